@@ -68,6 +68,25 @@ static INLINE void setBigField(uint64_t value, byte *memory, uint64_t offset,
   storeUInt64LE(addr, data);
 }
 
+/**
+ * Get the 64 bits which start at a bit offset of less than 32 from a byte
+ * address. This reads 12 bytes, and no more.
+ *
+ * @param memory  The byte address
+ * @param offset  The bit offset from that address, less than 32
+ *
+ * @return the bits
+ **/
+static INLINE uint64_t getWideField(const byte *memory, int offset)
+{
+  uint64_t field = getUInt64LE(memory) >> offset;
+  if (offset > 0) {
+    field |= (uint64_t) getUInt32LE(memory + sizeof(uint64_t))
+      << (sizeof(uint64_t) * CHAR_BIT - offset);
+  }
+  return field;
+}
+
 /***********************************************************************/
 void getBytes(const byte *memory, uint64_t offset, byte *destination, int size)
 {
@@ -94,7 +113,10 @@ void setBytes(byte *memory, uint64_t offset, const byte *source, int size)
 void moveBits(const byte *sMemory, uint64_t source, byte *dMemory,
               uint64_t destination, int size)
 {
-  enum { UINT32_BIT = sizeof(uint32_t) * CHAR_BIT };
+  enum {
+    UINT32_BIT = sizeof(uint32_t) * CHAR_BIT,
+    UINT64_BIT = sizeof(uint64_t) * CHAR_BIT,
+  };
   if (size > MAX_BIG_FIELD_BITS) {
     if (source > destination) {
       // This is a large move from a higher to a lower address.  We move
@@ -107,11 +129,20 @@ void moveBits(const byte *sMemory, uint64_t source, byte *dMemory,
       source      += count;
       destination += count;
       size        -= count;
-      // Now do the main loop to copy 32 bit chunks that are int-aligned
-      // at the destination.
+      // Now do the main loops to copy 64 bit and then 32 bit chunks that are
+      // int-aligned at the destination. Each 64 bit chunk reads four bytes
+      // past itself, which must still be part of the field.
       int offset = source % UINT32_BIT;
       const byte *src = sMemory + (source - offset) / CHAR_BIT;
       byte *dest = dMemory + destination / CHAR_BIT;
+      while (size > MAX_BIG_FIELD_BITS + UINT64_BIT) {
+        storeUInt64LE(dest, getWideField(src, offset));
+        src  += sizeof(uint64_t);
+        dest += sizeof(uint64_t);
+        source      += UINT64_BIT;
+        destination += UINT64_BIT;
+        size        -= UINT64_BIT;
+      }
       while (size > MAX_BIG_FIELD_BITS) {
         storeUInt32LE(dest, getUInt64LE(src) >> offset);
         src  += sizeof(uint32_t);
@@ -130,11 +161,17 @@ void moveBits(const byte *sMemory, uint64_t source, byte *dMemory,
         uint64_t field = getBigField(sMemory, source + size, count);
         setBigField(field, dMemory, destination + size, count);
       }
-      // Now do the main loop to copy 32 bit chunks that are int-aligned
-      // at the destination.
+      // Now do the main loops to copy 64 bit and then 32 bit chunks that are
+      // int-aligned at the destination.
       int offset = (source + size) % UINT32_BIT;
       const byte *src = sMemory + (source + size - offset) / CHAR_BIT;
       byte *dest = dMemory + (destination + size) / CHAR_BIT;
+      while (size > MAX_BIG_FIELD_BITS + UINT64_BIT) {
+        src  -= sizeof(uint64_t);
+        dest -= sizeof(uint64_t);
+        size -= UINT64_BIT;
+        storeUInt64LE(dest, getWideField(src, offset));
+      }
       while (size > MAX_BIG_FIELD_BITS) {
         src  -= sizeof(uint32_t);
         dest -= sizeof(uint32_t);
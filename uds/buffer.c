@@ -401,10 +401,15 @@ int getUInt32BEsFromBuffer(Buffer *buffer, size_t count, uint32_t *ui)
     return UDS_BUFFER_ERROR;
   }
 
-  unsigned int i;
+  memcpy(ui, buffer->data + buffer->start, sizeof(uint32_t) * count);
+  buffer->start += sizeof(uint32_t) * count;
+#if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
+  // Swap in place, in a loop simple enough for the compiler to vectorize.
+  size_t i;
   for (i = 0; i < count; i++) {
-    decodeUInt32BE(buffer->data, &buffer->start, ui + i);
+    ui[i] = __builtin_bswap32(ui[i]);
   }
+#endif
   return UDS_SUCCESS;
 }
 
@@ -415,10 +420,15 @@ int putUInt32BEsIntoBuffer(Buffer *buffer, size_t count, const uint32_t *ui)
     return UDS_BUFFER_ERROR;
   }
 
-  unsigned int i;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  memcpy(buffer->data + buffer->end, ui, sizeof(uint32_t) * count);
+  buffer->end += sizeof(uint32_t) * count;
+#else
+  size_t i;
   for (i = 0; i < count; i++) {
     encodeUInt32BE(buffer->data, &buffer->end, ui[i]);
   }
+#endif
   return UDS_SUCCESS;
 }
 
@@ -429,10 +439,14 @@ int getUInt64BEsFromBuffer(Buffer *buffer, size_t count, uint64_t *ui)
     return UDS_BUFFER_ERROR;
   }
 
-  unsigned int i;
+  memcpy(ui, buffer->data + buffer->start, sizeof(uint64_t) * count);
+  buffer->start += sizeof(uint64_t) * count;
+#if __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
+  size_t i;
   for (i = 0; i < count; i++) {
-    decodeUInt64BE(buffer->data, &buffer->start, ui + i);
+    ui[i] = __builtin_bswap64(ui[i]);
   }
+#endif
   return UDS_SUCCESS;
 }
 
@@ -443,10 +457,15 @@ int putUInt64BEsIntoBuffer(Buffer *buffer, size_t count, const uint64_t *ui)
     return UDS_BUFFER_ERROR;
   }
 
-  unsigned int i;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  memcpy(buffer->data + buffer->end, ui, sizeof(uint64_t) * count);
+  buffer->end += sizeof(uint64_t) * count;
+#else
+  size_t i;
   for (i = 0; i < count; i++) {
     encodeUInt64BE(buffer->data, &buffer->end, ui[i]);
   }
+#endif
   return UDS_SUCCESS;
 }
 
@@ -479,10 +498,14 @@ int getUInt16LEsFromBuffer(Buffer *buffer, size_t count, uint16_t *ui)
     return UDS_BUFFER_ERROR;
   }
 
-  unsigned int i;
+  memcpy(ui, buffer->data + buffer->start, sizeof(uint16_t) * count);
+  buffer->start += sizeof(uint16_t) * count;
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+  size_t i;
   for (i = 0; i < count; i++) {
-    decodeUInt16LE(buffer->data, &buffer->start, ui + i);
+    ui[i] = __builtin_bswap16(ui[i]);
   }
+#endif
   return UDS_SUCCESS;
 }
 
@@ -493,10 +516,15 @@ int putUInt16LEsIntoBuffer(Buffer *buffer, size_t count, const uint16_t *ui)
     return UDS_BUFFER_ERROR;
   }
 
-  unsigned int i;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(buffer->data + buffer->end, ui, sizeof(uint16_t) * count);
+  buffer->end += sizeof(uint16_t) * count;
+#else
+  size_t i;
   for (i = 0; i < count; i++) {
     encodeUInt16LE(buffer->data, &buffer->end, ui[i]);
   }
+#endif
   return UDS_SUCCESS;
 }
 
@@ -533,6 +561,43 @@ int putUInt32LEIntoBuffer(Buffer *buffer, uint32_t ui)
   return UDS_SUCCESS;
 }
 
+/**********************************************************************/
+int getUInt32LEsFromBuffer(Buffer *buffer, size_t count, uint32_t *ui)
+{
+  if (contentLength(buffer) < (sizeof(uint32_t) * count)) {
+    return UDS_BUFFER_ERROR;
+  }
+
+  memcpy(ui, buffer->data + buffer->start, sizeof(uint32_t) * count);
+  buffer->start += sizeof(uint32_t) * count;
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+  size_t i;
+  for (i = 0; i < count; i++) {
+    ui[i] = __builtin_bswap32(ui[i]);
+  }
+#endif
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+int putUInt32LEsIntoBuffer(Buffer *buffer, size_t count, const uint32_t *ui)
+{
+  if (!ensureAvailableSpace(buffer, sizeof(uint32_t) * count)) {
+    return UDS_BUFFER_ERROR;
+  }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(buffer->data + buffer->end, ui, sizeof(uint32_t) * count);
+  buffer->end += sizeof(uint32_t) * count;
+#else
+  size_t i;
+  for (i = 0; i < count; i++) {
+    encodeUInt32LE(buffer->data, &buffer->end, ui[i]);
+  }
+#endif
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 int putInt64LEIntoBuffer(Buffer *buffer, int64_t i)
 {
@@ -573,10 +638,14 @@ int getUInt64LEsFromBuffer(Buffer *buffer, size_t count, uint64_t *ui)
     return UDS_BUFFER_ERROR;
   }
 
-  unsigned int i;
+  memcpy(ui, buffer->data + buffer->start, sizeof(uint64_t) * count);
+  buffer->start += sizeof(uint64_t) * count;
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+  size_t i;
   for (i = 0; i < count; i++) {
-    decodeUInt64LE(buffer->data, &buffer->start, ui + i);
+    ui[i] = __builtin_bswap64(ui[i]);
   }
+#endif
   return UDS_SUCCESS;
 }
 
@@ -587,10 +656,15 @@ int putUInt64LEsIntoBuffer(Buffer *buffer, size_t count, const uint64_t *ui)
     return UDS_BUFFER_ERROR;
   }
 
-  unsigned int i;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(buffer->data + buffer->end, ui, sizeof(uint64_t) * count);
+  buffer->end += sizeof(uint64_t) * count;
+#else
+  size_t i;
   for (i = 0; i < count; i++) {
     encodeUInt64LE(buffer->data, &buffer->end, ui[i]);
   }
+#endif
   return UDS_SUCCESS;
 }
 
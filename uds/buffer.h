@@ -544,6 +544,34 @@ int getUInt32LEFromBuffer(Buffer *buffer, uint32_t *ui)
 int putUInt32LEIntoBuffer(Buffer *buffer, uint32_t ui)
   __attribute__((warn_unused_result));
 
+/**
+ * Get a series of 4 byte, little endian encoded integers from a buffer and
+ * advance the start pointer past them.
+ *
+ * @param buffer The buffer
+ * @param count  The number of integers to get
+ * @param ui     A pointer to hold the integers
+ *
+ * @return UDS_SUCCESS or UDS_BUFFER_ERROR if there is not enough data
+ *         in the buffer
+ **/
+int getUInt32LEsFromBuffer(Buffer *buffer, size_t count, uint32_t *ui)
+  __attribute__((warn_unused_result));
+
+/**
+ * Put a series of 4 byte, little endian encoded integers into a buffer and
+ * advance the end pointer past them.
+ *
+ * @param buffer The buffer
+ * @param count  The number of integers to put
+ * @param ui     A pointer to the integers
+ *
+ * @return UDS_SUCCESS or UDS_BUFFER_ERROR if there is not enough space
+ *         in the buffer
+ **/
+int putUInt32LEsIntoBuffer(Buffer *buffer, size_t count, const uint32_t *ui)
+  __attribute__((warn_unused_result));
+
 /**
  * Get an 8 byte, little endian encoded, unsigned integer from a
  * buffer and advance the start pointer past it.
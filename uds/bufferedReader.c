@@ -71,6 +71,30 @@ static void readAhead(BufferedReader *br, sector_t blockNumber)
     dm_bufio_prefetch(br->br_client, blockNumber, readAhead);
   }
 }
+
+/*****************************************************************************/
+enum { MAX_BULK_READ_AHEAD = 256 };
+
+/**
+ * Prefetch the blocks needed to finish a read which spans many blocks, so
+ * that large reads such as delta list images are not limited by the small
+ * sequential read ahead.
+ *
+ * @param br           The buffered reader
+ * @param blockNumber  The next block to be read
+ * @param length       The number of bytes remaining to be read
+ **/
+static void readAheadBulk(BufferedReader *br,
+                          sector_t        blockNumber,
+                          size_t          length)
+{
+  if (blockNumber < br->br_limit) {
+    size_t blocks = minSizeT((length + UDS_BLOCK_SIZE - 1) / UDS_BLOCK_SIZE,
+                             MAX_BULK_READ_AHEAD);
+    blocks = minSizeT(blocks, br->br_limit - blockNumber);
+    dm_bufio_prefetch(br->br_client, blockNumber, blocks);
+  }
+}
 #endif
 
 /*****************************************************************************/
@@ -202,12 +226,23 @@ int readFromBufferedReader(BufferedReader *br, void *data, size_t length)
 {
   byte *dp = data;
   int result = UDS_SUCCESS;
+#ifdef __KERNEL__
+  sector_t nextBulkReadAhead = 0;
+#endif
   while (length > 0) {
     if (bytesRemainingInReadBuffer(br) == 0) {
       sector_t blockNumber = br->br_blockNumber;
       if (br->br_pointer != NULL) {
         ++blockNumber;
       }
+#ifdef __KERNEL__
+      // Keep a large window of blocks in flight ahead of a long read,
+      // refilling it each time half of it has been consumed.
+      if ((length > UDS_BLOCK_SIZE) && (blockNumber >= nextBulkReadAhead)) {
+        readAheadBulk(br, blockNumber, length);
+        nextBulkReadAhead = blockNumber + MAX_BULK_READ_AHEAD / 2;
+      }
+#endif
       result = positionReader(br, blockNumber, 0);
       if (result != UDS_SUCCESS) {
         break;
@@ -0,0 +1,402 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/jasper/src/uds/cacheBudget.c#1 $
+ */
+
+#include "cacheBudget.h"
+
+#ifdef __KERNEL__
+#include <linux/shrinker.h>
+#include <linux/workqueue.h>
+#endif
+
+#include "logger.h"
+#include "pageCache.h"
+#include "threadOnce.h"
+#include "threads.h"
+#include "timeUtils.h"
+#include "volume.h"
+
+enum {
+  /** The minimum time between rebalances after chapter writes */
+  REBALANCE_INTERVAL_USEC = 10 * 1000 * 1000,
+  /** The scale of the fraction of the spare budget given to each cache */
+  SHARE_SCALE_SHIFT = 12,
+  /** The time after memory pressure before reclaimed entries are regrown */
+  REGROW_DELAY_USEC = 10 * 1000 * 1000,
+  /** The fraction of a cache's configured size regrown each rebalance */
+  REGROW_SHIFT = 3,
+};
+
+static OnceState budgetOnce;
+
+static struct {
+  /** Protects the fields below; taken before any readThreadsMutex */
+  Mutex          mutex;
+  /** The budget in megabytes, or 0 if there is none */
+  unsigned int   megabytes;
+  /** The volumes sharing the budget */
+  Volume        *volumes;
+  /** The time of the next rebalance which is not forced */
+  uint64_t       nextRebalance;
+  /** The time of the last memory pressure reclaim */
+  uint64_t       lastPressure;
+  /** Whether any cache is held below its size by memory pressure */
+  bool           underPressure;
+  /** The page cache entries which could be given back under pressure */
+  unsigned long  reclaimablePages;
+#ifdef __KERNEL__
+  /** Gives page cache entries back to the kernel under memory pressure */
+  struct shrinker     shrinker;
+  /** Resizes the caches outside of reclaim, since that locks mutexes */
+  struct work_struct  shrinkWork;
+  /** The number of entries the shrinker has asked to have given back */
+  atomic_long_t       pendingReclaim;
+  /** Whether the shrinker is registered */
+  bool                shrinkerRegistered;
+#endif
+} budget;
+
+#ifdef __KERNEL__
+static void shrinkPageCaches(struct work_struct *work);
+#endif
+
+/**********************************************************************/
+static void initializeBudget(void)
+{
+  int result = initMutex(&budget.mutex);
+  if (result != UDS_SUCCESS) {
+    logErrorWithStringError(result, "cannot initialize page cache budget");
+  }
+#ifdef __KERNEL__
+  INIT_WORK(&budget.shrinkWork, shrinkPageCaches);
+#endif
+}
+
+/**
+ * Count the page cache hits of a volume.
+ *
+ * @param volume  the volume
+ *
+ * @return the number of hits of the volume's page cache
+ **/
+static uint64_t getPageCacheHits(const Volume *volume)
+{
+  const CacheCounters *counters = &volume->pageCache->counters;
+  return (counters->firstTime.indexPage.hits
+          + counters->firstTime.recordPage.hits
+          + counters->retried.indexPage.hits
+          + counters->retried.recordPage.hits);
+}
+
+/**
+ * Get the number of page cache entries a volume always keeps.
+ *
+ * @param volume  the volume
+ *
+ * @return the number of entries, one chapter's worth of record pages
+ **/
+static unsigned int getMinimumEntries(const Volume *volume)
+{
+  unsigned int entries = volume->geometry->recordPagesPerChapter;
+  return ((entries < volume->pageCache->numCacheEntries)
+          ? entries : volume->pageCache->numCacheEntries);
+}
+
+/**
+ * Resize the page cache of a volume, noting how much of it could be given
+ * back under memory pressure.
+ *
+ * @param volume   the volume
+ * @param entries  the number of entries the cache should use
+ *
+ * @return the number of entries the cache now uses
+ **/
+static unsigned int resizeBudgetedCache(Volume *volume, unsigned int entries)
+{
+  // We hold the budget mutex.
+  lockMutex(&volume->readThreadsMutex);
+  unsigned int active = resizePageCache(volume->pageCache, entries);
+  unlockMutex(&volume->readThreadsMutex);
+
+  unsigned int minimum = getMinimumEntries(volume);
+  if (active > minimum) {
+    budget.reclaimablePages += active - minimum;
+  }
+  return active;
+}
+
+/**
+ * Let the caches held back by memory pressure grow again, a step at a time,
+ * once there has been no pressure for a while.
+ **/
+static void regrowLocked(void)
+{
+  // We hold the budget mutex.
+  if (!budget.underPressure
+      || (nowUsec() < budget.lastPressure + REGROW_DELAY_USEC)) {
+    return;
+  }
+
+  budget.underPressure = false;
+  Volume *volume;
+  for (volume = budget.volumes; volume != NULL;
+       volume = volume->nextBudgetVolume) {
+    unsigned int size = volume->pageCache->numCacheEntries;
+    unsigned int step = (size >> REGROW_SHIFT) + 1;
+    volume->pressureEntries = ((volume->pressureEntries + step < size)
+                               ? volume->pressureEntries + step : size);
+    if (volume->pressureEntries < size) {
+      budget.underPressure = true;
+    }
+  }
+}
+
+/**
+ * Redistribute the budget over the page caches sharing it. The part of the
+ * budget beyond the minimum size of each cache is split in proportion to the
+ * hits each cache has had since the last rebalance. A cache whose pages earn
+ * more hits than those of the others therefore grows until the hits per page
+ * even out, which approximates giving memory where it gains the most hits.
+ * No cache grows beyond what memory pressure has left it.
+ **/
+static void rebalanceLocked(void)
+{
+  // We hold the budget mutex.
+  regrowLocked();
+  uint64_t  limit       = (uint64_t) budget.megabytes << 20;
+  uint64_t  minimum     = 0;
+  uint64_t  totalWeight = 0;
+  Volume   *volume;
+  budget.reclaimablePages = 0;
+  for (volume = budget.volumes; volume != NULL;
+       volume = volume->nextBudgetVolume) {
+    uint64_t hits = getPageCacheHits(volume);
+    volume->budgetWeight = hits - volume->budgetHits + 1;
+    volume->budgetHits   = hits;
+    totalWeight += volume->budgetWeight;
+    minimum += ((uint64_t) getMinimumEntries(volume)
+                * volume->geometry->bytesPerPage);
+  }
+
+  uint64_t spare = (limit > minimum) ? (limit - minimum) : 0;
+  for (volume = budget.volumes; volume != NULL;
+       volume = volume->nextBudgetVolume) {
+    uint64_t entries = volume->pageCache->numCacheEntries;
+    if (limit > 0) {
+      uint64_t share = (((volume->budgetWeight << SHARE_SCALE_SHIFT)
+                         / totalWeight)
+                        * (spare >> SHARE_SCALE_SHIFT));
+      entries = (getMinimumEntries(volume)
+                 + (share / volume->geometry->bytesPerPage));
+      if (entries > volume->pageCache->numCacheEntries) {
+        entries = volume->pageCache->numCacheEntries;
+      }
+    }
+    if (entries > volume->pressureEntries) {
+      entries = volume->pressureEntries;
+    }
+
+    resizeBudgetedCache(volume, entries);
+  }
+
+  budget.nextRebalance = nowUsec() + REBALANCE_INTERVAL_USEC;
+}
+
+/**********************************************************************/
+void setPageCacheBudget(unsigned int megabytes)
+{
+  performOnce(&budgetOnce, initializeBudget);
+  lockMutex(&budget.mutex);
+  budget.megabytes = megabytes;
+  rebalanceLocked();
+  unlockMutex(&budget.mutex);
+}
+
+/**********************************************************************/
+unsigned int getPageCacheBudget(void)
+{
+  return budget.megabytes;
+}
+
+#ifdef __KERNEL__
+/**
+ * Count the page cache entries above the minimum size of each cache, which
+ * may be given back under memory pressure. Implements count_objects for the
+ * page cache shrinker.
+ **/
+static unsigned long countCachePages(struct shrinker       *shrinker
+                                     __attribute__((unused)),
+                                     struct shrink_control *sc
+                                     __attribute__((unused)))
+{
+  return READ_ONCE(budget.reclaimablePages);
+}
+
+/**
+ * Schedule the page caches to give back the entries the kernel asked for.
+ * Implements scan_objects for the page cache shrinker. Resizing a cache
+ * takes mutexes and waits for searches, so nothing is freed immediately.
+ **/
+static unsigned long scanCachePages(struct shrinker       *shrinker
+                                    __attribute__((unused)),
+                                    struct shrink_control *sc)
+{
+  atomic_long_add(sc->nr_to_scan, &budget.pendingReclaim);
+  schedule_work(&budget.shrinkWork);
+  return SHRINK_STOP;
+}
+
+/**
+ * Give back the page cache entries the shrinker asked for, taking from each
+ * cache in proportion to what it could give back. The caches are held at
+ * their reduced sizes until there has been no pressure for a while.
+ *
+ * @param work  the shrinkWork of the budget
+ **/
+static void shrinkPageCaches(struct work_struct *work __attribute__((unused)))
+{
+  lockMutex(&budget.mutex);
+  uint64_t wanted      = atomic_long_xchg(&budget.pendingReclaim, 0);
+  uint64_t reclaimable = budget.reclaimablePages;
+  if ((wanted == 0) || (reclaimable == 0)) {
+    unlockMutex(&budget.mutex);
+    return;
+  }
+  if (wanted > reclaimable) {
+    wanted = reclaimable;
+  }
+
+  budget.reclaimablePages = 0;
+  Volume *volume;
+  for (volume = budget.volumes; volume != NULL;
+       volume = volume->nextBudgetVolume) {
+    unsigned int active  = volume->pageCache->activeEntries;
+    unsigned int minimum = getMinimumEntries(volume);
+    unsigned int entries = active;
+    if (active > minimum) {
+      entries -= ((active - minimum) * wanted) / reclaimable;
+    }
+    volume->pressureEntries = entries;
+    unsigned int remaining  = resizeBudgetedCache(volume, entries);
+    if (remaining < active) {
+      volume->reclaimedBytes += ((uint64_t) (active - remaining)
+                                 * volume->geometry->bytesPerPage);
+    }
+  }
+
+  budget.lastPressure  = nowUsec();
+  budget.underPressure = true;
+  unlockMutex(&budget.mutex);
+}
+
+/**
+ * Register the page cache shrinker, if it is not already.
+ **/
+static void registerCacheShrinker(void)
+{
+  // We hold the budget mutex.
+  if (budget.shrinkerRegistered) {
+    return;
+  }
+
+  budget.shrinker = (struct shrinker) {
+    .count_objects = countCachePages,
+    .scan_objects  = scanCachePages,
+    .seeks         = DEFAULT_SEEKS,
+  };
+  int result = register_shrinker(&budget.shrinker);
+  if (result != 0) {
+    logWarningWithStringError(result, "cannot register page cache shrinker");
+    return;
+  }
+  budget.shrinkerRegistered = true;
+}
+
+/**
+ * Unregister the page cache shrinker once no volume shares the budget.
+ *
+ * @return whether the shrinker was unregistered
+ **/
+static bool unregisterCacheShrinker(void)
+{
+  // We hold the budget mutex.
+  if (!budget.shrinkerRegistered || (budget.volumes != NULL)) {
+    return false;
+  }
+  budget.shrinkerRegistered = false;
+  unregister_shrinker(&budget.shrinker);
+  return true;
+}
+#endif /* __KERNEL__ */
+
+/**********************************************************************/
+void addVolumeToCacheBudget(Volume *volume)
+{
+  performOnce(&budgetOnce, initializeBudget);
+  lockMutex(&budget.mutex);
+  volume->nextBudgetVolume = budget.volumes;
+  volume->budgetHits       = getPageCacheHits(volume);
+  volume->pressureEntries  = volume->pageCache->numCacheEntries;
+  budget.volumes           = volume;
+  rebalanceLocked();
+#ifdef __KERNEL__
+  registerCacheShrinker();
+#endif
+  unlockMutex(&budget.mutex);
+}
+
+/**********************************************************************/
+void removeVolumeFromCacheBudget(Volume *volume)
+{
+  performOnce(&budgetOnce, initializeBudget);
+  lockMutex(&budget.mutex);
+  Volume **link = &budget.volumes;
+  while (*link != NULL) {
+    if (*link == volume) {
+      *link = volume->nextBudgetVolume;
+      volume->nextBudgetVolume = NULL;
+      rebalanceLocked();
+      break;
+    }
+    link = &(*link)->nextBudgetVolume;
+  }
+#ifdef __KERNEL__
+  bool unregistered = unregisterCacheShrinker();
+#endif
+  unlockMutex(&budget.mutex);
+#ifdef __KERNEL__
+  if (unregistered) {
+    // The shrink work takes the budget mutex, so wait for it unlocked.
+    cancel_work_sync(&budget.shrinkWork);
+  }
+#endif
+}
+
+/**********************************************************************/
+void rebalanceCacheBudget(bool force)
+{
+  performOnce(&budgetOnce, initializeBudget);
+  lockMutex(&budget.mutex);
+  if (((budget.megabytes > 0) || budget.underPressure)
+      && (force || (nowUsec() >= budget.nextRebalance))) {
+    rebalanceLocked();
+  }
+  unlockMutex(&budget.mutex);
+}
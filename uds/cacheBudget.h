@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/jasper/src/uds/cacheBudget.h#1 $
+ */
+
+#ifndef CACHE_BUDGET_H
+#define CACHE_BUDGET_H
+
+#include "typeDefs.h"
+
+// Bare declaration to avoid include dependency loops.
+struct volume;
+
+/**
+ * Set the host-wide memory budget shared by the page caches of all open
+ * volumes, and rebalance the caches to fit it. Each page cache keeps at
+ * least one chapter's worth of record pages, and never grows beyond the
+ * size it was configured with, so the budget may not be met exactly.
+ *
+ * @param megabytes  the budget in megabytes, or 0 to let every page cache
+ *                   use its configured size
+ **/
+void setPageCacheBudget(unsigned int megabytes);
+
+/**
+ * Get the host-wide page cache memory budget.
+ *
+ * @return the budget in megabytes, or 0 if there is none
+ **/
+unsigned int getPageCacheBudget(void) __attribute__((warn_unused_result));
+
+/**
+ * Make the page cache of a newly made volume share the budget.
+ *
+ * @param volume  the volume
+ **/
+void addVolumeToCacheBudget(struct volume *volume);
+
+/**
+ * Stop a volume's page cache from sharing the budget. It is not an error if
+ * the volume was never added.
+ *
+ * @param volume  the volume
+ **/
+void removeVolumeFromCacheBudget(struct volume *volume);
+
+/**
+ * Redistribute the budget over the page caches which share it, according to
+ * the hits each cache has had since the last rebalance. Unless forced, this
+ * does nothing if the last rebalance was too recent. This must not be called
+ * while holding the readThreadsMutex of any volume.
+ *
+ * @param force  whether to rebalance regardless of the time
+ **/
+void rebalanceCacheBudget(bool force);
+
+#endif /* CACHE_BUDGET_H */
@@ -87,3 +87,18 @@ void incrementCacheCounter(CacheCounters   *counters,
   // XXX Vile case makes many assumptions.  Counters should be declared atomic.
   atomic64_inc((atomic64_t *) myCounter);
 }
+
+/**********************************************************************/
+void incrementReadAheadCounter(CacheCounters *counters, bool hit)
+{
+  uint64_t *myCounter = (hit
+                         ? &counters->readAheadHits
+                         : &counters->readAheadMisses);
+  atomic64_inc((atomic64_t *) myCounter);
+}
+
+/**********************************************************************/
+void addReadAheadPages(CacheCounters *counters, unsigned int pageCount)
+{
+  atomic64_add(pageCount, (atomic64_t *) &counters->readAheadPages);
+}
@@ -85,6 +85,14 @@ typedef struct cacheCounters {
   CacheCountsByKind     sparseChapters;
   /** Hit/miss counts for the sparce cache name searches */
   CacheCountsByKind     sparseSearches;
+
+  // counters for chapter read-ahead
+  /** Number of volume pages requested by read-ahead */
+  uint64_t              readAheadPages;
+  /** Number of record page searches which fell in a read-ahead window */
+  uint64_t              readAheadHits;
+  /** Number of record page searches which missed a read-ahead window */
+  uint64_t              readAheadMisses;
 } CacheCounters;
 
 /**
@@ -110,4 +118,20 @@ void incrementCacheCounter(CacheCounters   *counters,
                            int              probeType,
                            CacheResultKind  kind);
 
+/**
+ * Count a record page search in a chapter which has been read ahead.
+ *
+ * @param counters  pointer to the counters
+ * @param hit       whether the page searched was in the read-ahead window
+ **/
+void incrementReadAheadCounter(CacheCounters *counters, bool hit);
+
+/**
+ * Count volume pages requested by read-ahead.
+ *
+ * @param counters   pointer to the counters
+ * @param pageCount  the number of pages requested
+ **/
+void addReadAheadPages(CacheCounters *counters, unsigned int pageCount);
+
 #endif /* CACHE_COUNTERS_H */
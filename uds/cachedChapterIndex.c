@@ -21,8 +21,95 @@
 
 #include "cachedChapterIndex.h"
 
+#include "hashUtils.h"
 #include "memoryAlloc.h"
 
+enum {
+  // The number of filter bits for each record in a chapter
+  FILTER_BITS_PER_RECORD = 8,
+  // The number of filter bits set for each chapter index entry
+  FILTER_PROBES = 3,
+};
+
+/**
+ * Compute the filter bit positions for a chapter index entry, identified by
+ * its delta list number and address, and set or test them.
+ *
+ * @param chapter  the cached chapter index
+ * @param key      the delta list number and address of the entry, in the
+ *                 form returned by extractChapterIndexBytes()
+ * @param set      true to add the entry to the filter, false to test for it
+ *
+ * @return true if all the bits for the entry are set
+ **/
+static INLINE bool probeFilter(CachedChapterIndex *chapter,
+                               uint64_t            key,
+                               bool                set)
+{
+  // The key is already a hash, but only the low bits vary, so spread them.
+  uint64_t hash  = key * 0x9E3779B97F4A7C15ULL;
+  uint32_t bit   = (uint32_t) (hash >> 32);
+  uint32_t step  = ((uint32_t) hash) | 1;
+  bool     found = true;
+  unsigned int i;
+  for (i = 0; i < FILTER_PROBES; i++) {
+    uint32_t position = bit & chapter->filterMask;
+    byte     mask     = 1 << (position % CHAR_BIT);
+    if (set) {
+      chapter->filter[position / CHAR_BIT] |= mask;
+    } else if ((chapter->filter[position / CHAR_BIT] & mask) == 0) {
+      found = false;
+      break;
+    }
+    bit += step;
+  }
+  return found;
+}
+
+/**
+ * Build the filter for a cached chapter index from its index pages.
+ *
+ * @param chapter   the cached chapter index, with its pages loaded
+ * @param geometry  the geometry governing the volume
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int buildChapterFilter(CachedChapterIndex *chapter,
+                              const Geometry     *geometry)
+{
+  memset(chapter->filter, 0, (chapter->filterMask / CHAR_BIT) + 1);
+  unsigned int i;
+  for (i = 0; i < chapter->indexPagesCount; i++) {
+    DeltaIndexPage *page = &chapter->indexPages[i];
+    unsigned int listCount
+      = page->highestListNumber - page->lowestListNumber + 1;
+    unsigned int list;
+    for (list = 0; list < listCount; list++) {
+      uint64_t listBits = ((uint64_t) (page->lowestListNumber + list)
+                           << geometry->chapterAddressBits);
+      DeltaIndexEntry entry;
+      int result = startDeltaIndexSearch(&page->deltaIndex, list, 0, true,
+                                         &entry);
+      if (result != UDS_SUCCESS) {
+        return result;
+      }
+      for (;;) {
+        result = nextDeltaIndexEntry(&entry);
+        if (result != UDS_SUCCESS) {
+          return result;
+        }
+        if (entry.atEnd) {
+          break;
+        }
+        if (!entry.isCollision) {
+          probeFilter(chapter, listBits | entry.key, true);
+        }
+      }
+    }
+  }
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 int initializeCachedChapterIndex(CachedChapterIndex *chapter,
                                  const Geometry     *geometry)
@@ -41,6 +128,19 @@ int initializeCachedChapterIndex(CachedChapterIndex *chapter,
   if (result != UDS_SUCCESS) {
     return result;
   }
+
+  // Round the filter up to a power of two bits so it can be masked.
+  uint64_t filterBits = CHAR_BIT;
+  while (filterBits
+         < ((uint64_t) geometry->recordsPerChapter * FILTER_BITS_PER_RECORD)) {
+    filterBits *= 2;
+  }
+  chapter->filterMask = filterBits - 1;
+  result = ALLOCATE(filterBits / CHAR_BIT, byte, "sparse index filter",
+                    &chapter->filter);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
   
   unsigned int i;
   for (i = 0; i < chapter->indexPagesCount; i++) {
@@ -63,6 +163,7 @@ void destroyCachedChapterIndex(CachedChapterIndex *chapter)
   }
   FREE(chapter->indexPages);
   FREE(chapter->volumePages);
+  FREE(chapter->filter);
 }
 
 /**********************************************************************/
@@ -82,10 +183,16 @@ int cacheChapterIndex(CachedChapterIndex *chapter,
     return result;
   }
 
+  result = buildChapterFilter(chapter, volume->geometry);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
   // Reset all chapter counter values to zero.
   chapter->counters.searchHits        = 0;
   chapter->counters.searchMisses      = 0;
   chapter->counters.consecutiveMisses = 0;
+  chapter->counters.retainedHits      = 0;
 
   // Mark the entry as valid--it's now in the cache.
   chapter->virtualChapter = virtualChapter;
@@ -101,6 +208,14 @@ int searchCachedChapterIndex(CachedChapterIndex *chapter,
                              const UdsChunkName *name,
                              int                *recordPagePtr)
 {
+  uint64_t key = (extractChapterIndexBytes(name)
+                  & ((1ULL << (geometry->chapterAddressBits
+                               + geometry->chapterDeltaListBits)) - 1));
+  if (!probeFilter(chapter, key, false)) {
+    *recordPagePtr = NO_CHAPTER_INDEX_ENTRY;
+    return UDS_SUCCESS;
+  }
+
   // Find the indexPageNumber in the chapter that would have the chunk name.
   unsigned int physicalChapter
     = mapToPhysicalChapter(geometry, chapter->virtualChapter);
@@ -47,6 +47,9 @@ struct __attribute__((aligned(CACHE_LINE_BYTES))) cachedIndexCounters {
 
   /** the number of consecutive search misses since the last cache hit */
   uint64_t consecutiveMisses;
+
+  /** the number of search hits when this chapter was last spared eviction */
+  uint64_t retainedHits;
 };
 typedef struct cachedIndexCounters CachedIndexCounters;
 
@@ -86,6 +89,16 @@ struct __attribute__((aligned(CACHE_LINE_BYTES))) cachedChapterIndex {
   /* pointer to an array of VolumePages containing the index pages */
   struct volume_page *volumePages;
 
+  /*
+   * A Bloom filter of the chapter index entries, so that a search for a
+   * name which is not in the chapter can usually be rejected without
+   * decoding a delta list. It is rebuilt when the cache entry is replaced.
+   */
+  byte               *filter;
+
+  /* The number of bits in the filter, minus one */
+  uint32_t            filterMask;
+
   // The cache-aligned counters change often and are placed at the end of the
   // structure to prevent false sharing with the more stable fields above.
 
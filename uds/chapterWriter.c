@@ -36,6 +36,8 @@ struct chapterWriter {
   Index            *index;
   /* The thread to do the writing */
   Thread            thread;
+  /* The thread which writes record pages while index pages are written */
+  Thread            recordThread;
   /* lock protecting the following fields */
   Mutex             mutex;
   /* condition signalled on state changes */
@@ -48,14 +50,111 @@ struct chapterWriter {
   size_t            memoryAllocated;
   /* The number of zones which have submitted a chapter for writing */
   unsigned int      zonesToWrite;
-  /* Open chapter index used by closeOpenChapter() */
+  /* Set when collated records are ready for the record thread to write */
+  bool              recordsReady;
+  /* The result of writing the most recent record pages */
+  int               recordResult;
+  /* The physical page number of the chapter being written */
+  int               physicalPage;
+  /* Open chapter index used by writeSubmittedChapter() */
   OpenChapterIndex *openChapterIndex;
-  /* Collated records used by closeOpenChapter() */
+  /* Collated records used by writeSubmittedChapter() */
   UdsChunkRecord   *collatedRecords;
   /* The chapters to write (one per zone) */
   OpenChapterZone  *chapters[];
 };
 
+/**
+ * This is the driver function for the record writer thread. It loops until
+ * terminated, waiting for the writer thread to provide collated records, and
+ * sorts and writes their record pages while the writer thread packs and
+ * writes the index pages of the same chapter.
+ **/
+static void writeRecords(void *arg)
+{
+  ChapterWriter *writer = arg;
+  lockMutex(&writer->mutex);
+  for (;;) {
+    while (!writer->recordsReady) {
+      if (writer->stop && (writer->zonesToWrite == 0)) {
+        unlockMutex(&writer->mutex);
+        return;
+      }
+      waitCond(&writer->cond, &writer->mutex);
+    }
+
+    // The collated records and the physical page don't change until the
+    // writer thread sees our result.
+    unlockMutex(&writer->mutex);
+    int result = writeClaimedRecordPages(writer->index->volume, 0,
+                                         writer->physicalPage,
+                                         writer->collatedRecords, NULL);
+    lockMutex(&writer->mutex);
+    writer->recordResult = result;
+    writer->recordsReady = false;
+    broadcastCond(&writer->cond);
+  }
+}
+
+/**
+ * Write the chapter the zones have submitted. The records are collated and
+ * the chapter index populated first; then the record pages are written by
+ * the record writer thread while this thread writes the index pages. Once
+ * the index pages are written, this thread shares the remaining record
+ * pages with the record writer thread.
+ *
+ * @param writer  the chapter writer
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int writeSubmittedChapter(ChapterWriter *writer)
+{
+  Volume *volume = writer->index->volume;
+  uint64_t virtualChapter = writer->index->newestVirtualChapter;
+  int result = collateOpenChapter(writer->chapters, writer->index->zoneCount,
+                                  writer->openChapterIndex,
+                                  writer->collatedRecords, virtualChapter);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  unsigned int physicalChapter
+    = mapToPhysicalChapter(volume->geometry, virtualChapter);
+  startRecordPageClaims(volume);
+  lockMutex(&writer->mutex);
+  writer->physicalPage
+    = mapToPhysicalPage(volume->geometry, physicalChapter, 0);
+  writer->recordsReady = true;
+  broadcastCond(&writer->cond);
+  unlockMutex(&writer->mutex);
+
+  result = writeIndexPages(volume, writer->physicalPage,
+                           writer->openChapterIndex, NULL);
+  if (result == UDS_SUCCESS) {
+    // Help the record writer thread with whatever record pages are left.
+    result = writeClaimedRecordPages(volume, 1, writer->physicalPage,
+                                     writer->collatedRecords, NULL);
+  }
+
+  lockMutex(&writer->mutex);
+  while (writer->recordsReady) {
+    waitCond(&writer->cond, &writer->mutex);
+  }
+  if (result == UDS_SUCCESS) {
+    result = writer->recordResult;
+  }
+  unlockMutex(&writer->mutex);
+
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  if (volume->sparseCache != NULL) {
+    adaptSparseCacheHooks(volume->sparseCache, virtualChapter);
+  }
+  return finishChapterWrite(volume);
+}
+
 /**
  * This is the driver function for the writer thread. It loops until
  * terminated, waiting for a chapter to provided to close.
@@ -100,12 +199,7 @@ static void closeChapters(void *arg)
       }
     }
 
-    int result = closeOpenChapter(writer->chapters,
-                                  writer->index->zoneCount,
-                                  writer->index->volume,
-                                  writer->openChapterIndex,
-                                  writer->collatedRecords,
-                                  writer->index->newestVirtualChapter);
+    int result = writeSubmittedChapter(writer);
 
     if (result == UDS_SUCCESS) {
       result = processChapterWriterCheckpointSaves(writer->index);
@@ -173,7 +267,13 @@ int makeChapterWriter(Index                       *index,
                              + collatedRecordsSize
                              + openChapterIndexMemoryAllocated);
 
-  // We're initialized, so now it's safe to start the writer thread.
+  // We're initialized, so now it's safe to start the writer threads.
+  result = createThread(writeRecords, writer, "recordWriter",
+                        &writer->recordThread);
+  if (result != UDS_SUCCESS) {
+    freeChapterWriter(writer);
+    return makeUnrecoverable(result);
+  }
   result = createThread(closeChapters, writer, "writer", &writer->thread);
   if (result != UDS_SUCCESS) {
     freeChapterWriter(writer);
@@ -246,20 +346,28 @@ void waitForIdleChapterWriter(ChapterWriter *writer)
 int stopChapterWriter(ChapterWriter *writer)
 {
   Thread writerThread = 0;
+  Thread recordThread = 0;
 
   lockMutex(&writer->mutex);
   if (writer->thread != 0) {
     writerThread = writer->thread;
     writer->thread = 0;
-    writer->stop = true;
-    broadcastCond(&writer->cond);
   }
+  if (writer->recordThread != 0) {
+    recordThread = writer->recordThread;
+    writer->recordThread = 0;
+  }
+  writer->stop = true;
+  broadcastCond(&writer->cond);
   int result = writer->result;
   unlockMutex(&writer->mutex);
 
   if (writerThread != 0) {
     joinThreads(writerThread);
   }
+  if (recordThread != 0) {
+    joinThreads(recordThread);
+  }
 
   if (result != UDS_SUCCESS) {
     return logUnrecoverable(result, "Writing of previous open chapter failed");
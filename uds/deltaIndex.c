@@ -138,6 +138,8 @@
  * data changes.
  **/
 enum { MAGIC_SIZE = 8 };
+/** The number of saved delta list sizes read or written at a time */
+enum { LIST_SIZE_CHUNK = 64 };
 static const char MAGIC_DI_START[] = "DI-00002";
 
 struct di_header {
@@ -242,20 +244,19 @@ static INLINE void setImmutableStart(byte *memory, unsigned int listNumber,
 //**********************************************************************
 
 /**
- * Decode a delta index entry delta value. The DeltaIndexEntry basically
- * describes the previous list entry, and has had its offset field changed to
- * point to the subsequent entry. We decode the bit stream and update the
- * DeltaListEntry to describe the entry.
+ * Decode the key delta of a delta index entry from the bit stream.
  *
- * @param deltaEntry  The delta index entry
+ * @param deltaZone    The delta memory containing the entry
+ * @param deltaOffset  The bit offset of the encoded delta
+ * @param keyBitsPtr   A pointer to hold the number of bits in the encoding
+ *
+ * @return the decoded delta
  **/
-static INLINE void decodeDelta(DeltaIndexEntry *deltaEntry)
+static INLINE unsigned int decodeKeyDelta(const DeltaMemory *deltaZone,
+                                          uint64_t           deltaOffset,
+                                          int               *keyBitsPtr)
 {
-  const DeltaMemory *deltaZone = deltaEntry->deltaZone;
-  const byte *memory = deltaZone->memory;
-  uint64_t deltaOffset
-    = getDeltaEntryOffset(deltaEntry) + deltaEntry->valueBits;
-  const byte *addr = memory + deltaOffset / CHAR_BIT;
+  const byte *addr = deltaZone->memory + deltaOffset / CHAR_BIT;
   int offset = deltaOffset % CHAR_BIT;
   uint32_t data = getUInt32LE(addr) >> offset;
   addr += sizeof(uint32_t);
@@ -273,6 +274,25 @@ static INLINE void decodeDelta(DeltaIndexEntry *deltaEntry)
     keyBits += ffs(data);
     delta += (keyBits - deltaZone->minBits - 1) * deltaZone->incrKeys;
   }
+  *keyBitsPtr = keyBits;
+  return delta;
+}
+
+/**
+ * Decode a delta index entry delta value. The DeltaIndexEntry basically
+ * describes the previous list entry, and has had its offset field changed to
+ * point to the subsequent entry. We decode the bit stream and update the
+ * DeltaListEntry to describe the entry.
+ *
+ * @param deltaEntry  The delta index entry
+ **/
+static INLINE void decodeDelta(DeltaIndexEntry *deltaEntry)
+{
+  int keyBits;
+  unsigned int delta
+    = decodeKeyDelta(deltaEntry->deltaZone,
+                     getDeltaEntryOffset(deltaEntry) + deltaEntry->valueBits,
+                     &keyBits);
   deltaEntry->delta = delta;
   deltaEntry->key += delta;
 
@@ -903,6 +923,48 @@ static int readDeltaIndexHeader(BufferedReader *reader,
   return result;
 }
 
+/**
+ * Read the saved sizes of the delta lists of one zone file, and record each
+ * in the zone which now holds the list. The sizes are read in chunks rather
+ * than two bytes at a time.
+ *
+ * @param deltaIndex  The delta index
+ * @param reader      The reader for the zone file
+ * @param firstList   The first list saved in the file
+ * @param numLists    The number of lists saved in the file
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+__attribute__((warn_unused_result))
+static int readDeltaListSizes(const DeltaIndex *deltaIndex,
+                              BufferedReader   *reader,
+                              unsigned int      firstList,
+                              unsigned int      numLists)
+{
+  byte data[LIST_SIZE_CHUNK * sizeof(uint16_t)];
+  unsigned int i = 0;
+  while (i < numLists) {
+    unsigned int count = minSizeT(numLists - i, LIST_SIZE_CHUNK);
+    int result = readFromBufferedReader(reader, data,
+                                        count * sizeof(uint16_t));
+    if (result != UDS_SUCCESS) {
+      return logWarningWithStringError(result,
+                                       "failed to read delta index size");
+    }
+
+    unsigned int j;
+    for (j = 0; j < count; j++, i++) {
+      uint16_t deltaListSize = getUInt16LE(data + (j * sizeof(uint16_t)));
+      unsigned int listNumber = firstList + i;
+      unsigned int zoneNumber = getDeltaIndexZone(deltaIndex, listNumber);
+      const DeltaMemory *deltaZone = &deltaIndex->deltaZones[zoneNumber];
+      listNumber -= deltaZone->firstList;
+      deltaZone->deltaLists[listNumber + 1].size = deltaListSize;
+    }
+  }
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 int startRestoringDeltaIndex(const DeltaIndex  *deltaIndex,
                              BufferedReader   **bufferedReaders,
@@ -1000,21 +1062,10 @@ int startRestoringDeltaIndex(const DeltaIndex  *deltaIndex,
   // Read the delta list sizes from the files, and distribute each of them
   // to proper zone
   for (z = 0; z < numZones; z++) {
-    unsigned int i;
-    for (i = 0; i < numLists[z]; i++) {
-      byte deltaListSizeData[sizeof(uint16_t)];
-      int result = readFromBufferedReader(reader[z], deltaListSizeData,
-                                          sizeof(deltaListSizeData));
-      if (result != UDS_SUCCESS) {
-        return logWarningWithStringError(result,
-                                         "failed to read delta index size");
-      }
-      uint16_t deltaListSize = getUInt16LE(deltaListSizeData);
-      unsigned int listNumber = firstList[z] + i;
-      unsigned int zoneNumber = getDeltaIndexZone(deltaIndex, listNumber);
-      const DeltaMemory *deltaZone = &deltaIndex->deltaZones[zoneNumber];
-      listNumber -= deltaZone->firstList;
-      deltaZone->deltaLists[listNumber + 1].size = deltaListSize;
+    int result = readDeltaListSizes(deltaIndex, reader[z], firstList[z],
+                                    numLists[z]);
+    if (result != UDS_SUCCESS) {
+      return result;
     }
   }
 
@@ -1040,6 +1091,23 @@ bool isRestoringDeltaIndexDone(const DeltaIndex *deltaIndex)
   return true;
 }
 
+/**********************************************************************/
+bool isRestoringDeltaIndexZoneDone(const DeltaIndex *deltaIndex,
+                                   unsigned int      zoneNumber)
+{
+  return areDeltaMemoryTransfersDone(&deltaIndex->deltaZones[zoneNumber]);
+}
+
+/**********************************************************************/
+bool isRestoringDeltaListDone(const DeltaIndex *deltaIndex,
+                              unsigned int      listNumber)
+{
+  const DeltaMemory *deltaZone
+    = &deltaIndex->deltaZones[getDeltaIndexZone(deltaIndex, listNumber)];
+  return !isDeltaListTransferPending(deltaZone,
+                                     listNumber - deltaZone->firstList);
+}
+
 /**********************************************************************/
 int restoreDeltaListToDeltaIndex(const DeltaIndex *deltaIndex,
                                  const DeltaListSaveInfo *dlsi,
@@ -1061,6 +1129,126 @@ int restoreDeltaListToDeltaIndex(const DeltaIndex *deltaIndex,
   return restoreDeltaList(&deltaIndex->deltaZones[zoneNumber], dlsi, data);
 }
 
+/**
+ * Restore the delta lists of an image one at a time. This is needed for
+ * the lists of a zone which the image only partly covers, or when some of
+ * the lists have already been restored.
+ *
+ * @param deltaIndex      The delta index
+ * @param firstList       The first delta list covered by the image
+ * @param numLists        The number of delta lists covered by the image
+ * @param bitOffsets      The saved bit offset of each delta list
+ * @param data            A buffer for reading a single delta list
+ * @param bufferedReader  The buffered reader to read the image from
+ *
+ * @return error code or UDS_SUCCESS
+ **/
+static int restoreImageListByList(const DeltaIndex *deltaIndex,
+                                  unsigned int      firstList,
+                                  unsigned int      numLists,
+                                  const byte       *bitOffsets,
+                                  byte data[DELTA_LIST_MAX_BYTE_COUNT],
+                                  BufferedReader   *bufferedReader)
+{
+  unsigned int i;
+  for (i = 0; i < numLists; i++) {
+    unsigned int listNumber = firstList + i;
+    // Only the lists still waiting for their data are in the image.
+    if (isRestoringDeltaListDone(deltaIndex, listNumber)) {
+      continue;
+    }
+
+    DeltaMemory *deltaZone
+      = &deltaIndex->deltaZones[getDeltaIndexZone(deltaIndex, listNumber)];
+    const DeltaList *deltaList
+      = &deltaZone->deltaLists[listNumber - deltaZone->firstList + 1];
+    DeltaListSaveInfo dlsi = {
+      .tag       = deltaIndex->tag,
+      .bitOffset = bitOffsets[i],
+      .byteCount = (((unsigned int) bitOffsets[i]
+                     + getDeltaListSize(deltaList) + CHAR_BIT - 1)
+                    / CHAR_BIT),
+      .index     = listNumber,
+    };
+    int result = readFromBufferedReader(bufferedReader, data, dlsi.byteCount);
+    if (result != UDS_SUCCESS) {
+      return logWarningWithStringError(result,
+                                       "failed to read delta list data");
+    }
+    result = restoreDeltaList(deltaZone, &dlsi, data);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+int restoreDeltaImageToDeltaIndex(const DeltaIndex        *deltaIndex,
+                                  const DeltaListSaveInfo *dlsi,
+                                  byte data[DELTA_LIST_MAX_BYTE_COUNT],
+                                  BufferedReader          *bufferedReader)
+{
+  // Make sure the image is intended for this delta index.  Do not log an
+  // error, as this may be valid data for another delta index.
+  if (dlsi->tag != deltaIndex->tag) {
+    return UDS_CORRUPT_COMPONENT;
+  }
+
+  byte range[2 * sizeof(uint32_t)];
+  int result = readFromBufferedReader(bufferedReader, range, sizeof(range));
+  if (result != UDS_SUCCESS) {
+    return logWarningWithStringError(result,
+                                     "failed to read delta list image");
+  }
+  unsigned int firstList = getUInt32LE(&range[0]);
+  unsigned int numLists  = getUInt32LE(&range[sizeof(uint32_t)]);
+  if ((firstList >= deltaIndex->numLists)
+      || (numLists > deltaIndex->numLists - firstList)) {
+    return logWarningWithStringError(UDS_CORRUPT_COMPONENT,
+                                     "invalid delta list image of %u lists"
+                                     " from %u", numLists, firstList);
+  }
+
+  byte *bitOffsets;
+  result = ALLOCATE(numLists, byte, "delta list bit offsets", &bitOffsets);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = readFromBufferedReader(bufferedReader, bitOffsets, numLists);
+  if (result != UDS_SUCCESS) {
+    FREE(bitOffsets);
+    return logWarningWithStringError(result,
+                                     "failed to read delta list image");
+  }
+
+  // The image was saved by one zone, which may cover several of the current
+  // zones, or parts of them, if the zone count has changed. The lists of
+  // each zone are contiguous in the image, so every zone which the image
+  // covers completely can still be read with a single read.
+  unsigned int endList = firstList + numLists;
+  unsigned int listNumber = firstList;
+  while ((listNumber < endList) && (result == UDS_SUCCESS)) {
+    DeltaMemory *deltaZone
+      = &deltaIndex->deltaZones[getDeltaIndexZone(deltaIndex, listNumber)];
+    unsigned int zoneEnd = deltaZone->firstList + deltaZone->numLists;
+    unsigned int count = ((zoneEnd < endList) ? zoneEnd : endList) - listNumber;
+    const byte *zoneBitOffsets = &bitOffsets[listNumber - firstList];
+    if ((deltaZone->firstList == listNumber)
+        && (deltaZone->numLists == count)
+        && canRestoreDeltaMemoryImage(deltaZone, zoneBitOffsets)) {
+      result = restoreDeltaMemoryImage(deltaZone, zoneBitOffsets,
+                                       bufferedReader);
+    } else {
+      result = restoreImageListByList(deltaIndex, listNumber, count,
+                                      zoneBitOffsets, data, bufferedReader);
+    }
+    listNumber += count;
+  }
+  FREE(bitOffsets);
+  return result;
+}
+
 /**********************************************************************/
 void abortRestoringDeltaIndex(const DeltaIndex *deltaIndex)
 {
@@ -1070,6 +1258,13 @@ void abortRestoringDeltaIndex(const DeltaIndex *deltaIndex)
   }
 }
 
+/**********************************************************************/
+void abortRestoringDeltaIndexZone(const DeltaIndex *deltaIndex,
+                                  unsigned int      zoneNumber)
+{
+  abortRestoringDeltaMemory(&deltaIndex->deltaZones[zoneNumber]);
+}
+
 /**********************************************************************/
 __attribute__((warn_unused_result))
 static int encodeDeltaIndexHeader(Buffer *buffer, struct di_header *header)
@@ -1109,6 +1304,39 @@ static int encodeDeltaIndexHeader(Buffer *buffer, struct di_header *header)
   return result;
 }
 
+/**
+ * Write the sizes of the delta lists of a zone, a chunk at a time rather
+ * than two bytes at a time.
+ *
+ * @param deltaZone       The delta zone
+ * @param bufferedWriter  The writer for the zone file
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+__attribute__((warn_unused_result))
+static int writeDeltaListSizes(const DeltaMemory *deltaZone,
+                               BufferedWriter    *bufferedWriter)
+{
+  byte data[LIST_SIZE_CHUNK * sizeof(uint16_t)];
+  unsigned int i = 0;
+  while (i < deltaZone->numLists) {
+    unsigned int count = minSizeT(deltaZone->numLists - i, LIST_SIZE_CHUNK);
+    unsigned int j;
+    for (j = 0; j < count; j++, i++) {
+      storeUInt16LE(data + (j * sizeof(uint16_t)),
+                    getDeltaListSize(&deltaZone->deltaLists[i + 1]));
+    }
+
+    int result = writeToBufferedWriter(bufferedWriter, data,
+                                       count * sizeof(uint16_t));
+    if (result != UDS_SUCCESS) {
+      return logWarningWithStringError(result,
+                                       "failed to write delta list size");
+    }
+  }
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 int startSavingDeltaIndex(const DeltaIndex *deltaIndex,
                           unsigned int zoneNumber,
@@ -1142,16 +1370,9 @@ int startSavingDeltaIndex(const DeltaIndex *deltaIndex,
                                      "failed to write delta index header");
   }
 
-  unsigned int i;
-  for (i = 0; i < deltaZone->numLists; i++) {
-    uint16_t deltaListSize = getDeltaListSize(&deltaZone->deltaLists[i + 1]);
-    byte data[2];
-    storeUInt16LE(data, deltaListSize);
-    result = writeToBufferedWriter(bufferedWriter, data, sizeof(data));
-    if (result != UDS_SUCCESS) {
-      return logWarningWithStringError(result,
-                                       "failed to write delta list size");
-    }
+  result = writeDeltaListSizes(deltaZone, bufferedWriter);
+  if (result != UDS_SUCCESS) {
+    return result;
   }
 
   startSavingDeltaMemory(deltaZone, bufferedWriter);
@@ -1349,6 +1570,63 @@ int rememberDeltaIndexOffset(const DeltaIndexEntry *deltaEntry)
   return UDS_SUCCESS;
 }
 
+/**
+ * Advance a delta index entry over all the entries with keys less than a
+ * given key. This is the hot loop of every delta list search, so it keeps
+ * the decoding state in locals and decodes each entry with no function call
+ * or bounds assertion. It stops short of any entry it cannot trivially
+ * validate, leaving that entry for nextDeltaIndexEntry to decode and report.
+ *
+ * @param deltaEntry  The delta index entry, as set up by
+ *                    startDeltaIndexSearch
+ * @param key         The key to search for
+ **/
+static INLINE void skipDeltaIndexEntries(DeltaIndexEntry *deltaEntry,
+                                         unsigned int     key)
+{
+  const DeltaMemory *deltaZone = deltaEntry->deltaZone;
+  uint64_t           listStart = getDeltaListStart(deltaEntry->deltaList);
+  unsigned int       size      = getDeltaListSize(deltaEntry->deltaList);
+  unsigned int       valueBits = deltaEntry->valueBits;
+  unsigned int       entryKey  = deltaEntry->key;
+  uint32_t           offset    = deltaEntry->offset;
+  unsigned int       entryBits = deltaEntry->entryBits;
+
+  for (;;) {
+    uint32_t nextOffset = offset + entryBits;
+    if (nextOffset >= size) {
+      break;
+    }
+
+    int keyBits;
+    unsigned int delta = decodeKeyDelta(deltaZone,
+                                        listStart + nextOffset + valueBits,
+                                        &keyBits);
+    if (entryKey + delta >= key) {
+      break;
+    }
+
+    // A collision is a delta of zero not at the start of the list.
+    unsigned int nextBits = valueBits + keyBits;
+    if ((delta == 0) && (nextOffset > 0)) {
+      nextBits += COLLISION_BITS;
+    }
+    if (nextOffset + nextBits > size) {
+      break;
+    }
+
+    offset     = nextOffset;
+    entryBits  = nextBits;
+    entryKey  += delta;
+  }
+
+  // The delta and collision flag of the entry will be recomputed by the
+  // nextDeltaIndexEntry call which must follow.
+  deltaEntry->key       = entryKey;
+  deltaEntry->offset    = offset;
+  deltaEntry->entryBits = entryBits;
+}
+
 /**********************************************************************/
 int getDeltaIndexEntry(const DeltaIndex *deltaIndex, unsigned int listNumber,
                        unsigned int key, const byte *name, bool readOnly,
@@ -1359,6 +1637,7 @@ int getDeltaIndexEntry(const DeltaIndex *deltaIndex, unsigned int listNumber,
   if (result != UDS_SUCCESS) {
     return result;
   }
+  skipDeltaIndexEntries(deltaEntry, key);
   do {
     result = nextDeltaIndexEntry(deltaEntry);
     if (result != UDS_SUCCESS) {
@@ -1446,6 +1725,7 @@ int setDeltaEntryValue(const DeltaIndexEntry *deltaEntry, unsigned int value)
 
   setField(value, deltaEntry->deltaZone->memory,
            getDeltaEntryOffset(deltaEntry), deltaEntry->valueBits);
+  markDeltaListDirty(deltaEntry->deltaZone, deltaEntry->listNumber);
   return UDS_SUCCESS;
 }
 
@@ -1539,6 +1819,7 @@ int putDeltaIndexEntry(DeltaIndexEntry *deltaEntry, unsigned int key,
   encodeEntry(deltaEntry, value, name);
 
   DeltaMemory *deltaZone = deltaEntry->deltaZone;
+  markDeltaListDirty(deltaZone, deltaEntry->listNumber);
   deltaZone->recordCount++;
   deltaZone->collisionCount += deltaEntry->isCollision ? 1 : 0;
   return UDS_SUCCESS;
@@ -1586,6 +1867,7 @@ int removeDeltaIndexEntry(DeltaIndexEntry *deltaEntry)
     deleteBits(deltaEntry, oldSize - nextEntry.entryBits);
     encodeEntry(&nextEntry, nextValue, NULL);
   }
+  markDeltaListDirty(deltaZone, deltaEntry->listNumber);
   deltaZone->recordCount--;
   deltaZone->discardCount++;
   *deltaEntry = nextEntry;
@@ -1628,6 +1910,25 @@ uint64_t getDeltaIndexZoneDlistBitsUsed(const DeltaIndex *deltaIndex,
   return bitCount;
 }
 
+/**********************************************************************/
+uint64_t getDeltaIndexZoneDlistBitsAllocated(const DeltaIndex *deltaIndex,
+                                             unsigned int zoneNumber)
+{
+  return (uint64_t) deltaIndex->deltaZones[zoneNumber].size * CHAR_BIT;
+}
+
+/**********************************************************************/
+int resizeDeltaIndexZone(const DeltaIndex *deltaIndex,
+                         unsigned int      zoneNumber,
+                         size_t            size)
+{
+  if (!deltaIndex->isMutable) {
+    return logErrorWithStringError(UDS_BAD_STATE,
+                                   "Cannot resize an immutable index");
+  }
+  return resizeDeltaMemory(&deltaIndex->deltaZones[zoneNumber], size);
+}
+
 /**********************************************************************/
 uint64_t getDeltaIndexDlistBitsUsed(const DeltaIndex *deltaIndex)
 {
@@ -1659,14 +1960,18 @@ void getDeltaIndexStats(const DeltaIndex *deltaIndex, DeltaIndexStats *stats)
   unsigned int z;
   for (z = 0; z < deltaIndex->numZones; z++) {
     const DeltaMemory *deltaZone = &deltaIndex->deltaZones[z];
-    stats->memoryAllocated += getDeltaMemoryAllocated(deltaZone);
-    stats->rebalanceTime   += deltaZone->rebalanceTime;
-    stats->rebalanceCount  += deltaZone->rebalanceCount;
-    stats->recordCount     += deltaZone->recordCount;
-    stats->collisionCount  += deltaZone->collisionCount;
-    stats->discardCount    += deltaZone->discardCount;
-    stats->overflowCount   += deltaZone->overflowCount;
-    stats->numLists        += deltaZone->numLists;
+    stats->memoryAllocated     += getDeltaMemoryAllocated(deltaZone);
+    stats->rebalanceTime       += deltaZone->rebalanceTime;
+    stats->rebalanceCount      += deltaZone->rebalanceCount;
+    stats->localRebalanceCount += deltaZone->localRebalanceCount;
+    if (deltaZone->maxRebalanceTime > stats->maxRebalanceTime) {
+      stats->maxRebalanceTime = deltaZone->maxRebalanceTime;
+    }
+    stats->recordCount         += deltaZone->recordCount;
+    stats->collisionCount      += deltaZone->collisionCount;
+    stats->discardCount        += deltaZone->discardCount;
+    stats->overflowCount       += deltaZone->overflowCount;
+    stats->numLists            += deltaZone->numLists;
   }
 }
 
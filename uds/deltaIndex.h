@@ -106,14 +106,16 @@ typedef struct deltaIndexEntry {
 } DeltaIndexEntry;
 
 typedef struct {
-  size_t memoryAllocated;  // Number of bytes allocated
-  RelTime rebalanceTime;   // The time spent rebalancing
-  int  rebalanceCount;     // Number of memory rebalances
-  long recordCount;        // The number of records in the index
-  long collisionCount;     // The number of collision records
-  long discardCount;       // The number of records removed
-  long overflowCount;      // The number of UDS_OVERFLOWs detected
-  unsigned int numLists;   // The number of delta lists
+  size_t memoryAllocated;    // Number of bytes allocated
+  RelTime rebalanceTime;     // The time spent rebalancing
+  RelTime maxRebalanceTime;  // The longest time spent on one rebalance
+  int  rebalanceCount;       // Number of memory rebalances
+  int  localRebalanceCount;  // Number of rebalances of only nearby lists
+  long recordCount;          // The number of records in the index
+  long collisionCount;       // The number of collision records
+  long discardCount;         // The number of records removed
+  long overflowCount;        // The number of UDS_OVERFLOWs detected
+  unsigned int numLists;     // The number of delta lists
 } DeltaIndexStats;
 
 /**
@@ -236,6 +238,30 @@ int startRestoringDeltaIndex(const DeltaIndex *deltaIndex,
  **/
 bool isRestoringDeltaIndexDone(const DeltaIndex *deltaIndex);
 
+/**
+ * Have all the data for one zone been read while restoring a delta index
+ * from an input stream?
+ *
+ * @param deltaIndex  The delta index
+ * @param zoneNumber  The zone number
+ *
+ * @return true if all the data for the zone are read
+ **/
+bool isRestoringDeltaIndexZoneDone(const DeltaIndex *deltaIndex,
+                                   unsigned int      zoneNumber);
+
+/**
+ * Has a delta list been read while restoring a delta index from an input
+ * stream?
+ *
+ * @param deltaIndex  The delta index
+ * @param listNumber  The delta list number
+ *
+ * @return true if the delta list has been read
+ **/
+bool isRestoringDeltaListDone(const DeltaIndex *deltaIndex,
+                              unsigned int      listNumber);
+
 /**
  * Restore a saved delta list
  *
@@ -250,6 +276,22 @@ int restoreDeltaListToDeltaIndex(const DeltaIndex *deltaIndex,
                                  const byte data[DELTA_LIST_MAX_BYTE_COUNT])
   __attribute__((warn_unused_result));
 
+/**
+ * Restore an image of saved delta lists
+ *
+ * @param deltaIndex      The delta index
+ * @param dlsi            The DeltaListSaveInfo which introduced the image
+ * @param data            A buffer for reading a single delta list
+ * @param bufferedReader  The buffered reader to read the image from
+ *
+ * @return error code or UDS_SUCCESS
+ **/
+int restoreDeltaImageToDeltaIndex(const DeltaIndex        *deltaIndex,
+                                  const DeltaListSaveInfo *dlsi,
+                                  byte data[DELTA_LIST_MAX_BYTE_COUNT],
+                                  BufferedReader          *bufferedReader)
+  __attribute__((warn_unused_result));
+
 /**
  * Abort restoring a delta index from an input stream.
  *
@@ -257,6 +299,16 @@ int restoreDeltaListToDeltaIndex(const DeltaIndex *deltaIndex,
  **/
 void abortRestoringDeltaIndex(const DeltaIndex *deltaIndex);
 
+/**
+ * Abort restoring one zone of a delta index from an input stream, emptying
+ * all the delta lists of the zone.
+ *
+ * @param deltaIndex  The delta index
+ * @param zoneNumber  The zone number
+ **/
+void abortRestoringDeltaIndexZone(const DeltaIndex *deltaIndex,
+                                  unsigned int      zoneNumber);
+
 /**
  * Start saving a delta index zone to a buffered output stream.
  *
@@ -540,6 +592,34 @@ uint64_t getDeltaIndexZoneDlistBitsUsed(const DeltaIndex *deltaIndex,
                                         unsigned int zoneNumber)
   __attribute__((warn_unused_result));
 
+/**
+ * Get the number of bits allocated for master index entries in a zone
+ *
+ * @param deltaIndex  The delta index
+ * @param zoneNumber  The zone number
+ *
+ * @return The number of bits allocated
+ **/
+uint64_t getDeltaIndexZoneDlistBitsAllocated(const DeltaIndex *deltaIndex,
+                                             unsigned int zoneNumber)
+  __attribute__((warn_unused_result));
+
+/**
+ * Change the amount of memory allocated for the delta lists of a zone.
+ * The zone must not be in the middle of a save or restore.
+ *
+ * @param deltaIndex  The delta index
+ * @param zoneNumber  The zone number
+ * @param size        The new number of bytes of delta list memory
+ *
+ * @return UDS_SUCCESS, UDS_OVERFLOW if the lists of the zone do not fit in
+ *         the new size, or another error code
+ **/
+int resizeDeltaIndexZone(const DeltaIndex *deltaIndex,
+                         unsigned int      zoneNumber,
+                         size_t            size)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the number of bytes used for master index entries.
  *
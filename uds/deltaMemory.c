@@ -43,6 +43,14 @@
 // This is the number of guard bits that are needed in the tail guard list
 enum { GUARD_BITS = POST_FIELD_GUARD_BYTES * CHAR_BIT };
 
+enum {
+  // The number of delta lists in the smallest local rebalancing window
+  MIN_REBALANCE_WINDOW = 16,
+  // A local rebalance must leave each list in the window at least this
+  // fraction (as a divisor) of its share of the memory as free space
+  REBALANCE_FREE_DIVISOR = 16,
+};
+
 /**
  * Get the offset of the first byte that a delta list bit stream resides in
  *
@@ -250,6 +258,78 @@ static void rebalanceDeltaMemory(const DeltaMemory *deltaMemory,
   }
 }
 
+/**
+ * Try to make room for a growing delta list by rebalancing only the lists
+ * near it. The window of lists considered starts small and doubles until it
+ * has enough free space to be worth respacing, so the amount of data moved
+ * is proportional to the window and not to the whole zone.
+ *
+ * @param deltaMemory   A delta memory structure
+ * @param growingIndex  Index of the delta list that needs additional space
+ *                      left before it (from 1 to N+1)
+ * @param growingSize   Number of additional bytes needed before growingIndex
+ *
+ * @return true if the lists were rebalanced, or false if the window grew to
+ *         cover every list without finding enough space
+ **/
+static bool rebalanceNearbyDeltaLists(DeltaMemory  *deltaMemory,
+                                      unsigned int  growingIndex,
+                                      size_t        growingSize)
+{
+  DeltaList *deltaLists = deltaMemory->deltaLists;
+  size_t minSpacing
+    = deltaMemory->size / deltaMemory->numLists / REBALANCE_FREE_DIVISOR;
+  unsigned int window;
+  for (window = MIN_REBALANCE_WINDOW; window < deltaMemory->numLists;
+       window *= 2) {
+    // The window must include the list before growingIndex, since the space
+    // needed is between that list and growingIndex.
+    unsigned int first = ((growingIndex > window / 2)
+                          ? growingIndex - window / 2 : 1);
+    unsigned int last = first + window - 1;
+    if (last > deltaMemory->numLists) {
+      last  = deltaMemory->numLists;
+      first = last - window + 1;
+    }
+
+    // The window may use the memory between the lists just outside it.
+    const DeltaList *before = &deltaLists[first - 1];
+    uint64_t regionStart = (getDeltaListByteStart(before)
+                            + getDeltaListByteSize(before));
+    uint64_t regionEnd = getDeltaListByteStart(&deltaLists[last + 1]);
+    size_t usedSpace = growingSize;
+    unsigned int i;
+    for (i = first; i <= last; i++) {
+      usedSpace += getDeltaListByteSize(&deltaLists[i]);
+    }
+    if (regionEnd < regionStart + usedSpace) {
+      continue;
+    }
+
+    // There is one gap before each list and one after the last.
+    size_t spacing = ((regionEnd - regionStart - usedSpace)
+                      / (last - first + 2));
+    if (spacing < minSpacing) {
+      continue;
+    }
+
+    uint64_t offset = regionStart;
+    for (i = first; i <= last; i++) {
+      offset += spacing;
+      if (i == growingIndex) {
+        offset += growingSize;
+      }
+      deltaMemory->tempOffsets[i] = (offset * CHAR_BIT
+                                     + (getDeltaListStart(&deltaLists[i])
+                                        % CHAR_BIT));
+      offset += getDeltaListByteSize(&deltaLists[i]);
+    }
+    rebalanceDeltaMemory(deltaMemory, first, last);
+    return true;
+  }
+  return false;
+}
+
 /**********************************************************************/
 int initializeDeltaMemory(DeltaMemory *deltaMemory, size_t size,
                           unsigned int firstList, unsigned int numLists,
@@ -261,7 +341,7 @@ int initializeDeltaMemory(DeltaMemory *deltaMemory, size_t size,
                                      "delta lists");
   }
   byte *memory = NULL;
-  int result = ALLOCATE(size, byte, "delta list", &memory);
+  int result = allocateHugeMemory(size, "delta list", &memory);
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -280,27 +360,40 @@ int initializeDeltaMemory(DeltaMemory *deltaMemory, size_t size,
     FREE(tempOffsets);
     return result;
   }
+  byte *dirtyFlags = NULL;
+  result = ALLOCATE(getSizeOfFlags(numLists), byte, "delta list dirty flags",
+                    &dirtyFlags);
+  if (result != UDS_SUCCESS) {
+    FREE(memory);
+    FREE(tempOffsets);
+    FREE(flags);
+    return result;
+  }
 
   computeCodingConstants(meanDelta, &deltaMemory->minBits,
                          &deltaMemory->minKeys, &deltaMemory->incrKeys);
-  deltaMemory->valueBits       = numPayloadBits;
-  deltaMemory->memory          = memory;
-  deltaMemory->deltaLists      = NULL;
-  deltaMemory->tempOffsets     = tempOffsets;
-  deltaMemory->flags           = flags;
-  deltaMemory->bufferedWriter  = NULL;
-  deltaMemory->size            = size;
-  deltaMemory->rebalanceTime   = 0;
-  deltaMemory->rebalanceCount  = 0;
-  deltaMemory->recordCount     = 0;
-  deltaMemory->collisionCount  = 0;
-  deltaMemory->discardCount    = 0;
-  deltaMemory->overflowCount   = 0;
-  deltaMemory->firstList       = firstList;
-  deltaMemory->numLists        = numLists;
-  deltaMemory->numTransfers    = 0;
-  deltaMemory->transferStatus  = UDS_SUCCESS;
-  deltaMemory->tag             = 'm';
+  deltaMemory->valueBits           = numPayloadBits;
+  deltaMemory->memory              = memory;
+  deltaMemory->deltaLists          = NULL;
+  deltaMemory->tempOffsets         = tempOffsets;
+  deltaMemory->flags               = flags;
+  deltaMemory->dirtyFlags          = dirtyFlags;
+  deltaMemory->bufferedWriter      = NULL;
+  deltaMemory->size                = size;
+  deltaMemory->rebalanceTime       = 0;
+  deltaMemory->maxRebalanceTime    = 0;
+  deltaMemory->rebalanceCount      = 0;
+  deltaMemory->localRebalanceCount = 0;
+  deltaMemory->recordCount         = 0;
+  deltaMemory->collisionCount      = 0;
+  deltaMemory->discardCount        = 0;
+  deltaMemory->overflowCount       = 0;
+  deltaMemory->firstList           = firstList;
+  deltaMemory->numLists            = numLists;
+  deltaMemory->numTransfers        = 0;
+  deltaMemory->numDirtyLists       = 0;
+  deltaMemory->transferStatus      = UDS_SUCCESS;
+  deltaMemory->tag                 = 'm';
 
   // Allocate the delta lists.
   result = ALLOCATE(deltaMemory->numLists + 2, DeltaList,
@@ -319,6 +412,8 @@ void uninitializeDeltaMemory(DeltaMemory *deltaMemory)
 {
   FREE(deltaMemory->flags);
   deltaMemory->flags = NULL;
+  FREE(deltaMemory->dirtyFlags);
+  deltaMemory->dirtyFlags = NULL;
   FREE(deltaMemory->tempOffsets);
   deltaMemory->tempOffsets = NULL;
   FREE(deltaMemory->deltaLists);
@@ -335,24 +430,28 @@ void initializeDeltaMemoryPage(DeltaMemory *deltaMemory, byte *memory,
 {
   computeCodingConstants(meanDelta, &deltaMemory->minBits,
                          &deltaMemory->minKeys, &deltaMemory->incrKeys);
-  deltaMemory->valueBits       = numPayloadBits;
-  deltaMemory->memory          = memory;
-  deltaMemory->deltaLists      = NULL;
-  deltaMemory->tempOffsets     = NULL;
-  deltaMemory->flags           = NULL;
-  deltaMemory->bufferedWriter  = NULL;
-  deltaMemory->size            = size;
-  deltaMemory->rebalanceTime   = 0;
-  deltaMemory->rebalanceCount  = 0;
-  deltaMemory->recordCount     = 0;
-  deltaMemory->collisionCount  = 0;
-  deltaMemory->discardCount    = 0;
-  deltaMemory->overflowCount   = 0;
-  deltaMemory->firstList       = 0;
-  deltaMemory->numLists        = numLists;
-  deltaMemory->numTransfers    = 0;
-  deltaMemory->transferStatus  = UDS_SUCCESS;
-  deltaMemory->tag             = 'p';
+  deltaMemory->valueBits           = numPayloadBits;
+  deltaMemory->memory              = memory;
+  deltaMemory->deltaLists          = NULL;
+  deltaMemory->tempOffsets         = NULL;
+  deltaMemory->flags               = NULL;
+  deltaMemory->dirtyFlags          = NULL;
+  deltaMemory->bufferedWriter      = NULL;
+  deltaMemory->size                = size;
+  deltaMemory->rebalanceTime       = 0;
+  deltaMemory->maxRebalanceTime    = 0;
+  deltaMemory->rebalanceCount      = 0;
+  deltaMemory->localRebalanceCount = 0;
+  deltaMemory->recordCount         = 0;
+  deltaMemory->collisionCount      = 0;
+  deltaMemory->discardCount        = 0;
+  deltaMemory->overflowCount       = 0;
+  deltaMemory->firstList           = 0;
+  deltaMemory->numLists            = numLists;
+  deltaMemory->numTransfers        = 0;
+  deltaMemory->numDirtyLists       = 0;
+  deltaMemory->transferStatus      = UDS_SUCCESS;
+  deltaMemory->tag                 = 'p';
 }
 
 /**********************************************************************/
@@ -460,6 +559,57 @@ int restoreDeltaList(DeltaMemory *deltaMemory, const DeltaListSaveInfo *dlsi,
   return UDS_SUCCESS;
 }
 
+/**********************************************************************/
+bool canRestoreDeltaMemoryImage(const DeltaMemory *deltaMemory,
+                                const byte        *bitOffsets)
+{
+  uint64_t imageBytes = 0;
+  unsigned int nonEmptyLists = 0;
+  unsigned int i;
+  for (i = 0; i < deltaMemory->numLists; i++) {
+    uint16_t bitSize = getDeltaListSize(&deltaMemory->deltaLists[i + 1]);
+    if (bitSize > 0) {
+      nonEmptyLists++;
+      imageBytes += ((unsigned int) bitOffsets[i] + bitSize + CHAR_BIT - 1)
+                     / CHAR_BIT;
+    }
+  }
+
+  const DeltaList *guardList
+    = &deltaMemory->deltaLists[deltaMemory->numLists + 1];
+  return ((deltaMemory->numTransfers == nonEmptyLists)
+          && (imageBytes <= getDeltaListByteStart(guardList)));
+}
+
+/**********************************************************************/
+int restoreDeltaMemoryImage(DeltaMemory    *deltaMemory,
+                            const byte     *bitOffsets,
+                            BufferedReader *bufferedReader)
+{
+  // Lay the lists out end to end, exactly as they are in the image.
+  uint64_t imageBytes = 0;
+  unsigned int i;
+  for (i = 0; i < deltaMemory->numLists; i++) {
+    DeltaList *deltaList = &deltaMemory->deltaLists[i + 1];
+    deltaList->startOffset = imageBytes * CHAR_BIT;
+    if (getDeltaListSize(deltaList) > 0) {
+      deltaList->startOffset += bitOffsets[i];
+    }
+    imageBytes += getDeltaListByteSize(deltaList);
+  }
+
+  int result = readFromBufferedReader(bufferedReader, deltaMemory->memory,
+                                      imageBytes);
+  if (result != UDS_SUCCESS) {
+    return logWarningWithStringError(result,
+                                     "failed to read delta list image");
+  }
+  clearTransferFlags(deltaMemory);
+
+  // Now spread the lists out to leave room for each of them to grow.
+  return extendDeltaMemory(deltaMemory, 0, 0, true);
+}
+
 /**********************************************************************/
 void abortRestoringDeltaMemory(DeltaMemory *deltaMemory)
 {
@@ -473,17 +623,95 @@ void startSavingDeltaMemory(DeltaMemory *deltaMemory,
 {
   flagNonEmptyDeltaLists(deltaMemory);
   deltaMemory->bufferedWriter = bufferedWriter;
+  logDebug("saving delta lists %u-%u: %u of %u written lists changed since"
+           " the last save", deltaMemory->firstList,
+           deltaMemory->firstList + deltaMemory->numLists - 1,
+           deltaMemory->numDirtyLists, deltaMemory->numTransfers);
+  memset(deltaMemory->dirtyFlags, 0, getSizeOfFlags(deltaMemory->numLists));
+  deltaMemory->numDirtyLists = 0;
 }
 
 /**********************************************************************/
-int finishSavingDeltaMemory(DeltaMemory *deltaMemory)
+__attribute__((warn_unused_result))
+static int writeDeltaListSaveInfo(BufferedWriter *bufferedWriter,
+                                  DeltaListSaveInfo *dlsi)
 {
+  byte buffer[sizeof(DeltaListSaveInfo)];
+  buffer[0] = dlsi->tag;
+  buffer[1] = dlsi->bitOffset;
+  storeUInt16LE(&buffer[2], dlsi->byteCount);
+  storeUInt32LE(&buffer[4], dlsi->index);
+  return writeToBufferedWriter(bufferedWriter, buffer, sizeof(buffer));
+}
+
+/**
+ * Write every delta list which has not been flushed yet as a single image.
+ *
+ * @param deltaMemory  A delta memory structure
+ *
+ * @return error code or UDS_SUCCESS
+ **/
+static int writeDeltaMemoryImage(DeltaMemory *deltaMemory)
+{
+  BufferedWriter *bufferedWriter = deltaMemory->bufferedWriter;
+  DeltaListSaveInfo dlsi = {
+    .tag       = deltaMemory->tag,
+    .bitOffset = 0,
+    .byteCount = 0,
+    .index     = DELTA_LIST_IMAGE_INDEX,
+  };
+  int result = writeDeltaListSaveInfo(bufferedWriter, &dlsi);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  byte range[2 * sizeof(uint32_t)];
+  storeUInt32LE(&range[0], deltaMemory->firstList);
+  storeUInt32LE(&range[sizeof(uint32_t)], deltaMemory->numLists);
+  result = writeToBufferedWriter(bufferedWriter, range, sizeof(range));
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
   unsigned int i;
-  for (i = 0;
-       !areDeltaMemoryTransfersDone(deltaMemory)
-         && (i < deltaMemory->numLists);
-       i++) {
-    lazyFlushDeltaList(deltaMemory, i);
+  for (i = 0; i < deltaMemory->numLists; i++) {
+    byte bitOffset
+      = getDeltaListStart(&deltaMemory->deltaLists[i + 1]) % CHAR_BIT;
+    result = writeToBufferedWriter(bufferedWriter, &bitOffset, 1);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+
+  for (i = 0; i < deltaMemory->numLists; i++) {
+    if (!isDeltaListTransferPending(deltaMemory, i)) {
+      continue;
+    }
+    setZero(deltaMemory->flags, i, 1);
+    deltaMemory->numTransfers--;
+
+    const DeltaList *deltaList = &deltaMemory->deltaLists[i + 1];
+    result = writeToBufferedWriter(bufferedWriter,
+                                   deltaMemory->memory
+                                   + getDeltaListByteStart(deltaList),
+                                   getDeltaListByteSize(deltaList));
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+int finishSavingDeltaMemory(DeltaMemory *deltaMemory)
+{
+  if (!areDeltaMemoryTransfersDone(deltaMemory)) {
+    int result = writeDeltaMemoryImage(deltaMemory);
+    if ((result != UDS_SUCCESS)
+        && (deltaMemory->transferStatus == UDS_SUCCESS)) {
+      logWarningWithStringError(result, "failed to write delta list memory");
+      deltaMemory->transferStatus = result;
+    }
   }
   if (deltaMemory->numTransfers > 0) {
     deltaMemory->transferStatus
@@ -501,19 +729,6 @@ void abortSavingDeltaMemory(DeltaMemory *deltaMemory)
   deltaMemory->bufferedWriter = NULL;
 }
 
-/**********************************************************************/
-__attribute__((warn_unused_result))
-static int writeDeltaListSaveInfo(BufferedWriter *bufferedWriter,
-                                  DeltaListSaveInfo *dlsi)
-{
-  byte buffer[sizeof(DeltaListSaveInfo)];
-  buffer[0] = dlsi->tag;
-  buffer[1] = dlsi->bitOffset;
-  storeUInt16LE(&buffer[2], dlsi->byteCount);
-  storeUInt32LE(&buffer[4], dlsi->index);
-  return writeToBufferedWriter(bufferedWriter, buffer, sizeof(buffer));
-}
-
 /**********************************************************************/
 void flushDeltaList(DeltaMemory *deltaMemory, unsigned int flushIndex)
 {
@@ -564,6 +779,22 @@ int writeGuardDeltaList(BufferedWriter *bufferedWriter)
   return result;
 }
 
+/**
+ * Update the rebalancing statistics of a delta memory.
+ *
+ * @param deltaMemory  The delta memory which was rebalanced
+ * @param startTime    The time the rebalance started
+ **/
+static void noteRebalanceTime(DeltaMemory *deltaMemory, AbsTime startTime)
+{
+  RelTime elapsed = timeDifference(currentTime(CLOCK_MONOTONIC), startTime);
+  deltaMemory->rebalanceCount++;
+  deltaMemory->rebalanceTime += elapsed;
+  if (elapsed > deltaMemory->maxRebalanceTime) {
+    deltaMemory->maxRebalanceTime = elapsed;
+  }
+}
+
 /**********************************************************************/
 int extendDeltaMemory(DeltaMemory *deltaMemory, unsigned int growingIndex,
                       size_t growingSize, bool doCopy)
@@ -576,6 +807,15 @@ int extendDeltaMemory(DeltaMemory *deltaMemory, unsigned int growingIndex,
 
   AbsTime startTime = currentTime(CLOCK_MONOTONIC);
 
+  // Moving nearby lists is usually enough, and is much cheaper than moving
+  // every list in the zone. When no list is growing, balance them all.
+  if (doCopy && (growingSize > 0)
+      && rebalanceNearbyDeltaLists(deltaMemory, growingIndex, growingSize)) {
+    deltaMemory->localRebalanceCount++;
+    noteRebalanceTime(deltaMemory, startTime);
+    return UDS_SUCCESS;
+  }
+
   // Calculate the amount of space that is in use.  Include the space that
   // has a planned use.
   DeltaList *deltaLists = deltaMemory->deltaLists;
@@ -614,9 +854,7 @@ int extendDeltaMemory(DeltaMemory *deltaMemory, unsigned int growingIndex,
   // copied.
   if (doCopy) {
     rebalanceDeltaMemory(deltaMemory, 1, deltaMemory->numLists + 1);
-    AbsTime endTime = currentTime(CLOCK_MONOTONIC);
-    deltaMemory->rebalanceCount++;
-    deltaMemory->rebalanceTime += timeDifference(endTime, startTime);
+    noteRebalanceTime(deltaMemory, startTime);
   } else {
     for (i = 1; i <= deltaMemory->numLists + 1; i++) {
       deltaLists[i].startOffset = deltaMemory->tempOffsets[i];
@@ -625,6 +863,58 @@ int extendDeltaMemory(DeltaMemory *deltaMemory, unsigned int growingIndex,
   return UDS_SUCCESS;
 }
 
+/**********************************************************************/
+int resizeDeltaMemory(DeltaMemory *deltaMemory, size_t size)
+{
+  if (!isMutable(deltaMemory) || !areDeltaMemoryTransfersDone(deltaMemory)) {
+    return logErrorWithStringError(UDS_BAD_STATE,
+                                   "Attempt to resize a delta list memory"
+                                   " which is in use");
+  }
+
+  // Calculate the amount of space that is in use, including the end guard.
+  DeltaList *deltaLists = deltaMemory->deltaLists;
+  size_t usedSpace = POST_FIELD_GUARD_BYTES;
+  unsigned int i;
+  for (i = 0; i <= deltaMemory->numLists; i++) {
+    usedSpace += getDeltaListByteSize(&deltaLists[i]);
+  }
+  if (size < usedSpace) {
+    return UDS_OVERFLOW;
+  }
+
+  byte *memory = NULL;
+  int result = allocateHugeMemory(size, "delta list", &memory);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  // Copy each list to its new position, keeping its bit alignment.  The
+  // head guard list is empty, so it needs no space.
+  size_t spacing = (size - usedSpace) / deltaMemory->numLists;
+  uint64_t byteStart = spacing / 2;
+  for (i = 1; i <= deltaMemory->numLists; i++) {
+    DeltaList *deltaList = &deltaLists[i];
+    uint16_t byteSize = getDeltaListByteSize(deltaList);
+    memcpy(memory + byteStart,
+           deltaMemory->memory + getDeltaListByteStart(deltaList), byteSize);
+    deltaList->startOffset = (byteStart * CHAR_BIT
+                              + getDeltaListStart(deltaList) % CHAR_BIT);
+    byteStart += byteSize + spacing;
+  }
+
+  FREE(deltaMemory->memory);
+  deltaMemory->memory = memory;
+  deltaMemory->size   = size;
+
+  // The end guard list moves to the new end of the memory.
+  DeltaList *guardList = &deltaLists[deltaMemory->numLists + 1];
+  guardList->startOffset = (uint64_t) size * CHAR_BIT - GUARD_BITS;
+  memset(memory + size - POST_FIELD_GUARD_BYTES, ~0, POST_FIELD_GUARD_BYTES);
+  deltaMemory->rebalanceCount++;
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 int validateDeltaLists(const DeltaMemory *deltaMemory)
 {
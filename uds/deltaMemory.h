@@ -57,10 +57,13 @@ typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) deltaMemory {
   DeltaList *deltaLists;          // The delta list headers
   uint64_t *tempOffsets;          // Temporary starts of delta lists
   byte *flags;                    // Transfer flags
+  byte *dirtyFlags;               // Lists changed since the last save began
   BufferedWriter *bufferedWriter; // Buffered writer for saving an index
   size_t size;                 // The size of delta list memory
   RelTime rebalanceTime;       // The time spent rebalancing
+  RelTime maxRebalanceTime;    // The longest time spent on one rebalance
   int rebalanceCount;          // Number of memory rebalances
+  int localRebalanceCount;     // Number of rebalances of only nearby lists
   unsigned short valueBits;    // The number of bits of value
   unsigned short minBits;      // The number of bits in the minimal key code
   unsigned int minKeys;        // The number of keys used in a minimal code
@@ -72,6 +75,7 @@ typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) deltaMemory {
   unsigned int firstList;      // The index of the first delta list
   unsigned int numLists;       // The number of delta lists
   unsigned int numTransfers;   // Number of transfer flags that are set
+  unsigned int numDirtyLists;  // Number of dirty flags that are set
   int transferStatus;          // Status of the transfers in progress
   byte tag;                    // Tag belonging to this delta index
 } DeltaMemory;
@@ -83,6 +87,14 @@ typedef struct deltaListSaveInfo {
   uint32_t index;      // The delta list number within the delta index
 } DeltaListSaveInfo;
 
+// The delta list number of the DeltaListSaveInfo which introduces an image
+// of every delta list in a zone which was not saved individually.  The image
+// consists of the first delta list number and the number of lists it covers
+// (each a 32 bit little-endian value), the bit offset of each of those lists
+// (one byte each), and then the bytes of each list which was not saved
+// individually, in list order.
+#define DELTA_LIST_IMAGE_INDEX UINT32_MAX
+
 // The maximum size of a single delta list (in bytes).  We add guard bytes
 // to this because such a buffer can be used with moveBits.
 enum { DELTA_LIST_MAX_BYTE_COUNT = ((UINT16_MAX + CHAR_BIT) / CHAR_BIT
@@ -182,6 +194,36 @@ int restoreDeltaList(DeltaMemory *deltaMemory, const DeltaListSaveInfo *dlsi,
                      const byte data[DELTA_LIST_MAX_BYTE_COUNT])
   __attribute__((warn_unused_result));
 
+/**
+ * Check whether the delta lists of a delta memory can be restored from an
+ * image with a single read, which is possible if none of the lists has been
+ * restored yet and the image fits in the memory.
+ *
+ * @param deltaMemory  A delta memory structure
+ * @param bitOffsets   The saved bit offset of each delta list
+ *
+ * @return true if restoreDeltaMemoryImage() can be used
+ **/
+bool canRestoreDeltaMemoryImage(const DeltaMemory *deltaMemory,
+                                const byte        *bitOffsets)
+  __attribute__((warn_unused_result));
+
+/**
+ * Restore all the delta lists of a delta memory from an image, reading the
+ * image directly into the delta list memory and then spreading the lists
+ * out.
+ *
+ * @param deltaMemory     A delta memory structure
+ * @param bitOffsets      The saved bit offset of each delta list
+ * @param bufferedReader  The buffered reader positioned at the list data
+ *
+ * @return error code or UDS_SUCCESS
+ **/
+int restoreDeltaMemoryImage(DeltaMemory    *deltaMemory,
+                            const byte     *bitOffsets,
+                            BufferedReader *bufferedReader)
+  __attribute__((warn_unused_result));
+
 /**
  * Abort restoring delta list memory from an input stream.
  *
@@ -190,7 +232,9 @@ int restoreDeltaList(DeltaMemory *deltaMemory, const DeltaListSaveInfo *dlsi,
 void abortRestoringDeltaMemory(DeltaMemory *deltaMemory);
 
 /**
- * Start saving delta list memory to a buffered output stream
+ * Start saving delta list memory to a buffered output stream. The count of
+ * delta lists changed since the previous save began is logged and reset, so
+ * that the share of each save which actually changed can be measured.
  *
  * @param deltaMemory     A delta memory structure
  * @param bufferedWriter  The index state component being written
@@ -200,8 +244,9 @@ void startSavingDeltaMemory(DeltaMemory *deltaMemory,
 
 /**
  * Finish saving delta list memory to an output stream.  Force the writing
- * of all of the remaining data.  If an error occurred asynchronously
- * during the save operation, it will be returned here.
+ * of all of the remaining data, as a single image of the lists which have
+ * not been written yet.  If an error occurred asynchronously during the
+ * save operation, it will be returned here.
  *
  * @param deltaMemory  A delta memory structure
  *
@@ -270,6 +315,20 @@ int extendDeltaMemory(DeltaMemory *deltaMemory, unsigned int growingIndex,
 int validateDeltaLists(const DeltaMemory *deltaMemory)
   __attribute__((warn_unused_result));
 
+/**
+ * Move the delta lists into a newly allocated memory array of a different
+ * size, spacing them out evenly, and free the old array.  This must not be
+ * done while the delta memory is being saved or restored.
+ *
+ * @param deltaMemory  A delta memory structure
+ * @param size         The size of the new memory array
+ *
+ * @return UDS_SUCCESS, UDS_OVERFLOW if the lists do not fit in the new
+ *         size, or another error code
+ **/
+int resizeDeltaMemory(DeltaMemory *deltaMemory, size_t size)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the number of bytes allocated for delta index entries and any
  * associated overhead.
@@ -354,6 +413,21 @@ static INLINE bool isMutable(const DeltaMemory *deltaMemory)
   return deltaMemory->deltaLists != NULL;
 }
 
+/**
+ * Is a delta list still waiting to be transferred by the save or restore in
+ * progress?
+ *
+ * @param deltaMemory  A delta memory structure
+ * @param listNumber   Index of the delta list within the delta memory
+ *
+ * @return true if the delta list has not been transferred yet
+ **/
+static INLINE bool isDeltaListTransferPending(const DeltaMemory *deltaMemory,
+                                              unsigned int listNumber)
+{
+  return getField(deltaMemory->flags, listNumber, 1) != 0;
+}
+
 /**
  * Lazily flush a delta list to an output stream
  *
@@ -367,4 +441,20 @@ static INLINE void lazyFlushDeltaList(DeltaMemory *deltaMemory,
     flushDeltaList(deltaMemory, flushIndex);
   }
 }
+
+/**
+ * Note that a delta list has been changed since the last save of its delta
+ * memory began.
+ *
+ * @param deltaMemory  A delta memory structure
+ * @param listNumber   Index of the delta list which changed
+ **/
+static INLINE void markDeltaListDirty(DeltaMemory  *deltaMemory,
+                                      unsigned int  listNumber)
+{
+  if (getField(deltaMemory->dirtyFlags, listNumber, 1) == 0) {
+    setOne(deltaMemory->dirtyFlags, listNumber, 1);
+    deltaMemory->numDirtyLists++;
+  }
+}
 #endif /* DELTAMEMORY_H */
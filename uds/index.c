@@ -25,9 +25,65 @@
 #include "indexCheckpoint.h"
 #include "indexInternals.h"
 #include "logger.h"
+#include "memoryAlloc.h"
+#include "zone.h"
 
 static const uint64_t NO_LAST_CHECKPOINT = UINT_MAX;
 
+enum {
+  /** The number of chapters to read ahead of the chapter being replayed */
+  REPLAY_READ_AHEAD_CHAPTERS = 4,
+};
+
+typedef struct replayContext ReplayContext;
+
+/**
+ * A thread which replays the names of one master index zone.
+ **/
+typedef struct replayThread {
+  ReplayContext *context;
+  unsigned int   zone;
+  Thread         thread;
+  bool           started;
+} ReplayThread;
+
+/**
+ * The state shared by the threads replaying the volume. The names from the
+ * record pages of each chapter are grouped by master index zone, and the
+ * names of each zone are replayed by a thread for that zone, since the
+ * zones of the master index can be updated concurrently.
+ **/
+struct replayContext {
+  Index         *index;
+  /** Serializes the rebuild searches of the volume page cache */
+  Mutex          searchMutex;
+  /** Covers the fields used to hand chapters to the threads */
+  Mutex          mutex;
+  CondVar        cond;
+  /** Incremented each time a chapter is handed to the threads */
+  uint64_t       generation;
+  /** The number of threads still replaying the current chapter */
+  unsigned int   busyThreads;
+  /** Set to tell the threads to exit */
+  bool           finished;
+  /** The chapter being replayed */
+  uint64_t       virtualChapter;
+  /** Whether the chapter will be sparse once the replay is done */
+  bool           willBeSparse;
+  /** The names of the chapter, in record page order */
+  UdsChunkName  *pageNames;
+  /** The master index zone of each name in pageNames */
+  byte          *pageZones;
+  /** The names of the chapter, grouped by zone */
+  UdsChunkName  *names;
+  /** The start of each zone's names, followed by the end of the last */
+  unsigned int   zoneStarts[MAX_ZONES + 1];
+  /** The result of replaying each zone */
+  int            results[MAX_ZONES];
+  /** The replay threads, of which the first is unused */
+  ReplayThread   threads[MAX_ZONES];
+};
+
 
 /**
  * Replay an index which was loaded from a checkpoint.
@@ -90,15 +146,25 @@ static int loadIndex(Index *index, bool allowReplay)
 
   int result = loadIndexState(index->state, &replayRequired);
   if (result != UDS_SUCCESS) {
+    abandonMasterIndexRestore(index->masterIndex);
     return result;
   }
 
   if (replayRequired && !allowReplay) {
+    abandonMasterIndexRestore(index->masterIndex);
     return logErrorWithStringError(
       UDS_INDEX_NOT_SAVED_CLEANLY,
       "index not saved cleanly: open chapter missing");
   }
 
+  if (replayRequired) {
+    // Replay needs the whole master index, so don't restore it lazily.
+    result = finishRestoringMasterIndex(index->masterIndex);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+
   uint64_t lastCheckpointChapter
     = ((index->lastCheckpoint != NO_LAST_CHECKPOINT)
        ? index->lastCheckpoint : 0);
@@ -208,6 +274,15 @@ int makeIndex(IndexLayout                  *layout,
     return logErrorWithStringError(result, "could not make master index");
   }
 
+  if ((userParams != NULL) && userParams->lazy_load) {
+    setMasterIndexIncrementalRestore(index->masterIndex, zoneCount);
+  }
+  if ((userParams != NULL) && (userParams->master_index_budget_mb > 0)) {
+    setMasterIndexMemoryBudget(index->masterIndex,
+                               (size_t) userParams->master_index_budget_mb
+                               << 20);
+  }
+
   result = addIndexStateComponent(index->state, MASTER_INDEX_INFO, NULL,
                                   index->masterIndex);
   if (result != UDS_SUCCESS) {
@@ -290,11 +365,50 @@ void freeIndex(Index *index)
   releaseIndex(index);
 }
 
+/**
+ * Check whether the last save of an index still matches the index, so
+ * that saving it again would write exactly what is already on storage. The
+ * index must be quiescent.
+ *
+ * @param index  The index
+ *
+ * @return true if no request has changed the index since it was saved
+ **/
+static bool isIndexSaveCurrent(Index *index)
+{
+  if (!index->hasSavedOpenChapter) {
+    return false;
+  }
+
+  unsigned int z;
+  for (z = 0; z < index->zoneCount; z++) {
+    if (index->zones[z]->changedSinceSave) {
+      return false;
+    }
+  }
+  return true;
+}
+
 /**********************************************************************/
 int saveIndex(Index *index)
 {
   waitForIdleChapterWriter(index->chapterWriter);
-  int result = finishCheckpointing(index);
+  if (isIndexSaveCurrent(index)) {
+    // Repeated suspends of an idle index needn't rewrite the same save.
+    logInfo("index unchanged since save (vcn %" PRIu64 ")",
+            index->lastCheckpoint);
+    return UDS_SUCCESS;
+  }
+
+  // Every delta list must be in memory before the master index is saved.
+  int result = finishRestoringMasterIndex(index->masterIndex);
+  if (result != UDS_SUCCESS) {
+    logInfo("save index failed");
+    return result;
+  }
+  // A checkpoint in progress would only write out part of what the save
+  // is about to write, so don't spend time finishing it.
+  result = cancelCheckpointing(index);
   if (result != UDS_SUCCESS) {
     logInfo("save index failed");
     return result;
@@ -307,6 +421,10 @@ int saveIndex(Index *index)
     index->lastCheckpoint = index->prevCheckpoint;
   } else {
     index->hasSavedOpenChapter = true;
+    unsigned int z;
+    for (z = 0; z < index->zoneCount; z++) {
+      index->zones[z]->changedSinceSave = false;
+    }
     logInfo("finished save (vcn %" PRIu64 ")", index->lastCheckpoint);
   }
   return result;
@@ -471,6 +589,7 @@ static int removeFromIndexZone(IndexZone *zone, Request *request)
    * later search might later return stale advice if there is a colliding name
    * in the same chapter, but it's a very rare case (1 in 2^21).
    */
+  zone->changedSinceSave = true;
   result = removeMasterIndexRecord(&record);
   if (result != UDS_SUCCESS) {
     return result;
@@ -544,6 +663,13 @@ static int dispatchIndexZoneRequest(IndexZone *zone, Request *request)
   // Set the default location. It will be overwritten if we find the chunk.
   request->location = LOC_UNAVAILABLE;
 
+  if (!isMasterIndexNameAvailable(zone->index->masterIndex,
+                                  &request->chunkName)) {
+    // The master index entries for this name have not been restored yet, so
+    // there is no advice to give and nothing may be changed.
+    return UDS_SUCCESS;
+  }
+
   int result;
   switch (request->action) {
   case REQUEST_INDEX:
@@ -616,6 +742,7 @@ static int rebuildIndexPageMap(Index *index, uint64_t vcn)
  * Add an entry to the master index when rebuilding.
  *
  * @param index                The index to query.
+ * @param searchMutex          The mutex serializing volume searches
  * @param name                 The block name of interest.
  * @param virtualChapter       The virtual chapter number to write to the
  *                             master index
@@ -625,6 +752,7 @@ static int rebuildIndexPageMap(Index *index, uint64_t vcn)
  * @return UDS_SUCCESS or an error code
  **/
 static int replayRecord(Index              *index,
+                        Mutex              *searchMutex,
                         const UdsChunkName *name,
                         uint64_t            virtualChapter,
                         bool                willBeSparseChapter)
@@ -668,9 +796,11 @@ static int replayRecord(Index              *index,
        * In this case, we need to search that chapter to determine if the
        * master index entry was for the same record or a different one.
        */
+      lockMutex(searchMutex);
       result = searchVolumePageCache(index->volume, NULL, name,
                                      record.virtualChapter, NULL,
                                      &updateRecord);
+      unlockMutex(searchMutex);
       if (result != UDS_SUCCESS) {
         return result;
       }
@@ -750,6 +880,296 @@ static bool checkForSuspend(Index *index)
   return retVal;
 }
 
+/**
+ * Replay the names of one master index zone for the current chapter.
+ *
+ * @param context  The replay context
+ * @param zone     The zone to replay
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int replayZoneNames(ReplayContext *context, unsigned int zone)
+{
+  unsigned int i;
+  for (i = context->zoneStarts[zone]; i < context->zoneStarts[zone + 1];
+       i++) {
+    const UdsChunkName *name = &context->names[i];
+    int result = replayRecord(context->index, &context->searchMutex, name,
+                              context->virtualChapter, context->willBeSparse);
+    if (result != UDS_SUCCESS) {
+      char hexName[(2 * UDS_CHUNK_NAME_SIZE) + 1];
+      if (chunkNameToHex(name, hexName, sizeof(hexName)) != UDS_SUCCESS) {
+        strncpy(hexName, "<unknown>", sizeof(hexName));
+      }
+      return logUnrecoverable(result,
+                              "could not find block %s during rebuild",
+                              hexName);
+    }
+  }
+  return UDS_SUCCESS;
+}
+
+/**
+ * Thread function to replay one zone of each chapter handed to it.
+ *
+ * @param arg  The ReplayThread for the zone
+ **/
+static void replayThread(void *arg)
+{
+  ReplayThread  *thread     = arg;
+  ReplayContext *context    = thread->context;
+  uint64_t       generation = 0;
+
+  lockMutex(&context->mutex);
+  for (;;) {
+    while (!context->finished && (context->generation == generation)) {
+      waitCond(&context->cond, &context->mutex);
+    }
+    if (context->finished) {
+      break;
+    }
+
+    generation = context->generation;
+    unlockMutex(&context->mutex);
+    context->results[thread->zone] = replayZoneNames(context, thread->zone);
+    lockMutex(&context->mutex);
+    if (--context->busyThreads == 0) {
+      broadcastCond(&context->cond);
+    }
+  }
+  unlockMutex(&context->mutex);
+}
+
+/**
+ * Stop the replay threads and free a replay context.
+ *
+ * @param context  The replay context to free
+ **/
+static void freeReplayContext(ReplayContext *context)
+{
+  lockMutex(&context->mutex);
+  context->finished = true;
+  broadcastCond(&context->cond);
+  unlockMutex(&context->mutex);
+
+  unsigned int z;
+  for (z = 1; z < context->index->zoneCount; z++) {
+    if (context->threads[z].started) {
+      joinThreads(context->threads[z].thread);
+    }
+  }
+
+  destroyCond(&context->cond);
+  destroyMutex(&context->mutex);
+  destroyMutex(&context->searchMutex);
+  FREE(context->names);
+  FREE(context->pageZones);
+  FREE(context->pageNames);
+  FREE(context);
+}
+
+/**
+ * Make a replay context and start a replay thread for each zone but the
+ * first, which is replayed by the calling thread. Any zone whose thread
+ * can't be started is also replayed by the calling thread.
+ *
+ * @param [in]  index       The index being replayed
+ * @param [out] contextPtr  A pointer to hold the new context
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int makeReplayContext(Index *index, ReplayContext **contextPtr)
+{
+  unsigned int recordsPerChapter = index->volume->geometry->recordsPerChapter;
+  ReplayContext *context;
+  int result = ALLOCATE(1, ReplayContext, "replay context", &context);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  context->index = index;
+  result = initMutex(&context->searchMutex);
+  if (result != UDS_SUCCESS) {
+    FREE(context);
+    return result;
+  }
+  result = initMutex(&context->mutex);
+  if (result != UDS_SUCCESS) {
+    destroyMutex(&context->searchMutex);
+    FREE(context);
+    return result;
+  }
+  result = initCond(&context->cond);
+  if (result != UDS_SUCCESS) {
+    destroyMutex(&context->mutex);
+    destroyMutex(&context->searchMutex);
+    FREE(context);
+    return result;
+  }
+
+  result = ALLOCATE(recordsPerChapter, UdsChunkName, "replay page names",
+                    &context->pageNames);
+  if (result == UDS_SUCCESS) {
+    result = ALLOCATE(recordsPerChapter, byte, "replay page zones",
+                      &context->pageZones);
+  }
+  if (result == UDS_SUCCESS) {
+    result = ALLOCATE(recordsPerChapter, UdsChunkName, "replay names",
+                      &context->names);
+  }
+  if (result != UDS_SUCCESS) {
+    freeReplayContext(context);
+    return result;
+  }
+
+  unsigned int z;
+  for (z = 1; z < index->zoneCount; z++) {
+    ReplayThread *thread = &context->threads[z];
+    thread->context = context;
+    thread->zone    = z;
+    thread->started = (createThread(replayThread, thread, "replayW",
+                                    &thread->thread) == UDS_SUCCESS);
+  }
+
+  *contextPtr = context;
+  return UDS_SUCCESS;
+}
+
+/**
+ * Read the record pages of a chapter and group their names by master index
+ * zone. The names of a chapter which will be sparse are only kept if they
+ * are samples.
+ *
+ * @param context  The replay context
+ * @param chapter  The physical chapter number
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int gatherChapterNames(ReplayContext *context, unsigned int chapter)
+{
+  Index          *index    = context->index;
+  const Geometry *geometry = index->volume->geometry;
+  unsigned int    counts[MAX_ZONES];
+  unsigned int    count    = 0;
+  memset(counts, 0, sizeof(counts));
+
+  unsigned int j;
+  for (j = 0; j < geometry->recordPagesPerChapter; j++) {
+    unsigned int recordPageNumber = geometry->indexPagesPerChapter + j;
+    byte *recordPage;
+    int result = getPage(index->volume, chapter, recordPageNumber,
+                         CACHE_PROBE_RECORD_FIRST, &recordPage, NULL);
+    if (result != UDS_SUCCESS) {
+      return logUnrecoverable(result, "could not get page %d",
+                              recordPageNumber);
+    }
+    unsigned int k;
+    for (k = 0; k < geometry->recordsPerPage; k++) {
+      UdsChunkName *name = &context->pageNames[count];
+      memcpy(&name->name, recordPage + (k * BYTES_PER_RECORD),
+             UDS_CHUNK_NAME_SIZE);
+      if (context->willBeSparse
+          && !isMasterIndexSample(index->masterIndex, name)) {
+        // This entry will be in a sparse chapter after the rebuild
+        // completes, and it is not a sample, so just skip over it.
+        continue;
+      }
+      unsigned int zone = getMasterIndexZone(index->masterIndex, name);
+      context->pageZones[count++] = zone;
+      counts[zone]++;
+    }
+  }
+
+  // Group the names by zone, keeping their order within each zone.
+  unsigned int z;
+  context->zoneStarts[0] = 0;
+  for (z = 0; z < index->zoneCount; z++) {
+    context->zoneStarts[z + 1] = context->zoneStarts[z] + counts[z];
+    counts[z] = context->zoneStarts[z];
+  }
+  unsigned int i;
+  for (i = 0; i < count; i++) {
+    context->names[counts[context->pageZones[i]]++] = context->pageNames[i];
+  }
+  return UDS_SUCCESS;
+}
+
+/**
+ * Replay the gathered names of a chapter, one zone per thread.
+ *
+ * @param context  The replay context
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int replayChapterNames(ReplayContext *context)
+{
+  unsigned int zoneCount = context->index->zoneCount;
+  unsigned int z;
+  lockMutex(&context->mutex);
+  context->busyThreads = 0;
+  for (z = 1; z < zoneCount; z++) {
+    if (context->threads[z].started) {
+      context->busyThreads++;
+    }
+  }
+  context->generation++;
+  broadcastCond(&context->cond);
+  unlockMutex(&context->mutex);
+
+  for (z = 0; z < zoneCount; z++) {
+    if ((z == 0) || !context->threads[z].started) {
+      context->results[z] = replayZoneNames(context, z);
+    }
+  }
+
+  lockMutex(&context->mutex);
+  while (context->busyThreads > 0) {
+    waitCond(&context->cond, &context->mutex);
+  }
+  unlockMutex(&context->mutex);
+
+  for (z = 0; z < zoneCount; z++) {
+    if (context->results[z] != UDS_SUCCESS) {
+      return context->results[z];
+    }
+  }
+  return UDS_SUCCESS;
+}
+
+/**
+ * Record the progress of a volume replay for the load context.
+ *
+ * @param index     The index being replayed
+ * @param replayed  The number of chapters replayed so far
+ * @param total     The number of chapters to replay
+ **/
+static void noteReplayProgress(Index *index, uint64_t replayed, uint64_t total)
+{
+  if (index->loadContext == NULL) {
+    return;
+  }
+
+  lockMutex(&index->loadContext->mutex);
+  index->loadContext->chaptersReplayed = replayed;
+  index->loadContext->chaptersToReplay = total;
+  unlockMutex(&index->loadContext->mutex);
+}
+
+/**
+ * Prefetch the pages of a chapter of the volume.
+ *
+ * @param index  The index
+ * @param vcn    The virtual chapter number of the chapter to prefetch
+ **/
+static void prefetchChapter(Index *index, uint64_t vcn)
+{
+  const Geometry *geometry = index->volume->geometry;
+  unsigned int chapter = mapToPhysicalChapter(geometry, vcn);
+  prefetchVolumePages(&index->volume->volumeStore,
+                      mapToPhysicalPage(geometry, chapter, 0),
+                      geometry->pagesPerChapter);
+}
+
 /**********************************************************************/
 int replayVolume(Index *index, uint64_t fromVCN)
 {
@@ -761,6 +1181,12 @@ int replayVolume(Index *index, uint64_t fromVCN)
   setMasterIndexOpenChapter(index->masterIndex, uptoVCN);
   setMasterIndexOpenChapter(index->masterIndex, fromVCN);
 
+  ReplayContext *context;
+  result = makeReplayContext(index, &context);
+  if (result != UDS_SUCCESS) {
+    return logErrorWithStringError(result, "cannot start volume replay");
+  }
+
   /*
    * At least two cases to deal with here!
    * - index loaded but replaying from lastCheckpoint; maybe full, maybe not
@@ -779,65 +1205,59 @@ int replayVolume(Index *index, uint64_t fromVCN)
    *
    * Also, go through each index page for each chapter and rebuild the
    * index page map.
+   *
+   * The reads of the next few chapters are issued ahead of time, and the
+   * names of each chapter are replayed by a thread per master index zone.
    */
   const Geometry *geometry = index->volume->geometry;
   uint64_t oldIPMupdate = getLastUpdate(index->volume->indexPageMap);
   uint64_t vcn;
+  for (vcn = fromVCN;
+       (vcn < uptoVCN) && (vcn < fromVCN + REPLAY_READ_AHEAD_CHAPTERS);
+       ++vcn) {
+    prefetchChapter(index, vcn);
+  }
   for (vcn = fromVCN; vcn < uptoVCN; ++vcn) {
     if (checkForSuspend(index)) {
       logInfo("Replay interrupted by index shutdown at chapter %" PRIu64, vcn);
-      return UDS_SHUTTINGDOWN;
+      result = UDS_SHUTTINGDOWN;
+      break;
+    }
+
+    noteReplayProgress(index, vcn - fromVCN, uptoVCN - fromVCN);
+    if (vcn + REPLAY_READ_AHEAD_CHAPTERS < uptoVCN) {
+      prefetchChapter(index, vcn + REPLAY_READ_AHEAD_CHAPTERS);
     }
 
-    bool willBeSparseChapter = isChapterSparse(geometry, fromVCN, uptoVCN,
-                                               vcn);
+    context->virtualChapter = vcn;
+    context->willBeSparse   = isChapterSparse(geometry, fromVCN, uptoVCN, vcn);
     unsigned int chapter = mapToPhysicalChapter(geometry, vcn);
-    prefetchVolumePages(&index->volume->volumeStore,
-                        mapToPhysicalPage(geometry, chapter, 0),
-                        geometry->pagesPerChapter);
     setMasterIndexOpenChapter(index->masterIndex, vcn);
     result = rebuildIndexPageMap(index, vcn);
     if (result != UDS_SUCCESS) {
-      index->volume->lookupMode = oldLookupMode;
-      return logErrorWithStringError(result,
-                                     "could not rebuild index page map for"
-                                     " chapter %u",
-                                     chapter);
+      logErrorWithStringError(result,
+                              "could not rebuild index page map for"
+                              " chapter %u",
+                              chapter);
+      break;
     }
 
-    unsigned int j;
-    for (j = 0; j < geometry->recordPagesPerChapter; j++) {
-      unsigned int recordPageNumber = geometry->indexPagesPerChapter + j;
-      byte *recordPage;
-      result = getPage(index->volume, chapter, recordPageNumber,
-                       CACHE_PROBE_RECORD_FIRST, &recordPage, NULL);
-      if (result != UDS_SUCCESS) {
-        index->volume->lookupMode = oldLookupMode;
-        return logUnrecoverable(result, "could not get page %d",
-                                recordPageNumber);
-      }
-      unsigned int k;
-      for (k = 0; k < geometry->recordsPerPage; k++) {
-        const byte *nameBytes = recordPage + (k * BYTES_PER_RECORD);
-
-        UdsChunkName name;
-        memcpy(&name.name, nameBytes, UDS_CHUNK_NAME_SIZE);
+    result = gatherChapterNames(context, chapter);
+    if (result != UDS_SUCCESS) {
+      break;
+    }
 
-        result = replayRecord(index, &name, vcn, willBeSparseChapter);
-        if (result != UDS_SUCCESS) {
-          char hexName[(2 * UDS_CHUNK_NAME_SIZE) + 1];
-          if (chunkNameToHex(&name, hexName, sizeof(hexName)) != UDS_SUCCESS) {
-            strncpy(hexName, "<unknown>", sizeof(hexName));
-          }
-          index->volume->lookupMode = oldLookupMode;
-          return logUnrecoverable(result,
-                                  "could not find block %s during rebuild",
-                                  hexName);
-        }
-      }
+    result = replayChapterNames(context);
+    if (result != UDS_SUCCESS) {
+      break;
     }
   }
   index->volume->lookupMode = oldLookupMode;
+  freeReplayContext(context);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  noteReplayProgress(index, uptoVCN - fromVCN, uptoVCN - fromVCN);
 
   // We also need to reap the chapter being replaced by the open chapter
   setMasterIndexOpenChapter(index->masterIndex, uptoVCN);
@@ -872,6 +1292,25 @@ void getIndexStats(Index *index, UdsIndexStats *counters)
   counters->entriesDiscarded = (denseStats.discardCount
                                 + sparseStats.discardCount);
   counters->checkpoints      = getCheckpointCount(index->checkpoint);
+
+  counters->pageCacheBytes = ((uint64_t) index->volume->pageCache->activeEntries
+                              * index->volume->geometry->bytesPerPage);
+  const CacheCountsByPageType *firstTime
+    = &index->volume->pageCache->counters.firstTime;
+  counters->pageCacheHits   = (READ_ONCE(firstTime->indexPage.hits)
+                               + READ_ONCE(firstTime->recordPage.hits));
+  counters->pageCacheMisses = (READ_ONCE(firstTime->indexPage.misses)
+                               + READ_ONCE(firstTime->indexPage.queued)
+                               + READ_ONCE(firstTime->recordPage.misses)
+                               + READ_ONCE(firstTime->recordPage.queued));
+  counters->pageCacheReclaimedBytes = READ_ONCE(index->volume->reclaimedBytes);
+  counters->sparseCacheEvictions  = 0;
+  counters->sparseCacheRetentions = 0;
+  if (index->volume->sparseCache != NULL) {
+    getSparseCacheStats(index->volume->sparseCache,
+                        &counters->sparseCacheEvictions,
+                        &counters->sparseCacheRetentions);
+  }
 }
 
 /**********************************************************************/
@@ -888,6 +1327,10 @@ void advanceActiveChapters(Index *index)
 /**********************************************************************/
 uint64_t triageIndexRequest(Index *index, Request *request)
 {
+  if (!isMasterIndexNameAvailable(index->masterIndex, &request->chunkName)) {
+    return UINT64_MAX;
+  }
+
   MasterIndexTriage triage;
   lookupMasterIndexName(index->masterIndex, &request->chunkName, &triage);
   if (!triage.inSampledChapter) {
@@ -900,6 +1343,13 @@ uint64_t triageIndexRequest(Index *index, Request *request)
     return UINT64_MAX;
   }
 
+  // A sample which is not a hook at the chapter's hook level is looked up
+  // through the volume page cache instead of loading the chapter.
+  if (!isSparseCacheHook(index->volume->sparseCache, &request->chunkName,
+                         triage.virtualChapter)) {
+    return UINT64_MAX;
+  }
+
   // XXX Optimize for a common case by remembering the chapter from the most
   // recent barrier message and skipping this chapter if is it the same.
 
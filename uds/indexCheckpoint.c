@@ -175,6 +175,11 @@ int processCheckpointing(Index        *index,
   IndexCheckpointTriggerValue ictv
     = getCheckpointAction(checkpoint, newVirtualChapter);
 
+  if ((ictv == ICTV_START) && isMasterIndexRestoring(index->masterIndex)) {
+    // A checkpoint can't save delta lists which are still being restored.
+    ictv = ICTV_IDLE;
+  }
+
   if (ictv == ICTV_START) {
     checkpoint->chapter = newVirtualChapter;
   }
@@ -267,6 +272,44 @@ int finishCheckpointing(Index *index)
   return result;
 }
 
+/**********************************************************************/
+int cancelCheckpointing(Index *index)
+{
+  IndexCheckpoint *checkpoint = index->checkpoint;
+  lockMutex(&checkpoint->mutex);
+  if (checkpoint->state == NOT_CHECKPOINTING) {
+    unlockMutex(&checkpoint->mutex);
+    return UDS_SUCCESS;
+  }
+
+  if (checkpoint->state == CHECKPOINT_IN_PROGRESS) {
+    logInfo("abandoning checkpoint for save");
+    index->lastCheckpoint = index->prevCheckpoint;
+  }
+
+  // The zones are idle, so abort their parts of the checkpoint directly
+  // rather than waiting for each of them to notice.
+  int result = UDS_SUCCESS;
+  unsigned int z;
+  for (z = 0; z < index->zoneCount; ++z) {
+    int zoneResult = abortIndexStateCheckpointInZone(index->state, z, NULL);
+    if (result == UDS_SUCCESS) {
+      result = zoneResult;
+    }
+  }
+
+  if (index->state->saving) {
+    int abortResult = abortIndexStateCheckpoint(index->state);
+    if (result == UDS_SUCCESS) {
+      result = abortResult;
+    }
+  }
+
+  checkpoint->state = NOT_CHECKPOINTING;
+  unlockMutex(&checkpoint->mutex);
+  return result;
+}
+
 /**
  * Starts an incremental checkpoint.
  *
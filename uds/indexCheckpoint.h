@@ -86,6 +86,16 @@ uint64_t getCheckpointCount(IndexCheckpoint *checkpoint)
  **/
 int finishCheckpointing(Index *index) __attribute__((warn_unused_result));
 
+/**
+ * If incremental checkpointing is in progress, abandon it. This is used
+ * before a full save, which writes everything the checkpoint would have.
+ *
+ * @param index     The index, whose zones must not be processing requests
+ *
+ * @return          UDS_SUCCESS or an error code
+ **/
+int cancelCheckpointing(Index *index) __attribute__((warn_unused_result));
+
 /**
  * Process one zone's incremental checkpoint operation. Automatically
  * starts, processes, and finishes a checkpoint over multiple invocations
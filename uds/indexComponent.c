@@ -28,8 +28,22 @@
 #include "logger.h"
 #include "memoryAlloc.h"
 #include "permassert.h"
+#include "threads.h"
 #include "typeDefs.h"
 
+/**
+ * The work of writing one zone of a multi-zone component. The zones of a
+ * full save are written concurrently, one thread per zone.
+ **/
+typedef struct zoneWrite {
+  IndexComponent *component;
+  Saver           saver;
+  unsigned int    zone;
+  Thread          thread;
+  bool            started;
+  int             result;
+} ZoneWrite;
+
 /*****************************************************************************/
 int makeIndexComponent(IndexState                *state,
                        const IndexComponentInfo  *info,
@@ -150,6 +164,19 @@ int getBufferedReaderForPortal(ReadPortal      *portal,
   return UDS_SUCCESS;
 }
 
+/*****************************************************************************/
+int takeBufferedReaderFromPortal(ReadPortal      *portal,
+                                 unsigned int     part,
+                                 BufferedReader **readerPtr)
+{
+  int result = getBufferedReaderForPortal(portal, part, readerPtr);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  portal->readers[part] = NULL;
+  return UDS_SUCCESS;
+}
+
 /*****************************************************************************/
 int readIndexComponent(IndexComponent *component)
 {
@@ -365,35 +392,119 @@ int startIndexComponentIncrementalSave(IndexComponent *component)
   return startIndexComponentSave(component);
 }
 
-/*****************************************************************************/
-int writeIndexComponent(IndexComponent *component)
+/**
+ * Write one zone of an index component and release its writer.
+ *
+ * @param component  the index component
+ * @param saver      the function which writes the component data
+ * @param zone       the zone number
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int writeIndexComponentZone(IndexComponent *component,
+                                   Saver           saver,
+                                   unsigned int    zone)
 {
-  Saver saver = component->info->saver;
-  if ((saver == NULL) && (component->info->incremental != NULL)) {
-    saver = indexComponentSaverIncrementalWrapper;
+  WriteZone *writeZone = component->writeZones[zone];
+  int result = (*saver)(component, writeZone->writer, zone);
+  if (result != UDS_SUCCESS) {
+    return result;
   }
 
-  int result = startIndexComponentSave(component);
+  result = doneWithZone(writeZone);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  freeBufferedWriter(writeZone->writer);
+  writeZone->writer = NULL;
+  return UDS_SUCCESS;
+}
+
+/**
+ * Thread function to write one zone of an index component.
+ *
+ * @param arg  the ZoneWrite describing the zone to write
+ **/
+static void zoneWriteThread(void *arg)
+{
+  ZoneWrite *zoneWrite = arg;
+  zoneWrite->result = writeIndexComponentZone(zoneWrite->component,
+                                              zoneWrite->saver,
+                                              zoneWrite->zone);
+}
+
+/**
+ * Write all the zones of a multi-zone index component concurrently. Each
+ * zone has its own region and writer and the savers only touch the state of
+ * their own zone, so the zones are independent. Any zone for which a thread
+ * cannot be started is written by the calling thread.
+ *
+ * @param component  the index component
+ * @param saver      the function which writes the component data
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int writeIndexComponentZones(IndexComponent *component, Saver saver)
+{
+  ZoneWrite *zoneWrites;
+  int result = ALLOCATE(component->numZones, ZoneWrite, "zone writes",
+                        &zoneWrites);
   if (result != UDS_SUCCESS) {
     return result;
   }
 
   unsigned int z;
   for (z = 0; z < component->numZones; ++z) {
-    WriteZone *writeZone = component->writeZones[z];
+    ZoneWrite *zoneWrite = &zoneWrites[z];
+    zoneWrite->component = component;
+    zoneWrite->saver     = saver;
+    zoneWrite->zone      = z;
+    if (z > 0) {
+      zoneWrite->started = (createThread(zoneWriteThread, zoneWrite,
+                                         "saveZone", &zoneWrite->thread)
+                            == UDS_SUCCESS);
+    }
+  }
 
-    result = (*saver)(component, writeZone->writer, z);
-    if (result != UDS_SUCCESS) {
-      break;
+  for (z = 0; z < component->numZones; ++z) {
+    ZoneWrite *zoneWrite = &zoneWrites[z];
+    if (!zoneWrite->started) {
+      zoneWriteThread(zoneWrite);
     }
+  }
 
-    result = doneWithZone(writeZone);
-    if (result != UDS_SUCCESS) {
-      break;
+  for (z = 0; z < component->numZones; ++z) {
+    ZoneWrite *zoneWrite = &zoneWrites[z];
+    if (zoneWrite->started) {
+      joinThreads(zoneWrite->thread);
     }
+    if (result == UDS_SUCCESS) {
+      result = zoneWrite->result;
+    }
+  }
+
+  FREE(zoneWrites);
+  return result;
+}
+
+/*****************************************************************************/
+int writeIndexComponent(IndexComponent *component)
+{
+  Saver saver = component->info->saver;
+  if ((saver == NULL) && (component->info->incremental != NULL)) {
+    saver = indexComponentSaverIncrementalWrapper;
+  }
+
+  int result = startIndexComponentSave(component);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
 
-    freeBufferedWriter(writeZone->writer);
-    writeZone->writer = NULL;
+  if (component->numZones > 1) {
+    result = writeIndexComponentZones(component, saver);
+  } else {
+    result = writeIndexComponentZone(component, saver, 0);
   }
 
   if (result != UDS_SUCCESS) {
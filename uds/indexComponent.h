@@ -360,4 +360,21 @@ int getBufferedReaderForPortal(ReadPortal      *portal,
                                unsigned int     part,
                                BufferedReader **readerPtr);
 
+/**
+ * Take a buffered reader for the specified component part away from the
+ * portal, so that it can still be read after the component has been loaded.
+ *
+ * @param [in]  portal          The component portal.
+ * @param [in]  part            The component ordinal number.
+ * @param [out] readerPtr       Where to put the buffered reader.
+ *
+ * @return UDS_SUCCESS or an error code.
+ *
+ * @note the caller must free the reader
+ **/
+__attribute__((warn_unused_result))
+int takeBufferedReaderFromPortal(ReadPortal      *portal,
+                                 unsigned int     part,
+                                 BufferedReader **readerPtr);
+
 #endif /* INDEX_COMPONENT_H */
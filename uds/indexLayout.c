@@ -1731,6 +1731,16 @@ int openVolumeBufio(IndexLayout             *layout,
   return makeBufio(layout->factory, offset, blockSize, reservedBuffers,
                    clientPtr);
 }
+
+/*****************************************************************************/
+void openVolumeDirect(IndexLayout  *layout,
+                      IOFactory   **factoryPtr,
+                      off_t        *offsetPtr)
+{
+  getIOFactory(layout->factory);
+  *factoryPtr = layout->factory;
+  *offsetPtr  = layout->index.volume.startBlock * layout->super.blockSize;
+}
 #else
 /*****************************************************************************/
 int openVolumeRegion(IndexLayout *layout, IORegion **regionPtr)
@@ -182,6 +182,18 @@ int openVolumeBufio(IndexLayout             *layout,
                     unsigned int             reservedBuffers,
                     struct dm_bufio_client **clientPtr)
   __attribute__((warn_unused_result));
+
+/**
+ * Obtain the IOFactory and offset needed to read the specified index volume
+ * directly. A reference to the IOFactory is acquired for the caller.
+ *
+ * @param [in]  layout      The index layout.
+ * @param [out] factoryPtr  Where to put the IOFactory
+ * @param [out] offsetPtr   Where to put the byte offset of the volume
+ **/
+void openVolumeDirect(IndexLayout  *layout,
+                      IOFactory   **factoryPtr,
+                      off_t        *offsetPtr);
 #else
 /**
  * Obtain an IORegion for the specified index volume.
@@ -42,6 +42,8 @@ static int writeIndexPageMap(IndexComponent *component,
 static const byte INDEX_PAGE_MAP_MAGIC[] = "ALBIPM02";
 enum {
   INDEX_PAGE_MAP_MAGIC_LENGTH = sizeof(INDEX_PAGE_MAP_MAGIC) - 1,
+  // The most lookup buckets to keep for each index page of a chapter
+  LOOKUP_BUCKETS_PER_PAGE     = 4,
 };
 
 const IndexComponentInfo INDEX_PAGE_MAP_INFO = {
@@ -62,6 +64,70 @@ static INLINE size_t numEntries(const Geometry *geometry)
   return geometry->chaptersPerVolume * (geometry->indexPagesPerChapter - 1);
 }
 
+/*****************************************************************************/
+static INLINE size_t entriesSize(const Geometry *geometry)
+{
+  return sizeof(IndexPageMapEntry) * numEntries(geometry);
+}
+
+/**
+ * Compute the number of bits to shift a delta list number by to get its
+ * lookup bucket. This is the smallest shift which leaves each chapter with no
+ * more than LOOKUP_BUCKETS_PER_PAGE buckets for each of its index pages.
+ *
+ * @param geometry  The geometry of the index
+ *
+ * @return The shift
+ **/
+static unsigned int computeLookupShift(const Geometry *geometry)
+{
+  unsigned int maxBuckets
+    = LOOKUP_BUCKETS_PER_PAGE * geometry->indexPagesPerChapter;
+  unsigned int shift = 0;
+  while (((geometry->deltaListsPerChapter - 1) >> shift) >= maxBuckets) {
+    shift++;
+  }
+  return shift;
+}
+
+/*****************************************************************************/
+static INLINE unsigned int computeLookupBuckets(const Geometry *geometry)
+{
+  return ((geometry->deltaListsPerChapter - 1)
+          >> computeLookupShift(geometry)) + 1;
+}
+
+/*****************************************************************************/
+static INLINE size_t lookupSize(const Geometry *geometry)
+{
+  return (sizeof(IndexPageMapEntry) * geometry->chaptersPerVolume
+          * computeLookupBuckets(geometry));
+}
+
+/**
+ * Rebuild the lookup buckets of a chapter from its entries.
+ *
+ * @param map            The index page map
+ * @param chapterNumber  The chapter whose buckets to rebuild
+ **/
+static void updateChapterLookup(IndexPageMap *map, unsigned int chapterNumber)
+{
+  unsigned int pages = map->geometry->indexPagesPerChapter - 1;
+  const IndexPageMapEntry *entries = &map->entries[chapterNumber * pages];
+  IndexPageMapEntry *lookup
+    = &map->lookup[chapterNumber * map->lookupBuckets];
+  unsigned int indexPageNumber = 0;
+  unsigned int bucket;
+  for (bucket = 0; bucket < map->lookupBuckets; bucket++) {
+    unsigned int firstList = bucket << map->lookupShift;
+    while ((indexPageNumber < pages)
+           && (firstList > entries[indexPageNumber])) {
+      indexPageNumber++;
+    }
+    lookup[bucket] = indexPageNumber;
+  }
+}
+
 /*****************************************************************************/
 int makeIndexPageMap(const Geometry *geometry, IndexPageMap **mapPtr)
 {
@@ -81,7 +147,9 @@ int makeIndexPageMap(const Geometry *geometry, IndexPageMap **mapPtr)
     return result;
   }
 
-  map->geometry = geometry;
+  map->geometry      = geometry;
+  map->lookupShift   = computeLookupShift(geometry);
+  map->lookupBuckets = computeLookupBuckets(geometry);
 
   result = ALLOCATE(numEntries(geometry),
                     IndexPageMapEntry,
@@ -92,6 +160,16 @@ int makeIndexPageMap(const Geometry *geometry, IndexPageMap **mapPtr)
     return result;
   }
 
+  // An all zero lookup table is correct, if slow, for any entries.
+  result = ALLOCATE(geometry->chaptersPerVolume * map->lookupBuckets,
+                    IndexPageMapEntry,
+                    "Index Page Map Lookup",
+                    &map->lookup);
+  if (result != UDS_SUCCESS) {
+    freeIndexPageMap(map);
+    return result;
+  }
+
   *mapPtr = map;
   return UDS_SUCCESS;
 }
@@ -101,6 +179,7 @@ void freeIndexPageMap(IndexPageMap *map)
 {
   if (map != NULL) {
     FREE(map->entries);
+    FREE(map->lookup);
     FREE(map);
   }
 }
@@ -158,6 +237,7 @@ int updateIndexPageMap(IndexPageMap   *map,
   size_t slot
     = (chapterNumber * (geometry->indexPagesPerChapter - 1)) + indexPageNumber;
   map->entries[slot] = (IndexPageMapEntry) deltaListNumber;
+  updateChapterLookup(map, chapterNumber);
   return UDS_SUCCESS;
 }
 
@@ -175,11 +255,15 @@ int findIndexPageNumber(const IndexPageMap *map,
   }
 
   unsigned int deltaListNumber = hashToChapterDeltaList(name, geometry);
-  unsigned int slot = (chapterNumber * (geometry->indexPagesPerChapter - 1));
-  unsigned int limit = slot + (geometry->indexPagesPerChapter - 1);
-  unsigned int indexPageNumber = 0;
-  for (; slot < limit; indexPageNumber++, slot++) {
-    if (deltaListNumber <= map->entries[slot]) {
+  unsigned int pages = geometry->indexPagesPerChapter - 1;
+  const IndexPageMapEntry *entries = &map->entries[chapterNumber * pages];
+
+  // Start from the first page which could hold any list of the bucket.
+  unsigned int indexPageNumber
+    = map->lookup[(chapterNumber * map->lookupBuckets)
+                  + (deltaListNumber >> map->lookupShift)];
+  for (; indexPageNumber < pages; indexPageNumber++) {
+    if (deltaListNumber <= entries[indexPageNumber]) {
       break;
     }
   }
@@ -229,7 +313,7 @@ int getListNumberBounds(const IndexPageMap *map,
 /*****************************************************************************/
 size_t indexPageMapSize(const Geometry *geometry)
 {
-  return sizeof(IndexPageMapEntry) * numEntries(geometry);
+  return entriesSize(geometry) + lookupSize(geometry);
 }
 
 /*****************************************************************************/
@@ -267,7 +351,7 @@ static int writeIndexPageMap(IndexComponent *component,
     return logErrorWithStringError(result,
                                    "cannot write index page map header");
   }
-  result = makeBuffer(indexPageMapSize(map->geometry), &buffer);
+  result = makeBuffer(entriesSize(map->geometry), &buffer);
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -290,7 +374,7 @@ static int writeIndexPageMap(IndexComponent *component,
 /*****************************************************************************/
 uint64_t computeIndexPageMapSaveSize(const Geometry *geometry)
 {
-  return indexPageMapSize(geometry) +
+  return entriesSize(geometry) +
     INDEX_PAGE_MAP_MAGIC_LENGTH + sizeof(((IndexPageMap *) 0)->lastUpdate);
 }
 
@@ -307,6 +391,11 @@ static int decodeIndexPageMap(Buffer *buffer, IndexPageMap *map)
   if (result != UDS_SUCCESS) {
     return result;
   }
+
+  unsigned int chapter;
+  for (chapter = 0; chapter < map->geometry->chaptersPerVolume; chapter++) {
+    updateChapterLookup(map, chapter);
+  }
   result = ASSERT_LOG_ONLY(contentLength(buffer) == 0,
                            "%zu bytes decoded of %zu expected",
                            bufferLength(buffer) - contentLength(buffer),
@@ -334,7 +423,7 @@ static int readIndexPageMap(ReadPortal *portal)
 
   Buffer *buffer;
   result
-    = makeBuffer(sizeof(map->lastUpdate) + indexPageMapSize(map->geometry),
+    = makeBuffer(sizeof(map->lastUpdate) + entriesSize(map->geometry),
                  &buffer);
   if (result != UDS_SUCCESS) {
     return result;
@@ -46,6 +46,11 @@ typedef struct {
  *  of the last delta list on that index page.  In order to save memory, the
  *  information for the last page in each chapter is not recorded, as it is
  *  known from the geometry.
+ *
+ *  So that a lookup need not scan all the entries of a chapter, the map also
+ *  divides each chapter's delta lists into buckets of a power of two lists,
+ *  and records for each bucket the first index page which could hold any of
+ *  its lists.  This lookup table is not saved; it is rebuilt from the entries.
  */
 
 typedef uint16_t IndexPageMapEntry;
@@ -54,6 +59,9 @@ struct indexPageMap {
   const Geometry         *geometry;
   uint64_t                lastUpdate;
   IndexPageMapEntry      *entries;
+  unsigned int            lookupShift;
+  unsigned int            lookupBuckets;
+  IndexPageMapEntry      *lookup;
 };
 
 /**
@@ -152,8 +160,8 @@ uint64_t computeIndexPageMapSaveSize(const Geometry *geometry);
  *
  * @param geometry      The index geometry.
  *
- * @return              The number of bytes required for the page map data,
- *                      exclusive of headers.
+ * @return              The number of bytes of memory used by the page map
+ *                      entries and their lookup table, exclusive of headers.
  **/
 size_t indexPageMapSize(const Geometry *geometry)
   __attribute__((warn_unused_result));
@@ -67,6 +67,26 @@ static void enqueueBarrierMessages(IndexRouter *router,
   }
 }
 
+/**
+ * Enqueue a control message in every zone to start restoring the master
+ * index delta lists which an incremental load did not read.
+ *
+ * @param router  the router containing the relevant queues
+ **/
+static int enqueueRestoreMessages(IndexRouter *router)
+{
+  ZoneMessage message = { .index = router->index };
+  unsigned int zone;
+  for (zone = 0; zone < router->zoneCount; zone++) {
+    int result = launchZoneControlMessage(REQUEST_RESTORE_DELTA_LISTS,
+                                          message, zone, router);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+  return UDS_SUCCESS;
+}
+
 /**
  * This is the request processing function for the triage stage queue. Each
  * request is resolved in the master index, determining if it is a hook or
@@ -163,6 +183,14 @@ int makeIndexRouter(IndexLayout                  *layout,
     return logErrorWithStringError(result, "failed to create index");
   }
 
+  if (isMasterIndexRestoring(router->index->masterIndex)) {
+    result = enqueueRestoreMessages(router);
+    if (result != UDS_SUCCESS) {
+      freeIndexRouter(router);
+      return result;
+    }
+  }
+
   router->needToSave = (router->index->loadedType != LOAD_LOAD);
   *routerPtr = router;
   return UDS_SUCCESS;
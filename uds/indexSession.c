@@ -95,29 +95,49 @@ int checkIndexSession(struct uds_index_session *indexSession)
    return UDS_NO_INDEXSESSION;
 }
 
+/**
+ * Release several references to an index session at once.
+ *
+ * @param indexSession  The session to release
+ * @param count         The number of references to release
+ **/
+static void releaseIndexSessionRequests(struct uds_index_session *indexSession,
+                                        unsigned int              count)
+{
+  lockMutex(&indexSession->requestMutex);
+  indexSession->requestCount -= count;
+  if (indexSession->requestCount == 0) {
+    broadcastCond(&indexSession->requestCond);
+  }
+  unlockMutex(&indexSession->requestMutex);
+}
+
 /**********************************************************************/
-int getIndexSession(struct uds_index_session *indexSession)
+int getIndexSessionRequests(struct uds_index_session *indexSession,
+                            unsigned int              count)
 {
   lockMutex(&indexSession->requestMutex);
-  indexSession->requestCount++;
+  indexSession->requestCount += count;
   unlockMutex(&indexSession->requestMutex);
 
   int result = checkIndexSession(indexSession);
   if (result != UDS_SUCCESS) {
-    releaseIndexSession(indexSession);
+    releaseIndexSessionRequests(indexSession, count);
     return result;
   }
   return UDS_SUCCESS;
 }
 
+/**********************************************************************/
+int getIndexSession(struct uds_index_session *indexSession)
+{
+  return getIndexSessionRequests(indexSession, 1);
+}
+
 /**********************************************************************/
 void releaseIndexSession(struct uds_index_session *indexSession)
 {
-  lockMutex(&indexSession->requestMutex);
-  if (--indexSession->requestCount == 0) {
-    broadcastCond(&indexSession->requestCond);
-  }
-  unlockMutex(&indexSession->requestMutex);
+  releaseIndexSessionRequests(indexSession, 1);
 }
 
 /**********************************************************************/
@@ -506,6 +526,18 @@ int udsGetIndexStats(struct uds_index_session *indexSession,
   return UDS_SUCCESS;
 }
 
+/**********************************************************************/
+int udsGetIndexReplayProgress(struct uds_index_session *indexSession,
+                              uint64_t                 *replayed,
+                              uint64_t                 *total)
+{
+  lockMutex(&indexSession->loadContext.mutex);
+  *replayed = indexSession->loadContext.chaptersReplayed;
+  *total    = indexSession->loadContext.chaptersToReplay;
+  unlockMutex(&indexSession->loadContext.mutex);
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 int udsGetIndexSessionStats(struct uds_index_session *indexSession,
                             UdsContextStats          *stats)
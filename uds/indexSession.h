@@ -99,6 +99,9 @@ typedef struct indexLoadContext {
   Mutex              mutex;
   CondVar            cond;
   IndexSuspendStatus status;  // Covered by indexLoadContext.mutex.
+  // The progress of any volume replay, covered by indexLoadContext.mutex.
+  uint64_t           chaptersReplayed;
+  uint64_t           chaptersToReplay;
 } IndexLoadContext;
 
 /**
@@ -172,6 +175,20 @@ void disableIndexSession(struct uds_index_session *indexSession);
 int getIndexSession(struct uds_index_session *indexSession)
   __attribute__((warn_unused_result));
 
+/**
+ * Acquire the index session for a batch of asynchronous index requests. This
+ * is equivalent to calling getIndexSession() once for each request, and
+ * each request must eventually be released with releaseIndexSession().
+ *
+ * @param indexSession  The index session
+ * @param count         The number of requests in the batch
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int getIndexSessionRequests(struct uds_index_session *indexSession,
+                            unsigned int              count)
+  __attribute__((warn_unused_result));
+
 /**
  * Release a pointer to an index session.
  *
@@ -152,6 +152,13 @@ int loadIndexState(IndexState *state, bool *replayPtr)
   if (result != UDS_SUCCESS) {
     return result;
   }
+  if ((state->loadZones > 0) && (state->loadZones != state->zoneCount)) {
+    // The multi-zone components distribute their saved data to the current
+    // zones as they are read.
+    logInfo("index was saved with %u zone%s, repartitioning into %u zone%s",
+            state->loadZones, (state->loadZones == 1) ? "" : "s",
+            state->zoneCount, (state->zoneCount == 1) ? "" : "s");
+  }
 
   bool replayRequired = false;
   unsigned int i;
@@ -25,6 +25,7 @@
 #include "errors.h"
 #include "index.h"
 #include "logger.h"
+#include "memoryAlloc.h"
 #include "uds.h"
 
 /* The index state version header */
@@ -47,6 +48,110 @@ static const IndexStateVersion INDEX_STATE_VERSION_301 = {
   .versionID = 301,
 };
 
+/*
+ * The version of the optional list of cached chapters which follows the
+ * index state. Older releases ignore anything after the index state, so the
+ * list does not change the index state version.
+ */
+static const IndexStateVersion WARM_CHAPTERS_VERSION_1 = {
+  .signature = -1,
+  .versionID = 1,
+};
+
+enum {
+  /* The most cached chapters which are saved with the index state */
+  MAX_WARM_CHAPTERS = 32,
+};
+
+/**
+ * Read the list of chapters which were cached when the index was saved, if
+ * there is one, and start reading them back in. The list is only a hint, so
+ * a list which can not be decoded is ignored.
+ *
+ * @param buffer  the index state buffer, positioned after the index state
+ * @param volume  the volume of the index being loaded
+ **/
+static void readWarmChapters(Buffer *buffer, Volume *volume)
+{
+  IndexStateVersion version;
+  uint32_t          count;
+  if ((contentLength(buffer) == 0)
+      || (getInt32LEFromBuffer(buffer, &version.signature) != UDS_SUCCESS)
+      || (getInt32LEFromBuffer(buffer, &version.versionID) != UDS_SUCCESS)
+      || (version.signature != WARM_CHAPTERS_VERSION_1.signature)
+      || (version.versionID != WARM_CHAPTERS_VERSION_1.versionID)
+      || (getUInt32LEFromBuffer(buffer, &count) != UDS_SUCCESS)
+      || (count == 0) || (count > MAX_WARM_CHAPTERS)) {
+    return;
+  }
+
+  WarmChapter *chapters;
+  if (ALLOCATE(count, WarmChapter, __func__, &chapters) != UDS_SUCCESS) {
+    return;
+  }
+
+  unsigned int i;
+  for (i = 0; i < count; i++) {
+    WarmChapter *chapter = &chapters[i];
+    if ((getUInt32LEFromBuffer(buffer, &chapter->physicalChapter)
+         != UDS_SUCCESS)
+        || (getUInt32LEFromBuffer(buffer, &chapter->firstPage) != UDS_SUCCESS)
+        || (getUInt32LEFromBuffer(buffer, &chapter->pageCount)
+            != UDS_SUCCESS)) {
+      break;
+    }
+  }
+
+  prefetchWarmChapters(volume, chapters, i);
+  FREE(chapters);
+}
+
+/**
+ * Write the list of the chapters with the most cached pages after the index
+ * state, so that they can be read back in when the index is next loaded.
+ *
+ * @param buffer  the index state buffer, positioned after the index state
+ * @param volume  the volume of the index being saved
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int writeWarmChapters(Buffer *buffer, Volume *volume)
+{
+  WarmChapter *chapters;
+  int result = ALLOCATE(MAX_WARM_CHAPTERS, WarmChapter, __func__, &chapters);
+  if (result != UDS_SUCCESS) {
+    // The list is only a hint, so save the index without it.
+    return UDS_SUCCESS;
+  }
+
+  unsigned int count = listWarmChapters(volume, chapters, MAX_WARM_CHAPTERS);
+  if (count == 0) {
+    FREE(chapters);
+    return UDS_SUCCESS;
+  }
+
+  result = putUInt32LEIntoBuffer(buffer, WARM_CHAPTERS_VERSION_1.signature);
+  if (result == UDS_SUCCESS) {
+    result = putUInt32LEIntoBuffer(buffer, WARM_CHAPTERS_VERSION_1.versionID);
+  }
+  if (result == UDS_SUCCESS) {
+    result = putUInt32LEIntoBuffer(buffer, count);
+  }
+
+  unsigned int i;
+  for (i = 0; (i < count) && (result == UDS_SUCCESS); i++) {
+    result = putUInt32LEIntoBuffer(buffer, chapters[i].physicalChapter);
+    if (result == UDS_SUCCESS) {
+      result = putUInt32LEIntoBuffer(buffer, chapters[i].firstPage);
+    }
+    if (result == UDS_SUCCESS) {
+      result = putUInt32LEIntoBuffer(buffer, chapters[i].pageCount);
+    }
+  }
+  FREE(chapters);
+  return result;
+}
+
 /**
  * The index state index component reader.
  *
@@ -109,6 +214,7 @@ static int readIndexStateData(ReadPortal *portal)
   index->newestVirtualChapter = state.newestChapter;
   index->oldestVirtualChapter = state.oldestChapter;
   index->lastCheckpoint       = state.lastCheckpoint;
+  readWarmChapters(buffer, index->volume);
   return UDS_SUCCESS;
 }
 
@@ -166,7 +272,7 @@ static int writeIndexStateData(IndexComponent *component,
   if (result != UDS_SUCCESS) {
     return result;
   }
-  return UDS_SUCCESS;
+  return writeWarmChapters(buffer, index->volume);
 }
 
 /*****************************************************************************/
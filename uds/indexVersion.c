@@ -41,8 +41,7 @@ void initializeIndexVersion(struct index_version *version,
   
   /*
    * Version 3 was created when we discovered the the chapter index headers
-   * were written in native endian format.  It was first used in RHEL8.2 and is
-   * the current version for new indices.
+   * were written in native endian format.  It was first used in RHEL8.2.
    *
    * Versions before 3 read and write native endian chapter headers.  Version 3
    * reads chapter headers in any endian order, and writes little-endian
@@ -50,7 +49,18 @@ void initializeIndexVersion(struct index_version *version,
    */
   bool chapterIndexHeaderNativeEndian = superVersion < 3;
 
+  /*
+   * Version 4 was created when record pages were changed from a binary tree
+   * of records to a blocked search tree with four records per node, so that a
+   * search touches far fewer cache lines.  It is the current version for new
+   * indices.
+   *
+   * Versions before 4 read and write record pages as binary trees.
+   */
+  bool blockedRecordPages = superVersion >= 4;
+
   *version = (struct index_version) {
     .chapterIndexHeaderNativeEndian = chapterIndexHeaderNativeEndian,
+    .blockedRecordPages             = blockedRecordPages,
   };
 }  
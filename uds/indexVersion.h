@@ -26,12 +26,13 @@
 
 struct index_version {
   bool chapterIndexHeaderNativeEndian;
+  bool blockedRecordPages;
 };
 
 enum {
   SUPER_VERSION_MINIMUM = 1,
-  SUPER_VERSION_MAXIMUM = 3,
-  SUPER_VERSION_CURRENT = 3,
+  SUPER_VERSION_MAXIMUM = 4,
+  SUPER_VERSION_CURRENT = 4,
 };
 
 /**
@@ -32,6 +32,11 @@
 #include "sparseCache.h"
 #include "uds.h"
 
+enum {
+  // The number of delta lists a zone restores for each control message
+  RESTORE_LISTS_PER_MESSAGE = 64,
+};
+
 /**********************************************************************/
 int makeIndexZone(struct index *index, unsigned int zoneNumber)
 {
@@ -175,6 +180,27 @@ static int handleChapterClosed(IndexZone                *zone,
   return UDS_SUCCESS;
 }
 
+/**********************************************************************/
+int restoreZoneDeltaLists(IndexZone *zone, IndexRouter *router)
+{
+  for (;;) {
+    bool finished;
+    int result = restoreMasterIndexZone(zone->index->masterIndex, zone->id,
+                                        RESTORE_LISTS_PER_MESSAGE, &finished);
+    if ((result != UDS_SUCCESS) || finished) {
+      return result;
+    }
+
+    if (router != NULL) {
+      // Give the requests waiting for this zone a turn before going on.
+      ZoneMessage message = { .index = zone->index };
+      return launchZoneControlMessage(REQUEST_RESTORE_DELTA_LISTS, message,
+                                      zone->id, router);
+    }
+    // We're in a test which doesn't have zone queues, so just keep going.
+  }
+}
+
 /**********************************************************************/
 int dispatchIndexZoneControlRequest(Request *request)
 {
@@ -188,6 +214,9 @@ int dispatchIndexZoneControlRequest(Request *request)
   case REQUEST_ANNOUNCE_CHAPTER_CLOSED:
     return handleChapterClosed(zone, &message->data.chapterClosed);
 
+  case REQUEST_RESTORE_DELTA_LISTS:
+    return restoreZoneDeltaLists(zone, request->router);
+
   default:
     return ASSERT_FALSE("valid control message type: %d", request->action);
   }
@@ -362,6 +391,7 @@ int putRecordInZone(IndexZone          *zone,
                     Request            *request,
                     const UdsChunkData *metadata)
 {
+  zone->changedSinceSave = true;
   unsigned int remaining;
   int result = putOpenChapter(zone->openChapter, &request->chunkName, metadata,
                               &remaining);
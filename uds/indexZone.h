@@ -33,6 +33,7 @@ typedef struct {
   uint64_t         oldestVirtualChapter;
   uint64_t         newestVirtualChapter;
   unsigned int     id;
+  bool             changedSinceSave;
 } IndexZone;
 
 /**
@@ -102,6 +103,21 @@ int executeSparseCacheBarrierMessage(IndexZone          *zone,
                                      BarrierMessageData *barrier)
   __attribute__((warn_unused_result));
 
+/**
+ * Restore some of the master index delta lists of a zone after an
+ * incremental load, and if there are more to restore, enqueue another
+ * control message to continue once the requests waiting for the zone have
+ * had a turn.
+ *
+ * @param zone    The index zone
+ * @param router  The router whose queues the zone uses, or NULL to restore
+ *                all the delta lists of the zone now
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int restoreZoneDeltaLists(IndexZone *zone, IndexRouter *router)
+  __attribute__((warn_unused_result));
+
 /**
  * Open the next chapter.
  *
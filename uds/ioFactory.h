@@ -126,6 +126,49 @@ int makeBufio(IOFactory               *factory,
               unsigned int             reservedBuffers,
               struct dm_bufio_client **clientPtr)
   __attribute__((warn_unused_result));
+
+/**
+ * Read part of the index straight into memory with a single bio, bypassing
+ * dm-bufio. The caller waits for the read to finish.
+ *
+ * @param factory  The IOFactory
+ * @param offset   The byte offset of the data within the index
+ * @param buffer   The page aligned buffer to read into
+ * @param size     The number of bytes to read, a multiple of PAGE_SIZE
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int readDirect(IOFactory *factory, off_t offset, byte *buffer, size_t size)
+  __attribute__((warn_unused_result));
+
+/**
+ * Write a run of consecutive blocks of the index straight from memory,
+ * bypassing dm-bufio. The blocks are combined into bios as large as the
+ * device allows, which are all submitted before waiting for any of them.
+ *
+ * @param factory    The IOFactory
+ * @param offset     The byte offset of the first block within the index
+ * @param blocks     The page aligned data of each block
+ * @param count      The number of blocks
+ * @param blockSize  The size of a block, a multiple of PAGE_SIZE
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int writeDirect(IOFactory     *factory,
+                off_t          offset,
+                byte * const   blocks[],
+                unsigned int   count,
+                size_t         blockSize)
+  __attribute__((warn_unused_result));
+
+/**
+ * Flush the volatile write cache of the device holding the index.
+ *
+ * @param factory  The IOFactory
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int flushDirect(IOFactory *factory) __attribute__((warn_unused_result));
 #else
 /**
  * Create an IORegion for a region of the index.
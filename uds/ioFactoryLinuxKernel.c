@@ -19,15 +19,34 @@
  * $Id: //eng/uds-releases/jasper/kernelLinux/uds/ioFactoryLinuxKernel.c#9 $
  */
 
+#include <linux/bio.h>
 #include <linux/blkdev.h>
 #include <linux/mount.h>
+#include <linux/vmalloc.h>
 
 #include "atomicDefs.h"
 #include "ioFactory.h"
 #include "logger.h"
 #include "memoryAlloc.h"
 
-enum { BLK_FMODE = FMODE_READ | FMODE_WRITE };
+enum {
+  BLK_FMODE = FMODE_READ | FMODE_WRITE,
+  /** The number of memory pages in one bio of writeDirect(), which is 1MB
+   *  with 4K pages */
+  DIRECT_WRITE_BIO_PAGES = 256,
+};
+
+/*
+ * The state shared by the bios of one writeDirect() call.
+ */
+typedef struct directWrite {
+  /** The number of bios in flight, plus one while they are being issued */
+  atomic_t          remaining;
+  /** The first error reported by any of the bios */
+  atomic_t          result;
+  /** Signalled when the last bio finishes */
+  struct completion done;
+} DirectWrite;
 
 /*
  * A kernel mode IOFactory object controls access to an index stored on a block
@@ -119,6 +138,188 @@ int makeBufio(IOFactory               *factory,
   return UDS_SUCCESS;
 }
 
+/**
+ * Get the page of memory holding an address of a direct I/O buffer.
+ *
+ * @param address  The address, which must be page aligned
+ *
+ * @return The page
+ **/
+static struct page *getBufferPage(byte *address)
+{
+  // Large buffers come from vmalloc, so each page is mapped separately.
+  return (is_vmalloc_addr(address)
+          ? vmalloc_to_page(address)
+          : virt_to_page(address));
+}
+
+/*****************************************************************************/
+int readDirect(IOFactory *factory, off_t offset, byte *buffer, size_t size)
+{
+  if ((offset % SECTOR_SIZE != 0) || (size % PAGE_SIZE != 0)) {
+    return logErrorWithStringError(UDS_INCORRECT_ALIGNMENT,
+                                   "direct read of %zu bytes at offset %zd"
+                                   " is not aligned", size, offset);
+  }
+
+  unsigned int pageCount = size / PAGE_SIZE;
+  struct bio *bio = bio_alloc(GFP_NOIO, pageCount);
+  if (bio == NULL) {
+    return ENOMEM;
+  }
+  bio_set_dev(bio, factory->bdev);
+  bio->bi_iter.bi_sector = offset >> SECTOR_SHIFT;
+  bio_set_op_attrs(bio, REQ_OP_READ, 0);
+
+  unsigned int i;
+  for (i = 0; i < pageCount; i++) {
+    struct page *page = getBufferPage(buffer + (i * PAGE_SIZE));
+    if (bio_add_page(bio, page, PAGE_SIZE, 0) != PAGE_SIZE) {
+      bio_put(bio);
+      return logErrorWithStringError(UDS_BAD_STATE,
+                                     "cannot add page %u to direct read",
+                                     i);
+    }
+  }
+
+  int result = -submit_bio_wait(bio);
+  bio_put(bio);
+  return result;
+}
+
+/**
+ * Finish one bio of a writeDirect() call, waking the caller if it was the
+ * last one.
+ *
+ * @param write  The state of the write
+ * @param error  The error of the bio, or UDS_SUCCESS
+ **/
+static void finishDirectWriteBio(DirectWrite *write, int error)
+{
+  if (error != UDS_SUCCESS) {
+    atomic_cmpxchg(&write->result, UDS_SUCCESS, error);
+  }
+  if (atomic_dec_and_test(&write->remaining)) {
+    complete(&write->done);
+  }
+}
+
+/**
+ * The bio end_io callback of writeDirect().
+ *
+ * @param bio  The bio which has finished
+ **/
+static void endDirectWriteBio(struct bio *bio)
+{
+  DirectWrite *write = bio->bi_private;
+  int error = -blk_status_to_errno(bio->bi_status);
+  bio_put(bio);
+  finishDirectWriteBio(write, error);
+}
+
+/**
+ * Submit a bio of a writeDirect() call.
+ *
+ * @param write  The state of the write
+ * @param bio    The bio
+ **/
+static void submitDirectWriteBio(DirectWrite *write, struct bio *bio)
+{
+  atomic_inc(&write->remaining);
+  bio->bi_private = write;
+  bio->bi_end_io  = endDirectWriteBio;
+  submit_bio(bio);
+}
+
+/*****************************************************************************/
+int writeDirect(IOFactory     *factory,
+                off_t          offset,
+                byte * const   blocks[],
+                unsigned int   count,
+                size_t         blockSize)
+{
+  if ((offset % SECTOR_SIZE != 0) || (blockSize % PAGE_SIZE != 0)) {
+    return logErrorWithStringError(UDS_INCORRECT_ALIGNMENT,
+                                   "direct write of %zu byte blocks at"
+                                   " offset %zd is not aligned",
+                                   blockSize, offset);
+  }
+
+  DirectWrite write;
+  atomic_set(&write.remaining, 1);
+  atomic_set(&write.result, UDS_SUCCESS);
+  init_completion(&write.done);
+
+  unsigned int pagesPerBlock = blockSize / PAGE_SIZE;
+  unsigned int pageCount     = count * pagesPerBlock;
+  struct bio  *bio           = NULL;
+  int          result        = UDS_SUCCESS;
+  unsigned int i             = 0;
+  while (i < pageCount) {
+    if (bio == NULL) {
+      unsigned int vecs = pageCount - i;
+      if (vecs > DIRECT_WRITE_BIO_PAGES) {
+        vecs = DIRECT_WRITE_BIO_PAGES;
+      }
+      bio = bio_alloc(GFP_NOIO, vecs);
+      if (bio == NULL) {
+        result = ENOMEM;
+        break;
+      }
+      bio_set_dev(bio, factory->bdev);
+      bio->bi_iter.bi_sector
+        = (offset + ((off_t) i * PAGE_SIZE)) >> SECTOR_SHIFT;
+      bio_set_op_attrs(bio, REQ_OP_WRITE, 0);
+    }
+
+    byte *address
+      = blocks[i / pagesPerBlock] + ((i % pagesPerBlock) * PAGE_SIZE);
+    if (bio_add_page(bio, getBufferPage(address), PAGE_SIZE, 0)
+        == PAGE_SIZE) {
+      i++;
+      continue;
+    }
+
+    // The bio is as large as the device allows, so start another one.
+    if (bio->bi_iter.bi_size == 0) {
+      bio_put(bio);
+      bio = NULL;
+      result = logErrorWithStringError(UDS_BAD_STATE,
+                                       "cannot add page to direct write");
+      break;
+    }
+    submitDirectWriteBio(&write, bio);
+    bio = NULL;
+  }
+
+  if (bio != NULL) {
+    if (result == UDS_SUCCESS) {
+      submitDirectWriteBio(&write, bio);
+    } else {
+      bio_put(bio);
+    }
+  }
+
+  // Drop the reference held while issuing and wait for the bios in flight.
+  finishDirectWriteBio(&write, result);
+  wait_for_completion(&write.done);
+  return atomic_read(&write.result);
+}
+
+/*****************************************************************************/
+int flushDirect(IOFactory *factory)
+{
+  struct bio *bio = bio_alloc(GFP_NOIO, 0);
+  if (bio == NULL) {
+    return ENOMEM;
+  }
+  bio_set_dev(bio, factory->bdev);
+  bio_set_op_attrs(bio, REQ_OP_WRITE, REQ_PREFLUSH);
+  int result = -submit_bio_wait(bio);
+  bio_put(bio);
+  return result;
+}
+
 /*****************************************************************************/
 int openBufferedReader(IOFactory       *factory,
                        off_t            offset,
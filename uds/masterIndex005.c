@@ -58,6 +58,7 @@ typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) masterIndexZone {
   uint64_t virtualChapterLow;      // The lowest virtual chapter indexed
   uint64_t virtualChapterHigh;     // The highest virtual chapter indexed
   long     numEarlyFlushes;        // The number of early flushes
+  unsigned int sweepList;          // The next list to sweep for the budget
 } MasterIndexZone;
 
 typedef struct {
@@ -68,6 +69,9 @@ typedef struct {
   uint64_t     volumeNonce;        // The volume nonce
   uint64_t     chapterZoneBits;    // Expected size of a chapter (per zone)
   uint64_t     maxZoneBits;        // Maximum size index (per zone)
+  uint64_t     fullZoneBits;       // Configured memory size (per zone)
+  uint64_t     freeZoneBits;       // Target free space (per zone)
+  uint64_t     budgetZoneBits;     // Memory budget, or 0 if none (per zone)
   unsigned int addressBits;        // Number of bits in address mask
   unsigned int addressMask;        // Mask to get address within delta list
   unsigned int chapterBits;        // Number of bits in chapter number
@@ -315,6 +319,40 @@ static int getMasterIndexEntry(MasterIndexRecord *record,
   return UDS_SUCCESS;
 }
 
+/**
+ * Find the delta index entry, or the insertion point for a delta index
+ * entry, removing the entries of any chapters which have expired since the
+ * delta list was last searched.
+ *
+ * @param record       Updated to describe the entry being looked for
+ * @param listNumber   The delta list number
+ * @param key          The address field being looked for
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int getFlushedMasterIndexEntry(MasterIndexRecord *record,
+                                      unsigned int       listNumber,
+                                      unsigned int       key)
+{
+  const MasterIndex5 *mi5 = container_of(record->masterIndex, MasterIndex5,
+                                         common);
+  const MasterIndexZone *masterZone = getMasterZone(record);
+  uint64_t flushChapter = mi5->flushChapters[listNumber];
+  ChapterRange range;
+  uint64_t flushCount = masterZone->virtualChapterLow - flushChapter;
+  range.chapterStart = convertVirtualToIndex(mi5, flushChapter);
+  range.chapterCount = (flushCount > mi5->chapterMask
+                        ? mi5->chapterMask + 1
+                        : flushCount);
+  int result = getMasterIndexEntry(record, listNumber, key, &range);
+  flushChapter = convertIndexToVirtual(record, range.chapterStart);
+  if (flushChapter > masterZone->virtualChapterHigh) {
+    flushChapter = masterZone->virtualChapterHigh;
+  }
+  mi5->flushChapters[listNumber] = flushChapter;
+  return result;
+}
+
 /***********************************************************************/
 /**
  * Terminate and clean up the master index
@@ -712,6 +750,27 @@ static int restoreDeltaListToMasterIndex_005(MasterIndex *masterIndex,
   return restoreDeltaListToDeltaIndex(&mi5->deltaIndex, dlsi, data);
 }
 
+/***********************************************************************/
+/**
+ * Restore an image of saved delta lists
+ *
+ * @param masterIndex     The master index to restore into
+ * @param dlsi            The DeltaListSaveInfo which introduced the image
+ * @param data            A buffer for reading a single delta list
+ * @param bufferedReader  The buffered reader to read the image from
+ *
+ * @return error code or UDS_SUCCESS
+ **/
+static int restoreMasterIndexImage_005(MasterIndex *masterIndex,
+                                       const DeltaListSaveInfo *dlsi,
+                                       byte data[DELTA_LIST_MAX_BYTE_COUNT],
+                                       BufferedReader *bufferedReader)
+{
+  MasterIndex5 *mi5 = container_of(masterIndex, MasterIndex5, common);
+  return restoreDeltaImageToDeltaIndex(&mi5->deltaIndex, dlsi, data,
+                                       bufferedReader);
+}
+
 /***********************************************************************/
 /**
  * Abort restoring a master index from an input stream.
@@ -724,6 +783,57 @@ static void abortRestoringMasterIndex_005(MasterIndex *masterIndex)
   abortRestoringDeltaIndex(&mi5->deltaIndex);
 }
 
+/***********************************************************************/
+/**
+ * Have all the data for one zone been read while restoring a master index
+ * from an input stream?
+ *
+ * @param masterIndex  The master index to restore into
+ * @param zoneNumber   The zone number
+ *
+ * @return true if all the data for the zone are read
+ **/
+static bool isMasterIndexZoneRestored_005(const MasterIndex *masterIndex,
+                                          unsigned int       zoneNumber)
+{
+  const MasterIndex5 *mi5 = const_container_of(masterIndex, MasterIndex5,
+                                               common);
+  return isRestoringDeltaIndexZoneDone(&mi5->deltaIndex, zoneNumber);
+}
+
+/***********************************************************************/
+/**
+ * Has the delta list which would hold a chunk name been read while
+ * restoring a master index from an input stream?
+ *
+ * @param masterIndex  The master index to restore into
+ * @param name         The chunk name
+ *
+ * @return true if the delta list for the name has been read
+ **/
+static bool isMasterIndexNameRestored_005(const MasterIndex  *masterIndex,
+                                          const UdsChunkName *name)
+{
+  const MasterIndex5 *mi5 = const_container_of(masterIndex, MasterIndex5,
+                                               common);
+  return isRestoringDeltaListDone(&mi5->deltaIndex,
+                                  extractDListNum(mi5, name));
+}
+
+/***********************************************************************/
+/**
+ * Abort restoring one zone of a master index from an input stream.
+ *
+ * @param masterIndex  The master index
+ * @param zoneNumber   The zone number
+ **/
+static void abortRestoringMasterIndexZone_005(MasterIndex  *masterIndex,
+                                              unsigned int  zoneNumber)
+{
+  MasterIndex5 *mi5 = container_of(masterIndex, MasterIndex5, common);
+  abortRestoringDeltaIndexZone(&mi5->deltaIndex, zoneNumber);
+}
+
 /***********************************************************************/
 static void removeNewestChapters(MasterIndex5 *mi5,
                                  unsigned int zoneNumber,
@@ -771,6 +881,141 @@ static void removeNewestChapters(MasterIndex5 *mi5,
   }
 }
 
+/***********************************************************************/
+/**
+ * Set the memory budget of the master index.
+ *
+ * @param masterIndex  The master index
+ * @param budget       The number of bytes of delta list memory the master
+ *                     index may use, or 0 for the memory it was created with
+ **/
+static void setMasterIndexMemoryBudget_005(MasterIndex *masterIndex,
+                                           size_t       budget)
+{
+  MasterIndex5 *mi5 = container_of(masterIndex, MasterIndex5, common);
+  if (budget == 0) {
+    mi5->budgetZoneBits = 0;
+    return;
+  }
+  // Always leave room for the free space and a few chapters.
+  uint64_t minZoneBits = mi5->freeZoneBits + 2 * mi5->chapterZoneBits;
+  uint64_t budgetZoneBits = (uint64_t) budget * CHAR_BIT / mi5->numZones;
+  mi5->budgetZoneBits = ((budgetZoneBits > minZoneBits)
+                         ? budgetZoneBits : minZoneBits);
+  if (mi5->budgetZoneBits < mi5->fullZoneBits) {
+    logInfo("master index memory budget is %zu bytes of %" PRIu64,
+            budget, mi5->fullZoneBits * mi5->numZones / CHAR_BIT);
+  }
+}
+
+/***********************************************************************/
+/**
+ * Remove the entries of expired chapters from some of the delta lists of a
+ * zone, so that the space they use can be reclaimed even if the lists are
+ * not searched.
+ *
+ * @param mi5         The master index
+ * @param zoneNumber  The zone number
+ * @param count       The number of delta lists to sweep
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int sweepExpiredEntries(MasterIndex5 *mi5,
+                               unsigned int  zoneNumber,
+                               unsigned int  count)
+{
+  MasterIndexZone *masterZone = &mi5->masterZones[zoneNumber];
+  unsigned int firstList = getDeltaIndexZoneFirstList(&mi5->deltaIndex,
+                                                      zoneNumber);
+  unsigned int numLists = getDeltaIndexZoneNumLists(&mi5->deltaIndex,
+                                                    zoneNumber);
+  unsigned int i;
+  for (i = 0; i < count; i++) {
+    unsigned int listNumber = firstList + masterZone->sweepList;
+    masterZone->sweepList = (masterZone->sweepList + 1) % numLists;
+    if (mi5->flushChapters[listNumber] >= masterZone->virtualChapterLow) {
+      continue;
+    }
+    // No address is this large, so every entry in the list is examined.
+    MasterIndexRecord record = {
+      .magic       = masterIndexRecordMagic,
+      .masterIndex = &mi5->common,
+      .zoneNumber  = zoneNumber,
+    };
+    int result = getFlushedMasterIndexEntry(&record, listNumber, UINT_MAX);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+  return UDS_SUCCESS;
+}
+
+/***********************************************************************/
+/**
+ * Move the memory used by a zone towards its memory budget.  Shrinking the
+ * zone lowers the limit on its size by at most one chapter each time a
+ * chapter is closed, so that only a few of the oldest chapters expire
+ * early at a time.  Once the remaining entries fit, the delta lists are
+ * moved into a smaller memory array.
+ *
+ * @param mi5         The master index
+ * @param zoneNumber  The zone number
+ **/
+static void applyZoneMemoryBudget(MasterIndex5 *mi5, unsigned int zoneNumber)
+{
+  enum { SWEEP_LISTS_PER_CHAPTER = 4096 };
+  uint64_t targetBits = mi5->fullZoneBits;
+  if ((mi5->budgetZoneBits > 0) && (mi5->budgetZoneBits < targetBits)) {
+    targetBits = mi5->budgetZoneBits;
+  }
+  uint64_t allocatedBits
+    = getDeltaIndexZoneDlistBitsAllocated(&mi5->deltaIndex, zoneNumber);
+  if ((targetBits == allocatedBits)
+      || !isRestoringDeltaIndexZoneDone(&mi5->deltaIndex, zoneNumber)) {
+    // Nothing to do, or the zone is being saved or restored.
+    return;
+  }
+
+  uint64_t targetMaxBits = targetBits - mi5->freeZoneBits;
+  if (targetBits < allocatedBits) {
+    if (mi5->maxZoneBits > targetMaxBits + mi5->chapterZoneBits) {
+      mi5->maxZoneBits -= mi5->chapterZoneBits;
+    } else {
+      mi5->maxZoneBits = targetMaxBits;
+    }
+    int result = sweepExpiredEntries(mi5, zoneNumber,
+                                     SWEEP_LISTS_PER_CHAPTER);
+    if (result != UDS_SUCCESS) {
+      logWarningWithStringError(result,
+                                "masterZone %u: cannot sweep expired entries",
+                                zoneNumber);
+      return;
+    }
+    uint64_t usedBits = getDeltaIndexZoneDlistBitsUsed(&mi5->deltaIndex,
+                                                       zoneNumber);
+    if (usedBits + mi5->freeZoneBits > targetBits) {
+      return;
+    }
+  }
+
+  int result = resizeDeltaIndexZone(&mi5->deltaIndex, zoneNumber,
+                                    targetBits / CHAR_BIT);
+  if (result == UDS_OVERFLOW) {
+    // Some lists still waste more space than estimated; try again later.
+    return;
+  }
+  if (result != UDS_SUCCESS) {
+    logWarningWithStringError(result,
+                              "masterZone %u: cannot resize delta lists",
+                              zoneNumber);
+    return;
+  }
+  mi5->maxZoneBits = targetMaxBits;
+  logInfo("masterZone %u: resized delta list memory from %" PRIu64
+          " to %" PRIu64 " bytes", zoneNumber, allocatedBits / CHAR_BIT,
+          targetBits / CHAR_BIT);
+}
+
 /***********************************************************************/
 /**
  * Set the open chapter number on a zone.  The master index zone will be
@@ -821,6 +1066,7 @@ static void setMasterIndexZoneOpenChapter_005(MasterIndex *masterIndex,
     masterZone->virtualChapterLow  = virtualChapter;
     masterZone->virtualChapterHigh = virtualChapter;
   }
+  applyZoneMemoryBudget(mi5, zoneNumber);
   // Check to see if the zone data has grown to be too large
   if (masterZone->virtualChapterLow < masterZone->virtualChapterHigh) {
     uint64_t usedBits = getDeltaIndexZoneDlistBitsUsed(&mi5->deltaIndex,
@@ -1020,18 +1266,7 @@ static int getMasterIndexRecord_005(MasterIndex *masterIndex,
 
   int result;
   if (flushChapter < masterZone->virtualChapterLow) {
-    ChapterRange range;
-    uint64_t flushCount = masterZone->virtualChapterLow - flushChapter;
-    range.chapterStart = convertVirtualToIndex(mi5, flushChapter);
-    range.chapterCount = (flushCount > mi5->chapterMask
-                          ? mi5->chapterMask + 1
-                          : flushCount);
-    result = getMasterIndexEntry(record, deltaListNumber, address, &range);
-    flushChapter = convertIndexToVirtual(record, range.chapterStart);
-    if (flushChapter > masterZone->virtualChapterHigh) {
-      flushChapter = masterZone->virtualChapterHigh;
-    }
-    mi5->flushChapters[deltaListNumber] = flushChapter;
+    result = getFlushedMasterIndexEntry(record, deltaListNumber, address);
   } else {
     result = getDeltaIndexEntry(&mi5->deltaIndex, deltaListNumber, address,
                                 name->name, false, &record->deltaEntry);
@@ -1408,6 +1643,7 @@ int makeMasterIndex005(const Configuration *config, unsigned int numZones,
   }
 
   mi5->common.abortRestoringMasterIndex     = abortRestoringMasterIndex_005;
+  mi5->common.abortRestoringMasterIndexZone = abortRestoringMasterIndexZone_005;
   mi5->common.abortSavingMasterIndex        = abortSavingMasterIndex_005;
   mi5->common.finishSavingMasterIndex       = finishSavingMasterIndex_005;
   mi5->common.freeMasterIndex               = freeMasterIndex_005;
@@ -1415,12 +1651,16 @@ int makeMasterIndex005(const Configuration *config, unsigned int numZones,
   mi5->common.getMasterIndexRecord          = getMasterIndexRecord_005;
   mi5->common.getMasterIndexStats           = getMasterIndexStats_005;
   mi5->common.getMasterIndexZone            = getMasterIndexZone_005;
+  mi5->common.isMasterIndexNameRestored     = isMasterIndexNameRestored_005;
   mi5->common.isMasterIndexSample           = isMasterIndexSample_005;
+  mi5->common.isMasterIndexZoneRestored     = isMasterIndexZoneRestored_005;
   mi5->common.isRestoringMasterIndexDone    = isRestoringMasterIndexDone_005;
   mi5->common.isSavingMasterIndexDone       = isSavingMasterIndexDone_005;
   mi5->common.lookupMasterIndexName         = lookupMasterIndexName_005;
   mi5->common.lookupMasterIndexSampledName  = lookupMasterIndexSampledName_005;
   mi5->common.restoreDeltaListToMasterIndex = restoreDeltaListToMasterIndex_005;
+  mi5->common.restoreMasterIndexImage       = restoreMasterIndexImage_005;
+  mi5->common.setMasterIndexMemoryBudget    = setMasterIndexMemoryBudget_005;
   mi5->common.setMasterIndexOpenChapter     = setMasterIndexOpenChapter_005;
   mi5->common.setMasterIndexTag             = setMasterIndexTag_005;
   mi5->common.setMasterIndexZoneOpenChapter = setMasterIndexZoneOpenChapter_005;
@@ -1441,9 +1681,10 @@ int makeMasterIndex005(const Configuration *config, unsigned int numZones,
                                 params.numDeltaLists, params.meanDelta,
                                 params.chapterBits, params.memorySize);
   if (result == UDS_SUCCESS) {
-    mi5->maxZoneBits = ((getDeltaIndexDlistBitsAllocated(&mi5->deltaIndex)
-                         - params.targetFreeSize * CHAR_BIT)
-                        / numZones);
+    mi5->fullZoneBits = (getDeltaIndexDlistBitsAllocated(&mi5->deltaIndex)
+                         / numZones);
+    mi5->freeZoneBits = params.targetFreeSize * CHAR_BIT / numZones;
+    mi5->maxZoneBits  = mi5->fullZoneBits - mi5->freeZoneBits;
   }
 
   // Initialize the chapter flush ranges to be empty.  This depends upon
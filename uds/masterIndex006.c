@@ -420,6 +420,31 @@ static int restoreDeltaListToMasterIndex_006(MasterIndex *masterIndex,
   return result;
 }
 
+/***********************************************************************/
+/**
+ * Restore an image of saved delta lists
+ *
+ * @param masterIndex     The master index to restore into
+ * @param dlsi            The DeltaListSaveInfo which introduced the image
+ * @param data            A buffer for reading a single delta list
+ * @param bufferedReader  The buffered reader to read the image from
+ *
+ * @return error code or UDS_SUCCESS
+ **/
+static int restoreMasterIndexImage_006(MasterIndex *masterIndex,
+                                       const DeltaListSaveInfo *dlsi,
+                                       byte data[DELTA_LIST_MAX_BYTE_COUNT],
+                                       BufferedReader *bufferedReader)
+{
+  MasterIndex6 *mi6 = container_of(masterIndex, MasterIndex6, common);
+  int result = restoreMasterIndexImage(mi6->miNonHook, dlsi, data,
+                                       bufferedReader);
+  if (result != UDS_SUCCESS) {
+    result = restoreMasterIndexImage(mi6->miHook, dlsi, data, bufferedReader);
+  }
+  return result;
+}
+
 /***********************************************************************/
 /**
  * Abort restoring a master index from an input stream.
@@ -433,6 +458,61 @@ static void abortRestoringMasterIndex_006(MasterIndex *masterIndex)
   abortRestoringMasterIndex(mi6->miHook);
 }
 
+/***********************************************************************/
+/**
+ * Have all the data for one zone been read while restoring a master index
+ * from an input stream?
+ *
+ * @param masterIndex  The master index to restore into
+ * @param zoneNumber   The zone number
+ *
+ * @return true if all the data for the zone are read
+ **/
+static bool isMasterIndexZoneRestored_006(const MasterIndex *masterIndex,
+                                          unsigned int       zoneNumber)
+{
+  const MasterIndex6 *mi6 = const_container_of(masterIndex, MasterIndex6,
+                                               common);
+  return (isMasterIndexZoneRestored(mi6->miNonHook, zoneNumber)
+          && isMasterIndexZoneRestored(mi6->miHook, zoneNumber));
+}
+
+/***********************************************************************/
+/**
+ * Has the delta list which would hold a chunk name been read while
+ * restoring a master index from an input stream?
+ *
+ * @param masterIndex  The master index to restore into
+ * @param name         The chunk name
+ *
+ * @return true if the delta list for the name has been read
+ **/
+static bool isMasterIndexNameRestored_006(const MasterIndex  *masterIndex,
+                                          const UdsChunkName *name)
+{
+  const MasterIndex6 *mi6 = const_container_of(masterIndex, MasterIndex6,
+                                               common);
+  if (isMasterIndexSample_006(masterIndex, name)) {
+    return isMasterIndexNameRestored(mi6->miHook, name);
+  }
+  return isMasterIndexNameRestored(mi6->miNonHook, name);
+}
+
+/***********************************************************************/
+/**
+ * Abort restoring one zone of a master index from an input stream.
+ *
+ * @param masterIndex  The master index
+ * @param zoneNumber   The zone number
+ **/
+static void abortRestoringMasterIndexZone_006(MasterIndex  *masterIndex,
+                                              unsigned int  zoneNumber)
+{
+  MasterIndex6 *mi6 = container_of(masterIndex, MasterIndex6, common);
+  abortRestoringMasterIndexZone(mi6->miNonHook, zoneNumber);
+  abortRestoringMasterIndexZone(mi6->miHook, zoneNumber);
+}
+
 /***********************************************************************/
 /**
  * Set the open chapter number on a zone.  The master index zone will be
@@ -458,6 +538,34 @@ static void setMasterIndexZoneOpenChapter_006(MasterIndex *masterIndex,
   unlockMutex(mutex);
 }
 
+/***********************************************************************/
+/**
+ * Set the memory budget of the master index.  The budget is shared by the
+ * hook and non-hook indices in proportion to their configured sizes.
+ *
+ * @param masterIndex  The master index
+ * @param budget       The number of bytes of delta list memory the master
+ *                     index may use, or 0 for the memory it was created with
+ **/
+static void setMasterIndexMemoryBudget_006(MasterIndex *masterIndex,
+                                           size_t       budget)
+{
+  MasterIndex6 *mi6 = container_of(masterIndex, MasterIndex6, common);
+  MasterIndexStats nonHookStats, hookStats, dummyStats;
+  getMasterIndexStats(mi6->miNonHook, &nonHookStats, &dummyStats);
+  getMasterIndexStats(mi6->miHook,    &hookStats,    &dummyStats);
+  uint64_t totalSize = (nonHookStats.memoryAllocated
+                        + hookStats.memoryAllocated);
+  size_t hookBudget = 0;
+  if ((budget > 0) && (totalSize > 0)) {
+    // Use a ratio in thousandths to avoid overflowing the product.
+    uint64_t hookShare = hookStats.memoryAllocated * 1000 / totalSize;
+    hookBudget = (uint64_t) budget * hookShare / 1000;
+  }
+  setMasterIndexMemoryBudget(mi6->miNonHook, budget - hookBudget);
+  setMasterIndexMemoryBudget(mi6->miHook, hookBudget);
+}
+
 /***********************************************************************/
 /**
  * Set the open chapter number.  The master index will be modified to index
@@ -733,6 +841,7 @@ int makeMasterIndex006(const Configuration *config, unsigned int numZones,
   }
 
   mi6->common.abortRestoringMasterIndex     = abortRestoringMasterIndex_006;
+  mi6->common.abortRestoringMasterIndexZone = abortRestoringMasterIndexZone_006;
   mi6->common.abortSavingMasterIndex        = abortSavingMasterIndex_006;
   mi6->common.finishSavingMasterIndex       = finishSavingMasterIndex_006;
   mi6->common.freeMasterIndex               = freeMasterIndex_006;
@@ -740,12 +849,16 @@ int makeMasterIndex006(const Configuration *config, unsigned int numZones,
   mi6->common.getMasterIndexRecord          = getMasterIndexRecord_006;
   mi6->common.getMasterIndexStats           = getMasterIndexStats_006;
   mi6->common.getMasterIndexZone            = getMasterIndexZone_006;
+  mi6->common.isMasterIndexNameRestored     = isMasterIndexNameRestored_006;
   mi6->common.isMasterIndexSample           = isMasterIndexSample_006;
+  mi6->common.isMasterIndexZoneRestored     = isMasterIndexZoneRestored_006;
   mi6->common.isRestoringMasterIndexDone    = isRestoringMasterIndexDone_006;
   mi6->common.isSavingMasterIndexDone       = isSavingMasterIndexDone_006;
   mi6->common.lookupMasterIndexName         = lookupMasterIndexName_006;
   mi6->common.lookupMasterIndexSampledName  = lookupMasterIndexSampledName_006;
   mi6->common.restoreDeltaListToMasterIndex = restoreDeltaListToMasterIndex_006;
+  mi6->common.restoreMasterIndexImage       = restoreMasterIndexImage_006;
+  mi6->common.setMasterIndexMemoryBudget    = setMasterIndexMemoryBudget_006;
   mi6->common.setMasterIndexOpenChapter     = setMasterIndexOpenChapter_006;
   mi6->common.setMasterIndexTag             = setMasterIndexTag_006;
   mi6->common.setMasterIndexZoneOpenChapter = setMasterIndexZoneOpenChapter_006;
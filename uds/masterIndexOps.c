@@ -31,6 +31,29 @@
 #include "uds.h"
 #include "zone.h"
 
+/**
+ * The state of one zone of an incremental restore. The mutex is held while
+ * delta lists are being read, which is normally done by the zone thread.
+ **/
+typedef struct {
+  Mutex           mutex;
+  // The reader for the saved delta lists, or NULL once they have all been read
+  BufferedReader *reader;
+  // The buffer into which each saved delta list is read
+  byte           *dlData;
+} RestoreZone;
+
+struct masterIndexRestore {
+  // Covers zonesRestoring
+  Mutex        mutex;
+  // The number of zones still reading their delta lists
+  unsigned int zonesRestoring;
+  // The number of zones
+  unsigned int numZones;
+  // The state of each zone
+  RestoreZone  zones[];
+};
+
 /**********************************************************************/
 static INLINE bool usesSparse(const Configuration *config)
 {
@@ -81,6 +104,79 @@ int computeMasterIndexSaveBlocks(const Configuration *config,
   return UDS_SUCCESS;
 }
 
+/**
+ * Free the state of an incremental restore.
+ *
+ * @param restore  The restore to free
+ **/
+static void freeRestore(MasterIndexRestore *restore)
+{
+  unsigned int z;
+  for (z = 0; z < restore->numZones; z++) {
+    RestoreZone *zone = &restore->zones[z];
+    if (zone->reader != NULL) {
+      freeBufferedReader(zone->reader);
+    }
+    FREE(zone->dlData);
+    destroyMutex(&zone->mutex);
+  }
+  destroyMutex(&restore->mutex);
+  FREE(restore);
+}
+
+/**
+ * Read the headers of a saved master index, keeping the readers so that
+ * each zone can restore its own delta lists later.
+ *
+ * @param portal       The portal to read from
+ * @param masterIndex  The master index
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int startIncrementalRestore(ReadPortal *portal,
+                                   MasterIndex *masterIndex)
+{
+  unsigned int numZones = portal->zones;
+  MasterIndexRestore *restore;
+  int result = ALLOCATE_EXTENDED(MasterIndexRestore, numZones, RestoreZone,
+                                 "master index restore", &restore);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  restore->numZones = numZones;
+
+  result = initMutex(&restore->mutex);
+  BufferedReader *readers[MAX_ZONES];
+  unsigned int z;
+  for (z = 0; (z < numZones) && (result == UDS_SUCCESS); z++) {
+    RestoreZone *zone = &restore->zones[z];
+    result = initMutex(&zone->mutex);
+    if (result == UDS_SUCCESS) {
+      result = ALLOCATE(DELTA_LIST_MAX_BYTE_COUNT, byte, "delta list buffer",
+                        &zone->dlData);
+    }
+    if (result == UDS_SUCCESS) {
+      result = takeBufferedReaderFromPortal(portal, z, &zone->reader);
+      if (result != UDS_SUCCESS) {
+        logErrorWithStringError(result, "cannot read component for zone %u",
+                                z);
+      }
+    }
+    readers[z] = zone->reader;
+  }
+  if (result == UDS_SUCCESS) {
+    result = startRestoringMasterIndex(masterIndex, readers, numZones);
+  }
+  if (result != UDS_SUCCESS) {
+    freeRestore(restore);
+    return result;
+  }
+
+  restore->zonesRestoring = numZones;
+  masterIndex->restore    = restore;
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 static int readMasterIndex(ReadPortal *portal)
 {
@@ -92,6 +188,17 @@ static int readMasterIndex(ReadPortal *portal)
                                    numZones);
   }
 
+  if (numZones == masterIndex->incrementalZones) {
+    return startIncrementalRestore(portal, masterIndex);
+  }
+  if (masterIndex->incrementalZones > 0) {
+    // A zone thread may only restore lists which belong to its own zone, so
+    // lists saved by a different set of zones must all be redistributed now.
+    logInfo("restoring master index saved with %u zones before serving"
+            " requests with %u zones", numZones,
+            masterIndex->incrementalZones);
+  }
+
   BufferedReader *readers[MAX_ZONES];
   unsigned int z;
   for (z = 0; z < numZones; ++z) {
@@ -161,6 +268,32 @@ static const IndexComponentInfo MASTER_INDEX_INFO_DATA = {
 };
 const IndexComponentInfo *const MASTER_INDEX_INFO = &MASTER_INDEX_INFO_DATA;
 
+/**
+ * Read the next saved delta list, or image of delta lists, of a zone and
+ * restore it into a master index.
+ *
+ * @param masterIndex     The master index to restore into
+ * @param dlData          A buffer for reading a single delta list
+ * @param bufferedReader  The buffered reader for the zone
+ *
+ * @return UDS_SUCCESS, UDS_END_OF_FILE after the last list, or an error code
+ **/
+static int restoreNextDeltaLists(MasterIndex    *masterIndex,
+                                 byte dlData[DELTA_LIST_MAX_BYTE_COUNT],
+                                 BufferedReader *bufferedReader)
+{
+  DeltaListSaveInfo dlsi;
+  int result = readSavedDeltaList(&dlsi, dlData, bufferedReader);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  if (dlsi.index == DELTA_LIST_IMAGE_INDEX) {
+    return restoreMasterIndexImage(masterIndex, &dlsi, dlData,
+                                   bufferedReader);
+  }
+  return restoreDeltaListToMasterIndex(masterIndex, &dlsi, dlData);
+}
+
 /**********************************************************************/
 static int restoreMasterIndexBody(BufferedReader **bufferedReaders,
                                   unsigned int     numReaders,
@@ -177,19 +310,13 @@ static int restoreMasterIndexBody(BufferedReader **bufferedReaders,
   unsigned int z;
   for (z = 0; z < numReaders; z++) {
     for (;;) {
-      DeltaListSaveInfo dlsi;
-      result = readSavedDeltaList(&dlsi, dlData, bufferedReaders[z]);
+      result = restoreNextDeltaLists(masterIndex, dlData, bufferedReaders[z]);
       if (result == UDS_END_OF_FILE) {
         break;
       } else if (result != UDS_SUCCESS) {
         abortRestoringMasterIndex(masterIndex);
         return result;
       }
-      result = restoreDeltaListToMasterIndex(masterIndex, &dlsi, dlData);
-      if (result != UDS_SUCCESS) {
-        abortRestoringMasterIndex(masterIndex);
-        return result;
-      }
     }
   }
   if (!isRestoringMasterIndexDone(masterIndex)) {
@@ -215,3 +342,145 @@ int restoreMasterIndex(BufferedReader **bufferedReaders,
   FREE(dlData);
   return result;
 }
+
+/**********************************************************************/
+void setMasterIndexIncrementalRestore(MasterIndex  *masterIndex,
+                                      unsigned int  numZones)
+{
+  masterIndex->incrementalZones = numZones;
+}
+
+/**********************************************************************/
+bool isMasterIndexRestoring(MasterIndex *masterIndex)
+{
+  MasterIndexRestore *restore = masterIndex->restore;
+  if (restore == NULL) {
+    return false;
+  }
+
+  lockMutex(&restore->mutex);
+  bool restoring = (restore->zonesRestoring > 0);
+  unlockMutex(&restore->mutex);
+  return restoring;
+}
+
+/**********************************************************************/
+bool isMasterIndexNameAvailable(const MasterIndex  *masterIndex,
+                                const UdsChunkName *name)
+{
+  const MasterIndexRestore *restore = masterIndex->restore;
+  if (restore == NULL) {
+    return true;
+  }
+
+  // Once a zone has read all its lists, the transfer flags belong to saves.
+  unsigned int zone = getMasterIndexZone(masterIndex, name);
+  return ((restore->zones[zone].reader == NULL)
+          || isMasterIndexNameRestored(masterIndex, name));
+}
+
+/**
+ * Finish the incremental restore of a zone, checking that every delta list
+ * of the zone was read. If not, the zone is emptied.
+ *
+ * @param masterIndex  The master index
+ * @param zoneNumber   The zone which has stopped reading
+ * @param result       The result of reading the last delta list
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int finishRestoringZone(MasterIndex  *masterIndex,
+                               unsigned int  zoneNumber,
+                               int           result)
+{
+  MasterIndexRestore *restore = masterIndex->restore;
+  RestoreZone *zone = &restore->zones[zoneNumber];
+  freeBufferedReader(zone->reader);
+  zone->reader = NULL;
+
+  if (result == UDS_END_OF_FILE) {
+    result = UDS_SUCCESS;
+    if (!isMasterIndexZoneRestored(masterIndex, zoneNumber)) {
+      result = logWarningWithStringError(UDS_CORRUPT_COMPONENT,
+                                         "incomplete delta list data"
+                                         " for zone %u", zoneNumber);
+    }
+  }
+  if (result != UDS_SUCCESS) {
+    logErrorWithStringError(result, "emptying master index zone %u",
+                            zoneNumber);
+    abortRestoringMasterIndexZone(masterIndex, zoneNumber);
+  }
+
+  lockMutex(&restore->mutex);
+  if (--restore->zonesRestoring == 0) {
+    logInfo("finished restoring master index");
+  }
+  unlockMutex(&restore->mutex);
+  return result;
+}
+
+/**********************************************************************/
+int restoreMasterIndexZone(MasterIndex  *masterIndex,
+                           unsigned int  zoneNumber,
+                           unsigned int  maxLists,
+                           bool         *finishedPtr)
+{
+  MasterIndexRestore *restore = masterIndex->restore;
+  if ((restore == NULL) || (zoneNumber >= restore->numZones)) {
+    *finishedPtr = true;
+    return UDS_SUCCESS;
+  }
+
+  RestoreZone *zone = &restore->zones[zoneNumber];
+  int result = UDS_SUCCESS;
+  lockMutex(&zone->mutex);
+  unsigned int count;
+  for (count = 0; (zone->reader != NULL) && (count < maxLists); count++) {
+    result = restoreNextDeltaLists(masterIndex, zone->dlData, zone->reader);
+    if (result != UDS_SUCCESS) {
+      result = finishRestoringZone(masterIndex, zoneNumber, result);
+    }
+  }
+  *finishedPtr = (zone->reader == NULL);
+  unlockMutex(&zone->mutex);
+  return result;
+}
+
+/**********************************************************************/
+int finishRestoringMasterIndex(MasterIndex *masterIndex)
+{
+  MasterIndexRestore *restore = masterIndex->restore;
+  if (restore == NULL) {
+    return UDS_SUCCESS;
+  }
+
+  int firstResult = UDS_SUCCESS;
+  unsigned int z;
+  for (z = 0; z < restore->numZones; z++) {
+    bool finished;
+    int result = restoreMasterIndexZone(masterIndex, z, UINT_MAX, &finished);
+    if (firstResult == UDS_SUCCESS) {
+      firstResult = result;
+    }
+  }
+  return firstResult;
+}
+
+/**********************************************************************/
+void abandonMasterIndexRestore(MasterIndex *masterIndex)
+{
+  if (masterIndex->restore != NULL) {
+    abortRestoringMasterIndex(masterIndex);
+    freeMasterIndexRestore(masterIndex);
+  }
+}
+
+/**********************************************************************/
+void freeMasterIndexRestore(MasterIndex *masterIndex)
+{
+  if (masterIndex->restore != NULL) {
+    freeRestore(masterIndex->restore);
+    masterIndex->restore = NULL;
+  }
+}
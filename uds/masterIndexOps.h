@@ -33,6 +33,7 @@ extern const IndexComponentInfo *const MASTER_INDEX_INFO;
 extern unsigned int minMasterIndexDeltaLists;
 
 typedef struct masterIndex MasterIndex;
+typedef struct masterIndexRestore MasterIndexRestore;
 
 typedef struct {
   size_t memoryAllocated;  // Number of bytes allocated
@@ -90,6 +91,8 @@ typedef struct {
 
 struct masterIndex {
   void (*abortRestoringMasterIndex)(MasterIndex *masterIndex);
+  void (*abortRestoringMasterIndexZone)(MasterIndex *masterIndex,
+                                        unsigned int zoneNumber);
   int (*abortSavingMasterIndex)(const MasterIndex *masterIndex,
                                 unsigned int zoneNumber);
   int (*finishSavingMasterIndex)(const MasterIndex *masterIndex,
@@ -104,8 +107,12 @@ struct masterIndex {
                               MasterIndexStats *sparse);
   unsigned int (*getMasterIndexZone)(const MasterIndex *masterIndex,
                                      const UdsChunkName *name);
+  bool (*isMasterIndexNameRestored)(const MasterIndex *masterIndex,
+                                    const UdsChunkName *name);
   bool (*isMasterIndexSample)(const MasterIndex *masterIndex,
                               const UdsChunkName *name);
+  bool (*isMasterIndexZoneRestored)(const MasterIndex *masterIndex,
+                                    unsigned int zoneNumber);
   bool (*isRestoringMasterIndexDone)(const MasterIndex *masterIndex);
   bool (*isSavingMasterIndexDone)(const MasterIndex *masterIndex,
                                   unsigned int zoneNumber);
@@ -118,6 +125,12 @@ struct masterIndex {
   int (*restoreDeltaListToMasterIndex)(MasterIndex *masterIndex,
                                        const DeltaListSaveInfo *dlsi,
                                        const byte data[DELTA_LIST_MAX_BYTE_COUNT]);
+  int (*restoreMasterIndexImage)(MasterIndex *masterIndex,
+                                 const DeltaListSaveInfo *dlsi,
+                                 byte data[DELTA_LIST_MAX_BYTE_COUNT],
+                                 BufferedReader *bufferedReader);
+  void (*setMasterIndexMemoryBudget)(MasterIndex *masterIndex,
+                                     size_t budget);
   void (*setMasterIndexOpenChapter)(MasterIndex *masterIndex,
                                     uint64_t virtualChapter);
   void (*setMasterIndexTag)(MasterIndex *masterIndex, byte tag);
@@ -130,6 +143,12 @@ struct masterIndex {
   int (*startSavingMasterIndex)(const MasterIndex *masterIndex,
                                 unsigned int zoneNumber,
                                 BufferedWriter *bufferedWriter);
+
+  // The number of zones which should restore their own delta lists when the
+  // master index is next loaded, or 0 to restore them all while loading
+  unsigned int        incrementalZones;
+  // The incremental restore started by the last load, if any
+  MasterIndexRestore *restore;
 };
 
 /**
@@ -184,6 +203,91 @@ int restoreMasterIndex(BufferedReader **readers,
                        MasterIndex     *masterIndex)
   __attribute__((warn_unused_result));
 
+/**
+ * Arrange for the next load of a master index to read only the headers of
+ * the saved state, leaving each zone to restore its own delta lists with
+ * restoreMasterIndexZone() once the index is open. This is only done if the
+ * saved state has the same number of zones, since each zone then reads its
+ * lists from its own part of the saved state.
+ *
+ * @param masterIndex  The master index
+ * @param numZones     The number of zones of the master index, or 0 to
+ *                     restore all the delta lists while loading
+ **/
+void setMasterIndexIncrementalRestore(MasterIndex  *masterIndex,
+                                      unsigned int  numZones);
+
+/**
+ * Check whether any zone of a master index is still restoring its delta
+ * lists.
+ *
+ * @param masterIndex  The master index
+ *
+ * @return true if an incremental restore is in progress
+ **/
+bool isMasterIndexRestoring(MasterIndex *masterIndex)
+  __attribute__((warn_unused_result));
+
+/**
+ * Check whether the master index entries for a chunk name are available,
+ * which is the case unless an incremental restore has yet to read the delta
+ * list for the name. A chunk name which is not available must neither be
+ * looked up nor added to the master index.
+ *
+ * @param masterIndex  The master index
+ * @param name         The chunk name
+ *
+ * @return true if the name may be used
+ **/
+bool isMasterIndexNameAvailable(const MasterIndex  *masterIndex,
+                                const UdsChunkName *name)
+  __attribute__((warn_unused_result));
+
+/**
+ * Restore some of the delta lists of one zone of an incremental restore.
+ * This must only be called from the thread of the zone, or while the zone
+ * is otherwise idle. If the restore of the zone fails, the zone is emptied
+ * so that the index remains usable.
+ *
+ * @param [in]  masterIndex  The master index
+ * @param [in]  zoneNumber   The zone to restore
+ * @param [in]  maxLists     The maximum number of delta lists to read
+ * @param [out] finishedPtr  Set to true if the zone is now fully restored
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int restoreMasterIndexZone(MasterIndex  *masterIndex,
+                           unsigned int  zoneNumber,
+                           unsigned int  maxLists,
+                           bool         *finishedPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Restore all the delta lists which an incremental restore has not read
+ * yet. This must only be called while no requests are being processed.
+ *
+ * @param masterIndex  The master index
+ *
+ * @return UDS_SUCCESS or the first error encountered
+ **/
+int finishRestoringMasterIndex(MasterIndex *masterIndex)
+  __attribute__((warn_unused_result));
+
+/**
+ * Abandon an incremental restore before any zone has started to restore its
+ * delta lists, emptying the master index.
+ *
+ * @param masterIndex  The master index
+ **/
+void abandonMasterIndexRestore(MasterIndex *masterIndex);
+
+/**
+ * Free the state of an incremental restore.
+ *
+ * @param masterIndex  The master index
+ **/
+void freeMasterIndexRestore(MasterIndex *masterIndex);
+
 /**
  * Abort restoring a master index from an input stream.
  *
@@ -194,6 +298,18 @@ static INLINE void abortRestoringMasterIndex(MasterIndex *masterIndex)
   masterIndex->abortRestoringMasterIndex(masterIndex);
 }
 
+/**
+ * Abort restoring one zone of a master index from an input stream.
+ *
+ * @param masterIndex  The master index
+ * @param zoneNumber   The zone number
+ **/
+static INLINE void abortRestoringMasterIndexZone(MasterIndex  *masterIndex,
+                                                 unsigned int  zoneNumber)
+{
+  masterIndex->abortRestoringMasterIndexZone(masterIndex, zoneNumber);
+}
+
 /**
  * Abort saving a master index to an output stream.  If an error occurred
  * asynchronously during the save operation, it will be dropped.
@@ -232,6 +348,7 @@ static INLINE int finishSavingMasterIndex(const MasterIndex *masterIndex,
  **/
 static INLINE void freeMasterIndex(MasterIndex *masterIndex)
 {
+  freeMasterIndexRestore(masterIndex);
   masterIndex->freeMasterIndex(masterIndex);
 }
 
@@ -307,6 +424,21 @@ static INLINE unsigned int getMasterIndexZone(const MasterIndex *masterIndex,
   return masterIndex->getMasterIndexZone(masterIndex, name);
 }
 
+/**
+ * Has the delta list which would hold a chunk name been read while restoring
+ * a master index from an input stream?
+ *
+ * @param masterIndex  The master index to restore into
+ * @param name         The chunk name
+ *
+ * @return true if the delta list for the name has been read
+ **/
+static INLINE bool isMasterIndexNameRestored(const MasterIndex *masterIndex,
+                                             const UdsChunkName *name)
+{
+  return masterIndex->isMasterIndexNameRestored(masterIndex, name);
+}
+
 /**
  * Determine whether a given chunk name is a hook.
  *
@@ -321,6 +453,21 @@ static INLINE bool isMasterIndexSample(const MasterIndex *masterIndex,
   return masterIndex->isMasterIndexSample(masterIndex, name);
 }
 
+/**
+ * Have all the data for one zone been read while restoring a master index
+ * from an input stream?
+ *
+ * @param masterIndex  The master index to restore into
+ * @param zoneNumber   The zone number
+ *
+ * @return true if all the data for the zone are read
+ **/
+static INLINE bool isMasterIndexZoneRestored(const MasterIndex *masterIndex,
+                                             unsigned int zoneNumber)
+{
+  return masterIndex->isMasterIndexZoneRestored(masterIndex, zoneNumber);
+}
+
 /**
  * Have all the data been read while restoring a master index from an input
  * stream?
@@ -424,6 +571,45 @@ static INLINE int restoreDeltaListToMasterIndex(MasterIndex *masterIndex,
   return masterIndex->restoreDeltaListToMasterIndex(masterIndex, dlsi, data);
 }
 
+/**
+ * Restore an image of saved delta lists
+ *
+ * @param masterIndex     The master index to restore into
+ * @param dlsi            The DeltaListSaveInfo which introduced the image
+ * @param data            A buffer for reading a single delta list
+ * @param bufferedReader  The buffered reader to read the image from
+ *
+ * @return error code or UDS_SUCCESS
+ **/
+static INLINE int restoreMasterIndexImage(MasterIndex *masterIndex,
+                                          const DeltaListSaveInfo *dlsi,
+                                          byte data[DELTA_LIST_MAX_BYTE_COUNT],
+                                          BufferedReader *bufferedReader)
+{
+  return masterIndex->restoreMasterIndexImage(masterIndex, dlsi, data,
+                                              bufferedReader);
+}
+
+/**
+ * Set the memory budget of the master index.  The budget is not met at
+ * once: each time a zone closes a chapter, it expires a few more of its
+ * oldest chapters early, until its entries fit in its share of the budget
+ * and its delta lists can be moved into a smaller memory array.  Entries
+ * for the expired chapters are no longer found, just as if the index had
+ * been created with fewer chapters.
+ *
+ * This must be called before any zone thread is using the master index.
+ *
+ * @param masterIndex  The master index
+ * @param budget       The number of bytes of delta list memory the master
+ *                     index may use, or 0 for the memory it was created with
+ **/
+static INLINE void setMasterIndexMemoryBudget(MasterIndex *masterIndex,
+                                              size_t       budget)
+{
+  masterIndex->setMasterIndexMemoryBudget(masterIndex, budget);
+}
+
 /**
  * Set the open chapter number.  The master index will be modified to index
  * the proper number of chapters ending with the new open chapter.
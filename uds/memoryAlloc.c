@@ -42,3 +42,139 @@ int memdup(const void *buffer, size_t size, const char *what, void *dupPtr)
   *((void **) dupPtr) = dup;
   return UDS_SUCCESS;
 }
+
+/**
+ * A chunk of arena memory. The objects allocated from the chunk follow the
+ * header.
+ **/
+typedef struct arenaChunk {
+  struct arenaChunk *next;
+} __attribute__((aligned(CACHE_LINE_BYTES))) ArenaChunk;
+
+struct memoryArena {
+  /** The chunks of the arena, most recent first */
+  ArenaChunk *chunks;
+  /** The next free byte of the current chunk */
+  byte       *next;
+  /** The end of the current chunk */
+  byte       *limit;
+  /** The number of bytes to allocate for each chunk */
+  size_t      chunkSize;
+  /** The node to allocate chunks from */
+  int         node;
+};
+
+/**********************************************************************/
+int makeMemoryArena(size_t        chunkSize,
+                    int           node,
+                    const char   *what,
+                    MemoryArena **arenaPtr)
+{
+  MemoryArena *arena;
+  int result = ALLOCATE_ON_NODE(1, MemoryArena, node, what, &arena);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  arena->chunkSize = chunkSize;
+  arena->node      = node;
+  *arenaPtr = arena;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+void freeMemoryArena(MemoryArena **arenaPtr)
+{
+  MemoryArena *arena = *arenaPtr;
+  if (arena == NULL) {
+    return;
+  }
+
+  while (arena->chunks != NULL) {
+    ArenaChunk *chunk = arena->chunks;
+    arena->chunks = chunk->next;
+    FREE(chunk);
+  }
+
+  FREE(arena);
+  *arenaPtr = NULL;
+}
+
+/**
+ * Add a chunk to an arena.
+ *
+ * @param arena        The arena
+ * @param size         The number of bytes the chunk must hold
+ * @param makeCurrent  Whether to allocate from the chunk from now on
+ * @param what         What is being allocated (for error logging)
+ * @param ptr          A pointer to hold the start of the chunk's free space
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int addArenaChunk(MemoryArena  *arena,
+                         size_t        size,
+                         bool          makeCurrent,
+                         const char   *what,
+                         byte        **ptr)
+{
+  if (size > (SIZE_MAX - sizeof(ArenaChunk))) {
+    size = SIZE_MAX - sizeof(ArenaChunk);
+  }
+
+  ArenaChunk *chunk;
+  int result = allocateMemoryOnNode(sizeof(ArenaChunk) + size,
+                                    __alignof__(ArenaChunk), arena->node,
+                                    what, &chunk);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  byte *start = (byte *) (chunk + 1);
+  if (makeCurrent || (arena->chunks == NULL)) {
+    chunk->next   = arena->chunks;
+    arena->chunks = chunk;
+    if (makeCurrent) {
+      arena->next  = start;
+      arena->limit = start + size;
+    }
+  } else {
+    // Keep allocating from the current chunk, which is at the head.
+    chunk->next         = arena->chunks->next;
+    arena->chunks->next = chunk;
+  }
+
+  *ptr = start;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+int allocateFromArena(MemoryArena *arena,
+                      size_t       size,
+                      size_t       align,
+                      const char  *what,
+                      void        *ptr)
+{
+  if (align > __alignof__(ArenaChunk)) {
+    return UDS_INVALID_ARGUMENT;
+  }
+
+  // An object more than a quarter of a chunk gets a chunk to itself, so that
+  // big objects don't waste the rest of a partly used chunk.
+  if (size > (arena->chunkSize / 4)) {
+    return addArenaChunk(arena, size, false, what, (byte **) ptr);
+  }
+
+  uintptr_t mask = align - 1;
+  byte *start = (byte *) (((uintptr_t) arena->next + mask) & ~mask);
+  if ((arena->next == NULL) || (start > arena->limit)
+      || (size > (size_t) (arena->limit - start))) {
+    int result = addArenaChunk(arena, arena->chunkSize, true, what, &start);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+
+  arena->next = start + size;
+  *((void **) ptr) = start;
+  return UDS_SUCCESS;
+}
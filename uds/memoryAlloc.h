@@ -29,6 +29,9 @@
 #include "memoryDefs.h"
 #include "permassert.h"
 
+/** The memory node argument meaning that memory may come from any node */
+#define ANY_MEMORY_NODE (-1)
+
 /**
  * Allocate storage based on memory size and  alignment, logging an error if
  * the allocation fails. The memory will be zeroed.
@@ -43,6 +46,26 @@
 int allocateMemory(size_t size, size_t align, const char *what, void *ptr)
   __attribute__((warn_unused_result));
 
+/**
+ * Allocate storage based on memory size and alignment, preferring memory on
+ * a particular NUMA node, and logging an error if the allocation fails. The
+ * memory will be zeroed.
+ *
+ * @param size   The size of an object
+ * @param align  The required alignment
+ * @param node   The node to allocate from, or ANY_MEMORY_NODE
+ * @param what   What is being allocated (for error logging)
+ * @param ptr    A pointer to hold the allocated memory
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int allocateMemoryOnNode(size_t      size,
+                         size_t      align,
+                         int         node,
+                         const char *what,
+                         void       *ptr)
+  __attribute__((warn_unused_result));
+
 /**
  * Free storage
  *
@@ -70,17 +93,19 @@ void freeMemory(void *ptr);
  * @param size    The size of an object
  * @param extra   The number of additional bytes to allocate
  * @param align   The required alignment
+ * @param node    The node to allocate from, or ANY_MEMORY_NODE
  * @param what    What is being allocated (for error logging)
  * @param ptr     A pointer to hold the allocated memory
  *
  * @return UDS_SUCCESS or an error code
  **/
-static INLINE int doAllocation(size_t      count,
-                               size_t      size,
-                               size_t      extra,
-                               size_t      align,
-                               const char *what,
-                               void       *ptr)
+static INLINE int doAllocationOnNode(size_t      count,
+                                     size_t      size,
+                                     size_t      extra,
+                                     size_t      align,
+                                     int         node,
+                                     const char *what,
+                                     void       *ptr)
 {
   size_t totalSize = count * size + extra;
   // Overflow check:
@@ -95,7 +120,31 @@ static INLINE int doAllocation(size_t      count,
     totalSize = SIZE_MAX;
   }
 
-  return allocateMemory(totalSize, align, what, ptr);
+  return allocateMemoryOnNode(totalSize, align, node, what, ptr);
+}
+
+/**
+ * Allocate storage based on element counts, sizes, and alignment, from any
+ * memory node.
+ *
+ * @param count   The number of objects to allocate
+ * @param size    The size of an object
+ * @param extra   The number of additional bytes to allocate
+ * @param align   The required alignment
+ * @param what    What is being allocated (for error logging)
+ * @param ptr     A pointer to hold the allocated memory
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static INLINE int doAllocation(size_t      count,
+                               size_t      size,
+                               size_t      extra,
+                               size_t      align,
+                               const char *what,
+                               void       *ptr)
+{
+  return doAllocationOnNode(count, size, extra, align, ANY_MEMORY_NODE, what,
+                            ptr);
 }
 
 /**
@@ -132,6 +181,22 @@ int reallocateMemory(void       *ptr,
 #define ALLOCATE(COUNT, TYPE, WHAT, PTR) \
   doAllocation(COUNT, sizeof(TYPE), 0, __alignof__(TYPE), WHAT, PTR)
 
+/**
+ * Allocate storage for objects of a specified type, preferring memory on a
+ * given NUMA node, with error handling.
+ *
+ * @param COUNT  The number of objects to allocate
+ * @param TYPE   The type of objects to allocate
+ * @param NODE   The node to allocate from, or ANY_MEMORY_NODE
+ * @param WHAT   What is being allocated (for error logging)
+ * @param PTR    A pointer to hold the allocated memory
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+#define ALLOCATE_ON_NODE(COUNT, TYPE, NODE, WHAT, PTR) \
+  doAllocationOnNode(COUNT, sizeof(TYPE), 0, __alignof__(TYPE), NODE, WHAT, \
+                     PTR)
+
 /**
  * Allocate one object of an indicated type, followed by one or more
  * elements of a second type, logging an error if the allocation
@@ -183,6 +248,118 @@ static INLINE int allocateCacheAligned(size_t      size,
   return allocateMemory(size, CACHE_LINE_BYTES, what, ptr);
 }
 
+/**
+ * Allocate storage for a large table which is probed at random, such as the
+ * delta list memory of the master index, logging an error if the allocation
+ * fails. Where the platform supports it the memory is mapped with huge pages
+ * to reduce TLB misses; otherwise this is the same as allocateMemory(). The
+ * memory will be zeroed, and must be freed with FREE().
+ *
+ * @param size  The number of bytes to allocate
+ * @param what  What is being allocated (for error logging)
+ * @param ptr   A pointer to hold the allocated memory
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int allocateHugeMemory(size_t size, const char *what, void *ptr)
+  __attribute__((warn_unused_result));
+
+/**
+ * An arena from which many small, long-lived objects may be carved without
+ * a separate allocation for each. Objects allocated from an arena lie next
+ * to one another in memory, and are all freed together when the arena is
+ * freed; they must never be passed to FREE(). An arena is not thread-safe.
+ **/
+typedef struct memoryArena MemoryArena;
+
+/**
+ * Make a memory arena.
+ *
+ * @param chunkSize  The number of bytes to allocate for the arena at a time
+ * @param node       The node to allocate from, or ANY_MEMORY_NODE
+ * @param what       What the arena is for (for error logging)
+ * @param arenaPtr   A pointer to hold the new arena
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int makeMemoryArena(size_t        chunkSize,
+                    int           node,
+                    const char   *what,
+                    MemoryArena **arenaPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free a memory arena and everything allocated from it, and null out the
+ * reference to it.
+ *
+ * @param arenaPtr  The reference to the arena to free
+ **/
+void freeMemoryArena(MemoryArena **arenaPtr);
+
+/**
+ * Allocate zeroed storage from an arena, logging an error if the allocation
+ * fails. Requests too large to share a chunk are given a chunk of their own.
+ *
+ * @param arena  The arena to allocate from
+ * @param size   The size of an object
+ * @param align  The required alignment, which must be a power of two
+ * @param what   What is being allocated (for error logging)
+ * @param ptr    A pointer to hold the allocated memory
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int allocateFromArena(MemoryArena *arena,
+                      size_t       size,
+                      size_t       align,
+                      const char  *what,
+                      void        *ptr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Allocate one object of an indicated type, followed by zero or more
+ * elements of a second type, from an arena. The memory will be zeroed.
+ *
+ * @param ARENA  The arena to allocate from
+ * @param TYPE1  The type of the primary object to allocate
+ * @param COUNT  The number of array objects to allocate
+ * @param TYPE2  The type of array objects to allocate
+ * @param WHAT   What is being allocated (for error logging)
+ * @param PTR    A pointer to hold the allocated memory
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+#define ARENA_ALLOCATE_EXTENDED(ARENA, TYPE1, COUNT, TYPE2, WHAT, PTR)     \
+  __extension__ ({                                                        \
+      TYPE1 **_ptr = (PTR);                                               \
+      STATIC_ASSERT(__alignof__(TYPE1) >= __alignof__(TYPE2));            \
+      size_t _count = (COUNT);                                            \
+      size_t _size = sizeof(TYPE1) + (_count * sizeof(TYPE2));            \
+      if (_count > ((SIZE_MAX - sizeof(TYPE1)) / sizeof(TYPE2))) {        \
+        _size = SIZE_MAX;                                                 \
+      }                                                                   \
+      int _result = allocateFromArena(ARENA, _size, __alignof__(TYPE1),   \
+                                      WHAT, _ptr);                        \
+      _result;                                                            \
+    })
+
+/**
+ * Allocate one object of an indicated type from an arena. The memory will
+ * be zeroed.
+ *
+ * @param ARENA  The arena to allocate from
+ * @param TYPE   The type of object to allocate
+ * @param WHAT   What is being allocated (for error logging)
+ * @param PTR    A pointer to hold the allocated memory
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+#define ARENA_ALLOCATE(ARENA, TYPE, WHAT, PTR)                           \
+  __extension__ ({                                                       \
+      TYPE **_ptr = (PTR);                                               \
+      allocateFromArena(ARENA, sizeof(TYPE), __alignof__(TYPE), WHAT,    \
+                        _ptr);                                           \
+    })
+
 /**
  * Duplicate a string.
  *
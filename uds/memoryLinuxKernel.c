@@ -20,8 +20,10 @@
  */
 
 #include <linux/delay.h>
+#include <linux/hash.h>
 #include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
 #include <linux/sched/mm.h>
 #include <linux/slab.h>
 #include <linux/version.h>
@@ -80,85 +82,166 @@ void unregisterAllocatingThread(void)
  * used.
  */
 
-// We allocate very few large objects, and allocation/deallocation isn't done
-// in a performance-critical stage for us, so a linked list should be fine.
+// Each vmalloc block is recorded in a hash table keyed by its address, so
+// that freeing it does not have to search. Each bucket has its own lock.
 typedef struct vmallocBlockInfo {
   void                    *ptr;
   size_t                   size;
   struct vmallocBlockInfo *next;
 } VmallocBlockInfo;
 
-static struct {
+enum {
+  VMALLOC_HASH_BITS = 8,
+  VMALLOC_BUCKETS   = 1 << VMALLOC_HASH_BITS,
+  // How many bytes of allocation a CPU may do before its count is added to
+  // the global total used to track the peak usage.
+  USAGE_BATCH_BYTES = 1 << 20,
+};
+
+typedef struct vmallocBucket {
   spinlock_t        lock;
-  size_t            kmallocBlocks;
-  size_t            kmallocBytes;
-  size_t            vmallocBlocks;
-  size_t            vmallocBytes;
-  size_t            peakBytes;
-  VmallocBlockInfo *vmallocList;
-} memoryStats __cacheline_aligned;
+  VmallocBlockInfo *list;
+} __cacheline_aligned VmallocBucket;
 
-/*****************************************************************************/
-static void updatePeakUsage(void)
+/*
+ * The block and byte counts are kept per CPU so that no allocation touches a
+ * shared cache line; they are summed only when reported. The counts on any
+ * one CPU may go negative, as memory is often freed on a different CPU from
+ * the one which allocated it.
+ */
+typedef struct memoryCounters {
+  long kmallocBlocks;
+  long kmallocBytes;
+  long vmallocBlocks;
+  long vmallocBytes;
+  long unfoldedBytes;
+} MemoryCounters;
+
+static DEFINE_PER_CPU(MemoryCounters, memoryCounters);
+
+static struct {
+  // The total of the bytes folded in from the per-CPU counts
+  atomic_long_t foldedBytes;
+  // The largest value foldedBytes has reached
+  atomic_long_t peakBytes;
+} memoryUsage __cacheline_aligned;
+
+static VmallocBucket vmallocBuckets[VMALLOC_BUCKETS];
+
+/**
+ * Record the largest total yet seen. Since the total is only updated in
+ * batches, the peak may be off by up to USAGE_BATCH_BYTES per CPU.
+ *
+ * @param totalBytes  The current total of the folded byte counts
+ **/
+static void updatePeakUsage(long totalBytes)
+{
+  long peak = atomic_long_read(&memoryUsage.peakBytes);
+  while (totalBytes > peak) {
+    long old = atomic_long_cmpxchg(&memoryUsage.peakBytes, peak, totalBytes);
+    if (old == peak) {
+      break;
+    }
+    peak = old;
+  }
+}
+
+/**
+ * Update the counts of the current CPU.
+ *
+ * @param vmalloc  Whether the block is a vmalloc block
+ * @param blocks   The change in the number of blocks
+ * @param bytes    The change in the number of bytes
+ **/
+static void updateCounters(bool vmalloc, long blocks, long bytes)
 {
-  size_t totalBytes = memoryStats.kmallocBytes + memoryStats.vmallocBytes;
-  if (totalBytes > memoryStats.peakBytes) {
-    memoryStats.peakBytes = totalBytes;
+  unsigned long flags;
+  local_irq_save(flags);
+  MemoryCounters *counters = this_cpu_ptr(&memoryCounters);
+  if (vmalloc) {
+    counters->vmallocBlocks += blocks;
+    counters->vmallocBytes  += bytes;
+  } else {
+    counters->kmallocBlocks += blocks;
+    counters->kmallocBytes  += bytes;
+  }
+  counters->unfoldedBytes += bytes;
+  if ((counters->unfoldedBytes >= USAGE_BATCH_BYTES)
+      || (counters->unfoldedBytes <= -USAGE_BATCH_BYTES)) {
+    long total = atomic_long_add_return(counters->unfoldedBytes,
+                                        &memoryUsage.foldedBytes);
+    counters->unfoldedBytes = 0;
+    updatePeakUsage(total);
+  }
+  local_irq_restore(flags);
+}
+
+/**
+ * Sum the counts of all CPUs.
+ *
+ * @param totals  The counters to hold the sums
+ **/
+static void sumCounters(MemoryCounters *totals)
+{
+  memset(totals, 0, sizeof(*totals));
+  int cpu;
+  for_each_possible_cpu(cpu) {
+    MemoryCounters *counters = per_cpu_ptr(&memoryCounters, cpu);
+    totals->kmallocBlocks += READ_ONCE(counters->kmallocBlocks);
+    totals->kmallocBytes  += READ_ONCE(counters->kmallocBytes);
+    totals->vmallocBlocks += READ_ONCE(counters->vmallocBlocks);
+    totals->vmallocBytes  += READ_ONCE(counters->vmallocBytes);
   }
 }
 
+/*****************************************************************************/
+static INLINE VmallocBucket *getVmallocBucket(const void *ptr)
+{
+  return &vmallocBuckets[hash_ptr(ptr, VMALLOC_HASH_BITS)];
+}
+
 /*****************************************************************************/
 static void addKmallocBlock(size_t size)
 {
-  unsigned long flags;
-  spin_lock_irqsave(&memoryStats.lock, flags);
-  memoryStats.kmallocBlocks++;
-  memoryStats.kmallocBytes += size;
-  updatePeakUsage();
-  spin_unlock_irqrestore(&memoryStats.lock, flags);
+  updateCounters(false, 1, size);
 }
 
 /*****************************************************************************/
 static void removeKmallocBlock(size_t size)
 {
-  unsigned long flags;
-  spin_lock_irqsave(&memoryStats.lock, flags);
-  memoryStats.kmallocBlocks--;
-  memoryStats.kmallocBytes -= size;
-  spin_unlock_irqrestore(&memoryStats.lock, flags);
+  updateCounters(false, -1, -(long) size);
 }
 
 /*****************************************************************************/
 static void addVmallocBlock(VmallocBlockInfo *block)
 {
+  VmallocBucket *bucket = getVmallocBucket(block->ptr);
   unsigned long flags;
-  spin_lock_irqsave(&memoryStats.lock, flags);
-  block->next = memoryStats.vmallocList;
-  memoryStats.vmallocList = block;
-  memoryStats.vmallocBlocks++;
-  memoryStats.vmallocBytes += block->size;
-  updatePeakUsage();
-  spin_unlock_irqrestore(&memoryStats.lock, flags);
+  spin_lock_irqsave(&bucket->lock, flags);
+  block->next = bucket->list;
+  bucket->list = block;
+  spin_unlock_irqrestore(&bucket->lock, flags);
+  updateCounters(true, 1, block->size);
 }
 
 /*****************************************************************************/
 static void removeVmallocBlock(void *ptr)
 {
+  VmallocBucket *bucket = getVmallocBucket(ptr);
   VmallocBlockInfo *block, **blockPtr;
   unsigned long flags;
-  spin_lock_irqsave(&memoryStats.lock, flags);
-  for (blockPtr = &memoryStats.vmallocList;
+  spin_lock_irqsave(&bucket->lock, flags);
+  for (blockPtr = &bucket->list;
        (block = *blockPtr) != NULL;
        blockPtr = &block->next) {
     if (block->ptr == ptr) {
       *blockPtr = block->next;
-      memoryStats.vmallocBlocks--;
-      memoryStats.vmallocBytes -= block->size;
       break;
     }
   }
-  spin_unlock_irqrestore(&memoryStats.lock, flags);
+  spin_unlock_irqrestore(&bucket->lock, flags);
   if (block != NULL) {
+    updateCounters(true, -1, -(long) block->size);
     FREE(block);
   } else {
     logInfo("attempting to remove ptr %" PRIptr " not found in vmalloc list",
@@ -193,11 +276,10 @@ static void removeVmallocBlock(void *ptr)
  *
  * The kmalloc/vmalloc boundary is set at 4KB, and kmalloc gets the 4KB
  * requests.  There is no strong reason for favoring either kmalloc or vmalloc
- * for 4KB requests, except that the keeping of vmalloc statistics uses a
- * linked list implementation.  Using a simple test, this choice of boundary
- * results in 132 vmalloc calls.  Using vmalloc for requests of exactly 4KB
- * results in an additional 6374 vmalloc calls, which will require a change to
- * the code that tracks vmalloc statistics.
+ * for 4KB requests, except that each vmalloc block needs a small tracking
+ * record of its own.  Using a simple test, this choice of boundary results in
+ * 132 vmalloc calls.  Using vmalloc for requests of exactly 4KB results in an
+ * additional 6374 vmalloc calls.
  *
  * @param size  How many bytes to allocate
  **/
@@ -208,6 +290,35 @@ static INLINE bool useKmalloc(size_t size)
 
 /*****************************************************************************/
 int allocateMemory(size_t size, size_t align, const char *what, void *ptr)
+{
+  return allocateMemoryOnNode(size, align, ANY_MEMORY_NODE, what, ptr);
+}
+
+/**
+ * Make one attempt to allocate zeroed virtually contiguous memory.
+ *
+ * @param size      The size to allocate
+ * @param gfpFlags  The allocation flags
+ * @param node      The node to allocate from, or ANY_MEMORY_NODE
+ *
+ * @return The memory, or NULL
+ **/
+static void *vmallocOnNode(size_t size, gfp_t gfpFlags, int node)
+{
+  if (node == ANY_MEMORY_NODE) {
+    return __vmalloc(size, gfpFlags, PAGE_KERNEL);
+  }
+  // There is no exported node-specific form of __vmalloc(), so the retry
+  // and warning flags can't be passed through here.
+  return vzalloc_node(size, node);
+}
+
+/*****************************************************************************/
+int allocateMemoryOnNode(size_t      size,
+                         size_t      align,
+                         int         node,
+                         const char *what,
+                         void       *ptr)
 {
   if (ptr == NULL) {
     return UDS_INVALID_ARGUMENT;
@@ -243,7 +354,7 @@ int allocateMemory(size_t size, size_t align, const char *what, void *ptr)
   unsigned long startTime = jiffies;
   void *p = NULL;
   if (useKmalloc(size) && (align < PAGE_SIZE)) {
-    p = kmalloc(size, gfpFlags | __GFP_NOWARN);
+    p = kmalloc_node(size, gfpFlags | __GFP_NOWARN, node);
     if (p == NULL) {
       /*
        * If we had just done kmalloc(size, gfpFlags) it is possible that the
@@ -255,7 +366,7 @@ int allocateMemory(size_t size, size_t align, const char *what, void *ptr)
        * all that we need.
        */
       msleep(1);
-      p = kmalloc(size, gfpFlags);
+      p = kmalloc_node(size, gfpFlags, node);
     }
     if (p != NULL) {
       addKmallocBlock(ksize(p));
@@ -279,7 +390,7 @@ int allocateMemory(size_t size, size_t align, const char *what, void *ptr)
        * retries will succeed.
        */
       for (;;) {
-        p = __vmalloc(size, gfpFlags | __GFP_NOWARN, PAGE_KERNEL);
+        p = vmallocOnNode(size, gfpFlags | __GFP_NOWARN, node);
         // Try again unless we succeeded or more than 1 second has elapsed.
         if ((p != NULL) || (jiffies_to_msecs(jiffies - startTime) > 1000)) {
           break;
@@ -288,7 +399,7 @@ int allocateMemory(size_t size, size_t align, const char *what, void *ptr)
       }
       if (p == NULL) {
         // Try one more time, logging a failure for this call.
-        p = __vmalloc(size, gfpFlags, PAGE_KERNEL);
+        p = vmallocOnNode(size, gfpFlags, node);
       }
       if (p == NULL) {
         FREE(block);
@@ -314,6 +425,37 @@ int allocateMemory(size_t size, size_t align, const char *what, void *ptr)
   return UDS_SUCCESS;
 }
 
+/*****************************************************************************/
+int allocateHugeMemory(size_t size, const char *what, void *ptr)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,18,0)
+  /*
+   * vmalloc_huge() maps the allocation with PMD-sized pages where the
+   * architecture allows it, and quietly uses small pages for any part it
+   * cannot. It does not retry as hard as the path in allocateMemoryOnNode(),
+   * so if it fails, or if this thread must not do I/O to reclaim memory,
+   * fall back to an ordinary allocation.
+   */
+  if ((ptr != NULL) && (size >= PMD_SIZE) && allocationsAllowed()) {
+    VmallocBlockInfo *block;
+    if (ALLOCATE(1, VmallocBlockInfo, __func__, &block) == UDS_SUCCESS) {
+      void *p = vmalloc_huge(size, GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN);
+      if (p != NULL) {
+        block->ptr = p;
+        block->size = PAGE_ALIGN(size);
+        addVmallocBlock(block);
+        *((void **) ptr) = p;
+        return UDS_SUCCESS;
+      }
+      FREE(block);
+      logInfo("Could not allocate %zu bytes for %s with huge pages",
+              size, what);
+    }
+  }
+#endif
+  return allocateMemory(size, 0, what, ptr);
+}
+
 /*****************************************************************************/
 void *allocateMemoryNowait(size_t      size,
                            const char *what __attribute__((unused)))
@@ -368,11 +510,28 @@ int reallocateMemory(void       *ptr,
   return UDS_SUCCESS;
 }
 
+/**
+ * Get the peak usage, which is never less than the current usage even though
+ * the per-CPU counts have not all been folded into the recorded peak.
+ *
+ * @param totals  The summed counts
+ *
+ * @return The peak number of bytes allocated
+ **/
+static uint64_t getPeakBytes(const MemoryCounters *totals)
+{
+  long totalBytes = totals->kmallocBytes + totals->vmallocBytes;
+  long peakBytes = atomic_long_read(&memoryUsage.peakBytes);
+  return (totalBytes > peakBytes) ? totalBytes : peakBytes;
+}
+
 /*****************************************************************************/
 void memoryInit(void)
 {
-
-  spin_lock_init(&memoryStats.lock);
+  unsigned int i;
+  for (i = 0; i < VMALLOC_BUCKETS; i++) {
+    spin_lock_init(&vmallocBuckets[i].lock);
+  }
   initializeThreadRegistry(&allocatingThreads);
 }
 
@@ -380,40 +539,39 @@ void memoryInit(void)
 /*****************************************************************************/
 void memoryExit(void)
 {
-
-  ASSERT_LOG_ONLY(memoryStats.kmallocBytes == 0,
-                  "kmalloc memory used (%zd bytes in %zd blocks)"
+  MemoryCounters totals;
+  sumCounters(&totals);
+  ASSERT_LOG_ONLY(totals.kmallocBytes == 0,
+                  "kmalloc memory used (%ld bytes in %ld blocks)"
                   " is returned to the kernel",
-                  memoryStats.kmallocBytes, memoryStats.kmallocBlocks);
-  ASSERT_LOG_ONLY(memoryStats.vmallocBytes == 0,
-                  "vmalloc memory used (%zd bytes in %zd blocks)"
+                  totals.kmallocBytes, totals.kmallocBlocks);
+  ASSERT_LOG_ONLY(totals.vmallocBytes == 0,
+                  "vmalloc memory used (%ld bytes in %ld blocks)"
                   " is returned to the kernel",
-                  memoryStats.vmallocBytes, memoryStats.vmallocBlocks);
-  logDebug("%s peak usage %zd bytes", THIS_MODULE->name,
-           memoryStats.peakBytes);
+                  totals.vmallocBytes, totals.vmallocBlocks);
+  logDebug("%s peak usage %" PRIu64 " bytes", THIS_MODULE->name,
+           getPeakBytes(&totals));
 }
 
 /**********************************************************************/
 void getMemoryStats(uint64_t *bytesUsed, uint64_t *peakBytesUsed)
 {
-  unsigned long flags;
-  spin_lock_irqsave(&memoryStats.lock, flags);
-  *bytesUsed     = memoryStats.kmallocBytes + memoryStats.vmallocBytes;
-  *peakBytesUsed = memoryStats.peakBytes;
-  spin_unlock_irqrestore(&memoryStats.lock, flags);
+  MemoryCounters totals;
+  sumCounters(&totals);
+  *bytesUsed     = totals.kmallocBytes + totals.vmallocBytes;
+  *peakBytesUsed = getPeakBytes(&totals);
 }
 
 /**********************************************************************/
 void reportMemoryUsage()
 {
-  unsigned long flags;
-  spin_lock_irqsave(&memoryStats.lock, flags);
-  uint64_t kmallocBlocks = memoryStats.kmallocBlocks;
-  uint64_t kmallocBytes = memoryStats.kmallocBytes;
-  uint64_t vmallocBlocks = memoryStats.vmallocBlocks;
-  uint64_t vmallocBytes = memoryStats.vmallocBytes;
-  uint64_t peakUsage = memoryStats.peakBytes;
-  spin_unlock_irqrestore(&memoryStats.lock, flags);
+  MemoryCounters totals;
+  sumCounters(&totals);
+  uint64_t kmallocBlocks = totals.kmallocBlocks;
+  uint64_t kmallocBytes = totals.kmallocBytes;
+  uint64_t vmallocBlocks = totals.vmallocBlocks;
+  uint64_t vmallocBytes = totals.vmallocBytes;
+  uint64_t peakUsage = getPeakBytes(&totals);
   uint64_t totalBytes = kmallocBytes + vmallocBytes;
   logInfo("current module memory tracking"
           " (actual allocation sizes, not requested):");
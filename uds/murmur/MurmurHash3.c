@@ -297,43 +297,20 @@ void MurmurHash3_x86_128 ( const void * key, const int len,
 
 //-----------------------------------------------------------------------------
 
-void MurmurHash3_x64_128 ( const void * key, const int len,
-                           const uint32_t seed, void * out )
-{
-  const uint8_t * data = (const uint8_t*)key;
-  const int nblocks = len / 16;
-
-  uint64_t h1 = seed;
-  uint64_t h2 = seed;
+//-----------------------------------------------------------------------------
+// Tail mixing and finalization shared by the single and multi-buffer x64_128
+// variants, so that both always produce the same hash.
 
+static FORCE_INLINE void finish_x64_128 ( const uint8_t * tail, const int len,
+                                          uint64_t h1, uint64_t h2,
+                                          void * out )
+{
   uint64_t c1 = BIG_CONSTANT(0x87c37b91114253d5);
   uint64_t c2 = BIG_CONSTANT(0x4cf5ad432745937f);
 
-  //----------
-  // body
-
-  const uint64_t * blocks = (const uint64_t *)(data);
-
-  int i;
-  for(i = 0; i < nblocks; i++)
-  {
-    uint64_t k1 = getblock64(blocks,i*2+0);
-    uint64_t k2 = getblock64(blocks,i*2+1);
-
-    k1 *= c1; k1  = ROTL64(k1,31); k1 *= c2; h1 ^= k1;
-
-    h1 = ROTL64(h1,27); h1 += h2; h1 = h1*5+0x52dce729;
-
-    k2 *= c2; k2  = ROTL64(k2,33); k2 *= c1; h2 ^= k2;
-
-    h2 = ROTL64(h2,31); h2 += h1; h2 = h2*5+0x38495ab5;
-  }
-
   //----------
   // tail
 
-  const uint8_t * tail = (const uint8_t*)(data + nblocks*16);
-
   uint64_t k1 = 0;
   uint64_t k2 = 0;
 
@@ -377,3 +354,119 @@ void MurmurHash3_x64_128 ( const void * key, const int len,
   putblock64((uint64_t*)out, 0, h1);
   putblock64((uint64_t*)out, 1, h2);
 }
+
+//-----------------------------------------------------------------------------
+
+void MurmurHash3_x64_128 ( const void * key, const int len,
+                           const uint32_t seed, void * out )
+{
+  const uint8_t * data = (const uint8_t*)key;
+  const int nblocks = len / 16;
+
+  uint64_t h1 = seed;
+  uint64_t h2 = seed;
+
+  uint64_t c1 = BIG_CONSTANT(0x87c37b91114253d5);
+  uint64_t c2 = BIG_CONSTANT(0x4cf5ad432745937f);
+
+  //----------
+  // body
+
+  const uint64_t * blocks = (const uint64_t *)(data);
+
+  int i;
+  for(i = 0; i < nblocks; i++)
+  {
+    uint64_t k1 = getblock64(blocks,i*2+0);
+    uint64_t k2 = getblock64(blocks,i*2+1);
+
+    k1 *= c1; k1  = ROTL64(k1,31); k1 *= c2; h1 ^= k1;
+
+    h1 = ROTL64(h1,27); h1 += h2; h1 = h1*5+0x52dce729;
+
+    k2 *= c2; k2  = ROTL64(k2,33); k2 *= c1; h2 ^= k2;
+
+    h2 = ROTL64(h2,31); h2 += h1; h2 = h2*5+0x38495ab5;
+  }
+
+  finish_x64_128(data + nblocks*16, len, h1, h2, out);
+}
+
+//-----------------------------------------------------------------------------
+// Multi-buffer x64_128. The body loop of a single hash is one long serial
+// dependency chain of multiplies and rotates, so most of the execution units
+// sit idle. Running MURMUR_LANES independent keys through the loop side by
+// side lets the CPU overlap their chains. Each output is bit-for-bit the
+// same as calling MurmurHash3_x64_128 on the corresponding key.
+
+enum { MURMUR_LANES = 4 };
+
+#define X64_128_ROUND(blocks, i, h1, h2)                                \
+  do {                                                                  \
+    uint64_t k1 = getblock64(blocks,i*2+0);                             \
+    uint64_t k2 = getblock64(blocks,i*2+1);                             \
+    k1 *= c1; k1  = ROTL64(k1,31); k1 *= c2; h1 ^= k1;                  \
+    h1 = ROTL64(h1,27); h1 += h2; h1 = h1*5+0x52dce729;                 \
+    k2 *= c2; k2  = ROTL64(k2,33); k2 *= c1; h2 ^= k2;                  \
+    h2 = ROTL64(h2,31); h2 += h1; h2 = h2*5+0x38495ab5;                 \
+  } while (0)
+
+static void hash_x64_128_lanes ( const void * const * keys, const int len,
+                                 const uint32_t seed, void * const * outs )
+{
+  const int nblocks = len / 16;
+
+  uint64_t c1 = BIG_CONSTANT(0x87c37b91114253d5);
+  uint64_t c2 = BIG_CONSTANT(0x4cf5ad432745937f);
+
+  const uint64_t * blocksA = (const uint64_t *)keys[0];
+  const uint64_t * blocksB = (const uint64_t *)keys[1];
+  const uint64_t * blocksC = (const uint64_t *)keys[2];
+  const uint64_t * blocksD = (const uint64_t *)keys[3];
+
+  uint64_t h1A = seed, h2A = seed;
+  uint64_t h1B = seed, h2B = seed;
+  uint64_t h1C = seed, h2C = seed;
+  uint64_t h1D = seed, h2D = seed;
+
+  //----------
+  // body
+
+  int i;
+  for(i = 0; i < nblocks; i++)
+  {
+    X64_128_ROUND(blocksA, i, h1A, h2A);
+    X64_128_ROUND(blocksB, i, h1B, h2B);
+    X64_128_ROUND(blocksC, i, h1C, h2C);
+    X64_128_ROUND(blocksD, i, h1D, h2D);
+  }
+
+  finish_x64_128((const uint8_t *)blocksA + nblocks*16, len, h1A, h2A,
+                 outs[0]);
+  finish_x64_128((const uint8_t *)blocksB + nblocks*16, len, h1B, h2B,
+                 outs[1]);
+  finish_x64_128((const uint8_t *)blocksC + nblocks*16, len, h1C, h2C,
+                 outs[2]);
+  finish_x64_128((const uint8_t *)blocksD + nblocks*16, len, h1D, h2D,
+                 outs[3]);
+}
+
+#undef X64_128_ROUND
+
+//----------
+
+void MurmurHash3_x64_128_multi ( const void * const * keys, int count,
+                                 const int len, const uint32_t seed,
+                                 void * const * outs )
+{
+  int i = 0;
+  for(; i + MURMUR_LANES <= count; i += MURMUR_LANES)
+  {
+    hash_x64_128_lanes(keys + i, len, seed, outs + i);
+  }
+
+  for(; i < count; i++)
+  {
+    MurmurHash3_x64_128(keys[i], len, seed, outs[i]);
+  }
+}
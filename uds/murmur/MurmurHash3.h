@@ -39,6 +39,10 @@ void MurmurHash3_x86_128 ( const void * key, int len, uint32_t seed, void * out
 
 void MurmurHash3_x64_128 ( const void * key, int len, uint32_t seed, void * out );
 
+// Hash count keys of len bytes each, as if by MurmurHash3_x64_128 on each.
+void MurmurHash3_x64_128_multi ( const void * const * keys, int count, int len,
+                                 uint32_t seed, void * const * outs );
+
 //-----------------------------------------------------------------------------
 
 #endif // _MURMURHASH3_H_
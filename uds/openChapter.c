@@ -129,6 +129,22 @@ static int fillDeltaChapterIndex(OpenChapterZone **chapterZones,
   return UDS_SUCCESS;
 }
 
+/**********************************************************************/
+int collateOpenChapter(OpenChapterZone  **chapterZones,
+                       unsigned int       zoneCount,
+                       OpenChapterIndex  *chapterIndex,
+                       UdsChunkRecord    *collatedRecords,
+                       uint64_t           virtualChapterNumber)
+{
+  // Empty the delta chapter index, and prepare it for the new virtual chapter.
+  emptyOpenChapterIndex(chapterIndex, virtualChapterNumber);
+
+  // Map each non-deleted record name to its record page number in the delta
+  // chapter index.
+  return fillDeltaChapterIndex(chapterZones, zoneCount, chapterIndex,
+                               collatedRecords);
+}
+
 /**********************************************************************/
 int closeOpenChapter(OpenChapterZone  **chapterZones,
                      unsigned int       zoneCount,
@@ -137,13 +153,8 @@ int closeOpenChapter(OpenChapterZone  **chapterZones,
                      UdsChunkRecord    *collatedRecords,
                      uint64_t           virtualChapterNumber)
 {
-  // Empty the delta chapter index, and prepare it for the new virtual chapter.
-  emptyOpenChapterIndex(chapterIndex, virtualChapterNumber);
-
-  // Map each non-deleted record name to its record page number in the delta
-  // chapter index.
-  int result = fillDeltaChapterIndex(chapterZones, zoneCount, chapterIndex,
-                                     collatedRecords);
+  int result = collateOpenChapter(chapterZones, zoneCount, chapterIndex,
+                                  collatedRecords, virtualChapterNumber);
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -46,6 +46,25 @@ extern const IndexComponentInfo OPEN_CHAPTER_INFO;
  * zones at load time.
  **/
 
+/**
+ * Collate the records of the open chapter zones and populate the chapter
+ * index for them, without writing anything to disk.
+ *
+ * @param chapterZones         The zones of the chapter to close
+ * @param zoneCount            The number of zones
+ * @param chapterIndex         The OpenChapterIndex to populate
+ * @param collatedRecords      Collated records array to fill in
+ * @param virtualChapterNumber The virtual chapter number of the open chapter
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int collateOpenChapter(OpenChapterZone  **chapterZones,
+                       unsigned int       zoneCount,
+                       OpenChapterIndex  *chapterIndex,
+                       UdsChunkRecord    *collatedRecords,
+                       uint64_t           virtualChapterNumber)
+  __attribute__((warn_unused_result));
+
 /**
  * Close the open chapter and write it to disk.
  *
@@ -39,6 +39,20 @@ static INLINE size_t slotsSize(size_t slotCount)
   return (sizeof(Slot) * slotCount);
 }
 
+/**
+ * Get the fingerprint of a name which is kept in the hash slot of its record.
+ * This must not come from the bytes which choose the hash slot, or the zone.
+ *
+ * @param name  The name
+ *
+ * @return The fingerprint of the name
+ **/
+static INLINE byte nameToFingerprint(const UdsChunkName *name)
+{
+  // The low byte of the master index bytes, i.e. of its delta address
+  return name->name[MASTER_INDEX_BYTES_OFFSET + 7];
+}
+
 /**
  * Round up to the first power of two greater than or equal
  * to the supplied number.
@@ -136,6 +150,7 @@ static UdsChunkRecord *probeChapterSlots(OpenChapterZone    *openChapter,
   unsigned int slots     = openChapter->slotCount;
   unsigned int probe     = nameToHashSlot(name, slots);
   unsigned int firstSlot = 0;
+  byte fingerprint       = nameToFingerprint(name);
 
   UdsChunkRecord *record;
   unsigned int probeSlot;
@@ -144,7 +159,8 @@ static UdsChunkRecord *probeChapterSlots(OpenChapterZone    *openChapter,
 
   for (probeAttempts = 1; ; ++probeAttempts) {
     probeSlot = firstSlot + probe;
-    recordNumber = openChapter->slots[probeSlot].recordNumber;
+    const Slot *slot = &openChapter->slots[probeSlot];
+    recordNumber = slot->recordNumber;
 
     // If the hash slot is empty, we've reached the end of a chain without
     // finding the record and should terminate the search.
@@ -154,11 +170,14 @@ static UdsChunkRecord *probeChapterSlots(OpenChapterZone    *openChapter,
     }
 
     // If the name of the record referenced by the slot matches and has not
-    // been deleted, then we've found the requested name.
-    record = &openChapter->records[recordNumber];
-    if ((memcmp(&record->name, name, UDS_CHUNK_NAME_SIZE) == 0)
-        && !openChapter->slots[recordNumber].recordDeleted) {
-      break;
+    // been deleted, then we've found the requested name. Only look at the
+    // record if its fingerprint matches, since it probably won't.
+    if (slot->fingerprint == fingerprint) {
+      record = &openChapter->records[recordNumber];
+      if ((memcmp(&record->name, name, UDS_CHUNK_NAME_SIZE) == 0)
+          && !openChapter->slots[recordNumber].recordDeleted) {
+        break;
+      }
     }
 
     // Quadratic probing: advance the probe by 1, 2, 3, etc. and try again.
@@ -220,6 +239,7 @@ int putOpenChapter(OpenChapterZone    *openChapter,
 
   unsigned int recordNumber = ++openChapter->size;
   openChapter->slots[slot].recordNumber = recordNumber;
+  openChapter->slots[slot].fingerprint  = nameToFingerprint(name);
   record                                = &openChapter->records[recordNumber];
   record->name                          = *name;
   record->data                          = *metadata;
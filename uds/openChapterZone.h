@@ -54,6 +54,10 @@
  * flags, indexed by record number. This overlay is possible because the
  * number of hash slots always exceeds the number of records, and is done
  * simply to save on memory.
+ *
+ * <p>Each hash slot also holds a byte of the name of the record it
+ * addresses, so that probing only has to look at a record whose name is
+ * likely to match, rather than at every record along the probe sequence.
  **/
 
 enum {
@@ -66,6 +70,8 @@ typedef struct {
   unsigned int recordNumber : OPEN_CHAPTER_RECORD_NUMBER_BITS;
   /** If true, the record at the index of this hash slot was deleted */
   bool         recordDeleted : 1;
+  /** The fingerprint of the name of the record addressed by this slot */
+  byte         fingerprint;
 } __attribute__((packed)) Slot;
 
 typedef struct openChapterZone {
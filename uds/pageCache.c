@@ -69,7 +69,7 @@ int assertPageInCache(PageCache *cache, CachedPage *page)
 static void clearPage(PageCache *cache, CachedPage *page)
 {
   page->cp_physicalPage = cache->numIndexEntries;
-  WRITE_ONCE(page->cp_lastUsed, 0);
+  WRITE_ONCE(page->cp_referenced, false);
 }
 
 /**
@@ -248,9 +248,9 @@ int findInvalidateAndMakeLeastRecent(PageCache          *cache,
     return result;
   }
 
-  // Move the cached page to the least recently used end of the list
-  // so it will be replaced before any page with valid data.
-  WRITE_ONCE(page->cp_lastUsed, 0);
+  // Clear the reference bit so the page will be replaced the next time the
+  // clock hand reaches it.
+  WRITE_ONCE(page->cp_referenced, false);
 
   return UDS_SUCCESS;
 }
@@ -266,9 +266,10 @@ static int initializePageCache(PageCache      *cache,
   cache->geometry  = geometry;
   cache->numIndexEntries = geometry->pagesPerVolume + 1;
   cache->numCacheEntries = chaptersInCache * geometry->recordPagesPerChapter;
+  cache->activeEntries = cache->numCacheEntries;
   cache->readQueueMaxSize = readQueueMaxSize;
   cache->zoneCount = zoneCount;
-  atomic64_set(&cache->clock, 1);
+  cache->clockHand = 0;
 
   int result = ALLOCATE(readQueueMaxSize, QueuedRead,
                         "volume read queue", &cache->readQueue);
@@ -407,13 +408,18 @@ void makePageMostRecent(PageCache *cache, CachedPage *page)
 {
   // ASSERTION: We are either a zone thread holding a searchPendingCounter,
   //            or we are any thread holding the readThreadsMutex.
-  if (atomic64_read(&cache->clock) != READ_ONCE(page->cp_lastUsed)) {
-    WRITE_ONCE(page->cp_lastUsed, atomic64_inc_return(&cache->clock));
+  // Check before writing so that repeated hits on a page do not keep dirtying
+  // its cache line on every zone thread.
+  if (!READ_ONCE(page->cp_referenced)) {
+    WRITE_ONCE(page->cp_referenced, true);
   }
 }
 
 /**
- * Get the least recent valid page from the cache.
+ * Get the least recent valid page from the cache. This is a CLOCK sweep: the
+ * hand advances over the cache, clearing the reference bit of each page it
+ * passes, and stops at the first page which has not been used since the hand
+ * last passed it. Pages with pending reads are skipped.
  *
  * @param cache    the cache
  * @param pagePtr  a pointer to hold the new page (will be set to NULL
@@ -425,30 +431,30 @@ __attribute__((warn_unused_result))
 static int getLeastRecentPage(PageCache *cache, CachedPage **pagePtr)
 {
   // We hold the readThreadsMutex.
-  int oldestIndex = 0;
-  // Our first candidate is any page that does have a pending read.  We ensure
-  // above that there are more entries than read threads, so there must be one.
+  // Every page without a pending read is either selected on the first pass
+  // or has its reference bit cleared by it, so two passes always suffice. We
+  // ensure elsewhere that there are more entries than read threads, so there
+  // must be such a page.
+  unsigned int hand = cache->clockHand;
   unsigned int i;
-  for (i = 0;; i++) {
-    if (i >= cache->numCacheEntries) {
-      // This should never happen.
-      return ASSERT(false, "oldest page is not NULL");
+  for (i = 0; i < 2 * cache->activeEntries; i++) {
+    CachedPage *page = &cache->cache[hand];
+    hand = (hand + 1) % cache->activeEntries;
+    if (page->cp_readPending) {
+      continue;
     }
-    if (!cache->cache[i].cp_readPending) {
-      oldestIndex = i;
-      break;
-    }
-  }
-  // Now find the least recently used page that does not have a pending read.
-  for (i = 0; i < cache->numCacheEntries; i++) {
-    if (!cache->cache[i].cp_readPending
-        && (READ_ONCE(cache->cache[i].cp_lastUsed)
-            <= READ_ONCE(cache->cache[oldestIndex].cp_lastUsed))) {
-      oldestIndex = i;
+    if (READ_ONCE(page->cp_referenced)) {
+      WRITE_ONCE(page->cp_referenced, false);
+      continue;
     }
+    cache->clockHand = hand;
+    *pagePtr = page;
+    return UDS_SUCCESS;
   }
-  *pagePtr = &cache->cache[oldestIndex];
-  return UDS_SUCCESS;
+
+  // This should never happen.
+  *pagePtr = NULL;
+  return ASSERT(false, "oldest page is not NULL");
 }
 
 /***********************************************************************/
@@ -577,6 +583,31 @@ bool reserveReadQueueEntry(PageCache     *cache,
   return true;
 }
 
+/***********************************************************************/
+unsigned int countQueuedSuccessors(PageCache    *cache,
+                                   unsigned int  physicalPage,
+                                   unsigned int  limit)
+{
+  // We hold the readThreadsMutex.
+  unsigned int count;
+  for (count = 0; count < limit; count++) {
+    unsigned int page = physicalPage + count + 1;
+    if (page >= cache->numIndexEntries) {
+      break;
+    }
+    uint16_t indexValue = cache->index[page];
+    if ((indexValue & VOLUME_CACHE_QUEUED_FLAG) == 0) {
+      break;
+    }
+    QueuedRead *queued
+      = &cache->readQueue[indexValue & ~VOLUME_CACHE_QUEUED_FLAG];
+    if (queued->reserved || queued->invalid) {
+      break;
+    }
+  }
+  return count;
+}
+
 /************************************************************************/
 void releaseReadQueueEntry(PageCache *cache, unsigned int queuePos)
 {
@@ -708,6 +739,44 @@ void cancelPageInCache(PageCache    *cache,
   WRITE_ONCE(cache->index[physicalPage], cache->numCacheEntries);
 }
 
+/**********************************************************************/
+unsigned int resizePageCache(PageCache *cache, unsigned int entries)
+{
+  // We hold the readThreadsMutex.
+  if (entries > cache->numCacheEntries) {
+    entries = cache->numCacheEntries;
+  }
+  if (entries >= cache->activeEntries) {
+    cache->activeEntries = entries;
+    return entries;
+  }
+
+  // Give up entries from the end of the array. An entry with a pending read
+  // is still in use by a reader thread, so stop at it, and leave the rest of
+  // the shrinking for a later resize.
+  unsigned int active = cache->activeEntries;
+  while (active > entries) {
+    CachedPage *page = &cache->cache[active - 1];
+    if (page->cp_readPending) {
+      break;
+    }
+    if (page->cp_physicalPage != cache->numIndexEntries) {
+      cache->counters.evictions++;
+      WRITE_ONCE(cache->index[page->cp_physicalPage], cache->numCacheEntries);
+      waitForPendingSearches(cache, page->cp_physicalPage);
+      clearPage(cache, page);
+    }
+    trimVolumePage(&page->cp_pageData);
+    active--;
+  }
+
+  cache->activeEntries = active;
+  if (cache->clockHand >= active) {
+    cache->clockHand = 0;
+  }
+  return active;
+}
+
 /**********************************************************************/
 size_t getPageCacheSize(PageCache *cache)
 {
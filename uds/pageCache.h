@@ -43,8 +43,8 @@ typedef struct cachedPage {
   bool               cp_readPending;
   /* if equal to numCacheEntries, the page is invalid */
   unsigned int       cp_physicalPage;
-  /* the value of the volume clock when this page was last used */
-  int64_t            cp_lastUsed;
+  /* whether this page has been used since the clock hand last passed it */
+  bool               cp_referenced;
   /* the cache page data */
   struct volume_page cp_pageData;
   /* the chapter index page. This is here, even for record pages */
@@ -106,6 +106,9 @@ typedef struct pageCache {
   unsigned int    numIndexEntries;
   // The max number of cached entries
   uint16_t        numCacheEntries;
+  // The number of cached entries currently in use, which is never more than
+  // numCacheEntries and may change under the readThreadsMutex
+  unsigned int    activeEntries;
   // The index used to quickly access page in cache - top bit is a 'queued'
   // flag
   uint16_t       *index;
@@ -144,8 +147,8 @@ typedef struct pageCache {
   uint16_t              readQueueLast;
   // The size of the read queue
   unsigned int          readQueueMaxSize;
-  // Page access counter
-  atomic64_t            clock;
+  // The next cache entry to be considered for eviction
+  unsigned int          clockHand;
 } PageCache;
 
 /**
@@ -209,12 +212,13 @@ int findInvalidateAndMakeLeastRecent(PageCache          *cache,
                                      bool                mustFind);
 
 /**
- * Make the page the most recent in the cache
+ * Make the page the most recent in the cache. Recency is approximated with a
+ * CLOCK reference bit, so this only writes to the page when the bit has been
+ * cleared by the eviction sweep since the last use, and a hit on a recently
+ * used page writes no shared state at all.
  *
  * @param cache   the page cache
  * @param pagePtr the page to make most recent
- *
- * @return UDS_SUCCESS or an error code
  **/
 void makePageMostRecent(PageCache *cache, CachedPage *pagePtr);
 
@@ -279,6 +283,22 @@ bool reserveReadQueueEntry(PageCache     *cache,
                            unsigned int  *physicalPage,
                            bool          *invalid);
 
+/**
+ * Count the pages immediately following a page which have reads queued but
+ * not yet reserved, so that a reader thread can fetch them from storage
+ * along with the page it has reserved.
+ *
+ * @param cache         the page cache
+ * @param physicalPage  the page which has been reserved
+ * @param limit         the maximum number of following pages to count
+ *
+ * @return the number of consecutive following pages with queued reads
+ **/
+unsigned int countQueuedSuccessors(PageCache    *cache,
+                                   unsigned int  physicalPage,
+                                   unsigned int  limit)
+  __attribute__((warn_unused_result));
+
 /**
  * Releases a read from the queue, allowing it to be reused by future
  * enqueues
@@ -367,6 +387,19 @@ void cancelPageInCache(PageCache    *cache,
                        unsigned int  physicalPage,
                        CachedPage   *page);
 
+/**
+ * Change the number of entries a page cache uses, evicting the pages held by
+ * any entries it gives up and releasing their memory. The cache never uses
+ * more entries than it was made with. An entry with a read in progress is
+ * not given up, so the cache may end up larger than requested.
+ *
+ * @param cache    the page cache
+ * @param entries  the number of entries the cache should use
+ *
+ * @return the number of entries the cache now uses
+ **/
+unsigned int resizePageCache(PageCache *cache, unsigned int entries);
+
 /**
  * Get the page cache size
  *
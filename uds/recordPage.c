@@ -23,6 +23,16 @@
 
 #include "permassert.h"
 
+enum {
+  /*
+   * The number of records in each node of a blocked record page. A node of
+   * four 32-byte records fills a pair of 64-byte cache lines, which are
+   * fetched together, and has five children. This is part of the on-disk
+   * format, so must not depend on the cache line size of the machine.
+   */
+  RECORDS_PER_NODE = 4,
+};
+
 /**********************************************************************/
 static unsigned int encodeTree(byte                  recordPage[],
                                const UdsChunkRecord *sortedPointers[],
@@ -48,13 +58,58 @@ static unsigned int encodeTree(byte                  recordPage[],
   return nextRecord;
 }
 
+/**
+ * Copy sorted records to a record page as a blocked search tree. This is a
+ * B-tree stored in breadth-first order with no pointers: node N holds the
+ * records at indexes RECORDS_PER_NODE * N and up, and its children are nodes
+ * (RECORDS_PER_NODE + 1) * N + 1 and up. A node exists if its first record
+ * index is less than the record count.
+ *
+ * @param recordPage      The record page
+ * @param sortedPointers  The records to copy, in name order
+ * @param nextRecord      The index of the next record to copy
+ * @param node            The node of the subtree to fill in
+ * @param recordCount     The number of records on the page
+ *
+ * @return The index of the next record to copy after this subtree
+ **/
+static unsigned int encodeBlockedTree(byte                  recordPage[],
+                                      const UdsChunkRecord *sortedPointers[],
+                                      unsigned int          nextRecord,
+                                      unsigned int          node,
+                                      unsigned int          recordCount)
+{
+  unsigned int first = node * RECORDS_PER_NODE;
+  if (first >= recordCount) {
+    return nextRecord;
+  }
+
+  // In-order traversal: each record of the node comes after all the records
+  // in the child before it.
+  unsigned int child = (node * (RECORDS_PER_NODE + 1)) + 1;
+  unsigned int i;
+  for (i = 0; (i < RECORDS_PER_NODE) && (first + i < recordCount); i++) {
+    nextRecord = encodeBlockedTree(recordPage, sortedPointers, nextRecord,
+                                   child + i, recordCount);
+    memcpy(&recordPage[(first + i) * BYTES_PER_RECORD],
+           sortedPointers[nextRecord],
+           BYTES_PER_RECORD);
+    ++nextRecord;
+  }
+
+  // A partial node is the last node, so none of its children exist.
+  return encodeBlockedTree(recordPage, sortedPointers, nextRecord, child + i,
+                           recordCount);
+}
+
 /**********************************************************************/
-int encodeRecordPage(const Volume         *volume,
-                     const UdsChunkRecord  records[],
-                     byte                  recordPage[])
+int encodeRecordPage(const Volume           *volume,
+                     const RecordPageWriter *writer,
+                     const UdsChunkRecord    records[],
+                     byte                    recordPage[])
 {
   unsigned int recordsPerPage = volume->geometry->recordsPerPage;
-  const UdsChunkRecord **recordPointers = volume->recordPointers;
+  const UdsChunkRecord **recordPointers = writer->recordPointers;
 
   // Build an array of record pointers. We'll sort the pointers by the block
   // names in the records, which is less work than sorting the record values.
@@ -64,7 +119,7 @@ int encodeRecordPage(const Volume         *volume,
   }
 
   STATIC_ASSERT(offsetof(UdsChunkRecord, name) == 0);
-  int result = radixSort(volume->radixSorter, (const byte **) recordPointers,
+  int result = radixSort(writer->radixSorter, (const byte **) recordPointers,
                          recordsPerPage, UDS_CHUNK_NAME_SIZE);
   if (result != UDS_SUCCESS) {
     return result;
@@ -72,18 +127,67 @@ int encodeRecordPage(const Volume         *volume,
 
   // Use the sorted pointers to copy the records from the chapter to the
   // record page in tree order.
-  encodeTree(recordPage, recordPointers, 0, 0, recordsPerPage);
+  if (volume->blockedRecordPages) {
+    encodeBlockedTree(recordPage, recordPointers, 0, 0, recordsPerPage);
+  } else {
+    encodeTree(recordPage, recordPointers, 0, 0, recordsPerPage);
+  }
   return UDS_SUCCESS;
 }
 
+/**
+ * Find the metadata for a given block name in a record page stored as a
+ * blocked search tree by encodeBlockedTree().
+ *
+ * @param records      The records of the page
+ * @param name         The block name to look for
+ * @param recordCount  The number of records on the page
+ * @param metadata     an array in which to place the metadata of the
+ *                     record, if one was found
+ *
+ * @return <code>true</code> if the record was found
+ **/
+static bool searchBlockedTree(const UdsChunkRecord *records,
+                              const UdsChunkName   *name,
+                              unsigned int          recordCount,
+                              UdsChunkData         *metadata)
+{
+  unsigned int node = 0;
+  while (node * RECORDS_PER_NODE < recordCount) {
+    unsigned int first = node * RECORDS_PER_NODE;
+    unsigned int i;
+    for (i = 0; (i < RECORDS_PER_NODE) && (first + i < recordCount); i++) {
+      const UdsChunkRecord *record = &records[first + i];
+      int result = memcmp(name, &record->name, UDS_CHUNK_NAME_SIZE);
+      if (result == 0) {
+        if (metadata != NULL) {
+          *metadata = record->data;
+        }
+        return true;
+      }
+      if (result < 0) {
+        break;
+      }
+    }
+    // Child I of the node holds the names between records I - 1 and I.
+    node = (node * (RECORDS_PER_NODE + 1)) + 1 + i;
+  }
+  return false;
+}
+
 /**********************************************************************/
-bool searchRecordPage(const byte          recordPage[],
+bool searchRecordPage(const Volume       *volume,
+                      const byte          recordPage[],
                       const UdsChunkName *name,
-                      const Geometry     *geometry,
                       UdsChunkData       *metadata)
 {
   // The record page is just an array of chunk records.
   const UdsChunkRecord *records = (const UdsChunkRecord *) recordPage;
+  const Geometry       *geometry = volume->geometry;
+  if (volume->blockedRecordPages) {
+    return searchBlockedTree(records, name, geometry->recordsPerPage,
+                             metadata);
+  }
 
   // The array of records is sorted by name and stored as a binary tree in
   // heap order, so the root of the tree is the first array element.
@@ -30,29 +30,31 @@
  * in the open chapter representation.
  *
  * @param volume     The volume
+ * @param writer     The sorting state of the calling thread
  * @param records    The records to be encoded
  * @param recordPage The record page
  *
  * @return UDS_SUCCESS or an error code
  **/
-int encodeRecordPage(const Volume         *volume,
-                     const UdsChunkRecord  records[],
-                     byte                  recordPage[]);
+int encodeRecordPage(const Volume           *volume,
+                     const RecordPageWriter *writer,
+                     const UdsChunkRecord    records[],
+                     byte                    recordPage[]);
 
 /**
  * Find the metadata for a given block name in this page.
  *
+ * @param volume     The volume
  * @param recordPage The record page
  * @param name       The block name to look for
- * @param geometry   The geometry of the volume
  * @param metadata   an array in which to place the metadata of the
  *                   record, if one was found
  *
  * @return <code>true</code> if the record was found
  **/
-bool searchRecordPage(const byte          recordPage[],
+bool searchRecordPage(const Volume       *volume,
+                      const byte          recordPage[],
                       const UdsChunkName *name,
-                      const Geometry     *geometry,
                       UdsChunkData       *metadata);
 
 #endif /* RECORDPAGE_H */
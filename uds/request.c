@@ -28,8 +28,14 @@
 #include "permassert.h"
 #include "requestQueue.h"
 
-/**********************************************************************/
-int udsStartChunkOperation(UdsRequest *udsRequest)
+/**
+ * Check that a chunk request may be started.
+ *
+ * @param udsRequest  the request to check
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int validateChunkOperation(const UdsRequest *udsRequest)
 {
   if (udsRequest->callback == NULL) {
     return UDS_CALLBACK_REQUIRED;
@@ -39,18 +45,23 @@ int udsStartChunkOperation(UdsRequest *udsRequest)
   case UDS_POST:
   case UDS_QUERY:
   case UDS_UPDATE:
-    break;
+    return UDS_SUCCESS;
   default:
     return UDS_INVALID_OPERATION_TYPE;
   }
+}
+
+/**
+ * Launch a validated chunk request for which the index session has already
+ * been acquired.
+ *
+ * @param udsRequest  the request to launch
+ **/
+static void launchChunkOperation(UdsRequest *udsRequest)
+{
   memset(udsRequest->private, 0, sizeof(udsRequest->private));
   Request *request = (Request *)udsRequest;
 
-  int result = getIndexSession(request->session);
-  if (result != UDS_SUCCESS) {
-    return sansUnrecoverable(result);
-  }
-
   request->found            = false;
   request->action           = (RequestAction) request->type;
   request->isControlMessage = false;
@@ -58,6 +69,54 @@ int udsStartChunkOperation(UdsRequest *udsRequest)
   request->router           = request->session->router;
 
   enqueueRequest(request, STAGE_TRIAGE);
+}
+
+/**********************************************************************/
+int udsStartChunkOperation(UdsRequest *udsRequest)
+{
+  int result = validateChunkOperation(udsRequest);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  result = getIndexSession(udsRequest->session);
+  if (result != UDS_SUCCESS) {
+    return sansUnrecoverable(result);
+  }
+
+  launchChunkOperation(udsRequest);
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+int udsStartChunkOperations(UdsRequest *udsRequests[], unsigned int count)
+{
+  if (count == 0) {
+    return UDS_SUCCESS;
+  }
+
+  struct uds_index_session *session = udsRequests[0]->session;
+  unsigned int i;
+  for (i = 0; i < count; i++) {
+    int result = validateChunkOperation(udsRequests[i]);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    if (udsRequests[i]->session != session) {
+      return UDS_INVALID_ARGUMENT;
+    }
+  }
+
+  int result = getIndexSessionRequests(session, count);
+  if (result != UDS_SUCCESS) {
+    return sansUnrecoverable(result);
+  }
+
+  // Once a request is launched it may complete at any time, so each request
+  // must not be touched after it has been launched.
+  for (i = 0; i < count; i++) {
+    launchChunkOperation(udsRequests[i]);
+  }
   return UDS_SUCCESS;
 }
 
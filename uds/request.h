@@ -52,6 +52,11 @@ typedef enum {
   // request used by an indexZone to signal the other zones that it
   // has closed the current open chapter.
   REQUEST_ANNOUNCE_CHAPTER_CLOSED,
+
+  // REQUEST_RESTORE_DELTA_LISTS is the action for the control request used
+  // by an indexZone to read more of its master index delta lists after an
+  // incremental load.
+  REQUEST_RESTORE_DELTA_LISTS,
 } RequestAction;
 
 /**
@@ -141,6 +146,7 @@ struct internalRequest {
    * The remainder of this structure is private to the UDS implementation.
    */
   FunnelQueueEntry  requestQueueLink; // for lock-free request queue
+  AbsTime           enqueueTime;      // when last added to a request queue
   Request          *nextRequest;
   IndexRouter      *router;
 
@@ -28,6 +28,46 @@
 /* void return value because this function will process its own errors */
 typedef void RequestQueueProcessor(Request *);
 
+/**
+ * The priority lanes of a request queue, from highest to lowest priority.
+ **/
+typedef enum {
+  /** Requests which are being retried */
+  REQUEST_LANE_RETRY = 0,
+  /** Control messages such as those exchanged between index zones */
+  REQUEST_LANE_CONTROL,
+  /** Queries and posts, whose submitters are waiting for the answer */
+  REQUEST_LANE_QUERY,
+  /** Updates and deletes */
+  REQUEST_LANE_UPDATE,
+  REQUEST_LANE_COUNT,
+} RequestLane;
+
+enum {
+  /** The number of buckets in the wait time histogram of each lane */
+  REQUEST_WAIT_BUCKETS = 16,
+};
+
+/**
+ * The statistics of one lane of a request queue. They are maintained by the
+ * worker thread, so a copy taken by another thread is only approximate.
+ **/
+typedef struct requestLaneStats {
+  /** The number of requests currently in the lane */
+  uint64_t depth;
+  /** The greatest number of requests seen in the lane */
+  uint64_t maxDepth;
+  /** The number of requests taken from the lane */
+  uint64_t dequeued;
+  /** The number of requests taken out of turn to avoid starving the lane */
+  uint64_t starvationPasses;
+  /**
+   * The time requests spent in the lane. Bucket n counts waits of less than
+   * 2^n microseconds, except that the last bucket counts all longer waits.
+   **/
+  uint64_t waitHistogram[REQUEST_WAIT_BUCKETS];
+} RequestLaneStats;
+
 /**
  * Allocate a new request processing queue and start a worker thread to
  * consume and service requests in the queue.
@@ -45,14 +85,25 @@ int makeRequestQueue(const char             *queueName,
 
 /**
  * Add a request to the end of the queue for processing by the worker thread.
- * If the requeued flag is set on the request, it will be processed before
- * any non-requeued requests under most circumstances.
+ * Requests are processed in the priority order of their lanes: requeued
+ * requests first, then control messages, then queries and posts, then
+ * updates and deletes. A lane which has been passed over too many times in
+ * a row is served ahead of its turn so that it cannot be starved.
  *
  * @param queue    the request queue that should process the request
  * @param request  the request to be processed on the queue's worker thread
  **/
 void requestQueueEnqueue(RequestQueue *queue, Request *request);
 
+/**
+ * Get the statistics of each lane of a request queue.
+ *
+ * @param queue  the request queue
+ * @param stats  an array to hold the statistics of each lane
+ **/
+void getRequestQueueStats(RequestQueue     *queue,
+                          RequestLaneStats  stats[REQUEST_LANE_COUNT]);
+
 /**
  * Shut down the request queue worker thread, then destroy and free the queue.
  *
@@ -34,22 +34,26 @@
 /*
  * Ordering:
  *
- * Multiple retry requests or multiple non-retry requests enqueued from
- * a single producer thread will be processed in the order enqueued.
+ * Each queue has several lanes (see RequestLane). Multiple requests in the
+ * same lane enqueued from a single producer thread will be processed in the
+ * order enqueued.
  *
- * Retry requests will generally be processed before normal requests.
+ * Requests in a higher priority lane will generally be processed before
+ * those in lower priority lanes, so requests in different lanes from a
+ * single producer may be processed in the reverse of the order in which they
+ * were enqueued. As before, the checking of the lanes is very simple and
+ * there's a potential race with the producer regarding the priority handling.
  *
- * HOWEVER, a producer thread can enqueue a retry request (generally given
- * higher priority) and then enqueue a normal request, and they can get
- * processed in the reverse order.  The checking of the two internal queues is
- * very simple and there's a potential race with the producer regarding the
- * "priority" handling.  If an ordering guarantee is needed, it can be added
- * without much difficulty, it just makes the code a bit more complicated.
+ * To keep a busy lane from starving the lanes below it, each time a request
+ * is taken from a lane, every lower lane which has requests waiting is
+ * charged a pass. A lane which has been passed over STARVATION_LIMIT times
+ * is served next, ahead of its turn.
  *
  * If requests are enqueued while the processing of another request is
  * happening, and the enqueuing operations complete while the request
  * processing is still in progress, then the retry request(s) *will*
- * get processed next.  (This is used for testing.)
+ * get processed next (unless a lower lane is being starved).  (This is used
+ * for testing.)
  */
 
 /**
@@ -80,15 +84,35 @@ enum {
   MAXIMUM_BATCH = 64   // wait time decreases if batches are larger than this
 };
 
+enum {
+  /** The number of times a lane may be passed over before it is served */
+  STARVATION_LIMIT = 16,
+  /** The most requests the worker takes from a lane's queue at once */
+  LANE_POLL_BATCH  = 16
+};
+
+typedef struct laneQueue {
+  /* the requests in the lane */
+  FunnelQueue      *queue;
+  /* requests taken from the queue but not yet dequeued; used by the worker */
+  FunnelQueueEntry *batch;
+  /* the number of requests in the lane, maintained by enqueue and dequeue */
+  atomic_t          depth;
+  /* the number of times the lane has been passed over; used by the worker */
+  unsigned int      passes;
+  /* the lane statistics, all but the depth maintained by the worker */
+  RequestLaneStats  stats;
+} LaneQueue;
+
 struct requestQueue {
   /* Wait queue for synchronizing producers and consumer */
   struct wait_queue_head  wqhead;
   /* function to process 1 request */
   RequestQueueProcessor  *processOne;
-  /* new incoming requests */
-  FunnelQueue            *mainQueue;
-  /* old requests to retry first */
-  FunnelQueue            *retryQueue;
+  /* the name of the queue and its worker thread */
+  const char             *name;
+  /* the priority lanes, highest priority first */
+  LaneQueue               lanes[REQUEST_LANE_COUNT];
   /* thread id of the worker thread */
   Thread                  thread;
   /* true if the worker was started */
@@ -99,6 +123,107 @@ struct requestQueue {
   atomic_t                dormant;
 };
 
+/*****************************************************************************/
+/**
+ * Choose the lane of a request queue which should hold a request.
+ *
+ * @param request  the request being enqueued
+ *
+ * @return the lane for the request
+ **/
+static INLINE RequestLane getRequestLane(const Request *request)
+{
+  if (request->requeued) {
+    return REQUEST_LANE_RETRY;
+  }
+
+  if (request->action == REQUEST_RESTORE_DELTA_LISTS) {
+    // Restoring the master index is background work which should only use
+    // the time not needed by requests.
+    return REQUEST_LANE_UPDATE;
+  }
+
+  if (request->isControlMessage) {
+    return REQUEST_LANE_CONTROL;
+  }
+
+  switch (request->action) {
+  case REQUEST_INDEX:
+  case REQUEST_QUERY:
+    return REQUEST_LANE_QUERY;
+
+  default:
+    return REQUEST_LANE_UPDATE;
+  }
+}
+
+/*****************************************************************************/
+/**
+ * Record the time a request spent waiting in a lane.  Must only be called by
+ * the worker thread.
+ *
+ * @param lane     the lane the request was taken from
+ * @param request  the request
+ **/
+static INLINE void recordLaneWait(LaneQueue *lane, const Request *request)
+{
+  RelTime  wait = timeDifference(currentTime(CLOCK_MONOTONIC),
+                                 request->enqueueTime);
+  uint64_t microseconds = max(relTimeToMicroseconds(wait), (int64_t) 0);
+  unsigned int bucket = 0;
+  while ((microseconds > 0) && (bucket < REQUEST_WAIT_BUCKETS - 1)) {
+    microseconds >>= 1;
+    bucket++;
+  }
+  lane->stats.waitHistogram[bucket]++;
+}
+
+/*****************************************************************************/
+/**
+ * Poll one lane for a request to process.  Must only be called by the worker
+ * thread.
+ *
+ * @param queue   the RequestQueue being serviced
+ * @param laneID  the lane to poll
+ *
+ * @return a dequeued request, or NULL if the lane was empty
+ **/
+static INLINE Request *pollLane(RequestQueue *queue, RequestLane laneID)
+{
+  LaneQueue *lane = &queue->lanes[laneID];
+  FunnelQueueEntry *entry = lane->batch;
+  if (entry == NULL) {
+    // Take a run of requests at once so that the funnel queue's end-of-queue
+    // checks are made once per batch. The lanes are still checked in
+    // priority order for every request.
+    entry = funnelQueuePollBatch(lane->queue, LANE_POLL_BATCH, NULL);
+    if (entry == NULL) {
+      return NULL;
+    }
+  }
+  lane->batch = entry->next;
+  entry->next = NULL;
+
+  uint64_t depth = atomic_dec_return(&lane->depth) + 1;
+  if (depth > lane->stats.maxDepth) {
+    lane->stats.maxDepth = depth;
+  }
+  lane->stats.dequeued++;
+  lane->passes = 0;
+
+  // Charge a pass to each lower priority lane which has requests waiting.
+  RequestLane lower;
+  for (lower = laneID + 1; lower < REQUEST_LANE_COUNT; lower++) {
+    if (atomic_read(&queue->lanes[lower].depth) > 0) {
+      queue->lanes[lower].passes++;
+    }
+  }
+
+  Request *request = container_of(entry, Request, requestQueueLink);
+  recordLaneWait(lane, request);
+  return request;
+}
+
 /*****************************************************************************/
 /**
  * Poll the underlying lock-free queues for a request to process.  Must only be
@@ -110,18 +235,27 @@ struct requestQueue {
  **/
 static INLINE Request *pollQueues(RequestQueue *queue)
 {
-  // The retry queue has higher priority.
-  FunnelQueueEntry *entry = funnelQueuePoll(queue->retryQueue);
-  if (entry != NULL) {
-    return container_of(entry, Request, requestQueueLink);
+  RequestLane laneID;
+  // A lane which has been passed over too often goes first.
+  for (laneID = REQUEST_LANE_RETRY + 1; laneID < REQUEST_LANE_COUNT;
+       laneID++) {
+    if (queue->lanes[laneID].passes >= STARVATION_LIMIT) {
+      Request *request = pollLane(queue, laneID);
+      if (request != NULL) {
+        queue->lanes[laneID].stats.starvationPasses++;
+        return request;
+      }
+    }
   }
 
-  // The main queue has lower priority.
-  entry = funnelQueuePoll(queue->mainQueue);
-  if (entry != NULL) {
-    return container_of(entry, Request, requestQueueLink);
+  // Otherwise the lanes are polled in priority order.
+  for (laneID = REQUEST_LANE_RETRY; laneID < REQUEST_LANE_COUNT; laneID++) {
+    Request *request = pollLane(queue, laneID);
+    if (request != NULL) {
+      return request;
+    }
   }
-  
+
   // No entry found.
   return NULL;
 }
@@ -262,20 +396,19 @@ int makeRequestQueue(const char             *queueName,
     return result;
   }
   queue->processOne = processOne;
+  queue->name       = queueName;
   queue->alive      = true;
   atomic_set(&queue->dormant, false);
   init_waitqueue_head(&queue->wqhead);
 
-  result = makeFunnelQueue(&queue->mainQueue);
-  if (result != UDS_SUCCESS) {
-    requestQueueFinish(queue);
-    return result;
-  }
-
-  result = makeFunnelQueue(&queue->retryQueue);
-  if (result != UDS_SUCCESS) {
-    requestQueueFinish(queue);
-    return result;
+  RequestLane laneID;
+  for (laneID = REQUEST_LANE_RETRY; laneID < REQUEST_LANE_COUNT; laneID++) {
+    atomic_set(&queue->lanes[laneID].depth, 0);
+    result = makeFunnelQueue(&queue->lanes[laneID].queue);
+    if (result != UDS_SUCCESS) {
+      requestQueueFinish(queue);
+      return result;
+    }
   }
 
   result = createThread(requestQueueWorker, queue, queueName, &queue->thread);
@@ -303,9 +436,11 @@ static INLINE void wakeUpWorker(RequestQueue *queue)
 /**********************************************************************/
 void requestQueueEnqueue(RequestQueue *queue, Request *request)
 {
-  bool unbatched = request->unbatched;
-  funnelQueuePut(request->requeued ? queue->retryQueue : queue->mainQueue,
-                 &request->requestQueueLink);
+  bool       unbatched = request->unbatched;
+  LaneQueue *lane      = &queue->lanes[getRequestLane(request)];
+  request->enqueueTime = currentTime(CLOCK_MONOTONIC);
+  atomic_inc(&lane->depth);
+  funnelQueuePut(lane->queue, &request->requestQueueLink);
 
   /*
    * We must wake the worker thread when it is dormant (waiting with no
@@ -317,6 +452,43 @@ void requestQueueEnqueue(RequestQueue *queue, Request *request)
   }
 }
 
+/**********************************************************************/
+void getRequestQueueStats(RequestQueue     *queue,
+                          RequestLaneStats  stats[REQUEST_LANE_COUNT])
+{
+  RequestLane laneID;
+  for (laneID = REQUEST_LANE_RETRY; laneID < REQUEST_LANE_COUNT; laneID++) {
+    LaneQueue *lane = &queue->lanes[laneID];
+    stats[laneID]       = lane->stats;
+    stats[laneID].depth = max(atomic_read(&lane->depth), 0);
+  }
+}
+
+/**
+ * Log the statistics of the lanes of a request queue which were used.
+ *
+ * @param queue  the request queue
+ **/
+static void logRequestQueueStats(RequestQueue *queue)
+{
+  static const char *LANE_NAMES[REQUEST_LANE_COUNT] = {
+    "retry", "control", "query", "update",
+  };
+
+  RequestLaneStats stats[REQUEST_LANE_COUNT];
+  getRequestQueueStats(queue, stats);
+  RequestLane laneID;
+  for (laneID = REQUEST_LANE_RETRY; laneID < REQUEST_LANE_COUNT; laneID++) {
+    if (stats[laneID].dequeued == 0) {
+      continue;
+    }
+    logDebug("%s %s lane: %" PRIu64 " requests, max depth %" PRIu64
+             ", %" PRIu64 " starvation passes", queue->name,
+             LANE_NAMES[laneID], stats[laneID].dequeued,
+             stats[laneID].maxDepth, stats[laneID].starvationPasses);
+  }
+}
+
 /**********************************************************************/
 void requestQueueFinish(RequestQueue *queue)
 {
@@ -348,7 +520,10 @@ void requestQueueFinish(RequestQueue *queue)
     }
   }
 
-  freeFunnelQueue(queue->mainQueue);
-  freeFunnelQueue(queue->retryQueue);
+  logRequestQueueStats(queue);
+  RequestLane laneID;
+  for (laneID = REQUEST_LANE_RETRY; laneID < REQUEST_LANE_COUNT; laneID++) {
+    freeFunnelQueue(queue->lanes[laneID].queue);
+  }
   FREE(queue);
 }
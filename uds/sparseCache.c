@@ -29,43 +29,51 @@
  * The most important property of this cache is the absence of synchronization
  * for read operations. Safe concurrent access to the cache by the zone
  * threads is controlled by the triage queue and the barrier requests it
- * issues to the zone queues. The set of cached chapters does not and must not
- * change between the carefully coordinated calls to updateSparseCache() from
- * the zone threads.
+ * issues to the zone queues. Each zone thread's view of the set of cached
+ * chapters does not and must not change except in its own calls to
+ * updateSparseCache().
  *
- * The critical invariant for that coordination is the cache membership must
- * not change between those updates; the calls to sparseCacheContains() from
- * the zone threads must all receive the same results for any virtual chapter
- * number. To ensure that critical invariant, state changes such as "that
- * virtual chapter is no longer in the volume" and "skip searching that
- * chapter because it has had too many cache misses" are represented
- * separately from the cache membership information (the virtual chapter
- * number).
+ * The critical invariant for that coordination is that every zone thread
+ * sees the same cache membership after processing the same sequence of
+ * barrier requests; the calls to sparseCacheContains() from the zone threads
+ * must all receive the same results for any virtual chapter number. To
+ * ensure that critical invariant, state changes such as "that virtual
+ * chapter is no longer in the volume" and "skip searching that chapter
+ * because it has had too many cache misses" are represented separately from
+ * the cache membership information (the virtual chapter number).
  *
  * As a result of this invariant, we have the guarantee that every zone thread
  * will call updateSparseCache() once and exactly once to request a chapter
  * that is not in the cache, and the serialization of the barrier requests
  * from the triage queue ensures they will all request the same chapter
- * number. This means the only synchronization we need can be provided by a
- * pair of thread barriers used only in the updateSparseCache() call,
- * providing a critical section where a single zone thread can drive the cache
- * update while all the other zone threads are known to be blocked, waiting in
- * the second barrier. Outside that critical section, all the zone threads
- * implicitly hold a shared lock. Inside it, the "captain" (the thread that
- * was uniquely flagged when passing through the first barrier) holds an
- * exclusive lock. No other threads may access or modify the cache, except for
- * accessing cache statistics and similar queries.
+ * numbers in the same order. Each such call is thus the zone's part in a
+ * numbered cache update. The first zone thread to reach an update loads the
+ * chapter and publishes the resulting search list; every other zone thread
+ * adopts the published list when it reaches the same update, waiting only if
+ * the chapter is still being loaded. No zone ever waits for the other zones
+ * to arrive, so a slow zone does not stall the rest.
+ *
+ * The cache has one more entry than its capacity. The spare entry is not a
+ * member of the most recently published search list, and the next update
+ * loads its chapter into that entry, so the load never touches an entry
+ * that a zone thread may still be searching. The entry evicted by an update
+ * becomes the new spare, but zone threads that have not yet adopted that
+ * update may still be searching it, so an update may only start loading once
+ * every zone has adopted the previous one. That only delays the loading zone
+ * when some zone is at least two updates behind it.
  *
  * Cache statistics must only be modified by a single thread, conventionally
- * the zone zero thread. All fields that might be frequently updated by that
+ * the zone zero thread. The exception is the eviction tallies, which are
+ * modified by whichever zone thread loads an update, serialized by the
+ * update mutex. All fields that might be frequently updated by that
  * thread are kept in separate cache-aligned structures so they will not cause
  * cache contention via "false sharing" with the fields that are frequently
  * accessed by all of the zone threads.
  *
  * LRU order is kept independently by each zone thread, and each zone uses its
- * own list for searching and cache membership queries. The zone zero list is
- * used to decide which chapter to evict when the cache is updated, and its
- * search list is copied to the other threads at that time.
+ * own list for searching and cache membership queries. The list of the zone
+ * that loads an update is used to decide which chapter to evict, and it is
+ * published for the other threads to copy when they adopt that update.
  *
  * The virtual chapter number field of the cache entry is the single field
  * indicating whether a chapter is a member of the cache or not. The value
@@ -97,6 +105,16 @@
  * regardless of the state of the skipSearch flag, the virtual chapter must
  * still considered to be a member of the cache for sparseCacheContains().
  *
+ * Not every hook is allowed to load its chapter. Each chapter is given a
+ * hook level when it is written, and only the sampled names whose chapter
+ * index bytes end in that many zero bits act as hooks for it once it is
+ * sparse. The level rises while the chapters loaded earn few search hits,
+ * so a workload without locality does not churn the cache, and falls again
+ * once loads pay off. The other samples of a chapter which is not cached
+ * are resolved through the volume page cache, as a dense chapter would be.
+ * Chapters written before the index was loaded have level zero, so the
+ * search of an index saved without hook levels is unchanged.
+ *
  * Barrier requests and the sparse chapter index cache are also described in
  *
  * https://intranet.permabit.com/wiki/Chapter_Index_Cache_supports_concurrent_access
@@ -110,6 +128,7 @@
 #include "cachedChapterIndex.h"
 #include "chapterIndex.h"
 #include "common.h"
+#include "hashUtils.h"
 #include "index.h"
 #include "logger.h"
 #include "memoryAlloc.h"
@@ -123,7 +142,28 @@ enum {
   SKIP_SEARCH_THRESHOLD = 20000,
 
   /** a named constant to use when identifying zone zero */
-  ZONE_ZERO = 0
+  ZONE_ZERO = 0,
+
+  /** The number of least recently used chapters considered for eviction */
+  EVICTION_CANDIDATES = 4,
+
+  /** The number of new search hits that will spare a chapter from eviction */
+  RETENTION_HIT_THRESHOLD = 16,
+
+  /** The highest hook level, at which one sample in 2^level is a hook */
+  MAX_HOOK_LEVEL = 4,
+
+  /** The number of chapter loads between adjustments of the hook level */
+  HOOK_ADAPT_LOADS = 16,
+
+  /** The number of chapters written with fewer loads before the level drops */
+  HOOK_ADAPT_CHAPTERS = 64,
+
+  /** The search hits per chapter load below which the hook level rises */
+  LOW_HITS_PER_LOAD = 1,
+
+  /** The search hits per chapter load at which the hook level falls */
+  HIGH_HITS_PER_LOAD = 16,
 };
 
 /**
@@ -150,6 +190,12 @@ typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) sparseCacheCounters {
 
   /** the number of cache entries that were evicted while still valid */
   uint64_t      evictions;
+
+  /** the number of hot cache entries that were spared from eviction */
+  uint64_t      retentions;
+
+  /** the number of chapter indexes loaded into the cache */
+  uint64_t      loads;
 } SparseCacheCounters;
 
 /**
@@ -171,14 +217,46 @@ struct sparseCache {
   /** pointers to the cache-aligned chapter search order for each zone */
   SearchList            *searchLists[MAX_ZONES];
 
-  /** the thread barriers used to synchronize the zone threads for update */
-  Barrier                beginCacheUpdate;
-  Barrier                endCacheUpdate;
+  /** protects the update state below; never held while searching */
+  Mutex                  updateMutex;
+
+  /** signalled when an update is published or adopted by a zone */
+  CondVar                updateCond;
+
+  /** the number of cache updates that have been published */
+  uint64_t               publishedUpdates;
+
+  /** whether a zone thread is loading the next update */
+  bool                   updateLoading;
+
+  /** the cache entry which is not in the published search list */
+  unsigned int           spareEntry;
+
+  /** the search list of the most recently published update */
+  SearchList            *publishedList;
+
+  /** the number of updates each zone thread has adopted */
+  uint64_t               adoptedUpdates[MAX_ZONES];
+
+  /** the hook level of each physical chapter, set when it is written */
+  byte                  *hookLevels;
+
+  /** the hook level to give the next chapter written */
+  unsigned int           hookLevel;
+
+  /** the chapters written since the hook level was last considered */
+  unsigned int           adaptChapters;
+
+  /** the loads counted when the hook level was last considered */
+  uint64_t               adaptLoads;
+
+  /** the zone zero search hits counted when the level was last considered */
+  uint64_t               adaptHits;
 
   /** frequently-updated counter fields (cache-aligned) */
   SparseCacheCounters    counters;
 
-  /** the counted array of chapter index cache entries (cache-aligned) */
+  /** the capacity + 1 chapter index cache entries (cache-aligned) */
   CachedChapterIndex     chapters[];
 };
 
@@ -206,16 +284,25 @@ static int initializeSparseCache(SparseCache    *cache,
   // chapter search misses only in zone zero.
   cache->skipSearchThreshold = (SKIP_SEARCH_THRESHOLD / zoneCount);
 
-  int result = initializeBarrier(&cache->beginCacheUpdate, zoneCount);
+  int result = initMutex(&cache->updateMutex);
   if (result != UDS_SUCCESS) {
     return result;
   }
-  result = initializeBarrier(&cache->endCacheUpdate, zoneCount);
+  result = initCond(&cache->updateCond);
   if (result != UDS_SUCCESS) {
     return result;
   }
+
+  result = ALLOCATE(geometry->chaptersPerVolume, byte, "sparse hook levels",
+                    &cache->hookLevels);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  // The entry past the end of the search lists starts out as the spare.
+  cache->spareEntry = capacity;
   unsigned int i;
-  for (i = 0; i < capacity; i++) {
+  for (i = 0; i <= capacity; i++) {
     result = initializeCachedChapterIndex(&cache->chapters[i], geometry);
     if (result != UDS_SUCCESS) {
       return result;
@@ -229,7 +316,7 @@ static int initializeSparseCache(SparseCache    *cache,
       return result;
     }
   }
-  return UDS_SUCCESS;
+  return makeSearchList(capacity, &cache->publishedList);
 }
 
 /**********************************************************************/
@@ -239,7 +326,7 @@ int makeSparseCache(const Geometry  *geometry,
                     SparseCache    **cachePtr)
 {
   unsigned int bytes
-    = (sizeof(SparseCache) + (capacity * sizeof(CachedChapterIndex)));
+    = (sizeof(SparseCache) + ((capacity + 1) * sizeof(CachedChapterIndex)));
 
   SparseCache *cache;
   int result = allocateCacheAligned(bytes, "sparse cache", &cache);
@@ -263,7 +350,7 @@ size_t getSparseCacheMemorySize(const SparseCache *cache)
   // Count the DeltaIndexPage as cache memory, but ignore all other overhead.
   size_t pageSize = (sizeof(DeltaIndexPage) + cache->geometry->bytesPerPage);
   size_t chapterSize = (pageSize * cache->geometry->indexPagesPerChapter);
-  return (cache->capacity * chapterSize);
+  return ((cache->capacity + 1) * chapterSize);
 }
 
 /**
@@ -312,6 +399,62 @@ static void scoreEviction(IndexZone          *zone,
   }
 }
 
+/**
+ * Check whether a cache entry which is a candidate for eviction has been
+ * searched successfully often enough since it was cached, or since it was
+ * last spared, to be kept instead. A chapter which is spared must earn that
+ * many hits again to be spared the next time, so a formerly hot chapter will
+ * still age out of the cache.
+ *
+ * @param cache      the cache to update
+ * @param chapter    the cache entry which is a candidate for eviction
+ *
+ * @return <code>true</code> if the chapter should stay in the cache
+ **/
+static bool retainChapter(SparseCache *cache, CachedChapterIndex *chapter)
+{
+  // The hit counts are only maintained by zone zero, so they are just a
+  // sample of the traffic, which is all this heuristic needs.
+  uint64_t searchHits = chapter->counters.searchHits;
+  if ((searchHits - chapter->counters.retainedHits)
+      < RETENTION_HIT_THRESHOLD) {
+    return false;
+  }
+
+  chapter->counters.retainedHits = searchHits;
+  cache->counters.retentions += 1;
+  return true;
+}
+
+/**
+ * Choose the search list entry to evict from among the least recently used
+ * entries of a purged search list. A dead entry is always preferred, and a
+ * live chapter which is still getting search hits is passed over in favor of
+ * a more recently used one, so that a burst of scan traffic through the
+ * sparse chapters does not flush out the chapters the workload keeps
+ * returning to.
+ *
+ * @param cache      the cache
+ * @param list       the purged search list
+ *
+ * @return the position in the search list of the entry to evict
+ **/
+static unsigned int selectVictim(SparseCache *cache, const SearchList *list)
+{
+  unsigned int last = cache->capacity - 1;
+  unsigned int first = ((last < EVICTION_CANDIDATES)
+                        ? 0 : last - EVICTION_CANDIDATES + 1);
+  unsigned int position;
+  for (position = last; position > first; position--) {
+    if ((position >= list->firstDeadEntry)
+        || !retainChapter(cache,
+                          &cache->chapters[list->entries[position]])) {
+      return position;
+    }
+  }
+  return first;
+}
+
 /**
  * Update counters to reflect a cache search hit. This bumps the hit
  * count, clears the miss count, and clears the skipSearch flag.
@@ -347,6 +490,88 @@ static void scoreSearchMiss(SparseCache        *cache,
   }
 }
 
+/**********************************************************************/
+void getSparseCacheStats(const SparseCache *cache,
+                         uint64_t          *evictionsPtr,
+                         uint64_t          *retentionsPtr)
+{
+  *evictionsPtr  = cache->counters.evictions;
+  *retentionsPtr = cache->counters.retentions;
+}
+
+/**********************************************************************/
+bool isSparseCacheHook(const SparseCache  *cache,
+                       const UdsChunkName *name,
+                       uint64_t            virtualChapter)
+{
+  if (cache == NULL) {
+    return true;
+  }
+
+  unsigned int physicalChapter
+    = mapToPhysicalChapter(cache->geometry, virtualChapter);
+  uint64_t mask = (1 << cache->hookLevels[physicalChapter]) - 1;
+  return ((extractChapterIndexBytes(name) & mask) == 0);
+}
+
+/**********************************************************************/
+void adaptSparseCacheHooks(SparseCache *cache, uint64_t virtualChapter)
+{
+  // Search hits are only counted in zone zero, so scale them up to compare
+  // them to the loads, which every zone takes part in.
+  uint64_t loads = cache->counters.loads - cache->adaptLoads;
+  uint64_t hits  = ((cache->counters.searchHits - cache->adaptHits)
+                    * cache->zoneCount);
+  cache->adaptChapters += 1;
+
+  unsigned int level = cache->hookLevel;
+  if (loads >= HOOK_ADAPT_LOADS) {
+    if ((hits < loads * LOW_HITS_PER_LOAD) && (level < MAX_HOOK_LEVEL)) {
+      level += 1;
+    } else if ((hits >= loads * HIGH_HITS_PER_LOAD) && (level > 0)) {
+      level -= 1;
+    }
+  } else if ((cache->adaptChapters >= HOOK_ADAPT_CHAPTERS) && (level > 0)) {
+    // Too few loads to judge; let more hooks through to find out.
+    level -= 1;
+  }
+
+  if ((loads >= HOOK_ADAPT_LOADS)
+      || (cache->adaptChapters >= HOOK_ADAPT_CHAPTERS)) {
+    cache->adaptLoads    = cache->counters.loads;
+    cache->adaptHits     = cache->counters.searchHits;
+    cache->adaptChapters = 0;
+  }
+
+  if (level != cache->hookLevel) {
+    logDebug("sparse cache hook level changed from %u to %u",
+             cache->hookLevel, level);
+    cache->hookLevel = level;
+  }
+
+  unsigned int physicalChapter
+    = mapToPhysicalChapter(cache->geometry, virtualChapter);
+  cache->hookLevels[physicalChapter] = level;
+}
+
+/**********************************************************************/
+unsigned int listSparseCacheChapters(SparseCache  *cache,
+                                     uint64_t     *chapters,
+                                     unsigned int  maxCount)
+{
+  unsigned int count = 0;
+  lockMutex(&cache->updateMutex);
+  unsigned int i;
+  for (i = 0; (i <= cache->capacity) && (count < maxCount); i++) {
+    uint64_t virtualChapter = cache->chapters[i].virtualChapter;
+    if (virtualChapter != UINT64_MAX) {
+      chapters[count++] = virtualChapter;
+    }
+  }
+  unlockMutex(&cache->updateMutex);
+  return count;
+}
+
 /**********************************************************************/
 void freeSparseCache(SparseCache *cache)
 {
@@ -358,14 +583,16 @@ void freeSparseCache(SparseCache *cache)
   for (i = 0; i < cache->zoneCount; i++) {
     freeSearchList(&cache->searchLists[i]);
   }
+  freeSearchList(&cache->publishedList);
 
-  for (i = 0; i < cache->capacity; i++) {
+  for (i = 0; i <= cache->capacity; i++) {
     CachedChapterIndex *chapter = &cache->chapters[i];
     destroyCachedChapterIndex(chapter);
   }
 
-  destroyBarrier(&cache->beginCacheUpdate);
-  destroyBarrier(&cache->endCacheUpdate);
+  FREE(cache->hookLevels);
+  destroyCond(&cache->updateCond);
+  destroyMutex(&cache->updateMutex);
   FREE(cache);
 }
 
@@ -376,12 +603,12 @@ bool sparseCacheContains(SparseCache  *cache,
                          unsigned int  zoneNumber)
 {
   /*
-   * The correctness of the barriers depends on the invariant that between
+   * The correctness of the updates depends on the invariant that between
    * calls to updateSparseCache(), the answers this function returns must
    * never vary--the result for a given chapter must be identical across
-   * zones. That invariant must be maintained even if the chapter falls off
-   * the end of the volume, or if searching it is disabled because of too many
-   * search misses.
+   * zones which have adopted the same updates. That invariant must be
+   * maintained even if the chapter falls off the end of the volume, or if
+   * searching it is disabled because of too many search misses.
    */
 
   // Get the chapter search order for this zone thread.
@@ -407,6 +634,76 @@ bool sparseCacheContains(SparseCache  *cache,
   return false;
 }
 
+/**
+ * Check whether every zone thread has adopted a given cache update.
+ *
+ * @param cache   the cache
+ * @param update  the number of the update
+ *
+ * @return <code>true</code> if no zone is still using an older search list
+ **/
+static bool allZonesAdopted(const SparseCache *cache, uint64_t update)
+{
+  unsigned int z;
+  for (z = 0; z < cache->zoneCount; z++) {
+    if (cache->adoptedUpdates[z] < update) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Load a chapter index into the spare cache entry and make it the most
+ * recent entry of a zone's search list, evicting the least recently used
+ * entry, which becomes the new spare. This is done without holding the
+ * update mutex; the caller must have established that no zone thread is
+ * using the spare entry and that no other thread is changing the cache.
+ *
+ * @param zone            the zone loading the chapter
+ * @param list            the search list of that zone
+ * @param virtualChapter  the virtual chapter number of the chapter index
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int loadSpareEntry(IndexZone  *zone,
+                          SearchList *list,
+                          uint64_t    virtualChapter)
+{
+  const Index *index = zone->index;
+  SparseCache *cache = index->volume->sparseCache;
+
+  // Purge invalid chapters from the LRU search list.
+  purgeSearchList(list, cache->chapters, zone->oldestVirtualChapter);
+
+  // First check that the desired chapter is still in the volume. If it's
+  // not, the hook fell out of the index and there's nothing to do for it.
+  if (virtualChapter < index->oldestVirtualChapter) {
+    return UDS_SUCCESS;
+  }
+
+  // Read the index page bytes and initialize the page array.
+  CachedChapterIndex *spare = &cache->chapters[cache->spareEntry];
+  int result = cacheChapterIndex(spare, virtualChapter, index->volume);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  cache->counters.loads += 1;
+
+  // Replace a dead cache entry, or evict one of the least recently used live
+  // chapters, by rotating that list entry to the front and then substituting
+  // the spare for it.
+  unsigned int victim = rotateSearchList(list, selectVictim(cache, list) + 1);
+
+  // Check if the victim is already dead, and if it's not, add to the tally
+  // of evicted or invalidated cache entries.
+  scoreEviction(zone, cache, &cache->chapters[victim]);
+
+  list->entries[0]  = cache->spareEntry;
+  cache->spareEntry = victim;
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 int updateSparseCache(IndexZone *zone, uint64_t virtualChapter)
 {
@@ -419,52 +716,43 @@ int updateSparseCache(IndexZone *zone, uint64_t virtualChapter)
     return UDS_SUCCESS;
   }
 
-  // Wait for every zone thread to have reached its corresponding barrier
-  // request and invoked this function before starting to modify the cache.
-  enterBarrier(&cache->beginCacheUpdate, NULL);
+  // Every zone makes the same sequence of calls that reach this point, so
+  // this zone's count of adopted updates identifies the update it needs.
+  SearchList *list = cache->searchLists[zone->id];
+  uint64_t update = cache->adoptedUpdates[zone->id] + 1;
+  int result = UDS_SUCCESS;
 
-  /*
-   * This is the start of the critical section: the zone zero thread is
-   * captain, effectively holding an exclusive lock on the sparse cache. All
-   * the other zone threads must do nothing between the two barriers. They
-   * will wait at the endCacheUpdate barrier for the captain to finish the
-   * update.
-   */
+  lockMutex(&cache->updateMutex);
+  while (cache->updateLoading && (cache->publishedUpdates < update)) {
+    // Another zone is loading this update; wait for it to be published.
+    waitCond(&cache->updateCond, &cache->updateMutex);
+  }
 
-  int result = UDS_SUCCESS;
-  if (zone->id == ZONE_ZERO) {
-    // Purge invalid chapters from the LRU search list.
-    SearchList *zoneZeroList = cache->searchLists[ZONE_ZERO];
-    purgeSearchList(zoneZeroList, cache->chapters, zone->oldestVirtualChapter);
-
-    // First check that the desired chapter is still in the volume. If it's
-    // not, the hook fell out of the index and there's nothing to do for it.
-    if (virtualChapter >= index->oldestVirtualChapter) {
-      // Evict the least recently used live chapter, or replace a dead cache
-      // entry, all by rotating the the last list entry to the front.
-      CachedChapterIndex *victim
-        = &cache->chapters[rotateSearchList(zoneZeroList, cache->capacity)];
-
-      // Check if the victim is already dead, and if it's not, add to the
-      // tally of evicted or invalidated cache entries.
-      scoreEviction(zone, cache, victim);
-
-      // Read the index page bytes and initialize the page array.
-      result = cacheChapterIndex(victim, virtualChapter, index->volume);
+  if (cache->publishedUpdates < update) {
+    // This zone is the first to reach this update, so it loads the chapter.
+    // The spare entry may only be reused once no zone can still be
+    // searching it, which is when every zone has adopted the last update.
+    cache->updateLoading = true;
+    while (!allZonesAdopted(cache, update - 1)) {
+      waitCond(&cache->updateCond, &cache->updateMutex);
     }
+    unlockMutex(&cache->updateMutex);
 
-    // Copy the new search list state to all the other zone threads so they'll
-    // get the result of pruning and see the new chapter.
-    unsigned int z;
-    for (z = 1; z < cache->zoneCount; z++) {
-      copySearchList(zoneZeroList, cache->searchLists[z]);
-    }
-  }
+    result = loadSpareEntry(zone, list, virtualChapter);
 
-  // This is the end of the critical section. All cache invariants must have
-  // been restored--it will be shared/read-only again beyond the barrier.
+    lockMutex(&cache->updateMutex);
+    copySearchList(list, cache->publishedList);
+    cache->publishedUpdates = update;
+    cache->updateLoading    = false;
+  } else {
+    // Copy the published search list so this zone will get the result of
+    // pruning and see the new chapter.
+    copySearchList(cache->publishedList, list);
+  }
 
-  enterBarrier(&cache->endCacheUpdate, NULL);
+  cache->adoptedUpdates[zone->id] = update;
+  broadcastCond(&cache->updateCond);
+  unlockMutex(&cache->updateMutex);
   return result;
 }
 
@@ -35,9 +35,9 @@
  * cache.
  *
  * Searching the cache is an unsynchronized operation. Changing the contents
- * of the cache is a coordinated process requiring the coordinated
- * participation of all zone threads via the careful use of barrier messages
- * sent to all the index zones by the triage queue worker thread.
+ * of the cache requires the participation of all zone threads via barrier
+ * messages sent to all the index zones by the triage queue worker thread,
+ * but the zone threads do not wait for each other to reach those messages.
  **/
 typedef struct sparseCache SparseCache;
 
@@ -74,6 +74,59 @@ void freeSparseCache(SparseCache *cache);
  **/
 size_t getSparseCacheMemorySize(const SparseCache *cache);
 
+/**
+ * Get the eviction statistics of a sparse chapter cache.
+ *
+ * @param [in]  cache          the cache
+ * @param [out] evictionsPtr   the number of valid entries that were evicted
+ * @param [out] retentionsPtr  the number of times a hot entry was spared
+ **/
+void getSparseCacheStats(const SparseCache *cache,
+                         uint64_t          *evictionsPtr,
+                         uint64_t          *retentionsPtr);
+
+/**
+ * Check whether a sampled chunk name is a hook for a sparse chapter, which
+ * may load the chapter's index into the cache, at the hook level the
+ * chapter was written with.
+ *
+ * @param cache           the cache, or NULL if the index is dense
+ * @param name            the sampled chunk name
+ * @param virtualChapter  the virtual chapter the name was found in
+ *
+ * @return <code>true</code> if the name may load the chapter
+ **/
+bool isSparseCacheHook(const SparseCache  *cache,
+                       const UdsChunkName *name,
+                       uint64_t            virtualChapter)
+  __attribute__((warn_unused_result));
+
+/**
+ * Adjust the hook level according to how many search hits the chapters
+ * loaded since the last adjustment have earned, and give that level to a
+ * chapter which has just been written. This is only called by the chapter
+ * writer thread.
+ *
+ * @param cache           the cache
+ * @param virtualChapter  the virtual chapter which was written
+ **/
+void adaptSparseCacheHooks(SparseCache *cache, uint64_t virtualChapter);
+
+/**
+ * List the virtual chapters whose chapter indexes are in the cache, in no
+ * particular order.
+ *
+ * @param cache     the cache
+ * @param chapters  the array to hold the virtual chapter numbers
+ * @param maxCount  the size of the chapters array
+ *
+ * @return the number of chapters listed
+ **/
+unsigned int listSparseCacheChapters(SparseCache  *cache,
+                                     uint64_t     *chapters,
+                                     unsigned int  maxCount)
+  __attribute__((warn_unused_result));
+
 
 /**
  * Check whether a sparse chapter index is present in the chapter cache. This
@@ -93,8 +146,8 @@ bool sparseCacheContains(SparseCache  *cache,
  * Update the sparse cache to contain a chapter index.
  *
  * This function must be called by all the zone threads with the same chapter
- * numbers to correctly enter the thread barriers used to synchronize the
- * cache updates.
+ * numbers in the same order. The first zone thread to call it for a chapter
+ * loads the chapter index; the others adopt the result when they get there.
  *
  * @param zone            the index zone
  * @param virtualChapter  the virtual chapter number of the chapter index
@@ -25,6 +25,7 @@
 #include <linux/module.h>
 #include <linux/slab.h>
 
+#include "cacheBudget.h"
 #include "logger.h"
 #include "memoryAlloc.h"
 #include "stringUtils.h"
@@ -101,6 +102,7 @@ static struct kobj_type emptyObjectType = {
 // This is the the code for the /sys/<module_name>/parameter directory.
 //
 // <dir>/log_level                 UDS_LOG_LEVEL
+// <dir>/page_cache_budget_mb      the host-wide page cache budget
 //
 /**********************************************************************/
 
@@ -160,14 +162,42 @@ static void parameterStoreLogLevel(const char *string)
 
 /**********************************************************************/
 
+static const char *parameterShowPageCacheBudget(void)
+{
+  static char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%u", getPageCacheBudget());
+  return buffer;
+}
+
+/**********************************************************************/
+
+static void parameterStorePageCacheBudget(const char *string)
+{
+  unsigned int megabytes;
+  if (kstrtouint(string, 10, &megabytes) != 0) {
+    logWarning("invalid page cache budget: %s", string);
+    return;
+  }
+  setPageCacheBudget(megabytes);
+}
+
+/**********************************************************************/
+
 static ParameterAttribute logLevelAttr = {
   .attr        = { .name = "log_level", .mode = 0600 },
   .showString  = parameterShowLogLevel,
   .storeString = parameterStoreLogLevel,
 };
 
+static ParameterAttribute pageCacheBudgetAttr = {
+  .attr        = { .name = "page_cache_budget_mb", .mode = 0600 },
+  .showString  = parameterShowPageCacheBudget,
+  .storeString = parameterStorePageCacheBudget,
+};
+
 static struct attribute *parameterAttrs[] = {
   &logLevelAttr.attr,
+  &pageCacheBudgetAttr.attr,
   NULL,
 };
 
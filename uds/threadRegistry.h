@@ -26,17 +26,24 @@
 #include <linux/spinlock.h>
 
 /*
- * We don't expect this set to ever get really large, so a linked list
- * is adequate.
+ * The registered threads are hashed by task, so that a lookup, which is done
+ * on hot paths such as every memory allocation, only walks the few threads
+ * which share a bucket with the current one. Lookups hold no lock; the
+ * buckets are RCU lists, and only registering and unregistering take the
+ * lock.
  */
+enum {
+  THREAD_REGISTRY_BUCKET_BITS = 6,
+  THREAD_REGISTRY_BUCKETS     = 1 << THREAD_REGISTRY_BUCKET_BITS,
+};
 
 typedef struct threadRegistry {
-  struct list_head links;
-  rwlock_t         lock;
+  struct hlist_head buckets[THREAD_REGISTRY_BUCKETS];
+  spinlock_t        lock;
 } ThreadRegistry;
 
 typedef struct registeredThread {
-  struct list_head    links;
+  struct hlist_node   links;
   const void         *pointer;
   struct task_struct *task;
 } RegisteredThread;
@@ -64,7 +71,8 @@ void registerThread(ThreadRegistry   *registry,
                     const void       *pointer);
 
 /**
- * Remove the registration for the current thread.
+ * Remove the registration for the current thread. This waits for any
+ * concurrent lookups to finish with the registration, so it may sleep.
  *
  * A message may be logged if the thread was not registered.
  *
@@ -75,7 +83,7 @@ void unregisterThread(ThreadRegistry *registry);
 /**
  * Fetch a pointer that may have been registered for the current
  * thread. If the thread is not registered, a null pointer is
- * returned.
+ * returned. This takes no lock and may be called from any context.
  *
  * @param  registry  The thread registry
  *
@@ -176,6 +176,24 @@ struct udsRequest {
  **/
 UDS_ATTR_WARN_UNUSED_RESULT
 int udsStartChunkOperation(UdsRequest *request);
+
+/**
+ * Start a batch of UDS index chunk operations. Each request is prepared and
+ * completed exactly as for #udsStartChunkOperation, with its own callback,
+ * but the index session is acquired once for the whole batch. All the
+ * requests must use the same index session.
+ *
+ * If an error is returned, none of the requests have been started.
+ * Otherwise all of them have, and the caller must not touch any of them
+ * again until their callbacks are invoked.
+ *
+ * @param [in] requests  The operations to start
+ * @param [in] count     The number of operations
+ *
+ * @return              Either #UDS_SUCCESS or an error code
+ **/
+UDS_ATTR_WARN_UNUSED_RESULT
+int udsStartChunkOperations(UdsRequest *requests[], unsigned int count);
 /** @} */
 
 #endif /* UDS_BLOCK_H */
@@ -99,6 +99,13 @@ enum {
   UDS_CHUNK_NAME_SIZE   = 16,
   /** The maximum metadata size in bytes. */
   UDS_MAX_METADATA_SIZE = 16,
+  /** The smallest configurable volume page size in bytes. */
+  UDS_MIN_PAGE_SIZE     = 4096,
+  /**
+   * The largest configurable volume page size in bytes, limited by the 19
+   * bit list offsets of a chapter index page.
+   **/
+  UDS_MAX_PAGE_SIZE     = 65536,
 };
 
 /**
@@ -142,13 +149,32 @@ struct uds_parameters {
   int zone_count;
   // The number of threads used to read volume pages.
   int read_threads;
+  // The maximum number of queued volume page reads, or 0 for the default.
+  int read_queue_depth;
   // The number of chapters to write between checkpoints.
   int checkpoint_frequency;
+  // Whether a saved index may accept requests before its master index has
+  // been read completely. Names whose entries have not been read yet are
+  // not found until they have been.
+  bool lazy_load;
+  // The number of megabytes of memory the master index may use, or 0 for
+  // the size the index was created with. A smaller budget is reached
+  // gradually by expiring the oldest chapters from the master index early,
+  // so names in those chapters are no longer found.
+  unsigned int master_index_budget_mb;
+  // Whether volume pages are read straight into the page cache with bios of
+  // their own instead of through dm-bufio, so that they are not also cached
+  // by dm-bufio. Only the Linux kernel supports this.
+  bool direct_reads;
 };
 #define UDS_PARAMETERS_INITIALIZER {		\
 		.zone_count = 0,		\
 		.read_threads = 2,		\
+		.read_queue_depth = 0,		\
 		.checkpoint_frequency = 0,	\
+		.lazy_load = false,		\
+		.master_index_budget_mb = 0,	\
+		.direct_reads = false,		\
 	}
 
 /**
@@ -168,6 +194,18 @@ typedef struct udsIndexStats {
   uint64_t entriesDiscarded;
   /** The number of checkpoints done this session */
   uint64_t checkpoints;
+  /** The number of valid chapter indexes evicted from the sparse cache */
+  uint64_t sparseCacheEvictions;
+  /** The number of times a hot sparse chapter index was spared eviction */
+  uint64_t sparseCacheRetentions;
+  /** The memory currently allotted to the page cache, in bytes */
+  uint64_t pageCacheBytes;
+  /** The number of first lookups of a page which found it in the cache */
+  uint64_t pageCacheHits;
+  /** The number of first lookups of a page which had to wait for a read */
+  uint64_t pageCacheMisses;
+  /** The page cache memory given back under memory pressure, in bytes */
+  uint64_t pageCacheReclaimedBytes;
 } UdsIndexStats;
 
 /**
@@ -279,6 +317,33 @@ void udsConfigurationSetSparse(UdsConfiguration conf, bool sparse);
 UDS_ATTR_WARN_UNUSED_RESULT
 bool udsConfigurationGetSparse(UdsConfiguration conf);
 
+/**
+ * Sets the size of an index configuration's volume pages, keeping the number
+ * of records in each chapter, and so the memory the index uses, the same.
+ * Larger pages make fewer, larger reads when searching the volume for
+ * records which are not cached, which suits storage where random reads are
+ * costly, at the price of reading and caching more of each chapter at once.
+ * The page size of an index is fixed when the index is created.
+ *
+ * @param [in,out] conf          The configuration to change
+ * @param [in] bytesPerPage      The page size, a power of two from
+ *                               #UDS_MIN_PAGE_SIZE to #UDS_MAX_PAGE_SIZE
+ *
+ * @return                    Either #UDS_SUCCESS or an error code
+ **/
+UDS_ATTR_WARN_UNUSED_RESULT
+int udsConfigurationSetPageSize(UdsConfiguration conf, size_t bytesPerPage);
+
+/**
+ * Gets the size of an index configuration's volume pages.
+ *
+ * @param [in] conf  The configuration to check
+ *
+ * @return  The page size in bytes
+ **/
+UDS_ATTR_WARN_UNUSED_RESULT
+size_t udsConfigurationGetPageSize(UdsConfiguration conf);
+
 /**
  * Sets an index configuration's nonce.
  *
@@ -506,6 +571,22 @@ UDS_ATTR_WARN_UNUSED_RESULT
 int udsGetIndexSessionStats(struct uds_index_session *session,
                             UdsContextStats          *stats);
 
+/**
+ * Fetches the progress of the replay of volume chapters done while an index
+ * is loaded without a clean save or is rebuilt. The counts remain set once
+ * the replay has finished, and are both zero if no replay has been done.
+ *
+ * @param [in]  session   The session
+ * @param [out] replayed  The number of chapters replayed so far
+ * @param [out] total     The number of chapters to be replayed
+ *
+ * @return              Either #UDS_SUCCESS or an error code
+ **/
+UDS_ATTR_WARN_UNUSED_RESULT
+int udsGetIndexReplayProgress(struct uds_index_session *session,
+                              uint64_t                 *replayed,
+                              uint64_t                 *total);
+
 /**
  * Convert an error code to a string.
  *
@@ -126,6 +126,39 @@ bool udsConfigurationGetSparse(UdsConfiguration userConfig)
   return userConfig->sparseChaptersPerVolume > 0;
 }
 
+/**********************************************************************/
+int udsConfigurationSetPageSize(UdsConfiguration userConfig,
+                                size_t           bytesPerPage)
+{
+  if ((bytesPerPage < UDS_MIN_PAGE_SIZE) || (bytesPerPage > UDS_MAX_PAGE_SIZE)
+      || ((bytesPerPage & (bytesPerPage - 1)) != 0)) {
+    return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                   "page size %zu is not a power of two"
+                                   " from %u to %u", bytesPerPage,
+                                   UDS_MIN_PAGE_SIZE, UDS_MAX_PAGE_SIZE);
+  }
+
+  // Keep the records per chapter fixed by scaling the pages per chapter.
+  unsigned long chapterBytes
+    = ((unsigned long) userConfig->recordPagesPerChapter
+       * userConfig->bytesPerPage);
+  if ((chapterBytes % bytesPerPage) != 0) {
+    return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                   "page size %zu does not divide a chapter"
+                                   " of %lu bytes", bytesPerPage, chapterBytes);
+  }
+
+  userConfig->recordPagesPerChapter = chapterBytes / bytesPerPage;
+  userConfig->bytesPerPage          = bytesPerPage;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+size_t udsConfigurationGetPageSize(UdsConfiguration userConfig)
+{
+  return userConfig->bytesPerPage;
+}
+
 /**********************************************************************/
 void udsConfigurationSetNonce(UdsConfiguration userConfig, UdsNonce nonce)
 {
@@ -146,8 +179,11 @@ unsigned int udsConfigurationGetMemory(UdsConfiguration userConfig)
     SMALL_PAGES = CHAPTERS * SMALL_RECORD_PAGES_PER_CHAPTER,
     LARGE_PAGES = CHAPTERS * DEFAULT_RECORD_PAGES_PER_CHAPTER
   };
-  unsigned int pages = (userConfig->chaptersPerVolume
-                        * userConfig->recordPagesPerChapter);
+  // Count pages of the default size, whatever the configured page size.
+  unsigned int pages
+    = ((unsigned long) userConfig->chaptersPerVolume
+       * userConfig->recordPagesPerChapter * userConfig->bytesPerPage
+       / DEFAULT_BYTES_PER_PAGE);
   if (userConfig->sparseChaptersPerVolume != 0) {
     pages /= 10;
   }
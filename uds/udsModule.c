@@ -29,6 +29,7 @@
 #include "timeUtils.h"
 #include "uds.h"
 #include "uds-block.h"
+#include "util/eventCount.h"
 #include "util/funnelQueue.h"
 
 /**********************************************************************/
@@ -62,6 +63,8 @@ EXPORT_SYMBOL_GPL(udsConfigurationSetNonce);
 EXPORT_SYMBOL_GPL(udsConfigurationGetNonce);
 EXPORT_SYMBOL_GPL(udsConfigurationSetSparse);
 EXPORT_SYMBOL_GPL(udsConfigurationGetSparse);
+EXPORT_SYMBOL_GPL(udsConfigurationSetPageSize);
+EXPORT_SYMBOL_GPL(udsConfigurationGetPageSize);
 EXPORT_SYMBOL_GPL(udsConfigurationGetMemory);
 EXPORT_SYMBOL_GPL(udsConfigurationGetChaptersPerVolume);
 EXPORT_SYMBOL_GPL(udsFreeConfiguration);
@@ -75,9 +78,11 @@ EXPORT_SYMBOL_GPL(udsDestroyIndexSession);
 EXPORT_SYMBOL_GPL(udsFlushIndexSession);
 EXPORT_SYMBOL_GPL(udsGetIndexConfiguration);
 EXPORT_SYMBOL_GPL(udsGetIndexStats);
+EXPORT_SYMBOL_GPL(udsGetIndexReplayProgress);
 EXPORT_SYMBOL_GPL(udsGetIndexSessionStats);
 EXPORT_SYMBOL_GPL(udsStringError);
 EXPORT_SYMBOL_GPL(udsStartChunkOperation);
+EXPORT_SYMBOL_GPL(udsStartChunkOperations);
 
 EXPORT_SYMBOL_GPL(allocSprintf);
 EXPORT_SYMBOL_GPL(allocateMemory);
@@ -95,11 +100,17 @@ EXPORT_SYMBOL_GPL(currentTime);
 EXPORT_SYMBOL_GPL(duplicateString);
 EXPORT_SYMBOL_GPL(ensureAvailableSpace);
 EXPORT_SYMBOL_GPL(equalBuffers);
+EXPORT_SYMBOL_GPL(eventCountBroadcast);
+EXPORT_SYMBOL_GPL(eventCountCancel);
+EXPORT_SYMBOL_GPL(eventCountPrepare);
+EXPORT_SYMBOL_GPL(eventCountWait);
 EXPORT_SYMBOL_GPL(fixedSprintf);
 EXPORT_SYMBOL_GPL(freeBuffer);
+EXPORT_SYMBOL_GPL(freeEventCount);
 EXPORT_SYMBOL_GPL(freeFunnelQueue);
 EXPORT_SYMBOL_GPL(freeMemory);
 EXPORT_SYMBOL_GPL(funnelQueuePoll);
+EXPORT_SYMBOL_GPL(funnelQueuePollBatch);
 EXPORT_SYMBOL_GPL(getBoolean);
 EXPORT_SYMBOL_GPL(getBufferContents);
 EXPORT_SYMBOL_GPL(getByte);
@@ -111,6 +122,7 @@ EXPORT_SYMBOL_GPL(getUInt16LEsFromBuffer);
 EXPORT_SYMBOL_GPL(getUInt32BEFromBuffer);
 EXPORT_SYMBOL_GPL(getUInt32BEsFromBuffer);
 EXPORT_SYMBOL_GPL(getUInt32LEFromBuffer);
+EXPORT_SYMBOL_GPL(getUInt32LEsFromBuffer);
 EXPORT_SYMBOL_GPL(getUInt64BEsFromBuffer);
 EXPORT_SYMBOL_GPL(getUInt64LEFromBuffer);
 EXPORT_SYMBOL_GPL(getUInt64LEsFromBuffer);
@@ -118,8 +130,10 @@ EXPORT_SYMBOL_GPL(growBuffer);
 EXPORT_SYMBOL_GPL(hasSameBytes);
 EXPORT_SYMBOL_GPL(isFunnelQueueEmpty);
 EXPORT_SYMBOL_GPL(makeBuffer);
+EXPORT_SYMBOL_GPL(makeEventCount);
 EXPORT_SYMBOL_GPL(makeFunnelQueue);
 EXPORT_SYMBOL_GPL(MurmurHash3_x64_128);
+EXPORT_SYMBOL_GPL(MurmurHash3_x64_128_multi);
 EXPORT_SYMBOL_GPL(nowUsec);
 EXPORT_SYMBOL_GPL(peekByte);
 EXPORT_SYMBOL_GPL(putBoolean);
@@ -133,6 +147,7 @@ EXPORT_SYMBOL_GPL(putUInt16LEsIntoBuffer);
 EXPORT_SYMBOL_GPL(putUInt32BEIntoBuffer);
 EXPORT_SYMBOL_GPL(putUInt32BEsIntoBuffer);
 EXPORT_SYMBOL_GPL(putUInt32LEIntoBuffer);
+EXPORT_SYMBOL_GPL(putUInt32LEsIntoBuffer);
 EXPORT_SYMBOL_GPL(putUInt64BEsIntoBuffer);
 EXPORT_SYMBOL_GPL(putUInt64LEIntoBuffer);
 EXPORT_SYMBOL_GPL(putUInt64LEsIntoBuffer);
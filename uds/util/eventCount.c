@@ -85,11 +85,21 @@
  * line. The instrumentation counters increase the size of the structure so it
  * rounds up to use two (64-byte x86) cache lines.
  *
+ * In the kernel, waiters sleep interruptibly on a wait queue instead, in the
+ * manner of a futex: a waiter sleeps until the event counter differs from
+ * the one in its token, and a signaller which claims the waiters wakes them
+ * all. No tokens are transferred, so a waiter whose event has already been
+ * signalled has nothing to consume, and cancelling never has to wait.
+ *
  * XXX Need interface to access or display instrumentation counters.
  **/
 
 #include "eventCount.h"
 
+#ifdef __KERNEL__
+#include <linux/wait.h>
+#endif
+
 #include "atomicDefs.h"
 #include "common.h"
 #include "compiler.h"
@@ -111,8 +121,13 @@ struct eventCount {
   // high 48 bits: current event counter
   atomic64_t state;
 
+#ifdef __KERNEL__
+  // Wait queue on which threads sleep when waiting is required.
+  wait_queue_head_t waitQueue;
+#else
   // Semaphore used to block threads when waiting is required.
   Semaphore semaphore;
+#endif
 
   // Instrumentation counters.
 
@@ -130,7 +145,7 @@ static INLINE bool sameEvent(EventToken token1, EventToken token2)
 }
 
 /**********************************************************************/
-void eventCountBroadcast(EventCount *ec)
+bool eventCountBroadcast(EventCount *ec)
 {
 
   // Even if there are no waiters (yet), we will need a memory barrier.
@@ -146,7 +161,7 @@ void eventCountBroadcast(EventCount *ec)
     if (waiters == 0) {
       // Fast path first time through--no need to signal or post if there are
       // no observers.
-      return;
+      return false;
     }
 
     /*
@@ -162,6 +177,10 @@ void eventCountBroadcast(EventCount *ec)
   } while (unlikely(state != oldState));
 
 
+#ifdef __KERNEL__
+  // The waiters will see that the event counter has changed.
+  wake_up_all(&ec->waitQueue);
+#else
   /*
    * Wake the waiters by posting to the semaphore. This effectively transfers
    * the wait tokens to the semaphore. There's sadly no bulk post for posix
@@ -170,6 +189,8 @@ void eventCountBroadcast(EventCount *ec)
   while (waiters-- > 0) {
     releaseSemaphore(&ec->semaphore);
   }
+#endif
+  return true;
 }
 
 /**
@@ -211,6 +232,7 @@ static INLINE bool fastCancel(EventCount *ec, EventToken token)
  * @return true if a token was consumed, otherwise false only if a timeout
  *         was specified and we timed out
  **/
+#ifndef __KERNEL__
 static bool consumeWaitToken(EventCount *ec, const RelTime *timeout)
 {
   // Try to grab a token without waiting.
@@ -226,6 +248,7 @@ static bool consumeWaitToken(EventCount *ec, const RelTime *timeout)
   }
   return true;
 }
+#endif
 
 /**********************************************************************/
 int makeEventCount(EventCount **ecPtr)
@@ -239,11 +262,15 @@ int makeEventCount(EventCount **ecPtr)
   }
 
   atomic64_set(&ec->state, 0);
+#ifdef __KERNEL__
+  init_waitqueue_head(&ec->waitQueue);
+#else
   result = initializeSemaphore(&ec->semaphore, 0);
   if (result != UDS_SUCCESS) {
     FREE(ec);
     return result;
   }
+#endif
 
   *ecPtr = ec;
   return UDS_SUCCESS;
@@ -255,7 +282,9 @@ void freeEventCount(EventCount *ec)
   if (ec == NULL) {
     return;
   }
+#ifndef __KERNEL__
   destroySemaphore(&ec->semaphore);
+#endif
   FREE(ec);
 }
 
@@ -277,8 +306,49 @@ void eventCountCancel(EventCount *ec, EventToken token)
   eventCountWait(ec, token, NULL);
 }
 
+#ifdef __KERNEL__
+/**
+ * Check whether an event count has been signalled since a token was issued.
+ *
+ * @param ec     the event count
+ * @param token  the wait token
+ *
+ * @return true if the event counter no longer matches the token
+ **/
+static INLINE bool hasEventChanged(EventCount *ec, EventToken token)
+{
+  return !sameEvent(token, atomic64_read(&ec->state));
+}
+
 /**********************************************************************/
 bool eventCountWait(EventCount *ec, EventToken token, const RelTime *timeout)
+{
+  if (timeout == NULL) {
+    while (wait_event_interruptible(ec->waitQueue,
+                                    hasEventChanged(ec, token)) != 0) {
+      // Interrupted by a signal; keep waiting.
+    }
+    return true;
+  }
+
+  /*
+   * If the wait is interrupted by a signal, let the caller see a timeout,
+   * which it must already be prepared for, rather than track the time left.
+   */
+  long remaining = usecs_to_jiffies(relTimeToMicroseconds(*timeout));
+  if ((remaining > 0)
+      && (wait_event_interruptible_timeout(ec->waitQueue,
+                                           hasEventChanged(ec, token),
+                                           remaining) > 0)) {
+    return true;
+  }
+
+  // The wait timed out, so the token must be cancelled, unless a signaller
+  // came in first, in which case the event has happened.
+  return !fastCancel(ec, token);
+}
+#else
+bool eventCountWait(EventCount *ec, EventToken token, const RelTime *timeout)
 {
 
   for (;;) {
@@ -315,3 +385,4 @@ bool eventCountWait(EventCount *ec, EventToken token, const RelTime *timeout)
     yieldScheduler();
   }
 }
+#endif
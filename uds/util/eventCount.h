@@ -84,8 +84,11 @@ void freeEventCount(EventCount *ec);
  * Wake all threads that are waiting for the next event.
  *
  * @param ec  the EventCount to signal
+ *
+ * @return true if there were waiters to wake, or false if there were none,
+ *         in which case no wakeup was needed
  **/
-void eventCountBroadcast(EventCount *ec);
+bool eventCountBroadcast(EventCount *ec);
 
 /**
  * Prepare to wait for the EventCount to change by capturing a token of its
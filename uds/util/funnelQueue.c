@@ -135,6 +135,50 @@ FunnelQueueEntry *funnelQueuePoll(FunnelQueue *queue)
   return oldest;
 }
 
+/**********************************************************************/
+FunnelQueueEntry *funnelQueuePollBatch(FunnelQueue  *queue,
+                                       unsigned int  maxEntries,
+                                       unsigned int *countPtr)
+{
+  unsigned int count = 0;
+  FunnelQueueEntry *first = getOldest(queue);
+  if (first != NULL) {
+    /*
+     * getOldest() guarantees that the first entry has a successor. Extend
+     * the run as long as the successor is a real entry which has a successor
+     * of its own; the entry at which it stops stays behind as queue->oldest,
+     * as it would after funnelQueuePoll(), so no producer's next field is
+     * ever touched.
+     */
+    FunnelQueueEntry *last = first;
+    FunnelQueueEntry *next = first->next;
+    for (count = 1; count < maxEntries; count++) {
+      if (next == &queue->stub) {
+        break;
+      }
+      smp_read_barrier_depends();
+      FunnelQueueEntry *after = next->next;
+      if (after == NULL) {
+        break;
+      }
+      last = next;
+      next = after;
+    }
+
+    queue->oldest = next;
+    // Make sure the caller sees the proper stored data for these entries, as
+    // in funnelQueuePoll().
+    smp_rmb();
+    prefetchAddress(queue->oldest, true);
+    last->next = NULL;
+  }
+
+  if (countPtr != NULL) {
+    *countPtr = count;
+  }
+  return first;
+}
+
 /**********************************************************************/
 bool isFunnelQueueEmpty(FunnelQueue *queue)
 {
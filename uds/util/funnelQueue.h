@@ -111,29 +111,31 @@ int makeFunnelQueue(FunnelQueue **queuePtr)
 void freeFunnelQueue(FunnelQueue *queue);
 
 /**
- * Put an entry on the end of the queue.
- *
- * The entry pointer must be to the FunnelQueueEntry embedded in the caller's
- * data structure. The caller must be able to derive the address of the start
- * of their data structure from the pointer that passed in here, so every
- * entry in the queue must have the FunnelQueueEntry at the same offset within
- * the client's structure.
- *
- * @param queue  the queue on which to place the entry
- * @param entry  the entry to be added to the queue
+ * Put a chain of entries on the end of the queue with a single atomic
+ * exchange. The entries must already be linked from first to last through
+ * their next fields; the next field of the last entry will be cleared. Like
+ * funnelQueuePut(), the chain is appended atomically, so the entries will be
+ * consumed in order and no other producer's entry will come between them.
+ *
+ * @param queue  the queue on which to place the entries
+ * @param first  the first entry of the chain
+ * @param last   the last entry of the chain
  **/
-static INLINE void funnelQueuePut(FunnelQueue *queue, FunnelQueueEntry *entry)
+static INLINE void funnelQueuePutChain(FunnelQueue      *queue,
+                                       FunnelQueueEntry *first,
+                                       FunnelQueueEntry *last)
 {
   /*
-   * Barrier requirements: All stores relating to the entry ("next" pointer,
-   * containing data structure fields) must happen before the previous->next
-   * store making it visible to the consumer. Also, the entry's "next" field
-   * initialization to NULL must happen before any other producer threads can
-   * see the entry (the xchg) and try to update the "next" field.
+   * Barrier requirements: All stores relating to the entries ("next"
+   * pointers, containing data structure fields) must happen before the
+   * previous->next store making them visible to the consumer. Also, the last
+   * entry's "next" field initialization to NULL must happen before any other
+   * producer threads can see the entry (the xchg) and try to update the
+   * "next" field.
    *
    * xchg implements a full barrier.
    */
-  entry->next = NULL;
+  last->next = NULL;
   /*
    * The xchg macro in the PPC kernel calls a function that takes a void*
    * argument, triggering a warning about dropping the volatile qualifier.
@@ -142,11 +144,28 @@ static INLINE void funnelQueuePut(FunnelQueue *queue, FunnelQueueEntry *entry)
 #if __GNUC__ >= 5
 #pragma GCC diagnostic ignored "-Wdiscarded-qualifiers"
 #endif
-  FunnelQueueEntry *previous = xchg(&queue->newest, entry);
+  FunnelQueueEntry *previous = xchg(&queue->newest, last);
 #pragma GCC diagnostic pop
   // Pre-empts between these two statements hide the rest of the queue from
   // the consumer, preventing consumption until the following assignment runs.
-  previous->next = entry;
+  previous->next = first;
+}
+
+/**
+ * Put an entry on the end of the queue.
+ *
+ * The entry pointer must be to the FunnelQueueEntry embedded in the caller's
+ * data structure. The caller must be able to derive the address of the start
+ * of their data structure from the pointer that passed in here, so every
+ * entry in the queue must have the FunnelQueueEntry at the same offset within
+ * the client's structure.
+ *
+ * @param queue  the queue on which to place the entry
+ * @param entry  the entry to be added to the queue
+ **/
+static INLINE void funnelQueuePut(FunnelQueue *queue, FunnelQueueEntry *entry)
+{
+  funnelQueuePutChain(queue, entry, entry);
 }
 
 /**
@@ -160,6 +179,27 @@ static INLINE void funnelQueuePut(FunnelQueue *queue, FunnelQueueEntry *entry)
 FunnelQueueEntry *funnelQueuePoll(FunnelQueue *queue)
   __attribute__((warn_unused_result));
 
+/**
+ * Poll a queue, removing a run of its oldest entries at once if the queue is
+ * not empty. The entries are returned linked from oldest to newest through
+ * their next fields, and the last one's next field is NULL. The consumer can
+ * then work through them without touching the queue again. Only entries
+ * whose successors are already linked are taken after the first, so a
+ * partly completed put ends the run early rather than being waited for.
+ * This function must only be called from a single consumer thread.
+ *
+ * @param [in]  queue       the queue from which to remove entries
+ * @param [in]  maxEntries  the most entries to remove, which must not be 0
+ * @param [out] countPtr    if not NULL, a pointer to hold the number of
+ *                          entries removed
+ *
+ * @return the oldest entry in the queue, or NULL if the queue is empty.
+ **/
+FunnelQueueEntry *funnelQueuePollBatch(FunnelQueue  *queue,
+                                       unsigned int  maxEntries,
+                                       unsigned int *countPtr)
+  __attribute__((warn_unused_result));
+
 /**
  * Check whether the funnel queue is empty or not. This function must only be
  * called from a single consumer thread, as with funnelQueuePoll.
@@ -21,6 +21,7 @@
 
 #include "volume.h"
 
+#include "cacheBudget.h"
 #include "cacheCounters.h"
 #include "chapterIndex.h"
 #include "compiler.h"
@@ -41,6 +42,10 @@ enum {
   MAX_BAD_CHAPTERS = 100,           // max number of contiguous bad chapters
   DEFAULT_VOLUME_READ_THREADS = 2,  // Default number of reader threads
   MAX_VOLUME_READ_THREADS = 16,     // Maximum number of reader threads
+  MAX_COALESCED_READ_PAGES = 16,    // Maximum pages fetched by a single read
+  READ_AHEAD_STREAK = 4,            // Searches in a chapter before read-ahead
+  READ_AHEAD_PAGES = 8,             // Record pages to read ahead
+  MAX_WARM_SPARSE_CHAPTERS = 16,    // Sparse chapters saved for warm restart
 };
 
 /**********************************************************************/
@@ -225,6 +230,48 @@ static int initializeIndexPage(const Volume *volume,
   return result;
 }
 
+/**
+ * Determine how many record pages following a reserved record page also have
+ * queued reads, so that they can be fetched from storage in the same I/O.
+ * The run never extends past the end of the chapter.
+ *
+ * @param volume        the volume
+ * @param physicalPage  the reserved page
+ *
+ * @return the number of following pages to fetch along with the page
+ **/
+static unsigned int getCoalescedReadCount(Volume       *volume,
+                                          unsigned int  physicalPage)
+{
+  // We hold the readThreadsMutex.
+  Geometry *geometry = volume->geometry;
+  unsigned int limit
+    = geometry->pagesPerChapter - 1 - mapToPageNumber(geometry, physicalPage);
+  if (limit > MAX_COALESCED_READ_PAGES - 1) {
+    limit = MAX_COALESCED_READ_PAGES - 1;
+  }
+  return countQueuedSuccessors(volume->pageCache, physicalPage, limit);
+}
+
+/**
+ * Restart a list of requests which were waiting on a page read. This is done
+ * without holding the readThreadsMutex so that the zone threads are not held
+ * up while a whole batch of waiters is requeued.
+ *
+ * @param requestList  the first request in the list
+ * @param result       the result of the read
+ **/
+static void restartRequestList(Request *requestList, int result)
+{
+  while (requestList != NULL) {
+    Request *request = requestList;
+    requestList = request->nextRequest;
+    // reflect any read failures in the request status
+    request->status = result;
+    restartRequest(request);
+  }
+}
+
 /**********************************************************************/
 static void readThreadFunction(void *arg)
 {
@@ -253,7 +300,16 @@ static void readThreadFunction(void *arg)
       // Find a place to put the read queue page we reserved above.
       result = selectVictimInCache(volume->pageCache, &page);
       if (result == UDS_SUCCESS) {
+        unsigned int successors
+          = (recordPage ? getCoalescedReadCount(volume, physicalPage) : 0);
         unlockMutex(&volume->readThreadsMutex);
+        if (successors > 0) {
+          // Issue the reads of the following pages along with this one. The
+          // reader threads which reserve them will find them already in
+          // flight.
+          prefetchVolumePages(&volume->volumeStore, physicalPage,
+                              successors + 1);
+        }
         result = readVolumePage(&volume->volumeStore, physicalPage,
                                 &page->cp_pageData);
         if (result != UDS_SUCCESS) {
@@ -297,10 +353,13 @@ static void readThreadFunction(void *arg)
       page = NULL;
     }
 
-    while (requestList != NULL) {
-      Request *request = requestList;
-      requestList = request->nextRequest;
-
+    /*
+     * The page is no longer marked as queued, so no more requests can be
+     * added to the list.
+     */
+    Request *request;
+    for (request = requestList; request != NULL;
+         request = request->nextRequest) {
       /*
        * If we've read in a record page, we're going to do an immediate search,
        * in an attempt to speed up processing when we requeue the request, so
@@ -312,25 +371,24 @@ static void readThreadFunction(void *arg)
        * again.
        */
       if ((result == UDS_SUCCESS) && (page != NULL) && recordPage) {
-        if (searchRecordPage(getPageData(&page->cp_pageData),
-                             &request->chunkName, volume->geometry,
-                             &request->oldMetadata)) {
+        if (searchRecordPage(volume, getPageData(&page->cp_pageData),
+                             &request->chunkName, &request->oldMetadata)) {
           request->slLocation = LOC_IN_DENSE;
         } else {
           request->slLocation = LOC_UNAVAILABLE;
         }
         request->slLocationKnown = true;
       }
-
-      // reflect any read failures in the request status
-      request->status = result;
-      restartRequest(request);
     }
 
     releaseReadQueueEntry(volume->pageCache, queuePos);
 
     volume->busyReaderThreads--;
     broadcastCond(&volume->readThreadsReadDoneCond);
+
+    unlockMutex(&volume->readThreadsMutex);
+    restartRequestList(requestList, result);
+    lockMutex(&volume->readThreadsMutex);
   }
   unlockMutex(&volume->readThreadsMutex);
   logDebug("reader done");
@@ -410,8 +468,7 @@ int getPageLocked(Volume          *volume,
     if (result != UDS_SUCCESS) {
       return result;
     }
-  } else if (getZoneNumber(request) == 0) {
-    // Only 1 zone is responsible for updating LRU
+  } else {
     makePageMostRecent(volume->pageCache, page);
   }
 
@@ -508,10 +565,7 @@ int getPageProtected(Volume          *volume,
     beginPendingSearch(volume->pageCache, physicalPage, zoneNumber);
     unlockMutex(&volume->readThreadsMutex);
   } else {
-    if (getZoneNumber(request) == 0 ) {
-      // Only 1 zone is responsible for updating LRU
-      makePageMostRecent(volume->pageCache, page);
-    }
+    makePageMostRecent(volume->pageCache, page);
   }
 
   *pagePtr = page;
@@ -650,7 +704,7 @@ int searchCachedRecordPage(Volume             *volume,
     return result;
   }
 
-  if (searchRecordPage(getPageData(&recordPage->cp_pageData), name, geometry,
+  if (searchRecordPage(volume, getPageData(&recordPage->cp_pageData), name,
                        duplicate)) {
     *found = true;
   }
@@ -691,6 +745,154 @@ int readChapterIndexFromVolume(const Volume       *volume,
   return result;
 }
 
+/**
+ * Note a record page search by a zone, and if the zone has searched the same
+ * chapter several times in a row, read ahead the chapter's index pages and
+ * the record pages following the one being searched. The read-ahead goes
+ * through the volume store, so the pages will already be in memory when the
+ * page cache reads them.
+ *
+ * @param volume            the volume
+ * @param request           the request doing the search
+ * @param chapter           the physical chapter being searched
+ * @param recordPageNumber  the record page of the chapter being searched
+ **/
+static void readAhead(Volume       *volume,
+                      Request      *request,
+                      unsigned int  chapter,
+                      unsigned int  recordPageNumber)
+{
+  if ((request == NULL) || (volume->lookupMode == LOOKUP_FOR_REBUILD)) {
+    return;
+  }
+
+  Geometry       *geometry = volume->geometry;
+  CacheCounters  *counters = &volume->pageCache->counters;
+  ReadAheadState *state    = &volume->readAhead[request->zoneNumber];
+  if (state->chapter != chapter) {
+    *state = (ReadAheadState) { .chapter = chapter };
+  }
+
+  bool inWindow = ((recordPageNumber >= state->windowStart)
+                   && (recordPageNumber < state->windowEnd));
+  if (state->windowEnd > state->windowStart) {
+    incrementReadAheadCounter(counters, inWindow);
+  }
+
+  if (++state->streak < READ_AHEAD_STREAK) {
+    return;
+  }
+
+  if (!state->indexPagesFetched) {
+    prefetchVolumePages(&volume->volumeStore,
+                        mapToPhysicalPage(geometry, chapter, 0),
+                        geometry->indexPagesPerChapter);
+    addReadAheadPages(counters, geometry->indexPagesPerChapter);
+    state->indexPagesFetched = true;
+  }
+
+  // Don't extend the window until the searches are half way through it.
+  if (inWindow
+      && ((state->windowEnd - recordPageNumber) > (READ_AHEAD_PAGES / 2))) {
+    return;
+  }
+
+  unsigned int first = (inWindow ? state->windowEnd : recordPageNumber + 1);
+  unsigned int last  = recordPageNumber + 1 + READ_AHEAD_PAGES;
+  if (last > geometry->recordPagesPerChapter) {
+    last = geometry->recordPagesPerChapter;
+  }
+  if (first >= last) {
+    return;
+  }
+
+  prefetchVolumePages(&volume->volumeStore,
+                      mapToPhysicalPage(geometry, chapter,
+                                        geometry->indexPagesPerChapter
+                                        + first),
+                      last - first);
+  addReadAheadPages(counters, last - first);
+  if (!inWindow) {
+    state->windowStart = first;
+  }
+  state->windowEnd = last;
+}
+
+/**
+ * Get the record page hint a zone would keep for a name.
+ *
+ * @param volume   the volume
+ * @param request  the request doing the search
+ * @param name     the name being searched for
+ *
+ * @return the hint slot for the name
+ **/
+static INLINE RecordPageHint *getRecordPageHint(Volume             *volume,
+                                                Request            *request,
+                                                const UdsChunkName *name)
+{
+  unsigned int slot = ((unsigned int) extractChapterIndexBytes(name)
+                       & (RECORD_PAGE_HINTS_PER_ZONE - 1));
+  return &volume->recordPageHints[(request->zoneNumber
+                                   * RECORD_PAGE_HINTS_PER_ZONE) + slot];
+}
+
+/**********************************************************************/
+static INLINE uint32_t getRecordPageHintKey(const UdsChunkName *name)
+{
+  return (uint32_t) extractMasterIndexBytes(name);
+}
+
+/**
+ * Search the record page on which a zone last found a name, without looking
+ * at the chapter's index page. This is only done if the zone has a hint for
+ * the name in the chapter and the page is already in the page cache, since
+ * a request waiting for a page read must be searching the correct page.
+ *
+ * @param volume           the volume
+ * @param request          the request doing the search
+ * @param name             the name being searched for
+ * @param virtualChapter   the virtual chapter being searched
+ * @param physicalChapter  the physical chapter being searched
+ * @param metadata         the old metadata for the name, if found
+ *
+ * @return <code>true</code> if the name was found on the hinted page
+ **/
+static bool searchHintedRecordPage(Volume             *volume,
+                                   Request            *request,
+                                   const UdsChunkName *name,
+                                   uint64_t            virtualChapter,
+                                   unsigned int        physicalChapter,
+                                   UdsChunkData       *metadata)
+{
+  if ((request == NULL) || (volume->lookupMode == LOOKUP_FOR_REBUILD)) {
+    return false;
+  }
+
+  const RecordPageHint *hint = getRecordPageHint(volume, request, name);
+  if ((hint->virtualChapter != virtualChapter)
+      || (hint->nameKey != getRecordPageHintKey(name))) {
+    return false;
+  }
+
+  Geometry *geometry = volume->geometry;
+  unsigned int pageNumber
+    = geometry->indexPagesPerChapter + hint->recordPageNumber;
+  int physicalPage = mapToPhysicalPage(geometry, physicalChapter, pageNumber);
+  beginPendingSearch(volume->pageCache, physicalPage, request->zoneNumber);
+
+  CachedPage *page = NULL;
+  int result = getPageFromCache(volume->pageCache, physicalPage,
+                                (cacheProbeType(request, false)
+                                 | CACHE_PROBE_IGNORE_FAILURE),
+                                &page);
+  bool found = ((result == UDS_SUCCESS) && (page != NULL)
+                && searchRecordPage(volume, getPageData(&page->cp_pageData),
+                                    name, metadata));
+  endPendingSearch(volume->pageCache, request->zoneNumber);
+  return found;
+}
+
 /**********************************************************************/
 int searchVolumePageCache(Volume             *volume,
                           Request            *request,
@@ -701,6 +903,12 @@ int searchVolumePageCache(Volume             *volume,
 {
   unsigned int physicalChapter
     = mapToPhysicalChapter(volume->geometry, virtualChapter);
+  if (searchHintedRecordPage(volume, request, name, virtualChapter,
+                             physicalChapter, metadata)) {
+    *found = true;
+    return UDS_SUCCESS;
+  }
+
   unsigned int indexPageNumber;
   int result = findIndexPageNumber(volume->indexPageMap, name, physicalChapter,
                                    &indexPageNumber);
@@ -711,11 +919,22 @@ int searchVolumePageCache(Volume             *volume,
   int recordPageNumber;
   result = searchCachedIndexPage(volume, request, name, physicalChapter,
                                  indexPageNumber, &recordPageNumber);
+  if ((result == UDS_SUCCESS) && (recordPageNumber != NO_CHAPTER_INDEX_ENTRY)) {
+    readAhead(volume, request, physicalChapter, recordPageNumber);
+  }
   if (result == UDS_SUCCESS) {
     result = searchCachedRecordPage(volume, request, name, physicalChapter,
                                     recordPageNumber, metadata, found);
   }
 
+  if ((result == UDS_SUCCESS) && *found && (request != NULL)) {
+    *getRecordPageHint(volume, request, name) = (RecordPageHint) {
+      .virtualChapter   = virtualChapter,
+      .nameKey          = getRecordPageHintKey(name),
+      .recordPageNumber = recordPageNumber,
+    };
+  }
+
   return result;
 }
 
@@ -858,54 +1077,89 @@ int writeIndexPages(Volume            *volume,
 }
 
 /**********************************************************************/
-int writeRecordPages(Volume                *volume,
-                     int                    physicalPage,
-                     const UdsChunkRecord   records[],
-                     byte                 **pages)
+void startRecordPageClaims(Volume *volume)
+{
+  atomic_set(&volume->recordPagesClaimed, 0);
+}
+
+/**********************************************************************/
+int writeClaimedRecordPages(Volume                *volume,
+                            unsigned int           writerNumber,
+                            int                    physicalPage,
+                            const UdsChunkRecord   records[],
+                            byte                 **pages)
 {
   Geometry *geometry = volume->geometry;
+  RecordPageWriter *writer = &volume->recordWriters[writerNumber];
   // Skip over the index pages, which come before the record pages
   physicalPage += geometry->indexPagesPerChapter;
-  // The record array from the open chapter is 1-based.
-  const UdsChunkRecord *nextRecord = &records[1];
 
-  unsigned int recordPageNumber;
-  for (recordPageNumber = 0;
-       recordPageNumber < geometry->recordPagesPerChapter;
-       recordPageNumber++) {
+  for (;;) {
+    unsigned int recordPageNumber
+      = atomic_inc_return(&volume->recordPagesClaimed) - 1;
+    if (recordPageNumber >= geometry->recordPagesPerChapter) {
+      return UDS_SUCCESS;
+    }
+
     int result = prepareToWriteVolumePage(&volume->volumeStore,
                                           physicalPage + recordPageNumber,
-                                          &volume->scratchPage);
+                                          &writer->scratchPage);
     if (result != UDS_SUCCESS) {
       return logWarningWithStringError(result,
                                        "failed to prepare record page");
     }
 
-    // Sort the next page of records and copy them to the record page as a
-    // binary tree stored in heap order.
-    result = encodeRecordPage(volume, nextRecord,
-                              getPageData(&volume->scratchPage));
+    // Sort the page of records and copy them to the record page as a search
+    // tree. The record array from the open chapter is 1-based.
+    const UdsChunkRecord *pageRecords
+      = &records[1 + (recordPageNumber * geometry->recordsPerPage)];
+    result = encodeRecordPage(volume, writer, pageRecords,
+                              getPageData(&writer->scratchPage));
     if (result != UDS_SUCCESS) {
       return logWarningWithStringError(result,
                                        "failed to encode record page %u",
                                        recordPageNumber);
     }
-    nextRecord += geometry->recordsPerPage;
 
     result = writeVolumePage(&volume->volumeStore,
                              physicalPage + recordPageNumber,
-                             &volume->scratchPage);
+                             &writer->scratchPage);
     if (result != UDS_SUCCESS) {
       return logWarningWithStringError(result,
                                        "failed to write chapter record page");
     }
 
     if (pages != NULL) {
-      memcpy(pages[recordPageNumber], getPageData(&volume->scratchPage),
+      memcpy(pages[recordPageNumber], getPageData(&writer->scratchPage),
              geometry->bytesPerPage);
     }
   }
-  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+int writeRecordPages(Volume                *volume,
+                     int                    physicalPage,
+                     const UdsChunkRecord   records[],
+                     byte                 **pages)
+{
+  startRecordPageClaims(volume);
+  return writeClaimedRecordPages(volume, 0, physicalPage, records, pages);
+}
+
+/**********************************************************************/
+int finishChapterWrite(Volume *volume)
+{
+  releaseVolumePage(&volume->scratchPage);
+  unsigned int i;
+  for (i = 0; i < RECORD_PAGE_WRITERS; i++) {
+    releaseVolumePage(&volume->recordWriters[i].scratchPage);
+  }
+  // Flush the data to permanent storage.
+  int result = syncVolumeStore(&volume->volumeStore);
+  // A chapter write is a convenient point to share out the page cache
+  // budget again, since it is off the zone threads and infrequent.
+  rebalanceCacheBudget(false);
+  return result;
 }
 
 /**********************************************************************/
@@ -929,9 +1183,7 @@ int writeChapter(Volume                 *volume,
   if (result != UDS_SUCCESS) {
     return result;
   }
-  releaseVolumePage(&volume->scratchPage);
-  // Flush the data to permanent storage.
-  return syncVolumeStore(&volume->volumeStore);
+  return finishChapterWrite(volume);
 }
 
 /**********************************************************************/
@@ -1056,6 +1308,165 @@ static int findRealEndOfVolume(Volume       *volume,
   return UDS_SUCCESS;
 }
 
+/**
+ * The pages of one chapter found in the caches by listWarmChapters().
+ **/
+typedef struct {
+  unsigned int count;
+  unsigned int firstPage;
+  unsigned int lastPage;
+} ChapterPages;
+
+/**
+ * Note that a page of a chapter is cached.
+ *
+ * @param chapter  the chapter's cached pages
+ * @param page     the page, counting from the start of the chapter
+ * @param weight   the number of pages the page stands for
+ **/
+static void addWarmPage(ChapterPages *chapter,
+                        unsigned int  page,
+                        unsigned int  weight)
+{
+  if ((chapter->count == 0) || (page < chapter->firstPage)) {
+    chapter->firstPage = page;
+  }
+  if ((chapter->count == 0) || (page > chapter->lastPage)) {
+    chapter->lastPage = page;
+  }
+  chapter->count += weight;
+}
+
+/**
+ * Count the cached pages of each chapter. A chapter in the sparse cache
+ * counts as having all its index pages cached.
+ *
+ * @param volume  the volume
+ * @param pages   the array of per-chapter counts to fill in
+ **/
+static void countWarmPages(Volume *volume, ChapterPages *pages)
+{
+  const Geometry *geometry = volume->geometry;
+  PageCache      *cache    = volume->pageCache;
+  lockMutex(&volume->readThreadsMutex);
+  unsigned int i;
+  for (i = 0; i < cache->numCacheEntries; i++) {
+    const CachedPage *page = &cache->cache[i];
+    if (page->cp_readPending || (page->cp_physicalPage == 0)
+        || (page->cp_physicalPage >= cache->numIndexEntries)) {
+      continue;
+    }
+    unsigned int chapterPage = page->cp_physicalPage - 1;
+    addWarmPage(&pages[chapterPage / geometry->pagesPerChapter],
+                chapterPage % geometry->pagesPerChapter, 1);
+  }
+  unlockMutex(&volume->readThreadsMutex);
+
+  if (volume->sparseCache == NULL) {
+    return;
+  }
+
+  uint64_t sparseChapters[MAX_WARM_SPARSE_CHAPTERS];
+  unsigned int count = listSparseCacheChapters(volume->sparseCache,
+                                               sparseChapters,
+                                               MAX_WARM_SPARSE_CHAPTERS);
+  for (i = 0; i < count; i++) {
+    ChapterPages *chapter
+      = &pages[mapToPhysicalChapter(geometry, sparseChapters[i])];
+    addWarmPage(chapter, 0, geometry->indexPagesPerChapter);
+    addWarmPage(chapter, geometry->indexPagesPerChapter - 1, 0);
+  }
+}
+
+/**********************************************************************/
+unsigned int listWarmChapters(Volume       *volume,
+                              WarmChapter  *chapters,
+                              unsigned int  maxCount)
+{
+  const Geometry *geometry = volume->geometry;
+  ChapterPages   *pages;
+  int result = ALLOCATE(geometry->chaptersPerVolume, ChapterPages, __func__,
+                        &pages);
+  if (result != UDS_SUCCESS) {
+    logWarningWithStringError(result, "cannot list cached chapters");
+    return 0;
+  }
+
+  countWarmPages(volume, pages);
+
+  // Pick the chapters with the most cached pages, marking each one picked by
+  // making its count zero, until the spans would overflow the page cache.
+  unsigned int budget = volume->pageCache->numCacheEntries;
+  unsigned int count  = 0;
+  unsigned int i;
+  while (count < maxCount) {
+    unsigned int best = 0;
+    for (i = 1; i < geometry->chaptersPerVolume; i++) {
+      if (pages[i].count > pages[best].count) {
+        best = i;
+      }
+    }
+
+    unsigned int span = pages[best].lastPage - pages[best].firstPage + 1;
+    if ((pages[best].count == 0) || (span > budget)) {
+      break;
+    }
+
+    budget -= span;
+    pages[best].count = 0;
+    chapters[count++] = (WarmChapter) {
+      .physicalChapter = best,
+      .firstPage       = pages[best].firstPage,
+      .pageCount       = span,
+    };
+  }
+  FREE(pages);
+
+  // Put the picked chapters in physical order so the reads sweep the volume.
+  unsigned int j;
+  for (i = 1; i < count; i++) {
+    WarmChapter chapter = chapters[i];
+    for (j = i; (j > 0)
+           && (chapters[j - 1].physicalChapter > chapter.physicalChapter);
+         j--) {
+      chapters[j] = chapters[j - 1];
+    }
+    chapters[j] = chapter;
+  }
+  return count;
+}
+
+/**********************************************************************/
+void prefetchWarmChapters(Volume            *volume,
+                          const WarmChapter *chapters,
+                          unsigned int       count)
+{
+  const Geometry *geometry   = volume->geometry;
+  unsigned int    totalPages = 0;
+  unsigned int    i;
+  for (i = 0; i < count; i++) {
+    const WarmChapter *chapter = &chapters[i];
+    if ((chapter->physicalChapter >= geometry->chaptersPerVolume)
+        || (chapter->firstPage >= geometry->pagesPerChapter)
+        || (chapter->pageCount
+            > (geometry->pagesPerChapter - chapter->firstPage))) {
+      continue;
+    }
+
+    prefetchVolumePages(&volume->volumeStore,
+                        mapToPhysicalPage(geometry, chapter->physicalChapter,
+                                          chapter->firstPage),
+                        chapter->pageCount);
+    totalPages += chapter->pageCount;
+  }
+
+  if (totalPages > 0) {
+    addReadAheadPages(&volume->pageCache->counters, totalPages);
+    logInfo("reading %u cached pages of %u chapters back in", totalPages,
+            count);
+  }
+}
+
 /**********************************************************************/
 int findVolumeChapterBoundaries(Volume   *volume,
                                 uint64_t *lowestVCN,
@@ -1206,6 +1617,7 @@ static int allocateVolume(const Configuration  *config,
                           IndexLayout          *layout,
                           unsigned int          readQueueMaxSize,
                           unsigned int          zoneCount,
+                          bool                  directReads,
                           Volume              **newVolume)
 {
   Volume *volume;
@@ -1214,6 +1626,7 @@ static int allocateVolume(const Configuration  *config,
     return result;
   }
   volume->nonce = getVolumeNonce(layout);
+  volume->blockedRecordPages = getIndexVersion(layout)->blockedRecordPages;
   // It is safe to call freeVolume now to clean up and close the volume
 
   result = copyGeometry(config->geometry, &volume->geometry);
@@ -1223,18 +1636,21 @@ static int allocateVolume(const Configuration  *config,
                                      "failed to allocate geometry: error");
   }
 
-  // Need a buffer for each entry in the page cache
+  // Need a buffer for each entry in the page cache, unless pages are read
+  // directly into memory of their own
   unsigned int reservedBuffers
-    = config->cacheChapters * config->geometry->recordPagesPerChapter;
-  // And a buffer for the chapter writer
-  reservedBuffers += 1;
-  // And a buffer for each entry in the sparse cache
-  if (isSparse(volume->geometry)) {
+    = (directReads
+       ? 0 : config->cacheChapters * config->geometry->recordPagesPerChapter);
+  // And a buffer for each of the chapter writer's index and record pages
+  reservedBuffers += 1 + RECORD_PAGE_WRITERS;
+  // And a buffer for each entry in the sparse cache, including the spare
+  if (!directReads && isSparse(volume->geometry)) {
     reservedBuffers
-      += config->cacheChapters * config->geometry->indexPagesPerChapter;
+      += ((config->cacheChapters + 1)
+          * config->geometry->indexPagesPerChapter);
   }
   result = openVolumeStore(&volume->volumeStore, layout, reservedBuffers,
-                           config->geometry->bytesPerPage);
+                           config->geometry, directReads);
   if (result != UDS_SUCCESS) {
     freeVolume(volume);
     return result;
@@ -1245,18 +1661,29 @@ static int allocateVolume(const Configuration  *config,
     return result;
   }
 
-  result = makeRadixSorter(config->geometry->recordsPerPage,
-                           &volume->radixSorter);
-  if (result != UDS_SUCCESS) {
-    freeVolume(volume);
-    return result;
-  }
+  unsigned int i;
+  for (i = 0; i < RECORD_PAGE_WRITERS; i++) {
+    RecordPageWriter *writer = &volume->recordWriters[i];
+    result = initializeVolumePage(config->geometry, &writer->scratchPage);
+    if (result != UDS_SUCCESS) {
+      freeVolume(volume);
+      return result;
+    }
 
-  result = ALLOCATE(config->geometry->recordsPerPage, const UdsChunkRecord *,
-                    "record pointers", &volume->recordPointers);
-  if (result != UDS_SUCCESS) {
-    freeVolume(volume);
-    return result;
+    result = makeRadixSorter(config->geometry->recordsPerPage,
+                             &writer->radixSorter);
+    if (result != UDS_SUCCESS) {
+      freeVolume(volume);
+      return result;
+    }
+
+    result = ALLOCATE(config->geometry->recordsPerPage,
+                      const UdsChunkRecord *, "record pointers",
+                      &writer->recordPointers);
+    if (result != UDS_SUCCESS) {
+      freeVolume(volume);
+      return result;
+    }
   }
 
   if (isSparse(volume->geometry)) {
@@ -1273,6 +1700,18 @@ static int allocateVolume(const Configuration  *config,
     freeVolume(volume);
     return result;
   }
+  result = ALLOCATE(zoneCount, ReadAheadState, "volume read-ahead",
+                    &volume->readAhead);
+  if (result != UDS_SUCCESS) {
+    freeVolume(volume);
+    return result;
+  }
+  result = ALLOCATE(zoneCount * RECORD_PAGE_HINTS_PER_ZONE, RecordPageHint,
+                    "record page hints", &volume->recordPageHints);
+  if (result != UDS_SUCCESS) {
+    freeVolume(volume);
+    return result;
+  }
   result = makeIndexPageMap(volume->geometry, &volume->indexPageMap);
   if (result != UDS_SUCCESS) {
     freeVolume(volume);
@@ -1292,15 +1731,23 @@ int makeVolume(const Configuration          *config,
                Volume                      **newVolume)
 {
   unsigned int volumeReadThreads = getReadThreads(userParams);
+  if ((userParams != NULL) && (userParams->read_queue_depth > 0)) {
+    readQueueMaxSize = userParams->read_queue_depth;
+  }
 
+  if (readQueueMaxSize > VOLUME_CACHE_MAX_ENTRIES) {
+    logError("Read queue depth must be at most %u", VOLUME_CACHE_MAX_ENTRIES);
+    return UDS_INVALID_ARGUMENT;
+  }
   if (readQueueMaxSize <= volumeReadThreads) {
     logError("Number of read threads must be smaller than read queue");
     return UDS_INVALID_ARGUMENT;
   }
 
   Volume *volume = NULL;
+  bool directReads = ((userParams != NULL) && userParams->direct_reads);
   int result = allocateVolume(config, layout, readQueueMaxSize, zoneCount,
-                              &volume);
+                              directReads, &volume);
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -1340,6 +1787,7 @@ int makeVolume(const Configuration          *config,
     volume->numReadThreads = i + 1;
   }
 
+  addVolumeToCacheBudget(volume);
   *newVolume = volume;
   return UDS_SUCCESS;
 }
@@ -1351,6 +1799,8 @@ void freeVolume(Volume *volume)
     return;
   }
 
+  removeVolumeFromCacheBudget(volume);
+
   // If readerThreads is NULL, then we haven't set up the reader threads.
   if (volume->readerThreads != NULL) {
     // Stop the reader threads.  It is ok if there aren't any of them.
@@ -1366,9 +1816,15 @@ void freeVolume(Volume *volume)
     volume->readerThreads = NULL;
   }
 
-  // Must close the volume store AFTER freeing the scratch page and the caches
+  // Must close the volume store AFTER freeing the scratch pages and the caches
   destroyVolumePage(&volume->scratchPage);
+  unsigned int i;
+  for (i = 0; i < RECORD_PAGE_WRITERS; i++) {
+    destroyVolumePage(&volume->recordWriters[i].scratchPage);
+  }
   freePageCache(volume->pageCache);
+  FREE(volume->readAhead);
+  FREE(volume->recordPageHints);
   freeSparseCache(volume->sparseCache);
   closeVolumeStore(&volume->volumeStore);
 
@@ -1376,8 +1832,10 @@ void freeVolume(Volume *volume)
   destroyCond(&volume->readThreadsReadDoneCond);
   destroyMutex(&volume->readThreadsMutex);
   freeIndexPageMap(volume->indexPageMap);
-  freeRadixSorter(volume->radixSorter);
+  for (i = 0; i < RECORD_PAGE_WRITERS; i++) {
+    freeRadixSorter(volume->recordWriters[i].radixSorter);
+    FREE(volume->recordWriters[i].recordPointers);
+  }
   FREE(volume->geometry);
-  FREE(volume->recordPointers);
   FREE(volume);
 }
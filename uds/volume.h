@@ -22,6 +22,7 @@
 #ifndef VOLUME_H
 #define VOLUME_H
 
+#include "atomicDefs.h"
 #include "cacheCounters.h"
 #include "common.h"
 #include "chapterIndex.h"
@@ -59,6 +60,70 @@ typedef enum indexLookupMode {
   LOOKUP_FOR_REBUILD
 } IndexLookupMode;
 
+/**
+ * The read-ahead state of one zone. Each zone tracks its own streak of
+ * searches so that no state is shared between zone threads.
+ **/
+typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) readAheadState {
+  /* The physical chapter of the current streak */
+  unsigned int chapter;
+  /* The number of consecutive record page searches in the chapter */
+  unsigned int streak;
+  /* The first record page of the chapter covered by read-ahead */
+  unsigned int windowStart;
+  /* The record page after the last one covered by read-ahead */
+  unsigned int windowEnd;
+  /* Whether the index pages of the chapter have been read ahead */
+  bool         indexPagesFetched;
+} ReadAheadState;
+
+/**
+ * A zone's note of the record page on which it last found a name. A hint
+ * only saves looking at the chapter's index page; the record page is still
+ * searched for the name, so a wrong hint costs one extra probe of the page
+ * cache and nothing more.
+ **/
+typedef struct {
+  /* The virtual chapter in which the name was found */
+  uint64_t     virtualChapter;
+  /* Some bits of the name, to reject most hints for other names */
+  uint32_t     nameKey;
+  /* The record page of the chapter on which the name was found */
+  unsigned int recordPageNumber;
+} RecordPageHint;
+
+enum {
+  /* The number of threads which may write the record pages of a chapter */
+  RECORD_PAGE_WRITERS = 2,
+  /* The number of record page hints kept by each zone, a power of two */
+  RECORD_PAGE_HINTS_PER_ZONE = 4096,
+};
+
+/**
+ * The state one thread needs to sort, encode, and write record pages.
+ **/
+typedef struct recordPageWriter {
+  /* A single page's records, for sorting */
+  const UdsChunkRecord **recordPointers;
+  /* For sorting record pages */
+  RadixSorter           *radixSorter;
+  /* A single page used for writing record pages to the volume */
+  struct volume_page     scratchPage;
+} RecordPageWriter;
+
+/**
+ * A span of the pages of one chapter which were cached when the index was
+ * saved, to be read back in when it is next loaded.
+ **/
+typedef struct warmChapter {
+  /* The physical chapter */
+  unsigned int physicalChapter;
+  /* The first page of the span, counting from the start of the chapter */
+  unsigned int firstPage;
+  /* The number of pages in the span */
+  unsigned int pageCount;
+} WarmChapter;
+
 typedef struct volume {
   /* The layout of the volume */
   Geometry              *geometry;
@@ -66,18 +131,24 @@ typedef struct volume {
   Configuration         *config;
   /* The access to the volume's backing store */
   struct volume_store    volumeStore;
-  /* A single page used for writing to the volume */
+  /* A single page used for writing index pages to the volume */
   struct volume_page     scratchPage;
   /* The nonce used to save the volume */
   uint64_t               nonce;
-  /* A single page's records, for sorting */
-  const UdsChunkRecord **recordPointers;
-  /* For sorting record pages */
-  RadixSorter           *radixSorter;
+  /* Whether record pages are stored as blocked search trees */
+  bool                   blockedRecordPages;
+  /* The state of each thread which may write record pages */
+  RecordPageWriter       recordWriters[RECORD_PAGE_WRITERS];
+  /* The number of record pages of the chapter being written handed out */
+  atomic_t               recordPagesClaimed;
   /* The sparse chapter index cache */
   SparseCache           *sparseCache;
   /* The page cache */
   PageCache             *pageCache;
+  /* The read-ahead state for each zone */
+  ReadAheadState        *readAhead;
+  /* The record page hints of each zone */
+  RecordPageHint        *recordPageHints;
   /* The index page map maps delta list numbers to index page numbers */
   IndexPageMap          *indexPageMap;
   /* Mutex to sync between read threads and index thread */
@@ -96,6 +167,16 @@ typedef struct volume {
   IndexLookupMode        lookupMode;
   /* Number of read threads to use (run-time parameter) */
   unsigned int           numReadThreads;
+  /* The next volume sharing the host-wide page cache budget */
+  struct volume         *nextBudgetVolume;
+  /* The page cache hits counted at the last budget rebalance */
+  uint64_t               budgetHits;
+  /* The page cache hits since the last budget rebalance, plus one */
+  uint64_t               budgetWeight;
+  /* The most page cache entries to use while under memory pressure */
+  unsigned int           pressureEntries;
+  /* The page cache memory given back under memory pressure, in bytes */
+  uint64_t               reclaimedBytes;
 } Volume;
 
 /**
@@ -105,7 +186,8 @@ typedef struct volume {
  * @param layout            The index layout
  * @param userParams        The index session parameters.  If NULL, the default
  *                          session parameters will be used.
- * @param readQueueMaxSize  The maximum size of the read queue.
+ * @param readQueueMaxSize  The maximum size of the read queue, unless
+ *                          userParams specifies a read queue depth.
  * @param zoneCount         The number of zones to use.
  * @param newVolume         A pointer to hold a pointer to the new volume.
  *
@@ -255,7 +337,38 @@ int writeIndexPages(Volume            *volume,
 __attribute__((warn_unused_result));
 
 /**
- * Write a chapter's worth of record pages to a volume
+ * Prepare to write the record pages of a chapter with
+ * writeClaimedRecordPages().
+ *
+ * @param volume  the volume containing the chapter
+ **/
+void startRecordPageClaims(Volume *volume);
+
+/**
+ * Sort, encode, and write record pages of a chapter until every page has
+ * been written. Each page is claimed by exactly one caller, so up to
+ * RECORD_PAGE_WRITERS threads may share the work of writing the pages after
+ * a call to startRecordPageClaims(). This may be called concurrently with
+ * writeIndexPages() for the same chapter.
+ *
+ * @param volume        the volume containing the chapter
+ * @param writerNumber  the number of the calling thread's RecordPageWriter
+ * @param physicalPage  the page number in the volume for the chapter
+ * @param records       a 1-based array of chunk records in the chapter
+ * @param pages         pointer to array of page pointers. Used only in testing
+ *                      to return what data has been written to disk.
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int writeClaimedRecordPages(Volume                *volume,
+                            unsigned int           writerNumber,
+                            int                    physicalPage,
+                            const UdsChunkRecord   records[],
+                            byte                 **pages)
+  __attribute__((warn_unused_result));
+
+/**
+ * Write a chapter's worth of record pages to a volume from a single thread.
  *
  * @param volume        the volume containing the chapter
  * @param physicalPage  the page number in the volume for the chapter
@@ -271,6 +384,17 @@ int writeRecordPages(Volume                *volume,
                      byte                 **pages)
 __attribute__((warn_unused_result));
 
+/**
+ * Release the pages used by writeIndexPages() and writeRecordPages() and
+ * flush the chapter they wrote to permanent storage.
+ *
+ * @param volume  the volume containing the chapter
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int finishChapterWrite(Volume *volume)
+  __attribute__((warn_unused_result));
+
 /**
  * Write the index and records from the most recently filled chapter to the
  * volume.
@@ -411,6 +535,37 @@ int findVolumeChapterBoundariesImpl(unsigned int  chapterLimit,
                                     void *aux)
   __attribute__((warn_unused_result));
 
+/**
+ * List the chapters with the most pages in the page cache and the sparse
+ * cache, in physical chapter order, so that they can be saved and read back
+ * in when the index is next loaded. For each chapter, the span from its
+ * first to its last cached page is listed, and the spans listed never add up
+ * to more than the page cache can hold.
+ *
+ * @param volume    the volume
+ * @param chapters  the array to hold the chapter spans
+ * @param maxCount  the size of the chapters array
+ *
+ * @return the number of chapter spans listed
+ **/
+unsigned int listWarmChapters(Volume       *volume,
+                              WarmChapter  *chapters,
+                              unsigned int  maxCount)
+  __attribute__((warn_unused_result));
+
+/**
+ * Start reading chapter spans listed by listWarmChapters() into the volume
+ * store. The reads are asynchronous, so the cache fills alongside the
+ * first queries. Spans which do not fit the volume are ignored.
+ *
+ * @param volume    the volume
+ * @param chapters  the chapter spans to read
+ * @param count     the number of chapter spans
+ **/
+void prefetchWarmChapters(Volume            *volume,
+                          const WarmChapter *chapters,
+                          unsigned int       count);
+
 /**
  * Map a chapter number and page number to a phsical volume page number.
  *
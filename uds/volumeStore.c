@@ -21,19 +21,48 @@
 
 #include "geometry.h"
 #include "indexLayout.h"
+#include "ioFactory.h"
 #include "logger.h"
 #include "uds-error.h"
 #include "volumeStore.h"
 
+#ifdef __KERNEL__
+/**
+ * Release the buffers held for the chapter being written.
+ *
+ * @param volumeStore  The volume store
+ **/
+static void releaseWriteBuffers(const struct volume_store *volumeStore)
+{
+  unsigned int i;
+  for (i = 0; i < volumeStore->vs_pagesPerChapter; i++) {
+    if (volumeStore->vs_writeBuffers[i] != NULL) {
+      dm_bufio_release(volumeStore->vs_writeBuffers[i]);
+      volumeStore->vs_writeBuffers[i] = NULL;
+    }
+  }
+}
+#endif
 
 /*****************************************************************************/
 void closeVolumeStore(struct volume_store *volumeStore)
 {
 #ifdef __KERNEL__
+  if (volumeStore->vs_writeBuffers != NULL) {
+    releaseWriteBuffers(volumeStore);
+    FREE(volumeStore->vs_writeBuffers);
+    volumeStore->vs_writeBuffers = NULL;
+  }
+  FREE(volumeStore->vs_writeData);
+  volumeStore->vs_writeData = NULL;
   if (volumeStore->vs_client != NULL) {
     dm_bufio_client_destroy(volumeStore->vs_client);
     volumeStore->vs_client = NULL;
   }
+  if (volumeStore->vs_factory != NULL) {
+    putIOFactory(volumeStore->vs_factory);
+    volumeStore->vs_factory = NULL;
+  }
 #else
   if (volumeStore->vs_region != NULL) {
     putIORegion(volumeStore->vs_region);
@@ -47,10 +76,9 @@ void destroyVolumePage(struct volume_page *volumePage)
 {
 #ifdef __KERNEL__
   releaseVolumePage(volumePage);
-#else
+#endif
   FREE(volumePage->vp_data);
   volumePage->vp_data = NULL;
-#endif
 }
 
 /*****************************************************************************/
@@ -58,7 +86,9 @@ int initializeVolumePage(const struct geometry *geometry,
                          struct volume_page    *volumePage)
 {
 #ifdef __KERNEL__
+  // The page only gets memory of its own if it is read directly.
   volumePage->vp_buffer = NULL;
+  volumePage->vp_data   = NULL;
   return UDS_SUCCESS;
 #else
   return ALLOCATE_IO_ALIGNED(geometry->bytesPerPage, byte, __func__,
@@ -67,16 +97,36 @@ int initializeVolumePage(const struct geometry *geometry,
 }
 
 /*****************************************************************************/
-int openVolumeStore(struct volume_store *volumeStore,
-                    IndexLayout  *layout,
-                    unsigned int  reservedBuffers __attribute__((unused)),
-                    size_t        bytesPerPage)
+int openVolumeStore(struct volume_store   *volumeStore,
+                    IndexLayout           *layout,
+                    unsigned int           reservedBuffers
+                    __attribute__((unused)),
+                    const struct geometry *geometry,
+                    bool                   directReads
+                    __attribute__((unused)))
 {
 #ifdef __KERNEL__
-  return openVolumeBufio(layout, bytesPerPage, reservedBuffers,
-                         &volumeStore->vs_client);
+  // Pages are allocated and prefetched through bufio even when they are read
+  // and written with bios of their own.
+  int result = openVolumeBufio(layout, geometry->bytesPerPage, reservedBuffers,
+                               &volumeStore->vs_client);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  volumeStore->vs_bytesPerPage    = geometry->bytesPerPage;
+  volumeStore->vs_pagesPerChapter = geometry->pagesPerChapter;
+  volumeStore->vs_directReads     = directReads;
+  openVolumeDirect(layout, &volumeStore->vs_factory, &volumeStore->vs_offset);
+
+  result = ALLOCATE(geometry->pagesPerChapter, struct dm_buffer *,
+                    "chapter write buffers", &volumeStore->vs_writeBuffers);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  return ALLOCATE(geometry->pagesPerChapter, byte *, "chapter write data",
+                  &volumeStore->vs_writeData);
 #else
-  volumeStore->vs_bytesPerPage = bytesPerPage;
+  volumeStore->vs_bytesPerPage = geometry->bytesPerPage;
   return openVolumeRegion(layout, &volumeStore->vs_region);
 #endif
 }
@@ -115,6 +165,54 @@ int prepareToWriteVolumePage(const struct volume_store *volumeStore
   return UDS_SUCCESS;
 }
 
+#ifdef __KERNEL__
+/**
+ * Read a page from a volume store into the page's own memory, without
+ * leaving a copy of it in the bufio client.
+ *
+ * @param volumeStore   The volume store
+ * @param physicalPage  The volume page number of the desired page
+ * @param volumePage    The volume page buffer, which has been released
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int readVolumePageDirect(const struct volume_store *volumeStore,
+                                unsigned int               physicalPage,
+                                struct volume_page        *volumePage)
+{
+  size_t bytesPerPage = volumeStore->vs_bytesPerPage;
+  if (volumePage->vp_data == NULL) {
+    int result = ALLOCATE_IO_ALIGNED(bytesPerPage, byte, __func__,
+                                     &volumePage->vp_data);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+
+  // A page which was prefetched, or which was written but may not have been
+  // synced yet, is still held by the bufio client. Take it from there, and
+  // then drop it from bufio so that it is only cached once.
+  struct dm_buffer *buffer = NULL;
+  byte *data = dm_bufio_get(volumeStore->vs_client, physicalPage, &buffer);
+  if ((data != NULL) && !IS_ERR(data)) {
+    memcpy(volumePage->vp_data, data, bytesPerPage);
+    dm_bufio_release(buffer);
+    dm_bufio_forget(volumeStore->vs_client, physicalPage);
+    return UDS_SUCCESS;
+  }
+
+  off_t offset = (volumeStore->vs_offset
+                  + ((off_t) physicalPage * bytesPerPage));
+  int result = readDirect(volumeStore->vs_factory, offset,
+                          volumePage->vp_data, bytesPerPage);
+  if (result != UDS_SUCCESS) {
+    return logWarningWithStringError(result, "error reading physical page %u",
+                                     physicalPage);
+  }
+  return UDS_SUCCESS;
+}
+#endif
+
 /*****************************************************************************/
 int readVolumePage(const struct volume_store *volumeStore,
                    unsigned int               physicalPage,
@@ -122,6 +220,10 @@ int readVolumePage(const struct volume_store *volumeStore,
 {
 #ifdef __KERNEL__
   releaseVolumePage(volumePage);
+  if (volumeStore->vs_directReads) {
+    return readVolumePageDirect(volumeStore, physicalPage, volumePage);
+  }
+
   byte *data = dm_bufio_read(volumeStore->vs_client, physicalPage,
                              &volumePage->vp_buffer);
   if (IS_ERR(data)) {
@@ -156,6 +258,17 @@ void releaseVolumePage(struct volume_page *volumePage __attribute__((unused)))
 #endif
 }
 
+/*****************************************************************************/
+void trimVolumePage(struct volume_page *volumePage)
+{
+  releaseVolumePage(volumePage);
+#ifdef __KERNEL__
+  // Pages only own memory when they are read directly, which reallocates it.
+  FREE(volumePage->vp_data);
+  volumePage->vp_data = NULL;
+#endif
+}
+
 /*****************************************************************************/
 void swapVolumePages(struct volume_page *volumePage1,
                      struct volume_page *volumePage2)
@@ -165,11 +278,64 @@ void swapVolumePages(struct volume_page *volumePage1,
   *volumePage2 = temp;
 }
 
+#ifdef __KERNEL__
+/**
+ * Write the held pages of the chapter being written, combining each run of
+ * consecutive pages into as few bios as possible, and release them.
+ *
+ * @param volumeStore  The volume store
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int writeHeldPages(const struct volume_store *volumeStore)
+{
+  int          result    = UDS_SUCCESS;
+  unsigned int runLength = 0;
+  sector_t     runStart  = 0;
+  unsigned int i;
+  for (i = 0; i <= volumeStore->vs_pagesPerChapter; i++) {
+    struct dm_buffer *buffer = ((i < volumeStore->vs_pagesPerChapter)
+                                ? volumeStore->vs_writeBuffers[i] : NULL);
+    sector_t block = ((buffer != NULL)
+                      ? dm_bufio_get_block_number(buffer) : 0);
+    if ((runLength > 0)
+        && ((buffer == NULL) || (block != runStart + runLength))) {
+      off_t offset = (volumeStore->vs_offset
+                      + ((off_t) runStart * volumeStore->vs_bytesPerPage));
+      int writeResult = writeDirect(volumeStore->vs_factory, offset,
+                                    volumeStore->vs_writeData, runLength,
+                                    volumeStore->vs_bytesPerPage);
+      if (result == UDS_SUCCESS) {
+        result = writeResult;
+      }
+      runLength = 0;
+    }
+    if (buffer == NULL) {
+      continue;
+    }
+    if (runLength == 0) {
+      runStart = block;
+    }
+    volumeStore->vs_writeData[runLength++] = dm_bufio_get_block_data(buffer);
+  }
+
+  releaseWriteBuffers(volumeStore);
+  return result;
+}
+#endif
+
 /*****************************************************************************/
 int syncVolumeStore(const struct volume_store *volumeStore)
 {
 #ifdef __KERNEL__
-  int result = -dm_bufio_write_dirty_buffers(volumeStore->vs_client);
+  int result = writeHeldPages(volumeStore);
+  if (result == UDS_SUCCESS) {
+    // Write any pages which could not be held, then make it all durable.
+    result = -dm_bufio_write_dirty_buffers(volumeStore->vs_client);
+  }
+  if (result == UDS_SUCCESS) {
+    result = flushDirect(volumeStore->vs_factory);
+  }
 #else
   int result = syncRegionContents(volumeStore->vs_region);
 #endif
@@ -185,7 +351,23 @@ int writeVolumePage(const struct volume_store *volumeStore,
                     struct volume_page        *volumePage)
 {
 #ifdef __KERNEL__
-  dm_bufio_mark_buffer_dirty(volumePage->vp_buffer);
+  // Chapters are written sequentially, so rather than leave the page to be
+  // written back by itself, hold its buffer without dirtying it so that
+  // syncVolumeStore() can write it together with its neighbors. Each page of
+  // a chapter is written once, and only one chapter is written at a time.
+  // Page zero is the volume header, so the pages of a chapter start at one.
+  unsigned int slot = (physicalPage - 1) % volumeStore->vs_pagesPerChapter;
+  struct dm_buffer *buffer = NULL;
+  byte *data = dm_bufio_get(volumeStore->vs_client, physicalPage, &buffer);
+  if ((data == NULL) || IS_ERR(data)
+      || (volumeStore->vs_writeBuffers[slot] != NULL)) {
+    if ((data != NULL) && !IS_ERR(data)) {
+      dm_bufio_release(buffer);
+    }
+    dm_bufio_mark_buffer_dirty(volumePage->vp_buffer);
+    return UDS_SUCCESS;
+  }
+  volumeStore->vs_writeBuffers[slot] = buffer;
   return UDS_SUCCESS;
 #else
   off_t offset = (off_t) physicalPage * volumeStore->vs_bytesPerPage;
@@ -34,11 +34,22 @@
 
 struct geometry;
 struct indexLayout;
+struct ioFactory;
 
 
 struct volume_store {
 #ifdef __KERNEL__
   struct dm_bufio_client *vs_client;
+  struct ioFactory       *vs_factory;
+  off_t                   vs_offset;
+  size_t                  vs_bytesPerPage;
+  unsigned int            vs_pagesPerChapter;
+  // Whether pages are read with bios of their own rather than through bufio
+  bool                    vs_directReads;
+  // The buffers of the chapter being written, held until it is synced
+  struct dm_buffer      **vs_writeBuffers;
+  // The data of a run of consecutive pages being written
+  byte                  **vs_writeData;
 #else
   IORegion               *vs_region;
   size_t                  vs_bytesPerPage;
@@ -49,6 +60,8 @@ struct volume_store {
 struct volume_page {
 #ifdef __KERNEL__
   struct dm_buffer *vp_buffer;
+  // The page's own memory, used when vp_buffer is NULL
+  byte             *vp_data;
 #else
   byte             *vp_data;
 #endif
@@ -79,7 +92,9 @@ __attribute__((warn_unused_result))
 static INLINE byte *getPageData(const struct volume_page *volumePage)
 {
 #ifdef __KERNEL__
-  return dm_bufio_get_block_data(volumePage->vp_buffer);
+  return ((volumePage->vp_buffer != NULL)
+          ? dm_bufio_get_block_data(volumePage->vp_buffer)
+          : volumePage->vp_data);
 #else
   return volumePage->vp_data;
 #endif
@@ -103,12 +118,16 @@ int initializeVolumePage(const struct geometry *geometry,
  * @param volumeStore      The volume store
  * @param layout           The index layout
  * @param reservedBuffers  The number of buffers that can be reserved
- * @param bytesPerPage     The number of bytes in a volume page
+ * @param geometry         The volume geometry
+ * @param directReads      Whether to read pages into their own memory with
+ *                         direct bios instead of through dm-bufio, which is
+ *                         only possible in kernel mode
  **/
-int openVolumeStore(struct volume_store *volumeStore,
-                    struct indexLayout  *layout,
-                    unsigned int         reservedBuffers,
-                    size_t               bytesPerPage)
+int openVolumeStore(struct volume_store   *volumeStore,
+                    struct indexLayout    *layout,
+                    unsigned int           reservedBuffers,
+                    const struct geometry *geometry,
+                    bool                   directReads)
   __attribute__((warn_unused_result));
 
 /**
@@ -158,6 +177,14 @@ int readVolumePage(const struct volume_store *volumeStore,
  **/
 void releaseVolumePage(struct volume_page *volumePage);
 
+/**
+ * Release a volume page buffer along with any memory of its own which will
+ * be reacquired the next time a page is read into it. This is used when a
+ * page cache gives up the entry holding the buffer.
+ * @param volumePage  The volume page buffer
+ **/
+void trimVolumePage(struct volume_page *volumePage);
+
 /**
  * Swap volume pages.  This is used to put the contents of a newly written
  * index page (in the scratch page) into the page cache.
@@ -54,6 +54,16 @@ struct action {
   Action           *next;
 };
 
+/** The completion for applying a drain to one zone in parallel */
+typedef struct {
+  /** The completion for the zone's drain */
+  VDOCompletion  completion;
+  /** The manager of the action */
+  ActionManager *manager;
+  /** The zone being drained */
+  ZoneCount      zone;
+} ZoneActionCompletion;
+
 struct actionManager {
   /** The completion for performing actions */
   VDOCompletion     completion;
@@ -78,6 +88,10 @@ struct actionManager {
   void             *context;
   /** The zone currently being acted upon */
   ZoneCount         actingZone;
+  /** The number of zones still applying a parallel action */
+  ZoneCount         pendingZones;
+  /** The completions for applying parallel actions to each zone */
+  ZoneActionCompletion zoneCompletions[];
 };
 
 /**
@@ -134,7 +148,8 @@ int makeActionManager(ZoneCount          zones,
                       ActionManager    **managerPtr)
 {
   ActionManager *manager;
-  int result = ALLOCATE(1, ActionManager, __func__, &manager);
+  int result = ALLOCATE_EXTENDED(ActionManager, zones, ZoneActionCompletion,
+                                 __func__, &manager);
   if (result != VDO_SUCCESS) {
     return result;
   }
@@ -157,6 +172,18 @@ int makeActionManager(ZoneCount          zones,
     return result;
   }
 
+  for (ZoneCount zone = 0; zone < zones; zone++) {
+    ZoneActionCompletion *zoneCompletion = &manager->zoneCompletions[zone];
+    zoneCompletion->manager = manager;
+    zoneCompletion->zone    = zone;
+    result = initializeEnqueueableCompletion(&zoneCompletion->completion,
+                                             SUB_TASK_COMPLETION, layer);
+    if (result != VDO_SUCCESS) {
+      freeActionManager(&manager);
+      return result;
+    }
+  }
+
   *managerPtr = manager;
   return VDO_SUCCESS;
 }
@@ -169,6 +196,9 @@ void freeActionManager(ActionManager **managerPtr)
     return;
   }
 
+  for (ZoneCount zone = 0; zone < manager->zones; zone++) {
+    destroyEnqueueable(&manager->zoneCompletions[zone].completion);
+  }
   destroyEnqueueable(&manager->completion);
   FREE(manager);
   *managerPtr = NULL;
@@ -252,6 +282,76 @@ static void applyToZone(VDOCompletion *completion)
   manager->currentAction->zoneAction(manager->context, zone, completion);
 }
 
+/**
+ * Convert a generic VDOCompletion to a ZoneActionCompletion.
+ *
+ * @param completion The completion to convert
+ *
+ * @return The completion as a ZoneActionCompletion
+ **/
+static inline ZoneActionCompletion *
+asZoneActionCompletion(VDOCompletion *completion)
+{
+  STATIC_ASSERT(offsetof(ZoneActionCompletion, completion) == 0);
+  assertCompletionType(completion->type, SUB_TASK_COMPLETION);
+  return (ZoneActionCompletion *) completion;
+}
+
+/**
+ * Note that a zone has finished applying a parallel action, and finish the
+ * action if it was the last. This callback is registered in
+ * applyToZoneInParallel().
+ *
+ * @param completion  The zone's completion
+ **/
+static void finishZoneInParallel(VDOCompletion *completion)
+{
+  ActionManager *manager = asZoneActionCompletion(completion)->manager;
+  if ((completion->result != VDO_SUCCESS)
+      && (manager->currentAction->parent != NULL)) {
+    setCompletionResult(manager->currentAction->parent, completion->result);
+  }
+
+  if (--manager->pendingZones == 0) {
+    finishActionCallback(&manager->completion);
+  }
+}
+
+/**
+ * Apply the current action to one zone, on that zone's thread. This
+ * callback is registered in applyToAllZones().
+ *
+ * @param completion  The zone's completion
+ **/
+static void applyToZoneInParallel(VDOCompletion *completion)
+{
+  ZoneActionCompletion *zoneCompletion = asZoneActionCompletion(completion);
+  ActionManager        *manager        = zoneCompletion->manager;
+  prepareForRequeue(completion, finishZoneInParallel, finishZoneInParallel,
+                    manager->initiatorThreadID, NULL);
+  manager->currentAction->zoneAction(manager->context, zoneCompletion->zone,
+                                     completion);
+}
+
+/**
+ * Apply the current action to every zone at once. This callback is
+ * registered in launchCurrentAction().
+ *
+ * @param completion  The action manager completion
+ **/
+static void applyToAllZones(VDOCompletion *completion)
+{
+  ActionManager *manager = asActionManager(completion);
+  manager->pendingZones = manager->zones;
+  for (ZoneCount zone = 0; zone < manager->zones; zone++) {
+    VDOCompletion *zoneCompletion = &manager->zoneCompletions[zone].completion;
+    prepareForRequeue(zoneCompletion, applyToZoneInParallel,
+                      applyToZoneInParallel,
+                      manager->getZoneThreadID(manager->context, zone), NULL);
+    invokeCallback(zoneCompletion);
+  }
+}
+
 /**
  * The error handler for preamble errors.
  *
@@ -286,6 +386,10 @@ static void launchCurrentAction(ActionManager *manager)
 
   if (action->zoneAction == NULL) {
     prepareForConclusion(manager);
+  } else if (isDrainOperation(action->operation) && (manager->zones > 1)) {
+    prepareForRequeue(&manager->completion, applyToAllZones,
+                      handlePreambleError, manager->initiatorThreadID,
+                      manager->currentAction->parent);
   } else {
     manager->actingZone = 0;
     prepareForRequeue(&manager->completion, applyToZone, handlePreambleError,
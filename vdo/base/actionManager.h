@@ -46,6 +46,11 @@
  *               is done
  *
  * At least one of the three methods must be provided.
+ *
+ * The zone method is applied to one zone after another, except for drain
+ * operations, where it is applied to every zone at once so that each
+ * zone's writeback overlaps the others'; a zone's drain never waits on
+ * another zone of the same entity.
  **/
 
 /**
@@ -28,6 +28,7 @@
 #include "dataVIO.h"
 #include "pbnLock.h"
 #include "slabDepot.h"
+#include "timeUtils.h"
 #include "types.h"
 #include "vdoInternal.h"
 #include "vioWrite.h"
@@ -94,6 +95,8 @@ static int allocateAndLockBlock(AllocatingVIO *allocatingVIO)
   // We got a block!
   VIO *vio      = allocatingVIOAsVIO(allocatingVIO);
   vio->physical = allocatingVIO->allocation;
+  allocatingVIO->allocationGeneration
+    = getPBNFreeGeneration(getSlabDepot(vio->vdo), allocatingVIO->allocation);
   allocatingVIO->allocationCallback(allocatingVIO);
   return VDO_SUCCESS;
 }
@@ -111,6 +114,8 @@ retryAllocateBlockForWrite(Waiter *waiter,
                            void   *context __attribute__((unused)))
 {
   AllocatingVIO *allocatingVIO = waiterAsAllocatingVIO(waiter);
+  recordAllocationStall(getBlockAllocator(allocatingVIO->zone),
+                        nowUsec() - allocatingVIO->waitStartTime);
   allocateBlockForWrite(allocatingVIOAsCompletion(allocatingVIO));
 }
 
@@ -128,6 +133,7 @@ static int waitForCleanSlab(AllocatingVIO *allocatingVIO)
 {
   Waiter *waiter   = allocatingVIOAsWaiter(allocatingVIO);
   waiter->callback = retryAllocateBlockForWrite;
+  allocatingVIO->waitStartTime = nowUsec();
 
   BlockAllocator *allocator = getBlockAllocator(allocatingVIO->zone);
   int             result    = enqueueForCleanSlab(allocator, waiter);
@@ -212,15 +218,24 @@ void allocateDataBlock(AllocatingVIO      *allocatingVIO,
                        AllocationSelector *selector,
                        PBNLockType         writeLockType,
                        AllocationCallback *callback)
+{
+  VIO       *vio        = allocatingVIOAsVIO(allocatingVIO);
+  ZoneCount  zoneNumber = getNextAllocationZone(selector);
+  allocateDataBlockInZone(allocatingVIO, vio->vdo->physicalZones[zoneNumber],
+                          writeLockType, callback);
+}
+
+/**********************************************************************/
+void allocateDataBlockInZone(AllocatingVIO      *allocatingVIO,
+                             PhysicalZone       *zone,
+                             PBNLockType         writeLockType,
+                             AllocationCallback *callback)
 {
   allocatingVIO->writeLockType      = writeLockType;
   allocatingVIO->allocationCallback = callback;
   allocatingVIO->allocationAttempts = 0;
   allocatingVIO->allocation         = ZERO_BLOCK;
-
-  VIO *vio = allocatingVIOAsVIO(allocatingVIO);
-  allocatingVIO->zone
-    = vio->vdo->physicalZones[getNextAllocationZone(selector)];
+  allocatingVIO->zone               = zone;
 
   launchPhysicalZoneCallback(allocatingVIO, allocateBlockForWrite,
                              THIS_LOCATION("$F;cb=allocDataBlock"));
@@ -248,6 +263,7 @@ void resetAllocation(AllocatingVIO *allocatingVIO)
   allocatingVIOAsVIO(allocatingVIO)->physical = ZERO_BLOCK;
   allocatingVIO->zone                         = NULL;
   allocatingVIO->allocation                   = ZERO_BLOCK;
+  allocatingVIO->allocationGeneration         = 0;
   allocatingVIO->allocationAttempts           = 0;
   allocatingVIO->waitForCleanSlab             = false;
 }
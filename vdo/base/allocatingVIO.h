@@ -49,6 +49,9 @@ struct allocatingVIO {
   /** The block allocated to this VIO */
   PhysicalBlockNumber allocation;
 
+  /** The free generation of the allocated block when it was allocated */
+  uint64_t            allocationGeneration;
+
   /**
    * If non-NULL, the pooled PBN lock held on the allocated block. Must be a
    * write lock until the block has been written, after which it will become a
@@ -65,6 +68,9 @@ struct allocatingVIO {
   /** Whether this VIO should wait for a clean slab */
   bool                waitForCleanSlab;
 
+  /** The time at which this VIO started waiting for a clean slab */
+  uint64_t            waitStartTime;
+
   /** The function to call once allocation is complete */
   AllocationCallback *allocationCallback;
 };
@@ -251,6 +257,22 @@ void allocateDataBlock(AllocatingVIO      *allocatingVIO,
                        PBNLockType         writeLockType,
                        AllocationCallback *callback);
 
+/**
+ * Allocate a data block to an AllocatingVIO, starting in a given physical
+ * zone. If called on that zone's thread, the first allocation attempt is made
+ * before this function returns, so a caller on the zone thread which
+ * allocates several blocks in a row will get them in allocation order.
+ *
+ * @param allocatingVIO  The AllocatingVIO which needs an allocation
+ * @param zone           The physical zone to allocate from first
+ * @param writeLockType  The type of write lock to obtain on the block
+ * @param callback       The function to call once the allocation is complete
+ **/
+void allocateDataBlockInZone(AllocatingVIO      *allocatingVIO,
+                             PhysicalZone       *zone,
+                             PBNLockType         writeLockType,
+                             AllocationCallback *callback);
+
 /**
  * Release the PBN lock on the allocated block. If the reference to the locked
  * block is still provisional, it will be released as well.
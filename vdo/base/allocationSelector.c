@@ -26,13 +26,10 @@
 
 #include "types.h"
 
-enum {
-  ALLOCATIONS_PER_ZONE = 128,
-};
-
 /**********************************************************************/
 int makeAllocationSelector(ZoneCount            physicalZoneCount,
                            ThreadID             threadID,
+                           BlockCount           allocationsPerZone,
                            AllocationSelector **selectorPtr)
 {
   AllocationSelector *selector;
@@ -42,6 +39,7 @@ int makeAllocationSelector(ZoneCount            physicalZoneCount,
   }
 
   *selector = (AllocationSelector) {
+    .allocationsPerZone = allocationsPerZone,
     .nextAllocationZone = threadID % physicalZoneCount,
     .lastPhysicalZone   = physicalZoneCount - 1,
   };
@@ -66,7 +64,7 @@ void freeAllocationSelector(AllocationSelector **selectorPtr)
 ZoneCount getNextAllocationZone(AllocationSelector *selector)
 {
   if (selector->lastPhysicalZone > 0) {
-    if (selector->allocationCount < ALLOCATIONS_PER_ZONE) {
+    if (selector->allocationCount < selector->allocationsPerZone) {
       selector->allocationCount++;
     } else {
       selector->allocationCount = 1;
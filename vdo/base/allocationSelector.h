@@ -27,21 +27,32 @@
 /**
  * An AllocationSelector is used by any zone which does data block allocations.
  * The selector is used to round-robin allocation requests to different
- * physical zones. Currently, 128 allocations will be made to a given physical
- * zone before switching to the next.
+ * physical zones. A fixed number of allocations will be made to a given
+ * physical zone before switching to the next: by default 128, or for a
+ * selector which is to preserve locality, enough to fill a slab, so that
+ * one stream of writes fills a zone's open slab sequentially rather than
+ * sharing every zone's open slab with the other streams.
  **/
 
+enum {
+  /** The allocations made in a zone before moving on, by default */
+  DEFAULT_ALLOCATIONS_PER_ZONE = 128,
+};
+
 /**
  * Make a new allocation selector.
  *
- * @param [in]  physicalZoneCount  The number of physical zones
- * @param [in]  threadID           The ID of the thread using this selector
- * @param [out] selectorPtr        A pointer to receive the new selector
+ * @param [in]  physicalZoneCount   The number of physical zones
+ * @param [in]  threadID            The ID of the thread using this selector
+ * @param [in]  allocationsPerZone  The number of allocations to make in a
+ *                                  zone before moving on to the next
+ * @param [out] selectorPtr         A pointer to receive the new selector
  *
  * @return VDO_SUCCESS or an error
  **/
 int makeAllocationSelector(ZoneCount            physicalZoneCount,
                            ThreadID             threadID,
+                           BlockCount           allocationsPerZone,
                            AllocationSelector **selectorPtr)
   __attribute__((warn_unused_result));
 
@@ -28,6 +28,8 @@
 struct allocationSelector {
   /** The number of allocations done in the current zone */
   BlockCount     allocationCount;
+  /** The number of allocations to make in a zone before moving on */
+  BlockCount     allocationsPerZone;
   /** The physical zone to allocate from next */
   ZoneCount      nextAllocationZone;
   /** The number of the last physical zone */
@@ -23,6 +23,7 @@
 
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "timeUtils.h"
 
 #include "adminState.h"
 #include "heap.h"
@@ -41,6 +42,23 @@
 #include "vio.h"
 #include "vioPool.h"
 
+enum {
+  /**
+   * The size of each chunk of the arena holding a zone's slab structures. A
+   * slab of the default size needs a few kilobytes, so a chunk holds the
+   * structures of many slabs next to one another.
+   **/
+  SLAB_ARENA_CHUNK_SIZE        = 256 * 1024,
+  /**
+   * The alignment and minimum length, in blocks, of a discard of freed
+   * blocks. Shorter runs are left for the storage to find on its own.
+   **/
+  DISCARD_GRANULARITY          = 32,
+  /** The most freed blocks to discard at once */
+  DISCARD_MAXIMUM_RUN          = 8192,
+  MICROSECONDS_PER_MILLISECOND = 1000,
+};
+
 /**
  * Assert that a block allocator function was called from the correct thread.
  *
@@ -206,8 +224,18 @@ static int allocateComponents(BlockAllocator  *allocator,
 
   allocator->summary = getSlabSummaryForZone(depot, allocator->zoneNumber);
 
-  result = makeVIOPool(layer, vioPoolSize, allocator->threadID,
-                       makeAllocatorPoolVIOs, NULL, &allocator->vioPool);
+  if (layer->discardBlocks != NULL) {
+    result = createVIO(layer, VIO_TYPE_BLOCK_ALLOCATOR, VIO_PRIORITY_LOW,
+                       allocator, NULL, &allocator->discardVIO);
+    if (result != VDO_SUCCESS) {
+      return result;
+    }
+  }
+
+  result = makeGrowableVIOPool(layer, vioPoolSize,
+                               vioPoolSize * VIO_POOL_GROWTH_FACTOR,
+                               allocator->threadID, makeAllocatorPoolVIOs,
+                               NULL, &allocator->vioPool);
   if (result != VDO_SUCCESS) {
     return result;
   }
@@ -254,6 +282,7 @@ static int allocateComponents(BlockAllocator  *allocator,
 int makeBlockAllocator(SlabDepot         *depot,
                        ZoneCount          zoneNumber,
                        ThreadID           threadID,
+                       int                numaNode,
                        Nonce              nonce,
                        BlockCount         vioPoolSize,
                        PhysicalLayer     *layer,
@@ -262,8 +291,16 @@ int makeBlockAllocator(SlabDepot         *depot,
 {
 
   BlockAllocator *allocator;
-  int result = ALLOCATE(1, BlockAllocator, __func__, &allocator);
+  int result = ALLOCATE_ON_NODE(1, BlockAllocator, numaNode, __func__,
+                                &allocator);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  result = makeMemoryArena(SLAB_ARENA_CHUNK_SIZE, numaNode, "slab arena",
+                           &allocator->arena);
   if (result != VDO_SUCCESS) {
+    FREE(allocator);
     return result;
   }
 
@@ -273,6 +310,7 @@ int makeBlockAllocator(SlabDepot         *depot,
   allocator->nonce            = nonce;
   allocator->readOnlyNotifier = readOnlyNotifier;
   initializeRing(&allocator->dirtySlabJournals);
+  initializeRing(&allocator->pendingDiscards);
 
   result = allocateComponents(allocator, layer, vioPoolSize);
   if (result != VDO_SUCCESS) {
@@ -294,8 +332,10 @@ void freeBlockAllocator(BlockAllocator **blockAllocatorPtr)
 
   freeSlabScrubber(&allocator->slabScrubber);
   freeVIOPool(&allocator->vioPool);
+  freeVIO(&allocator->discardVIO);
   freePriorityTable(&allocator->prioritizedSlabs);
   destroyEnqueueable(&allocator->completion);
+  freeMemoryArena(&allocator->arena);
   FREE(allocator);
   *blockAllocatorPtr = NULL;
 }
@@ -420,6 +460,47 @@ static int allocateSlabBlock(Slab *slab, PhysicalBlockNumber *blockNumberPtr)
   return VDO_SUCCESS;
 }
 
+/**
+ * Choose the next slab to allocate from and remove it from the priority
+ * table. The highest priority slab is chosen, except that the slab which
+ * follows the exhausted open slab in this zone is preferred when it has the
+ * same priority, so that a stream of allocations moves through adjacent
+ * physical regions rather than jumping between slabs with similar amounts of
+ * free space. Slabs which are not yet recovered are never in the table, and
+ * all reference counts are resident, so free space and locality are all that
+ * distinguish the candidates.
+ *
+ * @param allocator  The allocator
+ * @param lastSlab   The slab which was just exhausted, or NULL
+ *
+ * @return The slab to open, or NULL if the table is empty
+ **/
+static Slab *selectNextSlab(BlockAllocator *allocator, Slab *lastSlab)
+{
+  PriorityTable *table = allocator->prioritizedSlabs;
+  SlabDepot     *depot = allocator->depot;
+  if (lastSlab != NULL) {
+    SlabCount nextNumber = lastSlab->slabNumber + depot->zoneCount;
+    Slab *next = ((nextNumber < depot->slabCount)
+                  ? depot->slabs[nextNumber] : NULL);
+    if ((next != NULL) && (next->allocator == allocator)
+        && !isUnrecoveredSlab(next) && !isRingEmpty(&next->ringNode)
+        && ((int) next->priority == getPriorityTableTopPriority(table))) {
+      priorityTableRemove(table, &next->ringNode);
+      return next;
+    }
+  }
+
+  return slabFromRingNode(priorityTableDequeue(table));
+}
+
+/**********************************************************************/
+void recordAllocationStall(BlockAllocator *allocator, uint64_t microseconds)
+{
+  relaxedAdd64(&allocator->statistics.allocationStalls, 1);
+  relaxedAdd64(&allocator->statistics.stallMicroseconds, microseconds);
+}
+
 /**********************************************************************/
 int allocateBlock(BlockAllocator *allocator,
                   PhysicalBlockNumber *blockNumberPtr)
@@ -435,10 +516,8 @@ int allocateBlock(BlockAllocator *allocator,
     prioritizeSlab(allocator->openSlab);
   }
 
-  // Remove the highest priority slab from the priority table and make it
-  // the open slab.
-  allocator->openSlab
-    = slabFromRingNode(priorityTableDequeue(allocator->prioritizedSlabs));
+  // Take the best slab from the priority table and make it the open slab.
+  allocator->openSlab = selectNextSlab(allocator, allocator->openSlab);
 
   if (isSlabJournalBlank(allocator->openSlab->journal)) {
     relaxedAdd64(&allocator->statistics.slabsOpened, 1);
@@ -475,6 +554,166 @@ void releaseBlockReference(BlockAllocator      *allocator,
   }
 }
 
+/**
+ * Convert a Slab's discard RingNode back to the Slab.
+ *
+ * @param node  The discardNode of a slab
+ *
+ * @return The slab
+ **/
+static inline Slab *slabFromDiscardNode(RingNode *node)
+{
+  return (Slab *) ((uintptr_t) node - offsetof(Slab, discardNode));
+}
+
+/**********************************************************************/
+void recordFreedBlock(Slab *slab, PhysicalBlockNumber pbn)
+{
+  BlockAllocator *allocator = slab->allocator;
+  uint32_t        delay     = relaxedLoad32(&allocator->discardDelay);
+  if ((allocator->discardVIO == NULL) || (delay == 0)) {
+    return;
+  }
+
+  SlabBlockNumber index = pbn - slab->start;
+  if (isRingEmpty(&slab->discardNode)) {
+    slab->discardStart    = index;
+    slab->discardEnd      = index + 1;
+    slab->discardDeadline = nowUsec() + (delay * MICROSECONDS_PER_MILLISECOND);
+    pushRingNode(&allocator->pendingDiscards, &slab->discardNode);
+    return;
+  }
+
+  slab->discardStart = minBlock(slab->discardStart, index);
+  slab->discardEnd   = maxBlock(slab->discardEnd, index + 1);
+}
+
+/**
+ * Discard the next run of freed blocks whose delay has passed, unless a
+ * discard is already in progress or the allocator is not operating
+ * normally. Each slab's runs are claimed, and discarded, from its lowest
+ * freed block to its highest, one run at a time.
+ *
+ * @param allocator  The allocator
+ **/
+static void launchNextDiscard(BlockAllocator *allocator);
+
+/**
+ * Release the run of blocks which has been discarded and discard the next
+ * one. This callback is registered in launchNextDiscard().
+ *
+ * @param completion  The discard VIO
+ **/
+static void finishDiscard(VDOCompletion *completion)
+{
+  BlockAllocator *allocator = completion->parent;
+  Slab           *slab      = allocator->discardingSlab;
+  if (completion->result == VDO_SUCCESS) {
+    relaxedAdd64(&allocator->statistics.discardsPassedDown, 1);
+    relaxedAdd64(&allocator->statistics.blocksPassedDown,
+                 allocator->discardRunLength);
+  } else {
+    logWarningWithStringError(completion->result,
+                              "failed to discard %" PRIu64
+                              " freed blocks at %" PRIu64,
+                              allocator->discardRunLength,
+                              allocator->discardRunStart);
+  }
+
+  releaseClaimedRun(slab->referenceCounts,
+                    allocator->discardRunStart - slab->start,
+                    allocator->discardRunLength);
+  for (BlockCount i = 0; i < allocator->discardRunLength; i++) {
+    adjustFreeBlockCount(slab, true);
+  }
+
+  allocator->discardingSlab = NULL;
+  if (isDraining(&allocator->state)
+      && (allocator->drainStep == DRAIN_ALLOCATOR_STEP_DISCARDS)) {
+    completeCompletion(&allocator->completion);
+    return;
+  }
+
+  launchNextDiscard(allocator);
+}
+
+/**********************************************************************/
+static void launchNextDiscard(BlockAllocator *allocator)
+{
+  if ((allocator->discardingSlab != NULL) || !isNormal(&allocator->state)
+      || isReadOnly(allocator->readOnlyNotifier)) {
+    return;
+  }
+
+  uint64_t now = nowUsec();
+  while (!isRingEmpty(&allocator->pendingDiscards)) {
+    Slab *slab = slabFromDiscardNode(allocator->pendingDiscards.next);
+    if (slab->discardDeadline > now) {
+      return;
+    }
+
+    SlabBlockNumber start  = slab->discardStart;
+    BlockCount      length
+      = claimUnreferencedRun(slab->referenceCounts, &start, slab->discardEnd,
+                             DISCARD_GRANULARITY, DISCARD_MAXIMUM_RUN);
+    if (length == 0) {
+      unspliceRingNode(&slab->discardNode);
+      continue;
+    }
+
+    // The claimed blocks count as allocated until they have been discarded.
+    for (BlockCount i = 0; i < length; i++) {
+      adjustFreeBlockCount(slab, false);
+    }
+
+    slab->discardStart          = start + length;
+    allocator->hasDiscarded     = true;
+    allocator->discardingSlab   = slab;
+    allocator->discardRunStart  = slab->start + start;
+    allocator->discardRunLength = length;
+
+    VIO *vio = allocator->discardVIO;
+    vio->completion.callbackThreadID = allocator->threadID;
+    launchDiscard(vio, allocator->discardRunStart, length, finishDiscard,
+                  finishDiscard);
+    return;
+  }
+}
+
+/**********************************************************************/
+void checkDiscardDeadlines(BlockAllocator *allocator)
+{
+  launchNextDiscard(allocator);
+}
+
+/**********************************************************************/
+void setDiscardDelay(BlockAllocator *allocator, uint32_t milliseconds)
+{
+  relaxedStore32(&allocator->discardDelay, milliseconds);
+}
+
+/**********************************************************************/
+uint32_t getDiscardDelay(const BlockAllocator *allocator)
+{
+  return relaxedLoad32(&allocator->discardDelay);
+}
+
+/**********************************************************************/
+bool isDiscardingBlock(const BlockAllocator *allocator,
+                       PhysicalBlockNumber   pbn)
+{
+  PhysicalBlockNumber start = allocator->discardRunStart;
+  return ((allocator->discardingSlab != NULL) && (pbn >= start)
+          && (pbn < start + allocator->discardRunLength));
+}
+
+/**********************************************************************/
+bool mayHaveDiscardedFreeBlocks(const BlockAllocator *allocator)
+{
+  return (allocator->hasDiscarded
+          || (relaxedLoad32(&allocator->discardDelay) > 0));
+}
+
 /**
  * This is a HeapComparator function that orders SlabStatuses using the
  * 'isClean' field as the primary key and the 'emptiness' field as the
@@ -674,11 +913,12 @@ int prepareSlabsForAllocation(BlockAllocator *allocator)
       continue;
     }
 
+    // A clean slab only needs its reference counts read, so rather than
+    // holding up the load, leave it for the scrubber to load in the
+    // background once the VDO is online, or sooner if it is touched.
     markSlabUnrecovered(slab);
-    bool highPriority
-      = ((currentSlabStatus.isClean && (depot->loadType == NORMAL_LOAD))
-         || requiresScrubbing(slab->journal));
-    registerSlabForScrubbing(allocator->slabScrubber, slab, highPriority);
+    registerSlabForScrubbing(allocator->slabScrubber, slab,
+                             requiresScrubbing(slab->journal));
   }
   FREE(slabStatuses);
 
@@ -729,6 +969,13 @@ static void doDrainStep(VDOCompletion *completion)
   prepareForRequeue(&allocator->completion, doDrainStep, handleOperationError,
                     allocator->threadID, NULL);
   switch (++allocator->drainStep) {
+  case DRAIN_ALLOCATOR_STEP_DISCARDS:
+    // Pending discards stay queued, but one in progress must finish.
+    if (allocator->discardingSlab == NULL) {
+      completeCompletion(completion);
+    }
+    return;
+
   case DRAIN_ALLOCATOR_STEP_SCRUBBER:
     stopScrubbing(allocator->slabScrubber, completion);
     return;
@@ -799,6 +1046,11 @@ static void doResumeStep(VDOCompletion *completion)
     resumeScrubbing(allocator->slabScrubber, completion);
     return;
 
+  case DRAIN_ALLOCATOR_STEP_DISCARDS:
+    // Queued discards resume at the next check of their deadlines.
+    completeCompletion(completion);
+    return;
+
   case DRAIN_ALLOCATOR_START:
     finishResumingWithResult(&allocator->state, completion->result);
     return;
@@ -888,6 +1140,16 @@ void increaseScrubbingPriority(Slab *slab)
   registerSlabForScrubbing(slab->allocator->slabScrubber, slab, true);
 }
 
+/**********************************************************************/
+void loadSlabOnDemand(Slab *slab)
+{
+  if (isUnrecoveredSlab(slab)
+      && getSummarizedCleanliness(slab->allocator->summary,
+                                  slab->slabNumber)) {
+    increaseScrubbingPriority(slab);
+  }
+}
+
 /**********************************************************************/
 void allocateFromAllocatorLastSlab(BlockAllocator *allocator)
 {
@@ -902,10 +1164,22 @@ BlockAllocatorStatistics
 getBlockAllocatorStatistics(const BlockAllocator *allocator)
 {
   const AtomicAllocatorStatistics *atoms = &allocator->statistics;
+  VIOPoolStatistics pool = getVIOPoolStatistics(allocator->vioPool);
   return (BlockAllocatorStatistics) {
-    .slabCount     = allocator->slabCount,
-    .slabsOpened   = relaxedLoad64(&atoms->slabsOpened),
-    .slabsReopened = relaxedLoad64(&atoms->slabsReopened),
+    .slabCount         = allocator->slabCount,
+    .slabsOpened       = relaxedLoad64(&atoms->slabsOpened),
+    .slabsReopened     = relaxedLoad64(&atoms->slabsReopened),
+    .allocationStalls  = relaxedLoad64(&atoms->allocationStalls),
+    .stallMicroseconds = relaxedLoad64(&atoms->stallMicroseconds),
+    .slabsScrubbed     = getScrubbedSlabCount(allocator->slabScrubber),
+    .slabsToScrub      = getScrubberSlabCount(allocator->slabScrubber),
+    .scrubSecondsRemaining
+      = getScrubbingSecondsRemaining(allocator->slabScrubber),
+    .vioPoolWaits            = pool.waits,
+    .vioPoolWaitMicroseconds = pool.waitMicroseconds,
+    .vioPoolSize             = pool.size,
+    .discardsPassedDown      = relaxedLoad64(&atoms->discardsPassedDown),
+    .blocksPassedDown        = relaxedLoad64(&atoms->blocksPassedDown),
   };
 }
 
@@ -919,6 +1193,7 @@ SlabJournalStatistics getSlabJournalStatistics(const BlockAllocator *allocator)
     .blockedCount  = atomicLoad64(&atoms->blockedCount),
     .blocksWritten = atomicLoad64(&atoms->blocksWritten),
     .tailBusyCount = atomicLoad64(&atoms->tailBusyCount),
+    .entriesInRuns = atomicLoad64(&atoms->entriesInRuns),
   };
 }
 
@@ -927,7 +1202,11 @@ RefCountsStatistics getRefCountsStatistics(const BlockAllocator *allocator)
 {
   const AtomicRefCountStatistics *atoms = &allocator->refCountStatistics;
   return (RefCountsStatistics) {
-    .blocksWritten = atomicLoad64(&atoms->blocksWritten),
+    .blocksWritten  = atomicLoad64(&atoms->blocksWritten),
+    .dirtyBlocks    = relaxedLoad64(&atoms->dirtyBlocks),
+    .writesDeferred = relaxedLoad64(&atoms->writesDeferred),
+    .writeLatency   = relaxedLoad64(&atoms->writeLatency),
+    .writeRate      = relaxedLoad64(&atoms->writeRate),
   };
 }
 
@@ -35,6 +35,7 @@
  * @param [in]  depot             The slab depot for this allocator
  * @param [in]  zoneNumber        The physical zone number for this allocator
  * @param [in]  threadID          The thread ID for this allocator's zone
+ * @param [in]  numaNode          The memory node of that thread
  * @param [in]  nonce             The nonce of the VDO
  * @param [in]  vioPoolSize       The size of the VIO pool
  * @param [in]  layer             The physical layer below this allocator
@@ -46,6 +47,7 @@
 int makeBlockAllocator(SlabDepot         *depot,
                        ZoneCount          zoneNumber,
                        ThreadID           threadID,
+                       int                numaNode,
                        Nonce              nonce,
                        BlockCount         vioPoolSize,
                        PhysicalLayer     *layer,
@@ -258,6 +260,86 @@ int enqueueForCleanSlab(BlockAllocator *allocator, Waiter *waiter)
  **/
 void increaseScrubbingPriority(Slab *slab);
 
+/**
+ * Note that an unrecovered slab has been touched. If the slab is clean, it
+ * is only waiting for its reference counts to be loaded, which is cheap, so
+ * it is moved ahead of the slabs being loaded in the background.
+ *
+ * @param slab  The slab which was touched
+ **/
+void loadSlabOnDemand(Slab *slab);
+
+/**
+ * Account for an allocation which had to wait for a slab to be scrubbed.
+ *
+ * @param allocator     The allocator in which the allocation waited
+ * @param microseconds  How long the allocation waited
+ **/
+void recordAllocationStall(BlockAllocator *allocator, uint64_t microseconds);
+
+/**
+ * Note that a block which may have held data has become unreferenced, so
+ * that it will be discarded on the storage once the allocator's discard
+ * delay has passed, if discards are being passed down.
+ *
+ * @param slab  The slab containing the block
+ * @param pbn   The block which was freed
+ **/
+void recordFreedBlock(Slab *slab, PhysicalBlockNumber pbn);
+
+/**
+ * Start discarding the freed blocks whose discard delay has passed. This
+ * must be called periodically on the allocator's thread, since a delay
+ * will often pass while the zone is idle.
+ *
+ * @param allocator  The allocator
+ **/
+void checkDiscardDeadlines(BlockAllocator *allocator);
+
+/**
+ * Set how long freed blocks wait to be discarded on the storage, so that
+ * blocks which are reused quickly are not discarded first. This may be
+ * called from any thread.
+ *
+ * @param allocator     The allocator
+ * @param milliseconds  The delay, or 0 to stop discarding freed blocks
+ **/
+void setDiscardDelay(BlockAllocator *allocator, uint32_t milliseconds);
+
+/**
+ * Get how long freed blocks wait to be discarded on the storage.
+ *
+ * @param allocator  The allocator
+ *
+ * @return The delay in milliseconds, or 0 if freed blocks are not discarded
+ **/
+uint32_t getDiscardDelay(const BlockAllocator *allocator)
+  __attribute__((warn_unused_result));
+
+/**
+ * Check whether a block is in the run of freed blocks being discarded.
+ *
+ * @param allocator  The allocator owning the block
+ * @param pbn        The block to check
+ *
+ * @return <code>true</code> if the block is being discarded
+ **/
+bool isDiscardingBlock(const BlockAllocator *allocator,
+                       PhysicalBlockNumber   pbn)
+  __attribute__((warn_unused_result));
+
+/**
+ * Check whether the unreferenced blocks of an allocator may have been
+ * discarded since they were freed. Such blocks can't be deduplicated
+ * against, since a discarded block need not read back the same way twice.
+ *
+ * @param allocator  The allocator
+ *
+ * @return <code>true</code> if free blocks may have been discarded
+ **/
+bool mayHaveDiscardedFreeBlocks(const BlockAllocator *allocator)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the statistics for this allocator.
  *
@@ -25,10 +25,12 @@
 #include "adminState.h"
 #include "atomic.h"
 #include "blockAllocator.h"
+#include "memoryAlloc.h"
 #include "priorityTable.h"
 #include "ringNode.h"
 #include "slabScrubber.h"
 #include "vioPool.h"
+#include "waitQueue.h"
 
 enum {
   /*
@@ -36,10 +38,13 @@ enum {
    * the VDO.
    */
   VIO_POOL_SIZE = 128,
+  /** The number of times its initial size the VIO pool may grow to */
+  VIO_POOL_GROWTH_FACTOR = 4,
 };
 
 typedef enum {
   DRAIN_ALLOCATOR_START = 0,
+  DRAIN_ALLOCATOR_STEP_DISCARDS,
   DRAIN_ALLOCATOR_STEP_SCRUBBER,
   DRAIN_ALLOCATOR_STEP_SLABS,
   DRAIN_ALLOCATOR_STEP_SUMMARY,
@@ -68,6 +73,14 @@ typedef struct atomicAllocatorStatistics {
   Atomic64 slabsOpened;
   /** The number of times since loading that a slab been re-opened */
   Atomic64 slabsReopened;
+  /** The number of allocations which waited for a slab to be scrubbed */
+  Atomic64 allocationStalls;
+  /** The total time allocations have spent waiting for scrubbed slabs */
+  Atomic64 stallMicroseconds;
+  /** Number of runs of freed blocks discarded on the storage */
+  Atomic64 discardsPassedDown;
+  /** Number of freed blocks discarded on the storage */
+  Atomic64 blocksPassedDown;
 } AtomicAllocatorStatistics;
 
 /**
@@ -87,6 +100,8 @@ typedef struct atomicSlabJournalStatistics {
   Atomic64 blocksWritten;
   /** Number of times we had to wait for the tail block commit */
   Atomic64 tailBusyCount;
+  /** Number of entries which continue a run of consecutive blocks */
+  Atomic64 entriesInRuns;
 } AtomicSlabJournalStatistics;
 
 /**
@@ -98,8 +113,40 @@ typedef struct atomicSlabJournalStatistics {
 typedef struct atomicRefCountStatistics {
   /** Number of blocks written */
   Atomic64 blocksWritten;
+  /** Number of reference blocks which are dirty and not yet writing */
+  Atomic64 dirtyBlocks;
+  /** Number of reference block writes which were held back by pacing */
+  Atomic64 writesDeferred;
+  /** The average latency of reference block writes (microseconds) */
+  Atomic64 writeLatency;
+  /** The paced reference block write rate (blocks per second) */
+  Atomic64 writeRate;
 } AtomicRefCountStatistics;
 
+/**
+ * The state used to pace the reference block writes which relieve slab
+ * journal pressure. Rather than launching each slab's share of its dirty
+ * blocks at once, the writes are queued here and launched only as fast as
+ * the zone's slab journals are filling, given the observed write latency.
+ * All fields are only accessed from the physical zone thread.
+ **/
+typedef struct {
+  /** The RefCounts which have paced writes waiting to be launched */
+  WaitQueue  waitingRefCounts;
+  /** The number of paced writes in progress */
+  BlockCount activeWrites;
+  /** Whether paced writes are currently being launched */
+  bool       launching;
+  /** The time writes were last requested to relieve journal pressure */
+  uint64_t   lastRequestTime;
+  /** The scaled moving average of the time between requests */
+  uint64_t   meanRequestInterval;
+  /** The scaled moving average of the number of writes per request */
+  uint64_t   meanWritesRequested;
+  /** The scaled moving average of the time taken by block writes */
+  uint64_t   meanWriteLatency;
+} ReferenceWritePacer;
+
 struct blockAllocator {
   VDOCompletion                completion;
   /** The slab depot for this allocator */
@@ -139,6 +186,25 @@ struct blockAllocator {
   AtomicSlabJournalStatistics  slabJournalStatistics;
   /** Cumulative statistics for the RefCounts in this zone */
   AtomicRefCountStatistics     refCountStatistics;
+  /** The pacing of reference block writes in this zone */
+  ReferenceWritePacer          referenceWritePacer;
+
+  /** The slabs with freed blocks to discard, in the order they were freed */
+  RingNode                     pendingDiscards;
+  /** The milliseconds freed blocks wait to be discarded, or 0 to not */
+  Atomic32                     discardDelay;
+  /** Whether any blocks in this zone have been discarded since loading */
+  bool                         hasDiscarded;
+  /** The VIO for discarding freed blocks, or NULL if the layer can't */
+  VIO                         *discardVIO;
+  /** The slab containing the run being discarded, if any */
+  Slab                        *discardingSlab;
+  /** The first block of the run being discarded */
+  PhysicalBlockNumber          discardRunStart;
+  /** The number of blocks in the run being discarded */
+  BlockCount                   discardRunLength;
+  /** The blocks in a full stripe of the storage, or 0 to ignore stripes */
+  BlockCount                   stripeBlocks;
 
   /**
    * This is the head of a queue of slab journals which have entries in their
@@ -152,6 +218,12 @@ struct blockAllocator {
 
   /** The VIO pool for reading and writing block allocator metadata */
   VIOPool                     *vioPool;
+  /**
+   * The arena holding the Slab, SlabJournal, and RefCounts structures of
+   * the slabs in this zone. It is only used while making slabs and loading
+   * their reference counts, which is never done concurrently.
+   **/
+  MemoryArena                 *arena;
 };
 
 /**
@@ -33,13 +33,34 @@
 #include "constants.h"
 #include "dataVIO.h"
 #include "forest.h"
+#include "heap.h"
 #include "numUtils.h"
 #include "recoveryJournal.h"
+#include "slabDepot.h"
 #include "statusCodes.h"
 #include "types.h"
 #include "vdoInternal.h"
 #include "vdoPageCache.h"
 
+enum {
+  /** The number of sequential leaf page fetches which start prefetching */
+  PREFETCH_TRIGGER     = 2,
+  /** The number of the zone's leaf pages to keep prefetched ahead */
+  PREFETCH_WINDOW      = 4,
+  /** The number of sequential reads in a zone which start data read-ahead */
+  READ_AHEAD_TRIGGER   = 4,
+  /** The number of logical blocks of data to keep read ahead of a stream */
+  READ_AHEAD_WINDOW    = 16,
+  /** How far behind a stream a read may land and still belong to it */
+  READ_AHEAD_SLACK     = 8,
+  /** The eighths of the journal the block map may hold before eras shorten */
+  ERA_PRESSURE_EIGHTHS = 6,
+  /** The shortest era, as a fraction of the configured maximum age */
+  MINIMUM_ERA_DIVISOR  = 8,
+  /** The leaf pages which fit in a super block extension, with counts */
+  MAXIMUM_WARM_PAGES   = 400,
+};
+
 typedef struct {
   PhysicalBlockNumber flatPageOrigin;
   BlockCount          flatPageCount;
@@ -116,6 +137,11 @@ static bool handlePageWrite(void         *rawPage,
     return true;
   }
 
+  BlockCount mapped;
+  BlockCount extents = countBlockMapPageExtents(page, &mapped);
+  relaxedAdd64(&zone->entriesWritten, mapped);
+  relaxedAdd64(&zone->extentsWritten, extents);
+
   // Release the page's references on the recovery journal.
   releaseRecoveryJournalBlockReference(zone->blockMap->journal,
                                        context->recoveryLock,
@@ -159,6 +185,8 @@ int makeBlockMap(BlockCount            logicalBlocks,
     BlockMapZone *blockMapZone = &map->zones[zone];
     blockMapZone->zoneNumber   = zone;
     blockMapZone->threadID     = getLogicalZoneThread(threadConfig, zone);
+    blockMapZone->numaNode     = getThreadNode(threadConfig,
+                                               blockMapZone->threadID);
     blockMapZone->blockMap     = map;
     map->zoneCount++;
   }
@@ -276,6 +304,7 @@ int decodeSodiumBlockMap(Buffer              *buffer,
  * @param cacheSize         The size of the page cache for the zone
  * @param maximumAge        The number of journal blocks before a dirtied page
  *                          is considered old and must be written out
+ * @param cachePolicy       The replacement policy for the page cache
  *
  * @return VDO_SUCCESS or an error
  **/
@@ -284,7 +313,8 @@ static int initializeBlockMapZone(BlockMapZone     *zone,
                                   PhysicalLayer    *layer,
                                   ReadOnlyNotifier *readOnlyNotifier,
                                   PageCount         cacheSize,
-                                  BlockCount        maximumAge)
+                                  BlockCount        maximumAge,
+                                  PageCachePolicy   cachePolicy)
 {
   zone->readOnlyNotifier = readOnlyNotifier;
   int result = initializeTreeZone(zone, layer, maximumAge);
@@ -294,7 +324,47 @@ static int initializeBlockMapZone(BlockMapZone     *zone,
 
   return makeVDOPageCache(layer, cacheSize, validatePageOnRead,
                           handlePageWrite, sizeof(BlockMapPageContext),
-                          maximumAge, zone, &zone->pageCache);
+                          maximumAge, cachePolicy, zone, &zone->pageCache);
+}
+
+/**
+ * Decide whether a zone's page cache can hold all of the zone's leaf pages,
+ * and so whether the zone should run in resident mode. This must be
+ * redone whenever the cache or the logical space changes size.
+ *
+ * @param zone  The zone
+ **/
+static void updateZoneResidence(BlockMapZone *zone)
+{
+  BlockMap  *map       = zone->blockMap;
+  PageCount  pageCount = computeBlockMapPageCount(zone->entryCount);
+  PageCount  zonePages = 0;
+  for (RootCount root = zone->zoneNumber;
+       (root < map->rootCount) && (root < pageCount);
+       root += map->zoneCount) {
+    zonePages += ((pageCount - root - 1) / map->rootCount) + 1;
+  }
+
+  bool resident = (getVDOPageCacheSize(zone->pageCache) >= zonePages);
+  if (resident != zone->resident) {
+    logDebug("block map zone %u %s resident mode", zone->zoneNumber,
+             (resident ? "entering" : "leaving"));
+    zone->resident = resident;
+  }
+}
+
+/**
+ * Point every zone at the block map's current forest and size. This may only
+ * be done when no zone is doing lookups.
+ *
+ * @param map  The block map
+ **/
+static void publishForest(BlockMap *map)
+{
+  for (ZoneCount zone = 0; zone < map->zoneCount; zone++) {
+    map->zones[zone].forest     = map->forest;
+    map->zones[zone].entryCount = map->entryCount;
+  }
 }
 
 /**********************************************************************/
@@ -313,6 +383,38 @@ static ThreadID getBlockMapZoneThreadID(void *context, ZoneCount zoneNumber)
   return getBlockMapZone(context, zoneNumber)->threadID;
 }
 
+/**
+ * Choose how long dirty pages may stay unwritten for the next era. While the
+ * recovery journal has headroom, pages may stay dirty for the full
+ * configured age, which bounds the journal replayed by a recovery. Once the
+ * block map is holding most of the journal, the age shrinks in proportion to
+ * the headroom left, so that pages are written and the journal reaped before
+ * writers must wait for journal space. Must be called from the journal
+ * thread.
+ *
+ * @param map  The block map
+ *
+ * @return The number of journal blocks a page may stay dirty
+ **/
+static BlockCount chooseEraLength(BlockMap *map)
+{
+  BlockCount length    = getRecoveryJournalUsableLength(map->journal);
+  BlockCount held      = getJournalBlocksHeldByBlockMap(map->journal);
+  BlockCount threshold = (length * ERA_PRESSURE_EIGHTHS) / 8;
+  if (held <= threshold) {
+    return map->maximumAge;
+  }
+
+  BlockCount headroom  = ((held < length) ? (length - held) : 0);
+  BlockCount eraLength = ((map->maximumAge * headroom)
+                          / (length - threshold));
+  BlockCount minimum   = map->maximumAge / MINIMUM_ERA_DIVISOR;
+  if (eraLength < minimum) {
+    eraLength = minimum;
+  }
+  return ((eraLength > 0) ? eraLength : 1);
+}
+
 /**
  * Prepare for an era advance.
  *
@@ -321,7 +423,12 @@ static ThreadID getBlockMapZoneThreadID(void *context, ZoneCount zoneNumber)
 static void prepareForEraAdvance(void *context, VDOCompletion *parent)
 {
   BlockMap *map = context;
-  map->currentEraPoint = map->pendingEraPoint;
+  map->currentEraPoint  = map->pendingEraPoint;
+  map->currentEraLength = chooseEraLength(map);
+  relaxedStore64(&map->eraLength, map->currentEraLength);
+  if (map->currentEraLength < map->maximumAge) {
+    relaxedAdd64(&map->shortenedEras, 1);
+  }
   completeCompletion(parent);
 }
 
@@ -335,8 +442,11 @@ static void advanceBlockMapZoneEra(void          *context,
                                    VDOCompletion *parent)
 {
   BlockMapZone *zone = getBlockMapZone(context, zoneNumber);
-  advanceVDOPageCachePeriod(zone->pageCache, zone->blockMap->currentEraPoint);
-  advanceZoneTreePeriod(&zone->treeZone, zone->blockMap->currentEraPoint);
+  BlockMap *map = zone->blockMap;
+  advanceVDOPageCachePeriod(zone->pageCache, map->currentEraPoint,
+                            map->currentEraLength);
+  advanceZoneTreePeriod(&zone->treeZone, map->currentEraPoint,
+                        map->currentEraLength);
   finishCompletion(parent, VDO_SUCCESS);
 }
 
@@ -363,15 +473,20 @@ int makeBlockMapCaches(BlockMap         *map,
                        RecoveryJournal  *journal,
                        Nonce             nonce,
                        PageCount         cacheSize,
-                       BlockCount        maximumAge)
+                       BlockCount        maximumAge,
+                       PageCachePolicy   cachePolicy)
 {
   int result = ASSERT(cacheSize > 0, "block map cache size is specified");
   if (result != UDS_SUCCESS) {
     return result;
   }
 
-  map->journal = journal;
-  map->nonce   = nonce;
+  map->journal          = journal;
+  map->nonce            = nonce;
+  map->maximumAge       = maximumAge;
+  map->currentEraLength = maximumAge;
+  relaxedStore64(&map->eraLength, maximumAge);
+  relaxedStore64(&map->shortenedEras, 0);
 
   result = makeForest(map, map->entryCount);
   if (result != VDO_SUCCESS) {
@@ -379,14 +494,30 @@ int makeBlockMapCaches(BlockMap         *map,
   }
 
   replaceForest(map);
+  publishForest(map);
+  map->warmPagesPerZone = MAXIMUM_WARM_PAGES / map->zoneCount;
+  result = ALLOCATE(map->warmPagesPerZone * map->zoneCount,
+                    PhysicalBlockNumber, "block map warm pages",
+                    &map->warmPages);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
   for (ZoneCount zone = 0; zone < map->zoneCount; zone++) {
+    map->zones[zone].warmPages
+      = &map->warmPages[zone * map->warmPagesPerZone];
     result = initializeBlockMapZone(&map->zones[zone], layer, readOnlyNotifier,
-                                    cacheSize / map->zoneCount, maximumAge);
+                                    cacheSize / map->zoneCount, maximumAge,
+                                    cachePolicy);
     if (result != VDO_SUCCESS) {
       return result;
     }
+
+    updateZoneResidence(&map->zones[zone]);
   }
 
+  map->cacheSize = (cacheSize / map->zoneCount) * map->zoneCount;
+
   return makeActionManager(map->zoneCount, getBlockMapZoneThreadID,
                            getRecoveryJournalThreadID(journal), map,
                            scheduleEraAdvance, layer,
@@ -419,6 +550,7 @@ void freeBlockMap(BlockMap **mapPtr)
   abandonBlockMapGrowth(map);
   freeForest(&map->forest);
   freeActionManager(&map->actionManager);
+  FREE(map->warmPages);
 
   FREE(map);
   *mapPtr = NULL;
@@ -465,6 +597,97 @@ int encodeBlockMap(const BlockMap *map, Buffer *buffer)
                 "encoded block map component size must match header size");
 }
 
+/**********************************************************************/
+int encodeBlockMapWarmPages(const BlockMap *map, Buffer *buffer)
+{
+  if (map->warmPages == NULL) {
+    return UDS_SUCCESS;
+  }
+
+  int result = putUInt32LEIntoBuffer(buffer, map->zoneCount);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  for (ZoneCount zone = 0; zone < map->zoneCount; zone++) {
+    const BlockMapZone *blockMapZone = &map->zones[zone];
+    result = putUInt32LEIntoBuffer(buffer, blockMapZone->warmPageCount);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+
+    result = putUInt64LEsIntoBuffer(buffer, blockMapZone->warmPageCount,
+                                    blockMapZone->warmPages);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+void decodeBlockMapWarmPages(BlockMap *map, Buffer *buffer)
+{
+  uint32_t zoneCount;
+  if ((contentLength(buffer) == 0)
+      || (getUInt32LEFromBuffer(buffer, &zoneCount) != UDS_SUCCESS)
+      || (zoneCount != map->zoneCount)) {
+    return;
+  }
+
+  for (ZoneCount zone = 0; zone < map->zoneCount; zone++) {
+    BlockMapZone *blockMapZone = &map->zones[zone];
+    uint32_t      count;
+    if ((getUInt32LEFromBuffer(buffer, &count) != UDS_SUCCESS)
+        || (count > map->warmPagesPerZone)
+        || (getUInt64LEsFromBuffer(buffer, count, blockMapZone->warmPages)
+            != UDS_SUCCESS)) {
+      break;
+    }
+
+    blockMapZone->warmPageCount = count;
+  }
+}
+
+/**
+ * Start reading the leaf pages a zone held at the last save into its cache.
+ *
+ * <p>Implements ZoneAction.
+ **/
+static void prefetchZoneWarmPages(void          *context,
+                                  ZoneCount      zoneNumber,
+                                  VDOCompletion *parent)
+{
+  BlockMapZone *zone = getBlockMapZone(context, zoneNumber);
+  for (PageCount i = 0; i < zone->warmPageCount; i++) {
+    prefetchVDOPage(zone->pageCache, zone->warmPages[i]);
+  }
+
+  finishCompletion(parent, VDO_SUCCESS);
+}
+
+/**********************************************************************/
+void prefetchWarmBlockMapPages(BlockMap *map)
+{
+  PageCount warmPageCount = 0;
+  for (ZoneCount zone = 0; zone < map->zoneCount; zone++) {
+    warmPageCount += map->zones[zone].warmPageCount;
+  }
+
+  if (warmPageCount == 0) {
+    return;
+  }
+
+  if (!scheduleAction(map->actionManager, NULL, prefetchZoneWarmPages, NULL,
+                      NULL)) {
+    logDebug("block map busy, not warming caches");
+    return;
+  }
+
+  logInfo("warming block map caches with %u pages", warmPageCount);
+}
+
 /**********************************************************************/
 void initializeBlockMapFromJournal(BlockMap *map, RecoveryJournal *journal)
 {
@@ -494,8 +717,9 @@ void findBlockMapSlotAsync(DataVIO   *dataVIO,
                            VDOAction *callback,
                            ThreadID   threadID)
 {
-  BlockMap *map = getBlockMap(getVDOFromDataVIO(dataVIO));
-  if (dataVIO->logical.lbn >= map->entryCount) {
+  BlockMap     *map  = getBlockMap(getVDOFromDataVIO(dataVIO));
+  BlockMapZone *zone = getBlockMapForZone(dataVIO->logical.zone);
+  if (dataVIO->logical.lbn >= zone->entryCount) {
     finishDataVIO(dataVIO, VDO_OUT_OF_RANGE);
     return;
   }
@@ -549,6 +773,52 @@ void checkForDrainComplete(BlockMapZone *zone)
   }
 }
 
+/**
+ * Compare two physical block numbers.
+ *
+ * <p>Implements HeapComparator.
+ **/
+static int compareWarmPages(const void *item1, const void *item2)
+{
+  const PhysicalBlockNumber *pbn1 = item1;
+  const PhysicalBlockNumber *pbn2 = item2;
+  if (*pbn1 == *pbn2) {
+    return 0;
+  }
+  return ((*pbn1 < *pbn2) ? -1 : 1);
+}
+
+/**
+ * Swap two physical block numbers.
+ *
+ * <p>Implements HeapSwapper.
+ **/
+static void swapWarmPages(void *item1, void *item2)
+{
+  PhysicalBlockNumber *pbn1 = item1;
+  PhysicalBlockNumber *pbn2 = item2;
+  PhysicalBlockNumber  temp = *pbn1;
+  *pbn1 = *pbn2;
+  *pbn2 = temp;
+}
+
+/**
+ * Remember the hottest leaf pages in a zone's cache, in PBN order, so that
+ * they can be saved and read back in when the VDO is next loaded.
+ *
+ * @param zone  The zone which is draining
+ **/
+static void recordWarmPages(BlockMapZone *zone)
+{
+  zone->warmPageCount = listResidentVDOPages(zone->pageCache, zone->warmPages,
+                                             zone->blockMap->warmPagesPerZone);
+  Heap heap;
+  initializeHeap(&heap, compareWarmPages, swapWarmPages, zone->warmPages,
+                 zone->warmPageCount, sizeof(PhysicalBlockNumber));
+  buildHeap(&heap, zone->warmPageCount);
+  sortHeap(&heap);
+}
+
 /**
  * Initiate a drain of the trees and page cache of a block map zone.
  *
@@ -557,6 +827,7 @@ void checkForDrainComplete(BlockMapZone *zone)
 static void initiateDrain(AdminState *state)
 {
   BlockMapZone *zone = container_of(state, BlockMapZone, state);
+  recordWarmPages(zone);
   drainZoneTrees(&zone->treeZone);
   drainVDOPageCache(zone->pageCache);
   checkForDrainComplete(zone);
@@ -596,6 +867,7 @@ static void resumeBlockMapZone(void          *context,
                                VDOCompletion *parent)
 {
   BlockMapZone *zone = getBlockMapZone(context, zoneNumber);
+  updateZoneResidence(zone);
   finishCompletion(parent, resumeIfQuiescent(&zone->state));
 }
 
@@ -606,6 +878,58 @@ void resumeBlockMap(BlockMap *map, VDOCompletion *parent)
                     resumeBlockMapZone, NULL, parent);
 }
 
+/**
+ * Resize the page cache of one zone of the block map.
+ *
+ * <p>Implements ZoneAction.
+ **/
+static void resizeZoneCache(void          *context,
+                            ZoneCount      zoneNumber,
+                            VDOCompletion *parent)
+{
+  BlockMap     *map  = context;
+  BlockMapZone *zone = getBlockMapZone(map, zoneNumber);
+  // The requested total size is carried as the action context.
+  PageCount cacheSize
+    = (uintptr_t) getCurrentActionContext(map->actionManager);
+  int result = resizeVDOPageCache(zone->pageCache, cacheSize / map->zoneCount);
+  updateZoneResidence(zone);
+  finishCompletion(parent, result);
+}
+
+/**
+ * Record the new size of the page caches once every zone has been resized.
+ *
+ * <p>Implements ActionConclusion.
+ **/
+static int finishCacheResize(void *context)
+{
+  BlockMap *map = context;
+  map->cacheSize = 0;
+  for (ZoneCount zone = 0; zone < map->zoneCount; zone++) {
+    map->cacheSize += getVDOPageCacheSize(map->zones[zone].pageCache);
+  }
+
+  logInfo("block map cache resized to %u pages", map->cacheSize);
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void resizeBlockMapCaches(BlockMap      *map,
+                          PageCount      cacheSize,
+                          VDOCompletion *parent)
+{
+  scheduleOperationWithContext(map->actionManager, ADMIN_STATE_OPERATING,
+                               NULL, resizeZoneCache, finishCacheResize,
+                               (void *) (uintptr_t) cacheSize, parent);
+}
+
+/**********************************************************************/
+PageCount getBlockMapCacheSize(const BlockMap *map)
+{
+  return map->cacheSize;
+}
+
 /**********************************************************************/
 int prepareToGrowBlockMap(BlockMap *map, BlockCount newLogicalBlocks)
 {
@@ -639,6 +963,7 @@ BlockCount getNewEntryCount(BlockMap *map)
 static void growForest(void *context, VDOCompletion *completion)
 {
   replaceForest(context);
+  publishForest(context);
   completeCompletion(completion);
 }
 
@@ -649,6 +974,49 @@ void growBlockMap(BlockMap *map, VDOCompletion *parent)
                     growForest, NULL, NULL, parent);
 }
 
+/**
+ * Switch the lookups of one zone over to the forest which was prepared. The
+ * new forest shares every page of the old one, so lookups already under way
+ * in the zone are unaffected.
+ *
+ * <p>Implements ZoneAction.
+ **/
+static void switchZoneForest(void          *context,
+                             ZoneCount      zoneNumber,
+                             VDOCompletion *parent)
+{
+  BlockMap     *map  = context;
+  BlockMapZone *zone = getBlockMapZone(map, zoneNumber);
+  if (map->nextForest != NULL) {
+    zone->forest = map->nextForest;
+  }
+
+  zone->entryCount = map->nextEntryCount;
+  updateZoneResidence(zone);
+  finishCompletion(parent, VDO_SUCCESS);
+}
+
+/**
+ * Free what is left of the old forest once every zone has switched away
+ * from it.
+ *
+ * <p>Implements ActionConclusion.
+ **/
+static int finishOnlineGrowth(void *context)
+{
+  BlockMap *map = context;
+  replaceForest(map);
+  logInfo("block map grown to %" PRIu64 " entries", map->entryCount);
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void growBlockMapOnline(BlockMap *map, VDOCompletion *parent)
+{
+  scheduleOperation(map->actionManager, ADMIN_STATE_OPERATING, NULL,
+                    switchZoneForest, finishOnlineGrowth, parent);
+}
+
 /**********************************************************************/
 void abandonBlockMapGrowth(BlockMap *map)
 {
@@ -680,6 +1048,84 @@ static void handlePageError(VDOCompletion *completion)
   finishProcessingPage(completion, completion->result);
 }
 
+/**
+ * Find the next leaf page after a given one which belongs to a zone. Leaf
+ * pages are spread round-robin over the roots, and the roots round-robin
+ * over the zones, so a zone's pages are interleaved with those of the
+ * other zones.
+ *
+ * @param zone        The zone
+ * @param pageNumber  The page to start after
+ *
+ * @return The number of the zone's next leaf page
+ **/
+static PageNumber nextZoneLeafPage(BlockMapZone *zone, PageNumber pageNumber)
+{
+  BlockMap   *map  = zone->blockMap;
+  PageNumber  next = pageNumber + 1;
+  for (RootCount i = 1; i < map->rootCount; i++, next++) {
+    if (((next % map->rootCount) % map->zoneCount) == zone->zoneNumber) {
+      break;
+    }
+  }
+
+  return next;
+}
+
+/**
+ * Note a leaf page fetch in a zone, and if the zone's fetches have been
+ * following the logical order of its pages, start reading the zone's next
+ * few leaf pages into its cache. Pages whose parent tree page is not
+ * loaded, and pages which have not been allocated, are not prefetched.
+ *
+ * @param zone        The zone doing the fetch
+ * @param pageNumber  The page being fetched
+ **/
+static void prefetchLeafPages(BlockMapZone *zone, PageNumber pageNumber)
+{
+  if ((pageNumber == zone->lastLeafPage)
+      || (pageNumber == zone->previousLeafPage)) {
+    // Concurrent requests for the same or a slightly older page.
+    return;
+  }
+
+  if (pageNumber == nextZoneLeafPage(zone, zone->lastLeafPage)) {
+    zone->sequentialRun++;
+  } else {
+    zone->sequentialRun     = 0;
+    zone->prefetchedThrough = pageNumber;
+  }
+
+  zone->previousLeafPage = zone->lastLeafPage;
+  zone->lastLeafPage     = pageNumber;
+  if (zone->sequentialRun < PREFETCH_TRIGGER) {
+    return;
+  }
+
+  PageCount  pageCount = computeBlockMapPageCount(zone->entryCount);
+  PageNumber limit     = pageNumber;
+  for (unsigned int i = 0; i < PREFETCH_WINDOW; i++) {
+    limit = nextZoneLeafPage(zone, limit);
+  }
+
+  if (zone->prefetchedThrough < pageNumber) {
+    zone->prefetchedThrough = pageNumber;
+  }
+
+  while (zone->prefetchedThrough < limit) {
+    PageNumber next = nextZoneLeafPage(zone, zone->prefetchedThrough);
+    if (next >= pageCount) {
+      break;
+    }
+
+    PhysicalBlockNumber pbn = findZoneBlockMapPagePBN(zone, next);
+    if (pbn != ZERO_BLOCK) {
+      prefetchVDOPage(zone->pageCache, pbn);
+    }
+    zone->prefetchedThrough = next;
+  }
+}
+
 /**
  * Get the mapping page for a get/put mapped block operation and dispatch to
  * the appropriate handler.
@@ -698,6 +1144,7 @@ static void setupMappedBlock(DataVIO   *dataVIO,
     return;
   }
 
+  prefetchLeafPages(zone, dataVIO->treeLock.treeSlots[0].pageIndex);
   initVDOPageCompletion(&dataVIO->pageCompletion, zone->pageCache,
                         dataVIO->treeLock.treeSlots[0].blockMapSlot.pbn,
                         modifiable, dataVIOAsCompletion(dataVIO), action,
@@ -752,6 +1199,76 @@ static int setMappedEntry(DataVIO *dataVIO, const BlockMapEntry *entry)
   return VDO_SUCCESS;
 }
 
+/**
+ * Note a read of a logical block in a zone, and if the zone's reads have
+ * been following the logical block order, ask the layer to prefetch the
+ * data of the next few blocks mapped by the same leaf page. The page is
+ * already in hand, so this costs no block map I/O, and the blocks are
+ * handed to the layer as a batch so that it can sort and coalesce them.
+ *
+ * @param zone     The zone of the read
+ * @param dataVIO  The DataVIO looking up its mapping
+ * @param page     The leaf page holding the DataVIO's mapping
+ **/
+static void readAheadFromPage(BlockMapZone       *zone,
+                              DataVIO            *dataVIO,
+                              const BlockMapPage *page)
+{
+  VDO           *vdo   = dataVIOAsVIO(dataVIO)->vdo;
+  PhysicalLayer *layer = vdo->layer;
+  if (!isReadDataVIO(dataVIO) || (layer->prefetchData == NULL)) {
+    return;
+  }
+
+  LogicalBlockNumber lbn = dataVIO->logical.lbn;
+  if (lbn == zone->nextReadLBN) {
+    zone->readStreak++;
+  } else if ((lbn > zone->nextReadLBN)
+             || ((lbn + READ_AHEAD_SLACK) < zone->nextReadLBN)) {
+    zone->readStreak     = 0;
+    zone->readAheadLimit = lbn + 1;
+  } else {
+    // A read of the current stream which was slightly reordered.
+    return;
+  }
+
+  zone->nextReadLBN = lbn + 1;
+  if ((zone->readStreak < READ_AHEAD_TRIGGER)
+      || (zone->readAheadLimit > (lbn + (READ_AHEAD_WINDOW / 2)))) {
+    return;
+  }
+
+  SlotNumber         slot  = dataVIO->treeLock.treeSlots[0].blockMapSlot.slot;
+  LogicalBlockNumber start = lbn + 1;
+  if (zone->readAheadLimit > start) {
+    start = zone->readAheadLimit;
+  }
+
+  // Only the entries of this page are at hand.
+  LogicalBlockNumber end = minUInt64(lbn + READ_AHEAD_WINDOW,
+                                     lbn - slot + BLOCK_MAP_ENTRIES_PER_PAGE);
+  end = minUInt64(end, zone->entryCount);
+
+  PhysicalBlockNumber pbns[READ_AHEAD_WINDOW];
+  BlockCount          count = 0;
+  for (LogicalBlockNumber next = start; next < end; next++) {
+    DataLocation mapped
+      = unpackBlockMapEntry(&page->entries[slot + (next - lbn)]);
+    if ((mapped.pbn != ZERO_BLOCK) && isValidLocation(&mapped)
+        && isPhysicalDataBlock(vdo->depot, mapped.pbn)) {
+      pbns[count++] = mapped.pbn;
+    }
+  }
+
+  if (end > zone->readAheadLimit) {
+    zone->readAheadLimit = end;
+  }
+
+  if (count > 0) {
+    layer->prefetchData(layer, pbns, count);
+  }
+}
+
 /**
  * This callback is registered in getMappedBlockAsync().
  **/
@@ -774,6 +1291,10 @@ static void getMappingFromFetchedPage(VDOCompletion *completion)
   const BlockMapEntry *entry    = &page->entries[treeSlot->blockMapSlot.slot];
 
   result = setMappedEntry(dataVIO, entry);
+  if (result == VDO_SUCCESS) {
+    readAheadFromPage(getBlockMapForZone(dataVIO->logical.zone), dataVIO,
+                      page);
+  }
   finishProcessingPage(completion, result);
 }
 
@@ -803,6 +1324,38 @@ static void putMappingInFetchedPage(VDOCompletion *completion)
   finishProcessingPage(completion, VDO_SUCCESS);
 }
 
+/**
+ * Get the mapping of a DataVIO directly from its block map page if the
+ * zone is resident and the page is usable without waiting.
+ *
+ * @param dataVIO  The DataVIO
+ *
+ * @return <code>true</code> if the mapping was read and the DataVIO has been
+ *         continued
+ **/
+static bool getResidentMapping(DataVIO *dataVIO)
+{
+  BlockMapZone *zone = getBlockMapForZone(dataVIO->logical.zone);
+  if (!zone->resident || isDraining(&zone->state)) {
+    return false;
+  }
+
+  BlockMapTreeSlot   *treeSlot = &dataVIO->treeLock.treeSlots[0];
+  const BlockMapPage *page
+    = findReadableVDOPage(zone->pageCache, treeSlot->blockMapSlot.pbn);
+  if (page == NULL) {
+    return false;
+  }
+
+  const BlockMapEntry *entry  = &page->entries[treeSlot->blockMapSlot.slot];
+  int                  result = setMappedEntry(dataVIO, entry);
+  if (result == VDO_SUCCESS) {
+    readAheadFromPage(zone, dataVIO, page);
+  }
+  continueDataVIO(dataVIO, result);
+  return true;
+}
+
 /**********************************************************************/
 void getMappedBlockAsync(DataVIO *dataVIO)
 {
@@ -814,6 +1367,10 @@ void getMappedBlockAsync(DataVIO *dataVIO)
     return;
   }
 
+  if (getResidentMapping(dataVIO)) {
+    return;
+  }
+
   setupMappedBlock(dataVIO, false, getMappingFromFetchedPage);
 }
 
@@ -853,7 +1410,29 @@ BlockMapStatistics getBlockMapStatistics(BlockMap *map)
     stats.pagesLoaded     += atomicLoad64(&atoms->pagesLoaded);
     stats.pagesSaved      += atomicLoad64(&atoms->pagesSaved);
     stats.flushCount      += atomicLoad64(&atoms->flushCount);
+
+    stats.probationHits      += atomicLoad64(&atoms->probationHits);
+    stats.ghostHits          += atomicLoad64(&atoms->ghostHits);
+    stats.evictions          += atomicLoad64(&atoms->evictions);
+    stats.probationEvictions += atomicLoad64(&atoms->probationEvictions);
+    stats.evictionAge        += atomicLoad64(&atoms->evictionAge);
+    stats.prefetchReads      += atomicLoad64(&atoms->prefetchReads);
+    stats.prefetchHits       += atomicLoad64(&atoms->prefetchHits);
+    stats.prefetchWasted     += atomicLoad64(&atoms->prefetchWasted);
+    stats.entriesWritten     += atomicLoad64(&map->zones[zone].entriesWritten);
+    stats.extentsWritten     += atomicLoad64(&map->zones[zone].extentsWritten);
+
+    VIOPoolStatistics pool
+      = getVIOPoolStatistics(map->zones[zone].treeZone.vioPool);
+    stats.vioPoolWaits            += pool.waits;
+    stats.vioPoolWaitMicroseconds += pool.waitMicroseconds;
+    stats.vioPoolSize             += pool.size;
   }
 
+  stats.traversalPagesQueued = atomicLoad64(&map->traversalPagesQueued);
+  stats.traversalPagesLoaded = atomicLoad64(&map->traversalPagesLoaded);
+  stats.eraLength            = relaxedLoad64(&map->eraLength);
+  stats.shortenedEras        = relaxedLoad64(&map->shortenedEras);
+
   return stats;
 }
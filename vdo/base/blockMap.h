@@ -98,6 +98,17 @@ BlockCount getNewEntryCount(BlockMap *map)
  **/
 void growBlockMap(BlockMap *map, VDOCompletion *parent);
 
+/**
+ * Grow a block map on which prepareToGrowBlockMap() has already been called
+ * without the block map being suspended. Each logical zone switches to the
+ * prepared forest on its own thread, between lookups, and the old forest is
+ * freed once every zone has switched.
+ *
+ * @param map     The block map to grow
+ * @param parent  The object to notify when the growth is complete
+ **/
+void growBlockMapOnline(BlockMap *map, VDOCompletion *parent);
+
 /**
  * Abandon any preparations which were made to grow this block map.
  *
@@ -150,6 +161,7 @@ int decodeSodiumBlockMap(Buffer              *buffer,
  * @param cacheSize         The block map cache size, in pages
  * @param maximumAge        The number of journal blocks before a dirtied page
  *                          is considered old and must be written out
+ * @param cachePolicy       The replacement policy for the caches
  *
  * @return VDO_SUCCESS or an error code
  **/
@@ -159,7 +171,34 @@ int makeBlockMapCaches(BlockMap         *map,
                        RecoveryJournal  *journal,
                        Nonce             nonce,
                        PageCount         cacheSize,
-                       BlockCount        maximumAge)
+                       BlockCount        maximumAge,
+                       PageCachePolicy   cachePolicy)
+  __attribute__((warn_unused_result));
+
+/**
+ * Resize the page caches of a block map while it is running. The new size
+ * is divided evenly among the logical zones. Must be called on the
+ * journal thread.
+ *
+ * @param map        The block map
+ * @param cacheSize  The requested total size of the caches, in pages
+ * @param parent     The completion to notify once every zone has been
+ *                   resized
+ *
+ * @see resizeVDOPageCache()
+ **/
+void resizeBlockMapCaches(BlockMap      *map,
+                          PageCount      cacheSize,
+                          VDOCompletion *parent);
+
+/**
+ * Get the total number of pages in the page caches of a block map.
+ *
+ * @param map  The block map
+ *
+ * @return The size of the caches, in pages
+ **/
+PageCount getBlockMapCacheSize(const BlockMap *map)
   __attribute__((warn_unused_result));
 
 /**
@@ -188,6 +227,39 @@ size_t getBlockMapEncodedSize(void)
 int encodeBlockMap(const BlockMap *map, Buffer *buffer)
   __attribute__((warn_unused_result));
 
+/**
+ * Encode the leaf pages each zone's cache held when the block map last
+ * drained, so that the caches can be warmed when the VDO is next loaded.
+ * Nothing is encoded if the block map has no caches.
+ *
+ * @param map     The block map
+ * @param buffer  The buffer to encode into
+ *
+ * @return UDS_SUCCESS or an error
+ **/
+int encodeBlockMapWarmPages(const BlockMap *map, Buffer *buffer)
+  __attribute__((warn_unused_result));
+
+/**
+ * Decode the leaf pages saved by encodeBlockMapWarmPages(). Since the pages
+ * are only hints, they are discarded if they can not be decoded, or if the
+ * number of logical zones has changed since they were saved. This must be
+ * called after makeBlockMapCaches().
+ *
+ * @param map     The block map
+ * @param buffer  The buffer to decode from
+ **/
+void decodeBlockMapWarmPages(BlockMap *map, Buffer *buffer);
+
+/**
+ * Start reading the leaf pages decoded by decodeBlockMapWarmPages() into the
+ * caches of their zones, in PBN order. This must be called from the journal
+ * thread, once the VDO is ready for normal operation.
+ *
+ * @param map  The block map
+ **/
+void prefetchWarmBlockMapPages(BlockMap *map);
+
 /**
  * Obtain any necessary state from the recovery journal that is needed for
  * normal block map operation.
@@ -23,6 +23,7 @@
 #define BLOCK_MAP_INTERNALS_H
 
 #include "adminState.h"
+#include "atomic.h"
 #include "blockMapEntry.h"
 #include "blockMapTree.h"
 #include "completion.h"
@@ -65,19 +66,56 @@ struct blockMapTreeZone {
  **/
 struct blockMapZone {
   /** The number of the zone this is */
-  ZoneCount         zoneNumber;
+  ZoneCount          zoneNumber;
   /** The ID of this zone's logical thread */
-  ThreadID          threadID;
+  ThreadID           threadID;
+  /** The memory node of this zone's logical thread */
+  int                numaNode;
   /** The BlockMap which owns this BlockMapZone */
-  BlockMap         *blockMap;
+  BlockMap          *blockMap;
   /** The ReadOnlyNotifier of the VDO */
-  ReadOnlyNotifier *readOnlyNotifier;
+  ReadOnlyNotifier  *readOnlyNotifier;
   /** The page cache for this zone */
-  VDOPageCache     *pageCache;
+  VDOPageCache      *pageCache;
   /** The per-zone portion of the tree for this zone */
-  BlockMapTreeZone  treeZone;
+  BlockMapTreeZone   treeZone;
+  /**
+   * The forest this zone's lookups use; only changed on the zone's thread,
+   * so that an online grow can switch each zone to the larger forest in turn
+   **/
+  Forest            *forest;
+  /** The number of entries of the block map this zone may look up */
+  BlockCount         entryCount;
   /** The administrative state of the zone */
-  AdminState        state;
+  AdminState         state;
+  /** The leaf page most recently fetched, for detecting sequential access */
+  PageNumber         lastLeafPage;
+  /** The leaf page fetched before lastLeafPage */
+  PageNumber         previousLeafPage;
+  /** The number of leaf pages in a row fetched in logical order */
+  unsigned int       sequentialRun;
+  /** The last leaf page which has been considered for prefetching */
+  PageNumber         prefetchedThrough;
+  /** The logical block a sequential read stream in this zone expects next */
+  LogicalBlockNumber nextReadLBN;
+  /** The number of reads in a row which have followed the stream */
+  unsigned int       readStreak;
+  /** The logical block up to which the stream's data has been prefetched */
+  LogicalBlockNumber readAheadLimit;
+  /**
+   * Whether every leaf page of the zone fits in its cache, so that leaf
+   * pages are read in as soon as their parent is loaded, and lookups of
+   * cached pages skip the page completion
+   **/
+  bool               resident;
+  /** The leaf pages cached when the zone last drained, in PBN order */
+  PhysicalBlockNumber *warmPages;
+  /** The number of pages in warmPages */
+  PageCount          warmPageCount;
+  /** The number of mapped entries in the leaf pages this zone has written */
+  Atomic64           entriesWritten;
+  /** The number of extents those entries would collapse into */
+  Atomic64           extentsWritten;
 };
 
 struct blockMap {
@@ -94,6 +132,10 @@ struct blockMap {
   SequenceNumber       currentEraPoint;
   /** The next era point, not yet distributed to any zone */
   SequenceNumber       pendingEraPoint;
+  /** The configured maximum age of a dirty page, in journal blocks */
+  BlockCount           maximumAge;
+  /** The era length currently being distributed to the zones */
+  BlockCount           currentEraLength;
 
   /** The number of entries in block map */
   BlockCount           entryCount;
@@ -109,6 +151,22 @@ struct blockMap {
   /** The number of entries after growth */
   BlockCount           nextEntryCount;
 
+  /** The total number of pages in the zone page caches */
+  PageCount            cacheSize;
+  /** The storage for the warmPages lists of all the zones */
+  PhysicalBlockNumber *warmPages;
+  /** The number of entries of warmPages which belong to each zone */
+  PageCount            warmPagesPerZone;
+
+  /** The number of tree pages the last traversal has found to read */
+  Atomic64             traversalPagesQueued;
+  /** The number of those pages which have been read */
+  Atomic64             traversalPagesLoaded;
+  /** The era length most recently chosen, for statistics */
+  Atomic64             eraLength;
+  /** The number of era advances made with a shortened era */
+  Atomic64             shortenedEras;
+
   /** The number of logical zones */
   ZoneCount            zoneCount;
   /** The per zone block map structure */
@@ -84,6 +84,37 @@ BlockMapPageValidity validateBlockMapPage(BlockMapPage        *page,
   return BLOCK_MAP_PAGE_VALID;
 }
 
+/**********************************************************************/
+BlockCount countBlockMapPageExtents(const BlockMapPage *page,
+                                    BlockCount         *mappedPtr)
+{
+  BlockCount          mapped  = 0;
+  BlockCount          extents = 0;
+  PhysicalBlockNumber nextPBN = ZERO_BLOCK;
+  for (SlotNumber slot = 0; slot < BLOCK_MAP_ENTRIES_PER_PAGE; slot++) {
+    DataLocation location = unpackBlockMapEntry(&page->entries[slot]);
+    if (!isMappedLocation(&location)) {
+      nextPBN = ZERO_BLOCK;
+      continue;
+    }
+
+    mapped++;
+    if (isCompressed(location.state)) {
+      extents++;
+      nextPBN = ZERO_BLOCK;
+      continue;
+    }
+
+    if ((nextPBN == ZERO_BLOCK) || (location.pbn != nextPBN)) {
+      extents++;
+    }
+    nextPBN = location.pbn + 1;
+  }
+
+  *mappedPtr = mapped;
+  return extents;
+}
+
 /**********************************************************************/
 void updateBlockMapPage(BlockMapPage        *page,
                         DataVIO             *dataVIO,
@@ -180,6 +180,20 @@ BlockMapPageValidity validateBlockMapPage(BlockMapPage        *page,
                                           PhysicalBlockNumber  pbn)
   __attribute__((warn_unused_result));
 
+/**
+ * Count the mapped entries of a block map page, and the number of extents
+ * they would collapse into if each run of consecutive uncompressed entries
+ * mapping consecutive physical blocks were stored as a single entry.
+ * Compressed entries are each their own extent.
+ *
+ * @param [in]  page       The page to examine
+ * @param [out] mappedPtr  A pointer to hold the number of mapped entries
+ *
+ * @return The number of extents
+ **/
+BlockCount countBlockMapPageExtents(const BlockMapPage *page,
+                                    BlockCount         *mappedPtr);
+
 /**
  * Update an entry on a block map page.
  *
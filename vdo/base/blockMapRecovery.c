@@ -19,6 +19,7 @@
  * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/base/blockMapRecovery.c#7 $
  */
 
+
 #include "blockMapRecovery.h"
 
 #include "logger.h"
@@ -34,23 +35,23 @@
 #include "vdoInternal.h"
 #include "vdoPageCache.h"
 
+typedef struct blockMapRecovery BlockMapRecovery;
+
 /**
- * A completion to manage recovering the block map from the recovery journal.
- * Note that the page completions kept in this structure are not immediately
- * freed, so the corresponding pages will be locked down in the page cache
- * until the recovery frees them.
+ * A completion to manage recovering the block map pages assigned to one
+ * logical zone from the recovery journal. Note that the page completions
+ * kept in this structure are not immediately freed, so the corresponding
+ * pages will be locked down in the page cache until the recovery frees them.
  **/
 typedef struct {
   /** completion header */
   VDOCompletion         completion;
-  /** the completion for flushing the block map */
-  VDOCompletion         subTaskCompletion;
-  /** the thread from which the block map may be flushed */
-  ThreadID              adminThread;
-  /** the thread on which all block map operations must be done */
+  /** the recovery of which this zone is a part */
+  BlockMapRecovery     *mapRecovery;
+  /** the thread on which all block map operations for this zone are done */
   ThreadID              logicalThreadID;
-  /** the block map */
-  BlockMap             *blockMap;
+  /** the page cache of this zone */
+  VDOPageCache         *pageCache;
   /** whether this recovery has been aborted */
   bool                  aborted;
   /** whether we are currently launching the initial round of requests */
@@ -59,6 +60,8 @@ typedef struct {
   // Fields for the journal entries.
   /** the journal entries to apply */
   NumberedBlockMapping *journalEntries;
+  /** the number of journal entries assigned to this zone */
+  BlockCount            entryCount;
   /**
    * a heap wrapping journalEntries. It re-orders and sorts journal entries in
    * ascending LBN order, then original journal order. This permits efficient
@@ -83,6 +86,27 @@ typedef struct {
   VDOPageCompletion     pageCompletions[];
 } BlockMapRecoveryCompletion;
 
+/**
+ * The recovery of the whole block map. The journal entries are divided among
+ * the logical zones by block map page so that every zone replays its share
+ * concurrently on its own thread, and the block map is flushed once all of
+ * them have finished.
+ **/
+struct blockMapRecovery {
+  /** the completion for flushing the block map */
+  VDOCompletion               completion;
+  /** the block map */
+  BlockMap                   *blockMap;
+  /** the thread from which the block map may be flushed */
+  ThreadID                    adminThread;
+  /** the number of zones replaying entries */
+  ZoneCount                   zoneCount;
+  /** the number of zones which have not finished (plus one while launching) */
+  ZoneCount                   zonesReplaying;
+  /** the recoveries of each zone */
+  BlockMapRecoveryCompletion *zones[];
+};
+
 /**
  * This is a HeapComparator function that orders NumberedBlockMappings using
  * the 'blockMapSlot' field as the primary key and the mapping 'number' field
@@ -145,60 +169,131 @@ asBlockMapRecoveryCompletion(VDOCompletion *completion)
   return (BlockMapRecoveryCompletion *) completion;
 }
 
+/**
+ * Convert a VDOCompletion to a BlockMapRecovery.
+ *
+ * @param completion  The completion to convert
+ *
+ * @return The completion as a BlockMapRecovery
+ **/
+__attribute__((warn_unused_result))
+static inline BlockMapRecovery *asBlockMapRecovery(VDOCompletion *completion)
+{
+  STATIC_ASSERT(offsetof(BlockMapRecovery, completion) == 0);
+  assertCompletionType(completion->type, SUB_TASK_COMPLETION);
+  return (BlockMapRecovery *) completion;
+}
+
 /**
  * Free a BlockMapRecoveryCompletion and null out the reference to it.
  *
- * @param completionPtr  a pointer to the completion to free
+ * @param recoveryPtr  a pointer to the completion to free
  **/
-static void freeRecoveryCompletion(VDOCompletion **completionPtr)
+static void freeRecoveryCompletion(BlockMapRecoveryCompletion **recoveryPtr)
 {
-  VDOCompletion *completion = *completionPtr;
-  if (completion == NULL) {
+  BlockMapRecoveryCompletion *recovery = *recoveryPtr;
+  if (recovery == NULL) {
     return;
   }
 
-  BlockMapRecoveryCompletion *recovery
-    = asBlockMapRecoveryCompletion(*completionPtr);
-  destroyEnqueueable(completion);
-  destroyEnqueueable(&recovery->subTaskCompletion);
+  destroyEnqueueable(&recovery->completion);
   FREE(recovery);
-  *completionPtr = NULL;
+  *recoveryPtr = NULL;
+}
+
+/**
+ * Free a BlockMapRecovery and the recoveries of all of its zones.
+ *
+ * @param mapRecoveryPtr  a pointer to the recovery to free
+ **/
+static void freeBlockMapRecovery(BlockMapRecovery **mapRecoveryPtr)
+{
+  BlockMapRecovery *mapRecovery = *mapRecoveryPtr;
+  if (mapRecovery == NULL) {
+    return;
+  }
+
+  for (ZoneCount zone = 0; zone < mapRecovery->zoneCount; zone++) {
+    freeRecoveryCompletion(&mapRecovery->zones[zone]);
+  }
+
+  destroyEnqueueable(&mapRecovery->completion);
+  FREE(mapRecovery);
+  *mapRecoveryPtr = NULL;
 }
 
 /**
- * Free the BlockMapRecoveryCompletion and notify the parent that the block map
- * recovery is done. This callback is registered in makeRecoveryCompletion().
+ * Free the BlockMapRecovery and notify the parent that the block map
+ * recovery is done. This callback is registered in launchZoneRecoveries().
  *
- * @param completion  The BlockMapRecoveryCompletion
+ * @param completion  The BlockMapRecovery
  **/
 static void finishBlockMapRecovery(VDOCompletion *completion)
 {
-  int            result = completion->result;
-  VDOCompletion *parent = completion->parent;
-  freeRecoveryCompletion(&completion);
+  int               result      = completion->result;
+  VDOCompletion    *parent      = completion->parent;
+  BlockMapRecovery *mapRecovery = asBlockMapRecovery(completion);
+  freeBlockMapRecovery(&mapRecovery);
   finishCompletion(parent, result);
 }
 
 /**
- * Make a new block map recovery completion.
+ * Note that one zone (or the launching of the zones) has finished. Once all
+ * of them have, flush the block map if the recovery was successful, or clean
+ * up if it wasn't.
  *
- * @param [in]  vdo             The VDO
- * @param [in]  entryCount      The number of journal entries
- * @param [in]  journalEntries  An array of journal entries to process
- * @param [in]  parent          The parent of the recovery completion
- * @param [out] recoveryPtr     The new block map recovery completion
+ * @param mapRecovery  The BlockMapRecovery
+ **/
+static void releaseZoneRecovery(BlockMapRecovery *mapRecovery)
+{
+  ASSERT_LOG_ONLY((getCallbackThreadID() == mapRecovery->adminThread),
+                  "%s called on admin thread", __func__);
+  if (--mapRecovery->zonesReplaying > 0) {
+    return;
+  }
+
+  if (mapRecovery->completion.result != VDO_SUCCESS) {
+    completeCompletion(&mapRecovery->completion);
+    return;
+  }
+
+  logInfo("Flushing block map changes");
+  drainBlockMap(mapRecovery->blockMap, ADMIN_STATE_RECOVERING,
+                &mapRecovery->completion);
+}
+
+/**
+ * Record the result of recovering one zone. This callback is registered in
+ * startZoneRecovery().
+ *
+ * @param completion  The BlockMapRecoveryCompletion of the zone
+ **/
+static void finishZoneRecovery(VDOCompletion *completion)
+{
+  BlockMapRecovery *mapRecovery
+    = asBlockMapRecoveryCompletion(completion)->mapRecovery;
+  setCompletionResult(&mapRecovery->completion, completion->result);
+  releaseZoneRecovery(mapRecovery);
+}
+
+/**
+ * Make the recovery completion for one logical zone.
+ *
+ * @param [in]  mapRecovery  The recovery of the whole block map
+ * @param [in]  zoneNumber   The number of the zone
+ * @param [in]  layer        The physical layer of the VDO
+ * @param [out] recoveryPtr  The new block map recovery completion
  *
  * @return a success or error code
  **/
-static int makeRecoveryCompletion(VDO                         *vdo,
-                                  BlockCount                   entryCount,
-                                  NumberedBlockMapping        *journalEntries,
-                                  VDOCompletion               *parent,
+static int makeRecoveryCompletion(BlockMapRecovery            *mapRecovery,
+                                  ZoneCount                    zoneNumber,
+                                  PhysicalLayer               *layer,
                                   BlockMapRecoveryCompletion **recoveryPtr)
 {
-  BlockMap *blockMap = getBlockMap(vdo);
-  PageCount pageCount
-    = minPageCount(getConfiguredCacheSize(vdo) >> 1,
+  VDOPageCache *pageCache = mapRecovery->blockMap->zones[zoneNumber].pageCache;
+  PageCount     pageCount
+    = minPageCount(getVDOPageCacheSize(pageCache) >> 1,
                    MAXIMUM_SIMULTANEOUS_BLOCK_MAP_RESTORATION_READS);
 
   BlockMapRecoveryCompletion *recovery;
@@ -210,67 +305,132 @@ static int makeRecoveryCompletion(VDO                         *vdo,
 
   result = initializeEnqueueableCompletion(&recovery->completion,
                                            BLOCK_MAP_RECOVERY_COMPLETION,
-                                           vdo->layer);
+                                           layer);
   if (result != VDO_SUCCESS) {
-    VDOCompletion *completion = &recovery->completion;
-    freeRecoveryCompletion(&completion);
+    freeRecoveryCompletion(&recovery);
     return result;
   }
 
-  result = initializeEnqueueableCompletion(&recovery->subTaskCompletion,
+  recovery->mapRecovery     = mapRecovery;
+  recovery->pageCache       = pageCache;
+  recovery->pageCount       = pageCount;
+  recovery->logicalThreadID
+    = mapRecovery->blockMap->zones[zoneNumber].threadID;
+  *recoveryPtr = recovery;
+  return VDO_SUCCESS;
+}
+
+/**
+ * Make a new block map recovery, with a recovery completion for each logical
+ * zone.
+ *
+ * @param [in]  vdo             The VDO
+ * @param [in]  parent          The parent of the recovery
+ * @param [out] mapRecoveryPtr  The new block map recovery
+ *
+ * @return a success or error code
+ **/
+static int makeBlockMapRecovery(VDO               *vdo,
+                                VDOCompletion     *parent,
+                                BlockMapRecovery **mapRecoveryPtr)
+{
+  BlockMap  *blockMap  = getBlockMap(vdo);
+  ZoneCount  zoneCount = blockMap->zoneCount;
+
+  BlockMapRecovery *mapRecovery;
+  int result = ALLOCATE_EXTENDED(BlockMapRecovery, zoneCount,
+                                 BlockMapRecoveryCompletion *, __func__,
+                                 &mapRecovery);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  result = initializeEnqueueableCompletion(&mapRecovery->completion,
                                            SUB_TASK_COMPLETION, vdo->layer);
   if (result != VDO_SUCCESS) {
-    VDOCompletion *completion = &recovery->completion;
-    freeRecoveryCompletion(&completion);
+    freeBlockMapRecovery(&mapRecovery);
     return result;
   }
 
-  recovery->blockMap       = blockMap;
-  recovery->journalEntries = journalEntries;
-  recovery->pageCount      = pageCount;
-  recovery->currentEntry   = &recovery->journalEntries[entryCount - 1];
-
-  const ThreadConfig *threadConfig = getThreadConfig(vdo);
-  recovery->adminThread     = getAdminThread(threadConfig);
-  recovery->logicalThreadID = getLogicalZoneThread(threadConfig, 0);
-
-  // Organize the journal entries into a binary heap so we can iterate over
-  // them in sorted order incrementally, avoiding an expensive sort call.
-  initializeHeap(&recovery->replayHeap, compareMappings, swapMappings,
-                 journalEntries, entryCount, sizeof(NumberedBlockMapping));
-  buildHeap(&recovery->replayHeap, entryCount);
-
-  ASSERT_LOG_ONLY((getCallbackThreadID() == recovery->logicalThreadID),
-                  "%s must be called on logical thread %u (not %u)", __func__,
-                  recovery->logicalThreadID, getCallbackThreadID());
-  prepareCompletion(&recovery->completion, finishBlockMapRecovery,
-                    finishBlockMapRecovery, recovery->logicalThreadID, parent);
+  mapRecovery->blockMap    = blockMap;
+  mapRecovery->adminThread = getAdminThread(getThreadConfig(vdo));
+  for (ZoneCount zone = 0; zone < zoneCount; zone++) {
+    result = makeRecoveryCompletion(mapRecovery, zone, vdo->layer,
+                                    &mapRecovery->zones[zone]);
+    if (result != VDO_SUCCESS) {
+      freeBlockMapRecovery(&mapRecovery);
+      return result;
+    }
 
-  // This message must be recognizable by VDOTest::RebuildBase.
-  logInfo("Replaying %zu recovery entries into block map",
-          recovery->replayHeap.count);
+    mapRecovery->zoneCount++;
+  }
 
-  *recoveryPtr = recovery;
+  mapRecovery->completion.parent = parent;
+  *mapRecoveryPtr = mapRecovery;
   return VDO_SUCCESS;
 }
 
-/**********************************************************************/
-static void flushBlockMap(VDOCompletion *completion)
+/**
+ * Get the zone which will replay a journal entry. Every entry for a given
+ * block map page goes to the same zone so that each page is only ever in the
+ * cache of one zone during the recovery.
+ *
+ * @param mapRecovery  The BlockMapRecovery
+ * @param entry        The journal entry
+ *
+ * @return The number of the zone which will replay the entry
+ **/
+static inline ZoneCount getEntryZone(const BlockMapRecovery     *mapRecovery,
+                                     const NumberedBlockMapping *entry)
 {
-  logInfo("Flushing block map changes");
-  BlockMapRecoveryCompletion *recovery
-    = asBlockMapRecoveryCompletion(completion->parent);
-  ASSERT_LOG_ONLY((completion->callbackThreadID == recovery->adminThread),
-                  "flushBlockMap() called on admin thread");
+  return (entry->blockMapSlot.pbn % mapRecovery->zoneCount);
+}
 
-  prepareToFinishParent(completion, completion->parent);
-  drainBlockMap(recovery->blockMap, ADMIN_STATE_RECOVERING, completion);
+/**
+ * Rearrange the journal entries in place so that each zone has a contiguous
+ * range of the entries it will replay. The order of entries within a zone
+ * does not matter since each zone sorts its own entries.
+ *
+ * @param mapRecovery     The BlockMapRecovery
+ * @param entryCount      The number of journal entries
+ * @param journalEntries  The journal entries
+ **/
+static void partitionEntries(BlockMapRecovery     *mapRecovery,
+                             BlockCount            entryCount,
+                             NumberedBlockMapping *journalEntries)
+{
+  for (BlockCount i = 0; i < entryCount; i++) {
+    ZoneCount zone = getEntryZone(mapRecovery, &journalEntries[i]);
+    mapRecovery->zones[zone]->entryCount++;
+  }
+
+  // The current entry of each zone serves as the cursor for placing entries.
+  NumberedBlockMapping *start = journalEntries;
+  for (ZoneCount zone = 0; zone < mapRecovery->zoneCount; zone++) {
+    BlockMapRecoveryCompletion *recovery = mapRecovery->zones[zone];
+    recovery->journalEntries = start;
+    recovery->currentEntry   = start;
+    start += recovery->entryCount;
+  }
+
+  for (ZoneCount zone = 0; zone < mapRecovery->zoneCount; zone++) {
+    BlockMapRecoveryCompletion *recovery = mapRecovery->zones[zone];
+    NumberedBlockMapping *end = recovery->journalEntries + recovery->entryCount;
+    while (recovery->currentEntry < end) {
+      ZoneCount target = getEntryZone(mapRecovery, recovery->currentEntry);
+      if (target == zone) {
+        recovery->currentEntry++;
+        continue;
+      }
+
+      swapMappings(recovery->currentEntry,
+                   mapRecovery->zones[target]->currentEntry++);
+    }
+  }
 }
 
 /**
- * Check whether the recovery is done. If so, finish it by either flushing the
- * block map (if the recovery was successful), or by cleaning up (if it
- * wasn't).
+ * Check whether the recovery of a zone is done. If so, finish it.
  *
  * @param recovery  The recovery completion
  *
@@ -296,15 +456,11 @@ static bool finishIfDone(BlockMapRecoveryCompletion *recovery)
         releaseVDOPageCompletion(&pageCompletion->completion);
       }
     }
-    completeCompletion(&recovery->completion);
-  } else {
-    launchCallbackWithParent(&recovery->subTaskCompletion, flushBlockMap,
-                             recovery->adminThread, &recovery->completion);
   }
 
+  completeCompletion(&recovery->completion);
   return true;
 }
-
 /**
  * Note that there has been an error during the recovery and finish it if there
  * is nothing else outstanding.
@@ -429,8 +585,8 @@ static void fetchPage(BlockMapRecoveryCompletion *recovery,
     = findEntryStartingNextPage(recovery, recovery->currentUnfetchedEntry,
                                 true);
   initVDOPageCompletion(((VDOPageCompletion *) completion),
-                        recovery->blockMap->zones[0].pageCache,
-                        newPBN, true, &recovery->completion,
+                        recovery->pageCache, newPBN, true,
+                        &recovery->completion,
                         pageLoaded, handlePageLoadError);
   recovery->outstanding++;
   getVDOPageAsync(completion);
@@ -500,24 +656,34 @@ static void recoverReadyPages(BlockMapRecoveryCompletion *recovery,
   }
 }
 
-/**********************************************************************/
-void recoverBlockMap(VDO                  *vdo,
-                     BlockCount            entryCount,
-                     NumberedBlockMapping *journalEntries,
-                     VDOCompletion        *parent)
+
+/**
+ * Start replaying the journal entries assigned to a zone. This callback is
+ * registered in launchZoneRecoveries().
+ *
+ * @param completion  The BlockMapRecoveryCompletion of the zone
+ **/
+static void startZoneRecovery(VDOCompletion *completion)
 {
-  BlockMapRecoveryCompletion *recovery;
-  int result = makeRecoveryCompletion(vdo, entryCount, journalEntries, parent,
-                                      &recovery);
-  if (result != VDO_SUCCESS) {
-    finishCompletion(parent, result);
+  BlockMapRecoveryCompletion *recovery
+    = asBlockMapRecoveryCompletion(completion);
+  ASSERT_LOG_ONLY((getCallbackThreadID() == recovery->logicalThreadID),
+                  "%s must be called on logical thread %u (not %u)", __func__,
+                  recovery->logicalThreadID, getCallbackThreadID());
+  prepareCompletion(completion, finishZoneRecovery, finishZoneRecovery,
+                    recovery->mapRecovery->adminThread, recovery->mapRecovery);
+  if (recovery->entryCount == 0) {
+    completeCompletion(completion);
     return;
   }
 
-  if (isHeapEmpty(&recovery->replayHeap)) {
-    finishCompletion(&recovery->completion, VDO_SUCCESS);
-    return;
-  }
+  // Organize the journal entries into a binary heap so we can iterate over
+  // them in sorted order incrementally, avoiding an expensive sort call.
+  initializeHeap(&recovery->replayHeap, compareMappings, swapMappings,
+                 recovery->journalEntries, recovery->entryCount,
+                 sizeof(NumberedBlockMapping));
+  buildHeap(&recovery->replayHeap, recovery->entryCount);
+  recovery->currentEntry = &recovery->journalEntries[recovery->entryCount - 1];
 
   NumberedBlockMapping *firstSortedEntry
     = sortNextHeapElement(&recovery->replayHeap);
@@ -540,3 +706,48 @@ void recoverBlockMap(VDO                  *vdo,
   // Process any ready pages.
   recoverReadyPages(recovery, &recovery->pageCompletions[0].completion);
 }
+
+/**
+ * Launch the recovery of every zone. The count of replaying zones includes
+ * the launch itself so that the recovery can't finish before all of the
+ * zones have been started. This callback is registered in recoverBlockMap().
+ *
+ * @param completion  The BlockMapRecovery
+ **/
+static void launchZoneRecoveries(VDOCompletion *completion)
+{
+  BlockMapRecovery *mapRecovery = asBlockMapRecovery(completion);
+  prepareCompletion(completion, finishBlockMapRecovery,
+                    finishBlockMapRecovery, mapRecovery->adminThread,
+                    completion->parent);
+  mapRecovery->zonesReplaying = mapRecovery->zoneCount + 1;
+  for (ZoneCount zone = 0; zone < mapRecovery->zoneCount; zone++) {
+    BlockMapRecoveryCompletion *recovery = mapRecovery->zones[zone];
+    launchCallback(&recovery->completion, startZoneRecovery,
+                   recovery->logicalThreadID);
+  }
+
+  releaseZoneRecovery(mapRecovery);
+}
+
+/**********************************************************************/
+void recoverBlockMap(VDO                  *vdo,
+                     BlockCount            entryCount,
+                     NumberedBlockMapping *journalEntries,
+                     VDOCompletion        *parent)
+{
+  BlockMapRecovery *mapRecovery;
+  int result = makeBlockMapRecovery(vdo, parent, &mapRecovery);
+  if (result != VDO_SUCCESS) {
+    finishCompletion(parent, result);
+    return;
+  }
+
+  // This message must be recognizable by VDOTest::RebuildBase.
+  logInfo("Replaying %" PRIu64 " recovery entries into block map",
+          entryCount);
+
+  partitionEntries(mapRecovery, entryCount, journalEntries);
+  launchCallback(&mapRecovery->completion, launchZoneRecoveries,
+                 mapRecovery->adminThread);
+}
@@ -42,7 +42,9 @@
 #include "vioPool.h"
 
 enum {
-  BLOCK_MAP_VIO_POOL_SIZE = 64,
+  BLOCK_MAP_VIO_POOL_SIZE         = 64,
+  /** The most VIOs a zone's pool may grow to during heavy tree writes */
+  MAXIMUM_BLOCK_MAP_VIO_POOL_SIZE = 4 * BLOCK_MAP_VIO_POOL_SIZE,
 };
 
 typedef struct __attribute__((packed)) {
@@ -118,8 +120,9 @@ int initializeTreeZone(BlockMapZone  *zone,
     return result;
   }
 
-  return makeVIOPool(layer, BLOCK_MAP_VIO_POOL_SIZE, zone->threadID,
-                     makeBlockMapVIOs, treeZone, &treeZone->vioPool);
+  return makeGrowableVIOPool(layer, BLOCK_MAP_VIO_POOL_SIZE,
+                             MAXIMUM_BLOCK_MAP_VIO_POOL_SIZE, zone->threadID,
+                             makeBlockMapVIOs, treeZone, &treeZone->vioPool);
 }
 
 /**********************************************************************/
@@ -171,7 +174,7 @@ static inline BlockMapTreeZone *getBlockMapTreeZone(DataVIO *dataVIO)
 static inline BlockMapTree *getTree(BlockMapTreeZone *zone, DataVIO *dataVIO)
 {
   RootCount rootIndex = dataVIO->treeLock.rootIndex;
-  return getTreeFromForest(zone->mapZone->blockMap->forest, rootIndex);
+  return getTreeFromForest(zone->mapZone->forest, rootIndex);
 }
 
 /**
@@ -188,7 +191,7 @@ static inline TreePage *getTreePage(BlockMapTreeZone *zone,
                                     BlockMapTree     *tree,
                                     TreeLock         *lock)
 {
-  return getTreePageByIndex(zone->mapZone->blockMap->forest, tree,
+  return getTreePageByIndex(zone->mapZone->forest, tree,
                             lock->height,
                             lock->treeSlots[lock->height].pageIndex);
 }
@@ -593,8 +596,11 @@ static void writeDirtyPagesCallback(RingNode *expired, void *context)
 }
 
 /**********************************************************************/
-void advanceZoneTreePeriod(BlockMapTreeZone *zone, SequenceNumber period)
+void advanceZoneTreePeriod(BlockMapTreeZone *zone,
+                           SequenceNumber    period,
+                           BlockCount        eraLength)
 {
+  setDirtyListsAge(zone->dirtyLists, eraLength);
   advancePeriod(zone->dirtyLists, period);
 }
 
@@ -776,6 +782,31 @@ static void continueWithLoadedPage(DataVIO *dataVIO, BlockMapPage *page)
   loadBlockMapPage(getBlockMapTreeZone(dataVIO), dataVIO);
 }
 
+/**
+ * Start reading in all the leaf pages under a newly loaded height one tree
+ * page if the zone keeps all of its leaf pages resident.
+ *
+ * @param zone  The zone which loaded the page
+ * @param vdo   The VDO
+ * @param page  The tree page which was just loaded
+ **/
+static void preloadLeafPages(BlockMapTreeZone   *zone,
+                             const VDO          *vdo,
+                             const BlockMapPage *page)
+{
+  BlockMapZone *mapZone = zone->mapZone;
+  if (!mapZone->resident || !isBlockMapPageInitialized(page)) {
+    return;
+  }
+
+  for (SlotNumber slot = 0; slot < BLOCK_MAP_ENTRIES_PER_PAGE; slot++) {
+    DataLocation mapping = unpackBlockMapEntry(&page->entries[slot]);
+    if (isMappedLocation(&mapping) && !isInvalidTreeEntry(vdo, &mapping, 1)) {
+      prefetchVDOPage(mapZone->pageCache, mapping.pbn);
+    }
+  }
+}
+
 /**
  * Continue a block map PBN lookup now that the page load we were waiting on
  * has finished.
@@ -814,6 +845,9 @@ static void finishBlockMapPageLoad(VDOCompletion *completion)
     formatBlockMapPage(page, nonce, pbn, false);
   }
   returnVIOToPool(zone->vioPool, entry);
+  if (treeLock->height == 1) {
+    preloadLeafPages(zone, getVDOFromDataVIO(dataVIO), page);
+  }
 
   // Release our claim to the load and wake any waiters
   releasePageLock(dataVIO, "load");
@@ -1250,8 +1284,18 @@ void lookupBlockMapPBN(DataVIO *dataVIO)
   loadBlockMapPage(zone, dataVIO);
 }
 
-/**********************************************************************/
-PhysicalBlockNumber findBlockMapPagePBN(BlockMap *map, PageNumber pageNumber)
+/**
+ * Find the PBN of a leaf block map page in a given forest.
+ *
+ * @param map         The block map
+ * @param forest      The forest to search
+ * @param pageNumber  The page number of the desired block map page
+ *
+ * @return The PBN of the page
+ **/
+static PhysicalBlockNumber findForestPagePBN(BlockMap   *map,
+                                             Forest     *forest,
+                                             PageNumber  pageNumber)
 {
   if (pageNumber < map->flatPageCount) {
     return (BLOCK_MAP_FLAT_PAGE_ORIGIN + pageNumber);
@@ -1262,8 +1306,8 @@ PhysicalBlockNumber findBlockMapPagePBN(BlockMap *map, PageNumber pageNumber)
   SlotNumber slot      = pageIndex % BLOCK_MAP_ENTRIES_PER_PAGE;
   pageIndex /= BLOCK_MAP_ENTRIES_PER_PAGE;
 
-  BlockMapTree *tree     = getTreeFromForest(map->forest, rootIndex);
-  TreePage     *treePage = getTreePageByIndex(map->forest, tree, 1, pageIndex);
+  BlockMapTree *tree     = getTreeFromForest(forest, rootIndex);
+  TreePage     *treePage = getTreePageByIndex(forest, tree, 1, pageIndex);
   BlockMapPage *page     = (BlockMapPage *) treePage->pageBuffer;
   if (!isBlockMapPageInitialized(page)) {
     return ZERO_BLOCK;
@@ -1276,6 +1320,19 @@ PhysicalBlockNumber findBlockMapPagePBN(BlockMap *map, PageNumber pageNumber)
   return mapping.pbn;
 }
 
+/**********************************************************************/
+PhysicalBlockNumber findBlockMapPagePBN(BlockMap *map, PageNumber pageNumber)
+{
+  return findForestPagePBN(map, map->forest, pageNumber);
+}
+
+/**********************************************************************/
+PhysicalBlockNumber findZoneBlockMapPagePBN(BlockMapZone *zone,
+                                            PageNumber    pageNumber)
+{
+  return findForestPagePBN(zone->blockMap, zone->forest, pageNumber);
+}
+
 /**********************************************************************/
 void writeTreePage(TreePage *page, BlockMapTreeZone *zone)
 {
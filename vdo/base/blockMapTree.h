@@ -72,10 +72,13 @@ bool isTreeZoneActive(BlockMapTreeZone *zone)
 /**
  * Advance the dirty period for a tree zone.
  *
- * @param zone    The BlockMapTreeZone to advance
- * @param period  The new dirty period
+ * @param zone       The BlockMapTreeZone to advance
+ * @param period     The new dirty period
+ * @param eraLength  The number of periods a page may now stay dirty
  **/
-void advanceZoneTreePeriod(BlockMapTreeZone *zone, SequenceNumber period);
+void advanceZoneTreePeriod(BlockMapTreeZone *zone,
+                           SequenceNumber    period,
+                           BlockCount        eraLength);
 
 /**
  * Drain the zone trees, i.e. ensure that all I/O is quiesced. If required by
@@ -107,6 +110,19 @@ void lookupBlockMapPBN(DataVIO *dataVIO);
  **/
 PhysicalBlockNumber findBlockMapPagePBN(BlockMap *map, PageNumber pageNumber);
 
+/**
+ * Find the PBN of a leaf block map page using the forest of a zone. Unlike
+ * findBlockMapPagePBN(), this is safe to call from the zone's thread while
+ * the block map is growing.
+ *
+ * @param zone        The zone doing the search
+ * @param pageNumber  The page number of the desired block map page
+ *
+ * @return The PBN of the page
+ **/
+PhysicalBlockNumber findZoneBlockMapPagePBN(BlockMapZone *zone,
+                                            PageNumber    pageNumber);
+
 /**
  * Write a tree page or indicate that it has been re-dirtied if it is already
  * being written. This method is used when correcting errors in the tree during
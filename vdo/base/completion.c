@@ -41,6 +41,7 @@ static const char *VDO_COMPLETION_TYPE_NAMES[] = {
   "GENERATION_FLUSHED_COMPLETION",
   "HEARTBEAT_COMPLETION",
   "LOCK_COUNTER_COMPLETION",
+  "PAGE_CACHE_REAPER_COMPLETION",
   "PARTITION_COPY_COMPLETION",
   "READ_ONLY_MODE_COMPLETION",
   "READ_ONLY_REBUILD_COMPLETION",
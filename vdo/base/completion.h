@@ -45,6 +45,7 @@ typedef enum __attribute__((packed)) {
   GENERATION_FLUSHED_COMPLETION,
   HEARTBEAT_COMPLETION,
   LOCK_COUNTER_COMPLETION,
+  PAGE_CACHE_REAPER_COMPLETION,
   PARTITION_COPY_COMPLETION,
   READ_ONLY_MODE_COMPLETION,
   READ_ONLY_REBUILD_COMPLETION,
@@ -170,7 +171,9 @@ void resetCompletion(VDOCompletion *completion);
  * Invoke the callback of a completion. If called on the correct thread (i.e.
  * the one specified in the completion's callbackThreadID field), the
  * completion will be run immediately. Otherwise, the completion will be
- * enqueued on the correct callback thread.
+ * enqueued on the correct callback thread. When a ThreadConfig puts several
+ * zones on one thread, a hop between those zones is therefore a direct call
+ * unless the completion has been marked for requeueing.
  **/
 void invokeCallback(VDOCompletion *completion);
 
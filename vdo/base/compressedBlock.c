@@ -24,11 +24,24 @@
 #include "memoryAlloc.h"
 #include "numeric.h"
 
+#include "constants.h"
+
 static const VersionNumber COMPRESSED_BLOCK_1_0 = {
   .majorVersion = 1,
   .minorVersion = 0,
 };
 
+static const VersionNumber COMPRESSED_BLOCK_1_1 = {
+  .majorVersion = 1,
+  .minorVersion = 1,
+};
+
+enum {
+  /** The number of low bits of a version 1.1 size which hold the size */
+  FRAGMENT_SIZE_BITS = 12,
+  FRAGMENT_SIZE_MASK = (1 << FRAGMENT_SIZE_BITS) - 1,
+};
+
 /**********************************************************************/
 void resetCompressedBlockHeader(CompressedBlockHeader *header)
 {
@@ -38,11 +51,21 @@ void resetCompressedBlockHeader(CompressedBlockHeader *header)
   memset(header->fields.sizes, 0, sizeof(header->fields.sizes));
 }
 
-/**********************************************************************/
-static uint16_t
-getCompressedFragmentSize(const CompressedBlockHeader *header, byte slot)
+/**
+ * Get the size of a fragment from a compressed block header.
+ *
+ * @param header  The header
+ * @param tagged  Whether the sizes carry compression tags (version 1.1)
+ * @param slot    The slot of the fragment
+ *
+ * @return The size of the fragment
+ **/
+static uint16_t getCompressedFragmentSize(const CompressedBlockHeader *header,
+                                          bool                         tagged,
+                                          byte                         slot)
 {
-  return getUInt16LE(header->fields.sizes[slot]);
+  uint16_t size = getUInt16LE(header->fields.sizes[slot]);
+  return (tagged ? (size & FRAGMENT_SIZE_MASK) : size);
 }
 
 /**********************************************************************/
@@ -50,7 +73,8 @@ int getCompressedBlockFragment(BlockMappingState  mappingState,
                                char              *buffer,
                                BlockSize          blockSize,
                                uint16_t          *fragmentOffset,
-                               uint16_t          *fragmentSize)
+                               uint16_t          *fragmentSize,
+                               CompressionTag    *fragmentTag)
 {
   if (!isCompressed(mappingState)) {
     return VDO_INVALID_FRAGMENT;
@@ -58,7 +82,8 @@ int getCompressedBlockFragment(BlockMappingState  mappingState,
 
   CompressedBlockHeader *header = (CompressedBlockHeader *) buffer;
   VersionNumber version = unpackVersionNumber(header->fields.version);
-  if (!areSameVersion(version, COMPRESSED_BLOCK_1_0)) {
+  bool tagged = areSameVersion(version, COMPRESSED_BLOCK_1_1);
+  if (!tagged && !areSameVersion(version, COMPRESSED_BLOCK_1_0)) {
     return VDO_INVALID_FRAGMENT;
   }
 
@@ -67,10 +92,10 @@ int getCompressedBlockFragment(BlockMappingState  mappingState,
     return VDO_INVALID_FRAGMENT;
   }
 
-  uint16_t compressedSize = getCompressedFragmentSize(header, slot);
+  uint16_t compressedSize = getCompressedFragmentSize(header, tagged, slot);
   uint16_t offset         = sizeof(CompressedBlockHeader);
   for (unsigned int i = 0; i < slot; i++) {
-    offset += getCompressedFragmentSize(header, i);
+    offset += getCompressedFragmentSize(header, tagged, i);
     if (offset >= blockSize) {
       return VDO_INVALID_FRAGMENT;
     }
@@ -80,8 +105,17 @@ int getCompressedBlockFragment(BlockMappingState  mappingState,
     return VDO_INVALID_FRAGMENT;
   }
 
+  CompressionTag tag = COMPRESSION_TAG_LZ4;
+  if (tagged) {
+    tag = getUInt16LE(header->fields.sizes[slot]) >> FRAGMENT_SIZE_BITS;
+    if (tag >= COMPRESSION_TAG_COUNT) {
+      return VDO_INVALID_FRAGMENT;
+    }
+  }
+
   *fragmentOffset = offset;
   *fragmentSize   = compressedSize;
+  *fragmentTag    = tag;
   return VDO_SUCCESS;
 }
 
@@ -90,8 +124,20 @@ void putCompressedBlockFragment(CompressedBlock *block,
                                 unsigned int     fragment,
                                 uint16_t         offset,
                                 const char      *data,
-                                uint16_t         size)
+                                uint16_t         size,
+                                CompressionTag   tag)
 {
-  storeUInt16LE(block->header.fields.sizes[fragment], size);
+  STATIC_ASSERT(VDO_BLOCK_SIZE <= FRAGMENT_SIZE_MASK + 1);
+  CompressedBlockHeader *header = &block->header;
+  if ((tag != COMPRESSION_TAG_LZ4)
+      && areSameVersion(unpackVersionNumber(header->fields.version),
+                        COMPRESSED_BLOCK_1_0)) {
+    // Blocks holding only LZ4 fragments stay readable by older versions,
+    // so only switch to the tagged format once some other tag shows up.
+    header->fields.version = packVersionNumber(COMPRESSED_BLOCK_1_1);
+  }
+
+  storeUInt16LE(header->fields.sizes[fragment],
+                size | ((uint16_t) tag << FRAGMENT_SIZE_BITS));
   memcpy(&block->data[offset], data, size);
 }
@@ -25,6 +25,19 @@
 #include "blockMappingState.h"
 #include "header.h"
 
+/**
+ * The on-disk tags identifying the compressor which produced a fragment.
+ * Only LZ4 fragments may appear in a version 1.0 compressed block; version
+ * 1.1 blocks store a tag in the top bits of each fragment size.
+ **/
+typedef enum {
+  COMPRESSION_TAG_LZ4     = 0,
+  COMPRESSION_TAG_ZSTD    = 1,
+  COMPRESSION_TAG_LZO     = 2,
+  COMPRESSION_TAG_DEFLATE = 3,
+  COMPRESSION_TAG_COUNT,
+} CompressionTag;
+
 /**
  * The header of a compressed block.
  **/
@@ -33,7 +46,11 @@ typedef union __attribute__((packed)) {
     /** Unsigned 32-bit major and minor versions, in little-endian byte order */
     PackedVersionNumber version;
 
-    /** List of unsigned 16-bit compressed block sizes, in little-endian order */
+    /**
+     * List of unsigned 16-bit compressed block sizes, in little-endian order.
+     * In version 1.1 blocks, the high bits of each size hold the
+     * CompressionTag of the fragment.
+     */
     byte sizes[MAX_COMPRESSION_SLOTS][2];
   } fields;
 
@@ -77,6 +94,7 @@ void resetCompressedBlockHeader(CompressedBlockHeader *header);
  * @param [out] fragmentOffset  the offset of the fragment within a
  *                              compressed block
  * @param [out] fragmentSize    the size of the fragment
+ * @param [out] fragmentTag     the compressor which produced the fragment
  *
  * @return If a valid compressed fragment is found, VDO_SUCCESS;
  *         otherwise, VDO_INVALID_FRAGMENT if the fragment is invalid.
@@ -85,7 +103,8 @@ int getCompressedBlockFragment(BlockMappingState  mappingState,
                                char              *buffer,
                                BlockSize          blockSize,
                                uint16_t          *fragmentOffset,
-                               uint16_t          *fragmentSize);
+                               uint16_t          *fragmentSize,
+                               CompressionTag    *fragmentTag);
 
 /**
  * Copy a fragment into the compressed block.
@@ -95,6 +114,7 @@ int getCompressedBlockFragment(BlockMappingState  mappingState,
  * @param offset     the byte offset of the fragment in the data area
  * @param data       a pointer to the compressed data
  * @param size       the size of the data
+ * @param tag        the compressor which produced the data
  *
  * @note no bounds checking -- the data better fit without smashing other stuff
  **/
@@ -102,6 +122,7 @@ void putCompressedBlockFragment(CompressedBlock *block,
                                 unsigned int     fragment,
                                 uint16_t         offset,
                                 const char      *data,
-                                uint16_t         size);
+                                uint16_t         size,
+                                CompressionTag   tag);
 
 #endif // COMPRESSED_BLOCK_H
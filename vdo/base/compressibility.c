@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/base/compressibility.c#1 $
+ */
+
+#include "compressibility.h"
+
+#include "numeric.h"
+#include "permassert.h"
+
+#include "constants.h"
+#include "numUtils.h"
+
+enum {
+  SAMPLE_COUNT       = VDO_BLOCK_SIZE / COMPRESSIBILITY_SAMPLE_STRIDE,
+  SAMPLED_BYTES      = SAMPLE_COUNT * COMPRESSIBILITY_SAMPLE_SIZE,
+  /**
+   * The number of sampled regions whose leading words may collide in the
+   * filter before we assume the block has repeated content. With 64 samples
+   * in a 4096-bit filter, random data averages about half a collision.
+   **/
+  MAX_SAMPLE_REPEATS = 3,
+  /**
+   * The entropy, in quarter-bits per byte, at or above which the sample
+   * looks incompressible. 30 is 7.5 bits per byte; random data estimates at
+   * very nearly 8, while text and most uncompressed binary formats come in
+   * well under 6.
+   **/
+  ENTROPY_THRESHOLD  = 30,
+};
+
+/**
+ * Compute four times the base-two logarithm of a number, rounded down. The
+ * extra factor gives a quarter bit of precision, which is plenty for the
+ * entropy estimate, without needing any floating point.
+ *
+ * @param n  The number, which must be no more than SAMPLED_BYTES
+ *
+ * @return floor(4 * log2(n))
+ **/
+static inline unsigned int quarterLog2(uint64_t n)
+{
+  return logBaseTwo(n * n * n * n);
+}
+
+/**
+ * Count the sampled regions whose leading words have been seen before.
+ *
+ * @param block      The block being examined
+ * @param seenWords  The filter to use, which will be cleared first
+ *
+ * @return The number of apparently repeated samples
+ **/
+static unsigned int countRepeatedSamples(const char *block,
+                                         uint64_t   *seenWords)
+{
+  memset(seenWords, 0, COMPRESSIBILITY_FILTER_BITS / CHAR_BIT);
+  unsigned int repeats = 0;
+  for (unsigned int offset = 0;
+       offset < VDO_BLOCK_SIZE;
+       offset += COMPRESSIBILITY_SAMPLE_STRIDE) {
+    // Fibonacci hashing of the word picks out well-mixed high bits.
+    uint64_t word = getUInt64LE((const byte *) block + offset);
+    unsigned int bit = ((word * 0x9e3779b97f4a7c15ULL)
+                        >> (64 - logBaseTwo(COMPRESSIBILITY_FILTER_BITS)));
+    uint64_t mask = 1ULL << (bit % 64);
+    if ((seenWords[bit / 64] & mask) != 0) {
+      repeats++;
+    }
+    seenWords[bit / 64] |= mask;
+  }
+  return repeats;
+}
+
+/**
+ * Estimate the entropy of the sampled bytes of a block.
+ *
+ * @param block      The block being examined
+ * @param histogram  The byte histogram to use, which will be cleared first
+ *
+ * @return The estimated entropy in quarter-bits per byte
+ **/
+static unsigned int estimateSampleEntropy(const char *block,
+                                          uint16_t   *histogram)
+{
+  memset(histogram, 0, 256 * sizeof(uint16_t));
+  for (unsigned int offset = 0;
+       offset < VDO_BLOCK_SIZE;
+       offset += COMPRESSIBILITY_SAMPLE_STRIDE) {
+    const byte *sample = (const byte *) block + offset;
+    for (unsigned int i = 0; i < COMPRESSIBILITY_SAMPLE_SIZE; i++) {
+      histogram[sample[i]]++;
+    }
+  }
+
+  // H = sum(c * (log2(N) - log2(c))) / N, for each byte count c in N bytes.
+  unsigned int logTotal = quarterLog2(SAMPLED_BYTES);
+  uint64_t     sum      = 0;
+  for (unsigned int i = 0; i < 256; i++) {
+    uint16_t count = histogram[i];
+    if (count > 0) {
+      sum += count * (logTotal - quarterLog2(count));
+    }
+  }
+  return sum / SAMPLED_BYTES;
+}
+
+/**********************************************************************/
+bool isProbablyIncompressible(const char               *block,
+                              CompressibilityWorkspace *workspace)
+{
+  STATIC_ASSERT(SAMPLED_BYTES <= UINT16_MAX);
+  if (countRepeatedSamples(block, workspace->seenWords) > MAX_SAMPLE_REPEATS) {
+    return false;
+  }
+
+  return (estimateSampleEntropy(block, workspace->histogram)
+          >= ENTROPY_THRESHOLD);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/base/compressibility.h#1 $
+ */
+
+#ifndef COMPRESSIBILITY_H
+#define COMPRESSIBILITY_H
+
+#include "types.h"
+
+enum {
+  /** The number of bytes sampled from each sampled region of a block */
+  COMPRESSIBILITY_SAMPLE_SIZE   = 16,
+  /** The distance between the starts of successive sampled regions */
+  COMPRESSIBILITY_SAMPLE_STRIDE = 64,
+  /** The number of bits in the repeated-sample filter */
+  COMPRESSIBILITY_FILTER_BITS   = 4096,
+};
+
+/**
+ * Scratch space for estimating the compressibility of a block. It is too big
+ * to put on the kernel stack, so callers must provide it; any otherwise idle
+ * buffer of at least this size will do.
+ **/
+typedef struct {
+  /** Counts of each byte value seen in the sample */
+  uint16_t histogram[256];
+  /** A bit filter of the leading words of the sampled regions */
+  uint64_t seenWords[COMPRESSIBILITY_FILTER_BITS / 64];
+} CompressibilityWorkspace;
+
+/**
+ * Cheaply estimate whether a block is so unlikely to compress that it is not
+ * worth running the compressor on it.
+ *
+ * <p>Only a sample of the block is examined. The estimate is conservative:
+ * a block is only judged incompressible if the sampled bytes have close to
+ * the maximum possible entropy and there is no sign of repeated content
+ * (which LZ4 could exploit even in high-entropy data). Already-compressed
+ * or encrypted data is the expected case.
+ *
+ * @param block      The block to examine, VDO_BLOCK_SIZE bytes long
+ * @param workspace  Scratch space for the estimate
+ *
+ * @return <code>true</code> if the block should not be compressed
+ **/
+bool isProbablyIncompressible(const char               *block,
+                              CompressibilityWorkspace *workspace)
+  __attribute__((warn_unused_result));
+
+#endif // COMPRESSIBILITY_H
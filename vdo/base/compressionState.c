@@ -100,11 +100,12 @@ bool mayCompressDataVIO(DataVIO *dataVIO)
   if (!hasAllocation(dataVIO)
       || ((getWritePolicy(getVDOFromDataVIO(dataVIO)) != WRITE_POLICY_SYNC)
           && vioRequiresFlushAfter(dataVIOAsVIO(dataVIO)))
-      || !getVDOCompressing(getVDOFromDataVIO(dataVIO))) {
+      || !getVDOCompressing(getVDOFromDataVIO(dataVIO))
+      || ((dataVIO->policy & LBN_POLICY_COMPRESS) == 0)) {
     /*
      * If this VIO didn't get an allocation, the compressed write probably
      * won't either, so don't try compressing it. Also, if compression is off,
-     * don't compress.
+     * for the whole VDO or for the VIO's block, don't compress.
      */
     setCompressionDone(dataVIO);
     return false;
@@ -57,6 +57,9 @@ enum {
   /** The maximum number of logical zones */
   MAX_LOGICAL_ZONES                                = 60,
 
+  /** The maximum number of packer zones */
+  MAX_PACKER_ZONES                                 = 16,
+
   /** The maximum number of physical zones */
   MAX_PHYSICAL_ZONES                               = 16,
 
@@ -29,6 +29,7 @@
 #include "extent.h"
 #include "logicalZone.h"
 #include "threadConfig.h"
+#include "timeUtils.h"
 #include "vdoInternal.h"
 #include "vioRead.h"
 #include "vioWrite.h"
@@ -39,6 +40,7 @@ static const char *ASYNC_OPERATION_NAMES[] = {
   "acquireHashLock",
   "acquireLogicalBlockLock",
   "acquirePBNReadLock",
+  "allocateDataBlock",
   "checkForDedupeForRollover",
   "checkForDeduplication",
   "compressData",
@@ -67,6 +69,55 @@ static const char *ASYNC_OPERATION_NAMES[] = {
   "writeData",
 };
 
+/** The write stage to which the time spent in each operation is charged */
+static const WriteStage OPERATION_STAGES[] = {
+  [LAUNCH]                            = WRITE_STAGE_LOGICAL_LOCK,
+  [ACKNOWLEDGE_WRITE]                 = WRITE_STAGE_ACKNOWLEDGE,
+  [ACQUIRE_HASH_LOCK]                 = WRITE_STAGE_HASHING,
+  [ACQUIRE_LOGICAL_BLOCK_LOCK]        = WRITE_STAGE_LOGICAL_LOCK,
+  [ACQUIRE_PBN_READ_LOCK]             = WRITE_STAGE_VERIFICATION,
+  [ALLOCATE_DATA_BLOCK]               = WRITE_STAGE_ALLOCATION,
+  [CHECK_FOR_DEDUPE_FOR_ROLLOVER]     = WRITE_STAGE_INDEX,
+  [CHECK_FOR_DEDUPLICATION]           = WRITE_STAGE_INDEX,
+  [COMPRESS_DATA]                     = WRITE_STAGE_COMPRESSION,
+  [CONTINUE_VIO_ASYNC]                = WRITE_STAGE_BLOCK_MAP,
+  [FIND_BLOCK_MAP_SLOT]               = WRITE_STAGE_BLOCK_MAP,
+  [GET_MAPPED_BLOCK]                  = WRITE_STAGE_BLOCK_MAP,
+  [GET_MAPPED_BLOCK_FOR_DEDUPE]       = WRITE_STAGE_BLOCK_MAP,
+  [GET_MAPPED_BLOCK_FOR_WRITE]        = WRITE_STAGE_BLOCK_MAP,
+  [HASH_DATA]                         = WRITE_STAGE_HASHING,
+  [JOURNAL_DECREMENT_FOR_DEDUPE]      = WRITE_STAGE_JOURNAL,
+  [JOURNAL_DECREMENT_FOR_WRITE]       = WRITE_STAGE_JOURNAL,
+  [JOURNAL_INCREMENT_FOR_COMPRESSION] = WRITE_STAGE_JOURNAL,
+  [JOURNAL_INCREMENT_FOR_DEDUPE]      = WRITE_STAGE_JOURNAL,
+  [JOURNAL_INCREMENT_FOR_WRITE]       = WRITE_STAGE_JOURNAL,
+  [JOURNAL_MAPPING_FOR_COMPRESSION]   = WRITE_STAGE_JOURNAL,
+  [JOURNAL_MAPPING_FOR_DEDUPE]        = WRITE_STAGE_JOURNAL,
+  [JOURNAL_MAPPING_FOR_WRITE]         = WRITE_STAGE_JOURNAL,
+  [JOURNAL_UNMAPPING_FOR_DEDUPE]      = WRITE_STAGE_JOURNAL,
+  [JOURNAL_UNMAPPING_FOR_WRITE]       = WRITE_STAGE_JOURNAL,
+  [PACK_COMPRESSED_BLOCK]             = WRITE_STAGE_COMPRESSION,
+  [PUT_MAPPED_BLOCK]                  = WRITE_STAGE_BLOCK_MAP,
+  [PUT_MAPPED_BLOCK_FOR_DEDUPE]       = WRITE_STAGE_BLOCK_MAP,
+  [READ_DATA]                         = WRITE_STAGE_DATA_WRITE,
+  [UPDATE_INDEX]                      = WRITE_STAGE_INDEX,
+  [VERIFY_DEDUPLICATION]              = WRITE_STAGE_VERIFICATION,
+  [WRITE_DATA]                        = WRITE_STAGE_DATA_WRITE,
+};
+
+static const char *WRITE_STAGE_NAMES[] = {
+  "logical_lock",
+  "block_map",
+  "allocation",
+  "data_write",
+  "journal",
+  "acknowledge",
+  "hashing",
+  "index",
+  "verification",
+  "compression",
+};
+
 /**
  * Initialize the LBN lock of a DataVIO. In addition to recording the LBN on
  * which the DataVIO will operate, it will also find the logical zone
@@ -81,6 +132,7 @@ static void initializeLBNLock(DataVIO *dataVIO, LogicalBlockNumber lbn)
   lock->lbn     = lbn;
   lock->locked  = false;
   initializeWaitQueue(&lock->waiters);
+  initializeWaitQueue(&lock->absorbed);
 
   VDO *vdo   = getVDOFromDataVIO(dataVIO);
   lock->zone = getLogicalZone(vdo->logicalZones, computeLogicalZone(dataVIO));
@@ -102,10 +154,15 @@ void prepareDataVIO(DataVIO            *dataVIO,
 
   resetAllocation(dataVIOAsAllocatingVIO(dataVIO));
 
-  dataVIO->isDuplicate = false;
+  dataVIO->isDuplicate         = false;
+  dataVIO->duplicateGeneration = 0;
+  dataVIO->duplicateIsFresh    = false;
 
   memset(&dataVIO->chunkName, 0, sizeof(dataVIO->chunkName));
   memset(&dataVIO->duplicate, 0, sizeof(dataVIO->duplicate));
+  memset(dataVIO->stageTimes, 0, sizeof(dataVIO->stageTimes));
+  dataVIO->lastAsyncOperation = LAUNCH;
+  dataVIO->operationStartTime = nowUsec();
 
   VIO *vio       = dataVIOAsVIO(dataVIO);
   vio->operation = operation;
@@ -121,6 +178,25 @@ void prepareDataVIO(DataVIO            *dataVIO,
                      THIS_LOCATION("$F;cb=acquireLogicalBlockLock"));
 }
 
+/**
+ * Charge the time since the current operation of a write DataVIO started to
+ * the write stage of that operation.
+ *
+ * @param dataVIO  The DataVIO
+ **/
+static void chargeWriteStage(DataVIO *dataVIO)
+{
+  if (isReadDataVIO(dataVIO)
+      || (dataVIO->lastAsyncOperation >= MAX_ASYNC_OPERATION_NUMBER)) {
+    return;
+  }
+
+  uint64_t   now   = nowUsec();
+  WriteStage stage = OPERATION_STAGES[dataVIO->lastAsyncOperation];
+  dataVIO->stageTimes[stage]  += now - dataVIO->operationStartTime;
+  dataVIO->operationStartTime  = now;
+}
+
 /**********************************************************************/
 void completeDataVIO(VDOCompletion *completion)
 {
@@ -138,6 +214,7 @@ void completeDataVIO(VDOCompletion *completion)
   if (isReadDataVIO(dataVIO)) {
     cleanupReadDataVIO(dataVIO);
   } else {
+    chargeWriteStage(dataVIO);
     cleanupWriteDataVIO(dataVIO);
   }
 }
@@ -150,6 +227,24 @@ void finishDataVIO(DataVIO *dataVIO, int result)
   completeDataVIO(completion);
 }
 
+/**********************************************************************/
+void setDataVIOOperation(DataVIO *dataVIO, AsyncOperationNumber operation)
+{
+  STATIC_ASSERT((MAX_ASYNC_OPERATION_NUMBER - MIN_ASYNC_OPERATION_NUMBER)
+                == COUNT_OF(OPERATION_STAGES));
+
+  chargeWriteStage(dataVIO);
+  dataVIO->lastAsyncOperation = operation;
+}
+
+/**********************************************************************/
+const char *getWriteStageName(WriteStage stage)
+{
+  STATIC_ASSERT(WRITE_STAGE_COUNT == COUNT_OF(WRITE_STAGE_NAMES));
+  return ((stage < WRITE_STAGE_COUNT)
+          ? WRITE_STAGE_NAMES[stage] : "unknown write stage");
+}
+
 /**********************************************************************/
 const char *getOperationName(DataVIO *dataVIO)
 {
@@ -162,7 +257,9 @@ const char *getOperationName(DataVIO *dataVIO)
 }
 
 /**********************************************************************/
-void receiveDedupeAdvice(DataVIO *dataVIO, const DataLocation *advice)
+void receiveDedupeAdvice(DataVIO            *dataVIO,
+                         const DataLocation *advice,
+                         uint64_t            generation)
 {
   /*
    * NOTE: this is called on non-base-code threads. Be very careful to not do
@@ -173,13 +270,19 @@ void receiveDedupeAdvice(DataVIO *dataVIO, const DataLocation *advice)
   VDO *vdo = getVDOFromDataVIO(dataVIO);
   ZonedPBN duplicate = validateDedupeAdvice(vdo, advice, dataVIO->logical.lbn);
   setDuplicateLocation(dataVIO, duplicate);
+  dataVIO->adviceRejected = ((advice != NULL) && !dataVIO->isDuplicate);
+  if (dataVIO->isDuplicate) {
+    dataVIO->duplicateGeneration = generation;
+  }
 }
 
 /**********************************************************************/
 void setDuplicateLocation(DataVIO *dataVIO, const ZonedPBN source)
 {
-  dataVIO->isDuplicate = (source.pbn != ZERO_BLOCK);
-  dataVIO->duplicate   = source;
+  dataVIO->isDuplicate         = (source.pbn != ZERO_BLOCK);
+  dataVIO->duplicate           = source;
+  dataVIO->duplicateGeneration = 0;
+  dataVIO->duplicateIsFresh    = false;
 }
 
 /**********************************************************************/
@@ -271,7 +374,7 @@ void attemptLogicalBlockLock(VDOCompletion *completion)
     return;
   }
 
-  dataVIO->lastAsyncOperation = ACQUIRE_LOGICAL_BLOCK_LOCK;
+  setDataVIOOperation(dataVIO, ACQUIRE_LOGICAL_BLOCK_LOCK);
   result = enqueueDataVIO(&lockHolder->logical.waiters, dataVIO,
                           THIS_LOCATION("$F;cb=logicalBlockLock"));
   if (result != VDO_SUCCESS) {
@@ -315,10 +418,56 @@ static void releaseLock(DataVIO *dataVIO)
   return;
 }
 
+/**
+ * Check whether a waiter for an LBN lock may be absorbed by the waiter
+ * behind it. Any write (or trim), full or partial, may be absorbed by a full
+ * block write, which overwrites it completely. A partial write may also
+ * absorb any write, since it applies the data of the writes it absorbed to
+ * the block it reads before applying its own; this lets a stream of small
+ * writes to one block share a single read-modify-write. The absorbed write
+ * must not ask for its data to be made durable on its own.
+ *
+ * @param dataVIO  The waiter which would be absorbed
+ * @param waiters  The remaining waiters for the lock
+ *
+ * @return <code>true</code> if the waiter may be absorbed
+ **/
+static bool mayAbsorbWrite(DataVIO *dataVIO, WaitQueue *waiters)
+{
+  if (isReadDataVIO(dataVIO)
+      || vioRequiresFlushAfter(dataVIOAsVIO(dataVIO))
+      || !hasWaiters(waiters)) {
+    return false;
+  }
+
+  DataVIO *successor = waiterAsDataVIO(getFirstWaiter(waiters));
+  return (isWriteDataVIO(successor)
+          || isReadModifyWriteVIO(dataVIOAsVIO(successor)));
+}
+
+/**
+ * Complete the writes absorbed by a DataVIO with its result, now that the
+ * data which superseded them has been written.
+ *
+ * @param dataVIO  The DataVIO which absorbed the writes
+ **/
+static void finishAbsorbedWrites(DataVIO *dataVIO)
+{
+  int result = dataVIOAsCompletion(dataVIO)->result;
+  while (hasWaiters(&dataVIO->logical.absorbed)) {
+    DataVIO *absorbed
+      = waiterAsDataVIO(dequeueNextWaiter(&dataVIO->logical.absorbed));
+    // Absorbed writes hold no locks but they still clean up in this zone.
+    dataVIOAsCompletion(absorbed)->requeue = true;
+    finishDataVIO(absorbed, result);
+  }
+}
+
 /**********************************************************************/
 void releaseLogicalBlockLock(DataVIO *dataVIO)
 {
   assertInLogicalZone(dataVIO);
+  finishAbsorbedWrites(dataVIO);
   if (!hasWaiters(&dataVIO->logical.waiters)) {
     releaseLock(dataVIO);
     return;
@@ -331,6 +480,30 @@ void releaseLogicalBlockLock(DataVIO *dataVIO)
   // lock map operation
   DataVIO *nextLockHolder = waiterAsDataVIO(dequeueNextWaiter(&lock->waiters));
 
+  /*
+   * Rather than writing blocks which will immediately be overwritten, let
+   * each such write be absorbed by the write which supersedes it (or, for
+   * partial writes, which merges it into its own read-modify-write). An
+   * absorbed write is acknowledged when the write which absorbed it
+   * releases the lock, by which point the superseding data is in place.
+   * Since the absorbed writes have not yet joined a flush generation, a
+   * flush cannot complete before they do.
+   */
+  while (mayAbsorbWrite(nextLockHolder, &lock->waiters)) {
+    DataVIO *successor = waiterAsDataVIO(dequeueNextWaiter(&lock->waiters));
+    transferAllWaiters(&nextLockHolder->logical.absorbed,
+                       &successor->logical.absorbed);
+    int result = enqueueDataVIO(&successor->logical.absorbed, nextLockHolder,
+                                THIS_LOCATION("$F;cb=absorbedWrite"));
+    if (result != VDO_SUCCESS) {
+      dataVIOAsCompletion(nextLockHolder)->requeue = true;
+      finishDataVIO(nextLockHolder, result);
+    } else {
+      recordAbsorbedWrite(lock->zone);
+    }
+    nextLockHolder = successor;
+  }
+
   // Transfer the remaining lock waiters to the next lock holder.
   transferAllWaiters(&lock->waiters, &nextLockHolder->logical.waiters);
 
@@ -26,6 +26,7 @@
 #include "atomic.h"
 #include "blockMapEntry.h"
 #include "blockMappingState.h"
+#include "compressedBlock.h"
 #include "constants.h"
 #include "hashZone.h"
 #include "journalPoint.h"
@@ -49,6 +50,7 @@ typedef enum __attribute__((packed)) {
   ACQUIRE_HASH_LOCK,
   ACQUIRE_LOGICAL_BLOCK_LOCK,
   ACQUIRE_PBN_READ_LOCK,
+  ALLOCATE_DATA_BLOCK,
   CHECK_FOR_DEDUPE_FOR_ROLLOVER,
   CHECK_FOR_DEDUPLICATION,
   COMPRESS_DATA,
@@ -78,6 +80,24 @@ typedef enum __attribute__((packed)) {
   MAX_ASYNC_OPERATION_NUMBER,
 } AsyncOperationNumber;
 
+/**
+ * The stages of the write path. The time a write spends in each asynchronous
+ * operation is charged to the stage which that operation belongs to.
+ **/
+typedef enum {
+  WRITE_STAGE_LOGICAL_LOCK = 0,
+  WRITE_STAGE_BLOCK_MAP,
+  WRITE_STAGE_ALLOCATION,
+  WRITE_STAGE_DATA_WRITE,
+  WRITE_STAGE_JOURNAL,
+  WRITE_STAGE_ACKNOWLEDGE,
+  WRITE_STAGE_HASHING,
+  WRITE_STAGE_INDEX,
+  WRITE_STAGE_VERIFICATION,
+  WRITE_STAGE_COMPRESSION,
+  WRITE_STAGE_COUNT,
+} WriteStage;
+
 /*
  * An LBN lock.
  */
@@ -88,6 +108,8 @@ struct lbnLock {
   bool                locked;
   /* The queue of waiters for the lock */
   WaitQueue           waiters;
+  /* The queued writes this lock holder has superseded */
+  WaitQueue           absorbed;
   /* The logical zone of the LBN */
   LogicalZone        *zone;
 };
@@ -138,6 +160,12 @@ typedef struct {
   /* A pointer to the compressed form of this block */
   char          *data;
 
+  /* The compressor which produced the compressed form of this block */
+  CompressionTag tag;
+
+  /* When this DataVIO was added to an input bin (microseconds) */
+  uint64_t       arrivalTime;
+
   /*
    * A VIO which is blocked in the packer while holding a lock this VIO needs.
    */
@@ -167,6 +195,12 @@ struct dataVIO {
   /* Used for logging and debugging */
   AsyncOperationNumber lastAsyncOperation;
 
+  /* When lastAsyncOperation was started (microseconds) */
+  uint64_t             operationStartTime;
+
+  /* The time a write has spent in each stage (microseconds) */
+  uint32_t             stageTimes[WRITE_STAGE_COUNT];
+
   /* The operation to record in the recovery and slab journals */
   ReferenceOperation   operation;
 
@@ -179,6 +213,9 @@ struct dataVIO {
   /* Whether this VIO write is a duplicate */
   bool                 isDuplicate;
 
+  /* What the write path may do with the data of this VIO write */
+  LBNPolicy            policy;
+
   /*
    * Whether this VIO has received an allocation (needs to be atomic so it can
    * be examined from threads not in the allocation zone).
@@ -200,6 +237,26 @@ struct dataVIO {
   /* The block number in the partition of the albireo deduplication advice */
   ZonedPBN             duplicate;
 
+  /*
+   * The free generation the advice for the duplicate was stamped with, or 0
+   * if the advice was not stamped (must be cleared whenever the duplicate
+   * changes).
+   */
+  uint64_t             duplicateGeneration;
+
+  /*
+   * Whether the duplicate is known not to have been freed since its advice
+   * was stamped, so that it need not be verified.
+   */
+  bool                 duplicateIsFresh;
+
+  /*
+   * Whether the last index query returned advice which could not be used at
+   * all, so that the index record must be replaced even if this VIO's own
+   * location was posted with the query.
+   */
+  bool                 adviceRejected;
+
   /*
    * The sequence number of the recovery journal block containing the increment
    * entry for this VIO.
@@ -391,6 +448,27 @@ static inline DataLocation getDataVIONewAdvice(const DataVIO *dataVIO)
   };
 }
 
+/**
+ * Get the free generation with which to stamp the new advice for a DataVIO.
+ * Only advice for an uncompressed write of the DataVIO's own allocation is
+ * stamped, since only then is the generation known to date from before the
+ * data was written.
+ *
+ * @param dataVIO  The write DataVIO that is ready to update Albireo
+ *
+ * @return the free generation of the new advice, or 0 if it is unknown
+ **/
+static inline uint64_t getDataVIONewAdviceGeneration(const DataVIO *dataVIO)
+{
+  const AllocatingVIO *allocatingVIO = &dataVIO->allocatingVIO;
+  if ((dataVIO->newMapped.state != MAPPING_STATE_UNCOMPRESSED)
+      || (dataVIO->newMapped.pbn == ZERO_BLOCK)
+      || (dataVIO->newMapped.pbn != allocatingVIO->allocation)) {
+    return 0;
+  }
+  return allocatingVIO->allocationGeneration;
+}
+
 /**
  * Get the VDO from a DataVIO.
  *
@@ -473,6 +551,26 @@ void completeDataVIO(VDOCompletion *completion);
  **/
 void finishDataVIO(DataVIO *dataVIO, int result);
 
+/**
+ * Record that a DataVIO is starting an asynchronous operation. If the DataVIO
+ * is a write, the time since its previous operation started is charged to
+ * the write stage of that operation.
+ *
+ * @param dataVIO    The DataVIO
+ * @param operation  The operation being started
+ **/
+void setDataVIOOperation(DataVIO *dataVIO, AsyncOperationNumber operation);
+
+/**
+ * Get the name of a write stage.
+ *
+ * @param stage  The stage
+ *
+ * @return The name of the stage
+ **/
+const char *getWriteStageName(WriteStage stage)
+  __attribute__((warn_unused_result));
+
 /**
  * Continue processing a DataVIO that has been waiting for an event, setting
  * the result from the event and calling the current callback.
@@ -838,6 +936,36 @@ static inline void launchJournalCallback(DataVIO       *dataVIO,
   invokeCallback(dataVIOAsCompletion(dataVIO));
 }
 
+/**
+ * Get the number of the packer zone which handles a DataVIO. Fragments are
+ * routed by hash zone. A DataVIO which is on its way to remove a lock holder
+ * from the packer is routed to the lock holder's zone.
+ *
+ * @param dataVIO  The DataVIO in question
+ *
+ * @return The number of the packer zone for the DataVIO
+ **/
+static inline ZoneCount getPackerZoneNumber(DataVIO *dataVIO)
+{
+  DataVIO *packed = ((dataVIO->compression.lockHolder != NULL)
+                     ? dataVIO->compression.lockHolder : dataVIO);
+  return getPackerZoneForHashZone(getThreadConfigFromDataVIO(dataVIO),
+                                  getHashZoneNumber(packed->hashZone));
+}
+
+/**
+ * Get the thread of the packer zone which handles a DataVIO.
+ *
+ * @param dataVIO  The DataVIO in question
+ *
+ * @return The packer thread for the DataVIO
+ **/
+static inline ThreadID getPackerThreadForDataVIO(DataVIO *dataVIO)
+{
+  return getPackerZoneThread(getThreadConfigFromDataVIO(dataVIO),
+                             getPackerZoneNumber(dataVIO));
+}
+
 /**
  * Check that a DataVIO is running on the packer thread
  *
@@ -845,7 +973,7 @@ static inline void launchJournalCallback(DataVIO       *dataVIO,
  **/
 static inline void assertInPackerZone(DataVIO *dataVIO)
 {
-  ThreadID expected = getPackerZoneThread(getThreadConfigFromDataVIO(dataVIO));
+  ThreadID expected = getPackerThreadForDataVIO(dataVIO);
   ThreadID threadID = getCallbackThreadID();
   ASSERT_LOG_ONLY((expected == threadID),
                   "DataVIO for logical block %" PRIu64
@@ -865,7 +993,7 @@ static inline void setPackerCallback(DataVIO       *dataVIO,
                                      TraceLocation  location)
 {
   setCallback(dataVIOAsCompletion(dataVIO), callback,
-              getPackerZoneThread(getThreadConfigFromDataVIO(dataVIO)));
+              getPackerThreadForDataVIO(dataVIO));
   dataVIOAddTraceRecord(dataVIO, location);
 }
 
@@ -889,10 +1017,13 @@ static inline void launchPackerCallback(DataVIO       *dataVIO,
  * and if it is, accept it as the location of a potential duplicate of the
  * DataVIO.
  *
- * @param dataVIO  The DataVIO that queried Albireo
- * @param advice   A potential location of the data, or NULL for no advice
+ * @param dataVIO     The DataVIO that queried Albireo
+ * @param advice      A potential location of the data, or NULL for no advice
+ * @param generation  The free generation the advice was stamped with, or 0
  **/
-void receiveDedupeAdvice(DataVIO *dataVIO, const DataLocation *advice);
+void receiveDedupeAdvice(DataVIO            *dataVIO,
+                         const DataLocation *advice,
+                         uint64_t            generation);
 
 /**
  * Set the location of the duplicate block for a DataVIO, updating the
@@ -28,8 +28,10 @@
 #include "types.h"
 
 struct dirtyLists {
-  /** The number of periods after which an element will be expired */
+  /** The number of periods for which there are lists */
   BlockCount      maximumAge;
+  /** The number of periods after which an element will be expired */
+  BlockCount      currentAge;
   /** The oldest period which has unexpired elements */
   SequenceNumber  oldestPeriod;
   /** One more than the current period */
@@ -60,6 +62,7 @@ int makeDirtyLists(BlockCount      maximumAge,
   }
 
   dirtyLists->maximumAge = maximumAge;
+  dirtyLists->currentAge = maximumAge;
   dirtyLists->callback   = callback;
   dirtyLists->context    = context;
 
@@ -120,8 +123,8 @@ static void expireOldestList(DirtyLists *dirtyLists)
 static void updatePeriod(DirtyLists *dirtyLists, SequenceNumber period)
 {
   while (dirtyLists->nextPeriod <= period) {
-    if ((dirtyLists->nextPeriod - dirtyLists->oldestPeriod)
-        == dirtyLists->maximumAge) {
+    while ((dirtyLists->nextPeriod - dirtyLists->oldestPeriod)
+           >= dirtyLists->currentAge) {
       expireOldestList(dirtyLists);
     }
     dirtyLists->nextPeriod++;
@@ -172,6 +175,22 @@ void advancePeriod(DirtyLists *dirtyLists, SequenceNumber period)
   writeExpiredElements(dirtyLists);
 }
 
+/**********************************************************************/
+void setDirtyListsAge(DirtyLists *dirtyLists, BlockCount age)
+{
+  if (age > dirtyLists->maximumAge) {
+    age = dirtyLists->maximumAge;
+  } else if (age == 0) {
+    age = 1;
+  }
+
+  dirtyLists->currentAge = age;
+  while ((dirtyLists->nextPeriod - dirtyLists->oldestPeriod) > age) {
+    expireOldestList(dirtyLists);
+  }
+  writeExpiredElements(dirtyLists);
+}
+
 /**********************************************************************/
 void flushDirtyLists(DirtyLists *dirtyLists)
 {
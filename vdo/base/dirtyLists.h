@@ -100,6 +100,17 @@ void addToDirtyLists(DirtyLists     *dirtyLists,
  **/
 void advancePeriod(DirtyLists *dirtyLists, SequenceNumber period);
 
+/**
+ * Change the age at which elements are expired, immediately expiring any
+ * which are older than the new age. The age can never exceed the maximum
+ * age the lists were made with.
+ *
+ * @param dirtyLists  The DirtyLists
+ * @param age         The new age, which is clamped to between 1 and the
+ *                    maximum age
+ **/
+void setDirtyListsAge(DirtyLists *dirtyLists, BlockCount age);
+
 /**
  * Flush all dirty lists. This will cause the period to be advanced past the
  * current period.
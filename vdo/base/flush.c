@@ -48,6 +48,8 @@ struct flusher {
   SequenceNumber  notifyGeneration;
   /** The logical zone to notify next */
   LogicalZone    *logicalZoneToNotify;
+  /** The packer zone to notify next */
+  ZoneCount       packerZoneToNotify;
   /** The ID of the thread on which flush requests should be made */
   ThreadID        threadID;
 };
@@ -88,7 +90,7 @@ int makeFlusher(VDO *vdo)
   }
 
   vdo->flusher->vdo      = vdo;
-  vdo->flusher->threadID = getPackerZoneThread(getThreadConfig(vdo));
+  vdo->flusher->threadID = getPackerZoneThread(getThreadConfig(vdo), 0);
   return initializeEnqueueableCompletion(&vdo->flusher->completion,
                                          FLUSH_NOTIFICATION_COMPLETION,
                                          vdo->layer);
@@ -146,16 +148,26 @@ static void finishNotification(VDOCompletion *completion)
 }
 
 /**
- * Flush the packer now that all of the logical and physical zones have been
- * notified of the new flush request. This callback is registered in
- * incrementGeneration().
+ * Flush a packer now that all of the logical and physical zones have been
+ * notified of the new flush request. If there are more packer zones, go on to
+ * the next one, otherwise, finish the notification. This callback is
+ * registered both in incrementGeneration() and in itself.
  *
  * @param completion  The flusher completion
  **/
 static void flushPackerCallback(VDOCompletion *completion)
 {
-  Flusher *flusher = asFlusher(completion);
-  incrementPackerFlushGeneration(flusher->vdo->packer);
+  Flusher     *flusher = asFlusher(completion);
+  PackerZones *zones   = flusher->vdo->packerZones;
+  incrementPackerFlushGeneration(getPackerZone(zones,
+                                               flusher->packerZoneToNotify));
+  if (++flusher->packerZoneToNotify < getPackerZoneCount(zones)) {
+    launchCallback(completion, flushPackerCallback,
+                   getPackerZoneThread(getThreadConfig(flusher->vdo),
+                                       flusher->packerZoneToNotify));
+    return;
+  }
+
   launchCallback(completion, finishNotification, flusher->threadID);
 }
 
@@ -192,6 +204,7 @@ static void notifyFlush(Flusher *flusher)
   VDOFlush *flush = waiterAsFlush(getFirstWaiter(&flusher->notifiers));
   flusher->notifyGeneration    = flush->flushGeneration;
   flusher->logicalZoneToNotify = getLogicalZone(flusher->vdo->logicalZones, 0);
+  flusher->packerZoneToNotify  = 0;
   flusher->completion.requeue  = true;
   launchCallback(&flusher->completion, incrementGeneration,
                  getLogicalZoneThreadID(flusher->logicalZoneToNotify));
@@ -23,6 +23,7 @@
 
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "numeric.h"
 
 #include "blockMap.h"
 #include "blockMapInternals.h"
@@ -33,12 +34,14 @@
 #include "dataVIO.h"
 #include "dirtyLists.h"
 #include "forest.h"
+#include "heap.h"
 #include "numUtils.h"
 #include "recoveryJournal.h"
 #include "slabDepot.h"
 #include "slabJournal.h"
 #include "types.h"
 #include "vdoInternal.h"
+#include "vio.h"
 #include "vioPool.h"
 
 enum {
@@ -53,33 +56,50 @@ struct forest {
   BlockMapTree   trees[];
 };
 
+/** A tree page waiting to be read in by a traversal */
 typedef struct {
-  PageNumber pageIndex;
-  SlotNumber slot;
-} CursorLevel;
+  PhysicalBlockNumber pbn;
+  PageNumber          pageIndex;
+  RootCount           root;
+  Height              height;
+} TraversalRead;
 
-typedef struct cursors Cursors;
+typedef struct traversal Traversal;
 
+/** A reader of pages for a traversal; each one holds a VIO throughout */
 typedef struct {
-  Waiter        waiter;
-  BlockMapTree *tree;
-  Height        height;
-  Cursors      *parent;
-  Boundary      boundary;
-  CursorLevel   levels[BLOCK_MAP_TREE_HEIGHT];
-  VIOPoolEntry *vioPoolEntry;
-} Cursor;
-
-struct cursors {
+  Waiter         waiter;
+  Traversal     *traversal;
+  VIOPoolEntry  *vioPoolEntry;
+  TraversalRead *read;
+} TraversalLoader;
+
+struct traversal {
   BlockMap         *map;
   BlockMapTreeZone *zone;
   VIOPool          *pool;
   EntryCallback    *entryCallback;
   VDOCompletion    *parent;
-  RootCount         activeRoots;
-  Cursor            cursors[];
+  /** The pages to read, one level after another */
+  TraversalRead    *reads;
+  /** The number of pages queued to be read */
+  PageCount         readCount;
+  /** The next page to read in the level being read */
+  PageCount         nextRead;
+  /** The end of the level being read */
+  PageCount         levelEnd;
+  /** Whether the loaders are being started on a level */
+  bool              launching;
+  /** The number of loaders which have not run out of pages in the level */
+  size_t            activeLoaders;
+  size_t            loaderCount;
+  TraversalLoader  *loaders;
+  Boundary          boundaries[];
 };
 
+/** The number of tree page reads a traversal may have outstanding */
+static unsigned int traversalReadDepth = DEFAULT_TRAVERSAL_READ_DEPTH;
+
 /**********************************************************************/
 BlockMapTree *getTreeFromForest(Forest *forest, RootCount index)
 {
@@ -316,151 +336,270 @@ void replaceForest(BlockMap *map)
   map->nextEntryCount = 0;
 }
 
+/**********************************************************************/
+void setForestTraversalReadDepth(unsigned int depth)
+{
+  traversalReadDepth = depth;
+}
+
+/**********************************************************************/
+unsigned int getForestTraversalReadDepth(void)
+{
+  return traversalReadDepth;
+}
+
 /**
- * Finish the traversal of a single tree. If it was the last cursor, finish
- * the traversal.
+ * Process the entries of a tree page which is in memory, erasing the bad
+ * ones and queueing the pages below it to be read.
  *
- * @param cursor  The cursor doing the traversal
+ * @param traversal  The traversal
+ * @param root       The root of the tree holding the page
+ * @param height     The height of the page
+ * @param pageIndex  The index of the page in its level of the tree
  **/
-static void finishCursor(Cursor *cursor)
+static void traversePage(Traversal  *traversal,
+                         RootCount   root,
+                         Height      height,
+                         PageNumber  pageIndex)
 {
-  Cursors *cursors = cursor->parent;
-  returnVIOToPool(cursors->pool, cursor->vioPoolEntry);
-  if (--cursors->activeRoots > 0) {
+  BlockMapTree *tree     = &traversal->map->forest->trees[root];
+  TreePage     *treePage = &(tree->segments[0].levels[height][pageIndex]);
+  BlockMapPage *page     = (BlockMapPage *) treePage->pageBuffer;
+  if (!isBlockMapPageInitialized(page)) {
     return;
   }
 
-  VDOCompletion *parent = cursors->parent;
-  FREE(cursors);
+  PageNumber boundary = traversal->boundaries[root].levels[height];
+  for (SlotNumber slot = 0; slot < BLOCK_MAP_ENTRIES_PER_PAGE; slot++) {
+    DataLocation location = unpackBlockMapEntry(&page->entries[slot]);
+    if (!isValidLocation(&location)) {
+      // This entry is invalid, so remove it from the page.
+      page->entries[slot] = packPBN(ZERO_BLOCK, MAPPING_STATE_UNMAPPED);
+      writeTreePage(treePage, traversal->zone);
+      continue;
+    }
+
+    if (!isMappedLocation(&location)) {
+      continue;
+    }
+
+    PageNumber entryIndex = (BLOCK_MAP_ENTRIES_PER_PAGE * pageIndex) + slot;
+
+    // Erase mapped entries past the end of the logical space.
+    if (entryIndex >= boundary) {
+      page->entries[slot] = packPBN(ZERO_BLOCK, MAPPING_STATE_UNMAPPED);
+      writeTreePage(treePage, traversal->zone);
+      continue;
+    }
+
+    if (height < BLOCK_MAP_TREE_HEIGHT - 1) {
+      int result = traversal->entryCallback(location.pbn, traversal->parent);
+      if (result != VDO_SUCCESS) {
+        page->entries[slot] = packPBN(ZERO_BLOCK, MAPPING_STATE_UNMAPPED);
+        writeTreePage(treePage, traversal->zone);
+        continue;
+      }
+    }
+
+    if (height == 0) {
+      continue;
+    }
+
+    traversal->reads[traversal->readCount++] = (TraversalRead) {
+      .pbn       = location.pbn,
+      .pageIndex = entryIndex,
+      .root      = root,
+      .height    = height - 1,
+    };
+    relaxedAdd64(&traversal->map->traversalPagesQueued, 1);
+  }
+}
+
+/**
+ * Free a traversal and notify its parent that it is done.
+ *
+ * @param traversal  The traversal, all of whose loaders are idle
+ **/
+static void finishTraversal(Traversal *traversal)
+{
+  for (size_t i = 0; i < traversal->loaderCount; i++) {
+    returnVIOToPool(traversal->pool, traversal->loaders[i].vioPoolEntry);
+  }
+
+  VDOCompletion *parent = traversal->parent;
+  freeVIOPool(&traversal->pool);
+  FREE(traversal->loaders);
+  FREE(traversal->reads);
+  FREE(traversal);
 
   finishCompletion(parent, VDO_SUCCESS);
 }
 
 /**********************************************************************/
-static void traverse(Cursor *cursor);
+static void startNextLevel(Traversal *traversal);
+
+/**********************************************************************/
+static void loadNextPage(TraversalLoader *loader);
 
 /**
- * Continue traversing a block map tree.
+ * Continue a traversal after a page failed to load. The page is left
+ * uninitialized so nothing below it will be traversed.
  *
- * @param completion  The VIO doing a read or write
+ * @param completion  The VIO doing the read
  **/
 static void continueTraversal(VDOCompletion *completion)
 {
   VIOPoolEntry *poolEntry = completion->parent;
-  Cursor       *cursor    = poolEntry->parent;
-  traverse(cursor);
+  loadNextPage(poolEntry->parent);
 }
 
 /**
- * Continue traversing a block map tree now that a page has been loaded.
+ * Traverse a tree page now that it has been loaded, then go on to the next
+ * one.
  *
  * @param completion  The VIO doing the read
  **/
 static void finishTraversalLoad(VDOCompletion *completion)
 {
-  VIOPoolEntry *entry  = completion->parent;
-  Cursor       *cursor = entry->parent;
-  Height        height = cursor->height;
-  CursorLevel  *level  = &cursor->levels[height];
+  VIOPoolEntry    *entry     = completion->parent;
+  TraversalLoader *loader    = entry->parent;
+  Traversal       *traversal = loader->traversal;
+  TraversalRead   *read      = loader->read;
 
+  BlockMapTree *tree     = &traversal->map->forest->trees[read->root];
   TreePage     *treePage
-    = &(cursor->tree->segments[0].levels[height][level->pageIndex]);
-  BlockMapPage *page = (BlockMapPage *) treePage->pageBuffer;
-  copyValidPage(entry->buffer, cursor->parent->map->nonce,
-                entry->vio->physical, page);
-  traverse(cursor);
+    = &(tree->segments[0].levels[read->height][read->pageIndex]);
+  copyValidPage(entry->buffer, traversal->map->nonce, entry->vio->physical,
+                (BlockMapPage *) treePage->pageBuffer);
+  relaxedAdd64(&traversal->map->traversalPagesLoaded, 1);
+
+  traversePage(traversal, read->root, read->height, read->pageIndex);
+  loadNextPage(loader);
 }
 
 /**
- * Traverse a single block map tree. This is the recursive heart of the
- * traversal process.
+ * Read the next page of the level being read, or note that the loader has
+ * run out of pages in the level.
  *
- * @param cursor  The cursor doing the traversal
+ * @param loader  The loader, which holds a VIO
  **/
-static void traverse(Cursor *cursor)
+static void loadNextPage(TraversalLoader *loader)
 {
-  for (; cursor->height < BLOCK_MAP_TREE_HEIGHT; cursor->height++) {
-    Height       height = cursor->height;
-    CursorLevel *level  = &cursor->levels[height];
-    TreePage *treePage
-      = &(cursor->tree->segments[0].levels[height][level->pageIndex]);
-    BlockMapPage *page = (BlockMapPage *) treePage->pageBuffer;
-    if (!isBlockMapPageInitialized(page)) {
-      continue;
+  Traversal *traversal = loader->traversal;
+  if (traversal->nextRead == traversal->levelEnd) {
+    if ((--traversal->activeLoaders == 0) && !traversal->launching) {
+      startNextLevel(traversal);
     }
+    return;
+  }
 
-    for (; level->slot < BLOCK_MAP_ENTRIES_PER_PAGE; level->slot++) {
-      DataLocation location = unpackBlockMapEntry(&page->entries[level->slot]);
-      if (!isValidLocation(&location)) {
-        // This entry is invalid, so remove it from the page.
-        page->entries[level->slot]
-          = packPBN(ZERO_BLOCK, MAPPING_STATE_UNMAPPED);
-        writeTreePage(treePage, cursor->parent->zone);
-        continue;
-      }
-
-      if (!isMappedLocation(&location)) {
-        continue;
-      }
+  loader->read = &traversal->reads[traversal->nextRead++];
+  launchReadMetadataVIO(loader->vioPoolEntry->vio, loader->read->pbn,
+                        finishTraversalLoad, continueTraversal);
+}
 
-      PageNumber entryIndex
-        = (BLOCK_MAP_ENTRIES_PER_PAGE * level->pageIndex) + level->slot;
+/**
+ * Start a loader now that it has a VIO with which to load pages.
+ *
+ * <p>Implements WaiterCallback.
+ *
+ * @param waiter   The loader
+ * @param context  The VIOPoolEntry just acquired
+ **/
+static void launchLoader(Waiter *waiter, void *context)
+{
+  STATIC_ASSERT(offsetof(TraversalLoader, waiter) == 0);
+  TraversalLoader *loader      = (TraversalLoader *) waiter;
+  loader->vioPoolEntry         = (VIOPoolEntry *) context;
+  loader->vioPoolEntry->parent = loader;
+  vioAsCompletion(loader->vioPoolEntry->vio)->callbackThreadID
+    = loader->traversal->zone->mapZone->threadID;
+  loadNextPage(loader);
+}
 
-      // Erase mapped entries past the end of the logical space.
-      if (entryIndex >= cursor->boundary.levels[height]) {
-        page->entries[level->slot]
-          = packPBN(ZERO_BLOCK, MAPPING_STATE_UNMAPPED);
-        writeTreePage(treePage, cursor->parent->zone);
-        continue;
-      }
+/**
+ * Compare the PBNs of two pages to be read.
+ *
+ * <p>Implements HeapComparator.
+ **/
+static int compareTraversalReads(const void *item1, const void *item2)
+{
+  const TraversalRead *read1 = item1;
+  const TraversalRead *read2 = item2;
+  if (read1->pbn == read2->pbn) {
+    return 0;
+  }
+  return ((read1->pbn < read2->pbn) ? -1 : 1);
+}
 
-      if (cursor->height < BLOCK_MAP_TREE_HEIGHT - 1) {
-        int result = cursor->parent->entryCallback(location.pbn,
-                                                   cursor->parent->parent);
-        if (result != VDO_SUCCESS) {
-          page->entries[level->slot]
-            = packPBN(ZERO_BLOCK, MAPPING_STATE_UNMAPPED);
-          writeTreePage(treePage, cursor->parent->zone);
-          continue;
-        }
-      }
+/**
+ * Swap two pages to be read.
+ *
+ * <p>Implements HeapSwapper.
+ **/
+static void swapTraversalReads(void *item1, void *item2)
+{
+  TraversalRead *read1 = item1;
+  TraversalRead *read2 = item2;
+  TraversalRead  temp  = *read1;
+  *read1 = *read2;
+  *read2 = temp;
+}
 
-      if (cursor->height == 0) {
-        continue;
-      }
+/**
+ * Start reading the pages queued by the level just traversed, in PBN order
+ * so that the reads sweep across the storage, or finish the traversal if
+ * there are none. All the loaders must be idle.
+ *
+ * @param traversal  The traversal
+ **/
+static void startNextLevel(Traversal *traversal)
+{
+  PageCount levelStart = traversal->levelEnd;
+  traversal->levelEnd  = traversal->readCount;
+  if (levelStart == traversal->levelEnd) {
+    finishTraversal(traversal);
+    return;
+  }
 
-      cursor->height--;
-      CursorLevel *nextLevel = &cursor->levels[cursor->height];
-      nextLevel->pageIndex   = entryIndex;
-      nextLevel->slot        = 0;
-      level->slot++;
-      launchReadMetadataVIO(cursor->vioPoolEntry->vio, location.pbn,
-                            finishTraversalLoad, continueTraversal);
-      return;
+  Heap heap;
+  initializeHeap(&heap, compareTraversalReads, swapTraversalReads,
+                 &traversal->reads[levelStart],
+                 traversal->levelEnd - levelStart, sizeof(TraversalRead));
+  buildHeap(&heap, traversal->levelEnd - levelStart);
+  sortHeap(&heap);
+
+  // Don't start the next level until every loader has started on this one.
+  traversal->launching     = true;
+  traversal->activeLoaders = traversal->loaderCount;
+  for (size_t i = 0; i < traversal->loaderCount; i++) {
+    TraversalLoader *loader = &traversal->loaders[i];
+    if (loader->vioPoolEntry == NULL) {
+      acquireVIOFromPool(traversal->pool, &loader->waiter);
+    } else {
+      loadNextPage(loader);
     }
   }
+  traversal->launching = false;
 
-  finishCursor(cursor);
+  if (traversal->activeLoaders == 0) {
+    startNextLevel(traversal);
+  }
 }
 
 /**
- * Start traversing a single block map tree now that the Cursor has a VIO with
- * which to load pages.
- *
- * <p>Implements WaiterCallback.
+ * Construct a VIO for a traversal's pool.
  *
- * @param waiter   The Cursor
- * @param context  The VIOPoolEntry just acquired
+ * <p>Implements VIOConstructor.
  **/
-static void launchCursor(Waiter *waiter, void *context)
+__attribute__((warn_unused_result))
+static int makeTraversalVIO(PhysicalLayer  *layer,
+                            void           *parent,
+                            void           *buffer,
+                            VIO           **vioPtr)
 {
-  STATIC_ASSERT(offsetof(Cursor, waiter) == 0);
-  Cursor *cursor               = (Cursor *) waiter;
-  cursor->vioPoolEntry         = (VIOPoolEntry *) context;
-  cursor->vioPoolEntry->parent = cursor;
-  vioAsCompletion(cursor->vioPoolEntry->vio)->callbackThreadID
-    = cursor->parent->zone->mapZone->threadID;
-  traverse(cursor);
+  return createVIO(layer, VIO_TYPE_BLOCK_MAP_INTERIOR, VIO_PRIORITY_METADATA,
+                   parent, buffer, vioPtr);
 }
 
 /**
@@ -512,32 +651,62 @@ void traverseForest(BlockMap      *map,
     return;
   }
 
-  Cursors *cursors;
-  int result = ALLOCATE_EXTENDED(Cursors, map->rootCount, Cursor, __func__,
-                                 &cursors);
+  Traversal *traversal;
+  int result = ALLOCATE_EXTENDED(Traversal, map->rootCount, Boundary,
+                                 __func__, &traversal);
   if (result != VDO_SUCCESS) {
     finishCompletion(parent, result);
     return;
   }
 
-  cursors->map           = map;
-  cursors->zone          = &(getBlockMapZone(map, 0)->treeZone);
-  cursors->pool          = cursors->zone->vioPool;
-  cursors->entryCallback = entryCallback;
-  cursors->parent        = parent;
-  cursors->activeRoots   = map->rootCount;
+  // Every tree page below the roots may need to be read.
+  PageCount treePages = 0;
   for (RootCount root = 0; root < map->rootCount; root++) {
-    Cursor *cursor = &cursors->cursors[root];
-    *cursor = (Cursor) {
-      .tree     = &map->forest->trees[root],
-      .height   = BLOCK_MAP_TREE_HEIGHT - 1,
-      .parent   = cursors,
-      .boundary = computeBoundary(map, root),
+    traversal->boundaries[root] = computeBoundary(map, root);
+    for (Height height = 0; height < BLOCK_MAP_TREE_HEIGHT - 1; height++) {
+      treePages += traversal->boundaries[root].levels[height];
+    }
+  }
+
+  traversal->map           = map;
+  traversal->zone          = &(getBlockMapZone(map, 0)->treeZone);
+  traversal->entryCallback = entryCallback;
+  traversal->parent        = parent;
+  traversal->loaderCount   = minSizeT(traversalReadDepth, treePages);
+  result = ALLOCATE(treePages, TraversalRead, "traversal reads",
+                    &traversal->reads);
+  if (result == VDO_SUCCESS) {
+    result = ALLOCATE(traversal->loaderCount, TraversalLoader,
+                      "traversal loaders", &traversal->loaders);
+  }
+  if (result == VDO_SUCCESS) {
+    result = makeVIOPool(parent->layer, traversal->loaderCount,
+                         traversal->zone->mapZone->threadID, makeTraversalVIO,
+                         NULL, &traversal->pool);
+  }
+  if (result != VDO_SUCCESS) {
+    FREE(traversal->loaders);
+    FREE(traversal->reads);
+    FREE(traversal);
+    finishCompletion(parent, result);
+    return;
+  }
+
+  for (size_t i = 0; i < traversal->loaderCount; i++) {
+    traversal->loaders[i] = (TraversalLoader) {
+      .waiter    = { .callback = launchLoader, },
+      .traversal = traversal,
     };
+  }
 
-    cursor->waiter.callback = launchCursor;
-    acquireVIOFromPool(cursors->pool, &cursor->waiter);
-  };
+  // The roots are always in memory, so the whole forest can be traversed
+  // one level at a time, reading each level with many VIOs at once.
+  atomicStore64(&map->traversalPagesQueued, 0);
+  atomicStore64(&map->traversalPagesLoaded, 0);
+  for (RootCount root = 0; root < map->rootCount; root++) {
+    traversePage(traversal, root, BLOCK_MAP_TREE_HEIGHT - 1, 0);
+  }
+  startNextLevel(traversal);
 }
 
 /**********************************************************************/
@@ -35,6 +35,13 @@
  **/
 typedef int EntryCallback(PhysicalBlockNumber pbn, VDOCompletion *completion);
 
+enum {
+  /** The default number of tree page reads a forest traversal may issue */
+  DEFAULT_TRAVERSAL_READ_DEPTH = 256,
+  /** The most tree page reads a forest traversal may be allowed to issue */
+  MAXIMUM_TRAVERSAL_READ_DEPTH = 4096,
+};
+
 /**
  * Get a tree from the forest.
  *
@@ -97,7 +104,25 @@ void abandonForest(BlockMap *map);
 void replaceForest(BlockMap *map);
 
 /**
- * Walk the entire forest of a block map.
+ * Set the number of tree page reads which forest traversals started from now
+ * on may have outstanding at once.
+ *
+ * @param depth  The number of reads, from 1 to MAXIMUM_TRAVERSAL_READ_DEPTH
+ **/
+void setForestTraversalReadDepth(unsigned int depth);
+
+/**
+ * Get the number of tree page reads a forest traversal may have outstanding.
+ *
+ * @return The read depth
+ **/
+unsigned int getForestTraversalReadDepth(void)
+  __attribute__((warn_unused_result));
+
+/**
+ * Walk the entire forest of a block map. The trees are walked together one
+ * level at a time, and the pages of each level are read in PBN order.
+ * Progress is recorded in the block map's traversal statistics.
  *
  * @param map            The block map to traverse
  * @param entryCallback  A function to call with the pbn of each allocated node
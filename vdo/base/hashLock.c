@@ -123,6 +123,10 @@
 #include "vioWrite.h"
 #include "waitQueue.h"
 
+#ifdef __KERNEL__
+#include "vdoTrace.h"
+#endif
+
 static const char *LOCK_STATE_NAMES[] = {
   [HASH_LOCK_BYPASSING]    = "BYPASSING",
   [HASH_LOCK_DEDUPING]     = "DEDUPING",
@@ -168,11 +172,9 @@ const char *getHashLockStateName(HashLockState state)
  **/
 static void setHashLockState(HashLock *lock, HashLockState newState)
 {
-  if (false) {
-    logWarning("XXX %" PRIptr " %s -> %s", (void *) lock,
-               getHashLockStateName(lock->state),
-               getHashLockStateName(newState));
-  }
+#ifdef __KERNEL__
+  trace_vdo_hash_lock_state(lock, lock->state, newState);
+#endif
   lock->state = newState;
 }
 
@@ -659,7 +661,7 @@ static void startUpdating(HashLock *lock, DataVIO *agent)
   ASSERT_LOG_ONLY(lock->verified, "new advice should have been verified");
   ASSERT_LOG_ONLY(lock->updateAdvice, "should only update advice if needed");
 
-  agent->lastAsyncOperation = UPDATE_INDEX;
+  setDataVIOOperation(agent, UPDATE_INDEX);
   setHashZoneCallback(agent, finishUpdating, THIS_LOCATION(NULL));
   dataVIOAsCompletion(agent)->layer->updateAlbireo(agent);
 }
@@ -859,6 +861,14 @@ static void finishVerifying(VDOCompletion *completion)
 
   lock->verified = agent->isDuplicate;
 
+  // Remember verified advice so that later writes of the same data can skip
+  // the index query, and forget advice which has gone stale.
+  if (lock->verified) {
+    cacheHashZoneAdvice(agent->hashZone, &lock->hash, lock->duplicate);
+  } else {
+    invalidateHashZoneAdvice(agent->hashZone, &lock->hash);
+  }
+
   // Only count the result of the initial verification of the advice as valid
   // or stale, and not any re-verifications due to PBN lock releases.
   if (!lock->verifyCounted) {
@@ -912,6 +922,13 @@ static void startVerifying(HashLock *lock, DataVIO *agent)
   setHashLockState(lock, HASH_LOCK_VERIFYING);
   ASSERT_LOG_ONLY(!lock->verified, "hash lock only verifies advice once");
 
+  if (agent->duplicateIsFresh) {
+    // The advice can be trusted as is, so finish verifying without reading.
+    bumpHashZoneTrustedAdviceCount(agent->hashZone);
+    finishVerifying(dataVIOAsCompletion(agent));
+    return;
+  }
+
   /*
    * XXX VDOSTORY-190 Optimization: This is one of those places where the zone
    * and continuation we want to use depends on the outcome of the comparison.
@@ -920,7 +937,7 @@ static void startVerifying(HashLock *lock, DataVIO *agent)
    * willing to delay visibility of the the hash lock state change).
    */
   VDOCompletion *completion = dataVIOAsCompletion(agent);
-  agent->lastAsyncOperation = VERIFY_DEDUPLICATION;
+  setDataVIOOperation(agent, VERIFY_DEDUPLICATION);
   setHashZoneCallback(agent, finishVerifying, THIS_LOCATION(NULL));
   completion->layer->verifyDuplication(agent);
 }
@@ -955,6 +972,7 @@ static void finishLocking(VDOCompletion *completion)
      * remembering to update UDS later with the new advice.
      */
     bumpHashZoneStaleAdviceCount(agent->hashZone);
+    invalidateHashZoneAdvice(agent->hashZone, &lock->hash);
     lock->updateAdvice = true;
     startWriting(lock, agent);
     return;
@@ -1098,6 +1116,16 @@ static void lockDuplicatePBN(VDOCompletion *completion)
     lock->incrementLimit = incrementLimit;
   }
 
+  // Advice stamped with the free generation its reference block still has
+  // is for a block which can't have been freed, and so reused, since it was
+  // written. Since the advice is only stamped if the chunk name is strong,
+  // the block need not be read back to verify it.
+  agent->duplicateIsFresh
+    = ((agent->duplicateGeneration != 0)
+       && !isCompressed(agent->duplicate.state)
+       && (agent->duplicateGeneration
+           == getPBNFreeGeneration(depot, agent->duplicate.pbn)));
+
   // We've successfully acquired a read lock on behalf of the hash lock,
   // so mark it as such.
   setDuplicateLock(agent->hashLock, lock);
@@ -1130,7 +1158,7 @@ static void startLocking(HashLock *lock, DataVIO *agent)
    * states (or use an agent-local state, or an atomic), we can avoid a thread
    * transition here.
    */
-  agent->lastAsyncOperation = ACQUIRE_PBN_READ_LOCK;
+  setDataVIOOperation(agent, ACQUIRE_PBN_READ_LOCK);
   launchDuplicateZoneCallback(agent, lockDuplicatePBN, THIS_LOCATION(NULL));
 }
 
@@ -1155,9 +1183,11 @@ static void finishWriting(HashLock *lock, DataVIO *agent)
   lock->duplicate = agent->newMapped;
   lock->verified  = true;
 
-  if (isCompressed(lock->duplicate.state) && lock->registered) {
+  if (isCompressed(lock->duplicate.state) && lock->registered
+      && ((agent->policy & LBN_POLICY_DEDUPE) != 0)) {
     // Compression means the location we gave in the UDS query is not the
-    // location we're using to deduplicate.
+    // location we're using to deduplicate. (There was no query if the
+    // block may not be deduplicated.)
     lock->updateAdvice = true;
   }
 
@@ -1330,8 +1360,12 @@ static void finishQuerying(VDOCompletion *completion)
     startLocking(lock, agent);
   } else {
     // The agent will be used as the duplicate if has an allocation; if it
-    // does, that location was posted to UDS, so no update will be needed.
-    lock->updateAdvice = !hasAllocation(agent);
+    // does, that location was posted to UDS, so no update will be needed
+    // unless UDS returned unusable advice, since a post keeps that record.
+    lock->updateAdvice = (agent->adviceRejected || !hasAllocation(agent));
+    if (agent->adviceRejected) {
+      bumpHashZoneStaleAdviceCount(agent->hashZone);
+    }
     /*
      * QUERYING -> WRITING transition: There was no advice or the advice
      * wasn't valid, so try to write or compress the data.
@@ -1353,8 +1387,34 @@ static void startQuerying(HashLock *lock, DataVIO *dataVIO)
   setAgent(lock, dataVIO);
   setHashLockState(lock, HASH_LOCK_QUERYING);
 
+  if ((dataVIO->policy & LBN_POLICY_DEDUPE) == 0) {
+    /*
+     * QUERYING -> WRITING transition: The block may not be deduplicated, so
+     * neither query the index nor tell it about the block; it is only here
+     * so that compression can share the lock. Writes of the same data which
+     * arrive while the lock is held may still share the block written.
+     */
+    lock->updateAdvice = false;
+    startWriting(lock, dataVIO);
+    return;
+  }
+
+  ZonedPBN advice;
+  if (getCachedHashZoneAdvice(dataVIO->hashZone, &lock->hash, &advice)) {
+    /*
+     * QUERYING -> LOCKING transition: The data was recently verified at the
+     * cached location, so skip the index query. The advice will still be
+     * verified, and a stale entry leads to an index update as usual.
+     */
+    setDuplicateLocation(dataVIO, advice);
+    lock->duplicate = advice;
+    startLocking(lock, dataVIO);
+    return;
+  }
+
   VDOCompletion *completion   = dataVIOAsCompletion(dataVIO);
-  dataVIO->lastAsyncOperation = CHECK_FOR_DEDUPLICATION;
+  dataVIO->adviceRejected      = false;
+  setDataVIOOperation(dataVIO, CHECK_FOR_DEDUPLICATION);
   setHashZoneCallback(dataVIO, finishQuerying, THIS_LOCATION(NULL));
   completion->layer->checkForDuplication(dataVIO);
 }
@@ -21,6 +21,7 @@
 
 #include "hashZone.h"
 
+#include "cpu.h"
 #include "logger.h"
 #include "memoryAlloc.h"
 #include "numeric.h"
@@ -30,7 +31,7 @@
 #include "dataVIO.h"
 #include "hashLock.h"
 #include "hashLockInternals.h"
-#include "pointerMap.h"
+#include "numUtils.h"
 #include "ringNode.h"
 #include "statistics.h"
 #include "threadConfig.h"
@@ -39,8 +40,47 @@
 
 enum {
   LOCK_POOL_CAPACITY = MAXIMUM_USER_VIOS,
+  /** The number of sets in the advice cache of each zone */
+  ADVICE_CACHE_SETS  = 256,
+  /** The number of entries in each advice cache set */
+  ADVICE_CACHE_WAYS  = 4,
+  /** The number of entries which fit in a cache line sized lock bucket */
+  LOCK_BUCKET_ENTRIES = ((CACHE_LINE_BYTES - (2 * sizeof(uint16_t)))
+                         / (sizeof(uint32_t) + sizeof(uint16_t))),
+  /** The number of lock buckets per bucket's worth of locks */
+  LOCK_BUCKETS_PER_FULL_BUCKET = 2,
 };
 
+/**
+ * A bucket of a zone's hash lock table holds as many entries as will fit in
+ * one cache line. Each entry is the hash code of a chunk name and the index
+ * of the lock for that name in the zone's lock array; full chunk names are
+ * only compared when the codes match. An entry which hashes to a full bucket
+ * is placed in the next bucket with room, and each full bucket it passes over
+ * counts it as an overflow so that a search knows to continue to the next
+ * bucket.
+ **/
+typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) {
+  /** The hash codes of the chunk names of the locks */
+  uint32_t codes[LOCK_BUCKET_ENTRIES];
+  /** The indexes of the corresponding locks in the lock array */
+  uint16_t locks[LOCK_BUCKET_ENTRIES];
+  /** The number of entries in this bucket */
+  uint16_t count;
+  /** The number of entries placed after this bucket because it was full */
+  uint16_t overflowCount;
+} HashLockBucket;
+
+/**
+ * An entry in the advice cache, recording the location of a block which was
+ * recently verified to hold the data for a chunk name. An entry is unused if
+ * its location is the zero block.
+ **/
+typedef struct {
+  UdsChunkName name;
+  ZonedPBN     advice;
+} AdviceCacheEntry;
+
 /**
  * These fields are only modified by the locks sharing the hash zone thread,
  * but are queried by other threads.
@@ -57,6 +97,15 @@ typedef struct atomicHashLockStatistics {
 
   /** Number of writes whose hash collided with an in-flight write */
   Atomic64 concurrentHashCollisions;
+
+  /** Number of queries answered by the advice cache */
+  Atomic64 adviceCacheHits;
+
+  /** Number of queries which missed the advice cache */
+  Atomic64 adviceCacheMisses;
+
+  /** Number of times unchanged UDS advice was trusted without a verify */
+  Atomic64 dedupeAdviceTrusted;
 } AtomicHashLockStatistics;
 
 struct hashZone {
@@ -66,8 +115,14 @@ struct hashZone {
   /** The thread ID for this zone */
   ThreadID threadID;
 
-  /** Mapping from chunkName fields to HashLocks */
-  PointerMap *hashLockMap;
+  /** The table mapping chunk names to registered HashLocks */
+  HashLockBucket *lockBuckets;
+
+  /** The mask which wraps a lock bucket index around the table */
+  size_t lockBucketMask;
+
+  /** The number of HashLocks registered in the table */
+  size_t registeredLocks;
 
   /** Ring containing all unused HashLocks */
   RingNode lockPool;
@@ -77,23 +132,23 @@ struct hashZone {
 
   /** Array of all HashLocks */
   HashLock *lockArray;
-};
 
-/**
- * Implements PointerKeyComparator.
- **/
-static bool compareKeys(const void *thisKey, const void *thatKey)
-{
-  // Null keys are not supported.
-  return (memcmp(thisKey, thatKey, sizeof(UdsChunkName)) == 0);
-}
+  /**
+   * Recently verified advice, so that repeated writes of hot data need not
+   * wait for the index. Each set is kept in most-recently-used order.
+   **/
+  AdviceCacheEntry *adviceCache;
+};
 
 /**
- * Implements PointerKeyComparator.
+ * Compute the hash code by which a chunk name is found in the lock table.
+ *
+ * @param name  The chunk name
+ *
+ * @return The hash code of the name
  **/
-static uint32_t hashKey(const void *key)
+static inline uint32_t hashChunkName(const UdsChunkName *name)
 {
-  const UdsChunkName *name = key;
   /*
    * Use a fragment of the chunk name as a hash code. It must not overlap with
    * fragments used elsewhere to ensure uniform distributions.
@@ -109,28 +164,148 @@ static inline HashLock *asHashLock(RingNode *poolNode)
   return (HashLock *) poolNode;
 }
 
+/**
+ * Get the lock recorded by an entry of a zone's lock table.
+ *
+ * @param zone         The hash zone
+ * @param bucketIndex  The index of the entry's bucket
+ * @param slot         The entry's slot in the bucket
+ *
+ * @return The lock
+ **/
+static inline HashLock *getLockEntry(const HashZone *zone,
+                                     size_t          bucketIndex,
+                                     unsigned int    slot)
+{
+  return &zone->lockArray[zone->lockBuckets[bucketIndex].locks[slot]];
+}
+
+/**
+ * Find the lock table entry for a chunk name. The search can not loop
+ * forever since the table is never more than half full, so some bucket can
+ * not have overflowed.
+ *
+ * @param [in]  zone       The hash zone
+ * @param [in]  name       The chunk name to find
+ * @param [out] bucketPtr  A pointer to hold the index of the entry's bucket
+ * @param [out] slotPtr    A pointer to hold the entry's slot in the bucket
+ *
+ * @return <code>true</code> if the name has an entry
+ **/
+static bool findLockEntry(const HashZone     *zone,
+                          const UdsChunkName *name,
+                          size_t             *bucketPtr,
+                          unsigned int       *slotPtr)
+{
+  uint32_t code  = hashChunkName(name);
+  size_t   index = code & zone->lockBucketMask;
+  for (;;) {
+    const HashLockBucket *bucket = &zone->lockBuckets[index];
+    for (unsigned int slot = 0; slot < bucket->count; slot++) {
+      if ((bucket->codes[slot] == code)
+          && (memcmp(&getLockEntry(zone, index, slot)->hash, name,
+                     sizeof(UdsChunkName)) == 0)) {
+        *bucketPtr = index;
+        *slotPtr   = slot;
+        return true;
+      }
+    }
+
+    if (bucket->overflowCount == 0) {
+      return false;
+    }
+    index = (index + 1) & zone->lockBucketMask;
+  }
+}
+
+/**
+ * Add a lock table entry for a lock whose chunk name does not have one.
+ *
+ * @param zone  The hash zone
+ * @param lock  The lock to add
+ **/
+static void addLockEntry(HashZone *zone, HashLock *lock)
+{
+  uint32_t        code   = hashChunkName(&lock->hash);
+  size_t          index  = code & zone->lockBucketMask;
+  HashLockBucket *bucket = &zone->lockBuckets[index];
+  while (bucket->count == LOCK_BUCKET_ENTRIES) {
+    bucket->overflowCount++;
+    index  = (index + 1) & zone->lockBucketMask;
+    bucket = &zone->lockBuckets[index];
+  }
+
+  bucket->codes[bucket->count] = code;
+  bucket->locks[bucket->count] = lock - zone->lockArray;
+  bucket->count++;
+  zone->registeredLocks++;
+}
+
+/**
+ * Remove a lock table entry, moving the last entry of its bucket into its
+ * slot and uncounting it as an overflow from the buckets it was placed after.
+ *
+ * @param zone         The hash zone
+ * @param bucketIndex  The index of the entry's bucket
+ * @param slot         The entry's slot in the bucket
+ **/
+static void removeLockEntry(HashZone     *zone,
+                            size_t        bucketIndex,
+                            unsigned int  slot)
+{
+  HashLockBucket *bucket = &zone->lockBuckets[bucketIndex];
+  uint32_t        code   = bucket->codes[slot];
+  bucket->count--;
+  bucket->codes[slot] = bucket->codes[bucket->count];
+  bucket->locks[slot] = bucket->locks[bucket->count];
+  zone->registeredLocks--;
+
+  for (size_t index = code & zone->lockBucketMask;
+       index != bucketIndex;
+       index = (index + 1) & zone->lockBucketMask) {
+    zone->lockBuckets[index].overflowCount--;
+  }
+}
+
 /**********************************************************************/
 int makeHashZone(VDO *vdo, ZoneCount zoneNumber, HashZone **zonePtr)
 {
+  const ThreadConfig *threadConfig = getThreadConfig(vdo);
+  ThreadID threadID = getHashZoneThread(threadConfig, zoneNumber);
+  int      node     = getThreadNode(threadConfig, threadID);
+
   HashZone *zone;
-  int result = ALLOCATE(1, HashZone, __func__, &zone);
+  int result = ALLOCATE_ON_NODE(1, HashZone, node, __func__, &zone);
   if (result != VDO_SUCCESS) {
     return result;
   }
 
-  result = makePointerMap(LOCK_MAP_CAPACITY, 0, compareKeys, hashKey,
-                          &zone->hashLockMap);
+  // Use a power of two number of lock buckets, at least twice as many as it
+  // would take to hold every lock.
+  STATIC_ASSERT(sizeof(HashLockBucket) == CACHE_LINE_BYTES);
+  STATIC_ASSERT(LOCK_POOL_CAPACITY <= UINT16_MAX);
+  size_t neededBuckets = (LOCK_BUCKETS_PER_FULL_BUCKET
+                          * computeBucketCount(LOCK_POOL_CAPACITY,
+                                               LOCK_BUCKET_ENTRIES));
+  size_t bucketCount = 1;
+  while (bucketCount < neededBuckets) {
+    bucketCount <<= 1;
+  }
+
+  zone->lockBucketMask = bucketCount - 1;
+  result = ALLOCATE_ON_NODE(bucketCount, HashLockBucket, node,
+                            "hash lock table", &zone->lockBuckets);
   if (result != VDO_SUCCESS) {
     freeHashZone(&zone);
     return result;
   }
 
   zone->zoneNumber = zoneNumber;
-  zone->threadID   = getHashZoneThread(getThreadConfig(vdo), zoneNumber);
+  zone->threadID   = threadID;
   initializeRing(&zone->lockPool);
 
-  result = ALLOCATE(LOCK_POOL_CAPACITY, HashLock, "HashLock array",
-                    &zone->lockArray);
+  result = ALLOCATE_ON_NODE(LOCK_POOL_CAPACITY, HashLock, node,
+                            "HashLock array", &zone->lockArray);
   if (result != VDO_SUCCESS) {
     freeHashZone(&zone);
     return result;
@@ -142,6 +317,14 @@ int makeHashZone(VDO *vdo, ZoneCount zoneNumber, HashZone **zonePtr)
     pushRingNode(&zone->lockPool, &lock->poolNode);
   }
 
+  result = ALLOCATE_ON_NODE(ADVICE_CACHE_SETS * ADVICE_CACHE_WAYS,
+                            AdviceCacheEntry, node, "advice cache",
+                            &zone->adviceCache);
+  if (result != VDO_SUCCESS) {
+    freeHashZone(&zone);
+    return result;
+  }
+
   *zonePtr = zone;
   return VDO_SUCCESS;
 }
@@ -154,8 +337,9 @@ void freeHashZone(HashZone **zonePtr)
   }
 
   HashZone *zone = *zonePtr;
-  freePointerMap(&zone->hashLockMap);
+  FREE(zone->lockBuckets);
   FREE(zone->lockArray);
+  FREE(zone->adviceCache);
   FREE(zone);
   *zonePtr = NULL;
 }
@@ -182,9 +366,118 @@ HashLockStatistics getHashZoneStatistics(const HashZone *zone)
     .concurrentDataMatches = relaxedLoad64(&atoms->concurrentDataMatches),
     .concurrentHashCollisions
       = relaxedLoad64(&atoms->concurrentHashCollisions),
+    .adviceCacheHits       = relaxedLoad64(&atoms->adviceCacheHits),
+    .adviceCacheMisses     = relaxedLoad64(&atoms->adviceCacheMisses),
+    .dedupeAdviceTrusted   = relaxedLoad64(&atoms->dedupeAdviceTrusted),
   };
 }
 
+/**
+ * Get the advice cache set which may hold an entry for a chunk name.
+ *
+ * @param zone  The hash zone
+ * @param name  The chunk name
+ *
+ * @return The first entry of the set
+ **/
+static AdviceCacheEntry *getAdviceCacheSet(HashZone           *zone,
+                                           const UdsChunkName *name)
+{
+  // Use a fragment of the chunk name which doesn't overlap with the ones
+  // used to choose the hash zone and to hash the lock map.
+  uint32_t set = getUInt32LE(&name->name[8]) % ADVICE_CACHE_SETS;
+  return &zone->adviceCache[set * ADVICE_CACHE_WAYS];
+}
+
+/**
+ * Find the entry for a chunk name in an advice cache set.
+ *
+ * @param set   The advice cache set
+ * @param name  The chunk name
+ *
+ * @return The index of the entry in the set, or ADVICE_CACHE_WAYS if the
+ *         name is not cached
+ **/
+static unsigned int findAdviceCacheEntry(const AdviceCacheEntry *set,
+                                         const UdsChunkName     *name)
+{
+  unsigned int way;
+  for (way = 0; way < ADVICE_CACHE_WAYS; way++) {
+    if ((set[way].advice.pbn != ZERO_BLOCK)
+        && (memcmp(&set[way].name, name, sizeof(UdsChunkName)) == 0)) {
+      break;
+    }
+  }
+  return way;
+}
+
+/**
+ * Move an entry of an advice cache set to the front of the set, shifting
+ * the entries ahead of it back one place.
+ *
+ * @param set    The advice cache set
+ * @param way    The index of the entry to move
+ * @param entry  The new contents of the entry
+ **/
+static void moveToFrontOfSet(AdviceCacheEntry *set,
+                             unsigned int      way,
+                             AdviceCacheEntry  entry)
+{
+  memmove(&set[1], &set[0], way * sizeof(AdviceCacheEntry));
+  set[0] = entry;
+}
+
+/**********************************************************************/
+bool getCachedHashZoneAdvice(HashZone           *zone,
+                             const UdsChunkName *name,
+                             ZonedPBN           *advicePtr)
+{
+  AdviceCacheEntry *set = getAdviceCacheSet(zone, name);
+  unsigned int      way = findAdviceCacheEntry(set, name);
+  if (way == ADVICE_CACHE_WAYS) {
+    relaxedAdd64(&zone->statistics.adviceCacheMisses, 1);
+    return false;
+  }
+
+  relaxedAdd64(&zone->statistics.adviceCacheHits, 1);
+  *advicePtr = set[way].advice;
+  moveToFrontOfSet(set, way, set[way]);
+  return true;
+}
+
+/**********************************************************************/
+void cacheHashZoneAdvice(HashZone           *zone,
+                         const UdsChunkName *name,
+                         ZonedPBN            advice)
+{
+  AdviceCacheEntry *set = getAdviceCacheSet(zone, name);
+  unsigned int      way = findAdviceCacheEntry(set, name);
+  if (way == ADVICE_CACHE_WAYS) {
+    // Evict the least recently used entry of the set.
+    way = ADVICE_CACHE_WAYS - 1;
+  }
+
+  moveToFrontOfSet(set, way, (AdviceCacheEntry) {
+      .name   = *name,
+      .advice = advice,
+    });
+}
+
+/**********************************************************************/
+void invalidateHashZoneAdvice(HashZone *zone, const UdsChunkName *name)
+{
+  AdviceCacheEntry *set = getAdviceCacheSet(zone, name);
+  unsigned int      way = findAdviceCacheEntry(set, name);
+  if (way == ADVICE_CACHE_WAYS) {
+    return;
+  }
+
+  // Close the gap so the set stays in most-recently-used order.
+  memmove(&set[way], &set[way + 1],
+          (ADVICE_CACHE_WAYS - way - 1) * sizeof(AdviceCacheEntry));
+  set[ADVICE_CACHE_WAYS - 1].advice.pbn = ZERO_BLOCK;
+}
+
 /**
  * Return a hash lock to the zone's pool and null out the reference to it.
  *
@@ -207,8 +500,16 @@ int acquireHashLockFromZone(HashZone            *zone,
                             HashLock            *replaceLock,
                             HashLock           **lockPtr)
 {
-  // Borrow and prepare a lock from the pool so we don't have to do two
-  // PointerMap accesses in the common case of no lock contention.
+  size_t       bucketIndex;
+  unsigned int slot;
+  HashLock *lock = (findLockEntry(zone, hash, &bucketIndex, &slot)
+                    ? getLockEntry(zone, bucketIndex, slot) : NULL);
+  if ((lock != NULL) && (replaceLock == NULL)) {
+    // There's already a lock for the hash, so a new lock isn't needed.
+    *lockPtr = lock;
+    return VDO_SUCCESS;
+  }
+
   HashLock *newLock = asHashLock(popRingNode(&zone->lockPool));
   int result = ASSERT(newLock != NULL,
                       "never need to wait for a free hash lock");
@@ -216,18 +517,7 @@ int acquireHashLockFromZone(HashZone            *zone,
     return result;
   }
 
-  // Fill in the hash of the new lock so we can map it, since we have to use
-  // the hash as the map key.
   newLock->hash = *hash;
-
-  HashLock *lock;
-  result = pointerMapPut(zone->hashLockMap, &newLock->hash, newLock,
-                         (replaceLock != NULL), (void **) &lock);
-  if (result != VDO_SUCCESS) {
-    returnHashLockToPool(zone, &newLock);
-    return result;
-  }
-
   if (replaceLock != NULL) {
     // XXX on mismatch put the old lock back and return a severe error
     ASSERT_LOG_ONLY(lock == replaceLock,
@@ -238,15 +528,15 @@ int acquireHashLockFromZone(HashZone            *zone,
     replaceLock->registered = false;
   }
 
-  if (lock == replaceLock) {
-    lock = newLock;
-    lock->registered = true;
+  if (lock != NULL) {
+    // Point the old lock's entry at the new lock.
+    zone->lockBuckets[bucketIndex].locks[slot] = newLock - zone->lockArray;
   } else {
-    // There's already a lock for the hash, so we don't need the borrowed lock.
-    returnHashLockToPool(zone, &newLock);
+    addLockEntry(zone, newLock);
   }
 
-  *lockPtr = lock;
+  newLock->registered = true;
+  *lockPtr = newLock;
   return VDO_SUCCESS;
 }
 
@@ -256,12 +546,19 @@ void returnHashLockToZone(HashZone *zone, HashLock **lockPtr)
   HashLock *lock = *lockPtr;
   *lockPtr = NULL;
 
+  size_t       bucketIndex;
+  unsigned int slot;
+  bool mapped = findLockEntry(zone, &lock->hash, &bucketIndex, &slot);
+  HashLock *mappedLock = (mapped ? getLockEntry(zone, bucketIndex, slot)
+                          : NULL);
   if (lock->registered) {
-    HashLock *removed = pointerMapRemove(zone->hashLockMap, &lock->hash);
-    ASSERT_LOG_ONLY(lock == removed,
+    ASSERT_LOG_ONLY(lock == mappedLock,
                     "hash lock being released must have been mapped");
+    if (mapped) {
+      removeLockEntry(zone, bucketIndex, slot);
+    }
   } else {
-    ASSERT_LOG_ONLY(lock != pointerMapGet(zone->hashLockMap, &lock->hash),
+    ASSERT_LOG_ONLY(lock != mappedLock,
                     "unregistered hash lock must not be in the lock map");
   }
 
@@ -321,6 +618,13 @@ void bumpHashZoneStaleAdviceCount(HashZone *zone)
   relaxedAdd64(&zone->statistics.dedupeAdviceStale, 1);
 }
 
+/**********************************************************************/
+void bumpHashZoneTrustedAdviceCount(HashZone *zone)
+{
+  // Must only be mutated on the hash zone thread.
+  relaxedAdd64(&zone->statistics.dedupeAdviceTrusted, 1);
+}
+
 /**********************************************************************/
 void bumpHashZoneDataMatchCount(HashZone *zone)
 {
@@ -338,13 +642,13 @@ void bumpHashZoneCollisionCount(HashZone *zone)
 /**********************************************************************/
 void dumpHashZone(const HashZone *zone)
 {
-  if (zone->hashLockMap == NULL) {
+  if (zone->lockBuckets == NULL) {
     logInfo("HashZone %u: NULL map", zone->zoneNumber);
     return;
   }
 
   logInfo("HashZone %u: mapSize=%zu",
-          zone->zoneNumber, pointerMapSize(zone->hashLockMap));
+          zone->zoneNumber, zone->registeredLocks);
   for (VIOCount i = 0; i < LOCK_POOL_CAPACITY; i++) {
     dumpHashLock(&zone->lockArray[i]);
   }
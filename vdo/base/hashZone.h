@@ -107,6 +107,45 @@ int acquireHashLockFromZone(HashZone            *zone,
  **/
 void returnHashLockToZone(HashZone *zone, HashLock **lockPtr);
 
+/**
+ * Look up a chunk name in the advice cache of a hash zone. The cached
+ * location was valid when it was cached but must still be verified before
+ * it is used. Must only be called from the hash zone thread.
+ *
+ * @param [in]  zone       The hash zone
+ * @param [in]  name       The chunk name to look up
+ * @param [out] advicePtr  A pointer to hold the cached advice
+ *
+ * @return <code>true</code> if the name was found in the cache
+ **/
+bool getCachedHashZoneAdvice(HashZone           *zone,
+                             const UdsChunkName *name,
+                             ZonedPBN           *advicePtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Record verified advice for a chunk name in the advice cache of a hash
+ * zone, replacing any previous advice for the name. Must only be called from
+ * the hash zone thread.
+ *
+ * @param zone    The hash zone
+ * @param name    The chunk name
+ * @param advice  The verified location of the data for the name
+ **/
+void cacheHashZoneAdvice(HashZone           *zone,
+                         const UdsChunkName *name,
+                         ZonedPBN            advice);
+
+/**
+ * Remove any advice for a chunk name from the advice cache of a hash zone,
+ * typically because it failed verification. Must only be called from the
+ * hash zone thread.
+ *
+ * @param zone  The hash zone
+ * @param name  The chunk name
+ **/
+void invalidateHashZoneAdvice(HashZone *zone, const UdsChunkName *name);
+
 /**
  * Increment the valid advice count in the hash zone statistics.
  * Must only be called from the hash zone thread.
@@ -123,6 +162,14 @@ void bumpHashZoneValidAdviceCount(HashZone *zone);
  **/
 void bumpHashZoneStaleAdviceCount(HashZone *zone);
 
+/**
+ * Increment the trusted advice count in the hash zone statistics.
+ * Must only be called from the hash zone thread.
+ *
+ * @param zone  The hash zone of the lock that trusted unchanged advice
+ **/
+void bumpHashZoneTrustedAdviceCount(HashZone *zone);
+
 /**
  * Increment the concurrent dedupe count in the hash zone statistics.
  * Must only be called from the hash zone thread.
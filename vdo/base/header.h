@@ -63,6 +63,7 @@ typedef enum {
   SLAB_DEPOT        = 3,
   BLOCK_MAP         = 4,
   GEOMETRY_BLOCK    = 5,
+  SUPER_BLOCK_EXTENSION = 6,
 } ComponentID;
 
 /**
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/base/hotBlockSketch.c#1 $
+ */
+
+#include "hotBlockSketch.h"
+
+#include "memoryAlloc.h"
+#include "permassert.h"
+
+#include "statusCodes.h"
+
+enum {
+  /** The bits of a hashed block number which select a counter in a row */
+  HOT_BLOCK_INDEX_BITS = 12,
+  /** The largest value of a counter */
+  HOT_BLOCK_COUNTER_MAX = 255,
+};
+
+struct hotBlockSketch {
+  /** The writes recorded since the counters were last halved */
+  uint32_t writesSinceAging;
+  /** The counters */
+  uint8_t  counters[HOT_BLOCK_SKETCH_ROWS][HOT_BLOCK_SKETCH_WIDTH];
+};
+
+/**********************************************************************/
+int makeHotBlockSketch(HotBlockSketch **sketchPtr)
+{
+  STATIC_ASSERT(HOT_BLOCK_SKETCH_WIDTH == (1 << HOT_BLOCK_INDEX_BITS));
+  STATIC_ASSERT((HOT_BLOCK_SKETCH_ROWS * HOT_BLOCK_INDEX_BITS) <= 64);
+  return ALLOCATE(1, HotBlockSketch, __func__, sketchPtr);
+}
+
+/**********************************************************************/
+void freeHotBlockSketch(HotBlockSketch **sketchPtr)
+{
+  HotBlockSketch *sketch = *sketchPtr;
+  if (sketch == NULL) {
+    return;
+  }
+
+  FREE(sketch);
+  *sketchPtr = NULL;
+}
+
+/**
+ * Scramble a logical block number so that each slice of the result can be
+ * used as an independent counter index. This is the 64-bit finalizer from
+ * MurmurHash3.
+ *
+ * @param lbn  The logical block number
+ *
+ * @return The scrambled block number
+ **/
+static inline uint64_t hashBlockNumber(LogicalBlockNumber lbn)
+{
+  uint64_t hash = lbn;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/**
+ * Halve all the counters of a sketch so that old writes fade away.
+ *
+ * @param sketch  The sketch to age
+ **/
+static void ageSketch(HotBlockSketch *sketch)
+{
+  for (unsigned int row = 0; row < HOT_BLOCK_SKETCH_ROWS; row++) {
+    for (unsigned int i = 0; i < HOT_BLOCK_SKETCH_WIDTH; i++) {
+      sketch->counters[row][i] >>= 1;
+    }
+  }
+
+  sketch->writesSinceAging = 0;
+}
+
+/**********************************************************************/
+bool recordHotBlockWrite(HotBlockSketch *sketch, LogicalBlockNumber lbn)
+{
+  uint64_t  hash = hashBlockNumber(lbn);
+  uint8_t  *counters[HOT_BLOCK_SKETCH_ROWS];
+  uint8_t   estimate = HOT_BLOCK_COUNTER_MAX;
+  for (unsigned int row = 0; row < HOT_BLOCK_SKETCH_ROWS; row++) {
+    counters[row] = &sketch->counters[row][hash % HOT_BLOCK_SKETCH_WIDTH];
+    hash >>= HOT_BLOCK_INDEX_BITS;
+    if (*counters[row] < estimate) {
+      estimate = *counters[row];
+    }
+  }
+
+  // Only bump the counters which are at the minimum (a "conservative
+  // update"); the others already overstate this block because of collisions.
+  if (estimate < HOT_BLOCK_COUNTER_MAX) {
+    for (unsigned int row = 0; row < HOT_BLOCK_SKETCH_ROWS; row++) {
+      if (*counters[row] == estimate) {
+        (*counters[row])++;
+      }
+    }
+    estimate++;
+  }
+
+  if (++sketch->writesSinceAging >= HOT_BLOCK_AGING_INTERVAL) {
+    ageSketch(sketch);
+  }
+
+  return (estimate >= HOT_BLOCK_WRITE_THRESHOLD);
+}
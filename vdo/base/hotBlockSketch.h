@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/base/hotBlockSketch.h#1 $
+ */
+
+#ifndef HOT_BLOCK_SKETCH_H
+#define HOT_BLOCK_SKETCH_H
+
+#include "types.h"
+
+/**
+ * A HotBlockSketch is a count-min sketch of the writes to the logical blocks
+ * of one logical zone, used to spot blocks which are rewritten so often
+ * (journals, swap, database redo logs) that their data is unlikely to last
+ * long enough to be worth deduplicating or compressing. Each write bumps one
+ * small counter in each row of the sketch; the smallest of a block's
+ * counters bounds how often it has been written, so collisions can only
+ * make a block look hotter, never colder. All the counters are halved every
+ * so many writes so that the sketch tracks recent writes only.
+ *
+ * A sketch is not thread-safe; it must only be used from the thread of the
+ * zone which owns it.
+ **/
+typedef struct hotBlockSketch HotBlockSketch;
+
+enum {
+  /** The number of rows of counters in a sketch */
+  HOT_BLOCK_SKETCH_ROWS      = 4,
+  /** The number of counters in each row, which must be a power of two */
+  HOT_BLOCK_SKETCH_WIDTH     = 4096,
+  /** The writes recorded between halvings of the counters */
+  HOT_BLOCK_AGING_INTERVAL   = HOT_BLOCK_SKETCH_WIDTH,
+  /** The recent writes after which a block is considered hot */
+  HOT_BLOCK_WRITE_THRESHOLD  = 8,
+};
+
+/**
+ * Make a hot block sketch.
+ *
+ * @param sketchPtr  A pointer to hold the new sketch
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+int makeHotBlockSketch(HotBlockSketch **sketchPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free a hot block sketch and null out the reference to it.
+ *
+ * @param sketchPtr  The reference to the sketch to free
+ **/
+void freeHotBlockSketch(HotBlockSketch **sketchPtr);
+
+/**
+ * Record a write to a logical block.
+ *
+ * @param sketch  The sketch
+ * @param lbn     The logical block being written
+ *
+ * @return <code>true</code> if the block, counting this write, has been
+ *         written often enough recently to be considered hot
+ **/
+bool recordHotBlockWrite(HotBlockSketch *sketch, LogicalBlockNumber lbn)
+  __attribute__((warn_unused_result));
+
+#endif // HOT_BLOCK_SKETCH_H
@@ -19,59 +19,50 @@
  * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/base/intMap.c#1 $
  */
 
+
 /**
- * Hash table implementation of a map from integers to pointers, implemented
- * using the Hopscotch Hashing algorithm by Herlihy, Shavit, and Tzafrir (see
- * http://en.wikipedia.org/wiki/Hopscotch_hashing). This implementation does
- * not contain any of the locking/concurrency features of the algorithm, just
- * the collision resolution scheme.
- *
- * Hopscotch Hashing is based on hashing with open addressing and linear
- * probing. All the entries are stored in a fixed array of buckets, with no
- * dynamic allocation for collisions. Unlike linear probing, all the entries
- * that hash to a given bucket are stored within a fixed neighborhood starting
- * at that bucket. Chaining is effectively represented as a bit vector
- * relative to each bucket instead of as pointers or explicit offsets.
- *
- * When an empty bucket cannot be found within a given neighborhood,
- * subsequent neighborhoods are searched, and one or more entries will "hop"
- * into those neighborhoods. When this process works, an empty bucket will
- * move into the desired neighborhood, allowing the entry to be added. When
- * that process fails (typically when the buckets are around 90% full), the
- * table must be resized and the all entries rehashed and added to the
- * expanded table.
- *
- * Unlike linear probing, the number of buckets that must be searched in the
- * worst case has a fixed upper bound (the size of the neighborhood). Those
- * entries occupy a small number of memory cache lines, leading to improved
- * use of the cache (fewer misses on both successful and unsuccessful
- * searches). Hopscotch hashing outperforms linear probing at much higher load
- * factors, so even with the increased memory burden for maintaining the hop
- * vectors, less memory is needed to achieve that performance. Hopscotch is
- * also immune to "contamination" from deleting entries since entries are
- * genuinely removed instead of being replaced by a placeholder.
- *
- * The published description of the algorithm used a bit vector, but the paper
- * alludes to an offset scheme which is used by this implementation. Since the
- * entries in the neighborhood are within N entries of the hash bucket at the
- * start of the neighborhood, a pair of small offset fields each log2(N) bits
- * wide is all that's needed to maintain the hops as a linked list. In order
- * to encode "no next hop" (i.e. NULL) as the natural initial value of zero,
- * the offsets are biased by one (i.e. 0 => NULL, 1 => offset=0, 2 =>
- * offset=1, etc.) We can represent neighborhoods of up to 255 entries with
- * just 8+8=16 bits per entry. The hop list is sorted by hop offset so the
- * first entry in the list is always the bucket closest to the start of the
- * neighborhood.
- *
- * While individual accesses tend to be very fast, the table resize operations
- * are very very expensive. If an upper bound on the latency of adding an
- * entry to the table is needed, we either need to ensure the table is
- * pre-sized to be large enough so no resize is ever needed, or we'll need to
- * develop an approach to incrementally resize the table.
+ * Hash table implementation of a map from integers to pointers, in the style
+ * of the "Swiss table" hash map designed at Google. This implementation does
+ * not contain any of the concurrency features of the design, just the
+ * collision resolution scheme.
+ *
+ * The entries are stored in a power-of-two sized array of slots which is
+ * divided into groups of eight. Alongside the slots is an array of control
+ * bytes, one per slot, packed so that the control bytes of each group form a
+ * single 64-bit word. A control byte records whether its slot is empty,
+ * deleted (a tombstone), or full, and for a full slot, also holds seven bits
+ * of the hash of the slot's key (its fingerprint).
+ *
+ * A search hashes the key to a starting group and a fingerprint, and then
+ * examines one group at a time. Comparing the fingerprint against all the
+ * control bytes of a group takes a handful of word-at-a-time operations, so
+ * only the keys of the slots with matching fingerprints (almost always just
+ * the one being sought) are ever compared. If a group has no matching key and
+ * has an empty slot, the key is not in the map. The groups are probed in
+ * triangular order, which visits every group of a power-of-two sized table.
+ *
+ * The published design matches sixteen control bytes at a time using vector
+ * instructions; kernel code can not use the vector registers without saving
+ * the FPU state, so this implementation matches eight at a time in a general
+ * purpose register instead.
+ *
+ * Removing an entry only leaves a tombstone if the entry's group has no empty
+ * slot, since a search can only have continued past a group which was full.
+ * When the empty slots which may be filled have all been used, the table is
+ * rehashed, doubling in size unless most of the used slots are tombstones.
+ * Rehashing all the entries at once would stall the caller for a time
+ * proportional to the size of the map, so new slots are allocated and the
+ * old ones kept as a second table until every entry has moved. Each put or
+ * remove migrates a few groups of the old table, and searches which miss in
+ * the new table continue in the old one. A migrated slot becomes a
+ * tombstone in the old table, so the entries left there can still be
+ * found. The old table is emptied well before the puts made meanwhile could
+ * fill the new one.
  **/
 
 #include "intMap.h"
 
+#include "cpu.h"
 #include "errors.h"
 #include "logger.h"
 #include "memoryAlloc.h"
@@ -79,40 +70,41 @@
 #include "permassert.h"
 
 enum {
-  DEFAULT_CAPACITY = 16,    // the number of neighborhoods in a new table
-  NEIGHBORHOOD     = 255,   // the number of buckets in each neighborhood
-  MAX_PROBES       = 1024,  // limit on the number of probes for a free bucket
-  NULL_HOP_OFFSET  = 0,     // the hop offset value terminating the hop list
-  DEFAULT_LOAD     = 75     // a compromise between memory use and performance
+  DEFAULT_CAPACITY = 16,    // the number of entries in a new table
+  DEFAULT_LOAD     = 75,    // a compromise between memory use and performance
+  GROUP_SIZE       = 8,     // the number of slots matched at once
+  MINIMUM_SLOTS    = 2 * GROUP_SIZE,
+  CONTROL_EMPTY    = 0x80,  // the control byte of a slot never yet used
+  CONTROL_DELETED  = 0xFE,  // the control byte of a slot whose entry left
+  FINGERPRINT_BITS = 7,     // the hash bits in the control byte of a full slot
+  FINGERPRINT_MASK = (1 << FINGERPRINT_BITS) - 1,
+  BATCH_SIZE       = 16,    // the number of lookups prefetched together
+  MIGRATION_GROUPS = 4,     // the groups migrated by each put or remove
 };
 
+static const uint64_t LOW_BYTE_BITS  = 0x0101010101010101ULL;
+static const uint64_t HIGH_BYTE_BITS = 0x8080808080808080ULL;
+
 /**
- * Buckets are packed together to reduce memory usage and improve cache
- * efficiency. It would be tempting to encode the hop offsets separately and
- * maintain alignment of key/value pairs, but it's crucial to keep the hop
- * fields near the buckets that they use them so they'll tend to share cache
- * lines.
+ * A slot holds one entry of the map.
  **/
-typedef struct __attribute__((packed)) bucket {
-  uint8_t   firstHop;  // the biased offset of the first entry in the hop list
-                       // of the neighborhood that hashes to this bucket
-  uint8_t   nextHop;   // the biased offset of the next bucket in the hop list
-
-  uint64_t  key;       // the key stored in this bucket
-  void     *value;     // the value stored in this bucket (NULL if empty)
-} Bucket;
+typedef struct {
+  uint64_t  key;    // the key stored in this slot
+  void     *value;  // the value stored in this slot (NULL if not full)
+} Slot;
 
 /**
- * The concrete definition of the opaque IntMap type. To avoid having to wrap
- * the neighborhoods of the last entries back around to the start of the
- * bucket array, we allocate a few more buckets at the end of the array
- * instead, which is why capacity and bucketCount are different.
+ * The concrete definition of the opaque IntMap type.
  **/
 struct intMap {
-  size_t  size;         // the number of entries stored in the map
-  size_t  capacity;     // the number of neighborhoods in the map
-  size_t  bucketCount;  // the number of buckets in the bucket array
-  Bucket *buckets;      // the array of hash buckets
+  size_t    size;        // the number of entries stored in the map
+  size_t    slotCount;   // the number of slots in the map, a power of two
+  size_t    groupMask;   // the mask which wraps a group index
+  size_t    growthLeft;  // the empty slots which may be filled before rehash
+  uint64_t *controls;    // the control bytes, one word for each group
+  Slot     *slots;       // the array of slots
+  IntMap   *oldMap;      // the table being migrated from, or NULL
+  size_t    nextGroup;   // the next group to migrate, in an old table
 };
 
 /**
@@ -158,22 +150,173 @@ static uint64_t hashKey(uint64_t key)
 }
 
 /**
- * Initialize an IntMap.
+ * Get the fingerprint of a hash, which is stored in the control byte of the
+ * slot holding the hashed key.
+ *
+ * @param hash  the hash of a key
+ *
+ * @return the fingerprint
+ **/
+static inline unsigned int getFingerprint(uint64_t hash)
+{
+  return (hash & FINGERPRINT_MASK);
+}
+
+/**
+ * Get the group at which a search for a hashed key starts.
+ *
+ * @param map   the map
+ * @param hash  the hash of a key
+ *
+ * @return the index of the first group to probe
+ **/
+static inline size_t getFirstGroup(const IntMap *map, uint64_t hash)
+{
+  return ((hash >> FINGERPRINT_BITS) & map->groupMask);
+}
+
+/**
+ * Find the control bytes of a group which match a fingerprint. A byte just
+ * above a matching byte may also be reported, but since only full slots are
+ * ever reported, comparing the key will reject it.
+ *
+ * @param controls     the control bytes of a group
+ * @param fingerprint  the fingerprint to match
+ *
+ * @return a word with the high bit set in each matching byte
+ **/
+static inline uint64_t matchFingerprint(uint64_t     controls,
+                                        unsigned int fingerprint)
+{
+  // A byte of the differences is zero exactly where the bytes match.
+  uint64_t differences = controls ^ (LOW_BYTE_BITS * fingerprint);
+  return ((differences - LOW_BYTE_BITS) & ~differences & HIGH_BYTE_BITS);
+}
+
+/**
+ * Find the control bytes of a group which are empty. Only empty bytes have
+ * the high bit set and bit one clear.
+ *
+ * @param controls  the control bytes of a group
+ *
+ * @return a word with the high bit set in each empty byte
+ **/
+static inline uint64_t matchEmpty(uint64_t controls)
+{
+  return (controls & (~controls << 6) & HIGH_BYTE_BITS);
+}
+
+/**
+ * Find the control bytes of a group which are empty or deleted. Only those
+ * bytes have the high bit set and bit zero clear.
+ *
+ * @param controls  the control bytes of a group
+ *
+ * @return a word with the high bit set in each empty or deleted byte
+ **/
+static inline uint64_t matchAvailable(uint64_t controls)
+{
+  return (controls & ~(controls << 7) & HIGH_BYTE_BITS);
+}
+
+/**
+ * Get the position in its group of the first slot reported by a match.
+ *
+ * @param matches  a non-zero match result
+ *
+ * @return the position of the first matching slot
+ **/
+static inline unsigned int getFirstMatch(uint64_t matches)
+{
+  return (__builtin_ctzll(matches) / 8);
+}
+
+/**
+ * Get the control byte of a slot.
+ *
+ * @param map   the map
+ * @param slot  the index of the slot
+ *
+ * @return the slot's control byte
+ **/
+static inline unsigned int getControl(const IntMap *map, size_t slot)
+{
+  return ((map->controls[slot / GROUP_SIZE] >> (8 * (slot % GROUP_SIZE)))
+          & 0xFF);
+}
+
+/**
+ * Set the control byte of a slot.
  *
- * @param map       the map to initialize
- * @param capacity  the initial capacity of the map
+ * @param map      the map
+ * @param slot     the index of the slot
+ * @param control  the new control byte
+ **/
+static inline void setControl(IntMap *map, size_t slot, unsigned int control)
+{
+  unsigned int  shift = 8 * (slot % GROUP_SIZE);
+  uint64_t     *group = &map->controls[slot / GROUP_SIZE];
+  *group = ((*group & ~(0xFFULL << shift)) | ((uint64_t) control << shift));
+}
+
+/**
+ * Allocate the slots and control bytes for a map, and mark all the slots
+ * empty.
+ *
+ * @param map        the map to initialize
+ * @param slotCount  the number of slots, a power of two
  *
  * @return UDS_SUCCESS or an error code
  **/
-static int allocateBuckets(IntMap *map, size_t capacity)
+static int allocateSlots(IntMap *map, size_t slotCount)
+{
+  size_t groupCount = slotCount / GROUP_SIZE;
+  map->size       = 0;
+  map->slotCount  = slotCount;
+  map->groupMask  = groupCount - 1;
+  // Always leave an eighth of the slots empty to bound the length of probes.
+  map->growthLeft = slotCount - (slotCount / 8);
+  map->controls   = NULL;
+  map->slots      = NULL;
+
+  int result = ALLOCATE(groupCount, uint64_t, "IntMap control bytes",
+                        &map->controls);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  for (size_t i = 0; i < groupCount; i++) {
+    map->controls[i] = LOW_BYTE_BITS * CONTROL_EMPTY;
+  }
+
+  return ALLOCATE(slotCount, Slot, "IntMap slots", &map->slots);
+}
+
+/**
+ * Free the slots and control bytes of a map.
+ *
+ * @param map  the map whose arrays are to be freed
+ **/
+static void freeSlots(IntMap *map)
 {
-  map->size     = 0;
-  map->capacity = capacity;
+  FREE(map->controls);
+  map->controls = NULL;
+  FREE(map->slots);
+  map->slots = NULL;
+}
 
-  // Allocate NEIGHBORHOOD - 1 extra buckets so the last bucket can have a
-  // full neighborhood without have to wrap back around to element zero.
-  map->bucketCount = capacity + (NEIGHBORHOOD - 1);
-  return ALLOCATE(map->bucketCount, Bucket, "IntMap buckets", &map->buckets);
+/**
+ * Free the old table of a map which is being migrated.
+ *
+ * @param map  the map whose old table is to be freed
+ **/
+static void freeOldMap(IntMap *map)
+{
+  if (map->oldMap != NULL) {
+    freeSlots(map->oldMap);
+    FREE(map->oldMap);
+    map->oldMap = NULL;
+  }
 }
 
 /**********************************************************************/
@@ -202,7 +345,13 @@ int makeIntMap(size_t         initialCapacity,
   // (i.e to hold 1000 entries at 80% load we need a capacity of 1250)
   capacity = capacity * 100 / initialLoad;
 
-  result = allocateBuckets(map, capacity);
+  // Round up to a power of two number of slots.
+  size_t slotCount = MINIMUM_SLOTS;
+  while (slotCount < capacity) {
+    slotCount <<= 1;
+  }
+
+  result = allocateSlots(map, slotCount);
   if (result != UDS_SUCCESS) {
     freeIntMap(&map);
     return result;
@@ -212,22 +361,12 @@ int makeIntMap(size_t         initialCapacity,
   return UDS_SUCCESS;
 }
 
-/**
- * Free the bucket array for the map.
- *
- * @param map  the map whose bucket array is to be freed
- **/
-static void freeBuckets(IntMap *map)
-{
-  FREE(map->buckets);
-  map->buckets = NULL;
-}
-
 /**********************************************************************/
 void freeIntMap(IntMap **mapPtr)
 {
   if (*mapPtr != NULL) {
-    freeBuckets(*mapPtr);
+    freeOldMap(*mapPtr);
+    freeSlots(*mapPtr);
     FREE(*mapPtr);
     *mapPtr = NULL;
   }
@@ -236,337 +375,263 @@ void freeIntMap(IntMap **mapPtr)
 /**********************************************************************/
 size_t intMapSize(const IntMap *map)
 {
-  return map->size;
+  return (map->size + ((map->oldMap != NULL) ? map->oldMap->size : 0));
 }
 
 /**
- * Convert a biased hop offset within a neighborhood to a pointer to the
- * bucket it references.
+ * Search the map for the slot holding a given key.
  *
- * @param neighborhood  the first bucket in the neighborhood
- * @param hopOffset     the biased hop offset to the desired bucket
+ * @param map   the map to search
+ * @param key   the mapping key
+ * @param hash  the hash of the key
  *
- * @return <code>NULL</code> if hopOffset is zero, otherwise a pointer to
- *         the bucket in the neighborhood at <code>hopOffset - 1</code>
+ * @return the slot holding the key, or <code>NULL</code> if not found
  **/
-static Bucket *dereferenceHop(Bucket *neighborhood, unsigned int hopOffset)
+static Slot *findSlot(const IntMap *map, uint64_t key, uint64_t hash)
 {
-  if (hopOffset == NULL_HOP_OFFSET) {
-    return NULL;
+  unsigned int fingerprint = getFingerprint(hash);
+  size_t       group       = getFirstGroup(map, hash);
+  for (size_t probe = 1; probe <= (map->groupMask + 1); probe++) {
+    uint64_t controls = map->controls[group];
+    for (uint64_t matches = matchFingerprint(controls, fingerprint);
+         matches != 0;
+         matches &= (matches - 1)) {
+      Slot *slot = &map->slots[(group * GROUP_SIZE) + getFirstMatch(matches)];
+      if (slot->key == key) {
+        return slot;
+      }
+    }
+
+    if (matchEmpty(controls) != 0) {
+      // The key would have been put in this group if it were in the map.
+      return NULL;
+    }
+    group = (group + probe) & map->groupMask;
   }
 
-  STATIC_ASSERT(NULL_HOP_OFFSET == 0);
-  return &neighborhood[hopOffset - 1];
+  return NULL;
 }
 
 /**
- * Add a bucket into the hop list for the neighborhood, inserting it into the
- * list so the hop list remains sorted by hop offset.
+ * Find the first empty or deleted slot in which a key with a given hash may
+ * be put. There is always an empty slot since the table is rehashed before
+ * the last eighth of its slots are used.
  *
- * @param neighborhood  the first bucket in the neighborhood
- * @param newBucket     the bucket to add to the hop list
+ * @param map   the map to search
+ * @param hash  the hash of the key
+ *
+ * @return the index of the slot
  **/
-static void insertInHopList(Bucket *neighborhood, Bucket *newBucket)
+static size_t findAvailableSlot(const IntMap *map, uint64_t hash)
 {
-  // Zero indicates a NULL hop offset, so bias the hop offset by one.
-  int hopOffset = 1 + (newBucket - neighborhood);
-
-  // Handle the special case of adding a bucket at the start of the list.
-  int nextHop = neighborhood->firstHop;
-  if ((nextHop == NULL_HOP_OFFSET) || (nextHop > hopOffset)) {
-    newBucket->nextHop = nextHop;
-    neighborhood->firstHop = hopOffset;
-    return;
+  size_t group = getFirstGroup(map, hash);
+  for (size_t probe = 1; ; probe++) {
+    uint64_t matches = matchAvailable(map->controls[group]);
+    if (matches != 0) {
+      return ((group * GROUP_SIZE) + getFirstMatch(matches));
+    }
+    group = (group + probe) & map->groupMask;
   }
+}
 
-  // Search the hop list for the insertion point that maintains the sort
-  // order.
-  for (;;) {
-    Bucket *bucket = dereferenceHop(neighborhood, nextHop);
-    nextHop = bucket->nextHop;
-
-    if ((nextHop == NULL_HOP_OFFSET) || (nextHop > hopOffset)) {
-      newBucket->nextHop = nextHop;
-      bucket->nextHop = hopOffset;
-      return;
-    }
+/**
+ * Put a new entry in an available slot.
+ *
+ * @param map    the map
+ * @param index  the index of the available slot
+ * @param key    the key of the entry
+ * @param hash   the hash of the key
+ * @param value  the value of the entry
+ **/
+static void fillSlot(IntMap   *map,
+                     size_t    index,
+                     uint64_t  key,
+                     uint64_t  hash,
+                     void     *value)
+{
+  if (getControl(map, index) == CONTROL_EMPTY) {
+    map->growthLeft -= 1;
   }
+
+  setControl(map, index, getFingerprint(hash));
+  map->slots[index] = (Slot) {
+    .key   = key,
+    .value = value,
+  };
+  map->size += 1;
 }
 
 /**
- * Select and return the hash bucket for a given search key.
+ * Empty a full slot, leaving a tombstone if searches may have continued
+ * past its group.
  *
- * @param map  the map to search
- * @param key  the mapping key
+ * @param map   the map containing the slot
+ * @param slot  the slot to empty
+ *
+ * @return the value which was in the slot
  **/
-static Bucket *selectBucket(const IntMap *map, uint64_t key)
+static void *vacateSlot(IntMap *map, Slot *slot)
 {
-  // Calculate a good hash value for the provided key. We want exactly 32
-  // bits, so mask the result.
-  uint64_t hash = hashKey(key) & 0xFFFFFFFF;
+  map->size -= 1;
+  void *value = slot->value;
+  slot->value = NULL;
+  slot->key   = 0;
 
   /*
-   * Scale the 32-bit hash to a bucket index by treating it as a binary
-   * fraction and multiplying that by the capacity. If the hash is uniformly
-   * distributed over [0 .. 2^32-1], then (hash * capacity / 2^32) should be
-   * uniformly distributed over [0 .. capacity-1]. The multiply and shift is
-   * much faster than a divide (modulus) on X86 CPUs.
+   * If the group has an empty slot, it has never been full, so no search can
+   * have continued past it and the slot can be made empty again. Otherwise
+   * the slot must be a tombstone so that searches continue past it.
    */
-  return &map->buckets[(hash * map->capacity) >> 32];
+  size_t index = slot - map->slots;
+  if (matchEmpty(map->controls[index / GROUP_SIZE]) != 0) {
+    setControl(map, index, CONTROL_EMPTY);
+    map->growthLeft += 1;
+  } else {
+    setControl(map, index, CONTROL_DELETED);
+  }
+
+  return value;
 }
 
 /**
- * Search the hop list associated with given hash bucket for a given search
- * key. If the key is found, returns a pointer to the entry (bucket or
- * collision), otherwise returns <code>NULL</code>.
- *
- * @param [in]  map          the map being searched
- * @param [in]  bucket       the map bucket to search for the key
- * @param [in]  key          the mapping key
- * @param [out] previousPtr  if not <code>NULL</code>, a pointer in which to
- *                           store the bucket in the list preceding the one
- *                           that had the matching key
- *
- * @return an entry that matches the key, or <code>NULL</code> if not found
+ * Move the entries of some groups of the old table of a map into the new
+ * table, and free the old table once it has been entirely migrated. The keys
+ * are known to be distinct, so there is no need to search for them in the
+ * new table. A migrated slot is left as a tombstone, never as an empty slot,
+ * so that searches for the entries still in the old table find them.
+ *
+ * @param map         the map being migrated
+ * @param groupCount  the maximum number of groups to migrate
  **/
-static Bucket *searchHopList(IntMap    *map __attribute__((unused)),
-                             Bucket    *bucket,
-                             uint64_t   key,
-                             Bucket   **previousPtr)
+static void migrateGroups(IntMap *map, size_t groupCount)
 {
-  Bucket *previous = NULL;
-  unsigned int nextHop = bucket->firstHop;
-  while (nextHop != NULL_HOP_OFFSET) {
-    // Check the neighboring bucket indexed by the offset for the desired key.
-    Bucket *entry = dereferenceHop(bucket, nextHop);
-    if ((key == entry->key) && (entry->value != NULL)) {
-      if (previousPtr != NULL) {
-        *previousPtr = previous;
+  IntMap *oldMap = map->oldMap;
+  for (; (groupCount > 0) && (oldMap->nextGroup <= oldMap->groupMask);
+       groupCount--, oldMap->nextGroup++) {
+    for (size_t i = 0; i < GROUP_SIZE; i++) {
+      size_t index = (oldMap->nextGroup * GROUP_SIZE) + i;
+      if (getControl(oldMap, index) & CONTROL_EMPTY) {
+        // The slot is empty or deleted.
+        continue;
       }
-      return entry;
+
+      Slot     *slot = &oldMap->slots[index];
+      uint64_t  hash = hashKey(slot->key);
+      fillSlot(map, findAvailableSlot(map, hash), slot->key, hash,
+               slot->value);
+      setControl(oldMap, index, CONTROL_DELETED);
+      slot->value   = NULL;
+      oldMap->size -= 1;
     }
-    nextHop = entry->nextHop;
-    previous = entry;
   }
-  return NULL;
-}
 
-/**********************************************************************/
-void *intMapGet(IntMap *map, uint64_t key)
-{
-  Bucket *match = searchHopList(map, selectBucket(map, key), key, NULL);
-  return ((match != NULL) ? match->value : NULL);
+  if (oldMap->nextGroup > oldMap->groupMask) {
+    freeOldMap(map);
+  }
 }
 
 /**
- * Increase the number of hash buckets and rehash all the existing entries,
- * storing them in the new buckets.
+ * Allocate new slots for a map, doubling the number of slots unless at least
+ * half of the used slots are tombstones, and begin migrating the entries
+ * into them. If a previous migration has not finished, it is finished first.
  *
  * @param map  the map to resize
  **/
-static int resizeBuckets(IntMap *map)
+static int resizeSlots(IntMap *map)
 {
-  // Copy the top-level map data to the stack.
-  IntMap oldMap = *map;
+  if (map->oldMap != NULL) {
+    migrateGroups(map, map->oldMap->groupMask + 1);
+  }
 
-  // Re-initialize the map to be empty and 50% larger.
-  size_t newCapacity = map->capacity / 2 * 3;
-  logInfo("%s: attempting resize from %zu to %zu, current size=%zu",
-          __func__, map->capacity, newCapacity, map->size);
-  int result = allocateBuckets(map, newCapacity);
+  IntMap *oldMap;
+  int result = ALLOCATE(1, IntMap, "IntMap old table", &oldMap);
   if (result != UDS_SUCCESS) {
-    *map = oldMap;
     return result;
   }
 
-  // Populate the new hash table from the entries in the old bucket array.
-  for (size_t i = 0; i < oldMap.bucketCount; i++) {
-    Bucket *entry = &oldMap.buckets[i];
-    if (entry->value == NULL) {
-      continue;
-    }
+  // Move the current table aside.
+  *oldMap = *map;
+  oldMap->nextGroup = 0;
 
-    result = intMapPut(map, entry->key, entry->value, true, NULL);
-    if (result != UDS_SUCCESS) {
-      // Destroy the new partial map and restore the map from the stack.
-      freeBuckets(map);
-      *map = oldMap;
-      return result;
-    }
+  size_t newSlotCount = ((map->size < (map->slotCount / 2))
+                         ? map->slotCount : (map->slotCount * 2));
+  logInfo("%s: attempting resize from %zu to %zu, current size=%zu",
+          __func__, map->slotCount, newSlotCount, map->size);
+  result = allocateSlots(map, newSlotCount);
+  if (result != UDS_SUCCESS) {
+    freeSlots(map);
+    *map = *oldMap;
+    FREE(oldMap);
+    return result;
   }
 
-  // Destroy the old bucket array.
-  freeBuckets(&oldMap);
+  map->oldMap = oldMap;
+  migrateGroups(map, MIGRATION_GROUPS);
   return UDS_SUCCESS;
 }
 
 /**
- * Probe the bucket array starting at the given bucket for the next empty
- * bucket, returning a pointer to it. <code>NULL</code> will be returned if
- * the search reaches the end of the bucket array or if the number of linear
- * probes exceeds a specified limit.
- *
- * @param map        the map containing the buckets to search
- * @param bucket     the bucket at which to start probing
- * @param maxProbes  the maximum number of buckets to search
- *
- * @return the next empty bucket, or <code>NULL</code> if the search failed
- **/
-static Bucket *findEmptyBucket(IntMap       *map,
-                               Bucket       *bucket,
-                               unsigned int  maxProbes)
-{
-  // Limit the search to either the nearer of the end of the bucket array or a
-  // fixed distance beyond the initial bucket.
-  size_t remaining = &map->buckets[map->bucketCount] - bucket;
-  Bucket *sentinel = &bucket[minSizeT(remaining, maxProbes)];
-
-  for (Bucket *entry = bucket; entry < sentinel; entry++) {
-    if (entry->value == NULL) {
-      return entry;
-    }
-  }
-  return NULL;
-}
-
-/**
- * Move an empty bucket closer to the start of the bucket array. This searches
- * the neighborhoods that contain the empty bucket for a non-empty bucket
- * closer to the start of the array. If such a bucket is found, this swaps the
- * two buckets by moving the entry to the empty bucket.
+ * Search a map, and the old table it is being migrated from, for the slot
+ * holding a given key.
  *
- * @param map   the map containing the bucket
- * @param hole  the empty bucket to fill with an entry that precedes it in one
- *              of its enclosing neighborhoods
+ * @param [in]  map     the map to search
+ * @param [in]  key     the mapping key
+ * @param [in]  hash    the hash of the key
+ * @param [out] mapPtr  a pointer to receive the table holding the slot
  *
- * @return the bucket that was vacated by moving its entry to the provided
- *         hole, or <code>NULL</code> if no entry could be moved
+ * @return the slot holding the key, or <code>NULL</code> if not found
  **/
-static Bucket *moveEmptyBucket(IntMap *map __attribute__((unused)),
-                               Bucket *hole)
+static Slot *findSlotInTables(IntMap    *map,
+                              uint64_t   key,
+                              uint64_t   hash,
+                              IntMap   **mapPtr)
 {
-  /*
-   * Examine every neighborhood that the empty bucket is part of, starting
-   * with the one in which it is the last bucket. No boundary check is needed
-   * for the negative array arithmetic since this function is only called when
-   * hole is at least NEIGHBORHOOD cells deeper into the array than a valid
-   * bucket.
-   */
-  for (Bucket *bucket = &hole[1 - NEIGHBORHOOD]; bucket < hole; bucket++) {
-    // Find the entry that is nearest to the bucket, which means it will be
-    // nearest to the hash bucket whose neighborhood is full.
-    Bucket *newHole = dereferenceHop(bucket, bucket->firstHop);
-    if (newHole == NULL) {
-      // There are no buckets in this neighborhood that are in use by this one
-      // (they must all be owned by overlapping neighborhoods).
-      continue;
-    }
-
-    // Skip this bucket if its first entry is actually further away than the
-    // hole that we're already trying to fill.
-    if (hole < newHole) {
-      continue;
-    }
-
-    /*
-     * We've found an entry in this neighborhood that we can "hop" further
-     * away, moving the hole closer to the hash bucket, if not all the way
-     * into its neighborhood.
-     */
-
-    // The entry that will be the new hole is the first bucket in the list,
-    // so setting firstHop is all that's needed remove it from the list.
-    bucket->firstHop = newHole->nextHop;
-    newHole->nextHop = NULL_HOP_OFFSET;
-
-    // Move the entry into the original hole.
-    hole->key      = newHole->key;
-    hole->value    = newHole->value;
-    newHole->value = NULL;
-
-    // Insert the filled hole into the hop list for the neighborhood.
-    insertInHopList(bucket, hole);
-    return newHole;
+  Slot *slot = findSlot(map, key, hash);
+  if ((slot == NULL) && (map->oldMap != NULL)) {
+    map  = map->oldMap;
+    slot = findSlot(map, key, hash);
   }
 
-  // We couldn't find an entry to relocate to the hole.
-  return NULL;
+  *mapPtr = map;
+  return slot;
 }
 
-/**
- * Find and update any existing mapping for a given key, returning the value
- * associated with the key in the provided pointer.
- *
- * @param [in]  map           the IntMap to attempt to modify
- * @param [in]  neighborhood  the first bucket in the neighborhood that
- *                            would contain the search key
- * @param [in]  key           the key with which to associate the new value
- * @param [in]  newValue      the value to be associated with the key
- * @param [in]  update        whether to overwrite an existing value
- * @param [out] oldValuePtr   a pointer in which to store the old value
- *                            (unmodified if no mapping was found)
- *
- * @return <code>true</code> if the map contains a mapping for the key
- *         <code>false</code> if it does not
- **/
-static bool updateMapping(IntMap    *map,
-                          Bucket    *neighborhood,
-                          uint64_t   key,
-                          void      *newValue,
-                          bool       update,
-                          void     **oldValuePtr)
+/**********************************************************************/
+void *intMapGet(IntMap *map, uint64_t key)
 {
-  Bucket *bucket = searchHopList(map, neighborhood, key, NULL);
-  if (bucket == NULL) {
-    // There is no bucket containing the key in the neighborhood.
-    return false;
-  }
-
-  // Return the value of the current mapping (if desired) and update the
-  // mapping with the new value (if desired).
-  if (oldValuePtr != NULL) {
-    *oldValuePtr = bucket->value;
-  }
-  if (update) {
-    bucket->value = newValue;
-  }
-  return true;
+  IntMap *table;
+  Slot   *slot = findSlotInTables(map, key, hashKey(key), &table);
+  return ((slot != NULL) ? slot->value : NULL);
 }
 
-/**
- * Find an empty bucket in a specified neighborhood for a new mapping or
- * attempt to re-arrange mappings so there is such a bucket. This operation
- * may fail (returning NULL) if an empty bucket is not available or could not
- * be relocated to the neighborhood.
- *
- * @param map           the IntMap to search or modify
- * @param neighborhood  the first bucket in the neighborhood in which
- *                      an empty bucket is needed for a new mapping
- *
- * @return a pointer to an empty bucket in the desired neighborhood, or
- *         <code>NULL</code> if a vacancy could not be found or arranged
- **/
-static Bucket *findOrMakeVacancy(IntMap *map, Bucket *neighborhood)
+/**********************************************************************/
+void intMapGetBatch(IntMap          *map,
+                    size_t           count,
+                    const uint64_t  *keys,
+                    void           **values)
 {
-  // Probe within and beyond the neighborhood for the first empty bucket.
-  Bucket *hole = findEmptyBucket(map, neighborhood, MAX_PROBES);
-
-  // Keep trying until the empty bucket is in the bucket's neighborhood or we
-  // are unable to move it any closer by swapping it with a filled bucket.
-  while (hole != NULL) {
-    int distance = hole - neighborhood;
-    if (distance < NEIGHBORHOOD) {
-      // We've found or relocated an empty bucket close enough to the initial
-      // hash bucket to be referenced by its hop vector.
-      return hole;
+  while (count > 0) {
+    // Hash a batch of keys and prefetch their first groups so that the cache
+    // misses of the whole batch overlap.
+    uint64_t hashes[BATCH_SIZE];
+    size_t batchSize = minSizeT(count, BATCH_SIZE);
+    for (size_t i = 0; i < batchSize; i++) {
+      hashes[i]    = hashKey(keys[i]);
+      size_t group = getFirstGroup(map, hashes[i]);
+      prefetchAddress(&map->controls[group], false);
+      prefetchAddress(&map->slots[group * GROUP_SIZE], false);
     }
 
-    // The nearest empty bucket isn't within the neighborhood that must
-    // contain the new entry, so try to swap it with bucket that is closer.
-    hole = moveEmptyBucket(map, hole);
-  }
+    for (size_t i = 0; i < batchSize; i++) {
+      IntMap *table;
+      Slot   *slot = findSlotInTables(map, keys[i], hashes[i], &table);
+      values[i] = ((slot != NULL) ? slot->value : NULL);
+    }
 
-  return NULL;
+    keys   += batchSize;
+    values += batchSize;
+    count  -= batchSize;
+  }
 }
 
 /**********************************************************************/
@@ -580,45 +645,40 @@ int intMapPut(IntMap    *map,
     return UDS_INVALID_ARGUMENT;
   }
 
-  // Select the bucket at the start of the neighborhood that must contain any
-  // entry for the provided key.
-  Bucket *neighborhood = selectBucket(map, key);
-
-  // Check whether the neighborhood already contains an entry for the key, in
-  // which case we optionally update it, returning the old value.
-  if (updateMapping(map, neighborhood, key, newValue, update, oldValuePtr)) {
+  // Check whether the map already contains an entry for the key, in which
+  // case we optionally update it, returning the old value.
+  IntMap   *table;
+  uint64_t  hash = hashKey(key);
+  Slot     *slot = findSlotInTables(map, key, hash, &table);
+  if (slot != NULL) {
+    if (oldValuePtr != NULL) {
+      *oldValuePtr = slot->value;
+    }
+    if (update) {
+      slot->value = newValue;
+    }
     return UDS_SUCCESS;
   }
 
+  if (map->oldMap != NULL) {
+    migrateGroups(map, MIGRATION_GROUPS);
+  }
+
   /*
-   * Find an empty bucket in the desired neighborhood for the new entry or
-   * re-arrange entries in the map so there is such a bucket. This operation
-   * will usually succeed; the loop body will only be executed on the rare
-   * occasions that we have to resize the map.
+   * Reusing a tombstone never costs an empty slot. If the slot is empty and
+   * no more empty slots may be used, we're forced to allocate new slots,
+   * start migrating the entries into them, and find a slot again.
    */
-  Bucket *bucket;
-  while ((bucket = findOrMakeVacancy(map, neighborhood)) == NULL) {
-    /*
-     * There is no empty bucket in which to put the new entry in the current
-     * map, so we're forced to allocate a new bucket array with a larger
-     * capacity, re-hash all the entries into those buckets, and try again (a
-     * very expensive operation for large maps).
-     */
-    int result = resizeBuckets(map);
+  size_t index = findAvailableSlot(map, hash);
+  if ((map->growthLeft == 0) && (getControl(map, index) == CONTROL_EMPTY)) {
+    int result = resizeSlots(map);
     if (result != UDS_SUCCESS) {
       return result;
     }
-
-    // Resizing the map invalidates all pointers to buckets, so recalculate
-    // the neighborhood pointer.
-    neighborhood = selectBucket(map, key);
+    index = findAvailableSlot(map, hash);
   }
 
-  // Put the new entry in the empty bucket, adding it to the neighborhood.
-  bucket->key   = key;
-  bucket->value = newValue;
-  insertInHopList(neighborhood, bucket);
-  map->size += 1;
+  fillSlot(map, index, key, hash, newValue);
 
   // There was no existing entry, so there was no old value to be returned.
   if (oldValuePtr != NULL) {
@@ -630,32 +690,18 @@ int intMapPut(IntMap    *map,
 /**********************************************************************/
 void *intMapRemove(IntMap *map, uint64_t key)
 {
-  // Select the bucket to search and search it for an existing entry.
-  Bucket *bucket = selectBucket(map, key);
-  Bucket *previous;
-  Bucket *victim = searchHopList(map, bucket, key, &previous);
-
+  IntMap *table;
+  Slot   *victim = findSlotInTables(map, key, hashKey(key), &table);
   if (victim == NULL) {
     // There is no matching entry to remove.
     return NULL;
   }
 
   // We found an entry to remove. Save the mapped value to return later and
-  // empty the bucket.
-  map->size -= 1;
-  void *value   = victim->value;
-  victim->value = NULL;
-  victim->key   = 0;
-
-  // The victim bucket is now empty, but it still needs to be spliced out of
-  // the hop list.
-  if (previous == NULL) {
-    // The victim is the head of the list, so swing firstHop.
-    bucket->firstHop  = victim->nextHop;
-  } else {
-    previous->nextHop = victim->nextHop;
+  // empty the slot.
+  void *value = vacateSlot(table, victim);
+  if (map->oldMap != NULL) {
+    migrateGroups(map, MIGRATION_GROUPS);
   }
-  victim->nextHop = NULL_HOP_OFFSET;
-
   return value;
 }
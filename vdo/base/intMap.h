@@ -29,11 +29,12 @@
  * (<code>uint64_t</code>). <code>NULL</code> pointer values are not
  * supported.
  *
- * The map is implemented as hash table, which should provide constant-time
- * insert, query, and remove operations, although the insert may occasionally
- * grow the table, which is linear in the number of entries in the map. The
- * table will grow as needed to hold new entries, but will not shrink as
- * entries are removed.
+ * The map is implemented as an open-addressed hash table which matches a
+ * hash fingerprint against a group of slots at a time. It should provide
+ * constant-time insert, query, and remove operations, although the insert
+ * may occasionally grow the table, which is linear in the number of entries
+ * in the map. The table will grow as needed to hold new entries, but will
+ * not shrink as entries are removed.
  **/
 
 typedef struct intMap IntMap;
@@ -85,6 +86,23 @@ size_t intMapSize(const IntMap *map);
  **/
 void *intMapGet(IntMap *map, uint64_t key);
 
+/**
+ * Retrieve the values associated with several keys from the IntMap. This is
+ * equivalent to calling intMapGet() for each key, but overlaps the cache
+ * misses of the lookups.
+ *
+ * @param [in]  map     the IntMap to query
+ * @param [in]  count   the number of keys to look up
+ * @param [in]  keys    the keys to look up
+ * @param [out] values  an array of count entries to receive the value
+ *                      associated with each key, or <code>NULL</code> for
+ *                      each key which is not mapped to any value
+ **/
+void intMapGetBatch(IntMap          *map,
+                    size_t           count,
+                    const uint64_t  *keys,
+                    void           **values);
+
 /**
  * Try to associate a value (a pointer) with an integer in an IntMap. If the
  * map already contains a mapping for the provided key, the old value is
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/base/lbnPolicy.c#1 $
+ */
+
+#include "lbnPolicy.h"
+
+#include "logger.h"
+#include "memoryAlloc.h"
+#include "numeric.h"
+
+#include "statusCodes.h"
+
+/** A range of logical blocks which share a policy */
+typedef struct {
+  /** The first block of the range */
+  LogicalBlockNumber start;
+  /** The block after the last block of the range */
+  LogicalBlockNumber end;
+  /** The policy for the range */
+  LBNPolicy          policy;
+} LBNPolicyRange;
+
+struct lbnPolicyTable {
+  /** The number of ranges */
+  size_t         count;
+  /** The ranges, in order, none of them empty, overlapping, or default */
+  LBNPolicyRange ranges[];
+};
+
+/**
+ * Append a range to a table being built, merging it into the last range if
+ * they are adjacent and share a policy, and dropping it if it is empty or
+ * has the default policy.
+ *
+ * @param table   The table being built
+ * @param start   The first block of the range
+ * @param end     The block after the last block of the range
+ * @param policy  The policy for the range
+ **/
+static void appendRange(LBNPolicyTable     *table,
+                        LogicalBlockNumber  start,
+                        LogicalBlockNumber  end,
+                        LBNPolicy           policy)
+{
+  if ((start >= end) || (policy == LBN_POLICY_DEFAULT)) {
+    return;
+  }
+
+  if (table->count > 0) {
+    LBNPolicyRange *last = &table->ranges[table->count - 1];
+    if ((last->end == start) && (last->policy == policy)) {
+      last->end = end;
+      return;
+    }
+  }
+
+  table->ranges[table->count++] = (LBNPolicyRange) {
+    .start  = start,
+    .end    = end,
+    .policy = policy,
+  };
+}
+
+/**********************************************************************/
+int makeLBNPolicyTable(const LBNPolicyTable  *table,
+                       LogicalBlockNumber     start,
+                       BlockCount             count,
+                       LBNPolicy              policy,
+                       LBNPolicyTable       **tablePtr)
+{
+  size_t oldCount = ((table == NULL) ? 0 : table->count);
+  // The new range can split at most one old range in two.
+  LBNPolicyTable *newTable;
+  int result = ALLOCATE_EXTENDED(LBNPolicyTable, oldCount + 2, LBNPolicyRange,
+                                 __func__, &newTable);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  // Old ranges are clipped to the parts before and after the new range.
+  LogicalBlockNumber end = start + count;
+  for (size_t i = 0; i < oldCount; i++) {
+    const LBNPolicyRange *range = &table->ranges[i];
+    appendRange(newTable, range->start, minUInt64(range->end, start),
+                range->policy);
+  }
+  appendRange(newTable, start, end, policy);
+  for (size_t i = 0; i < oldCount; i++) {
+    const LBNPolicyRange *range = &table->ranges[i];
+    appendRange(newTable, ((range->start > end) ? range->start : end),
+                range->end, range->policy);
+  }
+
+  if (newTable->count > MAX_LBN_POLICY_RANGES) {
+    FREE(newTable);
+    return logErrorWithStringError(VDO_OUT_OF_RANGE,
+                                   "LBN policy table would hold more than %u"
+                                   " ranges", MAX_LBN_POLICY_RANGES);
+  }
+
+  if (newTable->count == 0) {
+    FREE(newTable);
+    newTable = NULL;
+  }
+
+  *tablePtr = newTable;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void freeLBNPolicyTable(LBNPolicyTable **tablePtr)
+{
+  FREE(*tablePtr);
+  *tablePtr = NULL;
+}
+
+/**********************************************************************/
+LBNPolicy getLBNPolicy(const LBNPolicyTable *table, LogicalBlockNumber lbn)
+{
+  if (table == NULL) {
+    return LBN_POLICY_DEFAULT;
+  }
+
+  // Find the first range which ends after the block.
+  size_t low  = 0;
+  size_t high = table->count;
+  while (low < high) {
+    size_t middle = low + ((high - low) / 2);
+    if (table->ranges[middle].end <= lbn) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  if ((low < table->count) && (table->ranges[low].start <= lbn)) {
+    return table->ranges[low].policy;
+  }
+  return LBN_POLICY_DEFAULT;
+}
+
+/**********************************************************************/
+void logLBNPolicyTable(const LBNPolicyTable *table)
+{
+  if (table == NULL) {
+    logInfo("LBN policy: dedupe and compression on for all blocks");
+    return;
+  }
+
+  for (size_t i = 0; i < table->count; i++) {
+    const LBNPolicyRange *range = &table->ranges[i];
+    logInfo("LBN policy: blocks %" PRIu64 "-%" PRIu64 " dedupe %s"
+            " compression %s", range->start, range->end - 1,
+            (((range->policy & LBN_POLICY_DEDUPE) != 0) ? "on" : "off"),
+            (((range->policy & LBN_POLICY_COMPRESS) != 0) ? "on" : "off"));
+  }
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/base/lbnPolicy.h#1 $
+ */
+
+#ifndef LBN_POLICY_H
+#define LBN_POLICY_H
+
+#include "types.h"
+
+/**
+ * What the write path may do with data written to a logical block; a set
+ * of flags.
+ **/
+typedef enum {
+  /** The block may be deduplicated, and is named to the index */
+  LBN_POLICY_DEDUPE   = 1 << 0,
+  /** The block may be compressed */
+  LBN_POLICY_COMPRESS = 1 << 1,
+  /** The policy of blocks not in any range of a table */
+  LBN_POLICY_DEFAULT  = LBN_POLICY_DEDUPE | LBN_POLICY_COMPRESS,
+} LBNPolicy;
+
+enum {
+  /** The most ranges a policy table may hold */
+  MAX_LBN_POLICY_RANGES = 4096,
+};
+
+/**
+ * An immutable map from ranges of logical blocks to the policy for writes
+ * to them. A NULL table gives every block the default policy.
+ **/
+typedef struct lbnPolicyTable LBNPolicyTable;
+
+/**
+ * Make a policy table which is a copy of another with the policy of a range
+ * of blocks replaced. Adjacent ranges with the same policy are merged, and
+ * ranges with the default policy are dropped.
+ *
+ * @param [in]  table     The table to copy, may be NULL
+ * @param [in]  start     The first block of the range
+ * @param [in]  count     The number of blocks in the range
+ * @param [in]  policy    The policy for the range
+ * @param [out] tablePtr  A pointer to hold the new table, which is NULL if
+ *                        the new table would be empty
+ *
+ * @return VDO_SUCCESS, VDO_OUT_OF_RANGE if the table would hold too many
+ *         ranges, or an error
+ **/
+int makeLBNPolicyTable(const LBNPolicyTable  *table,
+                       LogicalBlockNumber     start,
+                       BlockCount             count,
+                       LBNPolicy              policy,
+                       LBNPolicyTable       **tablePtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free a policy table and null out the reference to it.
+ *
+ * @param tablePtr  The reference to the table to free
+ **/
+void freeLBNPolicyTable(LBNPolicyTable **tablePtr);
+
+/**
+ * Get the policy for writes to a logical block.
+ *
+ * @param table  The policy table, may be NULL
+ * @param lbn    The logical block
+ *
+ * @return The policy for the block
+ **/
+LBNPolicy getLBNPolicy(const LBNPolicyTable *table, LogicalBlockNumber lbn)
+  __attribute__((warn_unused_result));
+
+/**
+ * Log the ranges of a policy table.
+ *
+ * @param table  The policy table, may be NULL
+ **/
+void logLBNPolicyTable(const LBNPolicyTable *table);
+
+#endif // LBN_POLICY_H
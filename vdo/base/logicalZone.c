@@ -33,7 +33,9 @@
 #include "constants.h"
 #include "dataVIO.h"
 #include "flush.h"
+#include "hotBlockSketch.h"
 #include "intMap.h"
+#include "slabDepot.h"
 #include "vdoInternal.h"
 
 struct logicalZone {
@@ -70,6 +72,14 @@ struct logicalZone {
   AdminState          state;
   /** The selector for determining which physical zone to allocate from */
   AllocationSelector *selector;
+  /** The policy table for writes in this zone */
+  const LBNPolicyTable *policy;
+  /** The number of queued writes absorbed by later writes */
+  Atomic64            writesAbsorbed;
+  /** The sketch of recent writes for spotting hot blocks */
+  HotBlockSketch     *hotBlocks;
+  /** The number of writes to hot blocks not deduplicated or compressed */
+  Atomic64            hotWritesBypassed;
 };
 
 struct logicalZones {
@@ -77,6 +87,10 @@ struct logicalZones {
   VDO           *vdo;
   /** The manager for administrative actions */
   ActionManager *manager;
+  /** The policy table all the zones share once any change is complete */
+  LBNPolicyTable *policy;
+  /** The policy table the zones are switching to */
+  LBNPolicyTable *nextPolicy;
   /** The number of zones */
   ZoneCount      zoneCount;
   /** The logical zones themselves */
@@ -140,9 +154,23 @@ static int initializeZone(LogicalZones *zones, ZoneCount zoneNumber)
   zone->blockMapZone = getBlockMapZone(vdo->blockMap, zoneNumber);
   initializeRing(&zone->writeVIOs);
   atomicStore64(&zone->oldestLockedGeneration, 0);
+  atomicStore64(&zone->writesAbsorbed, 0);
+  atomicStore64(&zone->hotWritesBypassed, 0);
+  result = makeHotBlockSketch(&zone->hotBlocks);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
 
+  // A logical zone's writes are one stream as far as the physical zones can
+  // tell, so to keep them together, the stream stays on a zone until it has
+  // made a slab's worth of allocations there.
+  BlockCount allocationsPerZone
+    = ((getConfiguredAllocationPolicy(vdo) == ALLOCATION_POLICY_LOCALITY)
+       ? getSlabConfig(vdo->depot)->dataBlocks
+       : DEFAULT_ALLOCATIONS_PER_ZONE);
   return makeAllocationSelector(getThreadConfig(vdo)->physicalZoneCount,
-                                zone->threadID, &zone->selector);
+                                zone->threadID, allocationsPerZone,
+                                &zone->selector);
 }
 
 /**********************************************************************/
@@ -195,10 +223,12 @@ void freeLogicalZones(LogicalZones **zonesPtr)
   for (ZoneCount index = 0; index < zones->zoneCount; index++) {
     LogicalZone *zone = &zones->zones[index];
     freeAllocationSelector(&zone->selector);
+    freeHotBlockSketch(&zone->hotBlocks);
     destroyEnqueueable(&zone->completion);
     freeIntMap(&zone->lbnOperations);
   }
 
+  freeLBNPolicyTable(&zones->policy);
   FREE(zones);
   *zonesPtr = NULL;
 }
@@ -278,6 +308,113 @@ void resumeLogicalZones(LogicalZones *zones, VDOCompletion *parent)
                     resumeLogicalZone, NULL, parent);
 }
 
+/**********************************************************************/
+const LBNPolicyTable *getLBNPolicyTable(const LogicalZones *zones)
+{
+  return zones->policy;
+}
+
+/**
+ * Take the new policy table from the action context, since the context is
+ * not available to the conclusion.
+ *
+ * <p>Implements ActionPreamble.
+ **/
+static void startPolicyChange(void *context, VDOCompletion *parent)
+{
+  LogicalZones *zones = context;
+  zones->nextPolicy   = getCurrentActionContext(zones->manager);
+  completeCompletion(parent);
+}
+
+/**
+ * Switch a logical zone to the new policy table.
+ *
+ * <p>Implements ZoneAction.
+ **/
+static void setZonePolicy(void          *context,
+                          ZoneCount      zoneNumber,
+                          VDOCompletion *parent)
+{
+  LogicalZone *zone = getLogicalZone(context, zoneNumber);
+  zone->policy = zone->zones->nextPolicy;
+  completeCompletion(parent);
+}
+
+/**
+ * Free the old policy table now that no zone is using it.
+ *
+ * <p>Implements ActionConclusion.
+ **/
+static int finishPolicyChange(void *context)
+{
+  LogicalZones *zones = context;
+  freeLBNPolicyTable(&zones->policy);
+  zones->policy     = zones->nextPolicy;
+  zones->nextPolicy = NULL;
+  logLBNPolicyTable(zones->policy);
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void setLBNPolicyTable(LogicalZones   *zones,
+                       LBNPolicyTable *table,
+                       VDOCompletion  *parent)
+{
+  scheduleOperationWithContext(zones->manager, ADMIN_STATE_OPERATING,
+                               startPolicyChange, setZonePolicy,
+                               finishPolicyChange, table, parent);
+}
+
+/**********************************************************************/
+LBNPolicy getLogicalZonePolicy(const LogicalZone  *zone,
+                               LogicalBlockNumber  lbn)
+{
+  return getLBNPolicy(zone->policy, lbn);
+}
+
+/**********************************************************************/
+LBNPolicy applyHotBlockPolicy(LogicalZone        *zone,
+                              LogicalBlockNumber  lbn,
+                              LBNPolicy           policy)
+{
+  assertOnZoneThread(zone, __func__);
+  if (!recordHotBlockWrite(zone->hotBlocks, lbn)
+      || ((policy & LBN_POLICY_DEFAULT) == 0)) {
+    return policy;
+  }
+
+  relaxedAdd64(&zone->hotWritesBypassed, 1);
+  return (policy & ~LBN_POLICY_DEFAULT);
+}
+
+/**********************************************************************/
+void recordAbsorbedWrite(LogicalZone *zone)
+{
+  assertOnZoneThread(zone, __func__);
+  relaxedAdd64(&zone->writesAbsorbed, 1);
+}
+
+/**********************************************************************/
+uint64_t getAbsorbedWriteCount(const LogicalZones *zones)
+{
+  uint64_t total = 0;
+  for (ZoneCount zone = 0; zone < zones->zoneCount; zone++) {
+    total += relaxedLoad64(&zones->zones[zone].writesAbsorbed);
+  }
+  return total;
+}
+
+/**********************************************************************/
+uint64_t getHotWriteBypassCount(const LogicalZones *zones)
+{
+  uint64_t total = 0;
+  for (ZoneCount zone = 0; zone < zones->zoneCount; zone++) {
+    total += relaxedLoad64(&zones->zones[zone].hotWritesBypassed);
+  }
+  return total;
+}
+
 /**********************************************************************/
 ThreadID getLogicalZoneThreadID(const LogicalZone *zone)
 {
@@ -24,6 +24,7 @@
 
 #include "adminState.h"
 #include "intMap.h"
+#include "lbnPolicy.h"
 #include "types.h"
 
 /**
@@ -74,6 +75,91 @@ void drainLogicalZones(LogicalZones   *zones,
  **/
 void resumeLogicalZones(LogicalZones *zones, VDOCompletion *parent);
 
+/**
+ * Get the LBN policy table shared by a set of logical zones. It is only
+ * replaced by setLBNPolicyTable(), so it may be read from any thread which
+ * serializes its calls to that function.
+ *
+ * @param zones  The logical zones
+ *
+ * @return The policy table, which may be NULL
+ **/
+const LBNPolicyTable *getLBNPolicyTable(const LogicalZones *zones)
+  __attribute__((warn_unused_result));
+
+/**
+ * Give each logical zone a new LBN policy table. Once every zone uses it,
+ * the old table is freed. Must be called from the admin thread.
+ *
+ * @param zones   The logical zones
+ * @param table   The new policy table, which the zones take ownership of
+ *                once the parent is notified with VDO_SUCCESS, may be NULL
+ * @param parent  The object to notify when the zones use the new table
+ **/
+void setLBNPolicyTable(LogicalZones   *zones,
+                       LBNPolicyTable *table,
+                       VDOCompletion  *parent);
+
+/**
+ * Get the policy for a write to a logical block. Must be called from the
+ * thread of the zone.
+ *
+ * @param zone  The logical zone of the block
+ * @param lbn   The logical block
+ *
+ * @return The policy for the block
+ **/
+LBNPolicy getLogicalZonePolicy(const LogicalZone  *zone,
+                               LogicalBlockNumber  lbn)
+  __attribute__((warn_unused_result));
+
+/**
+ * Note a write to a logical block in its zone's sketch of recent writes and
+ * adjust the write's policy accordingly. A block which is being rewritten so
+ * often that its data is unlikely to outlive the work is neither
+ * deduplicated nor compressed. Must be called from the thread of the zone.
+ *
+ * @param zone    The logical zone of the block
+ * @param lbn     The logical block being written
+ * @param policy  The policy for the block
+ *
+ * @return The policy to use for this write
+ **/
+LBNPolicy applyHotBlockPolicy(LogicalZone        *zone,
+                              LogicalBlockNumber  lbn,
+                              LBNPolicy           policy)
+  __attribute__((warn_unused_result));
+
+/**
+ * Record that a queued write in a logical zone was absorbed by a later write
+ * to the same logical block. Must be called from the thread of the zone.
+ *
+ * @param zone  The logical zone of the block
+ **/
+void recordAbsorbedWrite(LogicalZone *zone);
+
+/**
+ * Get the number of writes absorbed in any of a set of logical zones.
+ *
+ * @param zones  The logical zones
+ *
+ * @return The total number of absorbed writes
+ **/
+uint64_t getAbsorbedWriteCount(const LogicalZones *zones)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the number of writes to hot blocks which were neither deduplicated nor
+ * compressed in any of a set of logical zones.
+ *
+ * @param zones  The logical zones
+ *
+ * @return The total number of hot writes which bypassed dedupe and
+ *         compression
+ **/
+uint64_t getHotWriteBypassCount(const LogicalZones *zones)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the ID of a logical zone's thread.
  *
@@ -373,7 +373,8 @@ static inline int LZ4_compressCtx(void** ctx,
                  const char* source,
                  char* dest,
                  int isize,
-                 int maxOutputSize)
+                 int maxOutputSize,
+                 int acceleration)
 {
 #if HEAPMODE
     struct refTables *srt = (struct refTables *) (*ctx);
@@ -414,7 +415,7 @@ static inline int LZ4_compressCtx(void** ctx,
     // Main Loop
     for ( ; ; )
     {
-        int findMatchAttempts = (1U << skipStrength) + 3;
+        int findMatchAttempts = (acceleration << skipStrength) + 3;
         const BYTE* forwardIp = ip;
         const BYTE* ref;
         BYTE* token;
@@ -534,7 +535,8 @@ static inline int LZ4_compress64kCtx(void** ctx,
                  const char* source,
                  char* dest,
                  int isize,
-                 int maxOutputSize)
+                 int maxOutputSize,
+                 int acceleration)
 {
 #if HEAPMODE
     struct refTables *srt = (struct refTables *) (*ctx);
@@ -574,7 +576,7 @@ static inline int LZ4_compress64kCtx(void** ctx,
     // Main Loop
     for ( ; ; )
     {
-        int findMatchAttempts = (1U << skipStrength) + 3;
+        int findMatchAttempts = (acceleration << skipStrength) + 3;
         const BYTE* forwardIp = ip;
         const BYTE* ref;
         BYTE* token;
@@ -689,10 +691,26 @@ int LZ4_compress_ctx_limitedOutput(void       *ctx,
                                    int         isize,
                                    int         maxOutputSize)
 {
+  return LZ4_compress_ctx_limitedOutput_accel(ctx, source, dest, isize,
+                                              maxOutputSize, 1);
+}
+
+int LZ4_compress_ctx_limitedOutput_accel(void       *ctx,
+                                         const char *source,
+                                         char       *dest,
+                                         int         isize,
+                                         int         maxOutputSize,
+                                         int         acceleration)
+{
+  if (acceleration < 1) {
+    acceleration = 1;
+  }
   if (isize < LZ4_64KLIMIT) {
-    return LZ4_compress64kCtx(&ctx, source, dest, isize, maxOutputSize);
+    return LZ4_compress64kCtx(&ctx, source, dest, isize, maxOutputSize,
+                              acceleration);
   } else {
-    return LZ4_compressCtx(&ctx, source, dest, isize, maxOutputSize);
+    return LZ4_compressCtx(&ctx, source, dest, isize, maxOutputSize,
+                           acceleration);
   }
 }
 
@@ -880,6 +898,187 @@ _output_error:
     return (int) (-(((char*)ip)-source));
 }
 
+//**************************************
+// Known output size decoding
+//**************************************
+// Distance from the end of the output within which a match is copied with
+// care rather than with 8-byte steps.
+#define MATCH_SAFEGUARD_DISTANCE ((2 * COPYLENGTH) - MINMATCH)
+
+static inline void LZ4_wildCopy8(BYTE* d, const BYTE* s, BYTE* const e)
+{
+    // May write up to COPYLENGTH - 1 bytes beyond e.
+    do { memcpy(d, s, 8); d += 8; s += 8; } while (d < e);
+}
+
+static inline U16 LZ4_readLE16(const BYTE* p)
+{
+#if (defined(LZ4_BIG_ENDIAN) && !defined(BIG_ENDIAN_NATIVE_BUT_INCOMPATIBLE))
+    return (U16) (p[0] + (p[1] << 8));
+#else
+    return A16(p);
+#endif
+}
+
+int LZ4_uncompress_knownOutputSize(
+                const char* source,
+                char* dest,
+                int isize,
+                int osize)
+{
+    const BYTE* ip = (const BYTE*) source;
+    const BYTE* const iend = ip + isize;
+
+    BYTE* op = (BYTE*) dest;
+    BYTE* const oend = op + osize;
+    BYTE* cpy;
+
+    // The shortcut below reads 16 bytes of literals and a 2-byte offset, and
+    // writes 16 bytes of literals and an 18-byte match.
+    const BYTE* const shortiend = iend - 14 - 2;
+    const BYTE* const shortoend = oend - 14 - 18;
+
+    static const unsigned inc32table[8] = {0, 1, 2, 1, 0, 4, 4, 4};
+    static const int dec64table[8] = {0, 0, 0, -1, -4, 1, 2, 3};
+
+    if ((isize <= 0) || (osize <= 0)) goto _output_error;
+
+    // Main Loop
+    while (1)
+    {
+        const BYTE* match;
+        size_t offset;
+        unsigned token = *ip++;
+        size_t length = token >> ML_BITS;
+
+        // Shortcut for the common case of a short literal run followed by a
+        // short match, far from the ends of both buffers: copy both with a
+        // fixed number of wide moves. This is tested first, so that the
+        // bounds of other sequences are only checked once.
+        if ((length != RUN_MASK)
+            && likely((ip < shortiend) & (op <= shortoend)))
+        {
+            memcpy(op, ip, 16);
+            op += length; ip += length;
+
+            length = token & ML_MASK;
+            offset = LZ4_readLE16(ip); ip += 2;
+            match = op - offset;
+            if ((length != ML_MASK) && (offset >= 8)
+                && (offset <= (size_t) (op - (BYTE*) dest)))
+            {
+                memcpy(op, match, 8);
+                memcpy(op + 8, match + 8, 8);
+                memcpy(op + 16, match + 16, 2);
+                op += length + MINMATCH;
+                continue;
+            }
+
+            // The literals are done; decode the match the long way.
+            goto _copy_match;
+        }
+
+        // get runlength
+        if (length == RUN_MASK)
+        {
+            unsigned s;
+            if (ip >= iend - RUN_MASK) goto _output_error;
+            do
+            {
+                if (ip >= iend) goto _output_error;
+                s = *ip++;
+                length += s;
+            } while (s == 255);
+            if ((size_t) (oend - op) < length) goto _output_error;
+        }
+
+        // copy literals
+        cpy = op + length;
+        if ((cpy > oend - MFLIMIT) || (ip + length > iend - (2 + 1 + LASTLITERALS)))
+        {
+            // The last literals must consume all input and fill all output.
+            if ((ip + length != iend) || (cpy != oend)) goto _output_error;
+            memmove(op, ip, length);
+            op += length;
+            break;
+        }
+        LZ4_wildCopy8(op, ip, cpy);
+        ip += length; op = cpy;
+
+        // get offset
+        offset = LZ4_readLE16(ip); ip += 2;
+        match = op - offset;
+
+        // get matchlength
+        length = token & ML_MASK;
+
+    _copy_match:
+        if (length == ML_MASK)
+        {
+            unsigned s;
+            do
+            {
+                s = *ip++;
+                length += s;
+                if (ip > iend - LASTLITERALS) goto _output_error;
+            } while (s == 255);
+            if ((size_t) (oend - op) < length) goto _output_error;
+        }
+        length += MINMATCH;
+
+        // Error : offset creates reference outside of destination buffer
+        if ((offset == 0) || (offset > (size_t) (op - (BYTE*) dest))) goto _output_error;
+
+        // copy repeated sequence
+        cpy = op + length;
+        if (unlikely(offset < 8))
+        {
+            // Expand the first 8 bytes so that the rest of the match is at
+            // least 8 bytes behind the output.
+            op[0] = match[0];
+            op[1] = match[1];
+            op[2] = match[2];
+            op[3] = match[3];
+            match += inc32table[offset];
+            memcpy(op + 4, match, 4);
+            match -= dec64table[offset];
+        }
+        else
+        {
+            memcpy(op, match, 8);
+            match += 8;
+        }
+        op += 8;
+
+        if (unlikely(cpy > oend - MATCH_SAFEGUARD_DISTANCE))
+        {
+            BYTE* const oCopyLimit = oend - (COPYLENGTH - 1);
+            // Error : the last LASTLITERALS bytes must be literals
+            if (cpy > oend - LASTLITERALS) goto _output_error;
+            if (op < oCopyLimit)
+            {
+                LZ4_wildCopy8(op, match, oCopyLimit);
+                match += oCopyLimit - op;
+                op = oCopyLimit;
+            }
+            while (op < cpy) *op++ = *match++;
+        }
+        else
+        {
+            memcpy(op, match, 8);
+            if (length > 16) LZ4_wildCopy8(op + 8, match + 8, cpy);
+        }
+        op = cpy;   // correction
+    }
+
+    // end of decoding
+    return (int) (((char*)op)-dest);
+
+    // write overflow error detected
+_output_error:
+    return (int) (-(((char*)ip)-source)) - 1;
+}
+
 int LZ4_context_size(void)
 {
 	return sizeof(struct refTables);
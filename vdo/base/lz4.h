@@ -84,6 +84,31 @@ int LZ4_compress_ctx_limitedOutput(void       *ctx,
                                    int         isize,
                                    int         maxOutputSize);
 
+/**
+ * Compress like LZ4_compress_ctx_limitedOutput, but trade compression ratio
+ * for speed.  The match finder starts out skipping ahead 'acceleration'
+ * bytes at a time when it is not finding matches, so larger values are
+ * faster on poorly compressible data.  The output is ordinary LZ4 and is
+ * decoded by LZ4_uncompress_unknownOutputSize.
+ *
+ * @param ctx            Scratch space that will not fit on the stack
+ * @param source         Input data
+ * @param dest           Output data
+ * @param isize          Input size. Max supported value is ~1.9GB
+ * @param maxOutputSize  Size of the destination buffer
+ * @param acceleration   The acceleration factor; 1 (or less) is the default
+ *                       LZ4 behavior
+ *
+ * @return the number of bytes written in buffer 'dest' or 0 if the
+ *         compression fails
+ **/
+int LZ4_compress_ctx_limitedOutput_accel(void       *ctx,
+                                         const char *source,
+                                         char       *dest,
+                                         int         isize,
+                                         int         maxOutputSize,
+                                         int         acceleration);
+
 /**
  * Return the size of the "ctx" block needed by the compression method.
  *
@@ -112,4 +137,25 @@ int LZ4_uncompress_unknownOutputSize(const char *source,
                                      int         isize,
                                      int         maxOutputSize);
 
+/**
+ * Uncompress 'isize' bytes from 'source' into an output buffer 'dest' which
+ * they must exactly fill. This is faster than
+ * LZ4_uncompress_unknownOutputSize, copying literals and matches in wide,
+ * possibly overlapping steps, and is equally protected against malicious
+ * data packets: it never reads beyond source + isize nor writes beyond
+ * dest + osize.
+ *
+ * @param source  Input data
+ * @param dest    Output data
+ * @param isize   Input size, therefore the compressed size
+ * @param osize   The exact size of the uncompressed data
+ *
+ * @return osize, or, if the source stream is malformed or does not
+ *         uncompress to exactly osize bytes, a negative result
+ **/
+int LZ4_uncompress_knownOutputSize(const char *source,
+                                   char       *dest,
+                                   int         isize,
+                                   int         osize);
+
 #endif // LZ4_H
@@ -23,17 +23,42 @@
 
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "numeric.h"
+#include "timeUtils.h"
 
+#include "actionManager.h"
 #include "adminState.h"
 #include "allocatingVIO.h"
 #include "allocationSelector.h"
 #include "compressionState.h"
 #include "dataVIO.h"
 #include "hashLock.h"
+#include "numUtils.h"
 #include "pbnLock.h"
 #include "vdo.h"
 #include "vdoInternal.h"
 
+enum {
+  /**
+   * The moving averages of arrivals weight each new sample by one over two
+   * to this power, and are stored scaled up by the same factor.
+   **/
+  ARRIVAL_AVERAGE_SHIFT = 3,
+  /** The shortest time the adaptive policy lets a bin wait (microseconds) */
+  MINIMUM_BIN_WAIT      = 100,
+  /** The longest time the adaptive policy lets a bin wait (microseconds) */
+  MAXIMUM_BIN_WAIT      = 5000,
+};
+
+struct packerZones {
+  /** The manager for administrative actions */
+  ActionManager *manager;
+  /** The number of zones */
+  ZoneCount      zoneCount;
+  /** The packers themselves */
+  Packer        *packers[];
+};
+
 /**
  * Check that we are on the packer thread.
  *
@@ -178,6 +203,7 @@ static int makeOutputBin(Packer *packer, PhysicalLayer *layer)
 
   // Add the bin to the stack even before it's fully initialized so it will
   // be freed even if we fail to initialize it below.
+  output->packer = packer;
   initializeRing(&output->ring);
   pushRingNode(&packer->outputBins, &output->ring);
   pushOutputBin(packer, output);
@@ -218,6 +244,7 @@ int makePacker(PhysicalLayer       *layer,
                BlockCount           inputBinCount,
                BlockCount           outputBinCount,
                const ThreadConfig  *threadConfig,
+               ZoneCount            zoneNumber,
                Packer             **packerPtr)
 {
   Packer *packer;
@@ -227,7 +254,8 @@ int makePacker(PhysicalLayer       *layer,
     return result;
   }
 
-  packer->threadID       = getPackerZoneThread(threadConfig);
+  packer->zoneNumber     = zoneNumber;
+  packer->threadID       = getPackerZoneThread(threadConfig, zoneNumber);
   packer->binDataSize    = VDO_BLOCK_SIZE - sizeof(CompressedBlockHeader);
   packer->size           = inputBinCount;
   packer->maxSlots       = MAX_COMPRESSION_SLOTS;
@@ -236,7 +264,9 @@ int makePacker(PhysicalLayer       *layer,
   initializeRing(&packer->outputBins);
 
   result = makeAllocationSelector(threadConfig->physicalZoneCount,
-                                  packer->threadID, &packer->selector);
+                                  packer->threadID,
+                                  DEFAULT_ALLOCATIONS_PER_ZONE,
+                                  &packer->selector);
   if (result != VDO_SUCCESS) {
     freePacker(&packer);
     return result;
@@ -300,16 +330,90 @@ void freePacker(Packer **packerPtr)
   *packerPtr = NULL;
 }
 
+/**
+ * Implements ZoneThreadGetter
+ **/
+static ThreadID getThreadIDForZone(void *context, ZoneCount zoneNumber)
+{
+  return getPackerThreadID(getPackerZone(context, zoneNumber));
+}
+
+/**********************************************************************/
+int makePackerZones(PhysicalLayer       *layer,
+                    BlockCount           inputBinCount,
+                    BlockCount           outputBinCount,
+                    const ThreadConfig  *threadConfig,
+                    PackerZones        **zonesPtr)
+{
+  PackerZones *zones;
+  int result = ALLOCATE_EXTENDED(PackerZones, threadConfig->packerZoneCount,
+                                 Packer *, __func__, &zones);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  zones->zoneCount = threadConfig->packerZoneCount;
+  for (ZoneCount zone = 0; zone < zones->zoneCount; zone++) {
+    result = makePacker(layer, inputBinCount, outputBinCount, threadConfig,
+                        zone, &zones->packers[zone]);
+    if (result != VDO_SUCCESS) {
+      freePackerZones(&zones);
+      return result;
+    }
+  }
+
+  result = makeActionManager(zones->zoneCount, getThreadIDForZone,
+                             getAdminThread(threadConfig), zones, NULL,
+                             layer, &zones->manager);
+  if (result != VDO_SUCCESS) {
+    freePackerZones(&zones);
+    return result;
+  }
+
+  *zonesPtr = zones;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void freePackerZones(PackerZones **zonesPtr)
+{
+  PackerZones *zones = *zonesPtr;
+  if (zones == NULL) {
+    return;
+  }
+
+  freeActionManager(&zones->manager);
+  for (ZoneCount zone = 0; zone < zones->zoneCount; zone++) {
+    freePacker(&zones->packers[zone]);
+  }
+
+  FREE(zones);
+  *zonesPtr = NULL;
+}
+
+/**********************************************************************/
+ZoneCount getPackerZoneCount(const PackerZones *zones)
+{
+  return zones->zoneCount;
+}
+
+/**********************************************************************/
+Packer *getPackerZone(PackerZones *zones, ZoneCount zoneNumber)
+{
+  return (zoneNumber < zones->zoneCount) ? zones->packers[zoneNumber] : NULL;
+}
+
 /**
  * Get the Packer from a DataVIO.
  *
  * @param dataVIO  The DataVIO
  *
- * @return The Packer from the VDO to which the DataVIO belongs
+ * @return The Packer of the zone which handles the DataVIO
  **/
 static inline Packer *getPackerFromDataVIO(DataVIO *dataVIO)
 {
-  return getVDOFromDataVIO(dataVIO)->packer;
+  return getPackerZone(getVDOFromDataVIO(dataVIO)->packerZones,
+                       getPackerZoneNumber(dataVIO));
 }
 
 /**********************************************************************/
@@ -326,18 +430,72 @@ ThreadID getPackerThreadID(Packer *packer)
 }
 
 /**********************************************************************/
-PackerStatistics getPackerStatistics(const Packer *packer)
+PackerStatistics getPackerStatistics(const PackerZones *zones)
 {
   /*
    * This is called from getVDOStatistics(), which is called from outside the
-   * packer thread. These are just statistics with no semantics that could
+   * packer threads. These are just statistics with no semantics that could
    * rely on memory order, so unfenced reads are sufficient.
    */
-  return (PackerStatistics) {
-    .compressedFragmentsWritten  = relaxedLoad64(&packer->fragmentsWritten),
-    .compressedBlocksWritten     = relaxedLoad64(&packer->blocksWritten),
-    .compressedFragmentsInPacker = relaxedLoad64(&packer->fragmentsPending),
+  PackerStatistics stats = {
+    .compressedFragmentsWritten  = 0,
+    .compressedBlocksWritten     = 0,
+    .compressedFragmentsInPacker = 0,
   };
+  for (ZoneCount zone = 0; zone < zones->zoneCount; zone++) {
+    Packer *packer = zones->packers[zone];
+    stats.compressedFragmentsWritten
+      += relaxedLoad64(&packer->fragmentsWritten);
+    stats.compressedBlocksWritten  += relaxedLoad64(&packer->blocksWritten);
+    stats.compressedFragmentsInPacker
+      += relaxedLoad64(&packer->fragmentsPending);
+  }
+  return stats;
+}
+
+/**********************************************************************/
+void getPackerHistograms(const PackerZones *zones,
+                         PackerHistograms  *histograms)
+{
+  // As with the statistics, unfenced reads are sufficient here.
+  for (unsigned int i = 0; i < PACKER_HISTOGRAM_BUCKETS; i++) {
+    histograms->packedSpace[i] = 0;
+    histograms->waitTime[i]    = 0;
+    histograms->slotsUsed[i]   = 0;
+    for (ZoneCount zone = 0; zone < zones->zoneCount; zone++) {
+      Packer *packer = zones->packers[zone];
+      histograms->packedSpace[i] += relaxedLoad64(&packer->packedSpace[i]);
+      histograms->waitTime[i]    += relaxedLoad64(&packer->waitTime[i]);
+      histograms->slotsUsed[i]   += relaxedLoad64(&packer->slotsUsed[i]);
+    }
+  }
+}
+
+/**********************************************************************/
+void setPackerPolicy(PackerZones *zones, PackerPolicy policy)
+{
+  for (ZoneCount zone = 0; zone < zones->zoneCount; zone++) {
+    relaxedStore32(&zones->packers[zone]->policy, policy);
+  }
+}
+
+/**
+ * Get the policy one packer is using for writing partially filled bins.
+ *
+ * @param packer  The packer
+ *
+ * @return The packer's current policy
+ **/
+static inline PackerPolicy getPolicy(const Packer *packer)
+{
+  return relaxedLoad32(&packer->policy);
+}
+
+/**********************************************************************/
+PackerPolicy getPackerPolicy(const PackerZones *zones)
+{
+  // All of the packers always share a policy.
+  return getPolicy(zones->packers[0]);
 }
 
 /**
@@ -393,8 +551,8 @@ static void writePendingBatches(Packer *packer);
 __attribute__((warn_unused_result))
 static bool switchToPackerThread(VDOCompletion *completion)
 {
-  VIO      *vio      = asVIO(completion);
-  ThreadID  threadID = vio->vdo->packer->threadID;
+  OutputBin *bin      = completion->parent;
+  ThreadID   threadID = bin->packer->threadID;
   if (completion->callbackThreadID == threadID) {
     return true;
   }
@@ -446,8 +604,9 @@ static void completeOutputBin(VDOCompletion *completion)
                         vio->physical);
   }
 
-  Packer *packer = vio->vdo->packer;
-  finishOutputBin(packer, completion->parent);
+  OutputBin *bin    = completion->parent;
+  Packer    *packer = bin->packer;
+  finishOutputBin(packer, bin);
   writePendingBatches(packer);
   checkForDrainComplete(packer);
 }
@@ -545,24 +704,78 @@ static void continueAfterAllocation(AllocatingVIO *allocatingVIO)
 }
 
 /**
- * Launch an output bin.
+ * Allocate blocks for a run of output bins one after another on the physical
+ * zone thread, so that nothing else allocates between them and the bins get
+ * consecutive free blocks of the zone's open slab. Their writes then reach
+ * the device in PBN order, adjacent to each other, and can be merged. This
+ * callback is registered in launchCompressedWrites().
  *
- * @param packer  The packer which owns the bin
- * @param bin     The output bin to launch
+ * @param completion  The writer of the first bin of the run
+ **/
+static void allocateCompressedRun(VDOCompletion *completion)
+{
+  OutputBin    *bin  = completion->parent;
+  PhysicalZone *zone = bin->writer->zone;
+  while (bin != NULL) {
+    OutputBin *next = bin->nextInRun;
+    bin->nextInRun  = NULL;
+    allocateDataBlockInZone(bin->writer, zone, VIO_COMPRESSED_WRITE_LOCK,
+                            continueAfterAllocation);
+    bin = next;
+  }
+}
+
+/**
+ * Launch a run of packed output bins, linked through their nextInRun fields.
+ *
+ * @param packer  The packer which owns the bins
+ * @param run     The first output bin to launch
  **/
-static void launchCompressedWrite(Packer *packer, OutputBin *bin)
+static void launchCompressedWrites(Packer *packer, OutputBin *run)
 {
-  if (isReadOnly(getVDOFromAllocatingVIO(bin->writer)->readOnlyNotifier)) {
-    finishOutputBin(packer, bin);
+  if (isReadOnly(getVDOFromAllocatingVIO(run->writer)->readOnlyNotifier)) {
+    while (run != NULL) {
+      OutputBin *next = run->nextInRun;
+      run->nextInRun  = NULL;
+      finishOutputBin(packer, run);
+      run = next;
+    }
     return;
   }
 
-  VIO *vio = allocatingVIOAsVIO(bin->writer);
-  resetCompletion(vioAsCompletion(vio));
-  vio->callback = completeOutputBin;
-  vio->priority = VIO_PRIORITY_COMPRESSED_DATA;
-  allocateDataBlock(bin->writer, packer->selector, VIO_COMPRESSED_WRITE_LOCK,
-                    continueAfterAllocation);
+  for (OutputBin *bin = run; bin != NULL; bin = bin->nextInRun) {
+    VIO *vio = allocatingVIOAsVIO(bin->writer);
+    resetCompletion(vioAsCompletion(vio));
+    vio->callback = completeOutputBin;
+    vio->priority = VIO_PRIORITY_COMPRESSED_DATA;
+  }
+
+  if (run->nextInRun == NULL) {
+    allocateDataBlock(run->writer, packer->selector, VIO_COMPRESSED_WRITE_LOCK,
+                      continueAfterAllocation);
+    return;
+  }
+
+  VDO *vdo = getVDOFromAllocatingVIO(run->writer);
+  run->writer->zone
+    = vdo->physicalZones[getNextAllocationZone(packer->selector)];
+  launchPhysicalZoneCallback(run->writer, allocateCompressedRun,
+                             THIS_LOCATION("$F;cb=allocateCompressedRun"));
+}
+
+/**
+ * Clamp a value to the range of packer histogram buckets.
+ *
+ * @param value  The value to bucket
+ *
+ * @return The bucket for the value
+ **/
+static inline unsigned int getHistogramBucket(int64_t value)
+{
+  if (value < 0) {
+    return 0;
+  }
+  return minUInt64(value, PACKER_HISTOGRAM_BUCKETS - 1);
 }
 
 /**
@@ -596,15 +809,15 @@ static void getNextBatch(Packer *packer, OutputBatch *batch)
 
 /**
  * Pack the next batch of compressed VIOs from the batched queue into an
- * output bin and write the output bin.
+ * output bin. The caller must launch the write of the bin.
  *
  * @param packer  The packer
  * @param output  The output bin to fill
  *
- * @return <code>true</code> if a write was issued for the output bin
+ * @return <code>true</code> if the output bin was packed and must be written
  **/
 __attribute__((warn_unused_result))
-static bool writeNextBatch(Packer *packer, OutputBin *output)
+static bool packNextBatch(Packer *packer, OutputBin *output)
 {
   OutputBatch batch;
   getNextBatch(packer, &batch);
@@ -623,13 +836,19 @@ static bool writeNextBatch(Packer *packer, OutputBin *output)
 
   resetCompressedBlockHeader(&output->block->header);
 
-  size_t spaceUsed = 0;
+  uint64_t now       = nowUsec();
+  size_t   spaceUsed = 0;
   for (SlotNumber slot = 0; slot < batch.slotsUsed; slot++) {
     DataVIO *dataVIO = batch.slots[slot];
     dataVIO->compression.slot = slot;
+    uint64_t waited = ((now > dataVIO->compression.arrivalTime)
+                       ? now - dataVIO->compression.arrivalTime : 0);
+    relaxedAdd64(&packer->waitTime[getHistogramBucket(logBaseTwo(waited) + 1)],
+                 1);
     putCompressedBlockFragment(output->block, slot, spaceUsed,
                                dataVIO->compression.data,
-                               dataVIO->compression.size);
+                               dataVIO->compression.size,
+                               dataVIO->compression.tag);
     spaceUsed += dataVIO->compression.size;
 
     int result = enqueueDataVIO(&output->outgoing, dataVIO,
@@ -642,7 +861,9 @@ static bool writeNextBatch(Packer *packer, OutputBin *output)
     output->slotsUsed += 1;
   }
 
-  launchCompressedWrite(packer, output);
+  size_t filled = (spaceUsed * PACKER_HISTOGRAM_BUCKETS) / packer->binDataSize;
+  relaxedAdd64(&packer->packedSpace[getHistogramBucket(filled)], 1);
+  relaxedAdd64(&packer->slotsUsed[getHistogramBucket(batch.slotsUsed)], 1);
   return true;
 }
 
@@ -714,6 +935,9 @@ static void addDataVIOToInputBin(Packer   *packer,
     startNewBatch(packer, bin);
   }
 
+  if (bin->slotsUsed == 0) {
+    bin->firstArrival = dataVIO->compression.arrivalTime;
+  }
   addToInputBin(bin, dataVIO);
   bin->freeSpace -= dataVIO->compression.size;
 
@@ -728,9 +952,9 @@ static void addDataVIOToInputBin(Packer   *packer,
 
 /**
  * Move DataVIOs in pending batches from the batchedDataVIOs to all free output
- * bins, issuing writes for the output bins as they are packed. This will loop
- * until either the pending queue is drained or all output bins are busy
- * writing a compressed block.
+ * bins, and then issue writes for all the bins which were packed as a single
+ * run. This will repeat until either the pending queue is drained or all
+ * output bins are busy writing a compressed block.
  *
  * @param packer  The packer
  **/
@@ -750,18 +974,129 @@ static void writePendingBatches(Packer *packer)
   // return from this function without clearing this flag.
   packer->writingBatches = true;
 
-  OutputBin *output;
-  while (hasWaiters(&packer->batchedDataVIOs)
-         && ((output = popOutputBin(packer)) != NULL)) {
-    if (!writeNextBatch(packer, output)) {
-      // We didn't use the output bin to write, so push it back on the stack.
-      pushOutputBin(packer, output);
+  for (;;) {
+    OutputBin  *run  = NULL;
+    OutputBin **tail = &run;
+    OutputBin  *output;
+    while (hasWaiters(&packer->batchedDataVIOs)
+           && ((output = popOutputBin(packer)) != NULL)) {
+      if (!packNextBatch(packer, output)) {
+        // We didn't use the output bin to write, so put it back on the stack.
+        pushOutputBin(packer, output);
+        continue;
+      }
+
+      *tail = output;
+      tail  = &output->nextInRun;
+    }
+
+    if (run == NULL) {
+      break;
     }
+
+    // Launching may return bins to the stack if their writes finish at once.
+    launchCompressedWrites(packer, run);
   }
 
   packer->writingBatches = false;
 }
 
+/**
+ * Fold a sample into one of the packer's scaled moving averages.
+ *
+ * @param mean    The current scaled average
+ * @param sample  The new sample
+ *
+ * @return The new scaled average
+ **/
+static inline uint64_t updateMean(uint64_t mean, uint64_t sample)
+{
+  return mean - (mean >> ARRIVAL_AVERAGE_SHIFT) + sample;
+}
+
+/**
+ * Update the packer's estimate of the fragment arrival rate.
+ *
+ * @param packer   The packer
+ * @param dataVIO  The DataVIO which has just arrived
+ * @param now      The current time in microseconds
+ **/
+static void recordArrival(Packer *packer, DataVIO *dataVIO, uint64_t now)
+{
+  // Cap the gap so that the estimate recovers quickly from an idle period.
+  uint64_t gap = MAXIMUM_BIN_WAIT;
+  if ((packer->lastArrival != 0) && (now >= packer->lastArrival)) {
+    gap = minUInt64(now - packer->lastArrival, MAXIMUM_BIN_WAIT);
+  }
+
+  packer->lastArrival              = now;
+  packer->meanInterarrival         = updateMean(packer->meanInterarrival, gap);
+  packer->meanFragmentSize         = updateMean(packer->meanFragmentSize,
+                                                dataVIO->compression.size);
+  dataVIO->compression.arrivalTime = now;
+}
+
+/**
+ * Compute how long the adaptive policy should let a bin wait for more
+ * fragments: roughly the time it would take for enough fragments of the
+ * average size to arrive to fill it, within fixed bounds.
+ *
+ * @param packer  The packer
+ * @param bin     The bin
+ *
+ * @return The time the bin may wait after its first arrival (microseconds)
+ **/
+static uint64_t getBinWait(const Packer *packer, const InputBin *bin)
+{
+  uint64_t meanSize = packer->meanFragmentSize >> ARRIVAL_AVERAGE_SHIFT;
+  if (meanSize == 0) {
+    meanSize = 1;
+  }
+  uint64_t needed   = minUInt64(bin->freeSpace / meanSize,
+                                packer->maxSlots - bin->slotsUsed);
+  uint64_t wait     = (needed
+                       * (packer->meanInterarrival >> ARRIVAL_AVERAGE_SHIFT));
+  if (wait < MINIMUM_BIN_WAIT) {
+    return MINIMUM_BIN_WAIT;
+  }
+  return minUInt64(wait, MAXIMUM_BIN_WAIT);
+}
+
+/**
+ * Start new batches in any bins which have waited longer than their adaptive
+ * deadline, and write them out.
+ *
+ * @param packer  The packer
+ * @param now     The current time in microseconds
+ **/
+static void writeExpiredBins(Packer *packer, uint64_t now)
+{
+  InputBin *bin = getFullestBin(packer);
+  while (bin != NULL) {
+    // Starting a batch re-sorts the bin, so find its successor first. The
+    // bin may be visited again, but then it will be empty.
+    InputBin *next = nextBin(packer, bin);
+    if ((bin->slotsUsed > 0)
+        && (now >= bin->firstArrival + getBinWait(packer, bin))) {
+      startNewBatch(packer, bin);
+      insertInSortedList(packer, bin);
+    }
+    bin = next;
+  }
+
+  writePendingBatches(packer);
+}
+
+/**********************************************************************/
+void checkPackerDeadlines(Packer *packer)
+{
+  assertOnPackerThread(packer, __func__);
+  if (isNormal(&packer->state)
+      && (getPolicy(packer) == PACKER_POLICY_ADAPTIVE)) {
+    writeExpiredBins(packer, nowUsec());
+  }
+}
+
 /**
  * Select the input bin that should be used to pack the compressed data in a
  * DataVIO with other DataVIOs.
@@ -848,8 +1183,14 @@ void attemptPacking(DataVIO *dataVIO)
     return;
   }
 
+  uint64_t now = nowUsec();
+  recordArrival(packer, dataVIO, now);
   addDataVIOToInputBin(packer, bin, dataVIO);
-  writePendingBatches(packer);
+  if (getPolicy(packer) == PACKER_POLICY_ADAPTIVE) {
+    writeExpiredBins(packer, now);
+  } else {
+    writePendingBatches(packer);
+  }
 }
 
 /**
@@ -880,6 +1221,27 @@ void flushPacker(Packer *packer)
   }
 }
 
+/**
+ * Flush the packer of one zone.
+ *
+ * <p>Implements ZoneAction.
+ **/
+static void flushPackerZone(void          *context,
+                            ZoneCount      zoneNumber,
+                            VDOCompletion *parent)
+{
+  flushPacker(getPackerZone(context, zoneNumber));
+  finishCompletion(parent, VDO_SUCCESS);
+}
+
+/**********************************************************************/
+void flushPackerZones(PackerZones *zones)
+{
+  // Flushing is asynchronous and nobody waits for it, so if the manager is
+  // busy with a drain (which flushes anyway), the request is just dropped.
+  scheduleAction(zones->manager, NULL, flushPackerZone, NULL, NULL);
+}
+
 /*
  * This method is only exposed for unit tests and should not normally be called
  * directly; use removeLockHolderFromPacker() instead.
@@ -940,21 +1302,49 @@ static void initiateDrain(AdminState *state)
   checkForDrainComplete(packer);
 }
 
-/**********************************************************************/
-void drainPacker(Packer *packer, VDOCompletion *completion)
+/**
+ * Drain the packer of one zone.
+ *
+ * <p>Implements ZoneAction.
+ **/
+static void drainPackerZone(void          *context,
+                            ZoneCount      zoneNumber,
+                            VDOCompletion *parent)
 {
+  Packer *packer = getPackerZone(context, zoneNumber);
   assertOnPackerThread(packer, __func__);
-  startDraining(&packer->state, ADMIN_STATE_SUSPENDING, completion,
+  startDraining(&packer->state, ADMIN_STATE_SUSPENDING, parent,
                 initiateDrain);
 }
 
 /**********************************************************************/
-void resumePacker(Packer *packer, VDOCompletion *parent)
+void drainPackerZones(PackerZones *zones, VDOCompletion *completion)
 {
+  scheduleOperation(zones->manager, ADMIN_STATE_SUSPENDING, NULL,
+                    drainPackerZone, NULL, completion);
+}
+
+/**
+ * Resume the packer of one zone.
+ *
+ * <p>Implements ZoneAction.
+ **/
+static void resumePackerZone(void          *context,
+                             ZoneCount      zoneNumber,
+                             VDOCompletion *parent)
+{
+  Packer *packer = getPackerZone(context, zoneNumber);
   assertOnPackerThread(packer, __func__);
   finishCompletion(parent, resumeIfQuiescent(&packer->state));
 }
 
+/**********************************************************************/
+void resumePackerZones(PackerZones *zones, VDOCompletion *parent)
+{
+  scheduleOperation(zones->manager, ADMIN_STATE_RESUMING, NULL,
+                    resumePackerZone, NULL, parent);
+}
+
 /**********************************************************************/
 void resetSlotCount(Packer *packer, CompressedFragmentCount slots)
 {
@@ -1000,7 +1390,7 @@ static void dumpOutputBin(const OutputBin *bin)
 /**********************************************************************/
 void dumpPacker(const Packer *packer)
 {
-  logInfo("Packer");
+  logInfo("Packer %u", packer->zoneNumber);
   logInfo("  flushGeneration=%" PRIu64 " state %s writingBatches=%s",
           packer->flushGeneration, getAdminStateName(&packer->state),
           boolToString(packer->writingBatches));
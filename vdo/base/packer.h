@@ -35,6 +35,48 @@ enum {
 
 typedef struct packer Packer;
 
+/**
+ * The set of packers of a VDO, one per packer zone. Each packer owns its own
+ * bins and statistics and runs on its own thread.
+ **/
+typedef struct packerZones PackerZones;
+
+/**
+ * The policies for deciding when a partially filled input bin is written.
+ **/
+typedef enum {
+  /** Hold fragments until their bin fills or the packer is flushed */
+  PACKER_POLICY_FILL = 0,
+  /**
+   * Also write out any bin which has waited longer than the recent fragment
+   * arrival rate suggests it will take to fill it.
+   **/
+  PACKER_POLICY_ADAPTIVE,
+} PackerPolicy;
+
+enum {
+  PACKER_HISTOGRAM_BUCKETS = 16,
+};
+
+/**
+ * Histograms describing how well the packer is doing.
+ **/
+typedef struct {
+  /** Compressed blocks written, by sixteenths of the data area filled */
+  uint64_t packedSpace[PACKER_HISTOGRAM_BUCKETS];
+  /**
+   * Fragments written, by the base two logarithm of the number of
+   * microseconds they spent in the packer.
+   **/
+  uint64_t waitTime[PACKER_HISTOGRAM_BUCKETS];
+  /**
+   * Compressed blocks written, by the number of fragments they hold. Blocks
+   * in the last used bucket, MAX_COMPRESSION_SLOTS, were limited by the
+   * number of slots rather than by space.
+   **/
+  uint64_t slotsUsed[PACKER_HISTOGRAM_BUCKETS];
+} PackerHistograms;
+
 /**
  * Make a new block packer.
  *
@@ -44,6 +86,7 @@ typedef struct packer Packer;
  * @param [in]  outputBinCount  The number of compressed blocks that can be
  *                              written concurrently
  * @param [in]  threadConfig    The thread configuration of the VDO
+ * @param [in]  zoneNumber      The number of the packer zone
  * @param [out] packerPtr       A pointer to hold the new packer
  *
  * @return VDO_SUCCESS or an error
@@ -52,6 +95,7 @@ int makePacker(PhysicalLayer       *layer,
                BlockCount           inputBinCount,
                BlockCount           outputBinCount,
                const ThreadConfig  *threadConfig,
+               ZoneCount            zoneNumber,
                Packer             **packerPtr)
   __attribute__((warn_unused_result));
 
@@ -62,6 +106,55 @@ int makePacker(PhysicalLayer       *layer,
  **/
 void freePacker(Packer **packerPtr);
 
+/**
+ * Make a packer for each packer zone of a VDO.
+ *
+ * @param [in]  layer           The physical layer to which compressed blocks
+ *                              will be written
+ * @param [in]  inputBinCount   The number of partial bins each packer keeps
+ *                              in memory
+ * @param [in]  outputBinCount  The number of compressed blocks each packer
+ *                              can write concurrently
+ * @param [in]  threadConfig    The thread configuration of the VDO
+ * @param [out] zonesPtr        A pointer to hold the new packer zones
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+int makePackerZones(PhysicalLayer       *layer,
+                    BlockCount           inputBinCount,
+                    BlockCount           outputBinCount,
+                    const ThreadConfig  *threadConfig,
+                    PackerZones        **zonesPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free a set of packer zones and null out the reference to it.
+ *
+ * @param zonesPtr  A pointer to the zones to free
+ **/
+void freePackerZones(PackerZones **zonesPtr);
+
+/**
+ * Get the number of packer zones.
+ *
+ * @param zones  The packer zones
+ *
+ * @return The number of zones
+ **/
+ZoneCount getPackerZoneCount(const PackerZones *zones)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the packer of a given zone.
+ *
+ * @param zones       The packer zones
+ * @param zoneNumber  The number of the zone
+ *
+ * @return The packer for the zone
+ **/
+Packer *getPackerZone(PackerZones *zones, ZoneCount zoneNumber)
+  __attribute__((warn_unused_result));
+
 /**
  * Check whether the compressed data in a DataVIO will fit in a packer bin.
  *
@@ -82,15 +175,53 @@ bool isSufficientlyCompressible(DataVIO *dataVIO)
 ThreadID getPackerThreadID(Packer *packer);
 
 /**
- * Get the current statistics from the packer.
+ * Get the current statistics from the packers, summed over all zones.
  *
- * @param packer  The packer to query
+ * @param zones  The packer zones to query
  *
- * @return a copy of the current statistics for the packer
+ * @return a copy of the current statistics for the packers
  **/
-PackerStatistics getPackerStatistics(const Packer *packer)
+PackerStatistics getPackerStatistics(const PackerZones *zones)
   __attribute__((warn_unused_result));
 
+/**
+ * Get the current histograms from the packers, summed over all zones.
+ *
+ * @param [in]  zones       The packer zones to query
+ * @param [out] histograms  The structure to fill in
+ **/
+void getPackerHistograms(const PackerZones *zones,
+                         PackerHistograms  *histograms);
+
+/**
+ * Set the policy for writing partially filled bins. This may be called from
+ * any thread; each packer will pick up the change at its next decision.
+ *
+ * @param zones   The packer zones
+ * @param policy  The new policy
+ **/
+void setPackerPolicy(PackerZones *zones, PackerPolicy policy);
+
+/**
+ * Get the policy for writing partially filled bins.
+ *
+ * @param zones  The packer zones
+ *
+ * @return The current policy
+ **/
+PackerPolicy getPackerPolicy(const PackerZones *zones)
+  __attribute__((warn_unused_result));
+
+/**
+ * Write out any input bins whose adaptive deadline has passed. This does
+ * nothing unless the packer's policy is PACKER_POLICY_ADAPTIVE. It must be
+ * called on the packer thread, and should be called periodically so that
+ * fragments don't wait for a flush when the arrival rate drops.
+ *
+ * @param packer  The packer
+ **/
+void checkPackerDeadlines(Packer *packer);
+
 /**
  * Attempt to rewrite the data in this DataVIO as part of a compressed block.
  *
@@ -109,6 +240,14 @@ void attemptPacking(DataVIO *dataVIO);
  **/
 void flushPacker(Packer *packer);
 
+/**
+ * Request that every packer flush asynchronously, as flushPacker() does.
+ * This must be called from the admin thread.
+ *
+ * @param zones  The packer zones to flush
+ **/
+void flushPackerZones(PackerZones *zones);
+
 /**
  * Remove a lock holder from the packer.
  *
@@ -128,23 +267,22 @@ void removeLockHolderFromPacker(VDOCompletion *completion);
 void incrementPackerFlushGeneration(Packer *packer);
 
 /**
- * Drain the packer by preventing any more VIOs from entering the packer and
- * then flushing.
+ * Drain the packers by preventing any more VIOs from entering them and then
+ * flushing. This must be called from the admin thread.
  *
- * @param packer      The packer to drain
- * @param completion  The completion to finish when the packer has drained
+ * @param zones       The packer zones to drain
+ * @param completion  The completion to finish when all packers have drained
  **/
-void drainPacker(Packer *packer, VDOCompletion *completion);
+void drainPackerZones(PackerZones *zones, VDOCompletion *completion);
 
 /**
- * Resume a packer which has been suspended.
- *
- * @param packer  The packer to resume
- * @param parent  The completion to finish when the packer has resumed
+ * Resume packers which have been suspended. This must be called from the
+ * admin thread.
  *
- * @return VDO_SUCCESS or an error
+ * @param zones   The packer zones to resume
+ * @param parent  The completion to finish when all packers have resumed
  **/
-void resumePacker(Packer *packer, VDOCompletion *parent);
+void resumePackerZones(PackerZones *zones, VDOCompletion *parent);
 
 /**
  * Dump the packer, in a thread-unsafe fashion.
@@ -52,6 +52,8 @@ struct inputBin {
   SlotNumber  slotsUsed;
   /** The number of compressed block bytes remaining in the current batch */
   size_t      freeSpace;
+  /** When the first DataVIO of the current batch arrived (microseconds) */
+  uint64_t    firstArrival;
   /** The current partial batch of DataVIOs, waiting for more */
   DataVIO    *incoming[];
 };
@@ -62,17 +64,21 @@ struct inputBin {
  * into the compressed block, written asynchronously, and are waiting for the
  * write to complete.
  **/
-typedef struct {
+typedef struct outputBin {
   /** List links for Packer.outputBins */
-  RingNode         ring;
+  RingNode           ring;
+  /** The packer which owns this bin */
+  Packer            *packer;
   /** The storage for encoding the compressed block representation */
-  CompressedBlock *block;
+  CompressedBlock   *block;
   /** The AllocatingVIO wrapping the compressed block for writing */
-  AllocatingVIO   *writer;
+  AllocatingVIO     *writer;
   /** The number of compression slots used in the compressed block */
-  SlotNumber       slotsUsed;
+  SlotNumber         slotsUsed;
   /** The DataVIOs packed into the block, waiting for the write to complete */
-  WaitQueue        outgoing;
+  WaitQueue          outgoing;
+  /** The next bin to be allocated in the same pass as this one, if any */
+  struct outputBin  *nextInRun;
 } OutputBin;
 
 /**
@@ -85,6 +91,8 @@ typedef struct {
 } OutputBatch;
 
 struct packer {
+  /** The number of the packer's zone */
+  ZoneCount           zoneNumber;
   /** The ID of the packer's callback thread */
   ThreadID            threadID;
   /** The selector for determining which physical zone to allocate from */
@@ -113,6 +121,20 @@ struct packer {
   /** True when writing batched DataVIOs */
   bool                writingBatches;
 
+  /** The PackerPolicy for writing partially filled bins */
+  Atomic32            policy;
+  /** When the most recent DataVIO arrived (microseconds) */
+  uint64_t            lastArrival;
+  /** A moving average of the time between arrivals (microseconds) */
+  uint64_t            meanInterarrival;
+  /** A moving average of the compressed size of arriving DataVIOs */
+  uint64_t            meanFragmentSize;
+
+  /** The counters for the fields of PackerHistograms */
+  Atomic64            packedSpace[PACKER_HISTOGRAM_BUCKETS];
+  Atomic64            waitTime[PACKER_HISTOGRAM_BUCKETS];
+  Atomic64            slotsUsed[PACKER_HISTOGRAM_BUCKETS];
+
   // Atomic counters corresponding to the fields of PackerStatistics:
 
   /** Number of compressed data items written since startup */
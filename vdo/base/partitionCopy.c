@@ -29,9 +29,27 @@
 #include "numUtils.h"
 
 enum {
-  STRIDE_LENGTH = 2048
+  /** The number of blocks read or written by each extent */
+  STRIDE_LENGTH = 1024,
+  /** The number of strides which may be in progress at once */
+  STRIDE_COUNT  = 4,
 };
 
+/**
+ * One stride of a partition copy, which reads a run of blocks from the
+ * source and then writes them to the target.
+ **/
+typedef struct {
+  /** the block the stride begins at, in the source partition */
+  PhysicalBlockNumber  startBlock;
+  /** the number of blocks in the stride, or 0 if the stride is idle */
+  BlockCount           blockCount;
+  /** the backing data used by the extent */
+  char                *data;
+  /** the extent being used to copy */
+  VDOExtent           *extent;
+} CopyStride;
+
 /**
  * A partition copy completion.
  **/
@@ -42,14 +60,17 @@ typedef struct {
   Partition           *source;
   /** the target partition to copy to */
   Partition           *target;
-  /** the current in-partition PBN the copy is beginning at */
+  /** the size of the source partition, at which block indexes wrap */
+  BlockCount           sourceSize;
+  /** the next block to assign to a stride, before wrapping */
   PhysicalBlockNumber  currentIndex;
-  /** the last block to copy */
+  /** the last block to copy, before wrapping */
   PhysicalBlockNumber  endingIndex;
-  /** the backing data used by the extent */
-  char                *data;
-  /** the extent being used to copy */
-  VDOExtent           *extent;
+  /** the number of strides which are reading or writing, plus one while
+      strides are being launched */
+  unsigned int         activeStrides;
+  /** the strides, each of which has its own extent */
+  CopyStride           strides[STRIDE_COUNT];
 } CopyCompletion;
 
 /**
@@ -78,20 +99,23 @@ int makeCopyCompletion(PhysicalLayer *layer, VDOCompletion **completionPtr)
   }
   initializeCompletion(&copy->completion, PARTITION_COPY_COMPLETION, layer);
 
-  result = ALLOCATE((VDO_BLOCK_SIZE * STRIDE_LENGTH), char,
-                    "partition copy extent", &copy->data);
-  if (result != VDO_SUCCESS) {
-    VDOCompletion *completion = &copy->completion;
-    freeCopyCompletion(&completion);
-    return result;
-  }
+  for (unsigned int i = 0; i < STRIDE_COUNT; i++) {
+    CopyStride *stride = &copy->strides[i];
+    result = ALLOCATE((VDO_BLOCK_SIZE * STRIDE_LENGTH), char,
+                      "partition copy extent", &stride->data);
+    if (result != VDO_SUCCESS) {
+      VDOCompletion *completion = &copy->completion;
+      freeCopyCompletion(&completion);
+      return result;
+    }
 
-  result = createExtent(layer, VIO_TYPE_PARTITION_COPY, VIO_PRIORITY_HIGH,
-                        STRIDE_LENGTH, copy->data, &copy->extent);
-  if (result != VDO_SUCCESS) {
-    VDOCompletion *completion = &copy->completion;
-    freeCopyCompletion(&completion);
-    return result;
+    result = createExtent(layer, VIO_TYPE_PARTITION_COPY, VIO_PRIORITY_HIGH,
+                          STRIDE_LENGTH, stride->data, &stride->extent);
+    if (result != VDO_SUCCESS) {
+      VDOCompletion *completion = &copy->completion;
+      freeCopyCompletion(&completion);
+      return result;
+    }
   }
 
   *completionPtr = &copy->completion;
@@ -106,25 +130,80 @@ void freeCopyCompletion(VDOCompletion **completionPtr)
   }
 
   CopyCompletion *copy = asCopyCompletion(*completionPtr);
-  freeExtent(&copy->extent);
-  FREE(copy->data);
+  for (unsigned int i = 0; i < STRIDE_COUNT; i++) {
+    freeExtent(&copy->strides[i].extent);
+    FREE(copy->strides[i].data);
+  }
   FREE(copy);
   *completionPtr = NULL;
 }
 
 /**********************************************************************/
-static void copyPartitionStride(CopyCompletion *copy);
+static void launchStrides(CopyCompletion *copy);
 
 /**
- * Determine the number of blocks to copy in the current stride.
+ * Find the stride which owns an extent.
+ *
+ * @param copy        The copy completion
+ * @param completion  The completion of the stride's extent
+ *
+ * @return The stride which owns the extent
+ **/
+static CopyStride *getStrideForExtent(CopyCompletion *copy,
+                                      VDOCompletion  *completion)
+{
+  VDOExtent *extent = asVDOExtent(completion);
+  for (unsigned int i = 0; i < STRIDE_COUNT; i++) {
+    if (copy->strides[i].extent == extent) {
+      return &copy->strides[i];
+    }
+  }
+
+  ASSERT_LOG_ONLY(false, "extent belongs to a partition copy stride");
+  return NULL;
+}
+
+/**
+ * Drop a reference on the active stride count, and complete the copy if it
+ * was the last one.
  *
  * @param copy  The copy completion
+ **/
+static void releaseStride(CopyCompletion *copy)
+{
+  if (--copy->activeStrides > 0) {
+    return;
+  }
+
+  // We're done.
+  finishCompletion(&copy->completion, copy->completion.result);
+}
+
+/**
+ * Finish a stride, whether it succeeded or not, and relaunch it on the next
+ * part of the copy if there is one.
  *
- * @return The number of blocks to copy in the current stride
+ * @param copy    The copy completion
+ * @param stride  The stride which has finished
+ * @param result  The result of the stride
  **/
-static inline BlockCount getStrideSize(CopyCompletion *copy)
+static void finishStride(CopyCompletion *copy, CopyStride *stride, int result)
 {
-  return minBlockCount(STRIDE_LENGTH, copy->endingIndex - copy->currentIndex);
+  setCompletionResult(&copy->completion, result);
+  stride->blockCount = 0;
+  launchStrides(copy);
+  releaseStride(copy);
+}
+
+/**
+ * Handle an error reading or writing a stride.
+ *
+ * @param completion  The extent which failed
+ **/
+static void handleStrideError(VDOCompletion *completion)
+{
+  CopyCompletion *copy = asCopyCompletion(completion->parent);
+  finishStride(copy, getStrideForExtent(copy, completion), completion->result);
 }
 
 /**
@@ -135,13 +214,7 @@ static inline BlockCount getStrideSize(CopyCompletion *copy)
 static void completeWriteForCopy(VDOCompletion *completion)
 {
   CopyCompletion *copy = asCopyCompletion(completion->parent);
-  copy->currentIndex += getStrideSize(copy);
-  if (copy->currentIndex >= copy->endingIndex) {
-    // We're done.
-    finishCompletion(completion->parent, VDO_SUCCESS);
-    return;
-  }
-  copyPartitionStride(copy);
+  finishStride(copy, getStrideForExtent(copy, completion), VDO_SUCCESS);
 }
 
 /**
@@ -152,40 +225,75 @@ static void completeWriteForCopy(VDOCompletion *completion)
  **/
 static void completeReadForCopy(VDOCompletion *completion)
 {
-  CopyCompletion *copy = asCopyCompletion(completion->parent);
+  CopyCompletion *copy   = asCopyCompletion(completion->parent);
+  CopyStride     *stride = getStrideForExtent(copy, completion);
   PhysicalBlockNumber layerStartBlock;
-  int result = translateToPBN(copy->target, copy->currentIndex,
+  int result = translateToPBN(copy->target, stride->startBlock,
                               &layerStartBlock);
   if (result != VDO_SUCCESS) {
-    finishCompletion(completion->parent, result);
+    finishStride(copy, stride, result);
     return;
   }
 
   completion->callback = completeWriteForCopy;
-  writePartialMetadataExtent(asVDOExtent(completion), layerStartBlock,
-                             getStrideSize(copy));
+  writePartialMetadataExtent(stride->extent, layerStartBlock,
+                             stride->blockCount);
 }
 
 /**
- * Copy a stride from one partition to the new partition.
+ * Copy a stride from one partition to the new partition. A stride never
+ * extends past the end of the source partition, so a copy which wraps is
+ * done as two runs of strides.
  *
- * @param copy  The CopyCompletion
+ * @param copy    The CopyCompletion
+ * @param stride  The idle stride to launch
  **/
-static void copyPartitionStride(CopyCompletion *copy)
+static void copyPartitionStride(CopyCompletion *copy, CopyStride *stride)
 {
+  PhysicalBlockNumber startBlock = copy->currentIndex % copy->sourceSize;
   PhysicalBlockNumber layerStartBlock;
-  int result = translateToPBN(copy->source, copy->currentIndex,
-                              &layerStartBlock);
+  int result = translateToPBN(copy->source, startBlock, &layerStartBlock);
   if (result != VDO_SUCCESS) {
-    finishCompletion(&copy->completion, result);
+    setCompletionResult(&copy->completion, result);
     return;
   }
 
-  prepareCompletion(&copy->extent->completion, completeReadForCopy,
-                    finishParentCallback, copy->completion.callbackThreadID,
+  BlockCount remaining = minBlockCount(copy->endingIndex - copy->currentIndex,
+                                       copy->sourceSize - startBlock);
+  stride->startBlock  = startBlock;
+  stride->blockCount  = minBlockCount(STRIDE_LENGTH, remaining);
+  copy->currentIndex += stride->blockCount;
+  copy->activeStrides++;
+
+  prepareCompletion(&stride->extent->completion, completeReadForCopy,
+                    handleStrideError, copy->completion.callbackThreadID,
                     &copy->completion);
-  readPartialMetadataExtent(copy->extent, layerStartBlock,
-                            getStrideSize(copy));
+  readPartialMetadataExtent(stride->extent, layerStartBlock,
+                            stride->blockCount);
+}
+
+/**
+ * Launch every idle stride on the next part of the copy, so that reads and
+ * writes from several strides are in flight at once. Nothing more is
+ * launched once the copy has failed. The copy is held open while launching
+ * so that it can't complete until every stride has been launched.
+ *
+ * @param copy  The CopyCompletion
+ **/
+static void launchStrides(CopyCompletion *copy)
+{
+  copy->activeStrides++;
+  for (unsigned int i = 0; i < STRIDE_COUNT; i++) {
+    if ((copy->currentIndex >= copy->endingIndex)
+        || (copy->completion.result != VDO_SUCCESS)) {
+      break;
+    }
+
+    if (copy->strides[i].blockCount == 0) {
+      copyPartitionStride(copy, &copy->strides[i]);
+    }
+  }
+  releaseStride(copy);
 }
 
 /**
@@ -222,6 +330,18 @@ void copyPartitionAsync(VDOCompletion *completion,
                         Partition     *source,
                         Partition     *target,
                         VDOCompletion *parent)
+{
+  copyPartitionBlocksAsync(completion, source, target, 0,
+                           getFixedLayoutPartitionSize(source), parent);
+}
+
+/**********************************************************************/
+void copyPartitionBlocksAsync(VDOCompletion       *completion,
+                              Partition           *source,
+                              Partition           *target,
+                              PhysicalBlockNumber  startBlock,
+                              BlockCount           blockCount,
+                              VDOCompletion       *parent)
 {
   int result = validatePartitionCopy(source, target);
   if (result != VDO_SUCCESS) {
@@ -229,11 +349,26 @@ void copyPartitionAsync(VDOCompletion *completion,
     return;
   }
 
+  BlockCount sourceSize = getFixedLayoutPartitionSize(source);
+  result = ASSERT(blockCount <= sourceSize,
+                  "cannot copy more blocks than the source partition holds");
+  if (result != UDS_SUCCESS) {
+    finishCompletion(parent, result);
+    return;
+  }
+
+  if (blockCount == 0) {
+    finishCompletion(parent, VDO_SUCCESS);
+    return;
+  }
+
   CopyCompletion *copy = asCopyCompletion(completion);
   prepareToFinishParent(&copy->completion, parent);
-  copy->source       = source;
-  copy->target       = target;
-  copy->currentIndex = 0;
-  copy->endingIndex  = getFixedLayoutPartitionSize(source);
-  copyPartitionStride(copy);
+  copy->source        = source;
+  copy->target        = target;
+  copy->sourceSize    = sourceSize;
+  copy->currentIndex  = startBlock % sourceSize;
+  copy->endingIndex   = copy->currentIndex + blockCount;
+  copy->activeStrides = 0;
+  launchStrides(copy);
 }
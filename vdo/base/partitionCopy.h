@@ -57,4 +57,25 @@ void copyPartitionAsync(VDOCompletion *completion,
                         Partition     *target,
                         VDOCompletion *parent);
 
+/**
+ * Copy a run of blocks from one partition to the same locations in another.
+ * The run wraps to the start of the partition if it extends past the end,
+ * as is the case for a range of a circular journal.
+ *
+ * @param completion    The copy completion to use
+ * @param source        The partition to copy from
+ * @param target        The partition to copy to
+ * @param startBlock    The first block to copy, taken modulo the size of
+ *                      the source partition
+ * @param blockCount    The number of blocks to copy, which may not exceed
+ *                      the size of the source partition
+ * @param parent        The parent to finish when the copy is complete
+ **/
+void copyPartitionBlocksAsync(VDOCompletion       *completion,
+                              Partition           *source,
+                              Partition           *target,
+                              PhysicalBlockNumber  startBlock,
+                              BlockCount           blockCount,
+                              VDOCompletion       *parent);
+
 #endif /* PARTITION_COPY_H */
@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/base/pbnLockTable.c#1 $
+ */
+
+#include "pbnLockTable.h"
+
+#include "cpu.h"
+#include "logger.h"
+#include "memoryAlloc.h"
+#include "permassert.h"
+
+#include "numUtils.h"
+#include "statusCodes.h"
+
+/**
+ * The index of a lock in the table's array of locks.
+ **/
+typedef uint16_t LockIndex;
+
+enum {
+  /** The number of entries which fit in a cache line sized bucket */
+  ENTRIES_PER_BUCKET = ((CACHE_LINE_BYTES - (2 * sizeof(uint16_t)))
+                        / (sizeof(PhysicalBlockNumber) + sizeof(LockIndex))),
+  /** The most locks a table may hold, limited by the size of a LockIndex */
+  MAXIMUM_PBN_LOCKS  = UINT16_MAX,
+  /** The number of buckets per bucket's worth of locks, to bound the load */
+  BUCKETS_PER_FULL_BUCKET = 2,
+};
+
+/** 2^64 divided by the golden ratio, for Fibonacci hashing of PBNs */
+static const uint64_t PBN_HASH_MULTIPLIER = 0x9e3779b97f4a7c15ULL;
+
+/**
+ * A bucket holds as many entries as will fit in one cache line, in unordered
+ * arrays. An entry which hashes to a full bucket is placed in the next bucket
+ * with room, and each full bucket it passes over counts it as an overflow so
+ * that a search knows to continue to the next bucket. Since entries are really
+ * removed rather than being replaced by placeholders, deletions never slow
+ * down later searches, and the locks themselves never move.
+ **/
+typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) {
+  /** The locked PBNs */
+  PhysicalBlockNumber pbns[ENTRIES_PER_BUCKET];
+  /** The indexes of the locks on the corresponding PBNs */
+  LockIndex           locks[ENTRIES_PER_BUCKET];
+  /** The number of entries in this bucket */
+  uint16_t            count;
+  /** The number of entries placed after this bucket because it was full */
+  uint16_t            overflowCount;
+} LockBucket;
+
+struct pbnLockTable {
+  /** The number of locks allocated for the table */
+  size_t        capacity;
+  /** The number of locks currently held on PBNs */
+  size_t        borrowed;
+  /** The mask which wraps a bucket index around the end of the table */
+  size_t        bucketMask;
+  /** The shift which reduces a PBN hash to a bucket index */
+  unsigned int  hashShift;
+  /** The buckets indexing the held locks by PBN */
+  LockBucket   *buckets;
+  /** A stack of the indexes of the free locks */
+  LockIndex    *freeLocks;
+  /** The memory for all the locks of this table */
+  PBNLock       locks[];
+};
+
+/**********************************************************************/
+int makePBNLockTable(size_t capacity, PBNLockTable **tablePtr)
+{
+  STATIC_ASSERT(sizeof(LockBucket) == CACHE_LINE_BYTES);
+  int result = ASSERT((capacity > 0) && (capacity <= MAXIMUM_PBN_LOCKS),
+                      "PBN lock table capacity %zu is between 1 and %u",
+                      capacity, MAXIMUM_PBN_LOCKS);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  PBNLockTable *table;
+  result = ALLOCATE_EXTENDED(PBNLockTable, capacity, PBNLock, __func__,
+                             &table);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  // Use a power of two number of buckets, with at least one bit of hash.
+  size_t neededBuckets = (BUCKETS_PER_FULL_BUCKET
+                          * computeBucketCount(capacity, ENTRIES_PER_BUCKET));
+  size_t       bucketCount = 2;
+  unsigned int bucketBits  = 1;
+  while (bucketCount < neededBuckets) {
+    bucketCount <<= 1;
+    bucketBits++;
+  }
+
+  table->capacity   = capacity;
+  table->bucketMask = bucketCount - 1;
+  table->hashShift  = 64 - bucketBits;
+  result = ALLOCATE(bucketCount, LockBucket, "PBN lock table buckets",
+                    &table->buckets);
+  if (result != VDO_SUCCESS) {
+    freePBNLockTable(&table);
+    return result;
+  }
+
+  result = ALLOCATE(capacity, LockIndex, "PBN lock table free locks",
+                    &table->freeLocks);
+  if (result != VDO_SUCCESS) {
+    freePBNLockTable(&table);
+    return result;
+  }
+
+  // Stack the free locks so that the first lock is the first to be used.
+  for (size_t i = 0; i < capacity; i++) {
+    table->freeLocks[i] = capacity - 1 - i;
+  }
+
+  *tablePtr = table;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void freePBNLockTable(PBNLockTable **tablePtr)
+{
+  PBNLockTable *table = *tablePtr;
+  if (table == NULL) {
+    return;
+  }
+
+  ASSERT_LOG_ONLY(table->borrowed == 0,
+                  "All PBN locks must be released before the table is freed,"
+                  " but %zu locks are still held", table->borrowed);
+  FREE(table->buckets);
+  FREE(table->freeLocks);
+  FREE(table);
+  *tablePtr = NULL;
+}
+
+/**
+ * Get the bucket to which a PBN hashes.
+ *
+ * @param table  The lock table
+ * @param pbn    The PBN
+ *
+ * @return The index of the PBN's home bucket
+ **/
+static inline size_t getHomeBucket(const PBNLockTable  *table,
+                                   PhysicalBlockNumber  pbn)
+{
+  return ((pbn * PBN_HASH_MULTIPLIER) >> table->hashShift);
+}
+
+/**
+ * Get the bucket after a given one, wrapping around the end of the table.
+ *
+ * @param table  The lock table
+ * @param index  The index of the bucket
+ *
+ * @return The index of the next bucket
+ **/
+static inline size_t getNextBucket(const PBNLockTable *table, size_t index)
+{
+  return ((index + 1) & table->bucketMask);
+}
+
+/**
+ * Find the entry for a PBN. The search can not loop forever since the
+ * table is never more than half full, so some bucket can not have overflowed.
+ *
+ * @param [in]  table      The lock table
+ * @param [in]  pbn        The PBN to find
+ * @param [out] bucketPtr  A pointer to hold the index of the entry's bucket
+ * @param [out] slotPtr    A pointer to hold the entry's slot in the bucket
+ *
+ * @return <code>true</code> if the PBN has an entry
+ **/
+static bool findEntry(const PBNLockTable  *table,
+                      PhysicalBlockNumber  pbn,
+                      size_t              *bucketPtr,
+                      unsigned int        *slotPtr)
+{
+  size_t index = getHomeBucket(table, pbn);
+  for (;;) {
+    const LockBucket *bucket = &table->buckets[index];
+    for (unsigned int slot = 0; slot < bucket->count; slot++) {
+      if (bucket->pbns[slot] == pbn) {
+        *bucketPtr = index;
+        *slotPtr   = slot;
+        return true;
+      }
+    }
+
+    if (bucket->overflowCount == 0) {
+      return false;
+    }
+    index = getNextBucket(table, index);
+  }
+}
+
+/**
+ * Add an entry for a PBN which does not already have one.
+ *
+ * @param table      The lock table
+ * @param pbn        The PBN
+ * @param lockIndex  The index of the lock on the PBN
+ **/
+static void addEntry(PBNLockTable        *table,
+                     PhysicalBlockNumber  pbn,
+                     LockIndex            lockIndex)
+{
+  size_t      index  = getHomeBucket(table, pbn);
+  LockBucket *bucket = &table->buckets[index];
+  while (bucket->count == ENTRIES_PER_BUCKET) {
+    bucket->overflowCount++;
+    index  = getNextBucket(table, index);
+    bucket = &table->buckets[index];
+  }
+
+  bucket->pbns[bucket->count]  = pbn;
+  bucket->locks[bucket->count] = lockIndex;
+  bucket->count++;
+}
+
+/**
+ * Remove an entry, moving the last entry of its bucket into its slot and
+ * uncounting it as an overflow from the buckets it was placed after.
+ *
+ * @param table        The lock table
+ * @param pbn          The PBN of the entry
+ * @param bucketIndex  The index of the entry's bucket
+ * @param slot         The entry's slot in the bucket
+ **/
+static void removeEntry(PBNLockTable        *table,
+                        PhysicalBlockNumber  pbn,
+                        size_t               bucketIndex,
+                        unsigned int         slot)
+{
+  LockBucket *bucket = &table->buckets[bucketIndex];
+  bucket->count--;
+  bucket->pbns[slot]  = bucket->pbns[bucket->count];
+  bucket->locks[slot] = bucket->locks[bucket->count];
+
+  for (size_t index = getHomeBucket(table, pbn);
+       index != bucketIndex;
+       index = getNextBucket(table, index)) {
+    table->buckets[index].overflowCount--;
+  }
+}
+
+/**********************************************************************/
+PBNLock *getPBNLockFromTable(const PBNLockTable  *table,
+                             PhysicalBlockNumber  pbn)
+{
+  size_t       bucketIndex;
+  unsigned int slot;
+  if (!findEntry(table, pbn, &bucketIndex, &slot)) {
+    return NULL;
+  }
+
+  // The table does not modify the lock, but its holders will.
+  return (PBNLock *) &table->locks[table->buckets[bucketIndex].locks[slot]];
+}
+
+/**********************************************************************/
+int findOrAddPBNLock(PBNLockTable         *table,
+                     PhysicalBlockNumber   pbn,
+                     PBNLockType           type,
+                     PBNLock             **lockPtr,
+                     bool                 *isNewPtr)
+{
+  size_t       bucketIndex;
+  unsigned int slot;
+  if (findEntry(table, pbn, &bucketIndex, &slot)) {
+    *lockPtr  = &table->locks[table->buckets[bucketIndex].locks[slot]];
+    *isNewPtr = false;
+    return VDO_SUCCESS;
+  }
+
+  if (table->borrowed >= table->capacity) {
+    return logErrorWithStringError(VDO_LOCK_ERROR,
+                                   "no free PBN locks left to borrow");
+  }
+
+  table->borrowed += 1;
+  LockIndex lockIndex = table->freeLocks[table->capacity - table->borrowed];
+  PBNLock  *lock      = &table->locks[lockIndex];
+  initializePBNLock(lock, type);
+  addEntry(table, pbn, lockIndex);
+
+  *lockPtr  = lock;
+  *isNewPtr = true;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void removePBNLock(PBNLockTable         *table,
+                   PhysicalBlockNumber   lockedPBN,
+                   PBNLock             **lockPtr)
+{
+  // Take what should be the last lock reference from the caller
+  PBNLock *lock = *lockPtr;
+  *lockPtr = NULL;
+
+  LockIndex    lockIndex = lock - table->locks;
+  size_t       bucketIndex;
+  unsigned int slot;
+  if (findEntry(table, lockedPBN, &bucketIndex, &slot)) {
+    ASSERT_LOG_ONLY((table->buckets[bucketIndex].locks[slot] == lockIndex),
+                    "physical block lock mismatch for block %" PRIu64,
+                    lockedPBN);
+    removeEntry(table, lockedPBN, bucketIndex, slot);
+  } else {
+    ASSERT_LOG_ONLY(false, "physical block %" PRIu64 " is locked",
+                    lockedPBN);
+  }
+
+  // A bit expensive, but will promptly catch some use-after-free errors.
+  memset(lock, 0, sizeof(*lock));
+
+  ASSERT_LOG_ONLY(table->borrowed > 0, "shouldn't release more than held");
+  table->freeLocks[table->capacity - table->borrowed] = lockIndex;
+  table->borrowed -= 1;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/base/pbnLockTable.h#1 $
+ */
+
+#ifndef PBN_LOCK_TABLE_H
+#define PBN_LOCK_TABLE_H
+
+#include "pbnLock.h"
+#include "types.h"
+
+/**
+ * A PBNLockTable holds all the PBN locks for a physical zone, both the
+ * indexing of held locks by PBN and the memory for the locks themselves. It
+ * never allocates after it is made, and, like everything else in a physical
+ * zone, may only be used from the zone's thread.
+ **/
+typedef struct pbnLockTable PBNLockTable;
+
+/**
+ * Create a new PBN lock table and all the lock instances it can hold.
+ *
+ * @param [in]  capacity  The number of PBN locks to allocate for the table
+ * @param [out] tablePtr  A pointer to receive the new table
+ *
+ * @return a VDO_SUCCESS or an error code
+ **/
+int makePBNLockTable(size_t capacity, PBNLockTable **tablePtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free a PBN lock table and null out the reference to it. This also frees
+ * all the PBN locks it allocated, so the caller must ensure that all locks
+ * have been released.
+ *
+ * @param [in,out] tablePtr  The reference to the lock table to free
+ **/
+void freePBNLockTable(PBNLockTable **tablePtr);
+
+/**
+ * Get the lock, if any, which is held on a PBN.
+ *
+ * @param table  The lock table
+ * @param pbn    The PBN to look up
+ *
+ * @return The lock on the PBN, or NULL if it is not locked
+ **/
+PBNLock *getPBNLockFromTable(const PBNLockTable  *table,
+                             PhysicalBlockNumber  pbn)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the lock which is held on a PBN, or, if there is none, take a free
+ * lock from the table, initialize it with the provided type, and record it
+ * as the lock on the PBN.
+ *
+ * @param [in]  table    The lock table
+ * @param [in]  pbn      The PBN to lock
+ * @param [in]  type     The type with which to initialize a new lock
+ * @param [out] lockPtr  A pointer to receive the lock on the PBN
+ * @param [out] isNewPtr A pointer to receive whether the lock is new
+ *
+ * @return VDO_SUCCESS, or VDO_LOCK_ERROR if there are no free locks
+ **/
+int findOrAddPBNLock(PBNLockTable         *table,
+                     PhysicalBlockNumber   pbn,
+                     PBNLockType           type,
+                     PBNLock             **lockPtr,
+                     bool                 *isNewPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Remove the lock on a PBN from the table, return it to the free locks, and
+ * null out the caller's reference to it. It must be the last live reference,
+ * as if the memory were being freed (the lock memory will be zeroed).
+ *
+ * @param [in]     table      The lock table
+ * @param [in]     lockedPBN  The PBN which is locked
+ * @param [in,out] lockPtr    The last reference to the lock being removed
+ **/
+void removePBNLock(PBNLockTable         *table,
+                   PhysicalBlockNumber   lockedPBN,
+                   PBNLock             **lockPtr);
+
+#endif // PBN_LOCK_TABLE_H
@@ -172,7 +172,9 @@ typedef void DataCopier(DataVIO *source, DataVIO *destination);
 
 /**
  * A function to apply a partial write to a DataVIO which has completed the
- * read portion of a read-modify-write operation.
+ * read portion of a read-modify-write operation. The writes the DataVIO has
+ * absorbed are applied first, oldest first, since its data supersedes
+ * theirs.
  *
  * @param dataVIO  The dataVIO to modify
  **/
@@ -229,6 +231,19 @@ typedef AsyncDataOperation DataReader;
  **/
 typedef AsyncOperation MetadataReader;
 
+/**
+ * A function to start reading data blocks which are expected to be read
+ * soon, so that the later reads can be satisfied without waiting for the
+ * storage. The layer may read any subset of the blocks, or none of them.
+ *
+ * @param layer  The layer to read from
+ * @param pbns   The blocks to read
+ * @param count  The number of blocks in pbns
+ **/
+typedef void DataPrefetcher(PhysicalLayer             *layer,
+                            const PhysicalBlockNumber *pbns,
+                            BlockCount                 count);
+
 /**
  * A function to write a single DataVIO to the layer
  *
@@ -243,6 +258,18 @@ typedef AsyncDataOperation DataWriter;
  **/
 typedef AsyncOperation MetadataWriter;
 
+/**
+ * A function to discard a run of unreferenced data blocks so that the
+ * storage can reclaim them. The run starts at the VIO's physical block
+ * number. A layer whose storage does not support discards may simply
+ * continue the VIO; either way the contents of the blocks are undefined
+ * once the VIO has been continued.
+ *
+ * @param vio         The VIO with which to discard the run
+ * @param blockCount  The number of blocks to discard
+ **/
+typedef void BlockDiscarder(VIO *vio, BlockCount blockCount);
+
 /**
  * A function to inform the layer that a DataVIO's related I/O request can be
  * safely acknowledged as complete, even though the DataVIO itself may have
@@ -378,11 +405,13 @@ struct physicalLayer {
   DuplicationChecker        *checkForDuplication;
   DuplicationVerifier       *verifyDuplication;
   DataReader                *readData;
+  DataPrefetcher            *prefetchData;
   DataWriter                *writeData;
   CompressedWriter          *writeCompressedBlock;
   MetadataReader            *readMetadata;
   MetadataWriter            *writeMetadata;
   MetadataWriter            *flush;
+  BlockDiscarder            *discardBlocks;
   DataAcknowledger          *acknowledgeDataVIO;
   DataVIOComparator         *compareDataVIOs;
   DataCompressor            *compressDataVIO;
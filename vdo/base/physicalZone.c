@@ -21,63 +21,107 @@
 
 #include "physicalZone.h"
 
+#include "logger.h"
 #include "memoryAlloc.h"
 
-#include "blockAllocator.h"
+#include "blockAllocatorInternals.h"
 #include "blockMap.h"
 #include "completion.h"
 #include "constants.h"
 #include "dataVIO.h"
 #include "flush.h"
 #include "hashLock.h"
-#include "intMap.h"
 #include "pbnLock.h"
-#include "pbnLockPool.h"
+#include "pbnLockTable.h"
+#include "readOnlyNotifier.h"
 #include "slabDepot.h"
+#include "slabJournal.h"
 #include "vdoInternal.h"
 
 enum {
   // Each user DataVIO needs a PBN read lock and write lock, and each packer
   // output bin has an AllocatingVIO that needs a PBN write lock.
   LOCK_POOL_CAPACITY = 2 * MAXIMUM_USER_VIOS + DEFAULT_PACKER_OUTPUT_BINS,
+  // A DataVIO is only handed a deferred decrement if one is free, so this
+  // just needs to be enough to keep every DataVIO from waiting in a burst.
+  DEFERRED_DECREMENT_POOL_CAPACITY = MAXIMUM_USER_VIOS,
 };
 
+/**
+ * A deferred decrement belonging to the pool of a physical zone.
+ **/
+typedef struct {
+  /** The decrement; this must be the first field */
+  DeferredDecrement  decrement;
+  /** The zone to which the decrement belongs */
+  PhysicalZone      *zone;
+} ZoneDecrement;
+
 struct physicalZone {
   /** Which physical zone this is */
   ZoneCount       zoneNumber;
   /** The thread ID for this zone */
   ThreadID        threadID;
-  /** In progress operations keyed by PBN */
-  IntMap         *pbnOperations;
-  /** Pool of unused PBNLock instances */
-  PBNLockPool    *lockPool;
+  /** The PBN locks of in progress operations, and the unused locks */
+  PBNLockTable   *lockTable;
   /** The block allocator for this zone */
   BlockAllocator *allocator;
+  /** The deferred decrements of this zone */
+  ZoneDecrement  *decrements;
+  /** The deferred decrements which are not in use */
+  ZoneDecrement **freeDecrements;
+  /** The number of deferred decrements which are not in use */
+  size_t          freeDecrementCount;
 };
 
+/**
+ * Whether to defer the decrements of overwritten and trimmed blocks. This is
+ * a module setting which is only read by physical zone threads.
+ **/
+static bool deferredDecrements = false;
+
 /**********************************************************************/
 int makePhysicalZone(VDO *vdo, ZoneCount zoneNumber, PhysicalZone **zonePtr)
 {
+  const ThreadConfig *threadConfig = getThreadConfig(vdo);
+  ThreadID threadID = getPhysicalZoneThread(threadConfig, zoneNumber);
+
   PhysicalZone *zone;
-  int result = ALLOCATE(1, PhysicalZone, __func__, &zone);
+  int result = ALLOCATE_ON_NODE(1, PhysicalZone,
+                                getThreadNode(threadConfig, threadID),
+                                __func__, &zone);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  result = makePBNLockTable(LOCK_POOL_CAPACITY, &zone->lockTable);
   if (result != VDO_SUCCESS) {
+    freePhysicalZone(&zone);
     return result;
   }
 
-  result = makeIntMap(LOCK_MAP_CAPACITY, 0, &zone->pbnOperations);
+  result = ALLOCATE(DEFERRED_DECREMENT_POOL_CAPACITY, ZoneDecrement, __func__,
+                    &zone->decrements);
   if (result != VDO_SUCCESS) {
     freePhysicalZone(&zone);
     return result;
   }
 
-  result = makePBNLockPool(LOCK_POOL_CAPACITY, &zone->lockPool);
+  result = ALLOCATE(DEFERRED_DECREMENT_POOL_CAPACITY, ZoneDecrement *,
+                    __func__, &zone->freeDecrements);
   if (result != VDO_SUCCESS) {
     freePhysicalZone(&zone);
     return result;
   }
 
+  for (size_t i = 0; i < DEFERRED_DECREMENT_POOL_CAPACITY; i++) {
+    zone->decrements[i].zone = zone;
+    zone->freeDecrements[i]  = &zone->decrements[i];
+  }
+  zone->freeDecrementCount = DEFERRED_DECREMENT_POOL_CAPACITY;
+
   zone->zoneNumber = zoneNumber;
-  zone->threadID   = getPhysicalZoneThread(getThreadConfig(vdo), zoneNumber);
+  zone->threadID   = threadID;
   zone->allocator  = getBlockAllocatorForZone(vdo->depot, zoneNumber);
 
   *zonePtr = zone;
@@ -92,8 +136,9 @@ void freePhysicalZone(PhysicalZone **zonePtr)
   }
 
   PhysicalZone *zone = *zonePtr;
-  freePBNLockPool(&zone->lockPool);
-  freeIntMap(&zone->pbnOperations);
+  freePBNLockTable(&zone->lockTable);
+  FREE(zone->decrements);
+  FREE(zone->freeDecrements);
   FREE(zone);
   *zonePtr = NULL;
 }
@@ -119,7 +164,7 @@ BlockAllocator *getBlockAllocator(const PhysicalZone *zone)
 /**********************************************************************/
 PBNLock *getPBNLock(PhysicalZone *zone, PhysicalBlockNumber pbn)
 {
-  return ((zone == NULL) ? NULL : intMapGet(zone->pbnOperations, pbn));
+  return ((zone == NULL) ? NULL : getPBNLockFromTable(zone->lockTable, pbn));
 }
 
 /**********************************************************************/
@@ -128,36 +173,23 @@ int attemptPBNLock(PhysicalZone         *zone,
                    PBNLockType           type,
                    PBNLock             **lockPtr)
 {
-  // Borrow and prepare a lock from the pool so we don't have to do two IntMap
-  // accesses in the common case of no lock contention.
-  PBNLock *newLock;
-  int result = borrowPBNLockFromPool(zone->lockPool, type, &newLock);
-  if (result != VDO_SUCCESS) {
-    ASSERT_LOG_ONLY(false, "must always be able to borrow a PBN lock");
-    return result;
-  }
-
   PBNLock *lock;
-  result = intMapPut(zone->pbnOperations, pbn, newLock, false,
-                     (void **) &lock);
+  bool     isNew;
+  int result = findOrAddPBNLock(zone->lockTable, pbn, type, &lock, &isNew);
   if (result != VDO_SUCCESS) {
-    returnPBNLockToPool(zone->lockPool, &newLock);
+    ASSERT_LOG_ONLY(false, "must always be able to borrow a PBN lock");
     return result;
   }
 
-  if (lock != NULL) {
-    // The lock is already held, so we don't need the borrowed lock.
-    returnPBNLockToPool(zone->lockPool, &newLock);
-
+  if (!isNew) {
     result = ASSERT(lock->holderCount > 0,
                     "physical block %" PRIu64 " lock held", pbn);
     if (result != VDO_SUCCESS) {
       return result;
     }
-    *lockPtr = lock;
-  } else {
-    *lockPtr = newLock;
   }
+
+  *lockPtr = lock;
   return VDO_SUCCESS;
 }
 
@@ -181,14 +213,59 @@ void releasePBNLock(PhysicalZone         *zone,
     return;
   }
 
-  PBNLock *holder = intMapRemove(zone->pbnOperations, lockedPBN);
-  ASSERT_LOG_ONLY((lock == holder),
-                  "physical block lock mismatch for block %" PRIu64,
-                  lockedPBN);
-
   releaseProvisionalReference(lock, lockedPBN, zone->allocator);
 
-  returnPBNLockToPool(zone->lockPool, &lock);
+  removePBNLock(zone->lockTable, lockedPBN, &lock);
+}
+
+/**********************************************************************/
+void setDeferredDecrements(bool defer)
+{
+  deferredDecrements = defer;
+}
+
+/**********************************************************************/
+bool getDeferredDecrements(void)
+{
+  return deferredDecrements;
+}
+
+/**
+ * Implements DeferredDecrementCallback. Return a deferred decrement to the
+ * pool of its zone once its entry has been made.
+ **/
+static void returnDeferredDecrement(DeferredDecrement *decrement, int result)
+{
+  ZoneDecrement *zoneDecrement = (ZoneDecrement *) decrement;
+  PhysicalZone  *zone          = zoneDecrement->zone;
+  if ((result != VDO_SUCCESS) && (result != VDO_READ_ONLY)) {
+    logErrorWithStringError(result, "deferred decrement of PBN %" PRIu64
+                            " failed", decrement->operation.pbn);
+    enterReadOnlyMode(zone->allocator->readOnlyNotifier, result);
+  }
+
+  zone->freeDecrements[zone->freeDecrementCount++] = zoneDecrement;
+}
+
+/**********************************************************************/
+bool deferDecrement(PhysicalZone *zone, DataVIO *dataVIO)
+{
+  SlabDepot *depot = zone->allocator->depot;
+  if (!deferredDecrements || (zone->freeDecrementCount == 0)
+      || !isPhysicalDataBlock(depot, dataVIO->operation.pbn)) {
+    // Impossible PBNs are left for the caller to complain about.
+    return false;
+  }
+
+  ZoneDecrement *zoneDecrement
+    = zone->freeDecrements[--zone->freeDecrementCount];
+  DeferredDecrement *decrement = &zoneDecrement->decrement;
+  decrement->operation            = dataVIO->operation;
+  decrement->recoveryJournalPoint = dataVIO->recoveryJournalPoint;
+  decrement->callback             = returnDeferredDecrement;
+  addDeferredSlabJournalEntry(getSlabJournal(depot, decrement->operation.pbn),
+                              decrement);
+  return true;
 }
 
 /**********************************************************************/
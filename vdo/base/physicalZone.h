@@ -120,6 +120,42 @@ void releasePBNLock(PhysicalZone         *zone,
                     PhysicalBlockNumber   lockedPBN,
                     PBNLock             **lockPtr);
 
+/**
+ * Set whether the decrements of overwritten and trimmed blocks should be
+ * deferred. This may be changed at any time; it only affects the decrements
+ * of DataVIOs which have not yet reached their physical zones.
+ *
+ * @param defer  Whether to defer decrements
+ **/
+void setDeferredDecrements(bool defer);
+
+/**
+ * Check whether the decrements of overwritten and trimmed blocks are being
+ * deferred.
+ *
+ * @return <code>true</code> if decrements are deferred
+ **/
+bool getDeferredDecrements(void)
+  __attribute__((warn_unused_result));
+
+/**
+ * Attempt to hand the decrement a DataVIO is about to make off to the slab
+ * journal, so that the DataVIO can go on to update the block map without
+ * waiting for the slab journal entry to be made. The slab journal makes the
+ * entry in the same order it would have for the DataVIO. This must be
+ * called from the zone's thread.
+ *
+ * @param zone     The physical zone of the PBN being decremented
+ * @param dataVIO  The DataVIO whose operation is the decrement to make
+ *
+ * @return <code>true</code> if the decrement was deferred, in which case the
+ *         caller must continue the DataVIO; <code>false</code> if decrements
+ *         are not being deferred or the zone has no free deferred
+ *         decrements
+ **/
+bool deferDecrement(PhysicalZone *zone, DataVIO *dataVIO)
+  __attribute__((warn_unused_result));
+
 /**
  * Dump information about a physical zone to the log for debugging.
  *
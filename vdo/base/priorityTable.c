@@ -167,6 +167,12 @@ RingNode *priorityTableDequeue(PriorityTable *table)
   return entry;
 }
 
+/**********************************************************************/
+int getPriorityTableTopPriority(const PriorityTable *table)
+{
+  return logBaseTwo(table->searchVector);
+}
+
 /**********************************************************************/
 void priorityTableRemove(PriorityTable *table, RingNode *entry)
 {
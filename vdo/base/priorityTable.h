@@ -102,6 +102,17 @@ void resetPriorityTable(PriorityTable *table);
 RingNode *priorityTableDequeue(PriorityTable *table)
   __attribute__((warn_unused_result));
 
+/**
+ * Get the priority of the entry which would be dequeued next.
+ *
+ * @param table  The priority table to examine
+ *
+ * @return the highest priority of any entry in the table, or -1 if the table
+ *         is empty
+ **/
+int getPriorityTableTopPriority(const PriorityTable *table)
+  __attribute__((warn_unused_result));
+
 /**
  * Remove a specified entry from its priority table.
  *
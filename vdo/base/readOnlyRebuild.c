@@ -363,6 +363,9 @@ static void applyJournalEntries(VDOCompletion *completion)
     }
   }
 
+  logInfo("Replaying %zu recovery journal entries into the block map",
+          rebuild->entryCount);
+
   // Suppress block map errors.
   setVDOPageCacheRebuildMode(getBlockMap(vdo)->zones[0].pageCache, true);
 
@@ -25,6 +25,7 @@
 #include "buffer.h"
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "timeUtils.h"
 
 #include "blockMap.h"
 #include "constants.h"
@@ -38,6 +39,10 @@
 #include "slabJournal.h"
 #include "waitQueue.h"
 
+#ifdef __KERNEL__
+#include "vdoTrace.h"
+#endif
+
 typedef struct {
   SequenceNumber journalStart;       // Sequence number to start the journal
   BlockCount     logicalBlocksUsed;  // Number of logical blocks used by VDO
@@ -63,6 +68,15 @@ enum {
    * that means reserving enough space for all 2048 VIOs, or 8 blocks.
    */
   RECOVERY_JOURNAL_RESERVED_BLOCKS = 8,
+  /**
+   * The moving averages used for group commit weight each new sample by one
+   * over two to this power, and are stored scaled up by the same factor.
+   **/
+  COMMIT_AVERAGE_SHIFT             = 3,
+  /** The longest time an entry may be held for group commit (microseconds) */
+  MAXIMUM_COMMIT_WINDOW            = 2000,
+  /** The largest block write latency sample (microseconds) */
+  MAXIMUM_WRITE_LATENCY            = 20000,
 };
 
 /**********************************************************************/
@@ -244,6 +258,17 @@ SequenceNumber getCurrentJournalSequenceNumber(RecoveryJournal *journal)
   return journal->tail;
 }
 
+/**********************************************************************/
+SequenceNumber getOldestWritableJournalBlock(RecoveryJournal *journal)
+{
+  assertOnJournalThread(journal, __func__);
+  if (isRingEmpty(&journal->activeTailBlocks)) {
+    return journal->tail;
+  }
+
+  return blockFromRingNode(journal->activeTailBlocks.next)->sequenceNumber;
+}
+
 /**
  * Get the head of the recovery journal, which is the lowest sequence number of
  * the block map head and the slab journal head.
@@ -549,12 +574,43 @@ void initializeRecoveryJournalPostRebuild(RecoveryJournal *journal,
   journal->blockMapDataBlocks = blockMapDataBlocks;
 }
 
+/**********************************************************************/
+BlockCount getJournalBlocksHeldByBlockMap(const RecoveryJournal *journal)
+{
+  if (journal->slabJournalHead < journal->blockMapHead) {
+    return 0;
+  }
+
+  return (journal->tail - journal->blockMapHead);
+}
+
+/**********************************************************************/
+BlockCount getRecoveryJournalUsableLength(const RecoveryJournal *journal)
+{
+  return getRecoveryJournalLength(journal->size);
+}
+
 /**********************************************************************/
 BlockCount getJournalBlockMapDataBlocksUsed(RecoveryJournal *journal)
 {
   return journal->blockMapDataBlocks;
 }
 
+/**********************************************************************/
+void setRecoveryJournalCommitPolicy(RecoveryJournal     *journal,
+                                    JournalCommitPolicy  policy)
+{
+  journal->commitPolicy = policy;
+}
+
+/**********************************************************************/
+bool isRecoveryJournalCommittingWithFUA(RecoveryJournal *journal)
+{
+  PhysicalLayer *layer = vioAsCompletion(journal->flushVIO)->layer;
+  return ((journal->commitPolicy == JOURNAL_COMMIT_FUA)
+          && (layer->getWritePolicy(layer) == WRITE_POLICY_ASYNC));
+}
+
 /**********************************************************************/
 void setJournalBlockMapDataBlocksUsed(RecoveryJournal *journal,
                                       BlockCount       pages)
@@ -798,6 +854,103 @@ static bool prepareToAssignEntry(RecoveryJournal *journal, bool increment)
 /**********************************************************************/
 static void writeBlocks(RecoveryJournal *journal);
 
+/**
+ * Fold a sample into one of the journal's scaled moving averages.
+ *
+ * @param mean    The current scaled average
+ * @param sample  The new sample
+ *
+ * @return The new scaled average
+ **/
+static inline uint64_t updateMean(uint64_t mean, uint64_t sample)
+{
+  return mean - (mean >> COMMIT_AVERAGE_SHIFT) + sample;
+}
+
+/**
+ * Compute how long an entry in a partially filled active block may wait for
+ * more entries to share its commit. Waiting only pays off if entries arrive
+ * faster than a block write completes, in which case the window is half the
+ * average write latency, within a fixed bound.
+ *
+ * @param journal  The journal
+ *
+ * @return The commit window in microseconds, or 0 if commits should be
+ *         issued immediately
+ **/
+static uint64_t getCommitWindow(const RecoveryJournal *journal)
+{
+  if (!journal->checkingDeadlines) {
+    return 0;
+  }
+
+  uint64_t window
+    = minUInt64(journal->meanWriteLatency >> (COMMIT_AVERAGE_SHIFT + 1),
+                MAXIMUM_COMMIT_WINDOW);
+  if ((journal->meanInterarrival >> COMMIT_AVERAGE_SHIFT) >= window) {
+    return 0;
+  }
+
+  return window;
+}
+
+/**
+ * Update the journal's estimate of the entry arrival rate.
+ *
+ * @param journal  The journal to which an entry has just been added
+ **/
+static void recordEntryArrival(RecoveryJournal *journal)
+{
+  // Cap the gap so that the estimate recovers quickly from an idle period.
+  uint64_t now = nowUsec();
+  uint64_t gap = MAXIMUM_COMMIT_WINDOW;
+  if ((journal->lastArrival != 0) && (now >= journal->lastArrival)) {
+    gap = minUInt64(now - journal->lastArrival, MAXIMUM_COMMIT_WINDOW);
+  }
+
+  journal->lastArrival      = now;
+  journal->meanInterarrival = updateMean(journal->meanInterarrival, gap);
+}
+
+/**
+ * Record the latency and size of a completed block commit.
+ *
+ * @param journal  The journal
+ * @param block    The block whose write has just finished
+ **/
+static void recordCommit(RecoveryJournal      *journal,
+                         RecoveryJournalBlock *block)
+{
+  uint64_t now     = nowUsec();
+  uint64_t latency = ((now > block->commitStarted)
+                      ? minUInt64(now - block->commitStarted,
+                                  MAXIMUM_WRITE_LATENCY)
+                      : 0);
+  journal->meanWriteLatency = updateMean(journal->meanWriteLatency, latency);
+
+  if (block->entriesInCommit > 0) {
+    unsigned int bucket
+      = minUInt64(logBaseTwo(block->entriesInCommit),
+                  RECOVERY_JOURNAL_HISTOGRAM_BUCKETS - 1);
+    journal->commitSizes[bucket]++;
+  }
+}
+
+/**
+ * Check whether the partially filled active block should be held back so
+ * that entries which are about to arrive can share its commit.
+ *
+ * @param journal  The journal
+ *
+ * @return <code>true</code> if the active block should not be written yet
+ **/
+static bool shouldHoldActiveBlock(RecoveryJournal *journal)
+{
+  return (isNormal(&journal->state)
+          && !isRecoveryBlockFull(journal->activeBlock)
+          && (journal->commitDeadline > nowUsec()));
+}
+
 /**
  * Queue a block for writing. The block is expected to be full. If the block
  * is currently writing, this is a noop as the block will be queued for
@@ -890,6 +1043,11 @@ static void assignEntry(Waiter *waiter, void *context)
   }
 
   journal->availableSpace--;
+  if (journal->commitDeadline == 0) {
+    // This is the oldest entry which has not been issued for writing.
+    journal->commitDeadline = journal->lastArrival + getCommitWindow(journal);
+  }
+
   int result = enqueueRecoveryBlockEntry(block, dataVIO);
   if (result != VDO_SUCCESS) {
     enterJournalReadOnlyMode(journal, result);
@@ -1042,6 +1200,13 @@ static void completeWrite(VDOCompletion *completion)
   RecoveryJournal      *journal = block->journal;
   assertOnJournalThread(journal, __func__);
 
+#ifdef __KERNEL__
+  trace_vdo_journal_commit(journal, block->sequenceNumber,
+                           block->entriesInCommit,
+                           nowUsec() - block->commitStarted,
+                           completion->result);
+#endif
+  recordCommit(journal, block);
   journal->pendingWriteCount        -= 1;
   journal->events.blocks.committed  += 1;
   journal->events.entries.committed += block->entriesInCommit;
@@ -1094,6 +1259,7 @@ static void writeBlock(Waiter *waiter, void *context __attribute__((unused)))
     return;
   }
 
+  block->commitStarted = nowUsec();
   int result = commitRecoveryBlock(block, completeWrite, handleWriteError);
   if (result != VDO_SUCCESS) {
     enterJournalReadOnlyMode(block->journal, result);
@@ -1117,7 +1283,9 @@ static void writeBlocks(RecoveryJournal *journal)
    *
    * In all modes, if there are no outstanding writes and some unwritten
    * entries, we must issue a block, even if it's the active block and it
-   * isn't full. Otherwise, in sync/async-unsafe modes, we want to issue
+   * isn't full, unless the active block is being held for group commit, in
+   * which case the periodic deadline check will provide the wakeup.
+   * Otherwise, in sync/async-unsafe modes, we want to issue
    * all full blocks every time; since we call it each time we fill a block,
    * this is equivalent to issuing every full block as soon as its full. In
    * async mode, we want to only issue full blocks if there are no
@@ -1132,9 +1300,12 @@ static void writeBlocks(RecoveryJournal *journal)
   }
 
   // Do we need to write the active block? Only if we have no outstanding
-  // writes, even after issuing all of the full writes.
+  // writes, even after issuing all of the full writes, and the entries in it
+  // have waited out the group commit window.
   if ((journal->pendingWriteCount == 0)
-      && canCommitRecoveryBlock(journal->activeBlock)) {
+      && canCommitRecoveryBlock(journal->activeBlock)
+      && !shouldHoldActiveBlock(journal)) {
+    journal->commitDeadline = 0;
     writeBlock(&journal->activeBlock->writeWaiter, NULL);
   }
 }
@@ -1158,6 +1329,7 @@ void addRecoveryJournalEntry(RecoveryJournal *journal, DataVIO *dataVIO)
                   "journal lock not held for increment");
 
   advanceJournalPoint(&journal->appendPoint, journal->entriesPerBlock);
+  recordEntryArrival(journal);
   int result = enqueueDataVIO((increment
                                ? &journal->incrementWaiters
                                : &journal->decrementWaiters), dataVIO,
@@ -1284,7 +1456,10 @@ void releasePerEntryLockFromOtherZone(RecoveryJournal *journal,
  **/
 static void initiateDrain(AdminState *state)
 {
-  checkForDrainComplete(container_of(state, RecoveryJournal, state));
+  RecoveryJournal *journal = container_of(state, RecoveryJournal, state);
+  // Write out any active block which was being held for group commit.
+  writeBlocks(journal);
+  checkForDrainComplete(journal);
 }
 
 /**********************************************************************/
@@ -1328,6 +1503,26 @@ getRecoveryJournalStatistics(const RecoveryJournal *journal)
   return journal->events;
 }
 
+/**********************************************************************/
+void getRecoveryJournalCommitHistogram(const RecoveryJournal *journal,
+                                       uint64_t              *histogram)
+{
+  // As with the statistics, unfenced reads are sufficient here.
+  for (unsigned int i = 0; i < RECOVERY_JOURNAL_HISTOGRAM_BUCKETS; i++) {
+    histogram[i] = journal->commitSizes[i];
+  }
+}
+
+/**********************************************************************/
+void checkRecoveryJournalCommitDeadline(RecoveryJournal *journal)
+{
+  assertOnJournalThread(journal, __func__);
+  journal->checkingDeadlines = true;
+  if (journal->commitDeadline != 0) {
+    writeBlocks(journal);
+  }
+}
+
 /**********************************************************************/
 void dumpRecoveryJournalStatistics(const RecoveryJournal *journal)
 {
@@ -1352,6 +1547,7 @@ void dumpRecoveryJournalStatistics(const RecoveryJournal *journal)
           PRIu64,
           stats.blocks.started, stats.blocks.written,
           stats.blocks.committed);
+  logInfo("  entries in runs=%" PRIu64, stats.entriesInRuns);
 
   logInfo("  active blocks:");
   const RingNode *head = &journal->activeTailBlocks;
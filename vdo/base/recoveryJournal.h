@@ -33,6 +33,11 @@
 #include "trace.h"
 #include "types.h"
 
+enum {
+  /** The number of buckets in the journal's commit size histogram */
+  RECOVERY_JOURNAL_HISTOGRAM_BUCKETS = 10,
+};
+
 /**
  * The RecoveryJournal provides a log of all block mapping changes
  * which have not yet been stably written to the block map. It exists
@@ -113,6 +118,19 @@
  * on-disk space when a VIO attempts to add an entry, the VIO will be
  * attached to the 'reapCompletion', and will be woken the next time a
  * journal block is reaped.
+ *
+ * There is a single journal, run on a single thread. Its one sequence of
+ * entries is what recovery and rebuild replay to order every mapping change
+ * against the others, including changes to the same block map page or slab
+ * made through different logical or physical zones, and the reap heads and
+ * slab journal commit thresholds are all expressed as positions in that one
+ * sequence. Splitting the journal into zones with their own tails would need
+ * a new on-disk format for the journal and its super block state, and a
+ * recovery which merges the zones, so the journal thread instead amortizes
+ * its work: entries are assigned in batches from the waiter queues, many
+ * entries share each block commit (see getCommitWindow()), and the block
+ * writes may bypass the main device's flush (see
+ * isRecoveryJournalCommittingWithFUA()).
  **/
 
 /**
@@ -206,6 +224,30 @@ void initializeRecoveryJournalPostRebuild(RecoveryJournal *journal,
                                           BlockCount       logicalBlocksUsed,
                                           BlockCount       blockMapDataBlocks);
 
+/**
+ * Get the number of journal blocks the block map is holding: those from the
+ * oldest block a dirty block map page still needs to the tail, or 0 if the
+ * slab journals hold on to an older block anyway. Must be called from the
+ * journal thread.
+ *
+ * @param journal  The journal in question
+ *
+ * @return The number of blocks only the block map keeps from being reaped
+ **/
+BlockCount getJournalBlocksHeldByBlockMap(const RecoveryJournal *journal)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the number of blocks a recovery journal can fill before it must wait
+ * for its head to be reaped.
+ *
+ * @param journal  The journal in question
+ *
+ * @return The usable length of the journal
+ **/
+BlockCount getRecoveryJournalUsableLength(const RecoveryJournal *journal)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the number of block map pages, allocated from data blocks, currently
  * in use.
@@ -217,6 +259,28 @@ void initializeRecoveryJournalPostRebuild(RecoveryJournal *journal,
 BlockCount getJournalBlockMapDataBlocksUsed(RecoveryJournal *journal)
   __attribute__((warn_unused_result));
 
+/**
+ * Set how the journal makes its commits stable.
+ *
+ * @param journal  The journal
+ * @param policy   The commit policy
+ **/
+void setRecoveryJournalCommitPolicy(RecoveryJournal     *journal,
+                                    JournalCommitPolicy  policy);
+
+/**
+ * Check whether the journal will write its blocks with FUA and without a
+ * preceding flush. This is only done in async mode; in sync mode, the flush
+ * before each journal block also makes block map pages and slab summary
+ * updates stable for reaping, so it can not be dropped.
+ *
+ * @param journal  The journal
+ *
+ * @return <code>true</code> if journal blocks are committed with FUA alone
+ **/
+bool isRecoveryJournalCommittingWithFUA(RecoveryJournal *journal)
+  __attribute__((warn_unused_result));
+
 /**
  * Set the number of block map pages, allocated from data blocks, currently
  * in use.
@@ -258,6 +322,20 @@ void openRecoveryJournal(RecoveryJournal *journal,
  **/
 SequenceNumber getCurrentJournalSequenceNumber(RecoveryJournal *journal);
 
+/**
+ * Get the sequence number of the oldest journal block which may still be
+ * written. Every journal block with a lower sequence number is on disk and
+ * will not be rewritten until the journal wraps around to it. This must be
+ * called from the journal zone thread.
+ *
+ * @param journal  The journal in question
+ *
+ * @return the sequence number of the oldest active tail block, or of the
+ *         tail if there are no active tail blocks
+ **/
+SequenceNumber getOldestWritableJournalBlock(RecoveryJournal *journal)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the number of usable recovery journal blocks.
  *
@@ -405,6 +483,26 @@ RecoveryJournalStatistics
 getRecoveryJournalStatistics(const RecoveryJournal *journal)
   __attribute__((warn_unused_result));
 
+/**
+ * Get the histogram of journal block commits, bucketed by the base two
+ * logarithm of the number of entries each commit wrote.
+ *
+ * @param [in]  journal    The recovery journal to query
+ * @param [out] histogram  The RECOVERY_JOURNAL_HISTOGRAM_BUCKETS counts
+ **/
+void getRecoveryJournalCommitHistogram(const RecoveryJournal *journal,
+                                       uint64_t              *histogram);
+
+/**
+ * Write out the partially filled active block if it has been held back for
+ * group commit longer than the adaptive commit window. This must be called
+ * on the journal thread, and should be called periodically; the journal will
+ * not hold back commits until it has been called at least once.
+ *
+ * @param journal  The recovery journal
+ **/
+void checkRecoveryJournalCommitDeadline(RecoveryJournal *journal);
+
 /**
  * Dump some current statistics and other debug info from the recovery
  * journal.
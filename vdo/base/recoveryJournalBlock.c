@@ -123,6 +123,7 @@ void initializeRecoveryBlock(RecoveryJournalBlock *block)
   block->sequenceNumber        = journal->tail;
   block->entryCount            = 0;
   block->uncommittedEntryCount = 0;
+  memset(block->lastEntries, 0, sizeof(block->lastEntries));
 
   block->blockNumber = getRecoveryJournalBlockNumber(journal, journal->tail);
 
@@ -180,6 +181,39 @@ static bool isSectorFull(const RecoveryJournalBlock *block)
   return (block->sector->entryCount == RECOVERY_JOURNAL_ENTRIES_PER_SECTOR);
 }
 
+/**
+ * Check whether a journal entry continues a run begun by the previous entry
+ * of the same operation, mapping the next slot of the same block map page
+ * to the next physical block, or leaving it unmapped as well. Such runs are
+ * what a run-length encoding of journal entries could collapse.
+ *
+ * @param previous  The previous entry of the same operation
+ * @param entry     The new entry
+ *
+ * @return <code>true</code> if the entry continues the run
+ **/
+static bool continuesRun(const RecoveryJournalEntry *previous,
+                         const RecoveryJournalEntry *entry)
+{
+  if ((previous->slot.pbn == ZERO_BLOCK)
+      || (previous->slot.pbn != entry->slot.pbn)
+      || ((previous->slot.slot + 1) != entry->slot.slot)
+      || (previous->mapping.state != entry->mapping.state)) {
+    return false;
+  }
+
+  switch (entry->mapping.state) {
+  case MAPPING_STATE_UNMAPPED:
+    return (previous->mapping.pbn == entry->mapping.pbn);
+
+  case MAPPING_STATE_UNCOMPRESSED:
+    return ((previous->mapping.pbn + 1) == entry->mapping.pbn);
+
+  default:
+    return false;
+  }
+}
+
 /**
  * Actually add entries from the queue to the given block.
  *
@@ -220,6 +254,11 @@ static int addQueuedRecoveryEntries(RecoveryJournalBlock *block)
       .slot      = lock->treeSlots[lock->height].blockMapSlot,
     };
     *packedEntry = packRecoveryJournalEntry(&newEntry);
+    RecoveryJournalEntry *lastEntry = &block->lastEntries[newEntry.operation];
+    if (continuesRun(lastEntry, &newEntry)) {
+      block->journal->events.entriesInRuns++;
+    }
+    *lastEntry = newEntry;
 
     if (isIncrementOperation(dataVIO->operation.type)) {
       dataVIO->recoverySequenceNumber = block->sequenceNumber;
@@ -313,13 +352,20 @@ int commitRecoveryBlock(RecoveryJournalBlock *block,
    *
    * In sync mode, and for FUA, we also need to make sure that the write we
    * are doing is stable, so we issue the write with FUA.
+   *
+   * When committing with FUA alone, every data block and journal block is
+   * written with FUA, so everything this block depends on is already stable
+   * and the flush can be skipped.
    */
   PhysicalLayer *layer        = vioAsCompletion(block->vio)->layer;
-  bool fua = (block->hasFUAEntry
+  bool fuaOnly = isRecoveryJournalCommittingWithFUA(journal);
+  bool fua = (fuaOnly || block->hasFUAEntry
               || (layer->getWritePolicy(layer) == WRITE_POLICY_SYNC));
-  bool flush = (block->hasFUAEntry
-                || (layer->getWritePolicy(layer) != WRITE_POLICY_ASYNC_UNSAFE)
-		|| block->hasPartialWriteEntry);
+  bool flush = (!fuaOnly
+                && (block->hasFUAEntry
+                    || (layer->getWritePolicy(layer)
+                        != WRITE_POLICY_ASYNC_UNSAFE)
+                    || block->hasPartialWriteEntry));
   block->hasFUAEntry          = false;
   block->hasPartialWriteEntry = false;
   launchWriteMetadataVIOWithFlush(block->vio, blockPBN, callback, errorHandler,
@@ -25,6 +25,7 @@
 #include "permassert.h"
 
 #include "packedRecoveryJournalBlock.h"
+#include "recoveryJournalEntry.h"
 #include "recoveryJournalInternals.h"
 #include "ringNode.h"
 #include "types.h"
@@ -59,6 +60,10 @@ struct recoveryJournalBlock {
   JournalEntryCount    uncommittedEntryCount;
   /** The number of new entries in the current commit */
   JournalEntryCount    entriesInCommit;
+  /** The time at which the current commit was issued (microseconds) */
+  uint64_t             commitStarted;
+  /** The last entry of each operation added to this block */
+  RecoveryJournalEntry lastEntries[BLOCK_MAP_INCREMENT + 1];
   /** The queue of VIOs which will make entries for the next commit */
   WaitQueue            entryWaiters;
   /** The queue of VIOs waiting for the current commit */
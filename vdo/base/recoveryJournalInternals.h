@@ -112,8 +112,22 @@ struct recoveryJournal {
   BlockCount                 pendingWriteCount;
   /** The threshold at which slab journal tail blocks will be written out */
   BlockCount                 slabJournalCommitThreshold;
+  /** How journal commits are made stable */
+  JournalCommitPolicy        commitPolicy;
   /** Counters for events in the journal that are reported as statistics */
   RecoveryJournalStatistics  events;
+  /** Block commits, by the base two logarithm of the entries written */
+  uint64_t                   commitSizes[RECOVERY_JOURNAL_HISTOGRAM_BUCKETS];
+  /** Whether the layer periodically checks the group commit deadline */
+  bool                       checkingDeadlines;
+  /** The time at which the held active block must be written, or 0 */
+  uint64_t                   commitDeadline;
+  /** The time of the most recent entry arrival (microseconds) */
+  uint64_t                   lastArrival;
+  /** The scaled moving average of the time between entry arrivals */
+  uint64_t                   meanInterarrival;
+  /** The scaled moving average of the time taken by block writes */
+  uint64_t                   meanWriteLatency;
   /** The locks for each on-disk block */
   LockCounter               *lockCounter;
 };
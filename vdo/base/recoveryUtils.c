@@ -26,27 +26,136 @@
 
 #include "completion.h"
 #include "extent.h"
+#include "numUtils.h"
 #include "packedRecoveryJournalBlock.h"
 #include "recoveryJournalEntry.h"
 #include "recoveryJournalInternals.h"
 #include "slabDepot.h"
 #include "vdoInternal.h"
 
+enum {
+  /** The number of journal blocks read by each extent of a journal load */
+  LOAD_STRIDE_LENGTH = 1024,
+  /** The number of extents of a journal load which may be reading at once */
+  LOAD_STRIDE_COUNT  = 4,
+};
+
 /**
- * Finish loading the journal by freeing the extent and notifying the parent.
- * This callback is registered in loadJournalAsync().
+ * The state of a journal load. The journal is read by several extents, each
+ * of which covers the next unread run of the journal when it is launched and
+ * is freed when its read completes, so reading starts as soon as the first
+ * extent is made, and only a few strides' worth of VIOs exist at once.
+ **/
+typedef struct {
+  /** The journal being loaded */
+  RecoveryJournal      *journal;
+  /** The completion to notify when the load is complete */
+  VDOCompletion        *parent;
+  /** The buffer holding the whole journal */
+  char                 *journalData;
+  /** The next journal block to assign to an extent */
+  PhysicalBlockNumber   nextBlock;
+  /** The first error encountered */
+  int                   result;
+  /** The number of extents reading, plus one while extents are launched */
+  unsigned int          activeStrides;
+  /** The extents which are reading, or NULL for idle strides */
+  VDOExtent            *extents[LOAD_STRIDE_COUNT];
+} JournalLoad;
+
+/**********************************************************************/
+static void finishJournalStride(VDOCompletion *completion);
+
+/**
+ * Drop a reference on the active stride count of a journal load, and
+ * notify the parent if it was the last one.
  *
- * @param completion  The load extent
+ * @param load  The journal load
  **/
-static void finishJournalLoad(VDOCompletion *completion)
+static void releaseJournalStride(JournalLoad *load)
 {
-  int            result = completion->result;
-  VDOCompletion *parent = completion->parent;
-  VDOExtent     *extent = asVDOExtent(completion);
-  freeExtent(&extent);
+  if (--load->activeStrides > 0) {
+    return;
+  }
+
+  VDOCompletion *parent = load->parent;
+  int            result = load->result;
+  FREE(load);
   finishCompletion(parent, result);
 }
 
+/**
+ * Launch every idle stride of a journal load on the next unread run of the
+ * journal, unless the load has failed.
+ *
+ * @param load  The journal load
+ **/
+static void launchJournalStrides(JournalLoad *load)
+{
+  load->activeStrides++;
+  for (unsigned int i = 0; i < LOAD_STRIDE_COUNT; i++) {
+    if ((load->nextBlock >= load->journal->size)
+        || (load->result != VDO_SUCCESS)) {
+      break;
+    }
+
+    if (load->extents[i] != NULL) {
+      continue;
+    }
+
+    PhysicalBlockNumber start = load->nextBlock;
+    BlockCount count = minBlockCount(LOAD_STRIDE_LENGTH,
+                                     load->journal->size - start);
+    int result = createExtent(load->parent->layer, VIO_TYPE_RECOVERY_JOURNAL,
+                              VIO_PRIORITY_METADATA, count,
+                              load->journalData + (start * VDO_BLOCK_SIZE),
+                              &load->extents[i]);
+    if (result != VDO_SUCCESS) {
+      load->result = result;
+      break;
+    }
+
+    // Claim the run before launching, in case the read finishes at once.
+    load->nextBlock += count;
+    load->activeStrides++;
+    VDOExtent *extent = load->extents[i];
+    prepareCompletion(&extent->completion, finishJournalStride,
+                      finishJournalStride, load->parent->callbackThreadID,
+                      load);
+    readMetadataExtent(extent,
+                       getFixedLayoutPartitionOffset(load->journal->partition)
+                       + start);
+  }
+
+  releaseJournalStride(load);
+}
+
+/**
+ * Free the extent of a finished stride and relaunch the stride on the next
+ * unread run of the journal. This callback is registered in
+ * launchJournalStrides().
+ *
+ * @param completion  The extent which has finished reading
+ **/
+static void finishJournalStride(VDOCompletion *completion)
+{
+  JournalLoad *load   = completion->parent;
+  VDOExtent   *extent = asVDOExtent(completion);
+  if ((completion->result != VDO_SUCCESS) && (load->result == VDO_SUCCESS)) {
+    load->result = completion->result;
+  }
+
+  for (unsigned int i = 0; i < LOAD_STRIDE_COUNT; i++) {
+    if (load->extents[i] == extent) {
+      freeExtent(&load->extents[i]);
+      break;
+    }
+  }
+
+  launchJournalStrides(load);
+  releaseJournalStride(load);
+}
+
 /**********************************************************************/
 void loadJournalAsync(RecoveryJournal  *journal,
                       VDOCompletion    *parent,
@@ -59,19 +168,20 @@ void loadJournalAsync(RecoveryJournal  *journal,
     return;
   }
 
-  VDOExtent *extent;
-  result = createExtent(parent->layer, VIO_TYPE_RECOVERY_JOURNAL,
-                        VIO_PRIORITY_METADATA, journal->size,
-                        *journalDataPtr, &extent);
+  JournalLoad *load;
+  result = ALLOCATE(1, JournalLoad, __func__, &load);
   if (result != VDO_SUCCESS) {
     finishCompletion(parent, result);
     return;
   }
 
-  prepareCompletion(&extent->completion, finishJournalLoad, finishJournalLoad,
-                    parent->callbackThreadID, parent);
-  readMetadataExtent(extent,
-                     getFixedLayoutPartitionOffset(journal->partition));
+  *load = (JournalLoad) {
+    .journal     = journal,
+    .parent      = parent,
+    .journalData = *journalDataPtr,
+    .result      = VDO_SUCCESS,
+  };
+  launchJournalStrides(load);
 }
 
 /**
@@ -26,6 +26,8 @@
 #include "memoryAlloc.h"
 #include "numeric.h"
 #include "permassert.h"
+#include "random.h"
+#include "timeUtils.h"
 
 #include "adminState.h"
 #include "blockAllocatorInternals.h"
@@ -50,6 +52,23 @@
 
 static const uint64_t BYTES_PER_WORD   = sizeof(uint64_t);
 static const bool     NORMAL_OPERATION = true;
+static const uint64_t LOW_BYTE_BITS    = 0x0101010101010101ULL;
+static const uint64_t HIGH_BYTE_BITS   = 0x8080808080808080ULL;
+
+enum {
+  /**
+   * The moving averages used for write pacing weight each new sample by one
+   * over two to this power, and are stored scaled up by the same factor.
+   **/
+  PACER_AVERAGE_SHIFT             = 3,
+  /** The largest interval between requests for writes (microseconds) */
+  MAXIMUM_REQUEST_INTERVAL        = 1000000,
+  /** The largest reference block write latency sample (microseconds) */
+  MAXIMUM_REFERENCE_WRITE_LATENCY = 100000,
+  /** The most paced writes a zone may have in progress at once */
+  MAXIMUM_PACED_WRITES            = VIO_POOL_SIZE / 4,
+  MICROSECONDS_PER_SECOND         = 1000000,
+};
 
 /**
  * Return the RefCounts from the RefCounts waiter.
@@ -127,10 +146,11 @@ static void resetSearchCursor(RefCounts *refCounts)
 {
   SearchCursor *cursor = &refCounts->searchCursor;
 
-  cursor->block    = cursor->firstBlock;
-  cursor->index    = 0;
+  cursor->block         = cursor->firstBlock;
+  cursor->index         = 0;
   // Unit tests have slabs with only one reference block (and it's a runt).
-  cursor->endIndex = minBlock(COUNTS_PER_BLOCK, refCounts->blockCount);
+  cursor->endIndex      = minBlock(COUNTS_PER_BLOCK, refCounts->blockCount);
+  cursor->runsExhausted = false;
 }
 
 /**
@@ -155,7 +175,8 @@ static bool advanceSearchCursor(RefCounts *refCounts)
 
   // We're not already at the end, so advance to cursor to the next block.
   cursor->block++;
-  cursor->index = cursor->endIndex;
+  cursor->index         = cursor->endIndex;
+  cursor->runsExhausted = false;
 
   if (cursor->block == cursor->lastBlock) {
     // The last reference block will usually be a runt.
@@ -175,8 +196,9 @@ int makeRefCounts(BlockCount            blockCount,
 {
   BlockCount  refBlockCount = getSavedReferenceCountSize(blockCount);
   RefCounts  *refCounts;
-  int result = ALLOCATE_EXTENDED(RefCounts, refBlockCount, ReferenceBlock,
-                                 "ref counts structure", &refCounts);
+  int result = ARENA_ALLOCATE_EXTENDED(slab->allocator->arena, RefCounts,
+                                       refBlockCount, ReferenceBlock,
+                                       "ref counts structure", &refCounts);
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -206,6 +228,7 @@ int makeRefCounts(BlockCount            blockCount,
     refCounts->blocks[index] = (ReferenceBlock) {
       .refCounts = refCounts,
     };
+    fillRandomly(&refCounts->blocks[index].freeGeneration, sizeof(uint64_t));
   }
 
   *refCountsPtr = refCounts;
@@ -220,8 +243,8 @@ void freeRefCounts(RefCounts **refCountsPtr)
     return;
   }
 
+  // The structure itself belongs to the allocator's arena.
   FREE(refCounts->counters);
-  FREE(refCounts);
   *refCountsPtr = NULL;
 }
 
@@ -271,7 +294,10 @@ static void enqueueDirtyBlock(ReferenceBlock *block)
   if (result != VDO_SUCCESS) {
     // This should never happen.
     enterRefCountsReadOnlyMode(block->refCounts, result);
+    return;
   }
+
+  relaxedAdd64(&block->refCounts->statistics->dirtyBlocks, 1);
 }
 
 /**
@@ -330,6 +356,32 @@ static int getReferenceCounter(RefCounts            *refCounts,
   return VDO_SUCCESS;
 }
 
+/**
+ * Advance the free generation of a reference block because one of its
+ * counters has dropped to zero. Generation 0 is skipped since it means that
+ * there is no generation.
+ *
+ * @param block  The reference block
+ **/
+static inline void advanceFreeGeneration(ReferenceBlock *block)
+{
+  if (++block->freeGeneration == 0) {
+    block->freeGeneration++;
+  }
+}
+
+/**********************************************************************/
+uint64_t getFreeGeneration(RefCounts *refCounts, PhysicalBlockNumber pbn)
+{
+  SlabBlockNumber index;
+  int result = slabBlockNumberFromPBN(refCounts->slab, pbn, &index);
+  if (result != VDO_SUCCESS) {
+    return 0;
+  }
+
+  return getReferenceBlock(refCounts, index)->freeGeneration;
+}
+
 /**********************************************************************/
 uint8_t getAvailableReferences(RefCounts *refCounts, PhysicalBlockNumber pbn)
 {
@@ -450,6 +502,7 @@ static int decrementForData(RefCounts       *refCounts,
       *counterPtr = EMPTY_REFERENCE_COUNT;
       block->allocatedCount--;
       refCounts->freeBlocks++;
+      advanceFreeGeneration(block);
       *freeStatusChanged = true;
     }
     break;
@@ -769,6 +822,37 @@ bool areEquivalentReferenceCounters(RefCounts *counterA, RefCounts *counterB)
                  sizeof(ReferenceCount) * counterA->blockCount) == 0);
 }
 
+/**
+ * Flag the zero bytes in a word of reference counters. The high bit of the
+ * first zero byte is always set, and no bits are set if no byte is zero.
+ * Bytes after the first zero byte may be flagged spuriously, so only the
+ * lowest flagged byte is meaningful.
+ *
+ * @param word  The counters, in little-endian order
+ *
+ * @return the flags for the zero bytes of the word
+ **/
+static inline uint64_t flagZeroBytes(uint64_t word)
+{
+  return ((word - LOW_BYTE_BITS) & ~word & HIGH_BYTE_BITS);
+}
+
+/**
+ * Convert the flags from flagZeroBytes() to the array index of the first
+ * zero byte.
+ *
+ * @param flags       The non-zero flags for a word
+ * @param startIndex  The array index corresponding to the first byte of the
+ *                    word
+ *
+ * @return the array index of the first zero byte in the word
+ **/
+static inline SlabBlockNumber firstFlaggedIndex(uint64_t        flags,
+                                                SlabBlockNumber startIndex)
+{
+  return (startIndex + (__builtin_ctzll(flags) / 8));
+}
+
 /**
  * Find the array index of the first zero byte in word-sized range of
  * reference counters. The search does no bounds checking; the function relies
@@ -785,18 +869,8 @@ static inline SlabBlockNumber findZeroByteInWord(const byte      *wordPtr,
                                                  SlabBlockNumber  startIndex,
                                                  SlabBlockNumber  failIndex)
 {
-  uint64_t word = getUInt64LE(wordPtr);
-
-  // This looks like a loop, but GCC will unroll the eight iterations for us.
-  for (unsigned int offset = 0; offset < BYTES_PER_WORD; offset++) {
-    // Assumes little-endian byte order, which we have on X86.
-    if ((word & 0xFF) == 0) {
-      return (startIndex + offset);
-    }
-    word >>= 8;
-  }
-
-  return failIndex;
+  uint64_t flags = flagZeroBytes(getUInt64LE(wordPtr));
+  return ((flags == 0) ? failIndex : firstFlaggedIndex(flags, startIndex));
 }
 
 /**********************************************************************/
@@ -823,30 +897,169 @@ bool findFreeBlock(const RefCounts *refCounts,
   nextIndex   += BYTES_PER_WORD;
   nextCounter += BYTES_PER_WORD;
 
-  // Now we're word-aligned; check an word at a time until we find a word
-  // containing a zero. (Array is padded so reading past end is safe.)
+  // Now check two words at a time until we find a pair containing a zero, so
+  // that the long runs of referenced counters in a nearly full slab cost one
+  // branch per sixteen counters. (Array is padded by two words so reading
+  // past end is safe.)
   while (nextCounter < endCounter) {
-    /*
-     * The following code is currently an exact copy of the code preceding the
-     * loop, but if you try to merge them by using a do loop, it runs slower
-     * because a jump instruction gets added at the start of the iteration.
-     */
-    zeroIndex = findZeroByteInWord(nextCounter, nextIndex, endIndex);
-    if (zeroIndex < endIndex) {
+    uint64_t lowFlags  = flagZeroBytes(getUInt64LE(nextCounter));
+    uint64_t highFlags = flagZeroBytes(getUInt64LE(nextCounter
+                                                   + BYTES_PER_WORD));
+    if ((lowFlags | highFlags) != 0) {
+      zeroIndex = ((lowFlags != 0)
+                   ? firstFlaggedIndex(lowFlags, nextIndex)
+                   : firstFlaggedIndex(highFlags, nextIndex + BYTES_PER_WORD));
+      if (zeroIndex >= endIndex) {
+        return false;
+      }
+
       *indexPtr = zeroIndex;
       return true;
     }
 
-    nextIndex   += BYTES_PER_WORD;
-    nextCounter += BYTES_PER_WORD;
+    nextIndex   += 2 * BYTES_PER_WORD;
+    nextCounter += 2 * BYTES_PER_WORD;
   }
 
   return false;
 }
 
+/**
+ * Check whether every counter of a run is free.
+ *
+ * @param [in]  refCounts  The RefCounts object to check
+ * @param [in]  start      The array index of the first counter of the run
+ * @param [in]  length     The length of the run
+ * @param [out] usedPtr    A pointer to receive the array index of the first
+ *                         referenced counter if the run is not free
+ *
+ * @return true if the whole run is free
+ **/
+static bool isRunFree(RefCounts       *refCounts,
+                      SlabBlockNumber  start,
+                      BlockCount       length,
+                      SlabBlockNumber *usedPtr)
+{
+  for (SlabBlockNumber index = start; index < start + length; index++) {
+    if (refCounts->counters[index] != EMPTY_REFERENCE_COUNT) {
+      *usedPtr = index;
+      return false;
+    }
+  }
+  return true;
+}
+
 /**
  * Search the reference block currently saved in the search cursor for a
- * reference count of zero, starting at the saved counter index.
+ * full stripe of free counters, aligned to the stripes of the storage, so
+ * that a stream of allocations fills whole stripes and parity RAID need not
+ * read the rest of a stripe to write part of it. A free counter at the
+ * saved index continues the current stripe, but a new stripe is only
+ * started if all of it is free. The stripe may extend past the end of the
+ * block, but not past the end of the slab.
+ *
+ * @param [in]  refCounts     The RefCounts object to search
+ * @param [in]  stripeBlocks  The number of blocks in a stripe
+ * @param [out] freeIndexPtr  A pointer to receive the array index of the
+ *                            first zero reference count of the stripe
+ *
+ * @return true if a free stripe was found
+ **/
+static bool findFreeStripe(RefCounts       *refCounts,
+                           BlockCount       stripeBlocks,
+                           SlabBlockNumber *freeIndexPtr)
+{
+  SearchCursor    *cursor = &refCounts->searchCursor;
+  SlabBlockNumber  index  = cursor->index;
+  SlabBlockNumber  used;
+  BlockCount       offset = indexToPBN(refCounts, index) % stripeBlocks;
+  if ((refCounts->counters[index] == EMPTY_REFERENCE_COUNT)
+      && ((offset != 0)
+          || ((index + stripeBlocks <= refCounts->blockCount)
+              && isRunFree(refCounts, index, stripeBlocks, &used)))) {
+    *freeIndexPtr = index;
+    return true;
+  }
+
+  if (cursor->runsExhausted) {
+    return false;
+  }
+
+  if (offset != 0) {
+    index += stripeBlocks - offset;
+  }
+
+  while ((index < cursor->endIndex)
+         && (index + stripeBlocks <= refCounts->blockCount)) {
+    if (isRunFree(refCounts, index, stripeBlocks, &used)) {
+      *freeIndexPtr = index;
+      return true;
+    }
+
+    // No stripe containing the referenced counter can be free.
+    index += ((used - index) / stripeBlocks + 1) * stripeBlocks;
+  }
+
+  cursor->runsExhausted = true;
+  return false;
+}
+
+/**
+ * Search the reference block currently saved in the search cursor for a run
+ * of free counters, so that consecutive allocations from a partially filled
+ * slab are physically contiguous rather than scattered among its isolated
+ * holes. A free counter at the saved index continues the current run;
+ * otherwise the search looks for an aligned word of free counters, or for a
+ * free stripe if the storage's stripes are known. A block
+ * with no such word is not searched for runs again until the cursor returns
+ * to it.
+ *
+ * @param [in]  refCounts     The RefCounts object to search
+ * @param [out] freeIndexPtr  A pointer to receive the array index of the
+ *                            first zero reference count of the run
+ *
+ * @return true if a free run was found
+ **/
+static bool findFreeRun(RefCounts *refCounts, SlabBlockNumber *freeIndexPtr)
+{
+  SearchCursor *cursor = &refCounts->searchCursor;
+  if (cursor->index >= cursor->endIndex) {
+    return false;
+  }
+
+  BlockCount stripeBlocks = refCounts->slab->allocator->stripeBlocks;
+  if (stripeBlocks > 1) {
+    return findFreeStripe(refCounts, stripeBlocks, freeIndexPtr);
+  }
+
+  if (refCounts->counters[cursor->index] == EMPTY_REFERENCE_COUNT) {
+    *freeIndexPtr = cursor->index;
+    return true;
+  }
+
+  BlockSize freeCount = COUNTS_PER_BLOCK - cursor->block->allocatedCount;
+  if (cursor->runsExhausted || (freeCount < BYTES_PER_WORD)) {
+    return false;
+  }
+
+  SlabBlockNumber index
+    = ((cursor->index + BYTES_PER_WORD - 1) / BYTES_PER_WORD) * BYTES_PER_WORD;
+  for (; (index + BYTES_PER_WORD) <= cursor->endIndex;
+       index += BYTES_PER_WORD) {
+    if (getUInt64LE(&refCounts->counters[index]) == 0) {
+      *freeIndexPtr = index;
+      return true;
+    }
+  }
+
+  cursor->runsExhausted = true;
+  return false;
+}
+
+/**
+ * Search the reference block currently saved in the search cursor for a
+ * reference count of zero, starting at the saved counter index. Runs of free
+ * counters are preferred over isolated ones.
  *
  * @param [in]  refCounts     The RefCounts object to search
  * @param [out] freeIndexPtr  A pointer to receive the array index of the
@@ -854,12 +1067,16 @@ bool findFreeBlock(const RefCounts *refCounts,
  *
  * @return true if an unreferenced counter was found
  **/
-static bool searchCurrentReferenceBlock(const RefCounts *refCounts,
+static bool searchCurrentReferenceBlock(RefCounts       *refCounts,
                                         SlabBlockNumber *freeIndexPtr)
 {
   // Don't bother searching if the current block is known to be full.
-  return ((refCounts->searchCursor.block->allocatedCount < COUNTS_PER_BLOCK)
-          && findFreeBlock(refCounts, refCounts->searchCursor.index,
+  if (refCounts->searchCursor.block->allocatedCount >= COUNTS_PER_BLOCK) {
+    return false;
+  }
+
+  return (findFreeRun(refCounts, freeIndexPtr)
+          || findFreeBlock(refCounts, refCounts->searchCursor.index,
                            refCounts->searchCursor.endIndex, freeIndexPtr));
 }
 
@@ -961,6 +1178,59 @@ int provisionallyReferenceBlock(RefCounts           *refCounts,
   return VDO_SUCCESS;
 }
 
+/**********************************************************************/
+BlockCount claimUnreferencedRun(RefCounts       *refCounts,
+                                SlabBlockNumber *startPtr,
+                                SlabBlockNumber  end,
+                                BlockCount       granularity,
+                                BlockCount       maximum)
+{
+  if (!isSlabOpen(refCounts->slab)) {
+    return 0;
+  }
+
+  PhysicalBlockNumber origin = refCounts->slab->start;
+  SlabBlockNumber     index  = *startPtr;
+  while ((index < end) && findFreeBlock(refCounts, index, end, &index)) {
+    // Nothing past the longest run which could be claimed matters.
+    SlabBlockNumber limit   = minBlock(end, index + maximum + granularity);
+    SlabBlockNumber runEnd  = index + 1;
+    while ((runEnd < limit)
+           && (refCounts->counters[runEnd] == EMPTY_REFERENCE_COUNT)) {
+      runEnd++;
+    }
+
+    PhysicalBlockNumber first = (((origin + index + granularity - 1)
+                                  / granularity) * granularity);
+    PhysicalBlockNumber last  = (((origin + runEnd) / granularity)
+                                 * granularity);
+    if (first < last) {
+      BlockCount length = minBlock(last - first, maximum);
+      *startPtr = first - origin;
+      for (SlabBlockNumber i = *startPtr; i < *startPtr + length; i++) {
+        makeProvisionalReference(refCounts, i);
+      }
+      return length;
+    }
+
+    index = runEnd;
+  }
+
+  return 0;
+}
+
+/**********************************************************************/
+void releaseClaimedRun(RefCounts       *refCounts,
+                       SlabBlockNumber  start,
+                       BlockCount       length)
+{
+  for (SlabBlockNumber i = start; i < start + length; i++) {
+    refCounts->counters[i] = EMPTY_REFERENCE_COUNT;
+    getReferenceBlock(refCounts, i)->allocatedCount--;
+    refCounts->freeBlocks++;
+  }
+}
+
 /**********************************************************************/
 BlockCount countUnreferencedBlocks(RefCounts           *refCounts,
                                    PhysicalBlockNumber  startPBN,
@@ -1002,7 +1272,9 @@ static void
 clearDirtyReferenceBlocks(Waiter *blockWaiter,
                           void   *context __attribute__((unused)))
 {
-  waiterAsReferenceBlock(blockWaiter)->isDirty = false;
+  ReferenceBlock *block = waiterAsReferenceBlock(blockWaiter);
+  block->isDirty = false;
+  relaxedAdd64(&block->refCounts->statistics->dirtyBlocks, -1);
 }
 
 /**********************************************************************/
@@ -1019,6 +1291,7 @@ void resetReferenceCounts(RefCounts *refCounts)
 
   for (size_t i = 0; i < refCounts->referenceBlockCount; i++) {
     refCounts->blocks[i].allocatedCount = 0;
+    advanceFreeGeneration(&refCounts->blocks[i]);
   }
 
   notifyAllWaiters(&refCounts->dirtyBlocks, clearDirtyReferenceBlocks, NULL);
@@ -1070,6 +1343,114 @@ static void updateSlabSummaryAsClean(RefCounts *refCounts)
                          getSlabFreeBlockCount(refCounts->slab));
 }
 
+/**
+ * Fold a sample into one of the write pacer's scaled moving averages.
+ *
+ * @param mean    The current scaled average
+ * @param sample  The new sample
+ *
+ * @return The new scaled average
+ **/
+static inline uint64_t updatePacerMean(uint64_t mean, uint64_t sample)
+{
+  return mean - (mean >> PACER_AVERAGE_SHIFT) + sample;
+}
+
+/**
+ * Compute how many paced writes a zone may have in progress. Keeping up with
+ * the slab journals requires the rate at which writes are requested times the
+ * write latency to be in flight; twice that is allowed so that a backlog can
+ * drain.
+ *
+ * @param pacer  The zone's write pacer
+ *
+ * @return The number of paced writes which may be in progress
+ **/
+static BlockCount getPacedWriteWindow(const ReferenceWritePacer *pacer)
+{
+  if ((pacer->meanWriteLatency == 0) || (pacer->meanRequestInterval == 0)) {
+    // There is nothing to go on yet.
+    return MAXIMUM_PACED_WRITES;
+  }
+
+  uint64_t window = (((2 * pacer->meanWritesRequested
+                       * pacer->meanWriteLatency)
+                      / pacer->meanRequestInterval)
+                     >> PACER_AVERAGE_SHIFT);
+  return minUInt64(window + 1, MAXIMUM_PACED_WRITES);
+}
+
+/**
+ * Update a zone's estimate of the rate at which its slab journals are asking
+ * for reference blocks to be written.
+ *
+ * @param refCounts  The RefCounts being asked to write
+ * @param writes     The number of writes requested
+ **/
+static void recordWriteRequest(RefCounts *refCounts, BlockCount writes)
+{
+  ReferenceWritePacer *pacer = &refCounts->slab->allocator->referenceWritePacer;
+
+  // Cap the interval so that the estimate recovers quickly from an idle
+  // period.
+  uint64_t now      = nowUsec();
+  uint64_t interval = MAXIMUM_REQUEST_INTERVAL;
+  if ((pacer->lastRequestTime != 0) && (now >= pacer->lastRequestTime)) {
+    interval = minUInt64(now - pacer->lastRequestTime,
+                         MAXIMUM_REQUEST_INTERVAL);
+  }
+
+  pacer->lastRequestTime     = now;
+  pacer->meanRequestInterval = updatePacerMean(pacer->meanRequestInterval,
+                                               interval);
+  pacer->meanWritesRequested = updatePacerMean(pacer->meanWritesRequested,
+                                               writes);
+  if (pacer->meanRequestInterval > 0) {
+    relaxedStore64(&refCounts->statistics->writeRate,
+                   ((pacer->meanWritesRequested * MICROSECONDS_PER_SECOND)
+                    / pacer->meanRequestInterval));
+  }
+}
+
+/**
+ * Note that a reference block write launched by the pacer is no longer in
+ * progress.
+ *
+ * @param block  The block which was writing
+ **/
+static void finishPacedWrite(ReferenceBlock *block)
+{
+  if (!block->isPacedWrite) {
+    return;
+  }
+
+  block->isPacedWrite = false;
+  block->refCounts->slab->allocator->referenceWritePacer.activeWrites--;
+}
+
+/**
+ * Record the latency of a completed reference block write.
+ *
+ * @param block  The block whose write has just finished
+ **/
+static void recordReferenceBlockWrite(ReferenceBlock *block)
+{
+  ReferenceWritePacer *pacer
+    = &block->refCounts->slab->allocator->referenceWritePacer;
+  uint64_t now     = nowUsec();
+  uint64_t latency = ((now > block->writeStartTime)
+                      ? minUInt64(now - block->writeStartTime,
+                                  MAXIMUM_REFERENCE_WRITE_LATENCY)
+                      : 0);
+  pacer->meanWriteLatency = updatePacerMean(pacer->meanWriteLatency, latency);
+  relaxedStore64(&block->refCounts->statistics->writeLatency,
+                 pacer->meanWriteLatency >> PACER_AVERAGE_SHIFT);
+  finishPacedWrite(block);
+}
+
+/**********************************************************************/
+static void launchPacedWrites(BlockAllocator *allocator);
+
 /**
  * Handle an I/O error reading or writing a reference count block.
  *
@@ -1080,6 +1461,7 @@ static void handleIOError(VDOCompletion *completion)
   int           result    = completion->result;
   VIOPoolEntry *entry     = completion->parent;
   RefCounts    *refCounts = ((ReferenceBlock *) entry->parent)->refCounts;
+  finishPacedWrite(entry->parent);
   returnVIO(refCounts->slab->allocator, entry);
   refCounts->activeCount--;
   enterRefCountsReadOnlyMode(refCounts, result);
@@ -1109,28 +1491,28 @@ static void finishReferenceBlockWrite(VDOCompletion *completion)
    * enqueue.
    */
   block->isWriting = false;
+  recordReferenceBlockWrite(block);
 
   if (isReadOnly(refCounts->readOnlyNotifier)) {
     checkIfSlabDrained(refCounts->slab);
     return;
   }
 
-  // Re-queue the block if it was re-dirtied while it was writing.
   if (block->isDirty) {
+    // Re-queue the block since it was re-dirtied while it was writing.
     enqueueDirtyBlock(block);
     if (isSlabDraining(refCounts->slab)) {
       // We must be saving, and this block will otherwise not be relaunched.
       saveDirtyReferenceBlocks(refCounts);
     }
-
-    return;
-  }
-
-  // Mark the RefCounts as clean in the slab summary if there are no dirty
-  // or writing blocks and no summary update in progress.
-  if (!hasActiveIO(refCounts) && !hasWaiters(&refCounts->dirtyBlocks)) {
+  } else if (!hasActiveIO(refCounts)
+             && !hasWaiters(&refCounts->dirtyBlocks)) {
+    // Mark the RefCounts as clean in the slab summary if there are no dirty
+    // or writing blocks and no summary update in progress.
     updateSlabSummaryAsClean(refCounts);
   }
+
+  launchPacedWrites(refCounts->slab->allocator);
 }
 
 /**********************************************************************/
@@ -1171,6 +1553,7 @@ static void writeReferenceBlock(Waiter *blockWaiter, void *vioContext)
   size_t              blockOffset = (block - block->refCounts->blocks);
   PhysicalBlockNumber pbn         = (block->refCounts->origin + blockOffset);
   block->slabJournalLockToRelease = block->slabJournalLock;
+  block->writeStartTime           = nowUsec();
   entry->parent                   = block;
 
   /*
@@ -1200,6 +1583,7 @@ static void writeReferenceBlock(Waiter *blockWaiter, void *vioContext)
 static void launchReferenceBlockWrite(Waiter *blockWaiter, void *context)
 {
   RefCounts *refCounts = context;
+  relaxedAdd64(&refCounts->statistics->dirtyBlocks, -1);
   if (isReadOnly(refCounts->readOnlyNotifier)) {
     return;
   }
@@ -1212,6 +1596,7 @@ static void launchReferenceBlockWrite(Waiter *blockWaiter, void *context)
   if (result != VDO_SUCCESS) {
     // This should never happen.
     refCounts->activeCount--;
+    finishPacedWrite(block);
     enterRefCountsReadOnlyMode(refCounts, result);
   }
 }
@@ -1223,6 +1608,118 @@ void saveOldestReferenceBlock(RefCounts *refCounts)
                    refCounts);
 }
 
+/**
+ * Check whether a reference block is the one which a fresh slab is currently
+ * filling. A slab which has never saved all of its reference blocks has not
+ * been used before, so allocations walk its reference blocks in order and
+ * the block under the search cursor will be dirtied again by the next few
+ * allocations.
+ *
+ * @param refCounts  The RefCounts which owns the block
+ * @param block      The block to check
+ *
+ * @return <code>true</code> if the block is being filled
+ **/
+static bool isFillingFreshBlock(RefCounts *refCounts, ReferenceBlock *block)
+{
+  if (block != refCounts->searchCursor.block) {
+    return false;
+  }
+
+  SlabSummaryZone *summary = getSlabSummaryZone(refCounts->slab->allocator);
+  return ((summary != NULL)
+          && !mustLoadRefCounts(summary, refCounts->slab->slabNumber));
+}
+
+/**
+ * Move the block which a fresh slab is filling to the back of the dirty
+ * queue if it is the oldest dirty block and there are others to write
+ * instead. This is only done for writes made to relieve slab journal
+ * pressure; saving all dirty blocks still writes it.
+ *
+ * @param refCounts  The RefCounts
+ **/
+static void deferFillingFreshBlock(RefCounts *refCounts)
+{
+  WaitQueue *dirtyBlocks = &refCounts->dirtyBlocks;
+  if (countWaiters(dirtyBlocks) < 2) {
+    return;
+  }
+
+  ReferenceBlock *oldest = waiterAsReferenceBlock(getFirstWaiter(dirtyBlocks));
+  if (!isFillingFreshBlock(refCounts, oldest)) {
+    return;
+  }
+
+  dequeueNextWaiter(dirtyBlocks);
+  relaxedAdd64(&refCounts->statistics->dirtyBlocks, -1);
+  enqueueDirtyBlock(oldest);
+}
+
+/**
+ * Launch one of the paced writes a RefCounts owes, and put it back at the
+ * end of the pacer's queue if it owes more.
+ *
+ * Implements WaiterCallback.
+ *
+ * @param waiter   The RefCounts' paced write waiter
+ * @param context  Unused
+ **/
+static void launchPacedWrite(Waiter *waiter,
+                             void   *context __attribute__((unused)))
+{
+  RefCounts *refCounts = container_of(waiter, RefCounts, pacedWriteWaiter);
+  if ((refCounts->pacedWritesOwed == 0)
+      || !hasWaiters(&refCounts->dirtyBlocks)
+      || !isSlabOpen(refCounts->slab)
+      || isReadOnly(refCounts->readOnlyNotifier)) {
+    // The writes are no longer needed, or will be made some other way.
+    refCounts->pacedWritesOwed = 0;
+    return;
+  }
+
+  ReferenceWritePacer *pacer = &refCounts->slab->allocator->referenceWritePacer;
+  deferFillingFreshBlock(refCounts);
+  waiterAsReferenceBlock(getFirstWaiter(&refCounts->dirtyBlocks))->isPacedWrite
+    = true;
+  pacer->activeWrites++;
+  saveOldestReferenceBlock(refCounts);
+
+  if (--refCounts->pacedWritesOwed == 0) {
+    return;
+  }
+
+  int result = enqueueWaiter(&pacer->waitingRefCounts, waiter);
+  if (result != VDO_SUCCESS) {
+    // This should never happen.
+    refCounts->pacedWritesOwed = 0;
+    enterRefCountsReadOnlyMode(refCounts, result);
+  }
+}
+
+/**
+ * Launch as many of a zone's owed paced writes as its pacing window allows.
+ *
+ * @param allocator  The allocator for the zone
+ **/
+static void launchPacedWrites(BlockAllocator *allocator)
+{
+  ReferenceWritePacer *pacer = &allocator->referenceWritePacer;
+  if (pacer->launching) {
+    // A write completed synchronously while we were launching.
+    return;
+  }
+
+  pacer->launching = true;
+  BlockCount window = getPacedWriteWindow(pacer);
+  while ((pacer->activeWrites < window)
+         && notifyNextWaiter(&pacer->waitingRefCounts, launchPacedWrite,
+                             NULL)) {
+    // Keep launching.
+  }
+  pacer->launching = false;
+}
+
 /**********************************************************************/
 void saveSeveralReferenceBlocks(RefCounts *refCounts, size_t flushDivisor)
 {
@@ -1237,14 +1734,36 @@ void saveSeveralReferenceBlocks(RefCounts *refCounts, size_t flushDivisor)
     blocksToWrite = 1;
   }
 
-  for (BlockCount written = 0; written < blocksToWrite; written++) {
-    saveOldestReferenceBlock(refCounts);
+  recordWriteRequest(refCounts, blocksToWrite);
+
+  // Any writes still owed are for blocks which are counted again here.
+  if (blocksToWrite > refCounts->pacedWritesOwed) {
+    refCounts->pacedWritesOwed = blocksToWrite;
+  }
+
+  if (!isWaiting(&refCounts->pacedWriteWaiter)) {
+    BlockAllocator *allocator = refCounts->slab->allocator;
+    int result = enqueueWaiter(&allocator->referenceWritePacer.waitingRefCounts,
+                               &refCounts->pacedWriteWaiter);
+    if (result != VDO_SUCCESS) {
+      // This should never happen.
+      refCounts->pacedWritesOwed = 0;
+      enterRefCountsReadOnlyMode(refCounts, result);
+      return;
+    }
+  }
+
+  launchPacedWrites(refCounts->slab->allocator);
+  if (refCounts->pacedWritesOwed > 0) {
+    relaxedAdd64(&refCounts->statistics->writesDeferred, 1);
   }
 }
 
 /**********************************************************************/
 void saveDirtyReferenceBlocks(RefCounts *refCounts)
 {
+  // Every dirty block is being written, so nothing is owed to the pacer.
+  refCounts->pacedWritesOwed = 0;
   notifyAllWaiters(&refCounts->dirtyBlocks, launchReferenceBlockWrite,
                    refCounts);
   checkIfSlabDrained(refCounts->slab);
@@ -1272,6 +1791,7 @@ static void clearProvisionalReferences(ReferenceBlock *block)
       block->allocatedCount--;
     }
   }
+  advanceFreeGeneration(block);
 }
 
 /**
@@ -1311,6 +1831,7 @@ static void unpackReferenceBlock(PackedReferenceBlock *packed,
       block->allocatedCount++;
     }
   }
+  advanceFreeGeneration(block);
 }
 
 /**
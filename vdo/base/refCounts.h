@@ -88,6 +88,20 @@ BlockCount getUnreferencedBlockCount(RefCounts *refCounts)
 uint8_t getAvailableReferences(RefCounts *refCounts, PhysicalBlockNumber pbn)
   __attribute__((warn_unused_result));
 
+/**
+ * Get the free generation of the reference block holding the counter of a
+ * block. While the generation is unchanged, no block it covers can have been
+ * freed. Generations start from a random base each time the counts are made,
+ * so they are not comparable across loads.
+ *
+ * @param refCounts  The RefCounts object
+ * @param pbn        The physical block number
+ *
+ * @return the free generation, or 0 if the PBN is not in the slab
+ **/
+uint64_t getFreeGeneration(RefCounts *refCounts, PhysicalBlockNumber pbn)
+  __attribute__((warn_unused_result));
+
 /**
  * Adjust the reference count of a block.
  *
@@ -184,6 +198,43 @@ int provisionallyReferenceBlock(RefCounts           *refCounts,
                                 PBNLock             *lock)
   __attribute__((warn_unused_result));
 
+/**
+ * Find the next run of unreferenced blocks in a range of a slab which is
+ * worth discarding, and provisionally reference it so that none of its
+ * blocks can be allocated while the discard is in progress. The ends of the
+ * run are trimmed to multiples of the granularity in the physical address
+ * space, so the run is at least that long.
+ *
+ * @param [in]     refCounts    The reference counters to scan
+ * @param [in,out] startPtr     The slab block number at which to start
+ *                              scanning; set to the start of the run claimed
+ * @param [in]     end          The slab block number at which to stop
+ *                              scanning (excluded from the scan)
+ * @param [in]     granularity  The alignment and minimum length of a run
+ * @param [in]     maximum      The most blocks to claim, a multiple of the
+ *                              granularity
+ *
+ * @return The number of blocks claimed, or 0 if there was no such run
+ **/
+BlockCount claimUnreferencedRun(RefCounts       *refCounts,
+                                SlabBlockNumber *startPtr,
+                                SlabBlockNumber  end,
+                                BlockCount       granularity,
+                                BlockCount       maximum)
+  __attribute__((warn_unused_result));
+
+/**
+ * Release the provisional references on a run of blocks claimed by
+ * claimUnreferencedRun(), leaving the blocks unreferenced again.
+ *
+ * @param refCounts  The reference counters of the slab containing the run
+ * @param start      The slab block number of the start of the run
+ * @param length     The number of blocks in the run
+ **/
+void releaseClaimedRun(RefCounts       *refCounts,
+                       SlabBlockNumber  start,
+                       BlockCount       length);
+
 /**
  * Count all unreferenced blocks in a range [startBlock, endBlock) of physical
  * block numbers.
@@ -215,7 +266,9 @@ BlockCount getSavedReferenceCountSize(BlockCount blockCount)
 
 /**
  * Request a RefCounts save several dirty blocks asynchronously. This function
- * currently writes 1 / flushDivisor of the dirty blocks.
+ * currently asks for 1 / flushDivisor of the dirty blocks to be written, but
+ * the writes are paced so that the zone's slab journals are relieved steadily
+ * rather than in bursts.
  *
  * @param refCounts       The RefCounts object to notify
  * @param flushDivisor    The inverse fraction of the dirty blocks to write
@@ -50,6 +50,8 @@ typedef struct searchCursor {
   SlabBlockNumber      index;
   /** The position just past the last valid counter in the current block */
   SlabBlockNumber      endIndex;
+  /** Whether the current block is known to have no more free runs */
+  bool                 runsExhausted;
 
   /** A pointer to the first reference block in the slab */
   ReferenceBlock      *firstBlock;
@@ -84,6 +86,10 @@ struct refCounts {
   WaitQueue                 dirtyBlocks;
   /** The number of blocks which are currently writing */
   size_t                    activeCount;
+  /** A waiter object for launching paced writes */
+  Waiter                    pacedWriteWaiter;
+  /** The number of paced writes waiting to be launched */
+  BlockCount                pacedWritesOwed;
 
   /** A waiter object for updating the slab summary */
   Waiter                    slabSummaryWaiter;
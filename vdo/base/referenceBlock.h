@@ -84,6 +84,15 @@ typedef struct {
   bool            isDirty;
   /** Whether this block is currently writing */
   bool            isWriting;
+  /** Whether the current write was launched by the write pacer */
+  bool            isPacedWrite;
+  /** The time at which the current write was launched */
+  uint64_t        writeStartTime;
+  /**
+   * A count, from a random base, of the times any counter in this block
+   * has dropped to zero
+   **/
+  uint64_t        freeGeneration;
 } ReferenceBlock;
 
 #endif // REFERENCE_BLOCK_H
@@ -32,9 +32,28 @@
 #include "numUtils.h"
 #include "refCounts.h"
 #include "slabDepot.h"
+#include "timeUtils.h"
 #include "vdoInternal.h"
 #include "vdoPageCache.h"
 
+enum {
+  /** How often to log the progress of counting leaf references, in us */
+  PROGRESS_REPORT_INTERVAL = 30 * 1000 * 1000,
+};
+
+/**
+ * A reference from a leaf block map entry to a data block, waiting to be
+ * counted.
+ **/
+typedef struct {
+  /** the referenced block */
+  PhysicalBlockNumber pbn;
+  /** the page completion holding the page with the entry */
+  PageCount           page;
+  /** the slot of the entry in its page */
+  SlotNumber          slot;
+} RebuildReference;
+
 /**
  * A reference count rebuild completion.
  * Note that the page completions kept in this structure are not immediately
@@ -70,6 +89,18 @@ typedef struct {
   BlockMapSlot       lastSlot;
   /** number of pending (non-ready) requests*/
   PageCount          outstanding;
+  /** the references from the pages of a round, bucketed by slab */
+  RebuildReference  *references;
+  /** the start of each slab's bucket of references, and the end of the last */
+  BlockCount        *slabOffsets;
+  /** the number of leaf pages whose references have been counted */
+  PageCount          pagesCounted;
+  /** the number of leaf references counted */
+  BlockCount         referencesCounted;
+  /** when counting leaf references started, in us */
+  uint64_t           startTime;
+  /** when to next log the progress of counting leaf references, in us */
+  uint64_t           nextReportTime;
   /** number of page completions */
   PageCount          pageCount;
   /** array of requested, potentially ready page completions */
@@ -104,6 +135,8 @@ static void freeRebuildCompletion(VDOCompletion **completionPtr)
   }
 
   RebuildCompletion *rebuild = asRebuildCompletion(completion);
+  FREE(rebuild->references);
+  FREE(rebuild->slabOffsets);
   destroyEnqueueable(&rebuild->subTaskCompletion);
   destroyEnqueueable(completion);
   FREE(rebuild);
@@ -171,6 +204,18 @@ static int makeRebuildCompletion(VDO                *vdo,
     return result;
   }
 
+  result = ALLOCATE(pageCount * BLOCK_MAP_ENTRIES_PER_PAGE, RebuildReference,
+                    "rebuild references", &rebuild->references);
+  if (result == VDO_SUCCESS) {
+    result = ALLOCATE(getDepotSlabCount(vdo->depot) + 1, BlockCount,
+                      "rebuild slab offsets", &rebuild->slabOffsets);
+  }
+  if (result != VDO_SUCCESS) {
+    VDOCompletion *completion = &rebuild->completion;
+    freeRebuildCompletion(&completion);
+    return result;
+  }
+
   rebuild->blockMap           = blockMap;
   rebuild->depot              = vdo->depot;
   rebuild->logicalBlocksUsed  = logicalBlocksUsed;
@@ -229,6 +274,10 @@ static bool finishIfDone(RebuildCompletion *rebuild)
     return false;
   }
 
+  uint64_t elapsed = nowUsec() - rebuild->startTime;
+  logInfo("Counted %" PRIu64 " references from %u block map leaf pages in %"
+          PRIu64 " ms", rebuild->referencesCounted, rebuild->pagesCounted,
+          elapsed / 1000);
   prepareCompletion(&rebuild->subTaskCompletion, flushBlockMapUpdates,
                     finishParentCallback, rebuild->adminThreadID, rebuild);
   invokeCallback(&rebuild->subTaskCompletion);
@@ -247,6 +296,9 @@ static void abortRebuild(RebuildCompletion *rebuild, int result)
   setCompletionResult(&rebuild->completion, result);
 }
 
+/**********************************************************************/
+static void finishRound(RebuildCompletion *rebuild);
+
 /**
  * Handle an error loading a page.
  *
@@ -258,19 +310,23 @@ static void handlePageLoadError(VDOCompletion *completion)
   rebuild->outstanding--;
   abortRebuild(rebuild, completion->result);
   releaseVDOPageCompletion(completion);
-  finishIfDone(rebuild);
+  if (!rebuild->launching && (rebuild->outstanding == 0)) {
+    finishRound(rebuild);
+  }
 }
 
 /**
- * Rebuild reference counts from a block map page.
+ * Clean up the entries of a block map page, and count the references from
+ * it to each slab. The references themselves are gathered once every page
+ * of the round has been cleaned up.
  *
  * @param rebuild     The rebuild completion
  * @param completion  The page completion holding the page
  *
  * @return VDO_SUCCESS or an error
  **/
-static int rebuildReferenceCountsFromPage(RebuildCompletion *rebuild,
-                                          VDOCompletion     *completion)
+static int countReferencesFromPage(RebuildCompletion *rebuild,
+                                   VDOCompletion     *completion)
 {
   BlockMapPage *page = dereferenceWritableVDOPage(completion);
   int result = ASSERT(page != NULL, "page available");
@@ -294,7 +350,6 @@ static int rebuildReferenceCountsFromPage(RebuildCompletion *rebuild,
     }
   }
 
-  // Inform the slab depot of all entries on this page.
   for (SlotNumber slot = 0; slot < BLOCK_MAP_ENTRIES_PER_PAGE; slot++) {
     DataLocation mapping = unpackBlockMapEntry(&page->entries[slot]);
     if (!isValidLocation(&mapping)) {
@@ -321,48 +376,200 @@ static int rebuildReferenceCountsFromPage(RebuildCompletion *rebuild,
       continue;
     }
 
-    Slab *slab   = getSlab(rebuild->depot, mapping.pbn);
-    int   result = adjustReferenceCountForRebuild(slab->referenceCounts,
-                                                  mapping.pbn, DATA_INCREMENT);
+    // Count into the next slab's offset, which will become the end of this
+    // slab's bucket.
+    SlabCount slabNumber = getSlab(rebuild->depot, mapping.pbn)->slabNumber;
+    rebuild->slabOffsets[slabNumber + 1]++;
+  }
+  return VDO_SUCCESS;
+}
+
+/**
+ * Put the references from a cleaned up block map page into the buckets for
+ * their slabs.
+ *
+ * @param rebuild  The rebuild completion
+ * @param index    The index of the page completion holding the page
+ **/
+static void gatherReferencesFromPage(RebuildCompletion *rebuild,
+                                     PageCount          index)
+{
+  VDOCompletion *completion = &rebuild->pageCompletions[index].completion;
+  BlockMapPage  *page       = dereferenceWritableVDOPage(completion);
+  if (!isBlockMapPageInitialized(page)) {
+    return;
+  }
+
+  for (SlotNumber slot = 0; slot < BLOCK_MAP_ENTRIES_PER_PAGE; slot++) {
+    DataLocation mapping = unpackBlockMapEntry(&page->entries[slot]);
+    if (!isMappedLocation(&mapping) || (mapping.pbn == ZERO_BLOCK)) {
+      continue;
+    }
+
+    SlabCount slabNumber = getSlab(rebuild->depot, mapping.pbn)->slabNumber;
+    rebuild->references[rebuild->slabOffsets[slabNumber]++]
+      = (RebuildReference) {
+          .pbn  = mapping.pbn,
+          .page = index,
+          .slot = slot,
+        };
+  }
+}
+
+/**
+ * Count the references from all the pages loaded in a round, one slab at a
+ * time. Bucketing the references by slab first means the counts of each
+ * slab are updated together, rather than in the scattered order the leaf
+ * pages refer to them.
+ *
+ * @param rebuild  The rebuild completion
+ **/
+static void rebuildReferenceCountsFromRound(RebuildCompletion *rebuild)
+{
+  SlabCount slabCount = getDepotSlabCount(rebuild->depot);
+  memset(rebuild->slabOffsets, 0, (slabCount + 1) * sizeof(BlockCount));
+  for (PageCount i = 0; i < rebuild->pageCount; i++) {
+    VDOPageCompletion *pageCompletion = &rebuild->pageCompletions[i];
+    if (!pageCompletion->ready) {
+      continue;
+    }
+
+    int result = countReferencesFromPage(rebuild, &pageCompletion->completion);
     if (result != VDO_SUCCESS) {
+      abortRebuild(rebuild, result);
+      return;
+    }
+    rebuild->pagesCounted++;
+  }
+
+  // Turn the counts into the start of each slab's bucket. Gathering the
+  // references advances each start to the end of its bucket.
+  for (SlabCount slab = 1; slab <= slabCount; slab++) {
+    rebuild->slabOffsets[slab] += rebuild->slabOffsets[slab - 1];
+  }
+
+  for (PageCount i = 0; i < rebuild->pageCount; i++) {
+    if (rebuild->pageCompletions[i].ready) {
+      gatherReferencesFromPage(rebuild, i);
+    }
+  }
+
+  rebuild->referencesCounted += rebuild->slabOffsets[slabCount];
+  BlockCount start = 0;
+  for (SlabCount slabNumber = 0; slabNumber < slabCount; slabNumber++) {
+    BlockCount end = rebuild->slabOffsets[slabNumber];
+    if (start == end) {
+      continue;
+    }
+
+    Slab *slab = getSlab(rebuild->depot, rebuild->references[start].pbn);
+    for (BlockCount i = start; i < end; i++) {
+      RebuildReference *reference = &rebuild->references[i];
+      int result = adjustReferenceCountForRebuild(slab->referenceCounts,
+                                                  reference->pbn,
+                                                  DATA_INCREMENT);
+      if (result == VDO_SUCCESS) {
+        continue;
+      }
+
+      VDOCompletion *completion
+        = &rebuild->pageCompletions[reference->page].completion;
+      BlockMapPage  *page = dereferenceWritableVDOPage(completion);
       logErrorWithStringError(result,
                               "Could not adjust reference count for PBN"
                               " %" PRIu64 ", slot %u mapped to PBN %" PRIu64,
-                              getBlockMapPagePBN(page), slot, mapping.pbn);
-      page->entries[slot] = packPBN(ZERO_BLOCK, MAPPING_STATE_UNMAPPED);
+                              getBlockMapPagePBN(page), reference->slot,
+                              reference->pbn);
+      page->entries[reference->slot]
+        = packPBN(ZERO_BLOCK, MAPPING_STATE_UNMAPPED);
       requestVDOPageWrite(completion);
     }
+    start = end;
   }
-  return VDO_SUCCESS;
 }
 
 /**********************************************************************/
 static void fetchPage(RebuildCompletion *rebuild, VDOCompletion *completion);
 
 /**
- * Process a page which has just been loaded. This callback is registered by
- * fetchPage().
+ * Start loading the next round of pages, one with each page completion.
  *
- * @param completion  The VDOPageCompletion for the fetched page
+ * @param rebuild  The rebuild completion
  **/
-static void pageLoaded(VDOCompletion *completion)
+static void launchRound(RebuildCompletion *rebuild)
 {
-  RebuildCompletion *rebuild = asRebuildCompletion(completion->parent);
-  rebuild->outstanding--;
+  // Prevent any round from finishing until all its pages have been launched.
+  rebuild->launching = true;
+  for (PageCount i = 0; i < rebuild->pageCount; i++) {
+    fetchPage(rebuild, &rebuild->pageCompletions[i].completion);
+  }
+  rebuild->launching = false;
 
-  int result = rebuildReferenceCountsFromPage(rebuild, completion);
-  if (result != VDO_SUCCESS) {
-    abortRebuild(rebuild, result);
+  if (rebuild->outstanding == 0) {
+    finishRound(rebuild);
   }
+}
 
-  releaseVDOPageCompletion(completion);
-  if (finishIfDone(rebuild)) {
+/**
+ * Log the progress of counting leaf references if it has been a while since
+ * the last report, since on a large volume this can take hours.
+ *
+ * @param rebuild  The rebuild completion
+ **/
+static void reportProgress(RebuildCompletion *rebuild)
+{
+  uint64_t now = nowUsec();
+  if (now < rebuild->nextReportTime) {
     return;
   }
 
-  // Advance progress to the next page, and fetch the next page we
-  // haven't yet requested.
-  fetchPage(rebuild, completion);
+  rebuild->nextReportTime = now + PROGRESS_REPORT_INTERVAL;
+  uint64_t elapsedSeconds = (now - rebuild->startTime) / 1000000;
+  if (elapsedSeconds == 0) {
+    elapsedSeconds = 1;
+  }
+  logInfo("Rebuilding reference counts: %u of %u block map leaf pages"
+          " examined, %" PRIu64 " pages/s", rebuild->pageToFetch,
+          rebuild->leafPages, rebuild->pagesCounted / elapsedSeconds);
+}
+
+/**
+ * Count the references from the pages of a round now that all of them have
+ * been loaded, release the pages, and go on to the next round.
+ *
+ * @param rebuild  The rebuild completion
+ **/
+static void finishRound(RebuildCompletion *rebuild)
+{
+  if (!rebuild->aborted) {
+    rebuildReferenceCountsFromRound(rebuild);
+    reportProgress(rebuild);
+  }
+
+  for (PageCount i = 0; i < rebuild->pageCount; i++) {
+    if (rebuild->pageCompletions[i].ready) {
+      releaseVDOPageCompletion(&rebuild->pageCompletions[i].completion);
+    }
+  }
+
+  if (!finishIfDone(rebuild)) {
+    launchRound(rebuild);
+  }
+}
+
+/**
+ * Note that a page has been loaded, and finish the round if it was the last
+ * one. This callback is registered by fetchPage().
+ *
+ * @param completion  The VDOPageCompletion for the fetched page
+ **/
+static void pageLoaded(VDOCompletion *completion)
+{
+  RebuildCompletion *rebuild = asRebuildCompletion(completion->parent);
+  rebuild->outstanding--;
+  if (!rebuild->launching && (rebuild->outstanding == 0)) {
+    finishRound(rebuild);
+  }
 }
 
 /**
@@ -373,7 +580,7 @@ static void pageLoaded(VDOCompletion *completion)
  **/
 static void fetchPage(RebuildCompletion *rebuild, VDOCompletion *completion)
 {
-  while (rebuild->pageToFetch < rebuild->leafPages) {
+  while (!rebuild->aborted && (rebuild->pageToFetch < rebuild->leafPages)) {
     PhysicalBlockNumber pbn = findBlockMapPagePBN(rebuild->blockMap,
                                                   rebuild->pageToFetch++);
     if (pbn == ZERO_BLOCK) {
@@ -382,9 +589,6 @@ static void fetchPage(RebuildCompletion *rebuild, VDOCompletion *completion)
 
     if (!isPhysicalDataBlock(rebuild->depot, pbn)) {
       abortRebuild(rebuild, VDO_BAD_MAPPING);
-      if (finishIfDone(rebuild)) {
-        return;
-      }
       continue;
     }
 
@@ -418,13 +622,11 @@ static void rebuildFromLeaves(VDOCompletion *completion)
     .pbn  = findBlockMapPagePBN(rebuild->blockMap, rebuild->leafPages - 1),
   };
 
-  // Prevent any page from being processed until all pages have been launched.
-  rebuild->launching = true;
-  for (PageCount i = 0; i < rebuild->pageCount; i++) {
-    fetchPage(rebuild, &rebuild->pageCompletions[i].completion);
-  }
-  rebuild->launching = false;
-  finishIfDone(rebuild);
+  logInfo("Rebuilding reference counts from %u block map leaf pages",
+          rebuild->leafPages);
+  rebuild->startTime      = nowUsec();
+  rebuild->nextReportTime = rebuild->startTime + PROGRESS_REPORT_INTERVAL;
+  launchRound(rebuild);
 }
 
 /**
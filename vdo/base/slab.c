@@ -132,7 +132,7 @@ int makeSlab(PhysicalBlockNumber   slabOrigin,
              Slab                **slabPtr)
 {
   Slab *slab;
-  int result = ALLOCATE(1, Slab, __func__, &slab);
+  int result = ARENA_ALLOCATE(allocator->arena, Slab, __func__, &slab);
   if (result != VDO_SUCCESS) {
     return result;
   }
@@ -144,6 +144,7 @@ int makeSlab(PhysicalBlockNumber   slabOrigin,
   slab->end        = slab->start + slabConfig->slabBlocks;
   slab->slabNumber = slabNumber;
   initializeRing(&slab->ringNode);
+  initializeRing(&slab->discardNode);
 
   slab->refCountsOrigin = slabOrigin + slabConfig->dataBlocks + translation;
   slab->journalOrigin   = (getSlabJournalStartBlock(slabConfig, slabOrigin)
@@ -196,7 +197,7 @@ void freeSlab(Slab **slabPtr)
   unspliceRingNode(&slab->ringNode);
   freeSlabJournal(&slab->journal);
   freeRefCounts(&slab->referenceCounts);
-  FREE(slab);
+  // The slab itself belongs to the allocator's arena.
   *slabPtr = NULL;
 }
 
@@ -255,6 +256,11 @@ int modifySlabReferenceCount(Slab               *slab,
 
   if (freeStatusChanged) {
     adjustFreeBlockCount(slab, !isIncrementOperation(operation.type));
+    // Only journaled decrements free blocks which may have been written.
+    if (!isIncrementOperation(operation.type)
+        && isValidJournalPoint(journalPoint)) {
+      recordFreedBlock(slab, operation.pbn);
+    }
   }
 
   return VDO_SUCCESS;
@@ -80,6 +80,15 @@ struct vdoSlab {
 
   /** The priority at which this slab has been queued for allocation */
   uint8_t              priority;
+
+  /** A RingNode to queue this slab for discarding its freed blocks */
+  RingNode             discardNode;
+  /** The first block freed since the slab's freed blocks were discarded */
+  SlabBlockNumber      discardStart;
+  /** The block past the last one freed since then */
+  SlabBlockNumber      discardEnd;
+  /** When, in microseconds, the slab's freed blocks may be discarded */
+  uint64_t             discardDeadline;
 };
 
 /**
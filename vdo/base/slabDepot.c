@@ -32,10 +32,12 @@
 #include "numUtils.h"
 #include "readOnlyNotifier.h"
 #include "refCounts.h"
+#include "referenceBlock.h"
 #include "slab.h"
 #include "slabDepotInternals.h"
 #include "slabJournal.h"
 #include "slabIterator.h"
+#include "slabScrubber.h"
 #include "slabSummary.h"
 #include "threadConfig.h"
 #include "types.h"
@@ -259,8 +261,9 @@ static int allocateComponents(SlabDepot          *depot,
   // Allocate the block allocators.
   for (ZoneCount zone = 0; zone < depot->zoneCount; zone++) {
     ThreadID threadID = getPhysicalZoneThread(threadConfig, zone);
-    result = makeBlockAllocator(depot, zone, threadID, nonce, vioPoolSize,
-                                layer, depot->readOnlyNotifier,
+    result = makeBlockAllocator(depot, zone, threadID,
+                                getThreadNode(threadConfig, threadID), nonce,
+                                vioPoolSize, layer, depot->readOnlyNotifier,
                                 &depot->allocators[zone]);
     if (result != VDO_SUCCESS) {
       return result;
@@ -444,16 +447,18 @@ void freeSlabDepot(SlabDepot **depotPtr)
 
   abandonNewSlabs(depot);
 
-  for (ZoneCount zone = 0; zone < depot->zoneCount; zone++) {
-    freeBlockAllocator(&depot->allocators[zone]);
-  }
-
+  // The slabs must be freed first since they live in their allocators'
+  // arenas.
   if (depot->slabs != NULL) {
     for (SlabCount i = 0; i < depot->slabCount; i++) {
       freeSlab(&depot->slabs[i]);
     }
   }
 
+  for (ZoneCount zone = 0; zone < depot->zoneCount; zone++) {
+    freeBlockAllocator(&depot->allocators[zone]);
+  }
+
   FREE(depot->slabs);
   freeActionManager(&depot->actionManager);
   freeSlabSummary(&depot->slabSummary);
@@ -767,13 +772,43 @@ SlabJournal *getSlabJournal(const SlabDepot *depot, PhysicalBlockNumber pbn)
 
 /**********************************************************************/
 uint8_t getIncrementLimit(SlabDepot *depot, PhysicalBlockNumber pbn)
+{
+  Slab *slab = getSlab(depot, pbn);
+  if (slab == NULL) {
+    return 0;
+  }
+
+  if (isUnrecoveredSlab(slab)) {
+    // Pass up this deduplication, but load the slab so later ones needn't.
+    loadSlabOnDemand(slab);
+    return 0;
+  }
+
+  // A block being discarded may be read before its run is, but must not
+  // be referenced again until afterwards.
+  if (isDiscardingBlock(slab->allocator, pbn)) {
+    return 0;
+  }
+
+  uint8_t limit = getAvailableReferences(slab->referenceCounts, pbn);
+  if ((limit == MAXIMUM_REFERENCE_COUNT)
+      && mayHaveDiscardedFreeBlocks(slab->allocator)) {
+    // The block is free, and may no longer hold the data it was freed with.
+    return 0;
+  }
+
+  return limit;
+}
+
+/**********************************************************************/
+uint64_t getPBNFreeGeneration(SlabDepot *depot, PhysicalBlockNumber pbn)
 {
   Slab *slab = getSlab(depot, pbn);
   if ((slab == NULL) || isUnrecoveredSlab(slab)) {
     return 0;
   }
 
-  return getAvailableReferences(slab->referenceCounts, pbn);
+  return getFreeGeneration(slab->referenceCounts, pbn);
 }
 
 /**********************************************************************/
@@ -793,6 +828,53 @@ bool isPhysicalDataBlock(const SlabDepot *depot, PhysicalBlockNumber pbn)
   return (result == VDO_SUCCESS);
 }
 
+/**
+ * Get the number of slabs, including any which are being added by a resize.
+ *
+ * @param depot  The depot
+ *
+ * @return The number of slabs
+ **/
+static SlabCount getAllSlabCount(const SlabDepot *depot)
+{
+  return maxUInt(depot->slabCount, depot->newSlabCount);
+}
+
+/**********************************************************************/
+bool getSlabMetadataIndex(const SlabDepot     *depot,
+                          PhysicalBlockNumber  pbn,
+                          BlockCount          *indexPtr)
+{
+  if (pbn < depot->origin) {
+    return false;
+  }
+
+  BlockCount offset     = pbn - depot->origin;
+  SlabCount  slabNumber = offset >> depot->slabSizeShift;
+  if (slabNumber >= getAllSlabCount(depot)) {
+    return false;
+  }
+
+  const SlabConfig *config = &depot->slabConfig;
+  BlockCount slabOffset = offset & ((1ULL << depot->slabSizeShift) - 1);
+  if (slabOffset < config->dataBlocks) {
+    return false;
+  }
+
+  BlockCount metadataBlocks = config->slabBlocks - config->dataBlocks;
+  *indexPtr = ((slabNumber * metadataBlocks)
+               + (slabOffset - config->dataBlocks));
+  return true;
+}
+
+/**********************************************************************/
+BlockCount getSlabMetadataBlockCount(const SlabDepot *depot)
+{
+  const SlabConfig *config = &depot->slabConfig;
+  return (getAllSlabCount(depot)
+          * (config->slabBlocks - config->dataBlocks));
+}
+
 /**********************************************************************/
 BlockCount getDepotAllocatedBlocks(const SlabDepot *depot)
 {
@@ -1023,6 +1105,77 @@ void scrubAllUnrecoveredSlabs(SlabDepot     *depot,
                  NULL, launchParent);
 }
 
+/**********************************************************************/
+void setDepotScrubConcurrency(SlabDepot *depot, unsigned int concurrency)
+{
+  for (ZoneCount zone = 0; zone < depot->zoneCount; zone++) {
+    setScrubberConcurrency(depot->allocators[zone]->slabScrubber,
+                           concurrency);
+  }
+}
+
+/**********************************************************************/
+unsigned int getDepotScrubConcurrency(const SlabDepot *depot)
+{
+  // All of the scrubbers always share their limits.
+  return getScrubberConcurrency(depot->allocators[0]->slabScrubber);
+}
+
+/**********************************************************************/
+void setDepotScrubRateLimit(SlabDepot *depot, uint32_t blocksPerSecond)
+{
+  // Each zone scrubs independently, so divide the limit between them.
+  uint32_t zoneLimit = blocksPerSecond / depot->zoneCount;
+  if ((blocksPerSecond > 0) && (zoneLimit == 0)) {
+    zoneLimit = 1;
+  }
+
+  for (ZoneCount zone = 0; zone < depot->zoneCount; zone++) {
+    setScrubberRateLimit(depot->allocators[zone]->slabScrubber, zoneLimit);
+  }
+}
+
+/**********************************************************************/
+uint32_t getDepotScrubRateLimit(const SlabDepot *depot)
+{
+  return (getScrubberRateLimit(depot->allocators[0]->slabScrubber)
+          * depot->zoneCount);
+}
+
+/**********************************************************************/
+void checkDepotScrubRateLimit(SlabDepot *depot, ZoneCount zoneNumber)
+{
+  checkScrubberRateLimit(depot->allocators[zoneNumber]->slabScrubber);
+}
+
+/**********************************************************************/
+void setDepotDiscardDelay(SlabDepot *depot, uint32_t milliseconds)
+{
+  for (ZoneCount zone = 0; zone < depot->zoneCount; zone++) {
+    setDiscardDelay(depot->allocators[zone], milliseconds);
+  }
+}
+
+/**********************************************************************/
+void setDepotStripeBlocks(SlabDepot *depot, BlockCount stripeBlocks)
+{
+  for (ZoneCount zone = 0; zone < depot->zoneCount; zone++) {
+    depot->allocators[zone]->stripeBlocks = stripeBlocks;
+  }
+}
+
+/**********************************************************************/
+uint32_t getDepotDiscardDelay(const SlabDepot *depot)
+{
+  return getDiscardDelay(depot->allocators[0]);
+}
+
+/**********************************************************************/
+void checkDepotDiscardDeadlines(SlabDepot *depot, ZoneCount zoneNumber)
+{
+  checkDiscardDeadlines(depot->allocators[zoneNumber]);
+}
+
 /**********************************************************************/
 void notifyZoneFinishedScrubbing(VDOCompletion *completion)
 {
@@ -1089,9 +1242,23 @@ getDepotBlockAllocatorStatistics(const SlabDepot *depot)
   for (ZoneCount zone = 0; zone < depot->zoneCount; zone++) {
     BlockAllocator *allocator = depot->allocators[zone];
     BlockAllocatorStatistics stats = getBlockAllocatorStatistics(allocator);
-    totals.slabCount     += stats.slabCount;
-    totals.slabsOpened   += stats.slabsOpened;
-    totals.slabsReopened += stats.slabsReopened;
+    totals.slabCount               += stats.slabCount;
+    totals.slabsOpened             += stats.slabsOpened;
+    totals.slabsReopened           += stats.slabsReopened;
+    totals.allocationStalls        += stats.allocationStalls;
+    totals.stallMicroseconds       += stats.stallMicroseconds;
+    totals.slabsScrubbed           += stats.slabsScrubbed;
+    totals.slabsToScrub            += stats.slabsToScrub;
+    totals.vioPoolWaits            += stats.vioPoolWaits;
+    totals.vioPoolWaitMicroseconds += stats.vioPoolWaitMicroseconds;
+    totals.vioPoolSize             += stats.vioPoolSize;
+    totals.discardsPassedDown      += stats.discardsPassedDown;
+    totals.blocksPassedDown        += stats.blocksPassedDown;
+    // The zones scrub concurrently, so the slowest one determines when
+    // scrubbing will be done.
+    if (stats.scrubSecondsRemaining > totals.scrubSecondsRemaining) {
+      totals.scrubSecondsRemaining = stats.scrubSecondsRemaining;
+    }
   }
 
   return totals;
@@ -1106,7 +1273,14 @@ RefCountsStatistics getDepotRefCountsStatistics(const SlabDepot *depot)
   for (ZoneCount zone = 0; zone < depot->zoneCount; zone++) {
     BlockAllocator *allocator = depot->allocators[zone];
     RefCountsStatistics stats = getRefCountsStatistics(allocator);
-    depotStats.blocksWritten += stats.blocksWritten;
+    depotStats.blocksWritten  += stats.blocksWritten;
+    depotStats.dirtyBlocks    += stats.dirtyBlocks;
+    depotStats.writesDeferred += stats.writesDeferred;
+    depotStats.writeRate      += stats.writeRate;
+    // The zones write to the same device, so report the slowest.
+    if (stats.writeLatency > depotStats.writeLatency) {
+      depotStats.writeLatency = stats.writeLatency;
+    }
   }
 
   return depotStats;
@@ -1126,6 +1300,7 @@ SlabJournalStatistics getDepotSlabJournalStatistics(const SlabDepot *depot)
     depotStats.blockedCount  += stats.blockedCount;
     depotStats.blocksWritten += stats.blocksWritten;
     depotStats.tailBusyCount += stats.tailBusyCount;
+    depotStats.entriesInRuns += stats.entriesInRuns;
   }
 
   return depotStats;
@@ -243,6 +243,18 @@ SlabJournal *getSlabJournal(const SlabDepot *depot, PhysicalBlockNumber pbn)
 uint8_t getIncrementLimit(SlabDepot *depot, PhysicalBlockNumber pbn)
   __attribute__((warn_unused_result));
 
+/**
+ * Get the free generation of the reference counts of a block. This method
+ * must be called from the physical zone thread of the PBN.
+ *
+ * @param depot  The slab depot
+ * @param pbn    The physical block number that is being queried
+ *
+ * @return the free generation, or 0 if the block's slab is not loaded
+ **/
+uint64_t getPBNFreeGeneration(SlabDepot *depot, PhysicalBlockNumber pbn)
+  __attribute__((warn_unused_result));
+
 /**
  * Determine whether the given PBN refers to a data block.
  *
@@ -254,6 +266,34 @@ uint8_t getIncrementLimit(SlabDepot *depot, PhysicalBlockNumber pbn)
 bool isPhysicalDataBlock(const SlabDepot *depot, PhysicalBlockNumber pbn)
   __attribute__((warn_unused_result));
 
+/**
+ * Find where a block lies among the reference count and slab journal blocks
+ * of the depot's slabs, numbering those blocks consecutively, slab by slab.
+ * Slabs which are being added by a resize are included.
+ *
+ * @param [in]  depot     The depot
+ * @param [in]  pbn       The physical block number to ask about
+ * @param [out] indexPtr  A pointer to hold the index of the block among the
+ *                        slab metadata blocks
+ *
+ * @return <code>true</code> if the PBN is a slab metadata block
+ **/
+bool getSlabMetadataIndex(const SlabDepot     *depot,
+                          PhysicalBlockNumber  pbn,
+                          BlockCount          *indexPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the number of reference count and slab journal blocks in the depot's
+ * slabs, including any slabs which are being added by a resize.
+ *
+ * @param depot  The depot
+ *
+ * @return The number of slab metadata blocks
+ **/
+BlockCount getSlabMetadataBlockCount(const SlabDepot *depot)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the total number of data blocks allocated across all the slabs in the
  * depot, which is the total number of blocks with a non-zero reference count.
@@ -467,6 +507,94 @@ SlabSummary *getSlabSummary(const SlabDepot *depot)
 SlabSummaryZone *getSlabSummaryForZone(const SlabDepot *depot, ZoneCount zone)
   __attribute__((warn_unused_result));
 
+/**
+ * Set the number of slabs each zone of the depot may scrub at once. This may
+ * be called from any thread.
+ *
+ * @param depot        The slab depot
+ * @param concurrency  The number of slabs per zone, from 1 to
+ *                     MAX_SCRUB_CONCURRENCY
+ **/
+void setDepotScrubConcurrency(SlabDepot *depot, unsigned int concurrency);
+
+/**
+ * Get the number of slabs each zone of the depot may scrub at once.
+ *
+ * @param depot  The slab depot
+ *
+ * @return The number of slabs per zone
+ **/
+unsigned int getDepotScrubConcurrency(const SlabDepot *depot)
+  __attribute__((warn_unused_result));
+
+/**
+ * Limit the metadata bandwidth of background slab scrubbing. The limit is
+ * shared evenly by the physical zones. This may be called from any thread.
+ *
+ * @param depot            The slab depot
+ * @param blocksPerSecond  The number of metadata blocks per second to read
+ *                         and write, or 0 for no limit
+ **/
+void setDepotScrubRateLimit(SlabDepot *depot, uint32_t blocksPerSecond);
+
+/**
+ * Get the metadata bandwidth limit of background slab scrubbing.
+ *
+ * @param depot  The slab depot
+ *
+ * @return The number of blocks per second, or 0 if there is no limit
+ **/
+uint32_t getDepotScrubRateLimit(const SlabDepot *depot)
+  __attribute__((warn_unused_result));
+
+/**
+ * Resume any scrubbing in a zone which has been held back by the rate limit.
+ * This must be called periodically on the zone's thread while a rate limit is
+ * set.
+ *
+ * @param depot       The slab depot
+ * @param zoneNumber  The physical zone to check
+ **/
+void checkDepotScrubRateLimit(SlabDepot *depot, ZoneCount zoneNumber);
+
+/**
+ * Set how long freed data blocks wait before they are discarded on the
+ * storage. This may be called from any thread.
+ *
+ * @param depot         The slab depot
+ * @param milliseconds  The delay, or 0 to stop discarding freed blocks
+ **/
+void setDepotDiscardDelay(SlabDepot *depot, uint32_t milliseconds);
+
+/**
+ * Set the stripe geometry of the storage, so that allocations fill whole
+ * stripes. This must be called before the depot begins allocating.
+ *
+ * @param depot         The slab depot
+ * @param stripeBlocks  The number of data blocks in a full stripe, or 0 if
+ *                      allocations should ignore stripes
+ **/
+void setDepotStripeBlocks(SlabDepot *depot, BlockCount stripeBlocks);
+
+/**
+ * Get how long freed data blocks wait before they are discarded.
+ *
+ * @param depot  The slab depot
+ *
+ * @return The delay in milliseconds, or 0 if freed blocks are not discarded
+ **/
+uint32_t getDepotDiscardDelay(const SlabDepot *depot)
+  __attribute__((warn_unused_result));
+
+/**
+ * Start discarding the freed blocks of a zone whose delay has passed. This
+ * must be called periodically on the zone's thread while there is a delay.
+ *
+ * @param depot       The slab depot
+ * @param zoneNumber  The physical zone to check
+ **/
+void checkDepotDiscardDeadlines(SlabDepot *depot, ZoneCount zoneNumber);
+
 /**
  * Scrub all unrecovered slabs.
  *
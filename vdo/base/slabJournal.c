@@ -170,7 +170,8 @@ bool isSlabJournalActive(SlabJournal *journal)
           || isReaping(journal)
           || journal->waitingToCommit
           || !isRingEmpty(&journal->uncommittedBlocks)
-          || journal->updatingSlabSummary);
+          || journal->updatingSlabSummary
+          || journal->readingTail);
 }
 
 /**
@@ -218,6 +219,7 @@ static bool blockIsFull(SlabJournal *journal)
 
 /**********************************************************************/
 static void addEntries(SlabJournal *journal);
+static void readDeferredTail(SlabJournal *journal);
 static void updateTailBlockLocation(SlabJournal *journal);
 static void releaseJournalLocks(Waiter *waiter, void *context);
 
@@ -229,8 +231,9 @@ int makeSlabJournal(BlockAllocator   *allocator,
 {
   SlabJournal *journal;
   const SlabConfig *slabConfig = getSlabConfig(allocator->depot);
-  int result = ALLOCATE_EXTENDED(SlabJournal, slabConfig->slabJournalBlocks,
-                                 JournalLock, __func__, &journal);
+  int result = ARENA_ALLOCATE_EXTENDED(allocator->arena, SlabJournal,
+                                       slabConfig->slabJournalBlocks,
+                                       JournalLock, __func__, &journal);
   if (result != VDO_SUCCESS) {
     return result;
   }
@@ -283,8 +286,8 @@ void freeSlabJournal(SlabJournal **journalPtr)
     return;
   }
 
+  // The journal itself belongs to the allocator's arena.
   FREE(journal->block);
-  FREE(journal);
   *journalPtr = NULL;
 }
 
@@ -334,13 +337,69 @@ static void markSlabJournalClean(SlabJournal *journal)
   unspliceRingNode(&journal->dirtyNode);
 }
 
+static void addDeferredEntryFromWaiter(Waiter *waiter, void *context);
+
+/**
+ * Check whether a waiter in a slab journal's entry queue is a deferred
+ * decrement rather than a DataVIO.
+ *
+ * @param waiter  The waiter to check
+ *
+ * @return <code>true</code> if the waiter is a deferred decrement
+ **/
+static inline bool isDeferredDecrement(Waiter *waiter)
+{
+  return (waiter->callback == addDeferredEntryFromWaiter);
+}
+
+/**
+ * Convert a waiter in a slab journal's entry queue to a deferred decrement.
+ *
+ * @param waiter  The waiter to convert
+ *
+ * @return The waiter as a DeferredDecrement
+ **/
+static inline DeferredDecrement *waiterAsDeferredDecrement(Waiter *waiter)
+{
+  STATIC_ASSERT(offsetof(DeferredDecrement, waiter) == 0);
+  return (DeferredDecrement *) waiter;
+}
+
+/**
+ * Release a deferred decrement's reference on its recovery journal block and
+ * notify it of the result of making its entry.
+ *
+ * @param journal    The slab journal
+ * @param decrement  The decrement
+ * @param result     The result of making the entry
+ **/
+static void finishDeferredDecrement(SlabJournal       *journal,
+                                    DeferredDecrement *decrement,
+                                    int                result)
+{
+  if (journal->recoveryJournal != NULL) {
+    releaseRecoveryJournalBlockReference(journal->recoveryJournal,
+                                         decrement->recoveryJournalPoint
+                                         .sequenceNumber,
+                                         ZONE_TYPE_PHYSICAL,
+                                         journal->slab->allocator->zoneNumber);
+  }
+
+  decrement->callback(decrement, result);
+}
+
 /**
  * Implements WaiterCallback. This callback is invoked on all VIOs waiting
  * to make slab journal entries after the VDO has gone into read-only mode.
  **/
-static void abortWaiter(Waiter *waiter,
-                        void   *context __attribute__((unused)))
+static void abortWaiter(Waiter *waiter, void *context)
 {
+  if (isDeferredDecrement(waiter)) {
+    finishDeferredDecrement((SlabJournal *) context,
+                            waiterAsDeferredDecrement(waiter), VDO_READ_ONLY);
+    return;
+  }
+
   continueDataVIO(waiterAsDataVIO(waiter), VDO_READ_ONLY);
 }
 
@@ -794,6 +853,40 @@ SlabJournalEntry decodeSlabJournalEntry(PackedSlabJournalBlock *block,
   return entry;
 }
 
+/**
+ * Check whether a new entry continues a run begun by the last entry in the
+ * tail block, adjusting the next block of the slab in the same way. Such
+ * runs are what a run-length encoding of slab journal entries could
+ * collapse.
+ *
+ * @param journal    The slab journal
+ * @param sbn        The slab block number of the new entry
+ * @param operation  The operation of the new entry
+ *
+ * @return <code>true</code> if the entry continues a run
+ **/
+static bool continuesRun(SlabJournal      *journal,
+                         SlabBlockNumber   sbn,
+                         JournalOperation  operation)
+{
+  JournalEntryCount entryCount = journal->tailHeader.entryCount;
+  if (entryCount == 0) {
+    return false;
+  }
+
+  // The packed header is only filled in when the tail block is written, so
+  // check the unpacked one for block map increments.
+  const SlabJournalPayload *payload = &journal->block->payload;
+  JournalEntryCount         last    = entryCount - 1;
+  SlabJournalEntry previous = unpackSlabJournalEntry(&payload->entries[last]);
+  if (journal->tailHeader.hasBlockMapIncrements
+      && ((payload->fullEntries.entryTypes[last / 8]
+           & ((byte) 1 << (last % 8))) != 0)) {
+    previous.operation = BLOCK_MAP_INCREMENT;
+  }
+  return ((previous.operation == operation) && ((previous.sbn + 1) == sbn));
+}
+
 /**
  * Actually add an entry to the slab journal, potentially firing off a write
  * if a block becomes full. This function is synchronous.
@@ -832,8 +925,13 @@ static void addEntry(SlabJournal         *journal,
     }
   }
 
-  encodeSlabJournalEntry(&journal->tailHeader, &block->payload,
-                         pbn - journal->slab->start, operation);
+  SlabBlockNumber sbn = pbn - journal->slab->start;
+  if (continuesRun(journal, sbn, operation)) {
+    relaxedAdd64(&journal->events->entriesInRuns, 1);
+  }
+
+  encodeSlabJournalEntry(&journal->tailHeader, &block->payload, sbn,
+                         operation);
   journal->tailHeader.recoveryPoint = *recoveryPoint;
   if (blockIsFull(journal)) {
     commitSlabJournalTail(journal);
@@ -917,19 +1015,22 @@ bool requiresScrubbing(const SlabJournal *journal)
 }
 
 /**
- * Implements WaiterCallback. This callback is invoked by addEntries() once
- * it has determined that we are ready to make another entry in the slab
- * journal.
+ * Make an entry in the slab journal and update the reference counts. This is
+ * called by addEntries() once it has determined that we are ready to make
+ * another entry in the slab journal.
  *
- * @param waiter        The VIO which should make an entry now
- * @param context       The slab journal to make an entry in
+ * @param journal        The slab journal to make an entry in
+ * @param operation      The reference count change to journal
+ * @param recoveryPoint  The recovery journal entry of the change
+ *
+ * @return VDO_SUCCESS or an error from updating the reference counts
  **/
-static void addEntryFromWaiter(Waiter *waiter, void *context)
+static int makeEntry(SlabJournal        *journal,
+                     ReferenceOperation  operation,
+                     const JournalPoint *recoveryPoint)
 {
-  DataVIO     *dataVIO = waiterAsDataVIO(waiter);
-  SlabJournal *journal = (SlabJournal *) context;
   SlabJournalBlockHeader *header = &journal->tailHeader;
-  SequenceNumber recoveryBlock = dataVIO->recoveryJournalPoint.sequenceNumber;
+  SequenceNumber recoveryBlock = recoveryPoint->sequenceNumber;
 
   if (header->entryCount == 0) {
     /*
@@ -965,13 +1066,49 @@ static void addEntryFromWaiter(Waiter *waiter, void *context)
     .entryCount     = header->entryCount,
   };
 
-  addEntry(journal, dataVIO->operation.pbn, dataVIO->operation.type,
-           &dataVIO->recoveryJournalPoint);
+  addEntry(journal, operation.pbn, operation.type, recoveryPoint);
 
   // Now that an entry has been made in the slab journal, update the
   // reference counts.
-  int result = modifySlabReferenceCount(journal->slab, &slabJournalPoint,
-                                        dataVIO->operation);
+  return modifySlabReferenceCount(journal->slab, &slabJournalPoint,
+                                  operation);
+}
+
+/**
+ * Implements WaiterCallback. Make the slab journal entry for a deferred
+ * decrement. This is also the waiter callback registered in every deferred
+ * decrement, which is how they are distinguished from the DataVIOs waiting
+ * to make entries.
+ *
+ * @param waiter   The deferred decrement
+ * @param context  The slab journal to make an entry in
+ **/
+static void addDeferredEntryFromWaiter(Waiter *waiter, void *context)
+{
+  DeferredDecrement *decrement = waiterAsDeferredDecrement(waiter);
+  SlabJournal       *journal   = (SlabJournal *) context;
+  int result = makeEntry(journal, decrement->operation,
+                         &decrement->recoveryJournalPoint);
+  finishDeferredDecrement(journal, decrement, result);
+}
+
+/**
+ * Implements WaiterCallback. Make the slab journal entry for the next waiter
+ * in the entry queue.
+ *
+ * @param waiter   The DataVIO or deferred decrement making the entry
+ * @param context  The slab journal to make an entry in
+ **/
+static void addEntryFromWaiter(Waiter *waiter, void *context)
+{
+  if (isDeferredDecrement(waiter)) {
+    addDeferredEntryFromWaiter(waiter, context);
+    return;
+  }
+
+  DataVIO *dataVIO = waiterAsDataVIO(waiter);
+  int result = makeEntry((SlabJournal *) context, dataVIO->operation,
+                         &dataVIO->recoveryJournalPoint);
   continueDataVIO(dataVIO, result);
 }
 
@@ -985,8 +1122,12 @@ static void addEntryFromWaiter(Waiter *waiter, void *context)
  **/
 static inline bool isNextEntryABlockMapIncrement(SlabJournal *journal)
 {
-  DataVIO *dataVIO = waiterAsDataVIO(getFirstWaiter(&journal->entryWaiters));
-  return (dataVIO->operation.type == BLOCK_MAP_INCREMENT);
+  Waiter *waiter = getFirstWaiter(&journal->entryWaiters);
+  if (isDeferredDecrement(waiter)) {
+    return false;
+  }
+
+  return (waiterAsDataVIO(waiter)->operation.type == BLOCK_MAP_INCREMENT);
 }
 
 /**
@@ -1004,6 +1145,14 @@ static void addEntries(SlabJournal *journal)
     return;
   }
 
+  if (journal->tailUnread) {
+    // No entry can be made until the tail block has been read.
+    if (hasWaiters(&journal->entryWaiters)) {
+      readDeferredTail(journal);
+    }
+    return;
+  }
+
   journal->addingEntries = true;
   while (hasWaiters(&journal->entryWaiters)) {
     if (journal->partialWriteInProgress || slabIsRebuilding(journal->slab)) {
@@ -1113,6 +1262,51 @@ void addSlabJournalEntry(SlabJournal *journal, DataVIO *dataVIO)
 
   if (isUnrecoveredSlab(journal->slab) && requiresReaping(journal)) {
     increaseScrubbingPriority(journal->slab);
+  } else {
+    loadSlabOnDemand(journal->slab);
+  }
+
+  addEntries(journal);
+}
+
+/**********************************************************************/
+void addDeferredSlabJournalEntry(SlabJournal       *journal,
+                                 DeferredDecrement *decrement)
+{
+  if (!isSlabOpen(journal->slab)) {
+    decrement->callback(decrement, VDO_INVALID_ADMIN_STATE);
+    return;
+  }
+
+  if (isVDOReadOnly(journal)) {
+    decrement->callback(decrement, VDO_READ_ONLY);
+    return;
+  }
+
+  /*
+   * The DataVIO which journaled this decrement no longer holds a lock on its
+   * recovery journal block, so hold one on the decrement's behalf until the
+   * slab journal has one of its own.
+   */
+  if (journal->recoveryJournal != NULL) {
+    acquireRecoveryJournalBlockReference(journal->recoveryJournal,
+                                         decrement->recoveryJournalPoint
+                                         .sequenceNumber,
+                                         ZONE_TYPE_PHYSICAL,
+                                         journal->slab->allocator->zoneNumber);
+  }
+
+  decrement->waiter.callback = addDeferredEntryFromWaiter;
+  int result = enqueueWaiter(&journal->entryWaiters, &decrement->waiter);
+  if (result != VDO_SUCCESS) {
+    finishDeferredDecrement(journal, decrement, result);
+    return;
+  }
+
+  if (isUnrecoveredSlab(journal->slab) && requiresReaping(journal)) {
+    increaseScrubbingPriority(journal->slab);
+  } else {
+    loadSlabOnDemand(journal->slab);
   }
 
   addEntries(journal);
@@ -1181,6 +1375,11 @@ void drainSlabJournal(SlabJournal *journal)
   }
 
   switch (journal->slab->state.state) {
+  case ADMIN_STATE_SCRUBBING:
+    // A scrubbed slab will be allocated from, so its tail must be known.
+    readDeferredTail(journal);
+    break;
+
   case ADMIN_STATE_REBUILDING:
   case ADMIN_STATE_SUSPENDING:
   case ADMIN_STATE_SAVE_FOR_SCRUBBING:
@@ -1203,7 +1402,20 @@ static void finishDecodingJournal(VDOCompletion *completion)
   VIOPoolEntry *entry   = completion->parent;
   SlabJournal  *journal = entry->parent;
   returnVIO(journal->slab->allocator, entry);
-  notifySlabJournalIsLoaded(journal->slab, result);
+  if (!journal->readingTail) {
+    notifySlabJournalIsLoaded(journal->slab, result);
+    return;
+  }
+
+  journal->readingTail = false;
+  journal->tailUnread  = false;
+  if (result != VDO_SUCCESS) {
+    enterJournalReadOnlyMode(journal, result);
+  } else {
+    addEntries(journal);
+  }
+
+  checkIfSlabDrained(journal->slab);
 }
 
 /**
@@ -1294,6 +1506,20 @@ void decodeSlabJournal(SlabJournal *journal)
     return;
   }
 
+  if (isCleanLoad(&slab->state)
+      && mustLoadRefCounts(journal->summary, slab->slabNumber)
+      && getSummarizedCleanliness(journal->summary, slab->slabNumber)) {
+    /*
+     * A clean slab with saved reference counts won't be allocated from until
+     * the scrubber has loaded them in the background, so its tail block
+     * needn't be read now either. It will be read when the slab is scrubbed,
+     * or sooner if an entry is made in its journal.
+     */
+    journal->tailUnread = true;
+    notifySlabJournalIsLoaded(slab, VDO_SUCCESS);
+    return;
+  }
+
   journal->resourceWaiter.callback = readSlabJournalTail;
   int result = acquireVIO(slab->allocator, &journal->resourceWaiter);
   if (result != VDO_SUCCESS) {
@@ -1301,6 +1527,27 @@ void decodeSlabJournal(SlabJournal *journal)
   }
 }
 
+/**
+ * Read the tail block of a journal whose read was deferred at load, if it
+ * has not already been read or started.
+ *
+ * @param journal  The journal
+ **/
+static void readDeferredTail(SlabJournal *journal)
+{
+  if (!journal->tailUnread || journal->readingTail) {
+    return;
+  }
+
+  journal->readingTail             = true;
+  journal->resourceWaiter.callback = readSlabJournalTail;
+  int result = acquireVIO(journal->slab->allocator, &journal->resourceWaiter);
+  if (result != VDO_SUCCESS) {
+    journal->readingTail = false;
+    enterJournalReadOnlyMode(journal, result);
+  }
+}
+
 /**********************************************************************/
 void dumpSlabJournal(const SlabJournal *journal)
 {
@@ -24,8 +24,39 @@
 
 #include "completion.h"
 #include "journalPoint.h"
+#include "referenceOperation.h"
 #include "ringNode.h"
 #include "types.h"
+#include "waitQueue.h"
+
+typedef struct deferredDecrement DeferredDecrement;
+
+/**
+ * A callback to be invoked once a deferred decrement has been made (or has
+ * failed).
+ *
+ * @param decrement  The decrement
+ * @param result     The result of making the decrement
+ **/
+typedef void DeferredDecrementCallback(DeferredDecrement *decrement,
+                                       int                result);
+
+/**
+ * A decrement which is made on behalf of a DataVIO which has gone on without
+ * waiting for it. It waits in the slab journal's entry queue in the place the
+ * DataVIO would have, so slab journal entries are still made in recovery
+ * journal order.
+ **/
+struct deferredDecrement {
+  /** The entry in the slab journal's queue of entries to be made */
+  Waiter                     waiter;
+  /** The decrement to make */
+  ReferenceOperation         operation;
+  /** The recovery journal entry of the decrement */
+  JournalPoint               recoveryJournalPoint;
+  /** The callback to invoke once the decrement has been made */
+  DeferredDecrementCallback *callback;
+};
 
 /**
  * Convert a completion to a SlabJournal.
@@ -152,6 +183,17 @@ bool attemptReplayIntoSlabJournal(SlabJournal         *journal,
  **/
 void addSlabJournalEntry(SlabJournal *journal, DataVIO *dataVIO);
 
+/**
+ * Add a deferred decrement to a slab journal. The journal holds a reference
+ * on the recovery journal block of the decrement until the entry has been
+ * made, and then invokes the decrement's callback.
+ *
+ * @param journal    The slab journal to use
+ * @param decrement  The decrement to make
+ **/
+void addDeferredSlabJournalEntry(SlabJournal       *journal,
+                                 DeferredDecrement *decrement);
+
 /**
  * Adjust the reference count for a slab journal block. Note that when the
  * adjustment is negative, the slab journal will be reaped.
@@ -191,6 +191,10 @@ struct slabJournal {
   bool                         addingEntries;
   /** Whether a partial write is in progress */
   bool                         partialWriteInProgress;
+  /** Whether reading the tail block was deferred when the slab was loaded */
+  bool                         tailUnread;
+  /** Whether the deferred read of the tail block is in progress */
+  bool                         readingTail;
 
   /** The oldest block in the journal on disk */
   SequenceNumber               head;
@@ -23,6 +23,8 @@
 
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "numeric.h"
+#include "timeUtils.h"
 
 #include "adminState.h"
 #include "blockAllocator.h"
@@ -34,30 +36,33 @@
 #include "slab.h"
 #include "slabJournalInternals.h"
 
+enum {
+  MICROSECONDS_PER_SECOND = 1000000,
+};
+
 /**
  * Allocate the buffer and extent used for reading the slab journal when
- * scrubbing a slab.
+ * scrubbing a slab in one of a scrubber's slots.
  *
- * @param scrubber         The slab scrubber for which to allocate
+ * @param slot             The slot for which to allocate
  * @param layer            The physical layer on which the scrubber resides
  * @param slabJournalSize  The size of a slab journal
  *
  * @return VDO_SUCCESS or an error
  **/
 __attribute__((warn_unused_result))
-static int allocateExtentAndBuffer(SlabScrubber  *scrubber,
+static int allocateExtentAndBuffer(ScrubSlot     *slot,
                                    PhysicalLayer *layer,
                                    BlockCount     slabJournalSize)
 {
   size_t bufferSize = VDO_BLOCK_SIZE * slabJournalSize;
-  int result = ALLOCATE(bufferSize, char, __func__, &scrubber->journalData);
+  int result = ALLOCATE(bufferSize, char, __func__, &slot->journalData);
   if (result != VDO_SUCCESS) {
     return result;
   }
 
   return createExtent(layer, VIO_TYPE_SLAB_JOURNAL, VIO_PRIORITY_METADATA,
-                      slabJournalSize, scrubber->journalData,
-                      &scrubber->extent);
+                      slabJournalSize, slot->journalData, &slot->extent);
 }
 
 /**********************************************************************/
@@ -72,10 +77,14 @@ int makeSlabScrubber(PhysicalLayer     *layer,
     return result;
   }
 
-  result = allocateExtentAndBuffer(scrubber, layer, slabJournalSize);
-  if (result != VDO_SUCCESS) {
-    freeSlabScrubber(&scrubber);
-    return result;
+  for (unsigned int i = 0; i < MAX_SCRUB_CONCURRENCY; i++) {
+    ScrubSlot *slot = &scrubber->slots[i];
+    slot->scrubber  = scrubber;
+    result = allocateExtentAndBuffer(slot, layer, slabJournalSize);
+    if (result != VDO_SUCCESS) {
+      freeSlabScrubber(&scrubber);
+      return result;
+    }
   }
 
   initializeCompletion(&scrubber->completion, SLAB_SCRUBBER_COMPLETION, layer);
@@ -83,21 +92,25 @@ int makeSlabScrubber(PhysicalLayer     *layer,
   initializeRing(&scrubber->slabs);
   scrubber->readOnlyNotifier = readOnlyNotifier;
   scrubber->adminState.state = ADMIN_STATE_SUSPENDED;
-  *scrubberPtr               = scrubber;
+  relaxedStore32(&scrubber->concurrency, DEFAULT_SCRUB_CONCURRENCY);
+  *scrubberPtr = scrubber;
   return VDO_SUCCESS;
 }
 
 /**
- * Free the extent and buffer used for reading slab journals.
+ * Free the extents and buffers used for reading slab journals.
  *
  * @param scrubber  The scrubber
  **/
 static void freeExtentAndBuffer(SlabScrubber *scrubber)
 {
-  freeExtent(&scrubber->extent);
-  if (scrubber->journalData != NULL) {
-    FREE(scrubber->journalData);
-    scrubber->journalData = NULL;
+  for (unsigned int i = 0; i < MAX_SCRUB_CONCURRENCY; i++) {
+    ScrubSlot *slot = &scrubber->slots[i];
+    freeExtent(&slot->extent);
+    if (slot->journalData != NULL) {
+      FREE(slot->journalData);
+      slot->journalData = NULL;
+    }
   }
 }
 
@@ -209,6 +222,17 @@ static void finishScrubbing(SlabScrubber *scrubber)
 /**********************************************************************/
 static void scrubNextSlab(SlabScrubber *scrubber);
 
+/**
+ * Release a slot once the slab in it has been scrubbed or abandoned.
+ *
+ * @param slot  The slot to release
+ **/
+static void releaseSlot(ScrubSlot *slot)
+{
+  slot->slab = NULL;
+  slot->scrubber->activeSlots--;
+}
+
 /**
  * Notify the scrubber that a slab has been scrubbed. This callback is
  * registered in applyJournalEntries().
@@ -217,20 +241,25 @@ static void scrubNextSlab(SlabScrubber *scrubber);
  **/
 static void slabScrubbed(VDOCompletion *completion)
 {
-  SlabScrubber *scrubber = completion->parent;
-  finishScrubbingSlab(scrubber->slab);
+  ScrubSlot    *slot     = completion->parent;
+  SlabScrubber *scrubber = slot->scrubber;
+  finishScrubbingSlab(slot->slab);
+  releaseSlot(slot);
   relaxedAdd64(&scrubber->slabCount, -1);
+  relaxedAdd64(&scrubber->slabsScrubbed, 1);
   scrubNextSlab(scrubber);
 }
 
 /**
  * Abort scrubbing due to an error.
  *
- * @param scrubber  The slab scrubber
- * @param result    The error
+ * @param slot    The slot whose slab could not be scrubbed
+ * @param result  The error
  **/
-static void abortScrubbing(SlabScrubber *scrubber, int result)
+static void abortScrubbing(ScrubSlot *slot, int result)
 {
+  SlabScrubber *scrubber = slot->scrubber;
+  releaseSlot(slot);
   enterReadOnlyMode(scrubber->readOnlyNotifier, result);
   setCompletionResult(&scrubber->completion, result);
   scrubNextSlab(scrubber);
@@ -304,15 +333,15 @@ static int applyBlockEntries(PackedSlabJournalBlock *block,
  **/
 static void applyJournalEntries(VDOCompletion *completion)
 {
-  SlabScrubber *scrubber        = completion->parent;
-  Slab         *slab            = scrubber->slab;
+  ScrubSlot    *slot            = completion->parent;
+  Slab         *slab            = slot->slab;
   SlabJournal  *journal         = slab->journal;
   RefCounts    *referenceCounts = slab->referenceCounts;
 
   // Find the boundaries of the useful part of the journal.
   SequenceNumber  tail     = journal->tail;
   TailBlockOffset endIndex = getSlabJournalBlockOffset(journal, tail - 1);
-  char *endData = scrubber->journalData + (endIndex * VDO_BLOCK_SIZE);
+  char *endData = slot->journalData + (endIndex * VDO_BLOCK_SIZE);
   PackedSlabJournalBlock *endBlock = (PackedSlabJournalBlock *) endData;
 
   SequenceNumber  head      = getUInt64LE(endBlock->header.fields.head);
@@ -322,7 +351,7 @@ static void applyJournalEntries(VDOCompletion *completion)
   JournalPoint refCountsPoint   = referenceCounts->slabJournalPoint;
   JournalPoint lastEntryApplied = refCountsPoint;
   for (SequenceNumber sequence = head; sequence < tail; sequence++) {
-    char *blockData = scrubber->journalData + (index * VDO_BLOCK_SIZE);
+    char *blockData = slot->journalData + (index * VDO_BLOCK_SIZE);
     PackedSlabJournalBlock *block  = (PackedSlabJournalBlock *) blockData;
     SlabJournalBlockHeader header;
     unpackSlabJournalBlockHeader(&block->header, &header);
@@ -336,13 +365,13 @@ static void applyJournalEntries(VDOCompletion *completion)
       // The block is not what we expect it to be.
       logError("Slab journal block for slab %u was invalid",
                slab->slabNumber);
-      abortScrubbing(scrubber, VDO_CORRUPT_JOURNAL);
+      abortScrubbing(slot, VDO_CORRUPT_JOURNAL);
       return;
     }
 
     int result = applyBlockEntries(block, header.entryCount, sequence, slab);
     if (result != VDO_SUCCESS) {
-      abortScrubbing(scrubber, result);
+      abortScrubbing(slot, result);
       return;
     }
 
@@ -359,13 +388,13 @@ static void applyJournalEntries(VDOCompletion *completion)
   int result = ASSERT(!beforeJournalPoint(&lastEntryApplied, &refCountsPoint),
                       "Refcounts are not more accurate than the slab journal");
   if (result != VDO_SUCCESS) {
-    abortScrubbing(scrubber, result);
+    abortScrubbing(slot, result);
     return;
   }
 
   // Save out the rebuilt reference blocks.
   prepareCompletion(completion, slabScrubbed, handleScrubberError,
-                    completion->callbackThreadID, scrubber);
+                    completion->callbackThreadID, slot);
   startSlabAction(slab, ADMIN_STATE_SAVE_FOR_SCRUBBING, completion);
 }
 
@@ -377,21 +406,107 @@ static void applyJournalEntries(VDOCompletion *completion)
  **/
 static void startScrubbing(VDOCompletion *completion)
 {
-  SlabScrubber *scrubber = completion->parent;
-  Slab         *slab     = scrubber->slab;
+  ScrubSlot *slot = completion->parent;
+  Slab      *slab = slot->slab;
   if (getSummarizedCleanliness(slab->allocator->summary, slab->slabNumber)) {
     slabScrubbed(completion);
     return;
   }
 
-  prepareCompletion(&scrubber->extent->completion, applyJournalEntries,
+  prepareCompletion(&slot->extent->completion, applyJournalEntries,
                     handleScrubberError, completion->callbackThreadID,
                     completion->parent);
-  readMetadataExtent(scrubber->extent, slab->journalOrigin);
+  readMetadataExtent(slot->extent, slab->journalOrigin);
 }
 
 /**
- * Scrub the next slab if there is one.
+ * Get the slab which should be scrubbed next in the current run.
+ *
+ * @param scrubber  The scrubber
+ *
+ * @return The next slab to scrub or <code>NULL</code> if the run is done
+ **/
+static Slab *getNextSlabForRun(SlabScrubber *scrubber)
+{
+  if (scrubber->highPriorityOnly
+      && isRingEmpty(&scrubber->highPrioritySlabs)) {
+    return NULL;
+  }
+
+  return getNextSlab(scrubber);
+}
+
+/**
+ * Check whether the rate limit allows a slab to be scrubbed now, and if so,
+ * charge the blocks it will read and write against the budget. Slabs which
+ * are needed to make progress are never held back: the high-priority ones,
+ * and any while VIOs are waiting for a clean slab.
+ *
+ * @param scrubber  The scrubber
+ * @param slab      The slab to be scrubbed
+ *
+ * @return <code>true</code> if the slab may be scrubbed now
+ **/
+static bool mayScrubSlab(SlabScrubber *scrubber, Slab *slab)
+{
+  uint32_t rate = relaxedLoad32(&scrubber->rateLimit);
+  if ((rate == 0) || scrubber->highPriorityOnly
+      || !isRingEmpty(&scrubber->highPrioritySlabs)
+      || hasWaiters(&scrubber->waiters)) {
+    return true;
+  }
+
+  // Replenish the budget for the time since it was last replenished, but
+  // never bank more than a second's worth.
+  uint64_t now     = nowUsec();
+  uint64_t elapsed = minUInt64(now - scrubber->budgetTime,
+                               MICROSECONDS_PER_SECOND);
+  scrubber->budget    += (elapsed * rate) / MICROSECONDS_PER_SECOND;
+  scrubber->budgetTime = now;
+  if (scrubber->budget > rate) {
+    scrubber->budget = rate;
+  }
+  if (scrubber->budget <= 0) {
+    return false;
+  }
+
+  scrubber->budget -= (slab->journal->size
+                       + slab->referenceCounts->referenceBlockCount);
+  return true;
+}
+
+/**
+ * Start scrubbing a slab in an idle slot.
+ *
+ * @param scrubber  The scrubber
+ * @param slab      The slab to scrub
+ **/
+static void startScrubbingSlab(SlabScrubber *scrubber, Slab *slab)
+{
+  ScrubSlot *slot = NULL;
+  for (unsigned int i = 0; i < MAX_SCRUB_CONCURRENCY; i++) {
+    if (scrubber->slots[i].slab == NULL) {
+      slot = &scrubber->slots[i];
+      break;
+    }
+  }
+
+  unspliceRingNode(&slab->ringNode);
+  slot->slab = slab;
+  scrubber->activeSlots++;
+  VDOCompletion *completion = extentAsCompletion(slot->extent);
+  prepareCompletion(completion, startScrubbing,
+                    handleScrubberError, scrubber->completion.callbackThreadID,
+                    slot);
+  startSlabAction(slab, ADMIN_STATE_SCRUBBING, completion);
+}
+
+/**
+ * Scrub as many of the remaining slabs at once as the concurrency and rate
+ * limits allow. Once the last slab in progress has been scrubbed and no more
+ * can be started, either finish scrubbing, finish draining, or, if the rate
+ * limit is what is holding scrubbing back, wait for
+ * checkScrubberRateLimit() to resume it.
  *
  * @param scrubber  The scrubber
  **/
@@ -400,32 +515,49 @@ static void scrubNextSlab(SlabScrubber *scrubber)
   // Note: this notify call is always safe only because scrubbing can only
   // be started when the VDO is quiescent.
   notifyAllWaiters(&scrubber->waiters, NULL, NULL);
+
+  // A slab may finish scrubbing before it has even been started, so don't
+  // refill the slots from inside the loop which is already filling them.
+  if (scrubber->launching) {
+    return;
+  }
+
+  scrubber->launching   = true;
+  scrubber->rateLimited = false;
+  while (!isReadOnly(scrubber->readOnlyNotifier)
+         && !isDraining(&scrubber->adminState)
+         && (scrubber->activeSlots < getScrubberConcurrency(scrubber))) {
+    Slab *slab = getNextSlabForRun(scrubber);
+    if (slab == NULL) {
+      break;
+    }
+
+    if (!mayScrubSlab(scrubber, slab)) {
+      scrubber->rateLimited = true;
+      break;
+    }
+
+    startScrubbingSlab(scrubber, slab);
+  }
+  scrubber->launching = false;
+
+  if (scrubber->activeSlots > 0) {
+    return;
+  }
+
   if (isReadOnly(scrubber->readOnlyNotifier)) {
     setCompletionResult(&scrubber->completion, VDO_READ_ONLY);
     finishScrubbing(scrubber);
     return;
   }
 
-  Slab *slab = getNextSlab(scrubber);
-  if ((slab == NULL)
-      || (scrubber->highPriorityOnly
-          && isRingEmpty(&scrubber->highPrioritySlabs))) {
+  if (getNextSlabForRun(scrubber) == NULL) {
     scrubber->highPriorityOnly = false;
     finishScrubbing(scrubber);
     return;
   }
 
-  if (finishDraining(&scrubber->adminState)) {
-    return;
-  }
-
-  unspliceRingNode(&slab->ringNode);
-  scrubber->slab = slab;
-  VDOCompletion *completion = extentAsCompletion(scrubber->extent);
-  prepareCompletion(completion, startScrubbing,
-                    handleScrubberError, scrubber->completion.callbackThreadID,
-                    scrubber);
-  startSlabAction(slab, ADMIN_STATE_SCRUBBING, completion);
+  finishDraining(&scrubber->adminState);
 }
 
 /**********************************************************************/
@@ -443,6 +575,9 @@ void scrubSlabs(SlabScrubber *scrubber,
     return;
   }
 
+  relaxedStore64(&scrubber->runStartTime, nowUsec());
+  relaxedStore64(&scrubber->runStartScrubbed,
+                 relaxedLoad64(&scrubber->slabsScrubbed));
   scrubNextSlab(scrubber);
 }
 
@@ -463,13 +598,29 @@ void scrubHighPrioritySlabs(SlabScrubber  *scrubber,
   scrubSlabs(scrubber, parent, callback, errorHandler);
 }
 
+/**
+ * Initiate a drain. If no slab is being scrubbed, the scrubber is waiting
+ * for the rate limit and can stop immediately; otherwise it stops once the
+ * slabs in progress have been scrubbed.
+ *
+ * Implements AdminInitiator.
+ **/
+static void initiateDrain(AdminState *state)
+{
+  SlabScrubber *scrubber = container_of(state, SlabScrubber, adminState);
+  if (scrubber->activeSlots == 0) {
+    finishDraining(state);
+  }
+}
+
 /**********************************************************************/
 void stopScrubbing(SlabScrubber *scrubber, VDOCompletion *parent)
 {
   if (isQuiescent(&scrubber->adminState)) {
     completeCompletion(parent);
   } else {
-    startDraining(&scrubber->adminState, ADMIN_STATE_SUSPENDING, parent, NULL);
+    startDraining(&scrubber->adminState, ADMIN_STATE_SUSPENDING, parent,
+                  initiateDrain);
   }
 }
 
@@ -505,12 +656,71 @@ int enqueueCleanSlabWaiter(SlabScrubber *scrubber, Waiter *waiter)
   return enqueueWaiter(&scrubber->waiters, waiter);
 }
 
+/**********************************************************************/
+void setScrubberConcurrency(SlabScrubber *scrubber, unsigned int concurrency)
+{
+  if (concurrency < 1) {
+    concurrency = 1;
+  } else if (concurrency > MAX_SCRUB_CONCURRENCY) {
+    concurrency = MAX_SCRUB_CONCURRENCY;
+  }
+  relaxedStore32(&scrubber->concurrency, concurrency);
+}
+
+/**********************************************************************/
+unsigned int getScrubberConcurrency(const SlabScrubber *scrubber)
+{
+  return relaxedLoad32(&scrubber->concurrency);
+}
+
+/**********************************************************************/
+void setScrubberRateLimit(SlabScrubber *scrubber, uint32_t blocksPerSecond)
+{
+  relaxedStore32(&scrubber->rateLimit, blocksPerSecond);
+}
+
+/**********************************************************************/
+uint32_t getScrubberRateLimit(const SlabScrubber *scrubber)
+{
+  return relaxedLoad32(&scrubber->rateLimit);
+}
+
+/**********************************************************************/
+void checkScrubberRateLimit(SlabScrubber *scrubber)
+{
+  if (scrubber->rateLimited && !isQuiescent(&scrubber->adminState)
+      && !isDraining(&scrubber->adminState)) {
+    scrubNextSlab(scrubber);
+  }
+}
+
+/**********************************************************************/
+uint64_t getScrubbedSlabCount(const SlabScrubber *scrubber)
+{
+  return relaxedLoad64(&scrubber->slabsScrubbed);
+}
+
+/**********************************************************************/
+uint64_t getScrubbingSecondsRemaining(const SlabScrubber *scrubber)
+{
+  SlabCount remaining = getScrubberSlabCount(scrubber);
+  uint64_t  scrubbed  = (relaxedLoad64(&scrubber->slabsScrubbed)
+                         - relaxedLoad64(&scrubber->runStartScrubbed));
+  if ((remaining == 0) || (scrubbed == 0)) {
+    return 0;
+  }
+
+  uint64_t elapsed = nowUsec() - relaxedLoad64(&scrubber->runStartTime);
+  return ((elapsed * remaining) / scrubbed) / MICROSECONDS_PER_SECOND;
+}
+
 /**********************************************************************/
 void dumpSlabScrubber(const SlabScrubber *scrubber)
 {
-  logInfo("slabScrubber slabCount %u waiters %zu %s%s",
-          getScrubberSlabCount(scrubber),
+  logInfo("slabScrubber slabCount %u active %u waiters %zu %s%s%s",
+          getScrubberSlabCount(scrubber), scrubber->activeSlots,
           countWaiters(&scrubber->waiters),
           getAdminStateName(&scrubber->adminState),
-          scrubber->highPriorityOnly ? ", highPriorityOnly " : "");
+          scrubber->highPriorityOnly ? ", highPriorityOnly " : "",
+          scrubber->rateLimited ? ", rateLimited " : "");
 }
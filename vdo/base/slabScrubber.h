@@ -26,6 +26,13 @@
 #include "types.h"
 #include "waitQueue.h"
 
+enum {
+  /** The most slabs a scrubber can scrub at once */
+  MAX_SCRUB_CONCURRENCY     = 4,
+  /** The number of slabs a scrubber scrubs at once unless told otherwise */
+  DEFAULT_SCRUB_CONCURRENCY = MAX_SCRUB_CONCURRENCY,
+};
+
 /**
  * Create a slab scrubber
  *
@@ -130,6 +137,79 @@ void resumeScrubbing(SlabScrubber *scrubber, VDOCompletion *parent);
  **/
 int enqueueCleanSlabWaiter(SlabScrubber *scrubber, Waiter *waiter);
 
+/**
+ * Set the number of slabs a scrubber may scrub at once. This may be called
+ * from any thread; the new limit applies to the next slab started.
+ *
+ * @param scrubber     The scrubber
+ * @param concurrency  The number of slabs, which is clamped to the range
+ *                     1 to MAX_SCRUB_CONCURRENCY
+ **/
+void setScrubberConcurrency(SlabScrubber *scrubber, unsigned int concurrency);
+
+/**
+ * Get the number of slabs a scrubber may scrub at once.
+ *
+ * @param scrubber  The scrubber to query
+ *
+ * @return The number of slabs which may be scrubbed at once
+ **/
+unsigned int getScrubberConcurrency(const SlabScrubber *scrubber)
+  __attribute__((warn_unused_result));
+
+/**
+ * Limit the rate at which a scrubber reads slab journals and writes reference
+ * blocks when scrubbing in the background. The limit does not apply while
+ * there are high-priority slabs or VIOs waiting for a clean slab. This may be
+ * called from any thread.
+ *
+ * @param scrubber         The scrubber
+ * @param blocksPerSecond  The number of metadata blocks per second, or 0 for
+ *                         no limit
+ **/
+void setScrubberRateLimit(SlabScrubber *scrubber, uint32_t blocksPerSecond);
+
+/**
+ * Get the rate limit for background scrubbing.
+ *
+ * @param scrubber  The scrubber to query
+ *
+ * @return The number of metadata blocks per second, or 0 if there is no limit
+ **/
+uint32_t getScrubberRateLimit(const SlabScrubber *scrubber)
+  __attribute__((warn_unused_result));
+
+/**
+ * Resume scrubbing if it has been waiting for the rate limit and the limit
+ * now allows more slabs to be scrubbed. This must be called periodically on
+ * the scrubber's thread whenever a rate limit is set.
+ *
+ * @param scrubber  The scrubber
+ **/
+void checkScrubberRateLimit(SlabScrubber *scrubber);
+
+/**
+ * Get the number of slabs a scrubber has scrubbed since the VDO was loaded.
+ *
+ * @param scrubber  The scrubber to query
+ *
+ * @return The number of slabs scrubbed
+ **/
+uint64_t getScrubbedSlabCount(const SlabScrubber *scrubber)
+  __attribute__((warn_unused_result));
+
+/**
+ * Estimate how long a scrubber will take to scrub its remaining slabs, from
+ * the rate at which it has scrubbed since it was last started.
+ *
+ * @param scrubber  The scrubber to query
+ *
+ * @return The estimated number of seconds, or 0 if there is nothing to scrub
+ *         or no slab has been scrubbed yet
+ **/
+uint64_t getScrubbingSecondsRemaining(const SlabScrubber *scrubber)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the number of slabs that are unrecovered or being scrubbed.
  *
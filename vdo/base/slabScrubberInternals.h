@@ -29,6 +29,17 @@
 #include "extent.h"
 #include "ringNode.h"
 
+typedef struct {
+  /** The scrubber which owns this slot */
+  SlabScrubber *scrubber;
+  /** The slab being scrubbed in this slot, or NULL if the slot is idle */
+  Slab         *slab;
+  /** The extent for loading slab journal blocks */
+  VDOExtent    *extent;
+  /** A buffer to store the slab journal blocks */
+  char         *journalData;
+} ScrubSlot;
+
 struct slabScrubber {
   VDOCompletion     completion;
   /** The queue of slabs to scrub first */
@@ -42,18 +53,35 @@ struct slabScrubber {
   // modified by the physical zone thread, but is queried by other threads.
   Atomic64          slabCount;
 
+  /** The number of slabs which have been scrubbed since loading */
+  Atomic64          slabsScrubbed;
+  /** The time at which the current run of scrubbing started */
+  Atomic64          runStartTime;
+  /** The value of slabsScrubbed when the current run started */
+  Atomic64          runStartScrubbed;
+  /** The number of slabs which may be scrubbed at once */
+  Atomic32          concurrency;
+  /** The metadata blocks per second background scrubbing may use, or 0 */
+  Atomic32          rateLimit;
+
   /** The administrative state of the scrubber */
   AdminState        adminState;
   /** Whether to only scrub high-priority slabs */
   bool              highPriorityOnly;
+  /** Whether slots are being filled, so finished slabs mustn't refill them */
+  bool              launching;
+  /** Whether background scrubbing is waiting for the rate limit */
+  bool              rateLimited;
+  /** The number of slots which are scrubbing a slab */
+  unsigned int      activeSlots;
+  /** The blocks of I/O which may be issued before the rate limit applies */
+  int64_t           budget;
+  /** The time at which the budget was last replenished */
+  uint64_t          budgetTime;
   /** The context for entering read-only mode */
   ReadOnlyNotifier *readOnlyNotifier;
-  /** The slab currently being scrubbed */
-  Slab             *slab;
-  /** The extent for loading slab journal blocks */
-  VDOExtent        *extent;
-  /** A buffer to store the slab journal blocks */
-  char             *journalData;
+  /** The slots for scrubbing several slabs at once */
+  ScrubSlot         slots[MAX_SCRUB_CONCURRENCY];
 };
 
 #endif // SLAB_SCRUBBER_INTERNALS_H
@@ -101,7 +101,7 @@ static BlockCount getApproximateFreeBlocks(SlabSummary *summary,
 // MAKE/FREE FUNCTIONS
 
 /**********************************************************************/
-static void launchWrite(SlabSummaryBlock *summaryBlock);
+static void launchWrites(SlabSummaryZone *summaryZone);
 
 /**
  * Initialize a SlabSummaryBlock.
@@ -332,13 +332,35 @@ static void notifyWaiters(SlabSummaryZone *summaryZone, WaitQueue *queue)
  **/
 static void finishUpdatingSlabSummaryBlock(SlabSummaryBlock *block)
 {
-  notifyWaiters(block->zone, &block->currentUpdateWaiters);
+  SlabSummaryZone *zone = block->zone;
+  notifyWaiters(zone, &block->currentUpdateWaiters);
   block->writing = false;
-  block->zone->writeCount--;
-  if (hasWaiters(&block->nextUpdateWaiters)) {
-    launchWrite(block);
-  } else {
-    checkForDrainComplete(block->zone);
+  if (--zone->writeCount > 0) {
+    return;
+  }
+
+  // The batch is done, so write whatever has been updated since it started.
+  launchWrites(zone);
+  checkForDrainComplete(zone);
+}
+
+/**
+ * Finish every block in the batch being written without writing them,
+ * because the VDO is in read-only mode.
+ *
+ * @param summaryZone  The zone whose batch is to be abandoned
+ **/
+static void abandonWrites(SlabSummaryZone *summaryZone)
+{
+  // Once the last block is finished, another batch may start, so don't
+  // look at any blocks after that.
+  BlockCount remaining = summaryZone->writeCount;
+  for (BlockCount i = 0; remaining > 0; i++) {
+    SlabSummaryBlock *block = &summaryZone->summaryBlocks[i];
+    if (block->writing) {
+      remaining--;
+      finishUpdatingSlabSummaryBlock(block);
+    }
   }
 }
 
@@ -368,37 +390,92 @@ static void handleWriteError(VDOCompletion *completion)
 }
 
 /**
- * Write a slab summary block unless it is currently out for writing.
+ * Handle an error flushing before writing a batch of slab summary blocks.
  *
- * @param [in] block  The block that needs to be committed
+ * @param completion  The flush VIO
  **/
-static void launchWrite(SlabSummaryBlock *block)
+static void handleFlushError(VDOCompletion *completion)
 {
-  if (block->writing) {
+  SlabSummaryBlock *block = completion->parent;
+  enterReadOnlyMode(block->zone->summary->readOnlyNotifier,
+                    completion->result);
+  abandonWrites(block->zone);
+}
+
+/**
+ * Write each block in a batch now that the layer has been flushed. The
+ * blocks are written in order so that adjacent ones can be coalesced by the
+ * layer. This callback is registered in launchWrites().
+ *
+ * @param completion  The flush VIO
+ **/
+static void writeBatch(VDOCompletion *completion)
+{
+  SlabSummaryZone *zone    = ((SlabSummaryBlock *) completion->parent)->zone;
+  SlabSummary     *summary = zone->summary;
+  PhysicalBlockNumber zoneOrigin
+    = summary->origin + (summary->blocksPerZone * zone->zoneNumber);
+
+  // Once the last block is launched, it may finish and start another batch,
+  // so don't look at any blocks after that.
+  BlockCount remaining = zone->writeCount;
+  for (BlockCount i = 0; remaining > 0; i++) {
+    SlabSummaryBlock *block = &zone->summaryBlocks[i];
+    if (block->writing) {
+      remaining--;
+      launchWriteMetadataVIOWithFlush(block->vio, zoneOrigin + block->index,
+                                      finishUpdate, handleWriteError, false,
+                                      false);
+    }
+  }
+}
+
+/**
+ * Write every block of a zone which has updates waiting, unless a batch of
+ * writes is already in progress, in which case the updates will be written
+ * by the next batch once it finishes. The whole batch shares one flush.
+ *
+ * @param summaryZone  The zone whose blocks need to be committed
+ **/
+static void launchWrites(SlabSummaryZone *summaryZone)
+{
+  if (summaryZone->writeCount > 0) {
     return;
   }
 
-  SlabSummaryZone *zone = block->zone;
-  zone->writeCount++;
-  transferAllWaiters(&block->nextUpdateWaiters, &block->currentUpdateWaiters);
-  block->writing = true;
+  SlabSummary      *summary = summaryZone->summary;
+  SlabSummaryBlock *first   = NULL;
+  for (BlockCount i = 0; i < summary->blocksPerZone; i++) {
+    SlabSummaryBlock *block = &summaryZone->summaryBlocks[i];
+    if (!hasWaiters(&block->nextUpdateWaiters)) {
+      continue;
+    }
 
-  SlabSummary *summary = zone->summary;
-  if (isReadOnly(summary->readOnlyNotifier)) {
-    finishUpdatingSlabSummaryBlock(block);
+    transferAllWaiters(&block->nextUpdateWaiters,
+                       &block->currentUpdateWaiters);
+    memcpy(block->outgoingEntries, block->entries,
+           sizeof(SlabSummaryEntry) * summary->entriesPerBlock);
+    block->writing = true;
+    summaryZone->writeCount++;
+    if (first == NULL) {
+      first = block;
+    }
+  }
+
+  if (first == NULL) {
     return;
   }
 
-  memcpy(block->outgoingEntries, block->entries,
-         sizeof(SlabSummaryEntry) * summary->entriesPerBlock);
+  if (isReadOnly(summary->readOnlyNotifier)) {
+    abandonWrites(summaryZone);
+    return;
+  }
 
   // Flush before writing to ensure that the slab journal tail blocks and
-  // reference updates covered by this summary update are stable (VDO-2332).
-  PhysicalBlockNumber pbn = (summary->origin
-                             + (summary->blocksPerZone * zone->zoneNumber)
-                             + block->index);
-  launchWriteMetadataVIOWithFlush(block->vio, pbn, finishUpdate,
-                                  handleWriteError, true, false);
+  // reference updates covered by these summary updates are stable
+  // (VDO-2332).
+  atomicAdd64(&summary->statistics.batchesWritten, 1);
+  launchFlush(first->vio, writeBatch, handleFlushError);
 }
 
 /**
@@ -477,7 +554,7 @@ void updateSlabSummaryEntry(SlabSummaryZone *summaryZone,
     return;
   }
 
-  launchWrite(block);
+  launchWrites(summaryZone);
 }
 
 /**********************************************************************/
@@ -646,6 +723,7 @@ SlabSummaryStatistics getSlabSummaryStatistics(const SlabSummary *summary)
 {
   const AtomicSlabSummaryStatistics *atoms = &summary->statistics;
   return (SlabSummaryStatistics) {
-    .blocksWritten = atomicLoad64(&atoms->blocksWritten),
+    .blocksWritten  = atomicLoad64(&atoms->blocksWritten),
+    .batchesWritten = atomicLoad64(&atoms->batchesWritten),
   };
 }
@@ -53,7 +53,7 @@ typedef struct slabSummaryBlock {
   SlabSummaryZone  *zone;
   /** The index of this block in its zone's summary */
   BlockCount        index;
-  /** Whether this block has a write outstanding */
+  /** Whether this block is in the batch being written */
   bool              writing;
   /** Ring of updates waiting on the outstanding write */
   WaitQueue         currentUpdateWaiters;
@@ -75,6 +75,8 @@ typedef struct slabSummaryBlock {
 typedef struct atomicSlabSummaryStatistics {
   /** Number of blocks written */
   Atomic64 blocksWritten;
+  /** Number of batches of blocks written, each with a single flush */
+  Atomic64 batchesWritten;
 } AtomicSlabSummaryStatistics;
 
 struct slabSummaryZone {
@@ -82,7 +84,7 @@ struct slabSummaryZone {
   SlabSummary      *summary;
   /** The number of this zone */
   ZoneCount         zoneNumber;
-  /** Count of the number of blocks currently out for writing */
+  /** Count of the blocks in the batch which is currently being written */
   BlockCount        writeCount;
   /** The state of this zone */
   AdminState        state;
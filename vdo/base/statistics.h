@@ -34,6 +34,26 @@ typedef struct {
   uint64_t slabsOpened;
   /** The number of times since loading that a slab has been re-opened */
   uint64_t slabsReopened;
+  /** The number of allocations which waited for a slab to be scrubbed */
+  uint64_t allocationStalls;
+  /** The total microseconds allocations waited for slabs to be scrubbed */
+  uint64_t stallMicroseconds;
+  /** The number of slabs scrubbed since loading */
+  uint64_t slabsScrubbed;
+  /** The number of slabs which are unrecovered or being scrubbed */
+  uint64_t slabsToScrub;
+  /** The estimated seconds until every zone has finished scrubbing */
+  uint64_t scrubSecondsRemaining;
+  /** The number of slab metadata I/Os which waited for a VIO */
+  uint64_t vioPoolWaits;
+  /** The total microseconds the slab metadata VIO pools had waiters */
+  uint64_t vioPoolWaitMicroseconds;
+  /** The number of VIOs in the slab metadata VIO pools */
+  uint64_t vioPoolSize;
+  /** The number of runs of freed blocks discarded on the storage */
+  uint64_t discardsPassedDown;
+  /** The number of freed blocks discarded on the storage */
+  uint64_t blocksPassedDown;
 } BlockAllocatorStatistics;
 
 /**
@@ -62,6 +82,11 @@ typedef struct {
   CommitStatistics entries;
   /** Write/Commit totals for journal blocks */
   CommitStatistics blocks;
+  /**
+   * Number of entries written which continue a run of the previous entry
+   * of the same operation in their block
+   **/
+  uint64_t entriesInRuns;
 } RecoveryJournalStatistics;
 
 /** The statistics for the compressed block packer. */
@@ -86,18 +111,33 @@ typedef struct {
   uint64_t blocksWritten;
   /** Number of times we had to wait for the tail to write */
   uint64_t tailBusyCount;
+  /**
+   * Number of entries which continue a run of increments or decrements of
+   * consecutive blocks in their tail block
+   **/
+  uint64_t entriesInRuns;
 } SlabJournalStatistics;
 
 /** The statistics for the slab summary. */
 typedef struct {
   /** Number of blocks written */
   uint64_t blocksWritten;
+  /** Number of batches of blocks written, each with a single flush */
+  uint64_t batchesWritten;
 } SlabSummaryStatistics;
 
 /** The statistics for the reference counts. */
 typedef struct {
   /** Number of reference blocks written */
   uint64_t blocksWritten;
+  /** Number of reference blocks which are dirty and not yet writing */
+  uint64_t dirtyBlocks;
+  /** Number of times paced reference block writes were held back */
+  uint64_t writesDeferred;
+  /** Average reference block write latency in microseconds */
+  uint64_t writeLatency;
+  /** Paced reference block write rate in blocks per second */
+  uint64_t writeRate;
 } RefCountsStatistics;
 
 /** The statistics for the block map. */
@@ -142,6 +182,40 @@ typedef struct {
   uint64_t pagesSaved;
   /** the number of flushes issued */
   uint64_t flushCount;
+  /** number of gets for pages still on the probation list */
+  uint64_t probationHits;
+  /** number of loads of recently evicted probationary pages */
+  uint64_t ghostHits;
+  /** number of pages evicted */
+  uint64_t evictions;
+  /** number of evicted pages which were still on probation */
+  uint64_t probationEvictions;
+  /** total page requests between each evicted page's last use and eviction */
+  uint64_t evictionAge;
+  /** number of pages read in ahead of any request for them */
+  uint64_t prefetchReads;
+  /** number of prefetched pages which were requested */
+  uint64_t prefetchHits;
+  /** number of prefetched pages dropped without having been requested */
+  uint64_t prefetchWasted;
+  /** number of mapped entries in the leaf pages written */
+  uint64_t entriesWritten;
+  /** number of contiguous extents those entries would collapse into */
+  uint64_t extentsWritten;
+  /** number of tree pages found to read by the last forest traversal */
+  uint64_t traversalPagesQueued;
+  /** number of those tree pages which have been read */
+  uint64_t traversalPagesLoaded;
+  /** number of journal blocks a dirty page may currently stay unwritten */
+  uint64_t eraLength;
+  /** number of eras shortened because the journal was nearly full */
+  uint64_t shortenedEras;
+  /** number of tree page I/Os which waited for a VIO */
+  uint64_t vioPoolWaits;
+  /** total microseconds the tree page VIO pools had waiters */
+  uint64_t vioPoolWaitMicroseconds;
+  /** number of VIOs in the tree page VIO pools */
+  uint64_t vioPoolSize;
 } BlockMapStatistics;
 
 /** The dedupe statistics from hash locks */
@@ -154,6 +228,12 @@ typedef struct {
   uint64_t concurrentDataMatches;
   /** Number of writes whose hash collided with an in-flight write */
   uint64_t concurrentHashCollisions;
+  /** Number of queries answered by the hash zone advice caches */
+  uint64_t adviceCacheHits;
+  /** Number of queries which missed the hash zone advice caches */
+  uint64_t adviceCacheMisses;
+  /** Number of times unchanged UDS advice was trusted without a verify */
+  uint64_t dedupeAdviceTrusted;
 } HashLockStatistics;
 
 /** Counts of error conditions in VDO. */
@@ -176,6 +256,10 @@ struct vdoStatistics {
   uint64_t overheadBlocksUsed;
   /** Number of logical blocks that are currently mapped to physical blocks */
   uint64_t logicalBlocksUsed;
+  /** Number of queued writes acknowledged once a later write superseded them */
+  uint64_t writesAbsorbed;
+  /** Number of writes to hot blocks not deduplicated or compressed */
+  uint64_t hotWritesBypassed;
   /** number of physical blocks */
   BlockCount physicalBlocks;
   /** number of logical blocks */
@@ -41,11 +41,15 @@ struct superBlock {
   VIO                  *vio;
   /** The buffer for encoding and decoding component data */
   Buffer               *componentBuffer;
+  /** The buffer for encoding and decoding extension data */
+  Buffer               *extensionBuffer;
   /**
    * A sector-sized buffer wrapping the first sector of encodedSuperBlock, for
    * encoding and decoding the entire super block.
    **/
   Buffer               *blockBuffer;
+  /** A buffer wrapping the rest of encodedSuperBlock, for the extension */
+  Buffer               *extensionBlockBuffer;
   /** A 1-block buffer holding the encoded on-disk super block */
   byte                 *encodedSuperBlock;
   /** The release version number loaded from the volume */
@@ -58,6 +62,9 @@ enum {
   SUPER_BLOCK_FIXED_SIZE
     = ENCODED_HEADER_SIZE + sizeof(ReleaseVersionNumber) + CHECKSUM_SIZE,
   MAX_COMPONENT_DATA_SIZE = VDO_SECTOR_SIZE - SUPER_BLOCK_FIXED_SIZE,
+  EXTENSION_BLOCK_SIZE    = VDO_BLOCK_SIZE - VDO_SECTOR_SIZE,
+  EXTENSION_FIXED_SIZE    = ENCODED_HEADER_SIZE + CHECKSUM_SIZE,
+  MAX_EXTENSION_DATA_SIZE = EXTENSION_BLOCK_SIZE - EXTENSION_FIXED_SIZE,
 };
 
 static const Header SUPER_BLOCK_HEADER_12_0 = {
@@ -71,6 +78,17 @@ static const Header SUPER_BLOCK_HEADER_12_0 = {
   .size = SUPER_BLOCK_FIXED_SIZE - ENCODED_HEADER_SIZE,
 };
 
+static const Header SUPER_BLOCK_EXTENSION_HEADER_1_0 = {
+  .id = SUPER_BLOCK_EXTENSION,
+  .version = {
+    .majorVersion = 1,
+    .minorVersion = 0,
+  },
+
+  // This is the minimum size, if the extension contains no data.
+  .size = CHECKSUM_SIZE,
+};
+
 /**
  * Allocate a super block. Callers must free the allocated super block even
  * on error.
@@ -94,6 +112,11 @@ static int allocateSuperBlock(PhysicalLayer *layer, SuperBlock **superBlockPtr)
     return result;
   }
 
+  result = makeBuffer(MAX_EXTENSION_DATA_SIZE, &superBlock->extensionBuffer);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
   result = layer->allocateIOBuffer(layer, VDO_BLOCK_SIZE,
                                    "encoded super block",
                                    (char **) &superBlock->encodedSuperBlock);
@@ -109,6 +132,15 @@ static int allocateSuperBlock(PhysicalLayer *layer, SuperBlock **superBlockPtr)
     return result;
   }
 
+  // The extension has its own checksum, so a torn write of the rest of the
+  // block can only lose the extension.
+  result = wrapBuffer(superBlock->encodedSuperBlock + VDO_SECTOR_SIZE,
+                      EXTENSION_BLOCK_SIZE, 0,
+                      &superBlock->extensionBlockBuffer);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
   if (layer->createMetadataVIO == NULL) {
     return VDO_SUCCESS;
   }
@@ -142,7 +174,9 @@ void freeSuperBlock(SuperBlock **superBlockPtr)
   }
 
   SuperBlock *superBlock = *superBlockPtr;
+  freeBuffer(&superBlock->extensionBlockBuffer);
   freeBuffer(&superBlock->blockBuffer);
+  freeBuffer(&superBlock->extensionBuffer);
   freeBuffer(&superBlock->componentBuffer);
   freeVIO(&superBlock->vio);
   FREE(superBlock->encodedSuperBlock);
@@ -150,6 +184,46 @@ void freeSuperBlock(SuperBlock **superBlockPtr)
   *superBlockPtr = NULL;
 }
 
+/**
+ * Encode the extension of a super block into the sectors following the
+ * super block proper. The extension is always rewritten, even when it is
+ * empty, so that a stale extension is never left behind.
+ *
+ * @param layer       The physical layer which implements the checksum
+ * @param superBlock  The super block whose extension is to be encoded
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+__attribute__((warn_unused_result))
+static int encodeExtension(PhysicalLayer *layer, SuperBlock *superBlock)
+{
+  Buffer *buffer = superBlock->extensionBlockBuffer;
+  int     result = resetBufferEnd(buffer, 0);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  size_t extensionDataSize = contentLength(superBlock->extensionBuffer);
+  Header header            = SUPER_BLOCK_EXTENSION_HEADER_1_0;
+  header.size += extensionDataSize;
+  result = encodeHeader(&header, buffer);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  result = putBytes(buffer, extensionDataSize,
+                    getBufferContents(superBlock->extensionBuffer));
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  CRC32Checksum checksum
+    = layer->updateCRC32(INITIAL_CHECKSUM,
+                         superBlock->encodedSuperBlock + VDO_SECTOR_SIZE,
+                         contentLength(buffer));
+  return putUInt32LEIntoBuffer(buffer, checksum);
+}
+
 /**
  * Encode a super block into its on-disk representation.
  *
@@ -199,7 +273,7 @@ static int encodeSuperBlock(PhysicalLayer *layer, SuperBlock *superBlock)
     return result;
   }
 
-  return UDS_SUCCESS;
+  return encodeExtension(layer, superBlock);
 }
 
 /**********************************************************************/
@@ -281,6 +355,53 @@ void saveSuperBlockAsync(SuperBlock          *superBlock,
                                   true, true);
 }
 
+/**
+ * Decode the extension of a super block. Since the extension only holds
+ * hints, an extension which can not be decoded is quietly discarded, which
+ * is the normal case for a volume last saved by an older release.
+ *
+ * @param layer       The physical layer which implements the checksum
+ * @param superBlock  The super block whose extension is to be decoded
+ **/
+static void decodeExtension(PhysicalLayer *layer, SuperBlock *superBlock)
+{
+  Buffer *extension = superBlock->extensionBuffer;
+  if (resetBufferEnd(extension, 0) != VDO_SUCCESS) {
+    return;
+  }
+
+  Buffer *buffer = superBlock->extensionBlockBuffer;
+  clearBuffer(buffer);
+
+  Header header;
+  if ((decodeHeader(buffer, &header) != VDO_SUCCESS)
+      || (header.id != SUPER_BLOCK_EXTENSION_HEADER_1_0.id)
+      || !areSameVersion(header.version,
+                         SUPER_BLOCK_EXTENSION_HEADER_1_0.version)
+      || (header.size < SUPER_BLOCK_EXTENSION_HEADER_1_0.size)
+      || (header.size > contentLength(buffer))) {
+    return;
+  }
+
+  // Checksum everything up to but not including the saved checksum itself.
+  size_t        dataSize = header.size - CHECKSUM_SIZE;
+  byte         *data     = getBufferContents(buffer);
+  CRC32Checksum checksum
+    = layer->updateCRC32(INITIAL_CHECKSUM,
+                         superBlock->encodedSuperBlock + VDO_SECTOR_SIZE,
+                         ENCODED_HEADER_SIZE + dataSize);
+  CRC32Checksum savedChecksum;
+  if ((skipForward(buffer, dataSize) != UDS_SUCCESS)
+      || (getUInt32LEFromBuffer(buffer, &savedChecksum) != UDS_SUCCESS)
+      || (checksum != savedChecksum)) {
+    return;
+  }
+
+  if (putBytes(extension, dataSize, data) != UDS_SUCCESS) {
+    logWarning("cannot decode super block extension");
+  }
+}
+
 /**
  * Decode a super block from its on-disk representation.
  *
@@ -354,7 +475,12 @@ static int decodeSuperBlock(PhysicalLayer *layer, SuperBlock *superBlock)
     return result;
   }
 
-  return ((checksum != savedChecksum) ? VDO_CHECKSUM_MISMATCH : VDO_SUCCESS);
+  if (checksum != savedChecksum) {
+    return VDO_CHECKSUM_MISMATCH;
+  }
+
+  decodeExtension(layer, superBlock);
+  return VDO_SUCCESS;
 }
 
 /**********************************************************************/
@@ -428,6 +554,12 @@ Buffer *getComponentBuffer(SuperBlock *superBlock)
   return superBlock->componentBuffer;
 }
 
+/**********************************************************************/
+Buffer *getExtensionBuffer(SuperBlock *superBlock)
+{
+  return superBlock->extensionBuffer;
+}
+
 /**********************************************************************/
 ReleaseVersionNumber getLoadedReleaseVersion(const SuperBlock *superBlock)
 {
@@ -112,6 +112,20 @@ void loadSuperBlockAsync(VDOCompletion        *parent,
 Buffer *getComponentBuffer(SuperBlock *superBlock)
   __attribute__((warn_unused_result));
 
+/**
+ * Get a buffer which contains the extension data of a super block. The
+ * extension lives in the sectors of the super block's block which follow the
+ * super block proper, and holds hints which are not needed to load the VDO.
+ * An extension which is torn, or which was not written by this release, is
+ * discarded when the super block is decoded, leaving the buffer empty.
+ *
+ * @param superBlock  The super block from which to get the extension data
+ *
+ * @return the extension data in a buffer
+ **/
+Buffer *getExtensionBuffer(SuperBlock *superBlock)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the release version number that was loaded from the volume when the
  * SuperBlock was decoded.
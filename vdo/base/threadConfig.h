@@ -30,13 +30,16 @@ struct threadConfig {
   ZoneCount    logicalZoneCount;
   ZoneCount    physicalZoneCount;
   ZoneCount    hashZoneCount;
+  ZoneCount    packerZoneCount;
   ThreadCount  baseThreadCount;
   ThreadID     adminThread;
   ThreadID     journalThread;
-  ThreadID     packerThread;
   ThreadID    *logicalThreads;
   ThreadID    *physicalThreads;
   ThreadID    *hashZoneThreads;
+  ThreadID    *packerThreads;
+  /** The memory node preferred by each thread, indexed by thread ID */
+  int         *threadNodes;
 };
 
 /**
@@ -47,6 +50,8 @@ struct threadConfig {
  * @param [in]  logicalZoneCount    The number of logical zones
  * @param [in]  physicalZoneCount   The number of physical zones
  * @param [in]  hashZoneCount       The number of hash zones
+ * @param [in]  packerZoneCount     The number of packer zones; 0 is treated
+ *                                  as 1
  * @param [out] configPtr           A pointer to hold the new thread
  *                                  configuration
  *
@@ -55,6 +60,7 @@ struct threadConfig {
 int makeThreadConfig(ZoneCount      logicalZoneCount,
                      ZoneCount      physicalZoneCount,
                      ZoneCount      hashZoneCount,
+                     ZoneCount      packerZoneCount,
                      ThreadConfig **configPtr)
   __attribute__((warn_unused_result));
 
@@ -162,16 +168,39 @@ static inline ThreadID getJournalZoneThread(const ThreadConfig *threadConfig)
 }
 
 /**
- * Get the thread id for the packer zone.
+ * Get the thread id for a given packer zone. Zone 0 is also the thread on
+ * which flush notifications are started.
  *
  * @param threadConfig  the thread config
+ * @param packerZone    the number of the packer zone
  *
- * @return the thread id for the packer zone
+ * @return the thread id for the given zone
  **/
 __attribute__((warn_unused_result))
-static inline ThreadID getPackerZoneThread(const ThreadConfig *threadConfig)
+static inline ThreadID getPackerZoneThread(const ThreadConfig *threadConfig,
+                                           ZoneCount           packerZone)
 {
-  return threadConfig->packerThread;
+  ASSERT_LOG_ONLY((packerZone < threadConfig->packerZoneCount),
+                  "packer zone valid");
+  return threadConfig->packerThreads[packerZone];
+}
+
+/**
+ * Get the packer zone which packs the fragments of a given hash zone. Since
+ * a hash lock's agent and the DataVIOs which might cancel it share a hash
+ * zone, routing by hash zone keeps each cancellation within one packer.
+ *
+ * @param threadConfig  the thread config
+ * @param hashZone      the number of the hash zone
+ *
+ * @return the number of the packer zone for the given hash zone
+ **/
+__attribute__((warn_unused_result))
+static inline
+ZoneCount getPackerZoneForHashZone(const ThreadConfig *threadConfig,
+                                   ZoneCount           hashZone)
+{
+  return (hashZone % threadConfig->packerZoneCount);
 }
 
 /**
@@ -187,6 +216,28 @@ static inline ThreadID getAdminThread(const ThreadConfig *threadConfig)
   return threadConfig->adminThread;
 }
 
+/**
+ * Get the memory node on which a thread runs and on which the structures it
+ * owns should be allocated.
+ *
+ * @param threadConfig  The thread config
+ * @param threadID      The thread id
+ *
+ * @return The node, or ANY_MEMORY_NODE if the thread has not been placed
+ **/
+int getThreadNode(const ThreadConfig *threadConfig, ThreadID threadID)
+  __attribute__((warn_unused_result));
+
+/**
+ * Set the memory node on which a thread should run and on which the
+ * structures it owns should be allocated.
+ *
+ * @param threadConfig  The thread config
+ * @param threadID      The thread id
+ * @param node          The node, or ANY_MEMORY_NODE
+ **/
+void setThreadNode(ThreadConfig *threadConfig, ThreadID threadID, int node);
+
 /**
  * Format the name of the worker thread desired to support a given
  * work queue. The physical layer may add a prefix identifying the
@@ -271,6 +271,39 @@ typedef enum {
                                ///< underlying device
 } WritePolicy;
 
+/**
+ * The possible block map page cache replacement policies.
+ **/
+typedef enum {
+  PAGE_CACHE_POLICY_LRU,       ///< Evict the least recently used page.
+  PAGE_CACHE_POLICY_2Q,        ///< Admit new pages to a FIFO probation list
+                               ///< and only promote pages which are needed
+                               ///< again shortly after they were evicted,
+                               ///< so that scans do not flush hot pages.
+} PageCachePolicy;
+
+/**
+ * The possible ways of making recovery journal commits stable.
+ **/
+typedef enum {
+  JOURNAL_COMMIT_FLUSH,        ///< Flush the device cache before writing
+                               ///< each journal block.
+  JOURNAL_COMMIT_FUA,          ///< In async mode, write data and journal
+                               ///< blocks with FUA instead, for storage with
+                               ///< power-loss protection or efficient FUA.
+} JournalCommitPolicy;
+
+/**
+ * The possible ways of choosing the physical zone a write allocates from.
+ **/
+typedef enum {
+  ALLOCATION_POLICY_ROUND_ROBIN, ///< Move on to the next physical zone every
+                                 ///< few allocations.
+  ALLOCATION_POLICY_LOCALITY,    ///< Keep each logical zone on one physical
+                                 ///< zone for a slab's worth of allocations,
+                                 ///< so its writes stay sequential.
+} AllocationPolicy;
+
 typedef enum {
   ZONE_TYPE_ADMIN,
   ZONE_TYPE_JOURNAL,
@@ -349,6 +382,14 @@ typedef struct vdoLoadConfig {
   WritePolicy           writePolicy;
   /** the maximum age of a dirty block map page in recovery journal blocks */
   BlockCount            maximumAge;
+  /** the replacement policy of the block map page cache */
+  PageCachePolicy       cachePolicy;
+  /** how recovery journal commits are made stable */
+  JournalCommitPolicy   journalCommitPolicy;
+  /** how writes choose the physical zone to allocate from */
+  AllocationPolicy      allocationPolicy;
+  /** the data blocks in a full stripe of the storage, or 0 if unknown */
+  BlockCount            stripeBlocks;
 } VDOLoadConfig;
 
 /**
@@ -136,7 +136,7 @@ int makeVDO(PhysicalLayer *layer, VDO **vdoPtr)
 void destroyVDO(VDO *vdo)
 {
   freeFlusher(&vdo->flusher);
-  freePacker(&vdo->packer);
+  freePackerZones(&vdo->packerZones);
   freeRecoveryJournal(&vdo->recoveryJournal);
   freeSlabDepot(&vdo->depot);
   freeVDOLayout(&vdo->layout);
@@ -327,7 +327,14 @@ static int encodeVDO(VDO *vdo)
 
   ASSERT_LOG_ONLY((contentLength(buffer) == getComponentDataSize(vdo)),
                   "All super block component data was encoded");
-  return VDO_SUCCESS;
+
+  Buffer *extension = getExtensionBuffer(vdo->superBlock);
+  result = resetBufferEnd(extension, 0);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  return encodeBlockMapWarmPages(vdo->blockMap, extension);
 }
 
 /**********************************************************************/
@@ -789,9 +796,9 @@ bool setVDOCompressing(VDO *vdo, bool enableCompression)
   bool stateChanged = compareAndSwapBool(&vdo->compressing, !enableCompression,
                                          enableCompression);
   if (stateChanged && !enableCompression) {
-    // Flushing the packer is asynchronous, but we don't care when it
+    // Flushing the packers is asynchronous, but we don't care when it
     // finishes.
-    flushPacker(vdo->packer);
+    flushPackerZones(vdo->packerZones);
   }
 
   logInfo("compression is %s", (enableCompression ? "enabled" : "disabled"));
@@ -805,9 +812,9 @@ bool getVDOCompressing(VDO *vdo)
 }
 
 /**********************************************************************/
-static size_t getBlockMapCacheSize(const VDO *vdo)
+static size_t getBlockMapCacheBytes(const VDO *vdo)
 {
-  return ((size_t) vdo->loadConfig.cacheSize) * VDO_BLOCK_SIZE;
+  return ((size_t) getBlockMapCacheSize(vdo->blockMap)) * VDO_BLOCK_SIZE;
 }
 
 /**
@@ -829,6 +836,9 @@ static HashLockStatistics getHashLockStatistics(const VDO *vdo)
     totals.dedupeAdviceStale        += stats.dedupeAdviceStale;
     totals.concurrentDataMatches    += stats.concurrentDataMatches;
     totals.concurrentHashCollisions += stats.concurrentHashCollisions;
+    totals.adviceCacheHits          += stats.adviceCacheHits;
+    totals.adviceCacheMisses        += stats.adviceCacheMisses;
+    totals.dedupeAdviceTrusted      += stats.dedupeAdviceTrusted;
   }
 
   return totals;
@@ -887,7 +897,7 @@ void getVDOStatistics(const VDO *vdo, VDOStatistics *stats)
   stats->blockSize          = VDO_BLOCK_SIZE;
   stats->completeRecoveries = vdo->completeRecoveries;
   stats->readOnlyRecoveries = vdo->readOnlyRecoveries;
-  stats->blockMapCacheSize  = getBlockMapCacheSize(vdo);
+  stats->blockMapCacheSize  = getBlockMapCacheBytes(vdo);
   snprintf(stats->writePolicy, sizeof(stats->writePolicy), "%s",
            describeWritePolicy(getWritePolicy(vdo)));
 
@@ -895,9 +905,11 @@ void getVDOStatistics(const VDO *vdo, VDOStatistics *stats)
   stats->dataBlocksUsed     = getPhysicalBlocksAllocated(vdo);
   stats->overheadBlocksUsed = getPhysicalBlocksOverhead(vdo);
   stats->logicalBlocksUsed  = getJournalLogicalBlocksUsed(journal);
+  stats->writesAbsorbed     = getAbsorbedWriteCount(vdo->logicalZones);
+  stats->hotWritesBypassed  = getHotWriteBypassCount(vdo->logicalZones);
   stats->allocator          = getDepotBlockAllocatorStatistics(depot);
   stats->journal            = getRecoveryJournalStatistics(journal);
-  stats->packer             = getPackerStatistics(vdo->packer);
+  stats->packer             = getPackerStatistics(vdo->packerZones);
   stats->slabJournal        = getDepotSlabJournalStatistics(depot);
   stats->slabSummary        = getSlabSummaryStatistics(getSlabSummary(depot));
   stats->refCounts          = getDepotRefCountsStatistics(depot);
@@ -956,6 +968,27 @@ void setWritePolicy(VDO *vdo, WritePolicy new)
   vdo->loadConfig.writePolicy = new;
 }
 
+/**********************************************************************/
+int setActiveHashZoneCount(VDO *vdo, ZoneCount count)
+{
+  ZoneCount threads = getThreadConfig(vdo)->hashZoneCount;
+  if ((count == 0) || (count > threads)) {
+    return logErrorWithStringError(VDO_BAD_CONFIGURATION,
+                                   "Hash zone count %u must be between 1"
+                                   " and %u", count, threads);
+  }
+
+  vdo->activeHashZones = count;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+bool writesDataWithFUA(const VDO *vdo)
+{
+  return ((vdo->loadConfig.journalCommitPolicy == JOURNAL_COMMIT_FUA)
+          && (getWritePolicy(vdo) == WRITE_POLICY_ASYNC));
+}
+
 /**********************************************************************/
 const VDOLoadConfig *getVDOLoadConfig(const VDO *vdo)
 {
@@ -968,6 +1001,12 @@ const ThreadConfig *getThreadConfig(const VDO *vdo)
   return vdo->loadConfig.threadConfig;
 }
 
+/**********************************************************************/
+PackerZones *getVDOPackerZones(const VDO *vdo)
+{
+  return vdo->packerZones;
+}
+
 /**********************************************************************/
 BlockCount getConfiguredBlockMapMaximumAge(const VDO *vdo)
 {
@@ -980,6 +1019,18 @@ PageCount getConfiguredCacheSize(const VDO *vdo)
   return vdo->loadConfig.cacheSize;
 }
 
+/**********************************************************************/
+PageCachePolicy getConfiguredCachePolicy(const VDO *vdo)
+{
+  return vdo->loadConfig.cachePolicy;
+}
+
+/**********************************************************************/
+AllocationPolicy getConfiguredAllocationPolicy(const VDO *vdo)
+{
+  return vdo->loadConfig.allocationPolicy;
+}
+
 /**********************************************************************/
 PhysicalBlockNumber getFirstBlockOffset(const VDO *vdo)
 {
@@ -1009,10 +1060,12 @@ void dumpVDOStatus(const VDO *vdo)
 {
   dumpFlusher(vdo->flusher);
   dumpRecoveryJournalStatistics(vdo->recoveryJournal);
-  dumpPacker(vdo->packer);
+  const ThreadConfig *threadConfig = getThreadConfig(vdo);
+  for (ZoneCount zone = 0; zone < threadConfig->packerZoneCount; zone++) {
+    dumpPacker(getPackerZone(vdo->packerZones, zone));
+  }
   dumpSlabDepot(vdo->depot);
 
-  const ThreadConfig *threadConfig = getThreadConfig(vdo);
   for (ZoneCount zone = 0; zone < threadConfig->logicalZoneCount; zone++) {
     dumpLogicalZone(getLogicalZone(vdo->logicalZones, zone));
   }
@@ -1086,7 +1139,7 @@ HashZone *selectHashZone(const VDO *vdo, const UdsChunkName *name)
    * uniformly distributed over [0 .. count-1]. The multiply and shift is much
    * faster than a divide (modulus) on X86 CPUs.
    */
-  return vdo->hashZones[(hash * getThreadConfig(vdo)->hashZoneCount) >> 8];
+  return vdo->hashZones[(hash * vdo->activeHashZones) >> 8];
 }
 
 /**********************************************************************/
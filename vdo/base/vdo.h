@@ -22,6 +22,7 @@
 #ifndef VDO_H
 #define VDO_H
 
+#include "packer.h"
 #include "types.h"
 
 /**
@@ -71,7 +72,8 @@ void freeVDO(VDO **vdoPtr);
 void makeVDOReadOnly(VDO *vdo, int errorCode);
 
 /**
- * Set whether compression is enabled in VDO.
+ * Set whether compression is enabled in VDO. This must be called from the
+ * admin thread.
  *
  * @param vdo                The VDO
  * @param enableCompression  Whether to enable compression in VDO
@@ -154,6 +156,32 @@ WritePolicy getWritePolicy(const VDO *vdo);
  **/
 void setWritePolicy(VDO *vdo, WritePolicy new);
 
+/**
+ * Change the number of hash zones chunk names are spread over. Each name
+ * always goes to the same zone for a given count, and the hash zones only
+ * hold state while requests are in progress, so this may only be done
+ * while the VDO is suspended. The count can't exceed the number of hash
+ * zone threads the VDO was started with.
+ *
+ * @param vdo    The VDO
+ * @param count  The number of hash zones to use
+ *
+ * @return VDO_SUCCESS or VDO_BAD_CONFIGURATION if the count is out of range
+ **/
+int setActiveHashZoneCount(VDO *vdo, ZoneCount count)
+  __attribute__((warn_unused_result));
+
+/**
+ * Check whether data blocks must be written with FUA because the recovery
+ * journal will not flush before committing the entries which map them.
+ *
+ * @param vdo  The VDO
+ *
+ * @return <code>true</code> if data writes must be issued with FUA
+ **/
+bool writesDataWithFUA(const VDO *vdo)
+  __attribute__((warn_unused_result));
+
 /**
  * Get a copy of the load-time configuration of the VDO.
  *
@@ -174,6 +202,16 @@ const VDOLoadConfig *getVDOLoadConfig(const VDO *vdo)
 const ThreadConfig *getThreadConfig(const VDO *vdo)
   __attribute__((warn_unused_result));
 
+/**
+ * Get the compressed block packers of the VDO.
+ *
+ * @param vdo  The VDO
+ *
+ * @return The packer zones
+ **/
+PackerZones *getVDOPackerZones(const VDO *vdo)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the configured maximum age of a dirty block map page.
  *
@@ -194,6 +232,26 @@ BlockCount getConfiguredBlockMapMaximumAge(const VDO *vdo)
 PageCount getConfiguredCacheSize(const VDO *vdo)
   __attribute__((warn_unused_result));
 
+/**
+ * Get the configured page cache replacement policy of the VDO.
+ *
+ * @param vdo  The VDO
+ *
+ * @return The replacement policy for the page cache
+ **/
+PageCachePolicy getConfiguredCachePolicy(const VDO *vdo)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the configured physical zone allocation policy of the VDO.
+ *
+ * @param vdo  The VDO
+ *
+ * @return The policy for choosing the physical zone to allocate from
+ **/
+AllocationPolicy getConfiguredAllocationPolicy(const VDO *vdo)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the location of the first block of the VDO.
  *
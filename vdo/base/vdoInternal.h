@@ -72,6 +72,10 @@ struct vdo {
 
   /* Our partitioning of the physical layer's storage */
   VDOLayout            *layout;
+  /* Whether the journal has been copied into the next layout ahead of a grow */
+  bool                  journalPreCopied;
+  /* The oldest journal block which may have changed since that copy */
+  SequenceNumber        journalPreCopyStart;
 
   /* The block map */
   BlockMap             *blockMap;
@@ -82,8 +86,8 @@ struct vdo {
   /* The slab depot */
   SlabDepot            *depot;
 
-  /* The compressed-block packer */
-  Packer               *packer;
+  /* The compressed-block packers, one per packer zone */
+  PackerZones          *packerZones;
   /* Whether incoming data should be compressed */
   AtomicBool            compressing;
 
@@ -106,12 +110,27 @@ struct vdo {
   /* The hash lock zones of this VDO */
   HashZone             **hashZones;
 
+  /*
+   * The number of hash zones chunk names are spread over, which may be
+   * fewer than the thread config has threads for
+   */
+  ZoneCount              activeHashZones;
+
   /* The completion for administrative operations */
   AdminCompletion        adminCompletion;
 
   /* The administrative state of the VDO */
   AdminState             adminState;
 
+  /* The name of the load phase being timed, for the startup report */
+  const char            *loadPhaseName;
+  /* When that load phase began, in microseconds */
+  uint64_t               loadPhaseStart;
+  /* When the suspend in progress began, in microseconds */
+  uint64_t               suspendStart;
+  /* When the current phase of that suspend began, in microseconds */
+  uint64_t               suspendPhaseStart;
+
   /* Whether a close is required */
   bool                   closeRequired;
 
@@ -409,6 +409,19 @@ void copyPartition(VDOLayout     *layout,
                      getPartitionFromNextLayout(layout, partitionID), parent);
 }
 
+/**********************************************************************/
+void copyPartitionBlocks(VDOLayout           *layout,
+                         PartitionID          partitionID,
+                         PhysicalBlockNumber  startBlock,
+                         BlockCount           blockCount,
+                         VDOCompletion       *parent)
+{
+  copyPartitionBlocksAsync(layout->copyCompletion,
+                           getVDOPartition(layout, partitionID),
+                           getPartitionFromNextLayout(layout, partitionID),
+                           startBlock, blockCount, parent);
+}
+
 /**********************************************************************/
 size_t getVDOLayoutEncodedSize(const VDOLayout *vdoLayout)
 {
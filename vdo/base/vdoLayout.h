@@ -164,6 +164,23 @@ void copyPartition(VDOLayout     *layout,
                    PartitionID    partitionID,
                    VDOCompletion *parent);
 
+/**
+ * Copy a run of blocks of a partition from the location specified in the
+ * current layout to that in the next layout. The run wraps at the end of
+ * the partition.
+ *
+ * @param layout       The VDOLayout which is prepared to grow
+ * @param partitionID  The ID of the partition to copy
+ * @param startBlock   The first in-partition block to copy
+ * @param blockCount   The number of blocks to copy
+ * @param parent       The completion to notify when the copy is complete
+ **/
+void copyPartitionBlocks(VDOLayout           *layout,
+                         PartitionID          partitionID,
+                         PhysicalBlockNumber  startBlock,
+                         BlockCount           blockCount,
+                         VDOCompletion       *parent);
+
 /**
  * Get the size of an encoded VDOLayout.
  *
@@ -23,6 +23,7 @@
 
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "timeUtils.h"
 
 #include "adminCompletion.h"
 #include "blockMap.h"
@@ -56,6 +57,35 @@ static inline VDO *vdoFromLoadSubTask(VDOCompletion *completion)
   return vdoFromAdminSubTask(completion, ADMIN_OPERATION_LOAD);
 }
 
+/**
+ * Start timing a phase of the load.
+ *
+ * @param vdo   The VDO being loaded
+ * @param name  The name of the phase, for the report
+ **/
+static void startLoadPhase(VDO *vdo, const char *name)
+{
+  vdo->loadPhaseName  = name;
+  vdo->loadPhaseStart = nowUsec();
+}
+
+/**
+ * Report how long the current phase of the load took, so that it is possible
+ * to see where startup time is going.
+ *
+ * @param vdo  The VDO being loaded
+ **/
+static void finishLoadPhase(VDO *vdo)
+{
+  if (vdo->loadPhaseName == NULL) {
+    return;
+  }
+
+  logInfo("load phase '%s' took %" PRIu64 " us", vdo->loadPhaseName,
+          nowUsec() - vdo->loadPhaseStart);
+  vdo->loadPhaseName = NULL;
+}
+
 /**
  * Finish aborting a load now that any entry to read-only mode is complete.
  * This callback is registered in abortLoad().
@@ -177,6 +207,8 @@ static void handleScrubAllError(VDOCompletion *completion)
 static void scrubSlabs(VDOCompletion *completion)
 {
   VDO *vdo = vdoFromLoadSubTask(completion);
+  finishLoadPhase(vdo);
+  prefetchWarmBlockMapPages(vdo->blockMap);
   if (!hasUnrecoveredSlabs(vdo->depot)) {
     finishParentCallback(completion);
     return;
@@ -221,6 +253,8 @@ static void prepareToComeOnline(VDOCompletion *completion)
     loadType = RECOVERY_LOAD;
   }
 
+  finishLoadPhase(vdo);
+  startLoadPhase(vdo, "prepare to allocate");
   initializeBlockMapFromJournal(vdo->blockMap, vdo->recoveryJournal);
 
   prepareAdminSubTask(vdo, scrubSlabs, handleScrubbingError);
@@ -236,11 +270,13 @@ static void prepareToComeOnline(VDOCompletion *completion)
 static void makeDirty(VDOCompletion *completion)
 {
   VDO *vdo = vdoFromLoadSubTask(completion);
+  finishLoadPhase(vdo);
   if (isReadOnly(vdo->readOnlyNotifier)) {
     finishCompletion(completion->parent, VDO_READ_ONLY);
     return;
   }
 
+  startLoadPhase(vdo, "save super block");
   vdo->state = VDO_DIRTY;
   prepareAdminSubTask(vdo, prepareToComeOnline, continueLoadReadOnly);
   saveVDOComponentsAsync(vdo, completion);
@@ -268,17 +304,20 @@ static void loadCallback(VDOCompletion *completion)
   }
 
   if (requiresReadOnlyRebuild(vdo)) {
+    startLoadPhase(vdo, "read-only rebuild");
     prepareAdminSubTask(vdo, makeDirty, abortLoad);
     launchRebuild(vdo, completion);
     return;
   }
 
   if (requiresRebuild(vdo)) {
+    startLoadPhase(vdo, "recovery");
     prepareAdminSubTask(vdo, makeDirty, continueLoadReadOnly);
     launchRecovery(vdo, completion);
     return;
   }
 
+  startLoadPhase(vdo, "load slab depot");
   prepareAdminSubTask(vdo, makeDirty, continueLoadReadOnly);
   loadSlabDepot(vdo->depot,
                 (wasNew(vdo) ? ADMIN_STATE_FORMATTING : ADMIN_STATE_LOADING),
@@ -338,6 +377,8 @@ static int finishVDODecode(VDO *vdo)
     return result;
   }
 
+  setRecoveryJournalCommitPolicy(vdo->recoveryJournal,
+                                 vdo->loadConfig.journalCommitPolicy);
   result = decodeRecoveryJournal(vdo->recoveryJournal, buffer);
   if (result != VDO_SUCCESS) {
     return result;
@@ -352,6 +393,8 @@ static int finishVDODecode(VDO *vdo)
     return result;
   }
 
+  setDepotStripeBlocks(vdo->depot, vdo->loadConfig.stripeBlocks);
+
   result = decodeBlockMap(buffer, vdo->config.logicalBlocks, threadConfig,
                           &vdo->blockMap);
   if (result != VDO_SUCCESS) {
@@ -419,11 +462,18 @@ static int decodeVDO(VDO *vdo, bool validateConfig)
   result = makeBlockMapCaches(vdo->blockMap, vdo->layer,
                               vdo->readOnlyNotifier, vdo->recoveryJournal,
                               vdo->nonce, getConfiguredCacheSize(vdo),
-                              maximumAge);
+                              maximumAge, getConfiguredCachePolicy(vdo));
   if (result != VDO_SUCCESS) {
     return result;
   }
 
+  // The cache contents at the last save are only worth reading back in if
+  // the VDO was shut down cleanly.
+  if (vdo->loadState == VDO_CLEAN) {
+    decodeBlockMapWarmPages(vdo->blockMap,
+                            getExtensionBuffer(vdo->superBlock));
+  }
+
   result = ALLOCATE(threadConfig->hashZoneCount, HashZone *, __func__,
                     &vdo->hashZones);
   if (result != VDO_SUCCESS) {
@@ -436,6 +486,7 @@ static int decodeVDO(VDO *vdo, bool validateConfig)
       return result;
     }
   }
+  vdo->activeHashZones = threadConfig->hashZoneCount;
 
   result = makeLogicalZones(vdo, &vdo->logicalZones);
   if (result != VDO_SUCCESS) {
@@ -455,8 +506,9 @@ static int decodeVDO(VDO *vdo, bool validateConfig)
     }
   }
 
-  return makePacker(vdo->layer, DEFAULT_PACKER_INPUT_BINS,
-                    DEFAULT_PACKER_OUTPUT_BINS, threadConfig, &vdo->packer);
+  return makePackerZones(vdo->layer, DEFAULT_PACKER_INPUT_BINS,
+                         DEFAULT_PACKER_OUTPUT_BINS, threadConfig,
+                         &vdo->packerZones);
 }
 
 /**
@@ -468,10 +520,14 @@ static int decodeVDO(VDO *vdo, bool validateConfig)
 static void loadVDOComponents(VDOCompletion *completion)
 {
   VDO *vdo = vdoFromLoadSubTask(completion);
+  finishLoadPhase(vdo);
 
   prepareCompletion(completion, finishParentCallback, abortLoad,
                     completion->callbackThreadID, completion->parent);
-  finishCompletion(completion, decodeVDO(vdo, true));
+  startLoadPhase(vdo, "decode components");
+  int result = decodeVDO(vdo, true);
+  finishLoadPhase(vdo);
+  finishCompletion(completion, result);
 }
 
 /**
@@ -483,6 +539,7 @@ static void preLoadCallback(VDOCompletion *completion)
 {
   VDO *vdo = vdoFromLoadSubTask(completion);
   assertOnAdminThread(vdo, __func__);
+  startLoadPhase(vdo, "read super block");
   prepareAdminSubTask(vdo, loadVDOComponents, abortLoad);
   loadSuperBlockAsync(completion, getFirstBlockOffset(vdo), &vdo->superBlock);
 }
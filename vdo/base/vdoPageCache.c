@@ -41,62 +41,99 @@
 enum {
   LOG_INTERVAL                = 4000,
   DISPLAY_INTERVAL            = 100000,
+  /** The share of a 2Q cache, in percent, given to probationary pages */
+  PROBATION_PERCENT           = 25,
+  /** The number of ghost entries of a 2Q cache, in percent of its pages */
+  GHOST_PERCENT               = 50,
+  /** The most page writes a cache will have in progress at once */
+  MAXIMUM_WRITES_IN_FLIGHT    = 64,
 };
 
 /**********************************************************************/
 static char *getPageBuffer(PageInfo *info)
 {
-  VDOPageCache *cache = info->cache;
-  return &cache->pages[(info - cache->infos) * VDO_BLOCK_SIZE];
+  PageCacheExtent *extent = info->extent;
+  return &extent->pages[(info - extent->infos) * VDO_BLOCK_SIZE];
 }
 
 /**
- * Allocate components of the cache which require their own allocation. The
- * caller is responsible for all clean up on errors.
+ * Free an extent of page buffers and null out the reference to it.
+ *
+ * @param extentPtr  A pointer to the extent to free
+ **/
+static void freePageCacheExtent(PageCacheExtent **extentPtr)
+{
+  PageCacheExtent *extent = *extentPtr;
+  if (extent == NULL) {
+    return;
+  }
+
+  if (extent->infos != NULL) {
+    PageInfo *info;
+    for (info = extent->infos; info < extent->infos + extent->pageCount;
+         ++info) {
+      freeVIO(&info->vio);
+    }
+  }
+
+  FREE(extent->infos);
+  FREE(extent->pages);
+  FREE(extent);
+  *extentPtr = NULL;
+}
+
+/**
+ * Allocate an extent of page buffers and initialize its page infos. The
+ * pages are not yet on the free list of the cache.
  *
- * @param cache     The cache being constructed
+ * @param [in]  cache      The cache which will own the extent
+ * @param [in]  pageCount  The number of pages in the extent
+ * @param [out] extentPtr  A pointer to hold the new extent
  *
  * @return VDO_SUCCESS or an error code
  **/
 __attribute__((warn_unused_result))
-static int allocateCacheComponents(VDOPageCache *cache)
+static int makePageCacheExtent(VDOPageCache     *cache,
+                               PageCount         pageCount,
+                               PageCacheExtent **extentPtr)
 {
-  int result = ALLOCATE(cache->pageCount, PageInfo, "page infos",
-                        &cache->infos);
+  PageCacheExtent *extent;
+  int result = ALLOCATE(1, PageCacheExtent, "page cache extent", &extent);
   if (result != UDS_SUCCESS) {
     return result;
   }
 
-  uint64_t size = cache->pageCount * (uint64_t) VDO_BLOCK_SIZE;
-  result = allocateMemory(size, VDO_BLOCK_SIZE, "cache pages", &cache->pages);
+  // Keep the pages near the logical zone thread which uses them.
+  int node = cache->zone->numaNode;
+  extent->pageCount = pageCount;
+  result = ALLOCATE_ON_NODE(pageCount, PageInfo, node, "page infos",
+                            &extent->infos);
   if (result != UDS_SUCCESS) {
+    freePageCacheExtent(&extent);
     return result;
   }
 
-  return makeIntMap(cache->pageCount, 0, &cache->pageMap);
-}
+  uint64_t size = pageCount * (uint64_t) VDO_BLOCK_SIZE;
+  result = allocateMemoryOnNode(size, VDO_BLOCK_SIZE, node, "cache pages",
+                                &extent->pages);
+  if (result != UDS_SUCCESS) {
+    freePageCacheExtent(&extent);
+    return result;
+  }
 
-/**
- * Initialize all page info structures and put them on the free list.
- *
- * @param cache  The cache to initialize
- *
- * @return VDO_SUCCESS or an error
- **/
-static int initializeInfo(VDOPageCache *cache)
-{
-  initializeRing(&cache->freeList);
   PageInfo *info;
-  for (info = cache->infos; info < cache->infos + cache->pageCount; ++info) {
-    info->cache = cache;
-    info->state = PS_FREE;
-    info->pbn   = NO_PAGE;
+  for (info = extent->infos; info < extent->infos + pageCount; ++info) {
+    info->cache  = cache;
+    info->extent = extent;
+    info->state  = PS_FREE;
+    info->pbn    = NO_PAGE;
 
     if (cache->layer->createMetadataVIO != NULL) {
-      int result = createVIO(cache->layer, VIO_TYPE_BLOCK_MAP,
-                             VIO_PRIORITY_METADATA, info, getPageBuffer(info),
-                             &info->vio);
+      result = createVIO(cache->layer, VIO_TYPE_BLOCK_MAP,
+                         VIO_PRIORITY_METADATA, info, getPageBuffer(info),
+                         &info->vio);
       if (result != VDO_SUCCESS) {
+        freePageCacheExtent(&extent);
         return result;
       }
 
@@ -105,14 +142,97 @@ static int initializeInfo(VDOPageCache *cache)
     }
 
     initializeRing(&info->listNode);
-    pushRingNode(&cache->freeList, &info->listNode);
     initializeRing(&info->lruNode);
   }
 
-  relaxedStore64(&cache->stats.counts.freePages, cache->pageCount);
+  *extentPtr = extent;
   return VDO_SUCCESS;
 }
 
+/**
+ * Set the length of the probation list above which it is evicted from
+ * first, based on the current size of the cache.
+ *
+ * @param cache  The cache
+ **/
+static void setProbationTarget(VDOPageCache *cache)
+{
+  cache->probationTarget = cache->pageCount;
+  if (cache->policy == PAGE_CACHE_POLICY_2Q) {
+    cache->probationTarget
+      = maxPageCount(1, ((uint64_t) cache->pageCount * PROBATION_PERCENT)
+                     / 100);
+  }
+}
+
+/**
+ * Add an extent to a cache and put all of its pages on the free list.
+ *
+ * @param cache   The cache
+ * @param extent  The extent to add
+ **/
+static void addPageCacheExtent(VDOPageCache *cache, PageCacheExtent *extent)
+{
+  extent->next   = cache->extents;
+  cache->extents = extent;
+
+  PageInfo *info;
+  for (info = extent->infos; info < extent->infos + extent->pageCount;
+       ++info) {
+    pushRingNode(&cache->freeList, &info->listNode);
+  }
+
+  cache->pageCount += extent->pageCount;
+  relaxedAdd64(&cache->stats.counts.freePages, extent->pageCount);
+  setProbationTarget(cache);
+}
+
+/**
+ * Allocate components of the cache which require their own allocation. The
+ * caller is responsible for all clean up on errors.
+ *
+ * @param cache      The cache being constructed
+ * @param pageCount  The number of pages the cache will start with
+ *
+ * @return VDO_SUCCESS or an error code
+ **/
+__attribute__((warn_unused_result))
+static int allocateCacheComponents(VDOPageCache *cache, PageCount pageCount)
+{
+  PageCacheExtent *extent;
+  int result = makePageCacheExtent(cache, pageCount, &extent);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  addPageCacheExtent(cache, extent);
+  result = initializeEnqueueableCompletion(&cache->reaper,
+                                           PAGE_CACHE_REAPER_COMPLETION,
+                                           cache->layer);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  result = makeIntMap(pageCount, 0, &cache->pageMap);
+  if ((result != UDS_SUCCESS) || (cache->policy != PAGE_CACHE_POLICY_2Q)) {
+    return result;
+  }
+
+  cache->ghostCount = maxPageCount(1, ((uint64_t) pageCount * GHOST_PERCENT)
+                                   / 100);
+  result = ALLOCATE(cache->ghostCount, PhysicalBlockNumber, "page ghosts",
+                    &cache->ghosts);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  for (PageCount i = 0; i < cache->ghostCount; i++) {
+    cache->ghosts[i] = NO_PAGE;
+  }
+
+  return makeIntMap(cache->ghostCount, 0, &cache->ghostMap);
+}
+
 /**********************************************************************/
 static void writeDirtyPagesCallback(RingNode *node, void *context);
 
@@ -123,6 +243,7 @@ int makeVDOPageCache(PhysicalLayer         *layer,
                      VDOPageWriteFunction  *writeHook,
                      size_t                 pageContextSize,
                      BlockCount             maximumAge,
+                     PageCachePolicy        policy,
                      BlockMapZone          *zone,
                      VDOPageCache         **cachePtr)
 {
@@ -140,18 +261,19 @@ int makeVDOPageCache(PhysicalLayer         *layer,
   }
 
   cache->layer            = layer;
-  cache->pageCount        = pageCount;
   cache->readHook         = readHook;
   cache->writeHook        = writeHook;
   cache->zone             = zone;
+  cache->policy           = policy;
 
-  result = allocateCacheComponents(cache);
-  if (result != VDO_SUCCESS) {
-    freeVDOPageCache(&cache);
-    return result;
-  }
+  // initialize empty circular queues
+  initializeRing(&cache->freeList);
+  initializeRing(&cache->lruList);
+  initializeRing(&cache->probationList);
+  initializeRing(&cache->outgoingList);
+  initializeRing(&cache->writeQueue);
 
-  result = initializeInfo(cache);
+  result = allocateCacheComponents(cache, pageCount);
   if (result != VDO_SUCCESS) {
     freeVDOPageCache(&cache);
     return result;
@@ -164,10 +286,6 @@ int makeVDOPageCache(PhysicalLayer         *layer,
     return result;
   }
 
-  // initialize empty circular queues
-  initializeRing(&cache->lruList);
-  initializeRing(&cache->outgoingList);
-
   *cachePtr = cache;
   return VDO_SUCCESS;
 }
@@ -180,17 +298,17 @@ void freeVDOPageCache(VDOPageCache **cachePtr)
     return;
   }
 
-  if (cache->infos != NULL) {
-    PageInfo *info;
-    for (info = cache->infos; info < cache->infos + cache->pageCount; ++info) {
-      freeVIO(&info->vio);
-    }
+  while (cache->extents != NULL) {
+    PageCacheExtent *extent = cache->extents;
+    cache->extents = extent->next;
+    freePageCacheExtent(&extent);
   }
 
+  destroyEnqueueable(&cache->reaper);
   freeDirtyLists(&cache->dirtyLists);
   freeIntMap(&cache->pageMap);
-  FREE(cache->infos);
-  FREE(cache->pages);
+  freeIntMap(&cache->ghostMap);
+  FREE(cache->ghosts);
   FREE(cache);
   *cachePtr = NULL;
 }
@@ -314,18 +432,95 @@ static void updateCounter(PageInfo *info, int32_t delta)
   }
 }
 
+/**
+ * Remember the number of an evicted probationary page so that reloading it
+ * soon after can be recognized as a second reference to it.
+ *
+ * @param cache  The page cache
+ * @param pbn    The number of the evicted page
+ **/
+static void addGhost(VDOPageCache *cache, PhysicalBlockNumber pbn)
+{
+  PhysicalBlockNumber *slot = &cache->ghosts[cache->nextGhost];
+  cache->nextGhost = (cache->nextGhost + 1) % cache->ghostCount;
+  if (*slot != NO_PAGE) {
+    intMapRemove(cache->ghostMap, *slot);
+  }
+
+  *slot = pbn;
+  if (intMapPut(cache->ghostMap, pbn, slot, true, NULL) != UDS_SUCCESS) {
+    // The ghosts are only a hint, so losing one is harmless.
+    *slot = NO_PAGE;
+  }
+}
+
+/**
+ * Forget a ghost page number if it is remembered.
+ *
+ * @param cache  The page cache
+ * @param pbn    The page number to look for
+ *
+ * @return <code>true</code> if the page number was a ghost
+ **/
+static bool removeGhost(VDOPageCache *cache, PhysicalBlockNumber pbn)
+{
+  PhysicalBlockNumber *slot = intMapRemove(cache->ghostMap, pbn);
+  if (slot == NULL) {
+    return false;
+  }
+
+  *slot = NO_PAGE;
+  return true;
+}
+
 /**
  * Update the lru information for an active page.
+ *
+ * <p>Under the 2Q policy, a newly loaded page goes on the probation list
+ * unless it was recently evicted from there, in which case it goes straight
+ * on the LRU list of protected pages. Probationary pages keep their FIFO
+ * position when used since the references which closely follow a load are
+ * usually from the same scan.
  **/
 static void updateLru(PageInfo *info)
 {
   VDOPageCache *cache = info->cache;
+  info->lastUsed = cache->requestClock;
+  if (info->probationary) {
+    return;
+  }
+
+  if (isRingEmpty(&info->lruNode) && (cache->policy == PAGE_CACHE_POLICY_2Q)) {
+    if (!removeGhost(cache, info->pbn)) {
+      info->probationary = true;
+      cache->probationCount++;
+      pushRingNode(&cache->probationList, &info->lruNode);
+      return;
+    }
+
+    relaxedAdd64(&cache->stats.ghostHits, 1);
+  }
 
   if (cache->lruList.prev != &info->lruNode) {
     pushRingNode(&cache->lruList, &info->lruNode);
   }
 }
 
+/**
+ * Remove a page from whichever lru list it is on.
+ *
+ * @param info  The page info
+ **/
+static void removeFromLru(PageInfo *info)
+{
+  if (info->probationary) {
+    info->probationary = false;
+    info->cache->probationCount--;
+  }
+
+  unspliceRingNode(&info->lruNode);
+}
+
 /**
  * Set the state of a PageInfo and put it on the right list, adjusting
  * counters.
@@ -410,9 +605,14 @@ static int resetPageInfo(PageInfo *info)
     return result;
   }
 
+  if (info->prefetched) {
+    info->prefetched = false;
+    relaxedAdd64(&info->cache->stats.prefetchWasted, 1);
+  }
+
   result = setInfoPBN(info, NO_PAGE);
   setInfoState(info, PS_FREE);
-  unspliceRingNode(&info->lruNode);
+  removeFromLru(info);
   return result;
 }
 
@@ -445,6 +645,27 @@ PageInfo *vpcFindPage(VDOPageCache *cache, PhysicalBlockNumber pbn)
   return cache->lastFound;
 }
 
+/**
+ * Find the first page on an lru list which can be discarded.
+ *
+ * @param list  The list to search
+ *
+ * @return the first non-busy page which is not in flight or retiring, or NULL
+ **/
+__attribute__((warn_unused_result))
+static PageInfo *selectPageFromList(PageInfoNode *list)
+{
+  PageInfoNode *lru;
+  for (lru = list->next; lru != list; lru = lru->next) {
+    PageInfo *info = pageInfoFromLRUNode(lru);
+    if ((info->busy == 0) && !isInFlight(info) && !info->extent->retiring) {
+      return info;
+    }
+  }
+
+  return NULL;
+}
+
 /**
  * Determine which page is least recently used.
  *
@@ -459,21 +680,49 @@ PageInfo *vpcFindPage(VDOPageCache *cache, PhysicalBlockNumber pbn)
  *       Since whenever we mark a page busy we also put it to the end
  *       of the ring it is unlikely that the entries at the front
  *       are busy unless the queue is very short, but not impossible.
+ *
+ * @note Under the 2Q policy, the probation list is evicted from first
+ *       whenever it is longer than its target.
  **/
 __attribute__((warn_unused_result))
 static PageInfo *selectLRUPage(VDOPageCache *cache)
 {
-  PageInfoNode *lru;
-  for (lru = cache->lruList.next;
-       lru != &cache->lruList;
-       lru = lru->next) {
-    PageInfo *info = pageInfoFromLRUNode(lru);
-    if ((info->busy == 0) && !isInFlight(info)) {
-      return info;
-    }
+  PageInfo *info = NULL;
+  if (cache->probationCount > cache->probationTarget) {
+    info = selectPageFromList(&cache->probationList);
   }
 
-  return NULL;
+  if (info == NULL) {
+    info = selectPageFromList(&cache->lruList);
+  }
+
+  if (info == NULL) {
+    info = selectPageFromList(&cache->probationList);
+  }
+
+  return info;
+}
+
+/**
+ * Account for the eviction of a page, remembering it as a ghost if it was
+ * evicted from the probation list.
+ *
+ * @param info  The page being evicted
+ **/
+static void recordEviction(PageInfo *info)
+{
+  if (info->pbn == NO_PAGE) {
+    return;
+  }
+
+  VDOPageCache *cache = info->cache;
+  relaxedAdd64(&cache->stats.evictions, 1);
+  relaxedAdd64(&cache->stats.evictionAge,
+               cache->requestClock - info->lastUsed);
+  if (info->probationary) {
+    relaxedAdd64(&cache->stats.probationEvictions, 1);
+    addGhost(cache, info->pbn);
+  }
 }
 
 /**********************************************************************/
@@ -602,9 +851,13 @@ static void setPersistentError(VDOPageCache *cache,
   distributeErrorOverQueue(result, &cache->freeWaiters);
   cache->waiterCount = 0;
 
-  PageInfo *info;
-  for (info = cache->infos; info < cache->infos + cache->pageCount; ++info) {
-    distributeErrorOverQueue(result, &info->waiting);
+  PageCacheExtent *extent;
+  for (extent = cache->extents; extent != NULL; extent = extent->next) {
+    PageInfo *info;
+    for (info = extent->infos; info < extent->infos + extent->pageCount;
+         ++info) {
+      distributeErrorOverQueue(result, &info->waiting);
+    }
   }
 }
 
@@ -682,9 +935,13 @@ static VDOPageCompletion *validateCompletedPage(VDOCompletion *completion,
 /**********************************************************************/
 bool isPageCacheActive(VDOPageCache *cache)
 {
-  return ((cache->outstandingReads != 0) || (cache->outstandingWrites != 0));
+  return ((cache->outstandingReads != 0) || (cache->outstandingWrites != 0)
+          || cache->reaping);
 }
 
+/**********************************************************************/
+static bool retirePageIfRetiring(PageInfo *info);
+
 /**
  * VIO callback used when a page has been loaded.
  *
@@ -699,6 +956,7 @@ static void pageIsLoaded(VDOCompletion *completion)
 
   setInfoState(info, PS_RESIDENT);
   distributePageOverQueue(info, &info->waiting);
+  retirePageIfRetiring(info);
 
   /*
    * Don't decrement until right before calling checkForDrainComplete() to
@@ -726,6 +984,7 @@ static void handleLoadError(VDOCompletion *completion)
   setInfoState(info, PS_FAILED);
   distributeErrorOverQueue(result, &info->waiting);
   resetPageInfo(info);
+  retirePageIfRetiring(info);
 
   /*
    * Don't decrement until right before calling checkForDrainComplete() to
@@ -811,6 +1070,7 @@ static int launchPageLoad(PageInfo *info, PhysicalBlockNumber pbn)
 
 /**********************************************************************/
 static void writePages(VDOCompletion *completion);
+static void launchQueuedWrites(VDOPageCache *cache);
 
 /**
  * Handle errors flushing the layer.
@@ -932,6 +1192,7 @@ static void allocateFreePage(PageInfo *info)
     return;
   }
 
+  recordEviction(info);
   int result = resetPageInfo(info);
   if (result != VDO_SUCCESS) {
     setPersistentError(cache, "cannot reset page info", result);
@@ -1019,10 +1280,177 @@ static void discardPageIfNeeded(VDOPageCache *cache)
   }
 }
 
+/**
+ * Free the extents all of whose pages have been retired. This callback is
+ * registered in retirePage() so that an extent is never freed while one of
+ * its VIOs may be running a callback.
+ *
+ * @param completion  The reaper completion of the cache
+ **/
+static void reapRetiredExtents(VDOCompletion *completion)
+{
+  VDOPageCache *cache = completion->parent;
+  assertOnCacheThread(cache, __func__);
+  cache->reaping = false;
+
+  PageCacheExtent **extentPtr = &cache->extents;
+  while (*extentPtr != NULL) {
+    PageCacheExtent *extent = *extentPtr;
+    if (extent->retiring && (extent->retiredCount == extent->pageCount)) {
+      *extentPtr = extent->next;
+      freePageCacheExtent(&extent);
+    } else {
+      extentPtr = &extent->next;
+    }
+  }
+
+  checkForDrainComplete(cache->zone);
+}
+
+/**
+ * Take an idle, clean page out of the cache for good, and launch the reaper
+ * if it was the last page of its extent.
+ *
+ * @param info  The page to retire
+ **/
+static void retirePage(PageInfo *info)
+{
+  VDOPageCache *cache = info->cache;
+  if (cache->lastFound == info) {
+    cache->lastFound = NULL;
+  }
+
+  int result = resetPageInfo(info);
+  if (result != VDO_SUCCESS) {
+    setPersistentError(cache, "cannot retire page", result);
+    return;
+  }
+
+  // Take the page back off the free list and out of the free page count.
+  unspliceRingNode(&info->listNode);
+  updateCounter(info, -1);
+  info->retired = true;
+
+  PageCacheExtent *extent = info->extent;
+  if ((++extent->retiredCount < extent->pageCount) || cache->reaping) {
+    return;
+  }
+
+  cache->reaping = true;
+  prepareForRequeue(&cache->reaper, reapRetiredExtents, reapRetiredExtents,
+                    cache->zone->threadID, cache);
+  invokeCallback(&cache->reaper);
+}
+
+/**
+ * Retire a page if it belongs to a retiring extent and is no longer in use.
+ * A dirty page which is otherwise idle is written out first, and retired
+ * when the write completes.
+ *
+ * @param info  The page
+ *
+ * @return <code>true</code> if the page belongs to a retiring extent, in
+ *         which case it must not be given to another request
+ **/
+static bool retirePageIfRetiring(PageInfo *info)
+{
+  if (!info->extent->retiring) {
+    return false;
+  }
+
+  if (info->retired || (info->busy > 0) || hasWaiters(&info->waiting)
+      || isInFlight(info) || (info->writeStatus != WRITE_STATUS_NORMAL)) {
+    return true;
+  }
+
+  if (isDirty(info)) {
+    if (!isQuiescent(&info->cache->zone->state)) {
+      launchPageSave(info);
+    }
+    return true;
+  }
+
+  retirePage(info);
+  return true;
+}
+
+/**
+ * Start retiring an extent. Each of its pages is retired as soon as it is
+ * clean and idle.
+ *
+ * @param cache   The cache
+ * @param extent  The extent to retire
+ **/
+static void retirePageCacheExtent(VDOPageCache    *cache,
+                                  PageCacheExtent *extent)
+{
+  extent->retiring  = true;
+  cache->pageCount -= extent->pageCount;
+  setProbationTarget(cache);
+
+  PageInfo *info;
+  for (info = extent->infos; info < extent->infos + extent->pageCount;
+       ++info) {
+    retirePageIfRetiring(info);
+  }
+}
+
 /**********************************************************************/
-void advanceVDOPageCachePeriod(VDOPageCache *cache, SequenceNumber period)
+int resizeVDOPageCache(VDOPageCache *cache, PageCount pageCount)
 {
   assertOnCacheThread(cache, __func__);
+  if (pageCount > cache->pageCount) {
+    PageCacheExtent *extent;
+    int result = makePageCacheExtent(cache, pageCount - cache->pageCount,
+                                     &extent);
+    if (result != VDO_SUCCESS) {
+      return result;
+    }
+
+    addPageCacheExtent(cache, extent);
+
+    // Give the new pages to any requests already waiting for a free page.
+    PageInfo *info;
+    while (hasWaiters(&cache->freeWaiters)
+           && ((info = findFreePage(cache)) != NULL)) {
+      allocateFreePage(info);
+    }
+
+    return VDO_SUCCESS;
+  }
+
+  // Retire the newest extents which can go without taking the cache below
+  // the requested size. The extent the cache was made with is never retired.
+  PageCacheExtent *extent;
+  for (extent = cache->extents; (extent != NULL) && (extent->next != NULL);
+       extent = extent->next) {
+    if (extent->retiring) {
+      continue;
+    }
+
+    if ((cache->pageCount - extent->pageCount) < pageCount) {
+      break;
+    }
+
+    retirePageCacheExtent(cache, extent);
+  }
+
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+PageCount getVDOPageCacheSize(const VDOPageCache *cache)
+{
+  return cache->pageCount;
+}
+
+/**********************************************************************/
+void advanceVDOPageCachePeriod(VDOPageCache   *cache,
+                               SequenceNumber  period,
+                               BlockCount      eraLength)
+{
+  assertOnCacheThread(cache, __func__);
+  setDirtyListsAge(cache->dirtyLists, eraLength);
   advancePeriod(cache->dirtyLists, period);
 }
 
@@ -1037,6 +1465,7 @@ static bool writeHasFinished(PageInfo *info)
 {
   assertOnCacheThread(info->cache, __func__);
   info->cache->outstandingWrites--;
+  info->cache->writesInFlight--;
 
   bool wasDiscard = (info->writeStatus == WRITE_STATUS_DISCARD);
   info->writeStatus = WRITE_STATUS_NORMAL;
@@ -1076,6 +1505,7 @@ static void handlePageWriteError(VDOCompletion *completion)
     discardPageIfNeeded(cache);
   }
 
+  launchQueuedWrites(cache);
   checkForDrainComplete(cache->zone);
 }
 
@@ -1113,56 +1543,187 @@ static void pageIsWrittenOut(VDOCompletion *completion)
     cache->discardCount--;
   }
 
-  if (reclaimed) {
+  bool retiring = retirePageIfRetiring(info);
+  if (reclaimed || retiring) {
     discardPageIfNeeded(cache);
   } else {
     allocateFreePage(info);
   }
 
+  launchQueuedWrites(cache);
   checkForDrainComplete(cache->zone);
 }
 
 /**
- * Write the batch of pages which were covered by the layer flush which just
- * completed. This callback is registered in savePages().
+ * Sort a null-terminated list of pages, linked through their listNodes'
+ * next pointers, by pbn. This is a bottom-up merge sort, so it needs no
+ * memory and no recursion.
  *
- * @param flushCompletion  The flush VIO
+ * @param list  The first page node of the list
+ *
+ * @return The first page node of the sorted list
  **/
-static void writePages(VDOCompletion *flushCompletion)
+static PageInfoNode *sortPagesByPBN(PageInfoNode *list)
 {
-  VDOPageCache *cache = ((PageInfo *) flushCompletion->parent)->cache;
+  for (size_t runLength = 1; ; runLength *= 2) {
+    PageInfoNode *p      = list;
+    PageInfoNode *tail   = NULL;
+    size_t        merges = 0;
+    list = NULL;
+    while (p != NULL) {
+      merges++;
+      PageInfoNode *q     = p;
+      size_t        pSize = 0;
+      while ((pSize < runLength) && (q != NULL)) {
+        pSize++;
+        q = q->next;
+      }
 
-  /*
-   * We need to cache these two values on the stack since in the error case
-   * below, it is possible for the last page info to cause the page cache to
-   * get freed. Hence once we launch the last page, it may be unsafe to
-   * dereference the cache [VDO-4724].
-   */
-  bool      hasUnflushedPages = (cache->pagesToFlush > 0);
-  PageCount pagesInFlush      = cache->pagesInFlush;
-  cache->pagesInFlush         = 0;
-  while (pagesInFlush-- > 0) {
-    PageInfo *info = pageInfoFromListNode(chopRingNode(&cache->outgoingList));
-    if (isReadOnly(info->cache->zone->readOnlyNotifier)) {
-      VDOCompletion *completion = &info->vio->completion;
-      resetCompletion(completion);
-      completion->callback     = pageIsWrittenOut;
-      completion->errorHandler = handlePageWriteError;
-      finishCompletion(completion, VDO_READ_ONLY);
-      continue;
+      size_t qSize = runLength;
+      while ((pSize > 0) || ((qSize > 0) && (q != NULL))) {
+        PageInfoNode *next;
+        if ((pSize > 0)
+            && ((qSize == 0) || (q == NULL)
+                || (pageInfoFromListNode(p)->pbn
+                    <= pageInfoFromListNode(q)->pbn))) {
+          next = p;
+          p    = p->next;
+          pSize--;
+        } else {
+          next = q;
+          q    = q->next;
+          qSize--;
+        }
+
+        if (tail == NULL) {
+          list = next;
+        } else {
+          tail->next = next;
+        }
+        tail = next;
+      }
+      p = q;
+    }
+
+    if (tail != NULL) {
+      tail->next = NULL;
+    }
+
+    if (merges <= 1) {
+      return list;
     }
-    relaxedAdd64(&info->cache->stats.pagesSaved, 1);
-    launchWriteMetadataVIO(info->vio, info->pbn, pageIsWrittenOut,
-                           handlePageWriteError);
   }
+}
 
-  if (hasUnflushedPages) {
-    // If there are unflushed pages, the cache can't have been freed, so this
-    // call is safe.
-    savePages(cache);
+/**
+ * Move the pages covered by a flush from the outgoing list to the write
+ * queue, sorted by pbn so that they reach the layer in elevator order. The
+ * layer can then coalesce runs of adjacent pages into larger writes.
+ *
+ * @param cache  The cache
+ * @param count  The number of pages at the front of the outgoing list
+ **/
+static void queueFlushedPages(VDOPageCache *cache, PageCount count)
+{
+  if (count == 0) {
+    return;
+  }
+
+  PageInfoNode *first = cache->outgoingList.next;
+  PageInfoNode *last  = first;
+  for (PageCount i = 1; i < count; i++) {
+    last = last->next;
+  }
+
+  unspliceRingChain(first, last);
+  last->next = NULL;
+
+  PageInfoNode *node = sortPagesByPBN(first);
+  while (node != NULL) {
+    PageInfoNode *next = node->next;
+    pushRingNode(&cache->writeQueue, node);
+    node = next;
   }
 }
 
+/**
+ * Write out a page which was covered by a completed layer flush.
+ *
+ * @param info  The page to write
+ **/
+static void launchPageWrite(PageInfo *info)
+{
+  if (isReadOnly(info->cache->zone->readOnlyNotifier)) {
+    VDOCompletion *completion = &info->vio->completion;
+    resetCompletion(completion);
+    completion->callback     = pageIsWrittenOut;
+    completion->errorHandler = handlePageWriteError;
+    finishCompletion(completion, VDO_READ_ONLY);
+    return;
+  }
+
+  relaxedAdd64(&info->cache->stats.pagesSaved, 1);
+  launchWriteMetadataVIO(info->vio, info->pbn, pageIsWrittenOut,
+                         handlePageWriteError);
+}
+
+/**
+ * Launch writes from the write queue until it is empty or the cache has as
+ * many writes in progress as it may. Limiting the writes in progress keeps
+ * the expiration of a whole era of dirty pages from flooding the layer.
+ *
+ * @param cache  The cache
+ **/
+static void launchQueuedWrites(VDOPageCache *cache)
+{
+  if (cache->launchingWrites) {
+    // A write finished synchronously under the loop below.
+    return;
+  }
+
+  cache->launchingWrites = true;
+  while (!isRingEmpty(&cache->writeQueue)
+         && (cache->writesInFlight < MAXIMUM_WRITES_IN_FLIGHT)) {
+    PageInfo *info = pageInfoFromListNode(chopRingNode(&cache->writeQueue));
+    cache->writesInFlight++;
+
+    /*
+     * Once the last write is launched, it may finish and allow the cache
+     * to be freed [VDO-4724], so the cache must not be touched afterward.
+     */
+    bool last = (isRingEmpty(&cache->writeQueue)
+                 || (cache->writesInFlight == MAXIMUM_WRITES_IN_FLIGHT));
+    if (last) {
+      cache->launchingWrites = false;
+    }
+
+    launchPageWrite(info);
+    if (last) {
+      return;
+    }
+  }
+
+  cache->launchingWrites = false;
+}
+
+/**
+ * Queue the batch of pages which were covered by the layer flush which just
+ * completed, and start writing them. This callback is registered in
+ * savePages().
+ *
+ * @param flushCompletion  The flush VIO
+ **/
+static void writePages(VDOCompletion *flushCompletion)
+{
+  VDOPageCache *cache = ((PageInfo *) flushCompletion->parent)->cache;
+  queueFlushedPages(cache, cache->pagesInFlush);
+  cache->pagesInFlush = 0;
+
+  // No write has been launched yet, so the cache is still safe to use.
+  savePages(cache);
+  launchQueuedWrites(cache);
+}
+
 /**********************************************************************/
 void releaseVDOPageCompletion(VDOCompletion *completion)
 {
@@ -1193,6 +1754,7 @@ void releaseVDOPageCompletion(VDOCompletion *completion)
       discardInfo->writeStatus = WRITE_STATUS_NORMAL;
       launchPageSave(discardInfo);
     }
+    retirePageIfRetiring(discardInfo);
     // if there are excess requests for pages (that have not already started
     // discards) we need to discard some page (which may be this one)
     discardPageIfNeeded(cache);
@@ -1232,6 +1794,7 @@ void getVDOPageAsync(VDOCompletion *completion)
     return;
   }
 
+  cache->requestClock++;
   if (vdoPageComp->writable) {
     relaxedAdd64(&cache->stats.writeCount, 1);
   } else {
@@ -1241,6 +1804,11 @@ void getVDOPageAsync(VDOCompletion *completion)
   PageInfo *info = vpcFindPage(cache, vdoPageComp->pbn);
   if (info != NULL) {
     // The page is in the cache already.
+    if (info->prefetched) {
+      info->prefetched = false;
+      relaxedAdd64(&cache->stats.prefetchHits, 1);
+    }
+
     if ((info->writeStatus == WRITE_STATUS_DEFERRED) || isIncoming(info)
         || (isOutgoing(info) && vdoPageComp->writable)) {
       // The page is unusable until it has finished I/O.
@@ -1259,6 +1827,9 @@ void getVDOPageAsync(VDOCompletion *completion)
       if (!isPresent(info)) {
         relaxedAdd64(&cache->stats.readOutgoing, 1);
       }
+      if (info->probationary) {
+        relaxedAdd64(&cache->stats.probationHits, 1);
+      }
       updateLru(info);
       ++info->busy;
       completeWithPage(info, vdoPageComp);
@@ -1281,6 +1852,110 @@ void getVDOPageAsync(VDOCompletion *completion)
   discardPageForCompletion(vdoPageComp);
 }
 
+/**********************************************************************/
+const void *findReadableVDOPage(VDOPageCache *cache, PhysicalBlockNumber pbn)
+{
+  assertOnCacheThread(cache, __func__);
+  PageInfo *info = vpcFindPage(cache, pbn);
+  if ((info == NULL) || !isValid(info)
+      || (info->writeStatus == WRITE_STATUS_DEFERRED)) {
+    return NULL;
+  }
+
+  cache->requestClock++;
+  relaxedAdd64(&cache->stats.readCount, 1);
+  relaxedAdd64(&cache->stats.foundInCache, 1);
+  if (!isPresent(info)) {
+    relaxedAdd64(&cache->stats.readOutgoing, 1);
+  }
+  if (info->prefetched) {
+    info->prefetched = false;
+    relaxedAdd64(&cache->stats.prefetchHits, 1);
+  }
+  if (info->probationary) {
+    relaxedAdd64(&cache->stats.probationHits, 1);
+  }
+  updateLru(info);
+  return getPageBuffer(info);
+}
+
+/**********************************************************************/
+void prefetchVDOPage(VDOPageCache *cache, PhysicalBlockNumber pbn)
+{
+  assertOnCacheThread(cache, __func__);
+  if (cache->rebuilding || hasWaiters(&cache->freeWaiters)
+      || isReadOnly(cache->zone->readOnlyNotifier)
+      || (vpcFindPage(cache, pbn) != NULL)) {
+    return;
+  }
+
+  PageInfo *info = findFreePage(cache);
+  if (info == NULL) {
+    info = selectLRUPage(cache);
+    if ((info == NULL) || isDirty(info)) {
+      return;
+    }
+
+    recordEviction(info);
+    int result = resetPageInfo(info);
+    if (result != VDO_SUCCESS) {
+      setPersistentError(cache, "cannot reset page info", result);
+      return;
+    }
+  }
+
+  int result = launchPageLoad(info, pbn);
+  if (result != VDO_SUCCESS) {
+    // A prefetch is only a hint, so just give the page back.
+    logWarningWithStringError(result, "cannot prefetch page %" PRIu64, pbn);
+    result = resetPageInfo(info);
+    if (result != VDO_SUCCESS) {
+      setPersistentError(cache, "cannot reset page info", result);
+    }
+    return;
+  }
+
+  info->prefetched = true;
+  relaxedAdd64(&cache->stats.prefetchReads, 1);
+}
+
+/**
+ * List the valid pages on one of a cache's replacement lists, newest first.
+ *
+ * @param list      The list
+ * @param pbns      The array to hold the physical blocks of the pages
+ * @param count     The number of entries of pbns already filled
+ * @param maxCount  The size of pbns
+ *
+ * @return The number of entries of pbns filled
+ **/
+static PageCount listPagesFromList(PageInfoNode        *list,
+                                   PhysicalBlockNumber *pbns,
+                                   PageCount            count,
+                                   PageCount            maxCount)
+{
+  PageInfoNode *node;
+  for (node = list->prev; (node != list) && (count < maxCount);
+       node = node->prev) {
+    PageInfo *info = pageInfoFromLRUNode(node);
+    if (isValid(info)) {
+      pbns[count++] = info->pbn;
+    }
+  }
+
+  return count;
+}
+
+/**********************************************************************/
+PageCount listResidentVDOPages(VDOPageCache        *cache,
+                               PhysicalBlockNumber *pbns,
+                               PageCount            maxCount)
+{
+  assertOnCacheThread(cache, __func__);
+  PageCount count = listPagesFromList(&cache->lruList, pbns, 0, maxCount);
+  return listPagesFromList(&cache->probationList, pbns, count, maxCount);
+}
+
 /**********************************************************************/
 void markCompletedVDOPageDirty(VDOCompletion  *completion,
                                SequenceNumber  oldDirtyPeriod,
@@ -1355,11 +2030,15 @@ int invalidateVDOPageCache(VDOPageCache *cache)
   assertOnCacheThread(cache, __func__);
 
   // Make sure we don't throw away any dirty pages.
-  PageInfo *info;
-  for (info = cache->infos; info < cache->infos + cache->pageCount; info++) {
-    int result = ASSERT(!isDirty(info), "cache must have no dirty pages");
-    if (result != VDO_SUCCESS) {
-      return result;
+  PageCacheExtent *extent;
+  for (extent = cache->extents; extent != NULL; extent = extent->next) {
+    PageInfo *info;
+    for (info = extent->infos; info < extent->infos + extent->pageCount;
+         info++) {
+      int result = ASSERT(!isDirty(info), "cache must have no dirty pages");
+      if (result != VDO_SUCCESS) {
+        return result;
+      }
     }
   }
 
@@ -96,6 +96,22 @@ typedef struct {
   Atomic64              pagesSaved;
   /* number of flushes initiated */
   Atomic64              flushCount;
+  /* number of gets for pages still on the probation list */
+  Atomic64              probationHits;
+  /* number of loads of recently evicted probationary pages */
+  Atomic64              ghostHits;
+  /* number of pages evicted */
+  Atomic64              evictions;
+  /* number of evicted pages which were still on probation */
+  Atomic64              probationEvictions;
+  /* total page requests between each evicted page's last use and eviction */
+  Atomic64              evictionAge;
+  /* number of pages read in ahead of any request for them */
+  Atomic64              prefetchReads;
+  /* number of prefetched pages which were requested */
+  Atomic64              prefetchHits;
+  /* number of prefetched pages dropped without having been requested */
+  Atomic64              prefetchWasted;
 } AtomicPageCacheStatistics;
 
 /**
@@ -145,6 +161,7 @@ typedef bool VDOPageWriteFunction(void         *rawPage,
  * @param [in]  maximumAge        The number of journal blocks before a dirtied
  *                                page is considered old and must be written
  *                                out
+ * @param [in]  policy            The replacement policy for the cache
  * @param [in]  zone              The block map zone which owns this cache
  * @param [out] cachePtr          A pointer to hold the cache
  *
@@ -156,10 +173,37 @@ int makeVDOPageCache(PhysicalLayer         *layer,
                      VDOPageWriteFunction  *writeHook,
                      size_t                 pageContextSize,
                      BlockCount             maximumAge,
+                     PageCachePolicy        policy,
                      BlockMapZone          *zone,
                      VDOPageCache         **cachePtr)
   __attribute__((warn_unused_result));
 
+/**
+ * Change the number of pages in a page cache. Growing allocates a new
+ * extent of pages. Shrinking retires the newest extents which can be
+ * removed without going below the requested size; their pages are freed
+ * once they are clean and idle. A cache never shrinks below the size it was
+ * made with.
+ *
+ * @param cache      The cache to resize
+ * @param pageCount  The requested number of pages
+ *
+ * @return VDO_SUCCESS or an error code
+ **/
+int resizeVDOPageCache(VDOPageCache *cache, PageCount pageCount)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the number of pages in a page cache, excluding any which are being
+ * retired.
+ *
+ * @param cache  The cache
+ *
+ * @return The number of pages in the cache
+ **/
+PageCount getVDOPageCacheSize(const VDOPageCache *cache)
+  __attribute__((warn_unused_result));
+
 /**
  * Free the page cache structure and null out the reference to it.
  *
@@ -198,10 +242,13 @@ bool isPageCacheActive(VDOPageCache *cache)
 /**
  * Advance the dirty period for a page cache.
  *
- * @param cache   The cache to advance
- * @param period  The new dirty period
+ * @param cache      The cache to advance
+ * @param period     The new dirty period
+ * @param eraLength  The number of periods a page may now stay dirty
  **/
-void advanceVDOPageCachePeriod(VDOPageCache *cache, SequenceNumber period);
+void advanceVDOPageCachePeriod(VDOPageCache   *cache,
+                               SequenceNumber  period,
+                               BlockCount      eraLength);
 
 /**
  * Write one or more batches of dirty pages.
@@ -301,6 +348,32 @@ void releaseVDOPageCompletion(VDOCompletion *completion);
  **/
 void getVDOPageAsync(VDOCompletion *completion);
 
+/**
+ * Start reading a page into the cache in anticipation of a request for it.
+ * Nothing is done if the page is already cached, if any request is waiting
+ * for a free page, or if the only page which could be replaced is dirty; a
+ * prefetch never waits and never causes a write.
+ *
+ * @param cache  The page cache
+ * @param pbn    The absolute physical block of the page to read
+ **/
+void prefetchVDOPage(VDOPageCache *cache, PhysicalBlockNumber pbn);
+
+/**
+ * List the pages held by a cache, most recently used first, with pages
+ * still on probation (under the 2Q policy) after all the protected ones.
+ *
+ * @param cache     The page cache
+ * @param pbns      The array to hold the physical blocks of the pages
+ * @param maxCount  The maximum number of pages to list
+ *
+ * @return The number of pages listed
+ **/
+PageCount listResidentVDOPages(VDOPageCache        *cache,
+                               PhysicalBlockNumber *pbns,
+                               PageCount            maxCount)
+  __attribute__((warn_unused_result));
+
 /**
  * Mark a VDO page referenced by a completed VDOPageCompletion as dirty.
  *
@@ -320,6 +393,21 @@ void markCompletedVDOPageDirty(VDOCompletion  *completion,
  **/
 void requestVDOPageWrite(VDOCompletion *completion);
 
+/**
+ * Look up a page which is already in the cache and may be read right away,
+ * without a VDOPageCompletion. The request is counted like a read through
+ * getVDOPageAsync(). The page is not held, so the returned memory may only be
+ * used until control returns to the cache's thread's work queue.
+ *
+ * @param cache  The page cache
+ * @param pbn    The absolute physical block of the desired page
+ *
+ * @return a pointer to the raw memory of the page, or NULL if the page is
+ *         not in the cache or is not usable without waiting
+ **/
+const void *findReadableVDOPage(VDOPageCache *cache, PhysicalBlockNumber pbn)
+  __attribute__((warn_unused_result));
+
 /**
  * Access the raw memory for a read-only page of a completed VDOPageCompletion.
  *
@@ -48,13 +48,34 @@ static const PhysicalBlockNumber NO_PAGE = 0xFFFFFFFFFFFFFFFF;
  **/
 typedef RingNode PageInfoNode;
 
+/**
+ * A block of page buffers and the infos which describe them. A cache starts
+ * with one extent and gains another each time it grows. Shrinking retires
+ * the newest extents, which are freed once all of their pages are idle.
+ **/
+typedef struct pageCacheExtent PageCacheExtent;
+struct pageCacheExtent {
+  /** the next older extent */
+  PageCacheExtent *next;
+  /** array of page information entries */
+  PageInfo        *infos;
+  /** raw memory for pages */
+  char            *pages;
+  /** number of pages in the extent */
+  PageCount        pageCount;
+  /** number of pages which have been retired */
+  PageCount        retiredCount;
+  /** whether the extent is being retired */
+  bool             retiring;
+};
+
 /**
  * The VDO Page Cache abstraction.
  **/
 struct vdoPageCache {
   /** the physical layer to page to */
   PhysicalLayer             *layer;
-  /** number of pages in cache */
+  /** number of pages in cache, excluding retiring extents */
   PageCount                  pageCount;
   /** function to call on page read */
   VDOPageReadFunction       *readHook;
@@ -65,22 +86,48 @@ struct vdoPageCache {
   /** Whether the VDO is doing a read-only rebuild */
   bool                       rebuilding;
 
-  /** array of page information entries */
-  PageInfo                  *infos;
-  /** raw memory for pages */
-  char                      *pages;
+  /** the page buffers, newest extent first */
+  PageCacheExtent           *extents;
+  /** completion for freeing retired extents */
+  VDOCompletion              reaper;
+  /** whether the reaper has been launched */
+  bool                       reaping;
   /** cache last found page info */
   PageInfo                  *lastFound;
   /** map of page number to info */
   IntMap                    *pageMap;
-  /** master LRU list (all infos) */
+  /** the replacement policy */
+  PageCachePolicy            policy;
+  /** LRU list of protected pages (all pages under the LRU policy) */
   PageInfoNode               lruList;
+  /** FIFO list of pages which have not been promoted (2Q only) */
+  PageInfoNode               probationList;
+  /** number of pages on the probation list */
+  PageCount                  probationCount;
+  /** the probation list length above which it is evicted from first */
+  PageCount                  probationTarget;
+  /** ring of recently evicted probationary page numbers (2Q only) */
+  PhysicalBlockNumber       *ghosts;
+  /** number of slots in the ghost ring */
+  PageCount                  ghostCount;
+  /** the next slot of the ghost ring to fill */
+  PageCount                  nextGhost;
+  /** map of ghost page number to its slot in the ghost ring */
+  IntMap                    *ghostMap;
+  /** number of page requests, used to measure eviction ages */
+  uint64_t                   requestClock;
   /** dirty pages by period */
   DirtyLists                *dirtyLists;
   /** free page list (oldest first) */
   PageInfoNode               freeList;
   /** outgoing page list */
   PageInfoNode               outgoingList;
+  /** flushed pages waiting to be written, in batches sorted by pbn */
+  PageInfoNode               writeQueue;
+  /** number of page writes launched and not yet finished */
+  PageCount                  writesInFlight;
+  /** whether writes are being launched from the write queue */
+  bool                       launchingWrites;
   /** number of read I/O operations pending */
   PageCount                  outstandingReads;
   /** number of write I/O operations pending */
@@ -147,6 +194,8 @@ struct pageInfo {
   VIO                 *vio;
   /** back-link for references */
   VDOPageCache        *cache;
+  /** the extent holding the page buffer */
+  PageCacheExtent     *extent;
   /** the pbn of the page */
   PhysicalBlockNumber  pbn;
   /** page is busy (temporarily locked) */
@@ -161,6 +210,14 @@ struct pageInfo {
   PageInfoNode         listNode;
   /** LRU node */
   PageInfoNode         lruNode;
+  /** whether the lruNode is on the probation list */
+  bool                 probationary;
+  /** whether the page has been retired from a shrinking cache */
+  bool                 retired;
+  /** whether the page was prefetched and has not been requested since */
+  bool                 prefetched;
+  /** the request clock when the page was last used */
+  uint64_t             lastUsed;
   /** Space for per-page client data */
   byte                 context[MAX_PAGE_CONTEXT_SIZE];
 };
@@ -38,6 +38,7 @@
 #include "slabDepot.h"
 #include "slabJournal.h"
 #include "slabJournalInternals.h"
+#include "timeUtils.h"
 #include "vdoInternal.h"
 #include "waitQueue.h"
 
@@ -266,10 +267,6 @@ static void prepareSubTask(RecoveryCompletion *recovery,
     threadID = getLogicalZoneThread(threadConfig, 0);
     break;
 
-  case ZONE_TYPE_PHYSICAL:
-    threadID = recovery->allocator->threadID;
-    break;
-
   case ZONE_TYPE_ADMIN:
   default:
     threadID = getAdminThread(threadConfig);
@@ -296,6 +293,13 @@ int makeRecoveryCompletion(VDO *vdo, RecoveryCompletion **recoveryPtr)
     initializeWaitQueue(&recovery->missingDecrefs[z]);
   }
 
+  result = ALLOCATE(threadConfig->physicalZoneCount, SlabJournalReplay,
+                    __func__, &recovery->slabJournalReplays);
+  if (result != VDO_SUCCESS) {
+    freeRecoveryCompletion(&recovery);
+    return result;
+  }
+
   result = initializeEnqueueableCompletion(&recovery->completion,
                                            RECOVERY_COMPLETION, vdo->layer);
   if (result != VDO_SUCCESS) {
@@ -347,12 +351,29 @@ void freeRecoveryCompletion(RecoveryCompletion **recoveryPtr)
 
   FREE(recovery->journalData);
   FREE(recovery->entries);
+  FREE(recovery->slabJournalReplays);
   destroyEnqueueable(&recovery->subTaskCompletion);
   destroyEnqueueable(&recovery->completion);
   FREE(recovery);
   *recoveryPtr = NULL;
 }
 
+/**
+ * Log how long the phase of the recovery which has just ended took and start
+ * timing the next one.
+ *
+ * @param recovery  The recovery completion
+ * @param phase     A description of the phase which has ended
+ **/
+static void finishRecoveryPhase(RecoveryCompletion *recovery,
+                                const char         *phase)
+{
+  uint64_t now = nowUsec();
+  logInfo("Recovery %s took %" PRIu64 " ms", phase,
+          (now - recovery->phaseStart) / 1000);
+  recovery->phaseStart = now;
+}
+
 /**
  * Finish recovering, free the recovery completion and notify the parent.
  *
@@ -364,6 +385,7 @@ static void finishRecovery(VDOCompletion *completion)
   RecoveryCompletion *recovery      = asRecoveryCompletion(completion);
   VDO                *vdo           = recovery->vdo;
   uint64_t            recoveryCount = ++vdo->completeRecoveries;
+  finishRecoveryPhase(recovery, "block map replay");
   initializeRecoveryJournalPostRecovery(vdo->recoveryJournal,
                                         recoveryCount, recovery->highestTail);
   freeRecoveryCompletion(&recovery);
@@ -493,6 +515,7 @@ static void launchBlockMapRecovery(VDOCompletion *completion)
   RecoveryCompletion *recovery = asRecoveryCompletion(completion->parent);
   VDO                *vdo      = recovery->vdo;
   assertOnLogicalZoneThread(vdo, 0, __func__);
+  finishRecoveryPhase(recovery, "preparation for block map replay");
 
   // Extract the journal entries for the block map recovery.
   int result = extractJournalEntries(recovery);
@@ -515,6 +538,7 @@ static void startSuperBlockSave(VDOCompletion *completion)
   RecoveryCompletion *recovery = asRecoveryCompletion(completion->parent);
   VDO                *vdo      = recovery->vdo;
   assertOnAdminThread(vdo, __func__);
+  finishRecoveryPhase(recovery, "slab journal flush");
 
   logInfo("Saving recovery progress");
   vdo->state = VDO_REPLAYING;
@@ -527,19 +551,19 @@ static void startSuperBlockSave(VDOCompletion *completion)
 }
 
 /**
- * The callback from loading the slab depot. It will update the logical blocks
- * and block map data blocks counts in the recovery journal and then drain the
- * slab depot in order to commit the recovered slab journals. It is registered
- * in applyToDepot().
+ * Update the logical blocks and block map data blocks counts in the recovery
+ * journal and then drain the slab depot in order to commit the recovered slab
+ * journals. This is called once the slab depot has loaded and every physical
+ * zone has finished replaying into its slab journals.
  *
- * @param completion  The sub-task completion
+ * @param recovery  The recovery completion
  **/
-static void finishRecoveringDepot(VDOCompletion *completion)
+static void finishRecoveringDepot(RecoveryCompletion *recovery)
 {
-  RecoveryCompletion *recovery = asRecoveryCompletion(completion->parent);
-  VDO                *vdo      = recovery->vdo;
+  VDO *vdo = recovery->vdo;
   assertOnAdminThread(vdo, __func__);
 
+  finishRecoveryPhase(recovery, "slab journal replay");
   logInfo("Replayed %zu journal entries into slab journals",
           recovery->entriesAddedToSlabJournals);
   logInfo("Synthesized %zu missing journal entries",
@@ -549,7 +573,63 @@ static void finishRecoveringDepot(VDOCompletion *completion)
 
   prepareSubTask(recovery, startSuperBlockSave, finishParentCallback,
                  ZONE_TYPE_ADMIN);
-  drainSlabDepot(vdo->depot, ADMIN_STATE_RECOVERING, completion);
+  drainSlabDepot(vdo->depot, ADMIN_STATE_RECOVERING,
+                 &recovery->subTaskCompletion);
+}
+
+/**
+ * Note that the slab depot has loaded or that a physical zone has finished
+ * replaying into its slab journals. Once all of them have, finish recovering
+ * the depot, or abort the recovery if any of them failed.
+ *
+ * @param recovery  The recovery completion
+ **/
+static void releaseSlabJournalReplay(RecoveryCompletion *recovery)
+{
+  assertOnAdminThread(recovery->vdo, __func__);
+  if (atomicAdd32(&recovery->slabJournalReplaysPending, -1) > 0) {
+    return;
+  }
+
+  if (abortRecoveryOnError(recovery->completion.result, recovery)) {
+    return;
+  }
+
+  finishRecoveringDepot(recovery);
+}
+
+/**
+ * Record the result of the slab journal replay of one physical zone. This
+ * callback is registered in finishSlabJournalReplay().
+ *
+ * @param completion  The completion of the block allocator which was
+ *                    recovered
+ **/
+static void slabJournalReplayFinished(VDOCompletion *completion)
+{
+  SlabJournalReplay  *replay   = completion->parent;
+  RecoveryCompletion *recovery = replay->recovery;
+  recovery->entriesAddedToSlabJournals += replay->entriesAdded;
+  setCompletionResult(&recovery->completion, completion->result);
+  releaseSlabJournalReplay(recovery);
+}
+
+/**
+ * Finish the slab journal replay of a physical zone and report the result on
+ * the admin thread.
+ *
+ * @param completion  The completion of the block allocator being recovered
+ * @param result      The result of the replay
+ **/
+static void finishSlabJournalReplay(VDOCompletion *completion, int result)
+{
+  SlabJournalReplay  *replay   = completion->parent;
+  const ThreadConfig *threadConfig
+    = getThreadConfig(replay->recovery->vdo);
+  prepareCompletion(completion, slabJournalReplayFinished,
+                    slabJournalReplayFinished, getAdminThread(threadConfig),
+                    replay);
+  finishCompletion(completion, result);
 }
 
 /**
@@ -561,8 +641,7 @@ static void finishRecoveringDepot(VDOCompletion *completion)
  **/
 static void handleAddSlabJournalEntryError(VDOCompletion *completion)
 {
-  RecoveryCompletion *recovery = asRecoveryCompletion(completion->parent);
-  notifySlabJournalsAreRecovered(recovery->allocator, completion->result);
+  finishSlabJournalReplay(completion, completion->result);
 }
 
 /**
@@ -572,14 +651,15 @@ static void handleAddSlabJournalEntryError(VDOCompletion *completion)
  **/
 static void addSynthesizedEntries(VDOCompletion *completion)
 {
-  RecoveryCompletion *recovery = asRecoveryCompletion(completion->parent);
+  SlabJournalReplay  *replay   = completion->parent;
+  RecoveryCompletion *recovery = replay->recovery;
 
   // Get ready in case we need to enqueue again
   prepareCompletion(completion, addSynthesizedEntries,
                     handleAddSlabJournalEntryError,
-                    completion->callbackThreadID, recovery);
+                    completion->callbackThreadID, replay);
   WaitQueue *missingDecrefs
-    = &recovery->missingDecrefs[recovery->allocator->zoneNumber];
+    = &recovery->missingDecrefs[replay->allocator->zoneNumber];
   while (hasWaiters(missingDecrefs)) {
     MissingDecref *decref = asMissingDecref(getFirstWaiter(missingDecrefs));
     if (!attemptReplayIntoSlabJournal(decref->slabJournal,
@@ -593,7 +673,7 @@ static void addSynthesizedEntries(VDOCompletion *completion)
     FREE(decref);
   }
 
-  notifySlabJournalsAreRecovered(recovery->allocator, VDO_SUCCESS);
+  finishSlabJournalReplay(completion, VDO_SUCCESS);
 }
 
 /**
@@ -659,37 +739,38 @@ static int computeUsages(RecoveryCompletion *recovery)
 /**
  * Advance the current recovery and journal points.
  *
- * @param recovery         The RecoveryCompletion whose points are to be
+ * @param replay           The SlabJournalReplay whose points are to be
  *                         advanced
  * @param entriesPerBlock  The number of entries in a recovery journal block
  **/
-static void advancePoints(RecoveryCompletion *recovery,
-                          JournalEntryCount   entriesPerBlock)
+static void advancePoints(SlabJournalReplay *replay,
+                          JournalEntryCount  entriesPerBlock)
 {
-  incrementRecoveryPoint(&recovery->nextRecoveryPoint);
-  advanceJournalPoint(&recovery->nextJournalPoint, entriesPerBlock);
+  incrementRecoveryPoint(&replay->nextRecoveryPoint);
+  advanceJournalPoint(&replay->nextJournalPoint, entriesPerBlock);
 }
 
 /**
- * Replay recovery journal entries into the slab journals of the allocator
- * currently being recovered, waiting for slab journal tailblock space when
- * necessary. This method is its own callback.
+ * Replay recovery journal entries into the slab journals of an allocator,
+ * waiting for slab journal tailblock space when necessary. This method is its
+ * own callback.
  *
  * @param completion  The allocator completion
  **/
 static void addSlabJournalEntries(VDOCompletion *completion)
 {
-  RecoveryCompletion *recovery = asRecoveryCompletion(completion->parent);
+  SlabJournalReplay  *replay   = completion->parent;
+  RecoveryCompletion *recovery = replay->recovery;
   VDO                *vdo      = recovery->vdo;
   RecoveryJournal    *journal  = vdo->recoveryJournal;
 
   // Get ready in case we need to enqueue again.
   prepareCompletion(completion, addSlabJournalEntries,
                     handleAddSlabJournalEntryError,
-                    completion->callbackThreadID, recovery);
-  for (RecoveryPoint *recoveryPoint = &recovery->nextRecoveryPoint;
+                    completion->callbackThreadID, replay);
+  for (RecoveryPoint *recoveryPoint = &replay->nextRecoveryPoint;
        beforeRecoveryPoint(recoveryPoint, &recovery->tailRecoveryPoint);
-       advancePoints(recovery, journal->entriesPerBlock)) {
+       advancePoints(replay, journal->entriesPerBlock)) {
     RecoveryJournalEntry entry = getEntry(recovery, recoveryPoint);
     int result = validateRecoveryJournalEntry(vdo, &entry);
     if (result != VDO_SUCCESS) {
@@ -703,22 +784,22 @@ static void addSlabJournalEntries(VDOCompletion *completion)
     }
 
     Slab *slab = getSlab(vdo->depot, entry.mapping.pbn);
-    if (slab->allocator != recovery->allocator) {
+    if (slab->allocator != replay->allocator) {
       continue;
     }
 
     if (!attemptReplayIntoSlabJournal(slab->journal, entry.mapping.pbn,
                                       entry.operation,
-                                      &recovery->nextJournalPoint,
+                                      &replay->nextJournalPoint,
                                       completion)) {
       return;
     }
 
-    recovery->entriesAddedToSlabJournals++;
+    replay->entriesAdded++;
   }
 
   logInfo("Recreating missing journal entries for zone %u",
-          recovery->allocator->zoneNumber);
+          replay->allocator->zoneNumber);
   addSynthesizedEntries(completion);
 }
 
@@ -735,22 +816,33 @@ void replayIntoSlabJournals(BlockAllocator *allocator,
     return;
   }
 
-  recovery->allocator = allocator;
-  recovery->nextRecoveryPoint = (RecoveryPoint) {
-    .sequenceNumber = recovery->slabJournalHead,
-    .sectorCount    = 1,
-    .entryCount     = 0,
-  };
-
-  recovery->nextJournalPoint = (JournalPoint) {
-    .sequenceNumber = recovery->slabJournalHead,
-    .entryCount     = 0,
+  SlabJournalReplay *replay
+    = &recovery->slabJournalReplays[allocator->zoneNumber];
+  *replay = (SlabJournalReplay) {
+    .recovery          = recovery,
+    .allocator         = allocator,
+    .nextRecoveryPoint = {
+      .sequenceNumber = recovery->slabJournalHead,
+      .sectorCount    = 1,
+      .entryCount     = 0,
+    },
+    .nextJournalPoint  = {
+      .sequenceNumber = recovery->slabJournalHead,
+      .entryCount     = 0,
+    },
   };
 
+  /*
+   * Finish loading this zone before replaying into it so that the depot can
+   * go on to load the next zone while this one replays. The recovery waits
+   * for every zone's replay before it drains the depot.
+   */
+  atomicAdd32(&recovery->slabJournalReplaysPending, 1);
   logInfo("Replaying entries into slab journals for zone %u",
           allocator->zoneNumber);
-  completion->parent = recovery;
+  completion->parent = replay;
   addSlabJournalEntries(completion);
+  notifySlabJournalsAreRecovered(allocator, VDO_SUCCESS);
 }
 
 /**
@@ -778,6 +870,20 @@ static void queueOnPhysicalZone(Waiter *waiter, void *context)
   enqueueMissingDecref(&decref->recovery->missingDecrefs[zoneNumber], decref);
 }
 
+/**
+ * Note that the slab depot has finished loading. Every physical zone will
+ * have started replaying into its slab journals by now. This callback is
+ * registered in applyToDepot().
+ *
+ * @param completion  The sub-task completion
+ **/
+static void slabDepotLoaded(VDOCompletion *completion)
+{
+  RecoveryCompletion *recovery = asRecoveryCompletion(completion->parent);
+  setCompletionResult(&recovery->completion, completion->result);
+  releaseSlabJournalReplay(recovery);
+}
+
 /**
  * Queue each missing decref on the slab journal to which it is to be applied
  * then load the slab depot. This callback is registered in
@@ -789,8 +895,8 @@ static void applyToDepot(VDOCompletion *completion)
 {
   RecoveryCompletion *recovery = asRecoveryCompletion(completion->parent);
   assertOnAdminThread(recovery->vdo, __func__);
-  prepareSubTask(recovery, finishRecoveringDepot, finishParentCallback,
-                 ZONE_TYPE_ADMIN);
+  finishRecoveryPhase(recovery, "missing decref search");
+  prepareSubTask(recovery, slabDepotLoaded, slabDepotLoaded, ZONE_TYPE_ADMIN);
 
   SlabDepot *depot = getSlabDepot(recovery->vdo);
   notifyAllWaiters(&recovery->missingDecrefs[0], queueOnPhysicalZone, depot);
@@ -798,6 +904,7 @@ static void applyToDepot(VDOCompletion *completion)
     return;
   }
 
+  atomicStore32(&recovery->slabJournalReplaysPending, 1);
   loadSlabDepot(depot, ADMIN_STATE_LOADING_FOR_RECOVERY, completion, recovery);
 }
 
@@ -1167,6 +1274,7 @@ static void prepareToApplyJournalEntries(VDOCompletion *completion)
   VDO                *vdo      = recovery->vdo;
   RecoveryJournal    *journal  = vdo->recoveryJournal;
   logInfo("Finished reading recovery journal");
+  finishRecoveryPhase(recovery, "journal read");
   bool foundEntries = findHeadAndTail(journal, recovery->journalData,
                                       &recovery->highestTail,
                                       &recovery->blockMapHead,
@@ -1250,6 +1358,7 @@ void launchRecovery(VDO *vdo, VDOCompletion *parent)
   VDOCompletion *completion = &recovery->completion;
   prepareCompletion(completion, finishRecovery, abortRecovery,
                     parent->callbackThreadID, parent);
+  recovery->phaseStart = nowUsec();
   prepareSubTask(recovery, prepareToApplyJournalEntries, finishParentCallback,
                  ZONE_TYPE_ADMIN);
   loadJournalAsync(vdo->recoveryJournal, &recovery->subTaskCompletion,
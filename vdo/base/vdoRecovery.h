@@ -27,7 +27,9 @@
 
 /**
  * Replay recovery journal entries in the the slab journals of slabs owned by a
- * given BlockAllocator.
+ * given BlockAllocator. The allocator's load is finished as soon as the replay
+ * has started so that the other zones may load and replay concurrently; the
+ * recovery itself waits for every zone's replay to finish.
  *
  * @param allocator   The allocator whose slab journals are to be recovered
  * @param completion  The completion to use for waiting on slab journal space
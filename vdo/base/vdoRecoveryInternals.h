@@ -24,6 +24,7 @@
 
 #include "vdoRecovery.h"
 
+#include "atomic.h"
 #include "blockMapRecovery.h"
 #include "intMap.h"
 #include "journalPoint.h"
@@ -41,15 +42,33 @@ typedef struct {
   JournalEntryCount entryCount;     // Entry number
 } RecoveryPoint;
 
+typedef struct recoveryCompletion RecoveryCompletion;
+
+/**
+ * The progress of the replay of the recovery journal into the slab journals
+ * of one physical zone. Each zone replays on its own thread, concurrently
+ * with the others.
+ **/
 typedef struct {
+  /** The recovery of which this replay is a part */
+  RecoveryCompletion          *recovery;
+  /** The BlockAllocator whose journals are being recovered */
+  BlockAllocator              *allocator;
+  /** The location of the next recovery journal entry to apply */
+  RecoveryPoint                nextRecoveryPoint;
+  /** The journal point to give to the next entry */
+  JournalPoint                 nextJournalPoint;
+  /** The number of entries played into the slab journals of this zone */
+  size_t                       entriesAdded;
+} SlabJournalReplay;
+
+struct recoveryCompletion {
   /** The completion header */
   VDOCompletion                completion;
   /** The sub-task completion */
   VDOCompletion                subTaskCompletion;
   /** The VDO in question */
   VDO                         *vdo;
-  /** The BlockAllocator whose journals are being recovered */
-  BlockAllocator              *allocator;
   /** A buffer to hold the data read off disk */
   char                        *journalData;
   /** The number of increfs */
@@ -73,16 +92,21 @@ typedef struct {
 
   /** A location just beyond the last valid entry of the journal */
   RecoveryPoint                tailRecoveryPoint;
-  /** The location of the next recovery journal entry to apply */
-  RecoveryPoint                nextRecoveryPoint;
   /** The number of logical blocks currently known to be in use */
   BlockCount                   logicalBlocksUsed;
   /** The number of block map data blocks known to be allocated */
   BlockCount                   blockMapDataBlocks;
-  /** The journal point to give to the next synthesized decref */
-  JournalPoint                 nextJournalPoint;
   /** The number of entries played into slab journals */
   size_t                       entriesAddedToSlabJournals;
+  /** The slab journal replay of each physical zone */
+  SlabJournalReplay           *slabJournalReplays;
+  /**
+   * The number of physical zones still replaying into their slab journals,
+   * plus one until the slab depot has finished loading
+   **/
+  Atomic32                     slabJournalReplaysPending;
+  /** The time at which the current phase of the recovery started */
+  uint64_t                     phaseStart;
 
   // Decref synthesis fields
 
@@ -96,7 +120,7 @@ typedef struct {
   JournalPoint                 nextSynthesizedJournalPoint;
   /** The queue of missing decrefs */
   WaitQueue                    missingDecrefs[];
-} RecoveryCompletion;
+};
 
 /**
  * Convert a generic completion to a RecoveryCompletion.
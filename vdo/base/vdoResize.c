@@ -25,12 +25,28 @@
 
 #include "adminCompletion.h"
 #include "completion.h"
+#include "numUtils.h"
 #include "recoveryJournal.h"
 #include "slabDepot.h"
 #include "slabSummary.h"
+#include "threadConfig.h"
 #include "vdoInternal.h"
 #include "vdoLayout.h"
 
+typedef enum {
+  PREPARE_GROW_PHYSICAL_PHASE_START = 0,
+  PREPARE_GROW_PHYSICAL_PHASE_RECORD_JOURNAL,
+  PREPARE_GROW_PHYSICAL_PHASE_COPY_JOURNAL,
+  PREPARE_GROW_PHYSICAL_PHASE_END,
+} PrepareGrowPhysicalPhase;
+
+static const char *PREPARE_GROW_PHYSICAL_PHASE_NAMES[] = {
+  "PREPARE_GROW_PHYSICAL_PHASE_START",
+  "PREPARE_GROW_PHYSICAL_PHASE_RECORD_JOURNAL",
+  "PREPARE_GROW_PHYSICAL_PHASE_COPY_JOURNAL",
+  "PREPARE_GROW_PHYSICAL_PHASE_END",
+};
+
 typedef enum {
   GROW_PHYSICAL_PHASE_START = 0,
   GROW_PHYSICAL_PHASE_COPY_SUMMARY,
@@ -58,6 +74,30 @@ static ThreadID getThreadIDForPhase(AdminCompletion *adminCompletion)
   return getAdminThread(getThreadConfig(adminCompletion->completion.parent));
 }
 
+/**
+ * Copy the recovery journal into the next layout. If the journal was copied
+ * while the VDO was still running, only the blocks which may have been
+ * written since then need to be copied again.
+ *
+ * @param vdo     The VDO being grown
+ * @param parent  The completion to notify when the copy is complete
+ **/
+static void copyJournalForGrowth(VDO *vdo, VDOCompletion *parent)
+{
+  if (!vdo->journalPreCopied) {
+    copyPartition(vdo->layout, RECOVERY_JOURNAL_PARTITION, parent);
+    return;
+  }
+
+  SequenceNumber tail = getCurrentJournalSequenceNumber(vdo->recoveryJournal);
+  BlockCount     blocksWritten = tail - vdo->journalPreCopyStart;
+  copyPartitionBlocks(vdo->layout, RECOVERY_JOURNAL_PARTITION,
+                      vdo->journalPreCopyStart,
+                      minBlockCount(blocksWritten,
+                                    vdo->config.recoveryJournalSize),
+                      parent);
+}
+
 /**
  * Callback to initiate a grow physical, registered in performGrowPhysical().
  *
@@ -83,8 +123,7 @@ static void growPhysicalCallback(VDOCompletion *completion)
                                  ADMIN_STATE_SUSPENDED_OPERATION,
                                  &adminCompletion->completion, NULL)) {
       // Copy the journal into the new layout.
-      copyPartition(vdo->layout, RECOVERY_JOURNAL_PARTITION,
-                    resetAdminSubTask(completion));
+      copyJournalForGrowth(vdo, resetAdminSubTask(completion));
     }
     return;
 
@@ -119,6 +158,7 @@ static void growPhysicalCallback(VDOCompletion *completion)
     setCompletionResult(resetAdminSubTask(completion), UDS_BAD_STATE);
   }
 
+  vdo->journalPreCopied = false;
   finishVDOLayoutGrowth(vdo->layout);
   finishOperationWithResult(&vdo->adminState, completion->result);
 }
@@ -150,6 +190,7 @@ int performGrowPhysical(VDO *vdo, BlockCount newPhysicalBlocks)
      * to a different size. Doing this check here relies on the fact that
      * the call to this method is done under the dmsetup message lock.
      */
+    vdo->journalPreCopied = false;
     finishVDOLayoutGrowth(vdo->layout);
     abandonNewSlabs(vdo->depot);
     return VDO_PARAMETER_MISMATCH;
@@ -175,35 +216,80 @@ int performGrowPhysical(VDO *vdo, BlockCount newPhysicalBlocks)
 }
 
 /**
- * Callback to check that we're not in recovery mode, used in
- * prepareToGrowPhysical().
+ * Implements ThreadIDGetterForPhase.
+ **/
+__attribute__((warn_unused_result))
+static ThreadID getThreadIDForPreparePhase(AdminCompletion *adminCompletion)
+{
+  const ThreadConfig *threadConfig
+    = getThreadConfig(adminCompletion->completion.parent);
+  if (adminCompletion->phase == PREPARE_GROW_PHYSICAL_PHASE_RECORD_JOURNAL) {
+    return getJournalZoneThread(threadConfig);
+  }
+
+  return getAdminThread(threadConfig);
+}
+
+/**
+ * Callback to check that we're not in recovery mode and then to copy the
+ * recovery journal into the next layout while the VDO is still running, so
+ * that the suspended part of the grow need only recopy the journal blocks
+ * written since. Registered in prepareToGrowPhysical().
  *
  * @param completion  The sub-task completion
  **/
-static void checkMayGrowPhysical(VDOCompletion *completion)
+static void prepareGrowPhysicalCallback(VDOCompletion *completion)
 {
   AdminCompletion *adminCompletion = adminCompletionFromSubTask(completion);
   assertAdminOperationType(adminCompletion,
                            ADMIN_OPERATION_PREPARE_GROW_PHYSICAL);
+  assertAdminPhaseThread(adminCompletion, __func__,
+                         PREPARE_GROW_PHYSICAL_PHASE_NAMES);
 
   VDO *vdo = adminCompletion->completion.parent;
-  assertOnAdminThread(vdo, __func__);
+  switch (adminCompletion->phase++) {
+  case PREPARE_GROW_PHYSICAL_PHASE_START:
+    // This check can only be done from a base code thread.
+    if (isReadOnly(vdo->readOnlyNotifier)) {
+      setCompletionResult(resetAdminSubTask(completion), VDO_READ_ONLY);
+      break;
+    }
 
-  resetAdminSubTask(completion);
+    // This check should only be done from a base code thread.
+    if (inRecoveryMode(vdo)) {
+      setCompletionResult(resetAdminSubTask(completion),
+                          VDO_RETRY_AFTER_REBUILD);
+      break;
+    }
 
-  // This check can only be done from a base code thread.
-  if (isReadOnly(vdo->readOnlyNotifier)) {
-    finishCompletion(completion->parent, VDO_READ_ONLY);
+    completeCompletion(resetAdminSubTask(completion));
+    return;
+
+  case PREPARE_GROW_PHYSICAL_PHASE_RECORD_JOURNAL:
+    /*
+     * Any journal block which is written after this point has a sequence
+     * number at least this large, so it is all that must be recopied once
+     * the VDO is suspended.
+     */
+    vdo->journalPreCopyStart
+      = getOldestWritableJournalBlock(vdo->recoveryJournal);
+    completeCompletion(resetAdminSubTask(completion));
     return;
-  }
 
-  // This check should only be done from a base code thread.
-  if (inRecoveryMode(vdo)) {
-    finishCompletion(completion->parent, VDO_RETRY_AFTER_REBUILD);
+  case PREPARE_GROW_PHYSICAL_PHASE_COPY_JOURNAL:
+    copyPartition(vdo->layout, RECOVERY_JOURNAL_PARTITION,
+                  resetAdminSubTask(completion));
     return;
+
+  case PREPARE_GROW_PHYSICAL_PHASE_END:
+    vdo->journalPreCopied = true;
+    break;
+
+  default:
+    setCompletionResult(resetAdminSubTask(completion), UDS_BAD_STATE);
   }
 
-  completeCompletion(completion->parent);
+  finishCompletion(completion->parent, completion->result);
 }
 
 /**********************************************************************/
@@ -220,22 +306,26 @@ int prepareToGrowPhysical(VDO *vdo, BlockCount newPhysicalBlocks)
     logWarning("Requested physical block count %" PRIu64
                " not greater than %" PRIu64,
                newPhysicalBlocks, currentPhysicalBlocks);
+    vdo->journalPreCopied = false;
     finishVDOLayoutGrowth(vdo->layout);
     abandonNewSlabs(vdo->depot);
     return VDO_PARAMETER_MISMATCH;
   }
 
-  int result = performAdminOperation(vdo,
-                                     ADMIN_OPERATION_PREPARE_GROW_PHYSICAL,
-                                     getThreadIDForPhase, checkMayGrowPhysical,
-                                     finishParentCallback);
+  // Any earlier copy of the journal may have been to a different layout.
+  vdo->journalPreCopied = false;
+  int result = prepareToGrowVDOLayout(vdo->layout, currentPhysicalBlocks,
+                                      newPhysicalBlocks, vdo->layer);
   if (result != VDO_SUCCESS) {
     return result;
   }
 
-  result = prepareToGrowVDOLayout(vdo->layout, currentPhysicalBlocks,
-                                  newPhysicalBlocks, vdo->layer);
+  result = performAdminOperation(vdo, ADMIN_OPERATION_PREPARE_GROW_PHYSICAL,
+                                 getThreadIDForPreparePhase,
+                                 prepareGrowPhysicalCallback,
+                                 finishParentCallback);
   if (result != VDO_SUCCESS) {
+    finishVDOLayoutGrowth(vdo->layout);
     return result;
   }
 
@@ -101,11 +101,63 @@ static void growLogicalCallback(VDOCompletion *completion)
 }
 
 /**
- * Handle an error during the grow physical process.
+ * Callback to initiate a grow logical while the VDO is running, registered in
+ * performOnlineGrowLogical(). The phases are those of growLogicalCallback(),
+ * but the super block is saved, and the block map grown, without suspending.
  *
  * @param completion  The sub-task completion
  **/
-static void handleGrowthError(VDOCompletion *completion)
+static void onlineGrowLogicalCallback(VDOCompletion *completion)
+{
+  AdminCompletion *adminCompletion = adminCompletionFromSubTask(completion);
+  assertAdminOperationType(adminCompletion, ADMIN_OPERATION_GROW_LOGICAL);
+  assertAdminPhaseThread(adminCompletion, __func__, GROW_LOGICAL_PHASE_NAMES);
+
+  VDO *vdo = adminCompletion->completion.parent;
+  switch (adminCompletion->phase++) {
+  case GROW_LOGICAL_PHASE_START:
+    if (isReadOnly(vdo->readOnlyNotifier)) {
+      logErrorWithStringError(VDO_READ_ONLY,
+                              "Can't grow logical size of a read-only VDO");
+      finishCompletion(resetAdminSubTask(completion), VDO_READ_ONLY);
+      return;
+    }
+
+    if (startOperationWithWaiter(&vdo->adminState, ADMIN_STATE_OPERATING,
+                                 &adminCompletion->completion, NULL)) {
+      // The VDO is dirty while running, so recovery does not depend on any
+      // component state written here other than the new logical size.
+      vdo->config.logicalBlocks = getNewEntryCount(getBlockMap(vdo));
+      saveVDOComponentsAsync(vdo, resetAdminSubTask(completion));
+    }
+
+    return;
+
+  case GROW_LOGICAL_PHASE_GROW_BLOCK_MAP:
+    growBlockMapOnline(getBlockMap(vdo), resetAdminSubTask(completion));
+    return;
+
+  case GROW_LOGICAL_PHASE_END:
+    break;
+
+  case GROW_LOGICAL_PHASE_ERROR:
+    enterReadOnlyMode(vdo->readOnlyNotifier, completion->result);
+    break;
+
+  default:
+    setCompletionResult(resetAdminSubTask(completion), UDS_BAD_STATE);
+  }
+
+  finishOperationWithResult(&vdo->adminState, completion->result);
+}
+
+/**
+ * Undo the in-memory effects of a grow logical which failed to save the
+ * super block, and move to the error phase.
+ *
+ * @param completion  The sub-task completion
+ **/
+static void recordGrowthError(VDOCompletion *completion)
 {
   AdminCompletion *adminCompletion = adminCompletionFromSubTask(completion);
   if (adminCompletion->phase == GROW_LOGICAL_PHASE_GROW_BLOCK_MAP) {
@@ -118,9 +170,30 @@ static void handleGrowthError(VDOCompletion *completion)
   }
 
   adminCompletion->phase = GROW_LOGICAL_PHASE_ERROR;
+}
+
+/**
+ * Handle an error during the grow logical process.
+ *
+ * @param completion  The sub-task completion
+ **/
+static void handleGrowthError(VDOCompletion *completion)
+{
+  recordGrowthError(completion);
   growLogicalCallback(completion);
 }
 
+/**
+ * Handle an error during the online grow logical process.
+ *
+ * @param completion  The sub-task completion
+ **/
+static void handleOnlineGrowthError(VDOCompletion *completion)
+{
+  recordGrowthError(completion);
+  onlineGrowLogicalCallback(completion);
+}
+
 /**********************************************************************/
 int performGrowLogical(VDO *vdo, BlockCount newLogicalBlocks)
 {
@@ -133,6 +206,18 @@ int performGrowLogical(VDO *vdo, BlockCount newLogicalBlocks)
                                handleGrowthError);
 }
 
+/**********************************************************************/
+int performOnlineGrowLogical(VDO *vdo, BlockCount newLogicalBlocks)
+{
+  if (getNewEntryCount(getBlockMap(vdo)) != newLogicalBlocks) {
+    return VDO_PARAMETER_MISMATCH;
+  }
+
+  return performAdminOperation(vdo, ADMIN_OPERATION_GROW_LOGICAL,
+                               getThreadIDForPhase, onlineGrowLogicalCallback,
+                               handleOnlineGrowthError);
+}
+
 /**********************************************************************/
 int prepareToGrowLogical(VDO *vdo, BlockCount newLogicalBlocks)
 {
@@ -35,6 +35,19 @@
  **/
 int performGrowLogical(VDO *vdo, BlockCount newLogicalBlocks);
 
+/**
+ * Grow the logical size of the VDO without suspending it. Each logical zone
+ * switches to the grown block map between lookups, so I/O continues
+ * throughout. This method may only be called while the VDO is running, after
+ * prepareToGrowLogical(), and must not be called from a base thread.
+ *
+ * @param vdo               The VDO to grow
+ * @param newLogicalBlocks  The size to which the VDO should be grown
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+int performOnlineGrowLogical(VDO *vdo, BlockCount newLogicalBlocks);
+
 /**
  * Prepare to grow the logical size of the VDO. This method may only be called
  * while the VDO is running.
@@ -67,9 +67,6 @@ static ThreadID getThreadIDForPhase(AdminCompletion *adminCompletion)
   case RESUME_PHASE_JOURNAL:
     return getJournalZoneThread(threadConfig);
 
-  case RESUME_PHASE_PACKER:
-    return getPackerZoneThread(threadConfig);
-
   default:
     return getAdminThread(threadConfig);
   }
@@ -147,7 +144,7 @@ static void resumeCallback(VDOCompletion *completion)
       return;
 
   case RESUME_PHASE_PACKER:
-    resumePacker(vdo->packer, resetAdminSubTask(completion));
+    resumePackerZones(vdo->packerZones, resetAdminSubTask(completion));
     return;
 
   case RESUME_PHASE_END:
@@ -22,6 +22,7 @@
 #include "vdoSuspend.h"
 
 #include "logger.h"
+#include "timeUtils.h"
 
 #include "adminCompletion.h"
 #include "blockMap.h"
@@ -64,9 +65,6 @@ static ThreadID getThreadIDForPhase(AdminCompletion *adminCompletion)
   const ThreadConfig *threadConfig
     = getThreadConfig(adminCompletion->completion.parent);
   switch (adminCompletion->phase) {
-  case SUSPEND_PHASE_PACKER:
-    return getPackerZoneThread(threadConfig);
-
   case SUSPEND_PHASE_JOURNAL:
     return getJournalZoneThread(threadConfig);
 
@@ -105,6 +103,25 @@ static void writeSuperBlock(VDO *vdo, VDOCompletion *completion)
   saveVDOComponentsAsync(vdo, completion);
 }
 
+/**
+ * Log how long the phase of a suspend which just finished took, and start
+ * timing the next one.
+ *
+ * @param vdo    The VDO being suspended
+ * @param phase  The phase about to start
+ **/
+static void timeSuspendPhase(VDO *vdo, SuspendPhase phase)
+{
+  uint64_t now = nowUsec();
+  if (phase == SUSPEND_PHASE_START) {
+    vdo->suspendStart = now;
+  } else {
+    logInfo("suspend phase '%s' took %" PRIu64 " us",
+            SUSPEND_PHASE_NAMES[phase - 1], now - vdo->suspendPhaseStart);
+  }
+  vdo->suspendPhaseStart = now;
+}
+
 /**
  * Callback to initiate a suspend, registered in performVDOSuspend().
  *
@@ -120,6 +137,7 @@ static void suspendCallback(VDOCompletion *completion)
   assertAdminPhaseThread(adminCompletion, __func__, SUSPEND_PHASE_NAMES);
 
   VDO *vdo = adminCompletion->completion.parent;
+  timeSuspendPhase(vdo, adminCompletion->phase);
   switch (adminCompletion->phase++) {
   case SUSPEND_PHASE_START:
     if (!startDraining(&vdo->adminState,
@@ -149,7 +167,7 @@ static void suspendCallback(VDOCompletion *completion)
       setCompletionResult(&adminCompletion->completion, VDO_READ_ONLY);
     }
 
-    drainPacker(vdo->packer, resetAdminSubTask(completion));
+    drainPackerZones(vdo->packerZones, resetAdminSubTask(completion));
     return;
 
   case SUSPEND_PHASE_LOGICAL_ZONES:
@@ -189,6 +207,7 @@ static void suspendCallback(VDOCompletion *completion)
     setCompletionResult(completion, UDS_BAD_STATE);
   }
 
+  logInfo("suspend took %" PRIu64 " us", nowUsec() - vdo->suspendStart);
   finishDrainingWithResult(&vdo->adminState, completion->result);
 }
 
@@ -182,3 +182,19 @@ void launchFlush(VIO *vio, VDOAction *callback, VDOAction *errorHandler)
 
   layer->flush(vio);
 }
+
+/**********************************************************************/
+void launchDiscard(VIO                 *vio,
+                   PhysicalBlockNumber  pbn,
+                   BlockCount           blockCount,
+                   VDOAction           *callback,
+                   VDOAction           *errorHandler)
+{
+  VDOCompletion *completion = vioAsCompletion(vio);
+  resetCompletion(completion);
+  completion->callback     = callback;
+  completion->errorHandler = errorHandler;
+  vio->operation           = VIO_WRITE;
+  vio->physical            = pbn;
+  completion->layer->discardBlocks(vio, blockCount);
+}
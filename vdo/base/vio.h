@@ -348,4 +348,20 @@ void launchWriteMetadataVIOWithFlush(VIO                 *vio,
  **/
 void launchFlush(VIO *vio, VDOAction *callback, VDOAction *errorHandler);
 
+/**
+ * Issue a discard of a run of unreferenced data blocks to the layer. The
+ * layer must support discards (its discardBlocks method must not be NULL).
+ *
+ * @param vio           The VIO to notify when the discard is complete
+ * @param pbn           The first block of the run
+ * @param blockCount    The number of blocks in the run
+ * @param callback      The function to call when the discard is complete
+ * @param errorHandler  The handler for discard errors
+ **/
+void launchDiscard(VIO                 *vio,
+                   PhysicalBlockNumber  pbn,
+                   BlockCount           blockCount,
+                   VDOAction           *callback,
+                   VDOAction           *errorHandler);
+
 #endif // VIO_H
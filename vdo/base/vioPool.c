@@ -23,18 +23,37 @@
 
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "numeric.h"
 #include "permassert.h"
+#include "timeUtils.h"
 
+#include "atomic.h"
 #include "constants.h"
 #include "vio.h"
 #include "types.h"
 
+enum {
+  /** The most times a pool may grow by its initial size */
+  MAX_VIO_POOL_GROWTHS    = 7,
+  /** The microseconds without an outage before a grown pool shrinks */
+  VIO_POOL_SHRINK_DELAY   = 1000000,
+};
+
 /**
- * An VIOPool is a collection of preallocated VIOs.
+ * An VIOPool is a collection of preallocated VIOs. A pool made with a
+ * maximum size larger than its initial size grows by its initial size
+ * whenever a request finds it empty, and gives the extra VIOs back once it
+ * is idle and has gone a while without running out.
  **/
 struct vioPool {
   /** The number of objects managed by the pool */
   size_t         size;
+  /** The number of objects the pool was made with */
+  size_t         initialSize;
+  /** The largest number of objects the pool may grow to */
+  size_t         maximumSize;
+  /** The number of objects the pool may grow to before it next shrinks */
+  size_t         sizeLimit;
   /** The list of objects which are available */
   RingNode       available;
   /** The queue of requestors waiting for objects from the pool */
@@ -45,14 +64,90 @@ struct vioPool {
   RingNode       busy;
   /** The number of requests when no object was available */
   uint64_t       outageCount;
+  /** The time of the last outage, in microseconds */
+  uint64_t       lastOutageTime;
+  /** The time requests started waiting, if any are waiting */
+  uint64_t       waitStartTime;
   /** The ID of the thread on which this pool may be used */
   ThreadID       threadID;
-  /** The buffer backing the pool's VIOs */
-  char          *buffer;
+  /** The layer the pool's VIOs operate in */
+  PhysicalLayer *layer;
+  /** The constructor for the pool's VIOs */
+  VIOConstructor *vioConstructor;
+  /** The context each entry has */
+  void          *context;
+  /** The number of requests which had to wait, for statistics */
+  Atomic64       waits;
+  /** The total microseconds requests were waiting, for statistics */
+  Atomic64       waitMicroseconds;
+  /** The number of objects, for statistics */
+  Atomic64       currentSize;
+  /** The buffers backing the pool's VIOs, one per growth */
+  char          *buffers[MAX_VIO_POOL_GROWTHS + 1];
   /** The pool entries */
   VIOPoolEntry   entries[];
 };
 
+/**
+ * Add entries to a pool, backed by a new buffer.
+ *
+ * @param pool   The pool
+ * @param count  The number of entries to add
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+static int addVIOPoolEntries(VIOPool *pool, size_t count)
+{
+  size_t growth = pool->size / pool->initialSize;
+  int result = ALLOCATE(count * VDO_BLOCK_SIZE, char, "VIO pool buffer",
+                        &pool->buffers[growth]);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  char *ptr = pool->buffers[growth];
+  for (size_t i = 0; i < count; i++) {
+    VIOPoolEntry *entry = &pool->entries[pool->size];
+    entry->buffer       = ptr;
+    entry->context      = pool->context;
+    result = pool->vioConstructor(pool->layer, entry, ptr, &entry->vio);
+    if (result != VDO_SUCCESS) {
+      return result;
+    }
+
+    ptr += VDO_BLOCK_SIZE;
+    initializeRing(&entry->node);
+    pushRingNode(&pool->available, &entry->node);
+    pool->size++;
+  }
+
+  relaxedStore64(&pool->currentSize, pool->size);
+  return VDO_SUCCESS;
+}
+
+/**
+ * Give the entries a pool grew by back, once none of them are in use.
+ *
+ * @param pool  The pool, which must have no busy entries
+ **/
+static void shrinkVIOPool(VIOPool *pool)
+{
+  for (size_t i = pool->initialSize; i < pool->size; i++) {
+    VIOPoolEntry *entry = &pool->entries[i];
+    unspliceRingNode(&entry->node);
+    freeVIO(&entry->vio);
+  }
+
+  for (size_t i = 1; i <= MAX_VIO_POOL_GROWTHS; i++) {
+    FREE(pool->buffers[i]);
+    pool->buffers[i] = NULL;
+  }
+
+  pool->size      = pool->initialSize;
+  pool->sizeLimit = pool->maximumSize;
+  relaxedStore64(&pool->currentSize, pool->size);
+}
+
 /**********************************************************************/
 int makeVIOPool(PhysicalLayer   *layer,
                 size_t           poolSize,
@@ -61,41 +156,52 @@ int makeVIOPool(PhysicalLayer   *layer,
                 void            *context,
                 VIOPool        **poolPtr)
 {
+  return makeGrowableVIOPool(layer, poolSize, poolSize, threadID,
+                             vioConstructor, context, poolPtr);
+}
+
+/**********************************************************************/
+int makeGrowableVIOPool(PhysicalLayer   *layer,
+                        size_t           poolSize,
+                        size_t           maximumSize,
+                        ThreadID         threadID,
+                        VIOConstructor  *vioConstructor,
+                        void            *context,
+                        VIOPool        **poolPtr)
+{
+  int result = ASSERT(((poolSize > 0) && (maximumSize >= poolSize)
+                       && (maximumSize
+                           <= (poolSize * (MAX_VIO_POOL_GROWTHS + 1)))),
+                      "VIO pool maximum size %zu is between %zu and %u times"
+                      " that", maximumSize, poolSize,
+                      MAX_VIO_POOL_GROWTHS + 1);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
   VIOPool *pool;
-  int result = ALLOCATE_EXTENDED(VIOPool, poolSize, VIOPoolEntry, __func__,
-                                 &pool);
+  result = ALLOCATE_EXTENDED(VIOPool, maximumSize, VIOPoolEntry, __func__,
+                             &pool);
   if (result != VDO_SUCCESS) {
     return result;
   }
 
-  pool->threadID = threadID;
+  pool->initialSize    = poolSize;
+  pool->maximumSize    = maximumSize;
+  pool->sizeLimit      = maximumSize;
+  pool->threadID       = threadID;
+  pool->layer          = layer;
+  pool->vioConstructor = vioConstructor;
+  pool->context        = context;
   initializeRing(&pool->available);
   initializeRing(&pool->busy);
 
-  result = ALLOCATE(poolSize * VDO_BLOCK_SIZE, char, "VIO pool buffer",
-                    &pool->buffer);
+  result = addVIOPoolEntries(pool, poolSize);
   if (result != VDO_SUCCESS) {
     freeVIOPool(&pool);
     return result;
   }
 
-  char *ptr = pool->buffer;
-  for (size_t i = 0; i < poolSize; i++) {
-    VIOPoolEntry *entry = &pool->entries[i];
-    entry->buffer       = ptr;
-    entry->context      = context;
-    result = vioConstructor(layer, entry, ptr, &entry->vio);
-    if (result != VDO_SUCCESS) {
-      freeVIOPool(&pool);
-      return result;
-    }
-
-    ptr += VDO_BLOCK_SIZE;
-    initializeRing(&entry->node);
-    pushRingNode(&pool->available, &entry->node);
-    pool->size++;
-  }
-
   *poolPtr = pool;
   return VDO_SUCCESS;
 }
@@ -132,7 +238,9 @@ void freeVIOPool(VIOPool **poolPtr)
                     entry->vio->operation);
   }
 
-  FREE(pool->buffer);
+  for (size_t i = 0; i <= MAX_VIO_POOL_GROWTHS; i++) {
+    FREE(pool->buffers[i]);
+  }
   FREE(pool);
   *poolPtr = NULL;
 }
@@ -151,6 +259,25 @@ int acquireVIOFromPool(VIOPool *pool, Waiter *waiter)
 
   if (isRingEmpty(&pool->available)) {
     pool->outageCount++;
+    pool->lastOutageTime = nowUsec();
+    if (pool->size < pool->sizeLimit) {
+      size_t count = minSizeT(pool->initialSize,
+                              pool->sizeLimit - pool->size);
+      int result = addVIOPoolEntries(pool, count);
+      if (result != VDO_SUCCESS) {
+        // Growing is an optimization; the request can wait instead, and the
+        // pool stays at this size until it shrinks.
+        logWarningWithStringError(result, "failed to grow VIO pool");
+        pool->sizeLimit = pool->size;
+      }
+    }
+  }
+
+  if (isRingEmpty(&pool->available)) {
+    relaxedAdd64(&pool->waits, 1);
+    if (!hasWaiters(&pool->waiting)) {
+      pool->waitStartTime = pool->lastOutageTime;
+    }
     return enqueueWaiter(&pool->waiting, waiter);
   }
 
@@ -169,11 +296,22 @@ void returnVIOToPool(VIOPool *pool, VIOPoolEntry *entry)
   entry->vio->completion.errorHandler = NULL;
   if (hasWaiters(&pool->waiting)) {
     notifyNextWaiter(&pool->waiting, NULL, entry);
+    if (!hasWaiters(&pool->waiting)) {
+      relaxedAdd64(&pool->waitMicroseconds, nowUsec() - pool->waitStartTime);
+    }
     return;
   }
 
   pushRingNode(&pool->available, &entry->node);
   --pool->busyCount;
+
+  // The VIO being returned may still be running its own callback, so the
+  // pool only shrinks when that VIO is one of the ones it keeps.
+  if ((pool->busyCount == 0) && (pool->size > pool->initialSize)
+      && ((size_t) (entry - pool->entries) < pool->initialSize)
+      && ((nowUsec() - pool->lastOutageTime) > VIO_POOL_SHRINK_DELAY)) {
+    shrinkVIOPool(pool);
+  }
 }
 
 /**********************************************************************/
@@ -181,3 +319,13 @@ uint64_t getVIOPoolOutageCount(VIOPool *pool)
 {
   return pool->outageCount;
 }
+
+/**********************************************************************/
+VIOPoolStatistics getVIOPoolStatistics(const VIOPool *pool)
+{
+  return (VIOPoolStatistics) {
+    .waits            = relaxedLoad64(&pool->waits),
+    .waitMicroseconds = relaxedLoad64(&pool->waitMicroseconds),
+    .size             = relaxedLoad64(&pool->currentSize),
+  };
+}
@@ -44,6 +44,18 @@ typedef struct {
   void     *context;
 } VIOPoolEntry;
 
+/**
+ * The statistics of a VIOPool.
+ **/
+typedef struct {
+  /** The number of requests which had to wait for a VIO */
+  uint64_t waits;
+  /** The total microseconds the pool had requests waiting */
+  uint64_t waitMicroseconds;
+  /** The number of VIOs in the pool */
+  uint64_t size;
+} VIOPoolStatistics;
+
 /**
  * A function which constructs a VIO for a pool.
  *
@@ -77,6 +89,31 @@ int makeVIOPool(PhysicalLayer   *layer,
                 VIOPool        **poolPtr)
   __attribute__((warn_unused_result));
 
+/**
+ * Create a new VIO pool which grows, by its initial size at a time, when a
+ * request finds it empty, and shrinks back to its initial size once it is
+ * idle and has not run out for a while.
+ *
+ * @param [in]  layer           the physical layer to write to and read from
+ * @param [in]  poolSize        the number of VIOs the pool starts with
+ * @param [in]  maximumSize     the most VIOs the pool may grow to, at most
+ *                              eight times poolSize
+ * @param [in]  threadID        the ID of the thread using this pool
+ * @param [in]  vioConstructor  the constructor for VIOs in the pool
+ * @param [in]  context         the context that each entry will have
+ * @param [out] poolPtr         the resulting pool
+ *
+ * @return a success or error code
+ **/
+int makeGrowableVIOPool(PhysicalLayer   *layer,
+                        size_t           poolSize,
+                        size_t           maximumSize,
+                        ThreadID         threadID,
+                        VIOConstructor  *vioConstructor,
+                        void            *context,
+                        VIOPool        **poolPtr)
+  __attribute__((warn_unused_result));
+
 /**
  * Destroy a VIO pool
  *
@@ -133,4 +170,14 @@ static inline VIOPoolEntry *asVIOPoolEntry(RingNode *node)
 uint64_t getVIOPoolOutageCount(VIOPool *pool)
   __attribute__((warn_unused_result));
 
+/**
+ * Get the statistics of a VIO pool. This may be called from any thread.
+ *
+ * @param pool  The pool
+ *
+ * @return The statistics of the pool
+ **/
+VIOPoolStatistics getVIOPoolStatistics(const VIOPool *pool)
+  __attribute__((warn_unused_result));
+
 #endif // VIO_POOL_H
@@ -76,7 +76,7 @@ static void readBlock(VDOCompletion *completion)
   }
 
   vio->physical = dataVIO->mapped.pbn;
-  dataVIO->lastAsyncOperation = READ_DATA;
+  setDataVIOOperation(dataVIO, READ_DATA);
   completion->layer->readData(dataVIO);
 }
 
@@ -96,7 +96,7 @@ static void readBlockMapping(VDOCompletion *completion)
   DataVIO *dataVIO = asDataVIO(completion);
   assertInLogicalZone(dataVIO);
   setLogicalCallback(dataVIO, readBlock, THIS_LOCATION("$F;cb=readBlock"));
-  dataVIO->lastAsyncOperation = GET_MAPPED_BLOCK;
+  setDataVIOOperation(dataVIO, GET_MAPPED_BLOCK);
   getMappedBlockAsync(dataVIO);
 }
 
@@ -104,7 +104,7 @@ static void readBlockMapping(VDOCompletion *completion)
 void launchReadDataVIO(DataVIO *dataVIO)
 {
   assertInLogicalZone(dataVIO);
-  dataVIO->lastAsyncOperation = FIND_BLOCK_MAP_SLOT;
+  setDataVIOOperation(dataVIO, FIND_BLOCK_MAP_SLOT);
   // Go find the block map slot for the LBN mapping.
   findBlockMapSlotAsync(dataVIO, readBlockMapping,
                         getLogicalZoneThreadID(dataVIO->logical.zone));
@@ -181,6 +181,15 @@
  *     finishVIO()
  *   }
  * }
+ *
+ * Each DataVIO covers exactly one logical block, even in a large sequential
+ * write: the LBN lock, the hash lock, and the pair of recovery journal
+ * entries are made per block because deduplication, compression, and
+ * recovery all operate on single blocks. The per-block cost of a streaming
+ * write is instead amortized where DataVIOs meet in shared queues; the
+ * layer hashes and compresses blocks in batches, the recovery journal
+ * commits many entries per block write, and the kernel layer coalesces
+ * the data writes of adjacent blocks into single bios.
  */
 
 #include "vioWrite.h"
@@ -193,6 +202,7 @@
 #include "compressionState.h"
 #include "dataVIO.h"
 #include "hashLock.h"
+#include "physicalZone.h"
 #include "recoveryJournal.h"
 #include "referenceOperation.h"
 #include "slab.h"
@@ -481,7 +491,7 @@ static void updateBlockMapForDedupe(VDOCompletion *completion)
   } else {
     completion->callback = completeDataVIO;
   }
-  dataVIO->lastAsyncOperation = PUT_MAPPED_BLOCK_FOR_DEDUPE;
+  setDataVIOOperation(dataVIO, PUT_MAPPED_BLOCK_FOR_DEDUPE);
   putMappedBlockAsync(dataVIO);
 }
 
@@ -559,7 +569,7 @@ static void decrementForDedupe(VDOCompletion *completion)
 
   setLogicalCallback(dataVIO, updateBlockMapForDedupe,
                      THIS_LOCATION("$F;js=dec"));
-  dataVIO->lastAsyncOperation = JOURNAL_DECREMENT_FOR_DEDUPE;
+  setDataVIOOperation(dataVIO, JOURNAL_DECREMENT_FOR_DEDUPE);
   updateReferenceCount(dataVIO);
 }
 
@@ -585,7 +595,7 @@ static void journalUnmappingForDedupe(VDOCompletion *completion)
     setMappedZoneCallback(dataVIO, decrementForDedupe,
                           THIS_LOCATION("$F;j=dedupe;js=unmap;cb=decDedupe"));
   }
-  dataVIO->lastAsyncOperation = JOURNAL_UNMAPPING_FOR_DEDUPE;
+  setDataVIOOperation(dataVIO, JOURNAL_UNMAPPING_FOR_DEDUPE);
   journalDecrement(dataVIO);
 }
 
@@ -605,7 +615,7 @@ static void readOldBlockMappingForDedupe(VDOCompletion *completion)
     return;
   }
 
-  dataVIO->lastAsyncOperation = GET_MAPPED_BLOCK_FOR_DEDUPE;
+  setDataVIOOperation(dataVIO, GET_MAPPED_BLOCK_FOR_DEDUPE);
   setJournalCallback(dataVIO, journalUnmappingForDedupe,
                      THIS_LOCATION("$F;cb=journalUnmapDedupe"));
   getMappedBlockAsync(dataVIO);
@@ -642,7 +652,7 @@ static void incrementForCompression(VDOCompletion *completion)
     setJournalCallback(dataVIO, journalUnmappingForDedupe,
                        THIS_LOCATION("$F;cb=journalUnmappingForDedupe"));
   }
-  dataVIO->lastAsyncOperation = JOURNAL_INCREMENT_FOR_COMPRESSION;
+  setDataVIOOperation(dataVIO, JOURNAL_INCREMENT_FOR_COMPRESSION);
   updateReferenceCount(dataVIO);
 }
 
@@ -667,7 +677,7 @@ static void addRecoveryJournalEntryForCompression(VDOCompletion *completion)
   setNewMappedZoneCallback(dataVIO, incrementForCompression,
                            THIS_LOCATION("$F($dup);js=map/$dup;"
                                          "cb=incCompress($dup)"));
-  dataVIO->lastAsyncOperation = JOURNAL_MAPPING_FOR_COMPRESSION;
+  setDataVIOOperation(dataVIO, JOURNAL_MAPPING_FOR_COMPRESSION);
   journalIncrement(dataVIO, getDuplicateLock(dataVIO));
 }
 
@@ -692,7 +702,7 @@ static void packCompressedData(VDOCompletion *completion)
 
   setJournalCallback(dataVIO, addRecoveryJournalEntryForCompression,
                      THIS_LOCATION("$F;cb=update(compress)"));
-  dataVIO->lastAsyncOperation = PACK_COMPRESSED_BLOCK;
+  setDataVIOOperation(dataVIO, PACK_COMPRESSED_BLOCK);
   attemptPacking(dataVIO);
 }
 
@@ -706,7 +716,7 @@ void compressData(DataVIO *dataVIO)
     return;
   }
 
-  dataVIO->lastAsyncOperation = COMPRESS_DATA;
+  setDataVIOOperation(dataVIO, COMPRESS_DATA);
   setPackerCallback(dataVIO, packCompressedData, THIS_LOCATION("$F;cb=pack"));
   dataVIOAsCompletion(dataVIO)->layer->compressDataVIO(dataVIO);
 }
@@ -742,7 +752,7 @@ static void incrementForDedupe(VDOCompletion *completion)
     setJournalCallback(dataVIO, journalUnmappingForDedupe,
                        THIS_LOCATION("$F;cb=journalUnmappingForDedupe"));
   }
-  dataVIO->lastAsyncOperation = JOURNAL_INCREMENT_FOR_DEDUPE;
+  setDataVIOOperation(dataVIO, JOURNAL_INCREMENT_FOR_DEDUPE);
   updateReferenceCount(dataVIO);
 }
 
@@ -763,7 +773,7 @@ static void addRecoveryJournalEntryForDedupe(VDOCompletion *completion)
   setNewMappedZoneCallback(dataVIO, incrementForDedupe,
                            THIS_LOCATION("$F($dup);js=map/$dup;"
                                          "cb=incDedupe($dup)"));
-  dataVIO->lastAsyncOperation = JOURNAL_MAPPING_FOR_DEDUPE;
+  setDataVIOOperation(dataVIO, JOURNAL_MAPPING_FOR_DEDUPE);
   journalIncrement(dataVIO, getDuplicateLock(dataVIO));
 }
 
@@ -844,7 +854,7 @@ static void resolveHashZone(VDOCompletion *completion)
 
   dataVIO->hashZone
     = selectHashZone(getVDOFromDataVIO(dataVIO), &dataVIO->chunkName);
-  dataVIO->lastAsyncOperation = ACQUIRE_HASH_LOCK;
+  setDataVIOOperation(dataVIO, ACQUIRE_HASH_LOCK);
   launchHashZoneCallback(dataVIO, lockHashInZone, THIS_LOCATION(NULL));
 }
 
@@ -874,9 +884,15 @@ static void prepareForDedupe(VDOCompletion *completion)
   ASSERT_LOG_ONLY(!dataVIO->isZeroBlock,
                   "must not prepare to dedupe zero blocks");
 
+  if ((dataVIO->policy & LBN_POLICY_DEFAULT) == 0) {
+    // Neither dedupe nor compression is allowed, so don't bother hashing.
+    abortDeduplication(dataVIO);
+    return;
+  }
+
   // Before we can dedupe, we need to know the chunk name, so the first step
   // is to hash the block data.
-  dataVIO->lastAsyncOperation = HASH_DATA;
+  setDataVIOOperation(dataVIO, HASH_DATA);
   // XXX this is the wrong thread to run this callback, but we don't yet have
   // a mechanism for running it on the CPU thread immediately after hashing.
   setAllocatedZoneCallback(dataVIO, resolveHashZone, THIS_LOCATION(NULL));
@@ -914,7 +930,7 @@ static void updateBlockMapForWrite(VDOCompletion *completion)
     completion->callback = completeDataVIO;
   }
 
-  dataVIO->lastAsyncOperation = PUT_MAPPED_BLOCK;
+  setDataVIOOperation(dataVIO, PUT_MAPPED_BLOCK);
   putMappedBlockAsync(dataVIO);
 }
 
@@ -932,8 +948,14 @@ static void decrementForWrite(VDOCompletion *completion)
     return;
   }
 
-  dataVIO->lastAsyncOperation = JOURNAL_DECREMENT_FOR_WRITE;
+  setDataVIOOperation(dataVIO, JOURNAL_DECREMENT_FOR_WRITE);
   setLogicalCallback(dataVIO, updateBlockMapForWrite, THIS_LOCATION(NULL));
+  if (deferDecrement(dataVIO->mapped.zone, dataVIO)) {
+    // The write no longer depends on the decrement, so don't wait for it.
+    continueDataVIO(dataVIO, VDO_SUCCESS);
+    return;
+  }
+
   updateReferenceCount(dataVIO);
 }
 
@@ -958,7 +980,7 @@ static void journalUnmappingForWrite(VDOCompletion *completion)
     setMappedZoneCallback(dataVIO, decrementForWrite,
                           THIS_LOCATION("$F;js=unmap;cb=decWrite"));
   }
-  dataVIO->lastAsyncOperation = JOURNAL_UNMAPPING_FOR_WRITE;
+  setDataVIOOperation(dataVIO, JOURNAL_UNMAPPING_FOR_WRITE);
   journalDecrement(dataVIO);
 }
 
@@ -980,7 +1002,7 @@ static void readOldBlockMappingForWrite(VDOCompletion *completion)
 
   setJournalCallback(dataVIO, journalUnmappingForWrite,
                      THIS_LOCATION("$F;cb=journalUnmapWrite"));
-  dataVIO->lastAsyncOperation = GET_MAPPED_BLOCK_FOR_WRITE;
+  setDataVIOOperation(dataVIO, GET_MAPPED_BLOCK_FOR_WRITE);
   getMappedBlockAsync(dataVIO);
 }
 
@@ -993,7 +1015,7 @@ static void acknowledgeWrite(DataVIO *dataVIO)
 {
   ASSERT_LOG_ONLY(dataVIO->hasFlushGenerationLock,
                   "write VIO to be acknowledged has a flush generation lock");
-  dataVIO->lastAsyncOperation = ACKNOWLEDGE_WRITE;
+  setDataVIOOperation(dataVIO, ACKNOWLEDGE_WRITE);
   dataVIOAsCompletion(dataVIO)->layer->acknowledgeDataVIO(dataVIO);
 }
 
@@ -1044,7 +1066,7 @@ static void incrementForWrite(VDOCompletion *completion)
    */
   downgradePBNWriteLock(dataVIOAsAllocatingVIO(dataVIO)->allocationLock);
 
-  dataVIO->lastAsyncOperation = JOURNAL_INCREMENT_FOR_WRITE;
+  setDataVIOOperation(dataVIO, JOURNAL_INCREMENT_FOR_WRITE);
   setLogicalCallback(dataVIO, getWriteIncrementCallback(dataVIO),
                      THIS_LOCATION(NULL));
   updateReferenceCount(dataVIO);
@@ -1072,7 +1094,7 @@ static void finishBlockWrite(VDOCompletion *completion)
     setAllocatedZoneCallback(dataVIO, incrementForWrite,
                              THIS_LOCATION("$F;js=mapWrite"));
   }
-  dataVIO->lastAsyncOperation = JOURNAL_MAPPING_FOR_WRITE;
+  setDataVIOOperation(dataVIO, JOURNAL_MAPPING_FOR_WRITE);
   journalIncrement(dataVIO, dataVIOAsAllocatingVIO(dataVIO)->allocationLock);
 }
 
@@ -1083,7 +1105,7 @@ static void finishBlockWrite(VDOCompletion *completion)
  **/
 static void writeBlock(DataVIO *dataVIO)
 {
-  dataVIO->lastAsyncOperation = WRITE_DATA;
+  setDataVIOOperation(dataVIO, WRITE_DATA);
   setJournalCallback(dataVIO, finishBlockWrite,
                      THIS_LOCATION("$F(data);cb=finishWrite"));
   dataVIOAsCompletion(dataVIO)->layer->writeData(dataVIO);
@@ -1133,6 +1155,33 @@ static void continueWriteAfterAllocation(AllocatingVIO *allocatingVIO)
   acknowledgeWrite(dataVIO);
 }
 
+/**
+ * Continue a trim now that the current mapping of its LBN is known. A trim of
+ * a block which is already unmapped has nothing to journal, decrement, or
+ * update, so it finishes immediately; this makes a repeated trim of a range
+ * cost a block map lookup per block rather than a trip through the journal.
+ * This callback is registered in continueWriteWithBlockMapSlot().
+ *
+ * @param completion  The DataVIO doing the trim
+ **/
+static void continueTrimWithOldMapping(VDOCompletion *completion)
+{
+  DataVIO *dataVIO = asDataVIO(completion);
+  assertInLogicalZone(dataVIO);
+  if (abortOnError(completion->result, dataVIO, READ_ONLY)) {
+    return;
+  }
+
+  if (dataVIO->mapped.state == MAPPING_STATE_UNMAPPED) {
+    finishDataVIO(dataVIO, VDO_SUCCESS);
+    return;
+  }
+
+  dataVIO->newMapped.pbn = ZERO_BLOCK;
+  launchJournalCallback(dataVIO, finishBlockWrite,
+                        THIS_LOCATION("$F;cb=finishWrite"));
+}
+
 /**
  * Continue the write path for a VIO now that block map slot resolution is
  * complete. This callback is registered in launchWriteDataVIO().
@@ -1160,7 +1209,15 @@ static void continueWriteWithBlockMapSlot(VDOCompletion *completion)
     return;
   }
 
-  if (dataVIO->isZeroBlock || isTrimDataVIO(dataVIO)) {
+  if (isTrimDataVIO(dataVIO)) {
+    setLogicalCallback(dataVIO, continueTrimWithOldMapping,
+                       THIS_LOCATION("$F;cb=continueTrim"));
+    setDataVIOOperation(dataVIO, GET_MAPPED_BLOCK_FOR_WRITE);
+    getMappedBlockAsync(dataVIO);
+    return;
+  }
+
+  if (dataVIO->isZeroBlock) {
     // We don't need to write any data, so skip allocation and just update
     // the block map and reference counts (via the journal).
     dataVIO->newMapped.pbn = ZERO_BLOCK;
@@ -1169,6 +1226,7 @@ static void continueWriteWithBlockMapSlot(VDOCompletion *completion)
     return;
   }
 
+  setDataVIOOperation(dataVIO, ALLOCATE_DATA_BLOCK);
   allocateDataBlock(dataVIOAsAllocatingVIO(dataVIO),
                     getAllocationSelector(dataVIO->logical.zone),
                     VIO_WRITE_LOCK, continueWriteAfterAllocation);
@@ -1182,6 +1240,15 @@ void launchWriteDataVIO(DataVIO *dataVIO)
     return;
   }
 
+  // The policy is looked up now, while on the thread of the logical zone.
+  dataVIO->policy = getLogicalZonePolicy(dataVIO->logical.zone,
+                                         dataVIO->logical.lbn);
+  if (!dataVIO->isZeroBlock && !isTrimDataVIO(dataVIO)) {
+    dataVIO->policy = applyHotBlockPolicy(dataVIO->logical.zone,
+                                          dataVIO->logical.lbn,
+                                          dataVIO->policy);
+  }
+
   // Write requests join the current flush generation.
   int result = acquireFlushGenerationLock(dataVIO);
   if (abortOnError(result, dataVIO, NOT_READ_ONLY)) {
@@ -1189,7 +1256,7 @@ void launchWriteDataVIO(DataVIO *dataVIO)
   }
 
   // Go find the block map slot for the LBN mapping.
-  dataVIO->lastAsyncOperation = FIND_BLOCK_MAP_SLOT;
+  setDataVIOOperation(dataVIO, FIND_BLOCK_MAP_SLOT);
   findBlockMapSlotAsync(dataVIO, continueWriteWithBlockMapSlot,
                         getLogicalZoneThreadID(dataVIO->logical.zone));
 }
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/backgroundBudget.c#1 $
+ */
+
+#include "backgroundBudget.h"
+
+#include "numeric.h"
+#include "timeUtils.h"
+
+enum {
+  /** How often the foreground load is sampled */
+  LOAD_SAMPLE_INTERVAL_NS = 100 * 1000 * 1000,
+  /** The percentage of the idle rate still granted at full load */
+  MINIMUM_GRANT_PERCENT   = 10,
+  /** The weight of the history in the smoothed load, in quarters */
+  LOAD_HISTORY_QUARTERS   = 3,
+};
+
+/**********************************************************************/
+void setBackgroundIdleRate(BackgroundBudget *budget, uint32_t idleRate)
+{
+  WRITE_ONCE(budget->grantedRate, idleRate);
+  WRITE_ONCE(budget->idleRate, idleRate);
+}
+
+/**
+ * Blend a new sample into a smoothed value.
+ *
+ * @param average  The smoothed value
+ * @param sample   The new sample
+ *
+ * @return The new smoothed value
+ **/
+static uint32_t smooth(uint32_t average, uint64_t sample)
+{
+  return (((uint64_t) average * LOAD_HISTORY_QUARTERS)
+          + minUInt64(sample, UINT32_MAX)) / (LOAD_HISTORY_QUARTERS + 1);
+}
+
+/**********************************************************************/
+bool sampleForegroundLoad(BackgroundBudget *budget,
+                          uint64_t          requests,
+                          unsigned int      occupancy,
+                          uint32_t         *ratePtr)
+{
+  uint64_t now     = currentTime(CLOCK_MONOTONIC);
+  uint64_t elapsed = now - budget->lastSampleTime;
+  if (elapsed < LOAD_SAMPLE_INTERVAL_NS) {
+    return false;
+  }
+
+  uint64_t iops = (((requests - budget->lastRequests) * NSEC_PER_SEC)
+                   / elapsed);
+  budget->lastRequests   = requests;
+  budget->lastSampleTime = now;
+  WRITE_ONCE(budget->foregroundIOPS, smooth(budget->foregroundIOPS, iops));
+
+  // The device is as loaded as whichever measure says it is busier.
+  uint64_t load     = occupancy;
+  uint32_t busyIOPS = READ_ONCE(budget->busyIOPS);
+  if ((busyIOPS > 0) && (((iops * 100) / busyIOPS) > load)) {
+    load = (iops * 100) / busyIOPS;
+  }
+  uint32_t loadPercent = smooth(budget->loadPercent, minUInt64(load, 100));
+  WRITE_ONCE(budget->loadPercent, loadPercent);
+
+  uint32_t idleRate     = READ_ONCE(budget->idleRate);
+  uint32_t grantPercent = (100 - ((loadPercent * (100 - MINIMUM_GRANT_PERCENT))
+                                  / 100));
+  uint32_t rate = maxUInt(1, ((uint64_t) idleRate * grantPercent) / 100);
+  WRITE_ONCE(budget->grantedRate, rate);
+  *ratePtr = rate;
+  return true;
+}
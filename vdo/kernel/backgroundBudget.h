@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/backgroundBudget.h#1 $
+ */
+
+#ifndef BACKGROUND_BUDGET_H
+#define BACKGROUND_BUDGET_H
+
+#include <linux/compiler.h>
+
+#include "types.h"
+
+/**
+ * A BackgroundBudget grants background work a share of the device which
+ * shrinks as the foreground load grows. The load is sampled periodically,
+ * both as the rate of incoming requests and as the fraction of the request
+ * limit in use, and smoothed. When the device is idle, background work gets
+ * its full idle rate; at full load it gets a tenth of it, so that it still
+ * makes progress.
+ *
+ * The budget is only managed once an idle rate has been set. Other than the
+ * two settings, the fields are only updated by the thread which samples the
+ * load.
+ **/
+typedef struct backgroundBudget {
+  /** The metadata blocks per second granted when idle, or 0 if unmanaged */
+  uint32_t idleRate;
+  /** The requests per second counted as a full load, or 0 to use only the
+   *  request limit */
+  uint32_t busyIOPS;
+  /** The smoothed foreground requests per second */
+  uint32_t foregroundIOPS;
+  /** The smoothed foreground load, as a percentage of a full load */
+  uint32_t loadPercent;
+  /** The metadata blocks per second currently granted */
+  uint32_t grantedRate;
+  /** The number of foreground requests at the last sample */
+  uint64_t lastRequests;
+  /** The time of the last sample, in nanoseconds */
+  uint64_t lastSampleTime;
+} BackgroundBudget;
+
+/**
+ * Set the rate granted to background work when the device is idle, starting
+ * or stopping the management of the budget.
+ *
+ * @param budget    The budget
+ * @param idleRate  The idle rate in metadata blocks per second, or 0 to stop
+ *                  managing the budget
+ **/
+void setBackgroundIdleRate(BackgroundBudget *budget, uint32_t idleRate);
+
+/**
+ * Check whether a budget is being managed.
+ *
+ * @param budget  The budget
+ *
+ * @return <code>true</code> if an idle rate has been set
+ **/
+static inline bool isBackgroundBudgetManaged(const BackgroundBudget *budget)
+{
+  return (READ_ONCE(budget->idleRate) > 0);
+}
+
+/**
+ * Sample the foreground load if a sampling interval has passed since the
+ * last sample, and recompute the budget from it.
+ *
+ * @param [in]  budget     The budget
+ * @param [in]  requests   The number of foreground requests received so far
+ * @param [in]  occupancy  The percentage of the request limit now in use
+ * @param [out] ratePtr    A pointer to hold the newly granted rate
+ *
+ * @return <code>true</code> if the budget was recomputed
+ **/
+bool sampleForegroundLoad(BackgroundBudget *budget,
+                          uint64_t          requests,
+                          unsigned int      occupancy,
+                          uint32_t         *ratePtr)
+  __attribute__((warn_unused_result));
+
+#endif // BACKGROUND_BUDGET_H
@@ -21,6 +21,8 @@
 
 #include "batchProcessor.h"
 
+#include <linux/delay.h>
+
 #include "memoryAlloc.h"
 
 #include "constants.h"
@@ -70,23 +72,44 @@ typedef enum batchProcessorState {
   BATCH_PROCESSOR_ENQUEUED,
 } BatchProcessorState;
 
+enum {
+  /** The most items taken from the funnel queue at once */
+  BATCH_POLL_SIZE = 32,
+};
+
 struct batchProcessor {
   spinlock_t              consumerLock;
   FunnelQueue            *queue;
+  // Items taken from the queue but not yet returned by nextBatchItem()
+  FunnelQueueEntry       *pending;
   KvdoWorkItem            workItem;
   atomic_t                state;
   BatchProcessorCallback  callback;
   void                   *closure;
   KernelLayer            *layer;
+  KvdoWorkQueue          *workQueue;
 };
 
 static void scheduleBatchProcessing(BatchProcessor *batch);
 
+/**
+ * Check whether a batch processor has items waiting to be processed. Must be
+ * called with the consumer lock held.
+ *
+ * @param batch  The batch processor
+ *
+ * @return <code>true</code> if there are items to process
+ **/
+static bool hasBatchItems(BatchProcessor *batch)
+{
+  return ((batch->pending != NULL) || !isFunnelQueueEmpty(batch->queue));
+}
+
 /**
  * Apply the batch processing function to the accumulated set of
  * objects.
  *
- * Runs in a "CPU queue".
+ * Runs in a "CPU queue", or the queue the processor was made for.
  *
  * @param [in]  item  The work item embedded in the BatchProcessor
  **/
@@ -94,12 +117,12 @@ static void batchProcessorWork(KvdoWorkItem *item)
 {
   BatchProcessor *batch = container_of(item, BatchProcessor, workItem);
   spin_lock(&batch->consumerLock);
-  while (!isFunnelQueueEmpty(batch->queue)) {
+  while (hasBatchItems(batch)) {
     batch->callback(batch, batch->closure);
   }
   atomic_set(&batch->state, BATCH_PROCESSOR_IDLE);
   memoryFence();
-  bool needReschedule = !isFunnelQueueEmpty(batch->queue);
+  bool needReschedule = hasBatchItems(batch);
   spin_unlock(&batch->consumerLock);
   if (needReschedule) {
     scheduleBatchProcessing(batch);
@@ -144,8 +167,14 @@ static void scheduleBatchProcessing(BatchProcessor *batch)
     = atomic_cmpxchg(&batch->state, BATCH_PROCESSOR_IDLE,
                      BATCH_PROCESSOR_ENQUEUED);
   bool doSchedule = (oldState == BATCH_PROCESSOR_IDLE);
-  if (doSchedule) {
+  if (!doSchedule) {
+    return;
+  }
+
+  if (batch->workQueue == NULL) {
     enqueueCPUWorkQueue(batch->layer, &batch->workItem);
+  } else {
+    enqueueWorkQueue(batch->workQueue, &batch->workItem);
   }
 }
 
@@ -154,6 +183,19 @@ int makeBatchProcessor(KernelLayer             *layer,
                        BatchProcessorCallback   callback,
                        void                    *closure,
                        BatchProcessor         **batchPtr)
+{
+  // The CPU queue may not exist yet, so it is looked up when scheduling.
+  return makeBatchProcessorOnQueue(layer, NULL, CPU_Q_ACTION_COMPLETE_KVIO,
+                                   callback, closure, batchPtr);
+}
+
+/**********************************************************************/
+int makeBatchProcessorOnQueue(KernelLayer             *layer,
+                              KvdoWorkQueue           *queue,
+                              unsigned int             action,
+                              BatchProcessorCallback   callback,
+                              void                    *closure,
+                              BatchProcessor         **batchPtr)
 {
   BatchProcessor *batch;
 
@@ -169,11 +211,12 @@ int makeBatchProcessor(KernelLayer             *layer,
 
   spin_lock_init(&batch->consumerLock);
   setupWorkItem(&batch->workItem, batchProcessorWork,
-                (KvdoWorkFunction) callback, CPU_Q_ACTION_COMPLETE_KVIO);
+                (KvdoWorkFunction) callback, action);
   atomic_set(&batch->state, BATCH_PROCESSOR_IDLE);
-  batch->callback = callback;
-  batch->closure  = closure;
-  batch->layer    = layer;
+  batch->callback  = callback;
+  batch->closure   = closure;
+  batch->layer     = layer;
+  batch->workQueue = queue;
 
   *batchPtr = batch;
   return UDS_SUCCESS;
@@ -189,14 +232,31 @@ void addToBatchProcessor(BatchProcessor *batch, KvdoWorkItem *item)
 /**********************************************************************/
 KvdoWorkItem *nextBatchItem(BatchProcessor *batch)
 {
-  FunnelQueueEntry *fqEntry = funnelQueuePoll(batch->queue);
+  FunnelQueueEntry *fqEntry = batch->pending;
   if (fqEntry == NULL) {
-    return NULL;
+    fqEntry = funnelQueuePollBatch(batch->queue, BATCH_POLL_SIZE, NULL);
+    if (fqEntry == NULL) {
+      return NULL;
+    }
   }
+  batch->pending = fqEntry->next;
+  fqEntry->next  = NULL;
 
   return container_of(fqEntry, KvdoWorkItem, workQueueEntryLink);
 }
 
+/**********************************************************************/
+void waitForBatchProcessorIdle(BatchProcessor *batch)
+{
+  while (atomic_read(&batch->state) == BATCH_PROCESSOR_ENQUEUED) {
+    msleep(1);
+  }
+  // The processor is marked idle with the consumer lock held, so once the
+  // lock is free, the last run of the batch has finished with it.
+  spin_lock(&batch->consumerLock);
+  spin_unlock(&batch->consumerLock);
+}
+
 /**********************************************************************/
 void condReschedBatchProcessor(BatchProcessor *batch)
 {
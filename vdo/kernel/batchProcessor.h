@@ -61,6 +61,26 @@ int makeBatchProcessor(KernelLayer             *layer,
                        void                    *closure,
                        BatchProcessor         **batchPtr);
 
+/**
+ * Creates a batch-processor control structure whose work function runs on
+ * a specified work queue rather than in one of the "CPU queues".
+ *
+ * @param [in]  layer     The kernel layer data
+ * @param [in]  queue     The work queue on which to run the callback
+ * @param [in]  action    The action code with which to enqueue the callback
+ * @param [in]  callback  A function to process the accumulated objects
+ * @param [in]  closure   A private data pointer for use by the callback
+ * @param [out] batchPtr  Where to store the pointer to the new object
+ *
+ * @return   UDS_SUCCESS or an error code
+ **/
+int makeBatchProcessorOnQueue(KernelLayer             *layer,
+                              KvdoWorkQueue           *queue,
+                              unsigned int             action,
+                              BatchProcessorCallback   callback,
+                              void                    *closure,
+                              BatchProcessor         **batchPtr);
+
 /**
  * Adds an object to the processing queue.
  *
@@ -89,6 +109,15 @@ KvdoWorkItem *nextBatchItem(BatchProcessor *batch)
  **/
 void freeBatchProcessor(BatchProcessor **batchPtr);
 
+/**
+ * Wait until no thread is running or about to run the batch-processing
+ * function. No items may be added to the batch while waiting. This is needed
+ * before freeing a batch processor on a work queue which outlives it.
+ *
+ * @param [in]  batch  The batch-processor data
+ **/
+void waitForBatchProcessorIdle(BatchProcessor *batch);
+
 /**
  * Yield control to the scheduler if the kernel has indicated that
  * other work needs to run on the current processor.
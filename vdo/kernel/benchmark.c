@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/benchmark.c#1 $
+ */
+
+#include "benchmark.h"
+
+#include <linux/semaphore.h>
+#include <linux/spinlock.h>
+
+#include "logger.h"
+#include "memoryAlloc.h"
+#include "numeric.h"
+#include "timeUtils.h"
+
+#include "constants.h"
+#include "statusCodes.h"
+
+#include "bio.h"
+#include "kernelLayer.h"
+
+enum {
+  /** The number of distinct blocks the duplicate writes are drawn from */
+  DUPLICATE_BLOCKS = 256,
+  /** The number of 64-bit words in a block */
+  BLOCK_WORDS      = VDO_BLOCK_SIZE / sizeof(uint64_t),
+};
+
+typedef struct benchmark Benchmark;
+
+typedef struct {
+  /** The benchmark issuing the request */
+  Benchmark *benchmark;
+  /** The bio of the request */
+  BIO       *bio;
+  /** The data of the bio */
+  char      *data;
+  /** Whether the request is a write */
+  bool       isWrite;
+  /** When the request was launched, in nanoseconds */
+  uint64_t   launchTime;
+} BenchmarkRequest;
+
+typedef struct {
+  /** The number of requests completed */
+  atomic64_t count;
+  /** The total latency of the requests, in nanoseconds */
+  atomic64_t totalLatency;
+  /** The greatest latency of any request, in nanoseconds */
+  atomic64_t maxLatency;
+} BenchmarkLatency;
+
+struct benchmark {
+  /** The layer the workload is run on */
+  KernelLayer          *layer;
+  /** The shape of the workload */
+  BenchmarkParameters   parameters;
+  /** The number of logical blocks the requests go to */
+  BlockCount            workingSet;
+  /** The state of the pseudo-random number generator */
+  uint64_t              random;
+  /** The number of unique blocks written so far */
+  uint64_t              uniqueBlocks;
+  /** Counts the requests which are not outstanding */
+  struct semaphore      idleCount;
+  /** Protects the list of idle requests */
+  spinlock_t            lock;
+  /** The requests which are not outstanding */
+  BenchmarkRequest    **idle;
+  /** The number of requests on the idle list */
+  unsigned int          idleRequests;
+  /** The latencies of the reads */
+  BenchmarkLatency      reads;
+  /** The latencies of the writes */
+  BenchmarkLatency      writes;
+  /** The number of requests which failed */
+  atomic64_t            errors;
+  /** The requests themselves */
+  BenchmarkRequest      requests[];
+};
+
+/**
+ * Get the next pseudo-random number of a benchmark. This is xorshift64*,
+ * which is plenty for choosing blocks and filling them with data.
+ *
+ * @param benchmark  The benchmark
+ *
+ * @return A pseudo-random number
+ **/
+static uint64_t nextRandom(Benchmark *benchmark)
+{
+  benchmark->random ^= benchmark->random >> 12;
+  benchmark->random ^= benchmark->random << 25;
+  benchmark->random ^= benchmark->random >> 27;
+  return benchmark->random * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Make a random choice with a given probability.
+ *
+ * @param benchmark  The benchmark
+ * @param percent    The percentage chance of choosing true
+ *
+ * @return <code>true</code> with the given chance
+ **/
+static bool choose(Benchmark *benchmark, unsigned int percent)
+{
+  return ((nextRandom(benchmark) % 100) < percent);
+}
+
+/**
+ * Fill the data of a write. A block is identified by a seed, which is
+ * either one of a small set of seeds shared by the duplicate writes, or a
+ * new one. The seed is the first word of the block, so that no two seeds
+ * give the same block; the incompressible part of the block follows as
+ * words drawn from a generator seeded with the seed, and the compressible
+ * part is the seed repeated.
+ *
+ * @param benchmark  The benchmark
+ * @param data       The block to fill
+ **/
+static void fillBlock(Benchmark *benchmark, char *data)
+{
+  const BenchmarkParameters *parameters = &benchmark->parameters;
+  uint64_t seed = (choose(benchmark, parameters->dedupePercent)
+                   ? (nextRandom(benchmark) % DUPLICATE_BLOCKS)
+                   : DUPLICATE_BLOCKS + benchmark->uniqueBlocks++);
+  // Seed zero would make a compressible block of zeros.
+  seed++;
+
+  uint64_t     *words       = (uint64_t *) data;
+  unsigned int  randomWords
+    = (BLOCK_WORDS * (100 - parameters->compressPercent)) / 100;
+  uint64_t      state       = seed;
+  words[0] = seed;
+  for (unsigned int i = 1; i < BLOCK_WORDS; i++) {
+    if (i < randomWords) {
+      state ^= state >> 12;
+      state ^= state << 25;
+      state ^= state >> 27;
+      words[i] = state * 0x2545F4914F6CDD1DULL;
+    } else {
+      words[i] = seed;
+    }
+  }
+}
+
+/**
+ * Add a request's latency to the benchmark's totals.
+ *
+ * @param latency  The latencies of the request's kind
+ * @param time     The latency of the request, in nanoseconds
+ **/
+static void recordLatency(BenchmarkLatency *latency, uint64_t time)
+{
+  atomic64_inc(&latency->count);
+  atomic64_add(time, &latency->totalLatency);
+  uint64_t max = atomic64_read(&latency->maxLatency);
+  while (time > max) {
+    uint64_t old = atomic64_cmpxchg(&latency->maxLatency, max, time);
+    if (old == max) {
+      break;
+    }
+    max = old;
+  }
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
+/**
+ * Callback for a completed benchmark request.
+ *
+ * @param bio  The bio of the request
+ **/
+static void completeBenchmarkRequest(BIO *bio)
+#else
+/**
+ * Callback for a completed benchmark request.
+ *
+ * @param bio     The bio of the request
+ * @param result  The result of the request
+ **/
+static void completeBenchmarkRequest(BIO *bio, int result)
+#endif
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
+  int result = getBioResult(bio);
+#endif
+  BenchmarkRequest *request   = bio->bi_private;
+  Benchmark        *benchmark = request->benchmark;
+  uint64_t          latency
+    = currentTime(CLOCK_MONOTONIC) - request->launchTime;
+  recordLatency((request->isWrite ? &benchmark->writes : &benchmark->reads),
+                latency);
+  if (result != 0) {
+    atomic64_inc(&benchmark->errors);
+  }
+
+  unsigned long flags;
+  spin_lock_irqsave(&benchmark->lock, flags);
+  benchmark->idle[benchmark->idleRequests++] = request;
+  spin_unlock_irqrestore(&benchmark->lock, flags);
+  up(&benchmark->idleCount);
+}
+
+/**
+ * Free a benchmark and its requests. None of them may be outstanding.
+ *
+ * @param benchmark  The benchmark to free
+ **/
+static void freeBenchmark(Benchmark *benchmark)
+{
+  for (unsigned int i = 0; i < benchmark->parameters.queueDepth; i++) {
+    BenchmarkRequest *request = &benchmark->requests[i];
+    if (request->bio != NULL) {
+      freeBio(request->bio, benchmark->layer);
+    }
+    FREE(request->data);
+  }
+
+  FREE(benchmark->idle);
+  FREE(benchmark);
+}
+
+/**
+ * Make a benchmark and the requests it will issue.
+ *
+ * @param [in]  layer          The layer to run the workload on
+ * @param [in]  logicalBlocks  The logical size of the pool
+ * @param [in]  parameters     The shape of the workload
+ * @param [out] benchmarkPtr   A pointer to hold the new benchmark
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+static int makeBenchmark(KernelLayer                *layer,
+                         BlockCount                  logicalBlocks,
+                         const BenchmarkParameters  *parameters,
+                         Benchmark                 **benchmarkPtr)
+{
+  Benchmark *benchmark;
+  int result = ALLOCATE_EXTENDED(Benchmark, parameters->queueDepth,
+                                 BenchmarkRequest, __func__, &benchmark);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  benchmark->layer        = layer;
+  benchmark->parameters   = *parameters;
+  benchmark->workingSet   = minUInt64(parameters->requests, logicalBlocks);
+  benchmark->random       = currentTime(CLOCK_MONOTONIC) | 1;
+  benchmark->idleRequests = parameters->queueDepth;
+  sema_init(&benchmark->idleCount, parameters->queueDepth);
+  spin_lock_init(&benchmark->lock);
+
+  result = ALLOCATE(parameters->queueDepth, BenchmarkRequest *, __func__,
+                    &benchmark->idle);
+  if (result != VDO_SUCCESS) {
+    freeBenchmark(benchmark);
+    return result;
+  }
+
+  for (unsigned int i = 0; i < parameters->queueDepth; i++) {
+    BenchmarkRequest *request = &benchmark->requests[i];
+    request->benchmark = benchmark;
+    benchmark->idle[i] = request;
+    result = ALLOCATE(VDO_BLOCK_SIZE, char, "benchmark data", &request->data);
+    if (result != VDO_SUCCESS) {
+      freeBenchmark(benchmark);
+      return result;
+    }
+
+    result = createBio(layer, request->data, &request->bio);
+    if (result != VDO_SUCCESS) {
+      freeBenchmark(benchmark);
+      return result;
+    }
+  }
+
+  *benchmarkPtr = benchmark;
+  return VDO_SUCCESS;
+}
+
+/**
+ * Launch a request to a random block of the working set.
+ *
+ * @param benchmark  The benchmark
+ * @param request    The idle request to launch
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+static int launchRequest(Benchmark *benchmark, BenchmarkRequest *request)
+{
+  KernelLayer        *layer = benchmark->layer;
+  LogicalBlockNumber  lbn   = nextRandom(benchmark) % benchmark->workingSet;
+  BIO                *bio   = request->bio;
+  request->isWrite = choose(benchmark, benchmark->parameters.writePercent);
+  resetBio(bio, layer);
+  if (request->isWrite) {
+    fillBlock(benchmark, request->data);
+    setBioOperationWrite(bio);
+  } else {
+    setBioOperationRead(bio);
+  }
+
+  setBioSector(bio, blockToSector(layer, lbn) + layer->startingSectorOffset);
+  bio->bi_end_io      = completeBenchmarkRequest;
+  bio->bi_private     = request;
+  request->launchTime = currentTime(CLOCK_MONOTONIC);
+  int result = kvdoMapBio(layer, bio);
+  return ((result == DM_MAPIO_SUBMITTED) ? VDO_SUCCESS : result);
+}
+
+/**
+ * Log the latencies of one kind of request.
+ *
+ * @param kind     The kind of request
+ * @param latency  The latencies of the requests of that kind
+ **/
+static void logLatency(const char *kind, BenchmarkLatency *latency)
+{
+  uint64_t count = atomic64_read(&latency->count);
+  if (count == 0) {
+    return;
+  }
+
+  logInfo("benchmark: %" PRIu64 " %s, latency average %" PRIu64
+          " us, maximum %" PRIu64 " us", count, kind,
+          atomic64_read(&latency->totalLatency) / count / 1000,
+          (uint64_t) atomic64_read(&latency->maxLatency) / 1000);
+}
+
+/**
+ * Log the results of a benchmark.
+ *
+ * @param benchmark  The benchmark
+ * @param elapsed    The time the benchmark took, in nanoseconds
+ **/
+static void logBenchmarkResults(Benchmark *benchmark, uint64_t elapsed)
+{
+  KernelLayer *layer = benchmark->layer;
+  uint64_t     count = (atomic64_read(&benchmark->reads.count)
+                        + atomic64_read(&benchmark->writes.count));
+  uint64_t     usec  = ((elapsed < 1000) ? 1 : (elapsed / 1000));
+  logInfo("benchmark: %" PRIu64 " requests in %" PRIu64 " us, %" PRIu64
+          " IOPS, %" PRIu64 " errors", count, usec,
+          (count * 1000000) / usec, atomic64_read(&benchmark->errors));
+  logLatency("reads", &benchmark->reads);
+  logLatency("writes", &benchmark->writes);
+
+  for (WriteStage stage = 0; stage < WRITE_STAGE_COUNT; stage++) {
+    uint64_t writes = relaxedLoad64(&layer->benchmarkStageWrites[stage]);
+    if (writes == 0) {
+      continue;
+    }
+
+    logInfo("benchmark: write stage %s: %" PRIu64 " writes, average %" PRIu64
+            " us", getWriteStageName(stage), writes,
+            relaxedLoad64(&layer->benchmarkStageTimes[stage]) / writes);
+  }
+}
+
+/**********************************************************************/
+int runBenchmark(KernelLayer               *layer,
+                 BlockCount                 logicalBlocks,
+                 const BenchmarkParameters *parameters)
+{
+  Benchmark *benchmark;
+  int result = makeBenchmark(layer, logicalBlocks, parameters, &benchmark);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  for (WriteStage stage = 0; stage < WRITE_STAGE_COUNT; stage++) {
+    relaxedStore64(&layer->benchmarkStageTimes[stage], 0);
+    relaxedStore64(&layer->benchmarkStageWrites[stage], 0);
+  }
+  atomicStoreBool(&layer->benchmarking, true);
+
+  logInfo("benchmark: %u requests, queue depth %u, %u%% writes,"
+          " %u%% duplicate, %u%% compressible", parameters->requests,
+          parameters->queueDepth, parameters->writePercent,
+          parameters->dedupePercent, parameters->compressPercent);
+  uint64_t startTime = currentTime(CLOCK_MONOTONIC);
+  for (unsigned int issued = 0; issued < parameters->requests; issued++) {
+    if (getKernelLayerState(layer) != LAYER_RUNNING) {
+      logWarning("benchmark: stopped since the pool is no longer running");
+      break;
+    }
+
+    if (down_interruptible(&benchmark->idleCount) != 0) {
+      logWarning("benchmark: interrupted");
+      break;
+    }
+
+    unsigned long flags;
+    spin_lock_irqsave(&benchmark->lock, flags);
+    BenchmarkRequest *request = benchmark->idle[--benchmark->idleRequests];
+    spin_unlock_irqrestore(&benchmark->lock, flags);
+
+    result = launchRequest(benchmark, request);
+    if (result != VDO_SUCCESS) {
+      logErrorWithStringError(result, "benchmark: launching request");
+      // The request was not taken, so it is idle again.
+      spin_lock_irqsave(&benchmark->lock, flags);
+      benchmark->idle[benchmark->idleRequests++] = request;
+      spin_unlock_irqrestore(&benchmark->lock, flags);
+      up(&benchmark->idleCount);
+      break;
+    }
+  }
+
+  /*
+   * Writes may be waiting in the packer, so use the pool's own wait, which
+   * flushes the packer, before waiting for the last requests. Once the pool
+   * is idle, the stage times of all the writes have been added up too.
+   */
+  waitForNoRequestsActive(layer);
+  for (unsigned int i = 0; i < parameters->queueDepth; i++) {
+    down(&benchmark->idleCount);
+  }
+  uint64_t elapsed = currentTime(CLOCK_MONOTONIC) - startTime;
+  atomicStoreBool(&layer->benchmarking, false);
+
+  logBenchmarkResults(benchmark, elapsed);
+  freeBenchmark(benchmark);
+  return result;
+}
+
+/**********************************************************************/
+void recordBenchmarkWriteStages(KernelLayer *layer, DataVIO *dataVIO)
+{
+  if (!atomicLoadBool(&layer->benchmarking)) {
+    return;
+  }
+
+  for (WriteStage stage = 0; stage < WRITE_STAGE_COUNT; stage++) {
+    if (dataVIO->stageTimes[stage] > 0) {
+      relaxedAdd64(&layer->benchmarkStageTimes[stage],
+                   dataVIO->stageTimes[stage]);
+      relaxedAdd64(&layer->benchmarkStageWrites[stage], 1);
+    }
+  }
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/benchmark.h#1 $
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "dataVIO.h"
+
+#include "kernelTypes.h"
+
+/**
+ * The shape of a synthetic workload.
+ **/
+typedef struct {
+  /** The number of requests to issue */
+  unsigned int requests;
+  /** The most requests to have outstanding at once */
+  unsigned int queueDepth;
+  /** The percentage of requests which are writes rather than reads */
+  unsigned int writePercent;
+  /** The percentage of writes which duplicate a block written before */
+  unsigned int dedupePercent;
+  /** The percentage of each written block which is compressible */
+  unsigned int compressPercent;
+} BenchmarkParameters;
+
+/**
+ * Run a synthetic workload against a layer and log its throughput, its
+ * latencies, and the time its writes spent in each write stage. The
+ * requests are launched as bios from the device-mapper would be, but
+ * without going through the block layer, so that what is measured is the
+ * VDO pipeline alone. The requests go to random blocks among the first
+ * few logical blocks, one for each request, so that reads find data
+ * written earlier in the run. Waits until every request has completed.
+ *
+ * The workload overwrites the pool's data, so this must only be used on a
+ * pool created for testing, and the pool should otherwise be idle.
+ *
+ * @param layer          The layer to run the workload on
+ * @param logicalBlocks  The logical size of the pool
+ * @param parameters     The shape of the workload
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+int runBenchmark(KernelLayer               *layer,
+                 BlockCount                 logicalBlocks,
+                 const BenchmarkParameters *parameters)
+  __attribute__((warn_unused_result));
+
+/**
+ * Add the time a completed write spent in each write stage to the totals
+ * of a running benchmark, if there is one.
+ *
+ * @param layer    The layer
+ * @param dataVIO  The completed write
+ **/
+void recordBenchmarkWriteStages(KernelLayer *layer, DataVIO *dataVIO);
+
+#endif // BENCHMARK_H
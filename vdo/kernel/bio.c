@@ -333,3 +333,21 @@ void prepareFlushBIO(BIO                 *bio,
   setBioSize(bio, 0);
   setBioSector(bio, 0);
 }
+
+/**********************************************************************/
+void prepareDiscardBIO(BIO                 *bio,
+                       void                *context,
+                       struct block_device *device,
+                       sector_t             sector,
+                       unsigned int         size,
+                       bio_end_io_t        *endIOCallback)
+{
+  clearBioOperationAndFlags(bio);
+  setBioOperationDiscard(bio);
+  bio->bi_end_io  = endIOCallback;
+  bio->bi_private = context;
+  bio->bi_vcnt    = 0;
+  setBioBlockDevice(bio, device);
+  setBioSize(bio, size);
+  setBioSector(bio, sector);
+}
@@ -24,6 +24,7 @@
 
 #include <linux/bio.h>
 #include <linux/blkdev.h>
+#include <linux/ioprio.h>
 #include <linux/version.h>
 
 #include "kernelTypes.h"
@@ -69,6 +70,18 @@ static inline void setBioOperationWrite(BIO *bio)
   setBioOperation(bio, WRITE);
 }
 
+/**********************************************************************/
+static inline void setBioOperationDiscard(BIO *bio)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+  setBioOperation(bio, REQ_OP_DISCARD);
+#elif LINUX_VERSION_CODE == KERNEL_VERSION(2,6,32)
+  setBioOperation(bio, WRITE | BIO_DISCARD);
+#else
+  setBioOperation(bio, WRITE | REQ_DISCARD);
+#endif
+}
+
 /**********************************************************************/
 static inline void clearBioOperationAndFlags(BIO *bio)
 {
@@ -89,6 +102,35 @@ static inline void copyBioOperationAndFlags(BIO *to, BIO *from)
 #endif
 }
 
+/**
+ * Check whether two bios have the same operation and flags.
+ *
+ * @param a  The first bio
+ * @param b  The second bio
+ *
+ * @return <code>true</code> if the operations and flags are the same
+ **/
+static inline bool areBioOperationsAndFlagsEqual(BIO *a, BIO *b)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+  return (a->bi_opf == b->bi_opf);
+#else
+  return (a->bi_rw == b->bi_rw);
+#endif
+}
+
+/**
+ * Get the I/O priority class of a bio.
+ *
+ * @param bio  The bio
+ *
+ * @return The IOPRIO_CLASS_* of the bio
+ **/
+static inline unsigned int getBioPriorityClass(BIO *bio)
+{
+  return IOPRIO_PRIO_CLASS(bio->bi_ioprio);
+}
+
 /**********************************************************************/
 static inline void setBioOperationFlag(BIO *bio, unsigned int flag)
 {
@@ -160,6 +202,14 @@ static inline void clearBioOperationFlagFua(BIO *bio)
 #endif
 }
 
+/**********************************************************************/
+static inline void setBioOperationFlagHighPriority(BIO *bio)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+  setBioOperationFlag(bio, REQ_HIPRI);
+#endif
+}
+
 /**********************************************************************/
 static inline bool isDiscardBio(BIO *bio)
 {
@@ -380,4 +430,21 @@ void prepareFlushBIO(BIO                 *bio,
                      struct block_device *device,
                      bio_end_io_t        *endIOCallback);
 
+/**
+ * Prepare a BIO without data pages to discard a range of the device below.
+ *
+ * @param bio            The discard BIO
+ * @param context        The context for the callback
+ * @param device         The device holding the range
+ * @param sector         The first sector of the range
+ * @param size           The size of the range in bytes
+ * @param endIOCallback  The function to call when the discard is complete
+ **/
+void prepareDiscardBIO(BIO                 *bio,
+                       void                *context,
+                       struct block_device *device,
+                       sector_t             sector,
+                       unsigned int         size,
+                       bio_end_io_t        *endIOCallback);
+
 #endif /* BIO_H */
@@ -22,8 +22,10 @@
 #include "bufferPool.h"
 
 #include <linux/delay.h>
+#include <linux/smp.h>
 #include <linux/sort.h>
 
+#include "cpu.h"
 #include "logger.h"
 #include "memoryAlloc.h"
 
@@ -44,6 +46,27 @@ typedef struct {
   void             *data;       // element data, if on free list
 } BufferElement;
 
+enum {
+  /** The number of free buffers each CPU's magazine can hold */
+  MAGAZINE_SIZE = 16,
+};
+
+/*
+ * A per-CPU cache of free buffers, in the manner of the slab allocator's
+ * magazines. Allocations and frees on a CPU use its magazine, and only go
+ * to the shared free list (the depot) to refill an empty magazine or to
+ * empty half of a full one, so the pool lock is taken once every several
+ * operations rather than on every one. The lock of a magazine is nearly
+ * always taken only by its own CPU; other CPUs take it only to steal a
+ * buffer when the depot is empty, so a pool never fails an allocation
+ * while any of its buffers are free.
+ */
+typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) {
+  spinlock_t    lock;                    // Locks this magazine
+  unsigned int  count;                   // Number of buffers held
+  void         *objects[MAGAZINE_SIZE];  // The buffers held
+} BufferMagazine;
+
 struct bufferPool {
   const char              *name; // Pool name
   void                    *data; // Associated pool data
@@ -58,8 +81,16 @@ struct bufferPool {
   BufferDumpFunction      *dump; // Dump function for buffer data
   BufferElement           *bhead; // Array of BufferElement structures
   void                   **objects;
+  BufferMagazine          *magazines; // Per-CPU caches, or NULL if unused
+  uint64_t                 refills; // Magazine refills from the depot
+  uint64_t                 flushes; // Magazine flushes to the depot
+  uint64_t                 steals;  // Buffers taken from other magazines
+  void                   **freeSnapshot; // Free buffers copied for a dump
 };
 
+// Serializes the use of the pools' free snapshots by dumps.
+static DEFINE_MUTEX(dumpMutex);
+
 /*************************************************************************/
 int makeBufferPool(const char              *poolName,
                    unsigned int             size,
@@ -91,6 +122,29 @@ int makeBufferPool(const char              *poolName,
     return result;
   }
 
+  result = ALLOCATE(size, void *, "free object snapshot",
+                    &pool->freeSnapshot);
+  if (result != VDO_SUCCESS) {
+    logError("buffer snapshot array allocation failure %d", result);
+    freeBufferPool(&pool);
+    return result;
+  }
+
+  // Small pools would strand too much of themselves in the magazines.
+  if (size >= (nr_cpu_ids * MAGAZINE_SIZE)) {
+    result = ALLOCATE(nr_cpu_ids, BufferMagazine, "buffer pool magazines",
+                      &pool->magazines);
+    if (result != VDO_SUCCESS) {
+      logError("buffer magazine allocation failure %d", result);
+      freeBufferPool(&pool);
+      return result;
+    }
+
+    for (unsigned int cpu = 0; cpu < nr_cpu_ids; cpu++) {
+      spin_lock_init(&pool->magazines[cpu].lock);
+    }
+  }
+
   pool->name  = poolName;
   pool->alloc = allocateFunction;
   pool->free  = freeFunction;
@@ -126,8 +180,17 @@ void freeBufferPool(BufferPool **poolPtr)
     return;
   }
 
-  ASSERT_LOG_ONLY((pool->numBusy == 0), "freeing busy buffer pool, numBusy=%d",
-                  pool->numBusy);
+  unsigned int cached = 0;
+  if (pool->magazines != NULL) {
+    for (unsigned int cpu = 0; cpu < nr_cpu_ids; cpu++) {
+      cached += pool->magazines[cpu].count;
+    }
+    FREE(pool->magazines);
+  }
+
+  ASSERT_LOG_ONLY((pool->numBusy == cached),
+                  "freeing busy buffer pool, numBusy=%d",
+                  pool->numBusy - cached);
   if (pool->objects != NULL) {
     for (int i = 0; i < pool->size; i++) {
       if (pool->objects[i] != NULL) {
@@ -136,19 +199,149 @@ void freeBufferPool(BufferPool **poolPtr)
     }
     FREE(pool->objects);
   }
+  FREE(pool->freeSnapshot);
   FREE(pool->bhead);
   FREE(pool);
   *poolPtr = NULL;
 }
 
-/*************************************************************************/
-static bool inFreeList(BufferPool *pool, void *data)
+/**
+ * Move buffers from the shared free list into a magazine. The magazine
+ * must be locked, and the pool lock must be held.
+ *
+ * @param pool      The pool
+ * @param magazine  The magazine to fill
+ * @param count     The most buffers to move
+ **/
+static void fillMagazine(BufferPool     *pool,
+                         BufferMagazine *magazine,
+                         unsigned int    count)
+{
+  for (unsigned int i = 0;
+       (i < count) && !list_empty(&pool->freeObjectList); i++) {
+    BufferElement *bh = list_first_entry(&pool->freeObjectList, BufferElement,
+                                         list);
+    list_move(&bh->list, &pool->spareListNodes);
+    magazine->objects[magazine->count++] = bh->data;
+    pool->numBusy++;
+  }
+}
+
+/**
+ * Move buffers from a magazine back onto the shared free list. The
+ * magazine must be locked, and the pool lock must be held.
+ *
+ * @param pool      The pool
+ * @param magazine  The magazine to empty
+ * @param count     The number of buffers to move
+ **/
+static void drainMagazine(BufferPool     *pool,
+                          BufferMagazine *magazine,
+                          unsigned int    count)
+{
+  for (unsigned int i = 0; i < count; i++) {
+    BufferElement *bh = list_first_entry(&pool->spareListNodes, BufferElement,
+                                         list);
+    list_move(&bh->list, &pool->freeObjectList);
+    bh->data = magazine->objects[--magazine->count];
+    pool->numBusy--;
+  }
+}
+
+/**
+ * Get the magazine of the current CPU. The thread may move to another CPU
+ * at any time, but since each magazine has its own lock, that only costs
+ * the occasional contended lock.
+ *
+ * @param pool  The pool, which must have magazines
+ *
+ * @return The magazine of the current CPU
+ **/
+static inline BufferMagazine *getMagazine(BufferPool *pool)
 {
-  struct list_head *node;
-  list_for_each(node, &pool->freeObjectList) {
-    if (container_of(node, BufferElement, list)->data == data) {
+  return &pool->magazines[raw_smp_processor_id()];
+}
+
+/**
+ * Count the buffers held in the magazines of a pool. The count is only
+ * a snapshot, since the magazines are not locked.
+ *
+ * @param pool  The pool
+ *
+ * @return The number of buffers the magazines hold
+ **/
+static unsigned int countCachedBuffers(BufferPool *pool)
+{
+  unsigned int cached = 0;
+  if (pool->magazines != NULL) {
+    for (unsigned int cpu = 0; cpu < nr_cpu_ids; cpu++) {
+      cached += READ_ONCE(pool->magazines[cpu].count);
+    }
+  }
+  return cached;
+}
+
+/**
+ * Return the buffers held in every magazine to the shared free list.
+ *
+ * @param pool  The pool
+ **/
+static void drainAllMagazines(BufferPool *pool)
+{
+  if (pool->magazines == NULL) {
+    return;
+  }
+
+  for (unsigned int cpu = 0; cpu < nr_cpu_ids; cpu++) {
+    BufferMagazine *magazine = &pool->magazines[cpu];
+    spin_lock(&magazine->lock);
+    spin_lock(&pool->lock);
+    drainMagazine(pool, magazine, magazine->count);
+    spin_unlock(&pool->lock);
+    spin_unlock(&magazine->lock);
+  }
+}
+
+/**
+ * Compare two buffer pointers, for sorting a free snapshot.
+ *
+ * @param item1  A pointer to the first buffer pointer
+ * @param item2  A pointer to the second buffer pointer
+ *
+ * @return -1, 0, or 1 as the first buffer's address is lower, the same, or
+ *         higher than the second's
+ **/
+static int compareBufferPointers(const void *item1, const void *item2)
+{
+  uintptr_t pointer1 = (uintptr_t) *(void * const *) item1;
+  uintptr_t pointer2 = (uintptr_t) *(void * const *) item2;
+  return ((pointer1 < pointer2) ? -1 : ((pointer1 > pointer2) ? 1 : 0));
+}
+
+/**
+ * Check whether a buffer is in a sorted snapshot of the free list.
+ *
+ * @param snapshot  The sorted free buffers
+ * @param count     The number of free buffers
+ * @param data      The buffer to look for
+ *
+ * @return true if the buffer was free
+ **/
+static bool inFreeSnapshot(void **snapshot, unsigned int count, void *data)
+{
+  unsigned int low  = 0;
+  unsigned int high = count;
+  while (low < high) {
+    unsigned int middle = low + ((high - low) / 2);
+    if (snapshot[middle] == data) {
       return true;
     }
+
+    if ((uintptr_t) snapshot[middle] < (uintptr_t) data) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
   }
   return false;
 }
@@ -165,37 +358,74 @@ void dumpBufferPool(BufferPool *pool, bool dumpElements)
   if (pool == NULL) {
     return;
   }
+
+  unsigned int cached = countCachedBuffers(pool);
+  if (dumpElements) {
+    // Put every free buffer where the free snapshot will see it.
+    drainAllMagazines(pool);
+    cached = 0;
+  }
+
+  /*
+   * Only copy the counters and the free list under the pool lock, so that
+   * allocations and frees are held up for as short a time as possible; the
+   * busy buffers are found and logged after the lock is released. They may
+   * change meanwhile, as they always could while being dumped.
+   */
+  mutex_lock(&dumpMutex);
+  unsigned int freeCount = 0;
   spin_lock(&pool->lock);
-  logInfo("%s: %u of %u busy (max %u)", pool->name, pool->numBusy, pool->size,
-          pool->maxBusy);
+  unsigned int busy    = pool->numBusy - cached;
+  unsigned int maxBusy = pool->maxBusy;
+  uint64_t     refills = pool->refills;
+  uint64_t     flushes = pool->flushes;
+  uint64_t     steals  = pool->steals;
   if (dumpElements && (pool->dump != NULL)) {
+    struct list_head *node;
+    list_for_each(node, &pool->freeObjectList) {
+      pool->freeSnapshot[freeCount++]
+        = container_of(node, BufferElement, list)->data;
+    }
+  }
+  spin_unlock(&pool->lock);
+
+  logInfo("%s: %u of %u busy (max %u)", pool->name, busy, pool->size,
+          maxBusy);
+  if (pool->magazines != NULL) {
+    logInfo("%s: %u cached in per-CPU magazines, %" PRIu64 " refills, %"
+            PRIu64 " flushes, %" PRIu64 " steals", pool->name, cached,
+            refills, flushes, steals);
+  }
+  if (dumpElements && (pool->dump != NULL)) {
+    sort(pool->freeSnapshot, freeCount, sizeof(void *),
+         compareBufferPointers, NULL);
     int dumped = 0;
     for (int i = 0; i < pool->size; i++) {
-      if (!inFreeList(pool, pool->objects[i])) {
+      if (!inFreeSnapshot(pool->freeSnapshot, freeCount, pool->objects[i])) {
         pool->dump(pool->data, pool->objects[i]);
         if (++dumped >= ELEMENTS_PER_BATCH) {
-          spin_unlock(&pool->lock);
           dumped = 0;
           msleep(SLEEP_FOR_SYSLOG);
-          spin_lock(&pool->lock);
         }
       }
     }
   }
-  spin_unlock(&pool->lock);
+  mutex_unlock(&dumpMutex);
 }
 
-/*************************************************************************/
-int allocBufferFromPool(BufferPool *pool, void **dataPtr)
+/**
+ * Acquire a free buffer from the shared free list of a pool.
+ *
+ * @param [in]  pool     The pool
+ * @param [out] dataPtr  A pointer to hold the buffer data
+ *
+ * @return VDO_SUCCESS or -ENOMEM if the list is empty
+ **/
+static int allocBufferFromDepot(BufferPool *pool, void **dataPtr)
 {
-  if (pool == NULL) {
-    return UDS_INVALID_ARGUMENT;
-  }
-
   spin_lock(&pool->lock);
   if (unlikely(list_empty(&pool->freeObjectList))) {
     spin_unlock(&pool->lock);
-    logDebug("no free buffers");
     return -ENOMEM;
   }
 
@@ -209,7 +439,126 @@ int allocBufferFromPool(BufferPool *pool, void **dataPtr)
   *dataPtr = bh->data;
   spin_unlock(&pool->lock);
   return VDO_SUCCESS;
+}
+
+/**
+ * Take a free buffer from the magazine of any CPU. This is only done when
+ * the shared free list and the current CPU's magazine are both empty.
+ *
+ * @param [in]  pool     The pool
+ * @param [out] dataPtr  A pointer to hold the buffer data
+ *
+ * @return <code>true</code> if a buffer was found
+ **/
+static bool stealFromMagazines(BufferPool *pool, void **dataPtr)
+{
+  for (unsigned int cpu = 0; cpu < nr_cpu_ids; cpu++) {
+    BufferMagazine *magazine = &pool->magazines[cpu];
+    if (READ_ONCE(magazine->count) == 0) {
+      continue;
+    }
+
+    spin_lock(&magazine->lock);
+    if (magazine->count > 0) {
+      *dataPtr = magazine->objects[--magazine->count];
+      spin_unlock(&magazine->lock);
+      spin_lock(&pool->lock);
+      pool->steals++;
+      spin_unlock(&pool->lock);
+      return true;
+    }
+    spin_unlock(&magazine->lock);
+  }
+
+  return false;
+}
+
+/**
+ * Acquire a free buffer through the magazine of the current CPU.
+ *
+ * @param [in]  pool     The pool, which must have magazines
+ * @param [out] dataPtr  A pointer to hold the buffer data
+ *
+ * @return VDO_SUCCESS or -ENOMEM if no buffer is free
+ **/
+static int allocBufferFromMagazine(BufferPool *pool, void **dataPtr)
+{
+  BufferMagazine *magazine = getMagazine(pool);
+  spin_lock(&magazine->lock);
+  if (magazine->count == 0) {
+    spin_lock(&pool->lock);
+    fillMagazine(pool, magazine, MAGAZINE_SIZE / 2);
+    pool->refills++;
+    if (pool->numBusy > pool->maxBusy) {
+      pool->maxBusy = pool->numBusy;
+    }
+    spin_unlock(&pool->lock);
+  }
+
+  if (magazine->count > 0) {
+    *dataPtr = magazine->objects[--magazine->count];
+    spin_unlock(&magazine->lock);
+    return VDO_SUCCESS;
+  }
+  spin_unlock(&magazine->lock);
 
+  /*
+   * Buffers may move between the depot and the magazines while they are
+   * searched, so keep looking as long as any magazine holds a buffer. A
+   * caller which holds a limiter permit for the pool must not be failed
+   * because its buffer was in transit.
+   */
+  do {
+    if (stealFromMagazines(pool, dataPtr)
+        || (allocBufferFromDepot(pool, dataPtr) == VDO_SUCCESS)) {
+      return VDO_SUCCESS;
+    }
+  } while (countCachedBuffers(pool) > 0);
+
+  logDebug("no free buffers");
+  return -ENOMEM;
+}
+
+/*************************************************************************/
+int allocBufferFromPool(BufferPool *pool, void **dataPtr)
+{
+  if (pool == NULL) {
+    return UDS_INVALID_ARGUMENT;
+  }
+
+  if (pool->magazines != NULL) {
+    return allocBufferFromMagazine(pool, dataPtr);
+  }
+
+  int result = allocBufferFromDepot(pool, dataPtr);
+  if (result != VDO_SUCCESS) {
+    logDebug("no free buffers");
+  }
+  return result;
+}
+
+/**
+ * Return buffers to the magazine of the current CPU, moving half of the
+ * magazine to the shared free list whenever it fills.
+ *
+ * @param pool   The pool, which must have magazines
+ * @param data   The buffer data to return
+ * @param count  Number of entries in the data array
+ **/
+static void freeBuffersToMagazine(BufferPool *pool, void **data, int count)
+{
+  BufferMagazine *magazine = getMagazine(pool);
+  spin_lock(&magazine->lock);
+  for (int i = 0; i < count; i++) {
+    if (magazine->count == MAGAZINE_SIZE) {
+      spin_lock(&pool->lock);
+      drainMagazine(pool, magazine, MAGAZINE_SIZE / 2);
+      pool->flushes++;
+      spin_unlock(&pool->lock);
+    }
+    magazine->objects[magazine->count++] = data[i];
+  }
+  spin_unlock(&magazine->lock);
 }
 
 /*************************************************************************/
@@ -229,6 +578,11 @@ static bool freeBufferToPoolInternal(BufferPool *pool, void *data)
 /*************************************************************************/
 void freeBufferToPool(BufferPool *pool, void *data)
 {
+  if (pool->magazines != NULL) {
+    freeBuffersToMagazine(pool, &data, 1);
+    return;
+  }
+
   spin_lock(&pool->lock);
   bool success = freeBufferToPoolInternal(pool, data);
   spin_unlock(&pool->lock);
@@ -240,6 +594,11 @@ void freeBufferToPool(BufferPool *pool, void *data)
 /*************************************************************************/
 void freeBuffersToPool(BufferPool *pool, void **data, int count)
 {
+  if (pool->magazines != NULL) {
+    freeBuffersToMagazine(pool, data, count);
+    return;
+  }
+
   spin_lock(&pool->lock);
   bool success = true;
   for (int i = 0; (i < count) && success; i++) {
@@ -40,7 +40,9 @@ typedef void BufferDumpFunction(void *poolData, void *data);
 /**
  * Creates a generic pool of buffer data. The elements in the pool are
  * allocated up front and placed on a free list, which manages the
- * reuse of the individual buffers in the pool.
+ * reuse of the individual buffers in the pool. A pool large enough to
+ * give each CPU a magazine of free buffers also caches buffers per CPU,
+ * so that most allocations and frees don't take the pool's lock.
  *
  * @param [in]  poolName         Name of the pool
  * @param [in]  size             The number of elements to create for this pool
@@ -73,11 +75,14 @@ int makeBufferPool(const char              *poolName,
 void freeBufferPool(BufferPool **poolPtr);
 
 /**
- * Dump a buffer pool to the log.
+ * Dump a buffer pool to the log. The pool is only locked long enough to
+ * copy its counters and its free list, so a dump doesn't hold up the
+ * allocations and frees of a busy pool while it logs.
  *
  * @param [in] pool          The buffer pool to allocate from
  * @param [in] dumpElements  True for complete output, or false for a
- *                           one-line summary
+ *                           summary; complete output first returns the
+ *                           buffers cached per CPU to the free list
  **/
 void dumpBufferPool(BufferPool *pool, bool dumpElements);
 
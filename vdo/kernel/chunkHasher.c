@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/chunkHasher.c#1 $
+ */
+
+#include "chunkHasher.h"
+
+#include <crypto/hash.h>
+#include <linux/err.h>
+
+#include "logger.h"
+#include "memoryAlloc.h"
+#include "murmur/MurmurHash3.h"
+#include "uds.h"
+
+#include "constants.h"
+#include "statusCodes.h"
+
+enum {
+  CHUNK_NAME_SEED     = 0x62ea60be,
+  SHA256_DIGEST_BYTES = 32,
+};
+
+typedef struct {
+  /** The name used in the dmsetup table */
+  const char *name;
+  /** The kernel crypto algorithm, or NULL for the built-in Murmur3 */
+  const char *algorithm;
+} HashInfo;
+
+static const HashInfo HASHES[] = {
+  [DEDUPE_HASH_MURMUR3] = {
+    .name      = "murmur3",
+    .algorithm = NULL,
+  },
+  [DEDUPE_HASH_SHA256] = {
+    .name      = "sha256",
+    .algorithm = "sha256",
+  },
+};
+
+struct chunkHasher {
+  /** The crypto transform, or NULL for the built-in Murmur3 */
+  struct crypto_shash *transform;
+};
+
+/**********************************************************************/
+int parseDedupeHash(const char *name, DedupeHash *hashPtr)
+{
+  for (unsigned int i = 0; i < COUNT_OF(HASHES); i++) {
+    if (strcmp(name, HASHES[i].name) == 0) {
+      *hashPtr = i;
+      return VDO_SUCCESS;
+    }
+  }
+
+  logError("unknown dedupe hash \"%s\"", name);
+  return -EINVAL;
+}
+
+/**********************************************************************/
+const char *getDedupeHashName(DedupeHash hash)
+{
+  return ((hash < COUNT_OF(HASHES)) ? HASHES[hash].name : "unknown");
+}
+
+/**********************************************************************/
+int makeChunkHasher(DedupeHash hash, ChunkHasher **hasherPtr)
+{
+  ChunkHasher *hasher;
+  int result = ALLOCATE(1, ChunkHasher, __func__, &hasher);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  if (HASHES[hash].algorithm != NULL) {
+    struct crypto_shash *transform
+      = crypto_alloc_shash(HASHES[hash].algorithm, 0, 0);
+    if (IS_ERR(transform)) {
+      result = (int) PTR_ERR(transform);
+      logErrorWithStringError(result, "cannot allocate %s hash",
+                              HASHES[hash].algorithm);
+      FREE(hasher);
+      return result;
+    }
+
+    if (crypto_shash_digestsize(transform) != SHA256_DIGEST_BYTES) {
+      crypto_free_shash(transform);
+      FREE(hasher);
+      return logErrorWithStringError(VDO_BAD_CONFIGURATION,
+                                     "unexpected %s digest size",
+                                     HASHES[hash].algorithm);
+    }
+    hasher->transform = transform;
+  }
+
+  *hasherPtr = hasher;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void freeChunkHasher(ChunkHasher **hasherPtr)
+{
+  ChunkHasher *hasher = *hasherPtr;
+  if (hasher == NULL) {
+    return;
+  }
+
+  if (hasher->transform != NULL) {
+    crypto_free_shash(hasher->transform);
+  }
+  FREE(hasher);
+  *hasherPtr = NULL;
+}
+
+/**********************************************************************/
+bool isStrongChunkHasher(const ChunkHasher *hasher)
+{
+  return (hasher->transform != NULL);
+}
+
+/**
+ * Name a block with a crypto hash, keeping the leading bytes of the digest.
+ *
+ * @param transform  The crypto transform
+ * @param block      The block to name
+ * @param name       The buffer to hold the name
+ **/
+static void hashChunkWithTransform(struct crypto_shash *transform,
+                                   const void          *block,
+                                   void                *name)
+{
+  u8 digest[SHA256_DIGEST_BYTES];
+  SHASH_DESC_ON_STACK(desc, transform);
+  desc->tfm = transform;
+  int result = crypto_shash_digest(desc, block, VDO_BLOCK_SIZE, digest);
+  shash_desc_zero(desc);
+  if (result != 0) {
+    // The software digest doesn't fail; should a driver do so, a name from
+    // the wrong hash only costs the block any chance of deduplicating.
+    logErrorWithStringError(result, "chunk hashing failed");
+    MurmurHash3_x64_128(block, VDO_BLOCK_SIZE, CHUNK_NAME_SEED, name);
+    return;
+  }
+
+  memcpy(name, digest, UDS_CHUNK_NAME_SIZE);
+}
+
+/**********************************************************************/
+void hashChunks(ChunkHasher       *hasher,
+                const void *const *blocks,
+                unsigned int       count,
+                void *const       *names)
+{
+  if (hasher->transform == NULL) {
+    MurmurHash3_x64_128_multi(blocks, count, VDO_BLOCK_SIZE, CHUNK_NAME_SEED,
+                              names);
+    return;
+  }
+
+  for (unsigned int i = 0; i < count; i++) {
+    hashChunkWithTransform(hasher->transform, blocks[i], names[i]);
+  }
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/chunkHasher.h#1 $
+ */
+
+#ifndef CHUNK_HASHER_H
+#define CHUNK_HASHER_H
+
+#include "types.h"
+
+/**
+ * The hash functions a pool may be configured to name chunks with. Murmur3
+ * is built in and fast, but names from it are only good enough to find
+ * candidates, each of which must be read back and compared before being
+ * deduplicated against. SHA-256 is provided by the kernel crypto API;
+ * names truncated from it are strong enough that advice which is known
+ * not to have changed since it was recorded may be trusted as is.
+ **/
+typedef enum {
+  DEDUPE_HASH_MURMUR3 = 0,
+  DEDUPE_HASH_SHA256,
+} DedupeHash;
+
+/**
+ * A chunk name generator, shared by all the CPU threads of a pool.
+ **/
+typedef struct chunkHasher ChunkHasher;
+
+/**
+ * Look up a dedupe hash by its table name.
+ *
+ * @param [in]  name     The name of the hash
+ * @param [out] hashPtr  A pointer to hold the hash
+ *
+ * @return VDO_SUCCESS or -EINVAL if the name is unknown
+ **/
+int parseDedupeHash(const char *name, DedupeHash *hashPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the table name of a dedupe hash.
+ *
+ * @param hash  The hash
+ *
+ * @return The name of the hash
+ **/
+const char *getDedupeHashName(DedupeHash hash)
+  __attribute__((warn_unused_result));
+
+/**
+ * Make a chunk hasher.
+ *
+ * @param [in]  hash       The hash function to name chunks with
+ * @param [out] hasherPtr  A pointer to hold the new hasher
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+int makeChunkHasher(DedupeHash hash, ChunkHasher **hasherPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free a chunk hasher and null out the reference to it.
+ *
+ * @param hasherPtr  The reference to the hasher to free
+ **/
+void freeChunkHasher(ChunkHasher **hasherPtr);
+
+/**
+ * Check whether the names a chunk hasher generates are strong enough that
+ * unchanged advice need not be verified.
+ *
+ * @param hasher  The hasher
+ *
+ * @return <code>true</code> if the hasher generates strong names
+ **/
+bool isStrongChunkHasher(const ChunkHasher *hasher)
+  __attribute__((warn_unused_result));
+
+/**
+ * Name a batch of data blocks. This may be called from several threads at
+ * once.
+ *
+ * @param hasher  The hasher
+ * @param blocks  The blocks to name, each VDO_BLOCK_SIZE bytes long
+ * @param count   The number of blocks
+ * @param names   The buffers to hold the name of each block
+ **/
+void hashChunks(ChunkHasher       *hasher,
+                const void *const *blocks,
+                unsigned int       count,
+                void *const       *names);
+
+#endif // CHUNK_HASHER_H
@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/compressionEngine.c#1 $
+ */
+
+#include "compressionEngine.h"
+
+#include <linux/crypto.h>
+#include <linux/err.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+
+#include "logger.h"
+#include "memoryAlloc.h"
+
+#include "constants.h"
+#include "lz4.h"
+#include "statusCodes.h"
+
+typedef struct {
+  /** The name used in the dmsetup table */
+  const char     *name;
+  /** The kernel crypto algorithm, or NULL for the built-in LZ4 */
+  const char     *algorithm;
+  /** The tag recorded with fragments this engine produces */
+  CompressionTag  tag;
+} EngineInfo;
+
+static const EngineInfo ENGINES[] = {
+  [COMPRESSION_ENGINE_LZ4] = {
+    .name      = "lz4",
+    .algorithm = NULL,
+    .tag       = COMPRESSION_TAG_LZ4,
+  },
+  // LZ4HC produces ordinary LZ4 blocks, so its fragments are decoded with
+  // the built-in LZ4 decompressor.
+  [COMPRESSION_ENGINE_LZ4HC] = {
+    .name      = "lz4hc",
+    .algorithm = "lz4hc",
+    .tag       = COMPRESSION_TAG_LZ4,
+  },
+  [COMPRESSION_ENGINE_ZSTD] = {
+    .name      = "zstd",
+    .algorithm = "zstd",
+    .tag       = COMPRESSION_TAG_ZSTD,
+  },
+  [COMPRESSION_ENGINE_LZO] = {
+    .name      = "lzo",
+    .algorithm = "lzo",
+    .tag       = COMPRESSION_TAG_LZO,
+  },
+  [COMPRESSION_ENGINE_DEFLATE] = {
+    .name      = "deflate",
+    .algorithm = "deflate",
+    .tag       = COMPRESSION_TAG_DEFLATE,
+  },
+};
+
+/** The crypto algorithms which decode each tag, except LZ4 */
+static const char *TAG_ALGORITHMS[COMPRESSION_TAG_COUNT] = {
+  [COMPRESSION_TAG_LZ4]     = NULL,
+  [COMPRESSION_TAG_ZSTD]    = "zstd",
+  [COMPRESSION_TAG_LZO]     = "lzo",
+  [COMPRESSION_TAG_DEFLATE] = "deflate",
+};
+
+struct compressionContext {
+  /** The engine this context compresses with */
+  CompressionEngine   engine;
+  /** The LZ4 acceleration factor */
+  int                 acceleration;
+  /** The LZ4 hash table, for the built-in engine */
+  char               *lz4Context;
+  /** The crypto transform, for all other engines */
+  struct crypto_comp *transform;
+};
+
+enum {
+  /** The number of decoded fragments a FragmentDecoder remembers */
+  FRAGMENT_CACHE_ENTRIES = 64,
+};
+
+/**
+ * A remembered decoding of a fragment. The compressed fragment is kept as
+ * well as its decoding, so that an entry which has gone stale because its
+ * block was freed and rewritten is never mistaken for the current one.
+ **/
+typedef struct {
+  /** Protects the rest of the entry */
+  spinlock_t          lock;
+  /** The block holding the fragment, or ZERO_BLOCK if the entry is unused */
+  PhysicalBlockNumber pbn;
+  /** The slot of the fragment in the block */
+  BlockMappingState   state;
+  /** The tag of the fragment */
+  CompressionTag      tag;
+  /** The size of the compressed fragment */
+  int                 fragmentSize;
+  /** The compressed fragment */
+  char                fragment[VDO_BLOCK_SIZE];
+  /** The decoded fragment */
+  char                data[VDO_BLOCK_SIZE];
+} FragmentCacheEntry;
+
+struct fragmentDecoder {
+  /** Serializes allocation and use of the transforms */
+  struct mutex        mutex;
+  /** The transforms for each tag, allocated on first use */
+  struct crypto_comp *transforms[COMPRESSION_TAG_COUNT];
+  /** The recently decoded fragments, indexed by location */
+  FragmentCacheEntry *cache;
+};
+
+/**
+ * Allocate a crypto compression transform.
+ *
+ * @param [in]  algorithm     The name of the crypto algorithm
+ * @param [out] transformPtr  A pointer to hold the transform
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+static int allocateTransform(const char          *algorithm,
+                             struct crypto_comp **transformPtr)
+{
+  struct crypto_comp *transform = crypto_alloc_comp(algorithm, 0, 0);
+  if (IS_ERR(transform)) {
+    int result = (int) PTR_ERR(transform);
+    logErrorWithStringError(result, "cannot allocate %s compressor",
+                            algorithm);
+    return result;
+  }
+
+  *transformPtr = transform;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+int parseCompressionEngine(const char *name, CompressionEngine *enginePtr)
+{
+  for (unsigned int i = 0; i < COUNT_OF(ENGINES); i++) {
+    if (strcmp(name, ENGINES[i].name) == 0) {
+      *enginePtr = i;
+      return VDO_SUCCESS;
+    }
+  }
+
+  logError("unknown compression engine \"%s\"", name);
+  return -EINVAL;
+}
+
+/**********************************************************************/
+const char *getCompressionEngineName(CompressionEngine engine)
+{
+  return ((engine < COUNT_OF(ENGINES)) ? ENGINES[engine].name : "unknown");
+}
+
+/**********************************************************************/
+int makeCompressionContext(CompressionEngine    engine,
+                           unsigned int         level,
+                           CompressionContext **contextPtr)
+{
+  CompressionContext *context;
+  int result = ALLOCATE(1, CompressionContext, __func__, &context);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  context->engine       = engine;
+  context->acceleration = ((level == 0) ? 1 : level);
+  if (ENGINES[engine].algorithm == NULL) {
+    result = ALLOCATE(LZ4_context_size(), char, "LZ4 context",
+                      &context->lz4Context);
+  } else {
+    result = allocateTransform(ENGINES[engine].algorithm,
+                               &context->transform);
+  }
+  if (result != VDO_SUCCESS) {
+    freeCompressionContext(&context);
+    return result;
+  }
+
+  *contextPtr = context;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void freeCompressionContext(CompressionContext **contextPtr)
+{
+  CompressionContext *context = *contextPtr;
+  if (context == NULL) {
+    return;
+  }
+
+  if (context->transform != NULL) {
+    crypto_free_comp(context->transform);
+  }
+  FREE(context->lz4Context);
+  FREE(context);
+  *contextPtr = NULL;
+}
+
+/**********************************************************************/
+int compressWithContext(CompressionContext *context,
+                        const char         *source,
+                        int                 size,
+                        char               *dest,
+                        int                 maxSize,
+                        CompressionTag     *tagPtr)
+{
+  *tagPtr = ENGINES[context->engine].tag;
+  if (context->transform == NULL) {
+    return LZ4_compress_ctx_limitedOutput_accel(context->lz4Context, source,
+                                                dest, size, maxSize,
+                                                context->acceleration);
+  }
+
+  unsigned int compressedSize = maxSize;
+  if (crypto_comp_compress(context->transform, (const u8 *) source, size,
+                           (u8 *) dest, &compressedSize) != 0) {
+    // Most backends fail when the output doesn't fit.
+    return 0;
+  }
+  return compressedSize;
+}
+
+/**********************************************************************/
+int makeFragmentDecoder(FragmentDecoder **decoderPtr)
+{
+  FragmentDecoder *decoder;
+  int result = ALLOCATE(1, FragmentDecoder, __func__, &decoder);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  result = ALLOCATE(FRAGMENT_CACHE_ENTRIES, FragmentCacheEntry,
+                    "fragment cache", &decoder->cache);
+  if (result != VDO_SUCCESS) {
+    FREE(decoder);
+    return result;
+  }
+
+  for (unsigned int i = 0; i < FRAGMENT_CACHE_ENTRIES; i++) {
+    spin_lock_init(&decoder->cache[i].lock);
+    decoder->cache[i].pbn = ZERO_BLOCK;
+  }
+
+  mutex_init(&decoder->mutex);
+  *decoderPtr = decoder;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void freeFragmentDecoder(FragmentDecoder **decoderPtr)
+{
+  FragmentDecoder *decoder = *decoderPtr;
+  if (decoder == NULL) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < COMPRESSION_TAG_COUNT; i++) {
+    if (decoder->transforms[i] != NULL) {
+      crypto_free_comp(decoder->transforms[i]);
+    }
+  }
+  mutex_destroy(&decoder->mutex);
+  FREE(decoder->cache);
+  FREE(decoder);
+  *decoderPtr = NULL;
+}
+
+/**********************************************************************/
+int decodeFragment(FragmentDecoder *decoder,
+                   CompressionTag   tag,
+                   const char      *fragment,
+                   int              size,
+                   char            *dest,
+                   int              maxSize)
+{
+  if (tag == COMPRESSION_TAG_LZ4) {
+    return LZ4_uncompress_knownOutputSize(fragment, dest, size, maxSize);
+  }
+
+  if ((tag >= COMPRESSION_TAG_COUNT) || (TAG_ALGORITHMS[tag] == NULL)) {
+    return -EINVAL;
+  }
+
+  // Fragments from crypto backends are only found on pools which have
+  // been configured to use them, so a single shared transform suffices.
+  mutex_lock(&decoder->mutex);
+  int result = VDO_SUCCESS;
+  if (decoder->transforms[tag] == NULL) {
+    result = allocateTransform(TAG_ALGORITHMS[tag], &decoder->transforms[tag]);
+  }
+
+  unsigned int decodedSize = maxSize;
+  if (result == VDO_SUCCESS) {
+    result = crypto_comp_decompress(decoder->transforms[tag],
+                                    (const u8 *) fragment, size, (u8 *) dest,
+                                    &decodedSize);
+  }
+  mutex_unlock(&decoder->mutex);
+
+  return ((result == 0) ? (int) decodedSize : -EIO);
+}
+
+/**
+ * Get the cache entry which may hold the decoding of the fragment in a slot.
+ *
+ * @param decoder  The decoder
+ * @param pbn      The block holding the fragment
+ * @param state    The slot of the fragment
+ *
+ * @return The cache entry for the slot
+ **/
+static FragmentCacheEntry *getFragmentCacheEntry(FragmentDecoder     *decoder,
+                                                 PhysicalBlockNumber  pbn,
+                                                 BlockMappingState    state)
+{
+  uint64_t key = (pbn * MAX_COMPRESSION_SLOTS) + getSlotFromState(state);
+  // Fibonacci hashing spreads neighboring blocks over the whole cache.
+  uint64_t hash = key * 0x9e3779b97f4a7c15ULL;
+  return &decoder->cache[(hash >> 32) % FRAGMENT_CACHE_ENTRIES];
+}
+
+/**********************************************************************/
+int decodeCachedFragment(FragmentDecoder     *decoder,
+                         PhysicalBlockNumber  pbn,
+                         BlockMappingState    state,
+                         CompressionTag       tag,
+                         const char          *fragment,
+                         int                  size,
+                         char                *dest)
+{
+  FragmentCacheEntry *entry = getFragmentCacheEntry(decoder, pbn, state);
+  spin_lock(&entry->lock);
+  if ((entry->pbn == pbn) && (entry->state == state) && (entry->tag == tag)
+      && (entry->fragmentSize == size)
+      && (memcmp(entry->fragment, fragment, size) == 0)) {
+    memcpy(dest, entry->data, VDO_BLOCK_SIZE);
+    spin_unlock(&entry->lock);
+    return VDO_BLOCK_SIZE;
+  }
+  spin_unlock(&entry->lock);
+
+  int decodedSize = decodeFragment(decoder, tag, fragment, size, dest,
+                                   VDO_BLOCK_SIZE);
+  if ((decodedSize != VDO_BLOCK_SIZE) || (size > VDO_BLOCK_SIZE)) {
+    return decodedSize;
+  }
+
+  spin_lock(&entry->lock);
+  entry->pbn          = pbn;
+  entry->state        = state;
+  entry->tag          = tag;
+  entry->fragmentSize = size;
+  memcpy(entry->fragment, fragment, size);
+  memcpy(entry->data, dest, VDO_BLOCK_SIZE);
+  spin_unlock(&entry->lock);
+  return decodedSize;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/compressionEngine.h#1 $
+ */
+
+#ifndef COMPRESSION_ENGINE_H
+#define COMPRESSION_ENGINE_H
+
+#include "compressedBlock.h"
+
+/**
+ * The compressors a pool may be configured to use. LZ4 is built in; the
+ * others are provided by the kernel crypto API and are only available if
+ * the corresponding crypto module can be loaded.
+ **/
+typedef enum {
+  COMPRESSION_ENGINE_LZ4 = 0,
+  COMPRESSION_ENGINE_LZ4HC,
+  COMPRESSION_ENGINE_ZSTD,
+  COMPRESSION_ENGINE_LZO,
+  COMPRESSION_ENGINE_DEFLATE,
+} CompressionEngine;
+
+/**
+ * A per-thread compressor. A CompressionContext must only be used by one
+ * thread at a time.
+ **/
+typedef struct compressionContext CompressionContext;
+
+/**
+ * A decompressor for fragments produced by any engine, shared by all the
+ * threads of a pool.
+ **/
+typedef struct fragmentDecoder FragmentDecoder;
+
+/**
+ * Look up a compression engine by its table name.
+ *
+ * @param [in]  name       The name of the engine
+ * @param [out] enginePtr  A pointer to hold the engine
+ *
+ * @return VDO_SUCCESS or -EINVAL if the name is unknown
+ **/
+int parseCompressionEngine(const char *name, CompressionEngine *enginePtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the table name of a compression engine.
+ *
+ * @param engine  The engine
+ *
+ * @return The name of the engine
+ **/
+const char *getCompressionEngineName(CompressionEngine engine)
+  __attribute__((warn_unused_result));
+
+/**
+ * Make a compression context.
+ *
+ * @param [in]  engine      The engine the context will compress with
+ * @param [in]  level       The engine-specific level; for LZ4 this is the
+ *                          acceleration factor, and 0 means the default
+ * @param [out] contextPtr  A pointer to hold the new context
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+int makeCompressionContext(CompressionEngine    engine,
+                           unsigned int         level,
+                           CompressionContext **contextPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free a compression context and null out the reference to it.
+ *
+ * @param contextPtr  The reference to the context to free
+ **/
+void freeCompressionContext(CompressionContext **contextPtr);
+
+/**
+ * Compress a block.
+ *
+ * @param [in]  context  The compression context
+ * @param [in]  source   The data to compress
+ * @param [in]  size     The size of the data
+ * @param [out] dest     The buffer to hold the compressed data
+ * @param [in]  maxSize  The size of the destination buffer
+ * @param [out] tagPtr   A pointer to hold the tag to record with the data
+ *
+ * @return The compressed size, or 0 if the data did not fit in maxSize
+ **/
+int compressWithContext(CompressionContext *context,
+                        const char         *source,
+                        int                 size,
+                        char               *dest,
+                        int                 maxSize,
+                        CompressionTag     *tagPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Make a fragment decoder.
+ *
+ * @param decoderPtr  A pointer to hold the new decoder
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+int makeFragmentDecoder(FragmentDecoder **decoderPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free a fragment decoder and null out the reference to it.
+ *
+ * @param decoderPtr  The reference to the decoder to free
+ **/
+void freeFragmentDecoder(FragmentDecoder **decoderPtr);
+
+/**
+ * Decompress a fragment. LZ4 fragments are decoded directly, and must fill
+ * the destination exactly; other tags use a crypto transform which is
+ * allocated the first time it is needed.
+ *
+ * @param decoder   The decoder
+ * @param tag       The tag recorded with the fragment
+ * @param fragment  The compressed data
+ * @param size      The size of the compressed data
+ * @param dest      The buffer to hold the decompressed data
+ * @param maxSize   The size of the destination buffer
+ *
+ * @return The decompressed size, or a negative value on error
+ **/
+int decodeFragment(FragmentDecoder *decoder,
+                   CompressionTag   tag,
+                   const char      *fragment,
+                   int              size,
+                   char            *dest,
+                   int              maxSize)
+  __attribute__((warn_unused_result));
+
+/**
+ * Decompress a fragment of a full block through the decoder's cache of
+ * recently decoded fragments, so that a fragment which is read over and
+ * over, such as a popular dedupe target, is only decompressed once. A
+ * cached decoding is only used if the fragment read is byte for byte the
+ * one which was decoded, so stale entries are harmless.
+ *
+ * @param decoder   The decoder
+ * @param pbn       The block holding the fragment
+ * @param state     The mapping state giving the slot of the fragment
+ * @param tag       The tag recorded with the fragment
+ * @param fragment  The compressed data
+ * @param size      The size of the compressed data
+ * @param dest      The VDO_BLOCK_SIZE buffer to hold the decompressed data
+ *
+ * @return The decompressed size, or a negative value on error
+ **/
+int decodeCachedFragment(FragmentDecoder     *decoder,
+                         PhysicalBlockNumber  pbn,
+                         BlockMappingState    state,
+                         CompressionTag       tag,
+                         const char          *fragment,
+                         int                  size,
+                         char                *dest)
+  __attribute__((warn_unused_result));
+
+#endif // COMPRESSION_ENGINE_H
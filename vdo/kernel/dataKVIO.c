@@ -24,24 +24,55 @@
 
 #include "logger.h"
 #include "memoryAlloc.h"
-#include "murmur/MurmurHash3.h"
+#include "timeUtils.h"
 
 #include "dataVIO.h"
 #include "compressedBlock.h"
+#include "compressibility.h"
 #include "hashLock.h"
-#include "lz4.h"
+#include "packer.h"
+#include "vdo.h"
 
+#include "benchmark.h"
 #include "bio.h"
+#include "chunkHasher.h"
 #include "dedupeIndex.h"
 #include "kvdoFlush.h"
 #include "kvio.h"
 #include "ioSubmitter.h"
+#include "physicalBlockCache.h"
+#include "sharedWorkQueue.h"
 #include "vdoCommon.h"
+#include "vdoTrace.h"
 #include "verify.h"
 
 static void dumpPooledDataKVIO(void *poolData, void *data);
 
+bool compressibilityEstimation = true;
+bool speculativeCompression    = false;
+
+/**
+ * The upper half of the chunk name given to a block which repeats one
+ * 64-bit word; the lower half is the word itself.
+ **/
+static const uint64_t PATTERN_NAME_TAG = 0x9f3b6c5e2ad14787ULL;
+
 enum {
+  /**
+   * The maximum number of blocks hashed in one multi-buffer pass; this
+   * should be a multiple of the number of lanes in the hash function.
+   **/
+  HASH_BATCH_SIZE         = 8,
+  /**
+   * One in this many blocks which the compressibility estimator skips is
+   * compressed anyway, in order to measure the estimator's accuracy.
+   **/
+  ESTIMATE_AUDIT_INTERVAL = 64,
+  /**
+   * The most acknowledgements handed to the upper layers in one batch
+   * before the ack thread gives the scheduler a chance to run other work.
+   **/
+  BIO_ACK_BATCH_LIMIT     = 32,
   WRITE_PROTECT_FREE_POOL = 0,
   WP_DATA_KVIO_SIZE       = (sizeof(DataKVIO) + PAGE_SIZE - 1
                              - ((sizeof(DataKVIO) + PAGE_SIZE - 1)
@@ -73,7 +104,7 @@ setWriteProtect(void   *address,
 /**********************************************************************/
 static void maybeLogDataKVIOTrace(DataKVIO *dataKVIO)
 {
-  if (dataKVIO->kvio.layer->traceLogging) {
+  if (dataKVIO->kvio.layer->traceLogging || READ_ONCE(traceBuffering)) {
     logKvioTrace(&dataKVIO->kvio);
   }
 }
@@ -175,20 +206,52 @@ static noinline void cleanDataKVIO(DataKVIO *dataKVIO, FreeBufferPointers *fbp)
   addFreeBufferPointer(fbp, dataKVIO);
 }
 
+/**
+ * Enter the time a write spent in each write stage into the layer's
+ * histograms. A stage the write never entered is not sampled, so that it
+ * does not swamp the histogram with zeros.
+ *
+ * @param layer    The kernel layer
+ * @param dataVIO  The write which has completed
+ **/
+static void enterWriteStageTimes(KernelLayer *layer, DataVIO *dataVIO)
+{
+  for (WriteStage stage = 0; stage < WRITE_STAGE_COUNT; stage++) {
+    if (dataVIO->stageTimes[stage] > 0) {
+      enterHistogramSample(layer->writeStageHistograms[stage],
+                           dataVIO->stageTimes[stage]);
+    }
+  }
+
+  recordBenchmarkWriteStages(layer, dataVIO);
+}
+
 /**********************************************************************/
 void returnDataKVIOBatchToPool(BatchProcessor *batch, void *closure)
 {
-  KernelLayer *layer = closure;
-  uint32_t     count = 0;
+  KernelLayer *layer      = closure;
+  uint32_t     count      = 0;
+  uint64_t     minLatency = UINT64_MAX;
+  uint32_t     classCounts[INTAKE_CLASS_COUNT + 1] = { 0, };
   ASSERT_LOG_ONLY(batch != NULL, "batch not null");
   ASSERT_LOG_ONLY(layer != NULL, "layer not null");
 
   FreeBufferPointers fbp;
   initFreeBufferPointers(&fbp, layer->dataKVIOPool);
 
+  uint64_t      now = currentTime(CLOCK_MONOTONIC);
   KvdoWorkItem *item;
   while ((item = nextBatchItem(batch)) != NULL) {
-    cleanDataKVIO(workItemAsDataKVIO(item), &fbp);
+    DataKVIO *dataKVIO = workItemAsDataKVIO(item);
+    uint64_t  latency  = now - dataKVIO->launchTime;
+    trace_vdo_data_vio_release(layer->instance, &dataKVIO->dataVIO,
+                               dataKVIO->dataVIO.logical.lbn, latency);
+    minLatency = minUInt64(minLatency, latency);
+    classCounts[dataKVIO->intakeClass]++;
+    if (!isReadDataVIO(&dataKVIO->dataVIO)) {
+      enterWriteStageTimes(layer, &dataKVIO->dataVIO);
+    }
+    cleanDataKVIO(dataKVIO, &fbp);
     condReschedBatchProcessor(batch);
     count++;
   }
@@ -197,6 +260,16 @@ void returnDataKVIOBatchToPool(BatchProcessor *batch, void *closure)
     freeBufferPointers(&fbp);
   }
 
+  for (IntakeClass class = 0; class < INTAKE_CLASS_COUNT; class++) {
+    if (classCounts[class] > 0) {
+      limiterReleaseMany(&layer->intakeLimiters[class], classCounts[class]);
+    }
+  }
+
+  if (count > 0) {
+    limiterReportLatency(&layer->requestLimiter, minLatency);
+  }
+
   completeManyRequests(layer, count);
 }
 
@@ -238,7 +311,9 @@ static void copyReadBlockData(KvdoWorkItem *workItem)
   // For a read-modify-write, copy the data into the dataBlock buffer so it
   // will be set up for the write phase.
   if (isReadModifyWriteVIO(dataKVIO->kvio.vio)) {
-    bioCopyDataOut(getBIOFromDataKVIO(dataKVIO), dataKVIO->readBlock.data);
+    if (dataKVIO->readBlock.data != dataKVIO->dataBlock) {
+      bioCopyDataOut(getBIOFromDataKVIO(dataKVIO), dataKVIO->readBlock.data);
+    }
     kvdoEnqueueDataVIOCallback(dataKVIO);
     return;
   }
@@ -318,14 +393,17 @@ static void uncompressReadBlock(KvdoWorkItem *workItem)
   ReadBlock *readBlock = &dataKVIO->readBlock;
   BlockSize  blockSize = VDO_BLOCK_SIZE;
 
-  // The DataKVIO's scratch block will be used to contain the
-  // uncompressed data.
+  // A read never uses its dataBlock otherwise, so it holds the
+  // uncompressed data. For a read-modify-write, that is where the data
+  // is wanted anyway.
   uint16_t fragmentOffset, fragmentSize;
+  CompressionTag fragmentTag;
   char *compressedData = readBlock->data;
   int result = getCompressedBlockFragment(readBlock->mappingState,
                                           compressedData, blockSize,
                                           &fragmentOffset,
-                                          &fragmentSize);
+                                          &fragmentSize,
+                                          &fragmentTag);
   if (result != VDO_SUCCESS) {
     logDebug("%s: frag err %d", __func__, result);
     readBlock->status = result;
@@ -333,13 +411,21 @@ static void uncompressReadBlock(KvdoWorkItem *workItem)
     return;
   }
 
+  KernelLayer *layer = getLayerFromDataKVIO(dataKVIO);
+  if (readBlock->cacheOnDecode) {
+    cacheBlock(layer->physicalBlockCache, readBlock->pbn,
+               readBlock->cacheStamp, compressedData, false);
+  }
+
   char *fragment = compressedData + fragmentOffset;
-  int size = LZ4_uncompress_unknownOutputSize(fragment, dataKVIO->scratchBlock,
-                                              fragmentSize, blockSize);
+  int size = decodeCachedFragment(layer->fragmentDecoder, readBlock->pbn,
+                                  readBlock->mappingState, fragmentTag,
+                                  fragment, fragmentSize,
+                                  dataKVIO->dataBlock);
   if (size == blockSize) {
-    readBlock->data = dataKVIO->scratchBlock;
+    readBlock->data = dataKVIO->dataBlock;
   } else {
-    logDebug("%s: lz4 error", __func__);
+    logDebug("%s: decompression error (tag %u)", __func__, fragmentTag);
     readBlock->status = VDO_INVALID_FRAGMENT;
   }
 
@@ -364,6 +450,12 @@ static void completeRead(DataKVIO *dataKVIO, int result)
     return;
   }
 
+  if ((result == VDO_SUCCESS) && readBlock->cacheOnDecode) {
+    KernelLayer *layer = getLayerFromDataKVIO(dataKVIO);
+    cacheBlock(layer->physicalBlockCache, readBlock->pbn,
+               readBlock->cacheStamp, readBlock->data, true);
+  }
+
   readBlock->callback(dataKVIO);
 }
 
@@ -409,9 +501,40 @@ void kvdoReadBlock(DataVIO             *dataVIO,
   ReadBlock   *readBlock = &dataKVIO->readBlock;
   KernelLayer *layer     = getLayerFromDataKVIO(dataKVIO);
 
-  readBlock->callback     = callback;
-  readBlock->status       = VDO_SUCCESS;
-  readBlock->mappingState = mappingState;
+  // The read will overwrite any compressed data from a speculation.
+  dataKVIO->speculationValid = false;
+
+  readBlock->callback      = callback;
+  readBlock->status        = VDO_SUCCESS;
+  readBlock->mappingState  = mappingState;
+  readBlock->pbn           = location;
+  readBlock->cacheOnDecode = false;
+
+  // Recently read compressed blocks, blocks read ahead of sequential reads,
+  // and repeatedly read blocks may be cached.
+  bool repeated;
+  if (readCachedBlock(layer->physicalBlockCache, location, readBlock->buffer,
+                      &readBlock->cacheStamp, &repeated)) {
+    if (isCompressed(mappingState)) {
+      atomic64_inc(&layer->compressedBlockCacheHits);
+    } else {
+      atomic64_inc(repeated
+                   ? &layer->repeatedReadCacheHits : &layer->readAheadHits);
+    }
+    readBlock->data = readBlock->buffer;
+    completeRead(dataKVIO, VDO_SUCCESS);
+    return;
+  }
+
+  if (isCompressed(mappingState)) {
+    atomic64_inc(&layer->compressedBlockCacheMisses);
+    readBlock->cacheOnDecode = true;
+  } else if (admitRepeatedRead(layer->physicalBlockCache, location)) {
+    // Both data reads and dedupe verification reads of a block which keeps
+    // being read are worth caching.
+    atomic64_inc(&layer->repeatedReadsCached);
+    readBlock->cacheOnDecode = true;
+  }
 
   BUG_ON(getBIOFromDataKVIO(dataKVIO)->bi_private != &dataKVIO->kvio);
   // Read the data directly from the device using the read bio.
@@ -423,6 +546,28 @@ void kvdoReadBlock(DataVIO             *dataVIO,
   submitBio(bio, action);
 }
 
+/**
+ * Check whether a partial read of an uncompressed block may be read
+ * straight into the requestor's bio. The storage must be able to read the
+ * requested sectors by themselves.
+ *
+ * @param dataKVIO  The DataKVIO doing the read
+ *
+ * @return <code>true</code> if the read may go directly to the user's bio
+ **/
+static bool canReadPartialDirectly(DataKVIO *dataKVIO)
+{
+  if (!dataKVIO->isPartial || isReadModifyWriteVIO(dataKVIO->kvio.vio)) {
+    return false;
+  }
+
+  KernelLayer  *layer     = getLayerFromDataKVIO(dataKVIO);
+  unsigned int  blockSize = bdev_logical_block_size(getKernelLayerBdev(layer));
+  BIO          *bio       = dataKVIO->externalIORequest.bio;
+  return (((dataKVIO->offset % blockSize) == 0)
+          && ((getBioSize(bio) % blockSize) == 0));
+}
+
 /**********************************************************************/
 void kvdoReadDataVIO(DataVIO *dataVIO)
 {
@@ -436,10 +581,33 @@ void kvdoReadDataVIO(DataVIO *dataVIO)
     return;
   }
 
-  KVIO *kvio = dataVIOAsKVIO(dataVIO);
-  BIO  *bio  = kvio->bio;
+  // A cached block is copied from the cache like the contents of a
+  // compressed block, rather than read into the user's bio. So is a block
+  // which is read again soon after it was last read, so that it is cached.
+  KernelLayer        *layer = getLayerFromDataKVIO(dataVIOAsDataKVIO(dataVIO));
+  PhysicalBlockCache *cache = layer->physicalBlockCache;
+  uint64_t            stamp;
+  if (isBlockCached(cache, dataVIO->mapped.pbn, &stamp)
+      || admitRepeatedRead(cache, dataVIO->mapped.pbn)) {
+    kvdoReadBlock(dataVIO, dataVIO->mapped.pbn, dataVIO->mapped.state,
+                  BIO_Q_ACTION_DATA, readDataKVIOReadBlockCallback);
+    return;
+  }
+
+  KVIO     *kvio     = dataVIOAsKVIO(dataVIO);
+  DataKVIO *dataKVIO = dataVIOAsDataKVIO(dataVIO);
+  sector_t  sector   = blockToSector(kvio->layer, dataVIO->mapped.pbn);
+  if (canReadPartialDirectly(dataKVIO)) {
+    // Read just the requested sectors into the requestor's bio rather than
+    // reading the whole block into the dataBlock and copying them out.
+    dataKVIO->isDirectRead = true;
+    kvio->bio              = dataKVIO->externalIORequest.bio;
+    sector                += (dataKVIO->offset >> SECTOR_SHIFT);
+  }
+
+  BIO *bio = kvio->bio;
   bio->bi_end_io = resetUserBio;
-  setBioSector(bio, blockToSector(kvio->layer, dataVIO->mapped.pbn));
+  setBioSector(bio, sector);
   submitBio(bio, BIO_Q_ACTION_DATA);
 }
 
@@ -490,10 +658,40 @@ void kvdoWriteDataVIO(DataVIO *dataVIO)
   KVIO *kvio  = dataVIOAsKVIO(dataVIO);
   BIO  *bio   = kvio->bio;
   setBioOperationWrite(bio);
+  if (writesDataWithFUA(getVDOFromDataVIO(dataVIO))) {
+    // The journal will not flush before committing this block's mapping.
+    setBioOperationFlagFua(bio);
+  }
   setBioSector(bio, blockToSector(kvio->layer, dataVIO->newMapped.pbn));
   submitBio(bio, BIO_Q_ACTION_DATA);
 }
 
+/**
+ * Apply the data of a write, full or partial, to a block.
+ *
+ * @param dataKVIO  The DataKVIO of the write
+ * @param block     The VDO_BLOCK_SIZE block to apply it to
+ **/
+static void applyWrite(DataKVIO *dataKVIO, char *block)
+{
+  BIO *bio = dataKVIO->externalIORequest.bio;
+  if (!dataKVIO->isPartial) {
+    // A full block write's data (or a trim's zeros) is already in its
+    // dataBlock, unless it is a block of zeros.
+    if (dataKVIO->dataVIO.isZeroBlock) {
+      memset(block, '\0', VDO_BLOCK_SIZE);
+    } else {
+      memcpy(block, dataKVIO->dataBlock, VDO_BLOCK_SIZE);
+    }
+  } else if (!isDiscardBio(bio)) {
+    bioCopyDataIn(bio, block + dataKVIO->offset);
+  } else {
+    memset(block + dataKVIO->offset, '\0',
+           min(dataKVIO->remainingDiscard,
+               (DiscardSize) (VDO_BLOCK_SIZE - dataKVIO->offset)));
+  }
+}
+
 /**********************************************************************/
 void kvdoModifyWriteDataVIO(DataVIO *dataVIO)
 {
@@ -503,13 +701,17 @@ void kvdoModifyWriteDataVIO(DataVIO *dataVIO)
   KernelLayer *layer    = getLayerFromDataKVIO(dataKVIO);
   resetBio(dataKVIO->dataBlockBio, layer);
 
-  if (!isDiscardBio(bio)) {
-    bioCopyDataIn(bio, dataKVIO->dataBlock + dataKVIO->offset);
-  } else {
-    memset(dataKVIO->dataBlock + dataKVIO->offset, '\0',
-           min(dataKVIO->remainingDiscard,
-               (DiscardSize) (VDO_BLOCK_SIZE - dataKVIO->offset)));
+  // The absorbed writes are idle until this one finishes, so their data is
+  // still in their bios.
+  WaitQueue    *absorbed = &dataVIO->logical.absorbed;
+  const Waiter *waiter;
+  for (waiter = getFirstWaiter(absorbed);
+       waiter != NULL;
+       waiter = getNextWaiter(absorbed, waiter)) {
+    DataVIO *earlier = waiterAsDataVIO((Waiter *) waiter);
+    applyWrite(dataVIOAsDataKVIO(earlier), dataKVIO->dataBlock);
   }
+  applyWrite(dataKVIO, dataKVIO->dataBlock);
 
   dataVIO->isZeroBlock               = bioIsZeroData(dataKVIO->dataBlockBio);
   dataKVIO->dataBlockBio->bi_private = &dataKVIO->kvio;
@@ -533,38 +735,221 @@ void kvdoCopyDataVIO(DataVIO *source, DataVIO *destination)
                  dataVIOAsDataKVIO(source)->dataBlock);
 }
 
-/**********************************************************************/
-static void kvdoCompressWork(KvdoWorkItem *item)
+/**
+ * Choose one of a set of per-CPU-thread batch processors for the next item,
+ * spreading the work round-robin so that every CPU thread gets a share.
+ *
+ * @param layer       The kernel layer
+ * @param processors  The batch processors, one per CPU thread
+ * @param index       The counter used to rotate through the processors
+ *
+ * @return The batch processor to use
+ **/
+static BatchProcessor *selectCPUBatchProcessor(KernelLayer     *layer,
+                                               BatchProcessor **processors,
+                                               Atomic32        *index)
 {
-  DataKVIO    *dataKVIO = workItemAsDataKVIO(item);
-  KernelLayer *layer    = getLayerFromDataKVIO(dataKVIO);
-  dataKVIOAddTraceRecord(dataKVIO, THIS_LOCATION(NULL));
+  uint32_t cpuThreads = layer->deviceConfig->threadCounts.cpuThreads;
+  return processors[atomicAdd32(index, 1) % cpuThreads];
+}
 
-  char *context = getWorkQueuePrivateData();
-  if (unlikely(context == NULL)) {
-    uint32_t index = atomicAdd32(&layer->compressionContextIndex, 1) - 1;
-    BUG_ON(index >= layer->deviceConfig->threadCounts.cpuThreads);
-    context = layer->compressionContext[index];
-    setWorkQueuePrivateData(context);
+/**
+ * Check whether a DataKVIO's data should skip compression because the
+ * compressibility estimator judges it incompressible, and account for it.
+ *
+ * @param dataKVIO  The DataKVIO about to be compressed
+ * @param auditPtr  A pointer to hold whether the block should be compressed
+ *                  anyway so that the estimate can be checked
+ *
+ * @return <code>true</code> if the block should not be compressed
+ **/
+static bool skipCompression(DataKVIO *dataKVIO, bool *auditPtr)
+{
+  *auditPtr = false;
+  if (!compressibilityEstimation) {
+    return false;
+  }
+
+  // The read buffer is idle until the compressor writes its output there.
+  STATIC_ASSERT(sizeof(CompressibilityWorkspace) <= VDO_BLOCK_SIZE);
+  if (!isProbablyIncompressible(dataKVIO->dataBlock,
+                                (CompressibilityWorkspace *)
+                                dataKVIO->readBlock.buffer)) {
+    return false;
+  }
+
+  KernelLayer *layer = getLayerFromDataKVIO(dataKVIO);
+  uint64_t skipped = atomic64_inc_return(&layer->compressionEstimateSkipped);
+  if ((skipped % ESTIMATE_AUDIT_INTERVAL) == 0) {
+    atomic64_inc(&layer->compressionEstimateAudited);
+    *auditPtr = true;
+    return false;
   }
 
-  int size = LZ4_compress_ctx_limitedOutput(context, dataKVIO->dataBlock,
-                                            dataKVIO->scratchBlock,
-                                            VDO_BLOCK_SIZE,
-                                            VDO_BLOCK_SIZE);
+  return true;
+}
+
+/**
+ * Compress the data block of a DataKVIO into its read buffer. By the time
+ * a write is compressed, it is done with any read of old data for a
+ * read-modify-write, and it is either done with any read of a block to
+ * verify dedupe advice or has not yet been told what to verify, so the
+ * buffer is free to hold the compressed data until the packer copies it
+ * out.
+ *
+ * @param dataKVIO  The DataKVIO to compress
+ * @param context   The compression context to use
+ **/
+static void compressDataBlock(DataKVIO *dataKVIO, CompressionContext *context)
+{
   DataVIO *dataVIO = &dataKVIO->dataVIO;
+  bool     audit;
+  if (skipCompression(dataKVIO, &audit)) {
+    dataVIO->compression.size = VDO_BLOCK_SIZE + 1;
+    return;
+  }
+
+  int size = compressWithContext(context, dataKVIO->dataBlock, VDO_BLOCK_SIZE,
+                                 dataKVIO->readBlock.buffer, VDO_BLOCK_SIZE,
+                                 &dataVIO->compression.tag);
   if (size > 0) {
-    // The scratch block will be used to contain the compressed data.
-    dataVIO->compression.data = dataKVIO->scratchBlock;
+    // The read buffer will be used to contain the compressed data.
+    dataVIO->compression.data = dataKVIO->readBlock.buffer;
     dataVIO->compression.size = size;
   } else {
     // Use block size plus one as an indicator for uncompressible data.
     dataVIO->compression.size = VDO_BLOCK_SIZE + 1;
   }
 
+  if (compressibilityEstimation) {
+    KernelLayer *layer        = getLayerFromDataKVIO(dataKVIO);
+    bool         compressible = isSufficientlyCompressible(dataVIO);
+    if (audit && compressible) {
+      atomic64_inc(&layer->compressionEstimateWronglySkipped);
+    } else if (!audit && !compressible) {
+      atomic64_inc(&layer->compressionEstimateMissed);
+    }
+  }
+}
+
+/**
+ * Compress a DataKVIO which has been told it will not be deduplicated, and
+ * continue it.
+ *
+ * @param dataKVIO  The DataKVIO to compress
+ * @param context   The compression context to use
+ **/
+static void compressDataKVIO(DataKVIO *dataKVIO, CompressionContext *context)
+{
+  dataKVIOAddTraceRecord(dataKVIO, THIS_LOCATION(NULL));
+  compressDataBlock(dataKVIO, context);
   kvdoEnqueueDataVIOCallback(dataKVIO);
 }
 
+/**
+ * The work function of a DataKVIO's speculation work item. Compression needs
+ * the context of the batch processor it is running in, so speculation items
+ * are run by compressDataKVIOBatch() rather than by this function.
+ *
+ * @param item  The speculation work item
+ **/
+static void speculativeCompressionWork(KvdoWorkItem *item)
+{
+  ASSERT_LOG_ONLY(false, "speculative compression item %" PRIptr
+                  " run from a batch", item);
+}
+
+/**
+ * Compress a DataKVIO while its dedupe query is outstanding, and continue it
+ * if the query has already finished.
+ *
+ * @param dataKVIO  The DataKVIO to compress
+ * @param context   The compression context to use
+ **/
+static void compressSpeculatively(DataKVIO           *dataKVIO,
+                                  CompressionContext *context)
+{
+  compressDataBlock(dataKVIO, context);
+  dataKVIO->speculationValid = true;
+  if (finishSpeculationLeg(dataKVIO)) {
+    kvdoEnqueueDataVIOCallback(dataKVIO);
+  }
+}
+
+/**
+ * Start compressing a write alongside its dedupe query if speculation is
+ * enabled and the write would be compressed should the query not find a
+ * duplicate.
+ *
+ * @param dataKVIO  The DataKVIO about to be queried
+ **/
+static void maybeSpeculate(DataKVIO *dataKVIO)
+{
+  DataVIO     *dataVIO = &dataKVIO->dataVIO;
+  KernelLayer *layer   = getLayerFromDataKVIO(dataKVIO);
+  if (!READ_ONCE(speculativeCompression) || !hasAllocation(dataVIO)
+      || ((dataVIO->policy & LBN_POLICY_COMPRESS) == 0)
+      || !getKVDOCompressing(&layer->kvdo)
+      || (isDiscardBio(dataKVIO->externalIORequest.bio)
+          && (dataKVIO->remainingDiscard > 0))) {
+    return;
+  }
+
+  atomic64_inc(&layer->speculativeCompressions);
+  atomic_set(&dataKVIO->speculationLegs, 2);
+  dataKVIO->speculating = true;
+  setupWorkItem(&dataKVIO->speculationItem, speculativeCompressionWork, NULL,
+                CPU_Q_ACTION_COMPRESS_BLOCK);
+  addToBatchProcessor(selectCPUBatchProcessor(layer,
+                                              layer->dataKVIOCompressors,
+                                              &layer->dataKVIOCompressorIndex),
+                      &dataKVIO->speculationItem);
+}
+
+/**********************************************************************/
+void compressDataKVIOBatch(BatchProcessor *batch, void *closure)
+{
+  // Each compressor owns one compression context, and the BatchProcessor
+  // guarantees that only one thread at a time is running it, so the context
+  // (and its hash table) stays hot in the cache of whichever thread is
+  // draining.
+  CompressionContext *context = closure;
+  KvdoWorkItem *item;
+  while ((item = nextBatchItem(batch)) != NULL) {
+    if (item->work == speculativeCompressionWork) {
+      compressSpeculatively(container_of(item, DataKVIO, speculationItem),
+                            context);
+    } else {
+      compressDataKVIO(workItemAsDataKVIO(item), context);
+    }
+    condReschedBatchProcessor(batch);
+  }
+}
+
+/**********************************************************************/
+void acknowledgeDataKVIOBatch(BatchProcessor *batch, void *closure)
+{
+  KernelLayer *layer     = closure;
+  bool         shared    = isSharedWorkQueue(layer->bioAckQueue);
+  uint64_t     startTime = (shared ? currentTime(CLOCK_MONOTONIC) : 0);
+
+  // Completions which arrive while the batch is being run are picked up by
+  // the next pass of the batch processor, so a busy ack thread takes many
+  // acknowledgements per wakeup, much like interrupt moderation.
+  unsigned int  count = 0;
+  KvdoWorkItem *item;
+  while ((count < BIO_ACK_BATCH_LIMIT)
+         && ((item = nextBatchItem(batch)) != NULL)) {
+    item->work(item);
+    count++;
+  }
+  noteWorkQueueBatch(count);
+  if (shared) {
+    updateWorkQueueShare(&layer->bioAckShare, count, startTime);
+  }
+  condReschedBatchProcessor(batch);
+}
+
 /**********************************************************************/
 void kvdoCompressDataVIO(DataVIO *dataVIO)
 {
@@ -585,8 +970,19 @@ void kvdoCompressDataVIO(DataVIO *dataVIO)
     return;
   }
 
-  launchDataKVIOOnCPUQueue(dataKVIO, kvdoCompressWork, NULL,
-                           CPU_Q_ACTION_COMPRESS_BLOCK);
+  KernelLayer *layer = getLayerFromDataKVIO(dataKVIO);
+  if (dataKVIO->speculationValid) {
+    // The block was compressed while the dedupe query was outstanding.
+    dataKVIO->speculationValid = false;
+    atomic64_inc(&layer->speculativeCompressionsUsed);
+    kvdoEnqueueDataVIOCallback(dataKVIO);
+    return;
+  }
+
+  addToBatchProcessor(selectCPUBatchProcessor(layer,
+                                              layer->dataKVIOCompressors,
+                                              &layer->dataKVIOCompressorIndex),
+                      workItemFromDataKVIO(dataKVIO));
 }
 
 /**
@@ -616,6 +1012,8 @@ static int makeDataKVIO(KernelLayer *layer, BIO *bio, DataKVIO **dataKVIOPtr)
   memset(&kvio->enqueueable, 0, sizeof(KvdoEnqueueable));
   memset(&dataKVIO->dedupeContext.pendingList, 0, sizeof(struct list_head));
   memset(&dataKVIO->dataVIO, 0, sizeof(DataVIO));
+  dataKVIO->speculating      = false;
+  dataKVIO->speculationValid = false;
   kvio->bioToSubmit = NULL;
   bio_list_init(&kvio->biosMerged);
 
@@ -670,20 +1068,22 @@ static int kvdoCreateKVIOFromBio(KernelLayer  *layer,
   }
 
   dataKVIO->externalIORequest = externalIORequest;
+  dataKVIO->launchTime        = currentTime(CLOCK_MONOTONIC);
   dataKVIO->offset = sectorToBlockOffset(layer, getBioSector(bio));
   dataKVIO->isPartial = ((getBioSize(bio) < VDO_BLOCK_SIZE)
                          || (dataKVIO->offset != 0));
+  dataKVIO->isDirectRead = false;
 
   if (dataKVIO->isPartial) {
     countBios(&layer->biosInPartial, bio);
   } else {
     /*
-     * Note that we unconditionally fill in the dataBlock array for
-     * non-read operations. There are places like kvdoCopyVIO that may
-     * look at kvio->dataBlock for a zero block (and maybe for
-     * discards?). We could skip filling in dataBlock for such cases,
-     * but only once we're sure all such places are fixed to check the
-     * isZeroBlock flag first.
+     * The base code acknowledges a write before it hashes, compresses, or
+     * verifies the data, so the data must be copied out of the bio to
+     * outlive it. A full block of zeros is never written, hashed, or
+     * compressed, and is never the source of kvdoCopyDataVIO() since it
+     * gets no allocation, so its dataBlock is never looked at and the copy
+     * is skipped.
      */
     if (isDiscardBio(bio)) {
       /*
@@ -694,9 +1094,11 @@ static int kvdoCreateKVIOFromBio(KernelLayer  *layer,
       memset(dataKVIO->dataBlock, 0, VDO_BLOCK_SIZE);
     } else if (bio_data_dir(bio) == WRITE) {
       dataKVIO->dataVIO.isZeroBlock = bioIsZeroData(bio);
-      // Copy the bio data to a char array so that we can continue to use
-      // the data after we acknowledge the bio.
-      bioCopyDataIn(bio, dataKVIO->dataBlock);
+      if (!dataKVIO->dataVIO.isZeroBlock) {
+        // Copy the bio data to a char array so that we can continue to use
+        // the data after we acknowledge the bio.
+        bioCopyDataIn(bio, dataKVIO->dataBlock);
+      }
     }
   }
 
@@ -790,8 +1192,10 @@ static void kvdoCompletePartialRead(VDOCompletion *completion)
   DataKVIO *dataKVIO = dataVIOAsDataKVIO(asDataVIO(completion));
   dataKVIOAddTraceRecord(dataKVIO, THIS_LOCATION(NULL));
 
-  bioCopyDataOut(dataKVIO->externalIORequest.bio,
-                 dataKVIO->readBlock.data + dataKVIO->offset);
+  if (!dataKVIO->isDirectRead) {
+    bioCopyDataOut(dataKVIO->externalIORequest.bio,
+                   dataKVIO->readBlock.data + dataKVIO->offset);
+  }
   kvdoCompleteDataKVIO(completion);
   return;
 }
@@ -800,7 +1204,8 @@ static void kvdoCompletePartialRead(VDOCompletion *completion)
 int kvdoLaunchDataKVIOFromBio(KernelLayer *layer,
                               BIO         *bio,
                               uint64_t     arrivalTime,
-                              bool         hasDiscardPermit)
+                              bool         hasDiscardPermit,
+                              IntakeClass  intakeClass)
 {
 
   DataKVIO *dataKVIO = NULL;
@@ -810,10 +1215,16 @@ int kvdoLaunchDataKVIOFromBio(KernelLayer *layer,
     if (hasDiscardPermit) {
       limiterRelease(&layer->discardLimiter);
     }
+    if (intakeClass != INTAKE_CLASS_NONE) {
+      limiterRelease(&layer->intakeLimiters[intakeClass]);
+    }
     limiterRelease(&layer->requestLimiter);
     return mapToSystemError(result);
   }
 
+  dataKVIO->intakeClass = intakeClass;
+  dataKVIO->submitCPU   = raw_smp_processor_id();
+
   /*
    * Discards behave very differently than other requests when coming
    * in from device-mapper. We have to be able to handle any size discards
@@ -850,35 +1261,113 @@ int kvdoLaunchDataKVIOFromBio(KernelLayer *layer,
   LogicalBlockNumber lbn
     = sectorToBlock(layer, getBioSector(bio) - layer->startingSectorOffset);
   prepareDataVIO(&dataKVIO->dataVIO, lbn, operation, isTrim, callback);
+  trace_vdo_data_vio_admit(layer->instance, &dataKVIO->dataVIO, lbn,
+                           operation);
   enqueueKVIO(kvio, launchDataKVIOWork, vioAsCompletion(kvio->vio)->callback,
               REQ_Q_ACTION_MAP_BIO);
   return VDO_SUCCESS;
 }
 
 /**
- * Hash a DataKVIO and set its chunk name.
+ * Hash the data blocks of a set of DataKVIOs in one multi-buffer pass, set
+ * their chunk names, and send each of them on to its next callback.
  *
- * @param item  The DataKVIO to be hashed
+ * @param hasher     The chunk hasher of the layer
+ * @param dataKVIOs  The DataKVIOs to hash
+ * @param count      The number of DataKVIOs
  **/
-static void kvdoHashDataWork(KvdoWorkItem *item)
+static void hashDataKVIOs(ChunkHasher   *hasher,
+                          DataKVIO     **dataKVIOs,
+                          unsigned int   count)
 {
-  DataKVIO *dataKVIO = workItemAsDataKVIO(item);
-  DataVIO  *dataVIO  = &dataKVIO->dataVIO;
-  dataVIOAddTraceRecord(dataVIO, THIS_LOCATION(NULL));
+  const void *blocks[HASH_BATCH_SIZE];
+  void       *chunkNames[HASH_BATCH_SIZE];
+  for (unsigned int i = 0; i < count; i++) {
+    blocks[i]     = dataKVIOs[i]->dataBlock;
+    chunkNames[i] = &dataKVIOs[i]->dataVIO.chunkName;
+  }
 
-  MurmurHash3_x64_128(dataKVIO->dataBlock, VDO_BLOCK_SIZE, 0x62ea60be,
-                      &dataVIO->chunkName);
-  dataKVIO->dedupeContext.chunkName = &dataVIO->chunkName;
+  hashChunks(hasher, blocks, count, chunkNames);
 
-  kvdoEnqueueDataVIOCallback(dataKVIO);
+  for (unsigned int i = 0; i < count; i++) {
+    DataKVIO *dataKVIO = dataKVIOs[i];
+    dataKVIO->dedupeContext.chunkName = &dataKVIO->dataVIO.chunkName;
+    kvdoEnqueueDataVIOCallback(dataKVIO);
+  }
+}
+
+/**********************************************************************/
+void hashDataKVIOBatch(BatchProcessor *batch, void *closure)
+{
+  KernelLayer  *layer = (KernelLayer *) closure;
+  DataKVIO     *dataKVIOs[HASH_BATCH_SIZE];
+  unsigned int  count = 0;
+
+  KvdoWorkItem *item;
+  while ((item = nextBatchItem(batch)) != NULL) {
+    DataKVIO *dataKVIO = workItemAsDataKVIO(item);
+    dataKVIOAddTraceRecord(dataKVIO, THIS_LOCATION(NULL));
+    dataKVIOs[count++] = dataKVIO;
+    if (count == HASH_BATCH_SIZE) {
+      hashDataKVIOs(layer->chunkHasher, dataKVIOs, count);
+      count = 0;
+      condReschedBatchProcessor(batch);
+    }
+  }
+
+  if (count > 0) {
+    hashDataKVIOs(layer->chunkHasher, dataKVIOs, count);
+  }
+}
+
+/**
+ * Check whether a block consists of one 64-bit word repeated throughout.
+ * Four words are compared per branch so that the loop can be vectorized.
+ *
+ * @param [in]  block       The block to check, which must be word aligned
+ * @param [out] patternPtr  A pointer to hold the repeated word
+ *
+ * @return <code>true</code> if the block is a repeated word
+ **/
+static bool isPatternBlock(const char *block, uint64_t *patternPtr)
+{
+  const uint64_t *words   = (const uint64_t *) block;
+  uint64_t        pattern = words[0];
+  for (size_t i = 0; i < (VDO_BLOCK_SIZE / sizeof(uint64_t)); i += 4) {
+    if (((words[i] ^ pattern) | (words[i + 1] ^ pattern)
+         | (words[i + 2] ^ pattern) | (words[i + 3] ^ pattern)) != 0) {
+      return false;
+    }
+  }
+
+  *patternPtr = pattern;
+  return true;
 }
 
 /**********************************************************************/
 void kvdoHashDataVIO(DataVIO *dataVIO)
 {
   dataVIOAddTraceRecord(dataVIO, THIS_LOCATION(NULL));
-  launchDataKVIOOnCPUQueue(dataVIOAsDataKVIO(dataVIO), kvdoHashDataWork, NULL,
-                           CPU_Q_ACTION_HASH_BLOCK);
+  DataKVIO    *dataKVIO = dataVIOAsDataKVIO(dataVIO);
+  KernelLayer *layer    = getLayerFromDataKVIO(dataKVIO);
+
+  // A block repeating one word (zero blocks never get here) is named for
+  // its pattern, which is far cheaper than hashing it and names every copy
+  // of the pattern identically.
+  uint64_t pattern;
+  if (isPatternBlock(dataKVIO->dataBlock, &pattern)) {
+    size_t offset = 0;
+    encodeUInt64LE(dataVIO->chunkName.name, &offset, pattern);
+    encodeUInt64LE(dataVIO->chunkName.name, &offset, PATTERN_NAME_TAG);
+    dataKVIO->dedupeContext.chunkName = &dataVIO->chunkName;
+    atomic64_inc(&layer->patternBlocksNamed);
+    kvdoEnqueueDataVIOCallback(dataKVIO);
+    return;
+  }
+
+  addToBatchProcessor(selectCPUBatchProcessor(layer, layer->dataKVIOHashers,
+                                              &layer->dataKVIOHasherIndex),
+                      workItemFromDataKVIO(dataKVIO));
 }
 
 /**********************************************************************/
@@ -892,6 +1381,7 @@ void kvdoCheckForDuplication(DataVIO *dataVIO)
                   "discard not checked for duplication");
 
   DataKVIO *dataKVIO = dataVIOAsDataKVIO(dataVIO);
+  maybeSpeculate(dataKVIO);
   if (hasAllocation(dataVIO)) {
     postDedupeAdvice(dataKVIO);
   } else {
@@ -932,7 +1422,6 @@ static void freePooledDataKVIO(void *poolData, void *data)
 
   FREE(dataKVIO->readBlock.buffer);
   FREE(dataKVIO->dataBlock);
-  FREE(dataKVIO->scratchBlock);
   FREE(dataKVIO);
 }
 
@@ -995,14 +1484,6 @@ static int allocatePooledDataKVIO(KernelLayer *layer, DataKVIO **dataKVIOPtr)
 
   dataKVIO->readBlock.bio->bi_private = &dataKVIO->kvio;
 
-  result = allocateMemory(VDO_BLOCK_SIZE, 0, "kvio scratch",
-                          &dataKVIO->scratchBlock);
-  if (result != VDO_SUCCESS) {
-    freePooledDataKVIO(layer, dataKVIO);
-    return logErrorWithStringError(result,
-                                   "DataKVIO scratch allocation failure");
-  }
-
   *dataKVIOPtr = dataKVIO;
   return VDO_SUCCESS;
 }
@@ -1185,8 +1666,23 @@ DataLocation getDedupeAdvice(const DedupeContext *context)
 }
 
 /**********************************************************************/
-void setDedupeAdvice(DedupeContext *context, const DataLocation *advice)
+uint64_t getDedupeAdviceGeneration(const DedupeContext *context)
+{
+  DataKVIO *dataKVIO = container_of(context, DataKVIO, dedupeContext);
+  if (!isStrongChunkHasher(getLayerFromDataKVIO(dataKVIO)->chunkHasher)) {
+    return 0;
+  }
+  return getDataVIONewAdviceGeneration(&dataKVIO->dataVIO);
+}
+
+/**********************************************************************/
+void setDedupeAdvice(DedupeContext      *context,
+                     const DataLocation *advice,
+                     uint64_t            generation)
 {
   DataKVIO *dataKVIO = container_of(context, DataKVIO, dedupeContext);
-  receiveDedupeAdvice(&dataKVIO->dataVIO, advice);
+  if (!isStrongChunkHasher(getLayerFromDataKVIO(dataKVIO)->chunkHasher)) {
+    generation = 0;
+  }
+  receiveDedupeAdvice(&dataKVIO->dataVIO, advice, generation);
 }
@@ -26,6 +26,19 @@
 #include "kvio.h"
 #include "uds-block.h"
 
+/**
+ * Whether to run the compressibility estimator on blocks before compressing
+ * them. Settable through sysfs.
+ **/
+extern bool compressibilityEstimation;
+
+/**
+ * Whether to start compressing a write on a CPU thread while its dedupe
+ * query is outstanding, rather than waiting to learn that it will not be
+ * deduplicated. Settable through sysfs.
+ **/
+extern bool speculativeCompression;
+
 typedef struct {
   /*
    * The BIO which was received from the device mapper to initiate an I/O
@@ -60,7 +73,9 @@ typedef struct {
    **/
   char                *data;
   /**
-   * Temporary storage for doing reads from the underlying device.
+   * Temporary storage for doing reads from the underlying device. A write
+   * also uses it to hold its compressed data once it has nothing left to
+   * read.
    **/
   char                *buffer;
   /**
@@ -76,6 +91,20 @@ typedef struct {
    * the data must be uncompressed.
    **/
   BlockMappingState    mappingState;
+  /**
+   * The physical block passed to kvdoReadBlock(), used to find cached
+   * decodings of compressed fragments.
+   **/
+  PhysicalBlockNumber  pbn;
+  /**
+   * Whether the block read should be added to the layer's physical block
+   * cache, once it has been decoded if it is compressed.
+   **/
+  bool                 cacheOnDecode;
+  /**
+   * The stamp from the physical block cache lookup which missed.
+   **/
+  uint64_t             cacheStamp;
   /**
    * The result code of the read attempt.
    **/
@@ -89,13 +118,29 @@ struct dataKVIO {
   KVIO               kvio;
   /* The BIO from the request which is being serviced by this KVIO. */
   ExternalIORequest  externalIORequest;
+  /* The time, in nanoseconds, at which the request was launched */
+  uint64_t           launchTime;
+  /* The intake class whose permit this request holds */
+  IntakeClass        intakeClass;
+  /* The CPU on which the request was submitted */
+  unsigned int       submitCPU;
   /* Dedupe */
   DedupeContext      dedupeContext;
+  /* Speculative compression alongside the dedupe query */
+  KvdoWorkItem       speculationItem;
+  /* The number of the query and the compression still running */
+  atomic_t           speculationLegs;
+  /* Whether the dedupe query is racing a speculative compression */
+  bool               speculating;
+  /* Whether the compression results are from a speculation still valid */
+  bool               speculationValid;
   /* Read cache */
   ReadBlock          readBlock;
   /* partial block support */
   BlockSize          offset;
   bool               isPartial;
+  /* true if a partial read was read straight into the requestor's bio */
+  bool               isDirectRead;
   /* discard support */
   bool               hasDiscardPermit;
   DiscardSize        remainingDiscard;
@@ -105,13 +150,12 @@ struct dataKVIO {
    * thus losing access to the original data.
    *
    * Also used as buffer space for read-modify-write cycles when
-   * emulating smaller-than-blockSize I/O operations.
+   * emulating smaller-than-blockSize I/O operations, and to hold the
+   * uncompressed data of a read of a compressed block.
    **/
   char              *dataBlock;
   /** A bio structure describing the #dataBlock buffer. */
   BIO               *dataBlockBio;
-  /** A block used as output during compression or uncompression. */
-  char              *scratchBlock;
 };
 
 /**
@@ -270,7 +314,7 @@ static inline void launchDataKVIOOnCPUQueue(DataKVIO         *dataKVIO,
 }
 
 /**
- * Set up and enqueue a DataKVIO on the BIO Ack queue.
+ * Set up a DataKVIO and add it to a batch to be run on the BIO Ack queue.
  *
  * @param dataKVIO       The DataKVIO to set up
  * @param work           The function pointer to execute
@@ -283,7 +327,10 @@ static inline void launchDataKVIOOnBIOAckQueue(DataKVIO         *dataKVIO,
                                                unsigned int      action)
 {
   KVIO *kvio = dataKVIOAsKVIO(dataKVIO);
-  launchKVIO(kvio, work, statsFunction, action, kvio->layer->bioAckQueue);
+  setupKVIOWork(kvio, work, statsFunction, action);
+  addToBatchProcessor(getBioAckBatchProcessor(kvio->layer,
+                                              dataKVIO->submitCPU),
+                      &kvio->enqueueable.workItem);
 }
 
 /**
@@ -296,6 +343,31 @@ static inline void kvdoEnqueueDataVIOCallback(DataKVIO *dataKVIO)
   kvdoEnqueueVIOCallback(dataKVIOAsKVIO(dataKVIO));
 }
 
+/**
+ * Note that the dedupe query or the speculative compression of a DataKVIO
+ * which is doing both at once has finished.
+ *
+ * @param dataKVIO  The DataKVIO
+ *
+ * @return <code>true</code> if nothing else is running on behalf of the
+ *         DataKVIO, so the caller should continue it
+ **/
+static inline bool finishSpeculationLeg(DataKVIO *dataKVIO)
+{
+  if (!dataKVIO->speculating) {
+    return true;
+  }
+
+  // Only the second leg to finish may clear the flag, which the first leg
+  // has already read.
+  if (!atomic_dec_and_test(&dataKVIO->speculationLegs)) {
+    return false;
+  }
+
+  dataKVIO->speculating = false;
+  return true;
+}
+
 /**
  * Check whether the external request bio had FUA set.
  *
@@ -313,8 +385,8 @@ static inline bool requestorSetFUA(DataKVIO *dataKVIO)
  * processing the KVIO.
  *
  * If setting up a KVIO fails, a message is logged, and the limiter permits
- * (request and maybe discard) released, but the caller is responsible for
- * disposing of the bio.
+ * (request, intake class, and maybe discard) released, but the caller is
+ * responsible for disposing of the bio.
  *
  * @param layer                 The physical layer
  * @param bio                   The bio for which to create KVIO
@@ -322,13 +394,16 @@ static inline bool requestorSetFUA(DataKVIO *dataKVIO)
  *                              entered the device mapbio function
  * @param hasDiscardPermit      Whether we got a permit from the discardLimiter
  *                              of the kernel layer
+ * @param intakeClass           The intake class whose permit was taken, or
+ *                              INTAKE_CLASS_NONE
  *
  * @return VDO_SUCCESS or a system error code
  **/
 int kvdoLaunchDataKVIOFromBio(KernelLayer *layer,
                               BIO         *bio,
                               Jiffies      arrivalTime,
-                              bool         hasDiscardPermit)
+                              bool         hasDiscardPermit,
+                              IntakeClass  intakeClass)
   __attribute__((warn_unused_result));
 
 /**
@@ -341,6 +416,39 @@ int kvdoLaunchDataKVIOFromBio(KernelLayer *layer,
  **/
 void returnDataKVIOBatchToPool(BatchProcessor *batch, void *closure);
 
+/**
+ * Hash a batch of DataKVIOs, several blocks at a time, and continue each of
+ * them once its chunk name has been set.
+ *
+ * <p>Implements BatchProcessorCallback.
+ *
+ * @param batch    The batch processor
+ * @param closure  The kernel layer
+ **/
+void hashDataKVIOBatch(BatchProcessor *batch, void *closure);
+
+/**
+ * Compress a batch of DataKVIOs using a single compression context, and
+ * continue each of them once it has been compressed.
+ *
+ * <p>Implements BatchProcessorCallback.
+ *
+ * @param batch    The batch processor
+ * @param closure  The compression context owned by the batch processor
+ **/
+void compressDataKVIOBatch(BatchProcessor *batch, void *closure);
+
+/**
+ * Run the work functions of a batch of DataKVIOs which have been set up to
+ * be acknowledged on the bio ack queue.
+ *
+ * <p>Implements BatchProcessorCallback.
+ *
+ * @param batch    The batch processor
+ * @param closure  The kernel layer
+ **/
+void acknowledgeDataKVIOBatch(BatchProcessor *batch, void *closure);
+
 /**
  * Implements DataVIOZeroer.
  *
@@ -455,14 +563,30 @@ int makeDataKVIOBufferPool(KernelLayer  *layer,
 DataLocation getDedupeAdvice(const DedupeContext *context)
   __attribute__((warn_unused_result));
 
+/**
+ * Get the free generation with which to stamp the advice from the DataKVIO
+ * associated with a DedupeContext. Advice is only stamped if the layer names
+ * chunks strongly enough for unchanged advice to be trusted.
+ *
+ * @param context  The DedupeContext
+ *
+ * @return the free generation of the advice PBN, or 0 if the advice should
+ *         not be stamped
+ **/
+uint64_t getDedupeAdviceGeneration(const DedupeContext *context)
+  __attribute__((warn_unused_result));
+
 /**
  * Set the result of a dedupe query for the DataKVIO associated with a
  * DedupeContext.
  *
- * @param context  The context receiving advice
- * @param advice   A data location at which the chunk named in the context
- *                 might be stored (will be NULL if no advice was found)
+ * @param context     The context receiving advice
+ * @param advice      A data location at which the chunk named in the context
+ *                    might be stored (will be NULL if no advice was found)
+ * @param generation  The free generation the advice was stamped with, or 0
  **/
-void setDedupeAdvice(DedupeContext *context, const DataLocation *advice);
+void setDedupeAdvice(DedupeContext      *context,
+                     const DataLocation *advice,
+                     uint64_t            generation);
 
 #endif /* DATA_KVIO_H */
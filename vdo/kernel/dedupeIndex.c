@@ -29,17 +29,55 @@
 unsigned int albireoTimeoutInterval  = 5000;
 unsigned int minAlbireoTimerInterval = 100;
 
+// Whether to derive the timeout from the observed index latency
+bool adaptiveAlbireoTimeout = false;
+
+// The depth of the index read queue for indexes opened from now on, or 0
+// for the UDS default
+unsigned int indexReadQueueDepth = 0;
+
+// Whether dedupe responses are gathered into one batch per hash zone thread
+bool batchedDedupeCallbacks = false;
+
+// Whether indexes opened from now on read their master index in the
+// background
+bool indexLazyLoad = false;
+
+// The master index memory budget in megabytes for indexes opened from now
+// on, or 0 for no budget
+unsigned int indexMemoryBudget = 0;
+
+// The number of zone threads for indexes opened from now on, or 0 for one
+// per pair of cores
+unsigned int indexZoneCount = 0;
+
+// Whether indexes opened from now on bypass dm-bufio when reading volume
+// pages
+bool indexDirectReads = false;
+
+// Whether to stop posting writes to logical regions which are not deduping
+bool adaptiveDedupeBypass = false;
+
+// One in this many writes to a bypassed region is still posted
+unsigned int dedupeBypassSampleInterval = 64;
+
 // These times are in jiffies
 Jiffies albireoTimeoutJiffies = 0;
 static Jiffies minAlbireoTimerJiffies = 0;
 
 /**********************************************************************/
-Jiffies getAlbireoTimeout(Jiffies startJiffies)
+Jiffies getAlbireoDeadline(Jiffies startJiffies, Jiffies timeoutJiffies)
 {
-  return maxULong(startJiffies + albireoTimeoutJiffies,
+  return maxULong(startJiffies + timeoutJiffies,
                   jiffies + minAlbireoTimerJiffies);
 }
 
+/**********************************************************************/
+Jiffies getAlbireoTimeout(Jiffies startJiffies)
+{
+  return getAlbireoDeadline(startJiffies, albireoTimeoutJiffies);
+}
+
 /**********************************************************************/
 void setAlbireoTimeoutInterval(unsigned int value)
 {
@@ -23,9 +23,21 @@
 #define DEDUPE_INDEX_H
 
 #include "dataKVIO.h"
+#include "indexBenchmark.h"
 
 struct dedupeIndex {
 
+  /**
+   * Run a synthetic workload against the index and log the results.
+   *
+   * @param index       The dedupe index
+   * @param parameters  The shape of the workload
+   *
+   * @return 0 or an error code
+   **/
+  int (*benchmark)(DedupeIndex                    *index,
+                   const IndexBenchmarkParameters *parameters);
+
   /**
    * Do the dedupe section of dmsetup message vdo0 0 dump ...
    *
@@ -152,6 +164,20 @@ struct dedupeIndex {
 int makeDedupeIndex(DedupeIndex **indexPtr, KernelLayer *layer)
   __attribute__((warn_unused_result));
 
+/**
+ * Run a synthetic workload against the index and log the results.
+ *
+ * @param index       The dedupe index
+ * @param parameters  The shape of the workload
+ *
+ * @return 0 or an error code
+ **/
+static inline int
+benchmarkDedupeIndex(DedupeIndex                    *index,
+                     const IndexBenchmarkParameters *parameters)
+{
+  return index->benchmark(index, parameters);
+}
 
 /**
  * Do the dedupe section of dmsetup message vdo0 0 dump ...
@@ -201,6 +227,9 @@ static inline void getIndexStatistics(DedupeIndex     *index,
   return index->getStatistics(index, stats);
 }
 
+// Whether dedupe responses are batched per hash zone thread
+extern bool batchedDedupeCallbacks;
+
 /**
  * Return from a dedupe operation by invoking the callback function
  *
@@ -210,7 +239,15 @@ static inline void invokeDedupeCallback(DataKVIO *dataKVIO)
 {
 
   dataKVIOAddTraceRecord(dataKVIO, THIS_LOCATION("$F($dup);cb=dedupe($dup)"));
-  kvdoEnqueueDataVIOCallback(dataKVIO);
+  if (!finishSpeculationLeg(dataKVIO)) {
+    return;
+  }
+
+  if (batchedDedupeCallbacks) {
+    kvdoEnqueueVIOCallbackBatched(dataKVIOAsKVIO(dataKVIO));
+  } else {
+    kvdoEnqueueDataVIOCallback(dataKVIO);
+  }
 }
 
 /**
@@ -343,6 +380,43 @@ extern Jiffies      albireoTimeoutJiffies;
 // check for requests waiting for Albireo that should now time out.
 extern unsigned int minAlbireoTimerInterval;
 
+// If true, the interval until requests time out is derived from the recent
+// latency of the index, and albireoTimeoutInterval is only used until enough
+// requests have been answered.
+extern bool         adaptiveAlbireoTimeout;
+
+// The maximum number of queued volume page reads in indexes opened from now
+// on, or 0 for the UDS default.
+extern unsigned int indexReadQueueDepth;
+
+// If true, indexes opened from now on accept requests before their master
+// index has been read completely, and give no advice for the names whose
+// entries have not been read yet.
+extern bool         indexLazyLoad;
+
+// The number of megabytes of memory the master index of indexes opened from
+// now on may use, or 0 for the size each index was created with. Indexes
+// over budget expire their oldest chapters until they fit.
+extern unsigned int indexMemoryBudget;
+
+// The number of zone threads of indexes opened from now on, or 0 to derive
+// it from the number of cores. This is independent of the hash zone count,
+// and a saved index may be loaded with any number of zones.
+extern unsigned int indexZoneCount;
+
+// If true, indexes opened from now on read volume pages straight into their
+// page caches instead of through dm-bufio.
+extern bool         indexDirectReads;
+
+// If true, writes to regions of the logical space where recent posts have
+// found almost no duplicates are not posted to the index, except for one in
+// every dedupeBypassSampleInterval, which still adds its name to the index
+// and shows when duplicates start to be found again.
+extern bool         adaptiveDedupeBypass;
+
+// The number of writes to a bypassed region per write still posted.
+extern unsigned int dedupeBypassSampleInterval;
+
 /**
  * Calculate the actual end of a timer, taking into account the absolute
  * start time and the present time.
@@ -353,6 +427,17 @@ extern unsigned int minAlbireoTimerInterval;
  **/
 Jiffies getAlbireoTimeout(Jiffies startJiffies);
 
+/**
+ * Calculate the actual end of a timer for a given timeout interval, taking
+ * into account the absolute start time and the present time.
+ *
+ * @param startJiffies    The absolute start time, in jiffies
+ * @param timeoutJiffies  The interval until the timeout, in jiffies
+ *
+ * @return the absolute end time for the timer, in jiffies
+ **/
+Jiffies getAlbireoDeadline(Jiffies startJiffies, Jiffies timeoutJiffies);
+
 /**
  * Set the interval from submission until switching to fast path and
  * skipping Albireo.
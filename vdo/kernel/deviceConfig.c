@@ -21,7 +21,10 @@
 
 #include "deviceConfig.h"
 
+#include <linux/blkdev.h>
+#include <linux/cpumask.h>
 #include <linux/device-mapper.h>
+#include <linux/nodemask.h>
 
 #include "logger.h"
 #include "memoryAlloc.h"
@@ -39,7 +42,12 @@ enum {
   BIO_ROTATION_INTERVAL_LIMIT = 1024,
   LOGICAL_THREAD_COUNT_LIMIT  = 60,
   PHYSICAL_THREAD_COUNT_LIMIT = 16,
+  PACKER_THREAD_COUNT_LIMIT   = 16,
   THREAD_COUNT_LIMIT          = 100,
+  // The largest LZ4 acceleration factor worth asking for
+  COMPRESSION_LEVEL_LIMIT     = 65537,
+  // The largest RAID stripe, in blocks, which allocations will align to
+  STRIPE_BLOCKS_LIMIT         = 1 << 16,
   // XXX The bio-submission queue configuration defaults are temporarily
   // still being defined here until the new runtime-based thread
   // configuration has been fully implemented for managed VDO devices.
@@ -116,6 +124,77 @@ int getPoolNameFromArgv(int    argc,
   return VDO_SUCCESS;
 }
 
+/**
+ * Round a zone count up to a multiple of the number of NUMA nodes, so that
+ * spreading the zones over the nodes leaves none of them short, unless
+ * that would exceed the limit for the zone type.
+ *
+ * @param count  The zone count
+ * @param nodes  The number of online NUMA nodes
+ * @param limit  The most zones of the type allowed
+ *
+ * @return The rounded zone count
+ **/
+static int roundToNodes(int count, int nodes, int limit)
+{
+  int rounded = roundup(count, nodes);
+  return ((rounded <= limit) ? rounded : count);
+}
+
+/**
+ * Choose the thread counts of a config from the online CPUs, the NUMA nodes
+ * and the underlying device. A quarter of the CPUs are given to each kind
+ * of zone and to the CPU threads, with no zone threads at all if there are
+ * too few CPUs to spare them. A rotational device gets one physical zone
+ * and one bio thread so that its writes stay in one sequential stream;
+ * otherwise there is a bio thread for each hardware queue the device has,
+ * up to the same quarter of the CPUs.
+ *
+ * @param config        The config whose thread counts are to be chosen
+ * @param requestQueue  The request queue of the underlying device
+ **/
+static void chooseAutomaticThreadCounts(DeviceConfig         *config,
+                                        struct request_queue *requestQueue)
+{
+  int  cpus       = num_online_cpus();
+  int  nodes      = num_online_nodes();
+  int  quarter    = max(cpus / 4, 1);
+  bool rotational = !blk_queue_nonrot(requestQueue);
+  int  hwQueues   = ((requestQueue->mq_ops != NULL)
+                     ? requestQueue->nr_hw_queues : 1);
+
+  ThreadCountConfig *counts = &config->threadCounts;
+  counts->cpuThreads    = min(quarter, (int) THREAD_COUNT_LIMIT);
+  counts->bioAckThreads = max(cpus / 8, 1);
+  counts->bioThreads    = (rotational ? 1 : clamp(hwQueues, 1, quarter));
+  counts->packerZones   = 1;
+  if (cpus < 4) {
+    counts->logicalZones  = 0;
+    counts->physicalZones = 0;
+    counts->hashZones     = 0;
+  } else {
+    counts->logicalZones
+      = roundToNodes(min(quarter, (int) LOGICAL_THREAD_COUNT_LIMIT), nodes,
+                     LOGICAL_THREAD_COUNT_LIMIT);
+    counts->physicalZones
+      = (rotational
+         ? 1
+         : roundToNodes(min(quarter, (int) PHYSICAL_THREAD_COUNT_LIMIT),
+                        nodes, PHYSICAL_THREAD_COUNT_LIMIT));
+    counts->hashZones
+      = roundToNodes(min(quarter, (int) THREAD_COUNT_LIMIT), nodes,
+                     THREAD_COUNT_LIMIT);
+  }
+
+  logInfo("Using automatic thread counts for %d CPUs on %d NUMA nodes and a"
+          " %s device with %d hardware queues: cpu=%d, ack=%d, bio=%d,"
+          " logical=%d, physical=%d, hash=%d, packer=%d", cpus, nodes,
+          (rotational ? "rotational" : "non-rotational"), hwQueues,
+          counts->cpuThreads, counts->bioAckThreads, counts->bioThreads,
+          counts->logicalZones, counts->physicalZones, counts->hashZones,
+          counts->packerZones);
+}
+
 /**
  * Resolve the config with write policy, physical size, and other unspecified
  * fields based on the device, if needed.
@@ -160,6 +239,10 @@ static void resolveConfigWithDevice(DeviceConfig  *config,
                " is dangerous!");
   }
 
+  if (config->autoThreadsEnabled) {
+    chooseAutomaticThreadCounts(config, requestQueue);
+  }
+
   if (config->version == 0) {
     uint64_t deviceSize = i_size_read(dev->bdev->bd_inode);
     config->physicalBlocks = deviceSize / VDO_BLOCK_SIZE;
@@ -195,6 +278,77 @@ static inline int parseBool(const char *boolStr,
   return VDO_SUCCESS;
 }
 
+/**
+ * Parse the name of a block map cache replacement policy.
+ *
+ * @param [in]  name       The name of the policy
+ * @param [out] policyPtr  A pointer to hold the policy
+ *
+ * @return VDO_SUCCESS or -EINVAL if the name is unknown
+ **/
+__attribute__((warn_unused_result))
+static int parseCachePolicy(const char *name, PageCachePolicy *policyPtr)
+{
+  if (strcmp(name, "lru") == 0) {
+    *policyPtr = PAGE_CACHE_POLICY_LRU;
+  } else if (strcmp(name, "2q") == 0) {
+    *policyPtr = PAGE_CACHE_POLICY_2Q;
+  } else {
+    logError("unknown block map cache policy \"%s\"", name);
+    return -EINVAL;
+  }
+
+  return VDO_SUCCESS;
+}
+
+/**
+ * Parse the name of a recovery journal commit policy.
+ *
+ * @param [in]  name       The name of the policy
+ * @param [out] policyPtr  A pointer to hold the policy
+ *
+ * @return VDO_SUCCESS or -EINVAL if the name is unknown
+ **/
+__attribute__((warn_unused_result))
+static int parseJournalCommitPolicy(const char          *name,
+                                    JournalCommitPolicy *policyPtr)
+{
+  if (strcmp(name, "flush") == 0) {
+    *policyPtr = JOURNAL_COMMIT_FLUSH;
+  } else if (strcmp(name, "fua") == 0) {
+    *policyPtr = JOURNAL_COMMIT_FUA;
+  } else {
+    logError("unknown journal commit policy \"%s\"", name);
+    return -EINVAL;
+  }
+
+  return VDO_SUCCESS;
+}
+
+/**
+ * Parse the name of a physical zone allocation policy.
+ *
+ * @param [in]  name       The name of the policy
+ * @param [out] policyPtr  A pointer to hold the policy
+ *
+ * @return VDO_SUCCESS or -EINVAL if the name is unknown
+ **/
+__attribute__((warn_unused_result))
+static int parseAllocationPolicy(const char       *name,
+                                 AllocationPolicy *policyPtr)
+{
+  if (strcmp(name, "roundrobin") == 0) {
+    *policyPtr = ALLOCATION_POLICY_ROUND_ROBIN;
+  } else if (strcmp(name, "locality") == 0) {
+    *policyPtr = ALLOCATION_POLICY_LOCALITY;
+  } else {
+    logError("unknown allocation policy \"%s\"", name);
+    return -EINVAL;
+  }
+
+  return VDO_SUCCESS;
+}
+
 /**
  * Process one component of a thread parameter configuration string and
  * update the configuration data structure.
@@ -245,6 +399,19 @@ static int processOneThreadConfigSpec(const char        *threadParamType,
     }
     config->physicalZones = count;
     return VDO_SUCCESS;
+  } else if (strcmp(threadParamType, "packer") == 0) {
+    if (count == 0) {
+      logError("thread config string error:"
+               " at least one 'packer' thread required");
+      return -EINVAL;
+    } else if (count > PACKER_THREAD_COUNT_LIMIT) {
+      logError("thread config string error: at most %d 'packer' threads"
+               " are allowed",
+               PACKER_THREAD_COUNT_LIMIT);
+      return -EINVAL;
+    }
+    config->packerZones = count;
+    return VDO_SUCCESS;
   } else {
     // Handle other thread count parameters
     if (count > THREAD_COUNT_LIMIT) {
@@ -328,7 +495,7 @@ static int parseOneThreadConfigSpec(const char        *spec,
  *
  * The configuration string should contain one or more comma-separated specs
  * of the form "typename=number"; the supported type names are "cpu", "ack",
- * "bio", "bioRotationInterval", "logical", "physical", and "hash".
+ * "bio", "bioRotationInterval", "logical", "physical", "hash", and "packer".
  *
  * If an error occurs during parsing of a single key/value pair, we deem
  * it serious enough to stop further parsing.
@@ -399,6 +566,34 @@ static int processOneKeyValuePair(const char   *key,
     config->maxDiscardBlocks = value;
     return VDO_SUCCESS;
   }
+  if (strcmp(key, "readCache") == 0) {
+    if ((value == 0) || ((value & (value - 1)) != 0)
+        || (value > MAX_PHYSICAL_BLOCK_CACHE_BLOCKS)) {
+      logError("optional parameter error: the read cache must be a power of"
+               " two blocks, at most %d", MAX_PHYSICAL_BLOCK_CACHE_BLOCKS);
+      return -EINVAL;
+    }
+    config->readCacheBlocks = value;
+    return VDO_SUCCESS;
+  }
+  if (strcmp(key, "stripeBlocks") == 0) {
+    if (value > STRIPE_BLOCKS_LIMIT) {
+      logError("optional parameter error: a stripe can be at most %d blocks",
+               STRIPE_BLOCKS_LIMIT);
+      return -EINVAL;
+    }
+    config->stripeBlocks = value;
+    return VDO_SUCCESS;
+  }
+  if (strcmp(key, "compressionLevel") == 0) {
+    if (value > COMPRESSION_LEVEL_LIMIT) {
+      logError("optional parameter error: compression level cannot be"
+               " higher than %d", COMPRESSION_LEVEL_LIMIT);
+      return -EINVAL;
+    }
+    config->compressionLevel = value;
+    return VDO_SUCCESS;
+  }
   // Handles unknown key names
   return processOneThreadConfigSpec(key, value, &config->threadCounts);
 }
@@ -417,6 +612,92 @@ static int parseOneKeyValuePair(const char   *key,
 				const char   *value,
                                 DeviceConfig *config)
 {
+  // The non-integer optional parameters
+  if (strcmp(key, "compression") == 0) {
+    return parseCompressionEngine(value, &config->compressionEngine);
+  }
+  if (strcmp(key, "dedupeHash") == 0) {
+    return parseDedupeHash(value, &config->dedupeHash);
+  }
+  if (strcmp(key, "numa") == 0) {
+    return parseNumaPlacement(value, &config->numaPlacement);
+  }
+  if (strcmp(key, "cachePolicy") == 0) {
+    return parseCachePolicy(value, &config->cachePolicy);
+  }
+  if (strcmp(key, "journalCommit") == 0) {
+    return parseJournalCommitPolicy(value, &config->journalCommitPolicy);
+  }
+  if (strcmp(key, "allocationPolicy") == 0) {
+    return parseAllocationPolicy(value, &config->allocationPolicy);
+  }
+  if (strcmp(key, "journalDevice") == 0) {
+    FREE(config->journalDeviceName);
+  FREE(config->indexDeviceName);
+    return duplicateString(value, "journal device name",
+                           &config->journalDeviceName);
+  }
+  if (strcmp(key, "indexDevice") == 0) {
+    FREE(config->indexDeviceName);
+    return duplicateString(value, "index device name",
+                           &config->indexDeviceName);
+  }
+  if (strcmp(key, "journalDeviceSummary") == 0) {
+    int result = parseBool(value, "on", "off", &config->journalDeviceSummary);
+    if (result != VDO_SUCCESS) {
+      logError("journalDeviceSummary must be \"on\" or \"off\","
+               " found \"%s\"", value);
+      return -EINVAL;
+    }
+    return VDO_SUCCESS;
+  }
+  if (strcmp(key, "journalDeviceMetadata") == 0) {
+    int result = parseBool(value, "on", "off",
+                           &config->journalDeviceMetadata);
+    if (result != VDO_SUCCESS) {
+      logError("journalDeviceMetadata must be \"on\" or \"off\","
+               " found \"%s\"", value);
+      return -EINVAL;
+    }
+    return VDO_SUCCESS;
+  }
+  if (strcmp(key, "bioPolling") == 0) {
+    int result = parseBool(value, "on", "off", &config->bioPollingEnabled);
+    if (result != VDO_SUCCESS) {
+      logError("bioPolling must be \"on\" or \"off\", found \"%s\"",
+               value);
+      return -EINVAL;
+    }
+    return VDO_SUCCESS;
+  }
+  if (strcmp(key, "ackAffinity") == 0) {
+    int result = parseBool(value, "on", "off", &config->ackAffinityEnabled);
+    if (result != VDO_SUCCESS) {
+      logError("ackAffinity must be \"on\" or \"off\", found \"%s\"",
+               value);
+      return -EINVAL;
+    }
+    return VDO_SUCCESS;
+  }
+  if (strcmp(key, "autoThreads") == 0) {
+    int result = parseBool(value, "on", "off", &config->autoThreadsEnabled);
+    if (result != VDO_SUCCESS) {
+      logError("autoThreads must be \"on\" or \"off\", found \"%s\"",
+               value);
+      return -EINVAL;
+    }
+    return VDO_SUCCESS;
+  }
+  if (strcmp(key, "ramBacking") == 0) {
+    int result = parseBool(value, "on", "off", &config->ramBackingEnabled);
+    if (result != VDO_SUCCESS) {
+      logError("ramBacking must be \"on\" or \"off\", found \"%s\"",
+               value);
+      return -EINVAL;
+    }
+    return VDO_SUCCESS;
+  }
+
   unsigned int count;
   int result = stringToUInt(value, &count);
   if (result != UDS_SUCCESS) {
@@ -469,7 +750,7 @@ static int parseKeyValuePairs(int            argc,
  * the thread configuration. The configuration string should contain
  * one or more comma-separated specs of the form "typename=number"; the
  * supported type names are "cpu", "ack", "bio", "bioRotationInterval",
- * "logical", "physical", and "hash".
+ * "logical", "physical", "hash", and "packer".
  *
  * For V2 configurations and beyond, there could be any number of
  * arguments. They should contain one or more key/value pairs
@@ -566,8 +847,22 @@ int parseDeviceConfig(int                argc,
     .logicalZones        = 0,
     .physicalZones       = 0,
     .hashZones           = 0,
+    .packerZones         = 1,
   };
-  config->maxDiscardBlocks = 1;
+  config->maxDiscardBlocks    = 1;
+  config->readCacheBlocks     = DEFAULT_PHYSICAL_BLOCK_CACHE_BLOCKS;
+  config->stripeBlocks        = 0;
+  config->compressionEngine   = COMPRESSION_ENGINE_LZ4;
+  config->compressionLevel    = 0;
+  config->dedupeHash          = DEDUPE_HASH_MURMUR3;
+  config->numaPlacement       = NUMA_PLACEMENT_NONE;
+  config->cachePolicy         = PAGE_CACHE_POLICY_LRU;
+  config->journalCommitPolicy = JOURNAL_COMMIT_FLUSH;
+  config->allocationPolicy    = ALLOCATION_POLICY_ROUND_ROBIN;
+  config->bioPollingEnabled   = false;
+  config->ackAffinityEnabled  = false;
+  config->ramBackingEnabled   = false;
+  config->autoThreadsEnabled  = false;
 
   struct dm_arg_set argSet;
 
@@ -701,6 +996,36 @@ int parseDeviceConfig(int                argc,
     return VDO_BAD_CONFIGURATION;
   }
 
+  if (config->journalDeviceName != NULL) {
+    result = dm_get_device(ti, config->journalDeviceName,
+                           dm_table_get_mode(ti->table),
+                           &config->journalDevice);
+    if (result != 0) {
+      logError("couldn't open journal device \"%s\": error %d",
+               config->journalDeviceName, result);
+      handleParseError(&config, errorPtr, "Unable to open journal device");
+      return VDO_BAD_CONFIGURATION;
+    }
+  } else if (config->journalDeviceSummary
+             || config->journalDeviceMetadata) {
+    handleParseError(&config, errorPtr,
+                     "Placing metadata on a journal device requires a"
+                     " journalDevice");
+    return VDO_BAD_CONFIGURATION;
+  }
+
+  if (config->indexDeviceName != NULL) {
+    result = dm_get_device(ti, config->indexDeviceName,
+                           dm_table_get_mode(ti->table),
+                           &config->indexDevice);
+    if (result != 0) {
+      logError("couldn't open index device \"%s\": error %d",
+               config->indexDeviceName, result);
+      handleParseError(&config, errorPtr, "Unable to open index device");
+      return VDO_BAD_CONFIGURATION;
+    }
+  }
+
   resolveConfigWithDevice(config, verbose);
 
   *configPtr = config;
@@ -724,8 +1049,17 @@ void freeDeviceConfig(DeviceConfig **configPtr)
     dm_put_device(config->owningTarget, config->ownedDevice);
   }
 
+  if (config->journalDevice != NULL) {
+    dm_put_device(config->owningTarget, config->journalDevice);
+  }
+
+  if (config->indexDevice != NULL) {
+    dm_put_device(config->owningTarget, config->indexDevice);
+  }
+
   FREE(config->poolName);
   FREE(config->parentDeviceName);
+  FREE(config->journalDeviceName);
   FREE(config->originalString);
 
   // Reduce the chance a use-after-free (as in BZ 1669960) happens to work.
@@ -752,6 +1086,45 @@ const char *getConfigWritePolicyString(DeviceConfig *config)
   }
 }
 
+/**********************************************************************/
+const char *getConfigCachePolicyString(DeviceConfig *config)
+{
+  switch (config->cachePolicy) {
+  case PAGE_CACHE_POLICY_LRU:
+    return "lru";
+  case PAGE_CACHE_POLICY_2Q:
+    return "2q";
+  default:
+    return "unknown";
+  }
+}
+
+/**********************************************************************/
+const char *getConfigJournalCommitPolicyString(DeviceConfig *config)
+{
+  switch (config->journalCommitPolicy) {
+  case JOURNAL_COMMIT_FLUSH:
+    return "flush";
+  case JOURNAL_COMMIT_FUA:
+    return "fua";
+  default:
+    return "unknown";
+  }
+}
+
+/**********************************************************************/
+const char *getConfigAllocationPolicyString(DeviceConfig *config)
+{
+  switch (config->allocationPolicy) {
+  case ALLOCATION_POLICY_ROUND_ROBIN:
+    return "roundrobin";
+  case ALLOCATION_POLICY_LOCALITY:
+    return "locality";
+  default:
+    return "unknown";
+  }
+}
+
 /**********************************************************************/
 void setDeviceConfigLayer(DeviceConfig *config, KernelLayer *layer)
 {
@@ -25,7 +25,10 @@
 
 #include "ringNode.h"
 
+#include "chunkHasher.h"
+#include "compressionEngine.h"
 #include "kernelTypes.h"
+#include "numaPlacement.h"
 
 // This structure is memcmp'd for equality. Keep it
 // packed and don't add any fields that are not
@@ -38,6 +41,7 @@ typedef struct {
   int logicalZones;
   int physicalZones;
   int hashZones;
+  int packerZones;
 } __attribute__((packed)) ThreadCountConfig;
 
 typedef uint32_t TableVersion;
@@ -57,9 +61,49 @@ typedef struct {
   unsigned int       cacheSize;
   unsigned int       blockMapMaximumAge;
   bool               mdRaid5ModeEnabled;
+  /**
+   * The number of data blocks in a full stripe of a parity RAID device, or
+   * 0 if allocations and writes should ignore stripes
+   **/
+  BlockCount         stripeBlocks;
+  bool               bioPollingEnabled;
+  /**
+   * Whether each bio is acknowledged by a bio ack thread on the NUMA node of
+   * the CPU which submitted it
+   **/
+  bool               ackAffinityEnabled;
+  /** Whether all I/O is held in memory rather than sent to the devices */
+  bool               ramBackingEnabled;
+  /**
+   * Whether the thread counts are chosen from the CPUs and the device,
+   * overriding any which were given
+   **/
+  bool               autoThreadsEnabled;
+  /** The device holding the recovery journal, if not the parent device */
+  char              *journalDeviceName;
+  struct dm_dev     *journalDevice;
+  /** Whether the slab summary is on the journal device too */
+  bool               journalDeviceSummary;
+  /**
+   * Whether the block map roots and the reference counts and journals of
+   * the slabs are on the journal device too
+   **/
+  bool               journalDeviceMetadata;
+  /** The device holding the dedupe index, if not the parent device */
+  char              *indexDeviceName;
+  struct dm_dev     *indexDevice;
   char              *poolName;
   ThreadCountConfig  threadCounts;
   BlockCount         maxDiscardBlocks;
+  /** The number of blocks the physical block cache holds */
+  BlockCount         readCacheBlocks;
+  CompressionEngine  compressionEngine;
+  unsigned int       compressionLevel;
+  DedupeHash         dedupeHash;
+  NumaPlacement      numaPlacement;
+  PageCachePolicy    cachePolicy;
+  JournalCommitPolicy journalCommitPolicy;
+  AllocationPolicy   allocationPolicy;
 } DeviceConfig;
 
 /**
@@ -128,6 +172,36 @@ void freeDeviceConfig(DeviceConfig **configPtr);
 const char *getConfigWritePolicyString(DeviceConfig *config)
   __attribute__((warn_unused_result));
 
+/**
+ * Get the text describing the block map cache replacement policy.
+ *
+ * @param config  The device config
+ *
+ * @returns a pointer to a string describing the cache policy
+ **/
+const char *getConfigCachePolicyString(DeviceConfig *config)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the text describing how recovery journal commits are made stable.
+ *
+ * @param config  The device config
+ *
+ * @returns a pointer to a string describing the journal commit policy
+ **/
+const char *getConfigJournalCommitPolicyString(DeviceConfig *config)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the text describing how writes choose a physical zone.
+ *
+ * @param config  The device config
+ *
+ * @returns a pointer to a string describing the allocation policy
+ **/
+const char *getConfigAllocationPolicyString(DeviceConfig *config)
+  __attribute__((warn_unused_result));
+
 /**
  * Acquire or release a reference from the config to a kernel layer.
  *
@@ -31,6 +31,7 @@
 #include "threadConfig.h"
 #include "vdo.h"
 
+#include "benchmark.h"
 #include "dedupeIndex.h"
 #include "deviceRegistry.h"
 #include "dump.h"
@@ -44,6 +45,7 @@
 #include "sysfs.h"
 #include "threadDevice.h"
 #include "threadRegistry.h"
+#include "vdoStringUtils.h"
 
 struct kvdoDevice kvdoDevice;   // global driver state (poorly named)
 
@@ -306,8 +308,15 @@ static BlockCount getUnderlyingDeviceBlockCount(KernelLayer *layer)
   return physicalSize / VDO_BLOCK_SIZE;
 }
 
-/**********************************************************************/
-static int vdoPrepareToGrowLogical(KernelLayer *layer, char *sizeString)
+/**
+ * Parse the logical block count of a grow logical message.
+ *
+ * @param [in]  sizeString       The count from the message
+ * @param [out] logicalCountPtr  A pointer to hold the count
+ *
+ * @return VDO_SUCCESS or -EINVAL
+ **/
+static int parseLogicalBlockCount(char *sizeString, BlockCount *logicalCountPtr)
 {
   BlockCount logicalCount;
   if (sscanf(sizeString, "%llu", &logicalCount) != 1) {
@@ -321,9 +330,237 @@ static int vdoPrepareToGrowLogical(KernelLayer *layer, char *sizeString)
     return -EINVAL;
   }
 
+  *logicalCountPtr = logicalCount;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+static int vdoPrepareToGrowLogical(KernelLayer *layer, char *sizeString)
+{
+  BlockCount logicalCount;
+  int result = parseLogicalBlockCount(sizeString, &logicalCount);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
   return prepareToResizeLogical(layer, logicalCount);
 }
 
+/**
+ * Grow the logical size while the device is running. The table reload which
+ * gives the device its new length will then find the VDO already grown.
+ *
+ * @param layer       The layer to grow
+ * @param sizeString  The new logical block count
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+static int vdoGrowLogical(KernelLayer *layer, char *sizeString)
+{
+  if (getKernelLayerState(layer) != LAYER_RUNNING) {
+    logWarning("Can only grow logical size online while running");
+    return -EINVAL;
+  }
+
+  BlockCount logicalCount;
+  int result = parseLogicalBlockCount(sizeString, &logicalCount);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  return growLogicalOnline(layer, logicalCount);
+}
+
+/**********************************************************************/
+static int vdoResizeBlockMapCache(KernelLayer *layer, char *sizeString)
+{
+  PageCount cacheSize;
+  if (sscanf(sizeString, "%u", &cacheSize) != 1) {
+    logWarning("Block map cache size \"%s\" is not a number", sizeString);
+    return -EINVAL;
+  }
+
+  // The table size is the floor; it is what the shrinker returns to.
+  if (cacheSize < layer->deviceConfig->cacheSize) {
+    logWarning("Block map cache size %u is less than the table's size (%u)",
+               cacheSize, layer->deviceConfig->cacheSize);
+    return -EINVAL;
+  }
+
+  int result = kvdoResizeBlockMapCache(&layer->kvdo, cacheSize);
+  if (result == VDO_SUCCESS) {
+    // This is the size the cache regrows to after memory pressure.
+    layer->requestedCacheSize = cacheSize;
+  }
+  return result;
+}
+
+/**
+ * Parse an on or off setting of an LBN policy message.
+ *
+ * @param [in]  value      The setting
+ * @param [in]  flag       The policy flag set by "on"
+ * @param [out] policyPtr  The policy to update
+ *
+ * @return VDO_SUCCESS or -EINVAL
+ **/
+static int parsePolicyFlag(const char *value,
+                           LBNPolicy   flag,
+                           LBNPolicy  *policyPtr)
+{
+  if (strcasecmp(value, "on") == 0) {
+    *policyPtr |= flag;
+    return VDO_SUCCESS;
+  }
+
+  if (strcasecmp(value, "off") == 0) {
+    return VDO_SUCCESS;
+  }
+
+  logWarning("invalid argument '%s' to dmsetup lbn-policy message", value);
+  return -EINVAL;
+}
+
+/**
+ * Set the dedupe and compression policy of a range of logical blocks.
+ *
+ * @param layer     The layer to which the message was sent
+ * @param argv      The arguments of the message: "lbn-policy", the first
+ *                  block, the block count, and "on" or "off" for dedupe and
+ *                  for compression
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+static int vdoSetLBNPolicy(KernelLayer *layer, char **argv)
+{
+  LogicalBlockNumber start;
+  BlockCount         count;
+  if ((sscanf(argv[1], "%llu", &start) != 1)
+      || (sscanf(argv[2], "%llu", &count) != 1)) {
+    logWarning("LBN policy range \"%s %s\" is not a pair of numbers",
+               argv[1], argv[2]);
+    return -EINVAL;
+  }
+
+  // A range may extend beyond the current logical size, so that it covers
+  // blocks added by growing the VDO.
+  if ((count == 0) || (start >= MAXIMUM_LOGICAL_BLOCKS)
+      || (count > MAXIMUM_LOGICAL_BLOCKS - start)) {
+    logWarning("LBN policy range %" PRIu64 "+%" PRIu64 " is empty or exceeds"
+               " the maximum logical block count (%" PRIu64 ")", start, count,
+               MAXIMUM_LOGICAL_BLOCKS);
+    return -EINVAL;
+  }
+
+  LBNPolicy policy = 0;
+  int result = parsePolicyFlag(argv[3], LBN_POLICY_DEDUPE, &policy);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  result = parsePolicyFlag(argv[4], LBN_POLICY_COMPRESS, &policy);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  return kvdoSetLBNPolicy(&layer->kvdo, start, count, policy);
+}
+
+/**
+ * Handle the dmsetup message to run a synthetic workload.
+ *
+ * @param layer  The layer to run the workload on
+ * @param argv   The arguments to the message: the number of requests, the
+ *               queue depth, and the percentages of writes, of duplicate
+ *               writes, and of the compressible part of each write
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+static int vdoRunBenchmark(KernelLayer *layer, char **argv)
+{
+  BenchmarkParameters parameters;
+  unsigned int *values[] = {
+    &parameters.requests,
+    &parameters.queueDepth,
+    &parameters.writePercent,
+    &parameters.dedupePercent,
+    &parameters.compressPercent,
+  };
+  for (unsigned int i = 0; i < COUNT_OF(values); i++) {
+    if (stringToUInt(argv[i + 1], values[i]) != UDS_SUCCESS) {
+      logWarning("benchmark argument \"%s\" is not a number", argv[i + 1]);
+      return -EINVAL;
+    }
+  }
+
+  if ((parameters.requests == 0) || (parameters.queueDepth == 0)
+      || (parameters.queueDepth > layer->requestLimiter.limit)
+      || (parameters.writePercent > 100) || (parameters.dedupePercent > 100)
+      || (parameters.compressPercent > 100)) {
+    logWarning("benchmark needs requests, a queue depth of at most %u, and"
+               " percentages of at most 100", layer->requestLimiter.limit);
+    return -EINVAL;
+  }
+
+  if (getKernelLayerState(layer) != LAYER_RUNNING) {
+    logWarning("benchmark needs a running pool");
+    return -EINVAL;
+  }
+
+  BlockCount logicalBlocks
+    = to_bytes(layer->deviceConfig->owningTarget->len) / VDO_BLOCK_SIZE;
+  return runBenchmark(layer, logicalBlocks, &parameters);
+}
+
+/**
+ * Run a synthetic workload against the dedupe index of a pool. The message
+ * is "index-benchmark <post|query|update> <requests> <queue depth> <repeat
+ * percent>".
+ *
+ * @param layer  The layer to which the message was sent
+ * @param argv   The arguments to the message
+ *
+ * @return 0 or an error code
+ **/
+static int vdoRunIndexBenchmark(KernelLayer *layer, char **argv)
+{
+  IndexBenchmarkParameters parameters;
+  if (strcasecmp(argv[1], "post") == 0) {
+    parameters.operation = UDS_POST;
+  } else if (strcasecmp(argv[1], "query") == 0) {
+    parameters.operation = UDS_QUERY;
+  } else if (strcasecmp(argv[1], "update") == 0) {
+    parameters.operation = UDS_UPDATE;
+  } else {
+    logWarning("index benchmark operation \"%s\" is not post, query,"
+               " or update", argv[1]);
+    return -EINVAL;
+  }
+
+  unsigned int *values[] = {
+    &parameters.requests,
+    &parameters.queueDepth,
+    &parameters.dedupePercent,
+  };
+  for (unsigned int i = 0; i < COUNT_OF(values); i++) {
+    if (stringToUInt(argv[i + 2], values[i]) != UDS_SUCCESS) {
+      logWarning("index benchmark argument \"%s\" is not a number",
+                 argv[i + 2]);
+      return -EINVAL;
+    }
+  }
+
+  if ((parameters.requests == 0) || (parameters.queueDepth == 0)
+      || (parameters.queueDepth > MAX_INDEX_BENCHMARK_DEPTH)
+      || (parameters.dedupePercent > 100)) {
+    logWarning("index benchmark needs requests, a queue depth of at most %u,"
+               " and a percentage of at most 100", MAX_INDEX_BENCHMARK_DEPTH);
+    return -EINVAL;
+  }
+
+  return benchmarkDedupeIndex(layer->dedupeIndex, &parameters);
+}
+
 /**
  * Process a dmsetup message now that we know no other message is being
  * processed.
@@ -417,6 +654,32 @@ static int processVDOMessageLocked(KernelLayer   *layer,
       return vdoPrepareToGrowLogical(layer, argv[1]);
     }
 
+    if (strcasecmp(argv[0], "growLogical") == 0) {
+      return vdoGrowLogical(layer, argv[1]);
+    }
+
+    if (strcasecmp(argv[0], "cacheSize") == 0) {
+      return vdoResizeBlockMapCache(layer, argv[1]);
+    }
+
+    break;
+
+  case 5:
+    if (strcasecmp(argv[0], "lbn-policy") == 0) {
+      return vdoSetLBNPolicy(layer, argv);
+    }
+
+    if (strcasecmp(argv[0], "index-benchmark") == 0) {
+      return vdoRunIndexBenchmark(layer, argv);
+    }
+
+    break;
+
+  case 6:
+    if (strcasecmp(argv[0], "benchmark") == 0) {
+      return vdoRunBenchmark(layer, argv);
+    }
+
     break;
 
 
@@ -622,17 +885,28 @@ static int vdoInitialize(struct dm_target *ti,
   logDebug("Physical blocks        = %" PRIu64, config->physicalBlocks);
   logDebug("Block map cache blocks = %u", config->cacheSize);
   logDebug("Block map maximum age  = %u", config->blockMapMaximumAge);
+  logDebug("Block map cache policy = %s", getConfigCachePolicyString(config));
+  logDebug("Read cache blocks      = %" PRIu64, config->readCacheBlocks);
   logDebug("MD RAID5 mode          = %s", (config->mdRaid5ModeEnabled
                                            ? "on" : "off"));
+  logDebug("Stripe blocks          = %" PRIu64, config->stripeBlocks);
   logDebug("Write policy           = %s", getConfigWritePolicyString(config));
+  logDebug("Journal commit policy  = %s",
+           getConfigJournalCommitPolicyString(config));
+  logDebug("Allocation policy      = %s",
+           getConfigAllocationPolicyString(config));
 
   // The threadConfig will be copied by the VDO if it's successfully
   // created.
   VDOLoadConfig loadConfig = {
-    .cacheSize    = config->cacheSize,
-    .threadConfig = NULL,
-    .writePolicy  = config->writePolicy,
-    .maximumAge   = config->blockMapMaximumAge,
+    .cacheSize           = config->cacheSize,
+    .threadConfig        = NULL,
+    .writePolicy         = config->writePolicy,
+    .maximumAge          = config->blockMapMaximumAge,
+    .cachePolicy         = config->cachePolicy,
+    .journalCommitPolicy = config->journalCommitPolicy,
+    .allocationPolicy    = config->allocationPolicy,
+    .stripeBlocks        = config->stripeBlocks,
   };
 
   char        *failureReason;
@@ -913,6 +1187,7 @@ static void vdoDestroy(void)
     vdoPutSysfs(&kvdoDevice.kobj);
   }
   vdoDestroyProcfs();
+  freeTraceBuffers();
 
   kvdoDevice.status = UNINITIALIZED;
 
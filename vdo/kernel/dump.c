@@ -65,6 +65,14 @@ enum dumpOptionFlags {
   FLAG_SKIP_DEFAULT       = (1 << SKIP_DEFAULT)
   };
 
+enum {
+  /*
+   * The shortest time between dumps requested by message, so that a
+   * triage script repeating dumps of a slow device doesn't make it slower
+   */
+  MINIMUM_DUMP_INTERVAL_SECONDS = 5,
+};
+
 enum {
   FLAGS_ALL_POOLS    = (FLAG_SHOW_VIO_POOL),
   FLAGS_ALL_QUEUES   = (FLAG_SHOW_REQUEST_QUEUE
@@ -195,6 +203,17 @@ int vdoDump(KernelLayer  *layer,
   if (result != 0) {
     return result;
   }
+
+  unsigned long now  = jiffies;
+  unsigned long last = READ_ONCE(layer->lastDumpJiffies);
+  if ((last != 0)
+      && time_before(now, last + (MINIMUM_DUMP_INTERVAL_SECONDS * HZ))) {
+    logInfo("%s dump via %s refused, the last was under %u seconds ago",
+            THIS_MODULE->name, why, MINIMUM_DUMP_INTERVAL_SECONDS);
+    return -EBUSY;
+  }
+  WRITE_ONCE(layer->lastDumpJiffies, now);
+
   doDump(layer, dumpOptionsRequested, why);
   return 0;
 }
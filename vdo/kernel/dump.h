@@ -26,12 +26,16 @@
 
 /**
  * Dump internal state and/or statistics to the kernel log, as
- * specified by zero or more string arguments.
+ * specified by zero or more string arguments. A dump requested within a
+ * few seconds of the previous one for the same layer is refused.
  *
  * @param layer   The kernel layer
  * @param argc    Number of arguments
  * @param argv    The argument list
  * @param why     Reason for doing the dump
+ *
+ * @return 0, -EINVAL if an option is unknown, or -EBUSY if the layer was
+ *         dumped too recently
  **/
 int vdoDump(KernelLayer  *layer,
             unsigned int  argc,
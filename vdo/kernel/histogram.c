@@ -20,6 +20,7 @@
  */
 
 #include <linux/kobject.h>
+#include <linux/percpu.h>
 
 #include "memoryAlloc.h"
 #include "typeDefs.h"
@@ -64,11 +65,39 @@ enum {
  * All internal processing uses the values as passed to enterHistogramSample.
  * Conversions only affect the values seen or input through the /sys interface,
  * including possibly rounding a "limit" value entered.
+ *
+ * A sharded histogram keeps all of its counts per CPU, so that entering a
+ * sample never writes a cache line shared with another CPU; the counts are
+ * summed when they are read. Its buckets follow the HDR histogram scheme:
+ * each power of two is divided into HDR_SUB_BUCKETS linear buckets, so every
+ * bucket is within 1/HDR_SUB_BUCKETS of the values it holds. Rather than the
+ * buckets, it reports the 50th, 99th, and 99.9th percentiles, which are
+ * cheap enough to compute on demand that such histograms can be left
+ * enabled in production even though NO_BUCKETS is set.
  */
 
+enum {
+  HDR_SUB_BUCKET_BITS = 4,
+  HDR_SUB_BUCKETS     = 1 << HDR_SUB_BUCKET_BITS,
+  // Samples of 2^HDR_MAX_BITS or more all go into the final bucket.
+  HDR_MAX_BITS        = 40,
+  HDR_BUCKETS         = (((HDR_MAX_BITS - HDR_SUB_BUCKET_BITS + 1)
+                          * HDR_SUB_BUCKETS) + 1),
+};
+
+typedef struct {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t unacceptable;
+  uint64_t minimum;
+  uint64_t maximum;
+  uint64_t buckets[HDR_BUCKETS];
+} HistogramShard;
+
 struct histogram {
   // These fields are ordered so that enterHistogramSample touches
   // only the first cache line.
+  HistogramShard __percpu *shards; // Per-CPU counts, or NULL if not sharded
   atomic64_t     *counters;     // Counter for each bucket
   uint64_t        limit;        // We want to know how many samples are larger
   atomic64_t      sum;          // Sum of all the samples
@@ -134,6 +163,121 @@ static unsigned int divideRoundingToNearest(uint64_t number, uint64_t divisor)
   return number / divisor;
 }
 
+/**
+ * Get the HDR bucket of a sample in a sharded histogram.
+ *
+ * @param sample  The sample
+ *
+ * @return The bucket
+ **/
+static inline unsigned int getHDRBucket(uint64_t sample)
+{
+  if (sample < HDR_SUB_BUCKETS) {
+    return sample;
+  }
+
+  unsigned int exponent = fls64(sample) - 1;
+  if (exponent >= HDR_MAX_BITS) {
+    return HDR_BUCKETS - 1;
+  }
+
+  unsigned int shift = exponent - HDR_SUB_BUCKET_BITS;
+  return (((exponent - HDR_SUB_BUCKET_BITS + 1) << HDR_SUB_BUCKET_BITS)
+          + ((sample >> shift) & (HDR_SUB_BUCKETS - 1)));
+}
+
+/**
+ * Get the smallest sample that goes into an HDR bucket.
+ *
+ * @param bucket  The bucket, which must not be the final one
+ *
+ * @return The bottom of the bucket
+ **/
+static uint64_t getHDRBucketBottom(unsigned int bucket)
+{
+  if (bucket < HDR_SUB_BUCKETS) {
+    return bucket;
+  }
+
+  unsigned int exponent = (bucket >> HDR_SUB_BUCKET_BITS) + HDR_SUB_BUCKET_BITS
+                          - 1;
+  uint64_t mantissa = HDR_SUB_BUCKETS + (bucket & (HDR_SUB_BUCKETS - 1));
+  return mantissa << (exponent - HDR_SUB_BUCKET_BITS);
+}
+
+/**
+ * Sum one of the fields of the shards of a sharded histogram.
+ *
+ * @param h       The histogram
+ * @param offset  The offset of the field in a HistogramShard
+ *
+ * @return The total of the field over all CPUs
+ **/
+static uint64_t sumShards(Histogram *h, size_t offset)
+{
+  uint64_t total = 0;
+  int cpu;
+  for_each_possible_cpu(cpu) {
+    const char *shard = (const char *) per_cpu_ptr(h->shards, cpu);
+    total += READ_ONCE(*((const uint64_t *) (shard + offset)));
+  }
+  return total;
+}
+
+/***********************************************************************/
+static uint64_t getCount(Histogram *h)
+{
+  return ((h->shards != NULL)
+          ? sumShards(h, offsetof(HistogramShard, count))
+          : atomic64_read(&h->count));
+}
+
+/***********************************************************************/
+static uint64_t getSum(Histogram *h)
+{
+  return ((h->shards != NULL)
+          ? sumShards(h, offsetof(HistogramShard, sum))
+          : atomic64_read(&h->sum));
+}
+
+/***********************************************************************/
+static uint64_t getUnacceptable(Histogram *h)
+{
+  return ((h->shards != NULL)
+          ? sumShards(h, offsetof(HistogramShard, unacceptable))
+          : atomic64_read(&h->unacceptable));
+}
+
+/***********************************************************************/
+static uint64_t getMaximum(Histogram *h)
+{
+  if (h->shards == NULL) {
+    return atomic64_read(&h->maximum);
+  }
+
+  uint64_t maximum = 0;
+  int cpu;
+  for_each_possible_cpu(cpu) {
+    maximum = max(maximum, READ_ONCE(per_cpu_ptr(h->shards, cpu)->maximum));
+  }
+  return maximum;
+}
+
+/***********************************************************************/
+static uint64_t getMinimum(Histogram *h)
+{
+  if (h->shards == NULL) {
+    return atomic64_read(&h->minimum);
+  }
+
+  uint64_t minimum = -1UL;
+  int cpu;
+  for_each_possible_cpu(cpu) {
+    minimum = min(minimum, READ_ONCE(per_cpu_ptr(h->shards, cpu)->minimum));
+  }
+  return minimum;
+}
+
 /***********************************************************************/
 static int maxBucket(Histogram *h)
 {
@@ -157,6 +301,9 @@ typedef struct {
 static void histogramKobjRelease(struct kobject *kobj)
 {
   Histogram *h = container_of(kobj, Histogram, kobj);
+  if (h->shards != NULL) {
+    free_percpu(h->shards);
+  }
   FREE(h->counters);
   FREE(h);
 }
@@ -191,7 +338,7 @@ static ssize_t histogramStore(struct kobject   *kobj,
 /***********************************************************************/
 static ssize_t histogramShowCount(Histogram *h, char *buf)
 {
-  int64_t count = atomic64_read(&h->count);
+  int64_t count = getCount(h);
   return sprintf(buf, "%" PRId64 "\n", count);
 }
 
@@ -288,7 +435,7 @@ static ssize_t histogramShowHistogram(Histogram *h, char *buffer)
 static ssize_t histogramShowMaximum(Histogram *h, char *buf)
 {
   // Maximum is initialized to 0.
-  unsigned long value = atomic64_read(&h->maximum);
+  unsigned long value = getMaximum(h);
   return sprintf(buf, "%lu\n", h->conversionFactor * value);
 }
 
@@ -296,9 +443,7 @@ static ssize_t histogramShowMaximum(Histogram *h, char *buf)
 static ssize_t histogramShowMinimum(Histogram *h, char *buf)
 {
   // Minimum is initialized to -1.
-  unsigned long value = ((atomic64_read(&h->count) > 0)
-                         ? atomic64_read(&h->minimum)
-                         : 0);
+  unsigned long value = ((getCount(h) > 0) ? getMinimum(h) : 0);
   return sprintf(buf, "%lu\n", h->conversionFactor * value);
 }
 
@@ -325,20 +470,27 @@ static ssize_t histogramStoreLimit(Histogram  *h,
    * computeBucketCount could also be called "divideRoundingUp".
    */
   h->limit = computeBucketCount(value, h->conversionFactor);
-  atomic64_set(&h->unacceptable, 0);
+  if (h->shards != NULL) {
+    int cpu;
+    for_each_possible_cpu(cpu) {
+      WRITE_ONCE(per_cpu_ptr(h->shards, cpu)->unacceptable, 0);
+    }
+  } else {
+    atomic64_set(&h->unacceptable, 0);
+  }
   return length;
 }
 
 /***********************************************************************/
 static ssize_t histogramShowMean(Histogram *h, char *buf)
 {
-  uint64_t count = atomic64_read(&h->count);
+  uint64_t count = getCount(h);
   if (count == 0) {
     return sprintf(buf, "0/0\n");
   }
   // Compute mean, scaled up by 1000, in reporting units
   unsigned long sumTimes1000InReportingUnits
-    = h->conversionFactor * atomic64_read(&h->sum) * 1000;
+    = h->conversionFactor * getSum(h) * 1000;
   unsigned int meanTimes1000
     = divideRoundingToNearest(sumTimes1000InReportingUnits, count);
   // Print mean with fractional part
@@ -349,10 +501,66 @@ static ssize_t histogramShowMean(Histogram *h, char *buf)
 /***********************************************************************/
 static ssize_t histogramShowUnacceptable(Histogram *h, char *buf)
 {
-  int64_t count = atomic64_read(&h->unacceptable);
+  int64_t count = getUnacceptable(h);
   return sprintf(buf, "%" PRId64 "\n", count);
 }
 
+/**
+ * Report a percentile of the samples in a sharded histogram. The value
+ * reported is the top of the bucket holding the sample of that rank, but
+ * never more than the maximum sample.
+ *
+ * @param h         The histogram
+ * @param buf       The buffer in which to report the value
+ * @param permille  The percentile to report, in tenths of a percent
+ *
+ * @return The number of bytes written to the buffer
+ **/
+static ssize_t histogramShowPercentile(Histogram    *h,
+                                       char         *buf,
+                                       unsigned int  permille)
+{
+  uint64_t count = getCount(h);
+  if (count == 0) {
+    return sprintf(buf, "0\n");
+  }
+
+  uint64_t maximum = getMaximum(h);
+  uint64_t rank = computeBucketCount(count * permille, 1000);
+  uint64_t value = maximum;
+  uint64_t seen = 0;
+  for (unsigned int bucket = 0; bucket < HDR_BUCKETS - 1; bucket++) {
+    int cpu;
+    for_each_possible_cpu(cpu) {
+      seen += READ_ONCE(per_cpu_ptr(h->shards, cpu)->buckets[bucket]);
+    }
+    if (seen >= rank) {
+      value = min(maximum, getHDRBucketBottom(bucket + 1) - 1);
+      break;
+    }
+  }
+
+  return sprintf(buf, "%" PRIu64 "\n", h->conversionFactor * value);
+}
+
+/***********************************************************************/
+static ssize_t histogramShowP50(Histogram *h, char *buf)
+{
+  return histogramShowPercentile(h, buf, 500);
+}
+
+/***********************************************************************/
+static ssize_t histogramShowP99(Histogram *h, char *buf)
+{
+  return histogramShowPercentile(h, buf, 990);
+}
+
+/***********************************************************************/
+static ssize_t histogramShowP999(Histogram *h, char *buf)
+{
+  return histogramShowPercentile(h, buf, 999);
+}
+
 /***********************************************************************/
 static ssize_t histogramShowLabel(Histogram *h, char *buf)
 {
@@ -413,6 +621,21 @@ static HistogramAttribute meanAttribute = {
   .show = histogramShowMean,
 };
 
+static HistogramAttribute p50Attribute = {
+  .attr = { .name = "p50", .mode = 0444, },
+  .show = histogramShowP50,
+};
+
+static HistogramAttribute p99Attribute = {
+  .attr = { .name = "p99", .mode = 0444, },
+  .show = histogramShowP99,
+};
+
+static HistogramAttribute p999Attribute = {
+  .attr = { .name = "p999", .mode = 0444, },
+  .show = histogramShowP999,
+};
+
 static HistogramAttribute unacceptableAttribute = {
   .attr = { .name = "unacceptable", .mode = 0444, },
   .show = histogramShowUnacceptable,
@@ -459,6 +682,28 @@ static struct kobj_type bucketlessHistogramKobjType = {
   .default_attrs = bucketlessHistogramAttributes,
 };
 
+// Sharded histograms report percentiles instead of buckets.
+static struct attribute *shardedHistogramAttributes[] = {
+  &countAttribute.attr,
+  &labelAttribute.attr,
+  &limitAttribute.attr,
+  &maximumAttribute.attr,
+  &meanAttribute.attr,
+  &minimumAttribute.attr,
+  &p50Attribute.attr,
+  &p99Attribute.attr,
+  &p999Attribute.attr,
+  &unacceptableAttribute.attr,
+  &unitAttribute.attr,
+  NULL,
+};
+
+static struct kobj_type shardedHistogramKobjType = {
+  .release       = histogramKobjRelease,
+  .sysfs_ops     = &histogramSysfsOps,
+  .default_attrs = shardedHistogramAttributes,
+};
+
 /***********************************************************************/
 static Histogram *makeHistogram(struct kobject *parent,
                                 const char     *name,
@@ -468,14 +713,15 @@ static Histogram *makeHistogram(struct kobject *parent,
                                 const char     *sampleUnits,
                                 int             numBuckets,
                                 unsigned long   conversionFactor,
-                                bool            logFlag)
+                                bool            logFlag,
+                                bool            sharded)
 {
   Histogram *h;
   if (ALLOCATE(1, Histogram, "histogram", &h) != UDS_SUCCESS) {
     return NULL;
   }
 
-  if (NO_BUCKETS) {
+  if (NO_BUCKETS || sharded) {
     numBuckets = 0;             // plus 1 for "bigger" bucket
   }
 
@@ -497,16 +743,28 @@ static Histogram *makeHistogram(struct kobject *parent,
   h->conversionFactor = conversionFactor;
   atomic64_set(&h->minimum, -1UL);
 
-  if (ALLOCATE(h->numBuckets + 1, atomic64_t, "histogram counters",
-               &h->counters) != UDS_SUCCESS) {
+  if (sharded) {
+    h->shards = alloc_percpu(HistogramShard);
+    if (h->shards == NULL) {
+      histogramKobjRelease(&h->kobj);
+      return NULL;
+    }
+    int cpu;
+    for_each_possible_cpu(cpu) {
+      per_cpu_ptr(h->shards, cpu)->minimum = -1UL;
+    }
+  } else if (ALLOCATE(h->numBuckets + 1, atomic64_t, "histogram counters",
+                      &h->counters) != UDS_SUCCESS) {
     histogramKobjRelease(&h->kobj);
     return NULL;
   }
 
   kobject_init(&h->kobj,
-               ((numBuckets > 0)
-                ? &histogramKobjType
-                : &bucketlessHistogramKobjType));
+               (sharded
+                ? &shardedHistogramKobjType
+                : ((numBuckets > 0)
+                   ? &histogramKobjType
+                   : &bucketlessHistogramKobjType)));
   if (kobject_add(&h->kobj, parent, name) != 0) {
     histogramKobjRelease(&h->kobj);
     return NULL;
@@ -524,7 +782,7 @@ Histogram *makeLinearHistogram(struct kobject *parent,
                                int             size)
 {
   return makeHistogram(parent, name, initLabel, countedItems,
-                       metric, sampleUnits, size, 1, false);
+                       metric, sampleUnits, size, 1, false, false);
 }
 
 
@@ -566,7 +824,7 @@ makeLogarithmicHistogramWithConversionFactor(struct kobject *parent,
   }
   return makeHistogram(parent, name,
                        initLabel, countedItems, metric, sampleUnits,
-                       10 * logSize, conversionFactor, true);
+                       10 * logSize, conversionFactor, true, false);
 }
 
 /***********************************************************************/
@@ -605,9 +863,74 @@ Histogram *makeLogarithmicJiffiesHistogram(struct kobject *parent,
                                                       jiffies_to_msecs(1));
 }
 
+/***********************************************************************/
+Histogram *makeShardedHistogram(struct kobject *parent,
+                                const char     *name,
+                                const char     *initLabel,
+                                const char     *countedItems,
+                                const char     *metric,
+                                const char     *sampleUnits)
+{
+  return makeHistogram(parent, name, initLabel, countedItems, metric,
+                       sampleUnits, 0, 1, false, true);
+}
+
+/***********************************************************************/
+Histogram *makeShardedJiffiesHistogram(struct kobject *parent,
+                                       const char     *name,
+                                       const char     *initLabel,
+                                       const char     *countedItems,
+                                       const char     *metric)
+{
+  return makeHistogram(parent, name, initLabel, countedItems, metric,
+                       "milliseconds", 0, jiffies_to_msecs(1), false, true);
+}
+
+/**
+ * Enter a sample into the counts of the current CPU for a sharded
+ * histogram. Each update is a single per-CPU operation, so it is safe
+ * against preemption and interrupts.
+ *
+ * @param h       The histogram
+ * @param sample  The sample
+ **/
+static void enterShardedSample(Histogram *h, uint64_t sample)
+{
+  HistogramShard __percpu *shard = h->shards;
+  this_cpu_inc(shard->buckets[getHDRBucket(sample)]);
+  this_cpu_inc(shard->count);
+  this_cpu_add(shard->sum, sample);
+  if ((h->limit > 0) && (sample > h->limit)) {
+    this_cpu_inc(shard->unacceptable);
+  }
+
+  uint64_t oldMaximum = this_cpu_read(shard->maximum);
+  while (oldMaximum < sample) {
+    uint64_t readValue = this_cpu_cmpxchg(shard->maximum, oldMaximum, sample);
+    if (readValue == oldMaximum) {
+      break;
+    }
+    oldMaximum = readValue;
+  }
+
+  uint64_t oldMinimum = this_cpu_read(shard->minimum);
+  while (oldMinimum > sample) {
+    uint64_t readValue = this_cpu_cmpxchg(shard->minimum, oldMinimum, sample);
+    if (readValue == oldMinimum) {
+      break;
+    }
+    oldMinimum = readValue;
+  }
+}
+
 /***********************************************************************/
 void enterHistogramSample(Histogram *h, uint64_t sample)
 {
+  if (h->shards != NULL) {
+    enterShardedSample(h, sample);
+    return;
+  }
+
   int bucket;
   if (h->logFlag) {
     int lo = 0;
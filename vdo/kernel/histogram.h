@@ -115,6 +115,49 @@ Histogram *makeLogarithmicJiffiesHistogram(struct kobject *parent,
                                            const char     *metric,
                                            int             logSize);
 
+/**
+ * Allocate and initialize a histogram whose counts are kept per CPU, for
+ * samples entered from many threads at once. It reports the 50th, 99th, and
+ * 99.9th percentiles of the samples (as p50, p99, and p999) instead of its
+ * buckets.
+ *
+ * @param parent       The parent kobject.
+ * @param name         The short name of the histogram.  This label is used
+ *                     for the sysfs node.
+ * @param initLabel    The label for the sampled data.
+ * @param countedItems A name (plural) for the things being counted.
+ * @param metric       The measure being used to divide samples into buckets.
+ * @param sampleUnits  The unit (plural) for the metric, or NULL if it's a
+ *                     simple counter.
+ *
+ * @return the histogram
+ **/
+Histogram *makeShardedHistogram(struct kobject *parent,
+                                const char     *name,
+                                const char     *initLabel,
+                                const char     *countedItems,
+                                const char     *metric,
+                                const char     *sampleUnits);
+
+/**
+ * Allocate and initialize a sharded histogram whose samples are entered in
+ * jiffies and are reported in milliseconds.
+ *
+ * @param parent       The parent kobject.
+ * @param name         The short name of the histogram.  This label is used
+ *                     for the sysfs node.
+ * @param initLabel    The label for the sampled data.
+ * @param countedItems A name (plural) for the things being counted.
+ * @param metric       The measure being used to divide samples into buckets.
+ *
+ * @return the histogram
+ **/
+Histogram *makeShardedJiffiesHistogram(struct kobject *parent,
+                                       const char     *name,
+                                       const char     *initLabel,
+                                       const char     *countedItems,
+                                       const char     *metric);
+
 /**
  * Enter a sample into a histogram
  *
@@ -0,0 +1,364 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/indexBenchmark.c#1 $
+ */
+
+#include "indexBenchmark.h"
+
+#include <linux/semaphore.h>
+#include <linux/spinlock.h>
+
+#include "logger.h"
+#include "memoryAlloc.h"
+#include "murmur/MurmurHash3.h"
+#include "timeUtils.h"
+
+enum {
+  /** The number of power-of-two latency ranges tracked, in nanoseconds */
+  LATENCY_BUCKETS = 64,
+};
+
+typedef struct indexBenchmark IndexBenchmark;
+
+typedef struct {
+  /** The benchmark issuing the request */
+  IndexBenchmark *benchmark;
+  /** When the request was started, in nanoseconds */
+  uint64_t        launchTime;
+  /** The request itself */
+  UdsRequest      request;
+} IndexBenchmarkRequest;
+
+struct indexBenchmark {
+  /** The index session the workload is run on */
+  struct uds_index_session *session;
+  /** The shape of the workload */
+  IndexBenchmarkParameters  parameters;
+  /** The state of the pseudo-random number generator */
+  uint64_t                  random;
+  /** Distinguishes the names of this run from those of earlier runs */
+  uint64_t                  salt;
+  /** The number of distinct names used so far */
+  uint64_t                  uniqueNames;
+  /** Counts the requests which are not outstanding */
+  struct semaphore          idleCount;
+  /** Protects the list of idle requests */
+  spinlock_t                lock;
+  /** The requests which are not outstanding */
+  IndexBenchmarkRequest   **idle;
+  /** The number of requests on the idle list */
+  unsigned int              idleRequests;
+  /** The number of requests which completed successfully */
+  atomic64_t                completed;
+  /** The number of successful requests which found their name */
+  atomic64_t                found;
+  /** The number of requests which failed */
+  atomic64_t                errors;
+  /** The total latency of the successful requests, in nanoseconds */
+  atomic64_t                totalLatency;
+  /** The greatest latency of any successful request, in nanoseconds */
+  atomic64_t                maxLatency;
+  /** The number of requests with latency in [2^i - 1, 2^(i+1) - 1) ns */
+  atomic64_t                latencies[LATENCY_BUCKETS];
+  /** The requests themselves */
+  IndexBenchmarkRequest     requests[];
+};
+
+/**
+ * Get the next pseudo-random number of a benchmark (xorshift64*).
+ *
+ * @param benchmark  The benchmark
+ *
+ * @return A pseudo-random number
+ **/
+static uint64_t nextRandom(IndexBenchmark *benchmark)
+{
+  benchmark->random ^= benchmark->random >> 12;
+  benchmark->random ^= benchmark->random << 25;
+  benchmark->random ^= benchmark->random >> 27;
+  return benchmark->random * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Choose the name of the next request. A repeated name is one of the names
+ * used earlier in the run; any other name is new. Names are hashed from
+ * their number just as block data is, so that they spread over the zones
+ * and chapters of the index as real names do.
+ *
+ * @param benchmark  The benchmark
+ * @param name       The name to fill in
+ **/
+static void chooseName(IndexBenchmark *benchmark, UdsChunkName *name)
+{
+  bool repeat = ((benchmark->uniqueNames > 0)
+                 && ((nextRandom(benchmark) % 100)
+                     < benchmark->parameters.dedupePercent));
+  uint64_t key[2] = {
+    benchmark->salt,
+    (repeat
+     ? (nextRandom(benchmark) % benchmark->uniqueNames)
+     : benchmark->uniqueNames++),
+  };
+  MurmurHash3_x64_128(key, sizeof(key), 0, name->name);
+}
+
+/**
+ * Callback for a completed benchmark request, called on the UDS callback
+ * thread.
+ *
+ * @param udsRequest  The request
+ **/
+static void completeIndexBenchmarkRequest(UdsRequest *udsRequest)
+{
+  IndexBenchmarkRequest *request
+    = container_of(udsRequest, IndexBenchmarkRequest, request);
+  IndexBenchmark *benchmark = request->benchmark;
+  uint64_t latency = currentTime(CLOCK_MONOTONIC) - request->launchTime;
+  if (udsRequest->status != UDS_SUCCESS) {
+    atomic64_inc(&benchmark->errors);
+  } else {
+    atomic64_inc(&benchmark->completed);
+    if (udsRequest->found) {
+      atomic64_inc(&benchmark->found);
+    }
+    atomic64_add(latency, &benchmark->totalLatency);
+    atomic64_inc(&benchmark->latencies[ilog2(latency + 1)]);
+    uint64_t max = atomic64_read(&benchmark->maxLatency);
+    while (latency > max) {
+      uint64_t old = atomic64_cmpxchg(&benchmark->maxLatency, max, latency);
+      if (old == max) {
+        break;
+      }
+      max = old;
+    }
+  }
+
+  spin_lock(&benchmark->lock);
+  benchmark->idle[benchmark->idleRequests++] = request;
+  spin_unlock(&benchmark->lock);
+  up(&benchmark->idleCount);
+}
+
+/**
+ * Free a benchmark. None of its requests may be outstanding.
+ *
+ * @param benchmark  The benchmark to free
+ **/
+static void freeIndexBenchmark(IndexBenchmark *benchmark)
+{
+  FREE(benchmark->idle);
+  FREE(benchmark);
+}
+
+/**
+ * Make a benchmark and the requests it will issue.
+ *
+ * @param [in]  session       The index session to run the workload on
+ * @param [in]  parameters    The shape of the workload
+ * @param [out] benchmarkPtr  A pointer to hold the new benchmark
+ *
+ * @return UDS_SUCCESS or an error
+ **/
+static int makeIndexBenchmark(struct uds_index_session        *session,
+                              const IndexBenchmarkParameters  *parameters,
+                              IndexBenchmark                 **benchmarkPtr)
+{
+  IndexBenchmark *benchmark;
+  int result = ALLOCATE_EXTENDED(IndexBenchmark, parameters->queueDepth,
+                                 IndexBenchmarkRequest, __func__, &benchmark);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  result = ALLOCATE(parameters->queueDepth, IndexBenchmarkRequest *,
+                    __func__, &benchmark->idle);
+  if (result != UDS_SUCCESS) {
+    freeIndexBenchmark(benchmark);
+    return result;
+  }
+
+  uint64_t now = currentTime(CLOCK_MONOTONIC);
+  benchmark->session      = session;
+  benchmark->parameters   = *parameters;
+  benchmark->random       = now | 1;
+  benchmark->salt         = now;
+  benchmark->idleRequests = parameters->queueDepth;
+  sema_init(&benchmark->idleCount, parameters->queueDepth);
+  spin_lock_init(&benchmark->lock);
+  for (unsigned int i = 0; i < parameters->queueDepth; i++) {
+    IndexBenchmarkRequest *request = &benchmark->requests[i];
+    request->benchmark        = benchmark;
+    request->request.callback = completeIndexBenchmarkRequest;
+    request->request.session  = session;
+    request->request.type     = parameters->operation;
+    request->request.update   = true;
+    benchmark->idle[i]        = request;
+  }
+
+  *benchmarkPtr = benchmark;
+  return UDS_SUCCESS;
+}
+
+/**
+ * Get the name of a benchmark operation.
+ *
+ * @param operation  The operation
+ *
+ * @return The name of the operation
+ **/
+static const char *getOperationName(UdsCallbackType operation)
+{
+  switch (operation) {
+  case UDS_POST:
+    return "posts";
+  case UDS_QUERY:
+    return "queries";
+  case UDS_UPDATE:
+    return "updates";
+  default:
+    return "requests";
+  }
+}
+
+/**
+ * Log the latency percentiles of the successful requests of a benchmark.
+ * Each is the top of the power-of-two range the percentile falls in.
+ *
+ * @param benchmark  The benchmark
+ * @param count      The number of successful requests
+ **/
+static void logLatencyPercentiles(IndexBenchmark *benchmark, uint64_t count)
+{
+  static const unsigned int PERMILLES[] = { 500, 900, 990, 999 };
+  uint64_t     tops[COUNT_OF(PERMILLES)];
+  uint64_t     seen   = 0;
+  unsigned int bucket = 0;
+  for (unsigned int i = 0; i < COUNT_OF(PERMILLES); i++) {
+    uint64_t target = DIV_ROUND_UP(count * PERMILLES[i], 1000);
+    while ((bucket < LATENCY_BUCKETS - 1)
+           && (seen + atomic64_read(&benchmark->latencies[bucket])
+               < target)) {
+      seen += atomic64_read(&benchmark->latencies[bucket++]);
+    }
+    tops[i] = ((bucket < LATENCY_BUCKETS - 1)
+               ? ((1ULL << (bucket + 1)) - 1)
+               : U64_MAX);
+  }
+
+  logInfo("index benchmark: latency average %" PRIu64 " ns, p50 %" PRIu64
+          " ns, p90 %" PRIu64 " ns, p99 %" PRIu64 " ns, p99.9 %" PRIu64
+          " ns, maximum %" PRIu64 " ns",
+          atomic64_read(&benchmark->totalLatency) / count, tops[0], tops[1],
+          tops[2], tops[3], (uint64_t) atomic64_read(&benchmark->maxLatency));
+}
+
+/**
+ * Log the results of a benchmark.
+ *
+ * @param benchmark  The benchmark
+ * @param elapsed    The time the benchmark took, in nanoseconds
+ * @param before     The index statistics from before the benchmark
+ * @param after      The index statistics from after the benchmark
+ **/
+static void logIndexBenchmarkResults(IndexBenchmark      *benchmark,
+                                     uint64_t             elapsed,
+                                     const UdsIndexStats *before,
+                                     const UdsIndexStats *after)
+{
+  uint64_t count = atomic64_read(&benchmark->completed);
+  uint64_t usec  = ((elapsed < 1000) ? 1 : (elapsed / 1000));
+  logInfo("index benchmark: %" PRIu64 " %s in %" PRIu64 " us, %" PRIu64
+          " per second, %" PRIu64 " found, %" PRIu64 " errors", count,
+          getOperationName(benchmark->parameters.operation), usec,
+          (count * 1000000) / usec, atomic64_read(&benchmark->found),
+          atomic64_read(&benchmark->errors));
+  if (count > 0) {
+    logLatencyPercentiles(benchmark, count);
+  }
+
+  uint64_t hits   = after->pageCacheHits - before->pageCacheHits;
+  uint64_t misses = after->pageCacheMisses - before->pageCacheMisses;
+  if (hits + misses > 0) {
+    logInfo("index benchmark: page cache %" PRIu64 " hits, %" PRIu64
+            " misses, %" PRIu64 "%% hits", hits, misses,
+            (hits * 100) / (hits + misses));
+  }
+}
+
+/**********************************************************************/
+int runIndexBenchmark(struct uds_index_session       *session,
+                      const IndexBenchmarkParameters *parameters)
+{
+  UdsIndexStats before;
+  int result = udsGetIndexStats(session, &before);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  IndexBenchmark *benchmark;
+  result = makeIndexBenchmark(session, parameters, &benchmark);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  logInfo("index benchmark: %u %s, queue depth %u, %u%% repeated names",
+          parameters->requests, getOperationName(parameters->operation),
+          parameters->queueDepth, parameters->dedupePercent);
+  uint64_t startTime = currentTime(CLOCK_MONOTONIC);
+  for (unsigned int issued = 0; issued < parameters->requests; issued++) {
+    if (down_interruptible(&benchmark->idleCount) != 0) {
+      logWarning("index benchmark: interrupted");
+      break;
+    }
+
+    spin_lock(&benchmark->lock);
+    IndexBenchmarkRequest *request
+      = benchmark->idle[--benchmark->idleRequests];
+    spin_unlock(&benchmark->lock);
+
+    chooseName(benchmark, &request->request.chunkName);
+    request->launchTime = currentTime(CLOCK_MONOTONIC);
+    result = udsStartChunkOperation(&request->request);
+    if (result != UDS_SUCCESS) {
+      logErrorWithStringError(result, "index benchmark: starting request");
+      // The request was not started, so it is idle again.
+      spin_lock(&benchmark->lock);
+      benchmark->idle[benchmark->idleRequests++] = request;
+      spin_unlock(&benchmark->lock);
+      up(&benchmark->idleCount);
+      break;
+    }
+  }
+
+  for (unsigned int i = 0; i < parameters->queueDepth; i++) {
+    down(&benchmark->idleCount);
+  }
+  uint64_t elapsed = currentTime(CLOCK_MONOTONIC) - startTime;
+
+  UdsIndexStats after;
+  int statsResult = udsGetIndexStats(session, &after);
+  if (statsResult != UDS_SUCCESS) {
+    logErrorWithStringError(statsResult, "index benchmark: reading stats");
+    after = before;
+  }
+
+  logIndexBenchmarkResults(benchmark, elapsed, &before, &after);
+  freeIndexBenchmark(benchmark);
+  return result;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/indexBenchmark.h#1 $
+ */
+
+#ifndef INDEX_BENCHMARK_H
+#define INDEX_BENCHMARK_H
+
+#include "uds-block.h"
+
+enum {
+  /** The most requests an index benchmark may have outstanding at once */
+  MAX_INDEX_BENCHMARK_DEPTH = 2048,
+};
+
+/**
+ * The shape of a synthetic index workload.
+ **/
+typedef struct {
+  /** The operation every request does: UDS_POST, UDS_QUERY or UDS_UPDATE */
+  UdsCallbackType operation;
+  /** The number of requests to issue */
+  unsigned int    requests;
+  /** The most requests to have outstanding at once */
+  unsigned int    queueDepth;
+  /** The percentage of requests which repeat a name used before */
+  unsigned int    dedupePercent;
+} IndexBenchmarkParameters;
+
+/**
+ * Run a synthetic workload against an open index session and log its
+ * throughput, its latency percentiles, and the hit rate of the index page
+ * cache while it ran. The requests use made-up chunk names, a given share
+ * of which repeat a name from earlier in the run, and carry no advice, so
+ * what is measured is the index alone. Waits until every request has
+ * completed.
+ *
+ * The names the workload adds stay in the index, where they displace real
+ * entries, so this should only be used on an index created for testing.
+ *
+ * @param session     The index session to issue the requests to
+ * @param parameters  The shape of the workload
+ *
+ * @return UDS_SUCCESS or an error
+ **/
+int runIndexBenchmark(struct uds_index_session       *session,
+                      const IndexBenchmarkParameters *parameters)
+  __attribute__((warn_unused_result));
+
+#endif // INDEX_BENCHMARK_H
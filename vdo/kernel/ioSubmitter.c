@@ -22,11 +22,14 @@
 #include "ioSubmitterInternals.h"
 
 #include "memoryAlloc.h"
+#include "timeUtils.h"
 
 #include "bio.h"
+#include "bioIterator.h"
 #include "dataKVIO.h"
 #include "kernelLayer.h"
 #include "logger.h"
+#include "vdoTrace.h"
 
 enum {
   /*
@@ -45,8 +48,36 @@ enum {
    * off this code and save compute/spinlock cycles.
    */
   USE_BIOMAP           = 1,
+  /*
+   * The most blocks of sequential data bios collected by the bio map which
+   * will be coalesced into a single multi-page bio. Submitting one large
+   * bio instead of a run of small ones saves per-I/O costs in the layers
+   * below us, and lets MD RAID5 see full-stripe writes. Runs of reads,
+   * such as the verification reads of a dedupe-heavy restore whose
+   * candidates were written together, are coalesced the same way. Runs
+   * longer than this are split; setting this to 1 disables coalescing.
+   */
+  MAX_COALESCED_BLOCKS = 32,
+  /*
+   * How many blocks, at most, may be coalesced into one bio when the
+   * storage's stripes are configured. Runs are then coalesced up to a full
+   * stripe, so that parity RAID can write the stripe without reading it,
+   * and are split at stripe boundaries so that no write straddles two
+   * stripes. This is the most pages one bio can hold.
+   */
+  MAX_COALESCED_STRIPE_BLOCKS = 256,
+  /*
+   * How many more bios a data bio's own bio thread must have waiting than
+   * some other bio thread before the data bio is sent to the other thread.
+   * Moving a bio costs the chance of merging it with its neighbors, so
+   * this only overrides PBN placement when one device queue has clearly
+   * backed up, such as when it is stuck behind a slow or failing device.
+   */
+  BIO_QUEUE_SPILL_DEPTH = 64,
 };
 
+bool directBioSubmission = true;
+
 /**
  * Increments appropriate counters for bio completions
  *
@@ -74,8 +105,20 @@ void countCompletedBios(BIO *bio)
 {
   KVIO        *kvio  = (KVIO *)bio->bi_private;
   KernelLayer *layer = kvio->layer;
+  trace_vdo_bio_complete(layer->instance, bio, kvio->vio->type);
   atomic64_inc(&layer->biosCompleted);
   countAllBiosCompleted(kvio, bio);
+
+  /*
+   * If a bio thread is polling for this bio, tell it the bio is done. Once
+   * the flag is set the bio thread may return, so the flag must not be
+   * touched again, and the pointer is cleared first so that a later use of
+   * this KVIO does not see it.
+   */
+  bool *pollCompletion = xchg(&kvio->pollCompletion, NULL);
+  if (pollCompletion != NULL) {
+    smp_store_release(pollCompletion, true);
+  }
 }
 
 /**********************************************************************/
@@ -176,6 +219,145 @@ static void countAllBios(KVIO *kvio, BIO *bio)
   }
 }
 
+/**
+ * Count a bio which is about to be sent to the underlying device.
+ *
+ * @param kvio      The kvio associated with the bio
+ * @param bio       The bio to count
+ * @param location  The source-location descriptor to be recorded
+ **/
+static void countSubmittedBio(KVIO *kvio, BIO *bio, TraceLocation location)
+{
+  trace_vdo_bio_submit(kvio->layer->instance, bio, kvio->vio->type,
+                       getBioSector(bio), getBioSize(bio));
+  atomic64_inc(&kvio->layer->biosSubmitted);
+  countAllBios(kvio, bio);
+  kvioAddTraceRecord(kvio, location);
+}
+
+/**
+ * Get the device a kvio's bio is sent to.
+ *
+ * @param kvio  The kvio
+ *
+ * @return The device which the bio's I/O is sent to
+ **/
+static struct block_device *getKVIODevice(KVIO *kvio)
+{
+  if (isData(kvio)) {
+    return getKernelLayerBdev(kvio->layer);
+  }
+
+  sector_t sector;
+  return mapMetadataBlock(kvio->layer, kvio->vio->type, kvio->vio->physical,
+                          &sector);
+}
+
+/**
+ * Check whether a bio thread should poll for the completion of a bio
+ * rather than wait for its interrupt. Only data and recovery journal bios
+ * are polled, since their latency is what writers and readers wait on,
+ * and only if the pool has polling enabled and the device supports it.
+ *
+ * @param kvio  The kvio associated with the bio
+ * @param bio   The bio about to be submitted
+ *
+ * @return true if the bio should be polled for
+ **/
+static bool shouldPollBio(KVIO *kvio, BIO *bio)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+  KernelLayer *layer = kvio->layer;
+  if (!layer->deviceConfig->bioPollingEnabled
+      || isFlushBio(bio) || isDiscardBio(bio)) {
+    return false;
+  }
+
+  if (!isData(kvio) && (kvio->vio->type != VIO_TYPE_RECOVERY_JOURNAL)) {
+    return false;
+  }
+
+  struct request_queue *queue = bdev_get_queue(getKVIODevice(kvio));
+  return test_bit(QUEUE_FLAG_POLL, &queue->queue_flags);
+#else
+  return false;
+#endif
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+/**
+ * Submit a bio marked for polled completion, and poll the device until it
+ * completes. This spends the bio thread's CPU time to avoid the interrupt
+ * and the wakeup of an interrupt-driven completion.
+ *
+ * If the block layer does not give back a cookie to poll with, the bio
+ * will complete through its interrupt after all. The claim on the
+ * completion flag is then withdrawn, but if the completion has already
+ * taken it, this thread must still wait for the flag to be set, since it
+ * lives on this stack.
+ *
+ * @param kvio  The kvio associated with the bio
+ * @param bio   The bio to submit
+ **/
+static void submitAndPollBio(KVIO *kvio, BIO *bio)
+{
+  BioQueueData         *bioQueueData = getCurrentBioQueueData();
+  KernelLayer          *layer        = kvio->layer;
+  struct request_queue *queue        = bdev_get_queue(getKVIODevice(kvio));
+
+  bool done = false;
+  kvio->pollCompletion = &done;
+  setBioOperationFlagHighPriority(bio);
+  uint64_t  startTime = currentTime(CLOCK_MONOTONIC);
+  blk_qc_t  cookie    = generic_make_request(bio);
+  bool      polling   = blk_qc_t_valid(cookie);
+  while (!smp_load_acquire(&done)) {
+    if (!polling) {
+      if (xchg(&kvio->pollCompletion, NULL) != NULL) {
+        break;
+      }
+      cpu_relax();
+      continue;
+    }
+
+    bioQueueData->pollCalls++;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,0,0)
+    blk_poll(queue, cookie, true);
+#else
+    blk_poll(queue, cookie);
+#endif
+    cond_resched();
+  }
+
+  uint64_t pollTime = currentTime(CLOCK_MONOTONIC) - startTime;
+  bioQueueData->polledBios++;
+  bioQueueData->pollTime += pollTime;
+  enterHistogramSample(layer->ioSubmitter->pollLatencyHistogram,
+                       pollTime / 1000);
+}
+#endif
+
+/**
+ * Check whether a bio is a write with a preflush to a separate journal
+ * device. The preflush must cover the data and metadata written to the
+ * main device before it too, so the main device is flushed first.
+ *
+ * @param kvio  The kvio associated with the bio
+ * @param bio   The bio about to be submitted
+ *
+ * @return true if the main device must be flushed before the bio is sent
+ **/
+static bool needsMainDeviceFlush(KVIO *kvio, BIO *bio)
+{
+  KernelLayer *layer = kvio->layer;
+  if ((layer->deviceConfig->journalDevice == NULL) || isData(kvio)
+      || !isFlushBio(bio) || (getBioSize(bio) == 0)) {
+    return false;
+  }
+
+  return (getKVIODevice(kvio) != getKernelLayerBdev(layer));
+}
+
 /**********************************************************************/
 void sendBioToDevice(KVIO *kvio, BIO *bio, TraceLocation location)
 {
@@ -185,23 +367,309 @@ void sendBioToDevice(KVIO *kvio, BIO *bio, TraceLocation location)
    */
   assertRunningInBioQueue();
 
-  atomic64_inc(&kvio->layer->biosSubmitted);
-  countAllBios(kvio, bio);
-  kvioAddTraceRecord(kvio, location);
+  if (kvio->layer->ramBacking != NULL) {
+    countSubmittedBio(kvio, bio, location);
+    bio->bi_next = NULL;
+    submitToRAMBacking(kvio->layer->ramBacking, getKVIODevice(kvio), bio);
+    return;
+  }
+
+  if (needsMainDeviceFlush(kvio, bio)) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,8,0)
+    int result = blkdev_issue_flush(getKernelLayerBdev(kvio->layer),
+                                    GFP_NOIO);
+#else
+    int result = blkdev_issue_flush(getKernelLayerBdev(kvio->layer),
+                                    GFP_NOIO, NULL);
+#endif
+    if (result != 0) {
+      bio->bi_next = NULL;
+      completeBio(bio, result);
+      return;
+    }
+  }
+
+  countSubmittedBio(kvio, bio, location);
   bio->bi_next = NULL;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+  if (shouldPollBio(kvio, bio)) {
+    submitAndPollBio(kvio, bio);
+    return;
+  }
+#endif
   generic_make_request(bio);
 }
 
+/**
+ * Check whether a kvio's bio may be collected with its neighbors in the bio
+ * map. Data bios always may. Metadata bios may only if they are plain
+ * single-block writes, since the map assumes each bio is one block, and
+ * flushes and FUA writes are best left alone.
+ *
+ * @param kvio  The kvio
+ * @param bio   The kvio's bio
+ *
+ * @return <code>true</code> if the bio may be merged
+ **/
+static bool isMergeable(KVIO *kvio, BIO *bio)
+{
+  if (isData(kvio)) {
+    return true;
+  }
+
+  return (isWriteBio(bio) && !isFlushBio(bio) && !isFUABio(bio)
+          && (getBioSize(bio) == VDO_BLOCK_SIZE));
+}
+
+/**
+ * Check whether a bio may be sent to the device from the submitting thread
+ * rather than through its bio thread. This is only done when the bio
+ * thread has nothing waiting, so that there is nothing to merge with and
+ * no earlier bio to overtake, and when the submitter is a VDO thread and
+ * so may block in the block layer as a bio thread would.
+ *
+ * @param bioQueueData  The bio queue the bio would otherwise go to
+ *
+ * @return true if the bio may be submitted directly
+ **/
+static bool canSubmitDirectly(BioQueueData *bioQueueData)
+{
+  return (READ_ONCE(directBioSubmission)
+          && (atomic_read(&bioQueueData->depth) == 0)
+          && !in_interrupt()
+          && (getCurrentWorkQueue() != NULL));
+}
+
+/**
+ * Send a bio to the device from the submitting thread, saving the handoff
+ * to a bio thread and the context switch that goes with it.
+ *
+ * @param kvio  The kvio associated with the bio
+ * @param bio   The bio to submit
+ **/
+static void submitBioDirectly(KVIO *kvio, BIO *bio)
+{
+  countSubmittedBio(kvio, bio, THIS_LOCATION("$F($io)"));
+  if (isMergeable(kvio, bio)) {
+    // As in submitNextBios(), which sets the device of every bio it sends.
+    setBioBlockDevice(bio, getKernelLayerBdev(kvio->layer));
+  }
+
+  if (kvio->layer->ramBacking != NULL) {
+    submitToRAMBacking(kvio->layer->ramBacking, getKVIODevice(kvio), bio);
+    return;
+  }
+
+  generic_make_request(bio);
+}
+
+/**********************************************************************/
+static void submitBioWork(KvdoWorkItem *item);
+
+/**
+ * Check whether a bio which is next in a merged list may be coalesced into
+ * a bio which starts with another. Plain writes, and reads of data blocks,
+ * may be coalesced with neighbors in the same direction.
+ *
+ * @param first     The first bio of the run, or NULL if this bio would
+ *                  start the run
+ * @param previous  The bio just before this one in the run
+ * @param bio       The bio to check
+ *
+ * @return <code>true</code> if the bio can be added to the run
+ **/
+static bool canCoalesce(BIO *first, BIO *previous, BIO *bio)
+{
+  KVIO *kvio = bio->bi_private;
+  if ((kvio->bioSubmissionCallback != submitBioWork)
+      || !(isWriteBio(bio) || (isReadBio(bio) && isData(kvio)))
+      || isFlushBio(bio) || isFUABio(bio) || isDiscardBio(bio)
+      || (bio->bi_vcnt == 0)) {
+    return false;
+  }
+
+  if (first == NULL) {
+    return true;
+  }
+
+  return (areBioOperationsAndFlagsEqual(first, bio)
+          && (getBioSector(bio)
+              == (getBioSector(previous) + (getBioSize(previous) >> 9))));
+}
+
+/**
+ * Count the bios at the start of a merged list which can be coalesced into
+ * one bio. If the storage's stripes are configured, a run ends at the end
+ * of a stripe.
+ *
+ * @param bio  The first bio in the list
+ *
+ * @return The number of bios in the run, or 0 if the first bio can't be
+ *         coalesced at all
+ **/
+static unsigned int countCoalescableRun(BIO *bio)
+{
+  if (!canCoalesce(NULL, NULL, bio)) {
+    return 0;
+  }
+
+  KernelLayer  *layer        = ((KVIO *) bio->bi_private)->layer;
+  BlockCount    stripeBlocks = layer->deviceConfig->stripeBlocks;
+  unsigned int  limit        = ((stripeBlocks > 1)
+                                ? MAX_COALESCED_STRIPE_BLOCKS
+                                : MAX_COALESCED_BLOCKS);
+  unsigned int  count        = 1;
+  BIO          *previous     = bio;
+  for (BIO *next = bio->bi_next;
+       ((next != NULL) && (count < limit)
+        && canCoalesce(bio, previous, next));
+       next = next->bi_next) {
+    if ((stripeBlocks > 1)
+        && ((sectorToBlock(layer, getBioSector(next)) % stripeBlocks) == 0)) {
+      // The next bio starts a new stripe.
+      break;
+    }
+
+    previous = next;
+    count++;
+  }
+  return count;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
+/**
+ * Handle the completion of a coalesced bio by completing each of the bios
+ * which were coalesced into it.
+ *
+ * @param bio  The coalesced bio
+ **/
+static void completeCoalescedBio(BIO *bio)
+#else
+/**
+ * Handle the completion of a coalesced bio by completing each of the bios
+ * which were coalesced into it.
+ *
+ * @param bio    The coalesced bio
+ * @param error  Possible error from underlying block device
+ **/
+static void completeCoalescedBio(BIO *bio, int error)
+#endif
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
+  int error = getBioResult(bio);
+#endif
+  BIO         *member = bio->bi_private;
+  KernelLayer *layer  = ((KVIO *) member->bi_private)->layer;
+  freeBio(bio, layer);
+
+  while (member != NULL) {
+    BIO *next       = member->bi_next;
+    member->bi_next = NULL;
+    completeBio(member, error);
+    member = next;
+  }
+}
+
+/**
+ * Submit a run of sequential bios as a single coalesced bio. The bios of
+ * the run are kept linked through bi_next so that they can be completed
+ * when the coalesced bio is.
+ *
+ * @param bio    The first bio of the run
+ * @param count  The number of bios in the run
+ *
+ * @return The bio following the run, or the first bio of the run if the
+ *         coalesced bio could not be built
+ **/
+static BIO *submitCoalescedRun(BIO *bio, unsigned int count)
+{
+  KernelLayer  *layer       = ((KVIO *) bio->bi_private)->layer;
+  unsigned int  vectorCount = 0;
+  BIO          *last        = NULL;
+  BIO          *member      = bio;
+  for (unsigned int i = 0; i < count; i++) {
+    vectorCount += member->bi_vcnt;
+    last         = member;
+    member       = member->bi_next;
+  }
+  BIO *rest = member;
+
+  // Don't wait for memory; the bios can always be submitted separately.
+  BIO *coalesced = bio_alloc_bioset(GFP_NOWAIT, vectorCount, layer->bioset);
+  if (coalesced == NULL) {
+    return bio;
+  }
+
+  for (member = bio; member != rest; member = member->bi_next) {
+    struct bio_vec *biovec;
+    for (BioIterator iter = createBioIterator(member);
+         (biovec = getNextBiovec(&iter)) != NULL;
+         advanceBioIterator(&iter)) {
+      if (bio_add_page(coalesced, biovec->bv_page, biovec->bv_len,
+                       biovec->bv_offset) != biovec->bv_len) {
+        freeBio(coalesced, layer);
+        return bio;
+      }
+    }
+  }
+
+  copyBioOperationAndFlags(coalesced, bio);
+  setBioSector(coalesced, getBioSector(bio));
+  setBioBlockDevice(coalesced, getKernelLayerBdev(layer));
+  coalesced->bi_end_io  = completeCoalescedBio;
+  coalesced->bi_private = bio;
+  last->bi_next         = NULL;
+
+  for (member = bio; member != NULL; member = member->bi_next) {
+    countSubmittedBio(member->bi_private, member, THIS_LOCATION("$F($io)"));
+  }
+  atomic64_inc(&layer->biosCoalesced);
+  atomic64_add(count, &layer->biosCoalescedMembers);
+  if (layer->ramBacking != NULL) {
+    submitToRAMBacking(layer->ramBacking, getKernelLayerBdev(layer),
+                       coalesced);
+  } else {
+    generic_make_request(coalesced);
+  }
+  return rest;
+}
+
+/**
+ * Submit the next bio, or run of coalescable bios, from a merged list.
+ *
+ * @param bio  The first bio remaining in the list
+ *
+ * @return The rest of the list
+ **/
+static BIO *submitNextBios(BIO *bio)
+{
+  unsigned int count = countCoalescableRun(bio);
+  if (count > 1) {
+    BIO *rest = submitCoalescedRun(bio, count);
+    if (rest != bio) {
+      return rest;
+    }
+  }
+
+  KVIO *kvio   = bio->bi_private;
+  BIO  *next   = bio->bi_next;
+  bio->bi_next = NULL;
+  setBioBlockDevice(bio, getKernelLayerBdev(kvio->layer));
+  kvio->bioSubmissionCallback(&kvio->enqueueable.workItem);
+  return next;
+}
+
 /**
  * Submits a bio to the underlying block device.  May block if the
  * device is busy.
  *
- * For metadata or if USE_BIOMAP is disabled, kvio->bioToSubmit holds
- * the BIO pointer to submit to the target device. For normal
- * data when USE_BIOMAP is enabled, kvio->biosMerged is the list of
- * all bios collected together in this group; all of them get
- * submitted. In both cases, the bi_end_io callback is invoked when
- * each I/O operation completes.
+ * For flushes, metadata reads, or if USE_BIOMAP is disabled,
+ * kvio->bioToSubmit holds the BIO pointer to submit to the target
+ * device. For data and plain metadata writes when USE_BIOMAP is
+ * enabled, kvio->biosMerged is the list of all bios collected together
+ * in this group; all of them get submitted, with runs of sequential
+ * reads or writes coalesced into single bios. In all cases, the bi_end_io
+ * callback is invoked when each I/O operation completes.
  *
  * @param item  The work item in the KVIO "owning" either the bio to
  *              submit, or the head of the bio_list to be submitted.
@@ -214,7 +682,7 @@ static void processBioMap(KvdoWorkItem *item)
    * in the caller, or in the callback function? Should we call
    * finishBioQueue for the biomap case on old kernels?
    */
-  if (USE_BIOMAP && isData(kvio)) {
+  if (USE_BIOMAP && isMergeable(kvio, kvio->bioToSubmit)) {
     // We need to make sure to do two things here:
     // 1. Use each bio's kvio when submitting. Any other kvio is not safe
     // 2. Detach the bio list from the kvio before submitting, because it
@@ -227,25 +695,24 @@ static void processBioMap(KvdoWorkItem *item)
       intMapRemove(bioQueueData->map, getBioSector(kvio->biosMerged.tail));
     }
     bio = kvio->biosMerged.head;
+    unsigned int count = bio_list_size(&kvio->biosMerged);
     bio_list_init(&kvio->biosMerged);
     mutex_unlock(&bioQueueData->lock);
     // Somewhere in the list we'll be submitting the current "kvio",
     // so drop our handle on it now.
     kvio = NULL;
 
+    assertRunningInBioQueue();
     while (bio != NULL) {
-      KVIO *kvioBio = bio->bi_private;
-      BIO  *next    = bio->bi_next;
-      bio->bi_next  = NULL;
-      setBioBlockDevice(bio, getKernelLayerBdev(kvioBio->layer));
-      kvioBio->bioSubmissionCallback(&kvioBio->enqueueable.workItem);
-      bio = next;
+      bio = submitNextBios(bio);
     }
+    atomic_sub(count, &bioQueueData->depth);
   } else {
+    BioQueueData *bioQueueData = getWorkQueuePrivateData();
     kvio->bioSubmissionCallback(&kvio->enqueueable.workItem);
+    atomic_dec(&bioQueueData->depth);
 #if LINUX_VERSION_CODE <= KERNEL_VERSION(2,6,38)
     //if journaling, kick the queue to make the requests leave faster
-    BioQueueData *bioQueueData = getWorkQueuePrivateData();
     finishBioQueue(bioQueueData);
 #endif
   }
@@ -307,14 +774,46 @@ static KVIO *getMergeableLocked(IntMap       *map,
   return kvioMerge;
 }
 
-/**********************************************************************/
-static inline unsigned int advanceBioRotor(IOSubmitter *bioData)
+/**
+ * Pick a bio queue round-robin. The rotor is not updated atomically, so
+ * racing submitters may pick the same queue, which is harmless.
+ *
+ * @param ioSubmitter  The I/O submitter
+ *
+ * @return The bio queue
+ **/
+static inline BioQueueData *advanceBioRotor(IOSubmitter *ioSubmitter)
+{
+  unsigned int index
+    = ioSubmitter->bioQueueRotor++ % ioSubmitter->numBioQueuesUsed;
+  return &ioSubmitter->bioQueueData[index];
+}
+
+/**
+ * Choose the bio queue for a data bio. The bio goes to the queue for its
+ * PBN, where it can be merged with its neighbors, unless that queue has
+ * backed up far beyond another queue sampled round-robin; comparing
+ * against a single sample keeps the choice cheap however many bio
+ * threads there are.
+ *
+ * @param ioSubmitter  The I/O submitter
+ * @param home         The bio queue for the bio's PBN
+ *
+ * @return The bio queue to use
+ **/
+static BioQueueData *chooseDataBioQueue(IOSubmitter  *ioSubmitter,
+                                        BioQueueData *home)
 {
-  unsigned int index = bioData->bioQueueRotor++
-                       % (bioData->numBioQueuesUsed
-                          * bioData->bioQueueRotationInterval);
-  index /= bioData->bioQueueRotationInterval;
-  return index;
+  if (ioSubmitter->numBioQueuesUsed == 1) {
+    return home;
+  }
+
+  BioQueueData *other = advanceBioRotor(ioSubmitter);
+  if (atomic_read(&home->depth)
+      > atomic_read(&other->depth) + BIO_QUEUE_SPILL_DEPTH) {
+    return other;
+  }
+  return home;
 }
 
 /**********************************************************************/
@@ -407,6 +906,9 @@ void enqueueBioMap(BIO                 *bio,
 
   KernelLayer  *layer = kvio->layer;
   BioQueueData *bioQueueData = bioQueueDataForPBN(layer->ioSubmitter, pbn);
+  if (isData(kvio)) {
+    bioQueueData = chooseDataBioQueue(layer->ioSubmitter, bioQueueData);
+  }
 
   kvioAddTraceRecord(kvio, THIS_LOCATION("$F($io)"));
 
@@ -414,6 +916,13 @@ void enqueueBioMap(BIO                 *bio,
   bio_list_init(&kvio->biosMerged);
   bio_list_add(&kvio->biosMerged, bio);
 
+  // Any block written may have been cached.
+  if (!isReadBio(bio) && (getBioSize(bio) > 0)) {
+    invalidateCachedBlocks(layer->physicalBlockCache,
+                           sectorToBlock(layer, getBioSector(bio)),
+                           DIV_ROUND_UP(getBioSize(bio), VDO_BLOCK_SIZE));
+  }
+
   /*
    * Enabling of MD RAID5 mode optimizes performance for MD RAID5 storage
    * configurations.  It clears the bits for sync I/O RW flags on data block
@@ -441,8 +950,15 @@ void enqueueBioMap(BIO                 *bio,
     }
   }
 
+  if ((callback == submitBioWork) && !needsMainDeviceFlush(kvio, bio)
+      && canSubmitDirectly(bioQueueData)) {
+    submitBioDirectly(kvio, bio);
+    return;
+  }
+
+  atomic_inc(&bioQueueData->depth);
   bool merged = false;
-  if (USE_BIOMAP && isData(kvio)) {
+  if (USE_BIOMAP && isMergeable(kvio, bio)) {
     merged = tryBioMapMerge(bioQueueData, kvio, bio);
   }
   if (!merged) {
@@ -502,6 +1018,15 @@ int makeIOSubmitter(const char    *threadNamePrefix,
     return result;
   }
 
+  ioSubmitter->pollLatencyHistogram
+    = makeShardedHistogram(&layer->kobj, "bio_poll_latency",
+                           "Polled Bio Latency", "bios", "latency",
+                           "microseconds");
+  if (ioSubmitter->pollLatencyHistogram == NULL) {
+    FREE(ioSubmitter);
+    return -ENOMEM;
+  }
+
   // Setup for each bio-submission work queue
   char queueName[MAX_QUEUE_NAME_LEN];
   ioSubmitter->bioQueueRotationInterval = rotationInterval;
@@ -574,6 +1099,7 @@ void freeIOSubmitter(IOSubmitter *ioSubmitter)
       freeIntMap(&ioSubmitter->bioQueueData[i].map);
     }
   }
+  freeHistogram(&ioSubmitter->pollLatencyHistogram);
   FREE(ioSubmitter);
 }
 
@@ -581,10 +1107,43 @@ void freeIOSubmitter(IOSubmitter *ioSubmitter)
 void dumpBioWorkQueue(IOSubmitter *ioSubmitter)
 {
   for (int i=0; i < ioSubmitter->numBioQueuesUsed; i++) {
+    logInfo("bio queue %d depth %d", i,
+            atomic_read(&ioSubmitter->bioQueueData[i].depth));
     dumpWorkQueue(ioSubmitter->bioQueueData[i].queue);
   }
 }
 
+/**********************************************************************/
+ssize_t formatBioQueueDepths(IOSubmitter *ioSubmitter,
+                             char        *buffer,
+                             size_t       length)
+{
+  size_t used = 0;
+  for (unsigned int i = 0; i < ioSubmitter->numBioQueuesUsed; i++) {
+    used += scnprintf(buffer + used, length - used, "%s%d",
+                      ((i == 0) ? "" : " "),
+                      atomic_read(&ioSubmitter->bioQueueData[i].depth));
+  }
+  used += scnprintf(buffer + used, length - used, "\n");
+  return used;
+}
+
+/**********************************************************************/
+ssize_t formatBioPollingStats(IOSubmitter *ioSubmitter, char *buffer)
+{
+  uint64_t polledBios = 0;
+  uint64_t pollCalls  = 0;
+  uint64_t pollTime   = 0;
+  for (unsigned int i = 0; i < ioSubmitter->numBioQueuesUsed; i++) {
+    BioQueueData *bioQueueData = &ioSubmitter->bioQueueData[i];
+    polledBios += READ_ONCE(bioQueueData->polledBios);
+    pollCalls  += READ_ONCE(bioQueueData->pollCalls);
+    pollTime   += READ_ONCE(bioQueueData->pollTime);
+  }
+  return sprintf(buffer, "%" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+                 polledBios, pollCalls, pollTime);
+}
+
 
 /**********************************************************************/
 void enqueueByPBNBioWorkItem(IOSubmitter         *ioSubmitter,
@@ -598,9 +1157,12 @@ void enqueueByPBNBioWorkItem(IOSubmitter         *ioSubmitter,
 /**********************************************************************/
 void enqueueBioWorkItem(IOSubmitter *ioSubmitter, KvdoWorkItem *workItem)
 {
-  unsigned int bioQueueIndex = advanceBioRotor(ioSubmitter);
-  enqueueWorkQueue(ioSubmitter->bioQueueData[bioQueueIndex].queue,
-                   workItem);
+  BioQueueData *bioQueueData = advanceBioRotor(ioSubmitter);
+  BioQueueData *other        = advanceBioRotor(ioSubmitter);
+  if (atomic_read(&other->depth) < atomic_read(&bioQueueData->depth)) {
+    bioQueueData = other;
+  }
+  enqueueWorkQueue(bioQueueData->queue, workItem);
 }
 
 /**********************************************************************/
@@ -30,6 +30,13 @@
 #include "kernelLayer.h"
 #include "kvio.h"
 
+/**
+ * Whether a bio may be sent to the device from the thread submitting it,
+ * rather than through a bio thread, when that bio thread is idle. Settable
+ * through sysfs.
+ **/
+extern bool directBioSubmission;
+
 /**
  * Does all the appropriate accounting for bio completions
  *
@@ -71,9 +78,8 @@ void completeAsyncBio(BIO *bio, int error);
  *
  * @param [in]  threadNamePrefix  The per-device prefix to use in process names
  * @param [in]  threadCount       Number of bio-submission threads to set up
- * @param [in]  rotationInterval  Interval to use when rotating between
- *                                bio-submission threads when enqueuing work
- *                                items
+ * @param [in]  rotationInterval  The number of consecutive PBNs assigned to
+ *                                each bio-submission thread in turn
  * @param [in]  maxRequestsActive Number of bios for merge tracking
  * @param [in]  layer             The kernel layer
  * @param [out] ioSubmitter       Pointer to the new data structure
@@ -113,6 +119,34 @@ void freeIOSubmitter(IOSubmitter *ioSubmitter);
  **/
 void dumpBioWorkQueue(IOSubmitter *ioSubmitter);
 
+/**
+ * Format the depth of each bio-submission thread's queue, the number of
+ * bios handed to it which it has not yet sent to the device, into a
+ * buffer for reporting via sysfs.
+ *
+ * @param [in]  ioSubmitter  The I/O submitter data
+ * @param [out] buffer       The buffer in which to report the depths
+ * @param [in]  length       The size of the buffer
+ *
+ * @return The number of bytes written to the buffer
+ **/
+ssize_t formatBioQueueDepths(IOSubmitter *ioSubmitter,
+                             char        *buffer,
+                             size_t       length);
+
+/**
+ * Format the number of bios the bio-submission threads have polled for,
+ * the number of polls made, and the time spent polling in nanoseconds
+ * into a buffer for reporting via sysfs. The time spent is the CPU cost
+ * of polling; the bio_poll_latency histogram gives the latency.
+ *
+ * @param [in]  ioSubmitter  The I/O submitter data
+ * @param [out] buffer       The buffer in which to report the statistics
+ *
+ * @return The number of bytes written to the buffer
+ **/
+ssize_t formatBioPollingStats(IOSubmitter *ioSubmitter, char *buffer);
+
 
 /**
  * Enqueue a work item to run in the work queue(s) used for bio
@@ -29,6 +29,8 @@
 
 #include "ioSubmitter.h"
 
+#include "histogram.h"
+
 /*
  * Submission of bio operations to the underlying storage device will
  * go through a separate work queue thread (or more than one) to
@@ -38,8 +40,12 @@
  *
  * When multiple worker threads are used, a thread is chosen for a
  * read cache or I/O operation submission based on the PBN, so a given
- * PBN will consistently wind up on the same thread. Flush operations
- * are assigned round-robin.
+ * PBN will usually wind up on the same thread, where it may be merged
+ * with its neighbors. Metadata always goes to that thread, but a data
+ * bio whose thread is much busier than another goes to the other one
+ * instead. Flush operations go to the less busy of two threads taken
+ * round-robin. Each thread's depth counts the bios handed to it which
+ * it has not yet sent to the device.
  *
  * The map (protected by the mutex) collects pending I/O operations so
  * that the worker thread can reorder them to try to encourage I/O
@@ -58,12 +64,21 @@ typedef struct bioQueueData {
   IntMap                *map;
   struct mutex           lock;
   unsigned int           queueNumber;
+  atomic_t               depth;
+  // Bios this thread has polled for, updated only by this thread
+  uint64_t               polledBios;
+  // Calls to blk_poll made while polling
+  uint64_t               pollCalls;
+  // Time spent polling (ns)
+  uint64_t               pollTime;
 } BioQueueData;
 
 struct ioSubmitter {
   unsigned int     numBioQueuesUsed;
   unsigned int     bioQueueRotationInterval;
   unsigned int     bioQueueRotor;
+  /** How long polled bios took to complete (microseconds) */
+  Histogram       *pollLatencyHistogram;
   BioQueueData     bioQueueData[];
 };
 
@@ -29,7 +29,6 @@
 #include "memoryAlloc.h"
 #include "murmur/MurmurHash3.h"
 
-#include "lz4.h"
 #include "releaseVersions.h"
 #include "volumeGeometry.h"
 #include "statistics.h"
@@ -45,12 +44,15 @@
 #include "kvdoFlush.h"
 #include "kvio.h"
 #include "poolSysfs.h"
+#include "sharedWorkQueue.h"
 #include "statusProcfs.h"
 #include "stringUtils.h"
 #include "verify.h"
 
 enum {
   DEDUPE_TIMEOUT_REPORT_INTERVAL = 1000,
+  /** How long after memory pressure to regrow the block map cache */
+  CACHE_REGROW_DELAY_MS          = 30 * 1000,
 };
 
 static const KvdoWorkQueueType bioAckQType = {
@@ -62,6 +64,9 @@ static const KvdoWorkQueueType bioAckQType = {
 };
 
 static const KvdoWorkQueueType cpuQType = {
+  // Work on the CPU queues doesn't depend on the thread running it.
+  .workStealing = true,
+  .spinPolling  = true,
   .actionTable = {
     { .name = "cpu_complete_kvio",
       .code = CPU_Q_ACTION_COMPLETE_KVIO,
@@ -75,6 +80,9 @@ static const KvdoWorkQueueType cpuQType = {
     { .name = "cpu_event_reporter",
       .code = CPU_Q_ACTION_EVENT_REPORTER,
       .priority = 0 },
+    { .name = "cpu_read_ahead",
+      .code = CPU_Q_ACTION_READ_AHEAD,
+      .priority = 0 },
   },
 };
 
@@ -229,7 +237,7 @@ static int launchDataKVIOFromVDOThread(KernelLayer *layer,
   bool hasDiscardPermit
     = (isDiscardBio(bio) && limiterPoll(&layer->discardLimiter));
   int result = kvdoLaunchDataKVIOFromBio(layer, bio, arrivalTime,
-                                         hasDiscardPermit);
+                                         hasDiscardPermit, INTAKE_CLASS_NONE);
   // Succeed or fail, kvdoLaunchDataKVIOFromBio owns the permit(s) now.
   if (result != VDO_SUCCESS) {
     return result;
@@ -238,6 +246,35 @@ static int launchDataKVIOFromVDOThread(KernelLayer *layer,
   return DM_MAPIO_SUBMITTED;
 }
 
+/**
+ * Determine the intake class of a bio from its I/O priority class. Bios
+ * with no priority class are best effort, as they are to the I/O
+ * schedulers. Discards may be configured to run as idle requests so that a
+ * large trim yields to foreground I/O.
+ *
+ * @param layer  The layer receiving the bio
+ * @param bio    The bio
+ *
+ * @return The intake class of the bio
+ **/
+static IntakeClass getIntakeClass(KernelLayer *layer, BIO *bio)
+{
+  if (layer->discardsIdle && isDiscardBio(bio)) {
+    return INTAKE_CLASS_IDLE;
+  }
+
+  switch (getBioPriorityClass(bio)) {
+  case IOPRIO_CLASS_RT:
+    return INTAKE_CLASS_REALTIME;
+
+  case IOPRIO_CLASS_IDLE:
+    return INTAKE_CLASS_IDLE;
+
+  default:
+    return INTAKE_CLASS_BEST_EFFORT;
+  }
+}
+
 /**********************************************************************/
 int kvdoMapBio(KernelLayer *layer, BIO *bio)
 {
@@ -280,10 +317,11 @@ int kvdoMapBio(KernelLayer *layer, BIO *bio)
 
   KvdoWorkQueue *currentWorkQueue = getCurrentWorkQueue();
   if ((currentWorkQueue != NULL)
-      && (layer == getWorkQueueOwner(currentWorkQueue))) {
+      && ((layer == getWorkQueueOwner(currentWorkQueue))
+          || isSharedWorkQueue(currentWorkQueue))) {
     /*
      * This prohibits sleeping during I/O submission to VDO from its own
-     * thread.
+     * thread, or from a shared thread which this VDO may be waiting on.
      */
     return launchDataKVIOFromVDOThread(layer, bio, arrivalTime);
   }
@@ -292,10 +330,14 @@ int kvdoMapBio(KernelLayer *layer, BIO *bio)
     limiterWaitForOneFree(&layer->discardLimiter);
     hasDiscardPermit = true;
   }
+  // A class which has used up its share waits here, behind its own limit,
+  // rather than in the shared queue for the request limiter.
+  IntakeClass intakeClass = getIntakeClass(layer, bio);
+  limiterWaitForOneFree(&layer->intakeLimiters[intakeClass]);
   limiterWaitForOneFree(&layer->requestLimiter);
 
   int result = kvdoLaunchDataKVIOFromBio(layer, bio, arrivalTime,
-                                         hasDiscardPermit);
+                                         hasDiscardPermit, intakeClass);
   // Succeed or fail, kvdoLaunchDataKVIOFromBio owns the permit(s) now.
   if (result != VDO_SUCCESS) {
     return result;
@@ -310,6 +352,184 @@ struct block_device *getKernelLayerBdev(const KernelLayer *layer)
   return layer->deviceConfig->ownedDevice->bdev;
 }
 
+/**
+ * The partitions which may be placed on a journal device, in the order in
+ * which they are laid out there. The reference counts and journals of the
+ * slabs, which may grow, follow them.
+ **/
+static const struct {
+  PartitionID id;
+  VIOType     vioType;
+} journalDevicePartitions[] = {
+  { RECOVERY_JOURNAL_PARTITION, VIO_TYPE_RECOVERY_JOURNAL,   },
+  { SLAB_SUMMARY_PARTITION,     VIO_TYPE_SLAB_SUMMARY,       },
+  { BLOCK_MAP_PARTITION,        VIO_TYPE_BLOCK_MAP_INTERIOR, },
+};
+
+/**
+ * Check whether one of the partitions which may be placed on a journal
+ * device is placed there by a configuration.
+ *
+ * @param config  The device configuration
+ * @param index   The index of the partition in journalDevicePartitions
+ *
+ * @return true if the partition is on the journal device
+ **/
+static bool isOnJournalDevice(const DeviceConfig *config, unsigned int index)
+{
+  switch (journalDevicePartitions[index].id) {
+  case RECOVERY_JOURNAL_PARTITION:
+    return true;
+
+  case SLAB_SUMMARY_PARTITION:
+    return config->journalDeviceSummary;
+
+  default:
+    return config->journalDeviceMetadata;
+  }
+}
+
+/**
+ * Walk the metadata placed on a layer's journal device, finding where a
+ * block is on that device, and how many blocks the device must hold.
+ *
+ * @param [in]  layer      The kernel layer
+ * @param [in]  vioType    The type of the VIO accessing the block
+ * @param [in]  pbn        The block in the layout of the main device
+ * @param [out] blockPtr   A pointer to hold the block on the journal device,
+ *                         if it is placed there; may be NULL
+ * @param [out] blocksPtr  A pointer to hold the size the journal device must
+ *                         be; may be NULL
+ *
+ * @return true if the block is on the journal device
+ **/
+static bool findJournalDeviceBlock(KernelLayer         *layer,
+                                   VIOType              vioType,
+                                   PhysicalBlockNumber  pbn,
+                                   PhysicalBlockNumber *blockPtr,
+                                   BlockCount          *blocksPtr)
+{
+  DeviceConfig *config = layer->deviceConfig;
+  if (config->journalDevice == NULL) {
+    return false;
+  }
+
+  BlockCount base = 0;
+  for (unsigned int i = 0; i < COUNT_OF(journalDevicePartitions); i++) {
+    if (!isOnJournalDevice(config, i)) {
+      continue;
+    }
+
+    PhysicalBlockNumber offset;
+    BlockCount          size;
+    if (!getKVDOPartitionExtent(&layer->kvdo, journalDevicePartitions[i].id,
+                                &offset, &size)) {
+      return false;
+    }
+
+    /*
+     * VIOs of the partition's type may also write just past it, when the
+     * layout is being grown and the partition will move; such copies stay
+     * on the main device.
+     */
+    if ((vioType == journalDevicePartitions[i].vioType)
+        && (pbn >= offset) && (pbn < offset + size)) {
+      if (blockPtr != NULL) {
+        *blockPtr = base + (pbn - offset);
+      }
+      return true;
+    }
+    base += size;
+  }
+
+  if (config->journalDeviceMetadata) {
+    BlockCount index;
+    if (((vioType == VIO_TYPE_SLAB_JOURNAL)
+         || (vioType == VIO_TYPE_BLOCK_ALLOCATOR))
+        && getKVDOSlabMetadataIndex(&layer->kvdo, pbn, &index)) {
+      if (blockPtr != NULL) {
+        *blockPtr = base + index;
+      }
+      return true;
+    }
+    base += getKVDOSlabMetadataBlockCount(&layer->kvdo);
+  }
+
+  if (blocksPtr != NULL) {
+    *blocksPtr = base;
+  }
+  return false;
+}
+
+/**
+ * Check that a layer's journal device is large enough to hold the metadata
+ * placed on it.
+ *
+ * @param layer  The kernel layer
+ *
+ * @return VDO_SUCCESS or VDO_PARAMETER_MISMATCH
+ **/
+static int checkJournalDeviceSize(KernelLayer *layer)
+{
+  struct dm_dev *journalDevice = layer->deviceConfig->journalDevice;
+  if (journalDevice == NULL) {
+    return VDO_SUCCESS;
+  }
+
+  BlockCount blocks = 0;
+  if (findJournalDeviceBlock(layer, VIO_TYPE_UNINITIALIZED, 0, NULL,
+                             &blocks)) {
+    return VDO_SUCCESS;
+  }
+
+  if (i_size_read(journalDevice->bdev->bd_inode) < blocks * VDO_BLOCK_SIZE) {
+    logError("journal device holds fewer than the %" PRIu64
+             " blocks needed", blocks);
+    return VDO_PARAMETER_MISMATCH;
+  }
+  return VDO_SUCCESS;
+}
+
+/**
+ * Check that a layer's index device is large enough to hold the index
+ * region described by the geometry.
+ *
+ * @param layer  The kernel layer
+ *
+ * @return VDO_SUCCESS or VDO_PARAMETER_MISMATCH
+ **/
+static int checkIndexDeviceSize(KernelLayer *layer)
+{
+  struct dm_dev *indexDevice = layer->deviceConfig->indexDevice;
+  if (indexDevice == NULL) {
+    return VDO_SUCCESS;
+  }
+
+  BlockCount blocks = getIndexRegionSize(layer->geometry);
+  if (i_size_read(indexDevice->bdev->bd_inode) < blocks * VDO_BLOCK_SIZE) {
+    logError("index device holds fewer than the %" PRIu64 " blocks needed",
+             blocks);
+    return VDO_PARAMETER_MISMATCH;
+  }
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+struct block_device *mapMetadataBlock(KernelLayer         *layer,
+                                      VIOType              vioType,
+                                      PhysicalBlockNumber  pbn,
+                                      sector_t            *sectorPtr)
+{
+  PhysicalBlockNumber block;
+  if (findJournalDeviceBlock(layer, vioType, pbn, &block, NULL)) {
+    *sectorPtr = blockToSector(layer, block);
+    return layer->deviceConfig->journalDevice->bdev;
+  }
+
+  *sectorPtr = blockToSector(layer, pbn);
+  return getKernelLayerBdev(layer);
+}
+
 /**********************************************************************/
 void completeManyRequests(KernelLayer *layer, uint32_t count)
 {
@@ -324,7 +544,8 @@ void completeManyRequests(KernelLayer *layer, uint32_t count)
     bool hasDiscardPermit
       = (isDiscardBio(bio) && limiterPoll(&layer->discardLimiter));
     int result = kvdoLaunchDataKVIOFromBio(layer, bio, arrivalTime,
-                                           hasDiscardPermit);
+                                           hasDiscardPermit,
+                                           INTAKE_CLASS_NONE);
     if (result != VDO_SUCCESS) {
       completeBio(bio, result);
     }
@@ -494,7 +715,12 @@ static int kvdoSynchronousRead(PhysicalLayer       *layer,
   bio->bi_private = &bioWait;
   setBioBlockDevice(bio, getKernelLayerBdev(kernelLayer));
   setBioSector(bio, blockToSector(kernelLayer, startBlock));
-  generic_make_request(bio);
+  if (kernelLayer->ramBacking != NULL) {
+    submitToRAMBacking(kernelLayer->ramBacking,
+                       getKernelLayerBdev(kernelLayer), bio);
+  } else {
+    generic_make_request(bio);
+  }
   wait_for_completion(&bioWait);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
   if (getBioResult(bio) != 0) {
@@ -609,6 +835,88 @@ static int makeDedupeBioSet(KernelLayer *layer)
   return VDO_SUCCESS;
 }
 
+/**
+ * Spread the bio ack threads over the NUMA nodes and choose, for each CPU,
+ * the ack batch (and so the ack thread) which will acknowledge the bios
+ * submitted from it: one on the same node if there is any, so that a
+ * DataKVIO's cache lines are not pulled across sockets just to complete its
+ * bio.
+ *
+ * @param layer  The kernel layer, whose ack batches must have been made
+ *
+ * @return VDO_SUCCESS or -ENOMEM
+ **/
+static int setUpAckAffinity(KernelLayer *layer)
+{
+  unsigned int threads = layer->deviceConfig->threadCounts.bioAckThreads;
+  for (unsigned int i = 0; i < threads; i++) {
+    KvdoWorkQueue *queue  = getWorkQueueServiceQueue(layer->bioAckQueue, i);
+    int            node   = getNodeForZone(i);
+    int            result = bindWorkQueueToNode(queue, node);
+    if (result != 0) {
+      // The acks still work, they just aren't kept near their submitters.
+      logWarningWithStringError(result,
+                                "cannot bind bio ack thread %u to NUMA node"
+                                " %d", i, node);
+    }
+  }
+
+  int result = ALLOCATE(nr_cpu_ids, unsigned int, "bio ack batch for CPU",
+                        &layer->bioAckBatchForCPU);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  unsigned int cpu;
+  for_each_possible_cpu(cpu) {
+    int          node  = cpu_to_node(cpu);
+    unsigned int local = 0;
+    for (unsigned int i = 0; i < threads; i++) {
+      if (getNodeForZone(i) == node) {
+        local++;
+      }
+    }
+
+    layer->bioAckBatchForCPU[cpu] = cpu % threads;
+    if (local == 0) {
+      continue;
+    }
+
+    unsigned int pick = cpu % local;
+    for (unsigned int i = 0; i < threads; i++) {
+      if ((getNodeForZone(i) == node) && (pick-- == 0)) {
+        layer->bioAckBatchForCPU[cpu] = i;
+        break;
+      }
+    }
+  }
+  return VDO_SUCCESS;
+}
+
+/**
+ * Make the histograms of the time writes spend in each write stage. They
+ * appear in the layer's sysfs directory as write_stage_<stage>_latency.
+ *
+ * @param layer  The kernel layer
+ *
+ * @return VDO_SUCCESS or -ENOMEM
+ **/
+static int makeWriteStageHistograms(KernelLayer *layer)
+{
+  for (WriteStage stage = 0; stage < WRITE_STAGE_COUNT; stage++) {
+    char name[64];
+    snprintf(name, sizeof(name), "write_stage_%s_latency",
+             getWriteStageName(stage));
+    layer->writeStageHistograms[stage]
+      = makeShardedHistogram(&layer->kobj, name, "Write Stage Latency",
+                             "writes", "latency", "microseconds");
+    if (layer->writeStageHistograms[stage] == NULL) {
+      return -ENOMEM;
+    }
+  }
+  return VDO_SUCCESS;
+}
+
 /**********************************************************************/
 int makeKernelLayer(uint64_t        startingSector,
                     unsigned int    instance,
@@ -692,6 +1000,9 @@ int makeKernelLayer(uint64_t        startingSector,
   int requestLimit = defaultMaxRequestsActive;
   initializeLimiter(&layer->requestLimiter, requestLimit);
   initializeLimiter(&layer->discardLimiter, requestLimit * 3 / 4);
+  for (IntakeClass class = 0; class < INTAKE_CLASS_COUNT; class++) {
+    initializeLimiter(&layer->intakeLimiters[class], requestLimit);
+  }
 
   layer->allocationsAllowed   = true;
   layer->instance             = instance;
@@ -714,12 +1025,14 @@ int makeKernelLayer(uint64_t        startingSector,
   layer->common.compareDataVIOs          = kvdoCompareDataVIOs;
   layer->common.copyData                 = kvdoCopyDataVIO;
   layer->common.readData                 = kvdoReadDataVIO;
+  layer->common.prefetchData             = kvdoPrefetchData;
   layer->common.writeData                = kvdoWriteDataVIO;
   layer->common.writeCompressedBlock     = kvdoWriteCompressedBlock;
   layer->common.readMetadata             = kvdoSubmitMetadataVIO;
   layer->common.writeMetadata            = kvdoSubmitMetadataVIO;
   layer->common.applyPartialWrite        = kvdoModifyWriteDataVIO;
   layer->common.flush                    = kvdoFlushVIO;
+  layer->common.discardBlocks            = kvdoDiscardVIO;
   layer->common.hashData                 = kvdoHashDataVIO;
   layer->common.checkForDuplication      = kvdoCheckForDuplication;
   layer->common.verifyDuplication        = kvdoVerifyDuplication;
@@ -744,18 +1057,23 @@ int makeKernelLayer(uint64_t        startingSector,
   result = makeThreadConfig(config->threadCounts.logicalZones,
                             config->threadCounts.physicalZones,
                             config->threadCounts.hashZones,
+                            config->threadCounts.packerZones,
                             threadConfigPointer);
   if (result != VDO_SUCCESS) {
     *reason = "Cannot create thread configuration";
     freeKernelLayer(layer);
     return result;
   }
+  placeZoneThreads(*threadConfigPointer, config->numaPlacement);
 
-  logInfo("zones: %d logical, %d physical, %d hash; base threads: %d",
+  logInfo("zones: %d logical, %d physical, %d hash, %d packer;"
+          " base threads: %d; NUMA placement: %s",
           config->threadCounts.logicalZones,
           config->threadCounts.physicalZones,
           config->threadCounts.hashZones,
-          (*threadConfigPointer)->baseThreadCount);
+          (*threadConfigPointer)->packerZoneCount,
+          (*threadConfigPointer)->baseThreadCount,
+          getNumaPlacementName(config->numaPlacement));
 
   result = makeBatchProcessor(layer, returnDataKVIOBatchToPool, layer,
                               &layer->dataKVIOReleaser);
@@ -765,6 +1083,51 @@ int makeKernelLayer(uint64_t        startingSector,
     return result;
   }
 
+  result = makeWriteStageHistograms(layer);
+  if (result != VDO_SUCCESS) {
+    *reason = "Cannot allocate write stage histograms";
+    freeKernelLayer(layer);
+    return result;
+  }
+
+  layer->flushLatencyHistogram
+    = makeShardedJiffiesHistogram(&layer->kobj, "flush_latency",
+                                  "Flush Latency", "flushes", "latency");
+  layer->flushBatchHistogram
+    = makeLogarithmicHistogram(&layer->kobj, "flush_batch_size",
+                               "Flush Batch Size", "storage flushes",
+                               "flush bios", "bios", 3);
+  if ((layer->flushLatencyHistogram == NULL)
+      || (layer->flushBatchHistogram == NULL)) {
+    *reason = "Cannot allocate flush histograms";
+    freeKernelLayer(layer);
+    return -ENOMEM;
+  }
+
+  result = makeChunkHasher(config->dedupeHash, &layer->chunkHasher);
+  if (result != VDO_SUCCESS) {
+    *reason = "Cannot allocate chunk hasher";
+    freeKernelLayer(layer);
+    return result;
+  }
+
+  result = ALLOCATE(config->threadCounts.cpuThreads, BatchProcessor *,
+                    "KVIO hashers", &layer->dataKVIOHashers);
+  if (result != VDO_SUCCESS) {
+    *reason = "Cannot allocate KVIO hashing batch processors";
+    freeKernelLayer(layer);
+    return result;
+  }
+  for (int i = 0; i < config->threadCounts.cpuThreads; i++) {
+    result = makeBatchProcessor(layer, hashDataKVIOBatch, layer,
+                                &layer->dataKVIOHashers[i]);
+    if (result != UDS_SUCCESS) {
+      *reason = "Cannot allocate KVIO hashing batch processor";
+      freeKernelLayer(layer);
+      return result;
+    }
+  }
+
   // Spare KVDOFlush, so that we will always have at least one available
   result = makeKVDOFlush(&layer->spareKVDOFlush);
   if (result != UDS_SUCCESS) {
@@ -781,6 +1144,16 @@ int makeKernelLayer(uint64_t        startingSector,
     return result;
   }
 
+  // In-memory storage (also needed before the geometry block)
+  if (config->ramBackingEnabled) {
+    result = makeRAMBacking(layer, &layer->ramBacking);
+    if (result != VDO_SUCCESS) {
+      *reason = "Cannot allocate RAM backing";
+      freeKernelLayer(layer);
+      return result;
+    }
+  }
+
   // Read the geometry block so we know how to set up the index. Allow it to
   // do synchronous reads.
   layer->common.reader = kvdoSynchronousRead;
@@ -807,18 +1180,52 @@ int makeKernelLayer(uint64_t        startingSector,
   }
 
   // Compression context storage
-  result = ALLOCATE(config->threadCounts.cpuThreads, char *, "LZ4 context",
-                    &layer->compressionContext);
+  result = ALLOCATE(config->threadCounts.cpuThreads, CompressionContext *,
+                    "compression contexts", &layer->compressionContext);
   if (result != VDO_SUCCESS) {
-    *reason = "cannot allocate LZ4 context";
+    *reason = "cannot allocate compression contexts";
     freeKernelLayer(layer);
     return result;
   }
   for (int i = 0; i < config->threadCounts.cpuThreads; i++) {
-    result = ALLOCATE(LZ4_context_size(), char, "LZ4 context",
-                      &layer->compressionContext[i]);
+    result = makeCompressionContext(config->compressionEngine,
+                                    config->compressionLevel,
+                                    &layer->compressionContext[i]);
     if (result != VDO_SUCCESS) {
-      *reason = "cannot allocate LZ4 context";
+      *reason = "cannot allocate compression context";
+      freeKernelLayer(layer);
+      return result;
+    }
+  }
+
+  result = makeFragmentDecoder(&layer->fragmentDecoder);
+  if (result != VDO_SUCCESS) {
+    *reason = "cannot allocate fragment decoder";
+    freeKernelLayer(layer);
+    return result;
+  }
+
+  result = makePhysicalBlockCache(config->readCacheBlocks,
+                                  &layer->physicalBlockCache);
+  if (result != VDO_SUCCESS) {
+    *reason = "cannot allocate physical block cache";
+    freeKernelLayer(layer);
+    return result;
+  }
+
+  result = ALLOCATE(config->threadCounts.cpuThreads, BatchProcessor *,
+                    "KVIO compressors", &layer->dataKVIOCompressors);
+  if (result != VDO_SUCCESS) {
+    *reason = "Cannot allocate KVIO compression batch processors";
+    freeKernelLayer(layer);
+    return result;
+  }
+  for (int i = 0; i < config->threadCounts.cpuThreads; i++) {
+    result = makeBatchProcessor(layer, compressDataKVIOBatch,
+                                layer->compressionContext[i],
+                                &layer->dataKVIOCompressors[i]);
+    if (result != UDS_SUCCESS) {
+      *reason = "Cannot allocate KVIO compression batch processor";
       freeKernelLayer(layer);
       return result;
     }
@@ -854,6 +1261,14 @@ int makeKernelLayer(uint64_t        startingSector,
     return result;
   }
 
+  // Read-ahead staging buffers
+  result = makeReadAhead(layer, &layer->readAhead);
+  if (result != VDO_SUCCESS) {
+    *reason = "Cannot allocate read-ahead buffers";
+    freeKernelLayer(layer);
+    return result;
+  }
+
   /*
    * Part 4 - Do initializations that depend upon other previous
    * initialization, that may have order dependencies at freeing time.
@@ -887,10 +1302,22 @@ int makeKernelLayer(uint64_t        startingSector,
 
   // Bio ack queue
   if (useBioAckQueue(layer)) {
-    result = makeWorkQueue(layer->threadNamePrefix, "ackQ",
-                           &layer->wqDirectory, layer, layer, &bioAckQType,
-                           config->threadCounts.bioAckThreads,
-                           &layer->bioAckQueue);
+    // Ack affinity binds the ack threads to nodes, so it needs its own.
+    if (!config->ackAffinityEnabled) {
+      result = acquireSharedBioAckQueue(&bioAckQType, &layer->bioAckQueue);
+      if (result != VDO_SUCCESS) {
+        *reason = "shared bio ack queue initialization failed";
+        freeKernelLayer(layer);
+        return result;
+      }
+    }
+
+    if (layer->bioAckQueue == NULL) {
+      result = makeWorkQueue(layer->threadNamePrefix, "ackQ",
+                             &layer->wqDirectory, layer, layer, &bioAckQType,
+                             config->threadCounts.bioAckThreads,
+                             &layer->bioAckQueue);
+    }
     if (result != VDO_SUCCESS) {
       *reason = "bio ack queue initialization failed";
       freeKernelLayer(layer);
@@ -900,6 +1327,41 @@ int makeKernelLayer(uint64_t        startingSector,
 
   setKernelLayerState(layer, LAYER_BIO_ACK_QUEUE_INITIALIZED);
 
+  if (useBioAckQueue(layer)) {
+    result = ALLOCATE(config->threadCounts.bioAckThreads, BatchProcessor *,
+                      "bio ack batches", &layer->bioAckBatches);
+    if (result != VDO_SUCCESS) {
+      *reason = "Cannot allocate bio ack batch processors";
+      freeKernelLayer(layer);
+      return result;
+    }
+    for (int i = 0; i < config->threadCounts.bioAckThreads; i++) {
+      // With ack affinity, each batch belongs to one ack thread, so that
+      // the thread a DataKVIO is acknowledged on is known.
+      KvdoWorkQueue *queue
+        = (config->ackAffinityEnabled
+           ? getWorkQueueServiceQueue(layer->bioAckQueue, i)
+           : layer->bioAckQueue);
+      result = makeBatchProcessorOnQueue(layer, queue, BIO_ACK_Q_ACTION_ACK,
+                                         acknowledgeDataKVIOBatch, layer,
+                                         &layer->bioAckBatches[i]);
+      if (result != UDS_SUCCESS) {
+        *reason = "Cannot allocate bio ack batch processor";
+        freeKernelLayer(layer);
+        return result;
+      }
+    }
+
+    if (config->ackAffinityEnabled) {
+      result = setUpAckAffinity(layer);
+      if (result != VDO_SUCCESS) {
+        *reason = "Cannot set up bio ack affinity";
+        freeKernelLayer(layer);
+        return result;
+      }
+    }
+  }
+
   // CPU Queues
   result = makeWorkQueue(layer->threadNamePrefix, "cpuQ", &layer->wqDirectory,
                          layer, NULL, &cpuQType,
@@ -947,17 +1409,112 @@ int prepareToModifyKernelLayer(KernelLayer       *layer,
     return VDO_PARAMETER_MISMATCH;
   }
 
+  if (config->cachePolicy != extantConfig->cachePolicy) {
+    *errorPtr = "Block map cache policy cannot change";
+    return VDO_PARAMETER_MISMATCH;
+  }
+
+  if (config->journalCommitPolicy != extantConfig->journalCommitPolicy) {
+    *errorPtr = "Journal commit policy cannot change";
+    return VDO_PARAMETER_MISMATCH;
+  }
+
+  if (config->allocationPolicy != extantConfig->allocationPolicy) {
+    *errorPtr = "Allocation policy cannot change";
+    return VDO_PARAMETER_MISMATCH;
+  }
+
+  if (config->ramBackingEnabled != extantConfig->ramBackingEnabled) {
+    *errorPtr = "RAM backing cannot change";
+    return VDO_PARAMETER_MISMATCH;
+  }
+
+  if (((config->journalDevice == NULL) != (extantConfig->journalDevice == NULL))
+      || ((config->journalDevice != NULL)
+          && (config->journalDevice->bdev->bd_dev
+              != extantConfig->journalDevice->bdev->bd_dev))
+      || (config->journalDeviceSummary != extantConfig->journalDeviceSummary)
+      || (config->journalDeviceMetadata
+          != extantConfig->journalDeviceMetadata)) {
+    *errorPtr = "Journal device cannot change";
+    return VDO_PARAMETER_MISMATCH;
+  }
+
+  if (((config->indexDevice == NULL) != (extantConfig->indexDevice == NULL))
+      || ((config->indexDevice != NULL)
+          && (config->indexDevice->bdev->bd_dev
+              != extantConfig->indexDevice->bdev->bd_dev))) {
+    *errorPtr = "Index device cannot change";
+    return VDO_PARAMETER_MISMATCH;
+  }
+
   if (config->mdRaid5ModeEnabled != extantConfig->mdRaid5ModeEnabled) {
     *errorPtr = "mdRaid5Mode cannot change";
     return VDO_PARAMETER_MISMATCH;
   }
 
-  if (memcmp(&config->threadCounts, &extantConfig->threadCounts,
+  if (config->stripeBlocks != extantConfig->stripeBlocks) {
+    *errorPtr = "Stripe blocks cannot change";
+    return VDO_PARAMETER_MISMATCH;
+  }
+
+  if (config->autoThreadsEnabled && extantConfig->autoThreadsEnabled
+      && (memcmp(&config->threadCounts, &extantConfig->threadCounts,
+                 sizeof(ThreadCountConfig)) != 0)) {
+    // The threads of a running pool can't be remade, so the new choice
+    // only takes effect when the pool is next started.
+    logInfo("keeping the running thread counts until %s is restarted",
+            config->poolName);
+    config->threadCounts = extantConfig->threadCounts;
+  }
+
+  // Only the hash zone count can change, and only within the hash zone
+  // threads the pool was started with, since no other zone's state can be
+  // moved to a different zone layout.
+  ThreadCountConfig counts = config->threadCounts;
+  if ((counts.hashZones != extantConfig->threadCounts.hashZones)
+      && (extantConfig->threadCounts.hashZones > 0)) {
+    const ThreadConfig *threadConfig = getThreadConfig(layer->kvdo.vdo);
+    if ((counts.hashZones == 0)
+        || (counts.hashZones > threadConfig->hashZoneCount)) {
+      *errorPtr = "Hash zone count cannot exceed the pool's hash threads";
+      return VDO_PARAMETER_MISMATCH;
+    }
+    counts.hashZones = extantConfig->threadCounts.hashZones;
+  }
+
+  if (memcmp(&counts, &extantConfig->threadCounts,
 	     sizeof(ThreadCountConfig)) != 0) {
     *errorPtr = "Thread configuration cannot change";
     return VDO_PARAMETER_MISMATCH;
   }
 
+  if ((config->compressionEngine != extantConfig->compressionEngine)
+      || (config->compressionLevel != extantConfig->compressionLevel)) {
+    *errorPtr = "Compression engine cannot change";
+    return VDO_PARAMETER_MISMATCH;
+  }
+
+  if (config->readCacheBlocks != extantConfig->readCacheBlocks) {
+    *errorPtr = "Read cache size cannot change";
+    return VDO_PARAMETER_MISMATCH;
+  }
+
+  if (config->dedupeHash != extantConfig->dedupeHash) {
+    *errorPtr = "Dedupe hash cannot change";
+    return VDO_PARAMETER_MISMATCH;
+  }
+
+  if (config->numaPlacement != extantConfig->numaPlacement) {
+    *errorPtr = "NUMA placement cannot change";
+    return VDO_PARAMETER_MISMATCH;
+  }
+
+  if (config->ackAffinityEnabled != extantConfig->ackAffinityEnabled) {
+    *errorPtr = "Ack affinity cannot change";
+    return VDO_PARAMETER_MISMATCH;
+  }
+
   // Below here are the actions to take when a non-immutable property changes.
 
   if (config->writePolicy != extantConfig->writePolicy) {
@@ -971,10 +1528,14 @@ int prepareToModifyKernelLayer(KernelLayer       *layer,
       return VDO_PARAMETER_MISMATCH;
     }
 
-    int result = prepareToResizeLogical(layer, logicalBytes / VDO_BLOCK_SIZE);
-    if (result != VDO_SUCCESS) {
-      *errorPtr = "Device prepareToGrowLogical failed";
-      return result;
+    // A VDO which was grown online already has the new size.
+    BlockCount logicalCount = logicalBytes / VDO_BLOCK_SIZE;
+    if (logicalCount != getKVDOLogicalBlockCount(&layer->kvdo)) {
+      int result = prepareToResizeLogical(layer, logicalCount);
+      if (result != VDO_SUCCESS) {
+        *errorPtr = "Device prepareToGrowLogical failed";
+        return result;
+      }
     }
   }
 
@@ -1028,14 +1589,30 @@ int modifyKernelLayer(KernelLayer  *layer,
     setWritePolicy(layer->kvdo.vdo, config->writePolicy);
   }
 
-  if (config->owningTarget->len != extantConfig->owningTarget->len) {
-    size_t logicalBytes = to_bytes(config->owningTarget->len);
-    int result = resizeLogical(layer, logicalBytes / VDO_BLOCK_SIZE);
+  if (config->threadCounts.hashZones
+      != extantConfig->threadCounts.hashZones) {
+    logInfo("Modifying device '%s' hash zone count from %d to %d",
+            config->poolName, extantConfig->threadCounts.hashZones,
+            config->threadCounts.hashZones);
+    int result = setActiveHashZoneCount(layer->kvdo.vdo,
+                                        config->threadCounts.hashZones);
     if (result != VDO_SUCCESS) {
       return result;
     }
   }
 
+  if (config->owningTarget->len != extantConfig->owningTarget->len) {
+    size_t     logicalBytes = to_bytes(config->owningTarget->len);
+    BlockCount logicalCount = logicalBytes / VDO_BLOCK_SIZE;
+    // A VDO which was grown online already has the new size.
+    if (logicalCount != getKVDOLogicalBlockCount(&layer->kvdo)) {
+      int result = resizeLogical(layer, logicalCount);
+      if (result != VDO_SUCCESS) {
+        return result;
+      }
+    }
+  }
+
   // Grow physical if the version is 0, so we can't tell if we
   // got an old-style growPhysical command, or if size changed.
   if ((config->physicalBlocks != extantConfig->physicalBlocks)
@@ -1056,10 +1633,11 @@ void freeKernelLayer(KernelLayer *layer)
   // uncertainties in the shutdown process for work queues, we need to
   // store information to enable a late-in-process deallocation of
   // funnel-queue data structures in work queues.
-  bool usedBioAckQueue = false;
-  bool usedCpuQueue    = false;
-  bool usedKVDO        = false;
-  bool releaseInstance = false;
+  bool usedBioAckQueue       = false;
+  bool usedSharedBioAckQueue = false;
+  bool usedCpuQueue          = false;
+  bool usedKVDO              = false;
+  bool releaseInstance       = false;
 
   KernelLayerState state = getKernelLayerState(layer);
   switch (state) {
@@ -1085,7 +1663,18 @@ void freeKernelLayer(KernelLayer *layer)
     // fall through
 
   case LAYER_BIO_ACK_QUEUE_INITIALIZED:
-    if (useBioAckQueue(layer)) {
+    if (useBioAckQueue(layer) && isSharedWorkQueue(layer->bioAckQueue)) {
+      // Other devices keep the shared queue running, so wait for this
+      // device's batches rather than for the queue's threads to stop.
+      for (int i = 0; i < layer->deviceConfig->threadCounts.bioAckThreads;
+           i++) {
+        if ((layer->bioAckBatches != NULL)
+            && (layer->bioAckBatches[i] != NULL)) {
+          waitForBatchProcessorIdle(layer->bioAckBatches[i]);
+        }
+      }
+      usedSharedBioAckQueue = true;
+    } else if (useBioAckQueue(layer)) {
       finishWorkQueue(layer->bioAckQueue);
       usedBioAckQueue = true;
     }
@@ -1101,14 +1690,32 @@ void freeKernelLayer(KernelLayer *layer)
     // fall through
 
   case LAYER_BUFFER_POOLS_INITIALIZED:
+    freeReadAhead(&layer->readAhead);
     freeBufferPool(&layer->dataKVIOPool);
     freeBufferPool(&layer->traceBufferPool);
     // fall through
 
   case LAYER_SIMPLE_THINGS_INITIALIZED:
+    if (layer->bioAckBatches != NULL) {
+      for (int i = 0; i < layer->deviceConfig->threadCounts.bioAckThreads;
+           i++) {
+        freeBatchProcessor(&layer->bioAckBatches[i]);
+      }
+      FREE(layer->bioAckBatches);
+    }
+    FREE(layer->bioAckBatchForCPU);
+    if (layer->dataKVIOCompressors != NULL) {
+      for (int i = 0; i < layer->deviceConfig->threadCounts.cpuThreads; i++) {
+        freeBatchProcessor(&layer->dataKVIOCompressors[i]);
+      }
+      FREE(layer->dataKVIOCompressors);
+    }
+    freePhysicalBlockCache(&layer->physicalBlockCache);
+    freeRAMBacking(&layer->ramBacking);
+    freeFragmentDecoder(&layer->fragmentDecoder);
     if (layer->compressionContext != NULL) {
       for (int i = 0; i < layer->deviceConfig->threadCounts.cpuThreads; i++) {
-        FREE(layer->compressionContext[i]);
+        freeCompressionContext(&layer->compressionContext[i]);
       }
       FREE(layer->compressionContext);
     }
@@ -1118,6 +1725,18 @@ void freeKernelLayer(KernelLayer *layer)
     FREE(layer->spareKVDOFlush);
     layer->spareKVDOFlush = NULL;
     freeBatchProcessor(&layer->dataKVIOReleaser);
+    for (WriteStage stage = 0; stage < WRITE_STAGE_COUNT; stage++) {
+      freeHistogram(&layer->writeStageHistograms[stage]);
+    }
+    freeHistogram(&layer->flushLatencyHistogram);
+    freeHistogram(&layer->flushBatchHistogram);
+    if (layer->dataKVIOHashers != NULL) {
+      for (int i = 0; i < layer->deviceConfig->threadCounts.cpuThreads; i++) {
+        freeBatchProcessor(&layer->dataKVIOHashers[i]);
+      }
+      FREE(layer->dataKVIOHashers);
+    }
+    freeChunkHasher(&layer->chunkHasher);
     removeLayerFromDeviceRegistry(layer);
     break;
 
@@ -1132,6 +1751,9 @@ void freeKernelLayer(KernelLayer *layer)
   if (usedBioAckQueue) {
     freeWorkQueue(&layer->bioAckQueue);
   }
+  if (usedSharedBioAckQueue) {
+    releaseSharedBioAckQueue(&layer->bioAckQueue);
+  }
   if (layer->ioSubmitter) {
     freeIOSubmitter(layer->ioSubmitter);
   }
@@ -1187,9 +1809,112 @@ int preloadKernelLayer(KernelLayer          *layer,
     return result;
   }
 
+  result = checkJournalDeviceSize(layer);
+  if (result != VDO_SUCCESS) {
+    *reason = "Journal device is too small";
+    stopKernelLayer(layer);
+    return result;
+  }
+
+  result = checkIndexDeviceSize(layer);
+  if (result != VDO_SUCCESS) {
+    *reason = "Index device is too small";
+    stopKernelLayer(layer);
+    return result;
+  }
+
   return VDO_SUCCESS;
 }
 
+/**
+ * Count the block map cache pages above the table's cache size, which may
+ * be given back under memory pressure. Implements count_objects for the
+ * cache shrinker.
+ **/
+static unsigned long countCachePages(struct shrinker       *shrinker,
+                                     struct shrink_control *sc
+                                     __attribute__((unused)))
+{
+  KernelLayer *layer = container_of(shrinker, KernelLayer, cacheShrinker);
+  if (getKernelLayerState(layer) != LAYER_RUNNING) {
+    return 0;
+  }
+
+  PageCount cacheSize = getKVDOBlockMapCacheSize(&layer->kvdo);
+  PageCount tableSize = layer->deviceConfig->cacheSize;
+  return ((cacheSize > tableSize) ? (cacheSize - tableSize) : 0);
+}
+
+/**
+ * Schedule the block map cache to shrink back to the table's cache size.
+ * Implements scan_objects for the cache shrinker. Retired pages are only
+ * freed once they have been written out, so nothing is freed immediately.
+ **/
+static unsigned long scanCachePages(struct shrinker       *shrinker,
+                                    struct shrink_control *sc
+                                    __attribute__((unused)))
+{
+  KernelLayer *layer = container_of(shrinker, KernelLayer, cacheShrinker);
+  schedule_work(&layer->cacheShrinkWork);
+  return SHRINK_STOP;
+}
+
+/**
+ * Shrink the block map cache back to the table's cache size.
+ *
+ * @param work  The cacheShrinkWork of the layer
+ **/
+static void shrinkBlockMapCache(struct work_struct *work)
+{
+  KernelLayer *layer     = container_of(work, KernelLayer, cacheShrinkWork);
+  PageCount    cacheSize = getKVDOBlockMapCacheSize(&layer->kvdo);
+  PageCount    tableSize = layer->deviceConfig->cacheSize;
+  int result = kvdoResizeBlockMapCache(&layer->kvdo, tableSize);
+  if (result != VDO_SUCCESS) {
+    logWarningWithStringError(result, "cannot shrink block map cache");
+    return;
+  }
+
+  if (cacheSize > tableSize) {
+    atomic64_add(cacheSize - tableSize, &layer->blockMapCacheReclaimedPages);
+  }
+
+  // Each shrink pushes the regrowth back, so the cache stays small for as
+  // long as the pressure lasts.
+  if (layer->requestedCacheSize > tableSize) {
+    mod_delayed_work(system_wq, &layer->cacheRegrowWork,
+                     msecs_to_jiffies(CACHE_REGROW_DELAY_MS));
+  }
+}
+
+/**
+ * Grow the block map cache back to the size last requested by message,
+ * once there has been no memory pressure for a while.
+ *
+ * @param work  The work_struct of the cacheRegrowWork of the layer
+ **/
+static void regrowBlockMapCache(struct work_struct *work)
+{
+  KernelLayer *layer = container_of(to_delayed_work(work), KernelLayer,
+                                    cacheRegrowWork);
+  if (getKernelLayerState(layer) != LAYER_RUNNING) {
+    return;
+  }
+
+  PageCount cacheSize = getKVDOBlockMapCacheSize(&layer->kvdo);
+  PageCount wanted    = layer->requestedCacheSize;
+  if (cacheSize >= wanted) {
+    return;
+  }
+
+  int result = kvdoResizeBlockMapCache(&layer->kvdo, wanted);
+  if (result != VDO_SUCCESS) {
+    logWarningWithStringError(result, "cannot regrow block map cache");
+    return;
+  }
+  atomic64_add(wanted - cacheSize, &layer->blockMapCacheRegrownPages);
+}
+
 /**********************************************************************/
 int startKernelLayer(KernelLayer *layer, char **reason)
 {
@@ -1220,6 +1945,21 @@ int startKernelLayer(KernelLayer *layer, char **reason)
   }
   layer->statsAdded = true;
 
+  layer->cacheShrinker = (struct shrinker) {
+    .count_objects = countCachePages,
+    .scan_objects  = scanCachePages,
+    .seeks         = DEFAULT_SEEKS,
+  };
+  INIT_WORK(&layer->cacheShrinkWork, shrinkBlockMapCache);
+  INIT_DELAYED_WORK(&layer->cacheRegrowWork, regrowBlockMapCache);
+  result = register_shrinker(&layer->cacheShrinker);
+  if (result != 0) {
+    *reason = "Cannot register block map cache shrinker";
+    stopKernelLayer(layer);
+    return result;
+  }
+  layer->cacheShrinkerRegistered = true;
+
   // Don't try to load or rebuild the index first (and log scary error
   // messages) if this is known to be a newly-formatted volume.
   startDedupeIndex(layer->dedupeIndex, wasNew(layer->kvdo.vdo));
@@ -1251,6 +1991,13 @@ void stopKernelLayer(KernelLayer *layer)
   }
   vdoDestroyProcfsEntry(layer->deviceConfig->poolName, layer->procfsPrivate);
 
+  if (layer->cacheShrinkerRegistered) {
+    layer->cacheShrinkerRegistered = false;
+    unregister_shrinker(&layer->cacheShrinker);
+    cancel_work_sync(&layer->cacheShrinkWork);
+    cancel_delayed_work_sync(&layer->cacheRegrowWork);
+  }
+
   switch (getKernelLayerState(layer)) {
   case LAYER_RUNNING:
     suspendKernelLayer(layer);
@@ -1290,6 +2037,7 @@ int suspendKernelLayer(KernelLayer *layer)
    * the suspend, even if it hasn't been flushed yet.
    */
   waitForNoRequestsActive(layer);
+  waitForReadAheadIdle(layer->readAhead);
   int result = synchronousFlush(layer);
   if (result != VDO_SUCCESS) {
     setKVDOReadOnly(&layer->kvdo, result);
@@ -1345,6 +2093,11 @@ int prepareToResizePhysical(KernelLayer *layer, BlockCount physicalCount)
     }
   }
 
+  if (checkJournalDeviceSize(layer) != VDO_SUCCESS) {
+    // The slab metadata of the new slabs would not fit on the journal device.
+    return -ENOSPC;
+  }
+
   logInfo("Done preparing to resize physical");
   return VDO_SUCCESS;
 }
@@ -1394,3 +2147,22 @@ int resizeLogical(KernelLayer *layer, BlockCount logicalCount)
   return VDO_SUCCESS;
 }
 
+/***********************************************************************/
+int growLogicalOnline(KernelLayer *layer, BlockCount logicalCount)
+{
+  int result = prepareToResizeLogical(layer, logicalCount);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  logInfo("Growing logical to %" PRIu64 " while running", logicalCount);
+  result = kvdoGrowLogicalOnline(&layer->kvdo, logicalCount);
+  if (result != VDO_SUCCESS) {
+    // kvdoGrowLogicalOnline logs errors
+    return result;
+  }
+
+  logInfo("Logical blocks now %" PRIu64, logicalCount);
+  return VDO_SUCCESS;
+}
+
@@ -23,9 +23,12 @@
 #define KERNELLAYER_H
 
 #include <linux/device-mapper.h>
+#include <linux/shrinker.h>
+#include <linux/workqueue.h>
 
 #include "atomic.h"
 #include "constants.h"
+#include "dataVIO.h"
 #include "flush.h"
 #include "intMap.h"
 #include "physicalLayer.h"
@@ -33,8 +36,11 @@
 #include "volumeGeometry.h"
 #include "waitQueue.h"
 
+#include "backgroundBudget.h"
 #include "batchProcessor.h"
 #include "bufferPool.h"
+#include "chunkHasher.h"
+#include "compressionEngine.h"
 #include "deadlockQueue.h"
 #include "deviceConfig.h"
 #include "histogram.h"
@@ -43,8 +49,12 @@
 #include "kernelVDO.h"
 #include "ktrace.h"
 #include "limiter.h"
+#include "physicalBlockCache.h"
+#include "ramBacking.h"
+#include "readAhead.h"
 #include "statistics.h"
 #include "workQueue.h"
+#include "workQueueStats.h"
 
 enum {
   VDO_SECTORS_PER_BLOCK = (VDO_BLOCK_SIZE >> SECTOR_SHIFT)
@@ -65,6 +75,20 @@ typedef enum {
   LAYER_RESUMING,
 } KernelLayerState;
 
+/**
+ * The classes into which incoming bios are sorted, by I/O priority class,
+ * for admission. Each class has its own limit on the share of the request
+ * pool it may occupy.
+ **/
+typedef enum {
+  INTAKE_CLASS_REALTIME = 0,
+  INTAKE_CLASS_BEST_EFFORT,
+  INTAKE_CLASS_IDLE,
+  INTAKE_CLASS_COUNT,
+  /** The class of requests admitted without a class permit */
+  INTAKE_CLASS_NONE = INTAKE_CLASS_COUNT,
+} IntakeClass;
+
 /* Keep BIO statistics atomically */
 struct atomicBioStats {
   atomic64_t read;              // Number of not REQ_WRITE bios
@@ -126,12 +150,20 @@ struct kernelLayer {
   /** Limit the number of requests that are being processed. */
   Limiter                 requestLimiter;
   Limiter                 discardLimiter;
+  /** Whether discards are admitted as idle requests whatever their class */
+  bool                    discardsIdle;
+  /** Limit the share of the requests each intake class may have. */
+  Limiter                 intakeLimiters[INTAKE_CLASS_COUNT];
+  /** The share of the device granted to background work under load */
+  BackgroundBudget        backgroundBudget;
   KVDO                    kvdo;
   /** Incoming bios we've had to buffer to avoid deadlock. */
   DeadlockQueue           deadlockQueue;
   // for REQ_FLUSH processing
   struct bio_list         waitingFlushes;
   KVDOFlush              *spareKVDOFlush;
+  /** The launched flush which new flush bios join, until the VDO starts it */
+  KVDOFlush              *pendingKVDOFlush;
   spinlock_t              flushLock;
   Jiffies                 flushArrivalTime;
   /**
@@ -149,11 +181,18 @@ struct kernelLayer {
    * CPU-intensive, non-blocking work.
    **/
   KvdoWorkQueue          *cpuQueue;
-  /** N blobs of context data for LZ4 code, one per CPU thread. */
-  char                  **compressionContext;
-  Atomic32                compressionContextIndex;
-  /** Optional work queue for calling bio_endio. */
+  /** N compression contexts, one per CPU thread. */
+  CompressionContext    **compressionContext;
+  /** The decompressor for fragments from any compression engine. */
+  FragmentDecoder        *fragmentDecoder;
+  PhysicalBlockCache     *physicalBlockCache;
+  ReadAhead              *readAhead;
+  /** The in-memory storage replacing the devices, if the table asks for it */
+  RAMBacking             *ramBacking;
+  /** Optional work queue for calling bio_endio, which may be shared. */
   KvdoWorkQueue          *bioAckQueue;
+  /** This layer's use of the bio ack queue, if the queue is shared */
+  KvdoWorkQueueShare      bioAckShare;
   /** Underlying block device info. */
   uint64_t                startingSectorOffset;
   VolumeGeometry          geometry;
@@ -167,6 +206,7 @@ struct kernelLayer {
   atomic64_t              biosCompleted;
   atomic64_t              dedupeContextBusy;
   atomic64_t              flushOut;
+  atomic64_t              flushesCoalesced;
   AtomicBioStats          biosIn;
   AtomicBioStats          biosInPartial;
   AtomicBioStats          biosOut;
@@ -179,11 +219,32 @@ struct kernelLayer {
   AtomicBioStats          biosPageCache;
   AtomicBioStats          biosJournalCompleted;
   AtomicBioStats          biosPageCacheCompleted;
+  atomic64_t              compressionEstimateSkipped;
+  atomic64_t              compressionEstimateAudited;
+  atomic64_t              compressionEstimateWronglySkipped;
+  atomic64_t              compressionEstimateMissed;
+  atomic64_t              speculativeCompressions;
+  atomic64_t              speculativeCompressionsUsed;
+  atomic64_t              blockMapCacheReclaimedPages;
+  atomic64_t              blockMapCacheRegrownPages;
+  atomic64_t              biosCoalesced;
+  atomic64_t              biosCoalescedMembers;
+  atomic64_t              patternBlocksNamed;
+  atomic64_t              completionThreadHops;
+  atomic64_t              completionsRequeued;
+  atomic64_t              compressedBlockCacheHits;
+  atomic64_t              compressedBlockCacheMisses;
+  atomic64_t              readAheadReads;
+  atomic64_t              readAheadHits;
+  atomic64_t              repeatedReadsCached;
+  atomic64_t              repeatedReadCacheHits;
   // for reporting Albireo timeouts
   PeriodicEventReporter   albireoTimeoutReporter;
   // Debugging
   /* Whether to dump VDO state on shutdown */
   bool                    dumpOnShutdown;
+  /* When the last dump requested by message started, in jiffies */
+  unsigned long           lastDumpJiffies;
   /**
    * Whether we should collect tracing info. (Actually, this controls
    * allocations; non-null record pointers cause recording.)
@@ -198,10 +259,44 @@ struct kernelLayer {
   void                   *procfsPrivate;
   /* For returning batches of DataKVIOs to their pool */
   BatchProcessor         *dataKVIOReleaser;
+  /* The time writes spend in each write stage, entered as they are freed */
+  Histogram              *writeStageHistograms[WRITE_STAGE_COUNT];
+  /* Whether a benchmark is adding up the time writes spend in each stage */
+  AtomicBool              benchmarking;
+  /* The total time the benchmark's writes spent in each write stage */
+  Atomic64                benchmarkStageTimes[WRITE_STAGE_COUNT];
+  /* The number of writes in each of the benchmark's stage totals */
+  Atomic64                benchmarkStageWrites[WRITE_STAGE_COUNT];
+  /* The time from the arrival of a flush to its storage flush completing */
+  Histogram              *flushLatencyHistogram;
+  /* The number of flush bios covered by each storage flush */
+  Histogram              *flushBatchHistogram;
+  /* The chunk name generator shared by the DataKVIO hashers */
+  ChunkHasher            *chunkHasher;
+  /* For hashing batches of DataKVIOs, one per CPU thread */
+  BatchProcessor        **dataKVIOHashers;
+  Atomic32                dataKVIOHasherIndex;
+  /* For compressing batches of DataKVIOs, one per LZ4 context */
+  BatchProcessor        **dataKVIOCompressors;
+  Atomic32                dataKVIOCompressorIndex;
+  /* For acknowledging batches of DataKVIOs, one per bio ack thread */
+  BatchProcessor        **bioAckBatches;
+  /* With ack affinity, the ack batch for the bios submitted on each CPU */
+  unsigned int           *bioAckBatchForCPU;
 
   // Administrative operations
   /* The object used to wait for administrative operations to complete */
   struct completion       callbackSync;
+  /* Returns the block map cache to its table size under memory pressure */
+  struct shrinker         cacheShrinker;
+  /* Shrinks the cache outside of reclaim, since resizing waits on the VDO */
+  struct work_struct      cacheShrinkWork;
+  /* Regrows the cache once memory pressure has passed */
+  struct delayed_work     cacheRegrowWork;
+  /* The block map cache size last set by message, or 0 if none was */
+  PageCount               requestedCacheSize;
+  /* Whether the cache shrinker is registered */
+  bool                    cacheShrinkerRegistered;
 
   // Statistics reporting
   /* Protects the *statsStorage structs */
@@ -213,6 +308,10 @@ struct kernelLayer {
   /* Used to gather statistics without allocating memory */
   VDOStatistics           vdoStatsStorage;
   KernelStatistics        kernelStatsStorage;
+  /* Whether the *statsStorage structs hold a snapshot */
+  bool                    statsSnapshotTaken;
+  /* When the snapshot in the *statsStorage structs was taken (jiffies) */
+  unsigned long           statsSnapshotTime;
 };
 
 typedef enum bioQAction {
@@ -230,6 +329,7 @@ typedef enum cpuQAction {
   CPU_Q_ACTION_COMPRESS_BLOCK,
   CPU_Q_ACTION_EVENT_REPORTER,
   CPU_Q_ACTION_HASH_BLOCK,
+  CPU_Q_ACTION_READ_AHEAD,
 } CPUQAction;
 
 typedef enum bioAckQAction {
@@ -458,6 +558,24 @@ static inline BlockSize sectorToBlockOffset(KernelLayer *layer,
 struct block_device *getKernelLayerBdev(const KernelLayer *layer)
   __attribute__((warn_unused_result));
 
+/**
+ * Find the device and sector holding a metadata block. The recovery
+ * journal, and optionally the slab summary, may be placed on a separate
+ * journal device; every other block is on the device underlying the layer.
+ *
+ * @param [in]  layer      The kernel layer
+ * @param [in]  vioType    The type of the VIO accessing the block
+ * @param [in]  pbn        The physical block number in the VDO layout
+ * @param [out] sectorPtr  A pointer to hold the sector on the device
+ *
+ * @return The device holding the block
+ **/
+struct block_device *mapMetadataBlock(KernelLayer         *layer,
+                                      VIOType              vioType,
+                                      PhysicalBlockNumber  pbn,
+                                      sector_t            *sectorPtr)
+  __attribute__((warn_unused_result));
+
 /**
  * Set the layer's active config.
  *
@@ -559,6 +677,18 @@ int prepareToResizeLogical(KernelLayer *layer, BlockCount logicalCount);
  */
 int resizeLogical(KernelLayer *layer, BlockCount logicalCount);
 
+/**
+ * Present a larger logical space without suspending the VDO. A subsequent
+ * table reload with the new size, which device-mapper still brackets with
+ * its own suspend, then has nothing left to grow.
+ *
+ * @param layer         the kernel layer
+ * @param logicalCount  the new logical size in blocks
+ *
+ * @return VDO_SUCCESS or an error
+ */
+int growLogicalOnline(KernelLayer *layer, BlockCount logicalCount);
+
 /**
  * Indicate whether the kernel layer is configured to use a separate
  * work queue for acknowledging received and processed bios.
@@ -576,6 +706,30 @@ static inline bool useBioAckQueue(KernelLayer *layer)
   return layer->deviceConfig->threadCounts.bioAckThreads > 0;
 }
 
+/**
+ * Get the batch processor which should acknowledge the next DataKVIO
+ * finished on the current CPU. Completions from one CPU are gathered into
+ * the same batch so that the ack threads are woken once per batch rather
+ * than once per bio. With ack affinity, completions are instead gathered by
+ * the CPU which submitted them, into a batch whose thread is on that CPU's
+ * NUMA node.
+ *
+ * @param layer      The kernel layer, which must be using a bio ack queue
+ * @param submitCPU  The CPU which submitted the bio being acknowledged
+ *
+ * @return The batch processor to use
+ **/
+static inline BatchProcessor *getBioAckBatchProcessor(KernelLayer  *layer,
+                                                      unsigned int  submitCPU)
+{
+  if ((layer->bioAckBatchForCPU != NULL) && (submitCPU < nr_cpu_ids)) {
+    return layer->bioAckBatches[layer->bioAckBatchForCPU[submitCPU]];
+  }
+
+  unsigned int threads = layer->deviceConfig->threadCounts.bioAckThreads;
+  return layer->bioAckBatches[raw_smp_processor_id() % threads];
+}
+
 /**
  * Update bookkeeping for the completion of some number of requests, so that
  * more incoming requests can be accepted.
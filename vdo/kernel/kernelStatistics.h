@@ -67,8 +67,38 @@ typedef struct {
   uint32_t currDedupeQueries;
   /** Maximum number of dedupe queries that have been in flight */
   uint32_t maxDedupeQueries;
+  /** Number of valid chapter indexes evicted from the sparse cache */
+  uint64_t sparseCacheEvictions;
+  /** Number of times a hot sparse chapter index was spared eviction */
+  uint64_t sparseCacheRetentions;
+  /** Memory currently allotted to the index page cache, in bytes */
+  uint64_t pageCacheBytes;
+  /** Number of first lookups of an index page which found it cached */
+  uint64_t pageCacheHits;
+  /** Number of first lookups of an index page which waited for a read */
+  uint64_t pageCacheMisses;
+  /** Index page cache memory given back under memory pressure, in bytes */
+  uint64_t pageCacheReclaimedBytes;
+  /** Number of writes not posted because their region was not deduping */
+  uint64_t bypassedPosts;
+  /** Number of writes to regions not deduping which were posted anyway */
+  uint64_t sampledPosts;
+  /** Current number of logical regions whose writes are not deduping */
+  uint32_t bypassedRegions;
 } IndexStatistics;
 
+/** Compressibility estimator statistics */
+typedef struct {
+  /** Number of blocks judged too incompressible to be worth compressing */
+  uint64_t skipped;
+  /** Number of skipped blocks compressed anyway to check the estimate */
+  uint64_t audited;
+  /** Number of audited blocks which turned out to be compressible */
+  uint64_t wronglySkipped;
+  /** Number of blocks compressed on the estimator's advice to no effect */
+  uint64_t missed;
+} CompressionEstimateStatistics;
+
 typedef struct {
   uint32_t version;
   uint32_t releaseVersion;
@@ -82,6 +112,8 @@ typedef struct {
   uint64_t dedupeAdviceTimeouts;
   /** Number of flush requests submitted to the storage device */
   uint64_t flushOut;
+  /** Number of flush requests which joined a flush already waiting */
+  uint64_t flushesCoalesced;
   /** Logical block size */
   uint64_t logicalBlockSize;
   /** Bios submitted into VDO from above */
@@ -101,10 +133,46 @@ typedef struct {
   BioStats biosAcknowledgedPartial;
   /** Current number of bios in progress */
   BioStats biosInProgress;
+  /** Number of multi-block bios built by coalescing sequential writes */
+  uint64_t biosCoalesced;
+  /** Number of bios merged into coalesced bios */
+  uint64_t biosCoalescedMembers;
+  /** Number of written blocks of a repeated word named without hashing */
+  uint64_t patternBlocksNamed;
+  /** Number of completion callbacks enqueued to run on another thread */
+  uint64_t completionThreadHops;
+  /** Number of completion callbacks requeued on their current thread */
+  uint64_t completionsRequeued;
+  /** Number of compressed block reads found in the compressed block cache */
+  uint64_t compressedBlockCacheHits;
+  /** Number of compressed block reads which had to go to storage */
+  uint64_t compressedBlockCacheMisses;
+  /** Number of blocks read ahead of sequential reads */
+  uint64_t readAheadReads;
+  /** Number of data reads satisfied by blocks which were read ahead */
+  uint64_t readAheadHits;
+  /** Number of uncompressed blocks cached because they were read again */
+  uint64_t repeatedReadsCached;
+  /** Number of reads satisfied by blocks cached because they were read again */
+  uint64_t repeatedReadCacheHits;
+  /** Number of bios acknowledged on ack threads shared with other VDOs */
+  uint64_t sharedBioAcks;
+  /** Time spent acknowledging bios on shared ack threads, in microseconds */
+  uint64_t sharedBioAckMicroseconds;
+  /** Number of writes compressed while their dedupe queries were running */
+  uint64_t speculativeCompressions;
+  /** Number of speculative compressions which were written compressed */
+  uint64_t speculativeCompressionsUsed;
+  /** Number of block map cache pages given back under memory pressure */
+  uint64_t blockMapCacheReclaimedPages;
+  /** Number of block map cache pages regrown after memory pressure */
+  uint64_t blockMapCacheRegrownPages;
   /** Memory usage stats. */
   MemoryUsage memoryUsage;
   /** The statistics for the UDS index */
   IndexStatistics index;
+  /** The statistics for the compressibility estimator */
+  CompressionEstimateStatistics compressionEstimate;
 } KernelStatistics;
 
 /**
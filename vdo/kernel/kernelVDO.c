@@ -25,10 +25,17 @@
 
 #include "memoryAlloc.h"
 
+#include "blockMap.h"
+#include "fixedLayout.h"
+#include "logicalZone.h"
+#include "recoveryJournal.h"
+#include "slabDepot.h"
 #include "statistics.h"
 #include "threadConfig.h"
 #include "vdo.h"
 #include "vdoDebug.h"
+#include "vdoInternal.h"
+#include "vdoLayout.h"
 #include "vdoLoad.h"
 #include "vdoResize.h"
 #include "vdoResizeLogical.h"
@@ -39,7 +46,17 @@
 #include "kvio.h"
 #include "logger.h"
 
-enum { PARANOID_THREAD_CONSISTENCY_CHECKS = 0 };
+enum {
+  PARANOID_THREAD_CONSISTENCY_CHECKS = 0,
+  // How often to check the packer's adaptive deadlines
+  PACKER_TICK_MILLISECONDS           = 1,
+  // How often to check the recovery journal's group commit deadline
+  JOURNAL_TICK_MILLISECONDS          = 1,
+  // How often to check whether rate-limited slab scrubbing may resume
+  SCRUB_TICK_MILLISECONDS            = 10,
+  // How often to check for freed blocks whose discard delay has passed
+  DISCARD_TICK_MILLISECONDS          = 100,
+};
 
 /**********************************************************************/
 static void startKVDORequestQueue(void *ptr)
@@ -62,16 +79,29 @@ static void finishKVDORequestQueue(void *ptr)
 static const KvdoWorkQueueType requestQueueType = {
   .start       = startKVDORequestQueue,
   .finish      = finishKVDORequestQueue,
+  .spinPolling = true,
   .actionTable = {
     { .name = "req_completion",
       .code = REQ_Q_ACTION_COMPLETION,
       .priority = 1 },
+    { .name = "req_discard_tick",
+      .code = REQ_Q_ACTION_DISCARD_TICK,
+      .priority = 1 },
     { .name = "req_flush",
       .code = REQ_Q_ACTION_FLUSH,
       .priority = 2 },
+    { .name = "req_journal_tick",
+      .code = REQ_Q_ACTION_JOURNAL_TICK,
+      .priority = 1 },
     { .name = "req_map_bio",
       .code = REQ_Q_ACTION_MAP_BIO,
       .priority = 0 },
+    { .name = "req_packer_tick",
+      .code = REQ_Q_ACTION_PACKER_TICK,
+      .priority = 1 },
+    { .name = "req_scrub_tick",
+      .code = REQ_Q_ACTION_SCRUB_TICK,
+      .priority = 1 },
     { .name = "req_sync",
       .code = REQ_Q_ACTION_SYNC,
       .priority = 2 },
@@ -81,6 +111,273 @@ static const KvdoWorkQueueType requestQueueType = {
   },
 };
 
+/**********************************************************************/
+static void schedulePackerTick(KVDO *kvdo);
+
+/**
+ * Write out any packer bins whose adaptive deadlines have passed. The work
+ * item visits each packer zone in turn on that zone's thread, and once every
+ * zone has been checked, schedules the next check.
+ *
+ * @param item  The KVDO's packer tick work item
+ **/
+static void packerTickWork(KvdoWorkItem *item)
+{
+  KVDO        *kvdo  = container_of(item, KVDO, packerTickItem);
+  PackerZones *zones = getVDOPackerZones(kvdo->vdo);
+  checkPackerDeadlines(getPackerZone(zones, kvdo->packerTickZone));
+  if (++kvdo->packerTickZone < getPackerZoneCount(zones)) {
+    ThreadID threadID = getPackerZoneThread(getThreadConfig(kvdo->vdo),
+                                            kvdo->packerTickZone);
+    enqueueWorkQueue(kvdo->threads[threadID].requestQueue, item);
+    return;
+  }
+
+  kvdo->packerTickZone = 0;
+  atomic_set(&kvdo->packerTickQueued, 0);
+  schedulePackerTick(kvdo);
+}
+
+/**
+ * Schedule a check of the packer's adaptive deadlines if the VDO is running
+ * with the adaptive packer policy and one is not already scheduled.
+ *
+ * @param kvdo  The KVDO
+ **/
+static void schedulePackerTick(KVDO *kvdo)
+{
+  if ((atomic_read(&kvdo->ticking) == 0)
+      || (getPackerPolicy(getVDOPackerZones(kvdo->vdo))
+          != PACKER_POLICY_ADAPTIVE)) {
+    return;
+  }
+
+  if (atomic_xchg(&kvdo->packerTickQueued, 1) == 0) {
+    ThreadID threadID = getPackerZoneThread(getThreadConfig(kvdo->vdo), 0);
+    setupWorkItem(&kvdo->packerTickItem, packerTickWork, NULL,
+                  REQ_Q_ACTION_PACKER_TICK);
+    enqueueWorkQueueDelayed(kvdo->threads[threadID].requestQueue,
+                            &kvdo->packerTickItem,
+                            jiffies
+                            + msecs_to_jiffies(PACKER_TICK_MILLISECONDS));
+  }
+}
+
+/**********************************************************************/
+static void scheduleJournalTick(KVDO *kvdo);
+
+/**
+ * Write out the recovery journal's active block if it has been held for
+ * group commit past its deadline, and schedule the next check.
+ *
+ * @param item  The KVDO's journal tick work item
+ **/
+static void journalTickWork(KvdoWorkItem *item)
+{
+  KVDO *kvdo = container_of(item, KVDO, journalTickItem);
+  checkRecoveryJournalCommitDeadline(getRecoveryJournal(kvdo->vdo));
+  atomic_set(&kvdo->journalTickQueued, 0);
+  scheduleJournalTick(kvdo);
+}
+
+/**
+ * Schedule a check of the recovery journal's group commit deadline if the
+ * VDO is running and one is not already scheduled.
+ *
+ * @param kvdo  The KVDO
+ **/
+static void scheduleJournalTick(KVDO *kvdo)
+{
+  if (atomic_read(&kvdo->ticking) == 0) {
+    return;
+  }
+
+  if (atomic_xchg(&kvdo->journalTickQueued, 1) == 0) {
+    ThreadID threadID = getJournalZoneThread(getThreadConfig(kvdo->vdo));
+    setupWorkItem(&kvdo->journalTickItem, journalTickWork, NULL,
+                  REQ_Q_ACTION_JOURNAL_TICK);
+    enqueueWorkQueueDelayed(kvdo->threads[threadID].requestQueue,
+                            &kvdo->journalTickItem,
+                            jiffies
+                            + msecs_to_jiffies(JOURNAL_TICK_MILLISECONDS));
+  }
+}
+
+/**********************************************************************/
+static void scheduleScrubTick(KVDO *kvdo);
+
+/**
+ * If the layer is managing a background budget, sample the foreground load
+ * and, if the budget has been recomputed, grant it to slab scrubbing.
+ *
+ * @param kvdo  The KVDO
+ **/
+static void updateScrubBudget(KVDO *kvdo)
+{
+  KernelLayer      *layer  = container_of(kvdo, KernelLayer, kvdo);
+  BackgroundBudget *budget = &layer->backgroundBudget;
+  if (!isBackgroundBudgetManaged(budget)) {
+    return;
+  }
+
+  uint64_t requests = (atomic64_read(&layer->biosIn.read)
+                       + atomic64_read(&layer->biosIn.write));
+  uint32_t active, maximum;
+  getLimiterValuesAtomically(&layer->requestLimiter, &active, &maximum);
+  uint32_t     limit     = READ_ONCE(layer->requestLimiter.limit);
+  unsigned int occupancy = ((limit == 0)
+                            ? 0 : minUInt64((active * 100) / limit, 100));
+  uint32_t rate;
+  if (sampleForegroundLoad(budget, requests, occupancy, &rate)
+      && isBackgroundBudgetManaged(budget)) {
+    setDepotScrubRateLimit(getSlabDepot(kvdo->vdo), rate);
+  }
+}
+
+/**
+ * Resume slab scrubbing which has been held back by the scrub rate limit.
+ * The work item visits each physical zone in turn on that zone's thread, and
+ * once every zone has been checked, schedules the next check.
+ *
+ * @param item  The KVDO's scrub tick work item
+ **/
+static void scrubTickWork(KvdoWorkItem *item)
+{
+  KVDO               *kvdo         = container_of(item, KVDO, scrubTickItem);
+  const ThreadConfig *threadConfig = getThreadConfig(kvdo->vdo);
+  if (kvdo->scrubTickZone == 0) {
+    updateScrubBudget(kvdo);
+  }
+  checkDepotScrubRateLimit(getSlabDepot(kvdo->vdo), kvdo->scrubTickZone);
+  if (++kvdo->scrubTickZone < threadConfig->physicalZoneCount) {
+    ThreadID threadID = getPhysicalZoneThread(threadConfig,
+                                              kvdo->scrubTickZone);
+    enqueueWorkQueue(kvdo->threads[threadID].requestQueue, item);
+    return;
+  }
+
+  kvdo->scrubTickZone = 0;
+  atomic_set(&kvdo->scrubTickQueued, 0);
+  scheduleScrubTick(kvdo);
+}
+
+/**
+ * Schedule a check of whether rate-limited slab scrubbing may resume if the
+ * VDO is running with a scrub rate limit and one is not already scheduled.
+ *
+ * @param kvdo  The KVDO
+ **/
+static void scheduleScrubTick(KVDO *kvdo)
+{
+  SlabDepot *depot = getSlabDepot(kvdo->vdo);
+  if ((atomic_read(&kvdo->ticking) == 0) || (depot == NULL)
+      || (getDepotScrubRateLimit(depot) == 0)) {
+    return;
+  }
+
+  if (atomic_xchg(&kvdo->scrubTickQueued, 1) == 0) {
+    ThreadID threadID = getPhysicalZoneThread(getThreadConfig(kvdo->vdo), 0);
+    setupWorkItem(&kvdo->scrubTickItem, scrubTickWork, NULL,
+                  REQ_Q_ACTION_SCRUB_TICK);
+    enqueueWorkQueueDelayed(kvdo->threads[threadID].requestQueue,
+                            &kvdo->scrubTickItem,
+                            jiffies
+                            + msecs_to_jiffies(SCRUB_TICK_MILLISECONDS));
+  }
+}
+
+/**********************************************************************/
+static void scheduleDiscardTick(KVDO *kvdo);
+
+/**
+ * Discard freed blocks whose delay has passed. The work item visits each
+ * physical zone in turn on that zone's thread, and once every zone has been
+ * checked, schedules the next check.
+ *
+ * @param item  The KVDO's discard tick work item
+ **/
+static void discardTickWork(KvdoWorkItem *item)
+{
+  KVDO               *kvdo         = container_of(item, KVDO, discardTickItem);
+  const ThreadConfig *threadConfig = getThreadConfig(kvdo->vdo);
+  checkDepotDiscardDeadlines(getSlabDepot(kvdo->vdo), kvdo->discardTickZone);
+  if (++kvdo->discardTickZone < threadConfig->physicalZoneCount) {
+    ThreadID threadID = getPhysicalZoneThread(threadConfig,
+                                              kvdo->discardTickZone);
+    enqueueWorkQueue(kvdo->threads[threadID].requestQueue, item);
+    return;
+  }
+
+  kvdo->discardTickZone = 0;
+  atomic_set(&kvdo->discardTickQueued, 0);
+  scheduleDiscardTick(kvdo);
+}
+
+/**
+ * Schedule a check for freed blocks to discard if the VDO is running with a
+ * discard delay and one is not already scheduled.
+ *
+ * @param kvdo  The KVDO
+ **/
+static void scheduleDiscardTick(KVDO *kvdo)
+{
+  SlabDepot *depot = getSlabDepot(kvdo->vdo);
+  if ((atomic_read(&kvdo->ticking) == 0) || (depot == NULL)
+      || (getDepotDiscardDelay(depot) == 0)) {
+    return;
+  }
+
+  if (atomic_xchg(&kvdo->discardTickQueued, 1) == 0) {
+    ThreadID threadID = getPhysicalZoneThread(getThreadConfig(kvdo->vdo), 0);
+    setupWorkItem(&kvdo->discardTickItem, discardTickWork, NULL,
+                  REQ_Q_ACTION_DISCARD_TICK);
+    enqueueWorkQueueDelayed(kvdo->threads[threadID].requestQueue,
+                            &kvdo->discardTickItem,
+                            jiffies
+                            + msecs_to_jiffies(DISCARD_TICK_MILLISECONDS));
+  }
+}
+
+/**
+ * Start or stop the periodic checks of the packer's adaptive deadlines, the
+ * recovery journal's group commit deadline, the slab scrub rate limit, and
+ * the discard delay of freed blocks.
+ *
+ * @param kvdo     The KVDO
+ * @param ticking  Whether the checks should run
+ **/
+static void setTicking(KVDO *kvdo, bool ticking)
+{
+  atomic_set(&kvdo->ticking, (ticking ? 1 : 0));
+  if (ticking) {
+    schedulePackerTick(kvdo);
+    scheduleJournalTick(kvdo);
+    scheduleScrubTick(kvdo);
+    scheduleDiscardTick(kvdo);
+  }
+}
+
+/**
+ * Run the VIO callbacks gathered in a base thread's callback batch.
+ *
+ * <p>Implements BatchProcessorCallback.
+ *
+ * @param batch    The batch processor
+ * @param closure  Unused
+ **/
+static void runVIOCallbackBatch(BatchProcessor *batch,
+                                void           *closure __attribute__((unused)))
+{
+  unsigned int  count = 0;
+  KvdoWorkItem *item;
+  while ((item = nextBatchItem(batch)) != NULL) {
+    item->work(item);
+    count++;
+    condReschedBatchProcessor(batch);
+  }
+  noteWorkQueueBatch(count);
+}
+
 /**********************************************************************/
 int initializeKVDO(KVDO                *kvdo,
                    const ThreadConfig  *threadConfig,
@@ -110,12 +407,23 @@ int initializeKVDO(KVDO                *kvdo,
     int result = makeWorkQueue(layer->threadNamePrefix, queueName,
                                &layer->wqDirectory, layer, thread,
                                &requestQueueType, 1, &thread->requestQueue);
+    if (result == VDO_SUCCESS) {
+      result = makeBatchProcessorOnQueue(layer, thread->requestQueue,
+                                         REQ_Q_ACTION_VIO_CALLBACK,
+                                         runVIOCallbackBatch, NULL,
+                                         &thread->callbackBatch);
+      if (result != VDO_SUCCESS) {
+        finishWorkQueue(thread->requestQueue);
+        freeWorkQueue(&thread->requestQueue);
+      }
+    }
     if (result != VDO_SUCCESS) {
       *reason = "Cannot initialize request queue";
       while (kvdo->initializedThreadCount > 0) {
         unsigned int threadToDestroy = kvdo->initializedThreadCount - 1;
         thread = &kvdo->threads[threadToDestroy];
         finishWorkQueue(thread->requestQueue);
+        freeBatchProcessor(&thread->callbackBatch);
         freeWorkQueue(&thread->requestQueue);
         kvdo->initializedThreadCount--;
       }
@@ -123,6 +431,15 @@ int initializeKVDO(KVDO                *kvdo,
       return result;
     }
 
+    int node = getThreadNode(threadConfig, thread->threadID);
+    if (node != ANY_MEMORY_NODE) {
+      result = bindWorkQueueToNode(thread->requestQueue, node);
+      if (result != 0) {
+        // The thread still works, it just isn't kept near its memory.
+        logWarningWithStringError(result, "cannot bind %s to NUMA node %d",
+                                  queueName, node);
+      }
+    }
   }
   return VDO_SUCCESS;
 }
@@ -157,6 +474,7 @@ int startKVDO(KVDO *kvdo, PhysicalLayer *common, char **reason)
     return result;
   }
 
+  setTicking(kvdo, true);
   return VDO_SUCCESS;
 }
 
@@ -167,6 +485,7 @@ int suspendKVDO(KVDO *kvdo)
     return VDO_SUCCESS;
   }
 
+  setTicking(kvdo, false);
   KernelLayer *layer = container_of(kvdo, KernelLayer, kvdo);
   init_completion(&layer->callbackSync);
   int result = performVDOSuspend(kvdo->vdo, !layer->noFlushSuspend);
@@ -194,12 +513,18 @@ int resumeKVDO(KVDO *kvdo)
 
   KernelLayer *layer = container_of(kvdo, KernelLayer, kvdo);
   init_completion(&layer->callbackSync);
-  return performVDOResume(kvdo->vdo);
+  int result = performVDOResume(kvdo->vdo);
+  if (result == VDO_SUCCESS) {
+    setTicking(kvdo, true);
+  }
+  return result;
 }
 
 /**********************************************************************/
 void finishKVDO(KVDO *kvdo)
 {
+  // A pending tick will still run, but won't schedule another.
+  atomic_set(&kvdo->ticking, 0);
   for (int i = 0; i < kvdo->initializedThreadCount; i++) {
     finishWorkQueue(kvdo->threads[i].requestQueue);
   }
@@ -210,6 +535,7 @@ void destroyKVDO(KVDO *kvdo)
 {
   destroyVDO(kvdo->vdo);
   for (int i = 0; i < kvdo->initializedThreadCount; i++) {
+    freeBatchProcessor(&kvdo->threads[i].callbackBatch);
     freeWorkQueue(&kvdo->threads[i].requestQueue);
   }
   FREE(kvdo->threads);
@@ -225,6 +551,45 @@ void dumpKVDOWorkQueue(KVDO *kvdo)
   }
 }
 
+/**********************************************************************/
+bool getKVDOPartitionExtent(KVDO                *kvdo,
+                            PartitionID          id,
+                            PhysicalBlockNumber *offsetPtr,
+                            BlockCount          *sizePtr)
+{
+  VDO *vdo = kvdo->vdo;
+  if ((vdo == NULL) || (vdo->layout == NULL)) {
+    return false;
+  }
+
+  Partition *partition = getVDOPartition(vdo->layout, id);
+  *offsetPtr = getFixedLayoutPartitionOffset(partition);
+  *sizePtr   = getFixedLayoutPartitionSize(partition);
+  return true;
+}
+
+/**********************************************************************/
+bool getKVDOSlabMetadataIndex(KVDO                *kvdo,
+                              PhysicalBlockNumber  pbn,
+                              BlockCount          *indexPtr)
+{
+  VDO *vdo = kvdo->vdo;
+  if ((vdo == NULL) || (vdo->depot == NULL)) {
+    return false;
+  }
+  return getSlabMetadataIndex(vdo->depot, pbn, indexPtr);
+}
+
+/**********************************************************************/
+BlockCount getKVDOSlabMetadataBlockCount(KVDO *kvdo)
+{
+  VDO *vdo = kvdo->vdo;
+  if ((vdo == NULL) || (vdo->depot == NULL)) {
+    return 0;
+  }
+  return getSlabMetadataBlockCount(vdo->depot);
+}
+
 /**********************************************************************/
 typedef struct {
   KvdoWorkItem       workItem;
@@ -293,7 +658,7 @@ bool setKVDOCompressing(KVDO *kvdo, bool enableCompression)
   VDOCompressData data;
   data.enable = enableCompression;
   performKVDOOperation(kvdo, setCompressingWork, &data,
-                       getPackerZoneThread(getThreadConfig(kvdo->vdo)),
+                       getAdminThread(getThreadConfig(kvdo->vdo)),
                        &compressWait);
   return data.wasEnabled;
 }
@@ -422,6 +787,107 @@ int performKVDOExtendedCommand(KVDO *kvdo, int argc, char **argv)
   return destroyVDOCommandCompletion(&cmd);
 }
 
+/**
+ * A completion carrying the requested size of a block map cache resize.
+ **/
+typedef struct {
+  VDOCompletion  completion;
+  BlockMap      *blockMap;
+  PageCount      cacheSize;
+} CacheResizeCompletion;
+
+/**
+ * Start resizing the block map caches. Implements VDOAction.
+ *
+ * @param completion  The completion of a CacheResizeCompletion
+ **/
+static void resizeBlockMapCacheAction(VDOCompletion *completion)
+{
+  CacheResizeCompletion *resize
+    = container_of(completion, CacheResizeCompletion, completion);
+  resizeBlockMapCaches(resize->blockMap, resize->cacheSize, completion);
+}
+
+/**********************************************************************/
+int kvdoResizeBlockMapCache(KVDO *kvdo, PageCount cacheSize)
+{
+  KernelLayer          *layer  = container_of(kvdo, KernelLayer, kvdo);
+  CacheResizeCompletion resize = {
+    .blockMap  = getBlockMap(kvdo->vdo),
+    .cacheSize = cacheSize,
+  };
+  initializeCompletion(&resize.completion, EXTERNAL_COMPLETION,
+                       &layer->common);
+
+  VDOActionData data;
+  initializeVDOActionData(&data, resizeBlockMapCacheAction,
+                          &resize.completion);
+  performKVDOOperation(kvdo, performVDOActionWork, &data,
+                       getAdminThread(getThreadConfig(kvdo->vdo)),
+                       &data.waiter);
+  return resize.completion.result;
+}
+
+/**
+ * A completion carrying a new LBN policy table for the logical zones.
+ **/
+typedef struct {
+  VDOCompletion   completion;
+  LogicalZones   *zones;
+  LBNPolicyTable *table;
+} PolicyChangeCompletion;
+
+/**
+ * Start giving the logical zones a new policy table. Implements VDOAction.
+ *
+ * @param completion  The completion of a PolicyChangeCompletion
+ **/
+static void setLBNPolicyAction(VDOCompletion *completion)
+{
+  PolicyChangeCompletion *change
+    = container_of(completion, PolicyChangeCompletion, completion);
+  setLBNPolicyTable(change->zones, change->table, completion);
+}
+
+/**********************************************************************/
+int kvdoSetLBNPolicy(KVDO               *kvdo,
+                     LogicalBlockNumber  start,
+                     BlockCount          count,
+                     LBNPolicy           policy)
+{
+  KernelLayer            *layer  = container_of(kvdo, KernelLayer, kvdo);
+  PolicyChangeCompletion  change = {
+    .zones = kvdo->vdo->logicalZones,
+  };
+
+  // Messages are serialized, so the table can't change while it is copied.
+  int result = makeLBNPolicyTable(getLBNPolicyTable(change.zones), start,
+                                  count, policy, &change.table);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  initializeCompletion(&change.completion, EXTERNAL_COMPLETION,
+                       &layer->common);
+
+  VDOActionData data;
+  initializeVDOActionData(&data, setLBNPolicyAction, &change.completion);
+  performKVDOOperation(kvdo, performVDOActionWork, &data,
+                       getAdminThread(getThreadConfig(kvdo->vdo)),
+                       &data.waiter);
+  if (change.completion.result != VDO_SUCCESS) {
+    // The zones did not take the table.
+    freeLBNPolicyTable(&change.table);
+  }
+  return change.completion.result;
+}
+
+/**********************************************************************/
+PageCount getKVDOBlockMapCacheSize(KVDO *kvdo)
+{
+  return getBlockMapCacheSize(getBlockMap(kvdo->vdo));
+}
+
 /**********************************************************************/
 void dumpKVDOStatus(KVDO *kvdo)
 {
@@ -434,6 +900,90 @@ bool getKVDOCompressing(KVDO *kvdo)
   return getVDOCompressing(kvdo->vdo);
 }
 
+/**********************************************************************/
+void setKVDOPackerPolicy(KVDO *kvdo, PackerPolicy policy)
+{
+  setPackerPolicy(getVDOPackerZones(kvdo->vdo), policy);
+  schedulePackerTick(kvdo);
+}
+
+/**********************************************************************/
+PackerPolicy getKVDOPackerPolicy(KVDO *kvdo)
+{
+  return getPackerPolicy(getVDOPackerZones(kvdo->vdo));
+}
+
+/**********************************************************************/
+void getKVDOPackerHistograms(KVDO *kvdo, PackerHistograms *histograms)
+{
+  getPackerHistograms(getVDOPackerZones(kvdo->vdo), histograms);
+}
+
+/**********************************************************************/
+void getKVDOJournalCommitHistogram(KVDO *kvdo, uint64_t *histogram)
+{
+  getRecoveryJournalCommitHistogram(getRecoveryJournal(kvdo->vdo), histogram);
+}
+
+/**********************************************************************/
+int setKVDOScrubConcurrency(KVDO *kvdo, unsigned int concurrency)
+{
+  SlabDepot *depot = getSlabDepot(kvdo->vdo);
+  if (depot == NULL) {
+    return VDO_COMPONENT_BUSY;
+  }
+
+  setDepotScrubConcurrency(depot, concurrency);
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+unsigned int getKVDOScrubConcurrency(KVDO *kvdo)
+{
+  SlabDepot *depot = getSlabDepot(kvdo->vdo);
+  return ((depot == NULL) ? 0 : getDepotScrubConcurrency(depot));
+}
+
+/**********************************************************************/
+int setKVDOScrubRateLimit(KVDO *kvdo, uint32_t blocksPerSecond)
+{
+  SlabDepot *depot = getSlabDepot(kvdo->vdo);
+  if (depot == NULL) {
+    return VDO_COMPONENT_BUSY;
+  }
+
+  setDepotScrubRateLimit(depot, blocksPerSecond);
+  scheduleScrubTick(kvdo);
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+uint32_t getKVDOScrubRateLimit(KVDO *kvdo)
+{
+  SlabDepot *depot = getSlabDepot(kvdo->vdo);
+  return ((depot == NULL) ? 0 : getDepotScrubRateLimit(depot));
+}
+
+/**********************************************************************/
+int setKVDODiscardDelay(KVDO *kvdo, uint32_t milliseconds)
+{
+  SlabDepot *depot = getSlabDepot(kvdo->vdo);
+  if (depot == NULL) {
+    return VDO_COMPONENT_BUSY;
+  }
+
+  setDepotDiscardDelay(depot, milliseconds);
+  scheduleDiscardTick(kvdo);
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+uint32_t getKVDODiscardDelay(KVDO *kvdo)
+{
+  SlabDepot *depot = getSlabDepot(kvdo->vdo);
+  return ((depot == NULL) ? 0 : getDepotDiscardDelay(depot));
+}
+
 /**********************************************************************/
 int kvdoPrepareToGrowPhysical(KVDO *kvdo, BlockCount physicalCount)
 {
@@ -475,6 +1025,25 @@ int kvdoResizeLogical(KVDO *kvdo, BlockCount logicalCount)
   return result;
 }
 
+/**********************************************************************/
+int kvdoGrowLogicalOnline(KVDO *kvdo, BlockCount logicalCount)
+{
+  KernelLayer *layer = container_of(kvdo, KernelLayer, kvdo);
+  init_completion(&layer->callbackSync);
+  int result = performOnlineGrowLogical(kvdo->vdo, logicalCount);
+  if (result != VDO_SUCCESS) {
+    logError("online grow logical operation failed, result = %d", result);
+  }
+
+  return result;
+}
+
+/**********************************************************************/
+BlockCount getKVDOLogicalBlockCount(KVDO *kvdo)
+{
+  return getNumberOfBlockMapEntries(getBlockMap(kvdo->vdo));
+}
+
 /**********************************************************************/
 WritePolicy getKVDOWritePolicy(KVDO *kvdo)
 {
@@ -506,6 +1075,19 @@ void enqueueKVIO(KVIO             *kvio,
              kvio->layer->kvdo.threads[threadID].requestQueue);
 }
 
+/**********************************************************************/
+void enqueueKVIOBatched(KVIO             *kvio,
+                        KvdoWorkFunction  work,
+                        void             *statsFunction,
+                        unsigned int      action)
+{
+  ThreadID threadID = vioAsCompletion(kvio->vio)->callbackThreadID;
+  BUG_ON(threadID >= kvio->layer->kvdo.initializedThreadCount);
+  setupKVIOWork(kvio, work, statsFunction, action);
+  addToBatchProcessor(kvio->layer->kvdo.threads[threadID].callbackBatch,
+                      &kvio->enqueueable.workItem);
+}
+
 /**********************************************************************/
 static void kvdoEnqueueWork(KvdoWorkItem *workItem)
 {
@@ -534,6 +1116,15 @@ void kvdoEnqueue(Enqueueable *enqueueable)
     vioAddTraceRecord(asVIO(enqueueable->completion),
                       THIS_LOCATION("$F($cb)"));
   }
+
+  // invokeCallback() only gets here for a callback on the current thread if
+  // the completion asked to be requeued; anything else is a thread hop.
+  if (threadID == kvdoGetCurrentThreadID()) {
+    atomic64_inc(&layer->completionsRequeued);
+  } else {
+    atomic64_inc(&layer->completionThreadHops);
+  }
+
   setupWorkItem(&kvdoEnqueueable->workItem, kvdoEnqueueWork,
                 (KvdoWorkFunction) enqueueable->completion->callback,
                 REQ_Q_ACTION_COMPLETION);
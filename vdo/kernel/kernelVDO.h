@@ -23,6 +23,10 @@
 #define KERNEL_VDO_H
 
 #include "completion.h"
+#include "lbnPolicy.h"
+#include "packer.h"
+
+#include "batchProcessor.h"
 #include "kernelTypes.h"
 #include "threadRegistry.h"
 #include "workQueue.h"
@@ -31,6 +35,8 @@ typedef struct {
   KVDO              *kvdo;
   ThreadID           threadID;
   KvdoWorkQueue     *requestQueue;
+  // Gathers VIO callbacks from other threads into one enqueue per wakeup
+  BatchProcessor    *callbackBatch;
   RegisteredThread   allocatingThread;
 } KVDOThread;
 
@@ -40,14 +46,35 @@ struct kvdo {
   KvdoWorkItem       workItem;
   VDOAction         *action;
   VDOCompletion     *completion;
+  // Periodic work which enforces the packer's adaptive deadlines
+  KvdoWorkItem       packerTickItem;
+  atomic_t           packerTickQueued;
+  ZoneCount          packerTickZone;
+  // Periodic work which enforces the journal's group commit deadline
+  KvdoWorkItem       journalTickItem;
+  atomic_t           journalTickQueued;
+  // Periodic work which resumes rate-limited slab scrubbing
+  KvdoWorkItem       scrubTickItem;
+  atomic_t           scrubTickQueued;
+  ZoneCount          scrubTickZone;
+  // Periodic work which discards freed blocks once their delay has passed
+  KvdoWorkItem       discardTickItem;
+  atomic_t           discardTickQueued;
+  ZoneCount          discardTickZone;
+  // Whether the periodic work should run
+  atomic_t           ticking;
   // Base-code device info
   VDO               *vdo;
 };
 
 typedef enum reqQAction {
   REQ_Q_ACTION_COMPLETION,
+  REQ_Q_ACTION_DISCARD_TICK,
   REQ_Q_ACTION_FLUSH,
+  REQ_Q_ACTION_JOURNAL_TICK,
   REQ_Q_ACTION_MAP_BIO,
+  REQ_Q_ACTION_PACKER_TICK,
+  REQ_Q_ACTION_SCRUB_TICK,
   REQ_Q_ACTION_SYNC,
   REQ_Q_ACTION_VIO_CALLBACK
 } ReqQAction;
@@ -149,6 +176,51 @@ static inline VDO *getVDO(KVDO *kvdo)
   return kvdo->vdo;
 }
 
+/**
+ * Get the extent of one of the partitions of a VDO's layout.
+ *
+ * @param [in]  kvdo       The KVDO object
+ * @param [in]  id         The partition
+ * @param [out] offsetPtr  A pointer to hold the first block of the partition
+ * @param [out] sizePtr    A pointer to hold the size of the partition
+ *
+ * @return true if the layout has been loaded and so the extent is known
+ **/
+bool getKVDOPartitionExtent(KVDO                *kvdo,
+                            PartitionID          id,
+                            PhysicalBlockNumber *offsetPtr,
+                            BlockCount          *sizePtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Find where a block lies among the reference count and slab journal blocks
+ * of a VDO's slabs, numbered consecutively slab by slab.
+ *
+ * @param [in]  kvdo      The KVDO object
+ * @param [in]  pbn       The physical block number
+ * @param [out] indexPtr  A pointer to hold the index of the block among the
+ *                        slab metadata blocks
+ *
+ * @return true if the slab depot has been loaded and the block is a slab
+ *         metadata block
+ **/
+bool getKVDOSlabMetadataIndex(KVDO                *kvdo,
+                              PhysicalBlockNumber  pbn,
+                              BlockCount          *indexPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the number of reference count and slab journal blocks of a VDO's
+ * slabs, including any slabs being added by a resize.
+ *
+ * @param kvdo  The KVDO object
+ *
+ * @return The number of slab metadata blocks, or 0 if the slab depot has not
+ *         been loaded
+ **/
+BlockCount getKVDOSlabMetadataBlockCount(KVDO *kvdo)
+  __attribute__((warn_unused_result));
+
 /**
  * Set whether compression is enabled.
  *
@@ -168,6 +240,100 @@ bool setKVDOCompressing(KVDO *kvdo, bool enableCompression);
  */
 bool getKVDOCompressing(KVDO *kvdo);
 
+/**
+ * Set the packer's policy for writing partially filled bins.
+ *
+ * @param kvdo    The KVDO object
+ * @param policy  The new policy
+ **/
+void setKVDOPackerPolicy(KVDO *kvdo, PackerPolicy policy);
+
+/**
+ * Get the packer's policy for writing partially filled bins.
+ *
+ * @param kvdo  The KVDO object to be queried
+ *
+ * @return The current packer policy
+ **/
+PackerPolicy getKVDOPackerPolicy(KVDO *kvdo);
+
+/**
+ * Get the packer's pack-efficiency and wait-time histograms.
+ *
+ * @param [in]  kvdo        The KVDO object to be queried
+ * @param [out] histograms  The histograms to fill in
+ **/
+void getKVDOPackerHistograms(KVDO *kvdo, PackerHistograms *histograms);
+
+/**
+ * Get the recovery journal's histogram of entries written per block commit.
+ *
+ * @param [in]  kvdo       The KVDO object to be queried
+ * @param [out] histogram  The RECOVERY_JOURNAL_HISTOGRAM_BUCKETS counts
+ **/
+void getKVDOJournalCommitHistogram(KVDO *kvdo, uint64_t *histogram);
+
+/**
+ * Set the number of slabs each physical zone may scrub at once.
+ *
+ * @param kvdo         The KVDO object
+ * @param concurrency  The number of slabs, from 1 to MAX_SCRUB_CONCURRENCY
+ *
+ * @return VDO_SUCCESS or VDO_COMPONENT_BUSY if the VDO has not been loaded
+ **/
+int setKVDOScrubConcurrency(KVDO *kvdo, unsigned int concurrency)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the number of slabs each physical zone may scrub at once.
+ *
+ * @param kvdo  The KVDO object to be queried
+ *
+ * @return The number of slabs, or 0 if the VDO has not been loaded
+ **/
+unsigned int getKVDOScrubConcurrency(KVDO *kvdo);
+
+/**
+ * Limit the metadata bandwidth of background slab scrubbing.
+ *
+ * @param kvdo             The KVDO object
+ * @param blocksPerSecond  The number of blocks per second, or 0 for no limit
+ *
+ * @return VDO_SUCCESS or VDO_COMPONENT_BUSY if the VDO has not been loaded
+ **/
+int setKVDOScrubRateLimit(KVDO *kvdo, uint32_t blocksPerSecond)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the metadata bandwidth limit of background slab scrubbing.
+ *
+ * @param kvdo  The KVDO object to be queried
+ *
+ * @return The number of blocks per second, or 0 if there is no limit
+ **/
+uint32_t getKVDOScrubRateLimit(KVDO *kvdo);
+
+/**
+ * Set how long freed data blocks wait before they are discarded on the
+ * underlying storage.
+ *
+ * @param kvdo          The KVDO object
+ * @param milliseconds  The delay, or 0 to stop discarding freed blocks
+ *
+ * @return VDO_SUCCESS or VDO_COMPONENT_BUSY if the VDO has not been loaded
+ **/
+int setKVDODiscardDelay(KVDO *kvdo, uint32_t milliseconds)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get how long freed data blocks wait before they are discarded.
+ *
+ * @param kvdo  The KVDO object to be queried
+ *
+ * @return The delay in milliseconds, or 0 if freed blocks are not discarded
+ **/
+uint32_t getKVDODiscardDelay(KVDO *kvdo);
+
 /**
  * Gets the latest statistics gathered by the base code.
  *
@@ -232,6 +398,62 @@ int kvdoPrepareToGrowLogical(KVDO *kvdo, BlockCount logicalCount);
  */
 int kvdoResizeLogical(KVDO *kvdo, BlockCount logicalCount);
 
+/**
+ * Request the base code grow the logical space without suspending.
+ *
+ * @param kvdo          The KVDO to be updated
+ * @param logicalCount  The new size
+ *
+ * @return VDO_SUCCESS or error
+ */
+int kvdoGrowLogicalOnline(KVDO *kvdo, BlockCount logicalCount);
+
+/**
+ * Get the current logical size of the VDO.
+ *
+ * @param kvdo  The KVDO to be queried
+ *
+ * @return The number of logical blocks
+ */
+BlockCount getKVDOLogicalBlockCount(KVDO *kvdo);
+
+/**
+ * Request the base code resize the block map page caches.
+ *
+ * @param kvdo       The KVDO to be updated
+ * @param cacheSize  The new total cache size, in pages
+ *
+ * @return VDO_SUCCESS or error
+ */
+int kvdoResizeBlockMapCache(KVDO *kvdo, PageCount cacheSize);
+
+/**
+ * Set whether writes to a range of logical blocks may be deduplicated or
+ * compressed. The policy is not saved, and every block starts with both
+ * allowed when a VDO is started.
+ *
+ * @param kvdo    The KVDO to be updated
+ * @param start   The first block of the range
+ * @param count   The number of blocks in the range
+ * @param policy  The policy for the range
+ *
+ * @return VDO_SUCCESS or error
+ */
+int kvdoSetLBNPolicy(KVDO               *kvdo,
+                     LogicalBlockNumber  start,
+                     BlockCount          count,
+                     LBNPolicy           policy);
+
+/**
+ * Get the current total size of the block map page caches. The value is
+ * only updated on the admin thread, so it may be momentarily stale.
+ *
+ * @param kvdo  The KVDO
+ *
+ * @return The size of the caches, in pages
+ */
+PageCount getKVDOBlockMapCacheSize(KVDO *kvdo);
+
 /**
  * Request the base code go read-only.
  *
@@ -275,6 +497,21 @@ void enqueueKVIO(KVIO             *kvio,
                  void             *statsFunction,
                  unsigned int      action);
 
+/**
+ * Set up a VIO's work item to be processed in the base code context, and add
+ * it to the callback batch of the thread it is to run on, so that a thread
+ * sending a burst of VIOs to the same base thread wakes it only once.
+ *
+ * @param kvio           The VIO with the work item to be run
+ * @param work           The function pointer to execute
+ * @param statsFunction  A function pointer to record for stats, or NULL
+ * @param action         Action code, mapping to a relative priority
+ **/
+void enqueueKVIOBatched(KVIO             *kvio,
+                        KvdoWorkFunction  work,
+                        void             *statsFunction,
+                        unsigned int      action);
+
 /**
  * Enqueue an arbitrary completion for execution on its indicated
  * thread.
@@ -21,6 +21,10 @@
 
 #include "ktrace.h"
 
+#include <linux/fs.h>
+#include <linux/percpu.h>
+#include <linux/uaccess.h>
+
 #include "memoryAlloc.h"
 
 #include "dataVIO.h"
@@ -35,9 +39,32 @@ enum {
 
   // What fraction (1 out of TRACE_SAMPLE_INTERVAL VIOs) to trace
   TRACE_SAMPLE_INTERVAL = 3,
+
+  // How many records each CPU's trace buffer holds
+  TRACE_BUFFER_RECORDS  = 4096,
+
+  // How many records are copied out of a trace buffer at a time by a read
+  TRACE_READ_BATCH      = 8,
 };
 
+/**
+ * A ring of binary trace records. When the ring is full, the oldest records
+ * are overwritten.
+ **/
+typedef struct {
+  spinlock_t   lock;
+  uint64_t     written;  // the number of records ever written
+  uint64_t     read;     // the number of records ever read or overwritten
+  KTraceRecord records[TRACE_BUFFER_RECORDS];
+} TraceBuffer;
+
 bool traceRecording = false;
+bool traceBuffering = false;
+
+static DEFINE_PER_CPU(TraceBuffer *, traceBuffers);
+
+// Serializes the allocation of the trace buffers.
+static struct mutex traceBufferMutex;
 
 static struct {
   char         buffer[2000];
@@ -132,11 +159,145 @@ int traceKernelLayerInit(KernelLayer *layer)
 void initializeTraceLoggingOnce(void)
 {
   mutex_init(&traceLoggingState.lock);
+  mutex_init(&traceBufferMutex);
+}
+
+/*************************************************************************/
+int setTraceBuffering(bool enable)
+{
+  mutex_lock(&traceBufferMutex);
+  int cpu;
+  for_each_possible_cpu(cpu) {
+    TraceBuffer **bufferPtr = per_cpu_ptr(&traceBuffers, cpu);
+    if (!enable || (*bufferPtr != NULL)) {
+      continue;
+    }
+
+    TraceBuffer *buffer;
+    int result = ALLOCATE(1, TraceBuffer, "trace buffer", &buffer);
+    if (result != VDO_SUCCESS) {
+      mutex_unlock(&traceBufferMutex);
+      return result;
+    }
+    spin_lock_init(&buffer->lock);
+    WRITE_ONCE(*bufferPtr, buffer);
+  }
+
+  WRITE_ONCE(traceBuffering, enable);
+  mutex_unlock(&traceBufferMutex);
+  return VDO_SUCCESS;
+}
+
+/*************************************************************************/
+void freeTraceBuffers(void)
+{
+  WRITE_ONCE(traceBuffering, false);
+  int cpu;
+  for_each_possible_cpu(cpu) {
+    TraceBuffer **bufferPtr = per_cpu_ptr(&traceBuffers, cpu);
+    FREE(*bufferPtr);
+    *bufferPtr = NULL;
+  }
+}
+
+/**
+ * Copy the trace of a KVIO into the current CPU's trace buffer.
+ *
+ * @param kvio  The kvio
+ **/
+static void bufferKvioTrace(KVIO *kvio)
+{
+  kvioAddTraceRecord(kvio, THIS_LOCATION(NULL));
+  Trace *trace = kvio->vio->trace;
+
+  unsigned long flags;
+  local_irq_save(flags);
+  TraceBuffer *buffer = *this_cpu_ptr(&traceBuffers);
+  if (buffer != NULL) {
+    spin_lock(&buffer->lock);
+    for (unsigned int i = 0; i < trace->used; i++) {
+      TraceRecord *record = &trace->records[i];
+      buffer->records[buffer->written % TRACE_BUFFER_RECORDS]
+        = (KTraceRecord) {
+            .when     = record->when,
+            .kvio     = (uintptr_t) kvio,
+            .tid      = record->tid,
+            .location = record->location,
+          };
+      buffer->written++;
+    }
+    if ((buffer->written - buffer->read) > TRACE_BUFFER_RECORDS) {
+      buffer->read = buffer->written - TRACE_BUFFER_RECORDS;
+    }
+    spin_unlock(&buffer->lock);
+  }
+  local_irq_restore(flags);
 }
 
+/**
+ * Read the records in the trace buffers, removing them from the buffers.
+ * The buffers are drained in CPU order; the records are copied out of the
+ * spin lock a few at a time so that tracing is never held up by a slow copy.
+ *
+ * @param file    The trace buffer file
+ * @param buf     The user buffer to fill
+ * @param length  The size of the user buffer
+ * @param offset  The file offset, which is ignored
+ *
+ * @return The number of bytes read, or -EFAULT
+ **/
+static ssize_t readTraceBuffers(struct file *file,
+                                char __user *buf,
+                                size_t       length,
+                                loff_t      *offset)
+{
+  KTraceRecord batch[TRACE_READ_BATCH];
+  size_t       copied = 0;
+  int          cpu;
+  for_each_possible_cpu(cpu) {
+    TraceBuffer *buffer = READ_ONCE(*per_cpu_ptr(&traceBuffers, cpu));
+    if (buffer == NULL) {
+      continue;
+    }
+
+    for (;;) {
+      size_t count = 0;
+      spin_lock_irq(&buffer->lock);
+      while ((count < TRACE_READ_BATCH) && (buffer->read < buffer->written)
+             && ((copied + ((count + 1) * sizeof(KTraceRecord))) <= length)) {
+        batch[count++]
+          = buffer->records[buffer->read++ % TRACE_BUFFER_RECORDS];
+      }
+      spin_unlock_irq(&buffer->lock);
+
+      if (count == 0) {
+        break;
+      }
+
+      if (copy_to_user(buf + copied, batch,
+                       count * sizeof(KTraceRecord)) != 0) {
+        return ((copied > 0) ? copied : -EFAULT);
+      }
+      copied += count * sizeof(KTraceRecord);
+    }
+  }
+
+  *offset += copied;
+  return copied;
+}
+
+const struct file_operations traceBufferOps = {
+  .read = readTraceBuffers,
+};
+
 /*************************************************************************/
 void logKvioTrace(KVIO *kvio)
 {
+  if (READ_ONCE(traceBuffering)) {
+    bufferKvioTrace(kvio);
+    return;
+  }
+
   KernelLayer *layer = kvio->layer;
 
   mutex_lock(&traceLoggingState.lock);
@@ -42,6 +42,33 @@ typedef struct {
  **/
 extern bool traceRecording;
 
+/**
+ * Flag indicating whether the traces of sampled KVIOs are copied into the
+ * per-CPU trace buffers rather than being formatted and logged.
+ **/
+extern bool traceBuffering;
+
+/**
+ * The binary record of one trace point of a KVIO, as read from the trace
+ * buffer file. Each CPU's buffer holds the records of the KVIOs freed on it,
+ * so a decoder should sort the records by time. The location is an index
+ * relative to baseTraceLocation, which a decoder resolves from the module's
+ * .kvdo_trace_locations section.
+ **/
+typedef struct {
+  uint64_t            when;     // counted in usec
+  uint64_t            kvio;     // the address of the KVIO, which identifies it
+  pid_t               tid;
+  TraceLocationNumber location;
+} KTraceRecord;
+
+/**
+ * The file operations of the trace buffer file. Reading the file drains the
+ * records from the per-CPU trace buffers; a read which finds them all empty
+ * returns 0.
+ **/
+extern const struct file_operations traceBufferOps;
+
 /**
  * Updates the counter state and returns true once each time the
  * sampling interval is reached.
@@ -85,7 +112,25 @@ int allocTraceFromPool(struct kernelLayer *layer, Trace **tracePointer);
 void freeTraceToPool(struct kernelLayer *layer, Trace *trace);
 
 /**
- * Log the trace at kvio freeing time
+ * Turn the per-CPU trace buffers on or off. The buffers are allocated the
+ * first time they are turned on, and kept, with any records not yet read,
+ * until the module is unloaded.
+ *
+ * @param enable  Whether to copy traces into the buffers
+ *
+ * @return VDO_SUCCESS or an error code
+ **/
+int setTraceBuffering(bool enable)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free the per-CPU trace buffers when the module is unloaded.
+ **/
+void freeTraceBuffers(void);
+
+/**
+ * Log the trace at kvio freeing time, or copy it into the current CPU's
+ * trace buffer if trace buffering is on
  *
  * @param kvio  The kvio structure
  **/
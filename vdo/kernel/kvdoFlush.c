@@ -38,6 +38,11 @@
  * If another allocation fails while the spare is in use, it will merely be
  * queued for later processing.
  *
+ * <p>Until the VDO starts a KVDOFlush, it is the layer's pending flush, and
+ * any other flush bio which arrives joins it rather than getting a flush of
+ * its own. Once the VDO flush is done, only the first bio is sent on to the
+ * storage device; the others are completed with its result.
+ *
  * <p>When a KVDOFlush is complete, it will either be freed, immediately
  * re-used for queued flushes, or stashed in the kernel layer as the new spare
  * object. This ensures that we will always make forward progress.
@@ -48,6 +53,10 @@ struct kvdoFlush {
   struct bio_list  bios;
   Jiffies          arrivalTime;  // Time when earliest bio appeared
   VDOFlush         vdoFlush;
+  // The private data and callback of the bio sent to the storage device
+  void            *devicePrivate;
+  bio_end_io_t    *deviceEndIO;
+  unsigned int     bioCount;
 };
 
 /**********************************************************************/
@@ -69,8 +78,17 @@ bool shouldProcessFlush(KernelLayer *layer)
  **/
 static void kvdoFlushWork(KvdoWorkItem *item)
 {
-  KVDOFlush *kvdoFlush = container_of(item, KVDOFlush, workItem);
-  flush(kvdoFlush->layer->kvdo.vdo, &kvdoFlush->vdoFlush);
+  KVDOFlush   *kvdoFlush = container_of(item, KVDOFlush, workItem);
+  KernelLayer *layer     = kvdoFlush->layer;
+
+  // Once the VDO flush starts, later bios may not be covered by it.
+  spin_lock(&layer->flushLock);
+  if (layer->pendingKVDOFlush == kvdoFlush) {
+    layer->pendingKVDOFlush = NULL;
+  }
+  spin_unlock(&layer->flushLock);
+
+  flush(layer->kvdo.vdo, &kvdoFlush->vdoFlush);
 }
 
 /**
@@ -88,6 +106,7 @@ static void initializeKVDOFlush(KVDOFlush *kvdoFlush, KernelLayer *layer)
   bio_list_merge(&kvdoFlush->bios, &layer->waitingFlushes);
   bio_list_init(&layer->waitingFlushes);
   kvdoFlush->arrivalTime = layer->flushArrivalTime;
+  layer->pendingKVDOFlush = kvdoFlush;
 }
 
 /**********************************************************************/
@@ -96,7 +115,7 @@ static void enqueueKVDOFlush(KVDOFlush *kvdoFlush)
   setupWorkItem(&kvdoFlush->workItem, kvdoFlushWork, NULL, REQ_Q_ACTION_FLUSH);
   KVDO *kvdo = &kvdoFlush->layer->kvdo;
   enqueueKVDOWork(kvdo, &kvdoFlush->workItem,
-                  getPackerZoneThread(getThreadConfig(kvdo->vdo)));
+                  getPackerZoneThread(getThreadConfig(kvdo->vdo), 0));
 }
 
 /**********************************************************************/
@@ -108,6 +127,15 @@ void launchKVDOFlush(KernelLayer *layer, BIO *bio)
 
   spin_lock(&layer->flushLock);
 
+  if (layer->pendingKVDOFlush != NULL) {
+    // A flush which the VDO has not yet started will cover this bio too.
+    bio_list_add(&layer->pendingKVDOFlush->bios, bio);
+    spin_unlock(&layer->flushLock);
+    atomic64_inc(&layer->flushesCoalesced);
+    FREE(kvdoFlush);
+    return;
+  }
+
   // We have a new bio to start.  Add it to the list.  If it becomes the
   // only entry on the list, record the time.
   if (bio_list_empty(&layer->waitingFlushes)) {
@@ -179,7 +207,68 @@ static void releaseKVDOFlush(KVDOFlush *kvdoFlush)
 }
 
 /**
- * Function called to complete and free a flush request
+ * Function called to record that a flush request is done and release it,
+ * once the storage device has finished flushing.
+ *
+ * @param item    The flush-request work item
+ **/
+static void kvdoFinishFlushWork(KvdoWorkItem *item)
+{
+  KVDOFlush   *kvdoFlush = container_of(item, KVDOFlush, workItem);
+  KernelLayer *layer     = kvdoFlush->layer;
+
+  enterHistogramSample(layer->flushLatencyHistogram,
+                       jiffies - kvdoFlush->arrivalTime);
+  enterHistogramSample(layer->flushBatchHistogram, kvdoFlush->bioCount);
+
+  // Release the KVDOFlush object, freeing it, re-using it as the spare, or
+  // using it to launch any flushes that had to wait when allocations failed.
+  releaseKVDOFlush(kvdoFlush);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
+/**
+ * Callback for the flush bio sent to the storage device on behalf of all the
+ * bios of a flush request.
+ *
+ * @param bio  The flush bio
+ **/
+static void endCoalescedFlush(BIO *bio)
+#else
+/**
+ * Callback for the flush bio sent to the storage device on behalf of all the
+ * bios of a flush request.
+ *
+ * @param bio     The flush bio
+ * @param result  The result of the flush operation
+ **/
+static void endCoalescedFlush(BIO *bio, int result)
+#endif
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
+  int result = getBioResult(bio);
+#endif
+
+  KVDOFlush *kvdoFlush = bio->bi_private;
+  BIO       *waiter;
+  while ((waiter = bio_list_pop(&kvdoFlush->bios)) != NULL) {
+    completeBio(waiter, result);
+  }
+
+  bio->bi_private = kvdoFlush->devicePrivate;
+  bio->bi_end_io  = kvdoFlush->deviceEndIO;
+  completeBio(bio, result);
+
+  // The flush lock may not be taken in interrupt context.
+  setupWorkItem(&kvdoFlush->workItem, kvdoFinishFlushWork, NULL,
+                BIO_Q_ACTION_FLUSH);
+  enqueueBioWorkItem(kvdoFlush->layer->ioSubmitter, &kvdoFlush->workItem);
+}
+
+/**
+ * Function called to send a completed flush request on to the storage
+ * device. Only one flush is issued no matter how many bios the request
+ * covers.
  *
  * @param item    The flush-request work item
  **/
@@ -188,23 +277,28 @@ static void kvdoCompleteFlushWork(KvdoWorkItem *item)
   KVDOFlush   *kvdoFlush = container_of(item, KVDOFlush, workItem);
   KernelLayer *layer     = kvdoFlush->layer;
 
+  // We're not acknowledging these bios now, but we'll never touch them
+  // again, so this is the last chance to account for them.
+  kvdoFlush->bioCount = 0;
   BIO *bio;
-  while ((bio = bio_list_pop(&kvdoFlush->bios)) != NULL) {
-    // We're not acknowledging this bio now, but we'll never touch it
-    // again, so this is the last chance to account for it.
+  bio_list_for_each(bio, &kvdoFlush->bios) {
     countBios(&layer->biosAcknowledged, bio);
-
-    // Make sure the bio is a empty flush bio.
-    prepareFlushBIO(bio, bio->bi_private, getKernelLayerBdev(layer),
-                    bio->bi_end_io);
-    atomic64_inc(&layer->flushOut);
-    generic_make_request(bio);
+    kvdoFlush->bioCount++;
   }
 
+  // Make sure the bio is a empty flush bio.
+  bio = bio_list_pop(&kvdoFlush->bios);
+  kvdoFlush->devicePrivate = bio->bi_private;
+  kvdoFlush->deviceEndIO   = bio->bi_end_io;
+  prepareFlushBIO(bio, kvdoFlush, getKernelLayerBdev(layer),
+                  endCoalescedFlush);
+  atomic64_inc(&layer->flushOut);
+  if (layer->ramBacking != NULL) {
+    submitToRAMBacking(layer->ramBacking, getKernelLayerBdev(layer), bio);
+    return;
+  }
 
-  // Release the KVDOFlush object, freeing it, re-using it as the spare, or
-  // using it to launch any flushes that had to wait when allocations failed.
-  releaseKVDOFlush(kvdoFlush);
+  generic_make_request(bio);
 }
 
 /**********************************************************************/
@@ -267,7 +361,11 @@ int synchronousFlush(KernelLayer *layer)
   init_completion(&layer->flushWait);
   prepareFlushBIO(&bio, layer, getKernelLayerBdev(layer), endSynchronousFlush);
   bio.bi_next = NULL;
-  generic_make_request(&bio);
+  if (layer->ramBacking != NULL) {
+    submitToRAMBacking(layer->ramBacking, getKernelLayerBdev(layer), &bio);
+  } else {
+    generic_make_request(&bio);
+  }
   wait_for_completion(&layer->flushWait);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
   if (getBioResult(&bio) != 0) {
@@ -53,6 +53,14 @@ void kvdoEnqueueVIOCallback(KVIO *kvio)
               REQ_Q_ACTION_VIO_CALLBACK);
 }
 
+/**********************************************************************/
+void kvdoEnqueueVIOCallbackBatched(KVIO *kvio)
+{
+  enqueueKVIOBatched(kvio, kvdoHandleVIOCallback,
+                     (KvdoWorkFunction) vioAsCompletion(kvio->vio)->callback,
+                     REQ_Q_ACTION_VIO_CALLBACK);
+}
+
 /**********************************************************************/
 void kvdoContinueKvio(KVIO *kvio, int error)
 {
@@ -66,7 +74,7 @@ void kvdoContinueKvio(KVIO *kvio, int error)
 // noinline ensures systemtap can hook in here
 static noinline void maybeLogKvioTrace(KVIO *kvio)
 {
-  if (kvio->layer->traceLogging) {
+  if (kvio->layer->traceLogging || READ_ONCE(traceBuffering)) {
     logKvioTrace(kvio);
   }
 }
@@ -105,13 +113,17 @@ void freeCompressedWriteKVIO(CompressedWriteKVIO **compressedWriteKVIOPtr)
 void kvdoWriteCompressedBlock(AllocatingVIO *allocatingVIO)
 {
   // This method assumes that compressed writes never set the flush or FUA
-  // bits.
+  // bits, except when the journal will not flush before committing the
+  // mappings to the block.
   CompressedWriteKVIO *compressedWriteKVIO
     = allocatingVIOAsCompressedWriteKVIO(allocatingVIO);
   KVIO *kvio = compressedWriteKVIOAsKVIO(compressedWriteKVIO);
   BIO  *bio  = kvio->bio;
   resetBio(bio, kvio->layer);
   setBioOperationWrite(bio);
+  if (writesDataWithFUA(kvio->vio->vdo)) {
+    setBioOperationFlagFua(bio);
+  }
   setBioSector(bio, blockToSector(kvio->layer, kvio->vio->physical));
   submitBio(bio, BIO_Q_ACTION_COMPRESSED_DATA);
 }
@@ -136,7 +148,11 @@ void kvdoSubmitMetadataVIO(VIO *vio)
   BIO  *bio  = kvio->bio;
   resetBio(bio, kvio->layer);
 
-  setBioSector(bio, blockToSector(kvio->layer, vio->physical));
+  sector_t             sector;
+  struct block_device *device = mapMetadataBlock(kvio->layer, vio->type,
+                                                 vio->physical, &sector);
+  setBioBlockDevice(bio, device);
+  setBioSector(bio, sector);
 
   // Metadata I/Os bypass the read cache.
   if (isReadVIO(vio)) {
@@ -160,7 +176,14 @@ void kvdoSubmitMetadataVIO(VIO *vio)
     }
   }
 
-  if (vioRequiresFlushAfter(vio)) {
+  /*
+   * Flushes and FUA writes only reach the device they are sent to, so
+   * writes to a separate journal device are always made durable at once;
+   * see sendBioToDevice() for the preflush. This also keeps them out of the
+   * bio map, whose sectors are those of the main device.
+   */
+  if (vioRequiresFlushAfter(vio)
+      || (!isReadVIO(vio) && (device != getKernelLayerBdev(kvio->layer)))) {
     setBioOperationFlagFua(bio);
   }
   submitBio(bio, getMetadataAction(vio));
@@ -209,6 +232,54 @@ void kvdoFlushVIO(VIO *vio)
   submitBio(bio, getMetadataAction(vio));
 }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
+/**
+ * Handle the completion of a base-code initiated discard by continuing the
+ * discard VIO.
+ *
+ * @param bio    The bio to complete
+ **/
+static void completeDiscardBio(BIO *bio)
+#else
+/**
+ * Handle the completion of a base-code initiated discard by continuing the
+ * discard VIO.
+ *
+ * @param bio    The bio to complete
+ * @param error  Possible error from underlying block device
+ **/
+static void completeDiscardBio(BIO *bio, int error)
+#endif
+{
+  KVIO *kvio = (KVIO *) bio->bi_private;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
+  int   error = getBioResult(bio);
+#endif
+  // A device may stop supporting discards, which is no cause for alarm.
+  kvdoContinueKvio(kvio, ((error == -EOPNOTSUPP) ? VDO_SUCCESS : error));
+}
+
+/**********************************************************************/
+void kvdoDiscardVIO(VIO *vio, BlockCount blockCount)
+{
+  KVIO        *kvio  = metadataKVIOAsKVIO(vioAsMetadataKVIO(vio));
+  BIO         *bio   = kvio->bio;
+  KernelLayer *layer = kvio->layer;
+
+  sector_t             sector;
+  struct block_device *device = mapMetadataBlock(layer, vio->type,
+                                                 vio->physical, &sector);
+  if (!blk_queue_discard(bdev_get_queue(device))) {
+    kvdoContinueKvio(kvio, VDO_SUCCESS);
+    return;
+  }
+
+  resetBio(bio, layer);
+  prepareDiscardBIO(bio, kvio, device, sector,
+                    blockCount * VDO_BLOCK_SIZE, completeDiscardBio);
+  submitBio(bio, BIO_Q_ACTION_METADATA);
+}
+
 /*
  * Hook for a SystemTap probe to potentially restrict the choices
  * of which VIOs should have their latencies tracked.
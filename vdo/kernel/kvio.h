@@ -59,6 +59,11 @@ struct kvio {
    * locate the containing KVIO like any other work function.
    **/
   KvdoWorkFunction   bioSubmissionCallback;
+  /**
+   * Set by a bio thread which is polling for the completion of this
+   * KVIO's bio, to a flag the completion sets; see ioSubmitter.c.
+   **/
+  bool              *pollCompletion;
   /** A slot for an arbitrary bit of data, for use by systemtap. */
   long               debugSlot;
 };
@@ -238,6 +243,14 @@ static inline void launchKVIO(KVIO             *kvio,
  **/
 void kvdoEnqueueVIOCallback(KVIO *kvio);
 
+/**
+ * Move a KVIO back to the base threads through the callback batch of the
+ * thread it is to run on.
+ *
+ * @param kvio The KVIO to enqueue
+ **/
+void kvdoEnqueueVIOCallbackBatched(KVIO *kvio);
+
 /**
  * Handles kvio-related I/O post-processing.
  *
@@ -346,4 +359,16 @@ void kvdoSubmitMetadataVIO(VIO *vio);
  **/
 void kvdoFlushVIO(VIO *vio);
 
+/**
+ * Discard a run of data blocks on the lower layer using the BIO in a
+ * metadata VIO. If the device does not support discards, the VIO is simply
+ * continued.
+ *
+ * <p>Implements BlockDiscarder.
+ *
+ * @param vio         The VIO, whose physical block starts the run
+ * @param blockCount  The number of blocks to discard
+ **/
+void kvdoDiscardVIO(VIO *vio, BlockCount blockCount);
+
 #endif /* KVIO_H */
@@ -23,6 +23,14 @@
 
 #include <linux/sched.h>
 
+#include "numeric.h"
+#include "timeUtils.h"
+
+enum {
+  /** The interval over which the smallest latency is tracked */
+  LATENCY_INTERVAL_NS = 100 * 1000 * 1000,
+};
+
 /**********************************************************************/
 void getLimiterValuesAtomically(Limiter  *limiter,
                                 uint32_t *active,
@@ -37,13 +45,101 @@ void getLimiterValuesAtomically(Limiter  *limiter,
 /**********************************************************************/
 void initializeLimiter(Limiter *limiter, uint32_t limit)
 {
-  limiter->active  = 0;
-  limiter->limit   = limit;
-  limiter->maximum = 0;
+  limiter->active             = 0;
+  limiter->limit              = limit;
+  limiter->maximum            = 0;
+  limiter->ceiling            = limit;
+  limiter->floor              = maxUInt(1, limit / 16);
+  limiter->targetLatency      = 0;
+  limiter->intervalStart      = 0;
+  limiter->intervalMinLatency = UINT64_MAX;
   init_waitqueue_head(&limiter->waiterQueue);
   spin_lock_init(&limiter->lock);
 }
 
+/**
+ * Set the limit of a limiter, waking any waiters which the new limit admits.
+ *
+ * The limiter's lock must already be locked. It will be unlocked on return.
+ *
+ * @param limiter  The limiter to update
+ * @param limit    The new limit
+ **/
+static void setLimitAndUnlock(Limiter *limiter, uint32_t limit)
+{
+  uint32_t oldLimit = limiter->limit;
+  limiter->limit = limit;
+  spin_unlock(&limiter->lock);
+  if ((limit > oldLimit) && waitqueue_active(&limiter->waiterQueue)) {
+    wake_up_nr(&limiter->waiterQueue, limit - oldLimit);
+  }
+}
+
+/**********************************************************************/
+void setLimiterLatencyTarget(Limiter *limiter, uint64_t targetLatency)
+{
+  spin_lock(&limiter->lock);
+  limiter->targetLatency      = targetLatency;
+  limiter->intervalStart      = currentTime(CLOCK_MONOTONIC);
+  limiter->intervalMinLatency = UINT64_MAX;
+  setLimitAndUnlock(limiter, ((targetLatency == 0)
+                              ? limiter->ceiling : limiter->limit));
+}
+
+/**********************************************************************/
+void setLimiterCeiling(Limiter *limiter, uint32_t ceiling)
+{
+  spin_lock(&limiter->lock);
+  limiter->ceiling = ceiling;
+  limiter->floor   = maxUInt(1, ceiling / 16);
+  uint32_t limit   = limiter->limit;
+  if ((limiter->targetLatency == 0) || (limit > ceiling)) {
+    limit = ceiling;
+  }
+  setLimitAndUnlock(limiter, maxUInt(limit, limiter->floor));
+}
+
+/**********************************************************************/
+uint64_t getLimiterLatencyTarget(Limiter *limiter)
+{
+  spin_lock(&limiter->lock);
+  uint64_t targetLatency = limiter->targetLatency;
+  spin_unlock(&limiter->lock);
+  return targetLatency;
+}
+
+/**********************************************************************/
+void limiterReportLatency(Limiter *limiter, uint64_t latency)
+{
+  uint64_t now = currentTime(CLOCK_MONOTONIC);
+  spin_lock(&limiter->lock);
+  if (limiter->targetLatency == 0) {
+    spin_unlock(&limiter->lock);
+    return;
+  }
+
+  limiter->intervalMinLatency = minUInt64(limiter->intervalMinLatency,
+                                          latency);
+  if ((now - limiter->intervalStart) < LATENCY_INTERVAL_NS) {
+    spin_unlock(&limiter->lock);
+    return;
+  }
+
+  uint32_t limit = limiter->limit;
+  if (limiter->intervalMinLatency > limiter->targetLatency) {
+    limit = maxUInt(limiter->floor, limit - (limit / 8));
+  } else if (limit < limiter->ceiling) {
+    limit += maxUInt(1, limit / 16);
+    if (limit > limiter->ceiling) {
+      limit = limiter->ceiling;
+    }
+  }
+
+  limiter->intervalStart      = now;
+  limiter->intervalMinLatency = UINT64_MAX;
+  setLimitAndUnlock(limiter, limit);
+}
+
 /**********************************************************************/
 bool limiterIsIdle(Limiter *limiter)
 {
@@ -28,6 +28,13 @@
  * A Limiter is a fancy counter used to limit resource usage.  We have a
  * limit to number of resources that we are willing to use, and a Limiter
  * holds us to that limit.
+ *
+ * A Limiter may also be given a latency target, in which case the limit
+ * becomes a window which moves between a floor and the initial limit (the
+ * ceiling). In the manner of CoDel, the smallest latency reported in each
+ * interval is compared with the target: if even the quickest resource was
+ * held too long, a standing queue has formed and the window shrinks by an
+ * eighth; otherwise it grows by a sixteenth.
  */
 
 typedef struct limiter {
@@ -41,6 +48,16 @@ typedef struct limiter {
   uint32_t          maximum;
   // The limit to the number of resources that are allowed to be used
   uint32_t          limit;
+  // The largest limit, the one the limiter was initialized with
+  uint32_t          ceiling;
+  // The smallest limit the window may shrink to
+  uint32_t          floor;
+  // The latency target in nanoseconds, or 0 if the limit is fixed
+  uint64_t          targetLatency;
+  // The time at which the current latency interval began
+  uint64_t          intervalStart;
+  // The smallest latency reported in the current interval
+  uint64_t          intervalMinLatency;
 } Limiter;
 
 /**
@@ -62,6 +79,44 @@ void getLimiterValuesAtomically(Limiter  *limiter,
  **/
 void initializeLimiter(Limiter *limiter, uint32_t limit);
 
+/**
+ * Set the latency target of a Limiter. Setting a target of zero returns the
+ * limit to its ceiling and stops adapting it.
+ *
+ * @param limiter        The limiter
+ * @param targetLatency  The latency target in nanoseconds
+ **/
+void setLimiterLatencyTarget(Limiter *limiter, uint64_t targetLatency);
+
+/**
+ * Change the ceiling of a Limiter. Unless the limiter has a latency target
+ * and its window is already below the new ceiling, its limit becomes the
+ * new ceiling.
+ *
+ * @param limiter  The limiter
+ * @param ceiling  The new ceiling
+ **/
+void setLimiterCeiling(Limiter *limiter, uint32_t ceiling);
+
+/**
+ * Get the latency target of a Limiter.
+ *
+ * @param limiter  The limiter
+ *
+ * @return The latency target in nanoseconds, or 0 if there is none
+ **/
+uint64_t getLimiterLatencyTarget(Limiter *limiter);
+
+/**
+ * Report how long resources were held, adapting the limit if the limiter
+ * has a latency target and the current interval has ended.
+ *
+ * @param limiter  The limiter
+ * @param latency  The smallest latency, in nanoseconds, of the resources
+ *                 being reported
+ **/
+void limiterReportLatency(Limiter *limiter, uint64_t latency);
+
 /**
  * Determine whether there are any active resources
  *
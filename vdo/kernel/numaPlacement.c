@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/numaPlacement.c#1 $
+ */
+
+#include "numaPlacement.h"
+
+#include <linux/nodemask.h>
+
+#include "logger.h"
+
+#include "constants.h"
+#include "statusCodes.h"
+
+static const char *PLACEMENT_NAMES[] = {
+  [NUMA_PLACEMENT_NONE]   = "none",
+  [NUMA_PLACEMENT_SPREAD] = "spread",
+};
+
+/**********************************************************************/
+int parseNumaPlacement(const char *name, NumaPlacement *placementPtr)
+{
+  for (unsigned int i = 0; i < COUNT_OF(PLACEMENT_NAMES); i++) {
+    if (strcmp(name, PLACEMENT_NAMES[i]) == 0) {
+      *placementPtr = i;
+      return VDO_SUCCESS;
+    }
+  }
+
+  logError("unknown NUMA placement \"%s\"", name);
+  return -EINVAL;
+}
+
+/**********************************************************************/
+const char *getNumaPlacementName(NumaPlacement placement)
+{
+  return ((placement < COUNT_OF(PLACEMENT_NAMES))
+          ? PLACEMENT_NAMES[placement] : "unknown");
+}
+
+/**********************************************************************/
+int getNodeForZone(ZoneCount zone)
+{
+  unsigned int index = zone % num_online_nodes();
+  int          node;
+  for_each_online_node(node) {
+    if (index-- == 0) {
+      return node;
+    }
+  }
+  return first_online_node;
+}
+
+/**
+ * Assign the threads of one type of zone to nodes round-robin.
+ *
+ * @param threadConfig  The thread configuration to update
+ * @param threadIDs     The threads of the zones
+ * @param zoneCount     The number of zones
+ **/
+static void spreadZones(ThreadConfig   *threadConfig,
+                        const ThreadID  threadIDs[],
+                        ZoneCount       zoneCount)
+{
+  for (ZoneCount zone = 0; zone < zoneCount; zone++) {
+    setThreadNode(threadConfig, threadIDs[zone], getNodeForZone(zone));
+  }
+}
+
+/**********************************************************************/
+void placeZoneThreads(ThreadConfig *threadConfig, NumaPlacement placement)
+{
+  // A single-threaded configuration runs everything on one thread, so
+  // there is nothing to separate.
+  if ((placement == NUMA_PLACEMENT_NONE)
+      || (threadConfig->baseThreadCount <= 1)) {
+    return;
+  }
+
+  spreadZones(threadConfig, threadConfig->logicalThreads,
+              threadConfig->logicalZoneCount);
+  spreadZones(threadConfig, threadConfig->physicalThreads,
+              threadConfig->physicalZoneCount);
+  spreadZones(threadConfig, threadConfig->hashZoneThreads,
+              threadConfig->hashZoneCount);
+  spreadZones(threadConfig, threadConfig->packerThreads,
+              threadConfig->packerZoneCount);
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/numaPlacement.h#1 $
+ */
+
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+#include "threadConfig.h"
+
+/**
+ * The policies for placing zone threads, and the memory they own, on NUMA
+ * nodes.
+ **/
+typedef enum {
+  /** Let the scheduler and allocator place everything */
+  NUMA_PLACEMENT_NONE = 0,
+  /** Spread the zones of each type round-robin across the online nodes */
+  NUMA_PLACEMENT_SPREAD,
+} NumaPlacement;
+
+/**
+ * Look up a NUMA placement policy by its table name.
+ *
+ * @param [in]  name          The name of the policy
+ * @param [out] placementPtr  A pointer to hold the policy
+ *
+ * @return VDO_SUCCESS or -EINVAL if the name is unknown
+ **/
+int parseNumaPlacement(const char *name, NumaPlacement *placementPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the table name of a NUMA placement policy.
+ *
+ * @param placement  The policy
+ *
+ * @return The name of the policy
+ **/
+const char *getNumaPlacementName(NumaPlacement placement)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the online node which should hold a given zone, spreading successive
+ * zones (or threads) round-robin over the online nodes.
+ *
+ * @param zone  The zone number
+ *
+ * @return The node for the zone
+ **/
+int getNodeForZone(ZoneCount zone)
+  __attribute__((warn_unused_result));
+
+/**
+ * Assign the logical, physical, hash, and packer zone threads of a thread
+ * configuration to NUMA nodes according to a placement policy. The admin
+ * and journal thread is left unplaced.
+ *
+ * @param threadConfig  The thread configuration to update
+ * @param placement     The placement policy
+ **/
+void placeZoneThreads(ThreadConfig *threadConfig, NumaPlacement placement);
+
+#endif // NUMA_PLACEMENT_H
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/physicalBlockCache.c#1 $
+ */
+
+#include "physicalBlockCache.h"
+
+#include <linux/spinlock.h>
+
+#include "memoryAlloc.h"
+#include "numeric.h"
+#include "permassert.h"
+
+#include "constants.h"
+#include "statusCodes.h"
+
+typedef struct {
+  /** Protects the fields of the entry */
+  spinlock_t          lock;
+  /** The block held, or ZERO_BLOCK if the entry is empty */
+  PhysicalBlockNumber pbn;
+  /** Advanced whenever a write covers the entry's slot */
+  uint64_t            generation;
+  /** The last uncompressed block read past the entry without being cached */
+  PhysicalBlockNumber candidate;
+  /** Whether the block held was cached because it was read repeatedly */
+  bool                repeated;
+  /** The contents of the block */
+  char                data[VDO_BLOCK_SIZE];
+} CacheEntry;
+
+struct physicalBlockCache {
+  /** The number of entries, a power of two */
+  BlockCount  entryCount;
+  CacheEntry *entries;
+};
+
+/**********************************************************************/
+int makePhysicalBlockCache(BlockCount           blocks,
+                           PhysicalBlockCache **cachePtr)
+{
+  int result = ASSERT(((blocks > 0) && ((blocks & (blocks - 1)) == 0)),
+                      "physical block cache size %llu is a power of two",
+                      blocks);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  PhysicalBlockCache *cache;
+  result = ALLOCATE(1, PhysicalBlockCache, __func__, &cache);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  result = ALLOCATE(blocks, CacheEntry, "physical block cache",
+                    &cache->entries);
+  if (result != VDO_SUCCESS) {
+    FREE(cache);
+    return result;
+  }
+
+  cache->entryCount = blocks;
+  for (BlockCount i = 0; i < blocks; i++) {
+    spin_lock_init(&cache->entries[i].lock);
+    cache->entries[i].pbn       = ZERO_BLOCK;
+    cache->entries[i].candidate = ZERO_BLOCK;
+  }
+
+  *cachePtr = cache;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void freePhysicalBlockCache(PhysicalBlockCache **cachePtr)
+{
+  PhysicalBlockCache *cache = *cachePtr;
+  if (cache == NULL) {
+    return;
+  }
+
+  FREE(cache->entries);
+  FREE(cache);
+  *cachePtr = NULL;
+}
+
+/**
+ * Get the entry which may hold a block. Neighboring blocks get neighboring
+ * entries, so a write of a run of blocks touches each entry at most once.
+ *
+ * @param cache  The cache
+ * @param pbn    The block
+ *
+ * @return The entry for the block
+ **/
+static inline CacheEntry *getCacheEntry(PhysicalBlockCache  *cache,
+                                        PhysicalBlockNumber  pbn)
+{
+  return &cache->entries[pbn & (cache->entryCount - 1)];
+}
+
+/**********************************************************************/
+bool isBlockCached(PhysicalBlockCache  *cache,
+                   PhysicalBlockNumber  pbn,
+                   uint64_t            *stampPtr)
+{
+  CacheEntry *entry = getCacheEntry(cache, pbn);
+  spin_lock(&entry->lock);
+  bool cached = (entry->pbn == pbn);
+  if (!cached) {
+    *stampPtr = entry->generation;
+  }
+  spin_unlock(&entry->lock);
+  return cached;
+}
+
+/**********************************************************************/
+bool readCachedBlock(PhysicalBlockCache  *cache,
+                     PhysicalBlockNumber  pbn,
+                     char                *buffer,
+                     uint64_t            *stampPtr,
+                     bool                *repeatedPtr)
+{
+  CacheEntry *entry = getCacheEntry(cache, pbn);
+  spin_lock(&entry->lock);
+  bool hit = (entry->pbn == pbn);
+  if (hit) {
+    memcpy(buffer, entry->data, VDO_BLOCK_SIZE);
+    *repeatedPtr = entry->repeated;
+  } else {
+    *stampPtr = entry->generation;
+  }
+  spin_unlock(&entry->lock);
+  return hit;
+}
+
+/**********************************************************************/
+bool admitRepeatedRead(PhysicalBlockCache *cache, PhysicalBlockNumber pbn)
+{
+  CacheEntry *entry = getCacheEntry(cache, pbn);
+  spin_lock(&entry->lock);
+  bool admit = (entry->candidate == pbn);
+  entry->candidate = pbn;
+  spin_unlock(&entry->lock);
+  return admit;
+}
+
+/**********************************************************************/
+void cacheBlock(PhysicalBlockCache  *cache,
+                PhysicalBlockNumber  pbn,
+                uint64_t             stamp,
+                const char          *data,
+                bool                 repeated)
+{
+  CacheEntry *entry = getCacheEntry(cache, pbn);
+  spin_lock(&entry->lock);
+  if (entry->generation == stamp) {
+    entry->pbn      = pbn;
+    entry->repeated = repeated;
+    memcpy(entry->data, data, VDO_BLOCK_SIZE);
+  }
+  spin_unlock(&entry->lock);
+}
+
+/**********************************************************************/
+void invalidateCachedBlocks(PhysicalBlockCache  *cache,
+                            PhysicalBlockNumber  pbn,
+                            BlockCount           count)
+{
+  count = minUInt64(count, cache->entryCount);
+  for (BlockCount i = 0; i < count; i++) {
+    CacheEntry *entry = getCacheEntry(cache, pbn + i);
+    spin_lock(&entry->lock);
+    entry->generation++;
+    entry->pbn = ZERO_BLOCK;
+    spin_unlock(&entry->lock);
+  }
+}
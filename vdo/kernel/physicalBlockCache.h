@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/physicalBlockCache.h#1 $
+ */
+
+#ifndef PHYSICAL_BLOCK_CACHE_H
+#define PHYSICAL_BLOCK_CACHE_H
+
+#include "types.h"
+
+/**
+ * A small cache of physical blocks, shared by all the threads of a pool. It
+ * holds recently read compressed blocks, so that reading the several
+ * fragments of one compressed block only reads it from storage once, and
+ * blocks read ahead of sequential reads. Every write to the storage
+ * invalidates the blocks it covers, and a read which overlaps such a write
+ * is not cached, so the cache never holds stale data.
+ *
+ * Uncompressed blocks are also cached once they are read a second time
+ * while still remembered by their cache entry. Blocks shared by many
+ * logical blocks, such as those of cloned images, are read over and over
+ * through different logical addresses which the page cache above can not
+ * share, so they are the ones which qualify.
+ **/
+typedef struct physicalBlockCache PhysicalBlockCache;
+
+enum {
+  /** The default number of blocks the cache holds */
+  DEFAULT_PHYSICAL_BLOCK_CACHE_BLOCKS = 512,
+  /** The largest number of blocks the cache may be configured to hold */
+  MAX_PHYSICAL_BLOCK_CACHE_BLOCKS     = 1 << 20,
+};
+
+/**
+ * Make a physical block cache.
+ *
+ * @param [in]  blocks    The number of blocks the cache holds, a power of two
+ * @param [out] cachePtr  A pointer to hold the new cache
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+int makePhysicalBlockCache(BlockCount           blocks,
+                           PhysicalBlockCache **cachePtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free a physical block cache and null out the reference to it.
+ *
+ * @param cachePtr  The reference to the cache to free
+ **/
+void freePhysicalBlockCache(PhysicalBlockCache **cachePtr);
+
+/**
+ * Check whether a block is in the cache.
+ *
+ * @param [in]  cache     The cache
+ * @param [in]  pbn       The block to look up
+ * @param [out] stampPtr  A pointer to hold the stamp to pass to cacheBlock()
+ *                        if the block is not cached
+ *
+ * @return <code>true</code> if the block is cached
+ **/
+bool isBlockCached(PhysicalBlockCache  *cache,
+                   PhysicalBlockNumber  pbn,
+                   uint64_t            *stampPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Look up a block in the cache.
+ *
+ * @param [in]  cache        The cache
+ * @param [in]  pbn          The block to look up
+ * @param [out] buffer       The VDO_BLOCK_SIZE buffer to hold the cached
+ *                           block
+ * @param [out] stampPtr     A pointer to hold the stamp to pass to
+ *                           cacheBlock() if the lookup misses
+ * @param [out] repeatedPtr  A pointer to hold whether a hit was on a block
+ *                           cached because it was read repeatedly
+ *
+ * @return <code>true</code> if the block was found and copied to buffer
+ **/
+bool readCachedBlock(PhysicalBlockCache  *cache,
+                     PhysicalBlockNumber  pbn,
+                     char                *buffer,
+                     uint64_t            *stampPtr,
+                     bool                *repeatedPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Note a read of an uncompressed block which is not cached, and decide
+ * whether the block should be cached once it has been read. A block is
+ * admitted if it was the last block read past its entry.
+ *
+ * @param cache  The cache
+ * @param pbn    The block being read
+ *
+ * @return <code>true</code> if the block should be cached
+ **/
+bool admitRepeatedRead(PhysicalBlockCache *cache, PhysicalBlockNumber pbn)
+  __attribute__((warn_unused_result));
+
+/**
+ * Add a block which has been read from storage to the cache, unless a write
+ * to its entry was submitted since the lookup which missed.
+ *
+ * @param cache     The cache
+ * @param pbn       The block which was read
+ * @param stamp     The stamp from the lookup
+ * @param data      The contents of the block
+ * @param repeated  Whether the block is cached because it was read
+ *                  repeatedly
+ **/
+void cacheBlock(PhysicalBlockCache  *cache,
+                PhysicalBlockNumber  pbn,
+                uint64_t             stamp,
+                const char          *data,
+                bool                 repeated);
+
+/**
+ * Invalidate any cached copies of blocks which are about to be written.
+ *
+ * @param cache  The cache
+ * @param pbn    The first block being written
+ * @param count  The number of blocks being written
+ **/
+void invalidateCachedBlocks(PhysicalBlockCache  *cache,
+                            PhysicalBlockNumber  pbn,
+                            BlockCount           count);
+
+#endif // PHYSICAL_BLOCK_CACHE_H
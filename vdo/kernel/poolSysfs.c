@@ -23,9 +23,12 @@
 
 #include "memoryAlloc.h"
 
+#include "recoveryJournal.h"
+#include "slabScrubber.h"
 #include "vdo.h"
 
 #include "dedupeIndex.h"
+#include "ioSubmitter.h"
 
 typedef struct poolAttribute {
   struct attribute attr;
@@ -65,12 +68,109 @@ static struct sysfs_ops vdoPoolSysfsOps = {
   .store = vdoPoolAttrStore,
 };
 
+/**********************************************************************/
+static ssize_t poolBackgroundBudgetShow(KernelLayer *layer, char *buf)
+{
+  BackgroundBudget *budget = &layer->backgroundBudget;
+  return sprintf(buf, "%" PRIu32 "\n",
+                 (isBackgroundBudgetManaged(budget)
+                  ? READ_ONCE(budget->grantedRate) : 0));
+}
+
+/**********************************************************************/
+static ssize_t poolBackgroundBusyIOPSShow(KernelLayer *layer, char *buf)
+{
+  return sprintf(buf, "%" PRIu32 "\n",
+                 READ_ONCE(layer->backgroundBudget.busyIOPS));
+}
+
+/**********************************************************************/
+static ssize_t poolBackgroundBusyIOPSStore(KernelLayer *layer,
+                                           const char  *buf,
+                                           size_t       length)
+{
+  unsigned int value;
+  if ((length > 12) || (sscanf(buf, "%u", &value) != 1)) {
+    return -EINVAL;
+  }
+  WRITE_ONCE(layer->backgroundBudget.busyIOPS, value);
+  return length;
+}
+
+/**********************************************************************/
+static ssize_t poolBackgroundIdleRateShow(KernelLayer *layer, char *buf)
+{
+  return sprintf(buf, "%" PRIu32 "\n",
+                 READ_ONCE(layer->backgroundBudget.idleRate));
+}
+
+/**********************************************************************/
+static ssize_t poolBackgroundIdleRateStore(KernelLayer *layer,
+                                           const char  *buf,
+                                           size_t       length)
+{
+  unsigned int value;
+  if ((length > 12) || (sscanf(buf, "%u", &value) != 1)) {
+    return -EINVAL;
+  }
+
+  // Scrubbing starts out with the whole idle rate, or without a limit once
+  // the budget is no longer managed.
+  setBackgroundIdleRate(&layer->backgroundBudget, value);
+  if (setKVDOScrubRateLimit(&layer->kvdo, value) != VDO_SUCCESS) {
+    setBackgroundIdleRate(&layer->backgroundBudget, 0);
+    return -EBUSY;
+  }
+  return length;
+}
+
+/**********************************************************************/
+static ssize_t poolBackgroundLoadShow(KernelLayer *layer, char *buf)
+{
+  return sprintf(buf, "%" PRIu32 "\n",
+                 READ_ONCE(layer->backgroundBudget.loadPercent));
+}
+
+/**********************************************************************/
+static ssize_t poolBioQueueDepthsShow(KernelLayer *layer, char *buf)
+{
+  return formatBioQueueDepths(layer->ioSubmitter, buf, PAGE_SIZE);
+}
+
+/**********************************************************************/
+static ssize_t poolBioPollingShow(KernelLayer *layer, char *buf)
+{
+  return formatBioPollingStats(layer->ioSubmitter, buf);
+}
+
 /**********************************************************************/
 static ssize_t poolCompressingShow(KernelLayer *layer, char *buf)
 {
   return sprintf(buf, "%s\n", (getKVDOCompressing(&layer->kvdo) ? "1" : "0"));
 }
 
+/**********************************************************************/
+static ssize_t poolDiscardPassdownDelayShow(KernelLayer *layer, char *buf)
+{
+  return sprintf(buf, "%" PRIu32 "\n", getKVDODiscardDelay(&layer->kvdo));
+}
+
+/**********************************************************************/
+static ssize_t poolDiscardPassdownDelayStore(KernelLayer *layer,
+                                             const char  *buf,
+                                             size_t       length)
+{
+  unsigned int value;
+  if ((length > 12) || (sscanf(buf, "%u", &value) != 1)) {
+    return -EINVAL;
+  }
+
+  if (setKVDODiscardDelay(&layer->kvdo, value) != VDO_SUCCESS) {
+    return -EBUSY;
+  }
+  return length;
+}
+
 /**********************************************************************/
 static ssize_t poolDiscardsActiveShow(KernelLayer *layer, char *buf)
 {
@@ -96,18 +196,123 @@ static ssize_t poolDiscardsLimitStore(KernelLayer *layer,
   return length;
 }
 
+/**********************************************************************/
+static ssize_t poolDiscardsIdleShow(KernelLayer *layer, char *buf)
+{
+  return sprintf(buf, "%s\n", (layer->discardsIdle ? "1" : "0"));
+}
+
+/**********************************************************************/
+static ssize_t poolDiscardsIdleStore(KernelLayer *layer,
+                                     const char  *buf,
+                                     size_t       length)
+{
+  unsigned int value;
+  if ((length > 12) || (sscanf(buf, "%u", &value) != 1) || (value > 1)) {
+    return -EINVAL;
+  }
+  layer->discardsIdle = (value == 1);
+  return length;
+}
+
 /**********************************************************************/
 static ssize_t poolDiscardsMaximumShow(KernelLayer *layer, char *buf)
 {
   return sprintf(buf, "%" PRIu32 "\n", layer->discardLimiter.maximum);
 }
 
+/**********************************************************************/
+static ssize_t poolForegroundIOPSShow(KernelLayer *layer, char *buf)
+{
+  return sprintf(buf, "%" PRIu32 "\n",
+                 READ_ONCE(layer->backgroundBudget.foregroundIOPS));
+}
+
 /**********************************************************************/
 static ssize_t poolInstanceShow(KernelLayer *layer, char *buf)
 {
   return sprintf(buf, "%u\n", layer->instance);
 }
 
+/**********************************************************************/
+static ssize_t poolPackerPolicyShow(KernelLayer *layer, char *buf)
+{
+  return sprintf(buf, "%s\n",
+                 ((getKVDOPackerPolicy(&layer->kvdo) == PACKER_POLICY_ADAPTIVE)
+                  ? "adaptive" : "fill"));
+}
+
+/**********************************************************************/
+static ssize_t poolPackerPolicyStore(KernelLayer *layer,
+                                     const char  *buf,
+                                     size_t       length)
+{
+  PackerPolicy policy;
+  if (sysfs_streq(buf, "adaptive")) {
+    policy = PACKER_POLICY_ADAPTIVE;
+  } else if (sysfs_streq(buf, "fill")) {
+    policy = PACKER_POLICY_FILL;
+  } else {
+    return -EINVAL;
+  }
+  setKVDOPackerPolicy(&layer->kvdo, policy);
+  return length;
+}
+
+/**
+ * Format a histogram as a line of bucket counts.
+ *
+ * @param buckets  The bucket counts
+ * @param count    The number of buckets
+ * @param buf      The buffer to format into
+ *
+ * @return The number of bytes formatted
+ **/
+static ssize_t showHistogram(const uint64_t *buckets,
+                             unsigned int    count,
+                             char           *buf)
+{
+  ssize_t length = 0;
+  for (unsigned int i = 0; i < count; i++) {
+    length += sprintf(buf + length, "%s%" PRIu64, ((i == 0) ? "" : " "),
+                      buckets[i]);
+  }
+  length += sprintf(buf + length, "\n");
+  return length;
+}
+
+/**********************************************************************/
+static ssize_t poolPackerPackedSpaceShow(KernelLayer *layer, char *buf)
+{
+  PackerHistograms histograms;
+  getKVDOPackerHistograms(&layer->kvdo, &histograms);
+  return showHistogram(histograms.packedSpace, PACKER_HISTOGRAM_BUCKETS, buf);
+}
+
+/**********************************************************************/
+static ssize_t poolPackerWaitTimeShow(KernelLayer *layer, char *buf)
+{
+  PackerHistograms histograms;
+  getKVDOPackerHistograms(&layer->kvdo, &histograms);
+  return showHistogram(histograms.waitTime, PACKER_HISTOGRAM_BUCKETS, buf);
+}
+
+/**********************************************************************/
+static ssize_t poolPackerSlotsUsedShow(KernelLayer *layer, char *buf)
+{
+  PackerHistograms histograms;
+  getKVDOPackerHistograms(&layer->kvdo, &histograms);
+  return showHistogram(histograms.slotsUsed, PACKER_HISTOGRAM_BUCKETS, buf);
+}
+
+/**********************************************************************/
+static ssize_t poolJournalCommitSizeShow(KernelLayer *layer, char *buf)
+{
+  uint64_t histogram[RECOVERY_JOURNAL_HISTOGRAM_BUCKETS];
+  getKVDOJournalCommitHistogram(&layer->kvdo, histogram);
+  return showHistogram(histogram, RECOVERY_JOURNAL_HISTOGRAM_BUCKETS, buf);
+}
+
 /**********************************************************************/
 static ssize_t poolRequestsActiveShow(KernelLayer *layer, char *buf)
 {
@@ -120,12 +325,170 @@ static ssize_t poolRequestsLimitShow(KernelLayer *layer, char *buf)
   return sprintf(buf, "%" PRIu32 "\n", layer->requestLimiter.limit);
 }
 
+/**********************************************************************/
+static ssize_t showIntakeActive(KernelLayer *layer,
+                                IntakeClass  class,
+                                char        *buf)
+{
+  return sprintf(buf, "%" PRIu32 "\n", layer->intakeLimiters[class].active);
+}
+
+/**********************************************************************/
+static ssize_t showIntakeLimit(KernelLayer *layer,
+                               IntakeClass  class,
+                               char        *buf)
+{
+  return sprintf(buf, "%" PRIu32 "\n", layer->intakeLimiters[class].limit);
+}
+
+/**********************************************************************/
+static ssize_t storeIntakeLimit(KernelLayer *layer,
+                                IntakeClass  class,
+                                const char  *buf,
+                                size_t       length)
+{
+  unsigned int value;
+  if ((length > 12) || (sscanf(buf, "%u", &value) != 1) || (value < 1)
+      || (value > layer->requestLimiter.ceiling)) {
+    return -EINVAL;
+  }
+  setLimiterCeiling(&layer->intakeLimiters[class], value);
+  return length;
+}
+
+/**********************************************************************/
+static ssize_t poolRequestsRealtimeActiveShow(KernelLayer *layer, char *buf)
+{
+  return showIntakeActive(layer, INTAKE_CLASS_REALTIME, buf);
+}
+
+/**********************************************************************/
+static ssize_t poolRequestsRealtimeLimitShow(KernelLayer *layer, char *buf)
+{
+  return showIntakeLimit(layer, INTAKE_CLASS_REALTIME, buf);
+}
+
+/**********************************************************************/
+static ssize_t poolRequestsRealtimeLimitStore(KernelLayer *layer,
+                                              const char  *buf,
+                                              size_t       length)
+{
+  return storeIntakeLimit(layer, INTAKE_CLASS_REALTIME, buf, length);
+}
+
+/**********************************************************************/
+static ssize_t poolRequestsBestEffortActiveShow(KernelLayer *layer, char *buf)
+{
+  return showIntakeActive(layer, INTAKE_CLASS_BEST_EFFORT, buf);
+}
+
+/**********************************************************************/
+static ssize_t poolRequestsBestEffortLimitShow(KernelLayer *layer, char *buf)
+{
+  return showIntakeLimit(layer, INTAKE_CLASS_BEST_EFFORT, buf);
+}
+
+/**********************************************************************/
+static ssize_t poolRequestsBestEffortLimitStore(KernelLayer *layer,
+                                                const char  *buf,
+                                                size_t       length)
+{
+  return storeIntakeLimit(layer, INTAKE_CLASS_BEST_EFFORT, buf, length);
+}
+
+/**********************************************************************/
+static ssize_t poolRequestsIdleActiveShow(KernelLayer *layer, char *buf)
+{
+  return showIntakeActive(layer, INTAKE_CLASS_IDLE, buf);
+}
+
+/**********************************************************************/
+static ssize_t poolRequestsIdleLimitShow(KernelLayer *layer, char *buf)
+{
+  return showIntakeLimit(layer, INTAKE_CLASS_IDLE, buf);
+}
+
+/**********************************************************************/
+static ssize_t poolRequestsIdleLimitStore(KernelLayer *layer,
+                                          const char  *buf,
+                                          size_t       length)
+{
+  return storeIntakeLimit(layer, INTAKE_CLASS_IDLE, buf, length);
+}
+
+/**********************************************************************/
+static ssize_t poolRequestsLatencyTargetShow(KernelLayer *layer, char *buf)
+{
+  uint64_t target = getLimiterLatencyTarget(&layer->requestLimiter);
+  return sprintf(buf, "%" PRIu64 "\n", target / 1000);
+}
+
+/**********************************************************************/
+static ssize_t poolRequestsLatencyTargetStore(KernelLayer *layer,
+                                              const char  *buf,
+                                              size_t       length)
+{
+  unsigned int value;
+  if ((length > 12) || (sscanf(buf, "%u", &value) != 1)) {
+    return -EINVAL;
+  }
+  setLimiterLatencyTarget(&layer->requestLimiter, (uint64_t) value * 1000);
+  return length;
+}
+
 /**********************************************************************/
 static ssize_t poolRequestsMaximumShow(KernelLayer *layer, char *buf)
 {
   return sprintf(buf, "%" PRIu32 "\n", layer->requestLimiter.maximum);
 }
 
+/**********************************************************************/
+static ssize_t poolScrubConcurrencyShow(KernelLayer *layer, char *buf)
+{
+  return sprintf(buf, "%u\n", getKVDOScrubConcurrency(&layer->kvdo));
+}
+
+/**********************************************************************/
+static ssize_t poolScrubConcurrencyStore(KernelLayer *layer,
+                                         const char  *buf,
+                                         size_t       length)
+{
+  unsigned int value;
+  if ((length > 12) || (sscanf(buf, "%u", &value) != 1) || (value < 1)
+      || (value > MAX_SCRUB_CONCURRENCY)) {
+    return -EINVAL;
+  }
+
+  if (setKVDOScrubConcurrency(&layer->kvdo, value) != VDO_SUCCESS) {
+    return -EBUSY;
+  }
+  return length;
+}
+
+/**********************************************************************/
+static ssize_t poolScrubRateLimitShow(KernelLayer *layer, char *buf)
+{
+  return sprintf(buf, "%" PRIu32 "\n", getKVDOScrubRateLimit(&layer->kvdo));
+}
+
+/**********************************************************************/
+static ssize_t poolScrubRateLimitStore(KernelLayer *layer,
+                                       const char  *buf,
+                                       size_t       length)
+{
+  unsigned int value;
+  if ((length > 12) || (sscanf(buf, "%u", &value) != 1)) {
+    return -EINVAL;
+  }
+
+  // A managed background budget sets the rate limit itself.
+  if (isBackgroundBudgetManaged(&layer->backgroundBudget)
+      || (setKVDOScrubRateLimit(&layer->kvdo, value) != VDO_SUCCESS)) {
+    return -EBUSY;
+  }
+  return length;
+}
+
 /**********************************************************************/
 static void vdoPoolRelease(struct kobject *kobj)
 {
@@ -134,16 +497,60 @@ static void vdoPoolRelease(struct kobject *kobj)
   FREE(layer);
 }
 
+static PoolAttribute vdoPoolBackgroundBudgetAttr = {
+  .attr  = { .name = "background_budget", .mode = 0444, },
+  .show  = poolBackgroundBudgetShow,
+};
+
+static PoolAttribute vdoPoolBackgroundBusyIOPSAttr = {
+  .attr  = { .name = "background_busy_iops", .mode = 0644, },
+  .show  = poolBackgroundBusyIOPSShow,
+  .store = poolBackgroundBusyIOPSStore,
+};
+
+static PoolAttribute vdoPoolBackgroundIdleRateAttr = {
+  .attr  = { .name = "background_idle_rate", .mode = 0644, },
+  .show  = poolBackgroundIdleRateShow,
+  .store = poolBackgroundIdleRateStore,
+};
+
+static PoolAttribute vdoPoolBackgroundLoadAttr = {
+  .attr  = { .name = "background_load", .mode = 0444, },
+  .show  = poolBackgroundLoadShow,
+};
+
+static PoolAttribute vdoPoolBioPollingAttr = {
+  .attr  = { .name = "bio_polling", .mode = 0444, },
+  .show  = poolBioPollingShow,
+};
+
+static PoolAttribute vdoPoolBioQueueDepthsAttr = {
+  .attr  = { .name = "bio_queue_depths", .mode = 0444, },
+  .show  = poolBioQueueDepthsShow,
+};
+
 static PoolAttribute vdoPoolCompressingAttr = {
   .attr  = { .name = "compressing", .mode = 0444, },
   .show  = poolCompressingShow,
 };
 
+static PoolAttribute vdoPoolDiscardPassdownDelayAttr = {
+  .attr  = { .name = "discard_passdown_delay", .mode = 0644, },
+  .show  = poolDiscardPassdownDelayShow,
+  .store = poolDiscardPassdownDelayStore,
+};
+
 static PoolAttribute vdoPoolDiscardsActiveAttr = {
   .attr  = { .name = "discards_active", .mode = 0444, },
   .show  = poolDiscardsActiveShow,
 };
 
+static PoolAttribute vdoPoolDiscardsIdleAttr = {
+  .attr  = { .name = "discards_idle", .mode = 0644, },
+  .show  = poolDiscardsIdleShow,
+  .store = poolDiscardsIdleStore,
+};
+
 static PoolAttribute vdoPoolDiscardsLimitAttr = {
   .attr  = { .name = "discards_limit", .mode = 0644, },
   .show  = poolDiscardsLimitShow,
@@ -155,16 +562,86 @@ static PoolAttribute vdoPoolDiscardsMaximumAttr = {
   .show  = poolDiscardsMaximumShow,
 };
 
+static PoolAttribute vdoPoolForegroundIOPSAttr = {
+  .attr  = { .name = "foreground_iops", .mode = 0444, },
+  .show  = poolForegroundIOPSShow,
+};
+
 static PoolAttribute vdoPoolInstanceAttr = {
   .attr  = { .name = "instance", .mode = 0444, },
   .show  = poolInstanceShow,
 };
 
+static PoolAttribute vdoPoolJournalCommitSizeAttr = {
+  .attr  = { .name = "journal_commit_size_histogram", .mode = 0444, },
+  .show  = poolJournalCommitSizeShow,
+};
+
+static PoolAttribute vdoPoolPackerPolicyAttr = {
+  .attr  = { .name = "packer_policy", .mode = 0644, },
+  .show  = poolPackerPolicyShow,
+  .store = poolPackerPolicyStore,
+};
+
+static PoolAttribute vdoPoolPackerPackedSpaceAttr = {
+  .attr  = { .name = "packer_packed_space_histogram", .mode = 0444, },
+  .show  = poolPackerPackedSpaceShow,
+};
+
+static PoolAttribute vdoPoolPackerWaitTimeAttr = {
+  .attr  = { .name = "packer_wait_time_histogram", .mode = 0444, },
+  .show  = poolPackerWaitTimeShow,
+};
+
+static PoolAttribute vdoPoolPackerSlotsUsedAttr = {
+  .attr  = { .name = "packer_slots_used_histogram", .mode = 0444, },
+  .show  = poolPackerSlotsUsedShow,
+};
+
 static PoolAttribute vdoPoolRequestsActiveAttr = {
   .attr  = { .name = "requests_active", .mode = 0444, },
   .show  = poolRequestsActiveShow,
 };
 
+static PoolAttribute vdoPoolRequestsRealtimeActiveAttr = {
+  .attr  = { .name = "requests_realtime_active", .mode = 0444, },
+  .show  = poolRequestsRealtimeActiveShow,
+};
+
+static PoolAttribute vdoPoolRequestsRealtimeLimitAttr = {
+  .attr  = { .name = "requests_realtime_limit", .mode = 0644, },
+  .show  = poolRequestsRealtimeLimitShow,
+  .store = poolRequestsRealtimeLimitStore,
+};
+
+static PoolAttribute vdoPoolRequestsBestEffortActiveAttr = {
+  .attr  = { .name = "requests_best_effort_active", .mode = 0444, },
+  .show  = poolRequestsBestEffortActiveShow,
+};
+
+static PoolAttribute vdoPoolRequestsBestEffortLimitAttr = {
+  .attr  = { .name = "requests_best_effort_limit", .mode = 0644, },
+  .show  = poolRequestsBestEffortLimitShow,
+  .store = poolRequestsBestEffortLimitStore,
+};
+
+static PoolAttribute vdoPoolRequestsIdleActiveAttr = {
+  .attr  = { .name = "requests_idle_active", .mode = 0444, },
+  .show  = poolRequestsIdleActiveShow,
+};
+
+static PoolAttribute vdoPoolRequestsIdleLimitAttr = {
+  .attr  = { .name = "requests_idle_limit", .mode = 0644, },
+  .show  = poolRequestsIdleLimitShow,
+  .store = poolRequestsIdleLimitStore,
+};
+
+static PoolAttribute vdoPoolRequestsLatencyTargetAttr = {
+  .attr  = { .name = "requests_latency_target", .mode = 0644, },
+  .show  = poolRequestsLatencyTargetShow,
+  .store = poolRequestsLatencyTargetStore,
+};
+
 static PoolAttribute vdoPoolRequestsLimitAttr = {
   .attr  = { .name = "requests_limit", .mode = 0444, },
   .show  = poolRequestsLimitShow,
@@ -175,15 +652,50 @@ static PoolAttribute vdoPoolRequestsMaximumAttr = {
   .show  = poolRequestsMaximumShow,
 };
 
+static PoolAttribute vdoPoolScrubConcurrencyAttr = {
+  .attr  = { .name = "scrub_concurrency", .mode = 0644, },
+  .show  = poolScrubConcurrencyShow,
+  .store = poolScrubConcurrencyStore,
+};
+
+static PoolAttribute vdoPoolScrubRateLimitAttr = {
+  .attr  = { .name = "scrub_rate_limit", .mode = 0644, },
+  .show  = poolScrubRateLimitShow,
+  .store = poolScrubRateLimitStore,
+};
+
 static struct attribute *poolAttrs[] = {
+  &vdoPoolBackgroundBudgetAttr.attr,
+  &vdoPoolBackgroundBusyIOPSAttr.attr,
+  &vdoPoolBackgroundIdleRateAttr.attr,
+  &vdoPoolBackgroundLoadAttr.attr,
+  &vdoPoolBioPollingAttr.attr,
+  &vdoPoolBioQueueDepthsAttr.attr,
   &vdoPoolCompressingAttr.attr,
+  &vdoPoolDiscardPassdownDelayAttr.attr,
   &vdoPoolDiscardsActiveAttr.attr,
+  &vdoPoolDiscardsIdleAttr.attr,
   &vdoPoolDiscardsLimitAttr.attr,
   &vdoPoolDiscardsMaximumAttr.attr,
+  &vdoPoolForegroundIOPSAttr.attr,
   &vdoPoolInstanceAttr.attr,
+  &vdoPoolJournalCommitSizeAttr.attr,
+  &vdoPoolPackerPolicyAttr.attr,
+  &vdoPoolPackerPackedSpaceAttr.attr,
+  &vdoPoolPackerWaitTimeAttr.attr,
+  &vdoPoolPackerSlotsUsedAttr.attr,
   &vdoPoolRequestsActiveAttr.attr,
+  &vdoPoolRequestsRealtimeActiveAttr.attr,
+  &vdoPoolRequestsRealtimeLimitAttr.attr,
+  &vdoPoolRequestsBestEffortActiveAttr.attr,
+  &vdoPoolRequestsBestEffortLimitAttr.attr,
+  &vdoPoolRequestsIdleActiveAttr.attr,
+  &vdoPoolRequestsIdleLimitAttr.attr,
+  &vdoPoolRequestsLatencyTargetAttr.attr,
   &vdoPoolRequestsLimitAttr.attr,
   &vdoPoolRequestsMaximumAttr.attr,
+  &vdoPoolScrubConcurrencyAttr.attr,
+  &vdoPoolScrubRateLimitAttr.attr,
   NULL,
 };
 
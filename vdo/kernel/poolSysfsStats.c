@@ -55,7 +55,7 @@ static ssize_t poolStatsDataBlocksUsedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.dataBlocksUsed);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -72,7 +72,7 @@ static ssize_t poolStatsOverheadBlocksUsedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.overheadBlocksUsed);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -89,7 +89,7 @@ static ssize_t poolStatsLogicalBlocksUsedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.logicalBlocksUsed);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -100,13 +100,47 @@ static PoolStatsAttribute poolStatsLogicalBlocksUsedAttr = {
   .show  = poolStatsLogicalBlocksUsedShow,
 };
 
+/**********************************************************************/
+/** Number of queued writes acknowledged once a later write superseded them */
+static ssize_t poolStatsWritesAbsorbedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.writesAbsorbed);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsWritesAbsorbedAttr = {
+  .attr  = { .name = "writes_absorbed", .mode = 0444, },
+  .show  = poolStatsWritesAbsorbedShow,
+};
+
+/**********************************************************************/
+/** Number of writes to hot blocks not deduplicated or compressed */
+static ssize_t poolStatsHotWritesBypassedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.hotWritesBypassed);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsHotWritesBypassedAttr = {
+  .attr  = { .name = "hot_writes_bypassed", .mode = 0444, },
+  .show  = poolStatsHotWritesBypassedShow,
+};
+
 /**********************************************************************/
 /** number of physical blocks */
 static ssize_t poolStatsPhysicalBlocksShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.physicalBlocks);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -123,7 +157,7 @@ static ssize_t poolStatsLogicalBlocksShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.logicalBlocks);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -140,7 +174,7 @@ static ssize_t poolStatsBlockMapCacheSizeShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMapCacheSize);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -157,7 +191,7 @@ static ssize_t poolStatsWritePolicyShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%s\n", layer->vdoStatsStorage.writePolicy);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -174,7 +208,7 @@ static ssize_t poolStatsBlockSizeShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockSize);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -191,7 +225,7 @@ static ssize_t poolStatsCompleteRecoveriesShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.completeRecoveries);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -208,7 +242,7 @@ static ssize_t poolStatsReadOnlyRecoveriesShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.readOnlyRecoveries);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -225,7 +259,7 @@ static ssize_t poolStatsModeShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%s\n", layer->vdoStatsStorage.mode);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -242,7 +276,7 @@ static ssize_t poolStatsInRecoveryModeShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%d\n", layer->vdoStatsStorage.inRecoveryMode);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -259,7 +293,7 @@ static ssize_t poolStatsRecoveryPercentageShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%u\n", layer->vdoStatsStorage.recoveryPercentage);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -276,7 +310,7 @@ static ssize_t poolStatsPackerCompressedFragmentsWrittenShow(KernelLayer *layer,
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.packer.compressedFragmentsWritten);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -293,7 +327,7 @@ static ssize_t poolStatsPackerCompressedBlocksWrittenShow(KernelLayer *layer, ch
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.packer.compressedBlocksWritten);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -310,7 +344,7 @@ static ssize_t poolStatsPackerCompressedFragmentsInPackerShow(KernelLayer *layer
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.packer.compressedFragmentsInPacker);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -327,7 +361,7 @@ static ssize_t poolStatsAllocatorSlabCountShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.slabCount);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -344,7 +378,7 @@ static ssize_t poolStatsAllocatorSlabsOpenedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.slabsOpened);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -361,7 +395,7 @@ static ssize_t poolStatsAllocatorSlabsReopenedShow(KernelLayer *layer, char *buf
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.slabsReopened);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -372,13 +406,183 @@ static PoolStatsAttribute poolStatsAllocatorSlabsReopenedAttr = {
   .show  = poolStatsAllocatorSlabsReopenedShow,
 };
 
+/**********************************************************************/
+/** The number of allocations which waited for a slab to be scrubbed */
+static ssize_t poolStatsAllocatorAllocationStallsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.allocationStalls);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsAllocatorAllocationStallsAttr = {
+  .attr  = { .name = "allocator_allocation_stalls", .mode = 0444, },
+  .show  = poolStatsAllocatorAllocationStallsShow,
+};
+
+/**********************************************************************/
+/** The total microseconds allocations waited for slabs to be scrubbed */
+static ssize_t poolStatsAllocatorStallMicrosecondsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.stallMicroseconds);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsAllocatorStallMicrosecondsAttr = {
+  .attr  = { .name = "allocator_stall_microseconds", .mode = 0444, },
+  .show  = poolStatsAllocatorStallMicrosecondsShow,
+};
+
+/**********************************************************************/
+/** The number of slabs scrubbed since loading */
+static ssize_t poolStatsAllocatorSlabsScrubbedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.slabsScrubbed);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsAllocatorSlabsScrubbedAttr = {
+  .attr  = { .name = "allocator_slabs_scrubbed", .mode = 0444, },
+  .show  = poolStatsAllocatorSlabsScrubbedShow,
+};
+
+/**********************************************************************/
+/** The number of slabs which are unrecovered or being scrubbed */
+static ssize_t poolStatsAllocatorSlabsToScrubShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.slabsToScrub);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsAllocatorSlabsToScrubAttr = {
+  .attr  = { .name = "allocator_slabs_to_scrub", .mode = 0444, },
+  .show  = poolStatsAllocatorSlabsToScrubShow,
+};
+
+/**********************************************************************/
+/** The estimated seconds until every zone has finished scrubbing */
+static ssize_t poolStatsAllocatorScrubSecondsRemainingShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.scrubSecondsRemaining);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsAllocatorScrubSecondsRemainingAttr = {
+  .attr  = { .name = "allocator_scrub_seconds_remaining", .mode = 0444, },
+  .show  = poolStatsAllocatorScrubSecondsRemainingShow,
+};
+
+/**********************************************************************/
+/** The number of slab metadata I/Os which waited for a VIO */
+static ssize_t poolStatsAllocatorVioPoolWaitsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.vioPoolWaits);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsAllocatorVioPoolWaitsAttr = {
+  .attr  = { .name = "allocator_vio_pool_waits", .mode = 0444, },
+  .show  = poolStatsAllocatorVioPoolWaitsShow,
+};
+
+/**********************************************************************/
+/** The total microseconds the slab metadata VIO pools had waiters */
+static ssize_t poolStatsAllocatorVioPoolWaitMicrosecondsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.vioPoolWaitMicroseconds);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsAllocatorVioPoolWaitMicrosecondsAttr = {
+  .attr  = { .name = "allocator_vio_pool_wait_microseconds", .mode = 0444, },
+  .show  = poolStatsAllocatorVioPoolWaitMicrosecondsShow,
+};
+
+/**********************************************************************/
+/** The number of VIOs in the slab metadata VIO pools */
+static ssize_t poolStatsAllocatorVioPoolSizeShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.vioPoolSize);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsAllocatorVioPoolSizeAttr = {
+  .attr  = { .name = "allocator_vio_pool_size", .mode = 0444, },
+  .show  = poolStatsAllocatorVioPoolSizeShow,
+};
+
+/**********************************************************************/
+/** The number of runs of freed blocks discarded on the storage */
+static ssize_t poolStatsAllocatorDiscardsPassedDownShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.discardsPassedDown);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsAllocatorDiscardsPassedDownAttr = {
+  .attr  = { .name = "allocator_discards_passed_down", .mode = 0444, },
+  .show  = poolStatsAllocatorDiscardsPassedDownShow,
+};
+
+/**********************************************************************/
+/** The number of freed blocks discarded on the storage */
+static ssize_t poolStatsAllocatorBlocksPassedDownShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.allocator.blocksPassedDown);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsAllocatorBlocksPassedDownAttr = {
+  .attr  = { .name = "allocator_blocks_passed_down", .mode = 0444, },
+  .show  = poolStatsAllocatorBlocksPassedDownShow,
+};
+
 /**********************************************************************/
 /** Number of times the on-disk journal was full */
 static ssize_t poolStatsJournalDiskFullShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.journal.diskFull);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -395,7 +599,7 @@ static ssize_t poolStatsJournalSlabJournalCommitsRequestedShow(KernelLayer *laye
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.journal.slabJournalCommitsRequested);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -412,7 +616,7 @@ static ssize_t poolStatsJournalEntriesStartedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.journal.entries.started);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -429,7 +633,7 @@ static ssize_t poolStatsJournalEntriesWrittenShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.journal.entries.written);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -446,7 +650,7 @@ static ssize_t poolStatsJournalEntriesCommittedShow(KernelLayer *layer, char *bu
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.journal.entries.committed);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -463,7 +667,7 @@ static ssize_t poolStatsJournalBlocksStartedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.journal.blocks.started);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -480,7 +684,7 @@ static ssize_t poolStatsJournalBlocksWrittenShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.journal.blocks.written);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -497,7 +701,7 @@ static ssize_t poolStatsJournalBlocksCommittedShow(KernelLayer *layer, char *buf
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.journal.blocks.committed);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -508,13 +712,30 @@ static PoolStatsAttribute poolStatsJournalBlocksCommittedAttr = {
   .show  = poolStatsJournalBlocksCommittedShow,
 };
 
+/**********************************************************************/
+/** Number of entries written which continue a run of the previous entry of the same operation in their block */
+static ssize_t poolStatsJournalEntriesInRunsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.journal.entriesInRuns);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsJournalEntriesInRunsAttr = {
+  .attr  = { .name = "journal_entries_in_runs", .mode = 0444, },
+  .show  = poolStatsJournalEntriesInRunsShow,
+};
+
 /**********************************************************************/
 /** Number of times the on-disk journal was full */
 static ssize_t poolStatsSlabJournalDiskFullCountShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.slabJournal.diskFullCount);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -531,7 +752,7 @@ static ssize_t poolStatsSlabJournalFlushCountShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.slabJournal.flushCount);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -548,7 +769,7 @@ static ssize_t poolStatsSlabJournalBlockedCountShow(KernelLayer *layer, char *bu
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.slabJournal.blockedCount);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -565,7 +786,7 @@ static ssize_t poolStatsSlabJournalBlocksWrittenShow(KernelLayer *layer, char *b
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.slabJournal.blocksWritten);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -582,7 +803,7 @@ static ssize_t poolStatsSlabJournalTailBusyCountShow(KernelLayer *layer, char *b
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.slabJournal.tailBusyCount);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -593,13 +814,30 @@ static PoolStatsAttribute poolStatsSlabJournalTailBusyCountAttr = {
   .show  = poolStatsSlabJournalTailBusyCountShow,
 };
 
+/**********************************************************************/
+/** Number of entries which continue a run of increments or decrements of consecutive blocks in their tail block */
+static ssize_t poolStatsSlabJournalEntriesInRunsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.slabJournal.entriesInRuns);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsSlabJournalEntriesInRunsAttr = {
+  .attr  = { .name = "slab_journal_entries_in_runs", .mode = 0444, },
+  .show  = poolStatsSlabJournalEntriesInRunsShow,
+};
+
 /**********************************************************************/
 /** Number of blocks written */
 static ssize_t poolStatsSlabSummaryBlocksWrittenShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.slabSummary.blocksWritten);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -610,13 +848,30 @@ static PoolStatsAttribute poolStatsSlabSummaryBlocksWrittenAttr = {
   .show  = poolStatsSlabSummaryBlocksWrittenShow,
 };
 
+/**********************************************************************/
+/** Number of batches of blocks written, each with a single flush */
+static ssize_t poolStatsSlabSummaryBatchesWrittenShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.slabSummary.batchesWritten);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsSlabSummaryBatchesWrittenAttr = {
+  .attr  = { .name = "slab_summary_batches_written", .mode = 0444, },
+  .show  = poolStatsSlabSummaryBatchesWrittenShow,
+};
+
 /**********************************************************************/
 /** Number of reference blocks written */
 static ssize_t poolStatsRefCountsBlocksWrittenShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.refCounts.blocksWritten);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -627,13 +882,81 @@ static PoolStatsAttribute poolStatsRefCountsBlocksWrittenAttr = {
   .show  = poolStatsRefCountsBlocksWrittenShow,
 };
 
+/**********************************************************************/
+/** Number of reference blocks which are dirty and not yet writing */
+static ssize_t poolStatsRefCountsDirtyBlocksShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.refCounts.dirtyBlocks);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsRefCountsDirtyBlocksAttr = {
+  .attr  = { .name = "ref_counts_dirty_blocks", .mode = 0444, },
+  .show  = poolStatsRefCountsDirtyBlocksShow,
+};
+
+/**********************************************************************/
+/** Number of times paced reference block writes were held back */
+static ssize_t poolStatsRefCountsWritesDeferredShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.refCounts.writesDeferred);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsRefCountsWritesDeferredAttr = {
+  .attr  = { .name = "ref_counts_writes_deferred", .mode = 0444, },
+  .show  = poolStatsRefCountsWritesDeferredShow,
+};
+
+/**********************************************************************/
+/** Average reference block write latency in microseconds */
+static ssize_t poolStatsRefCountsWriteLatencyShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.refCounts.writeLatency);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsRefCountsWriteLatencyAttr = {
+  .attr  = { .name = "ref_counts_write_latency", .mode = 0444, },
+  .show  = poolStatsRefCountsWriteLatencyShow,
+};
+
+/**********************************************************************/
+/** Paced reference block write rate in blocks per second */
+static ssize_t poolStatsRefCountsWriteRateShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.refCounts.writeRate);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsRefCountsWriteRateAttr = {
+  .attr  = { .name = "ref_counts_write_rate", .mode = 0444, },
+  .show  = poolStatsRefCountsWriteRateShow,
+};
+
 /**********************************************************************/
 /** number of dirty (resident) pages */
 static ssize_t poolStatsBlockMapDirtyPagesShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu32 "\n", layer->vdoStatsStorage.blockMap.dirtyPages);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -650,7 +973,7 @@ static ssize_t poolStatsBlockMapCleanPagesShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu32 "\n", layer->vdoStatsStorage.blockMap.cleanPages);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -667,7 +990,7 @@ static ssize_t poolStatsBlockMapFreePagesShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu32 "\n", layer->vdoStatsStorage.blockMap.freePages);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -684,7 +1007,7 @@ static ssize_t poolStatsBlockMapFailedPagesShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu32 "\n", layer->vdoStatsStorage.blockMap.failedPages);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -701,7 +1024,7 @@ static ssize_t poolStatsBlockMapIncomingPagesShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu32 "\n", layer->vdoStatsStorage.blockMap.incomingPages);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -718,7 +1041,7 @@ static ssize_t poolStatsBlockMapOutgoingPagesShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu32 "\n", layer->vdoStatsStorage.blockMap.outgoingPages);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -735,7 +1058,7 @@ static ssize_t poolStatsBlockMapCachePressureShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu32 "\n", layer->vdoStatsStorage.blockMap.cachePressure);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -752,7 +1075,7 @@ static ssize_t poolStatsBlockMapReadCountShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.readCount);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -769,7 +1092,7 @@ static ssize_t poolStatsBlockMapWriteCountShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.writeCount);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -786,7 +1109,7 @@ static ssize_t poolStatsBlockMapFailedReadsShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.failedReads);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -803,7 +1126,7 @@ static ssize_t poolStatsBlockMapFailedWritesShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.failedWrites);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -820,7 +1143,7 @@ static ssize_t poolStatsBlockMapReclaimedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.reclaimed);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -837,7 +1160,7 @@ static ssize_t poolStatsBlockMapReadOutgoingShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.readOutgoing);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -854,7 +1177,7 @@ static ssize_t poolStatsBlockMapFoundInCacheShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.foundInCache);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -871,7 +1194,7 @@ static ssize_t poolStatsBlockMapDiscardRequiredShow(KernelLayer *layer, char *bu
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.discardRequired);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -888,7 +1211,7 @@ static ssize_t poolStatsBlockMapWaitForPageShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.waitForPage);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -905,7 +1228,7 @@ static ssize_t poolStatsBlockMapFetchRequiredShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.fetchRequired);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -922,7 +1245,7 @@ static ssize_t poolStatsBlockMapPagesLoadedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.pagesLoaded);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -939,7 +1262,7 @@ static ssize_t poolStatsBlockMapPagesSavedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.pagesSaved);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -956,7 +1279,7 @@ static ssize_t poolStatsBlockMapFlushCountShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.flushCount);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -968,190 +1291,479 @@ static PoolStatsAttribute poolStatsBlockMapFlushCountAttr = {
 };
 
 /**********************************************************************/
-/** Number of times the UDS advice proved correct */
-static ssize_t poolStatsHashLockDedupeAdviceValidShow(KernelLayer *layer, char *buf)
+/** number of gets for pages still on the probation list */
+static ssize_t poolStatsBlockMapProbationHitsShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
-  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.hashLock.dedupeAdviceValid);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.probationHits);
   mutex_unlock(&layer->statsMutex);
   return retval;
 }
 
-static PoolStatsAttribute poolStatsHashLockDedupeAdviceValidAttr = {
-  .attr  = { .name = "hash_lock_dedupe_advice_valid", .mode = 0444, },
-  .show  = poolStatsHashLockDedupeAdviceValidShow,
+static PoolStatsAttribute poolStatsBlockMapProbationHitsAttr = {
+  .attr  = { .name = "block_map_probation_hits", .mode = 0444, },
+  .show  = poolStatsBlockMapProbationHitsShow,
 };
 
 /**********************************************************************/
-/** Number of times the UDS advice proved incorrect */
-static ssize_t poolStatsHashLockDedupeAdviceStaleShow(KernelLayer *layer, char *buf)
+/** number of loads of recently evicted probationary pages */
+static ssize_t poolStatsBlockMapGhostHitsShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
-  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.hashLock.dedupeAdviceStale);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.ghostHits);
   mutex_unlock(&layer->statsMutex);
   return retval;
 }
 
-static PoolStatsAttribute poolStatsHashLockDedupeAdviceStaleAttr = {
-  .attr  = { .name = "hash_lock_dedupe_advice_stale", .mode = 0444, },
-  .show  = poolStatsHashLockDedupeAdviceStaleShow,
+static PoolStatsAttribute poolStatsBlockMapGhostHitsAttr = {
+  .attr  = { .name = "block_map_ghost_hits", .mode = 0444, },
+  .show  = poolStatsBlockMapGhostHitsShow,
 };
 
 /**********************************************************************/
-/** Number of writes with the same data as another in-flight write */
-static ssize_t poolStatsHashLockConcurrentDataMatchesShow(KernelLayer *layer, char *buf)
+/** number of pages evicted */
+static ssize_t poolStatsBlockMapEvictionsShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
-  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.hashLock.concurrentDataMatches);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.evictions);
   mutex_unlock(&layer->statsMutex);
   return retval;
 }
 
-static PoolStatsAttribute poolStatsHashLockConcurrentDataMatchesAttr = {
-  .attr  = { .name = "hash_lock_concurrent_data_matches", .mode = 0444, },
-  .show  = poolStatsHashLockConcurrentDataMatchesShow,
+static PoolStatsAttribute poolStatsBlockMapEvictionsAttr = {
+  .attr  = { .name = "block_map_evictions", .mode = 0444, },
+  .show  = poolStatsBlockMapEvictionsShow,
 };
 
 /**********************************************************************/
-/** Number of writes whose hash collided with an in-flight write */
-static ssize_t poolStatsHashLockConcurrentHashCollisionsShow(KernelLayer *layer, char *buf)
+/** number of evicted pages which were still on probation */
+static ssize_t poolStatsBlockMapProbationEvictionsShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
-  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.hashLock.concurrentHashCollisions);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.probationEvictions);
   mutex_unlock(&layer->statsMutex);
   return retval;
 }
 
-static PoolStatsAttribute poolStatsHashLockConcurrentHashCollisionsAttr = {
-  .attr  = { .name = "hash_lock_concurrent_hash_collisions", .mode = 0444, },
-  .show  = poolStatsHashLockConcurrentHashCollisionsShow,
+static PoolStatsAttribute poolStatsBlockMapProbationEvictionsAttr = {
+  .attr  = { .name = "block_map_probation_evictions", .mode = 0444, },
+  .show  = poolStatsBlockMapProbationEvictionsShow,
 };
 
 /**********************************************************************/
-/** number of times VDO got an invalid dedupe advice PBN from UDS */
-static ssize_t poolStatsErrorsInvalidAdvicePBNCountShow(KernelLayer *layer, char *buf)
+/** total page requests between each evicted page's last use and eviction */
+static ssize_t poolStatsBlockMapEvictionAgeShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
-  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.errors.invalidAdvicePBNCount);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.evictionAge);
   mutex_unlock(&layer->statsMutex);
   return retval;
 }
 
-static PoolStatsAttribute poolStatsErrorsInvalidAdvicePBNCountAttr = {
-  .attr  = { .name = "errors_invalid_advicePBNCount", .mode = 0444, },
-  .show  = poolStatsErrorsInvalidAdvicePBNCountShow,
+static PoolStatsAttribute poolStatsBlockMapEvictionAgeAttr = {
+  .attr  = { .name = "block_map_eviction_age", .mode = 0444, },
+  .show  = poolStatsBlockMapEvictionAgeShow,
 };
 
 /**********************************************************************/
-/** number of times a VIO completed with a VDO_NO_SPACE error */
-static ssize_t poolStatsErrorsNoSpaceErrorCountShow(KernelLayer *layer, char *buf)
+/** number of pages read in ahead of any request for them */
+static ssize_t poolStatsBlockMapPrefetchReadsShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
-  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.errors.noSpaceErrorCount);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.prefetchReads);
   mutex_unlock(&layer->statsMutex);
   return retval;
 }
 
-static PoolStatsAttribute poolStatsErrorsNoSpaceErrorCountAttr = {
-  .attr  = { .name = "errors_no_space_error_count", .mode = 0444, },
-  .show  = poolStatsErrorsNoSpaceErrorCountShow,
+static PoolStatsAttribute poolStatsBlockMapPrefetchReadsAttr = {
+  .attr  = { .name = "block_map_prefetch_reads", .mode = 0444, },
+  .show  = poolStatsBlockMapPrefetchReadsShow,
 };
 
 /**********************************************************************/
-/** number of times a VIO completed with a VDO_READ_ONLY error */
-static ssize_t poolStatsErrorsReadOnlyErrorCountShow(KernelLayer *layer, char *buf)
+/** number of prefetched pages which were requested */
+static ssize_t poolStatsBlockMapPrefetchHitsShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
-  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.errors.readOnlyErrorCount);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.prefetchHits);
   mutex_unlock(&layer->statsMutex);
   return retval;
 }
 
-static PoolStatsAttribute poolStatsErrorsReadOnlyErrorCountAttr = {
-  .attr  = { .name = "errors_read_only_error_count", .mode = 0444, },
-  .show  = poolStatsErrorsReadOnlyErrorCountShow,
+static PoolStatsAttribute poolStatsBlockMapPrefetchHitsAttr = {
+  .attr  = { .name = "block_map_prefetch_hits", .mode = 0444, },
+  .show  = poolStatsBlockMapPrefetchHitsShow,
 };
 
 /**********************************************************************/
-/** The VDO instance */
-static ssize_t poolStatsInstanceShow(KernelLayer *layer, char *buf)
+/** number of prefetched pages dropped without having been requested */
+static ssize_t poolStatsBlockMapPrefetchWastedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
-  retval = sprintf(buf, "%" PRIu32 "\n", layer->kernelStatsStorage.instance);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.prefetchWasted);
   mutex_unlock(&layer->statsMutex);
   return retval;
 }
 
-static PoolStatsAttribute poolStatsInstanceAttr = {
-  .attr  = { .name = "instance", .mode = 0444, },
-  .show  = poolStatsInstanceShow,
+static PoolStatsAttribute poolStatsBlockMapPrefetchWastedAttr = {
+  .attr  = { .name = "block_map_prefetch_wasted", .mode = 0444, },
+  .show  = poolStatsBlockMapPrefetchWastedShow,
 };
 
 /**********************************************************************/
-/** Current number of active VIOs */
-static ssize_t poolStatsCurrentVIOsInProgressShow(KernelLayer *layer, char *buf)
+/** number of mapped entries in the leaf pages written */
+static ssize_t poolStatsBlockMapEntriesWrittenShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
-  retval = sprintf(buf, "%" PRIu32 "\n", layer->kernelStatsStorage.currentVIOsInProgress);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.entriesWritten);
   mutex_unlock(&layer->statsMutex);
   return retval;
 }
 
-static PoolStatsAttribute poolStatsCurrentVIOsInProgressAttr = {
-  .attr  = { .name = "currentVIOs_in_progress", .mode = 0444, },
-  .show  = poolStatsCurrentVIOsInProgressShow,
+static PoolStatsAttribute poolStatsBlockMapEntriesWrittenAttr = {
+  .attr  = { .name = "block_map_entries_written", .mode = 0444, },
+  .show  = poolStatsBlockMapEntriesWrittenShow,
 };
 
 /**********************************************************************/
-/** Maximum number of active VIOs */
-static ssize_t poolStatsMaxVIOsShow(KernelLayer *layer, char *buf)
+/** number of contiguous extents those entries would collapse into */
+static ssize_t poolStatsBlockMapExtentsWrittenShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
-  retval = sprintf(buf, "%" PRIu32 "\n", layer->kernelStatsStorage.maxVIOs);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.extentsWritten);
   mutex_unlock(&layer->statsMutex);
   return retval;
 }
 
-static PoolStatsAttribute poolStatsMaxVIOsAttr = {
-  .attr  = { .name = "maxVIOs", .mode = 0444, },
-  .show  = poolStatsMaxVIOsShow,
+static PoolStatsAttribute poolStatsBlockMapExtentsWrittenAttr = {
+  .attr  = { .name = "block_map_extents_written", .mode = 0444, },
+  .show  = poolStatsBlockMapExtentsWrittenShow,
 };
 
 /**********************************************************************/
-/** Number of times the UDS index was too slow in responding */
-static ssize_t poolStatsDedupeAdviceTimeoutsShow(KernelLayer *layer, char *buf)
+/** number of tree pages found to read by the last forest traversal */
+static ssize_t poolStatsBlockMapTraversalPagesQueuedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
-  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.dedupeAdviceTimeouts);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.traversalPagesQueued);
   mutex_unlock(&layer->statsMutex);
   return retval;
 }
 
-static PoolStatsAttribute poolStatsDedupeAdviceTimeoutsAttr = {
-  .attr  = { .name = "dedupe_advice_timeouts", .mode = 0444, },
-  .show  = poolStatsDedupeAdviceTimeoutsShow,
+static PoolStatsAttribute poolStatsBlockMapTraversalPagesQueuedAttr = {
+  .attr  = { .name = "block_map_traversal_pages_queued", .mode = 0444, },
+  .show  = poolStatsBlockMapTraversalPagesQueuedShow,
+};
+
+/**********************************************************************/
+/** number of those tree pages which have been read */
+static ssize_t poolStatsBlockMapTraversalPagesLoadedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.traversalPagesLoaded);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsBlockMapTraversalPagesLoadedAttr = {
+  .attr  = { .name = "block_map_traversal_pages_loaded", .mode = 0444, },
+  .show  = poolStatsBlockMapTraversalPagesLoadedShow,
+};
+
+/**********************************************************************/
+/** number of journal blocks a dirty page may currently stay unwritten */
+static ssize_t poolStatsBlockMapEraLengthShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.eraLength);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsBlockMapEraLengthAttr = {
+  .attr  = { .name = "block_map_era_length", .mode = 0444, },
+  .show  = poolStatsBlockMapEraLengthShow,
+};
+
+/**********************************************************************/
+/** number of eras shortened because the journal was nearly full */
+static ssize_t poolStatsBlockMapShortenedErasShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.shortenedEras);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsBlockMapShortenedErasAttr = {
+  .attr  = { .name = "block_map_shortened_eras", .mode = 0444, },
+  .show  = poolStatsBlockMapShortenedErasShow,
+};
+
+/**********************************************************************/
+/** number of tree page I/Os which waited for a VIO */
+static ssize_t poolStatsBlockMapVioPoolWaitsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.vioPoolWaits);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsBlockMapVioPoolWaitsAttr = {
+  .attr  = { .name = "block_map_vio_pool_waits", .mode = 0444, },
+  .show  = poolStatsBlockMapVioPoolWaitsShow,
+};
+
+/**********************************************************************/
+/** total microseconds the tree page VIO pools had waiters */
+static ssize_t poolStatsBlockMapVioPoolWaitMicrosecondsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.vioPoolWaitMicroseconds);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsBlockMapVioPoolWaitMicrosecondsAttr = {
+  .attr  = { .name = "block_map_vio_pool_wait_microseconds", .mode = 0444, },
+  .show  = poolStatsBlockMapVioPoolWaitMicrosecondsShow,
+};
+
+/**********************************************************************/
+/** number of VIOs in the tree page VIO pools */
+static ssize_t poolStatsBlockMapVioPoolSizeShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.blockMap.vioPoolSize);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsBlockMapVioPoolSizeAttr = {
+  .attr  = { .name = "block_map_vio_pool_size", .mode = 0444, },
+  .show  = poolStatsBlockMapVioPoolSizeShow,
+};
+
+/**********************************************************************/
+/** Number of times the UDS advice proved correct */
+static ssize_t poolStatsHashLockDedupeAdviceValidShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.hashLock.dedupeAdviceValid);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsHashLockDedupeAdviceValidAttr = {
+  .attr  = { .name = "hash_lock_dedupe_advice_valid", .mode = 0444, },
+  .show  = poolStatsHashLockDedupeAdviceValidShow,
+};
+
+/**********************************************************************/
+/** Number of times the UDS advice proved incorrect */
+static ssize_t poolStatsHashLockDedupeAdviceStaleShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.hashLock.dedupeAdviceStale);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsHashLockDedupeAdviceStaleAttr = {
+  .attr  = { .name = "hash_lock_dedupe_advice_stale", .mode = 0444, },
+  .show  = poolStatsHashLockDedupeAdviceStaleShow,
+};
+
+/**********************************************************************/
+/** Number of writes with the same data as another in-flight write */
+static ssize_t poolStatsHashLockConcurrentDataMatchesShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.hashLock.concurrentDataMatches);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsHashLockConcurrentDataMatchesAttr = {
+  .attr  = { .name = "hash_lock_concurrent_data_matches", .mode = 0444, },
+  .show  = poolStatsHashLockConcurrentDataMatchesShow,
+};
+
+/**********************************************************************/
+/** Number of writes whose hash collided with an in-flight write */
+static ssize_t poolStatsHashLockConcurrentHashCollisionsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.hashLock.concurrentHashCollisions);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsHashLockConcurrentHashCollisionsAttr = {
+  .attr  = { .name = "hash_lock_concurrent_hash_collisions", .mode = 0444, },
+  .show  = poolStatsHashLockConcurrentHashCollisionsShow,
+};
+
+/**********************************************************************/
+/** number of times VDO got an invalid dedupe advice PBN from UDS */
+static ssize_t poolStatsErrorsInvalidAdvicePBNCountShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.errors.invalidAdvicePBNCount);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsErrorsInvalidAdvicePBNCountAttr = {
+  .attr  = { .name = "errors_invalid_advicePBNCount", .mode = 0444, },
+  .show  = poolStatsErrorsInvalidAdvicePBNCountShow,
+};
+
+/**********************************************************************/
+/** number of times a VIO completed with a VDO_NO_SPACE error */
+static ssize_t poolStatsErrorsNoSpaceErrorCountShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.errors.noSpaceErrorCount);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsErrorsNoSpaceErrorCountAttr = {
+  .attr  = { .name = "errors_no_space_error_count", .mode = 0444, },
+  .show  = poolStatsErrorsNoSpaceErrorCountShow,
+};
+
+/**********************************************************************/
+/** number of times a VIO completed with a VDO_READ_ONLY error */
+static ssize_t poolStatsErrorsReadOnlyErrorCountShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.errors.readOnlyErrorCount);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsErrorsReadOnlyErrorCountAttr = {
+  .attr  = { .name = "errors_read_only_error_count", .mode = 0444, },
+  .show  = poolStatsErrorsReadOnlyErrorCountShow,
+};
+
+/**********************************************************************/
+/** The VDO instance */
+static ssize_t poolStatsInstanceShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu32 "\n", layer->kernelStatsStorage.instance);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsInstanceAttr = {
+  .attr  = { .name = "instance", .mode = 0444, },
+  .show  = poolStatsInstanceShow,
+};
+
+/**********************************************************************/
+/** Current number of active VIOs */
+static ssize_t poolStatsCurrentVIOsInProgressShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu32 "\n", layer->kernelStatsStorage.currentVIOsInProgress);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsCurrentVIOsInProgressAttr = {
+  .attr  = { .name = "currentVIOs_in_progress", .mode = 0444, },
+  .show  = poolStatsCurrentVIOsInProgressShow,
+};
+
+/**********************************************************************/
+/** Maximum number of active VIOs */
+static ssize_t poolStatsMaxVIOsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu32 "\n", layer->kernelStatsStorage.maxVIOs);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsMaxVIOsAttr = {
+  .attr  = { .name = "maxVIOs", .mode = 0444, },
+  .show  = poolStatsMaxVIOsShow,
+};
+
+/**********************************************************************/
+/** Number of times the UDS index was too slow in responding */
+static ssize_t poolStatsDedupeAdviceTimeoutsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.dedupeAdviceTimeouts);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsDedupeAdviceTimeoutsAttr = {
+  .attr  = { .name = "dedupe_advice_timeouts", .mode = 0444, },
+  .show  = poolStatsDedupeAdviceTimeoutsShow,
 };
 
 /**********************************************************************/
@@ -1160,7 +1772,7 @@ static ssize_t poolStatsFlushOutShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.flushOut);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1171,13 +1783,30 @@ static PoolStatsAttribute poolStatsFlushOutAttr = {
   .show  = poolStatsFlushOutShow,
 };
 
+/**********************************************************************/
+/** Number of flush requests which joined a flush already waiting */
+static ssize_t poolStatsFlushesCoalescedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.flushesCoalesced);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsFlushesCoalescedAttr = {
+  .attr  = { .name = "flushes_coalesced", .mode = 0444, },
+  .show  = poolStatsFlushesCoalescedShow,
+};
+
 /**********************************************************************/
 /** Logical block size */
 static ssize_t poolStatsLogicalBlockSizeShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.logicalBlockSize);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1194,7 +1823,7 @@ static ssize_t poolStatsBiosInReadShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosIn.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1211,7 +1840,7 @@ static ssize_t poolStatsBiosInWriteShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosIn.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1228,7 +1857,7 @@ static ssize_t poolStatsBiosInDiscardShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosIn.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1245,7 +1874,7 @@ static ssize_t poolStatsBiosInFlushShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosIn.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1262,7 +1891,7 @@ static ssize_t poolStatsBiosInFuaShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosIn.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1279,7 +1908,7 @@ static ssize_t poolStatsBiosInPartialReadShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosInPartial.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1296,7 +1925,7 @@ static ssize_t poolStatsBiosInPartialWriteShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosInPartial.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1313,7 +1942,7 @@ static ssize_t poolStatsBiosInPartialDiscardShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosInPartial.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1330,7 +1959,7 @@ static ssize_t poolStatsBiosInPartialFlushShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosInPartial.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1347,7 +1976,7 @@ static ssize_t poolStatsBiosInPartialFuaShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosInPartial.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1364,7 +1993,7 @@ static ssize_t poolStatsBiosOutReadShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosOut.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1381,7 +2010,7 @@ static ssize_t poolStatsBiosOutWriteShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosOut.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1398,7 +2027,7 @@ static ssize_t poolStatsBiosOutDiscardShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosOut.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1415,7 +2044,7 @@ static ssize_t poolStatsBiosOutFlushShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosOut.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1432,7 +2061,7 @@ static ssize_t poolStatsBiosOutFuaShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosOut.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1449,7 +2078,7 @@ static ssize_t poolStatsBiosMetaReadShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosMeta.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1466,7 +2095,7 @@ static ssize_t poolStatsBiosMetaWriteShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosMeta.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1483,7 +2112,7 @@ static ssize_t poolStatsBiosMetaDiscardShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosMeta.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1500,7 +2129,7 @@ static ssize_t poolStatsBiosMetaFlushShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosMeta.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1517,7 +2146,7 @@ static ssize_t poolStatsBiosMetaFuaShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosMeta.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1534,7 +2163,7 @@ static ssize_t poolStatsBiosJournalReadShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosJournal.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1551,7 +2180,7 @@ static ssize_t poolStatsBiosJournalWriteShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosJournal.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1568,7 +2197,7 @@ static ssize_t poolStatsBiosJournalDiscardShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosJournal.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1585,7 +2214,7 @@ static ssize_t poolStatsBiosJournalFlushShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosJournal.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1602,7 +2231,7 @@ static ssize_t poolStatsBiosJournalFuaShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosJournal.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1619,7 +2248,7 @@ static ssize_t poolStatsBiosPageCacheReadShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosPageCache.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1636,7 +2265,7 @@ static ssize_t poolStatsBiosPageCacheWriteShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosPageCache.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1653,7 +2282,7 @@ static ssize_t poolStatsBiosPageCacheDiscardShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosPageCache.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1670,7 +2299,7 @@ static ssize_t poolStatsBiosPageCacheFlushShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosPageCache.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1687,7 +2316,7 @@ static ssize_t poolStatsBiosPageCacheFuaShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosPageCache.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1704,7 +2333,7 @@ static ssize_t poolStatsBiosOutCompletedReadShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosOutCompleted.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1721,7 +2350,7 @@ static ssize_t poolStatsBiosOutCompletedWriteShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosOutCompleted.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1738,7 +2367,7 @@ static ssize_t poolStatsBiosOutCompletedDiscardShow(KernelLayer *layer, char *bu
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosOutCompleted.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1755,7 +2384,7 @@ static ssize_t poolStatsBiosOutCompletedFlushShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosOutCompleted.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1772,7 +2401,7 @@ static ssize_t poolStatsBiosOutCompletedFuaShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosOutCompleted.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1789,7 +2418,7 @@ static ssize_t poolStatsBiosMetaCompletedReadShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosMetaCompleted.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1806,7 +2435,7 @@ static ssize_t poolStatsBiosMetaCompletedWriteShow(KernelLayer *layer, char *buf
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosMetaCompleted.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1823,7 +2452,7 @@ static ssize_t poolStatsBiosMetaCompletedDiscardShow(KernelLayer *layer, char *b
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosMetaCompleted.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1840,7 +2469,7 @@ static ssize_t poolStatsBiosMetaCompletedFlushShow(KernelLayer *layer, char *buf
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosMetaCompleted.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1857,7 +2486,7 @@ static ssize_t poolStatsBiosMetaCompletedFuaShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosMetaCompleted.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1874,7 +2503,7 @@ static ssize_t poolStatsBiosJournalCompletedReadShow(KernelLayer *layer, char *b
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosJournalCompleted.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1891,7 +2520,7 @@ static ssize_t poolStatsBiosJournalCompletedWriteShow(KernelLayer *layer, char *
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosJournalCompleted.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1908,7 +2537,7 @@ static ssize_t poolStatsBiosJournalCompletedDiscardShow(KernelLayer *layer, char
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosJournalCompleted.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1925,7 +2554,7 @@ static ssize_t poolStatsBiosJournalCompletedFlushShow(KernelLayer *layer, char *
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosJournalCompleted.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1942,7 +2571,7 @@ static ssize_t poolStatsBiosJournalCompletedFuaShow(KernelLayer *layer, char *bu
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosJournalCompleted.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1959,7 +2588,7 @@ static ssize_t poolStatsBiosPageCacheCompletedReadShow(KernelLayer *layer, char
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosPageCacheCompleted.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1976,7 +2605,7 @@ static ssize_t poolStatsBiosPageCacheCompletedWriteShow(KernelLayer *layer, char
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosPageCacheCompleted.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -1993,7 +2622,7 @@ static ssize_t poolStatsBiosPageCacheCompletedDiscardShow(KernelLayer *layer, ch
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosPageCacheCompleted.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2010,7 +2639,7 @@ static ssize_t poolStatsBiosPageCacheCompletedFlushShow(KernelLayer *layer, char
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosPageCacheCompleted.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2027,7 +2656,7 @@ static ssize_t poolStatsBiosPageCacheCompletedFuaShow(KernelLayer *layer, char *
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosPageCacheCompleted.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2044,7 +2673,7 @@ static ssize_t poolStatsBiosAcknowledgedReadShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosAcknowledged.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2061,7 +2690,7 @@ static ssize_t poolStatsBiosAcknowledgedWriteShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosAcknowledged.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2078,7 +2707,7 @@ static ssize_t poolStatsBiosAcknowledgedDiscardShow(KernelLayer *layer, char *bu
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosAcknowledged.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2095,7 +2724,7 @@ static ssize_t poolStatsBiosAcknowledgedFlushShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosAcknowledged.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2112,7 +2741,7 @@ static ssize_t poolStatsBiosAcknowledgedFuaShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosAcknowledged.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2129,7 +2758,7 @@ static ssize_t poolStatsBiosAcknowledgedPartialReadShow(KernelLayer *layer, char
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosAcknowledgedPartial.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2146,7 +2775,7 @@ static ssize_t poolStatsBiosAcknowledgedPartialWriteShow(KernelLayer *layer, cha
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosAcknowledgedPartial.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2163,7 +2792,7 @@ static ssize_t poolStatsBiosAcknowledgedPartialDiscardShow(KernelLayer *layer, c
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosAcknowledgedPartial.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2180,7 +2809,7 @@ static ssize_t poolStatsBiosAcknowledgedPartialFlushShow(KernelLayer *layer, cha
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosAcknowledgedPartial.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2197,7 +2826,7 @@ static ssize_t poolStatsBiosAcknowledgedPartialFuaShow(KernelLayer *layer, char
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosAcknowledgedPartial.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2214,7 +2843,7 @@ static ssize_t poolStatsBiosInProgressReadShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosInProgress.read);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2231,7 +2860,7 @@ static ssize_t poolStatsBiosInProgressWriteShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosInProgress.write);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2248,7 +2877,7 @@ static ssize_t poolStatsBiosInProgressDiscardShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosInProgress.discard);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2265,7 +2894,7 @@ static ssize_t poolStatsBiosInProgressFlushShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosInProgress.flush);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2282,7 +2911,7 @@ static ssize_t poolStatsBiosInProgressFuaShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosInProgress.fua);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2299,7 +2928,7 @@ static ssize_t poolStatsMemoryUsageBytesUsedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.memoryUsage.bytesUsed);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2316,7 +2945,7 @@ static ssize_t poolStatsMemoryUsagePeakBytesUsedShow(KernelLayer *layer, char *b
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.memoryUsage.peakBytesUsed);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2333,7 +2962,7 @@ static ssize_t poolStatsMemoryUsageBiosUsedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.memoryUsage.biosUsed);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2350,7 +2979,7 @@ static ssize_t poolStatsMemoryUsagePeakBioCountShow(KernelLayer *layer, char *bu
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.memoryUsage.peakBioCount);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2367,7 +2996,7 @@ static ssize_t poolStatsIndexEntriesIndexedShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.entriesIndexed);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2384,7 +3013,7 @@ static ssize_t poolStatsIndexPostsFoundShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.postsFound);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2401,7 +3030,7 @@ static ssize_t poolStatsIndexPostsNotFoundShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.postsNotFound);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2418,7 +3047,7 @@ static ssize_t poolStatsIndexQueriesFoundShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.queriesFound);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2435,7 +3064,7 @@ static ssize_t poolStatsIndexQueriesNotFoundShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.queriesNotFound);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2452,7 +3081,7 @@ static ssize_t poolStatsIndexUpdatesFoundShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.updatesFound);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2469,7 +3098,7 @@ static ssize_t poolStatsIndexUpdatesNotFoundShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.updatesNotFound);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2486,7 +3115,7 @@ static ssize_t poolStatsIndexCurrDedupeQueriesShow(KernelLayer *layer, char *buf
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu32 "\n", layer->kernelStatsStorage.index.currDedupeQueries);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2503,7 +3132,7 @@ static ssize_t poolStatsIndexMaxDedupeQueriesShow(KernelLayer *layer, char *buf)
 {
   ssize_t retval;
   mutex_lock(&layer->statsMutex);
-  getKernelStats(layer, &layer->kernelStatsStorage);
+  refreshPoolStats(layer);
   retval = sprintf(buf, "%" PRIu32 "\n", layer->kernelStatsStorage.index.maxDedupeQueries);
   mutex_unlock(&layer->statsMutex);
   return retval;
@@ -2514,10 +3143,573 @@ static PoolStatsAttribute poolStatsIndexMaxDedupeQueriesAttr = {
   .show  = poolStatsIndexMaxDedupeQueriesShow,
 };
 
+/**********************************************************************/
+/** Number of valid chapter indexes evicted from the sparse cache */
+static ssize_t poolStatsIndexSparseCacheEvictionsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.sparseCacheEvictions);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsIndexSparseCacheEvictionsAttr = {
+  .attr  = { .name = "index_sparse_cache_evictions", .mode = 0444, },
+  .show  = poolStatsIndexSparseCacheEvictionsShow,
+};
+
+/**********************************************************************/
+/** Number of times a hot sparse chapter index was spared eviction */
+static ssize_t poolStatsIndexSparseCacheRetentionsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.sparseCacheRetentions);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsIndexSparseCacheRetentionsAttr = {
+  .attr  = { .name = "index_sparse_cache_retentions", .mode = 0444, },
+  .show  = poolStatsIndexSparseCacheRetentionsShow,
+};
+
+/**********************************************************************/
+/** Memory currently allotted to the index page cache, in bytes */
+static ssize_t poolStatsIndexPageCacheBytesShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.pageCacheBytes);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsIndexPageCacheBytesAttr = {
+  .attr  = { .name = "index_page_cache_bytes", .mode = 0444, },
+  .show  = poolStatsIndexPageCacheBytesShow,
+};
+
+/**********************************************************************/
+/** Number of first lookups of an index page which found it cached */
+static ssize_t poolStatsIndexPageCacheHitsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.pageCacheHits);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsIndexPageCacheHitsAttr = {
+  .attr  = { .name = "index_page_cache_hits", .mode = 0444, },
+  .show  = poolStatsIndexPageCacheHitsShow,
+};
+
+/**********************************************************************/
+/** Number of first lookups of an index page which waited for a read */
+static ssize_t poolStatsIndexPageCacheMissesShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.pageCacheMisses);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsIndexPageCacheMissesAttr = {
+  .attr  = { .name = "index_page_cache_misses", .mode = 0444, },
+  .show  = poolStatsIndexPageCacheMissesShow,
+};
+
+/**********************************************************************/
+/** Index page cache memory given back under memory pressure, in bytes */
+static ssize_t poolStatsIndexPageCacheReclaimedBytesShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.pageCacheReclaimedBytes);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsIndexPageCacheReclaimedBytesAttr = {
+  .attr  = { .name = "index_page_cache_reclaimed_bytes", .mode = 0444, },
+  .show  = poolStatsIndexPageCacheReclaimedBytesShow,
+};
+
+/**********************************************************************/
+/** Number of writes not posted because their region was not deduping */
+static ssize_t poolStatsIndexBypassedPostsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.bypassedPosts);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsIndexBypassedPostsAttr = {
+  .attr  = { .name = "index_bypassed_posts", .mode = 0444, },
+  .show  = poolStatsIndexBypassedPostsShow,
+};
+
+/**********************************************************************/
+/** Number of writes to regions not deduping which were posted anyway */
+static ssize_t poolStatsIndexSampledPostsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.index.sampledPosts);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsIndexSampledPostsAttr = {
+  .attr  = { .name = "index_sampled_posts", .mode = 0444, },
+  .show  = poolStatsIndexSampledPostsShow,
+};
+
+/**********************************************************************/
+/** Current number of logical regions whose writes are not deduping */
+static ssize_t poolStatsIndexBypassedRegionsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu32 "\n", layer->kernelStatsStorage.index.bypassedRegions);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsIndexBypassedRegionsAttr = {
+  .attr  = { .name = "index_bypassed_regions", .mode = 0444, },
+  .show  = poolStatsIndexBypassedRegionsShow,
+};
+
+/**********************************************************************/
+/** Number of blocks judged too incompressible to be worth compressing */
+static ssize_t poolStatsCompressionEstimateSkippedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.compressionEstimate.skipped);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsCompressionEstimateSkippedAttr = {
+  .attr  = { .name = "compression_estimate_skipped", .mode = 0444, },
+  .show  = poolStatsCompressionEstimateSkippedShow,
+};
+
+/**********************************************************************/
+/** Number of skipped blocks compressed anyway to check the estimate */
+static ssize_t poolStatsCompressionEstimateAuditedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.compressionEstimate.audited);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsCompressionEstimateAuditedAttr = {
+  .attr  = { .name = "compression_estimate_audited", .mode = 0444, },
+  .show  = poolStatsCompressionEstimateAuditedShow,
+};
+
+/**********************************************************************/
+/** Number of audited blocks which turned out to be compressible */
+static ssize_t poolStatsCompressionEstimateWronglySkippedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.compressionEstimate.wronglySkipped);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsCompressionEstimateWronglySkippedAttr = {
+  .attr  = { .name = "compression_estimate_wrongly_skipped", .mode = 0444, },
+  .show  = poolStatsCompressionEstimateWronglySkippedShow,
+};
+
+/**********************************************************************/
+/** Number of blocks compressed on the estimator's advice to no effect */
+static ssize_t poolStatsCompressionEstimateMissedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.compressionEstimate.missed);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsCompressionEstimateMissedAttr = {
+  .attr  = { .name = "compression_estimate_missed", .mode = 0444, },
+  .show  = poolStatsCompressionEstimateMissedShow,
+};
+
+/**********************************************************************/
+/** Number of multi-block bios built by coalescing sequential writes */
+static ssize_t poolStatsBiosCoalescedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosCoalesced);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsBiosCoalescedAttr = {
+  .attr  = { .name = "bios_coalesced", .mode = 0444, },
+  .show  = poolStatsBiosCoalescedShow,
+};
+
+/**********************************************************************/
+/** Number of bios merged into coalesced bios */
+static ssize_t poolStatsBiosCoalescedMembersShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.biosCoalescedMembers);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsBiosCoalescedMembersAttr = {
+  .attr  = { .name = "bios_coalesced_members", .mode = 0444, },
+  .show  = poolStatsBiosCoalescedMembersShow,
+};
+
+/**********************************************************************/
+/** Number of written blocks of a repeated word named without hashing */
+static ssize_t poolStatsPatternBlocksNamedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.patternBlocksNamed);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsPatternBlocksNamedAttr = {
+  .attr  = { .name = "pattern_blocks_named", .mode = 0444, },
+  .show  = poolStatsPatternBlocksNamedShow,
+};
+
+/**********************************************************************/
+/** Number of completion callbacks enqueued to run on another thread */
+static ssize_t poolStatsCompletionThreadHopsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.completionThreadHops);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsCompletionThreadHopsAttr = {
+  .attr  = { .name = "completion_thread_hops", .mode = 0444, },
+  .show  = poolStatsCompletionThreadHopsShow,
+};
+
+/**********************************************************************/
+/** Number of completion callbacks requeued on their current thread */
+static ssize_t poolStatsCompletionsRequeuedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.completionsRequeued);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsCompletionsRequeuedAttr = {
+  .attr  = { .name = "completions_requeued", .mode = 0444, },
+  .show  = poolStatsCompletionsRequeuedShow,
+};
+
+/**********************************************************************/
+/** Number of compressed block reads found in the compressed block cache */
+static ssize_t poolStatsCompressedBlockCacheHitsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.compressedBlockCacheHits);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsCompressedBlockCacheHitsAttr = {
+  .attr  = { .name = "compressed_block_cache_hits", .mode = 0444, },
+  .show  = poolStatsCompressedBlockCacheHitsShow,
+};
+
+/**********************************************************************/
+/** Number of compressed block reads which had to go to storage */
+static ssize_t poolStatsCompressedBlockCacheMissesShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.compressedBlockCacheMisses);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsCompressedBlockCacheMissesAttr = {
+  .attr  = { .name = "compressed_block_cache_misses", .mode = 0444, },
+  .show  = poolStatsCompressedBlockCacheMissesShow,
+};
+
+/**********************************************************************/
+/** Number of blocks read ahead of sequential reads */
+static ssize_t poolStatsReadAheadReadsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.readAheadReads);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsReadAheadReadsAttr = {
+  .attr  = { .name = "read_ahead_reads", .mode = 0444, },
+  .show  = poolStatsReadAheadReadsShow,
+};
+
+/**********************************************************************/
+/** Number of data reads satisfied by blocks which were read ahead */
+static ssize_t poolStatsReadAheadHitsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.readAheadHits);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsReadAheadHitsAttr = {
+  .attr  = { .name = "read_ahead_hits", .mode = 0444, },
+  .show  = poolStatsReadAheadHitsShow,
+};
+
+/**********************************************************************/
+/** Number of uncompressed blocks cached because they were read again */
+static ssize_t poolStatsRepeatedReadsCachedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.repeatedReadsCached);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsRepeatedReadsCachedAttr = {
+  .attr  = { .name = "repeated_reads_cached", .mode = 0444, },
+  .show  = poolStatsRepeatedReadsCachedShow,
+};
+
+/**********************************************************************/
+/** Number of reads satisfied by blocks cached because they were read again */
+static ssize_t poolStatsRepeatedReadCacheHitsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.repeatedReadCacheHits);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsRepeatedReadCacheHitsAttr = {
+  .attr  = { .name = "repeated_read_cache_hits", .mode = 0444, },
+  .show  = poolStatsRepeatedReadCacheHitsShow,
+};
+
+/**********************************************************************/
+/** Number of bios acknowledged on ack threads shared with other VDOs */
+static ssize_t poolStatsSharedBioAcksShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.sharedBioAcks);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsSharedBioAcksAttr = {
+  .attr  = { .name = "shared_bio_acks", .mode = 0444, },
+  .show  = poolStatsSharedBioAcksShow,
+};
+
+/**********************************************************************/
+/** Time spent acknowledging bios on shared ack threads, in microseconds */
+static ssize_t poolStatsSharedBioAckMicrosecondsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.sharedBioAckMicroseconds);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsSharedBioAckMicrosecondsAttr = {
+  .attr  = { .name = "shared_bio_ack_microseconds", .mode = 0444, },
+  .show  = poolStatsSharedBioAckMicrosecondsShow,
+};
+
+/**********************************************************************/
+/** Number of writes compressed while their dedupe queries were running */
+static ssize_t poolStatsSpeculativeCompressionsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.speculativeCompressions);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsSpeculativeCompressionsAttr = {
+  .attr  = { .name = "speculative_compressions", .mode = 0444, },
+  .show  = poolStatsSpeculativeCompressionsShow,
+};
+
+/**********************************************************************/
+/** Number of speculative compressions which were written compressed */
+static ssize_t poolStatsSpeculativeCompressionsUsedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.speculativeCompressionsUsed);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsSpeculativeCompressionsUsedAttr = {
+  .attr  = { .name = "speculative_compressions_used", .mode = 0444, },
+  .show  = poolStatsSpeculativeCompressionsUsedShow,
+};
+
+/**********************************************************************/
+/** Number of block map cache pages given back under memory pressure */
+static ssize_t poolStatsBlockMapCacheReclaimedPagesShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.blockMapCacheReclaimedPages);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsBlockMapCacheReclaimedPagesAttr = {
+  .attr  = { .name = "block_map_cache_reclaimed_pages", .mode = 0444, },
+  .show  = poolStatsBlockMapCacheReclaimedPagesShow,
+};
+
+/**********************************************************************/
+/** Number of block map cache pages regrown after memory pressure */
+static ssize_t poolStatsBlockMapCacheRegrownPagesShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->kernelStatsStorage.blockMapCacheRegrownPages);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsBlockMapCacheRegrownPagesAttr = {
+  .attr  = { .name = "block_map_cache_regrown_pages", .mode = 0444, },
+  .show  = poolStatsBlockMapCacheRegrownPagesShow,
+};
+
+/**********************************************************************/
+/** Number of queries answered by the hash zone advice caches */
+static ssize_t poolStatsHashLockAdviceCacheHitsShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.hashLock.adviceCacheHits);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsHashLockAdviceCacheHitsAttr = {
+  .attr  = { .name = "hash_lock_advice_cache_hits", .mode = 0444, },
+  .show  = poolStatsHashLockAdviceCacheHitsShow,
+};
+
+/**********************************************************************/
+/** Number of queries which missed the hash zone advice caches */
+static ssize_t poolStatsHashLockAdviceCacheMissesShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.hashLock.adviceCacheMisses);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsHashLockAdviceCacheMissesAttr = {
+  .attr  = { .name = "hash_lock_advice_cache_misses", .mode = 0444, },
+  .show  = poolStatsHashLockAdviceCacheMissesShow,
+};
+
+/**********************************************************************/
+/** Number of times unchanged UDS advice was trusted without a verify */
+static ssize_t poolStatsHashLockDedupeAdviceTrustedShow(KernelLayer *layer, char *buf)
+{
+  ssize_t retval;
+  mutex_lock(&layer->statsMutex);
+  refreshPoolStats(layer);
+  retval = sprintf(buf, "%" PRIu64 "\n", layer->vdoStatsStorage.hashLock.dedupeAdviceTrusted);
+  mutex_unlock(&layer->statsMutex);
+  return retval;
+}
+
+static PoolStatsAttribute poolStatsHashLockDedupeAdviceTrustedAttr = {
+  .attr  = { .name = "hash_lock_dedupe_advice_trusted", .mode = 0444, },
+  .show  = poolStatsHashLockDedupeAdviceTrustedShow,
+};
+
 struct attribute *poolStatsAttrs[] = {
   &poolStatsDataBlocksUsedAttr.attr,
   &poolStatsOverheadBlocksUsedAttr.attr,
   &poolStatsLogicalBlocksUsedAttr.attr,
+  &poolStatsWritesAbsorbedAttr.attr,
+  &poolStatsHotWritesBypassedAttr.attr,
   &poolStatsPhysicalBlocksAttr.attr,
   &poolStatsLogicalBlocksAttr.attr,
   &poolStatsBlockMapCacheSizeAttr.attr,
@@ -2534,6 +3726,16 @@ struct attribute *poolStatsAttrs[] = {
   &poolStatsAllocatorSlabCountAttr.attr,
   &poolStatsAllocatorSlabsOpenedAttr.attr,
   &poolStatsAllocatorSlabsReopenedAttr.attr,
+  &poolStatsAllocatorAllocationStallsAttr.attr,
+  &poolStatsAllocatorStallMicrosecondsAttr.attr,
+  &poolStatsAllocatorSlabsScrubbedAttr.attr,
+  &poolStatsAllocatorSlabsToScrubAttr.attr,
+  &poolStatsAllocatorScrubSecondsRemainingAttr.attr,
+  &poolStatsAllocatorVioPoolWaitsAttr.attr,
+  &poolStatsAllocatorVioPoolWaitMicrosecondsAttr.attr,
+  &poolStatsAllocatorVioPoolSizeAttr.attr,
+  &poolStatsAllocatorDiscardsPassedDownAttr.attr,
+  &poolStatsAllocatorBlocksPassedDownAttr.attr,
   &poolStatsJournalDiskFullAttr.attr,
   &poolStatsJournalSlabJournalCommitsRequestedAttr.attr,
   &poolStatsJournalEntriesStartedAttr.attr,
@@ -2542,13 +3744,20 @@ struct attribute *poolStatsAttrs[] = {
   &poolStatsJournalBlocksStartedAttr.attr,
   &poolStatsJournalBlocksWrittenAttr.attr,
   &poolStatsJournalBlocksCommittedAttr.attr,
+  &poolStatsJournalEntriesInRunsAttr.attr,
   &poolStatsSlabJournalDiskFullCountAttr.attr,
   &poolStatsSlabJournalFlushCountAttr.attr,
   &poolStatsSlabJournalBlockedCountAttr.attr,
   &poolStatsSlabJournalBlocksWrittenAttr.attr,
   &poolStatsSlabJournalTailBusyCountAttr.attr,
+  &poolStatsSlabJournalEntriesInRunsAttr.attr,
   &poolStatsSlabSummaryBlocksWrittenAttr.attr,
+  &poolStatsSlabSummaryBatchesWrittenAttr.attr,
   &poolStatsRefCountsBlocksWrittenAttr.attr,
+  &poolStatsRefCountsDirtyBlocksAttr.attr,
+  &poolStatsRefCountsWritesDeferredAttr.attr,
+  &poolStatsRefCountsWriteLatencyAttr.attr,
+  &poolStatsRefCountsWriteRateAttr.attr,
   &poolStatsBlockMapDirtyPagesAttr.attr,
   &poolStatsBlockMapCleanPagesAttr.attr,
   &poolStatsBlockMapFreePagesAttr.attr,
@@ -2569,6 +3778,23 @@ struct attribute *poolStatsAttrs[] = {
   &poolStatsBlockMapPagesLoadedAttr.attr,
   &poolStatsBlockMapPagesSavedAttr.attr,
   &poolStatsBlockMapFlushCountAttr.attr,
+  &poolStatsBlockMapProbationHitsAttr.attr,
+  &poolStatsBlockMapGhostHitsAttr.attr,
+  &poolStatsBlockMapEvictionsAttr.attr,
+  &poolStatsBlockMapProbationEvictionsAttr.attr,
+  &poolStatsBlockMapEvictionAgeAttr.attr,
+  &poolStatsBlockMapPrefetchReadsAttr.attr,
+  &poolStatsBlockMapPrefetchHitsAttr.attr,
+  &poolStatsBlockMapPrefetchWastedAttr.attr,
+  &poolStatsBlockMapEntriesWrittenAttr.attr,
+  &poolStatsBlockMapExtentsWrittenAttr.attr,
+  &poolStatsBlockMapTraversalPagesQueuedAttr.attr,
+  &poolStatsBlockMapTraversalPagesLoadedAttr.attr,
+  &poolStatsBlockMapEraLengthAttr.attr,
+  &poolStatsBlockMapShortenedErasAttr.attr,
+  &poolStatsBlockMapVioPoolWaitsAttr.attr,
+  &poolStatsBlockMapVioPoolWaitMicrosecondsAttr.attr,
+  &poolStatsBlockMapVioPoolSizeAttr.attr,
   &poolStatsHashLockDedupeAdviceValidAttr.attr,
   &poolStatsHashLockDedupeAdviceStaleAttr.attr,
   &poolStatsHashLockConcurrentDataMatchesAttr.attr,
@@ -2581,6 +3807,7 @@ struct attribute *poolStatsAttrs[] = {
   &poolStatsMaxVIOsAttr.attr,
   &poolStatsDedupeAdviceTimeoutsAttr.attr,
   &poolStatsFlushOutAttr.attr,
+  &poolStatsFlushesCoalescedAttr.attr,
   &poolStatsLogicalBlockSizeAttr.attr,
   &poolStatsBiosInReadAttr.attr,
   &poolStatsBiosInWriteAttr.attr,
@@ -2660,5 +3887,38 @@ struct attribute *poolStatsAttrs[] = {
   &poolStatsIndexUpdatesNotFoundAttr.attr,
   &poolStatsIndexCurrDedupeQueriesAttr.attr,
   &poolStatsIndexMaxDedupeQueriesAttr.attr,
+  &poolStatsIndexSparseCacheEvictionsAttr.attr,
+  &poolStatsIndexSparseCacheRetentionsAttr.attr,
+  &poolStatsIndexPageCacheBytesAttr.attr,
+  &poolStatsIndexPageCacheHitsAttr.attr,
+  &poolStatsIndexPageCacheMissesAttr.attr,
+  &poolStatsIndexPageCacheReclaimedBytesAttr.attr,
+  &poolStatsIndexBypassedPostsAttr.attr,
+  &poolStatsIndexSampledPostsAttr.attr,
+  &poolStatsIndexBypassedRegionsAttr.attr,
+  &poolStatsCompressionEstimateSkippedAttr.attr,
+  &poolStatsCompressionEstimateAuditedAttr.attr,
+  &poolStatsCompressionEstimateWronglySkippedAttr.attr,
+  &poolStatsCompressionEstimateMissedAttr.attr,
+  &poolStatsBiosCoalescedAttr.attr,
+  &poolStatsBiosCoalescedMembersAttr.attr,
+  &poolStatsPatternBlocksNamedAttr.attr,
+  &poolStatsCompletionThreadHopsAttr.attr,
+  &poolStatsCompletionsRequeuedAttr.attr,
+  &poolStatsCompressedBlockCacheHitsAttr.attr,
+  &poolStatsCompressedBlockCacheMissesAttr.attr,
+  &poolStatsReadAheadReadsAttr.attr,
+  &poolStatsReadAheadHitsAttr.attr,
+  &poolStatsRepeatedReadsCachedAttr.attr,
+  &poolStatsRepeatedReadCacheHitsAttr.attr,
+  &poolStatsSharedBioAcksAttr.attr,
+  &poolStatsSharedBioAckMicrosecondsAttr.attr,
+  &poolStatsSpeculativeCompressionsAttr.attr,
+  &poolStatsSpeculativeCompressionsUsedAttr.attr,
+  &poolStatsBlockMapCacheReclaimedPagesAttr.attr,
+  &poolStatsBlockMapCacheRegrownPagesAttr.attr,
+  &poolStatsHashLockAdviceCacheHitsAttr.attr,
+  &poolStatsHashLockAdviceCacheMissesAttr.attr,
+  &poolStatsHashLockDedupeAdviceTrustedAttr.attr,
   NULL,
 };
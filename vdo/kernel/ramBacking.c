@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/ramBacking.c#1 $
+ */
+
+#include "ramBacking.h"
+
+#include <linux/completion.h>
+#include <linux/mutex.h>
+
+#include "logger.h"
+#include "memoryAlloc.h"
+#include "numeric.h"
+
+#include "constants.h"
+#include "intMap.h"
+#include "statusCodes.h"
+
+#include "bio.h"
+#include "bioIterator.h"
+#include "kernelLayer.h"
+
+enum {
+  /** The number of blocks allocated at a time to hold written data */
+  RAM_EXTENT_BLOCKS = 256,
+};
+
+struct ramBacking {
+  /** The layer whose I/O is held */
+  KernelLayer          *layer;
+  /** The parent device; any other device is the journal device */
+  struct block_device  *device;
+  /** Serializes all access to the blocks */
+  struct mutex          mutex;
+  /** The data of each block held, keyed by makeBlockKey() */
+  IntMap               *blocks;
+  /** The extents holding the data of the blocks */
+  char                **extents;
+  /** The number of extents allocated */
+  size_t                extentCount;
+  /** The number of extents the extents array can hold */
+  size_t                extentCapacity;
+  /** The number of blocks handed out from the last extent */
+  unsigned int          extentBlocksUsed;
+};
+
+/**********************************************************************/
+int makeRAMBacking(KernelLayer *layer, RAMBacking **backingPtr)
+{
+  RAMBacking *backing;
+  int result = ALLOCATE(1, RAMBacking, __func__, &backing);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  result = makeIntMap(0, 0, &backing->blocks);
+  if (result != VDO_SUCCESS) {
+    FREE(backing);
+    return result;
+  }
+
+  backing->layer  = layer;
+  backing->device = getKernelLayerBdev(layer);
+  mutex_init(&backing->mutex);
+  *backingPtr = backing;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void freeRAMBacking(RAMBacking **backingPtr)
+{
+  RAMBacking *backing = *backingPtr;
+  if (backing == NULL) {
+    return;
+  }
+
+  logInfo("discarding %zu blocks held in memory", intMapSize(backing->blocks));
+  for (size_t i = 0; i < backing->extentCount; i++) {
+    FREE(backing->extents[i]);
+  }
+  FREE(backing->extents);
+  freeIntMap(&backing->blocks);
+  FREE(backing);
+  *backingPtr = NULL;
+}
+
+/**
+ * Make the key under which a block is held. Blocks of the journal device
+ * are kept apart from those of the parent device by the low bit.
+ *
+ * @param backing  The RAM backing
+ * @param device   The device of the block
+ * @param sector   The first sector of the block
+ *
+ * @return The key of the block
+ **/
+static inline uint64_t makeBlockKey(RAMBacking          *backing,
+                                    struct block_device *device,
+                                    sector_t             sector)
+{
+  return (((uint64_t) (sector / VDO_SECTORS_PER_BLOCK) << 1)
+          | ((device == backing->device) ? 0 : 1));
+}
+
+/**
+ * Hand out the space for a new block from the last extent, allocating a new
+ * extent if it is full.
+ *
+ * @param [in]  backing   The RAM backing
+ * @param [out] blockPtr  A pointer to hold the space for the block
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+static int allocateBlock(RAMBacking *backing, char **blockPtr)
+{
+  if ((backing->extentCount > 0)
+      && (backing->extentBlocksUsed < RAM_EXTENT_BLOCKS)) {
+    char *extent = backing->extents[backing->extentCount - 1];
+    *blockPtr = extent + (backing->extentBlocksUsed++ * VDO_BLOCK_SIZE);
+    return VDO_SUCCESS;
+  }
+
+  if (backing->extentCount == backing->extentCapacity) {
+    size_t capacity = maxSizeT(backing->extentCapacity * 2, 16);
+    int result = reallocateMemory(backing->extents,
+                                  backing->extentCapacity * sizeof(char *),
+                                  capacity * sizeof(char *),
+                                  "RAM backing extents", &backing->extents);
+    if (result != VDO_SUCCESS) {
+      return result;
+    }
+    backing->extentCapacity = capacity;
+  }
+
+  char *extent;
+  int result = ALLOCATE(RAM_EXTENT_BLOCKS * VDO_BLOCK_SIZE, char,
+                        "RAM backing extent", &extent);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  backing->extents[backing->extentCount++] = extent;
+  backing->extentBlocksUsed                = 1;
+  *blockPtr                                = extent;
+  return VDO_SUCCESS;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
+/**
+ * Callback for a bio which read a block from the device.
+ *
+ * @param bio  The bio
+ **/
+static void endDeviceRead(BIO *bio)
+#else
+/**
+ * Callback for a bio which read a block from the device.
+ *
+ * @param bio     The bio
+ * @param result  The result of the read operation
+ **/
+static void endDeviceRead(BIO *bio, int result)
+#endif
+{
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,4,0)
+  if (result != 0) {
+    clear_bit(BIO_UPTODATE, &bio->bi_flags);
+  }
+#endif
+  complete((struct completion *) bio->bi_private);
+}
+
+/**
+ * Read a block from a device, waiting for the read to finish.
+ *
+ * @param backing  The RAM backing
+ * @param device   The device to read from
+ * @param sector   The first sector of the block
+ * @param buffer   The buffer to read into
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+static int readFromDevice(RAMBacking          *backing,
+                          struct block_device *device,
+                          sector_t             sector,
+                          char                *buffer)
+{
+  BIO *bio;
+  int result = createBio(backing->layer, buffer, &bio);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  struct completion readWait;
+  init_completion(&readWait);
+  setBioOperationRead(bio);
+  bio->bi_end_io  = endDeviceRead;
+  bio->bi_private = &readWait;
+  setBioBlockDevice(bio, device);
+  setBioSector(bio, sector);
+  generic_make_request(bio);
+  wait_for_completion(&readWait);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
+  if (getBioResult(bio) != 0) {
+#else
+  if (!bio_flagged(bio, BIO_UPTODATE)) {
+#endif
+    result = logErrorWithStringError(-EIO,
+                                     "reading sector %llu into memory",
+                                     (unsigned long long) sector);
+  }
+
+  freeBio(bio, backing->layer);
+  return result;
+}
+
+/**
+ * Get the data of a block, making space for it if it is not yet held.
+ *
+ * @param [in]  backing   The RAM backing
+ * @param [in]  device    The device of the block
+ * @param [in]  sector    The first sector of the block
+ * @param [in]  fetch     Whether a new block must be read from the device,
+ *                        rather than being about to be overwritten
+ * @param [out] blockPtr  A pointer to hold the data of the block
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+static int getBlock(RAMBacking           *backing,
+                    struct block_device  *device,
+                    sector_t              sector,
+                    bool                  fetch,
+                    char                **blockPtr)
+{
+  uint64_t key = makeBlockKey(backing, device, sector);
+  *blockPtr = intMapGet(backing->blocks, key);
+  if (*blockPtr != NULL) {
+    return VDO_SUCCESS;
+  }
+
+  char *block;
+  int result = allocateBlock(backing, &block);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  if (fetch) {
+    result = readFromDevice(backing, device, sector, block);
+  }
+
+  if (result == VDO_SUCCESS) {
+    result = intMapPut(backing->blocks, key, block, false, NULL);
+  }
+
+  if (result != VDO_SUCCESS) {
+    // The block was the last one handed out, so it can be taken back.
+    backing->extentBlocksUsed--;
+    return result;
+  }
+
+  *blockPtr = block;
+  return VDO_SUCCESS;
+}
+
+/**
+ * Zero the blocks covered by a discard.
+ *
+ * @param backing  The RAM backing
+ * @param device   The device the bio would have been sent to
+ * @param bio      The discard bio
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+static int discardBlocks(RAMBacking          *backing,
+                         struct block_device *device,
+                         BIO                 *bio)
+{
+  sector_t sector = getBioSector(bio);
+  for (unsigned int done = 0; done < getBioSize(bio);
+       done += VDO_BLOCK_SIZE, sector += VDO_SECTORS_PER_BLOCK) {
+    char *block;
+    int result = getBlock(backing, device, sector, false, &block);
+    if (result != VDO_SUCCESS) {
+      return result;
+    }
+    memset(block, 0, VDO_BLOCK_SIZE);
+  }
+
+  return VDO_SUCCESS;
+}
+
+/**
+ * Copy the data of a bio to or from the blocks it covers.
+ *
+ * @param backing  The RAM backing
+ * @param device   The device the bio would have been sent to
+ * @param bio      The bio
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+static int transferBlocks(RAMBacking          *backing,
+                          struct block_device *device,
+                          BIO                 *bio)
+{
+  bool          isWrite = isWriteBio(bio);
+  sector_t      sector  = getBioSector(bio);
+  char         *block   = NULL;
+  unsigned int  offset  = 0;
+  struct bio_vec *biovec;
+  for (BioIterator iter = createBioIterator(bio);
+       (biovec = getNextBiovec(&iter)) != NULL;
+       advanceBioIterator(&iter)) {
+    char         *buffer = page_address(biovec->bv_page) + biovec->bv_offset;
+    unsigned int  length = biovec->bv_len;
+    while (length > 0) {
+      if (block == NULL) {
+        int result = getBlock(backing, device, sector, !isWrite, &block);
+        if (result != VDO_SUCCESS) {
+          return result;
+        }
+      }
+
+      unsigned int bytes = minUInt64(length, VDO_BLOCK_SIZE - offset);
+      if (isWrite) {
+        memcpy(block + offset, buffer, bytes);
+      } else {
+        memcpy(buffer, block + offset, bytes);
+      }
+
+      buffer += bytes;
+      length -= bytes;
+      offset += bytes;
+      if (offset == VDO_BLOCK_SIZE) {
+        block   = NULL;
+        offset  = 0;
+        sector += VDO_SECTORS_PER_BLOCK;
+      }
+    }
+
+    if (!isWrite) {
+      flush_dcache_page(biovec->bv_page);
+    }
+  }
+
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void submitToRAMBacking(RAMBacking          *backing,
+                        struct block_device *device,
+                        BIO                 *bio)
+{
+  // Flushes have nothing to do, since nothing held in memory is durable.
+  if (getBioSize(bio) == 0) {
+    completeBio(bio, 0);
+    return;
+  }
+
+  // The pool only does whole block I/O, which is all this keeps track of.
+  if (((getBioSector(bio) % VDO_SECTORS_PER_BLOCK) != 0)
+      || ((getBioSize(bio) % VDO_BLOCK_SIZE) != 0)) {
+    completeBio(bio, -EIO);
+    return;
+  }
+
+  mutex_lock(&backing->mutex);
+  int result = (isDiscardBio(bio)
+                ? discardBlocks(backing, device, bio)
+                : transferBlocks(backing, device, bio));
+  mutex_unlock(&backing->mutex);
+  completeBio(bio, ((result == VDO_SUCCESS) ? 0 : -EIO));
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/ramBacking.h#1 $
+ */
+
+#ifndef RAM_BACKING_H
+#define RAM_BACKING_H
+
+#include <linux/blkdev.h>
+
+#include "kernelTypes.h"
+
+/**
+ * The in-memory storage of a pool whose table asks for RAM backing. Every
+ * bio the pool would send to its devices is completed from memory instead,
+ * so that the cost of the VDO pipeline can be measured apart from the cost
+ * of the storage. A block is read from the device the first time it is
+ * read, so that a formatted pool loads as usual; it is never written back.
+ **/
+typedef struct ramBacking RAMBacking;
+
+/**
+ * Make the RAM backing of a layer.
+ *
+ * @param [in]  layer       The layer whose I/O will be held in memory
+ * @param [out] backingPtr  A pointer to hold the new backing
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+int makeRAMBacking(KernelLayer *layer, RAMBacking **backingPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free the RAM backing of a layer, discarding everything written to it, and
+ * null out the reference to it. There must be no I/O in progress.
+ *
+ * @param backingPtr  The reference to the backing to free
+ **/
+void freeRAMBacking(RAMBacking **backingPtr);
+
+/**
+ * Complete a bio from memory rather than sending it to a device. This may
+ * block, since blocks not yet held are read from the device, so it must
+ * only be called where a bio could be submitted to the device.
+ *
+ * @param backing  The RAM backing
+ * @param device   The device the bio would have been sent to
+ * @param bio      The bio
+ **/
+void submitToRAMBacking(RAMBacking          *backing,
+                        struct block_device *device,
+                        BIO                 *bio);
+
+#endif // RAM_BACKING_H
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/readAhead.c#1 $
+ */
+
+#include "readAhead.h"
+
+#include <linux/sort.h>
+
+#include "memoryAlloc.h"
+#include "numeric.h"
+
+#include "constants.h"
+#include "statusCodes.h"
+
+#include "bio.h"
+#include "bufferPool.h"
+#include "ioSubmitter.h"
+#include "kernelLayer.h"
+#include "limiter.h"
+#include "physicalBlockCache.h"
+
+enum {
+  /** The number of blocks which may be read ahead at once */
+  READ_AHEAD_BUFFERS = 64,
+  /** The most blocks taken from one prefetch request */
+  READ_AHEAD_BATCH   = 16,
+};
+
+typedef struct {
+  /** The work item for submitting the read and for finishing it */
+  KvdoWorkItem         workItem;
+  /** The layer doing the read */
+  KernelLayer         *layer;
+  /** The block being read */
+  PhysicalBlockNumber  pbn;
+  /** The cache stamp from when the block was found not to be cached */
+  uint64_t             stamp;
+  /** The result of the read */
+  int                  result;
+  /** The buffer holding the block */
+  char                *data;
+  /** The bio reading the block into data */
+  BIO                 *bio;
+} ReadAheadBuffer;
+
+struct readAhead {
+  /** The count of buffers in use, for waiting on idle */
+  Limiter     active;
+  /** The staging buffers */
+  BufferPool *pool;
+};
+
+/**
+ * Make a staging buffer. Implements BufferAllocateFunction.
+ **/
+static int makeReadAheadBuffer(void *poolData, void **dataPtr)
+{
+  KernelLayer     *layer = poolData;
+  ReadAheadBuffer *buffer;
+  int result = ALLOCATE(1, ReadAheadBuffer, __func__, &buffer);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  buffer->layer = layer;
+  result = ALLOCATE(VDO_BLOCK_SIZE, char, "read-ahead data", &buffer->data);
+  if (result != VDO_SUCCESS) {
+    FREE(buffer);
+    return result;
+  }
+
+  result = createBio(layer, buffer->data, &buffer->bio);
+  if (result != VDO_SUCCESS) {
+    FREE(buffer->data);
+    FREE(buffer);
+    return result;
+  }
+
+  *dataPtr = buffer;
+  return VDO_SUCCESS;
+}
+
+/**
+ * Free a staging buffer. Implements BufferFreeFunction.
+ **/
+static void freeReadAheadBuffer(void *poolData, void *data)
+{
+  ReadAheadBuffer *buffer = data;
+  freeBio(buffer->bio, poolData);
+  FREE(buffer->data);
+  FREE(buffer);
+}
+
+/**********************************************************************/
+int makeReadAhead(KernelLayer *layer, ReadAhead **readAheadPtr)
+{
+  ReadAhead *readAhead;
+  int result = ALLOCATE(1, ReadAhead, __func__, &readAhead);
+  if (result != VDO_SUCCESS) {
+    return result;
+  }
+
+  initializeLimiter(&readAhead->active, READ_AHEAD_BUFFERS);
+  result = makeBufferPool("Read-ahead Pool", READ_AHEAD_BUFFERS,
+                          makeReadAheadBuffer, freeReadAheadBuffer, NULL,
+                          layer, &readAhead->pool);
+  if (result != VDO_SUCCESS) {
+    FREE(readAhead);
+    return result;
+  }
+
+  *readAheadPtr = readAhead;
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+void freeReadAhead(ReadAhead **readAheadPtr)
+{
+  ReadAhead *readAhead = *readAheadPtr;
+  if (readAhead == NULL) {
+    return;
+  }
+
+  freeBufferPool(&readAhead->pool);
+  FREE(readAhead);
+  *readAheadPtr = NULL;
+}
+
+/**********************************************************************/
+void waitForReadAheadIdle(ReadAhead *readAhead)
+{
+  limiterWaitForIdle(&readAhead->active);
+}
+
+/**
+ * Cache a block which has been read ahead, and release its buffer. This
+ * callback is registered in completeReadAhead().
+ *
+ * @param item  The work item of the buffer
+ **/
+static void finishReadAhead(KvdoWorkItem *item)
+{
+  ReadAheadBuffer *buffer    = container_of(item, ReadAheadBuffer, workItem);
+  KernelLayer     *layer     = buffer->layer;
+  ReadAhead       *readAhead = layer->readAhead;
+  if (buffer->result == VDO_SUCCESS) {
+    cacheBlock(layer->physicalBlockCache, buffer->pbn, buffer->stamp,
+               buffer->data, false);
+  }
+
+  freeBufferToPool(readAhead->pool, buffer);
+  limiterRelease(&readAhead->active);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
+/**
+ * Callback for a bio reading ahead.
+ *
+ * @param bio     The bio
+ */
+static void completeReadAhead(BIO *bio)
+#else
+/**
+ * Callback for a bio reading ahead.
+ *
+ * @param bio     The bio
+ * @param result  The result of the read operation
+ */
+static void completeReadAhead(BIO *bio, int result)
+#endif
+{
+  ReadAheadBuffer *buffer = bio->bi_private;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0)
+  buffer->result = getBioResult(bio);
+#else
+  buffer->result = result;
+#endif
+  // Copying the block into the cache is left to a CPU thread.
+  setupWorkItem(&buffer->workItem, finishReadAhead, NULL,
+                CPU_Q_ACTION_READ_AHEAD);
+  enqueueCPUWorkQueue(buffer->layer, &buffer->workItem);
+}
+
+/**
+ * Send a read-ahead bio to the storage. This callback is registered in
+ * kvdoPrefetchData().
+ *
+ * @param item  The work item of the buffer
+ **/
+static void submitReadAhead(KvdoWorkItem *item)
+{
+  ReadAheadBuffer *buffer = container_of(item, ReadAheadBuffer, workItem);
+  KernelLayer *layer = buffer->layer;
+  atomic64_inc(&layer->readAheadReads);
+  if (layer->ramBacking != NULL) {
+    submitToRAMBacking(layer->ramBacking, getKernelLayerBdev(layer),
+                       buffer->bio);
+    return;
+  }
+
+  generic_make_request(buffer->bio);
+}
+
+/**
+ * Compare two physical block numbers for sort().
+ **/
+static int comparePBNs(const void *first, const void *second)
+{
+  PhysicalBlockNumber a = *((const PhysicalBlockNumber *) first);
+  PhysicalBlockNumber b = *((const PhysicalBlockNumber *) second);
+  if (a == b) {
+    return 0;
+  }
+  return ((a < b) ? -1 : 1);
+}
+
+/**********************************************************************/
+void kvdoPrefetchData(PhysicalLayer             *common,
+                      const PhysicalBlockNumber *pbns,
+                      BlockCount                 count)
+{
+  KernelLayer *layer     = asKernelLayer(common);
+  ReadAhead   *readAhead = layer->readAhead;
+
+  // Issue the reads in block order so the storage sees them as a stream.
+  PhysicalBlockNumber sorted[READ_AHEAD_BATCH];
+  count = minUInt64(count, READ_AHEAD_BATCH);
+  memcpy(sorted, pbns, count * sizeof(PhysicalBlockNumber));
+  sort(sorted, count, sizeof(PhysicalBlockNumber), comparePBNs, NULL);
+
+  for (BlockCount i = 0; i < count; i++) {
+    if ((i > 0) && (sorted[i] == sorted[i - 1])) {
+      // Several fragments of one compressed block.
+      continue;
+    }
+
+    uint64_t stamp;
+    if (isBlockCached(layer->physicalBlockCache, sorted[i], &stamp)) {
+      continue;
+    }
+
+    if (!limiterPoll(&readAhead->active)) {
+      return;
+    }
+
+    ReadAheadBuffer *buffer;
+    int result = allocBufferFromPool(readAhead->pool, (void **) &buffer);
+    if (result != VDO_SUCCESS) {
+      limiterRelease(&readAhead->active);
+      return;
+    }
+
+    buffer->pbn   = sorted[i];
+    buffer->stamp = stamp;
+
+    BIO *bio = buffer->bio;
+    resetBio(bio, layer);
+    setBioSector(bio, blockToSector(layer, buffer->pbn));
+    setBioOperationRead(bio);
+    bio->bi_private = buffer;
+    bio->bi_end_io  = completeReadAhead;
+    setupWorkItem(&buffer->workItem, submitReadAhead, NULL,
+                  BIO_Q_ACTION_READCACHE);
+    enqueueBioWorkItem(layer->ioSubmitter, &buffer->workItem);
+  }
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/readAhead.h#1 $
+ */
+
+#ifndef READ_AHEAD_H
+#define READ_AHEAD_H
+
+#include "physicalLayer.h"
+
+#include "kernelTypes.h"
+
+/**
+ * The data read-ahead of a pool. When the block map sees a zone's reads
+ * following the logical block order, it hands the layer the mapped blocks
+ * of the next few logical blocks. Those blocks are read into a small set of
+ * staging buffers and then put in the physical block cache, where the
+ * sequential reads which follow find them.
+ **/
+typedef struct readAhead ReadAhead;
+
+/**
+ * Make the read-ahead state of a layer.
+ *
+ * @param [in]  layer         The layer which will read ahead
+ * @param [out] readAheadPtr  A pointer to hold the new read-ahead state
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+int makeReadAhead(KernelLayer *layer, ReadAhead **readAheadPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free the read-ahead state of a layer and null out the reference to it.
+ * There must be no read-ahead in progress.
+ *
+ * @param readAheadPtr  The reference to the read-ahead state to free
+ **/
+void freeReadAhead(ReadAhead **readAheadPtr);
+
+/**
+ * Wait for all read-ahead in progress to finish.
+ *
+ * @param readAhead  The read-ahead state
+ **/
+void waitForReadAheadIdle(ReadAhead *readAhead);
+
+/**
+ * Implements DataPrefetcher. Blocks which are already cached are skipped,
+ * only the first few blocks of a long request are considered, and when all
+ * the staging buffers are busy the remaining blocks are simply not read
+ * ahead.
+ **/
+void kvdoPrefetchData(PhysicalLayer             *layer,
+                      const PhysicalBlockNumber *pbns,
+                      BlockCount                 count);
+
+#endif // READ_AHEAD_H
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/sharedWorkQueue.c#1 $
+ */
+
+#include "sharedWorkQueue.h"
+
+#include <linux/mutex.h>
+
+#include "logger.h"
+
+#include "dmvdo.h"
+
+unsigned int sharedBioAckThreads = 0;
+
+static DEFINE_MUTEX(sharedQueueMutex);
+static KvdoWorkQueue *sharedBioAckQueue      = NULL;
+static unsigned int   sharedBioAckQueueUsers = 0;
+
+/**********************************************************************/
+int acquireSharedBioAckQueue(const KvdoWorkQueueType  *type,
+                             KvdoWorkQueue           **queuePtr)
+{
+  int result = VDO_SUCCESS;
+  mutex_lock(&sharedQueueMutex);
+  if (sharedBioAckQueue == NULL) {
+    unsigned int threads = READ_ONCE(sharedBioAckThreads);
+    if (threads > 0) {
+      // The queue belongs to no layer, which marks it as shared.
+      result = makeWorkQueue("kvdo", "sharedAckQ", &kvdoDevice.kobj, NULL,
+                             NULL, type, threads, &sharedBioAckQueue);
+      if (result != VDO_SUCCESS) {
+        logError("cannot make shared bio ack queue: %d", result);
+        sharedBioAckQueue = NULL;
+      }
+    }
+  }
+
+  if (sharedBioAckQueue != NULL) {
+    sharedBioAckQueueUsers++;
+  }
+  *queuePtr = sharedBioAckQueue;
+  mutex_unlock(&sharedQueueMutex);
+  return result;
+}
+
+/**********************************************************************/
+void releaseSharedBioAckQueue(KvdoWorkQueue **queuePtr)
+{
+  if (*queuePtr == NULL) {
+    return;
+  }
+
+  mutex_lock(&sharedQueueMutex);
+  if (--sharedBioAckQueueUsers == 0) {
+    finishWorkQueue(sharedBioAckQueue);
+    freeWorkQueue(&sharedBioAckQueue);
+  }
+  mutex_unlock(&sharedQueueMutex);
+  *queuePtr = NULL;
+}
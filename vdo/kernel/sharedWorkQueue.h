@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/sharedWorkQueue.h#1 $
+ */
+
+#ifndef SHARED_WORK_QUEUE_H
+#define SHARED_WORK_QUEUE_H
+
+#include "workQueue.h"
+
+enum {
+  /** The most threads the shared bio ack queue may be configured with */
+  MAXIMUM_SHARED_BIO_ACK_THREADS = 100,
+};
+
+/**
+ * The number of threads in the bio ack queue shared by all VDO devices, or
+ * 0 if each device acknowledges bios on its own threads. A change only
+ * affects devices started once no running device is using the shared queue.
+ **/
+extern unsigned int sharedBioAckThreads;
+
+/**
+ * Get a reference to the bio ack queue shared by all VDO devices, making the
+ * queue if no device is using it.
+ *
+ * @param [in]  type      The type of the bio ack queue
+ * @param [out] queuePtr  A pointer to hold the shared queue, or NULL if the
+ *                        queue is not shared
+ *
+ * @return VDO_SUCCESS or an error
+ **/
+int acquireSharedBioAckQueue(const KvdoWorkQueueType  *type,
+                             KvdoWorkQueue           **queuePtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Release a reference to the shared bio ack queue, stopping and freeing the
+ * queue if this was the last reference, and null out the pointer. The
+ * caller must ensure that none of its work is still on the queue.
+ *
+ * @param queuePtr  The reference to release
+ **/
+void releaseSharedBioAckQueue(KvdoWorkQueue **queuePtr);
+
+/**
+ * Check whether a work queue is shared by all VDO devices rather than owned
+ * by one of them.
+ *
+ * @param queue  The work queue
+ *
+ * @return <code>true</code> if the queue is shared
+ **/
+static inline bool isSharedWorkQueue(KvdoWorkQueue *queue)
+{
+  return (getWorkQueueOwner(queue) == NULL);
+}
+
+#endif // SHARED_WORK_QUEUE_H
@@ -26,10 +26,13 @@
  *
  * +--+-----  /proc/vdo           procfsRoot
  *    |
+ *    +-------  trace_buffer      binary records from the trace buffers
+ *    |
  *    +-+-----  vdo<n>            config->poolName
  *      |
  *      +-------  dedupe_stats    GET_DEDUPE_STATS ioctl
  *      +-------  kernel_stats    GET_KERNEL_STATS ioctl
+ *      +-------  pool_stats      both of the above, from one snapshot
  *
  */
 #include "statusProcfs.h"
@@ -52,6 +55,10 @@
 
 static struct proc_dir_entry *procfsRoot = NULL;
 
+static const char *POOL_STATS_PROC_FILE = "pool_stats";
+
+static const char *TRACE_BUFFER_PROC_FILE = "trace_buffer";
+
 /**********************************************************************/
 static int statusDedupeShow(struct seq_file *m, void *v)
 {
@@ -124,6 +131,7 @@ void getKernelStats(KernelLayer *layer, KernelStatistics *stats)
   stats->dedupeAdviceTimeouts = (getEventCount(&layer->albireoTimeoutReporter)
                                  + atomic64_read(&layer->dedupeContextBusy));
   stats->flushOut             = atomic64_read(&layer->flushOut);
+  stats->flushesCoalesced     = atomic64_read(&layer->flushesCoalesced);
   stats->logicalBlockSize     = layer->deviceConfig->logicalBlockSize;
   copyBioStat(&stats->biosIn, &layer->biosIn);
   copyBioStat(&stats->biosInPartial, &layer->biosInPartial);
@@ -141,8 +149,64 @@ void getKernelStats(KernelLayer *layer, KernelStatistics *stats)
               &layer->biosAcknowledgedPartial);
   stats->biosInProgress = subtractBioStats(stats->biosIn,
                                            stats->biosAcknowledged);
+  stats->biosCoalesced = atomic64_read(&layer->biosCoalesced);
+  stats->biosCoalescedMembers = atomic64_read(&layer->biosCoalescedMembers);
+  stats->patternBlocksNamed = atomic64_read(&layer->patternBlocksNamed);
+  stats->completionThreadHops = atomic64_read(&layer->completionThreadHops);
+  stats->completionsRequeued = atomic64_read(&layer->completionsRequeued);
+  stats->compressedBlockCacheHits
+    = atomic64_read(&layer->compressedBlockCacheHits);
+  stats->compressedBlockCacheMisses
+    = atomic64_read(&layer->compressedBlockCacheMisses);
+  stats->readAheadReads = atomic64_read(&layer->readAheadReads);
+  stats->readAheadHits = atomic64_read(&layer->readAheadHits);
+  stats->repeatedReadsCached = atomic64_read(&layer->repeatedReadsCached);
+  stats->repeatedReadCacheHits
+    = atomic64_read(&layer->repeatedReadCacheHits);
+  stats->sharedBioAcks = atomic64_read(&layer->bioAckShare.items);
+  stats->sharedBioAckMicroseconds
+    = atomic64_read(&layer->bioAckShare.runTime) / 1000;
+  stats->speculativeCompressions
+    = atomic64_read(&layer->speculativeCompressions);
+  stats->speculativeCompressionsUsed
+    = atomic64_read(&layer->speculativeCompressionsUsed);
+  stats->blockMapCacheReclaimedPages
+    = atomic64_read(&layer->blockMapCacheReclaimedPages);
+  stats->blockMapCacheRegrownPages
+    = atomic64_read(&layer->blockMapCacheRegrownPages);
   stats->memoryUsage = getMemoryUsage();
   getIndexStatistics(layer->dedupeIndex, &stats->index);
+  stats->compressionEstimate = (CompressionEstimateStatistics) {
+    .skipped        = atomic64_read(&layer->compressionEstimateSkipped),
+    .audited        = atomic64_read(&layer->compressionEstimateAudited),
+    .wronglySkipped
+      = atomic64_read(&layer->compressionEstimateWronglySkipped),
+    .missed         = atomic64_read(&layer->compressionEstimateMissed),
+  };
+}
+
+/**
+ * Take a snapshot of all of the statistics of a layer into its
+ * vdoStatsStorage and kernelStatsStorage. The caller must hold the layer's
+ * statsMutex.
+ *
+ * @param layer    the kernel layer
+ */
+static void takePoolStatsSnapshot(KernelLayer *layer)
+{
+  getKVDOStatistics(&layer->kvdo, &layer->vdoStatsStorage);
+  getKernelStats(layer, &layer->kernelStatsStorage);
+  layer->statsSnapshotTaken = true;
+  layer->statsSnapshotTime  = jiffies;
+}
+
+/**********************************************************************/
+void refreshPoolStats(KernelLayer *layer)
+{
+  if (!layer->statsSnapshotTaken
+      || time_after(jiffies, layer->statsSnapshotTime + HZ)) {
+    takePoolStatsSnapshot(layer);
+  }
 }
 
 /**********************************************************************/
@@ -182,6 +246,43 @@ static const struct file_operations vdoProcfsKernelOps = {
   .release = single_release,
 };
 
+/**
+ * Write a VDOStatistics followed by a KernelStatistics, both taken from one
+ * fresh snapshot, so that a monitor can read everything at once.
+ **/
+static int statusPoolShow(struct seq_file *m, void *v)
+{
+  KernelLayer *layer = (KernelLayer *) m->private;
+  RegisteredThread allocatingThread, instanceThread;
+  registerAllocatingThread(&allocatingThread, NULL);
+  registerThreadDevice(&instanceThread, layer);
+  mutex_lock(&layer->statsMutex);
+  takePoolStatsSnapshot(layer);
+  seq_write(m, &layer->vdoStatsStorage, sizeof(VDOStatistics));
+  seq_write(m, &layer->kernelStatsStorage, sizeof(KernelStatistics));
+  mutex_unlock(&layer->statsMutex);
+  unregisterThreadDeviceID();
+  unregisterAllocatingThread();
+  return VDO_SUCCESS;
+}
+
+/**********************************************************************/
+static int statusPoolOpen(struct inode *inode, struct file *file)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0)
+  return single_open(file, statusPoolShow, PDE_DATA(inode));
+#else
+  return single_open(file, statusPoolShow, PDE(inode)->data);
+#endif
+}
+
+static const struct file_operations vdoProcfsPoolOps = {
+  .open = statusPoolOpen,
+  .read = seq_read,
+  .llseek = seq_lseek,
+  .release = single_release,
+};
+
 /**********************************************************************/
 int vdoInitProcfs()
 {
@@ -191,12 +292,20 @@ int vdoInitProcfs()
     logWarning("Could not create proc filesystem root %s\n", procfsName);
     return -ENOMEM;
   }
+
+  if (proc_create_data(TRACE_BUFFER_PROC_FILE, 0400, procfsRoot,
+                       &traceBufferOps, NULL) == NULL) {
+    logWarning("Could not create proc file %s\n", TRACE_BUFFER_PROC_FILE);
+  }
   return VDO_SUCCESS;
 }
 
 /**********************************************************************/
 void vdoDestroyProcfs()
 {
+  if (procfsRoot != NULL) {
+    remove_proc_entry(TRACE_BUFFER_PROC_FILE, procfsRoot);
+  }
   remove_proc_entry(getProcRoot(), NULL);
   procfsRoot = NULL;
 }
@@ -218,6 +327,9 @@ int vdoCreateProcfsEntry(KernelLayer *layer, const char *name, void **private)
       } else if (proc_create_data(getKernelStatisticsProcFile(), 0644, fsDir,
                                   &vdoProcfsKernelOps, layer) == NULL) {
         result = -ENOMEM;
+      } else if (proc_create_data(POOL_STATS_PROC_FILE, 0644, fsDir,
+                                  &vdoProcfsPoolOps, layer) == NULL) {
+        result = -ENOMEM;
       }
     }
     if (result < 0) {
@@ -241,6 +353,7 @@ void vdoDestroyProcfsEntry(const char *name, void *private)
     struct proc_dir_entry *fsDir = (struct proc_dir_entry *) private;
     remove_proc_entry(getVDOStatisticsProcFile(), fsDir);
     remove_proc_entry(getKernelStatisticsProcFile(), fsDir);
+    remove_proc_entry(POOL_STATS_PROC_FILE, fsDir);
     remove_proc_entry(name, procfsRoot);
 #endif
   }
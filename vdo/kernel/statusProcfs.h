@@ -70,4 +70,16 @@ void vdoDestroyProcfsEntry(const char *name, void *private);
  */
 void getKernelStats(KernelLayer *layer, KernelStatistics *stats);
 
+/**
+ * Make sure the layer's vdoStatsStorage and kernelStatsStorage hold a
+ * snapshot of the statistics no more than a second old. Gathering the VDO
+ * statistics visits every zone thread, so reading each sysfs statistic
+ * would otherwise cost a round trip through all of them; instead, a scrape
+ * of the whole statistics directory shares one snapshot. The caller must
+ * hold the layer's statsMutex.
+ *
+ * @param layer    the kernel layer
+ */
+void refreshPoolStats(KernelLayer *layer);
+
 #endif  /* STATUS_PROC_H */
@@ -24,9 +24,16 @@
 #include <linux/module.h>
 #include <linux/version.h>
 
+#include "forest.h"
+#include "physicalZone.h"
+
+#include "dataKVIO.h"
 #include "dedupeIndex.h"
 #include "dmvdo.h"
+#include "ioSubmitter.h"
 #include "logger.h"
+#include "sharedWorkQueue.h"
+#include "workItemStats.h"
 
 extern int defaultMaxRequestsActive;
 
@@ -174,6 +181,55 @@ static ssize_t vdoTraceRecordingStore(struct kvdoDevice *device,
   return scanBool(buf, n, &traceRecording);
 }
 
+/**********************************************************************/
+static ssize_t vdoTraceBufferingStore(struct kvdoDevice *device,
+                                      const char        *buf,
+                                      size_t             n)
+{
+  bool enable;
+  ssize_t result = scanBool(buf, n, &enable);
+  if (result <= 0) {
+    return result;
+  }
+
+  if (setTraceBuffering(enable) != VDO_SUCCESS) {
+    return -ENOMEM;
+  }
+  return result;
+}
+
+/**********************************************************************/
+static ssize_t vdoCompressibilityEstimationStore(struct kvdoDevice *device,
+                                                 const char        *buf,
+                                                 size_t             n)
+{
+  return scanBool(buf, n, &compressibilityEstimation);
+}
+
+/**********************************************************************/
+static ssize_t vdoDirectBioSubmissionStore(struct kvdoDevice *device,
+                                           const char        *buf,
+                                           size_t             n)
+{
+  return scanBool(buf, n, &directBioSubmission);
+}
+
+/**********************************************************************/
+static ssize_t vdoWorkStealingStore(struct kvdoDevice *device,
+                                    const char        *buf,
+                                    size_t             n)
+{
+  return scanBool(buf, n, &workStealing);
+}
+
+/**********************************************************************/
+static ssize_t vdoWorkItemTimingStore(struct kvdoDevice *device,
+                                      const char        *buf,
+                                      size_t             n)
+{
+  return scanBool(buf, n, &workItemTiming);
+}
+
 /**********************************************************************/
 static ssize_t vdoMaxReqActiveStore(struct kvdoDevice *device,
                                     const char        *buf,
@@ -214,6 +270,137 @@ static ssize_t vdoMinAlbireoTimerIntervalStore(struct kvdoDevice *device,
   return result;
 }
 
+/**********************************************************************/
+static ssize_t vdoAdaptiveAlbireoTimeoutStore(struct kvdoDevice *device,
+                                              const char        *buf,
+                                              size_t             n)
+{
+  return scanBool(buf, n, &adaptiveAlbireoTimeout);
+}
+
+/**********************************************************************/
+static ssize_t vdoTraversalReadDepthShow(struct kvdoDevice *device,
+                                         struct attribute  *attr,
+                                         char              *buf)
+{
+  return sprintf(buf, "%u\n", getForestTraversalReadDepth());
+}
+
+/**********************************************************************/
+static ssize_t vdoTraversalReadDepthStore(struct kvdoDevice *device,
+                                          const char        *buf,
+                                          size_t             n)
+{
+  unsigned int value;
+  ssize_t result = scanUInt(buf, n, &value, 1, MAXIMUM_TRAVERSAL_READ_DEPTH);
+  if (result > 0) {
+    setForestTraversalReadDepth(value);
+  }
+  return result;
+}
+
+/**********************************************************************/
+static ssize_t vdoDeferredDecrementsShow(struct kvdoDevice *device,
+                                         struct attribute  *attr,
+                                         char              *buf)
+{
+  return sprintf(buf, "%u\n", getDeferredDecrements() ? 1 : 0);
+}
+
+/**********************************************************************/
+static ssize_t vdoDeferredDecrementsStore(struct kvdoDevice *device,
+                                          const char        *buf,
+                                          size_t             n)
+{
+  bool value;
+  ssize_t result = scanBool(buf, n, &value);
+  if (result > 0) {
+    setDeferredDecrements(value);
+  }
+  return result;
+}
+
+/**********************************************************************/
+static ssize_t vdoIndexReadQueueDepthStore(struct kvdoDevice *device,
+                                           const char        *buf,
+                                           size_t             n)
+{
+  return scanUInt(buf, n, &indexReadQueueDepth, 0, INT_MAX);
+}
+
+/**********************************************************************/
+static ssize_t vdoBatchedDedupeCallbacksStore(struct kvdoDevice *device,
+                                              const char        *buf,
+                                              size_t             n)
+{
+  return scanBool(buf, n, &batchedDedupeCallbacks);
+}
+
+/**********************************************************************/
+static ssize_t vdoSpeculativeCompressionStore(struct kvdoDevice *device,
+                                              const char        *buf,
+                                              size_t             n)
+{
+  return scanBool(buf, n, &speculativeCompression);
+}
+
+/**********************************************************************/
+static ssize_t vdoSharedBioAckThreadsStore(struct kvdoDevice *device,
+                                           const char        *buf,
+                                           size_t             n)
+{
+  return scanUInt(buf, n, &sharedBioAckThreads, 0,
+                  MAXIMUM_SHARED_BIO_ACK_THREADS);
+}
+
+/**********************************************************************/
+static ssize_t vdoIndexLazyLoadStore(struct kvdoDevice *device,
+                                     const char        *buf,
+                                     size_t             n)
+{
+  return scanBool(buf, n, &indexLazyLoad);
+}
+
+/**********************************************************************/
+static ssize_t vdoIndexMemoryBudgetStore(struct kvdoDevice *device,
+                                         const char        *buf,
+                                         size_t             n)
+{
+  return scanUInt(buf, n, &indexMemoryBudget, 0, UINT_MAX);
+}
+
+/**********************************************************************/
+static ssize_t vdoIndexZoneCountStore(struct kvdoDevice *device,
+                                      const char        *buf,
+                                      size_t             n)
+{
+  return scanUInt(buf, n, &indexZoneCount, 0, INT_MAX);
+}
+
+/**********************************************************************/
+static ssize_t vdoIndexDirectReadsStore(struct kvdoDevice *device,
+                                        const char        *buf,
+                                        size_t             n)
+{
+  return scanBool(buf, n, &indexDirectReads);
+}
+
+/**********************************************************************/
+static ssize_t vdoAdaptiveDedupeBypassStore(struct kvdoDevice *device,
+                                            const char        *buf,
+                                            size_t             n)
+{
+  return scanBool(buf, n, &adaptiveDedupeBypass);
+}
+
+/**********************************************************************/
+static ssize_t vdoDedupeBypassSampleIntervalStore(struct kvdoDevice *device,
+                                                  const char        *buf,
+                                                  size_t             n)
+{
+  return scanUInt(buf, n, &dedupeBypassSampleInterval, 1, UINT_MAX);
+}
+
 /**********************************************************************/
 static ssize_t vdoVersionShow(struct kvdoDevice *device,
                               struct attribute  *attr,
@@ -283,6 +470,81 @@ static VDOAttribute vdoMinAlbireoTimerInterval = {
   .valuePtr = &minAlbireoTimerInterval,
 };
 
+static VDOAttribute vdoAdaptiveAlbireoTimeout = {
+  .attr     = {.name = "deduplication_adaptive_timeout", .mode = 0644, },
+  .show     = showBool,
+  .store    = vdoAdaptiveAlbireoTimeoutStore,
+  .valuePtr = &adaptiveAlbireoTimeout,
+};
+
+static VDOAttribute vdoIndexReadQueueDepth = {
+  .attr     = {.name = "deduplication_read_queue_depth", .mode = 0644, },
+  .show     = showUInt,
+  .store    = vdoIndexReadQueueDepthStore,
+  .valuePtr = &indexReadQueueDepth,
+};
+
+static VDOAttribute vdoBatchedDedupeCallbacks = {
+  .attr     = {.name = "deduplication_batched_callbacks", .mode = 0644, },
+  .show     = showBool,
+  .store    = vdoBatchedDedupeCallbacksStore,
+  .valuePtr = &batchedDedupeCallbacks,
+};
+
+static VDOAttribute vdoTraversalReadDepth = {
+  .attr     = {.name = "block_map_traversal_read_depth", .mode = 0644, },
+  .show     = vdoTraversalReadDepthShow,
+  .store    = vdoTraversalReadDepthStore,
+};
+
+static VDOAttribute vdoDeferredDecrements = {
+  .attr     = {.name = "deferred_decrements", .mode = 0644, },
+  .show     = vdoDeferredDecrementsShow,
+  .store    = vdoDeferredDecrementsStore,
+};
+
+static VDOAttribute vdoIndexLazyLoad = {
+  .attr     = {.name = "deduplication_lazy_load", .mode = 0644, },
+  .show     = showBool,
+  .store    = vdoIndexLazyLoadStore,
+  .valuePtr = &indexLazyLoad,
+};
+
+static VDOAttribute vdoIndexMemoryBudget = {
+  .attr     = {.name = "deduplication_memory_budget_mb", .mode = 0644, },
+  .show     = showUInt,
+  .store    = vdoIndexMemoryBudgetStore,
+  .valuePtr = &indexMemoryBudget,
+};
+
+static VDOAttribute vdoIndexZoneCount = {
+  .attr     = {.name = "deduplication_zones", .mode = 0644, },
+  .show     = showUInt,
+  .store    = vdoIndexZoneCountStore,
+  .valuePtr = &indexZoneCount,
+};
+
+static VDOAttribute vdoIndexDirectReads = {
+  .attr     = {.name = "deduplication_direct_reads", .mode = 0644, },
+  .show     = showBool,
+  .store    = vdoIndexDirectReadsStore,
+  .valuePtr = &indexDirectReads,
+};
+
+static VDOAttribute vdoAdaptiveDedupeBypass = {
+  .attr     = {.name = "deduplication_adaptive_bypass", .mode = 0644, },
+  .show     = showBool,
+  .store    = vdoAdaptiveDedupeBypassStore,
+  .valuePtr = &adaptiveDedupeBypass,
+};
+
+static VDOAttribute vdoDedupeBypassSampleInterval = {
+  .attr     = {.name = "deduplication_bypass_sample_interval", .mode = 0644, },
+  .show     = showUInt,
+  .store    = vdoDedupeBypassSampleIntervalStore,
+  .valuePtr = &dedupeBypassSampleInterval,
+};
+
 static VDOAttribute vdoTraceRecording = {
   .attr     = {.name = "trace_recording", .mode = 0644, },
   .show     = showBool,
@@ -290,6 +552,55 @@ static VDOAttribute vdoTraceRecording = {
   .valuePtr = &traceRecording,
 };
 
+static VDOAttribute vdoTraceBuffering = {
+  .attr     = {.name = "trace_buffering", .mode = 0644, },
+  .show     = showBool,
+  .store    = vdoTraceBufferingStore,
+  .valuePtr = &traceBuffering,
+};
+
+static VDOAttribute vdoCompressibilityEstimation = {
+  .attr     = {.name = "compressibility_estimation", .mode = 0644, },
+  .show     = showBool,
+  .store    = vdoCompressibilityEstimationStore,
+  .valuePtr = &compressibilityEstimation,
+};
+
+static VDOAttribute vdoDirectBioSubmission = {
+  .attr     = {.name = "direct_bio_submission", .mode = 0644, },
+  .show     = showBool,
+  .store    = vdoDirectBioSubmissionStore,
+  .valuePtr = &directBioSubmission,
+};
+
+static VDOAttribute vdoWorkStealing = {
+  .attr     = {.name = "work_stealing", .mode = 0644, },
+  .show     = showBool,
+  .store    = vdoWorkStealingStore,
+  .valuePtr = &workStealing,
+};
+
+static VDOAttribute vdoSpeculativeCompression = {
+  .attr     = {.name = "speculative_compression", .mode = 0644, },
+  .show     = showBool,
+  .store    = vdoSpeculativeCompressionStore,
+  .valuePtr = &speculativeCompression,
+};
+
+static VDOAttribute vdoSharedBioAckThreads = {
+  .attr     = {.name = "shared_bio_ack_threads", .mode = 0644, },
+  .show     = showUInt,
+  .store    = vdoSharedBioAckThreadsStore,
+  .valuePtr = &sharedBioAckThreads,
+};
+
+static VDOAttribute vdoWorkItemTiming = {
+  .attr     = {.name = "work_item_timing", .mode = 0644, },
+  .show     = showBool,
+  .store    = vdoWorkItemTimingStore,
+  .valuePtr = &workItemTiming,
+};
+
 static VDOAttribute vdoVersionAttr = {
   .attr  = { .name = "version", .mode = 0444, },
   .show  = vdoVersionShow,
@@ -301,7 +612,25 @@ static struct attribute *defaultAttrs[] = {
   &vdoMaxReqActiveAttr.attr,
   &vdoAlbireoTimeoutInterval.attr,
   &vdoMinAlbireoTimerInterval.attr,
+  &vdoAdaptiveAlbireoTimeout.attr,
+  &vdoIndexReadQueueDepth.attr,
+  &vdoBatchedDedupeCallbacks.attr,
+  &vdoTraversalReadDepth.attr,
+  &vdoDeferredDecrements.attr,
+  &vdoIndexLazyLoad.attr,
+  &vdoIndexMemoryBudget.attr,
+  &vdoIndexZoneCount.attr,
+  &vdoIndexDirectReads.attr,
+  &vdoAdaptiveDedupeBypass.attr,
+  &vdoDedupeBypassSampleInterval.attr,
   &vdoTraceRecording.attr,
+  &vdoTraceBuffering.attr,
+  &vdoCompressibilityEstimation.attr,
+  &vdoSpeculativeCompression.attr,
+  &vdoWorkStealing.attr,
+  &vdoDirectBioSubmission.attr,
+  &vdoSharedBioAckThreads.attr,
+  &vdoWorkItemTiming.attr,
   &vdoVersionAttr.attr,
   NULL
 };
@@ -22,6 +22,8 @@
 #include "threadRegistry.h"
 
 #include <linux/gfp.h>
+#include <linux/hash.h>
+#include <linux/rculist.h>
 #include <linux/slab.h>
 
 #include "permassert.h"
@@ -32,68 +34,97 @@
  * we do not want to invoke the logger while holding a lock.
  */
 
+/**
+ * Get the bucket of a registry which holds the registration of a task.
+ *
+ * @param registry  The thread registry
+ * @param task      The task
+ *
+ * @return The bucket for the task
+ **/
+static struct hlist_head *getBucket(ThreadRegistry     *registry,
+                                    struct task_struct *task)
+{
+  return &registry->buckets[hash_ptr(task, THREAD_REGISTRY_BUCKET_BITS)];
+}
+
+/**
+ * Remove the registration of the current thread from a bucket. The
+ * registry lock must be held.
+ *
+ * @param bucket  The bucket of the current thread
+ *
+ * @return true if the thread was registered
+ **/
+static bool removeCurrentThread(struct hlist_head *bucket)
+{
+  RegisteredThread *thread;
+  hlist_for_each_entry(thread, bucket, links) {
+    if (thread->task == current) {
+      hlist_del_rcu(&thread->links);
+      return true;
+    }
+  }
+  return false;
+}
+
 /*****************************************************************************/
 void registerThread(ThreadRegistry   *registry,
                     RegisteredThread *newThread,
                     const void       *pointer)
 {
-  INIT_LIST_HEAD(&newThread->links);
+  INIT_HLIST_NODE(&newThread->links);
   newThread->pointer = pointer;
   newThread->task    = current;
 
-  bool foundIt = false;
-  RegisteredThread *thread;
-  write_lock(&registry->lock);
-  list_for_each_entry(thread, &registry->links, links) {
-    if (thread->task == current) {
-      // This should not have been there.
-      // We'll complain after releasing the lock.
-      list_del_init(&thread->links);
-      foundIt = true;
-      break;
-    }
-  }
-  list_add_tail(&newThread->links, &registry->links);
-  write_unlock(&registry->lock);
+  struct hlist_head *bucket = getBucket(registry, current);
+  spin_lock(&registry->lock);
+  // This should not have been there. We'll complain after releasing the lock.
+  bool foundIt = removeCurrentThread(bucket);
+  hlist_add_head_rcu(&newThread->links, bucket);
+  spin_unlock(&registry->lock);
   ASSERT_LOG_ONLY(!foundIt, "new thread not already in registry");
+  if (foundIt) {
+    // The stale registration may still be in use by a lookup.
+    synchronize_rcu();
+  }
 }
 
 /*****************************************************************************/
 void unregisterThread(ThreadRegistry *registry)
 {
-  bool foundIt = false;
-  RegisteredThread *thread;
-  write_lock(&registry->lock);
-  list_for_each_entry(thread, &registry->links, links) {
-    if (thread->task == current) {
-      list_del_init(&thread->links);
-      foundIt = true;
-      break;
-    }
-  }
-  write_unlock(&registry->lock);
+  spin_lock(&registry->lock);
+  bool foundIt = removeCurrentThread(getBucket(registry, current));
+  spin_unlock(&registry->lock);
   ASSERT_LOG_ONLY(foundIt, "thread found in registry");
+  if (foundIt) {
+    // A lookup by another thread may still be walking past the registration,
+    // and the caller is free to reuse its storage once we return.
+    synchronize_rcu();
+  }
 }
 
 /*****************************************************************************/
 void initializeThreadRegistry(ThreadRegistry *registry)
 {
-  INIT_LIST_HEAD(&registry->links);
-  rwlock_init(&registry->lock);
+  for (unsigned int i = 0; i < THREAD_REGISTRY_BUCKETS; i++) {
+    INIT_HLIST_HEAD(&registry->buckets[i]);
+  }
+  spin_lock_init(&registry->lock);
 }
 
 /*****************************************************************************/
 const void *lookupThread(ThreadRegistry *registry)
 {
   const void *result = NULL;
-  read_lock(&registry->lock);
+  rcu_read_lock();
   RegisteredThread *thread;
-  list_for_each_entry(thread, &registry->links, links) {
+  hlist_for_each_entry_rcu(thread, getBucket(registry, current), links) {
     if (thread->task == current) {
       result = thread->pointer;
       break;
     }
   }
-  read_unlock(&registry->lock);
+  rcu_read_unlock();
   return result;
 }
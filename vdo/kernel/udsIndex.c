@@ -36,6 +36,7 @@
 
 #include "udsIndex.h"
 
+#include "histogram.h"
 #include "logger.h"
 #include "memoryAlloc.h"
 #include "murmur/MurmurHash3.h"
@@ -43,17 +44,85 @@
 #include "stringUtils.h"
 #include "uds-block.h"
 
+#include "vdoTrace.h"
+
 /*****************************************************************************/
 
+struct udsIndex;
+
 typedef struct udsAttribute {
   struct attribute attr;
   const char *(*showString)(DedupeIndex *);
+  ssize_t (*show)(struct udsIndex *, char *);
 } UDSAttribute;
 
 /*****************************************************************************/
 
 enum { UDS_Q_ACTION };
 
+enum {
+  // The most requests submitted to UDS in a single batch
+  UDS_BATCH_SIZE = 32,
+};
+
+enum {
+  // The number of power-of-two latency ranges tracked, in jiffies
+  LATENCY_BUCKETS         = 16,
+  // The number of answered requests between adaptive timeout updates
+  LATENCY_SAMPLE_PERIOD   = 1024,
+  // The percentile of answered requests which should not time out
+  LATENCY_PERCENTILE      = 99,
+  // The adaptive timeout is this multiple of that percentile's latency
+  ADAPTIVE_TIMEOUT_FACTOR = 4,
+  // The largest adaptive timeout, in milliseconds (the largest settable
+  // fixed timeout)
+  MAX_ADAPTIVE_TIMEOUT    = 120000,
+};
+
+enum {
+  // The number of regions of the logical space whose dedupe rate is
+  // tracked; logical blocks a multiple of this many regions apart share a
+  // record
+  DEDUPE_REGIONS            = 64,
+  // The log2 of the number of logical blocks in a region (1GB of 4K blocks)
+  DEDUPE_REGION_SHIFT       = 18,
+  // The number of answered posts to a region between bypass decisions
+  DEDUPE_WINDOW             = 512,
+  // A region is bypassed if fewer posts of a window than this found advice
+  DEDUPE_BYPASS_ENTER_HITS  = 4,
+  // A bypassed region is posted again once this many of the posts of a
+  // window found advice
+  DEDUPE_BYPASS_LEAVE_HITS  = 8,
+};
+
+/**
+ * A decaying record of the latency of answered index requests, from which
+ * the adaptive timeout is derived. The counts are halved each time the
+ * timeout is recomputed, so old samples fade away.
+ **/
+typedef struct {
+  // The number of samples since the timeout was last computed
+  unsigned int samples;
+  // The decayed number of samples with latency in [2^i - 1, 2^(i+1) - 1)
+  unsigned int counts[LATENCY_BUCKETS];
+} LatencyTracker;
+
+/**
+ * A record of how often posts of writes to one region of the logical space
+ * have found advice recently. All but the writes field are only modified by
+ * the UDS callback thread.
+ **/
+typedef struct {
+  // The number of answered posts in the current window
+  unsigned int posts;
+  // The number of those posts which found advice
+  unsigned int hits;
+  // Whether writes to the region are only sampled
+  bool         bypassed;
+  // The number of writes to the region which were considered for bypass
+  atomic_t     writes;
+} DedupeRegion;
+
 /*****************************************************************************/
 
 // These are the values in the atomic dedupeContext.requestState field
@@ -108,16 +177,35 @@ typedef struct udsIndex {
   struct list_head   pendingHead;  // protected by pendingLock
   struct timer_list  pendingTimer; // protected by pendingLock
   bool               startedTimer; // protected by pendingLock
+  // These fields are only modified by the UDS callback thread.
+  LatencyTracker     latency;
+  Jiffies            adaptiveTimeout; // 0 until the first computation
+  Histogram         *answeredHistogram;
+  Histogram         *timedOutHistogram;
+  DedupeRegion       regions[DEDUPE_REGIONS];
+  unsigned int       bypassedRegions;
+  atomic64_t         bypassedPosts;
+  atomic64_t         sampledPosts;
+  // These fields are only used by the udsQueue thread.
+  KvdoWorkItem       batchWorkItem;
+  bool               batchQueued;
+  unsigned int       batchSize;
+  UdsRequest        *batch[UDS_BATCH_SIZE];
 } UDSIndex;
 
 /*****************************************************************************/
 
 // Version 1:  user space albireo index (limited to 32 bytes)
 // Version 2:  kernel space albireo index (limited to 16 bytes)
+// Version 3:  version 2 stamped with the free generation of the PBN
 enum {
-  UDS_ADVICE_VERSION = 2,
+  UDS_ADVICE_VERSION         = 2,
   // version byte + state byte + 64-bit little-endian PBN
-  UDS_ADVICE_SIZE    = 1 + 1 + sizeof(uint64_t),
+  UDS_ADVICE_SIZE            = 1 + 1 + sizeof(uint64_t),
+  UDS_STAMPED_ADVICE_VERSION = 3,
+  // version byte + state byte + 48-bit little-endian PBN
+  // + 64-bit little-endian free generation
+  UDS_STAMPED_ADVICE_SIZE    = 1 + 1 + 6 + sizeof(uint64_t),
 };
 
 /*****************************************************************************/
@@ -156,29 +244,49 @@ static const char *indexStateToString(UDSIndex *index, IndexState state)
 
 /**
  * Encode VDO duplicate advice into the newMetadata field of a UDS request.
+ * Stamped advice is only written if there is a free generation to stamp it
+ * with; PBNs are always small enough to fit in the narrower field it has.
  *
- * @param request  The UDS request to receive the encoding
- * @param advice   The advice to encode
+ * @param request     The UDS request to receive the encoding
+ * @param advice      The advice to encode
+ * @param generation  The free generation of the advice PBN, or 0 if the
+ *                    advice is not to be stamped
  **/
-static void encodeUDSAdvice(UdsRequest *request, DataLocation advice)
+static void encodeUDSAdvice(UdsRequest   *request,
+                            DataLocation  advice,
+                            uint64_t      generation)
 {
   size_t offset = 0;
   UdsChunkData *encoding = &request->newMetadata;
-  encoding->data[offset++] = UDS_ADVICE_VERSION;
+  if ((generation == 0) || ((advice.pbn >> 48) != 0)) {
+    encoding->data[offset++] = UDS_ADVICE_VERSION;
+    encoding->data[offset++] = advice.state;
+    encodeUInt64LE(encoding->data, &offset, advice.pbn);
+    BUG_ON(offset != UDS_ADVICE_SIZE);
+    return;
+  }
+
+  encoding->data[offset++] = UDS_STAMPED_ADVICE_VERSION;
   encoding->data[offset++] = advice.state;
-  encodeUInt64LE(encoding->data, &offset, advice.pbn);
-  BUG_ON(offset != UDS_ADVICE_SIZE);
+  encodeUInt32LE(encoding->data, &offset, (uint32_t) advice.pbn);
+  encodeUInt16LE(encoding->data, &offset, (uint16_t) (advice.pbn >> 32));
+  encodeUInt64LE(encoding->data, &offset, generation);
+  BUG_ON(offset != UDS_STAMPED_ADVICE_SIZE);
 }
 
 /**
  * Decode VDO duplicate advice from the oldMetadata field of a UDS request.
  *
- * @param request  The UDS request containing the encoding
- * @param advice   The DataLocation to receive the decoded advice
+ * @param [in]  request        The UDS request containing the encoding
+ * @param [out] advice         The DataLocation to receive the decoded advice
+ * @param [out] generationPtr  A pointer to receive the free generation the
+ *                             advice was stamped with, or 0 if it was not
  *
  * @return <code>true</code> if valid advice was found and decoded
  **/
-static bool decodeUDSAdvice(const UdsRequest *request, DataLocation *advice)
+static bool decodeUDSAdvice(const UdsRequest *request,
+                            DataLocation     *advice,
+                            uint64_t         *generationPtr)
 {
   if ((request->status != UDS_SUCCESS) || !request->found) {
     return false;
@@ -187,14 +295,188 @@ static bool decodeUDSAdvice(const UdsRequest *request, DataLocation *advice)
   size_t offset = 0;
   const UdsChunkData *encoding = &request->oldMetadata;
   byte version = encoding->data[offset++];
-  if (version != UDS_ADVICE_VERSION) {
+  if (version == UDS_ADVICE_VERSION) {
+    advice->state = encoding->data[offset++];
+    decodeUInt64LE(encoding->data, &offset, &advice->pbn);
+    BUG_ON(offset != UDS_ADVICE_SIZE);
+    *generationPtr = 0;
+    return true;
+  }
+
+  if (version != UDS_STAMPED_ADVICE_VERSION) {
     logError("invalid UDS advice version code %u", version);
     return false;
   }
 
+  uint32_t low;
+  uint16_t high;
   advice->state = encoding->data[offset++];
-  decodeUInt64LE(encoding->data, &offset, &advice->pbn);
-  BUG_ON(offset != UDS_ADVICE_SIZE);
+  decodeUInt32LE(encoding->data, &offset, &low);
+  decodeUInt16LE(encoding->data, &offset, &high);
+  decodeUInt64LE(encoding->data, &offset, generationPtr);
+  BUG_ON(offset != UDS_STAMPED_ADVICE_SIZE);
+  advice->pbn = ((uint64_t) high << 32) | low;
+  return true;
+}
+
+/**
+ * Get the interval after which dedupe requests to an index time out.
+ *
+ * @param index  The index
+ *
+ * @return the timeout interval, in jiffies
+ **/
+static Jiffies getIndexTimeout(UDSIndex *index)
+{
+  if (adaptiveAlbireoTimeout) {
+    Jiffies timeout = READ_ONCE(index->adaptiveTimeout);
+    if (timeout > 0) {
+      return timeout;
+    }
+  }
+  return albireoTimeoutJiffies;
+}
+
+/**
+ * Recompute the adaptive timeout of an index from its latency record, and
+ * decay the record.
+ *
+ * @param index  The index
+ **/
+static void updateAdaptiveTimeout(UDSIndex *index)
+{
+  LatencyTracker *tracker = &index->latency;
+  uint64_t total = 0;
+  for (unsigned int i = 0; i < LATENCY_BUCKETS; i++) {
+    total += tracker->counts[i];
+  }
+
+  // Find the smallest bucket at or below which the desired percentile of the
+  // samples fall, using the top of that bucket as the latency.
+  uint64_t target = DIV_ROUND_UP(total * LATENCY_PERCENTILE, 100);
+  uint64_t seen = 0;
+  unsigned int bucket;
+  for (bucket = 0; bucket < LATENCY_BUCKETS - 1; bucket++) {
+    seen += tracker->counts[bucket];
+    if (seen >= target) {
+      break;
+    }
+  }
+
+  Jiffies timeout = ADAPTIVE_TIMEOUT_FACTOR * ((1UL << (bucket + 1)) - 1);
+  timeout = clamp(timeout, 2UL,
+                  (unsigned long) msecs_to_jiffies(MAX_ADAPTIVE_TIMEOUT));
+  WRITE_ONCE(index->adaptiveTimeout, timeout);
+
+  for (unsigned int i = 0; i < LATENCY_BUCKETS; i++) {
+    tracker->counts[i] /= 2;
+  }
+  tracker->samples = 0;
+}
+
+/**
+ * Record the latency of an answered index request. Requests which have
+ * already timed out are included so the adaptive timeout can grow when the
+ * index is slow. This must only be called from the UDS callback thread.
+ *
+ * @param index          The index which answered the request
+ * @param dedupeContext  The context of the request
+ * @param timedOut       Whether the request had already timed out
+ **/
+static void recordIndexLatency(UDSIndex      *index,
+                               DedupeContext *dedupeContext,
+                               bool           timedOut)
+{
+  Jiffies latency = jiffies - dedupeContext->submissionTime;
+  enterHistogramSample((timedOut
+                        ? index->timedOutHistogram
+                        : index->answeredHistogram), latency);
+
+  unsigned int bucket = ilog2(latency + 1);
+  if (bucket >= LATENCY_BUCKETS) {
+    bucket = LATENCY_BUCKETS - 1;
+  }
+  LatencyTracker *tracker = &index->latency;
+  tracker->counts[bucket]++;
+  if (++tracker->samples == LATENCY_SAMPLE_PERIOD) {
+    updateAdaptiveTimeout(index);
+  }
+}
+
+/**
+ * Get the record of the dedupe rate of the region of a write.
+ *
+ * @param index     The index
+ * @param dataKVIO  The write
+ *
+ * @return the record of the region
+ **/
+static DedupeRegion *getDedupeRegion(UDSIndex *index, DataKVIO *dataKVIO)
+{
+  LogicalBlockNumber lbn = dataKVIO->dataVIO.logical.lbn;
+  return &index->regions[(lbn >> DEDUPE_REGION_SHIFT) % DEDUPE_REGIONS];
+}
+
+/**
+ * Record whether an answered post found advice, and at the end of each
+ * window of posts to its region decide whether the region should be
+ * bypassed. The decisions are made whether or not adaptiveDedupeBypass is
+ * set, so that they can be watched before it is. Must only be called from
+ * the UDS callback thread.
+ *
+ * @param index     The index
+ * @param dataKVIO  The write which was posted
+ * @param found     Whether the post found advice
+ **/
+static void recordPostResult(UDSIndex *index, DataKVIO *dataKVIO, bool found)
+{
+  DedupeRegion *region = getDedupeRegion(index, dataKVIO);
+  if (found) {
+    region->hits++;
+  }
+  if (++region->posts < DEDUPE_WINDOW) {
+    return;
+  }
+
+  bool bypass = (region->hits < (region->bypassed
+                                 ? DEDUPE_BYPASS_LEAVE_HITS
+                                 : DEDUPE_BYPASS_ENTER_HITS));
+  if (bypass != region->bypassed) {
+    WRITE_ONCE(region->bypassed, bypass);
+    WRITE_ONCE(index->bypassedRegions,
+               index->bypassedRegions + (bypass ? 1 : -1));
+  }
+  region->posts = 0;
+  region->hits  = 0;
+}
+
+/**
+ * Check whether a write should not be posted because its region has not
+ * been deduping, and account for it.
+ *
+ * @param index     The index
+ * @param dataKVIO  The write to be posted
+ *
+ * @return <code>true</code> if the write should not be posted
+ **/
+static bool bypassPost(UDSIndex *index, DataKVIO *dataKVIO)
+{
+  if (!adaptiveDedupeBypass) {
+    return false;
+  }
+
+  DedupeRegion *region = getDedupeRegion(index, dataKVIO);
+  if (!READ_ONCE(region->bypassed)) {
+    return false;
+  }
+
+  unsigned int writes = atomic_inc_return(&region->writes);
+  if ((writes % READ_ONCE(dedupeBypassSampleInterval)) == 0) {
+    atomic64_inc(&index->sampledPosts);
+    return false;
+  }
+
+  atomic64_inc(&index->bypassedPosts);
   return true;
 }
 
@@ -204,9 +486,22 @@ static void finishIndexOperation(UdsRequest *udsRequest)
   DataKVIO *dataKVIO = container_of(udsRequest, DataKVIO,
                                     dedupeContext.udsRequest);
   DedupeContext *dedupeContext = &dataKVIO->dedupeContext;
+  KVIO *kvio = dataKVIOAsKVIO(dataKVIO);
+  UDSIndex *index = container_of(kvio->layer->dedupeIndex, UDSIndex, common);
+  trace_vdo_dedupe_response(kvio->layer->instance, &dataKVIO->dataVIO,
+                            udsRequest->type, udsRequest->status,
+                            (atomicLoad32(&dedupeContext->requestState)
+                             == UR_TIMED_OUT));
+  if (udsRequest->status == UDS_SUCCESS) {
+    // Only the UDS callback thread sees successful requests.
+    recordIndexLatency(index, dedupeContext,
+                       (atomicLoad32(&dedupeContext->requestState)
+                        == UR_TIMED_OUT));
+    if (udsRequest->type == UDS_POST) {
+      recordPostResult(index, dataKVIO, udsRequest->found);
+    }
+  }
   if (compareAndSwap32(&dedupeContext->requestState, UR_BUSY, UR_IDLE)) {
-    KVIO *kvio = dataKVIOAsKVIO(dataKVIO);
-    UDSIndex *index = container_of(kvio->layer->dedupeIndex, UDSIndex, common);
 
     spin_lock_bh(&index->pendingLock);
     if (dedupeContext->isPending) {
@@ -218,10 +513,11 @@ static void finishIndexOperation(UdsRequest *udsRequest)
     dedupeContext->status = udsRequest->status;
     if ((udsRequest->type == UDS_POST) || (udsRequest->type == UDS_QUERY)) {
       DataLocation advice;
-      if (decodeUDSAdvice(udsRequest, &advice)) {
-        setDedupeAdvice(dedupeContext, &advice);
+      uint64_t     generation;
+      if (decodeUDSAdvice(udsRequest, &advice, &generation)) {
+        setDedupeAdvice(dedupeContext, &advice, generation);
       } else {
-        setDedupeAdvice(dedupeContext, NULL);
+        setDedupeAdvice(dedupeContext, NULL, 0);
       }
     }
     invokeDedupeCallback(dataKVIO);
@@ -237,10 +533,43 @@ static void startExpirationTimer(UDSIndex *index, DataKVIO *dataKVIO)
   if (!index->startedTimer) {
     index->startedTimer = true;
     mod_timer(&index->pendingTimer,
-              getAlbireoTimeout(dataKVIO->dedupeContext.submissionTime));
+              getAlbireoDeadline(dataKVIO->dedupeContext.submissionTime,
+                                 getIndexTimeout(index)));
   }
 }
 
+/**
+ * Submit the requests which have been collected by the udsQueue thread to
+ * UDS in a single batch.
+ *
+ * @param index  The index whose batch is to be submitted
+ **/
+static void submitIndexBatch(UDSIndex *index)
+{
+  unsigned int count = index->batchSize;
+  index->batchSize = 0;
+  if (count == 0) {
+    return;
+  }
+
+  int status = udsStartChunkOperations(index->batch, count);
+  if (status != UDS_SUCCESS) {
+    // None of the requests were started.
+    for (unsigned int i = 0; i < count; i++) {
+      index->batch[i]->status = status;
+      finishIndexOperation(index->batch[i]);
+    }
+  }
+}
+
+/*****************************************************************************/
+static void submitIndexBatchWork(KvdoWorkItem *item)
+{
+  UDSIndex *index = container_of(item, UDSIndex, batchWorkItem);
+  index->batchQueued = false;
+  submitIndexBatch(index);
+}
+
 /*****************************************************************************/
 static void startIndexOperation(KvdoWorkItem *item)
 {
@@ -255,11 +584,20 @@ static void startIndexOperation(KvdoWorkItem *item)
   startExpirationTimer(index, dataKVIO);
   spin_unlock_bh(&index->pendingLock);
 
-  UdsRequest *udsRequest = &dedupeContext->udsRequest;
-  int status = udsStartChunkOperation(udsRequest);
-  if (status != UDS_SUCCESS) {
-    udsRequest->status = status;
-    finishIndexOperation(udsRequest);
+  /*
+   * Rather than starting the request now, add it to the current batch. The
+   * batch is submitted when it fills, or when the udsQueue thread reaches
+   * the work item queued behind the first request of the batch, which
+   * collects all the requests that were already waiting on the queue.
+   */
+  index->batch[index->batchSize++] = &dedupeContext->udsRequest;
+  if (index->batchSize == UDS_BATCH_SIZE) {
+    submitIndexBatch(index);
+  } else if (!index->batchQueued) {
+    index->batchQueued = true;
+    setupWorkItem(&index->batchWorkItem, submitIndexBatchWork, NULL,
+                  UDS_Q_ACTION);
+    enqueueWorkQueue(index->udsQueue, &index->batchWorkItem);
   }
 }
 
@@ -276,7 +614,7 @@ static void timeoutIndexOperations(unsigned long arg)
   UDSIndex *index = (UDSIndex *) arg;
 #endif
   LIST_HEAD(expiredHead);
-  uint64_t timeoutJiffies = msecs_to_jiffies(albireoTimeoutInterval);
+  uint64_t timeoutJiffies = getIndexTimeout(index);
   unsigned long earliestSubmissionAllowed = jiffies - timeoutJiffies;
   spin_lock_bh(&index->pendingLock);
   index->startedTimer = false;
@@ -325,7 +663,8 @@ static void enqueueIndexOperation(DataKVIO        *dataKVIO,
     udsRequest->type      = operation;
     udsRequest->update    = true;
     if ((operation == UDS_POST) || (operation == UDS_UPDATE)) {
-      encodeUDSAdvice(udsRequest, getDedupeAdvice(dedupeContext));
+      encodeUDSAdvice(udsRequest, getDedupeAdvice(dedupeContext),
+                      getDedupeAdviceGeneration(dedupeContext));
     }
 
     setupWorkItem(&kvio->enqueueable.workItem, startIndexOperation, NULL,
@@ -333,6 +672,8 @@ static void enqueueIndexOperation(DataKVIO        *dataKVIO,
 
     spin_lock(&index->stateLock);
     if (index->deduping) {
+      trace_vdo_dedupe_query(kvio->layer->instance, &dataKVIO->dataVIO,
+                             operation);
       enqueueWorkQueue(index->udsQueue, &kvio->enqueueable.workItem);
       unsigned int active = atomic_inc_return(&index->active);
       if (active > index->maximum) {
@@ -526,6 +867,34 @@ static void resumeUDSIndex(DedupeIndex *dedupeIndex)
 
 /*****************************************************************************/
 
+/*****************************************************************************/
+static int benchmarkUDSIndex(DedupeIndex                    *dedupeIndex,
+                             const IndexBenchmarkParameters *parameters)
+{
+  UDSIndex *index = container_of(dedupeIndex, UDSIndex, common);
+  spin_lock(&index->stateLock);
+  bool opened = ((index->indexState == IS_OPENED) && !index->changing
+                 && !index->suspended);
+  spin_unlock(&index->stateLock);
+  if (!opened) {
+    logWarning("index benchmark needs an open index");
+    return -EINVAL;
+  }
+
+  // The zone count and density are fixed when the index is made, so a run
+  // can only measure the configuration the index has.
+  if (index->udsParams.zone_count > 0) {
+    logInfo("index benchmark: %s index with %d zones",
+            (udsConfigurationGetSparse(index->configuration)
+             ? "sparse" : "dense"), index->udsParams.zone_count);
+  } else {
+    logInfo("index benchmark: %s index with the default zone count",
+            (udsConfigurationGetSparse(index->configuration)
+             ? "sparse" : "dense"));
+  }
+  return runIndexBenchmark(index->indexSession, parameters);
+}
+
 /*****************************************************************************/
 static void dumpUDSIndex(DedupeIndex *dedupeIndex, bool showQueue)
 {
@@ -564,6 +933,8 @@ static void freeUDSIndex(DedupeIndex *dedupeIndex)
     del_timer_sync(&index->pendingTimer);
   }
   spin_unlock_bh(&index->pendingLock);
+  freeHistogram(&index->answeredHistogram);
+  freeHistogram(&index->timedOutHistogram);
   kobject_put(&index->dedupeObject);
 }
 
@@ -586,11 +957,20 @@ static void getUDSStatistics(DedupeIndex *dedupeIndex, IndexStatistics *stats)
   stats->maxDedupeQueries      = index->maximum;
   spin_unlock(&index->stateLock);
   stats->currDedupeQueries     = atomic_read(&index->active);
+  stats->bypassedPosts         = atomic64_read(&index->bypassedPosts);
+  stats->sampledPosts          = atomic64_read(&index->sampledPosts);
+  stats->bypassedRegions       = READ_ONCE(index->bypassedRegions);
   if (indexState == IS_OPENED) {
     UdsIndexStats indexStats;
     int result = udsGetIndexStats(index->indexSession, &indexStats);
     if (result == UDS_SUCCESS) {
-      stats->entriesIndexed = indexStats.entriesIndexed;
+      stats->entriesIndexed          = indexStats.entriesIndexed;
+      stats->sparseCacheEvictions    = indexStats.sparseCacheEvictions;
+      stats->sparseCacheRetentions   = indexStats.sparseCacheRetentions;
+      stats->pageCacheBytes          = indexStats.pageCacheBytes;
+      stats->pageCacheHits           = indexStats.pageCacheHits;
+      stats->pageCacheMisses         = indexStats.pageCacheMisses;
+      stats->pageCacheReclaimedBytes = indexStats.pageCacheReclaimedBytes;
     } else {
       logErrorWithStringError(result, "Error reading index stats");
     }
@@ -633,6 +1013,14 @@ static int processMessage(DedupeIndex *dedupeIndex, const char *name)
 /*****************************************************************************/
 static void udsPost(DataKVIO *dataKVIO)
 {
+  UDSIndex *index = container_of(dataKVIOAsKVIO(dataKVIO)->layer->dedupeIndex,
+                                 UDSIndex, common);
+  if (bypassPost(index, dataKVIO)) {
+    // Offer no advice, just as if the index were not deduping.
+    dataKVIO->dedupeContext.status = UDS_SUCCESS;
+    invokeDedupeCallback(dataKVIO);
+    return;
+  }
   enqueueIndexOperation(dataKVIO, UDS_POST);
 }
 
@@ -680,11 +1068,26 @@ static ssize_t dedupeStatusShow(struct kobject   *kobj,
   UDSIndex *index = container_of(kobj, UDSIndex, dedupeObject);
   if (ua->showString != NULL) {
     return sprintf(buf, "%s\n", ua->showString(&index->common));
+  } else if (ua->show != NULL) {
+    return ua->show(index, buf);
   } else {
     return -EINVAL;
   }
 }
 
+/*****************************************************************************/
+static ssize_t replayProgressShow(UDSIndex *index, char *buf)
+{
+  uint64_t replayed = 0;
+  uint64_t total    = 0;
+  int result = udsGetIndexReplayProgress(index->indexSession, &replayed,
+                                         &total);
+  if (result != UDS_SUCCESS) {
+    return -EINVAL;
+  }
+  return sprintf(buf, "%" PRIu64 "/%" PRIu64 "\n", replayed, total);
+}
+
 /*****************************************************************************/
 static ssize_t dedupeStatusStore(struct kobject   *kobj,
                                  struct attribute *attr,
@@ -706,8 +1109,14 @@ static UDSAttribute dedupeStatusAttribute = {
   .showString = getUDSStateName,
 };
 
+static UDSAttribute dedupeReplayProgressAttribute = {
+  .attr = {.name = "replay_progress", .mode = 0444, },
+  .show = replayProgressShow,
+};
+
 static struct attribute *dedupeAttributes[] = {
   &dedupeStatusAttribute.attr,
+  &dedupeReplayProgressAttribute.attr,
   NULL,
 };
 
@@ -746,9 +1155,16 @@ int makeUDSIndex(KernelLayer *layer, DedupeIndex **indexPtr)
     return result;
   }
 
+  // An index on its own device starts at the beginning of it; one in the
+  // VDO's own layout starts after the geometry block.
+  const DeviceConfig *config = layer->deviceConfig;
+  bool separate = (config->indexDeviceName != NULL);
   result = allocSprintf("index name", &index->indexName,
-                        "dev=%s offset=4096 size=%" PRIu64,
-                        layer->deviceConfig->parentDeviceName,
+                        "dev=%s offset=%u size=%" PRIu64,
+                        (separate
+                         ? config->indexDeviceName
+                         : config->parentDeviceName),
+                        (separate ? 0 : VDO_BLOCK_SIZE),
                         getIndexRegionSize(layer->geometry) * VDO_BLOCK_SIZE);
   if (result != UDS_SUCCESS) {
     logError("Creating index name failed (%d)", result);
@@ -758,6 +1174,11 @@ int makeUDSIndex(KernelLayer *layer, DedupeIndex **indexPtr)
 
   index->udsParams = (struct uds_parameters) UDS_PARAMETERS_INITIALIZER;
   indexConfigToUdsParameters(&layer->geometry.indexConfig, &index->udsParams);
+  index->udsParams.read_queue_depth       = indexReadQueueDepth;
+  index->udsParams.lazy_load              = indexLazyLoad;
+  index->udsParams.master_index_budget_mb = indexMemoryBudget;
+  index->udsParams.zone_count             = indexZoneCount;
+  index->udsParams.direct_reads           = indexDirectReads;
   result = indexConfigToUdsConfiguration(&layer->geometry.indexConfig,
                                          &index->configuration);
   if (result != VDO_SUCCESS) {
@@ -806,6 +1227,29 @@ int makeUDSIndex(KernelLayer *layer, DedupeIndex **indexPtr)
     return result;
   }
 
+  index->answeredHistogram
+    = makeShardedJiffiesHistogram(&index->dedupeObject,
+                                  "answered_latency",
+                                  "Dedupe Answered Latency",
+                                  "requests answered in time", "latency");
+  index->timedOutHistogram
+    = makeShardedJiffiesHistogram(&index->dedupeObject,
+                                  "timed_out_latency",
+                                  "Dedupe Timed Out Latency",
+                                  "requests answered after timing out",
+                                  "latency");
+  if ((index->answeredHistogram == NULL)
+      || (index->timedOutHistogram == NULL)) {
+    freeHistogram(&index->answeredHistogram);
+    freeHistogram(&index->timedOutHistogram);
+    freeWorkQueue(&index->udsQueue);
+    udsDestroyIndexSession(index->indexSession);
+    // Releasing the kobject frees the configuration and the index.
+    kobject_put(&index->dedupeObject);
+    return -ENOMEM;
+  }
+
+  index->common.benchmark                 = benchmarkUDSIndex;
   index->common.dump                      = dumpUDSIndex;
   index->common.free                      = freeUDSIndex;
   index->common.getDedupeStateName        = getUDSStateName;
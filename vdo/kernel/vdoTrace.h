@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2020 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/kernel/vdoTrace.h#1 $
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM kvdo
+
+#if !defined(VDO_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define VDO_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * Static tracepoints for following DataVIOs through a pool. Each costs only
+ * a patched-out branch while nothing is attached to it, so they are always
+ * compiled in. The arguments are all cheap to compute at the call sites;
+ * anything which needs decoding, such as the hash lock states or VIO types,
+ * is recorded as a number.
+ */
+
+/**
+ * A DataVIO has been admitted for a user bio.
+ **/
+TRACE_EVENT(vdo_data_vio_admit,
+  TP_PROTO(unsigned int instance, const void *dataVIO, uint64_t lbn,
+           uint32_t operation),
+  TP_ARGS(instance, dataVIO, lbn, operation),
+  TP_STRUCT__entry(
+    __field(unsigned int, instance)
+    __field(const void *, dataVIO)
+    __field(uint64_t,     lbn)
+    __field(uint32_t,     operation)
+  ),
+  TP_fast_assign(
+    __entry->instance  = instance;
+    __entry->dataVIO   = dataVIO;
+    __entry->lbn       = lbn;
+    __entry->operation = operation;
+  ),
+  TP_printk("vdo%u dataVIO=%p lbn=%llu operation=0x%x", __entry->instance,
+            __entry->dataVIO, (unsigned long long) __entry->lbn,
+            __entry->operation)
+);
+
+/**
+ * A DataVIO has been returned to its pool.
+ **/
+TRACE_EVENT(vdo_data_vio_release,
+  TP_PROTO(unsigned int instance, const void *dataVIO, uint64_t lbn,
+           uint64_t latency),
+  TP_ARGS(instance, dataVIO, lbn, latency),
+  TP_STRUCT__entry(
+    __field(unsigned int, instance)
+    __field(const void *, dataVIO)
+    __field(uint64_t,     lbn)
+    __field(uint64_t,     latency)
+  ),
+  TP_fast_assign(
+    __entry->instance = instance;
+    __entry->dataVIO  = dataVIO;
+    __entry->lbn      = lbn;
+    __entry->latency  = latency;
+  ),
+  TP_printk("vdo%u dataVIO=%p lbn=%llu latency=%lluns", __entry->instance,
+            __entry->dataVIO, (unsigned long long) __entry->lbn,
+            (unsigned long long) __entry->latency)
+);
+
+/**
+ * A hash lock has changed state.
+ **/
+TRACE_EVENT(vdo_hash_lock_state,
+  TP_PROTO(const void *lock, uint32_t oldState, uint32_t newState),
+  TP_ARGS(lock, oldState, newState),
+  TP_STRUCT__entry(
+    __field(const void *, lock)
+    __field(uint32_t,     oldState)
+    __field(uint32_t,     newState)
+  ),
+  TP_fast_assign(
+    __entry->lock     = lock;
+    __entry->oldState = oldState;
+    __entry->newState = newState;
+  ),
+  TP_printk("lock=%p state %u -> %u", __entry->lock, __entry->oldState,
+            __entry->newState)
+);
+
+/**
+ * A dedupe request has been queued for the index.
+ **/
+TRACE_EVENT(vdo_dedupe_query,
+  TP_PROTO(unsigned int instance, const void *dataVIO, uint32_t type),
+  TP_ARGS(instance, dataVIO, type),
+  TP_STRUCT__entry(
+    __field(unsigned int, instance)
+    __field(const void *, dataVIO)
+    __field(uint32_t,     type)
+  ),
+  TP_fast_assign(
+    __entry->instance = instance;
+    __entry->dataVIO  = dataVIO;
+    __entry->type     = type;
+  ),
+  TP_printk("vdo%u dataVIO=%p type=%u", __entry->instance, __entry->dataVIO,
+            __entry->type)
+);
+
+/**
+ * The index has answered a dedupe request, or the request has failed.
+ **/
+TRACE_EVENT(vdo_dedupe_response,
+  TP_PROTO(unsigned int instance, const void *dataVIO, uint32_t type,
+           int status, bool timedOut),
+  TP_ARGS(instance, dataVIO, type, status, timedOut),
+  TP_STRUCT__entry(
+    __field(unsigned int, instance)
+    __field(const void *, dataVIO)
+    __field(uint32_t,     type)
+    __field(int,          status)
+    __field(bool,         timedOut)
+  ),
+  TP_fast_assign(
+    __entry->instance = instance;
+    __entry->dataVIO  = dataVIO;
+    __entry->type     = type;
+    __entry->status   = status;
+    __entry->timedOut = timedOut;
+  ),
+  TP_printk("vdo%u dataVIO=%p type=%u status=%d timedOut=%d",
+            __entry->instance, __entry->dataVIO, __entry->type,
+            __entry->status, __entry->timedOut)
+);
+
+/**
+ * A recovery journal block write has completed.
+ **/
+TRACE_EVENT(vdo_journal_commit,
+  TP_PROTO(const void *journal, uint64_t sequenceNumber, uint32_t entries,
+           uint64_t commitTime, int result),
+  TP_ARGS(journal, sequenceNumber, entries, commitTime, result),
+  TP_STRUCT__entry(
+    __field(const void *, journal)
+    __field(uint64_t,     sequenceNumber)
+    __field(uint32_t,     entries)
+    __field(uint64_t,     commitTime)
+    __field(int,          result)
+  ),
+  TP_fast_assign(
+    __entry->journal        = journal;
+    __entry->sequenceNumber = sequenceNumber;
+    __entry->entries        = entries;
+    __entry->commitTime     = commitTime;
+    __entry->result         = result;
+  ),
+  TP_printk("journal=%p block=%llu entries=%u time=%lluus result=%d",
+            __entry->journal, (unsigned long long) __entry->sequenceNumber,
+            __entry->entries, (unsigned long long) __entry->commitTime,
+            __entry->result)
+);
+
+/**
+ * A bio has been submitted to the underlying device.
+ **/
+TRACE_EVENT(vdo_bio_submit,
+  TP_PROTO(unsigned int instance, const void *bio, uint32_t vioType,
+           uint64_t sector, uint32_t size),
+  TP_ARGS(instance, bio, vioType, sector, size),
+  TP_STRUCT__entry(
+    __field(unsigned int, instance)
+    __field(const void *, bio)
+    __field(uint32_t,     vioType)
+    __field(uint64_t,     sector)
+    __field(uint32_t,     size)
+  ),
+  TP_fast_assign(
+    __entry->instance = instance;
+    __entry->bio      = bio;
+    __entry->vioType  = vioType;
+    __entry->sector   = sector;
+    __entry->size     = size;
+  ),
+  TP_printk("vdo%u bio=%p vioType=%u sector=%llu size=%u", __entry->instance,
+            __entry->bio, __entry->vioType,
+            (unsigned long long) __entry->sector, __entry->size)
+);
+
+/**
+ * A bio submitted to the underlying device has completed.
+ **/
+TRACE_EVENT(vdo_bio_complete,
+  TP_PROTO(unsigned int instance, const void *bio, uint32_t vioType),
+  TP_ARGS(instance, bio, vioType),
+  TP_STRUCT__entry(
+    __field(unsigned int, instance)
+    __field(const void *, bio)
+    __field(uint32_t,     vioType)
+  ),
+  TP_fast_assign(
+    __entry->instance = instance;
+    __entry->bio      = bio;
+    __entry->vioType  = vioType;
+  ),
+  TP_printk("vdo%u bio=%p vioType=%u", __entry->instance, __entry->bio,
+            __entry->vioType)
+);
+
+#endif // VDO_TRACE_H
+
+// This part must be outside the include guard.
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE vdoTrace
+#include <trace/define_trace.h>
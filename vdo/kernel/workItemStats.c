@@ -24,6 +24,8 @@
 #include "atomic.h"
 #include "logger.h"
 
+bool workItemTiming = false;
+
 /**
  * Scan the work queue stats table for the provided work function and
  * priority value. If it's not found, see if an empty slot is
@@ -126,7 +128,7 @@ static void getWorkItemCountsByItem(const KvdoWorkItemStats *stats,
                                     unsigned int            *pendingPtr)
 {
   uint64_t enqueued  = atomic64_read(&stats->enqueued[index]);
-  uint64_t processed = stats->times[index].count;
+  uint64_t processed = stats->processed[index];
   unsigned int pending;
   if (enqueued < processed) {
     // Probably just out of sync.
@@ -251,7 +253,7 @@ size_t formatWorkItemStats(const KvdoWorkItemStats *stats,
     getWorkItemCountsByItem(stats, i, &enqueued, &processed, &pending);
 
     // Format: fn prio enq proc timeo [ min max mean ]
-    if (ENABLE_PER_FUNCTION_TIMING_STATS) {
+    if (stats->times[i].count > 0) {
       uint64_t min, mean, max;
       getWorkItemTimesByItem(stats, i, &min, &mean, &max);
       currentOffset += snprintf(buffer + currentOffset,
@@ -291,6 +293,50 @@ size_t formatWorkItemStats(const KvdoWorkItemStats *stats,
   return currentOffset;
 }
 
+/**********************************************************************/
+size_t formatWorkItemRunTimes(const KvdoWorkItemStats *stats,
+                              char                    *buffer,
+                              size_t                   length)
+{
+  const KvdoWorkFunctionTable *functionIDs = &stats->functionTable;
+  size_t currentOffset = 0;
+  for (int i = 0; i < NUM_WORK_QUEUE_ITEM_STATS + 1; i++) {
+    if ((i < NUM_WORK_QUEUE_ITEM_STATS)
+        && (functionIDs->functions[i] == NULL)) {
+      break;
+    }
+    if (stats->times[i].count == 0) {
+      continue;
+    }
+
+    if (i == NUM_WORK_QUEUE_ITEM_STATS) {
+      currentOffset += snprintf(buffer + currentOffset,
+                                length - currentOffset, "%-36s %d",
+                                "OTHER", 0);
+    } else {
+      currentOffset += snprintf(buffer + currentOffset,
+                                length - currentOffset, "%-36ps %d",
+                                functionIDs->functions[i],
+                                functionIDs->priorities[i]);
+    }
+    for (int b = 0;
+         (b < NUM_WORK_ITEM_RUN_TIME_BUCKETS) && (currentOffset < length);
+         b++) {
+      currentOffset += snprintf(buffer + currentOffset,
+                                length - currentOffset, " %u",
+                                stats->runTimeBuckets[i][b]);
+    }
+    if (currentOffset < length) {
+      currentOffset += snprintf(buffer + currentOffset,
+                                length - currentOffset, "\n");
+    }
+    if (currentOffset >= length) {
+      return length;
+    }
+  }
+  return currentOffset;
+}
+
 /**********************************************************************/
 void logWorkItemStats(const KvdoWorkItemStats *stats)
 {
@@ -324,7 +370,7 @@ void logWorkItemStats(const KvdoWorkItemStats *stats)
     static char work[256]; // arbitrary size
     getFunctionName(functionIDs->functions[i], work, sizeof(work));
 
-    if (ENABLE_PER_FUNCTION_TIMING_STATS) {
+    if (stats->times[i].count > 0) {
       uint64_t min, mean, max;
       getWorkItemTimesByItem(stats, i, &min, &mean, &max);
       logInfo("  priority %d: %u pending"
@@ -27,12 +27,19 @@
 #include "workQueue.h"
 
 enum {
-  // Whether to enable tracking of per-work-function run-time stats.
-  ENABLE_PER_FUNCTION_TIMING_STATS = 0,
   // How many work function/priority pairs to track call stats for
-  NUM_WORK_QUEUE_ITEM_STATS        = 18,
+  NUM_WORK_QUEUE_ITEM_STATS      = 18,
+  // How many power-of-two buckets of work function run times to keep; the
+  // first holds times under 1024ns, and the last everything over 16ms.
+  NUM_WORK_ITEM_RUN_TIME_BUCKETS = 16,
 };
 
+/**
+ * Whether to time every work function run, breaking the times down by work
+ * function. Settable through sysfs.
+ **/
+extern bool workItemTiming;
+
 typedef struct simpleStats {
   uint64_t count;
   uint64_t sum;
@@ -102,16 +109,17 @@ typedef struct kvdoWorkItemStats {
   // Skip to (somewhere on) the next cache line
   char                   pad2[CACHE_LINE_BYTES - sizeof(atomic64_t)];
   /*
-   * These values are updated only by the consumer (worker thread). We
-   * overload the .times[].count field as a count of items processed,
-   * so if we're not doing the optional processing-time tracking
-   * (controlled via an option in workQueue.c), we need to explicitly
-   * update the count.
+   * These values are updated only by the consumer (worker thread). The
+   * .times and .runTimeBuckets entries only count the work items run while
+   * workItemTiming was set.
    *
    * Since only one thread can ever update these values, no
    * synchronization is used.
    */
+  uint64_t               processed[NUM_WORK_QUEUE_ITEM_STATS + 1];
   SimpleStats            times[NUM_WORK_QUEUE_ITEM_STATS + 1];
+  uint32_t               runTimeBuckets[NUM_WORK_QUEUE_ITEM_STATS + 1]
+                                       [NUM_WORK_ITEM_RUN_TIME_BUCKETS];
 } KvdoWorkItemStats;
 
 /**
@@ -178,29 +186,18 @@ void updateWorkItemStatsForEnqueue(KvdoWorkItemStats *stats,
  * no-ops) and is called for every work item processed, hence the inline
  * definition.
  *
- * This function requires that recordStartTime and
- * updateWorkItemStatsForWorkTime below both get called as well; in some cases
- * counters may be updated in updateWorkItemStatsForWorkTime rather than here.
- *
  * @param  stats  The statistics structure
  * @param  item   The work item enqueued
  **/
 static inline void updateWorkItemStatsForDequeue(KvdoWorkItemStats *stats,
                                                  KvdoWorkItem      *item)
 {
-  // The times[].count field is overloaded as a count of items
-  // processed.
-  if (!ENABLE_PER_FUNCTION_TIMING_STATS) {
-    stats->times[item->statTableIndex].count++;
-  } else {
-    // In this case, updateWorkItemStatsForWorkTime will bump the counter.
-  }
+  stats->processed[item->statTableIndex]++;
 }
 
 /**
  * Record the starting time for processing a work item, if timing
- * stats are enabled and if we haven't run out of room for recording
- * stats in the table.
+ * stats are enabled.
  *
  * @param  index  The work item's index into the internal array
  *
@@ -208,13 +205,12 @@ static inline void updateWorkItemStatsForDequeue(KvdoWorkItemStats *stats,
  **/
 static inline uint64_t recordStartTime(unsigned int index)
 {
-  return (ENABLE_PER_FUNCTION_TIMING_STATS ? currentTime(CLOCK_MONOTONIC) : 0);
+  return (READ_ONCE(workItemTiming) ? currentTime(CLOCK_MONOTONIC) : 0);
 }
 
 /**
  * Update the work queue statistics with the wall-clock time for
- * processing a work item, if timing stats are enabled and if we
- * haven't run out of room for recording stats in the table.
+ * processing a work item, if its start time was recorded.
  *
  * @param  stats      The statistics structure
  * @param  index      The work item's index into the internal array
@@ -224,10 +220,17 @@ static inline void updateWorkItemStatsForWorkTime(KvdoWorkItemStats *stats,
                                                   unsigned int       index,
                                                   uint64_t           startTime)
 {
-  if (ENABLE_PER_FUNCTION_TIMING_STATS) {
-    uint64_t endTime = currentTime(CLOCK_MONOTONIC);
-    addSample(&stats->times[index], endTime - startTime);
+  if (startTime == 0) {
+    return;
+  }
+
+  uint64_t runTime = currentTime(CLOCK_MONOTONIC) - startTime;
+  addSample(&stats->times[index], runTime);
+  unsigned int bucket = fls64(runTime >> 10);
+  if (bucket >= NUM_WORK_ITEM_RUN_TIME_BUCKETS) {
+    bucket = NUM_WORK_ITEM_RUN_TIME_BUCKETS - 1;
   }
+  stats->runTimeBuckets[index][bucket]++;
 }
 
 /**
@@ -261,4 +264,19 @@ size_t formatWorkItemStats(const KvdoWorkItemStats *stats,
                            char                    *buffer,
                            size_t                   length);
 
+/**
+ * Format the run-time histograms of the timed work functions for reporting
+ * via /sys. Each line gives a work function and priority, followed by the
+ * counts of runs taking under 1us, 1-2us, 2-4us, and so on.
+ *
+ * @param [in]  stats   The statistics structure
+ * @param [out] buffer  The output buffer
+ * @param [in]  length  The size of the output buffer
+ *
+ * @return  The size of the string actually written
+ **/
+size_t formatWorkItemRunTimes(const KvdoWorkItemStats *stats,
+                              char                    *buffer,
+                              size_t                   length);
+
 #endif // WORK_ITEM_STATS_H
@@ -21,15 +21,20 @@
 
 #include "workQueue.h"
 
+#include <linux/cpumask.h>
 #include <linux/delay.h>
 #include <linux/kthread.h>
+#include <linux/numa.h>
+#include <linux/topology.h>
 #include <linux/version.h>
 
 #include "atomic.h"
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "numeric.h"
 #include "permassert.h"
 #include "stringUtils.h"
+#include "util/eventCount.h"
 
 #include "numeric.h"
 #include "workItemStats.h"
@@ -49,6 +54,8 @@ enum {
   FUNNEL_FINISH_SLEEP = 5000,
 };
 
+bool workStealing = false;
+
 static struct mutex queueDataLock;
 static SimpleWorkQueue queueData;
 
@@ -149,7 +156,8 @@ static inline SimpleWorkQueue *pickSimpleQueue(KvdoWorkQueue *queue)
 
 /**
  * Scan the work queue's work item lists, and dequeue and return the next
- * waiting work item, if any.
+ * waiting work item, if any. The caller must be the only consumer of the
+ * queue's funnel queues.
  *
  * We scan the funnel queues from highest priority to lowest, once; there is
  * therefore a race condition where a high-priority work item can be enqueued
@@ -161,7 +169,7 @@ static inline SimpleWorkQueue *pickSimpleQueue(KvdoWorkQueue *queue)
  *
  * @return  a work item pointer, or NULL
  **/
-static KvdoWorkItem *pollForWorkItem(SimpleWorkQueue *queue)
+static KvdoWorkItem *pollPriorityLists(SimpleWorkQueue *queue)
 {
   KvdoWorkItem *item = NULL;
   for (int i = READ_ONCE(queue->numPriorityLists) - 1; i >= 0; i--) {
@@ -176,19 +184,86 @@ static KvdoWorkItem *pollForWorkItem(SimpleWorkQueue *queue)
 }
 
 /**
- * Add a work item into the queue, and inform the caller of any additional
- * processing necessary.
+ * Dequeue and return the next waiting work item of the current thread's own
+ * work queue, if any.
+ *
+ * If siblings may steal from the queue, the funnel queues have several
+ * consumers, so they are polled under the consumer lock, and the dequeue is
+ * accounted for while the lock is held.
+ *
+ * @param queue  the work queue
+ *
+ * @return  a work item pointer, or NULL
+ **/
+static KvdoWorkItem *pollForWorkItem(SimpleWorkQueue *queue)
+{
+  if (!queue->stealable) {
+    return pollPriorityLists(queue);
+  }
+
+  spin_lock(&queue->consumerLock);
+  KvdoWorkItem *item = pollPriorityLists(queue);
+  if (item != NULL) {
+    updateStatsForDequeue(&queue->stats, item);
+  }
+  spin_unlock(&queue->consumerLock);
+  return item;
+}
+
+/**
+ * Try to steal a work item from a sibling of the current thread's work
+ * queue. Only siblings whose threads are busy are considered, and a sibling
+ * whose consumer lock is held is skipped rather than waited for.
  *
- * If the worker thread may not be awake, true is returned, and the caller
- * should attempt a wakeup.
+ * @param queue  the work queue of the current thread
+ *
+ * @return  a stolen work item, or NULL
+ **/
+static KvdoWorkItem *stealWorkItem(SimpleWorkQueue *queue)
+{
+  KvdoWorkQueue *parentQueue = READ_ONCE(queue->parentQueue);
+  if (!queue->stealable || (parentQueue == NULL) || !READ_ONCE(workStealing)) {
+    return NULL;
+  }
+
+  RoundRobinWorkQueue *parent = asRoundRobinWorkQueue(parentQueue);
+  unsigned int         count  = parent->numServiceQueues;
+  for (unsigned int i = 0; i < count; i++) {
+    SimpleWorkQueue *victim
+      = READ_ONCE(parent->serviceQueues[queue->stealRotor++ % count]);
+    if ((victim == NULL) || (victim == queue)
+        || (atomic_read(&victim->idle) == 1)
+        || !spin_trylock(&victim->consumerLock)) {
+      continue;
+    }
+
+    KvdoWorkItem *item = pollPriorityLists(victim);
+    if (item != NULL) {
+      updateStatsForDequeue(&victim->stats, item);
+      victim->stats.stolen++;
+    }
+    spin_unlock(&victim->consumerLock);
+
+    if (item != NULL) {
+      queue->stats.steals++;
+      return item;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Check the preconditions for adding a work item to a queue, and account for
+ * it as enqueued.
  *
  * @param queue  The work queue
- * @param item   The work item to add
+ * @param item   The work item to be added
  *
- * @return  true iff the caller should wake the worker thread
+ * @return  the priority list to which the item must be added
  **/
-__attribute__((warn_unused_result))
-static bool enqueueWorkQueueItem(SimpleWorkQueue *queue, KvdoWorkItem *item)
+static unsigned int prepareWorkQueueItem(SimpleWorkQueue *queue,
+                                         KvdoWorkItem    *item)
 {
   ASSERT_LOG_ONLY(item->myQueue == NULL,
                   "item %" PRIptr " (fn %" PRIptr "/%" PRIptr
@@ -206,44 +281,61 @@ static bool enqueueWorkQueueItem(SimpleWorkQueue *queue, KvdoWorkItem *item)
   updateStatsForEnqueue(&queue->stats, item, priority);
 
   item->myQueue = &queue->common;
+  return priority;
+}
+
+/**
+ * Add a work item into the queue. The caller must then call
+ * wakeWorkerThread() in case the worker thread is waiting.
+ *
+ * @param queue  The work queue
+ * @param item   The work item to add
+ **/
+static void enqueueWorkQueueItem(SimpleWorkQueue *queue, KvdoWorkItem *item)
+{
+  unsigned int priority = prepareWorkQueueItem(queue, item);
 
   // Funnel queue handles the synchronization for the put.
   funnelQueuePut(queue->priorityLists[priority], &item->workQueueEntryLink);
+}
 
-  /*
-   * Due to how funnel-queue synchronization is handled (just atomic
-   * operations), the simplest safe implementation here would be to wake-up any
-   * waiting threads after enqueueing each item. Even if the funnel queue is
-   * not empty at the time of adding an item to the queue, the consumer thread
-   * may not see this since it is not guaranteed to have the same view of the
-   * queue as a producer thread.
-   *
-   * However, the above is wasteful so instead we attempt to minimize the
-   * number of thread wakeups. This is normally unsafe due to the above
-   * consumer-producer synchronization constraints. To correct this a timeout
-   * mechanism is used to wake the thread periodically to handle the occasional
-   * race condition that triggers and results in this thread not being woken
-   * properly.
-   *
-   * In most cases, the above timeout will not occur prior to some other work
-   * item being added after the queue is set to idle state, so thread wakeups
-   * will generally be triggered much faster than this interval. The timeout
-   * provides protection against the cases where more work items are either not
-   * added or are added too infrequently.
-   *
-   * This is also why we can get away with the normally-unsafe optimization for
-   * the common case by checking queue->idle first without synchronization. The
-   * race condition exists, but another work item getting enqueued can wake us
-   * up, and if we don't get that either, we still have the timeout to fall
-   * back on.
-   *
-   * Developed and tuned for some x86 boxes; untested whether this is any
-   * better or worse for other platforms, with or without the explicit memory
-   * barrier.
-   */
-  smp_mb();
-  return ((atomic_read(&queue->idle) == 1)
-          && (atomic_cmpxchg(&queue->idle, 1, 0) == 1));
+/**
+ * Add a chain of work items, linked through their next fields, into the
+ * queue. The items for each priority are put on its funnel queue with a
+ * single exchange, and the worker thread needs at most one wakeup, which the
+ * caller must then attempt with wakeWorkerThread().
+ *
+ * @param queue  The work queue
+ * @param items  The first work item of the chain
+ **/
+static void enqueueWorkQueueItems(SimpleWorkQueue *queue, KvdoWorkItem *items)
+{
+  FunnelQueueEntry *first[WORK_QUEUE_PRIORITY_COUNT] = { NULL, };
+  FunnelQueueEntry *last[WORK_QUEUE_PRIORITY_COUNT];
+  KvdoWorkItem     *item = items;
+  while (item != NULL) {
+    KvdoWorkItem *next = item->next;
+    item->next          = NULL;
+    item->executionTime = 0;
+
+    unsigned int      priority = prepareWorkQueueItem(queue, item);
+    FunnelQueueEntry *entry    = &item->workQueueEntryLink;
+    if (first[priority] == NULL) {
+      first[priority] = entry;
+    } else {
+      last[priority]->next = entry;
+    }
+    last[priority] = entry;
+    item = next;
+  }
+
+  for (unsigned int priority = 0; priority < WORK_QUEUE_PRIORITY_COUNT;
+       priority++) {
+    if (first[priority] != NULL) {
+      funnelQueuePutChain(queue->priorityLists[priority], first[priority],
+                          last[priority]);
+    }
+  }
 }
 
 /**
@@ -262,7 +354,7 @@ static unsigned int getPendingCount(SimpleWorkQueue *queue)
   long long pending = 0;
   for (int i = 0; i < NUM_WORK_QUEUE_ITEM_STATS + 1; i++) {
     pending += atomic64_read(&stats->enqueued[i]);
-    pending -= stats->times[i].count;
+    pending -= stats->processed[i];
   }
   if (pending < 0) {
     /*
@@ -332,11 +424,61 @@ static bool hasDelayedWorkItems(SimpleWorkQueue *queue)
   bool result;
   unsigned long flags;
   spin_lock_irqsave(&queue->lock, flags);
-  result = !isWorkItemListEmpty(&queue->delayedItems);
+  result = (queue->delayedCount > 0);
   spin_unlock_irqrestore(&queue->lock, flags);
   return result;
 }
 
+/**
+ * Poll for a work item for up to the queue's spin budget, without telling
+ * submitters we are idle, so that work arriving soon is picked up without
+ * the cost of a wakeup. The budget is halved each time a poll comes up
+ * empty, so that a queue which is really idle soon stops burning the CPU,
+ * and restored whenever a poll finds work.
+ *
+ * @param queue  The work queue to poll
+ *
+ * @return  a work item, or NULL if none arrived in time
+ **/
+static KvdoWorkItem *spinForWorkItem(SimpleWorkQueue *queue)
+{
+  unsigned int spinMicroseconds = READ_ONCE(queue->spinMicroseconds);
+  if (spinMicroseconds == 0) {
+    return NULL;
+  }
+
+  if ((queue->spinBudget == 0) || (queue->spinBudget > spinMicroseconds)) {
+    queue->spinBudget = spinMicroseconds;
+  }
+
+  uint64_t      start    = currentTime(CLOCK_MONOTONIC);
+  uint64_t      deadline = start + (queue->spinBudget * NSEC_PER_USEC);
+  uint64_t      now      = start;
+  KvdoWorkItem *item     = NULL;
+  while ((now < deadline) && !need_resched() && !kthread_should_stop()) {
+    cpu_relax();
+    item = pollForWorkItem(queue);
+    if (item == NULL) {
+      item = stealWorkItem(queue);
+    }
+    if (item != NULL) {
+      break;
+    }
+    now = currentTime(CLOCK_MONOTONIC);
+  }
+
+  // Only the worker thread updates these, so they need not be atomic.
+  if (item != NULL) {
+    queue->stats.spins++;
+    queue->spinBudget = spinMicroseconds;
+  } else {
+    queue->stats.spinStalls++;
+    queue->spinBudget = maxUInt(queue->spinBudget / 2, 1);
+  }
+  queue->stats.spinTime += currentTime(CLOCK_MONOTONIC) - start;
+  return item;
+}
+
 /**
  * Wait for the next work item to process, or until kthread_should_stop
  * indicates that it's time for us to shut down.
@@ -359,31 +501,34 @@ static KvdoWorkItem *waitForNextWorkItem(SimpleWorkQueue *queue,
     return item;
   }
 
-  DEFINE_WAIT(wait);
+  item = spinForWorkItem(queue);
+  if (item != NULL) {
+    return item;
+  }
+
+  RelTime timeout = ((RelTime) jiffies_to_usecs(timeoutInterval)
+                     * NSEC_PER_USEC);
   while (true) {
     atomic64_set(&queue->firstWakeup, 0);
-    prepare_to_wait(&queue->waitingWorkerThreads, &wait, TASK_INTERRUPTIBLE);
+    atomic_set(&queue->idle, 1);
     /*
-     * Don't set the idle flag until a wakeup will not be lost.
-     *
-     * Force synchronization between setting the idle flag and checking the
-     * funnel queue; the producer side will do them in the reverse order.
-     * (There's still a race condition we've chosen to allow, because we've got
-     * a timeout below that unwedges us if we hit it, but this may narrow the
-     * window a little.)
+     * Preparing the token is a full barrier, and submitters broadcast after
+     * putting their items, so either the poll below sees a new item or the
+     * submitter sees our token and wakes us; no wakeup can be lost.
      */
-    atomic_set(&queue->idle, 1);
-    memoryFence(); // store-load barrier between "idle" and funnel queue
+    EventToken token = eventCountPrepare(queue->wakeEvent);
 
     item = pollForWorkItem(queue);
     if (item != NULL) {
+      eventCountCancel(queue->wakeEvent, token);
       break;
     }
 
     /*
-     * We need to check for thread-stop after setting TASK_INTERRUPTIBLE state
-     * up above. Otherwise, schedule() will put the thread to sleep and might
-     * miss a wakeup from kthread_stop() call in finishWorkQueue().
+     * We need to check for thread-stop after preparing the wait token up
+     * above. kthread_stop() in finishWorkQueue() wakes the thread, which ends
+     * an interruptible wait early, but the check must follow the prepare so
+     * that a stop issued just before the wait is not overlooked.
      *
      * If there are delayed work items, we need to wait for them to
      * get run. Then, when we check kthread_should_stop again, we'll
@@ -408,6 +553,7 @@ static KvdoWorkItem *waitForNextWorkItem(SimpleWorkQueue *queue,
        * were required to be completed and not re-queued before shutting down a
        * work queue.
        */
+      eventCountCancel(queue->wakeEvent, token);
       item = pollForWorkItem(queue);
       break;
     }
@@ -420,8 +566,9 @@ static KvdoWorkItem *waitForNextWorkItem(SimpleWorkQueue *queue,
     uint64_t timeBeforeSchedule = currentTime(CLOCK_MONOTONIC);
     atomic64_add(timeBeforeSchedule - queue->mostRecentWakeup,
                  &queue->stats.runTime);
-    // Wake up often, to address the missed-wakeup race.
-    schedule_timeout(timeoutInterval);
+    // Wake up periodically anyway, to notice kthread_stop(), which does not
+    // signal the event count.
+    eventCountWait(queue->wakeEvent, token, &timeout);
     queue->mostRecentWakeup = currentTime(CLOCK_MONOTONIC);
     uint64_t callDurationNS = queue->mostRecentWakeup - timeBeforeSchedule;
     enterHistogramSample(queue->stats.scheduleTimeHistogram,
@@ -431,8 +578,12 @@ static KvdoWorkItem *waitForNextWorkItem(SimpleWorkQueue *queue,
      * Check again before resetting firstWakeup for more accurate
      * stats. (It's still racy, which can't be fixed without requiring
      * tighter synchronization between producer and consumer sides.)
+     * A sibling may have woken us to take some of its work.
      */
     item = pollForWorkItem(queue);
+    if (item == NULL) {
+      item = stealWorkItem(queue);
+    }
     if (item != NULL) {
       break;
     }
@@ -455,7 +606,6 @@ static KvdoWorkItem *waitForNextWorkItem(SimpleWorkQueue *queue,
                            getPendingCount(queue));
     }
   }
-  finish_wait(&queue->waitingWorkerThreads, &wait);
   atomic_set(&queue->idle, 0);
 
   return item;
@@ -477,6 +627,9 @@ static KvdoWorkItem *getNextWorkItem(SimpleWorkQueue *queue,
                                      TimeoutJiffies   timeoutInterval)
 {
   KvdoWorkItem *item = pollForWorkItem(queue);
+  if (item == NULL) {
+    item = stealWorkItem(queue);
+  }
   if (item != NULL) {
     return item;
   }
@@ -492,10 +645,16 @@ static KvdoWorkItem *getNextWorkItem(SimpleWorkQueue *queue,
 static void processWorkItem(SimpleWorkQueue *queue,
                             KvdoWorkItem    *item)
 {
-  if (ASSERT(item->myQueue == &queue->common,
-             "item %" PRIptr " from queue %" PRIptr
-             " marked as being in this queue (%" PRIptr ")",
-             item, queue, item->myQueue) == UDS_SUCCESS) {
+  bool stolen = false;
+  if (queue->stealable) {
+    // The dequeue was accounted for when the item was polled, in the stats
+    // of whichever queue it came from.
+    stolen        = (item->myQueue != &queue->common);
+    item->myQueue = NULL;
+  } else if (ASSERT(item->myQueue == &queue->common,
+                    "item %" PRIptr " from queue %" PRIptr
+                    " marked as being in this queue (%" PRIptr ")",
+                    item, queue, item->myQueue) == UDS_SUCCESS) {
     updateStatsForDequeue(&queue->stats, item);
     item->myQueue = NULL;
   }
@@ -506,8 +665,11 @@ static void processWorkItem(SimpleWorkQueue *queue,
   item->work(item);
   // We just surrendered control of the work item; no more access.
   item = NULL;
-  updateWorkItemStatsForWorkTime(&queue->stats.workItemStats, index,
-                                 workStartTime);
+  if (!stolen) {
+    // A stolen item's index refers to the function table of its own queue.
+    updateWorkItemStatsForWorkTime(&queue->stats.workItemStats, index,
+                                   workStartTime);
+  }
 
   /*
    * Be friendly to a CPU that has other work to do, if the kernel has told us
@@ -617,17 +779,134 @@ void setupWorkItem(KvdoWorkItem     *item,
 
 // Thread management
 
-/**********************************************************************/
-static inline void wakeWorkerThread(SimpleWorkQueue *queue)
+/**
+ * Wake the worker thread of a queue after adding work items, if it is
+ * waiting for them. If it is running or still polling for work, the event
+ * count finds no waiter and the wakeup is skipped with no more than a
+ * memory barrier and a read.
+ *
+ * @param queue  The work queue
+ *
+ * @return  true if the worker thread was waiting and has been woken
+ **/
+static inline bool wakeWorkerThread(SimpleWorkQueue *queue)
 {
-  smp_mb();
+  if (!eventCountBroadcast(queue->wakeEvent)) {
+    atomic64_inc(&queue->stats.avoidedWakeups);
+    return false;
+  }
+
   atomic64_cmpxchg(&queue->firstWakeup, 0, currentTime(CLOCK_MONOTONIC));
-  // Despite the name, there's a maximum of one thread in this list.
-  wake_up(&queue->waitingWorkerThreads);
+  atomic64_inc(&queue->stats.wakeups);
+  return true;
+}
+
+/**
+ * Wake the thread of one sibling of a busy work queue, if it is idle, so
+ * that it can steal some of the busy queue's work. Only one sibling is
+ * checked, chosen in rotation, to keep this cheap for the submitter.
+ *
+ * @param queue  The busy work queue
+ **/
+static void wakeIdleSibling(SimpleWorkQueue *queue)
+{
+  KvdoWorkQueue *parentQueue = READ_ONCE(queue->parentQueue);
+  if (parentQueue == NULL) {
+    return;
+  }
+
+  RoundRobinWorkQueue *parent = asRoundRobinWorkQueue(parentQueue);
+  unsigned int index = (parent->wakeRotor++ % parent->numServiceQueues);
+  SimpleWorkQueue *sibling = READ_ONCE(parent->serviceQueues[index]);
+  if ((sibling != NULL) && (sibling != queue)
+      && (atomic_read(&sibling->idle) == 1)) {
+    wakeWorkerThread(sibling);
+  }
 }
 
 // Delayed work items
 
+/**
+ * Get the wheel slot holding the delayed work items due at a given time.
+ *
+ * @param queue  The work queue
+ * @param time   The execution time (jiffies)
+ *
+ * @return  the slot for that time
+ **/
+static inline KvdoWorkItemList *getWheelSlot(SimpleWorkQueue *queue,
+                                             Jiffies          time)
+{
+  return &queue->delayedWheel[time % DELAYED_WHEEL_SLOTS];
+}
+
+/**
+ * Remove the delayed work items which are due from the slots of the wheel
+ * between the last expiry and now. The caller must hold the queue lock.
+ *
+ * @param queue  The work queue
+ * @param now    The current time (jiffies)
+ *
+ * @return  the expired work items, chained through their next fields
+ **/
+static KvdoWorkItem *expireDelayedWorkItems(SimpleWorkQueue *queue,
+                                            Jiffies          now)
+{
+  KvdoWorkItem  *readyItems = NULL;
+  KvdoWorkItem **readyTail  = &readyItems;
+
+  // Each slot need be visited only once, however late the timer is.
+  Jiffies time = queue->wheelTime;
+  if ((now - time) >= DELAYED_WHEEL_SLOTS) {
+    time = now - DELAYED_WHEEL_SLOTS + 1;
+  }
+
+  for (; time <= now; time++) {
+    KvdoWorkItemList *slot    = getWheelSlot(queue, time);
+    KvdoWorkItemList  pending;
+    initializeWorkItemList(&pending);
+    KvdoWorkItem *item;
+    while ((item = workItemListPoll(slot)) != NULL) {
+      if (item->executionTime > now) {
+        // Due on a later turn of the wheel.
+        addToWorkItemList(&pending, item);
+        continue;
+      }
+      item->myQueue = NULL;
+      *readyTail    = item;
+      readyTail     = &item->next;
+      queue->delayedCount--;
+    }
+    *slot = pending;
+  }
+
+  queue->wheelTime = now + 1;
+  return readyItems;
+}
+
+/**
+ * Find when the timer must next fire to expire delayed work items: the time
+ * of the first non-empty wheel slot after the current time. The items in
+ * that slot may be due on a later turn of the wheel, in which case the timer
+ * will just go off again. The caller must hold the queue lock, and there
+ * must be delayed work items.
+ *
+ * @param queue  The work queue
+ *
+ * @return  the time at which to set the timer
+ **/
+static Jiffies getNextWheelExpiry(SimpleWorkQueue *queue)
+{
+  for (Jiffies time = queue->wheelTime;
+       time < queue->wheelTime + DELAYED_WHEEL_SLOTS; time++) {
+    KvdoWorkItem *first = workItemListPeek(getWheelSlot(queue, time));
+    if (first != NULL) {
+      return time;
+    }
+  }
+  return queue->wheelTime + DELAYED_WHEEL_SLOTS;
+}
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,15,0)
 /**
  * Timer function invoked when a delayed work item is ready to run.
@@ -649,27 +928,24 @@ static void processDelayedWorkItems(unsigned long data)
 #else
   SimpleWorkQueue *queue = (SimpleWorkQueue *) data;
 #endif
-  Jiffies          nextExecutionTime = 0;
   bool             reschedule        = false;
   bool             needsWakeup       = false;
+  KvdoWorkItem    *readyItems        = NULL;
 
   unsigned long flags;
   spin_lock_irqsave(&queue->lock, flags);
-  while (!isWorkItemListEmpty(&queue->delayedItems)) {
-    KvdoWorkItem *item = workItemListPeek(&queue->delayedItems);
-    if (item->executionTime > jiffies) {
-      nextExecutionTime = item->executionTime;
-      reschedule = true;
-      break;
-    }
-    workItemListPoll(&queue->delayedItems);
-    item->executionTime = 0;    // not actually looked at...
-    item->myQueue = NULL;
-    needsWakeup |= enqueueWorkQueueItem(queue, item);
+  readyItems = expireDelayedWorkItems(queue, jiffies);
+  if (queue->delayedCount > 0) {
+    queue->timerExpiry = getNextWheelExpiry(queue);
+    reschedule         = true;
+  }
+  if (readyItems != NULL) {
+    enqueueWorkQueueItems(queue, readyItems);
+    needsWakeup = true;
   }
   spin_unlock_irqrestore(&queue->lock, flags);
   if (reschedule) {
-    mod_timer(&queue->delayedItemsTimer, nextExecutionTime);
+    mod_timer(&queue->delayedItemsTimer, queue->timerExpiry);
   }
   if (needsWakeup) {
     wakeWorkerThread(queue);
@@ -757,11 +1033,16 @@ static int makeSimpleWorkQueue(const char               *threadNamePrefix,
     return -ENOMEM;
   }
 
-  init_waitqueue_head(&queue->waitingWorkerThreads);
   init_waitqueue_head(&queue->startWaiters);
   spin_lock_init(&queue->lock);
+  spin_lock_init(&queue->consumerLock);
+  queue->stealable = type->workStealing;
+  queue->numaNode  = NUMA_NO_NODE;
 
-  initializeWorkItemList(&queue->delayedItems);
+  for (unsigned int i = 0; i < DELAYED_WHEEL_SLOTS; i++) {
+    initializeWorkItemList(&queue->delayedWheel[i]);
+  }
+  queue->wheelTime = jiffies;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,15,0)
   timer_setup(&queue->delayedItemsTimer, processDelayedWorkItems, 0);
 #else
@@ -777,6 +1058,11 @@ static int makeSimpleWorkQueue(const char               *threadNamePrefix,
     return result;
   }
   queue->numPriorityLists = numPriorityLists;
+  result = makeEventCount(&queue->wakeEvent);
+  if (result != UDS_SUCCESS) {
+    freeSimpleWorkQueue(queue);
+    return result;
+  }
   for (int i = 0; i < WORK_QUEUE_PRIORITY_COUNT; i++) {
     result = makeFunnelQueue(&queue->priorityLists[i]);
     if (result != UDS_SUCCESS) {
@@ -922,6 +1208,53 @@ static void finishRoundRobinWorkQueue(RoundRobinWorkQueue *queue)
   }
 }
 
+/**
+ * Restrict a simple work queue's thread to the CPUs of a NUMA node.
+ *
+ * @param queue  The work queue
+ * @param node   The node
+ *
+ * @return 0 or a kernel error code
+ **/
+static int bindSimpleWorkQueueToNode(SimpleWorkQueue *queue, int node)
+{
+  int result = set_cpus_allowed_ptr(queue->thread, cpumask_of_node(node));
+  if (result == 0) {
+    queue->numaNode = node;
+  }
+  return result;
+}
+
+/**********************************************************************/
+KvdoWorkQueue *getWorkQueueServiceQueue(KvdoWorkQueue *queue,
+                                        unsigned int   index)
+{
+  if (!queue->roundRobinMode) {
+    return queue;
+  }
+
+  RoundRobinWorkQueue *rrQueue = asRoundRobinWorkQueue(queue);
+  BUG_ON(index >= rrQueue->numServiceQueues);
+  return &rrQueue->serviceQueues[index]->common;
+}
+
+/**********************************************************************/
+int bindWorkQueueToNode(KvdoWorkQueue *queue, int node)
+{
+  if (!queue->roundRobinMode) {
+    return bindSimpleWorkQueueToNode(asSimpleWorkQueue(queue), node);
+  }
+
+  RoundRobinWorkQueue *rrQueue = asRoundRobinWorkQueue(queue);
+  for (unsigned int i = 0; i < rrQueue->numServiceQueues; i++) {
+    int result = bindSimpleWorkQueueToNode(rrQueue->serviceQueues[i], node);
+    if (result != 0) {
+      return result;
+    }
+  }
+  return 0;
+}
+
 /**********************************************************************/
 void finishWorkQueue(KvdoWorkQueue *queue)
 {
@@ -943,6 +1276,7 @@ static void freeSimpleWorkQueue(SimpleWorkQueue *queue)
   for (unsigned int i = 0; i < WORK_QUEUE_PRIORITY_COUNT; i++) {
     freeFunnelQueue(queue->priorityLists[i]);
   }
+  freeEventCount(queue->wakeEvent);
   cleanupWorkQueueStats(&queue->stats);
   kobject_put(&queue->common.kobj);
 }
@@ -1033,7 +1367,6 @@ static void dumpSimpleWorkQueue(SimpleWorkQueue *queue)
   mutex_unlock(&queueDataLock);
 
   // ->lock spin lock status?
-  // ->waitingWorkerThreads wait queue status? anyone waiting?
 }
 
 /**********************************************************************/
@@ -1070,8 +1403,25 @@ void enqueueWorkQueue(KvdoWorkQueue *kvdoWorkQueue, KvdoWorkItem *item)
 
   item->executionTime = 0;
 
-  if (enqueueWorkQueueItem(queue, item)) {
-    wakeWorkerThread(queue);
+  enqueueWorkQueueItem(queue, item);
+  if (!wakeWorkerThread(queue) && queue->stealable
+      && READ_ONCE(workStealing)) {
+    wakeIdleSibling(queue);
+  }
+}
+
+/**********************************************************************/
+void enqueueWorkQueueBatch(KvdoWorkQueue *kvdoWorkQueue, KvdoWorkItem *items)
+{
+  if (items == NULL) {
+    return;
+  }
+
+  SimpleWorkQueue *queue = pickSimpleQueue(kvdoWorkQueue);
+  enqueueWorkQueueItems(queue, items);
+  if (!wakeWorkerThread(queue) && queue->stealable
+      && READ_ONCE(workStealing)) {
+    wakeIdleSibling(queue);
   }
 }
 
@@ -1091,24 +1441,26 @@ void enqueueWorkQueueDelayed(KvdoWorkQueue *kvdoWorkQueue,
 
   item->executionTime = executionTime;
 
-  // Lock if the work item is delayed. All delayed items are handled via a
-  // single linked list.
   spin_lock_irqsave(&queue->lock, flags);
 
-  if (isWorkItemListEmpty(&queue->delayedItems)) {
-    rescheduleTimer = true;
-  }
   /*
-   * XXX We should keep the list sorted, but at the moment the list won't
-   * grow above a single entry anyway.
+   * The slots before wheelTime have already been expired, so an item due
+   * by then (the timer may be running late) goes in the next slot to be.
    */
+  Jiffies slotTime = ((executionTime < queue->wheelTime)
+                      ? queue->wheelTime : executionTime);
+  if ((queue->delayedCount == 0) || (slotTime < queue->timerExpiry)) {
+    queue->timerExpiry = slotTime;
+    rescheduleTimer    = true;
+  }
   item->myQueue = &queue->common;
-  addToWorkItemList(&queue->delayedItems, item);
+  addToWorkItemList(getWheelSlot(queue, slotTime), item);
+  queue->delayedCount++;
 
   spin_unlock_irqrestore(&queue->lock, flags);
 
   if (rescheduleTimer) {
-    mod_timer(&queue->delayedItemsTimer, executionTime);
+    mod_timer(&queue->delayedItemsTimer, slotTime);
   }
 }
 
@@ -1122,6 +1474,15 @@ KvdoWorkQueue *getCurrentWorkQueue(void)
   return (queue == NULL) ? NULL : &queue->common;
 }
 
+/**********************************************************************/
+void noteWorkQueueBatch(unsigned int count)
+{
+  SimpleWorkQueue *queue = getCurrentThreadWorkQueue();
+  if (queue != NULL) {
+    updateStatsForBatch(&queue->stats, count);
+  }
+}
+
 /**********************************************************************/
 KernelLayer *getWorkQueueOwner(KvdoWorkQueue *queue)
 {
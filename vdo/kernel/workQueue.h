@@ -31,11 +31,17 @@
 enum {
   MAX_QUEUE_NAME_LEN        = TASK_COMM_LEN,
   /** Maximum number of action definitions per work queue type */
-  WORK_QUEUE_ACTION_COUNT   = 8,
+  WORK_QUEUE_ACTION_COUNT   = 10,
   /** Number of priority values available */
   WORK_QUEUE_PRIORITY_COUNT = 4,
 };
 
+/**
+ * Whether idle threads of work queues whose type allows it steal work items
+ * from their busy siblings. Settable through sysfs.
+ **/
+extern bool workStealing;
+
 struct kvdoWorkItem {
   /** Entry link for lock-free work queue */
   FunnelQueueEntry  workQueueEntryLink;
@@ -126,6 +132,20 @@ typedef struct kvdoWorkQueueType {
   /** A function to call in the new thread after running out of work */
   KvdoWorkQueueFunction suspend;
 
+  /**
+   * Whether the threads of a multi-threaded queue of this type may steal
+   * work items from each other. This is only safe if no work item depends
+   * on which of the queue's threads runs it.
+   **/
+  bool                  workStealing;
+
+  /**
+   * Whether the threads of a queue of this type may be set, through sysfs,
+   * to poll for work for a while before going to sleep, trading CPU time for
+   * the latency of being woken.
+   **/
+  bool                  spinPolling;
+
   /** Table of actions for this work queue */
   KvdoWorkQueueAction   actionTable[WORK_QUEUE_ACTION_COUNT];
 } KvdoWorkQueueType;
@@ -159,6 +179,32 @@ int makeWorkQueue(const char               *threadNamePrefix,
                   unsigned int              threadCount,
                   KvdoWorkQueue           **queuePtr);
 
+/**
+ * Restrict the threads of a work queue to the CPUs of a NUMA node.
+ *
+ * @param queue  The work queue
+ * @param node   The node on which the threads should run
+ *
+ * @return 0 or a kernel error code
+ **/
+int bindWorkQueueToNode(KvdoWorkQueue *queue, int node)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get one of the threads of a work queue as a work queue of its own, so that
+ * work can be directed to that thread. For a queue with only one thread,
+ * this is the queue itself.
+ *
+ * @param queue  The work queue
+ * @param index  The index of the thread, which must be less than the number
+ *               of threads the queue was made with
+ *
+ * @return The work queue of the thread
+ **/
+KvdoWorkQueue *getWorkQueueServiceQueue(KvdoWorkQueue *queue,
+                                        unsigned int   index)
+  __attribute__((warn_unused_result));
+
 /**
  * Set up the fields of a work queue item.
  *
@@ -190,6 +236,18 @@ void setupWorkItem(KvdoWorkItem     *item,
  **/
 void enqueueWorkQueue(KvdoWorkQueue *queue, KvdoWorkItem *item);
 
+/**
+ * Add a chain of work items, linked through their next fields and ending
+ * with NULL, to a work queue. Each priority's items are appended with a
+ * single atomic exchange, and the worker thread is woken at most once. All
+ * of the items go to the same thread of a multi-threaded queue, and will be
+ * run in order within each priority.
+ *
+ * @param queue  The queue handle
+ * @param items  The first work item of the chain
+ **/
+void enqueueWorkQueueBatch(KvdoWorkQueue *queue, KvdoWorkItem *items);
+
 /**
  * Add a work item to a work queue, to be run at a later point in time.
  *
@@ -289,6 +347,15 @@ void setWorkQueuePrivateData(void *newData);
  **/
 KvdoWorkQueue *getCurrentWorkQueue(void);
 
+/**
+ * Record that a work item running on the current thread has processed a
+ * batch of objects, for the queue's batch size statistics. Does nothing if
+ * the current thread is not a work queue thread.
+ *
+ * @param count  The number of objects in the batch
+ **/
+void noteWorkQueueBatch(unsigned int count);
+
 /**
  * Returns the kernel layer that owns the work queue.
  *
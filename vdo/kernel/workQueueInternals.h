@@ -28,6 +28,8 @@
 #include <linux/spinlock.h>
 #include <linux/wait.h>
 
+#include "util/eventCount.h"
+
 #include "workItemStats.h"
 #include "workQueueStats.h"
 
@@ -35,6 +37,11 @@ typedef struct kvdoWorkItemList {
   KvdoWorkItem *tail;
 } KvdoWorkItemList;
 
+enum {
+  /** The number of one-jiffy slots in the wheel of delayed work items */
+  DELAYED_WHEEL_SLOTS = 64,
+};
+
 /**
  * Work queue definition.
  *
@@ -82,6 +89,8 @@ struct simpleWorkQueue {
   FunnelQueue             *priorityLists[WORK_QUEUE_PRIORITY_COUNT];
   /** The kernel thread */
   struct task_struct      *thread;
+  /** The NUMA node the thread is bound to, or NUMA_NO_NODE */
+  int                      numaNode;
   /** Life cycle functions, etc */
   const KvdoWorkQueueType *type;
   /** Opaque private data pointer, defined by higher level code */
@@ -90,32 +99,66 @@ struct simpleWorkQueue {
   KvdoWorkQueue           *parentQueue;
   /** Padding for cache line separation */
   char                     pad[CACHE_LINE_BYTES - sizeof(KvdoWorkQueue *)];
-  /** Lock protecting delayedItems, priorityMap, numPriorityLists, started */
+  /**
+   * Lock protecting the delayed wheel, priorityMap, numPriorityLists and
+   * started
+   **/
   spinlock_t               lock;
-  /** Any worker threads (zero or one) waiting for new work to do */
-  wait_queue_head_t        waitingWorkerThreads;
   /**
-   * Hack to reduce wakeup calls if the worker thread is running. See comments
-   * in workQueue.c.
-   *
-   * There is a lot of redundancy with "firstWakeup", though, and the pair
-   * should be re-examined.
+   * The event count the worker thread waits on for new work to do. A
+   * submitter broadcasts it after adding work, which costs only a barrier and
+   * a read when the worker thread is not waiting.
+   **/
+  EventCount              *wakeEvent;
+  /**
+   * Set while the worker thread has found no work to do. This is only a hint,
+   * used to pick a sibling to wake when work stealing and for status dumps;
+   * the event count alone decides whether a wakeup is needed.
    **/
   atomic_t                 idle;
   /** Wait list for synchronization during worker thread startup */
   wait_queue_head_t        startWaiters;
   /** Worker thread status (boolean) */
   bool                     started;
+  /** Whether sibling threads may steal work items from this queue */
+  bool                     stealable;
+  /**
+   * Lock serializing the consumers of a stealable queue's funnel queues,
+   * which are the worker thread and any siblings trying to steal from it.
+   **/
+  spinlock_t               consumerLock;
+  /** Which sibling to try stealing from first */
+  unsigned int             stealRotor;
+  /**
+   * How long (microseconds) the worker thread may poll for work before going
+   * to sleep, or 0 to sleep at once; set through sysfs
+   **/
+  unsigned int             spinMicroseconds;
+  /**
+   * How long the worker thread will poll next time, which is halved each
+   * time a poll finds no work and restored when one does
+   **/
+  unsigned int             spinBudget;
 
-  /** List of delayed work items; usually only one, if any */
-  KvdoWorkItemList         delayedItems;
   /**
-   * Timer for pulling delayed work items off their list and submitting them to
+   * Delayed work items, hashed by execution time into the slots of a timer
+   * wheel, so that adding one is O(1). An item due more than a turn of the
+   * wheel away is passed over until the turn in which it is due.
+   **/
+  KvdoWorkItemList         delayedWheel[DELAYED_WHEEL_SLOTS];
+  /** The number of items in the delayed wheel */
+  unsigned int             delayedCount;
+  /** The first jiffy whose wheel slot has not been expired */
+  Jiffies                  wheelTime;
+  /** When the timer will fire, if there are delayed items */
+  Jiffies                  timerExpiry;
+  /**
+   * Timer for pulling delayed work items off the wheel and submitting them to
    * run.
    *
    * If the spinlock "lock" above is not held, this timer is scheduled (or
    * currently firing and the callback about to acquire the lock) iff
-   * delayedItems is nonempty.
+   * delayedCount is nonzero.
    **/
   struct timer_list        delayedItemsTimer;
 
@@ -126,24 +169,11 @@ struct simpleWorkQueue {
    * Written by submitting threads with atomic64_cmpxchg, and by the worker
    * thread setting to 0.
    *
-   * If the value is 0, the worker is probably asleep; the submitting thread
-   * stores a non-zero value and becomes responsible for calling wake_up on the
-   * worker thread. If the value is non-zero, either the worker is running or
-   * another thread has the responsibility for issuing the wakeup.
-   *
-   * The "sleep" mode has periodic wakeups and the worker thread may happen to
-   * wake up while a work item is being enqueued. If that happens, the wakeup
-   * may be unneeded but will be attempted anyway.
-   *
-   * So the return value from cmpxchg(firstWakeup,0,nonzero) can always be
-   * done, and will tell the submitting thread whether to issue the wakeup or
-   * not; cmpxchg is atomic, so no other synchronization is needed.
-   *
-   * A timestamp is used rather than, say, 1, so that the worker thread can
-   * record stats on how long it takes to actually get the worker thread
-   * running.
-   *
-   * There is some redundancy between this and "idle" above.
+   * A submitting thread whose broadcast actually woke the worker thread
+   * stores the time of the first such wakeup here, if the value is still 0,
+   * so that the worker thread can record stats on how long it takes to
+   * actually get running. The event count, not this field, decides whether a
+   * wakeup is issued.
    **/
   atomic64_t               firstWakeup;
   /** Padding for cache line separation */
@@ -172,6 +202,11 @@ struct roundRobinWorkQueue {
    * problem.)
    **/
   unsigned int      serviceQueueRotor;
+  /**
+   * Rotor used by submitting threads to pick an idle subordinate queue to
+   * wake when work stealing, updated as loosely as serviceQueueRotor.
+   **/
+  unsigned int      wakeRotor;
 };
 
 static inline SimpleWorkQueue *asSimpleWorkQueue(KvdoWorkQueue *queue)
@@ -31,10 +31,8 @@ int initializeWorkQueueStats(KvdoWorkQueueStats *stats,
                              struct kobject     *queueKObject)
 {
   spin_lock_init(&stats->workItemStats.functionTable.lock);
-  if (ENABLE_PER_FUNCTION_TIMING_STATS) {
-    for (int i = 0; i < NUM_WORK_QUEUE_ITEM_STATS + 1; i++) {
-      initSimpleStats(&stats->workItemStats.times[i]);
-    }
+  for (int i = 0; i < NUM_WORK_QUEUE_ITEM_STATS + 1; i++) {
+    initSimpleStats(&stats->workItemStats.times[i]);
   }
 
   stats->queueTimeHistogram
@@ -93,6 +91,14 @@ int initializeWorkQueueStats(KvdoWorkQueueStats *stats,
     return -ENOMEM;
   }
 
+  stats->batchSizeHistogram
+    = makeLogarithmicHistogram(queueKObject, "batch_size",
+                               "Batch Size", "batches",
+                               "batched objects", NULL, 4);
+  if (stats->batchSizeHistogram == NULL) {
+    return -ENOMEM;
+  }
+
   return 0;
 }
 
@@ -106,6 +112,16 @@ void cleanupWorkQueueStats(KvdoWorkQueueStats *stats)
   freeHistogram(&stats->scheduleTimeHistogram);
   freeHistogram(&stats->wakeupLatencyHistogram);
   freeHistogram(&stats->wakeupQueueLengthHistogram);
+  freeHistogram(&stats->batchSizeHistogram);
+}
+
+/**********************************************************************/
+void updateWorkQueueShare(KvdoWorkQueueShare *share,
+                          unsigned int        count,
+                          uint64_t            startTime)
+{
+  atomic64_add(count, &share->items);
+  atomic64_add(currentTime(CLOCK_MONOTONIC) - startTime, &share->runTime);
 }
 
 /**********************************************************************/
@@ -113,7 +129,7 @@ static uint64_t getTotalProcessed(const SimpleWorkQueue *queue)
 {
   uint64_t totalProcessed = 0;
   for (int i = 0; i < NUM_WORK_QUEUE_ITEM_STATS + 1; i++) {
-    totalProcessed += queue->stats.workItemStats.times[i].count;
+    totalProcessed += queue->stats.workItemStats.processed[i];
   }
   return totalProcessed;
 }
@@ -156,3 +172,26 @@ ssize_t formatRunTimeStats(const KvdoWorkQueueStats *stats, char *buffer)
                  "%" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
                  lifetime, runTime, rescheduleTime);
 }
+
+/**********************************************************************/
+ssize_t formatStealStats(const KvdoWorkQueueStats *stats, char *buffer)
+{
+  return sprintf(buffer, "%" PRIu64 " %" PRIu64 "\n",
+                 READ_ONCE(stats->steals), READ_ONCE(stats->stolen));
+}
+
+/**********************************************************************/
+ssize_t formatSpinStats(const KvdoWorkQueueStats *stats, char *buffer)
+{
+  return sprintf(buffer, "%" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+                 READ_ONCE(stats->spins), READ_ONCE(stats->spinStalls),
+                 READ_ONCE(stats->spinTime));
+}
+
+/**********************************************************************/
+ssize_t formatWakeupStats(const KvdoWorkQueueStats *stats, char *buffer)
+{
+  return sprintf(buffer, "%" PRIu64 " %" PRIu64 "\n",
+                 (uint64_t) atomic64_read(&stats->wakeups),
+                 (uint64_t) atomic64_read(&stats->avoidedWakeups));
+}
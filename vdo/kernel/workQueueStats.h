@@ -49,6 +49,23 @@ typedef struct kvdoWorkQueueStats {
   KvdoWorkItemStats  workItemStats;
   // How often we go to sleep waiting for work
   uint64_t           waits;
+  // How many work items we have stolen from sibling queues
+  uint64_t           steals;
+  // How many work items siblings have stolen from us (updated by the
+  // stealing threads while holding our consumer lock)
+  uint64_t           stolen;
+  // How many times polling for work before sleeping found some
+  uint64_t           spins;
+  // How many times polling for work before sleeping gave up
+  uint64_t           spinStalls;
+  // Time spent polling for work before sleeping (ns)
+  uint64_t           spinTime;
+  // How many submissions woke the waiting worker thread (updated by the
+  // submitting threads)
+  atomic64_t         wakeups;
+  // How many submissions found the worker thread not waiting and so skipped
+  // the wakeup (updated by the submitting threads)
+  atomic64_t         avoidedWakeups;
 
   // Run time data, for monitoring utilization levels.
 
@@ -83,8 +100,21 @@ typedef struct kvdoWorkQueueStats {
   Histogram         *wakeupLatencyHistogram;
   // How much work is pending by the time we start running
   Histogram         *wakeupQueueLengthHistogram;
+  // How many objects each batched work item handled
+  Histogram         *batchSizeHistogram;
 } KvdoWorkQueueStats;
 
+/*
+ * The use one layer has made of a work queue shared by all layers, so that a
+ * device which is monopolizing the shared threads can be found.
+ */
+typedef struct kvdoWorkQueueShare {
+  // How many objects the layer's work items have processed
+  atomic64_t items;
+  // How long the layer's work items have run, in nanoseconds
+  atomic64_t runTime;
+} KvdoWorkQueueShare;
+
 /**
  * Initialize the work queue's statistics tracking.
  *
@@ -136,6 +166,31 @@ static inline void updateStatsForDequeue(KvdoWorkQueueStats *stats,
   item->enqueueTime = 0;
 }
 
+/**
+ * Update the work queue statistics tracking to note the processing of
+ * a batch of objects by a single work item.
+ *
+ * @param stats  The statistics structure
+ * @param count  The number of objects in the batch
+ **/
+static inline void updateStatsForBatch(KvdoWorkQueueStats *stats,
+                                       unsigned int        count)
+{
+  enterHistogramSample(stats->batchSizeHistogram, count);
+}
+
+/**
+ * Charge a layer for a batch of objects which one of its work items has
+ * processed on a shared work queue.
+ *
+ * @param share      The layer's share of the queue
+ * @param count      The number of objects in the batch
+ * @param startTime  When the work item started running
+ **/
+void updateWorkQueueShare(KvdoWorkQueueShare *share,
+                          unsigned int        count,
+                          uint64_t            startTime);
+
 /**
  * Write the work queue's accumulated statistics to the kernel log.
  *
@@ -146,6 +201,33 @@ static inline void updateStatsForDequeue(KvdoWorkQueueStats *stats,
  **/
 void logWorkQueueStats(const struct simpleWorkQueue *queue);
 
+/**
+ * Format the counts of work items stolen by and from a work queue into a
+ * supplied buffer for reporting via sysfs.
+ *
+ * @param [in]  stats   The stats structure containing the steal counts
+ * @param [out] buffer  The buffer in which to report the info
+ **/
+ssize_t formatStealStats(const KvdoWorkQueueStats *stats, char *buffer);
+
+/**
+ * Format the counts of successful and abandoned polls for work, and the
+ * time spent polling, into a supplied buffer for reporting via sysfs.
+ *
+ * @param [in]  stats   The stats structure containing the spin counts
+ * @param [out] buffer  The buffer in which to report the info
+ **/
+ssize_t formatSpinStats(const KvdoWorkQueueStats *stats, char *buffer);
+
+/**
+ * Format the counts of wakeups issued and wakeups avoided because the worker
+ * thread was not waiting into a supplied buffer for reporting via sysfs.
+ *
+ * @param [in]  stats   The stats structure containing the wakeup counts
+ * @param [out] buffer  The buffer in which to report the info
+ **/
+ssize_t formatWakeupStats(const KvdoWorkQueueStats *stats, char *buffer);
+
 /**
  * Format the thread lifetime, run time, and suspend time into a
  * supplied buffer for reporting via sysfs.
@@ -40,6 +40,12 @@ static ssize_t nameShow(const KvdoWorkQueue *queue, char *buf)
   return sprintf(buf, "%s\n", queue->name);
 }
 
+/**********************************************************************/
+static ssize_t numaNodeShow(const KvdoWorkQueue *queue, char *buf)
+{
+  return sprintf(buf, "%d\n", asConstSimpleWorkQueue(queue)->numaNode);
+}
+
 /**********************************************************************/
 static ssize_t pidShow(const KvdoWorkQueue *queue, char *buf)
 {
@@ -47,6 +53,40 @@ static ssize_t pidShow(const KvdoWorkQueue *queue, char *buf)
                  (long) atomic_read(&asConstSimpleWorkQueue(queue)->threadID));
 }
 
+/**********************************************************************/
+static ssize_t spinMicrosecondsShow(const KvdoWorkQueue *queue, char *buf)
+{
+  return sprintf(buf, "%u\n",
+                 READ_ONCE(asConstSimpleWorkQueue(queue)->spinMicroseconds));
+}
+
+/**********************************************************************/
+static ssize_t spinMicrosecondsStore(KvdoWorkQueue *queue,
+                                     const char    *buf,
+                                     size_t         length)
+{
+  SimpleWorkQueue *simpleQueue = asSimpleWorkQueue(queue);
+  unsigned int     value;
+  if (!simpleQueue->type->spinPolling || (length > 12)
+      || (sscanf(buf, "%u", &value) != 1) || (value > USEC_PER_SEC)) {
+    return -EINVAL;
+  }
+  WRITE_ONCE(simpleQueue->spinMicroseconds, value);
+  return length;
+}
+
+/**********************************************************************/
+static ssize_t spinsShow(const KvdoWorkQueue *queue, char *buf)
+{
+  return formatSpinStats(&asConstSimpleWorkQueue(queue)->stats, buf);
+}
+
+/**********************************************************************/
+static ssize_t stealsShow(const KvdoWorkQueue *queue, char *buf)
+{
+  return formatStealStats(&asConstSimpleWorkQueue(queue)->stats, buf);
+}
+
 /**********************************************************************/
 static ssize_t timesShow(const KvdoWorkQueue *queue, char *buf)
 {
@@ -60,6 +100,12 @@ static ssize_t typeShow(const KvdoWorkQueue *queue, char *buf)
   return strlen(buf);
 }
 
+/**********************************************************************/
+static ssize_t wakeupsShow(const KvdoWorkQueue *queue, char *buf)
+{
+  return formatWakeupStats(&asConstSimpleWorkQueue(queue)->stats, buf);
+}
+
 /**********************************************************************/
 static ssize_t workFunctionsShow(const KvdoWorkQueue *queue, char *buf)
 {
@@ -68,18 +114,51 @@ static ssize_t workFunctionsShow(const KvdoWorkQueue *queue, char *buf)
                              PAGE_SIZE);
 }
 
+/**********************************************************************/
+static ssize_t workFunctionTimesShow(const KvdoWorkQueue *queue, char *buf)
+{
+  const SimpleWorkQueue *simpleQueue = asConstSimpleWorkQueue(queue);
+  return formatWorkItemRunTimes(&simpleQueue->stats.workItemStats, buf,
+                                PAGE_SIZE);
+}
+
 /**********************************************************************/
 static WorkQueueAttribute nameAttr = {
   .attr = { .name = "name", .mode = 0444, },
   .show = nameShow,
 };
 
+/**********************************************************************/
+static WorkQueueAttribute numaNodeAttr = {
+  .attr = { .name = "numa_node", .mode = 0444, },
+  .show = numaNodeShow,
+};
+
 /**********************************************************************/
 static WorkQueueAttribute pidAttr = {
   .attr = { .name = "pid", .mode = 0444, },
   .show = pidShow,
 };
 
+/**********************************************************************/
+static WorkQueueAttribute spinMicrosecondsAttr = {
+  .attr  = { .name = "spin_microseconds", .mode = 0644, },
+  .show  = spinMicrosecondsShow,
+  .store = spinMicrosecondsStore,
+};
+
+/**********************************************************************/
+static WorkQueueAttribute spinsAttr = {
+  .attr = { .name = "spins", .mode = 0444, },
+  .show = spinsShow,
+};
+
+/**********************************************************************/
+static WorkQueueAttribute stealsAttr = {
+  .attr = { .name = "steals", .mode = 0444, },
+  .show = stealsShow,
+};
+
 /**********************************************************************/
 static WorkQueueAttribute timesAttr = {
   .attr = { .name = "times", .mode = 0444 },
@@ -92,19 +171,37 @@ static WorkQueueAttribute typeAttr = {
   .show = typeShow,
 };
 
+/**********************************************************************/
+static WorkQueueAttribute wakeupsAttr = {
+  .attr = { .name = "wakeups", .mode = 0444, },
+  .show = wakeupsShow,
+};
+
 /**********************************************************************/
 static WorkQueueAttribute workFunctionsAttr = {
   .attr = { .name = "work_functions", .mode = 0444, },
   .show = workFunctionsShow,
 };
 
+/**********************************************************************/
+static WorkQueueAttribute workFunctionTimesAttr = {
+  .attr = { .name = "work_function_times", .mode = 0444, },
+  .show = workFunctionTimesShow,
+};
+
 /**********************************************************************/
 static struct attribute *simpleWorkQueueAttrs[] = {
   &nameAttr.attr,
+  &numaNodeAttr.attr,
   &pidAttr.attr,
+  &spinMicrosecondsAttr.attr,
+  &spinsAttr.attr,
+  &stealsAttr.attr,
   &timesAttr.attr,
   &typeAttr.attr,
+  &wakeupsAttr.attr,
   &workFunctionsAttr.attr,
+  &workFunctionTimesAttr.attr,
   NULL,
 };
 